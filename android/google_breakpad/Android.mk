@@ -73,15 +73,20 @@ LOCAL_SRC_FILES := \
     src/client/linux/crash_generation/crash_generation_client.cc \
     src/client/linux/handler/exception_handler.cc \
     src/client/linux/handler/minidump_descriptor.cc \
+    src/client/linux/handler/minidump_handoff.cc \
     src/client/linux/log/log.cc \
+    src/client/linux/minidump_writer/crash_annotations.cc \
     src/client/linux/minidump_writer/linux_dumper.cc \
     src/client/linux/minidump_writer/linux_ptrace_dumper.cc \
     src/client/linux/minidump_writer/minidump_writer.cc \
+    src/client/linux/minidump_writer/module_identifier_cache.cc \
+    src/client/linux/minidump_writer/thread_stack_sampler.cc \
     src/client/minidump_file_writer.cc \
     src/common/android/breakpad_getcontext.S \
     src/common/convert_UTF.c \
     src/common/md5.cc \
     src/common/string_conversion.cc \
+    src/common/linux/elf_section_index.cc \
     src/common/linux/elfutils.cc \
     src/common/linux/file_id.cc \
     src/common/linux/guid_creator.cc \
@@ -218,6 +218,16 @@ void BreakpadUploadReportWithParametersAndConfiguration(
     NSDictionary *server_parameters,
     NSDictionary *configuration);
 
+// Prepares a report for uploading by the Breakpad client, for example from a
+// background NSURLSession. The request body, with the minidump, is written to
+// |body_path|, and the request to send it with is returned, or nil on failure.
+// |server_parameters| is additional server parameters to send.
+// |configuration| is the configuration of the breakpad report to send.
+NSURLRequest *BreakpadPrepareReportUpload(BreakpadRef ref,
+                                          NSDictionary *server_parameters,
+                                          NSDictionary *configuration,
+                                          NSString *body_path);
+
 // Handles the network response of a breakpad upload. This function is needed if
 // the actual upload is done by the Breakpad client.
 // |configuration| is the configuration of the upload. It must contain the same
@@ -36,6 +36,7 @@
 #include <pthread.h>
 #include <sys/stat.h>
 #include <sys/sysctl.h>
+#include <unistd.h>
 
 #import "client/ios/handler/ios_exception_minidump_generator.h"
 #import "client/mac/crash_generation/ConfigFile.h"
@@ -156,6 +157,9 @@ class Breakpad {
   void UploadNextReport(NSDictionary *server_parameters);
   void UploadReportWithConfiguration(NSDictionary *configuration,
                                      NSDictionary *server_parameters);
+  NSURLRequest *PrepareReportUpload(NSDictionary *configuration,
+                                    NSDictionary *server_parameters,
+                                    NSString *body_path);
   void UploadData(NSData *data, NSString *name,
                   NSDictionary *server_parameters);
   void HandleNetworkResponse(NSDictionary *configuration,
@@ -192,8 +196,6 @@ class Breakpad {
 
   SimpleStringDictionary  *config_params_; // Create parameters (STRONG)
 
-  ConfigFile config_file_;
-
   // A static reference to the current Breakpad instance. Used for handling
   // NSException.
   static Breakpad *current_breakpad_;
@@ -482,6 +484,21 @@ void Breakpad::UploadReportWithConfiguration(NSDictionary *configuration,
   [uploader report];
 }
 
+//=============================================================================
+NSURLRequest *Breakpad::PrepareReportUpload(NSDictionary *configuration,
+                                            NSDictionary *server_parameters,
+                                            NSString *body_path) {
+  Uploader *uploader = [[[Uploader alloc]
+      initWithConfig:configuration] autorelease];
+  if (!uploader)
+    return nil;
+  for (NSString *key in server_parameters) {
+    [uploader addServerParameter:[server_parameters objectForKey:key]
+                          forKey:key];
+  }
+  return [uploader reportRequestWithBodyWrittenToFile:body_path];
+}
+
 //=============================================================================
 void Breakpad::UploadNextReport(NSDictionary *server_parameters) {
   NSDictionary *configuration = NextCrashReportConfiguration();
@@ -546,10 +563,28 @@ NSDictionary *Breakpad::GenerateReport(NSDictionary *server_parameters) {
 //=============================================================================
 bool Breakpad::HandleMinidump(const char *dump_dir,
                               const char *minidump_id) {
-  config_file_.WriteFile(dump_dir,
-                         config_params_,
-                         dump_dir,
-                         minidump_id);
+  // Give a thread that is changing the parameters a moment to finish, so
+  // that the config file doesn't get a half-written value.  The lock is
+  // only tried, never waited on: this may run in a signal handler, and the
+  // crashed thread may be the one holding it.
+  bool locked = false;
+  for (int i = 0; i < 100 && !locked; ++i) {
+    locked = pthread_mutex_trylock(&gDictionaryMutex) == 0;
+    if (!locked)
+      usleep(1000);
+  }
+
+  // The config file is written from config_params_ alone, without any
+  // Objective-C.  It lives on the stack, since this object is in protected
+  // memory and can't be written to.
+  ConfigFile config_file;
+  config_file.WriteFile(dump_dir,
+                        config_params_,
+                        dump_dir,
+                        minidump_id);
+
+  if (locked)
+    pthread_mutex_unlock(&gDictionaryMutex);
 
   // Return true here to indicate that we've processed things as much as we
   // want.
@@ -867,6 +902,23 @@ void BreakpadUploadNextReportWithParameters(BreakpadRef ref,
   }
 }
 
+//=============================================================================
+NSURLRequest *BreakpadPrepareReportUpload(BreakpadRef ref,
+                                          NSDictionary *server_parameters,
+                                          NSDictionary *configuration,
+                                          NSString *body_path) {
+  try {
+    // Not called at exception time
+    Breakpad *breakpad = (Breakpad *)ref;
+    if (breakpad && configuration && body_path)
+      return breakpad->PrepareReportUpload(configuration, server_parameters,
+                                           body_path);
+  } catch(...) {    // don't let exceptions leave this C API
+    fprintf(stderr, "BreakpadPrepareReportUpload() : error\n");
+  }
+  return nil;
+}
+
 void BreakpadHandleNetworkResponse(BreakpadRef ref,
                                    NSDictionary *configuration,
                                    NSData *data,
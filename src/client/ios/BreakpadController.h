@@ -66,6 +66,24 @@
   // The dictionary that contains additional server parameters to send when
   // uploading crash reports.
   NSDictionary* uploadTimeParameters_;
+
+  // The identifier of the background session reports are uploaded with, or
+  // nil to upload them one at a time on |queue_|.
+  NSString* backgroundSessionIdentifier_;
+
+  // The background session, created when the controller starts.
+  NSURLSession* uploadSession_;
+
+  // The response bodies of running uploads, by task identifier. Only used on
+  // |queue_|.
+  NSMutableDictionary* uploadResponses_;
+
+  // Whether the uploads that a previous run left unfinished have been started
+  // again.
+  BOOL interruptedUploadsResumed_;
+
+  // The handler given to handleEventsForBackgroundURLSession:.
+  void (^backgroundEventsCompletionHandler_)();
 }
 
 // Singleton.
@@ -88,6 +106,21 @@
 // will prevent uploads.
 - (void)setUploadInterval:(int)intervalInSeconds;
 
+// Upload reports with the background NSURLSession |identifier|, several at a
+// time, instead of one by one on the breakpad thread. Uploads keep going
+// while the application is suspended, and are not started again on the next
+// launch unless they failed. The application delegate must forward
+// -application:handleEventsForBackgroundURLSession:completionHandler: to
+// handleEventsForBackgroundURLSession:completionHandler:. This must be called
+// before the controller is started.
+- (void)setBackgroundUploadSessionIdentifier:(NSString*)identifier;
+
+// Finishes the uploads of the background session |identifier|, if it is the
+// one set with setBackgroundUploadSessionIdentifier:, then calls
+// |completionHandler|.
+- (void)handleEventsForBackgroundURLSession:(NSString*)identifier
+                          completionHandler:(void(^)())completionHandler;
+
 // Set additional server parameters to send when uploading crash reports.
 - (void)setParametersToAddAtUploadTime:(NSDictionary*)uploadTimeParameters;
 
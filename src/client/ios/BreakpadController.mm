@@ -41,7 +41,7 @@
 #pragma mark -
 #pragma mark Private Methods
 
-@interface BreakpadController ()
+@interface BreakpadController () <NSURLSessionDataDelegate>
 
 // Init the singleton instance.
 - (id)initSingleton;
@@ -49,6 +49,22 @@
 // Load a crash report and send it to the server.
 - (void)sendStoredCrashReports;
 
+// Starts background uploads of the next reports, up to a batch of them. This
+// method must be called from the breakpad queue.
+- (void)threadUnsafeStartReportUploads;
+
+// Starts the upload of the request body at |bodyPath|.
+- (void)startUploadOfBody:(NSString*)bodyPath request:(NSURLRequest*)request;
+
+// Starts the uploads that a previous run left unfinished again, except those
+// still in |uploadTasks|. This method must be called from the breakpad queue.
+- (void)threadUnsafeResumeUploadsExcept:(NSArray*)uploadTasks;
+
+// Handles the end of |task|. This method must be called from the breakpad
+// queue.
+- (void)threadUnsafeFinishUploadTask:(NSURLSessionTask*)task
+                           withError:(NSError*)error;
+
 // Returns when a report can be sent. |-1| means never, |0| means that a report
 // can be sent immediately, a positive number is the number of seconds to wait
 // before being allowed to upload a report.
@@ -69,6 +85,29 @@ namespace {
 // server.
 NSString* const kLastSubmission = @"com.google.Breakpad.LastSubmission";
 
+// The most reports started uploading in the background at once.
+const int kUploadBatchSize = 4;
+
+// A report being uploaded in the background has its request body in the dump
+// directory, in <minidump ID>.upload, and a record of it next to the body,
+// in <minidump ID>.upload.plist. The record keeps the report configuration
+// and the request, to handle the response or start the upload again after
+// a relaunch.
+NSString* const kUploadBodyExtension = @"upload";
+NSString* const kUploadRecordExtension = @"plist";
+NSString* const kUploadRecordConfiguration = @"Configuration";
+NSString* const kUploadRecordRequest = @"Request";
+
+NSString* UploadRecordPath(NSString* bodyPath) {
+  return [bodyPath stringByAppendingPathExtension:kUploadRecordExtension];
+}
+
+void RemoveUpload(NSString* bodyPath) {
+  NSFileManager* fileManager = [NSFileManager defaultManager];
+  [fileManager removeItemAtPath:bodyPath error:nil];
+  [fileManager removeItemAtPath:UploadRecordPath(bodyPath) error:nil];
+}
+
 // Returns a NSString describing the current platform.
 NSString* GetPlatform() {
   // Name of the system call for getting the platform.
@@ -110,6 +149,7 @@ NSString* GetPlatform() {
     queue_ = dispatch_queue_create("com.google.BreakpadQueue", NULL);
     enableUploads_ = NO;
     started_ = NO;
+    uploadResponses_ = [[NSMutableDictionary alloc] init];
     [self resetConfiguration];
   }
   return self;
@@ -121,6 +161,9 @@ NSString* GetPlatform() {
   dispatch_release(queue_);
   [configuration_ release];
   [uploadTimeParameters_ release];
+  [backgroundSessionIdentifier_ release];
+  [uploadSession_ release];
+  [uploadResponses_ release];
   [super dealloc];
 }
 
@@ -136,6 +179,17 @@ NSString* GetPlatform() {
       if (breakpadRef_) {
         BreakpadAddUploadParameter(breakpadRef_, @"platform", GetPlatform());
       }
+      if (backgroundSessionIdentifier_ && !uploadSession_) {
+        // There can only be one session with the identifier in the process,
+        // so it outlives stop.
+        NSString* identifier = backgroundSessionIdentifier_;
+        NSURLSessionConfiguration* config = [NSURLSessionConfiguration
+            backgroundSessionConfigurationWithIdentifier:identifier];
+        uploadSession_ =
+            [[NSURLSession sessionWithConfiguration:config
+                                           delegate:self
+                                      delegateQueue:nil] retain];
+      }
   };
   if (onCurrentThread)
     startBlock();
@@ -223,6 +277,25 @@ NSString* GetPlatform() {
     uploadIntervalInSeconds_ = 0;
 }
 
+- (void)setBackgroundUploadSessionIdentifier:(NSString*)identifier {
+  NSAssert(!started_, @"The controller must not be started when "
+                      "setBackgroundUploadSessionIdentifier is called");
+  [backgroundSessionIdentifier_ autorelease];
+  backgroundSessionIdentifier_ = [identifier copy];
+}
+
+- (void)handleEventsForBackgroundURLSession:(NSString*)identifier
+                          completionHandler:(void(^)())completionHandler {
+  if (![identifier isEqualToString:backgroundSessionIdentifier_])
+    return;
+  dispatch_async(queue_, ^{
+      // The session delivers the events now that it has been told about the
+      // handler, and calls URLSessionDidFinishEventsForBackgroundURLSession:.
+      Block_release(backgroundEventsCompletionHandler_);
+      backgroundEventsCompletionHandler_ = Block_copy(completionHandler);
+  });
+}
+
 - (void)setParametersToAddAtUploadTime:(NSDictionary*)uploadTimeParameters {
   NSAssert(!started_, @"The controller must not be started when "
                       "setParametersToAddAtUploadTime is called");
@@ -319,6 +392,17 @@ NSString* GetPlatform() {
 
 - (void)sendStoredCrashReports {
   dispatch_async(queue_, ^{
+      if (uploadSession_ && enableUploads_ && !interruptedUploadsResumed_) {
+        interruptedUploadsResumed_ = YES;
+        [uploadSession_ getTasksWithCompletionHandler:
+            ^(NSArray* dataTasks, NSArray* uploadTasks,
+              NSArray* downloadTasks) {
+                dispatch_async(queue_, ^{
+                    [self threadUnsafeResumeUploadsExcept:uploadTasks];
+                });
+            }];
+      }
+
       if (BreakpadGetCrashReportCount(breakpadRef_) == 0)
         return;
 
@@ -331,8 +415,12 @@ NSString* GetPlatform() {
       // A report can be sent now.
       if (timeToWait == 0) {
         [self reportWillBeSent];
-        BreakpadUploadNextReportWithParameters(breakpadRef_,
-                                               uploadTimeParameters_);
+        if (uploadSession_) {
+          [self threadUnsafeStartReportUploads];
+        } else {
+          BreakpadUploadNextReportWithParameters(breakpadRef_,
+                                                 uploadTimeParameters_);
+        }
 
         // If more reports must be sent, make sure this method is called again.
         if (BreakpadGetCrashReportCount(breakpadRef_) > 0)
@@ -351,4 +439,164 @@ NSString* GetPlatform() {
   });
 }
 
+#pragma mark -
+
+- (void)threadUnsafeStartReportUploads {
+  NSString* directory = BreakpadKeyValue(breakpadRef_,
+                                         @BREAKPAD_DUMP_DIRECTORY);
+  for (int i = 0; i < kUploadBatchSize; ++i) {
+    // This deletes the report's config file, so from here on the report is
+    // only known by its upload record.
+    NSDictionary* configuration =
+        BreakpadGetNextReportConfiguration(breakpadRef_);
+    if (!configuration)
+      return;
+
+    NSString* minidumpID = [configuration objectForKey:@kReporterMinidumpIDKey];
+    NSURL* url =
+        [NSURL URLWithString:[configuration objectForKey:@BREAKPAD_URL]];
+    if (![minidumpID length] || [url isFileURL]) {
+      // Background sessions can't write the request to a file URL.
+      BreakpadUploadReportWithParametersAndConfiguration(breakpadRef_,
+                                                         uploadTimeParameters_,
+                                                         configuration);
+      continue;
+    }
+
+    NSString* bodyPath = [directory stringByAppendingPathComponent:
+        [minidumpID stringByAppendingPathExtension:kUploadBodyExtension]];
+    NSURLRequest* request = BreakpadPrepareReportUpload(breakpadRef_,
+                                                        uploadTimeParameters_,
+                                                        configuration,
+                                                        bodyPath);
+    if (!request)
+      continue;
+
+    NSDictionary* record = [NSDictionary dictionaryWithObjectsAndKeys:
+        configuration, kUploadRecordConfiguration,
+        [NSKeyedArchiver archivedDataWithRootObject:request],
+        kUploadRecordRequest,
+        nil];
+    if (![record writeToFile:UploadRecordPath(bodyPath) atomically:YES]) {
+      RemoveUpload(bodyPath);
+      continue;
+    }
+    [self startUploadOfBody:bodyPath request:request];
+  }
+}
+
+- (void)startUploadOfBody:(NSString*)bodyPath request:(NSURLRequest*)request {
+  NSURLSessionUploadTask* task =
+      [uploadSession_ uploadTaskWithRequest:request
+                                   fromFile:[NSURL fileURLWithPath:bodyPath]];
+  // The description survives a relaunch, unlike the task identifier.
+  [task setTaskDescription:bodyPath];
+  [task resume];
+}
+
+- (void)threadUnsafeResumeUploadsExcept:(NSArray*)uploadTasks {
+  NSMutableSet* runningBodies = [NSMutableSet set];
+  for (NSURLSessionTask* task in uploadTasks) {
+    if ([task taskDescription])
+      [runningBodies addObject:[task taskDescription]];
+  }
+
+  NSString* directory = BreakpadKeyValue(breakpadRef_,
+                                         @BREAKPAD_DUMP_DIRECTORY);
+  if (!directory)
+    return;
+  NSArray* files = [[NSFileManager defaultManager]
+      contentsOfDirectoryAtPath:directory error:nil];
+  for (NSString* file in files) {
+    if (![[file pathExtension] isEqualToString:kUploadBodyExtension])
+      continue;
+    NSString* bodyPath = [directory stringByAppendingPathComponent:file];
+    if ([runningBodies containsObject:bodyPath])
+      continue;
+
+    NSDictionary* record =
+        [NSDictionary dictionaryWithContentsOfFile:UploadRecordPath(bodyPath)];
+    NSData* requestData = [record objectForKey:kUploadRecordRequest];
+    NSURLRequest* request = nil;
+    @try {
+      if (requestData)
+        request = [NSKeyedUnarchiver unarchiveObjectWithData:requestData];
+    } @catch (NSException* exception) {
+      request = nil;
+    }
+    if (![request isKindOfClass:[NSURLRequest class]]) {
+      RemoveUpload(bodyPath);
+      continue;
+    }
+    [self startUploadOfBody:bodyPath request:request];
+  }
+}
+
+- (void)threadUnsafeFinishUploadTask:(NSURLSessionTask*)task
+                           withError:(NSError*)error {
+  NSNumber* taskKey = [NSNumber numberWithUnsignedInteger:
+      [task taskIdentifier]];
+  NSData* data = [[[uploadResponses_ objectForKey:taskKey] retain] autorelease];
+  [uploadResponses_ removeObjectForKey:taskKey];
+
+  NSString* bodyPath = [task taskDescription];
+  if (!bodyPath)
+    return;
+
+  // A request that never got a response is started again on the next launch.
+  // One the server answered, even with an error, is done with, as it would
+  // be when uploading on the breakpad queue.
+  if (error && ![task response])
+    return;
+
+  NSDictionary* record =
+      [NSDictionary dictionaryWithContentsOfFile:UploadRecordPath(bodyPath)];
+  NSDictionary* configuration =
+      [record objectForKey:kUploadRecordConfiguration];
+  if (configuration && breakpadRef_)
+    BreakpadHandleNetworkResponse(breakpadRef_, configuration, data, error);
+  RemoveUpload(bodyPath);
+}
+
+#pragma mark -
+#pragma mark NSURLSessionDataDelegate
+
+- (void)URLSession:(NSURLSession*)session
+          dataTask:(NSURLSessionDataTask*)dataTask
+    didReceiveData:(NSData*)data {
+  NSNumber* taskKey = [NSNumber numberWithUnsignedInteger:
+      [dataTask taskIdentifier]];
+  dispatch_async(queue_, ^{
+      NSMutableData* response = [uploadResponses_ objectForKey:taskKey];
+      if (response)
+        [response appendData:data];
+      else
+        [uploadResponses_ setObject:[NSMutableData dataWithData:data]
+                             forKey:taskKey];
+  });
+}
+
+- (void)URLSession:(NSURLSession*)session
+                    task:(NSURLSessionTask*)task
+    didCompleteWithError:(NSError*)error {
+  dispatch_async(queue_, ^{
+      [self threadUnsafeFinishUploadTask:task withError:error];
+  });
+}
+
+- (void)URLSessionDidFinishEventsForBackgroundURLSession:
+    (NSURLSession*)session {
+  // Queued after the completions above, so the responses are handled first.
+  dispatch_async(queue_, ^{
+      void (^completionHandler)() = backgroundEventsCompletionHandler_;
+      backgroundEventsCompletionHandler_ = nil;
+      if (!completionHandler)
+        return;
+      dispatch_async(dispatch_get_main_queue(), ^{
+          completionHandler();
+          Block_release(completionHandler);
+      });
+  });
+}
+
 @end
@@ -30,22 +30,32 @@
 #ifndef CLIENT_LINUX_CRASH_GENERATION_CLIENT_INFO_H_
 #define CLIENT_LINUX_CRASH_GENERATION_CLIENT_INFO_H_
 
+#include <stddef.h>
+
 namespace google_breakpad {
 
 class CrashGenerationServer;
+struct DumpSignature;
 
 class ClientInfo {
  public:
-  ClientInfo(pid_t pid, CrashGenerationServer* crash_server)
+  ClientInfo(pid_t pid, CrashGenerationServer* crash_server,
+             const DumpSignature* dump_signature = NULL)
     : crash_server_(crash_server),
-      pid_(pid) {}
+      pid_(pid),
+      dump_signature_(dump_signature) {}
 
   CrashGenerationServer* crash_server() const { return crash_server_; }
   pid_t pid() const { return pid_; }
 
+  // The signature of the client's crash, if the server has a DumpAnalyzer
+  // and it found one; NULL otherwise.  Only valid during the callback.
+  const DumpSignature* dump_signature() const { return dump_signature_; }
+
  private:
   CrashGenerationServer* crash_server_;
   pid_t pid_;
+  const DumpSignature* dump_signature_;
 };
 
 }
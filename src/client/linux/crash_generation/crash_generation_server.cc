@@ -31,9 +31,10 @@
 #include <dirent.h>
 #include <fcntl.h>
 #include <limits.h>
-#include <poll.h>
 #include <stdio.h>
 #include <string.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
 #include <sys/socket.h>
 #include <sys/stat.h>
 #include <sys/types.h>
@@ -43,16 +44,25 @@
 
 #include "client/linux/crash_generation/crash_generation_server.h"
 #include "client/linux/crash_generation/client_info.h"
+#include "client/linux/crash_generation/dump_analyzer.h"
 #include "client/linux/handler/exception_handler.h"
 #include "client/linux/minidump_writer/minidump_writer.h"
 #include "common/linux/eintr_wrapper.h"
 #include "common/linux/guid_creator.h"
 #include "common/linux/safe_readlink.h"
 
-static const char kCommandQuit = 'x';
+static const uint64_t kCommandQuit = 1;
 
 namespace google_breakpad {
 
+// A dump request read from the client channel, waiting for a worker.
+struct CrashGenerationServer::DumpRequest {
+  pid_t crashing_pid;
+  int signal_fd;
+  string minidump_filename;
+  char crash_context[sizeof(ExceptionHandler::CrashContext)];
+};
+
 CrashGenerationServer::CrashGenerationServer(
   const int listen_fd,
   OnClientDumpRequestCallback dump_callback,
@@ -67,18 +77,50 @@ CrashGenerationServer::CrashGenerationServer(
     exit_callback_(exit_callback),
     exit_context_(exit_context),
     generate_dumps_(generate_dumps),
-    started_(false)
+    dump_analyzer_(NULL),
+    started_(false),
+    epoll_fd_(-1),
+    control_fd_(-1),
+    worker_done_fd_(-1),
+    watching_clients_(false),
+    max_concurrent_dumps_(kDefaultMaxConcurrentDumps),
+    stopping_(false)
 {
   if (dump_path)
     dump_dir_ = *dump_path;
   else
     dump_dir_ = "/tmp";
+
+  pthread_mutex_init(&queue_mutex_, NULL);
+  pthread_cond_init(&queue_cond_, NULL);
 }
 
 CrashGenerationServer::~CrashGenerationServer()
 {
   if (started_)
     Stop();
+
+  pthread_cond_destroy(&queue_cond_);
+  pthread_mutex_destroy(&queue_mutex_);
+}
+
+static void
+CloseIfOpen(int* fd)
+{
+  if (*fd >= 0) {
+    close(*fd);
+    *fd = -1;
+  }
+}
+
+static bool
+AddToEpoll(int epoll_fd, int fd)
+{
+  struct epoll_event event;
+  memset(&event, 0, sizeof(event));
+  event.events = EPOLLIN;
+  event.data.fd = fd;
+  return epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &event) == 0;
 }
 
 bool
@@ -87,24 +129,33 @@ CrashGenerationServer::Start()
   if (started_ || 0 > server_fd_)
     return false;
 
-  int control_pipe[2];
-  if (pipe(control_pipe))
+  control_fd_ = eventfd(0, EFD_NONBLOCK);
+  worker_done_fd_ = eventfd(0, EFD_NONBLOCK);
+  epoll_fd_ = epoll_create(3);
+  if (control_fd_ < 0 || worker_done_fd_ < 0 || epoll_fd_ < 0 ||
+      fcntl(control_fd_, F_SETFD, FD_CLOEXEC) ||
+      fcntl(worker_done_fd_, F_SETFD, FD_CLOEXEC) ||
+      fcntl(epoll_fd_, F_SETFD, FD_CLOEXEC) ||
+      !AddToEpoll(epoll_fd_, control_fd_) ||
+      !AddToEpoll(epoll_fd_, worker_done_fd_) ||
+      !WatchClients(true)) {
+    CloseIfOpen(&epoll_fd_);
+    CloseIfOpen(&worker_done_fd_);
+    CloseIfOpen(&control_fd_);
+    watching_clients_ = false;
     return false;
+  }
 
-  if (fcntl(control_pipe[0], F_SETFD, FD_CLOEXEC))
-    return false;
-  if (fcntl(control_pipe[1], F_SETFD, FD_CLOEXEC))
-    return false;
-
-  if (fcntl(control_pipe[0], F_SETFL, O_NONBLOCK))
-    return false;
-
-  control_pipe_in_ = control_pipe[0];
-  control_pipe_out_ = control_pipe[1];
-
-  if (pthread_create(&thread_, NULL,
-                     ThreadMain, reinterpret_cast<void*>(this)))
+  if (!StartWorkers() ||
+      pthread_create(&thread_, NULL,
+                     ThreadMain, reinterpret_cast<void*>(this))) {
+    StopWorkers();
+    CloseIfOpen(&epoll_fd_);
+    CloseIfOpen(&worker_done_fd_);
+    CloseIfOpen(&control_fd_);
+    watching_clients_ = false;
     return false;
+  }
 
   started_ = true;
   return true;
@@ -118,14 +169,36 @@ CrashGenerationServer::Stop()
   if (!started_)
     return;
 
-  HANDLE_EINTR(write(control_pipe_out_, &kCommandQuit, 1));
+  HANDLE_EINTR(write(control_fd_, &kCommandQuit, sizeof(kCommandQuit)));
 
   void* dummy;
   pthread_join(thread_, &dummy);
 
+  // Let the clients whose requests were already read have their dumps.
+  StopWorkers();
+
+  CloseIfOpen(&epoll_fd_);
+  CloseIfOpen(&worker_done_fd_);
+  CloseIfOpen(&control_fd_);
+  watching_clients_ = false;
+
   started_ = false;
 }
 
+void
+CrashGenerationServer::set_max_concurrent_dumps(unsigned max_dumps)
+{
+  assert(!started_);
+  max_concurrent_dumps_ = max_dumps ? max_dumps : 1;
+}
+
+void
+CrashGenerationServer::set_dump_analyzer(DumpAnalyzer* analyzer)
+{
+  assert(!started_);
+  dump_analyzer_ = analyzer;
+}
+
 //static
 bool
 CrashGenerationServer::CreateReportChannel(int* server_fd, int* client_fd)
@@ -155,18 +228,12 @@ CrashGenerationServer::CreateReportChannel(int* server_fd, int* client_fd)
 void
 CrashGenerationServer::Run()
 {
-  struct pollfd pollfds[2];
-  memset(&pollfds, 0, sizeof(pollfds));
-
-  pollfds[0].fd = server_fd_;
-  pollfds[0].events = POLLIN;
-
-  pollfds[1].fd = control_pipe_in_;
-  pollfds[1].events = POLLIN;
+  struct epoll_event events[3];
 
   while (true) {
     // infinite timeout
-    int nevents = poll(pollfds, sizeof(pollfds)/sizeof(pollfds[0]), -1);
+    int nevents = epoll_wait(epoll_fd_, events,
+                             sizeof(events)/sizeof(events[0]), -1);
     if (-1 == nevents) {
       if (EINTR == errno) {
         continue;
@@ -175,20 +242,33 @@ CrashGenerationServer::Run()
       }
     }
 
-    if (pollfds[0].revents && !ClientEvent(pollfds[0].revents))
-      return;
-
-    if (pollfds[1].revents && !ControlEvent(pollfds[1].revents))
-      return;
+    for (int i = 0; i < nevents; ++i) {
+      const int fd = events[i].data.fd;
+      if (fd == server_fd_) {
+        if (!ClientEvent(events[i].events))
+          return;
+        // Leave further requests in the channel while the queue is full.
+        if (DumpQueueFull() && !WatchClients(false))
+          return;
+      } else if (fd == control_fd_) {
+        if (!ControlEvent(events[i].events))
+          return;
+      } else if (fd == worker_done_fd_) {
+        uint64_t count;
+        HANDLE_EINTR(read(worker_done_fd_, &count, sizeof(count)));
+        if (!watching_clients_ && !DumpQueueFull() && !WatchClients(true))
+          return;
+      }
+    }
   }
 }
 
 bool
-CrashGenerationServer::ClientEvent(short revents)
+CrashGenerationServer::ClientEvent(unsigned int events)
 {
-  if (POLLHUP & revents)
+  if (EPOLLHUP & events)
     return false;
-  assert(POLLIN & revents);
+  assert(EPOLLIN & events);
 
   // A process has crashed and has signaled us by writing a datagram
   // to the death signal socket. The datagram contains the crash context needed
@@ -257,39 +337,163 @@ CrashGenerationServer::ClientEvent(short revents)
     return true;
   }
 
-  string minidump_filename;
-  if (!MakeMinidumpFilename(minidump_filename))
+  DumpRequest* request = new DumpRequest;
+  if (!MakeMinidumpFilename(request->minidump_filename)) {
+    delete request;
+    close(signal_fd);
     return true;
+  }
+  request->crashing_pid = crashing_pid;
+  request->signal_fd = signal_fd;
+  memcpy(request->crash_context, crash_context, kCrashContextSize);
+  QueueDump(request);
 
-  if (!google_breakpad::WriteMinidump(minidump_filename.c_str(),
-                                      crashing_pid, crash_context,
-                                      kCrashContextSize)) {
-    close(signal_fd);
+  return true;
+}
+
+void
+CrashGenerationServer::QueueDump(DumpRequest* request)
+{
+  pthread_mutex_lock(&queue_mutex_);
+  if (!clients_dumping_.insert(request->crashing_pid).second) {
+    // This client already has a dump on the way; don't let it queue more.
+    pthread_mutex_unlock(&queue_mutex_);
+    close(request->signal_fd);
+    delete request;
+    return;
+  }
+  pending_dumps_.push_back(request);
+  pthread_cond_signal(&queue_cond_);
+  pthread_mutex_unlock(&queue_mutex_);
+}
+
+bool
+CrashGenerationServer::DumpQueueFull()
+{
+  pthread_mutex_lock(&queue_mutex_);
+  const bool full = pending_dumps_.size() >= max_concurrent_dumps_;
+  pthread_mutex_unlock(&queue_mutex_);
+  return full;
+}
+
+bool
+CrashGenerationServer::WatchClients(bool watch)
+{
+  if (watch == watching_clients_)
     return true;
+
+  if (watch) {
+    if (!AddToEpoll(epoll_fd_, server_fd_))
+      return false;
+  } else {
+    // Older kernels insist on an event argument even when deleting.
+    struct epoll_event event;
+    memset(&event, 0, sizeof(event));
+    if (epoll_ctl(epoll_fd_, EPOLL_CTL_DEL, server_fd_, &event))
+      return false;
+  }
+  watching_clients_ = watch;
+  return true;
+}
+
+// The following methods execute on the dump workers
+
+void
+CrashGenerationServer::WorkerLoop()
+{
+  while (true) {
+    pthread_mutex_lock(&queue_mutex_);
+    while (pending_dumps_.empty() && !stopping_)
+      pthread_cond_wait(&queue_cond_, &queue_mutex_);
+    if (pending_dumps_.empty()) {
+      pthread_mutex_unlock(&queue_mutex_);
+      return;
+    }
+    DumpRequest* request = pending_dumps_.front();
+    pending_dumps_.pop_front();
+    pthread_mutex_unlock(&queue_mutex_);
+
+    HandleDump(request);
+
+    pthread_mutex_lock(&queue_mutex_);
+    clients_dumping_.erase(request->crashing_pid);
+    pthread_mutex_unlock(&queue_mutex_);
+    delete request;
+
+    // Wake the event loop in case it stopped reading requests.
+    const uint64_t one = 1;
+    HANDLE_EINTR(write(worker_done_fd_, &one, sizeof(one)));
+  }
+}
+
+void
+CrashGenerationServer::HandleDump(DumpRequest* request)
+{
+  if (!google_breakpad::WriteMinidump(request->minidump_filename.c_str(),
+                                      request->crashing_pid,
+                                      request->crash_context,
+                                      sizeof(request->crash_context))) {
+    close(request->signal_fd);
+    return;
   }
 
+  DumpSignature signature;
+  bool has_signature =
+      dump_analyzer_ &&
+      dump_analyzer_->Analyze(request->minidump_filename, &signature);
+
   if (dump_callback_) {
-    ClientInfo info(crashing_pid, this);
+    ClientInfo info(request->crashing_pid, this,
+                    has_signature ? &signature : NULL);
 
-    dump_callback_(dump_context_, &info, &minidump_filename);
+    dump_callback_(dump_context_, &info, &request->minidump_filename);
   }
 
   // Send the done signal to the process: it can exit now.
   // (Closing this will make the child's sys_read unblock and return 0.)
-  close(signal_fd);
+  close(request->signal_fd);
+}
 
+bool
+CrashGenerationServer::StartWorkers()
+{
+  for (unsigned i = 0; i < max_concurrent_dumps_; ++i) {
+    pthread_t worker;
+    if (pthread_create(&worker, NULL,
+                       WorkerMain, reinterpret_cast<void*>(this)))
+      return false;
+    workers_.push_back(worker);
+  }
   return true;
 }
 
+void
+CrashGenerationServer::StopWorkers()
+{
+  pthread_mutex_lock(&queue_mutex_);
+  stopping_ = true;
+  pthread_cond_broadcast(&queue_cond_);
+  pthread_mutex_unlock(&queue_mutex_);
+
+  for (size_t i = 0; i < workers_.size(); ++i) {
+    void* dummy;
+    pthread_join(workers_[i], &dummy);
+  }
+  workers_.clear();
+  stopping_ = false;
+}
+
+// The following methods execute on the server thread
+
 bool
-CrashGenerationServer::ControlEvent(short revents)
+CrashGenerationServer::ControlEvent(unsigned int events)
 {
-  if (POLLHUP & revents)
+  if (EPOLLHUP & events)
     return false;
-  assert(POLLIN & revents);
+  assert(EPOLLIN & events);
 
-  char command;
-  if (read(control_pipe_in_, &command, 1))
+  uint64_t command;
+  if (read(control_fd_, &command, sizeof(command)) != sizeof(command))
     return false;
 
   switch (command) {
@@ -327,4 +531,12 @@ CrashGenerationServer::ThreadMain(void *arg)
   return NULL;
 }
 
+// static
+void*
+CrashGenerationServer::WorkerMain(void *arg)
+{
+  reinterpret_cast<CrashGenerationServer*>(arg)->WorkerLoop();
+  return NULL;
+}
+
 }  // namespace google_breakpad
@@ -31,20 +31,25 @@
 #define CLIENT_LINUX_CRASH_GENERATION_CRASH_GENERATION_SERVER_H_
 
 #include <pthread.h>
+#include <sys/types.h>
 
+#include <deque>
+#include <set>
 #include <string>
+#include <vector>
 
 #include "common/using_std_string.h"
 
 namespace google_breakpad {
 
 class ClientInfo;
+class DumpAnalyzer;
 
 class CrashGenerationServer {
 public:
   // WARNING: callbacks may be invoked on a different thread
-  // than that which creates the CrashGenerationServer.  They must
-  // be thread safe.
+  // than that which creates the CrashGenerationServer, and dump request
+  // callbacks on several threads at once.  They must be thread safe.
   typedef void (*OnClientDumpRequestCallback)(void* context,
                                               const ClientInfo* client_info,
                                               const string* file_path);
@@ -52,6 +57,10 @@ public:
   typedef void (*OnClientExitingCallback)(void* context,
                                           const ClientInfo* client_info);
 
+  // The number of dumps written at the same time unless changed with
+  // set_max_concurrent_dumps().
+  static const unsigned kDefaultMaxConcurrentDumps = 4;
+
   // Create an instance with the given parameters.
   //
   // Parameter listen_fd: The server fd created by CreateReportChannel().
@@ -80,9 +89,25 @@ public:
   // Return true if initialization is successful; false otherwise.
   bool Start();
 
-  // Stop the server.
+  // Stop the server.  Dump requests already received are completed first.
   void Stop();
 
+  // Sets how many dumps may be written at the same time, each on its own
+  // worker thread.  Dump requests arriving while every worker is busy wait
+  // in a queue of up to |max_dumps| more; once that is full, no further
+  // requests are read until a worker frees up, leaving the clients blocked
+  // in the channel.  A client that sends a request while one of its own is
+  // pending is refused.  Must be called before Start().
+  void set_max_concurrent_dumps(unsigned max_dumps);
+
+  // Sets an analyzer that each dump is handed to once it is written, on
+  // the worker thread that wrote it.  If it finds a signature, the dump
+  // request callback gets it through ClientInfo::dump_signature().  The
+  // client is kept waiting until the analysis and the callback are done.
+  // Does not take ownership of |analyzer|, which may be NULL (the
+  // default).  Must be called before Start().
+  void set_dump_analyzer(DumpAnalyzer* analyzer);
+
   // Create a "channel" that can be used by clients to report crashes
   // to a CrashGenerationServer.  |*server_fd| should be passed to
   // this class's constructor, and |*client_fd| should be passed to
@@ -90,22 +115,45 @@ public:
   static bool CreateReportChannel(int* server_fd, int* client_fd);
 
 private:
+  struct DumpRequest;
+
   // Run the server's event loop
   void Run();
 
   // Invoked when an child process (client) event occurs
   // Returning true => "keep running", false => "exit loop"
-  bool ClientEvent(short revents);
+  bool ClientEvent(unsigned int events);
 
   // Invoked when the controlling thread (main) event occurs
   // Returning true => "keep running", false => "exit loop"
-  bool ControlEvent(short revents);
+  bool ControlEvent(unsigned int events);
 
   // Return a unique filename at which a minidump can be written
   bool MakeMinidumpFilename(string& outFilename);
 
-  // Trampoline to |Run()|
+  // Adds |request| to the queue served by the dump workers.
+  void QueueDump(DumpRequest* request);
+
+  // Returns true if no more dump requests should be read for now.
+  bool DumpQueueFull();
+
+  // Enables or disables reading from the client channel in the event loop.
+  bool WatchClients(bool watch);
+
+  // Takes dump requests off the queue and serves them until the server
+  // stops and the queue is empty.
+  void WorkerLoop();
+
+  // Writes the dump for |request| and lets the client go.
+  void HandleDump(DumpRequest* request);
+
+  // Starts and stops the dump workers.
+  bool StartWorkers();
+  void StopWorkers();
+
+  // Trampolines to |Run()| and |WorkerLoop()|
   static void* ThreadMain(void* arg);
+  static void* WorkerMain(void* arg);
 
   int server_fd_;
 
@@ -117,13 +165,33 @@ private:
 
   bool generate_dumps_;
 
+  DumpAnalyzer* dump_analyzer_;
+
   string dump_dir_;
 
   bool started_;
 
   pthread_t thread_;
-  int control_pipe_in_;
-  int control_pipe_out_;
+
+  // The event loop's epoll instance, and eventfds signaled to stop the loop
+  // and when a worker finishes a dump.
+  int epoll_fd_;
+  int control_fd_;
+  int worker_done_fd_;
+
+  // Whether the event loop is reading from the client channel.
+  bool watching_clients_;
+
+  unsigned max_concurrent_dumps_;
+  std::vector<pthread_t> workers_;
+
+  // The following are guarded by queue_mutex_.
+  pthread_mutex_t queue_mutex_;
+  pthread_cond_t queue_cond_;
+  std::deque<DumpRequest*> pending_dumps_;
+  // The process ids of the clients with a dump queued or in progress.
+  std::set<pid_t> clients_dumping_;
+  bool stopping_;
 
   // disable these
   CrashGenerationServer(const CrashGenerationServer&);
@@ -0,0 +1,83 @@
+// Copyright (c) 2016, Google Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+// notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above
+// copyright notice, this list of conditions and the following disclaimer
+// in the documentation and/or other materials provided with the
+// distribution.
+//     * Neither the name of Google Inc. nor the names of its
+// contributors may be used to endorse or promote products derived from
+// this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+// dump_analyzer.h: DumpAnalyzer, which a CrashGenerationServer hands each
+// client minidump to once it is written, and DumpSignature, the summary
+// of the crash that it reports back.
+//
+// A host agent that uploads every minidump it receives sends the same
+// crash over and over when one is common.  With a signature in hand, it
+// can tell a duplicate from a new crash before uploading anything.  The
+// client library doesn't depend on the processor, so it doesn't analyze
+// dumps itself; CrashSignatureAnalyzer (src/processor) does the work with
+// the processor library, and a DumpAnalyzer can simply pass its results
+// on.
+
+#ifndef CLIENT_LINUX_CRASH_GENERATION_DUMP_ANALYZER_H_
+#define CLIENT_LINUX_CRASH_GENERATION_DUMP_ANALYZER_H_
+
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+
+#include "common/using_std_string.h"
+
+namespace google_breakpad {
+
+struct DumpSignature {
+  DumpSignature() : signature(0) {}
+
+  // A hash of the crash reason, the modules and the crashing thread's
+  // stack, the same for crashes at the same place in the same build.
+  // Never 0.
+  uint64_t signature;
+
+  // Why the process crashed, such as "SIGSEGV".
+  string crash_reason;
+
+  // Descriptions of the crashing thread's innermost frames, innermost
+  // first, such as "libfoo.so!Foo::Bar+0x1c".
+  std::vector<string> frames;
+};
+
+class DumpAnalyzer {
+ public:
+  virtual ~DumpAnalyzer() {}
+
+  // Examines the minidump at |dump_path| and fills in |signature|.
+  // Returns false if no signature could be had.  Called on the server's
+  // dump worker threads, on several at once if the server writes several
+  // dumps at a time.
+  virtual bool Analyze(const string& dump_path, DumpSignature* signature) = 0;
+};
+
+}  // namespace google_breakpad
+
+#endif  // CLIENT_LINUX_CRASH_GENERATION_DUMP_ANALYZER_H_
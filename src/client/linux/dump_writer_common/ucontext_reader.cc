@@ -48,6 +48,17 @@ uintptr_t UContextReader::GetInstructionPointer(const struct ucontext* uc) {
   return uc->uc_mcontext.gregs[REG_EIP];
 }
 
+size_t UContextReader::GetGeneralRegisters(
+    const struct ucontext* uc, uintptr_t regs[kMaxGeneralRegisters]) {
+  static const int kRegisters[] = {
+    REG_EAX, REG_EBX, REG_ECX, REG_EDX, REG_ESI, REG_EDI, REG_EBP
+  };
+  const size_t count = sizeof(kRegisters) / sizeof(kRegisters[0]);
+  for (size_t i = 0; i < count; ++i)
+    regs[i] = uc->uc_mcontext.gregs[kRegisters[i]];
+  return count;
+}
+
 void UContextReader::FillCPUContext(RawContextCPU *out, const ucontext *uc,
                                     const struct _libc_fpstate* fp) {
   const greg_t* regs = uc->uc_mcontext.gregs;
@@ -96,6 +107,18 @@ uintptr_t UContextReader::GetInstructionPointer(const struct ucontext* uc) {
   return uc->uc_mcontext.gregs[REG_RIP];
 }
 
+size_t UContextReader::GetGeneralRegisters(
+    const struct ucontext* uc, uintptr_t regs[kMaxGeneralRegisters]) {
+  static const int kRegisters[] = {
+    REG_RAX, REG_RBX, REG_RCX, REG_RDX, REG_RSI, REG_RDI, REG_RBP,
+    REG_R8, REG_R9, REG_R10, REG_R11, REG_R12, REG_R13, REG_R14, REG_R15
+  };
+  const size_t count = sizeof(kRegisters) / sizeof(kRegisters[0]);
+  for (size_t i = 0; i < count; ++i)
+    regs[i] = uc->uc_mcontext.gregs[kRegisters[i]];
+  return count;
+}
+
 void UContextReader::FillCPUContext(RawContextCPU *out, const ucontext *uc,
                                     const struct _libc_fpstate* fpregs) {
   const greg_t* regs = uc->uc_mcontext.gregs;
@@ -153,6 +176,25 @@ uintptr_t UContextReader::GetInstructionPointer(const struct ucontext* uc) {
   return uc->uc_mcontext.arm_pc;
 }
 
+size_t UContextReader::GetGeneralRegisters(
+    const struct ucontext* uc, uintptr_t regs[kMaxGeneralRegisters]) {
+  regs[0] = uc->uc_mcontext.arm_r0;
+  regs[1] = uc->uc_mcontext.arm_r1;
+  regs[2] = uc->uc_mcontext.arm_r2;
+  regs[3] = uc->uc_mcontext.arm_r3;
+  regs[4] = uc->uc_mcontext.arm_r4;
+  regs[5] = uc->uc_mcontext.arm_r5;
+  regs[6] = uc->uc_mcontext.arm_r6;
+  regs[7] = uc->uc_mcontext.arm_r7;
+  regs[8] = uc->uc_mcontext.arm_r8;
+  regs[9] = uc->uc_mcontext.arm_r9;
+  regs[10] = uc->uc_mcontext.arm_r10;
+  regs[11] = uc->uc_mcontext.arm_fp;
+  regs[12] = uc->uc_mcontext.arm_ip;
+  regs[13] = uc->uc_mcontext.arm_lr;
+  return 14;
+}
+
 void UContextReader::FillCPUContext(RawContextCPU *out, const ucontext *uc) {
   out->context_flags = MD_CONTEXT_ARM_FULL;
 
@@ -192,6 +234,15 @@ uintptr_t UContextReader::GetInstructionPointer(const struct ucontext* uc) {
   return uc->uc_mcontext.pc;
 }
 
+size_t UContextReader::GetGeneralRegisters(
+    const struct ucontext* uc, uintptr_t regs[kMaxGeneralRegisters]) {
+  // x0 to x30; x30 is the link register.
+  const size_t count = MD_CONTEXT_ARM64_REG_SP;
+  for (size_t i = 0; i < count; ++i)
+    regs[i] = uc->uc_mcontext.regs[i];
+  return count;
+}
+
 void UContextReader::FillCPUContext(RawContextCPU *out, const ucontext *uc,
                                     const struct fpsimd_context* fpregs) {
   out->context_flags = MD_CONTEXT_ARM64_FULL;
@@ -218,6 +269,16 @@ uintptr_t UContextReader::GetInstructionPointer(const struct ucontext* uc) {
   return uc->uc_mcontext.pc;
 }
 
+size_t UContextReader::GetGeneralRegisters(
+    const struct ucontext* uc, uintptr_t regs[kMaxGeneralRegisters]) {
+  size_t count = 0;
+  for (int i = 0; i < MD_CONTEXT_MIPS_GPR_COUNT; ++i) {
+    if (i != MD_CONTEXT_MIPS_REG_SP)
+      regs[count++] = uc->uc_mcontext.gregs[i];
+  }
+  return count;
+}
+
 void UContextReader::FillCPUContext(RawContextCPU *out, const ucontext *uc) {
   out->context_flags = MD_CONTEXT_MIPS_FULL;
 
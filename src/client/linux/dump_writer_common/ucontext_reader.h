@@ -45,6 +45,14 @@ struct UContextReader {
 
   static uintptr_t GetInstructionPointer(const struct ucontext* uc);
 
+  // The most general purpose registers GetGeneralRegisters() returns.
+  static const size_t kMaxGeneralRegisters = 32;
+
+  // Copies the general purpose registers, other than the stack pointer and
+  // the instruction pointer, to |regs| and returns how many were copied.
+  static size_t GetGeneralRegisters(const struct ucontext* uc,
+                                    uintptr_t regs[kMaxGeneralRegisters]);
+
   // Juggle a arch-specific ucontext into a minidump format
   //   out: the minidump structure
   //   info: the collection of register structures.
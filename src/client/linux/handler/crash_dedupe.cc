@@ -0,0 +1,263 @@
+// Copyright (c) 2016 Google Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+// notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above
+// copyright notice, this list of conditions and the following disclaimer
+// in the documentation and/or other materials provided with the
+// distribution.
+//     * Neither the name of Google Inc. nor the names of its
+// contributors may be used to endorse or promote products derived from
+// this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "client/linux/handler/crash_dedupe.h"
+
+#include <fcntl.h>
+#include <time.h>
+
+#include "client/linux/dump_writer_common/ucontext_reader.h"
+#include "client/linux/minidump_writer/line_reader.h"
+#include "common/linux/linux_libc_support.h"
+#include "common/memory.h"
+#include "third_party/lss/linux_syscall_support.h"
+
+namespace google_breakpad {
+
+namespace {
+
+// A mapping of the calling process, with its file named by a hash of the
+// path, or 0 for anonymous mappings.
+struct Mapping {
+  uintptr_t start;
+  uintptr_t end;
+  uintptr_t offset;
+  uint64_t name_hash;
+  bool readable;
+  bool executable;
+};
+
+const uint64_t kFNVOffsetBasis = 14695981039346656037ULL;
+const uint64_t kFNVPrime = 1099511628211ULL;
+
+uint64_t HashBytes(uint64_t hash, const void* data, size_t size) {
+  const uint8_t* bytes = reinterpret_cast<const uint8_t*>(data);
+  for (size_t i = 0; i < size; ++i) {
+    hash ^= bytes[i];
+    hash *= kFNVPrime;
+  }
+  return hash;
+}
+
+uint64_t HashValue(uint64_t hash, uint64_t value) {
+  return HashBytes(hash, &value, sizeof(value));
+}
+
+// Reads the mappings of the calling process into |mappings|. Returns false
+// if /proc/self/maps can't be read.
+bool ReadMappings(PageAllocator* allocator,
+                  wasteful_vector<Mapping>* mappings) {
+  const int fd = sys_open("/proc/self/maps", O_RDONLY, 0);
+  if (fd < 0)
+    return false;
+  LineReader* const line_reader = new(*allocator) LineReader(fd);
+  const char* line;
+  unsigned line_len;
+  while (line_reader->GetNextLine(&line, &line_len)) {
+    // 7f0b97b6f000-7f0b97b70000 r-xp 00000000 08:01 1234 /lib/libfoo.so
+    Mapping mapping;
+    const char* i = my_read_hex_ptr(&mapping.start, line);
+    if (*i == '-')
+      i = my_read_hex_ptr(&mapping.end, i + 1);
+    if (*i == ' ' && my_strlen(i) >= 6) {
+      mapping.readable = i[1] == 'r';
+      mapping.executable = i[3] == 'x';
+      i = my_read_hex_ptr(&mapping.offset, i + 6);
+      if (*i == ' ') {
+        const char* name = my_strchr(i, '/');
+        mapping.name_hash =
+            name ? HashBytes(kFNVOffsetBasis, name, my_strlen(name)) : 0;
+        mappings->push_back(mapping);
+      }
+    }
+    line_reader->PopLine(line_len);
+  }
+  sys_close(fd);
+  return true;
+}
+
+const Mapping* FindMapping(const wasteful_vector<Mapping>& mappings,
+                           uintptr_t address) {
+  for (size_t i = 0; i < mappings.size(); ++i) {
+    if (address >= mappings[i].start && address < mappings[i].end)
+      return &mappings[i];
+  }
+  return NULL;
+}
+
+// Fills |frames| with up to |max_frames| return addresses found by
+// following the frame pointer chain from |fp|, and returns their number.
+// Only frames that lie in the stack mapping of |sp|, above |sp|, are read,
+// so that a broken chain can't fault; the walk stops at the first frame
+// that doesn't, or whose return address is not in executable code.
+size_t WalkFramePointers(const wasteful_vector<Mapping>& mappings,
+                         uintptr_t sp, uintptr_t fp,
+                         uintptr_t* frames, size_t max_frames) {
+  const Mapping* stack = FindMapping(mappings, sp);
+  if (!stack || !stack->readable)
+    return 0;
+  size_t count = 0;
+  while (count < max_frames &&
+         fp >= sp && fp % sizeof(uintptr_t) == 0 &&
+         fp < stack->end - 2 * sizeof(uintptr_t)) {
+    const uintptr_t* frame = reinterpret_cast<const uintptr_t*>(fp);
+    const uintptr_t return_address = frame[1];
+    const Mapping* code = FindMapping(mappings, return_address);
+    if (!code || !code->executable)
+      break;
+    frames[count++] = return_address;
+    // Frames are pushed downwards, so the caller's frame must be higher.
+    if (frame[0] <= fp)
+      break;
+    fp = frame[0];
+  }
+  return count;
+}
+
+uintptr_t GetFramePointer(const struct ucontext* uc) {
+#if defined(__i386__)
+  return uc->uc_mcontext.gregs[REG_EBP];
+#elif defined(__x86_64__)
+  return uc->uc_mcontext.gregs[REG_RBP];
+#elif defined(__aarch64__)
+  return uc->uc_mcontext.regs[29];
+#else
+  return 0;
+#endif
+}
+
+}  // namespace
+
+CrashDedupe::CrashDedupe(const string& path, uint32_t window_seconds)
+    : path_(path),
+      window_seconds_(window_seconds),
+      last_crash_count_(0) {
+}
+
+// This function runs in a compromised context: see the top of
+// exception_handler.cc.
+bool CrashDedupe::IsRepeatedCrash(int signal, const struct ucontext* context) {
+  last_crash_count_ = 0;
+  const uint64_t signature = ComputeSignature(
+      signal,
+      UContextReader::GetInstructionPointer(context),
+      UContextReader::GetStackPointer(context),
+      GetFramePointer(context));
+  struct kernel_timespec now;
+  if (sys_clock_gettime(CLOCK_REALTIME, &now) != 0)
+    return false;
+  return RecordCrash(signature, now.tv_sec, &last_crash_count_);
+}
+
+// static
+uint64_t CrashDedupe::ComputeSignature(int signal, uintptr_t pc, uintptr_t sp,
+                                       uintptr_t fp) {
+  PageAllocator allocator;
+  wasteful_vector<Mapping> mappings(&allocator, 256);
+  ReadMappings(&allocator, &mappings);
+
+  uintptr_t addresses[1 + kCrashDedupeFrames];
+  addresses[0] = pc;
+  size_t address_count = 1;
+  if (fp) {
+    address_count += WalkFramePointers(mappings, sp, fp, addresses + 1,
+                                       kCrashDedupeFrames);
+  }
+
+  uint64_t hash = HashValue(kFNVOffsetBasis, signal);
+  for (size_t i = 0; i < address_count; ++i) {
+    // Code outside of any file is hashed by its presence only, as its
+    // address changes from one run to the next.
+    const Mapping* mapping = FindMapping(mappings, addresses[i]);
+    if (mapping && mapping->name_hash) {
+      hash = HashValue(hash, mapping->name_hash);
+      hash = HashValue(hash, addresses[i] - mapping->start + mapping->offset);
+    } else {
+      hash = HashValue(hash, 0);
+    }
+  }
+  return hash ? hash : 1;
+}
+
+// This function runs in a compromised context: see the top of
+// exception_handler.cc.
+bool CrashDedupe::RecordCrash(uint64_t signature, uint64_t now,
+                              uint32_t* count) {
+  *count = 0;
+  const int fd = sys_open(path_.c_str(), O_RDWR | O_CREAT, 0600);
+  if (fd < 0)
+    return false;
+
+  struct {
+    CrashDedupeHeader header;
+    CrashDedupeEntry entries[kCrashDedupeEntries];
+  } file;
+  // A file that is new, or not one of ours, starts out empty.
+  if (sys_read(fd, &file, sizeof(file)) != sizeof(file) ||
+      file.header.magic != kCrashDedupeMagic ||
+      file.header.next >= kCrashDedupeEntries) {
+    my_memset(&file, 0, sizeof(file));
+    file.header.magic = kCrashDedupeMagic;
+  }
+
+  bool repeated = false;
+  CrashDedupeEntry* entry = NULL;
+  for (size_t i = 0; i < kCrashDedupeEntries; ++i) {
+    if (file.entries[i].signature == signature) {
+      entry = &file.entries[i];
+      break;
+    }
+  }
+  if (entry) {
+    // A clock that went backwards can't tell how long ago it was.
+    repeated = now >= entry->last_time &&
+               now - entry->last_time <= window_seconds_;
+    if (entry->count < UINT32_MAX)
+      ++entry->count;
+  } else {
+    entry = &file.entries[file.header.next];
+    file.header.next = (file.header.next + 1) % kCrashDedupeEntries;
+    my_memset(entry, 0, sizeof(*entry));
+    entry->signature = signature;
+    entry->first_time = now;
+    entry->count = 1;
+  }
+  entry->last_time = now;
+
+  const bool written =
+      sys_lseek(fd, 0, SEEK_SET) == 0 &&
+      sys_write(fd, &file, sizeof(file)) == sizeof(file);
+  sys_close(fd);
+  if (!written)
+    return false;
+  *count = entry->count;
+  return repeated;
+}
+
+}  // namespace google_breakpad
@@ -0,0 +1,130 @@
+// Copyright (c) 2016 Google Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+// notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above
+// copyright notice, this list of conditions and the following disclaimer
+// in the documentation and/or other materials provided with the
+// distribution.
+//     * Neither the name of Google Inc. nor the names of its
+// contributors may be used to endorse or promote products derived from
+// this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+// crash_dedupe.h: Recognize a crash that repeats one seen shortly before,
+// so that a process stuck in a crash loop does not write and upload the
+// same large minidump on every restart.
+//
+// The signature of a crash hashes its signal with the module and offset
+// of the crash address and of the first return addresses found by
+// following the frame pointer chain on the crashing thread's stack.
+// Modules are named by their path in /proc/self/maps, and offsets are
+// relative to the start of the file, so the signature stays the same
+// from one restart to the next despite address space layout
+// randomization. Frame pointers are only followed on x86, x86-64 and
+// ARM64, and only within the stack mapping; on other CPUs the signature
+// holds only the crash address.
+//
+// Signatures are kept in a small file that the restarts of the process
+// share. It holds the last kCrashDedupeEntries signatures, with the time
+// each was first and last seen and how many times it was seen. The file
+// is updated without locking, so two processes crashing at the same time
+// may both write a minidump.
+
+#ifndef CLIENT_LINUX_HANDLER_CRASH_DEDUPE_H_
+#define CLIENT_LINUX_HANDLER_CRASH_DEDUPE_H_
+
+#include <stdint.h>
+#include <sys/ucontext.h>
+
+#include <string>
+
+#include "common/using_std_string.h"
+
+namespace google_breakpad {
+
+static const uint32_t kCrashDedupeMagic = 0x70646463;  // "cddp"
+static const size_t kCrashDedupeEntries = 16;
+// The most return addresses that go into a signature.
+static const size_t kCrashDedupeFrames = 8;
+
+// The layout of the file, which starts with a CrashDedupeHeader that is
+// followed by kCrashDedupeEntries CrashDedupeEntry records.
+struct CrashDedupeHeader {
+  uint32_t magic;  // kCrashDedupeMagic
+  uint32_t next;   // The entry that the next new signature replaces.
+};
+
+struct CrashDedupeEntry {
+  uint64_t signature;  // 0 if the entry is unused.
+  uint64_t first_time;  // Seconds since the epoch.
+  uint64_t last_time;
+  uint32_t count;
+  uint32_t reserved;
+};
+
+class CrashDedupe {
+ public:
+  // Keeps signatures in the file at |path|, which is created if it does
+  // not exist. A crash is a repeat if its signature was last seen at most
+  // |window_seconds| earlier.
+  CrashDedupe(const string& path, uint32_t window_seconds);
+
+  // Computes the signature of a crash of the calling process by |signal|
+  // in |context|, and records it with the current time. Returns true if
+  // the crash repeats one seen within the window. Does nothing and
+  // returns false if the file can't be used.
+  // This method runs in a compromised context: it only uses system calls
+  // and does not allocate from the heap.
+  bool IsRepeatedCrash(int signal, const struct ucontext* context);
+
+  // How many times the signature of the last crash passed to
+  // IsRepeatedCrash() has been seen, including that crash, or 0 if it
+  // wasn't recorded.
+  uint32_t last_crash_count() const { return last_crash_count_; }
+
+  // Computes the signature of a crash by |signal| at |pc|, with the stack
+  // pointer |sp| and frame pointer |fp|, using the mappings of the calling
+  // process. |fp| is 0 on CPUs whose frame pointers are not followed.
+  // Never returns 0. Runs in a compromised context.
+  static uint64_t ComputeSignature(int signal, uintptr_t pc, uintptr_t sp,
+                                   uintptr_t fp);
+
+  // Records a crash with |signature| at |now|, in seconds since the epoch,
+  // and sets |count| to the number of times it was seen. Returns true if
+  // it was last seen at most |window_seconds| earlier. Returns false, with
+  // |count| set to 0, if the file can't be used. Runs in a compromised
+  // context.
+  bool RecordCrash(uint64_t signature, uint64_t now, uint32_t* count);
+
+  const char* path() const { return path_.c_str(); }
+
+ private:
+  const string path_;
+  const uint32_t window_seconds_;
+  uint32_t last_crash_count_;
+
+  // Disallow copy constructor and assignment operator.
+  CrashDedupe(const CrashDedupe&);
+  void operator=(const CrashDedupe&);
+};
+
+}  // namespace google_breakpad
+
+#endif  // CLIENT_LINUX_HANDLER_CRASH_DEDUPE_H_
@@ -0,0 +1,159 @@
+// Copyright (c) 2016 Google Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+// notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above
+// copyright notice, this list of conditions and the following disclaimer
+// in the documentation and/or other materials provided with the
+// distribution.
+//     * Neither the name of Google Inc. nor the names of its
+// contributors may be used to endorse or promote products derived from
+// this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+// crash_dedupe_unittest.cc: Unit tests for google_breakpad::CrashDedupe.
+
+#include <fcntl.h>
+#include <signal.h>
+#include <stdint.h>
+#include <sys/ucontext.h>
+#include <ucontext.h>
+#include <unistd.h>
+
+#include <string>
+
+#include "breakpad_googletest_includes.h"
+#include "client/linux/handler/crash_dedupe.h"
+#include "common/tests/auto_tempdir.h"
+#include "common/using_std_string.h"
+
+using namespace google_breakpad;
+
+namespace {
+
+const uint32_t kWindow = 60;
+const uint64_t kNow = 1000000;
+
+// Captures the context of the same place every time it is called.
+void __attribute__((noinline)) GetContextHere(struct ucontext* context) {
+  getcontext(context);
+}
+
+class CrashDedupeTest : public testing::Test {
+ public:
+  void SetUp() {
+    path_ = temp_dir_.path() + "/crashes";
+  }
+
+  AutoTempDir temp_dir_;
+  string path_;
+};
+
+TEST_F(CrashDedupeTest, RepeatsWithinWindow) {
+  CrashDedupe dedupe(path_, kWindow);
+  uint32_t count;
+  EXPECT_FALSE(dedupe.RecordCrash(1, kNow, &count));
+  EXPECT_EQ(1U, count);
+  EXPECT_TRUE(dedupe.RecordCrash(1, kNow + kWindow, &count));
+  EXPECT_EQ(2U, count);
+  EXPECT_FALSE(dedupe.RecordCrash(2, kNow + kWindow, &count));
+  EXPECT_EQ(1U, count);
+
+  // The window starts again from the last time the crash was seen.
+  EXPECT_TRUE(dedupe.RecordCrash(1, kNow + 2 * kWindow, &count));
+  EXPECT_EQ(3U, count);
+  EXPECT_FALSE(dedupe.RecordCrash(1, kNow + 3 * kWindow + 1, &count));
+  EXPECT_EQ(4U, count);
+
+  // Nor is it a repeat if the clock went backwards.
+  EXPECT_FALSE(dedupe.RecordCrash(1, kNow, &count));
+  EXPECT_EQ(5U, count);
+
+  // Another process sees the same file.
+  CrashDedupe restarted(path_, kWindow);
+  EXPECT_TRUE(restarted.RecordCrash(2, kNow + 2 * kWindow, &count));
+  EXPECT_EQ(2U, count);
+}
+
+TEST_F(CrashDedupeTest, ForgetsOldestSignatures) {
+  CrashDedupe dedupe(path_, kWindow);
+  uint32_t count;
+  for (uint64_t signature = 1; signature <= kCrashDedupeEntries + 1;
+       ++signature) {
+    EXPECT_FALSE(dedupe.RecordCrash(signature, kNow, &count));
+  }
+  EXPECT_FALSE(dedupe.RecordCrash(1, kNow, &count));
+  EXPECT_EQ(1U, count);
+  EXPECT_TRUE(dedupe.RecordCrash(kCrashDedupeEntries + 1, kNow, &count));
+  EXPECT_EQ(2U, count);
+}
+
+TEST_F(CrashDedupeTest, ReplacesForeignFile) {
+  const int fd = open(path_.c_str(), O_WRONLY | O_CREAT, 0600);
+  ASSERT_GE(fd, 0);
+  char junk[1024];
+  memset(junk, 0x5a, sizeof(junk));
+  ASSERT_EQ(static_cast<ssize_t>(sizeof(junk)),
+            write(fd, junk, sizeof(junk)));
+  close(fd);
+
+  CrashDedupe dedupe(path_, kWindow);
+  uint32_t count;
+  EXPECT_FALSE(dedupe.RecordCrash(1, kNow, &count));
+  EXPECT_EQ(1U, count);
+  EXPECT_TRUE(dedupe.RecordCrash(1, kNow, &count));
+}
+
+TEST_F(CrashDedupeTest, UnusableFile) {
+  CrashDedupe dedupe(temp_dir_.path() + "/no/such/directory", kWindow);
+  uint32_t count;
+  EXPECT_FALSE(dedupe.RecordCrash(1, kNow, &count));
+  EXPECT_EQ(0U, count);
+}
+
+TEST_F(CrashDedupeTest, Signatures) {
+  const uintptr_t pc = reinterpret_cast<uintptr_t>(&GetContextHere);
+  const uint64_t signature = CrashDedupe::ComputeSignature(SIGSEGV, pc, 0, 0);
+  EXPECT_NE(0U, signature);
+  EXPECT_EQ(signature, CrashDedupe::ComputeSignature(SIGSEGV, pc, 0, 0));
+  EXPECT_NE(signature, CrashDedupe::ComputeSignature(SIGABRT, pc, 0, 0));
+  EXPECT_NE(signature, CrashDedupe::ComputeSignature(SIGSEGV, pc + 1, 0, 0));
+
+  // Outside of any file, only the presence of the address counts.
+  EXPECT_EQ(CrashDedupe::ComputeSignature(SIGSEGV, 16, 0, 0),
+            CrashDedupe::ComputeSignature(SIGSEGV, 32, 0, 0));
+}
+
+TEST_F(CrashDedupeTest, RepeatedCrash) {
+  CrashDedupe dedupe(path_, kWindow);
+  // Both contexts are captured from the same call site, so that they
+  // have the same callers.
+  for (uint32_t i = 1; i <= 2; ++i) {
+    struct ucontext context;
+    GetContextHere(&context);
+    EXPECT_EQ(i > 1, dedupe.IsRepeatedCrash(SIGSEGV, &context));
+    EXPECT_EQ(i, dedupe.last_crash_count());
+  }
+  struct ucontext context;
+  GetContextHere(&context);
+  EXPECT_FALSE(dedupe.IsRepeatedCrash(SIGABRT, &context));
+  EXPECT_EQ(1U, dedupe.last_crash_count());
+}
+
+}  // namespace
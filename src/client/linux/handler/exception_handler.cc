@@ -55,6 +55,9 @@
 //                                            V
 //                                         sys_exit
 //
+// When StartDumpHelper() has been called, HandleSignal instead sends the crash
+// context to a helper process forked ahead of time and waits for it to write
+// the minidump (GenerateDumpWithHelper and RunDumpHelper).
 
 // This code is a little fragmented. Different functions of the ExceptionHandler
 // class run in a number of different contexts. Some of them run in a normal
@@ -68,12 +71,14 @@
 #include <errno.h>
 #include <fcntl.h>
 #include <linux/limits.h>
+#include <poll.h>
 #include <pthread.h>
 #include <sched.h>
 #include <signal.h>
 #include <stdio.h>
 #include <sys/mman.h>
 #include <sys/prctl.h>
+#include <sys/socket.h>
 #include <sys/syscall.h>
 #include <sys/wait.h>
 #include <unistd.h>
@@ -90,6 +95,8 @@
 #include "common/basictypes.h"
 #include "common/linux/linux_libc_support.h"
 #include "common/memory.h"
+#include "common/probes.h"
+#include "client/linux/handler/minidump_handoff.h"
 #include "client/linux/log/log.h"
 #include "client/linux/microdump_writer/microdump_writer.h"
 #include "client/linux/minidump_writer/linux_dumper.h"
@@ -194,6 +201,15 @@ void RestoreAlternateStackLocked() {
 std::vector<ExceptionHandler*>* g_handler_stack_ = NULL;
 pthread_mutex_t g_handler_stack_mutex_ = PTHREAD_MUTEX_INITIALIZER;
 
+// The time of CLOCK_MONOTONIC in nanoseconds, or 0 if it can't be read.
+// This function runs in a compromised context: see the top of the file.
+uint64_t MonotonicNanoseconds() {
+  struct kernel_timespec now;
+  if (sys_clock_gettime(CLOCK_MONOTONIC, &now) != 0)
+    return 0;
+  return static_cast<uint64_t>(now.tv_sec) * 1000000000 + now.tv_nsec;
+}
+
 }  // namespace
 
 // Runs before crashing: normal context.
@@ -207,13 +223,22 @@ ExceptionHandler::ExceptionHandler(const MinidumpDescriptor& descriptor,
       callback_(callback),
       callback_context_(callback_context),
       minidump_descriptor_(descriptor),
-      crash_handler_(NULL) {
+      crash_handler_(NULL),
+      dump_helper_pid_(-1),
+      dump_helper_fd_(-1),
+      module_identifier_cache_(NULL),
+      crash_annotations_(NULL),
+      crash_dedupe_(NULL),
+      snapshot_series_(NULL),
+      writing_snapshot_(false) {
   if (server_fd >= 0)
     crash_generation_client_.reset(CrashGenerationClient::TryCreate(server_fd));
 
   if (!IsOutOfProcess() && !minidump_descriptor_.IsFD() &&
       !minidump_descriptor_.IsMicrodumpOnConsole())
     minidump_descriptor_.UpdatePath();
+  if (!IsOutOfProcess() && minidump_descriptor_.IsMemory())
+    minidump_descriptor_.CreateMemoryFile();
 
   pthread_mutex_lock(&g_handler_stack_mutex_);
   if (!g_handler_stack_)
@@ -228,6 +253,11 @@ ExceptionHandler::ExceptionHandler(const MinidumpDescriptor& descriptor,
 
 // Runs before crashing: normal context.
 ExceptionHandler::~ExceptionHandler() {
+  StopDumpHelper();
+  StopSnapshotSeries();
+  if (minidump_descriptor_.IsMemory())
+    minidump_descriptor_.CloseMemoryFile();
+
   pthread_mutex_lock(&g_handler_stack_mutex_);
   std::vector<ExceptionHandler*>::iterator handler =
       std::find(g_handler_stack_->begin(), g_handler_stack_->end(), this);
@@ -373,6 +403,27 @@ struct ThreadArgument {
   size_t context_size;
 };
 
+// A request to write a minidump, sent to the dump helper process.  It is
+// followed by |app_memory_count| AppMemory and |mapping_count| MappingEntry
+// records.  The minidump is written to |path| or, if that is empty, to the
+// file descriptor sent along with the request.
+struct DumpHelperRequest {
+  ExceptionHandler::CrashContext context;
+  char path[PATH_MAX];
+  off_t size_limit;
+  bool size_limit_budgeted;
+  bool compressed;
+  unsigned int identifier_helpers;
+  // The crashing process's CrashAnnotations, or NULL.
+  const CrashAnnotations* annotations;
+  uint32_t app_memory_count;
+  uint32_t mapping_count;
+};
+
+// The largest request the crash path sends to the dump helper.  Mappings,
+// then application memory regions, that don't fit are left out.
+const size_t kDumpHelperMaxRequestSize = 64 * 1024;
+
 // This is the entry function for the cloned process. We are in a compromised
 // context here: see the top of the file.
 // static
@@ -390,6 +441,8 @@ int ExceptionHandler::ThreadEntry(void *arg) {
 // This function runs in a compromised context: see the top of the file.
 // Runs on the crashing thread.
 bool ExceptionHandler::HandleSignal(int sig, siginfo_t* info, void* uc) {
+  const uint64_t handler_start_ns = MonotonicNanoseconds();
+  BREAKPAD_PROBE2(handler__signal, sig, info->si_code);
   if (filter_ && !filter_(callback_context_))
     return false;
 
@@ -405,6 +458,7 @@ bool ExceptionHandler::HandleSignal(int sig, siginfo_t* info, void* uc) {
   memset(&context, 0, sizeof(context));
   memcpy(&context.siginfo, info, sizeof(siginfo_t));
   memcpy(&context.context, uc, sizeof(struct ucontext));
+  context.handler_start_ns = handler_start_ns;
 #if defined(__aarch64__)
   struct ucontext *uc_ptr = (struct ucontext*)uc;
   struct fpsimd_context *fp_ptr =
@@ -429,6 +483,15 @@ bool ExceptionHandler::HandleSignal(int sig, siginfo_t* info, void* uc) {
       return true;
     }
   }
+  if (crash_dedupe_ && crash_dedupe_->IsRepeatedCrash(sig, &context.context)) {
+    static const char msg[] = "ExceptionHandler::HandleSignal skipped the "
+                              "minidump of a repeated crash\n";
+    logger::write(msg, sizeof(msg) - 1);
+    BREAKPAD_PROBE1(handler__dump__skipped, sig);
+    if (callback_)
+      return callback_(minidump_descriptor_, callback_context_, false);
+    return false;
+  }
   return GenerateDump(&context);
 }
 
@@ -447,8 +510,26 @@ bool ExceptionHandler::SimulateSignalDelivery(int sig) {
 
 // This function may run in a compromised context: see the top of the file.
 bool ExceptionHandler::GenerateDump(CrashContext *context) {
-  if (IsOutOfProcess())
-    return crash_generation_client_->RequestDump(context, sizeof(*context));
+  BREAKPAD_PROBE1(handler__dump__start, IsOutOfProcess());
+  if (IsOutOfProcess()) {
+    bool requested = crash_generation_client_->RequestDump(context,
+                                                           sizeof(*context));
+    BREAKPAD_PROBE1(handler__dump__done, requested);
+    return requested;
+  }
+
+  bool success;
+  if (dump_helper_fd_ >= 0 && !minidump_descriptor_.IsMicrodumpOnConsole() &&
+      GenerateDumpWithHelper(context, &success)) {
+    BREAKPAD_PROBE1(handler__dump__done, success);
+    if (success)
+      HandOffMinidump();
+    if (callback_) {
+      success = callback_(minidump_descriptor_, callback_context_, success);
+      BREAKPAD_PROBE1(handler__callback__done, success);
+    }
+    return success;
+  }
 
   // Allocating too much stack isn't a problem, and better to err on the side
   // of caution than smash it into random locations.
@@ -511,12 +592,147 @@ bool ExceptionHandler::GenerateDump(CrashContext *context) {
     logger::write("\n", 1);
   }
 
-  bool success = r != -1 && WIFEXITED(status) && WEXITSTATUS(status) == 0;
-  if (callback_)
+  success = r != -1 && WIFEXITED(status) && WEXITSTATUS(status) == 0;
+  BREAKPAD_PROBE1(handler__dump__done, success);
+  if (success)
+    HandOffMinidump();
+  if (callback_) {
     success = callback_(minidump_descriptor_, callback_context_, success);
+    BREAKPAD_PROBE1(handler__callback__done, success);
+  }
   return success;
 }
 
+// This function runs in a compromised context: see the top of the file.
+// Runs on the crashing thread.  Returns false if the dump helper couldn't be
+// reached, in which case the dump should be written some other way.
+// Otherwise sets |succeeded| to whether the helper wrote the minidump.
+bool ExceptionHandler::GenerateDumpWithHelper(CrashContext *context,
+                                              bool* succeeded) {
+  size_t app_memory_count = 0;
+  for (AppMemoryList::const_iterator iter = app_memory_list_.begin();
+       iter != app_memory_list_.end(); ++iter) {
+    ++app_memory_count;
+  }
+  size_t mapping_count = 0;
+  for (MappingList::const_iterator iter = mapping_list_.begin();
+       iter != mapping_list_.end(); ++iter) {
+    ++mapping_count;
+  }
+  static const size_t kMaxRecords =
+      kDumpHelperMaxRequestSize - sizeof(DumpHelperRequest);
+  if (app_memory_count * sizeof(AppMemory) > kMaxRecords)
+    app_memory_count = kMaxRecords / sizeof(AppMemory);
+  const size_t mapping_space =
+      kMaxRecords - app_memory_count * sizeof(AppMemory);
+  if (mapping_count * sizeof(MappingEntry) > mapping_space)
+    mapping_count = mapping_space / sizeof(MappingEntry);
+
+  const size_t request_size = sizeof(DumpHelperRequest) +
+      app_memory_count * sizeof(AppMemory) +
+      mapping_count * sizeof(MappingEntry);
+  PageAllocator allocator;
+  uint8_t* buffer = reinterpret_cast<uint8_t*>(allocator.Alloc(request_size));
+  if (!buffer)
+    return false;
+  my_memset(buffer, 0, request_size);
+
+  DumpHelperRequest* request = reinterpret_cast<DumpHelperRequest*>(buffer);
+  my_memcpy(&request->context, context, sizeof(*context));
+  if (!minidump_descriptor_.IsFD()) {
+    my_strlcpy(request->path, minidump_descriptor_.path(),
+               sizeof(request->path));
+  }
+  request->size_limit = minidump_descriptor_.size_limit();
+  request->size_limit_budgeted = minidump_descriptor_.size_limit_budgeted();
+  request->compressed = minidump_descriptor_.compressed();
+  request->identifier_helpers = minidump_descriptor_.identifier_helpers();
+  request->annotations = crash_annotations_;
+  request->app_memory_count = app_memory_count;
+  request->mapping_count = mapping_count;
+
+  AppMemory* app_memory =
+      reinterpret_cast<AppMemory*>(buffer + sizeof(DumpHelperRequest));
+  AppMemoryList::const_iterator app_memory_iter = app_memory_list_.begin();
+  for (size_t i = 0; i < app_memory_count; ++i, ++app_memory_iter)
+    my_memcpy(&app_memory[i], &*app_memory_iter, sizeof(AppMemory));
+  MappingEntry* mappings =
+      reinterpret_cast<MappingEntry*>(app_memory + app_memory_count);
+  MappingList::const_iterator mapping_iter = mapping_list_.begin();
+  for (size_t i = 0; i < mapping_count; ++i, ++mapping_iter)
+    my_memcpy(&mappings[i], &*mapping_iter, sizeof(MappingEntry));
+
+  // The helper writes the result of the dump to this pipe and closes it.
+  int result_fds[2];
+  if (sys_pipe(result_fds) < 0)
+    return false;
+
+  const unsigned fd_count = minidump_descriptor_.IsFD() ? 2 : 1;
+  struct kernel_iovec iov;
+  iov.iov_base = buffer;
+  iov.iov_len = request_size;
+
+  struct kernel_msghdr msg = { 0 };
+  msg.msg_iov = &iov;
+  msg.msg_iovlen = 1;
+  char cmsg[CMSG_SPACE(2 * sizeof(int))];
+  my_memset(cmsg, 0, sizeof(cmsg));
+  msg.msg_control = cmsg;
+  msg.msg_controllen = CMSG_SPACE(fd_count * sizeof(int));
+
+  struct cmsghdr* hdr = CMSG_FIRSTHDR(&msg);
+  hdr->cmsg_level = SOL_SOCKET;
+  hdr->cmsg_type = SCM_RIGHTS;
+  hdr->cmsg_len = CMSG_LEN(fd_count * sizeof(int));
+  int* fds = reinterpret_cast<int*>(CMSG_DATA(hdr));
+  fds[0] = result_fds[1];
+  if (minidump_descriptor_.IsFD())
+    fds[1] = minidump_descriptor_.fd();
+
+  // Allow the helper to ptrace us.
+  sys_prctl(PR_SET_PTRACER, dump_helper_pid_, 0, 0, 0);
+
+  const ssize_t sent = HANDLE_EINTR(sys_sendmsg(dump_helper_fd_, &msg, 0));
+  sys_close(result_fds[1]);
+  if (sent != static_cast<ssize_t>(request_size)) {
+    sys_close(result_fds[0]);
+    static const char send_msg[] = "ExceptionHandler::GenerateDumpWithHelper "
+        "sys_sendmsg failed\n";
+    logger::write(send_msg, sizeof(send_msg) - 1);
+    return false;
+  }
+
+  char result;
+  const ssize_t r = HANDLE_EINTR(sys_read(result_fds[0], &result, 1));
+  sys_close(result_fds[0]);
+  if (r != 1) {
+    // The helper went away without answering.
+    static const char result_msg[] = "ExceptionHandler::GenerateDumpWithHelper "
+        "got no result from the dump helper\n";
+    logger::write(result_msg, sizeof(result_msg) - 1);
+    return false;
+  }
+  *succeeded = result != 0;
+  return true;
+}
+
+// This function runs in a compromised context: see the top of the file.
+void ExceptionHandler::HandOffMinidump() {
+  const int socket = minidump_descriptor_.handoff_socket();
+  if (!minidump_descriptor_.IsMemory() || socket < 0)
+    return;
+
+  // The in-memory file was empty before the dump, so its size is that of
+  // the minidump.
+  const int fd = minidump_descriptor_.fd();
+  const off_t size = sys_lseek(fd, 0, SEEK_END);
+  if (size <= 0 || !SendMinidumpHandoff(socket, fd, size)) {
+    static const char msg[] = "ExceptionHandler::HandOffMinidump "
+                              "could not hand off the minidump\n";
+    logger::write(msg, sizeof(msg) - 1);
+  }
+}
+
 // This function runs in a compromised context: see the top of the file.
 void ExceptionHandler::SendContinueSignalToChild() {
   static const char okToContinueMessage = 'a';
@@ -551,27 +767,51 @@ void ExceptionHandler::WaitForContinueSignal() {
 bool ExceptionHandler::DoDump(pid_t crashing_process, const void* context,
                               size_t context_size) {
   if (minidump_descriptor_.IsMicrodumpOnConsole()) {
-    return google_breakpad::WriteMicrodump(crashing_process,
-                                           context,
-                                           context_size,
-                                           mapping_list_);
+    return google_breakpad::WriteMicrodump(
+        crashing_process, context, context_size, mapping_list_,
+        minidump_descriptor_.microdump_compact(),
+        minidump_descriptor_.microdump_ring());
   }
+  const MinidumpSizeLimitPolicy size_limit_policy =
+      minidump_descriptor_.size_limit_budgeted() ?
+          kSizeLimitBudgeted : kSizeLimitTruncateExtraThreads;
+  const unsigned int identifier_helpers =
+      minidump_descriptor_.identifier_helpers();
+  MinidumpSnapshotSeries* snapshot_series =
+      writing_snapshot_ ? snapshot_series_ : NULL;
+  // Snapshots are rebuilt from their images, which must be uncompressed.
+  const bool compressed =
+      minidump_descriptor_.compressed() && !snapshot_series;
   if (minidump_descriptor_.IsFD()) {
     return google_breakpad::WriteMinidump(minidump_descriptor_.fd(),
                                           minidump_descriptor_.size_limit(),
+                                          size_limit_policy,
+                                          compressed,
                                           crashing_process,
                                           context,
                                           context_size,
                                           mapping_list_,
-                                          app_memory_list_);
+                                          app_memory_list_,
+                                          module_identifier_cache_,
+                                          crash_annotations_,
+                                          identifier_helpers,
+                                          snapshot_series,
+                                          NULL);
   }
   return google_breakpad::WriteMinidump(minidump_descriptor_.path(),
                                         minidump_descriptor_.size_limit(),
+                                        size_limit_policy,
+                                        compressed,
                                         crashing_process,
                                         context,
                                         context_size,
                                         mapping_list_,
-                                        app_memory_list_);
+                                        app_memory_list_,
+                                        module_identifier_cache_,
+                                        crash_annotations_,
+                                        identifier_helpers,
+                                        snapshot_series,
+                                        NULL);
 }
 
 // static
@@ -598,6 +838,12 @@ bool ExceptionHandler::WriteMinidump() {
     // generation happens, as clients may want to access the MinidumpDescriptor
     // after this call to find the exact path to the minidump file.
     minidump_descriptor_.UpdatePath();
+  } else if (minidump_descriptor_.IsMemory()) {
+    // The previous minidump may have been handed off, and belongs to the
+    // receiver now. Start a new in-memory file.
+    minidump_descriptor_.CloseMemoryFile();
+    if (!minidump_descriptor_.CreateMemoryFile())
+      return false;
   } else if (minidump_descriptor_.IsFD()) {
     // Reposition the FD to its beginning and resize it to get rid of the
     // previous minidump info.
@@ -609,6 +855,7 @@ bool ExceptionHandler::WriteMinidump() {
   sys_prctl(PR_SET_DUMPABLE, 1, 0, 0, 0);
 
   CrashContext context;
+  context.handler_start_ns = MonotonicNanoseconds();
   int getcontext_result = getcontext(&context.context);
   if (getcontext_result)
     return false;
@@ -664,7 +911,183 @@ bool ExceptionHandler::WriteMinidump() {
 #error "This code has not been ported to your platform yet."
 #endif
 
-  return GenerateDump(&context);
+  writing_snapshot_ = snapshot_series_ != NULL;
+  bool success = GenerateDump(&context);
+  writing_snapshot_ = false;
+  return success;
+}
+
+// Runs before crashing: normal context.
+bool ExceptionHandler::StartSnapshotSeries() {
+  if (snapshot_series_)
+    return true;
+  if (IsOutOfProcess())
+    return false;
+
+  // The dump is written by a process cloned without CLONE_VM, which must
+  // be able to update the series.
+  void* page = mmap(NULL, sizeof(*snapshot_series_), PROT_READ | PROT_WRITE,
+                    MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+  if (page == MAP_FAILED)
+    return false;
+  snapshot_series_ = static_cast<MinidumpSnapshotSeries*>(page);
+  return true;
+}
+
+// Runs before crashing: normal context.
+void ExceptionHandler::StopSnapshotSeries() {
+  if (!snapshot_series_)
+    return;
+  munmap(snapshot_series_, sizeof(*snapshot_series_));
+  snapshot_series_ = NULL;
+}
+
+bool ExceptionHandler::StartDumpHelper() {
+  if (dump_helper_fd_ >= 0)
+    return true;
+  if (IsOutOfProcess())
+    return false;
+
+  int fds[2];
+  if (socketpair(AF_UNIX, SOCK_SEQPACKET, 0, fds))
+    return false;
+
+  const pid_t crashing_process = getpid();
+  const pid_t helper = fork();
+  if (helper == -1) {
+    close(fds[0]);
+    close(fds[1]);
+    return false;
+  }
+  if (helper == 0) {
+    close(fds[0]);
+    RunDumpHelper(fds[1], crashing_process, module_identifier_cache_);
+    _exit(0);
+  }
+
+  close(fds[1]);
+  if (fcntl(fds[0], F_SETFD, FD_CLOEXEC)) {
+    close(fds[0]);
+    kill(helper, SIGKILL);
+    HANDLE_EINTR(waitpid(helper, NULL, 0));
+    return false;
+  }
+  dump_helper_pid_ = helper;
+  dump_helper_fd_ = fds[0];
+  return true;
+}
+
+// Runs before crashing: normal context.
+void ExceptionHandler::StopDumpHelper() {
+  if (dump_helper_fd_ < 0)
+    return;
+  close(dump_helper_fd_);
+  kill(dump_helper_pid_, SIGKILL);
+  HANDLE_EINTR(waitpid(dump_helper_pid_, NULL, 0));
+  dump_helper_fd_ = -1;
+  dump_helper_pid_ = -1;
+}
+
+// Runs in the dump helper process, which is healthy: normal context.
+// static
+void ExceptionHandler::RunDumpHelper(
+    int socket_fd, pid_t crashing_process,
+    const ModuleIdentifierCache* module_identifiers) {
+  // The handlers copied from the crashing process mustn't run here.
+  for (int i = 0; i < kNumHandledSignals; ++i)
+    signal(kExceptionSignals[i], SIG_DFL);
+
+  std::vector<uint8_t> buffer(kDumpHelperMaxRequestSize);
+  while (true) {
+    // Stop once the crashing process is gone, even if some other process it
+    // forked holds on to its end of the socket.
+    struct pollfd pfd;
+    memset(&pfd, 0, sizeof(pfd));
+    pfd.fd = socket_fd;
+    pfd.events = POLLIN;
+    const int ready = HANDLE_EINTR(poll(&pfd, 1, 1000));
+    if (ready < 0 || getppid() != crashing_process)
+      return;
+    if (ready == 0)
+      continue;
+
+    struct iovec iov;
+    iov.iov_base = &buffer[0];
+    iov.iov_len = buffer.size();
+    char control[CMSG_SPACE(2 * sizeof(int))];
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+
+    const ssize_t size = HANDLE_EINTR(recvmsg(socket_fd, &msg, 0));
+    if (size <= 0)
+      return;
+
+    int result_fd = -1;
+    int dump_fd = -1;
+    for (struct cmsghdr* hdr = CMSG_FIRSTHDR(&msg); hdr;
+         hdr = CMSG_NXTHDR(&msg, hdr)) {
+      if (hdr->cmsg_level != SOL_SOCKET || hdr->cmsg_type != SCM_RIGHTS)
+        continue;
+      const int* fds = reinterpret_cast<int*>(CMSG_DATA(hdr));
+      const size_t fd_count = (hdr->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+      if (fd_count > 0)
+        result_fd = fds[0];
+      if (fd_count > 1)
+        dump_fd = fds[1];
+    }
+
+    const DumpHelperRequest* request =
+        reinterpret_cast<const DumpHelperRequest*>(&buffer[0]);
+    bool succeeded = false;
+    if (result_fd >= 0 &&
+        static_cast<size_t>(size) >= sizeof(DumpHelperRequest) &&
+        static_cast<size_t>(size) ==
+            sizeof(DumpHelperRequest) +
+            request->app_memory_count * sizeof(AppMemory) +
+            request->mapping_count * sizeof(MappingEntry) &&
+        (dump_fd >= 0 || request->path[0] != '\0')) {
+      const AppMemory* app_memory = reinterpret_cast<const AppMemory*>(
+          &buffer[sizeof(DumpHelperRequest)]);
+      AppMemoryList app_memory_list(app_memory,
+                                    app_memory + request->app_memory_count);
+      const MappingEntry* mappings = reinterpret_cast<const MappingEntry*>(
+          app_memory + request->app_memory_count);
+      MappingList mapping_list(mappings, mappings + request->mapping_count);
+
+      const MinidumpSizeLimitPolicy size_limit_policy =
+          request->size_limit_budgeted ?
+              kSizeLimitBudgeted : kSizeLimitTruncateExtraThreads;
+      if (dump_fd >= 0) {
+        succeeded = google_breakpad::WriteMinidump(
+            dump_fd, request->size_limit, size_limit_policy,
+            request->compressed, crashing_process,
+            &request->context, sizeof(request->context),
+            mapping_list, app_memory_list, module_identifiers,
+            request->annotations, request->identifier_helpers, NULL);
+      } else {
+        char path[PATH_MAX];
+        my_strlcpy(path, request->path, sizeof(path));
+        succeeded = google_breakpad::WriteMinidump(
+            path, request->size_limit, size_limit_policy,
+            request->compressed, crashing_process,
+            &request->context, sizeof(request->context),
+            mapping_list, app_memory_list, module_identifiers,
+            request->annotations, request->identifier_helpers, NULL);
+      }
+    }
+
+    if (result_fd >= 0) {
+      const char result = succeeded;
+      ignore_result(HANDLE_EINTR(write(result_fd, &result, 1)));
+      close(result_fd);
+    }
+    if (dump_fd >= 0)
+      close(dump_fd);
+  }
 }
 
 void ExceptionHandler::AddMappingInfo(const string& name,
@@ -686,9 +1109,7 @@ void ExceptionHandler::AddMappingInfo(const string& name,
 }
 
 void ExceptionHandler::RegisterAppMemory(void* ptr, size_t length) {
-  AppMemoryList::iterator iter =
-    std::find(app_memory_list_.begin(), app_memory_list_.end(), ptr);
-  if (iter != app_memory_list_.end()) {
+  if (app_memory_index_.find(ptr) != app_memory_index_.end()) {
     // Don't allow registering the same pointer twice.
     return;
   }
@@ -696,14 +1117,15 @@ void ExceptionHandler::RegisterAppMemory(void* ptr, size_t length) {
   AppMemory app_memory;
   app_memory.ptr = ptr;
   app_memory.length = length;
-  app_memory_list_.push_back(app_memory);
+  app_memory_index_[ptr] =
+      app_memory_list_.insert(app_memory_list_.end(), app_memory);
 }
 
 void ExceptionHandler::UnregisterAppMemory(void* ptr) {
-  AppMemoryList::iterator iter =
-    std::find(app_memory_list_.begin(), app_memory_list_.end(), ptr);
-  if (iter != app_memory_list_.end()) {
-    app_memory_list_.erase(iter);
+  AppMemoryIndex::iterator iter = app_memory_index_.find(ptr);
+  if (iter != app_memory_index_.end()) {
+    app_memory_list_.erase(iter->second);
+    app_memory_index_.erase(iter);
   }
 }
 
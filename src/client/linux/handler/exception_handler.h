@@ -35,9 +35,11 @@
 #include <stdio.h>
 #include <sys/ucontext.h>
 
+#include <map>
 #include <string>
 
 #include "client/linux/crash_generation/crash_generation_client.h"
+#include "client/linux/handler/crash_dedupe.h"
 #include "client/linux/handler/minidump_descriptor.h"
 #include "client/linux/minidump_writer/minidump_writer.h"
 #include "common/scoped_ptr.h"
@@ -137,7 +139,12 @@ class ExceptionHandler {
   }
 
   void set_minidump_descriptor(const MinidumpDescriptor& descriptor) {
+    if (minidump_descriptor_.IsMemory() &&
+        minidump_descriptor_.fd() != descriptor.fd())
+      minidump_descriptor_.CloseMemoryFile();
     minidump_descriptor_ = descriptor;
+    if (minidump_descriptor_.IsMemory() && minidump_descriptor_.fd() == -1)
+      minidump_descriptor_.CreateMemoryFile();
   }
 
   void set_crash_handler(HandlerCallback callback) {
@@ -159,6 +166,10 @@ class ExceptionHandler {
   // If the ExceptionHandler has been created with a file descriptor, the file
   // descriptor is repositioned to its beginning and the previous generated
   // minidump is overwritten.
+  // If the ExceptionHandler has been created with an in-memory descriptor, a
+  // new in-memory file is created for each minidump, and the previous one is
+  // closed. A minidump that was not handed off must be read, or its file
+  // descriptor duplicated, before the next call.
   // Note that this method is not supposed to be called from a compromised
   // context as it uses the heap.
   bool WriteMinidump();
@@ -198,6 +209,9 @@ class ExceptionHandler {
     // ucontext so 'float_state' is not required.
     fpstate_t float_state;
 #endif
+    // When the handler was entered, in nanoseconds of CLOCK_MONOTONIC, or
+    // 0.  The minidump writer times the handler from here.
+    uint64_t handler_start_ns;
   };
 
   // Returns whether out-of-process dump generation is used or not.
@@ -221,6 +235,63 @@ class ExceptionHandler {
   // Unregister a block of memory that was registered with RegisterAppMemory.
   void UnregisterAppMemory(void* ptr);
 
+  // Starts a helper process that writes this handler's minidumps from then
+  // on.  The crash path then only sends the helper the crash context over a
+  // socket opened here, rather than cloning a process to write the dump at
+  // crash time.  The helper is forked from the calling process and keeps a
+  // copy-on-write snapshot of it, so this is best called early, before the
+  // process grows.  Microdumps, and dumps when the helper has gone away,
+  // are still written from a cloned process; out-of-process dumps aren't
+  // affected.  Returns true if the helper is running.
+  // Not to be called from a compromised context as it uses the heap.
+  bool StartDumpHelper();
+
+  // Makes dumps of this process use the module identifiers precomputed by
+  // |cache|, rather than reading each module's file at crash time.  The
+  // cache is not owned and must outlive the handler; it is up to the caller
+  // to keep it updated as modules are loaded.  A dump helper started by
+  // StartDumpHelper() only knows about modules cached before it started.
+  void set_module_identifier_cache(const ModuleIdentifierCache* cache) {
+    module_identifier_cache_ = cache;
+  }
+
+  // Makes dumps of this process include the annotations its threads record
+  // in |annotations|, in a MD_LINUX_ANNOTATIONS stream.  |annotations| is
+  // not owned and must outlive the handler.  Annotations reach dumps
+  // written by a dump helper too, as long as the handler had them set
+  // when the crash happened.  Out-of-process dumps don't include them.
+  void set_crash_annotations(const CrashAnnotations* annotations) {
+    crash_annotations_ = annotations;
+  }
+
+  // Makes the handler skip the minidump of a crash that repeats one that
+  // |dedupe| recorded shortly before, as described in crash_dedupe.h, so
+  // that a process stuck in a crash loop doesn't write the same minidump
+  // on every restart.  The repeat is only counted in |dedupe|'s file, and
+  // the MinidumpCallback is called with |succeeded| false; it can tell a
+  // skipped minidump from a failed one by dedupe->last_crash_count() being
+  // above 1.  Only crashes are checked, not dumps requested with
+  // WriteMinidump().  |dedupe| is not owned and must outlive the handler.
+  void set_crash_dedupe(CrashDedupe* dedupe) {
+    crash_dedupe_ = dedupe;
+  }
+
+  // Makes the minidumps written by WriteMinidump() from now on a series of
+  // snapshots of this process, as described by MD_LINUX_SNAPSHOT: the
+  // first is complete, and each one after it holds only the memory written
+  // since, to be overlaid onto the first by the processor.  Crash dumps
+  // stay complete, and snapshots are written uncompressed, whatever the
+  // descriptor asks.  Snapshots need the kernel's soft-dirty page tracking;
+  // without it, every minidump is complete.  Dumps written by a dump
+  // helper, or out of process, aren't snapshots.  Returns true if the
+  // series was started.
+  // Not to be called from a compromised context as it maps memory.
+  bool StartSnapshotSeries();
+
+  // Ends the series of snapshots started by StartSnapshotSeries(), so
+  // that minidumps are complete again.
+  void StopSnapshotSeries();
+
   // Force signal handling for the specified signal.
   bool SimulateSignalDelivery(int sig);
 
@@ -235,7 +306,14 @@ class ExceptionHandler {
 
   void PreresolveSymbols();
   bool GenerateDump(CrashContext *context);
+  bool GenerateDumpWithHelper(CrashContext *context, bool* succeeded);
+  void StopDumpHelper();
+  static void RunDumpHelper(int socket_fd, pid_t crashing_process,
+                            const ModuleIdentifierCache* module_identifiers);
   void SendContinueSignalToChild();
+  // Sends an in-memory minidump to the descriptor's handoff socket, if it
+  // has one.
+  void HandOffMinidump();
   void WaitForContinueSignal();
 
   static void SignalHandler(int sig, siginfo_t* info, void* uc);
@@ -264,6 +342,11 @@ class ExceptionHandler {
   // ptrace. This is used to store the file descriptors for the pipe
   int fdes[2];
 
+  // The process started by StartDumpHelper() and this process's end of the
+  // socket to it, or -1 when there is none.
+  pid_t dump_helper_pid_;
+  int dump_helper_fd_;
+
   // Callers can add extra info about mappings for cases where the
   // dumper code cannot extract enough information from /proc/<pid>/maps.
   MappingList mapping_list_;
@@ -271,6 +354,27 @@ class ExceptionHandler {
   // Callers can request additional memory regions to be included in
   // the dump.
   AppMemoryList app_memory_list_;
+
+  // The entries of app_memory_list_ by address, so that registering and
+  // unregistering regions doesn't search the list.  The crash path only
+  // reads the list.
+  typedef std::map<void*, AppMemoryList::iterator> AppMemoryIndex;
+  AppMemoryIndex app_memory_index_;
+
+  // Precomputed identifiers of this process's modules, or NULL.
+  const ModuleIdentifierCache* module_identifier_cache_;
+
+  // The annotations written to this process's dumps, or NULL.
+  const CrashAnnotations* crash_annotations_;
+
+  // Recognizes repeated crashes whose minidumps are skipped, or NULL.
+  CrashDedupe* crash_dedupe_;
+
+  // The state of the series of snapshots, in a page shared with the
+  // process that writes each one, or NULL; and whether the dump being
+  // written is one of them.
+  MinidumpSnapshotSeries* snapshot_series_;
+  bool writing_snapshot_;
 };
 
 }  // namespace google_breakpad
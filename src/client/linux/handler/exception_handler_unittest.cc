@@ -33,6 +33,7 @@
 #include <sys/mman.h>
 #include <sys/poll.h>
 #include <sys/socket.h>
+#include <sys/stat.h>
 #include <sys/uio.h>
 #include <sys/wait.h>
 #if defined(__mips__)
@@ -43,6 +44,7 @@
 
 #include "breakpad_googletest_includes.h"
 #include "client/linux/handler/exception_handler.h"
+#include "client/linux/handler/minidump_handoff.h"
 #include "client/linux/minidump_writer/minidump_writer.h"
 #include "common/linux/eintr_wrapper.h"
 #include "common/linux/file_id.h"
@@ -207,7 +209,7 @@ static void DoNullPointerDereference() {
   *p_null = 1;
 }
 
-void ChildCrash(bool use_fd) {
+void ChildCrash(bool use_fd, bool use_dump_helper) {
   AutoTempDir temp_dir;
   int fds[2] = {0};
   int minidump_fd = -1;
@@ -232,6 +234,8 @@ void ChildCrash(bool use_fd) {
                                            NULL, DoneCallback, fd_param,
                                            true, -1));
       }
+      if (use_dump_helper && !handler->StartDumpHelper())
+        _exit(1);
       // Crash with the exception handler in scope.
       DoNullPointerDereference();
     }
@@ -251,11 +255,19 @@ void ChildCrash(bool use_fd) {
 }
 
 TEST(ExceptionHandlerTest, ChildCrashWithPath) {
-  ASSERT_NO_FATAL_FAILURE(ChildCrash(false));
+  ASSERT_NO_FATAL_FAILURE(ChildCrash(false, false));
 }
 
 TEST(ExceptionHandlerTest, ChildCrashWithFD) {
-  ASSERT_NO_FATAL_FAILURE(ChildCrash(true));
+  ASSERT_NO_FATAL_FAILURE(ChildCrash(true, false));
+}
+
+TEST(ExceptionHandlerTest, ChildCrashWithPathAndDumpHelper) {
+  ASSERT_NO_FATAL_FAILURE(ChildCrash(false, true));
+}
+
+TEST(ExceptionHandlerTest, ChildCrashWithFDAndDumpHelper) {
+  ASSERT_NO_FATAL_FAILURE(ChildCrash(true, true));
 }
 
 #endif  // !ADDRESS_SANITIZER
@@ -1033,6 +1045,40 @@ TEST(ExceptionHandlerTest, GenerateMultipleDumpsWithFD) {
   ASSERT_GT(size, 0);
 }
 
+TEST(ExceptionHandlerTest, HandOffInMemoryMinidumps) {
+  int fds[2];
+  ASSERT_EQ(0, socketpair(AF_UNIX, SOCK_SEQPACKET, 0, fds));
+  MinidumpDescriptor descriptor(MinidumpDescriptor::kMinidumpInMemory,
+                                1024 * 1024);
+  descriptor.set_handoff_socket(fds[0]);
+  ExceptionHandler handler(descriptor, NULL, NULL, NULL, false, -1);
+
+  int dump_fds[2];
+  for (int i = 0; i < 2; ++i) {
+    ASSERT_TRUE(handler.WriteMinidump());
+    MinidumpHandoffMessage message;
+    ASSERT_TRUE(ReceiveMinidumpHandoff(fds[1], &dump_fds[i], &message));
+    EXPECT_EQ(static_cast<uint32_t>(getpid()), message.pid);
+    ASSERT_GT(message.size, 0U);
+
+    // The file holds exactly the minidump.
+    struct stat st;
+    ASSERT_EQ(0, fstat(dump_fds[i], &st));
+    EXPECT_EQ(static_cast<off_t>(message.size), st.st_size);
+  }
+
+  // Each minidump got its own file, which outlives the handler's copy.
+  for (int i = 0; i < 2; ++i) {
+    uint32_t signature = 0;
+    ASSERT_EQ(static_cast<ssize_t>(sizeof(signature)),
+              pread(dump_fds[i], &signature, sizeof(signature), 0));
+    EXPECT_EQ(static_cast<uint32_t>(MD_HEADER_SIGNATURE), signature);
+    close(dump_fds[i]);
+  }
+  close(fds[0]);
+  close(fds[1]);
+}
+
 TEST(ExceptionHandlerTest, GenerateMultipleDumpsWithPath) {
   AutoTempDir temp_dir;
   ExceptionHandler handler(MinidumpDescriptor(temp_dir.path()), NULL, NULL,
@@ -1107,6 +1153,40 @@ TEST(ExceptionHandlerTest, AdditionalMemory) {
   delete[] memory;
 }
 
+// Test that the dump helper includes memory registered after it started.
+TEST(ExceptionHandlerTest, AdditionalMemoryWithDumpHelper) {
+  const uint32_t kMemorySize = sysconf(_SC_PAGESIZE);
+
+  AutoTempDir temp_dir;
+  ExceptionHandler handler(
+      MinidumpDescriptor(temp_dir.path()), NULL, NULL, NULL, true, -1);
+  ASSERT_TRUE(handler.StartDumpHelper());
+
+  uint8_t* memory = new uint8_t[kMemorySize];
+  const uintptr_t kMemoryAddress = reinterpret_cast<uintptr_t>(memory);
+  for (uint32_t i = 0; i < kMemorySize; ++i) {
+    memory[i] = i % 253;
+  }
+
+  handler.RegisterAppMemory(memory, kMemorySize);
+  ASSERT_TRUE(handler.WriteMinidump());
+
+  Minidump minidump(handler.minidump_descriptor().path());
+  ASSERT_TRUE(minidump.Read());
+
+  MinidumpMemoryList* dump_memory_list = minidump.GetMemoryList();
+  ASSERT_TRUE(dump_memory_list);
+  const MinidumpMemoryRegion* region =
+    dump_memory_list->GetMemoryRegionForAddress(kMemoryAddress);
+  ASSERT_TRUE(region);
+
+  EXPECT_EQ(kMemoryAddress, region->GetBase());
+  EXPECT_EQ(kMemorySize, region->GetSize());
+  EXPECT_EQ(0, memcmp(region->GetMemory(), memory, kMemorySize));
+
+  delete[] memory;
+}
+
 // Test that a memory region that was previously registered
 // can be unregistered.
 TEST(ExceptionHandlerTest, AdditionalMemoryRemove) {
@@ -1143,6 +1223,48 @@ TEST(ExceptionHandlerTest, AdditionalMemoryRemove) {
   delete[] memory;
 }
 
+// Test registering and unregistering many regions, in a different order.
+TEST(ExceptionHandlerTest, AdditionalMemoryManyRegions) {
+  const uint32_t kMemorySize = sysconf(_SC_PAGESIZE);
+  const int kRegionCount = 64;
+
+  uint8_t* memory[kRegionCount];
+  for (int i = 0; i < kRegionCount; ++i)
+    memory[i] = new uint8_t[kMemorySize];
+
+  AutoTempDir temp_dir;
+  ExceptionHandler handler(
+      MinidumpDescriptor(temp_dir.path()), NULL, NULL, NULL, true, -1);
+
+  for (int i = 0; i < kRegionCount; ++i)
+    handler.RegisterAppMemory(memory[i], kMemorySize);
+  // Registering a pointer again is ignored, so one unregistration removes
+  // it.
+  handler.RegisterAppMemory(memory[0], kMemorySize);
+  for (int i = kRegionCount - 2; i >= 0; i -= 2)
+    handler.UnregisterAppMemory(memory[i]);
+  // Unknown pointers are ignored.
+  handler.UnregisterAppMemory(memory[0]);
+  handler.WriteMinidump();
+
+  Minidump minidump(handler.minidump_descriptor().path());
+  ASSERT_TRUE(minidump.Read());
+  MinidumpMemoryList* dump_memory_list = minidump.GetMemoryList();
+  ASSERT_TRUE(dump_memory_list);
+  for (int i = 0; i < kRegionCount; ++i) {
+    const MinidumpMemoryRegion* region =
+        dump_memory_list->GetMemoryRegionForAddress(
+            reinterpret_cast<uintptr_t>(memory[i]));
+    if (i % 2)
+      EXPECT_TRUE(region) << i;
+    else
+      EXPECT_FALSE(region) << i;
+  }
+
+  for (int i = 0; i < kRegionCount; ++i)
+    delete[] memory[i];
+}
+
 static bool SimpleCallback(const MinidumpDescriptor& descriptor,
                            void* context,
                            bool succeeded) {
@@ -27,23 +27,42 @@
 // (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
 // OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
+#include <fcntl.h>
+#include <linux/falloc.h>
 #include <stdio.h>
+#include <sys/syscall.h>
+#include <unistd.h>
 
 #include "client/linux/handler/minidump_descriptor.h"
 
 #include "common/linux/guid_creator.h"
 
+#ifndef MFD_CLOEXEC
+#define MFD_CLOEXEC 0x0001U
+#endif
+
 namespace google_breakpad {
 
 //static
 const MinidumpDescriptor::MicrodumpOnConsole kMicrodumpOnConsole = {};
 
+//static
+const MinidumpDescriptor::MinidumpInMemory
+    MinidumpDescriptor::kMinidumpInMemory = {};
+
 MinidumpDescriptor::MinidumpDescriptor(const MinidumpDescriptor& descriptor)
     : mode_(descriptor.mode_),
       fd_(descriptor.fd_),
+      memory_size_(descriptor.memory_size_),
+      handoff_socket_(descriptor.handoff_socket_),
       directory_(descriptor.directory_),
       c_path_(NULL),
-      size_limit_(descriptor.size_limit_) {
+      size_limit_(descriptor.size_limit_),
+      size_limit_budgeted_(descriptor.size_limit_budgeted_),
+      compressed_(descriptor.compressed_),
+      identifier_helpers_(descriptor.identifier_helpers_),
+      microdump_compact_(descriptor.microdump_compact_),
+      microdump_ring_(descriptor.microdump_ring_) {
   // The copy constructor is not allowed to be called on a MinidumpDescriptor
   // with a valid path_, as getting its c_path_ would require the heap which
   // can cause problems in compromised environments.
@@ -56,6 +75,8 @@ MinidumpDescriptor& MinidumpDescriptor::operator=(
 
   mode_ = descriptor.mode_;
   fd_ = descriptor.fd_;
+  memory_size_ = descriptor.memory_size_;
+  handoff_socket_ = descriptor.handoff_socket_;
   directory_ = descriptor.directory_;
   path_.clear();
   if (c_path_) {
@@ -64,6 +85,11 @@ MinidumpDescriptor& MinidumpDescriptor::operator=(
     UpdatePath();
   }
   size_limit_ = descriptor.size_limit_;
+  size_limit_budgeted_ = descriptor.size_limit_budgeted_;
+  compressed_ = descriptor.compressed_;
+  identifier_helpers_ = descriptor.identifier_helpers_;
+  microdump_compact_ = descriptor.microdump_compact_;
+  microdump_ring_ = descriptor.microdump_ring_;
   return *this;
 }
 
@@ -81,4 +107,38 @@ void MinidumpDescriptor::UpdatePath() {
   c_path_ = path_.c_str();
 }
 
+bool MinidumpDescriptor::CreateMemoryFile() {
+  assert(mode_ == kWriteMinidumpToMemory && fd_ == -1);
+
+  int fd = -1;
+#if defined(__NR_memfd_create)
+  fd = syscall(__NR_memfd_create, "breakpad-minidump", MFD_CLOEXEC);
+#endif
+#if defined(O_TMPFILE)
+  // Kernels without memfd_create can still create an unnamed file on the
+  // shared memory filesystem.
+  if (fd == -1)
+    fd = open("/dev/shm", O_TMPFILE | O_RDWR | O_CLOEXEC, 0600);
+#endif
+  if (fd == -1)
+    return false;
+
+  // Reserve the space without growing the file, so that the file size
+  // remains that of the minidump. A filesystem that cannot reserve space
+  // leaves the allocation to the time of the dump.
+  if (memory_size_ > 0)
+    fallocate(fd, FALLOC_FL_KEEP_SIZE, 0, memory_size_);
+
+  fd_ = fd;
+  return true;
+}
+
+void MinidumpDescriptor::CloseMemoryFile() {
+  assert(mode_ == kWriteMinidumpToMemory);
+  if (fd_ != -1) {
+    close(fd_);
+    fd_ = -1;
+  }
+}
+
 }  // namespace google_breakpad
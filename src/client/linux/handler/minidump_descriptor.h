@@ -41,46 +41,104 @@
 // - Writing a full minidump to a file in a given directory (the actual path,
 //   inside the directory, is determined by this class).
 // - Writing a full minidump to a given fd.
+// - Writing a full minidump to an in-memory file (a memfd), which can be
+//   handed off to another process over a unix domain socket.
 // - Writing a reduced microdump to the console (logcat on Android).
 namespace google_breakpad {
 
+struct MicrodumpRing;
+
 class MinidumpDescriptor {
  public:
   struct MicrodumpOnConsole {};
   static const MicrodumpOnConsole kMicrodumpOnConsole;
 
+  struct MinidumpInMemory {};
+  static const MinidumpInMemory kMinidumpInMemory;
+
   MinidumpDescriptor() : mode_(kUninitialized),
                          fd_(-1),
-                         size_limit_(-1) {}
+                         memory_size_(0),
+                         handoff_socket_(-1),
+                         size_limit_(-1),
+        size_limit_budgeted_(false),
+        compressed_(false),
+        identifier_helpers_(0),
+        microdump_compact_(false),
+        microdump_ring_(NULL) {}
 
   explicit MinidumpDescriptor(const string& directory)
       : mode_(kWriteMinidumpToFile),
         fd_(-1),
+        memory_size_(0),
+        handoff_socket_(-1),
         directory_(directory),
         c_path_(NULL),
-        size_limit_(-1) {
+        size_limit_(-1),
+        size_limit_budgeted_(false),
+        compressed_(false),
+        identifier_helpers_(0),
+        microdump_compact_(false),
+        microdump_ring_(NULL) {
     assert(!directory.empty());
   }
 
   explicit MinidumpDescriptor(int fd)
       : mode_(kWriteMinidumpToFd),
         fd_(fd),
+        memory_size_(0),
+        handoff_socket_(-1),
         c_path_(NULL),
-        size_limit_(-1) {
+        size_limit_(-1),
+        size_limit_budgeted_(false),
+        compressed_(false),
+        identifier_helpers_(0),
+        microdump_compact_(false),
+        microdump_ring_(NULL) {
     assert(fd != -1);
   }
 
   explicit MinidumpDescriptor(const MicrodumpOnConsole&)
       : mode_(kWriteMicrodumpToConsole),
         fd_(-1),
-        size_limit_(-1) {}
+        memory_size_(0),
+        handoff_socket_(-1),
+        size_limit_(-1),
+        size_limit_budgeted_(false),
+        compressed_(false),
+        identifier_helpers_(0),
+        microdump_compact_(false),
+        microdump_ring_(NULL) {}
+
+  // Writes the minidump to an in-memory file of which |reserved_size| bytes
+  // are reserved up front, so that writing the minidump does not have to
+  // allocate memory. The file itself is created by CreateMemoryFile(), which
+  // ExceptionHandler calls when it is installed.
+  MinidumpDescriptor(const MinidumpInMemory&, size_t reserved_size)
+      : mode_(kWriteMinidumpToMemory),
+        fd_(-1),
+        memory_size_(reserved_size),
+        handoff_socket_(-1),
+        c_path_(NULL),
+        size_limit_(-1),
+        size_limit_budgeted_(false),
+        compressed_(false),
+        identifier_helpers_(0),
+        microdump_compact_(false),
+        microdump_ring_(NULL) {}
 
   explicit MinidumpDescriptor(const MinidumpDescriptor& descriptor);
   MinidumpDescriptor& operator=(const MinidumpDescriptor& descriptor);
 
   static MinidumpDescriptor getMicrodumpDescriptor();
 
-  bool IsFD() const { return mode_ == kWriteMinidumpToFd; }
+  // True if the minidump is written to fd(), which includes in-memory
+  // minidumps.
+  bool IsFD() const {
+    return mode_ == kWriteMinidumpToFd || mode_ == kWriteMinidumpToMemory;
+  }
+
+  bool IsMemory() const { return mode_ == kWriteMinidumpToMemory; }
 
   int fd() const { return fd_; }
 
@@ -96,14 +154,64 @@ class MinidumpDescriptor {
   // Should be called from a normal context: this methods uses the heap.
   void UpdatePath();
 
+  // Creates the in-memory file of an in-memory descriptor and reserves its
+  // space. The minidump starts out empty, and its size is that of the file.
+  // Returns false if no file could be created.
+  // Should be called from a normal context.
+  bool CreateMemoryFile();
+
+  // Closes the in-memory file of an in-memory descriptor, if it has one.
+  // Copies of this descriptor share the file, and must not use it
+  // afterwards.
+  void CloseMemoryFile();
+
+  // If set to a connected unix domain socket, the in-memory file of an
+  // in-memory descriptor is sent over it after each successful dump, as
+  // described in minidump_handoff.h.
+  int handoff_socket() const { return handoff_socket_; }
+  void set_handoff_socket(int socket) { handoff_socket_ = socket; }
+
   off_t size_limit() const { return size_limit_; }
   void set_size_limit(off_t limit) { size_limit_ = limit; }
 
+  // Whether the size limit is filled with the most useful memory first
+  // (kSizeLimitBudgeted in minidump_writer.h) rather than by cutting the
+  // stacks of all but the first few threads short.
+  bool size_limit_budgeted() const { return size_limit_budgeted_; }
+  void set_size_limit_budgeted(bool budgeted) {
+    size_limit_budgeted_ = budgeted;
+  }
+
+  // Whether the minidump is written in the compressed format described in
+  // common/minidump_compression.h.  Not used for microdumps.
+  bool compressed() const { return compressed_; }
+  void set_compressed(bool compressed) { compressed_ = compressed; }
+
+  // The most helper tasks that read the files of the modules for their
+  // identifiers while the rest of the minidump is written; see
+  // LinuxDumper::StartIdentifierHelpers().  0, the default, reads them one
+  // at a time.  Not used for microdumps.
+  unsigned int identifier_helpers() const { return identifier_helpers_; }
+  void set_identifier_helpers(unsigned int helpers) {
+    identifier_helpers_ = helpers;
+  }
+
+  // Whether the microdump is written in the compact form described in
+  // microdump_writer.h.  Only used for microdumps.
+  bool microdump_compact() const { return microdump_compact_; }
+  void set_microdump_compact(bool compact) { microdump_compact_ = compact; }
+
+  // If set, the microdump is written into this ring rather than the
+  // console; see microdump_writer.h.  Only used for microdumps.
+  MicrodumpRing* microdump_ring() const { return microdump_ring_; }
+  void set_microdump_ring(MicrodumpRing* ring) { microdump_ring_ = ring; }
+
  private:
   enum DumpMode {
     kUninitialized = 0,
     kWriteMinidumpToFile,
     kWriteMinidumpToFd,
+    kWriteMinidumpToMemory,
     kWriteMicrodumpToConsole
   };
 
@@ -113,6 +221,11 @@ class MinidumpDescriptor {
   // The file descriptor where the minidump is generated.
   int fd_;
 
+  // Bytes reserved for an in-memory minidump, and the socket it is handed
+  // off through.
+  size_t memory_size_;
+  int handoff_socket_;
+
   // The directory where the minidump should be generated.
   string directory_;
   // The full path to the generated minidump.
@@ -122,6 +235,14 @@ class MinidumpDescriptor {
   const char* c_path_;
 
   off_t size_limit_;
+  bool size_limit_budgeted_;
+
+  bool compressed_;
+
+  unsigned int identifier_helpers_;
+
+  bool microdump_compact_;
+  MicrodumpRing* microdump_ring_;
 };
 
 }  // namespace google_breakpad
@@ -0,0 +1,122 @@
+// Copyright (c) 2016, Google Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+// notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above
+// copyright notice, this list of conditions and the following disclaimer
+// in the documentation and/or other materials provided with the
+// distribution.
+//     * Neither the name of Google Inc. nor the names of its
+// contributors may be used to endorse or promote products derived from
+// this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "client/linux/handler/minidump_handoff.h"
+
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "common/linux/eintr_wrapper.h"
+#include "common/linux/linux_libc_support.h"
+#include "third_party/lss/linux_syscall_support.h"
+
+namespace google_breakpad {
+
+// This function runs in a compromised context: see the top of
+// exception_handler.cc.
+bool SendMinidumpHandoff(int socket, int fd, uint64_t size) {
+  MinidumpHandoffMessage message;
+  message.magic = kMinidumpHandoffMagic;
+  message.pid = sys_getpid();
+  message.size = size;
+
+  struct kernel_iovec iov;
+  iov.iov_base = &message;
+  iov.iov_len = sizeof(message);
+
+  struct kernel_msghdr msg;
+  my_memset(&msg, 0, sizeof(msg));
+  msg.msg_iov = &iov;
+  msg.msg_iovlen = 1;
+  char cmsg[CMSG_SPACE(sizeof(int))];
+  my_memset(cmsg, 0, sizeof(cmsg));
+  msg.msg_control = cmsg;
+  msg.msg_controllen = sizeof(cmsg);
+
+  struct cmsghdr* hdr = CMSG_FIRSTHDR(&msg);
+  hdr->cmsg_level = SOL_SOCKET;
+  hdr->cmsg_type = SCM_RIGHTS;
+  hdr->cmsg_len = CMSG_LEN(sizeof(int));
+  my_memcpy(CMSG_DATA(hdr), &fd, sizeof(fd));
+
+  const ssize_t sent = HANDLE_EINTR(sys_sendmsg(socket, &msg, 0));
+  return sent == static_cast<ssize_t>(sizeof(message));
+}
+
+bool ReceiveMinidumpHandoff(int socket, int* fd,
+                            MinidumpHandoffMessage* message) {
+  struct iovec iov;
+  iov.iov_base = message;
+  iov.iov_len = sizeof(*message);
+
+  struct msghdr msg;
+  memset(&msg, 0, sizeof(msg));
+  msg.msg_iov = &iov;
+  msg.msg_iovlen = 1;
+  char cmsg[CMSG_SPACE(sizeof(int))];
+  msg.msg_control = cmsg;
+  msg.msg_controllen = sizeof(cmsg);
+
+  const ssize_t received =
+      HANDLE_EINTR(recvmsg(socket, &msg, MSG_CMSG_CLOEXEC));
+  if (received < 0)
+    return false;
+
+  // Take ownership of whatever descriptors arrived before validating the
+  // message, so that none of them leak.
+  int received_fd = -1;
+  for (struct cmsghdr* hdr = CMSG_FIRSTHDR(&msg); hdr;
+       hdr = CMSG_NXTHDR(&msg, hdr)) {
+    if (hdr->cmsg_level != SOL_SOCKET || hdr->cmsg_type != SCM_RIGHTS)
+      continue;
+    const size_t num_fds = (hdr->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+    const int* fds = reinterpret_cast<const int*>(CMSG_DATA(hdr));
+    for (size_t i = 0; i < num_fds; ++i) {
+      if (received_fd == -1)
+        received_fd = fds[i];
+      else
+        close(fds[i]);
+    }
+  }
+
+  if (received != static_cast<ssize_t>(sizeof(*message)) ||
+      (msg.msg_flags & (MSG_TRUNC | MSG_CTRUNC)) ||
+      message->magic != kMinidumpHandoffMagic ||
+      received_fd == -1) {
+    if (received_fd != -1)
+      close(received_fd);
+    return false;
+  }
+
+  *fd = received_fd;
+  return true;
+}
+
+}  // namespace google_breakpad
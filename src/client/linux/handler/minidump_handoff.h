@@ -0,0 +1,67 @@
+// Copyright (c) 2016, Google Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+// notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above
+// copyright notice, this list of conditions and the following disclaimer
+// in the documentation and/or other materials provided with the
+// distribution.
+//     * Neither the name of Google Inc. nor the names of its
+// contributors may be used to endorse or promote products derived from
+// this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+// minidump_handoff.h: Hand a minidump written to an in-memory file over to
+// another process, such as an uploader, without touching the filesystem.
+//
+// The sending side passes the file descriptor of the in-memory file over a
+// connected unix domain socket with SCM_RIGHTS, together with a
+// MinidumpHandoffMessage. The receiving side can read the minidump through
+// the descriptor, map it, or hand /proc/self/fd/<fd> to code that expects a
+// path.
+
+#ifndef CLIENT_LINUX_HANDLER_MINIDUMP_HANDOFF_H_
+#define CLIENT_LINUX_HANDLER_MINIDUMP_HANDOFF_H_
+
+#include <stdint.h>
+
+namespace google_breakpad {
+
+static const uint32_t kMinidumpHandoffMagic = 0x6d646f66;  // "fodm"
+
+struct MinidumpHandoffMessage {
+  uint32_t magic;  // kMinidumpHandoffMagic
+  uint32_t pid;    // The process that the minidump was written for.
+  uint64_t size;   // Bytes of minidump at the start of the file.
+};
+
+// Sends |fd|, which holds a minidump of |size| bytes, over |socket|.
+// Returns true on success. This function is async-signal-safe and does
+// not allocate, so that it can be called from a compromised context.
+bool SendMinidumpHandoff(int socket, int fd, uint64_t size);
+
+// Receives a minidump sent with SendMinidumpHandoff from |socket|. On
+// success, returns true, stores the received file descriptor in |fd|,
+// which the caller then owns, and fills in |message|.
+bool ReceiveMinidumpHandoff(int socket, int* fd,
+                            MinidumpHandoffMessage* message);
+
+}  // namespace google_breakpad
+
+#endif  // CLIENT_LINUX_HANDLER_MINIDUMP_HANDOFF_H_
@@ -32,6 +32,7 @@
 #if defined(__ANDROID__)
 #include <android/log.h>
 #else
+#include "common/linux/eintr_wrapper.h"
 #include "third_party/lss/linux_syscall_support.h"
 #endif
 
@@ -45,4 +46,31 @@ int write(const char* buf, size_t nbytes) {
 #endif
 }
 
+int write_lines(char* buf, size_t nbytes) {
+#if defined(__ANDROID__)
+  char* line = buf;
+  char* end = buf + nbytes;
+  for (char* p = buf; p < end; ++p) {
+    if (*p != '\n')
+      continue;
+    *p = '\0';
+    int result = write(line, p - line);
+    *p = '\n';
+    if (result < 0)
+      return result;
+    line = p + 1;
+  }
+  return nbytes;
+#else
+  size_t done = 0;
+  while (done < nbytes) {
+    int result = HANDLE_EINTR(sys_write(2, buf + done, nbytes - done));
+    if (result <= 0)
+      return -1;
+    done += result;
+  }
+  return nbytes;
+#endif
+}
+
 }  // namespace logger
@@ -36,6 +36,12 @@ namespace logger {
 
 int write(const char* buf, size_t nbytes);
 
+// Writes the |nbytes| at |buf|, which hold complete lines each ending in a
+// newline, in as few calls as the log allows.  On Linux they go out in one
+// write.  On Android every line becomes its own log entry, so the newlines
+// in |buf| are replaced with NULs while the lines are written.
+int write_lines(char* buf, size_t nbytes);
+
 }  // namespace logger
 
 #endif  // CLIENT_LINUX_LOG_LOG_H_
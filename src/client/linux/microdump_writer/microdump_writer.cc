@@ -34,6 +34,8 @@
 
 #include <sys/utsname.h>
 
+#include <algorithm>
+
 #include "client/linux/dump_writer_common/seccomp_unwinder.h"
 #include "client/linux/dump_writer_common/thread_info.h"
 #include "client/linux/dump_writer_common/ucontext_reader.h"
@@ -41,6 +43,7 @@
 #include "client/linux/log/log.h"
 #include "client/linux/minidump_writer/linux_ptrace_dumper.h"
 #include "common/linux/linux_libc_support.h"
+#include "common/memory.h"
 #include "common/scoped_ptr.h"
 
 namespace {
@@ -50,18 +53,55 @@ using google_breakpad::LinuxDumper;
 using google_breakpad::LinuxPtraceDumper;
 using google_breakpad::MappingInfo;
 using google_breakpad::MappingList;
+using google_breakpad::MicrodumpRing;
 using google_breakpad::RawContextCPU;
 using google_breakpad::scoped_array;
 using google_breakpad::SeccompUnwinder;
 using google_breakpad::ThreadInfo;
 using google_breakpad::UContextReader;
+using google_breakpad::wasteful_vector;
 
 const size_t kLineBufferSize = 2048;
 
+// Dump the content of the stack, splicing it into chunks which size is
+// compatible with the max logcat line size (see LOGGER_ENTRY_MAX_PAYLOAD).
+const size_t kStackDumpChunkSize = 384;
+
+// In a compact microdump, kept stack words separated by at most this many
+// dropped words are written as one run, since starting a new line costs
+// more than sending the words in between.
+const size_t kCompactStackMaxGapWords = 2;
+
+// The most frames followed through the frame pointer chain.
+const int kCompactStackMaxFrames = 256;
+
+// Committed lines are collected in a buffer of this size and written out
+// together, rather than with one log call each.
+const size_t kLogBatchSize = 16 * 1024;
+
+// An executable mapping that can be written as a module.  In a compact
+// microdump, only the modules that the CPU state or the kept stack words
+// point into are written.
+struct ModuleRange {
+  uintptr_t start;
+  uintptr_t end;
+  const MappingInfo* mapping;
+  bool member;
+  unsigned int mapping_id;
+  const uint8_t* identifier;
+  bool referenced;
+};
+
+bool ModuleRangeStartLess(const ModuleRange& a, const ModuleRange& b) {
+  return a.start < b.start;
+}
+
 class MicrodumpWriter {
  public:
   MicrodumpWriter(const ExceptionHandler::CrashContext* context,
                   const MappingList& mappings,
+                  bool compact,
+                  MicrodumpRing* ring,
                   LinuxDumper* dumper)
       : ucontext_(context ? &context->context : NULL),
 #if !defined(__ARM_EABI__) && !defined(__mips__)
@@ -69,7 +109,12 @@ class MicrodumpWriter {
 #endif
         dumper_(dumper),
         mapping_list_(mappings),
-        log_line_(new char[kLineBufferSize]) {
+        compact_(compact),
+        ring_(ring),
+        modules_(dumper->allocator()),
+        log_line_(new char[kLineBufferSize]),
+        log_batch_(NULL),
+        log_batch_length_(0) {
     log_line_.get()[0] = '\0';  // Clear out the log line buffer.
   }
 
@@ -78,6 +123,9 @@ class MicrodumpWriter {
   bool Init() {
     if (!dumper_->Init())
       return false;
+    log_batch_ = reinterpret_cast<char*>(Alloc(kLogBatchSize));
+    if (!log_batch_)
+      return false;
     return dumper_->ThreadsSuspend();
   }
 
@@ -85,22 +133,41 @@ class MicrodumpWriter {
     bool success;
     LogLine("-----BEGIN BREAKPAD MICRODUMP-----");
     success = DumpOSInformation();
+    CollectModules();
     if (success)
       success = DumpCrashingThread();
     if (success)
       success = DumpMappings();
     LogLine("-----END BREAKPAD MICRODUMP-----");
+    LogFlush();
     dumper_->ThreadsResume();
     return success;
   }
 
  private:
-  // Writes one line to the system log.
+  // Adds one line to the batch of lines for the system log, writing the
+  // batch out first if the line doesn't fit.
   void LogLine(const char* msg) {
-    logger::write(msg, my_strlen(msg));
-#if !defined(__ANDROID__)
-    logger::write("\n", 1);  // Android logger appends the \n. Linux's doesn't.
-#endif
+    size_t length = my_strlen(msg);
+    if (length + 1 > kLogBatchSize - log_batch_length_)
+      LogFlush();
+    if (length + 1 > kLogBatchSize)
+      length = kLogBatchSize - 1;
+    my_memcpy(log_batch_ + log_batch_length_, msg, length);
+    log_batch_length_ += length;
+    log_batch_[log_batch_length_++] = '\n';
+  }
+
+  // Writes out the batch of lines, to the ring if there is one and to the
+  // system log otherwise.
+  void LogFlush() {
+    if (log_batch_length_ == 0)
+      return;
+    if (ring_)
+      ring_->Write(log_batch_, log_batch_length_);
+    else
+      logger::write_lines(log_batch_, log_batch_length_);
+    log_batch_length_ = 0;
   }
 
   // Stages the given string in the current line buffer.
@@ -133,6 +200,34 @@ class MicrodumpWriter {
       LogAppend(*ptr);
   }
 
+  // Stages the buffer content base64-encoded in the current line buffer.
+  // This is a third shorter than hex, for the compact microdump.
+  void LogAppendBase64(const void* buf, size_t length) {
+    static const char kBase64[] =
+        "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    const uint8_t* ptr = reinterpret_cast<const uint8_t*>(buf);
+    // Encode 48 bytes (64 characters) at a time to keep the buffer small.
+    char chunk[64 + 1];
+    size_t chunk_length = 0;
+    for (size_t i = 0; i < length; i += 3) {
+      uint32_t group = ptr[i] << 16;
+      if (i + 1 < length)
+        group |= ptr[i + 1] << 8;
+      if (i + 2 < length)
+        group |= ptr[i + 2];
+      chunk[chunk_length++] = kBase64[(group >> 18) & 0x3F];
+      chunk[chunk_length++] = kBase64[(group >> 12) & 0x3F];
+      chunk[chunk_length++] = i + 1 < length ? kBase64[(group >> 6) & 0x3F]
+                                             : '=';
+      chunk[chunk_length++] = i + 2 < length ? kBase64[group & 0x3F] : '=';
+      if (chunk_length == sizeof(chunk) - 1 || i + 3 >= length) {
+        chunk[chunk_length] = '\0';
+        LogAppend(chunk);
+        chunk_length = 0;
+      }
+    }
+  }
+
   // Writes out the current line buffer on the system log.
   void LogCommitLine() {
     LogLine(log_line_.get());
@@ -183,10 +278,15 @@ class MicrodumpWriter {
     return true;
   }
 
+  // Copies the stack of |thread_id| into |*stack_copy|, and unless the
+  // microdump is compact, writes it out.  Sets |*stack_copy| to NULL if
+  // the stack can't be found.
   bool DumpThreadStack(uint32_t thread_id,
                        uintptr_t stack_pointer,
                        int max_stack_len,
-                       uint8_t** stack_copy) {
+                       uint8_t** stack_copy,
+                       uintptr_t* stack_start,
+                       size_t* stack_length) {
     *stack_copy = NULL;
     const void* stack;
     size_t stack_len;
@@ -212,22 +312,119 @@ class MicrodumpWriter {
 
     *stack_copy = reinterpret_cast<uint8_t*>(Alloc(stack_len));
     dumper_->CopyFromProcess(*stack_copy, thread_id, stack, stack_len);
+    *stack_start = reinterpret_cast<uintptr_t>(stack);
+    *stack_length = stack_len;
+    if (compact_)
+      return true;
 
-    // Dump the content of the stack, splicing it into chunks which size is
-    // compatible with the max logcat line size (see LOGGER_ENTRY_MAX_PAYLOAD).
-    const size_t STACK_DUMP_CHUNK_SIZE = 384;
     for (size_t stack_off = 0; stack_off < stack_len;
-         stack_off += STACK_DUMP_CHUNK_SIZE) {
+         stack_off += kStackDumpChunkSize) {
       LogAppend("S ");
       LogAppend(reinterpret_cast<uintptr_t>(stack) + stack_off);
       LogAppend(" ");
       LogAppend(*stack_copy + stack_off,
-                std::min(STACK_DUMP_CHUNK_SIZE, stack_len - stack_off));
+                std::min(kStackDumpChunkSize, stack_len - stack_off));
       LogCommitLine();
     }
     return true;
   }
 
+  // Marks the kept words of the stack in |keep| along the frame pointer
+  // chain starting at |frame_pointer|.  The words on both sides of each
+  // frame pointer are kept, which covers the saved frame pointer and
+  // return address in the frame layouts of all supported architectures.
+  void KeepFramePointerChain(uintptr_t frame_pointer,
+                             uintptr_t stack_start,
+                             const uint8_t* stack_copy,
+                             size_t stack_len,
+                             uint8_t* keep) {
+    const size_t num_words = stack_len / sizeof(uintptr_t);
+    for (int frame = 0; frame < kCompactStackMaxFrames; ++frame) {
+      if (frame_pointer < stack_start ||
+          frame_pointer % sizeof(uintptr_t) != 0)
+        return;
+      const size_t index = (frame_pointer - stack_start) / sizeof(uintptr_t);
+      if (index >= num_words)
+        return;
+      if (index > 0)
+        keep[index - 1] = 1;
+      keep[index] = 1;
+      if (index + 1 < num_words)
+        keep[index + 1] = 1;
+
+      uintptr_t next;
+      my_memcpy(&next, stack_copy + index * sizeof(uintptr_t), sizeof(next));
+      // Frames move towards the base of the stack; anything else is not a
+      // frame pointer.
+      if (next <= frame_pointer)
+        return;
+      frame_pointer = next;
+    }
+  }
+
+  // Writes the words of the stack that a stack walker needs: those that
+  // point into modules, which may be return addresses, and those along
+  // the frame pointer chains.  Runs of kept words are written base64
+  // encoded on "s" lines; everything else reads back as zero.
+  void DumpCompactStack(const RawContextCPU& cpu,
+                        uintptr_t stack_start,
+                        const uint8_t* stack_copy,
+                        size_t stack_len) {
+    const size_t num_words = stack_len / sizeof(uintptr_t);
+    uint8_t* keep = reinterpret_cast<uint8_t*>(Alloc(num_words + 1));
+    my_memset(keep, 0, num_words + 1);
+
+    for (size_t i = 0; i < num_words; ++i) {
+      uintptr_t word;
+      my_memcpy(&word, stack_copy + i * sizeof(uintptr_t), sizeof(word));
+      if (ReferenceModule(word))
+        keep[i] = 1;
+    }
+
+#if defined(__ARM_EABI__)
+    // r11 is the frame pointer in ARM code, r7 in Thumb code.
+    KeepFramePointerChain(cpu.iregs[MD_CONTEXT_ARM_REG_FP], stack_start,
+                          stack_copy, stack_len, keep);
+    KeepFramePointerChain(cpu.iregs[7], stack_start, stack_copy, stack_len,
+                          keep);
+#elif defined(__aarch64__)
+    KeepFramePointerChain(cpu.iregs[MD_CONTEXT_ARM64_REG_FP], stack_start,
+                          stack_copy, stack_len, keep);
+#elif defined(__x86_64__)
+    KeepFramePointerChain(cpu.rbp, stack_start, stack_copy, stack_len, keep);
+#elif defined(__i386__)
+    KeepFramePointerChain(cpu.ebp, stack_start, stack_copy, stack_len, keep);
+#elif defined(__mips__)
+    KeepFramePointerChain(cpu.iregs[MD_CONTEXT_MIPS_REG_FP], stack_start,
+                          stack_copy, stack_len, keep);
+#endif
+
+    const size_t max_run_words = kStackDumpChunkSize / sizeof(uintptr_t);
+    size_t i = 0;
+    while (i < num_words) {
+      if (!keep[i]) {
+        ++i;
+        continue;
+      }
+      // Extend the run over short gaps, up to the length of a line.
+      size_t run_end = i + 1;
+      for (size_t j = i + 1;
+           j < num_words && j - i < max_run_words &&
+           j - run_end < kCompactStackMaxGapWords;
+           ++j) {
+        if (keep[j])
+          run_end = j + 1;
+      }
+      LogAppend("s ");
+      LogAppend(stack_start + i * sizeof(uintptr_t));
+      LogAppend(" ");
+      LogAppendBase64(stack_copy + i * sizeof(uintptr_t),
+                      (run_end - i) * sizeof(uintptr_t));
+      LogCommitLine();
+      i = run_end;
+    }
+  }
+
   // Write information about the crashing thread.
   bool DumpCrashingThread() {
     const unsigned num_threads = dumper_->threads().size();
@@ -245,8 +442,11 @@ class MicrodumpWriter {
       assert(!dumper_->IsPostMortem());
 
       uint8_t* stack_copy;
+      uintptr_t stack_start = 0;
+      size_t stack_len = 0;
       const uintptr_t stack_ptr = UContextReader::GetStackPointer(ucontext_);
-      if (!DumpThreadStack(thread.thread_id, stack_ptr, -1, &stack_copy))
+      if (!DumpThreadStack(thread.thread_id, stack_ptr, -1, &stack_copy,
+                           &stack_start, &stack_len))
         return false;
 
       RawContextCPU cpu;
@@ -258,14 +458,31 @@ class MicrodumpWriter {
 #endif
       if (stack_copy)
         SeccompUnwinder::PopSeccompStackFrame(&cpu, thread, stack_copy);
+      if (compact_) {
+        ReferenceModule(UContextReader::GetInstructionPointer(ucontext_));
+#if defined(__ARM_EABI__)
+        ReferenceModule(cpu.iregs[MD_CONTEXT_ARM_REG_LR]);
+#elif defined(__aarch64__)
+        ReferenceModule(cpu.iregs[MD_CONTEXT_ARM64_REG_LR]);
+#elif defined(__mips__)
+        ReferenceModule(cpu.iregs[MD_CONTEXT_MIPS_REG_RA]);
+#endif
+        if (stack_copy)
+          DumpCompactStack(cpu, stack_start, stack_copy, stack_len);
+      }
       DumpCPUState(&cpu);
     }
     return true;
   }
 
   void DumpCPUState(RawContextCPU* cpu) {
-    LogAppend("C ");
-    LogAppend(cpu, sizeof(*cpu));
+    if (compact_) {
+      LogAppend("c ");
+      LogAppendBase64(cpu, sizeof(*cpu));
+    } else {
+      LogAppend("C ");
+      LogAppend(cpu, sizeof(*cpu));
+    }
     LogCommitLine();
   }
 
@@ -332,9 +549,25 @@ class MicrodumpWriter {
     LogCommitLine();
   }
 
-  // Write information about the mappings in effect.
-  bool DumpMappings() {
-    // First write all the mappings from the dumper
+  void AddModule(const MappingInfo& mapping,
+                 bool member,
+                 unsigned int mapping_id,
+                 const uint8_t* identifier) {
+    ModuleRange module;
+    module.start = mapping.start_addr;
+    module.end = mapping.start_addr + mapping.size;
+    module.mapping = &mapping;
+    module.member = member;
+    module.mapping_id = mapping_id;
+    module.identifier = identifier;
+    module.referenced = false;
+    modules_.push_back(module);
+  }
+
+  // Lists the mappings that can be written as modules.  A compact
+  // microdump looks words up in them, so they are sorted by address.
+  void CollectModules() {
+    // First all the mappings from the dumper
     for (unsigned i = 0; i < dumper_->mappings().size(); ++i) {
       const MappingInfo& mapping = *dumper_->mappings()[i];
       if (mapping.name[0] == 0 ||  // only want modules with filenames.
@@ -344,13 +577,43 @@ class MicrodumpWriter {
         continue;
       }
 
-      DumpModule(mapping, true, i, NULL);
+      AddModule(mapping, true, i, NULL);
     }
-    // Next write all the mappings provided by the caller
+    // Next all the mappings provided by the caller
     for (MappingList::const_iterator iter = mapping_list_.begin();
          iter != mapping_list_.end();
          ++iter) {
-      DumpModule(iter->first, false, 0, iter->second);
+      AddModule(iter->first, false, 0, iter->second);
+    }
+    if (compact_)
+      std::sort(modules_.begin(), modules_.end(), ModuleRangeStartLess);
+  }
+
+  // If |address| is in a module, marks the module as referenced and
+  // returns true.  Only used for compact microdumps.
+  bool ReferenceModule(uintptr_t address) {
+    ModuleRange key;
+    key.start = address;
+    wasteful_vector<ModuleRange>::iterator iter =
+        std::upper_bound(modules_.begin(), modules_.end(), key,
+                         ModuleRangeStartLess);
+    if (iter == modules_.begin())
+      return false;
+    --iter;
+    if (address >= iter->end)
+      return false;
+    iter->referenced = true;
+    return true;
+  }
+
+  // Write information about the mappings in effect.
+  bool DumpMappings() {
+    for (size_t i = 0; i < modules_.size(); ++i) {
+      const ModuleRange& module = modules_[i];
+      if (compact_ && !module.referenced)
+        continue;
+      DumpModule(*module.mapping, module.member, module.mapping_id,
+                 module.identifier);
     }
     return true;
   }
@@ -363,16 +626,66 @@ class MicrodumpWriter {
 #endif
   LinuxDumper* dumper_;
   const MappingList& mapping_list_;
+  const bool compact_;
+  MicrodumpRing* const ring_;
+  wasteful_vector<ModuleRange> modules_;
   scoped_array<char> log_line_;
+  char* log_batch_;
+  size_t log_batch_length_;
 };
 }  // namespace
 
 namespace google_breakpad {
 
+// static
+MicrodumpRing* MicrodumpRing::Create(void* memory, size_t size) {
+  if (size <= sizeof(MicrodumpRing))
+    return NULL;
+  MicrodumpRing* ring = reinterpret_cast<MicrodumpRing*>(memory);
+  ring->capacity = size - sizeof(MicrodumpRing);
+  ring->write_offset = 0;
+  ring->read_offset = 0;
+  ring->dropped = 0;
+  return ring;
+}
+
+bool MicrodumpRing::Write(const char* buf, size_t nbytes) {
+  const uint64_t write = write_offset;
+  if (nbytes > capacity - (write - read_offset)) {
+    dropped += nbytes;
+    return false;
+  }
+  const size_t start = write % capacity;
+  const size_t first = nbytes < capacity - start ? nbytes : capacity - start;
+  my_memcpy(data() + start, buf, first);
+  my_memcpy(data(), buf + first, nbytes - first);
+  // Make the text visible before the reader can see the new offset.
+  __sync_synchronize();
+  write_offset = write + nbytes;
+  return true;
+}
+
+size_t MicrodumpRing::Read(char* buf, size_t nbytes) {
+  const uint64_t read = read_offset;
+  const uint64_t available = write_offset - read;
+  __sync_synchronize();
+  if (nbytes > available)
+    nbytes = available;
+  const size_t start = read % capacity;
+  const size_t first = nbytes < capacity - start ? nbytes : capacity - start;
+  my_memcpy(buf, data() + start, first);
+  my_memcpy(buf + first, data(), nbytes - first);
+  __sync_synchronize();
+  read_offset = read + nbytes;
+  return nbytes;
+}
+
 bool WriteMicrodump(pid_t crashing_process,
                     const void* blob,
                     size_t blob_size,
-                    const MappingList& mappings) {
+                    const MappingList& mappings,
+                    bool compact,
+                    MicrodumpRing* ring) {
   LinuxPtraceDumper dumper(crashing_process);
   const ExceptionHandler::CrashContext* context = NULL;
   if (blob) {
@@ -384,7 +697,7 @@ bool WriteMicrodump(pid_t crashing_process,
     dumper.set_crash_signal(context->siginfo.si_signo);
     dumper.set_crash_thread(context->tid);
   }
-  MicrodumpWriter writer(context, mappings, &dumper);
+  MicrodumpWriter writer(context, mappings, compact, ring, &dumper);
   if (!writer.Init())
     return false;
   return writer.Dump();
@@ -30,6 +30,7 @@
 #ifndef CLIENT_LINUX_MINIDUMP_WRITER_MICRODUMP_WRITER_H_
 #define CLIENT_LINUX_MINIDUMP_WRITER_MICRODUMP_WRITER_H_
 
+#include <stddef.h>
 #include <stdint.h>
 #include <sys/types.h>
 
@@ -37,6 +38,34 @@
 
 namespace google_breakpad {
 
+// A ring buffer of microdump text, for a supervisor process to collect
+// microdumps without going through the system log.  The supervisor lays
+// it out in memory it shares with the process being watched, typically
+// from mmap(MAP_SHARED), before anything crashes, and drains it with Read
+// after a crash.  There is one writer and one reader.  A batch of lines
+// that doesn't fit in the free space is dropped whole and counted in
+// |dropped|, so the ring should be sized for the largest microdump.
+struct MicrodumpRing {
+  // Lays out an empty ring in the |size| bytes at |memory|, which must be
+  // 8-byte aligned, and returns it.  Returns NULL if |size| is too small.
+  static MicrodumpRing* Create(void* memory, size_t size);
+
+  // Appends the |nbytes| at |buf| if they all fit.  Returns true if so.
+  bool Write(const char* buf, size_t nbytes);
+
+  // Copies up to |nbytes| of the unread text to |buf|, and returns the
+  // number of bytes copied.
+  size_t Read(char* buf, size_t nbytes);
+
+  char* data() { return reinterpret_cast<char*>(this + 1); }
+
+  uint64_t capacity;
+  // Totals of the bytes ever written and read; they only increase.
+  volatile uint64_t write_offset;
+  volatile uint64_t read_offset;
+  volatile uint64_t dropped;
+};
+
 // Writes a microdump (a reduced dump containing only the state of the crashing
 // thread) on the console (logcat on Android). These functions do not malloc nor
 // use libc functions which may. Thus, it can be used in contexts where the
@@ -46,12 +75,21 @@ namespace google_breakpad {
 //   blob: a blob of data from the crashing process. See exception_handler.h
 //   blob_size: the length of |blob| in bytes.
 //   mappings: a list of additional mappings provided by the application.
+//   compact: if true, writes a compact microdump for small log buffers.  It
+//            keeps only the stack words that point into modules and those
+//            along the frame pointer chain, lists only the modules that
+//            they and the CPU state point into, and encodes the stack and
+//            CPU state in base64 rather than hex.
+//   ring: if non-NULL, the microdump is written into |ring| rather than the
+//         system log.
 //
 // Returns true iff successful.
 bool WriteMicrodump(pid_t crashing_process,
                     const void* blob,
                     size_t blob_size,
-                    const MappingList& mappings);
+                    const MappingList& mappings,
+                    bool compact,
+                    MicrodumpRing* ring);
 
 }  // namespace google_breakpad
 
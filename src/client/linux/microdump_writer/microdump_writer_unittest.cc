@@ -32,6 +32,7 @@
 #include <unistd.h>
 
 #include <string>
+#include <vector>
 
 #include "breakpad_googletest_includes.h"
 #include "client/linux/handler/exception_handler.h"
@@ -52,7 +53,12 @@ namespace {
 
 typedef testing::Test MicrodumpWriterTest;
 
-TEST(MicrodumpWriterTest, Setup) {
+// Writes a microdump of a child process, with |mappings| as the additional
+// mappings, and returns what was logged on stderr in |buf|.
+void CrashAndGetMicrodump(const MappingList& mappings,
+                          bool compact,
+                          MicrodumpRing* ring,
+                          scoped_array<char>* buf) {
   int fds[2];
   ASSERT_NE(-1, pipe(fds));
 
@@ -77,7 +83,33 @@ TEST(MicrodumpWriterTest, Setup) {
   // Set a non-zero tid to avoid tripping asserts.
   context.tid = child;
 
-  // Push some extra mapping to check the MappingList logic.
+  // Redirect temporarily stderr to the stderr.log file.
+  int save_err = dup(STDERR_FILENO);
+  ASSERT_NE(-1, save_err);
+  ASSERT_NE(-1, dup2(err_fd, STDERR_FILENO));
+
+  ASSERT_TRUE(WriteMicrodump(child, &context, sizeof(context), mappings,
+                             compact, ring));
+
+  // Revert stderr back to the console.
+  dup2(save_err, STDERR_FILENO);
+  close(save_err);
+
+  // Read back the stderr file.
+  fsync(err_fd);
+  lseek(err_fd, 0, SEEK_SET);
+  const size_t kBufSize = 64 * 1024;
+  buf->reset(new char[kBufSize]);
+  memset(buf->get(), 0, kBufSize);
+  ASSERT_GE(read(err_fd, buf->get(), kBufSize - 1), 0);
+
+  close(err_fd);
+  close(fds[1]);
+}
+
+// Returns a mapping list with an extra mapping for libfoo.so, to check the
+// MappingList logic.
+MappingList ExtraMappings() {
   const uint32_t memory_size = sysconf(_SC_PAGESIZE);
   const char* kMemoryName = "libfoo.so";
   const uint8_t kModuleGUID[sizeof(MDGUID)] = {
@@ -96,24 +128,12 @@ TEST(MicrodumpWriterTest, Setup) {
   mapping.first = info;
   memcpy(mapping.second, kModuleGUID, sizeof(MDGUID));
   mappings.push_back(mapping);
+  return mappings;
+}
 
-  // Redirect temporarily stderr to the stderr.log file.
-  int save_err = dup(STDERR_FILENO);
-  ASSERT_NE(-1, save_err);
-  ASSERT_NE(-1, dup2(err_fd, STDERR_FILENO));
-
-  ASSERT_TRUE(WriteMicrodump(child, &context, sizeof(context), mappings));
-
-  // Revert stderr back to the console.
-  dup2(save_err, STDERR_FILENO);
-  close(save_err);
-
-  // Read back the stderr file and check for the microdump marker.
-  fsync(err_fd);
-  lseek(err_fd, 0, SEEK_SET);
-  const size_t kBufSize = 64 * 1024;
-  scoped_array<char> buf(new char[kBufSize]);
-  ASSERT_GT(read(err_fd, buf.get(), kBufSize), 0);
+TEST(MicrodumpWriterTest, Setup) {
+  scoped_array<char> buf;
+  CrashAndGetMicrodump(ExtraMappings(), false, NULL, &buf);
 
   ASSERT_NE(static_cast<char*>(0), strstr(
       buf.get(), "-----BEGIN BREAKPAD MICRODUMP-----"));
@@ -129,9 +149,75 @@ TEST(MicrodumpWriterTest, Setup) {
       buf.get(), "M 00001000 0000002A 00001000 "
       "33221100554477668899AABBCCDDEEFF0 libfoo.so"));
 #endif
+}
 
-  close(err_fd);
-  close(fds[1]);
+TEST(MicrodumpWriterTest, Compact) {
+  scoped_array<char> buf;
+  CrashAndGetMicrodump(ExtraMappings(), true, NULL, &buf);
+
+  ASSERT_NE(static_cast<char*>(0), strstr(
+      buf.get(), "-----BEGIN BREAKPAD MICRODUMP-----"));
+  ASSERT_NE(static_cast<char*>(0), strstr(
+      buf.get(), "-----END BREAKPAD MICRODUMP-----"));
+
+  // The CPU state is base64 encoded, and no stack is written in hex; at
+  // most its header.
+  ASSERT_NE(static_cast<char*>(0), strstr(buf.get(), "\nc "));
+  ASSERT_EQ(static_cast<char*>(0), strstr(buf.get(), "\nC "));
+  const char* line = buf.get();
+  while ((line = strstr(line, "\nS ")) != NULL) {
+    ++line;
+    ASSERT_EQ(0, strncmp(line, "S 0 ", 4));
+  }
+
+  // Nothing points into libfoo.so, so it is left out.
+  ASSERT_EQ(static_cast<char*>(0), strstr(buf.get(), "libfoo.so"));
+}
+
+TEST(MicrodumpWriterTest, Ring) {
+  std::vector<uint64_t> memory(64 * 1024 / sizeof(uint64_t));
+  MicrodumpRing* ring =
+      MicrodumpRing::Create(&memory[0], memory.size() * sizeof(uint64_t));
+  ASSERT_TRUE(ring);
+
+  scoped_array<char> buf;
+  CrashAndGetMicrodump(ExtraMappings(), false, ring, &buf);
+
+  // Nothing goes to the log.
+  ASSERT_EQ(static_cast<char*>(0), strstr(
+      buf.get(), "-----BEGIN BREAKPAD MICRODUMP-----"));
+
+  string microdump(ring->write_offset, '\0');
+  ASSERT_EQ(microdump.size(), ring->Read(&microdump[0], microdump.size()));
+  ASSERT_EQ(0U, ring->dropped);
+  ASSERT_EQ(0U, microdump.find("-----BEGIN BREAKPAD MICRODUMP-----\n"));
+  ASSERT_NE(string::npos, microdump.find(
+      "\n-----END BREAKPAD MICRODUMP-----\n"));
+  ASSERT_NE(string::npos, microdump.find("libfoo.so\n"));
+}
+
+TEST(MicrodumpWriterTest, RingWrapsAround) {
+  uint64_t memory[(sizeof(MicrodumpRing) + 16) / sizeof(uint64_t)];
+  ASSERT_EQ(static_cast<MicrodumpRing*>(NULL),
+            MicrodumpRing::Create(memory, sizeof(MicrodumpRing)));
+  MicrodumpRing* ring = MicrodumpRing::Create(memory, sizeof(memory));
+  ASSERT_TRUE(ring);
+  ASSERT_EQ(16U, ring->capacity);
+
+  char out[16];
+  ASSERT_TRUE(ring->Write("0123456789", 10));
+  ASSERT_EQ(6U, ring->Read(out, 6));
+  ASSERT_EQ(0, memcmp(out, "012345", 6));
+
+  // This one goes past the end of the ring's memory and wraps around.
+  ASSERT_TRUE(ring->Write("abcdefghij", 10));
+  // Only 2 bytes are free now, so this is dropped whole.
+  ASSERT_FALSE(ring->Write("xyz", 3));
+  ASSERT_EQ(3U, ring->dropped);
+
+  ASSERT_EQ(14U, ring->Read(out, sizeof(out)));
+  ASSERT_EQ(0, memcmp(out, "6789abcdefghij", 14));
+  ASSERT_EQ(0U, ring->Read(out, sizeof(out)));
 }
 
 }  // namespace
@@ -0,0 +1,125 @@
+// Copyright (c) 2016 Google Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+// notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above
+// copyright notice, this list of conditions and the following disclaimer
+// in the documentation and/or other materials provided with the
+// distribution.
+//     * Neither the name of Google Inc. nor the names of its
+// contributors may be used to endorse or promote products derived from
+// this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+// crash_annotations.cc: Implementation of CrashAnnotations.
+//
+// See crash_annotations.h for documentation.
+
+#include "client/linux/minidump_writer/crash_annotations.h"
+
+#include "common/linux/linux_libc_support.h"
+#include "third_party/lss/linux_syscall_support.h"
+
+namespace google_breakpad {
+
+const size_t CrashAnnotations::kMaxThreads;
+const size_t CrashAnnotations::kRecordsPerThread;
+const size_t CrashAnnotations::kKeySize;
+const size_t CrashAnnotations::kValueSize;
+
+CrashAnnotations::CrashAnnotations() {
+  my_memset(rings_, 0, sizeof(rings_));
+}
+
+CrashAnnotations::ThreadRing* CrashAnnotations::RegisterThread() {
+  const int32_t tid = sys_gettid();
+  for (size_t i = 0; i < kMaxThreads; ++i) {
+    int32_t free_owner = 0;
+    if (__atomic_compare_exchange_n(&rings_[i].owner_, &free_owner, tid,
+                                    false, __ATOMIC_ACQUIRE,
+                                    __ATOMIC_RELAXED)) {
+      return &rings_[i];
+    }
+  }
+  return NULL;
+}
+
+void CrashAnnotations::UnregisterThread(ThreadRing* ring) {
+  // A free ring is left empty, so that the next thread to take it starts
+  // without the old annotations.
+  __atomic_store_n(&ring->count_, 0, __ATOMIC_RELAXED);
+  __atomic_store_n(&ring->owner_, 0, __ATOMIC_RELEASE);
+}
+
+void CrashAnnotations::ThreadRing::Record(const char* key,
+                                          const char* value) {
+  const uint32_t sequence = count_;
+  Entry* entry = &entries_[sequence % kRecordsPerThread];
+
+  // The entry is marked busy while it is written, so that a dump of a
+  // thread stopped halfway through leaves it out.
+  __atomic_store_n(&entry->busy, 1, __ATOMIC_RELAXED);
+  __atomic_thread_fence(__ATOMIC_RELEASE);
+  __atomic_store_n(&entry->sequence, sequence, __ATOMIC_RELAXED);
+  my_strlcpy(entry->key, key, kKeySize);
+  my_strlcpy(entry->value, value, kValueSize);
+  __atomic_store_n(&entry->busy, 0, __ATOMIC_RELEASE);
+  __atomic_store_n(&count_, sequence + 1, __ATOMIC_RELEASE);
+}
+
+size_t CrashAnnotations::GetAnnotations(MDRawAnnotation* annotations,
+                                        size_t max_annotations) const {
+  size_t copied = 0;
+  for (size_t i = 0; i < kMaxThreads; ++i) {
+    const ThreadRing& ring = rings_[i];
+    const int32_t owner = __atomic_load_n(&ring.owner_, __ATOMIC_ACQUIRE);
+    if (!owner)
+      continue;
+    const uint32_t count = __atomic_load_n(&ring.count_, __ATOMIC_ACQUIRE);
+    const uint32_t first =
+        count > kRecordsPerThread ? count - kRecordsPerThread : 0;
+    for (uint32_t sequence = first;
+         sequence < count && copied < max_annotations; ++sequence) {
+      const ThreadRing::Entry& entry =
+          ring.entries_[sequence % kRecordsPerThread];
+      if (__atomic_load_n(&entry.busy, __ATOMIC_ACQUIRE) ||
+          __atomic_load_n(&entry.sequence, __ATOMIC_RELAXED) != sequence) {
+        continue;
+      }
+      MDRawAnnotation* annotation = &annotations[copied];
+      annotation->thread_id = owner;
+      annotation->sequence = sequence;
+      my_memcpy(annotation->key, entry.key, kKeySize);
+      annotation->key[kKeySize - 1] = '\0';
+      my_memcpy(annotation->value, entry.value, kValueSize);
+      annotation->value[kValueSize - 1] = '\0';
+
+      // The owner may have started writing over the entry while it was
+      // copied, if it is still running.
+      __atomic_thread_fence(__ATOMIC_ACQUIRE);
+      if (!__atomic_load_n(&entry.busy, __ATOMIC_RELAXED) &&
+          __atomic_load_n(&entry.sequence, __ATOMIC_RELAXED) == sequence) {
+        ++copied;
+      }
+    }
+  }
+  return copied;
+}
+
+}  // namespace google_breakpad
@@ -0,0 +1,125 @@
+// Copyright (c) 2016 Google Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+// notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above
+// copyright notice, this list of conditions and the following disclaimer
+// in the documentation and/or other materials provided with the
+// distribution.
+//     * Neither the name of Google Inc. nor the names of its
+// contributors may be used to endorse or promote products derived from
+// this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+// crash_annotations.h: CrashAnnotations, preallocated per-thread rings of
+// key/value annotations that are written to a minidump's
+// MD_LINUX_ANNOTATIONS stream.
+//
+// A thread registers once, which gives it a ring of its own, and then
+// records annotations into its ring, such as the request it is serving,
+// without locks, system calls or allocation.  Each ring keeps the last
+// kRecordsPerThread annotations of its thread.  When a dump is written the
+// rings are read from the crashing process, so annotations recorded up to
+// the crash are included even when the dump is written by a helper process
+// started earlier.
+//
+// All of the annotations live inside the CrashAnnotations object, which
+// should be created early and outlive the threads that use it; it is
+// handed to the ExceptionHandler with set_crash_annotations().
+
+#ifndef CLIENT_LINUX_MINIDUMP_WRITER_CRASH_ANNOTATIONS_H_
+#define CLIENT_LINUX_MINIDUMP_WRITER_CRASH_ANNOTATIONS_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "google_breakpad/common/minidump_format.h"
+
+namespace google_breakpad {
+
+class CrashAnnotations {
+ public:
+  static const size_t kMaxThreads = 64;
+  static const size_t kRecordsPerThread = 8;
+  static const size_t kKeySize = MD_ANNOTATION_KEY_SIZE;
+  static const size_t kValueSize = MD_ANNOTATION_VALUE_SIZE;
+
+  class ThreadRing;
+
+  CrashAnnotations();
+
+  // Gives the calling thread a ring to record annotations into, or returns
+  // NULL if all kMaxThreads rings are taken.  A thread should register once
+  // and keep the ring, and must call UnregisterThread before it exits.
+  // Async-signal safe.
+  ThreadRing* RegisterThread();
+
+  // Releases |ring|, dropping its annotations.  Async-signal safe.
+  void UnregisterThread(ThreadRing* ring);
+
+  // Copies the annotations of every ring, each ring's oldest first, into
+  // |annotations|, up to |max_annotations| of them, and returns the number
+  // copied.  Annotations being recorded at the time are left out.  Called
+  // by the minidump writer, on a copy of the object read from the crashing
+  // process.  Async-signal safe.
+  size_t GetAnnotations(MDRawAnnotation* annotations,
+                        size_t max_annotations) const;
+
+  // The most annotations that GetAnnotations() can return.
+  static size_t max_annotations() {
+    return kMaxThreads * kRecordsPerThread;
+  }
+
+  class ThreadRing {
+   public:
+    // Records |value| under |key|, replacing the oldest annotation in the
+    // ring once it is full.  Both strings are truncated to fit.  Must only
+    // be called by the thread that owns the ring.  Async-signal safe.
+    void Record(const char* key, const char* value);
+
+   private:
+    friend class CrashAnnotations;
+
+    struct Entry {
+      // Set while the entry is being written.
+      uint32_t busy;
+      // The number of the annotation the entry holds.
+      uint32_t sequence;
+      char key[kKeySize];
+      char value[kValueSize];
+    };
+
+    // The id of the owning thread, or 0 if the ring is free.
+    int32_t owner_;
+    // The number of annotations recorded since the ring was taken.
+    uint32_t count_;
+    Entry entries_[kRecordsPerThread];
+  };
+
+ private:
+  ThreadRing rings_[kMaxThreads];
+
+  // Disallow copy constructor and assignment operator.
+  CrashAnnotations(const CrashAnnotations&);
+  void operator=(const CrashAnnotations&);
+};
+
+}  // namespace google_breakpad
+
+#endif  // CLIENT_LINUX_MINIDUMP_WRITER_CRASH_ANNOTATIONS_H_
@@ -0,0 +1,176 @@
+// Copyright (c) 2016 Google Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+// notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above
+// copyright notice, this list of conditions and the following disclaimer
+// in the documentation and/or other materials provided with the
+// distribution.
+//     * Neither the name of Google Inc. nor the names of its
+// contributors may be used to endorse or promote products derived from
+// this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+// crash_annotations_unittest.cc:
+// Unit tests for google_breakpad::CrashAnnotations.
+
+#include <pthread.h>
+#include <string.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <string>
+#include <vector>
+
+#include "breakpad_googletest_includes.h"
+#include "client/linux/minidump_writer/crash_annotations.h"
+
+using namespace google_breakpad;
+
+namespace {
+
+typedef testing::Test CrashAnnotationsTest;
+
+// Returns all annotations in |annotations|.
+std::vector<MDRawAnnotation> GetAll(const CrashAnnotations& annotations) {
+  std::vector<MDRawAnnotation> records(CrashAnnotations::max_annotations());
+  records.resize(annotations.GetAnnotations(&records[0], records.size()));
+  return records;
+}
+
+TEST(CrashAnnotationsTest, RecordsOldestFirst) {
+  CrashAnnotations annotations;
+  EXPECT_TRUE(GetAll(annotations).empty());
+
+  CrashAnnotations::ThreadRing* ring = annotations.RegisterThread();
+  ASSERT_TRUE(ring);
+  ring->Record("request", "1");
+  ring->Record("user", "2");
+
+  std::vector<MDRawAnnotation> records = GetAll(annotations);
+  ASSERT_EQ(2U, records.size());
+  EXPECT_EQ(static_cast<uint32_t>(syscall(__NR_gettid)),
+            records[0].thread_id);
+  EXPECT_EQ(0U, records[0].sequence);
+  EXPECT_STREQ("request", records[0].key);
+  EXPECT_STREQ("1", records[0].value);
+  EXPECT_EQ(1U, records[1].sequence);
+  EXPECT_STREQ("user", records[1].key);
+  EXPECT_STREQ("2", records[1].value);
+
+  annotations.UnregisterThread(ring);
+  EXPECT_TRUE(GetAll(annotations).empty());
+}
+
+TEST(CrashAnnotationsTest, KeepsLastRecords) {
+  CrashAnnotations annotations;
+  CrashAnnotations::ThreadRing* ring = annotations.RegisterThread();
+  ASSERT_TRUE(ring);
+  const size_t kCount = CrashAnnotations::kRecordsPerThread * 3 + 1;
+  for (size_t i = 0; i < kCount; ++i) {
+    char value[16];
+    snprintf(value, sizeof(value), "%zu", i);
+    ring->Record("i", value);
+  }
+
+  std::vector<MDRawAnnotation> records = GetAll(annotations);
+  ASSERT_EQ(CrashAnnotations::kRecordsPerThread, records.size());
+  for (size_t i = 0; i < records.size(); ++i) {
+    const size_t sequence = kCount - records.size() + i;
+    char value[16];
+    snprintf(value, sizeof(value), "%zu", sequence);
+    EXPECT_EQ(sequence, records[i].sequence);
+    EXPECT_STREQ(value, records[i].value);
+  }
+
+  // At most max_annotations are copied.
+  MDRawAnnotation record;
+  EXPECT_EQ(1U, annotations.GetAnnotations(&record, 1));
+  EXPECT_EQ(kCount - CrashAnnotations::kRecordsPerThread, record.sequence);
+}
+
+TEST(CrashAnnotationsTest, TruncatesStrings) {
+  CrashAnnotations annotations;
+  CrashAnnotations::ThreadRing* ring = annotations.RegisterThread();
+  ASSERT_TRUE(ring);
+  const std::string key(CrashAnnotations::kKeySize * 2, 'k');
+  const std::string value(CrashAnnotations::kValueSize * 2, 'v');
+  ring->Record(key.c_str(), value.c_str());
+
+  std::vector<MDRawAnnotation> records = GetAll(annotations);
+  ASSERT_EQ(1U, records.size());
+  EXPECT_EQ(key.substr(0, CrashAnnotations::kKeySize - 1), records[0].key);
+  EXPECT_EQ(value.substr(0, CrashAnnotations::kValueSize - 1),
+            records[0].value);
+}
+
+TEST(CrashAnnotationsTest, RunsOutOfRings) {
+  CrashAnnotations annotations;
+  std::vector<CrashAnnotations::ThreadRing*> rings;
+  for (size_t i = 0; i < CrashAnnotations::kMaxThreads; ++i) {
+    rings.push_back(annotations.RegisterThread());
+    ASSERT_TRUE(rings.back());
+  }
+  EXPECT_FALSE(annotations.RegisterThread());
+
+  // A released ring can be taken again, and is empty.
+  rings[3]->Record("old", "value");
+  annotations.UnregisterThread(rings[3]);
+  EXPECT_EQ(rings[3], annotations.RegisterThread());
+  EXPECT_TRUE(GetAll(annotations).empty());
+}
+
+struct RecorderArgs {
+  CrashAnnotations* annotations;
+  int records;
+};
+
+void* Recorder(void* arg) {
+  RecorderArgs* args = static_cast<RecorderArgs*>(arg);
+  CrashAnnotations::ThreadRing* ring = args->annotations->RegisterThread();
+  if (!ring)
+    return NULL;
+  for (int i = 0; i < args->records; ++i)
+    ring->Record("thread", "busy");
+  return ring;
+}
+
+TEST(CrashAnnotationsTest, ManyThreads) {
+  CrashAnnotations annotations;
+  RecorderArgs args = { &annotations, 1000 };
+  const size_t kThreads = 8;
+  pthread_t threads[kThreads];
+  for (size_t i = 0; i < kThreads; ++i)
+    ASSERT_EQ(0, pthread_create(&threads[i], NULL, Recorder, &args));
+  // Reading while the threads record only leaves out entries in progress.
+  for (int i = 0; i < 100; ++i) {
+    std::vector<MDRawAnnotation> records = GetAll(annotations);
+    for (size_t j = 0; j < records.size(); ++j)
+      EXPECT_STREQ("busy", records[j].value);
+  }
+  for (size_t i = 0; i < kThreads; ++i) {
+    void* ring;
+    ASSERT_EQ(0, pthread_join(threads[i], &ring));
+    EXPECT_TRUE(ring);
+  }
+  EXPECT_EQ(kThreads * CrashAnnotations::kRecordsPerThread,
+            GetAll(annotations).size());
+}
+
+}  // namespace
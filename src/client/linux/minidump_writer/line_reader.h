@@ -46,7 +46,26 @@ class LineReader {
   LineReader(int fd)
       : fd_(fd),
         hit_eof_(false),
-        buf_used_(0) {
+        buf_(inline_buf_),
+        buf_size_(sizeof(inline_buf_)),
+        buf_start_(0),
+        buf_used_(0),
+        buf_scanned_(0) {
+  }
+
+  // Same as above, but reads through |buffer|, which must outlive the
+  // reader, instead of an internal buffer of kMaxLineLen bytes.  The longest
+  // line that can be read is one byte shorter than |buffer_size|.  A large
+  // buffer cuts down on the number of reads needed for long files, such as
+  // /proc/<pid>/maps of processes with many mappings.
+  LineReader(int fd, char* buffer, unsigned buffer_size)
+      : fd_(fd),
+        hit_eof_(false),
+        buf_(buffer),
+        buf_size_(buffer_size),
+        buf_start_(0),
+        buf_used_(0),
+        buf_scanned_(0) {
   }
 
   // The maximum length of a line.
@@ -66,26 +85,36 @@ class LineReader {
       if (buf_used_ == 0 && hit_eof_)
         return false;
 
-      for (unsigned i = 0; i < buf_used_; ++i) {
-        if (buf_[i] == '\n' || buf_[i] == 0) {
-          buf_[i] = 0;
+      char* const data = buf_ + buf_start_;
+      for (unsigned i = buf_scanned_; i < buf_used_; ++i) {
+        if (data[i] == '\n' || data[i] == 0) {
+          data[i] = 0;
           *len = i;
-          *line = buf_;
+          *line = data;
           return true;
         }
       }
+      // Don't scan the same bytes again after reading more data.
+      buf_scanned_ = buf_used_;
 
-      if (buf_used_ == sizeof(buf_)) {
+      if (buf_used_ == buf_size_) {
         // we scanned the whole buffer and didn't find an end-of-line marker.
         // This line is too long to process.
         return false;
       }
 
+      // Move the incomplete line to the start of the buffer, to make room
+      // for the rest of it.
+      if (buf_start_) {
+        my_memmove(buf_, data, buf_used_);
+        buf_start_ = 0;
+      }
+
       // We didn't find any end-of-line terminators in the buffer. However, if
       // this is the last line in the file it might not have one:
       if (hit_eof_) {
         assert(buf_used_);
-        // There's room for the NUL because of the buf_used_ == sizeof(buf_)
+        // There's room for the NUL because of the buf_used_ == buf_size_
         // check above.
         buf_[buf_used_] = 0;
         *len = buf_used_;
@@ -96,7 +125,7 @@ class LineReader {
 
       // Otherwise, we should pull in more data from the file
       const ssize_t n = sys_read(fd_, buf_ + buf_used_,
-                                 sizeof(buf_) - buf_used_);
+                                 buf_size_ - buf_used_);
       if (n < 0) {
         return false;
       } else if (n == 0) {
@@ -114,16 +143,31 @@ class LineReader {
     // len doesn't include the NUL byte at the end.
 
     assert(buf_used_ >= len + 1);
+    buf_start_ += len + 1;
     buf_used_ -= len + 1;
-    my_memmove(buf_, buf_ + len + 1, buf_used_);
+    buf_scanned_ = 0;
+    if (buf_used_ == 0)
+      buf_start_ = 0;
   }
 
  private:
   const int fd_;
 
   bool hit_eof_;
+
+  // The buffer, and the offset and length of its unconsumed data.  Lines are
+  // popped by moving |buf_start_| forward, so data is only moved when a
+  // line straddles the end of the buffer.
+  char* const buf_;
+  const unsigned buf_size_;
+  unsigned buf_start_;
   unsigned buf_used_;
-  char buf_[kMaxLineLen];
+
+  // How much of the first unconsumed line has already been searched for its
+  // end.
+  unsigned buf_scanned_;
+
+  char inline_buf_[kMaxLineLen];
 };
 
 }  // namespace google_breakpad
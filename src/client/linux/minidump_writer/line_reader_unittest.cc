@@ -167,3 +167,34 @@ TEST(LineReaderTest, TooLong) {
   unsigned len;
   ASSERT_FALSE(reader.GetNextLine(&line, &len));
 }
+
+TEST(LineReaderTest, ExternalBufferRefills) {
+  // Lines straddle the end of the small buffer and have to be moved.
+  ScopedTestFile file("abc\ndefgh\nij\nklmnop");
+  ASSERT_TRUE(file.IsOk());
+  char buffer[8];
+  LineReader reader(file.GetFd(), buffer, sizeof(buffer));
+
+  const char* const expected[] = { "abc", "defgh", "ij", "klmnop" };
+  const char *line;
+  unsigned len;
+  for (size_t i = 0; i < sizeof(expected) / sizeof(expected[0]); ++i) {
+    ASSERT_TRUE(reader.GetNextLine(&line, &len));
+    ASSERT_EQ(strlen(expected[i]), len);
+    ASSERT_STREQ(expected[i], line);
+    reader.PopLine(len);
+  }
+
+  ASSERT_FALSE(reader.GetNextLine(&line, &len));
+}
+
+TEST(LineReaderTest, ExternalBufferTooLong) {
+  ScopedTestFile file("abcdefgh\n");
+  ASSERT_TRUE(file.IsOk());
+  char buffer[8];
+  LineReader reader(file.GetFd(), buffer, sizeof(buffer));
+
+  const char *line;
+  unsigned len;
+  ASSERT_FALSE(reader.GetNextLine(&line, &len));
+}
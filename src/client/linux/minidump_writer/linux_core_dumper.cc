@@ -53,6 +53,17 @@ LinuxCoreDumper::LinuxCoreDumper(pid_t pid,
   assert(core_path_);
 }
 
+LinuxCoreDumper::LinuxCoreDumper(pid_t pid,
+                                 const MemoryRange& core_content,
+                                 const char* procfs_path)
+    : LinuxDumper(pid),
+      core_path_(NULL),
+      core_content_(core_content),
+      procfs_path_(procfs_path),
+      thread_infos_(&allocator_, 8) {
+  assert(!core_content_.IsEmpty());
+}
+
 bool LinuxCoreDumper::BuildProcPath(char* path, pid_t pid,
                                     const char* node) const {
   if (!path || !node)
@@ -124,12 +135,15 @@ bool LinuxCoreDumper::ThreadsResume() {
 }
 
 bool LinuxCoreDumper::EnumerateThreads() {
-  if (!mapped_core_file_.Map(core_path_, 0)) {
-    fprintf(stderr, "Could not map core dump file into memory\n");
-    return false;
+  if (core_path_) {
+    if (!mapped_core_file_.Map(core_path_, 0)) {
+      fprintf(stderr, "Could not map core dump file into memory\n");
+      return false;
+    }
+    core_content_ = mapped_core_file_.content();
   }
 
-  core_.SetContent(mapped_core_file_.content());
+  core_.SetContent(core_content_);
   if (!core_.IsValid()) {
     fprintf(stderr, "Invalid core dump file\n");
     return false;
@@ -49,6 +49,12 @@ class LinuxCoreDumper : public LinuxDumper {
   //     auxv, cmdline, environ, exe, maps, status
   LinuxCoreDumper(pid_t pid, const char* core_path, const char* procfs_path);
 
+  // Constructs a dumper as above, but with the core dump already in memory
+  // at |core_content|, e.g. as read from a pipe by ElfCoreStreamReader.
+  // |core_content| must outlive the dumper.
+  LinuxCoreDumper(pid_t pid, const MemoryRange& core_content,
+                  const char* procfs_path);
+
   // Implements LinuxDumper::BuildProcPath().
   // Builds a proc path for a certain pid for a node (/proc/<pid>/<node>).
   // |path| is a character array of at least NAME_MAX bytes to return the
@@ -100,9 +106,13 @@ class LinuxCoreDumper : public LinuxDumper {
   virtual bool EnumerateThreads();
 
  private:
-  // Path of the core dump file.
+  // Path of the core dump file, or NULL if the core dump was given as
+  // |core_content_|.
   const char* core_path_;
 
+  // Core dump content given to the constructor.
+  MemoryRange core_content_;
+
   // Path of the directory containing the proc files of the given process,
   // which is usually a copy of /proc/<pid>.
   const char* procfs_path_;
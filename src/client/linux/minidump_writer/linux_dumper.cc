@@ -41,10 +41,14 @@
 #include <elf.h>
 #include <fcntl.h>
 #include <limits.h>
+#include <sched.h>
 #include <stddef.h>
 #include <string.h>
+#include <sys/wait.h>
 
 #include "client/linux/minidump_writer/line_reader.h"
+#include "client/linux/minidump_writer/module_identifier_cache.h"
+#include "common/linux/eintr_wrapper.h"
 #include "common/linux/elfutils.h"
 #include "common/linux/file_id.h"
 #include "common/linux/linux_libc_support.h"
@@ -55,6 +59,7 @@
 static const char kMappedFileUnsafePrefix[] = "/dev/";
 static const char kDeletedSuffix[] = " (deleted)";
 static const char kReservedFlags[] = " ---p";
+static const unsigned kMapsReadBufferSize = 64 * 1024;
 
 inline static bool IsMappedFileOpenUnsafe(
     const google_breakpad::MappingInfo& mapping) {
@@ -79,19 +84,197 @@ LinuxDumper::LinuxDumper(pid_t pid)
       crash_thread_(pid),
       threads_(&allocator_, 8),
       mappings_(&allocator_),
-      auxv_(&allocator_, AT_MAX + 1) {
+      sorted_mappings_(&allocator_),
+      auxv_(&allocator_, AT_MAX + 1),
+      module_identifier_cache_(NULL),
+      image_header_buffer_(NULL),
+      precomputed_identifiers_(NULL),
+      identifier_queue_(NULL),
+      identifier_queue_size_(0),
+      identifier_queue_next_(0),
+      identifier_helper_count_(0) {
   // The passed-in size to the constructor (above) is only a hint.
   // Must call .resize() to do actual initialization of the elements.
   auxv_.resize(AT_MAX + 1);
 }
 
 LinuxDumper::~LinuxDumper() {
+  // The helpers write to memory from the allocator.
+  WaitForIdentifierHelpers();
 }
 
 bool LinuxDumper::Init() {
   return ReadAuxv() && EnumerateThreads() && EnumerateMappings();
 }
 
+namespace {
+
+// The bytes of a module's image that ElfFileIdentifierFromProcessMemory
+// reads first.  The usual linkers put the program headers and the build
+// ID note in the first page.
+const size_t kImageHeaderSize = 4096;
+
+// The largest note segment that is read from the process on its own.
+const size_t kMaxNoteSegmentSize = 64 * 1024;
+
+// The stack of each identifier helper.
+const size_t kIdentifierHelperStackSize = 16 * 1024;
+
+// ELF note names and descriptions are padded to 32-bit words.
+size_t NotePadding(size_t size) {
+  return (size + 3) & ~static_cast<size_t>(3);
+}
+
+// Reads the identifier of the module mapped from |offset| in the file at
+// |filename|.  Uses nothing but system calls, so that identifier helpers
+// can call it.
+bool ElfFileIdentifierFromFile(const char* filename, size_t offset,
+                               uint8_t identifier[sizeof(MDGUID)]) {
+  MemoryMappedFile mapped_file(filename, offset);
+  if (!mapped_file.data() || mapped_file.size() < SELFMAG)
+    return false;
+  return FileID::ElfFileIdentifierFromMappedFile(mapped_file.data(),
+                                                 identifier);
+}
+
+// Finds the first PT_NOTE segment of the ELF image whose first |size|
+// bytes are at |image|, and sets |*offset| and |*note_size| to where the
+// segment lies in the image.  Only a segment that is loaded at the same
+// offset as it has in the file is found, since that's where
+// FileID::ElfFileIdentifierFromMappedFile reads it.
+template<typename ElfClass>
+bool FindNoteSegment(const uint8_t* image, size_t size,
+                     size_t* offset, size_t* note_size) {
+  typedef typename ElfClass::Ehdr Ehdr;
+  typedef typename ElfClass::Phdr Phdr;
+
+  if (size < sizeof(Ehdr))
+    return false;
+  const Ehdr* elf_header = reinterpret_cast<const Ehdr*>(image);
+  if (elf_header->e_phentsize != sizeof(Phdr) ||
+      elf_header->e_phoff > size ||
+      elf_header->e_phnum > (size - elf_header->e_phoff) / sizeof(Phdr)) {
+    return false;
+  }
+
+  const Phdr* phdrs = reinterpret_cast<const Phdr*>(image +
+                                                    elf_header->e_phoff);
+  const Phdr* first_load = NULL;
+  const Phdr* note = NULL;
+  for (int i = 0; i < elf_header->e_phnum; ++i) {
+    if (phdrs[i].p_type == PT_LOAD && !first_load)
+      first_load = &phdrs[i];
+    else if (phdrs[i].p_type == PT_NOTE && !note)
+      note = &phdrs[i];
+  }
+  if (!first_load || !note || note->p_filesz == 0 ||
+      first_load->p_vaddr < first_load->p_offset) {
+    return false;
+  }
+
+  // The image is mapped from the start of the file, so the first loadable
+  // segment is at its file offset from the start of the image.
+  const uintptr_t image_vaddr = first_load->p_vaddr - first_load->p_offset;
+  if (note->p_vaddr < image_vaddr ||
+      note->p_vaddr - image_vaddr != note->p_offset) {
+    return false;
+  }
+  *offset = note->p_offset;
+  *note_size = note->p_filesz;
+  return true;
+}
+
+// Copies as much of the first NT_GNU_BUILD_ID note among the |size| bytes
+// of notes at |notes| as fits into |identifier|.
+template<typename ElfClass>
+bool BuildIDFromNotes(const uint8_t* notes, size_t size,
+                      uint8_t identifier[sizeof(MDGUID)]) {
+  typedef typename ElfClass::Nhdr Nhdr;
+
+  size_t offset = 0;
+  while (size - offset >= sizeof(Nhdr)) {
+    const Nhdr* note_header = reinterpret_cast<const Nhdr*>(notes + offset);
+    const size_t name_size = NotePadding(note_header->n_namesz);
+    const size_t desc_size = NotePadding(note_header->n_descsz);
+    const size_t left = size - offset - sizeof(Nhdr);
+    if (name_size > left || desc_size > left - name_size)
+      return false;
+    if (note_header->n_type == NT_GNU_BUILD_ID) {
+      if (note_header->n_descsz == 0)
+        return false;
+      const size_t copied = note_header->n_descsz < sizeof(MDGUID) ?
+          note_header->n_descsz : sizeof(MDGUID);
+      my_memset(identifier, 0, sizeof(MDGUID));
+      my_memcpy(identifier, notes + offset + sizeof(Nhdr) + name_size,
+                copied);
+      return true;
+    }
+    offset += sizeof(Nhdr) + name_size + desc_size;
+  }
+  return false;
+}
+
+}  // namespace
+
+bool LinuxDumper::ElfFileIdentifierFromProcessMemory(
+    const MappingInfo& mapping,
+    uint8_t identifier[sizeof(MDGUID)]) {
+  if (mapping.offset != 0 || mapping.size < SELFMAG)
+    return false;
+  if (!image_header_buffer_) {
+    image_header_buffer_ =
+        reinterpret_cast<uint8_t*>(allocator_.Alloc(kImageHeaderSize));
+    if (!image_header_buffer_)
+      return false;
+  }
+
+  const size_t header_size =
+      mapping.size < kImageHeaderSize ? mapping.size : kImageHeaderSize;
+  CopyFromProcess(image_header_buffer_, pid_,
+                  reinterpret_cast<const void*>(mapping.start_addr),
+                  header_size);
+  if (!IsValidElf(image_header_buffer_))
+    return false;
+
+  const int elf_class = ElfClass(image_header_buffer_);
+  size_t note_offset;
+  size_t note_size;
+  bool found = false;
+  if (elf_class == ELFCLASS32) {
+    found = FindNoteSegment<ElfClass32>(image_header_buffer_, header_size,
+                                        &note_offset, &note_size);
+  } else if (elf_class == ELFCLASS64) {
+    found = FindNoteSegment<ElfClass64>(image_header_buffer_, header_size,
+                                        &note_offset, &note_size);
+  }
+  if (!found || note_offset > mapping.size ||
+      note_size > mapping.size - note_offset) {
+    return false;
+  }
+
+  // The notes are almost always in the header already read.
+  const uint8_t* notes;
+  if (note_offset <= header_size && note_size <= header_size - note_offset) {
+    notes = image_header_buffer_ + note_offset;
+  } else {
+    if (note_size > kMaxNoteSegmentSize)
+      return false;
+    uint8_t* note_copy =
+        reinterpret_cast<uint8_t*>(allocator_.Alloc(note_size));
+    if (!note_copy)
+      return false;
+    CopyFromProcess(note_copy, pid_,
+                    reinterpret_cast<const void*>(mapping.start_addr +
+                                                  note_offset),
+                    note_size);
+    notes = note_copy;
+  }
+
+  if (elf_class == ELFCLASS32)
+    return BuildIDFromNotes<ElfClass32>(notes, note_size, identifier);
+  return BuildIDFromNotes<ElfClass64>(notes, note_size, identifier);
+}
+
 bool
 LinuxDumper::ElfFileIdentifierForMapping(const MappingInfo& mapping,
                                          bool member,
@@ -102,6 +285,11 @@ LinuxDumper::ElfFileIdentifierForMapping(const MappingInfo& mapping,
   if (IsMappedFileOpenUnsafe(mapping))
     return false;
 
+  if (module_identifier_cache_ &&
+      module_identifier_cache_->Lookup(mapping, identifier)) {
+    return true;
+  }
+
   // Special-case linux-gate because it's not a real file.
   if (my_strcmp(mapping.name, kLinuxGateLibraryName) == 0) {
     void* linux_gate = NULL;
@@ -126,12 +314,24 @@ LinuxDumper::ElfFileIdentifierForMapping(const MappingInfo& mapping,
   filename[filename_len] = '\0';
   bool filename_modified = HandleDeletedFileInMapping(filename);
 
-  MemoryMappedFile mapped_file(filename, mapping.offset);
-  if (!mapped_file.data() || mapped_file.size() < SELFMAG)
-    return false;
-
-  bool success =
-      FileID::ElfFileIdentifierFromMappedFile(mapped_file.data(), identifier);
+  PrecomputedIdentifier* precomputed = NULL;
+  if (member && precomputed_identifiers_)
+    precomputed = &precomputed_identifiers_[mapping_id];
+  if (precomputed && precomputed->state == kIdentifierQueued)
+    WaitForIdentifierHelpers();
+
+  bool success;
+  if (precomputed && precomputed->state != kIdentifierUnknown &&
+      precomputed->state != kIdentifierQueued) {
+    success = precomputed->state == kIdentifierFound;
+    my_memcpy(identifier, precomputed->identifier, sizeof(MDGUID));
+  } else {
+    // The build ID in the process's image is right even if the module's
+    // file has been replaced or deleted since it was loaded, and reading
+    // it saves opening and mapping the file.
+    success = ElfFileIdentifierFromProcessMemory(mapping, identifier) ||
+              ElfFileIdentifierFromFile(filename, mapping.offset, identifier);
+  }
   if (success && member && filename_modified) {
     mappings_[mapping_id]->name[filename_len -
                                 sizeof(kDeletedSuffix) + 1] = '\0';
@@ -140,6 +340,123 @@ LinuxDumper::ElfFileIdentifierForMapping(const MappingInfo& mapping,
   return success;
 }
 
+bool LinuxDumper::StartIdentifierHelpers(const unsigned int* mapping_ids,
+                                         size_t count,
+                                         unsigned int helper_count) {
+  if (precomputed_identifiers_ || helper_count == 0 || count == 0)
+    return false;
+  if (helper_count > kMaxIdentifierHelpers)
+    helper_count = kMaxIdentifierHelpers;
+
+  const size_t num_mappings = mappings_.size();
+  PrecomputedIdentifier* precomputed =
+      reinterpret_cast<PrecomputedIdentifier*>(
+          allocator_.Alloc(num_mappings * sizeof(PrecomputedIdentifier)));
+  unsigned int* queue =
+      reinterpret_cast<unsigned int*>(
+          allocator_.Alloc(count * sizeof(unsigned int)));
+  if (!precomputed || !queue)
+    return false;
+  my_memset(precomputed, 0, num_mappings * sizeof(PrecomputedIdentifier));
+
+  // Everything but reading the files is done here, since the helpers
+  // can't use the allocator, and may not be allowed to read the process.
+  size_t queue_size = 0;
+  for (size_t i = 0; i < count; ++i) {
+    const unsigned int mapping_id = mapping_ids[i];
+    if (mapping_id >= num_mappings)
+      continue;
+    const MappingInfo& mapping = *mappings_[mapping_id];
+    uint8_t cached[sizeof(MDGUID)];
+    if (IsMappedFileOpenUnsafe(mapping) ||
+        my_strcmp(mapping.name, kLinuxGateLibraryName) == 0 ||
+        my_strlen(mapping.name) >= NAME_MAX ||
+        (module_identifier_cache_ &&
+         module_identifier_cache_->Lookup(mapping, cached))) {
+      continue;
+    }
+    PrecomputedIdentifier* entry = &precomputed[mapping_id];
+    if (ElfFileIdentifierFromProcessMemory(mapping, entry->identifier)) {
+      entry->state = kIdentifierFound;
+    } else {
+      entry->state = kIdentifierQueued;
+      queue[queue_size++] = mapping_id;
+    }
+  }
+  precomputed_identifiers_ = precomputed;
+  identifier_queue_ = queue;
+  identifier_queue_size_ = queue_size;
+  identifier_queue_next_ = 0;
+  if (queue_size == 0)
+    return true;
+
+  if (helper_count > queue_size)
+    helper_count = queue_size;
+  for (unsigned int i = 0; i < helper_count; ++i) {
+    uint8_t* stack = reinterpret_cast<uint8_t*>(
+        allocator_.Alloc(kIdentifierHelperStackSize));
+    if (!stack)
+      break;
+    // clone() needs the top-most address, aligned for any call.
+    stack += kIdentifierHelperStackSize;
+    stack -= reinterpret_cast<uintptr_t>(stack) & 15;
+    const pid_t helper = sys_clone(
+        IdentifierHelperMain, stack,
+        CLONE_VM | CLONE_FS | CLONE_FILES | CLONE_UNTRACED,
+        this, NULL, NULL, NULL);
+    if (helper == -1)
+      break;
+    identifier_helpers_[identifier_helper_count_++] = helper;
+  }
+  if (identifier_helper_count_ > 0)
+    return true;
+
+  // Without helpers, the files are read as they would have been.
+  for (size_t i = 0; i < queue_size; ++i)
+    precomputed[queue[i]].state = kIdentifierUnknown;
+  identifier_queue_size_ = 0;
+  return false;
+}
+
+void LinuxDumper::WaitForIdentifierHelpers() {
+  for (unsigned int i = 0; i < identifier_helper_count_; ++i)
+    HANDLE_EINTR(sys_waitpid(identifier_helpers_[i], NULL, __WALL));
+  identifier_helper_count_ = 0;
+
+  // A helper that died left its mapping queued.
+  for (size_t i = 0; i < identifier_queue_size_; ++i) {
+    PrecomputedIdentifier* entry =
+        &precomputed_identifiers_[identifier_queue_[i]];
+    if (entry->state == kIdentifierQueued)
+      entry->state = kIdentifierUnknown;
+  }
+}
+
+// static
+int LinuxDumper::IdentifierHelperMain(void* arg) {
+  LinuxDumper* dumper = reinterpret_cast<LinuxDumper*>(arg);
+  while (true) {
+    const size_t next =
+        __sync_fetch_and_add(&dumper->identifier_queue_next_, 1);
+    if (next >= dumper->identifier_queue_size_)
+      break;
+    const unsigned int mapping_id = dumper->identifier_queue_[next];
+    const MappingInfo& mapping = *dumper->mappings_[mapping_id];
+    PrecomputedIdentifier* entry =
+        &dumper->precomputed_identifiers_[mapping_id];
+
+    char filename[NAME_MAX];
+    my_strlcpy(filename, mapping.name, sizeof(filename));
+    dumper->HandleDeletedFileInMapping(filename);
+    const bool found = ElfFileIdentifierFromFile(filename, mapping.offset,
+                                                 entry->identifier);
+    // The identifier is written before the state that says it's there.
+    __sync_synchronize();
+    entry->state = found ? kIdentifierFound : kIdentifierNotFound;
+  }
+  return 0;
+}
+
 namespace {
 bool ElfFileSoNameFromMappedFile(
     const void* elf_base, char* soname, size_t soname_size) {
@@ -302,12 +619,22 @@ bool LinuxDumper::EnumerateMappings() {
   const int fd = sys_open(maps_path, O_RDONLY, 0);
   if (fd < 0)
     return false;
-  LineReader* const line_reader = new(allocator_) LineReader(fd);
+  // Processes may have tens of thousands of mappings, so read the maps file
+  // in large chunks rather than a line's worth at a time.
+  char* const buffer =
+      static_cast<char*>(allocator_.Alloc(kMapsReadBufferSize));
+  LineReader* const line_reader =
+      new(allocator_) LineReader(fd, buffer, kMapsReadBufferSize);
+
+  // The inode of the file behind mappings_.back(), which every mapping
+  // merged into it must share.
+  uintptr_t back_inode = 0;
+  bool sorted = true;
 
   const char* line;
   unsigned line_len;
   while (line_reader->GetNextLine(&line, &line_len)) {
-    uintptr_t start_addr, end_addr, offset;
+    uintptr_t start_addr, end_addr, offset, inode = 0;
 
     const char* i1 = my_read_hex_ptr(&start_addr, line);
     if (*i1 == '-') {
@@ -316,6 +643,13 @@ bool LinuxDumper::EnumerateMappings() {
         bool exec = (*(i2 + 3) == 'x');
         const char* i3 = my_read_hex_ptr(&offset, i2 + 6 /* skip ' rwxp ' */);
         if (*i3 == ' ') {
+          // Skip the device to get to the inode.
+          const char* i4 = i3 + 1;
+          while (*i4 && *i4 != ' ')
+            ++i4;
+          if (*i4 == ' ')
+            my_read_decimal_ptr(&inode, i4 + 1);
+
           const char* name = NULL;
           // Only copy name if the name is a valid path name, or if
           // it's the VDSO image.
@@ -326,12 +660,14 @@ bool LinuxDumper::EnumerateMappings() {
             offset = 0;
           }
           // Merge adjacent mappings with the same name into one module,
-          // assuming they're a single library mapped by the dynamic linker
+          // assuming they're a single library mapped by the dynamic linker.
+          // Comparing inodes first rules out most candidates without
+          // comparing names.
           if (name && !mappings_.empty()) {
             MappingInfo* module = mappings_.back();
             if ((start_addr == module->start_addr + module->size) &&
-                (my_strlen(name) == my_strlen(module->name)) &&
-                (my_strncmp(name, module->name, my_strlen(name)) == 0)) {
+                inode == back_inode &&
+                (my_strcmp(name, module->name) == 0)) {
               module->size = end_addr - module->start_addr;
               line_reader->PopLine(line_len);
               continue;
@@ -365,6 +701,13 @@ bool LinuxDumper::EnumerateMappings() {
             if (l < sizeof(module->name))
               my_memcpy(module->name, name, l);
           }
+          // The maps file lists mappings in address order, which makes
+          // |sorted_mappings_| an index for FindMapping.
+          if (!sorted_mappings_.empty() &&
+              sorted_mappings_.back()->start_addr >= start_addr) {
+            sorted = false;
+          }
+          sorted_mappings_.push_back(module);
           // If this is the entry-point mapping, and it's not already the
           // first one, then we need to make it be first.  This is because
           // the minidump format assumes the first module is the one that
@@ -383,6 +726,7 @@ bool LinuxDumper::EnumerateMappings() {
             mappings_[0] = module;
           } else {
             mappings_.push_back(module);
+            back_inode = inode;
           }
         }
       }
@@ -392,6 +736,9 @@ bool LinuxDumper::EnumerateMappings() {
 
   sys_close(fd);
 
+  if (!sorted)
+    sorted_mappings_.clear();
+
   return !mappings_.empty();
 }
 
@@ -426,6 +773,27 @@ bool LinuxDumper::GetStackInfo(const void** stack, size_t* stack_len,
 const MappingInfo* LinuxDumper::FindMapping(const void* address) const {
   const uintptr_t addr = (uintptr_t) address;
 
+  // Binary search the index, when it covers every mapping, for the last
+  // mapping starting at or below |addr|.
+  if (!sorted_mappings_.empty() &&
+      sorted_mappings_.size() == mappings_.size()) {
+    size_t low = 0;
+    size_t high = sorted_mappings_.size();
+    while (low < high) {
+      const size_t mid = low + (high - low) / 2;
+      if (sorted_mappings_[mid]->start_addr <= addr)
+        low = mid + 1;
+      else
+        high = mid;
+    }
+    if (low == 0)
+      return NULL;
+    const MappingInfo* mapping = sorted_mappings_[low - 1];
+    if (addr - mapping->start_addr < mapping->size)
+      return mapping;
+    return NULL;
+  }
+
   for (size_t i = 0; i < mappings_.size(); ++i) {
     const uintptr_t start = static_cast<uintptr_t>(mappings_[i]->start_addr);
     if (addr >= start && addr - start < mappings_[i]->size)
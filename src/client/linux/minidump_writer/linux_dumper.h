@@ -51,6 +51,8 @@
 
 namespace google_breakpad {
 
+class ModuleIdentifierCache;
+
 // Typedef for our parsing of the auxv variables in /proc/pid/auxv.
 #if defined(__i386) || defined(__ARM_EABI__) || defined(__mips__)
 typedef Elf32_auxv_t elf_aux_entry;
@@ -74,6 +76,9 @@ class LinuxDumper {
   // Parse the data for |threads| and |mappings|.
   virtual bool Init();
 
+  // The process being dumped.
+  pid_t pid() const { return pid_; }
+
   // Return true if the dumper performs a post-mortem dump.
   virtual bool IsPostMortem() const = 0;
 
@@ -113,11 +118,39 @@ class LinuxDumper {
   // Generate a File ID from the .text section of a mapped entry.
   // If not a member, mapping_id is ignored. This method can also manipulate the
   // |mapping|.name to truncate "(deleted)" from the file name if necessary.
+  // Identifiers found in the module identifier cache, if one is set, are
+  // used without opening the mapped file, and so are build IDs read from the
+  // module's image in the process's memory.
   bool ElfFileIdentifierForMapping(const MappingInfo& mapping,
                                    bool member,
                                    unsigned int mapping_id,
                                    uint8_t identifier[sizeof(MDGUID)]);
 
+  // Sets a cache of precomputed module identifiers, which must describe the
+  // modules of the dumped process. The cache is not owned and may be NULL.
+  void set_module_identifier_cache(const ModuleIdentifierCache* cache) {
+    module_identifier_cache_ = cache;
+  }
+
+  // The most helpers that StartIdentifierHelpers() starts.
+  static const unsigned int kMaxIdentifierHelpers = 8;
+
+  // Starts computing the identifiers of the |count| members of mappings()
+  // at |mapping_ids| on up to |helper_count| helper tasks, so that the
+  // modules' files, which can be slow to open and read, are read while
+  // the caller goes on with the dump.  The helpers share the dumper's
+  // address space, and use only system calls and memory set aside for
+  // them here.  Identifiers that don't need the files are found before
+  // this returns.  ElfFileIdentifierForMapping() uses the results for
+  // those mappings, waiting for the helpers if need be.  Returns false if
+  // no helper could be started, in which case the files are read as
+  // usual.
+  bool StartIdentifierHelpers(const unsigned int* mapping_ids, size_t count,
+                              unsigned int helper_count);
+
+  // Waits for the helpers started by StartIdentifierHelpers() to finish.
+  void WaitForIdentifierHelpers();
+
   uintptr_t crash_address() const { return crash_address_; }
   void set_crash_address(uintptr_t crash_address) {
     crash_address_ = crash_address;
@@ -158,6 +191,35 @@ class LinuxDumper {
   // Returns true if |path| is modified.
   bool HandleDeletedFileInMapping(char* path) const;
 
+  // Reads the build ID note of the module whose image starts at |mapping|
+  // from the process's memory into |identifier|, as
+  // FileID::ElfFileIdentifierFromMappedFile would find it in the module's
+  // file.  Returns false if the image has no build ID in its first note
+  // segment, or can't be read, in which case the file should be used.
+  bool ElfFileIdentifierFromProcessMemory(const MappingInfo& mapping,
+                                          uint8_t identifier[sizeof(MDGUID)]);
+
+  // What StartIdentifierHelpers() learned of a mapping's identifier.
+  struct PrecomputedIdentifier {
+    // kIdentifierUnknown and so on, below.  Set by the helpers once
+    // |identifier| is written.
+    volatile int state;
+    uint8_t identifier[sizeof(MDGUID)];
+  };
+
+  enum {
+    // ElfFileIdentifierForMapping() computes the identifier itself.
+    kIdentifierUnknown,
+    // A helper has yet to read the module's file.
+    kIdentifierQueued,
+    kIdentifierFound,
+    kIdentifierNotFound
+  };
+
+  // The body of a helper started by StartIdentifierHelpers(), where |arg|
+  // is the dumper.
+  static int IdentifierHelperMain(void* arg);
+
    // ID of the crashed process.
   const pid_t pid_;
 
@@ -178,8 +240,32 @@ class LinuxDumper {
   // Info from /proc/<pid>/maps.
   wasteful_vector<MappingInfo*> mappings_;
 
+  // The same mappings in address order, for FindMapping. Empty if the maps
+  // file was not in address order.
+  wasteful_vector<MappingInfo*> sorted_mappings_;
+
   // Info from /proc/<pid>/auxv
   wasteful_vector<elf_aux_val_t> auxv_;
+
+  // Precomputed module identifiers, or NULL.
+  const ModuleIdentifierCache* module_identifier_cache_;
+
+  // Holds the start of a module's image read from the process by
+  // ElfFileIdentifierFromProcessMemory, allocated on first use.
+  uint8_t* image_header_buffer_;
+
+  // One for each mapping once StartIdentifierHelpers() is called, or NULL.
+  PrecomputedIdentifier* precomputed_identifiers_;
+
+  // The mappings whose modules' files the helpers read, and the index in
+  // |identifier_queue_| of the next one for a helper to take.
+  unsigned int* identifier_queue_;
+  size_t identifier_queue_size_;
+  size_t identifier_queue_next_;
+
+  // The process IDs of the helpers that are yet to be waited for.
+  pid_t identifier_helpers_[kMaxIdentifierHelpers];
+  unsigned int identifier_helper_count_;
 };
 
 }  // namespace google_breakpad
@@ -47,8 +47,10 @@
 #include <stdlib.h>
 #include <string.h>
 #include <sys/ptrace.h>
+#include <sys/syscall.h>
 #include <sys/uio.h>
 #include <sys/wait.h>
+#include <unistd.h>
 
 #if defined(__i386)
 #include <cpuid.h>
@@ -59,20 +61,16 @@
 #include "common/linux/linux_libc_support.h"
 #include "third_party/lss/linux_syscall_support.h"
 
-// Suspends a thread by attaching to it.
-static bool SuspendThread(pid_t pid) {
-  // This may fail if the thread has just died or debugged.
-  errno = 0;
-  if (sys_ptrace(PTRACE_ATTACH, pid, NULL, NULL) != 0 &&
-      errno != 0) {
-    return false;
-  }
-  while (sys_waitpid(pid, NULL, __WALL) < 0) {
-    if (errno != EINTR) {
-      sys_ptrace(PTRACE_DETACH, pid, NULL, NULL);
-      return false;
-    }
-  }
+// Older kernel and libc headers lack these; PTRACE_SEIZE needs Linux 3.4.
+#ifndef PTRACE_SEIZE
+#define PTRACE_SEIZE 0x4206
+#endif
+#ifndef PTRACE_INTERRUPT
+#define PTRACE_INTERRUPT 0x4207
+#endif
+
+// Returns false if the stopped thread |pid| should be left out of the dump.
+static bool IsDumpableThread(pid_t pid) {
 #if defined(__i386) || defined(__x86_64)
   // On x86, the stack pointer is NULL or -1, when executing trusted code in
   // the seccomp sandbox. Not only does this cause difficulties down the line
@@ -89,23 +87,94 @@ static bool SuspendThread(pid_t pid) {
       !regs.rsp
 #endif
       ) {
-    sys_ptrace(PTRACE_DETACH, pid, NULL, NULL);
     return false;
   }
 #endif
   return true;
 }
 
-// Resumes a thread by detaching from it.
-static bool ResumeThread(pid_t pid) {
-  return sys_ptrace(PTRACE_DETACH, pid, NULL, NULL) >= 0;
+// Suspends a thread by attaching to it.
+static bool SuspendThread(pid_t pid) {
+  // This may fail if the thread has just died or debugged.
+  errno = 0;
+  if (sys_ptrace(PTRACE_ATTACH, pid, NULL, NULL) != 0 &&
+      errno != 0) {
+    return false;
+  }
+  while (sys_waitpid(pid, NULL, __WALL) < 0) {
+    if (errno != EINTR) {
+      sys_ptrace(PTRACE_DETACH, pid, NULL, NULL);
+      return false;
+    }
+  }
+  if (!IsDumpableThread(pid)) {
+    sys_ptrace(PTRACE_DETACH, pid, NULL, NULL);
+    return false;
+  }
+  return true;
+}
+
+// Starts suspending a thread by seizing and interrupting it, without waiting
+// for it to stop. Sets |*unsupported| if the kernel does not know
+// PTRACE_SEIZE.
+static bool SeizeThread(pid_t pid, bool* unsupported) {
+  *unsupported = false;
+  if (sys_ptrace(PTRACE_SEIZE, pid, NULL, NULL) != 0) {
+    *unsupported = errno == EIO;
+    return false;
+  }
+  if (sys_ptrace(PTRACE_INTERRUPT, pid, NULL, NULL) != 0) {
+    sys_ptrace(PTRACE_DETACH, pid, NULL, NULL);
+    return false;
+  }
+  return true;
+}
+
+// Waits for a thread started by SeizeThread to stop. A thread may stop to
+// have a signal delivered before the interrupt takes effect; it is just as
+// suspended, but the signal is stored in |*signal| so that resuming the
+// thread can deliver it.
+static bool WaitForSeizedThread(pid_t pid, int* signal) {
+  *signal = 0;
+  int status;
+  while (sys_waitpid(pid, &status, __WALL) < 0) {
+    if (errno != EINTR) {
+      sys_ptrace(PTRACE_DETACH, pid, NULL, NULL);
+      return false;
+    }
+  }
+  // The thread may have exited instead of stopping.
+  if (!WIFSTOPPED(status))
+    return false;
+  // The high bits are zero for a signal-delivery-stop, and hold
+  // PTRACE_EVENT_STOP for the interrupt.
+  if ((status >> 16) == 0)
+    *signal = WSTOPSIG(status);
+  if (!IsDumpableThread(pid)) {
+    sys_ptrace(PTRACE_DETACH, pid, NULL, reinterpret_cast<void*>(*signal));
+    return false;
+  }
+  return true;
+}
+
+// Resumes a thread by detaching from it, delivering |signal| if it is not
+// zero.
+static bool ResumeThread(pid_t pid, int signal) {
+  return sys_ptrace(PTRACE_DETACH, pid, NULL,
+                    reinterpret_cast<void*>(signal)) >= 0;
 }
 
 namespace google_breakpad {
 
 LinuxPtraceDumper::LinuxPtraceDumper(pid_t pid)
     : LinuxDumper(pid),
-      threads_suspended_(false) {
+      threads_suspended_(false),
+      resume_signals_(allocator(), 8),
+      mem_fd_(-1),
+      mem_fd_opened_(false),
+      process_vm_readv_unavailable_(false),
+      tgid_(-1),
+      ppid_(-1) {
 }
 
 bool LinuxPtraceDumper::BuildProcPath(char* path, pid_t pid,
@@ -130,37 +199,114 @@ bool LinuxPtraceDumper::BuildProcPath(char* path, pid_t pid,
   return true;
 }
 
+LinuxPtraceDumper::~LinuxPtraceDumper() {
+  if (mem_fd_ >= 0)
+    sys_close(mem_fd_);
+}
+
+// Copies the remote range with as few syscalls as possible. Most of the
+// memory a minidump needs, thread stacks in particular, comes in large
+// readable blocks, so the range is read in bulk with process_vm_readv, or
+// failing that with pread on /proc/<pid>/mem. Both stop at the first page
+// they cannot read; such pages are retried on their own with the next
+// method down, ending with one PTRACE_PEEKDATA per word, and whatever
+// cannot be read is zero-filled.
 void LinuxPtraceDumper::CopyFromProcess(void* dest, pid_t child,
                                         const void* src, size_t length) {
+  static const uintptr_t page_size = getpagesize();
+  uint8_t* const local = (uint8_t*) dest;
+  const uintptr_t remote = reinterpret_cast<uintptr_t>(src);
+  size_t done = 0;
+
+  while (done < length) {
+    size_t copied = ReadProcessVM(local + done, child, remote + done,
+                                  length - done);
+    if (copied == 0)
+      copied = ReadProcessMem(local + done, remote + done, length - done);
+    if (copied == 0) {
+      // Nothing could be read in bulk at remote + done. Deal with the rest
+      // of that page alone, so that the next page gets the fast path again.
+      const uintptr_t page_left =
+          page_size - ((remote + done) & (page_size - 1));
+      copied = (length - done > page_left) ? page_left : (length - done);
+      if (mem_fd_ >= 0) {
+        // /proc/<pid>/mem reads the same way PTRACE_PEEKDATA does, so the
+        // page is not readable at all.
+        my_memset(local + done, 0, copied);
+      } else {
+        PeekFromProcess(local + done, child, remote + done, copied);
+      }
+    }
+    done += copied;
+  }
+}
+
+size_t LinuxPtraceDumper::ReadProcessVM(uint8_t* dest, pid_t child,
+                                        uintptr_t src, size_t length) {
+#if defined(__NR_process_vm_readv)
+  if (process_vm_readv_unavailable_)
+    return 0;
+
+  struct kernel_iovec local_iov;
+  local_iov.iov_base = dest;
+  local_iov.iov_len = length;
+  struct kernel_iovec remote_iov;
+  remote_iov.iov_base = reinterpret_cast<void*>(src);
+  remote_iov.iov_len = length;
+  long result;
+  do {
+    result = syscall(__NR_process_vm_readv, child, &local_iov, 1,
+                     &remote_iov, 1, 0);
+  } while (result < 0 && errno == EINTR);
+  if (result > 0)
+    return result;
+  // EFAULT means an unreadable page; anything else means the call itself
+  // does not work for us (an old kernel, or a security policy that allows
+  // ptrace but not process_vm_readv), so stop trying it.
+  if (result < 0 && errno != EFAULT)
+    process_vm_readv_unavailable_ = true;
+#endif
+  return 0;
+}
+
+size_t LinuxPtraceDumper::ReadProcessMem(uint8_t* dest, uintptr_t src,
+                                         size_t length) {
+  if (!mem_fd_opened_) {
+    mem_fd_opened_ = true;
+    char mem_path[NAME_MAX];
+    if (BuildProcPath(mem_path, pid_, "mem"))
+      mem_fd_ = sys_open(mem_path, O_RDONLY, 0);
+  }
+  if (mem_fd_ < 0)
+    return 0;
+
+  ssize_t result;
+  do {
+    result = sys_pread64(mem_fd_, dest, length, static_cast<loff_t>(src));
+  } while (result < 0 && errno == EINTR);
+  return result > 0 ? result : 0;
+}
+
+void LinuxPtraceDumper::PeekFromProcess(uint8_t* dest, pid_t child,
+                                        uintptr_t src, size_t length) {
   unsigned long tmp = 55;
   size_t done = 0;
   static const size_t word_size = sizeof(tmp);
-  uint8_t* const local = (uint8_t*) dest;
-  uint8_t* const remote = (uint8_t*) src;
+  uint8_t* const remote = reinterpret_cast<uint8_t*>(src);
 
   while (done < length) {
     const size_t l = (length - done > word_size) ? word_size : (length - done);
     if (sys_ptrace(PTRACE_PEEKDATA, child, remote + done, &tmp) == -1) {
       tmp = 0;
     }
-    my_memcpy(local + done, &tmp, l);
+    my_memcpy(dest + done, &tmp, l);
     done += l;
   }
 }
 
-// Read thread info from /proc/$pid/status.
-// Fill out the |tgid|, |ppid| and |pid| members of |info|. If unavailable,
-// these members are set to -1. Returns true iff all three members are
-// available.
-bool LinuxPtraceDumper::GetThreadInfoByIndex(size_t index, ThreadInfo* info) {
-  if (index >= threads_.size())
-    return false;
-
-  pid_t tid = threads_[index];
-
-  assert(info != NULL);
+bool LinuxPtraceDumper::ReadProcessIds() {
   char status_path[NAME_MAX];
-  if (!BuildProcPath(status_path, tid, "status"))
+  if (!BuildProcPath(status_path, pid_, "status"))
     return false;
 
   const int fd = sys_open(status_path, O_RDONLY, 0);
@@ -171,22 +317,38 @@ bool LinuxPtraceDumper::GetThreadInfoByIndex(size_t index, ThreadInfo* info) {
   const char* line;
   unsigned line_len;
 
-  info->ppid = info->tgid = -1;
+  tgid_ = ppid_ = -1;
 
   while (line_reader->GetNextLine(&line, &line_len)) {
     if (my_strncmp("Tgid:\t", line, 6) == 0) {
-      my_strtoui(&info->tgid, line + 6);
+      my_strtoui(&tgid_, line + 6);
     } else if (my_strncmp("PPid:\t", line, 6) == 0) {
-      my_strtoui(&info->ppid, line + 6);
+      my_strtoui(&ppid_, line + 6);
     }
 
     line_reader->PopLine(line_len);
   }
   sys_close(fd);
 
-  if (info->ppid == -1 || info->tgid == -1)
+  return tgid_ != -1 && ppid_ != -1;
+}
+
+// Fill out the |tgid| and |ppid| members of |info| from /proc/$pid/status,
+// which is read for the first thread only: every thread in |threads_|
+// belongs to the same thread group, whose id and parent they share. The
+// registers are then read with ptrace.
+bool LinuxPtraceDumper::GetThreadInfoByIndex(size_t index, ThreadInfo* info) {
+  if (index >= threads_.size())
     return false;
 
+  pid_t tid = threads_[index];
+
+  assert(info != NULL);
+  if (tgid_ == -1 && !ReadProcessIds())
+    return false;
+  info->tgid = tgid_;
+  info->ppid = ppid_;
+
 #ifdef PTRACE_GETREGSET
   struct iovec io;
   io.iov_base = &info->regs;
@@ -227,14 +389,19 @@ bool LinuxPtraceDumper::GetThreadInfoByIndex(size_t index, ThreadInfo* info) {
 #endif  // defined(__i386)
 
 #if defined(__i386) || defined(__x86_64)
-  for (unsigned i = 0; i < ThreadInfo::kNumDebugRegisters; ++i) {
-    if (sys_ptrace(
-        PTRACE_PEEKUSER, tid,
-        reinterpret_cast<void*> (offsetof(struct user,
-                                          u_debugreg[0]) + i *
-                                 sizeof(debugreg_t)),
-        &info->dregs[i]) == -1) {
-      return false;
+  // DR7 says which of the breakpoint addresses in DR0-DR3 are enabled. A
+  // thread without hardware breakpoints, which is nearly every thread, has
+  // none, and only DR7 and the status in DR6 are read for it. DR4 and DR5
+  // are reserved and always read as zero.
+  my_memset(info->dregs, 0, sizeof(info->dregs));
+  if (!PeekDebugRegister(tid, 7, &info->dregs[7]) ||
+      !PeekDebugRegister(tid, 6, &info->dregs[6])) {
+    return false;
+  }
+  if (info->dregs[7] & kDR7EnableMask) {
+    for (unsigned i = 0; i < 4; ++i) {
+      if (!PeekDebugRegister(tid, i, &info->dregs[i]))
+        return false;
     }
   }
 #endif
@@ -270,6 +437,17 @@ bool LinuxPtraceDumper::GetThreadInfoByIndex(size_t index, ThreadInfo* info) {
   return true;
 }
 
+#if defined(__i386) || defined(__x86_64)
+bool LinuxPtraceDumper::PeekDebugRegister(pid_t tid, unsigned index,
+                                          debugreg_t* value) {
+  return sys_ptrace(
+      PTRACE_PEEKUSER, tid,
+      reinterpret_cast<void*>(offsetof(struct user, u_debugreg[0]) +
+                              index * sizeof(debugreg_t)),
+      value) != -1;
+}
+#endif
+
 bool LinuxPtraceDumper::IsPostMortem() const {
   return false;
 }
@@ -277,17 +455,46 @@ bool LinuxPtraceDumper::IsPostMortem() const {
 bool LinuxPtraceDumper::ThreadsSuspend() {
   if (threads_suspended_)
     return true;
+
+  // Seize and interrupt every thread before waiting for any of them, so
+  // that they all stop at about the same time and the process spends as
+  // little time as possible half stopped. Kernels without PTRACE_SEIZE get
+  // the old attach-and-wait for the remaining threads.
+  enum ThreadState { kLost, kSeized, kStopped };
+  wasteful_vector<uint8_t> states(allocator(), threads_.size());
+  bool use_seize = true;
   for (size_t i = 0; i < threads_.size(); ++i) {
-    if (!SuspendThread(threads_[i])) {
-      // If the thread either disappeared before we could attach to it, or if
-      // it was part of the seccomp sandbox's trusted code, it is OK to
-      // silently drop it from the minidump.
-      my_memmove(&threads_[i], &threads_[i+1],
-                 (threads_.size() - i - 1) * sizeof(threads_[i]));
-      threads_.resize(threads_.size() - 1);
-      --i;
+    if (use_seize) {
+      bool unsupported;
+      if (SeizeThread(threads_[i], &unsupported)) {
+        states.push_back(kSeized);
+        continue;
+      }
+      if (!unsupported) {
+        states.push_back(kLost);
+        continue;
+      }
+      use_seize = false;
     }
+    states.push_back(SuspendThread(threads_[i]) ? kStopped : kLost);
   }
+
+  // Collect the stops. If a thread either disappeared before we could
+  // suspend it, or if it was part of the seccomp sandbox's trusted code, it
+  // is OK to silently drop it from the minidump.
+  resume_signals_.clear();
+  size_t kept = 0;
+  for (size_t i = 0; i < threads_.size(); ++i) {
+    int signal = 0;
+    if (states[i] == kSeized && !WaitForSeizedThread(threads_[i], &signal))
+      states[i] = kLost;
+    if (states[i] == kLost)
+      continue;
+    threads_[kept++] = threads_[i];
+    resume_signals_.push_back(signal);
+  }
+  threads_.resize(kept);
+
   threads_suspended_ = true;
   return threads_.size() > 0;
 }
@@ -296,8 +503,11 @@ bool LinuxPtraceDumper::ThreadsResume() {
   if (!threads_suspended_)
     return false;
   bool good = true;
-  for (size_t i = 0; i < threads_.size(); ++i)
-    good &= ResumeThread(threads_[i]);
+  for (size_t i = 0; i < threads_.size(); ++i) {
+    int signal = i < resume_signals_.size() ? resume_signals_[i] : 0;
+    good &= ResumeThread(threads_[i], signal);
+  }
+  resume_signals_.clear();
   threads_suspended_ = false;
   return good;
 }
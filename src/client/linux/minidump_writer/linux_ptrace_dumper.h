@@ -44,6 +44,7 @@ class LinuxPtraceDumper : public LinuxDumper {
   // Constructs a dumper for extracting information of a given process
   // with a process ID of |pid|.
   explicit LinuxPtraceDumper(pid_t pid);
+  virtual ~LinuxPtraceDumper();
 
   // Implements LinuxDumper::BuildProcPath().
   // Builds a proc path for a certain pid for a node (/proc/<pid>/<node>).
@@ -54,8 +55,10 @@ class LinuxPtraceDumper : public LinuxDumper {
 
   // Implements LinuxDumper::CopyFromProcess().
   // Copies content of |length| bytes from a given process |child|,
-  // starting from |src|, into |dest|. This method uses ptrace to extract
-  // the content from the target process.
+  // starting from |src|, into |dest|. The content is read in bulk with
+  // process_vm_readv or from /proc/<pid>/mem where possible, and one word
+  // at a time with ptrace otherwise. Bytes that cannot be read are set to
+  // zero.
   virtual void CopyFromProcess(void* dest, pid_t child, const void* src,
                                size_t length);
 
@@ -70,7 +73,10 @@ class LinuxPtraceDumper : public LinuxDumper {
   virtual bool IsPostMortem() const;
 
   // Implements LinuxDumper::ThreadsSuspend().
-  // Suspends all threads in the given process. Returns true on success.
+  // Suspends all threads in the given process. Every thread is seized and
+  // interrupted before any is waited for, so the time to stop them all is
+  // set by the slowest thread rather than by their sum. Returns true on
+  // success.
   virtual bool ThreadsSuspend();
 
   // Implements LinuxDumper::ThreadsResume().
@@ -83,8 +89,50 @@ class LinuxPtraceDumper : public LinuxDumper {
   virtual bool EnumerateThreads();
 
  private:
+  // Helpers for CopyFromProcess(). ReadProcessVM() and ReadProcessMem()
+  // copy as much of the range as they can read in one go and return the
+  // number of bytes copied, which is zero if the first page of the range is
+  // unreadable or the method is unavailable. PeekFromProcess() copies the
+  // range one word at a time, zero-filling words that cannot be read.
+  size_t ReadProcessVM(uint8_t* dest, pid_t child, uintptr_t src,
+                       size_t length);
+  size_t ReadProcessMem(uint8_t* dest, uintptr_t src, size_t length);
+  void PeekFromProcess(uint8_t* dest, pid_t child, uintptr_t src,
+                       size_t length);
+
+  // Reads the thread group id and parent process id of the process from
+  // /proc/<pid>/status into |tgid_| and |ppid_|. Returns true on success.
+  bool ReadProcessIds();
+
+#if defined(__i386) || defined(__x86_64)
+  // The local and global enable bits of the breakpoints in DR0-DR3.
+  static const debugreg_t kDR7EnableMask = 0xff;
+
+  // Reads debug register |index| of thread |tid| into |value|. Returns
+  // true on success.
+  bool PeekDebugRegister(pid_t tid, unsigned index, debugreg_t* value);
+#endif
+
   // Set to true if all threads of the crashed process are suspended.
   bool threads_suspended_;
+
+  // For each suspended thread, a signal that it stopped for while being
+  // suspended and that resuming it should deliver, or zero.
+  wasteful_vector<int> resume_signals_;
+
+  // A descriptor for /proc/<pid>/mem, opened on first use, or -1 if it
+  // could not be opened.
+  int mem_fd_;
+  bool mem_fd_opened_;
+
+  // Set to true once process_vm_readv has failed for a reason other than
+  // an unreadable page.
+  bool process_vm_readv_unavailable_;
+
+  // The thread group id and parent process id shared by all threads of the
+  // process, read with the first thread's information, or -1 until then.
+  pid_t tgid_;
+  pid_t ppid_;
 };
 
 }  // namespace google_breakpad
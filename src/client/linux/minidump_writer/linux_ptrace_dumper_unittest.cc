@@ -47,6 +47,7 @@
 #include <sys/types.h>
 
 #include <string>
+#include <vector>
 
 #include "breakpad_googletest_includes.h"
 #include "client/linux/minidump_writer/linux_ptrace_dumper.h"
@@ -131,6 +132,28 @@ TEST_F(LinuxPtraceDumperChildTest, FindMappings) {
   ASSERT_FALSE(dumper.FindMapping(NULL));
 }
 
+TEST_F(LinuxPtraceDumperChildTest, FindMappingAtBoundaries) {
+  LinuxPtraceDumper dumper(getppid());
+  ASSERT_TRUE(dumper.Init());
+
+  const wasteful_vector<MappingInfo*>& mappings = dumper.mappings();
+  for (size_t i = 0; i < mappings.size(); ++i) {
+    const MappingInfo* mapping = mappings[i];
+    const uintptr_t first = mapping->start_addr;
+    const uintptr_t last = mapping->start_addr + mapping->size - 1;
+    EXPECT_EQ(mapping, dumper.FindMapping(reinterpret_cast<void*>(first)));
+    EXPECT_EQ(mapping, dumper.FindMapping(reinterpret_cast<void*>(last)));
+
+    // Just past the end is either unmapped or in another mapping.
+    const MappingInfo* next =
+        dumper.FindMapping(reinterpret_cast<void*>(last + 1));
+    EXPECT_NE(mapping, next);
+    if (next) {
+      EXPECT_EQ(last + 1, next->start_addr);
+    }
+  }
+}
+
 TEST_F(LinuxPtraceDumperChildTest, ThreadList) {
   LinuxPtraceDumper dumper(getppid());
   ASSERT_TRUE(dumper.Init());
@@ -243,6 +266,63 @@ TEST_F(LinuxPtraceDumperMappingsTest, MergedMappings) {
   EXPECT_EQ(1, mapping_count);
 }
 
+class LinuxPtraceDumperCopyTest : public LinuxPtraceDumperChildTest {
+ protected:
+  virtual void SetUp();
+  virtual void TearDown();
+
+  size_t page_size_;
+  uint8_t* mapping_;
+};
+
+void LinuxPtraceDumperCopyTest::SetUp() {
+  // Map three pages of known contents and unmap the middle one, so that
+  // copies spanning the hole must fall back from bulk reads.
+  page_size_ = sysconf(_SC_PAGESIZE);
+  mapping_ = reinterpret_cast<uint8_t*>(mmap(NULL, 3 * page_size_,
+                                             PROT_READ | PROT_WRITE,
+                                             MAP_PRIVATE | MAP_ANONYMOUS,
+                                             -1, 0));
+  ASSERT_NE(MAP_FAILED, mapping_);
+  for (size_t i = 0; i < 3 * page_size_; ++i)
+    mapping_[i] = static_cast<uint8_t>(i % 251 + 1);
+  ASSERT_EQ(0, munmap(mapping_ + page_size_, page_size_));
+
+  LinuxPtraceDumperChildTest::SetUp();
+}
+
+void LinuxPtraceDumperCopyTest::TearDown() {
+  munmap(mapping_, page_size_);
+  munmap(mapping_ + 2 * page_size_, page_size_);
+}
+
+TEST_F(LinuxPtraceDumperCopyTest, CopyAcrossUnreadablePage) {
+  LinuxPtraceDumper dumper(getppid());
+  ASSERT_TRUE(dumper.Init());
+  ASSERT_TRUE(dumper.ThreadsSuspend());
+
+  // Start and end mid-page, so that every kind of partial read happens.
+  const size_t offset = page_size_ / 2;
+  const size_t length = 2 * page_size_;
+  PageAllocator allocator;
+  uint8_t* copy = reinterpret_cast<uint8_t*>(allocator.Alloc(length));
+  memset(copy, 0xff, length);
+  dumper.CopyFromProcess(copy, getppid(), mapping_ + offset, length);
+  EXPECT_TRUE(dumper.ThreadsResume());
+
+  for (size_t i = 0; i < length; ++i) {
+    const size_t remote = offset + i;
+    const uint8_t expected = (remote >= page_size_ && remote < 2 * page_size_)
+        ? 0 : static_cast<uint8_t>(remote % 251 + 1);
+    ASSERT_EQ(expected, copy[i]) << "at offset " << remote;
+  }
+
+  // A small copy of readable memory.
+  uint32_t word = 0;
+  dumper.CopyFromProcess(&word, getppid(), mapping_ + 4, sizeof(word));
+  EXPECT_EQ(0x08070605U, word);
+}
+
 TEST_F(LinuxPtraceDumperChildTest, BuildProcPath) {
   const pid_t pid = getppid();
   LinuxPtraceDumper dumper(pid);
@@ -358,6 +438,72 @@ TEST_F(LinuxPtraceDumperChildTest, FileIDsMatch) {
   EXPECT_STREQ(identifier_string1, identifier_string2);
 }
 
+TEST_F(LinuxPtraceDumperChildTest, ModuleFileIDsMatch) {
+  // Identifiers read from the modules' images in memory, or from their
+  // files where the images don't hold a usable build ID, match those of
+  // the files, which are the modules that are loaded.
+  LinuxPtraceDumper dumper(getppid());
+  ASSERT_TRUE(dumper.Init());
+  const wasteful_vector<MappingInfo*> mappings = dumper.mappings();
+  unsigned modules = 0;
+  for (unsigned i = 0; i < mappings.size(); ++i) {
+    const MappingInfo* mapping = mappings[i];
+    if (mapping->name[0] != '/' || mapping->offset != 0)
+      continue;
+    uint8_t file_identifier[sizeof(MDGUID)];
+    FileID fileid(mapping->name);
+    if (!fileid.ElfFileIdentifier(file_identifier))
+      continue;
+    uint8_t identifier[sizeof(MDGUID)];
+    EXPECT_TRUE(dumper.ElfFileIdentifierForMapping(*mapping, false, 0,
+                                                   identifier));
+    EXPECT_EQ(0, memcmp(file_identifier, identifier, sizeof(MDGUID)))
+        << mapping->name;
+    ++modules;
+  }
+  EXPECT_LT(1U, modules);
+}
+
+TEST_F(LinuxPtraceDumperChildTest, IdentifierHelpersMatch) {
+  // Identifiers computed on helper tasks are the ones computed one at a
+  // time.
+  LinuxPtraceDumper dumper(getppid());
+  ASSERT_TRUE(dumper.Init());
+  LinuxPtraceDumper helped_dumper(getppid());
+  ASSERT_TRUE(helped_dumper.Init());
+  const wasteful_vector<MappingInfo*> mappings = dumper.mappings();
+  const wasteful_vector<MappingInfo*> helped_mappings =
+      helped_dumper.mappings();
+  ASSERT_EQ(mappings.size(), helped_mappings.size());
+
+  std::vector<unsigned int> mapping_ids;
+  for (unsigned int i = 0; i < mappings.size(); ++i) {
+    if (mappings[i]->name[0] == '/')
+      mapping_ids.push_back(i);
+  }
+  ASSERT_FALSE(mapping_ids.empty());
+  helped_dumper.StartIdentifierHelpers(&mapping_ids[0], mapping_ids.size(),
+                                       3);
+
+  unsigned int found = 0;
+  for (size_t i = 0; i < mapping_ids.size(); ++i) {
+    const unsigned int id = mapping_ids[i];
+    uint8_t identifier[sizeof(MDGUID)];
+    uint8_t helped_identifier[sizeof(MDGUID)];
+    const bool success = dumper.ElfFileIdentifierForMapping(
+        *mappings[id], true, id, identifier);
+    EXPECT_EQ(success, helped_dumper.ElfFileIdentifierForMapping(
+        *helped_mappings[id], true, id, helped_identifier))
+        << mappings[id]->name;
+    if (success) {
+      EXPECT_EQ(0, memcmp(identifier, helped_identifier, sizeof(MDGUID)))
+          << mappings[id]->name;
+      ++found;
+    }
+  }
+  EXPECT_LT(1U, found);
+}
+
 /* Get back to normal behavior of TEST*() macros wrt TestBody. */
 #undef TestBody
 
@@ -425,6 +571,8 @@ TEST(LinuxPtraceDumperTest, VerifyStackReadWithMultipleThreads) {
   ThreadInfo one_thread;
   for (size_t i = 0; i < dumper.threads().size(); ++i) {
     EXPECT_TRUE(dumper.GetThreadInfoByIndex(i, &one_thread));
+    EXPECT_EQ(child_pid, one_thread.tgid);
+    EXPECT_EQ(getpid(), one_thread.ppid);
     const void* stack;
     size_t stack_len;
     EXPECT_TRUE(dumper.GetStackInfo(&stack, &stack_len,
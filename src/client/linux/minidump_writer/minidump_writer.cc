@@ -69,6 +69,7 @@
 #include "client/linux/dump_writer_common/ucontext_reader.h"
 #include "client/linux/handler/exception_handler.h"
 #include "client/linux/minidump_writer/cpu_set.h"
+#include "client/linux/minidump_writer/crash_annotations.h"
 #include "client/linux/minidump_writer/line_reader.h"
 #include "client/linux/minidump_writer/linux_dumper.h"
 #include "client/linux/minidump_writer/linux_ptrace_dumper.h"
@@ -84,6 +85,7 @@ namespace {
 using google_breakpad::AppMemoryList;
 using google_breakpad::ExceptionHandler;
 using google_breakpad::CpuSet;
+using google_breakpad::CrashAnnotations;
 using google_breakpad::LineReader;
 using google_breakpad::LinuxDumper;
 using google_breakpad::LinuxPtraceDumper;
@@ -92,11 +94,17 @@ using google_breakpad::MappingEntry;
 using google_breakpad::MappingInfo;
 using google_breakpad::MappingList;
 using google_breakpad::MinidumpFileWriter;
+using google_breakpad::MinidumpSizeLimitPolicy;
+using google_breakpad::MinidumpSnapshotSeries;
+using google_breakpad::MinidumpWriterStatistics;
+using google_breakpad::ModuleIdentifierCache;
 using google_breakpad::PageAllocator;
 using google_breakpad::ProcCpuInfoReader;
 using google_breakpad::RawContextCPU;
 using google_breakpad::SeccompUnwinder;
 using google_breakpad::ThreadInfo;
+using google_breakpad::kSizeLimitBudgeted;
+using google_breakpad::kSizeLimitTruncateExtraThreads;
 using google_breakpad::TypedMDRVA;
 using google_breakpad::UContextReader;
 using google_breakpad::UntypedMDRVA;
@@ -105,6 +113,14 @@ using google_breakpad::wasteful_vector;
 typedef MDTypeHelper<sizeof(void*)>::MDRawDebug MDRawDebug;
 typedef MDTypeHelper<sizeof(void*)>::MDRawLinkMap MDRawLinkMap;
 
+// The time of CLOCK_MONOTONIC in nanoseconds.
+uint64_t MonotonicNanoseconds() {
+  struct kernel_timespec now;
+  if (sys_clock_gettime(CLOCK_MONOTONIC, &now) != 0)
+    return 0;
+  return static_cast<uint64_t>(now.tv_sec) * 1000000000 + now.tv_nsec;
+}
+
 class MinidumpWriter {
  public:
   // The following kLimit* constants are for when minidump_size_limit_ is set
@@ -122,6 +138,24 @@ class MinidumpWriter {
   // Make sure this number of additional bytes can fit in the minidump
   // (exclude the stack data).
   static const unsigned kLimitMinidumpFudgeFactor = 64 * 1024;
+  // With kSizeLimitBudgeted, the number of bytes dumped around each of the
+  // crashing thread's registers that points into mapped memory.
+  static const unsigned kBudgetRegisterMemoryLen = 256;
+
+  // The number of bytes of each DSO name read from the process, and the
+  // span of the process's memory that WriteDSODebugStream() reads names
+  // from in one go.
+  static const size_t kDSONameLength = 256;
+  static const size_t kDSONameBatchSpan = 4096;
+
+  // The soft-dirty bit of an entry of /proc/<pid>/pagemap, and the number
+  // of entries read at once.
+  static const uint64_t kPageMapSoftDirty = 1ULL << 55;
+  static const size_t kPageMapBatch = 512;
+
+  // The number of phases timed for the MD_LINUX_HANDLER_TIMING stream,
+  // which are numbered from 1.
+  static const unsigned kHandlerPhaseCount = MD_HANDLER_PHASE_WRITE;
 
   MinidumpWriter(const char* minidump_path,
                  int minidump_fd,
@@ -137,24 +171,53 @@ class MinidumpWriter {
 #endif
         dumper_(dumper),
         minidump_size_limit_(-1),
+        size_limit_policy_(kSizeLimitTruncateExtraThreads),
+        memory_ranges_(dumper_->allocator()),
         memory_blocks_(dumper_->allocator()),
         mapping_list_(mappings),
-        app_memory_list_(appmem) {
+        app_memory_list_(appmem),
+        annotations_(NULL),
+        identifier_helpers_(0),
+        snapshot_series_(NULL),
+        snapshot_delta_(false),
+        snapshot_stacks_(dumper_->allocator()),
+        statistics_(NULL),
+        stream_start_ns_(0),
+        handler_start_ns_(context ? context->handler_start_ns : 0) {
     // Assert there should be either a valid fd or a valid path, not both.
     assert(fd_ != -1 || minidump_path);
     assert(fd_ == -1 || !minidump_path);
+    my_memset(timings_, 0, sizeof(timings_));
+    for (unsigned i = 0; i < kHandlerPhaseCount; ++i)
+      timings_[i].phase = i + 1;
   }
 
   bool Init() {
+    // Without a crash context, the handler is timed from here.
+    uint64_t start_ns = MonotonicNanoseconds();
+    if (handler_start_ns_ && handler_start_ns_ <= start_ns)
+      start_ns = EndPhase(MD_HANDLER_PHASE_HANDLER, handler_start_ns_);
+    else
+      handler_start_ns_ = start_ns;
+
     if (!dumper_->Init())
       return false;
+    EndPhase(MD_HANDLER_PHASE_ENUMERATE, start_ns);
+    if (statistics_)
+      statistics_->init_ns = timing(MD_HANDLER_PHASE_ENUMERATE)->duration;
 
     if (fd_ != -1)
       minidump_writer_.SetFile(fd_);
     else if (!minidump_writer_.Open(path_))
       return false;
 
-    return dumper_->ThreadsSuspend();
+    start_ns = MonotonicNanoseconds();
+    if (!dumper_->ThreadsSuspend())
+      return false;
+    EndPhase(MD_HANDLER_PHASE_SUSPEND, start_ns);
+    if (statistics_)
+      statistics_->suspend_ns = timing(MD_HANDLER_PHASE_SUSPEND)->duration;
+    return true;
   }
 
   ~MinidumpWriter() {
@@ -168,7 +231,7 @@ class MinidumpWriter {
   bool Dump() {
     // A minidump file contains a number of tagged streams. This is the number
     // of stream which we write.
-    unsigned kNumWriters = 13;
+    unsigned kNumWriters = 16;
 
     TypedMDRVA<MDRawHeader> header(&minidump_writer_);
     TypedMDRVA<MDRawDirectory> dir(&minidump_writer_);
@@ -186,107 +249,159 @@ class MinidumpWriter {
 
     unsigned dir_index = 0;
     MDRawDirectory dirent;
+    const uint64_t write_start_ns = MonotonicNanoseconds();
+    stream_start_ns_ = write_start_ns;
+
+    // The modules' files are read for their identifiers while the thread
+    // stacks are copied, if there are helpers to do it.
+    StartIdentifierHelpers();
+    StartSnapshot();
 
     if (!WriteThreadListStream(&dirent))
       return false;
-    dir.CopyIndex(dir_index++, &dirent);
+    AddStream(&dir, &dir_index, dirent);
 
     if (!WriteMappings(&dirent))
       return false;
-    dir.CopyIndex(dir_index++, &dirent);
-
-    if (!WriteAppMemory())
-      return false;
+    AddStream(&dir, &dir_index, dirent);
 
     if (!WriteMemoryListStream(&dirent))
       return false;
-    dir.CopyIndex(dir_index++, &dirent);
+    AddStream(&dir, &dir_index, dirent);
 
     if (!WriteExceptionStream(&dirent))
       return false;
-    dir.CopyIndex(dir_index++, &dirent);
+    AddStream(&dir, &dir_index, dirent);
 
     if (!WriteSystemInfoStream(&dirent))
       return false;
-    dir.CopyIndex(dir_index++, &dirent);
+    AddStream(&dir, &dir_index, dirent);
 
     dirent.stream_type = MD_LINUX_CPU_INFO;
     if (!WriteFile(&dirent.location, "/proc/cpuinfo"))
       NullifyDirectoryEntry(&dirent);
-    dir.CopyIndex(dir_index++, &dirent);
+    AddStream(&dir, &dir_index, dirent);
 
     dirent.stream_type = MD_LINUX_PROC_STATUS;
     if (!WriteProcFile(&dirent.location, GetCrashThread(), "status"))
       NullifyDirectoryEntry(&dirent);
-    dir.CopyIndex(dir_index++, &dirent);
+    AddStream(&dir, &dir_index, dirent);
 
     dirent.stream_type = MD_LINUX_LSB_RELEASE;
     if (!WriteFile(&dirent.location, "/etc/lsb-release"))
       NullifyDirectoryEntry(&dirent);
-    dir.CopyIndex(dir_index++, &dirent);
+    AddStream(&dir, &dir_index, dirent);
 
     dirent.stream_type = MD_LINUX_CMD_LINE;
     if (!WriteProcFile(&dirent.location, GetCrashThread(), "cmdline"))
       NullifyDirectoryEntry(&dirent);
-    dir.CopyIndex(dir_index++, &dirent);
+    AddStream(&dir, &dir_index, dirent);
 
     dirent.stream_type = MD_LINUX_ENVIRON;
     if (!WriteProcFile(&dirent.location, GetCrashThread(), "environ"))
       NullifyDirectoryEntry(&dirent);
-    dir.CopyIndex(dir_index++, &dirent);
+    AddStream(&dir, &dir_index, dirent);
 
     dirent.stream_type = MD_LINUX_AUXV;
     if (!WriteProcFile(&dirent.location, GetCrashThread(), "auxv"))
       NullifyDirectoryEntry(&dirent);
-    dir.CopyIndex(dir_index++, &dirent);
+    AddStream(&dir, &dir_index, dirent);
 
     dirent.stream_type = MD_LINUX_MAPS;
     if (!WriteProcFile(&dirent.location, GetCrashThread(), "maps"))
       NullifyDirectoryEntry(&dirent);
-    dir.CopyIndex(dir_index++, &dirent);
+    AddStream(&dir, &dir_index, dirent);
 
     dirent.stream_type = MD_LINUX_DSO_DEBUG;
     if (!WriteDSODebugStream(&dirent))
       NullifyDirectoryEntry(&dirent);
-    dir.CopyIndex(dir_index++, &dirent);
+    AddStream(&dir, &dir_index, dirent);
+
+    dirent.stream_type = MD_LINUX_ANNOTATIONS;
+    if (!WriteAnnotationsStream(&dirent))
+      NullifyDirectoryEntry(&dirent);
+    AddStream(&dir, &dir_index, dirent);
+
+    dirent.stream_type = MD_LINUX_SNAPSHOT;
+    if (!WriteSnapshotStream(&dirent))
+      NullifyDirectoryEntry(&dirent);
+    AddStream(&dir, &dir_index, dirent);
+
+    // This stream is written last, so that it can time the others.
+    EndPhase(MD_HANDLER_PHASE_WRITE, write_start_ns);
+    dirent.stream_type = MD_LINUX_HANDLER_TIMING;
+    if (!WriteHandlerTimingStream(&dirent))
+      NullifyDirectoryEntry(&dirent);
+    AddStream(&dir, &dir_index, dirent);
 
     // If you add more directory entries, don't forget to update kNumWriters,
     // above.
 
     dumper_->ThreadsResume();
+    if (statistics_)
+      statistics_->minidump_size = minidump_writer_.position();
     return true;
   }
 
-  bool FillThreadStack(MDRawThread* thread, uintptr_t stack_pointer,
-                       int max_stack_len, uint8_t** stack_copy) {
-    *stack_copy = NULL;
+  // Writes |dirent| to the next entry of the stream directory |dir|, and
+  // records how long the stream took to write.
+  void AddStream(TypedMDRVA<MDRawDirectory>* dir, unsigned* dir_index,
+                 const MDRawDirectory& dirent) {
+    dir->CopyIndex((*dir_index)++, &dirent);
+    if (!statistics_ ||
+        statistics_->stream_count == MinidumpWriterStatistics::kMaxStreams) {
+      return;
+    }
+    const uint64_t now_ns = MonotonicNanoseconds();
+    statistics_->stream_types[statistics_->stream_count] = dirent.stream_type;
+    statistics_->stream_ns[statistics_->stream_count] =
+        now_ns - stream_start_ns_;
+    ++statistics_->stream_count;
+    stream_start_ns_ = now_ns;
+  }
+
+  // Records |thread|'s stack range in |thread->stack|. The range is added to
+  // the memory to be dumped by WriteThreadListStream() once the size limit,
+  // if any, has been applied.
+  void SetThreadStack(MDRawThread* thread, uintptr_t stack_pointer,
+                      int max_stack_len) {
     const void* stack;
     size_t stack_len;
     if (dumper_->GetStackInfo(&stack, &stack_len, stack_pointer)) {
-      UntypedMDRVA memory(&minidump_writer_);
       if (max_stack_len >= 0 &&
           stack_len > static_cast<unsigned int>(max_stack_len)) {
         stack_len = max_stack_len;
       }
-      if (!memory.Allocate(stack_len))
-        return false;
-      *stack_copy = reinterpret_cast<uint8_t*>(Alloc(stack_len));
-      dumper_->CopyFromProcess(*stack_copy, thread->thread_id, stack,
-                               stack_len);
-      memory.Copy(*stack_copy, stack_len);
       thread->stack.start_of_memory_range =
           reinterpret_cast<uintptr_t>(stack);
-      thread->stack.memory = memory.location();
-      memory_blocks_.push_back(thread->stack);
+      thread->stack.memory.data_size = stack_len;
     } else {
       thread->stack.start_of_memory_range = stack_pointer;
       thread->stack.memory.data_size = 0;
+    }
+  }
+
+  // Points |thread->stack| at the copy of its stack written to the dump,
+  // and returns a pointer to that copy, or NULL if the stack is empty.  The
+  // stacks of a snapshot delta are left empty; the pages written since the
+  // base are in the memory list.
+  uint8_t* FillThreadStack(MDRawThread* thread) {
+    if (snapshot_delta_)
+      thread->stack.memory.data_size = 0;
+    if (thread->stack.memory.data_size == 0) {
       thread->stack.memory.rva = minidump_writer_.position();
+      return NULL;
     }
-    return true;
+    return FindMemoryBlock(thread->stack.start_of_memory_range,
+                           &thread->stack.memory);
   }
 
   // Write information about the threads.
+  //
+  // All the memory the dump needs from the process (thread stacks, the
+  // memory around the crashing instruction and the application-provided
+  // regions) is collected first and written by WriteMemoryRanges() in as few
+  // reads and writes as possible, before the thread contexts are filled in.
   bool WriteThreadListStream(MDRawDirectory* dirent) {
     const unsigned num_threads = dumper_->threads().size();
 
@@ -303,9 +418,11 @@ class MinidumpWriter {
     // most of the space is filled with stack data, just check against that.
     // If this expects to exceed the limit, set extra_thread_stack_len such
     // that any thread beyond the first kLimitBaseThreadCount threads will
-    // have only kLimitMaxExtraThreadStackLen bytes dumped.
+    // have only kLimitMaxExtraThreadStackLen bytes dumped.  With
+    // kSizeLimitBudgeted, FitMemoryToBudget() trims the stacks instead.
     int extra_thread_stack_len = -1;  // default to no maximum
-    if (minidump_size_limit_ >= 0) {
+    if (minidump_size_limit_ >= 0 &&
+        size_limit_policy_ == kSizeLimitTruncateExtraThreads) {
       const unsigned estimated_total_stack_size = num_threads *
           kLimitAverageThreadStackLength;
       const off_t estimated_minidump_size = minidump_writer_.position() +
@@ -314,102 +431,119 @@ class MinidumpWriter {
         extra_thread_stack_len = kLimitMaxExtraThreadStackLen;
     }
 
+    MDRawThread* threads = reinterpret_cast<MDRawThread*>(
+        Alloc(num_threads * sizeof(MDRawThread)));
+    ThreadInfo* infos = reinterpret_cast<ThreadInfo*>(
+        Alloc(num_threads * sizeof(ThreadInfo)));
+    MDMemoryDescriptor ip_memory_d;
+    bool ip_is_mapped = false;
+    unsigned crash_thread_index = num_threads;
+
+    // First work out the memory every thread needs.
     for (unsigned i = 0; i < num_threads; ++i) {
-      MDRawThread thread;
+      MDRawThread& thread = threads[i];
       my_memset(&thread, 0, sizeof(thread));
       thread.thread_id = dumper_->threads()[i];
+      if (dumper_->threads()[i] == GetCrashThread())
+        crash_thread_index = i;
 
       // We have a different source of information for the crashing thread. If
       // we used the actual state of the thread we would find it running in the
       // signal handler with the alternative stack, which would be deeply
       // unhelpful.
-      if (static_cast<pid_t>(thread.thread_id) == GetCrashThread() &&
-          ucontext_ &&
-          !dumper_->IsPostMortem()) {
-        uint8_t* stack_copy;
+      if (IsCrashThreadWithContext(thread)) {
         const uintptr_t stack_ptr = UContextReader::GetStackPointer(ucontext_);
-        if (!FillThreadStack(&thread, stack_ptr, -1, &stack_copy))
-          return false;
+        SetThreadStack(&thread, stack_ptr, -1);
 
         // Copy 256 bytes around crashing instruction pointer to minidump.
         const size_t kIPMemorySize = 256;
         uint64_t ip = UContextReader::GetInstructionPointer(ucontext_);
-        // Bound it to the upper and lower bounds of the memory map
-        // it's contained within. If it's not in mapped memory,
-        // don't bother trying to write it.
-        bool ip_is_mapped = false;
-        MDMemoryDescriptor ip_memory_d;
-        for (unsigned j = 0; j < dumper_->mappings().size(); ++j) {
-          const MappingInfo& mapping = *dumper_->mappings()[j];
-          if (ip >= mapping.start_addr &&
-              ip < mapping.start_addr + mapping.size) {
-            ip_is_mapped = true;
-            // Try to get 128 bytes before and after the IP, but
-            // settle for whatever's available.
-            ip_memory_d.start_of_memory_range =
-              std::max(mapping.start_addr,
-                       uintptr_t(ip - (kIPMemorySize / 2)));
-            uintptr_t end_of_range =
-              std::min(uintptr_t(ip + (kIPMemorySize / 2)),
-                       uintptr_t(mapping.start_addr + mapping.size));
-            ip_memory_d.memory.data_size =
-              end_of_range - ip_memory_d.start_of_memory_range;
-            break;
-          }
-        }
-
-        if (ip_is_mapped) {
-          UntypedMDRVA ip_memory(&minidump_writer_);
-          if (!ip_memory.Allocate(ip_memory_d.memory.data_size))
-            return false;
-          uint8_t* memory_copy =
-              reinterpret_cast<uint8_t*>(Alloc(ip_memory_d.memory.data_size));
-          dumper_->CopyFromProcess(
-              memory_copy,
-              thread.thread_id,
-              reinterpret_cast<void*>(ip_memory_d.start_of_memory_range),
-              ip_memory_d.memory.data_size);
-          ip_memory.Copy(memory_copy, ip_memory_d.memory.data_size);
-          ip_memory_d.memory = ip_memory.location();
-          memory_blocks_.push_back(ip_memory_d);
-        }
-
-        TypedMDRVA<RawContextCPU> cpu(&minidump_writer_);
-        if (!cpu.Allocate())
-          return false;
-        my_memset(cpu.get(), 0, sizeof(RawContextCPU));
-#if !defined(__ARM_EABI__) && !defined(__mips__)
-        UContextReader::FillCPUContext(cpu.get(), ucontext_, float_state_);
-#else
-        UContextReader::FillCPUContext(cpu.get(), ucontext_);
-#endif
-        if (stack_copy)
-          SeccompUnwinder::PopSeccompStackFrame(cpu.get(), thread, stack_copy);
-        thread.thread_context = cpu.location();
-        crashing_thread_context_ = cpu.location();
+        ip_is_mapped = GetMemoryAround(ip, kIPMemorySize, &ip_memory_d);
       } else {
-        ThreadInfo info;
-        if (!dumper_->GetThreadInfoByIndex(i, &info))
+        if (!dumper_->GetThreadInfoByIndex(i, &infos[i]))
           return false;
 
-        uint8_t* stack_copy;
         int max_stack_len = -1;  // default to no maximum for this thread
         if (minidump_size_limit_ >= 0 && i >= kLimitBaseThreadCount)
           max_stack_len = extra_thread_stack_len;
-        if (!FillThreadStack(&thread, info.stack_pointer, max_stack_len,
-            &stack_copy))
-          return false;
+        SetThreadStack(&thread, infos[i].stack_pointer, max_stack_len);
+      }
+    }
 
-        TypedMDRVA<RawContextCPU> cpu(&minidump_writer_);
-        if (!cpu.Allocate())
-          return false;
-        my_memset(cpu.get(), 0, sizeof(RawContextCPU));
-        info.FillCPUContext(cpu.get());
+    if (minidump_size_limit_ >= 0 &&
+        size_limit_policy_ == kSizeLimitBudgeted) {
+      FitMemoryToBudget(threads, num_threads, crash_thread_index,
+                        ip_memory_d, ip_is_mapped);
+    } else {
+      for (unsigned i = 0; i < num_threads; ++i) {
+        AddMemoryRange(threads[i].stack.start_of_memory_range,
+                       threads[i].stack.memory.data_size);
+      }
+      if (ip_is_mapped) {
+        AddMemoryRange(ip_memory_d.start_of_memory_range,
+                       ip_memory_d.memory.data_size);
+      }
+      AddAppMemoryRanges();
+    }
+    if (snapshot_delta_) {
+      for (unsigned i = 0; i < num_threads; ++i) {
+        if (threads[i].stack.memory.data_size == 0)
+          continue;
+        MDRawSnapshotStack stack;
+        my_memset(&stack, 0, sizeof(stack));
+        stack.thread_id = threads[i].thread_id;
+        stack.start_of_memory_range = threads[i].stack.start_of_memory_range;
+        stack.size = threads[i].stack.memory.data_size;
+        snapshot_stacks_.push_back(stack);
+      }
+    }
+    const uint64_t memory_start_ns = MonotonicNanoseconds();
+    if (!WriteMemoryRanges())
+      return false;
+    EndPhase(MD_HANDLER_PHASE_MEMORY, memory_start_ns);
+    // The base's memory is in the dump, and the process's threads are
+    // still suspended, so the series can start from here.
+    if (snapshot_series_ && !snapshot_delta_)
+      FinishSnapshotBase();
+
+    // Now that the memory is in the dump, fill in the thread contexts. They
+    // are laid out one after another and filled in memory first, so that
+    // the contexts and then the thread records each reach the dump in a
+    // single write, however many threads there are.
+    const size_t contexts_size = num_threads * sizeof(RawContextCPU);
+    UntypedMDRVA contexts_rva(&minidump_writer_);
+    if (!contexts_rva.Allocate(contexts_size))
+      return false;
+    RawContextCPU* contexts =
+        reinterpret_cast<RawContextCPU*>(Alloc(contexts_size));
+    my_memset(contexts, 0, contexts_size);
+
+    for (unsigned i = 0; i < num_threads; ++i) {
+      MDRawThread& thread = threads[i];
+      uint8_t* stack_copy = FillThreadStack(&thread);
+      RawContextCPU* cpu = &contexts[i];
+      MDLocationDescriptor cpu_location;
+      cpu_location.data_size = sizeof(RawContextCPU);
+      cpu_location.rva = contexts_rva.position() + i * sizeof(RawContextCPU);
+
+      if (IsCrashThreadWithContext(thread)) {
+#if !defined(__ARM_EABI__) && !defined(__mips__)
+        UContextReader::FillCPUContext(cpu, ucontext_, float_state_);
+#else
+        UContextReader::FillCPUContext(cpu, ucontext_);
+#endif
+        if (stack_copy)
+          SeccompUnwinder::PopSeccompStackFrame(cpu, thread, stack_copy);
+        thread.thread_context = cpu_location;
+        crashing_thread_context_ = cpu_location;
+      } else {
+        ThreadInfo& info = infos[i];
+        info.FillCPUContext(cpu);
         if (stack_copy)
-          SeccompUnwinder::PopSeccompStackFrame(cpu.get(), thread, stack_copy);
-        thread.thread_context = cpu.location();
+          SeccompUnwinder::PopSeccompStackFrame(cpu, thread, stack_copy);
+        thread.thread_context = cpu_location;
         if (dumper_->threads()[i] == GetCrashThread()) {
-          crashing_thread_context_ = cpu.location();
+          crashing_thread_context_ = cpu_location;
           if (!dumper_->IsPostMortem()) {
             // This is the crashing thread of a live process, but
             // no context was provided, so set the crash address
@@ -418,37 +552,360 @@ class MinidumpWriter {
           }
         }
       }
+    }
+
+    if (!contexts_rva.Copy(contexts, contexts_size))
+      return false;
+    return list.CopyIndexAfterObject(0, threads,
+                                     num_threads * sizeof(MDRawThread));
+  }
+
+  // Returns true if |thread| is the crashing thread of a live process and
+  // its state is to be taken from the crash context.
+  bool IsCrashThreadWithContext(const MDRawThread& thread) const {
+    return static_cast<pid_t>(thread.thread_id) == GetCrashThread() &&
+           ucontext_ &&
+           !dumper_->IsPostMortem();
+  }
+
+  // Sets |range| to the |size| bytes centred on |address|, bounded by the
+  // mapping that contains it. Returns false if |address| isn't mapped.
+  bool GetMemoryAround(uint64_t address, size_t size,
+                       MDMemoryDescriptor* range) const {
+    for (unsigned i = 0; i < dumper_->mappings().size(); ++i) {
+      const MappingInfo& mapping = *dumper_->mappings()[i];
+      if (address >= mapping.start_addr &&
+          address < mapping.start_addr + mapping.size) {
+        // Try to get half of the bytes before and half after the address,
+        // but settle for whatever's available.
+        range->start_of_memory_range =
+          std::max(mapping.start_addr, uintptr_t(address - (size / 2)));
+        uintptr_t end_of_range =
+          std::min(uintptr_t(address + (size / 2)),
+                   uintptr_t(mapping.start_addr + mapping.size));
+        range->memory.data_size = end_of_range - range->start_of_memory_range;
+        return true;
+      }
+    }
+    return false;
+  }
+
+  // Takes up to |wanted| bytes from |*budget| and returns how many it took.
+  static size_t TakeFromBudget(size_t* budget, size_t wanted) {
+    const size_t taken = std::min(*budget, wanted);
+    *budget -= taken;
+    return taken;
+  }
+
+  // Trims the memory collected for the threads so that the dump fits in
+  // minidump_size_limit_, keeping the memory most useful to the stack
+  // walker, and adds the memory kept to the ranges to be dumped. The
+  // application-provided regions are always kept. The budget left once
+  // everything else in the dump has been estimated is handed out greedily
+  // in this order:
+  //   1. the crashing thread's stack,
+  //   2. the memory around the crashing instruction, then around each of the
+  //      crashing thread's registers that points into mapped memory,
+  //   3. the top kLimitMaxExtraThreadStackLen bytes of every other stack,
+  //   4. the rest of the other stacks, shared out evenly.
+  // Stacks are always trimmed from the end furthest from the stack pointer.
+  // Up to step 2, a range is only charged for the bytes that earlier ranges
+  // don't already cover, since WriteMemoryRanges() writes those bytes once.
+  // Register memory in particular mostly lies in the crashing thread's
+  // stack.
+  void FitMemoryToBudget(MDRawThread* threads, unsigned num_threads,
+                         unsigned crash_thread_index,
+                         const MDMemoryDescriptor& ip_memory_d,
+                         bool ip_is_mapped) {
+    off_t available = minidump_size_limit_ - minidump_writer_.position() -
+        kLimitMinidumpFudgeFactor -
+        static_cast<off_t>(num_threads * sizeof(RawContextCPU));
+    for (AppMemoryList::const_iterator iter = app_memory_list_.begin();
+         iter != app_memory_list_.end();
+         ++iter) {
+      const uintptr_t start = reinterpret_cast<uintptr_t>(iter->ptr);
+      available -= UncoveredBytes(start, iter->length);
+      AddMemoryRange(start, iter->length);
+    }
+    size_t budget = available > 0 ? available : 0;
 
-      list.CopyIndexAfterObject(i, &thread, sizeof(thread));
+    // The stack lengths wanted; the threads start out with nothing.
+    size_t* wanted = reinterpret_cast<size_t*>(
+        Alloc(num_threads * sizeof(size_t)));
+    for (unsigned i = 0; i < num_threads; ++i) {
+      wanted[i] = threads[i].stack.memory.data_size;
+      threads[i].stack.memory.data_size = 0;
     }
 
-    return true;
+    if (crash_thread_index < num_threads) {
+      MDRawThread& thread = threads[crash_thread_index];
+      const uintptr_t start = thread.stack.start_of_memory_range;
+      const size_t taken =
+          TakeFromBudget(&budget, wanted[crash_thread_index]);
+      // Give back what the application-provided regions already cover.
+      budget += taken - UncoveredBytes(start, taken);
+      thread.stack.memory.data_size = taken;
+      wanted[crash_thread_index] = 0;
+      AddMemoryRange(start, taken);
+    }
+
+    if (ip_is_mapped) {
+      TakeRangeFromBudget(&budget, ip_memory_d.start_of_memory_range,
+                          ip_memory_d.memory.data_size);
+    }
+
+    if (ucontext_ && !dumper_->IsPostMortem()) {
+      uintptr_t registers[UContextReader::kMaxGeneralRegisters];
+      const size_t register_count =
+          UContextReader::GetGeneralRegisters(ucontext_, registers);
+      for (size_t i = 0; i < register_count; ++i) {
+        MDMemoryDescriptor range;
+        if (GetMemoryAround(registers[i], kBudgetRegisterMemoryLen, &range)) {
+          TakeRangeFromBudget(&budget, range.start_of_memory_range,
+                              range.memory.data_size);
+        }
+      }
+    }
+
+    unsigned threads_wanting = 0;
+    for (unsigned i = 0; i < num_threads; ++i) {
+      const size_t taken = TakeFromBudget(
+          &budget, std::min(wanted[i], size_t(kLimitMaxExtraThreadStackLen)));
+      threads[i].stack.memory.data_size += taken;
+      wanted[i] -= taken;
+      if (wanted[i] > 0)
+        ++threads_wanting;
+    }
+
+    // Share what's left evenly, handing the share of any thread that needs
+    // less to the others on the next round.
+    while (threads_wanting > 0 && budget >= threads_wanting) {
+      const size_t share = budget / threads_wanting;
+      threads_wanting = 0;
+      for (unsigned i = 0; i < num_threads; ++i) {
+        if (wanted[i] == 0)
+          continue;
+        const size_t taken = TakeFromBudget(&budget,
+                                            std::min(wanted[i], share));
+        threads[i].stack.memory.data_size += taken;
+        wanted[i] -= taken;
+        if (wanted[i] > 0)
+          ++threads_wanting;
+      }
+    }
+
+    for (unsigned i = 0; i < num_threads; ++i) {
+      if (i != crash_thread_index) {
+        AddMemoryRange(threads[i].stack.start_of_memory_range,
+                       threads[i].stack.memory.data_size);
+      }
+    }
   }
 
-  // Write application-provided memory regions.
-  bool WriteAppMemory() {
+  // Adds the |size| bytes at |start| to the ranges to be dumped if the
+  // bytes not already among them fit in |*budget|, and takes those bytes
+  // from |*budget|.
+  void TakeRangeFromBudget(size_t* budget, uintptr_t start, size_t size) {
+    const size_t charge = UncoveredBytes(start, size);
+    if (charge > *budget)
+      return;
+    *budget -= charge;
+    AddMemoryRange(start, size);
+  }
+
+  // Returns how many of the |size| bytes at |start| are not in any of the
+  // ranges to be dumped so far.
+  size_t UncoveredBytes(uintptr_t start, size_t size) {
+    const uintptr_t end = start + size;
+    wasteful_vector<MemoryRange> overlaps(dumper_->allocator());
+    for (size_t i = 0; i < memory_ranges_.size(); ++i) {
+      const MemoryRange& range = memory_ranges_[i];
+      const uintptr_t overlap_start = std::max(start, range.start);
+      const uintptr_t overlap_end = std::min(end, range.start + range.size);
+      if (overlap_start < overlap_end) {
+        MemoryRange overlap;
+        overlap.start = overlap_start;
+        overlap.size = overlap_end - overlap_start;
+        overlap.copy = NULL;
+        overlaps.push_back(overlap);
+      }
+    }
+    std::sort(overlaps.begin(), overlaps.end(), MemoryRangeLess);
+
+    // Count the bytes covered by the overlaps, once each.
+    size_t covered = 0;
+    uintptr_t covered_end = start;
+    for (size_t i = 0; i < overlaps.size(); ++i) {
+      const uintptr_t overlap_start =
+          std::max(overlaps[i].start, covered_end);
+      const uintptr_t overlap_end = overlaps[i].start + overlaps[i].size;
+      if (overlap_end > overlap_start) {
+        covered += overlap_end - overlap_start;
+        covered_end = overlap_end;
+      }
+    }
+    return size - covered;
+  }
+
+  // Add application-provided memory regions to the ranges to be dumped.
+  void AddAppMemoryRanges() {
     for (AppMemoryList::const_iterator iter = app_memory_list_.begin();
          iter != app_memory_list_.end();
          ++iter) {
-      uint8_t* data_copy =
-        reinterpret_cast<uint8_t*>(dumper_->allocator()->Alloc(iter->length));
-      dumper_->CopyFromProcess(data_copy, GetCrashThread(), iter->ptr,
-                               iter->length);
+      AddMemoryRange(reinterpret_cast<uintptr_t>(iter->ptr), iter->length);
+    }
+  }
+
+  // A range of the process's memory to be included in the dump and, once
+  // written, the copy read from the process.
+  struct MemoryRange {
+    uintptr_t start;
+    size_t size;
+    uint8_t* copy;
+  };
+
+  void AddMemoryRange(uintptr_t start, size_t size) {
+    if (size == 0)
+      return;
+    MemoryRange range;
+    range.start = start;
+    range.size = size;
+    range.copy = NULL;
+    memory_ranges_.push_back(range);
+  }
+
+  static bool MemoryRangeLess(const MemoryRange& a, const MemoryRange& b) {
+    return a.start < b.start;
+  }
 
+  // Sorts the collected memory ranges, merges the ones that overlap or
+  // touch, and writes each merged block to the dump with one read from the
+  // process and one write to the file. The blocks are recorded in
+  // memory_blocks_ for the memory list stream.
+  bool WriteMemoryRanges() {
+    std::sort(memory_ranges_.begin(), memory_ranges_.end(), MemoryRangeLess);
+
+    size_t merged = 0;
+    for (size_t i = 0; i < memory_ranges_.size(); ++i) {
+      const MemoryRange& range = memory_ranges_[i];
+      if (merged > 0) {
+        MemoryRange& last = memory_ranges_[merged - 1];
+        if (range.start <= last.start + last.size) {
+          const uintptr_t end = range.start + range.size;
+          if (end > last.start + last.size)
+            last.size = end - last.start;
+          continue;
+        }
+      }
+      memory_ranges_[merged++] = range;
+    }
+    memory_ranges_.resize(merged);
+    if (snapshot_delta_)
+      KeepWrittenPages();
+
+    for (size_t i = 0; i < memory_ranges_.size(); ++i) {
+      MemoryRange& range = memory_ranges_[i];
       UntypedMDRVA memory(&minidump_writer_);
-      if (!memory.Allocate(iter->length)) {
+      if (!memory.Allocate(range.size))
         return false;
-      }
-      memory.Copy(data_copy, iter->length);
+      range.copy = reinterpret_cast<uint8_t*>(Alloc(range.size));
+      dumper_->CopyFromProcess(range.copy, GetCrashThread(),
+                               reinterpret_cast<void*>(range.start),
+                               range.size);
+      memory.Copy(range.copy, range.size);
+
       MDMemoryDescriptor desc;
-      desc.start_of_memory_range = reinterpret_cast<uintptr_t>(iter->ptr);
+      desc.start_of_memory_range = range.start;
       desc.memory = memory.location();
       memory_blocks_.push_back(desc);
     }
-
     return true;
   }
 
+  // Replaces the merged memory ranges with the parts of them on pages that
+  // the process has written since the snapshot series' base was taken, by
+  // the soft-dirty bits in its page map.  If the page map can't be read,
+  // the ranges are kept whole.
+  void KeepWrittenPages() {
+    char path[NAME_MAX];
+    if (!dumper_->BuildProcPath(path, dumper_->pid(), "pagemap"))
+      return;
+    const int fd = sys_open(path, O_RDONLY, 0);
+    if (fd < 0)
+      return;
+
+    const uintptr_t page_size = getpagesize();
+    uint64_t* entries = reinterpret_cast<uint64_t*>(
+        Alloc(kPageMapBatch * sizeof(uint64_t)));
+    wasteful_vector<MemoryRange> written(dumper_->allocator(),
+                                         memory_ranges_.size());
+    bool read_all = true;
+    for (size_t i = 0; i < memory_ranges_.size() && read_all; ++i) {
+      const uintptr_t start = memory_ranges_[i].start;
+      const uintptr_t end = start + memory_ranges_[i].size;
+      uintptr_t page = start - start % page_size;
+      while (page < end) {
+        size_t count = (end - page + page_size - 1) / page_size;
+        if (count > kPageMapBatch)
+          count = kPageMapBatch;
+        const size_t bytes = count * sizeof(uint64_t);
+        if (sys_pread64(fd, entries, bytes,
+                        page / page_size * sizeof(uint64_t)) !=
+            static_cast<ssize_t>(bytes)) {
+          read_all = false;
+          break;
+        }
+        for (size_t j = 0; j < count; ++j, page += page_size) {
+          if (!(entries[j] & kPageMapSoftDirty))
+            continue;
+          const uintptr_t run_start = page > start ? page : start;
+          const uintptr_t run_end = page + page_size < end ?
+              page + page_size : end;
+          if (!written.empty() &&
+              written.back().start + written.back().size == run_start) {
+            written.back().size += run_end - run_start;
+          } else {
+            MemoryRange range;
+            range.start = run_start;
+            range.size = run_end - run_start;
+            range.copy = NULL;
+            written.push_back(range);
+          }
+        }
+      }
+    }
+    sys_close(fd);
+    if (!read_all)
+      return;
+
+    memory_ranges_.clear();
+    for (size_t i = 0; i < written.size(); ++i)
+      memory_ranges_.push_back(written[i]);
+  }
+
+  // Finds the block written by WriteMemoryRanges() that holds the memory
+  // starting at |start|, sets the RVA in |location| to the position of
+  // that memory in the dump, and returns a pointer to its copy.
+  // |location->data_size| must already hold the size of the memory.
+  uint8_t* FindMemoryBlock(uintptr_t start, MDLocationDescriptor* location) {
+    size_t low = 0;
+    size_t high = memory_ranges_.size();
+    while (high - low > 1) {
+      const size_t middle = low + (high - low) / 2;
+      if (memory_ranges_[middle].start <= start)
+        low = middle;
+      else
+        high = middle;
+    }
+    assert(low < memory_ranges_.size());
+    const MemoryRange& range = memory_ranges_[low];
+    const uintptr_t offset = start - range.start;
+    assert(start >= range.start &&
+           offset + location->data_size <= range.size);
+    location->rva = memory_blocks_[low].memory.rva + offset;
+    return range.copy + offset;
+  }
+
   static bool ShouldIncludeMapping(const MappingInfo& mapping) {
     if (mapping.name[0] == 0 ||  // only want modules with filenames.
         // Only want to include one mapping per shared lib.
@@ -478,6 +935,25 @@ class MinidumpWriter {
     return false;
   }
 
+  // Starts the identifier helpers, if any, on the mappings that
+  // WriteMappings() writes from the dumper.
+  void StartIdentifierHelpers() {
+    const unsigned num_mappings = dumper_->mappings().size();
+    if (identifier_helpers_ == 0 || num_mappings == 0)
+      return;
+    unsigned int* mapping_ids = static_cast<unsigned int*>(
+        Alloc(num_mappings * sizeof(unsigned int)));
+    if (!mapping_ids)
+      return;
+    size_t count = 0;
+    for (unsigned i = 0; i < num_mappings; ++i) {
+      const MappingInfo& mapping = *dumper_->mappings()[i];
+      if (ShouldIncludeMapping(mapping) && !HaveMappingInfo(mapping))
+        mapping_ids[count++] = i;
+    }
+    dumper_->StartIdentifierHelpers(mapping_ids, count, identifier_helpers_);
+  }
+
   // Write information about the mappings in effect. Because we are using the
   // minidump format, the information about the mappings is pretty limited.
   // Because of this, we also include the full, unparsed, /proc/$x/maps file in
@@ -558,8 +1034,10 @@ class MinidumpWriter {
       my_memcpy(signature, identifier, sizeof(MDGUID));
     } else {
       // Note: ElfFileIdentifierForMapping() can manipulate the |mapping.name|.
+      const uint64_t start_ns = MonotonicNanoseconds();
       dumper_->ElfFileIdentifierForMapping(mapping, member,
                                            mapping_id, signature);
+      EndPhase(MD_HANDLER_PHASE_IDENTIFIERS, start_ns);
     }
     my_memset(cv_ptr, 0, sizeof(uint32_t));  // Set age to 0 on Linux.
     cv_ptr += sizeof(uint32_t);
@@ -644,6 +1122,60 @@ class MinidumpWriter {
     return true;
   }
 
+  // Orders indices into a link_map array by the address of the name.
+  struct LinkMapNameLess {
+    explicit LinkMapNameLess(const struct link_map* maps) : maps_(maps) {}
+    bool operator()(size_t a, size_t b) const {
+      return maps_[a].l_name < maps_[b].l_name;
+    }
+    const struct link_map* maps_;
+  };
+
+  // Reads the names of the |count| DSOs in |maps| into |names|, which has
+  // room for |count| names of kDSONameLength + 1 bytes. The dynamic loader
+  // allocates the names close together, so they are read in address order
+  // and the names that lie within kDSONameBatchSpan bytes of each other are
+  // read with a single CopyFromProcess().
+  void ReadDSONames(const struct link_map* maps, size_t count, char* names) {
+    my_memset(names, 0, count * (kDSONameLength + 1));
+    size_t* order = reinterpret_cast<size_t*>(Alloc(count * sizeof(size_t)));
+    size_t named = 0;
+    for (size_t i = 0; i < count; ++i) {
+      if (maps[i].l_name)
+        order[named++] = i;
+    }
+    std::sort(order, order + named, LinkMapNameLess(maps));
+
+    uint8_t* batch = reinterpret_cast<uint8_t*>(
+        Alloc(kDSONameBatchSpan + kDSONameLength));
+    for (size_t first = 0; first < named; ) {
+      const uintptr_t start =
+          reinterpret_cast<uintptr_t>(maps[order[first]].l_name);
+      size_t last = first + 1;
+      while (last < named &&
+             reinterpret_cast<uintptr_t>(maps[order[last]].l_name) - start <
+                 kDSONameBatchSpan) {
+        ++last;
+      }
+      const uintptr_t end =
+          reinterpret_cast<uintptr_t>(maps[order[last - 1]].l_name) +
+          kDSONameLength;
+      dumper_->CopyFromProcess(batch, GetCrashThread(),
+                               reinterpret_cast<void*>(start), end - start);
+      for (size_t i = first; i < last; ++i) {
+        const uintptr_t offset =
+            reinterpret_cast<uintptr_t>(maps[order[i]].l_name) - start;
+        my_memcpy(names + order[i] * (kDSONameLength + 1), batch + offset,
+                  kDSONameLength);
+      }
+      first = last;
+    }
+  }
+
+  // Writes the MD_LINUX_DSO_DEBUG stream, which holds the program's dynamic
+  // section and the dynamic loader's list of DSOs. The program headers and
+  // the dynamic section are each read with one CopyFromProcess(), the DSO
+  // list is walked once, and the DSO names are read in batches.
   bool WriteDSODebugStream(MDRawDirectory* dirent) {
     ElfW(Phdr)* phdr = reinterpret_cast<ElfW(Phdr) *>(dumper_->auxv()[AT_PHDR]);
     char* base;
@@ -655,10 +1187,14 @@ class MinidumpWriter {
     base = reinterpret_cast<char *>(reinterpret_cast<uintptr_t>(phdr) & ~0xfff);
 
     // Search for the program PT_DYNAMIC segment
+    ElfW(Phdr)* phdrs = reinterpret_cast<ElfW(Phdr)*>(
+        Alloc(phnum * sizeof(ElfW(Phdr))));
+    dumper_->CopyFromProcess(phdrs, GetCrashThread(), phdr,
+                             phnum * sizeof(ElfW(Phdr)));
     ElfW(Addr) dyn_addr = 0;
-    for (; phnum >= 0; phnum--, phdr++) {
-      ElfW(Phdr) ph;
-      dumper_->CopyFromProcess(&ph, GetCrashThread(), phdr, sizeof(ph));
+    size_t dyn_size = 0;
+    for (int i = 0; i < phnum; ++i) {
+      const ElfW(Phdr)& ph = phdrs[i];
       // Adjust base address with the virtual address of the PT_LOAD segment
       // corresponding to offset 0
       if (ph.p_type == PT_LOAD && ph.p_offset == 0) {
@@ -666,9 +1202,10 @@ class MinidumpWriter {
       }
       if (ph.p_type == PT_DYNAMIC) {
         dyn_addr = ph.p_vaddr;
+        dyn_size = ph.p_memsz;
       }
     }
-    if (!dyn_addr)
+    if (!dyn_addr || dyn_size < sizeof(ElfW(Dyn)))
       return false;
 
     ElfW(Dyn) *dynamic = reinterpret_cast<ElfW(Dyn) *>(dyn_addr + base);
@@ -677,17 +1214,17 @@ class MinidumpWriter {
     // DSOs loaded into the program. If this information is indeed available,
     // dump it to a MD_LINUX_DSO_DEBUG stream.
     struct r_debug* r_debug = NULL;
+    const size_t dyn_count = dyn_size / sizeof(ElfW(Dyn));
+    ElfW(Dyn)* dyns = reinterpret_cast<ElfW(Dyn)*>(
+        Alloc(dyn_count * sizeof(ElfW(Dyn))));
+    dumper_->CopyFromProcess(dyns, GetCrashThread(), dynamic,
+                             dyn_count * sizeof(ElfW(Dyn)));
     uint32_t dynamic_length = 0;
-
-    for (int i = 0;;) {
-      ElfW(Dyn) dyn;
-      dynamic_length += sizeof(dyn);
-      dumper_->CopyFromProcess(&dyn, GetCrashThread(), dynamic+i++,
-                               sizeof(dyn));
-      if (dyn.d_tag == DT_DEBUG) {
-        r_debug = reinterpret_cast<struct r_debug*>(dyn.d_un.d_ptr);
-        continue;
-      } else if (dyn.d_tag == DT_NULL) {
+    for (size_t i = 0; i < dyn_count; ++i) {
+      dynamic_length += sizeof(ElfW(Dyn));
+      if (dyns[i].d_tag == DT_DEBUG) {
+        r_debug = reinterpret_cast<struct r_debug*>(dyns[i].d_un.d_ptr);
+      } else if (dyns[i].d_tag == DT_NULL) {
         break;
       }
     }
@@ -699,18 +1236,17 @@ class MinidumpWriter {
     // directly. Instead, we use CopyFromProcess() everywhere.
     // See <link.h> for a more detailed discussion of the how the dynamic
     // loader communicates with debuggers.
-
-    // Count the number of loaded DSOs
-    int dso_count = 0;
     struct r_debug debug_entry;
     dumper_->CopyFromProcess(&debug_entry, GetCrashThread(), r_debug,
                              sizeof(debug_entry));
+    wasteful_vector<struct link_map> maps(dumper_->allocator());
     for (struct link_map* ptr = debug_entry.r_map; ptr; ) {
       struct link_map map;
       dumper_->CopyFromProcess(&map, GetCrashThread(), ptr, sizeof(map));
       ptr = map.l_next;
-      dso_count++;
+      maps.push_back(map);
     }
+    const int dso_count = maps.size();
 
     MDRVA linkmap_rva = minidump_writer_.kInvalidMDRVA;
     if (dso_count > 0) {
@@ -720,26 +1256,22 @@ class MinidumpWriter {
       if (!linkmap.AllocateArray(dso_count))
         return false;
       linkmap_rva = linkmap.location().rva;
-      int idx = 0;
+
+      char* names = reinterpret_cast<char*>(
+          Alloc(dso_count * (kDSONameLength + 1)));
+      ReadDSONames(&maps[0], dso_count, names);
 
       // Iterate over DSOs and write their information to mini dump
-      for (struct link_map* ptr = debug_entry.r_map; ptr; ) {
-        struct link_map map;
-        dumper_->CopyFromProcess(&map, GetCrashThread(), ptr, sizeof(map));
-        ptr = map.l_next;
-        char filename[257] = { 0 };
-        if (map.l_name) {
-          dumper_->CopyFromProcess(filename, GetCrashThread(), map.l_name,
-                                   sizeof(filename) - 1);
-        }
+      for (int i = 0; i < dso_count; ++i) {
         MDLocationDescriptor location;
-        if (!minidump_writer_.WriteString(filename, 0, &location))
+        if (!minidump_writer_.WriteString(names + i * (kDSONameLength + 1), 0,
+                                          &location))
           return false;
         MDRawLinkMap entry;
         entry.name = location.rva;
-        entry.addr = map.l_addr;
-        entry.ld = reinterpret_cast<uintptr_t>(map.l_ld);
-        linkmap.CopyIndex(idx++, &entry);
+        entry.addr = maps[i].l_addr;
+        entry.ld = reinterpret_cast<uintptr_t>(maps[i].l_ld);
+        linkmap.CopyIndex(i, &entry);
       }
     }
 
@@ -758,19 +1290,184 @@ class MinidumpWriter {
     debug.get()->ldbase = debug_entry.r_ldbase;
     debug.get()->dynamic = reinterpret_cast<uintptr_t>(dynamic);
 
-    wasteful_vector<char> dso_debug_data(dumper_->allocator(), dynamic_length);
-    // The passed-in size to the constructor (above) is only a hint.
-    // Must call .resize() to do actual initialization of the elements.
-    dso_debug_data.resize(dynamic_length);
-    dumper_->CopyFromProcess(&dso_debug_data[0], GetCrashThread(), dynamic,
-                             dynamic_length);
-    debug.CopyIndexAfterObject(0, &dso_debug_data[0], dynamic_length);
+    debug.CopyIndexAfterObject(0, dyns, dynamic_length);
 
     return true;
   }
 
+  // Writes the MD_LINUX_ANNOTATIONS stream from a copy of annotations_
+  // read from the process.  The threads that record annotations are
+  // suspended, so the copy can only miss an annotation being recorded.
+  bool WriteAnnotationsStream(MDRawDirectory* dirent) {
+    if (!annotations_)
+      return false;
+
+    CrashAnnotations* annotations =
+        reinterpret_cast<CrashAnnotations*>(Alloc(sizeof(CrashAnnotations)));
+    dumper_->CopyFromProcess(annotations, GetCrashThread(), annotations_,
+                             sizeof(CrashAnnotations));
+    const size_t max_count = CrashAnnotations::max_annotations();
+    MDRawAnnotation* records = reinterpret_cast<MDRawAnnotation*>(
+        Alloc(max_count * sizeof(MDRawAnnotation)));
+    const size_t count = annotations->GetAnnotations(records, max_count);
+
+    TypedMDRVA<uint32_t> list(&minidump_writer_);
+    if (!list.AllocateObjectAndArray(count, sizeof(MDRawAnnotation)))
+      return false;
+    *list.get() = count;
+    for (size_t i = 0; i < count; ++i)
+      list.CopyIndexAfterObject(i, &records[i], sizeof(MDRawAnnotation));
+
+    dirent->stream_type = MD_LINUX_ANNOTATIONS;
+    dirent->location = list.location();
+    return true;
+  }
+
+  // Decides whether this dump is the base of snapshot_series_ or a delta
+  // of it, and fills in snapshot_info_.
+  void StartSnapshot() {
+    if (!snapshot_series_)
+      return;
+    my_memset(&snapshot_info_, 0, sizeof(snapshot_info_));
+    snapshot_info_.size_of_header = sizeof(MDRawSnapshotInfo);
+    snapshot_info_.size_of_entry = sizeof(MDRawSnapshotStack);
+    snapshot_info_.process_id = dumper_->pid();
+    snapshot_info_.page_size = getpagesize();
+    if (snapshot_series_->next_sequence > 0 &&
+        snapshot_series_->process_id == dumper_->pid() &&
+        !dumper_->IsPostMortem()) {
+      snapshot_delta_ = true;
+      snapshot_info_.sequence = snapshot_series_->next_sequence++;
+      snapshot_info_.series_id = snapshot_series_->series_id;
+      return;
+    }
+
+    // A new series, which needs an identifier of its own.
+    snapshot_series_->next_sequence = 0;
+    const int fd = sys_open("/dev/urandom", O_RDONLY, 0);
+    bool random = false;
+    if (fd >= 0) {
+      random = sys_read(fd, &snapshot_info_.series_id,
+                        sizeof(snapshot_info_.series_id)) ==
+               static_cast<ssize_t>(sizeof(snapshot_info_.series_id));
+      sys_close(fd);
+    }
+    if (!random) {
+      const uint64_t now_ns = MonotonicNanoseconds();
+      snapshot_info_.series_id.data1 = dumper_->pid();
+      my_memcpy(snapshot_info_.series_id.data4, &now_ns, sizeof(now_ns));
+    }
+  }
+
+  // Clears the soft-dirty bits of the process's pages, so that the next
+  // dump of snapshot_series_ can be a delta of this one.  Without
+  // soft-dirty tracking, the series doesn't start.
+  void FinishSnapshotBase() {
+    if (dumper_->IsPostMortem())
+      return;
+    char path[NAME_MAX];
+    if (!dumper_->BuildProcPath(path, dumper_->pid(), "clear_refs"))
+      return;
+    const int fd = sys_open(path, O_WRONLY, 0);
+    if (fd < 0)
+      return;
+    // Writing 4 clears the soft-dirty bits.
+    const bool cleared = sys_write(fd, "4", 1) == 1;
+    sys_close(fd);
+    if (!cleared)
+      return;
+    snapshot_series_->process_id = dumper_->pid();
+    snapshot_series_->series_id = snapshot_info_.series_id;
+    snapshot_series_->next_sequence = 1;
+  }
+
+  // Writes the MD_LINUX_SNAPSHOT stream, if the dump is a snapshot.
+  bool WriteSnapshotStream(MDRawDirectory* dirent) {
+    if (!snapshot_series_)
+      return false;
+
+    const size_t count = snapshot_stacks_.size();
+    snapshot_info_.number_of_entries = count;
+    TypedMDRVA<MDRawSnapshotInfo> info(&minidump_writer_);
+    if (!info.AllocateObjectAndArray(count, sizeof(MDRawSnapshotStack)))
+      return false;
+    my_memcpy(info.get(), &snapshot_info_, sizeof(snapshot_info_));
+    for (size_t i = 0; i < count; ++i) {
+      info.CopyIndexAfterObject(i, &snapshot_stacks_[i],
+                                sizeof(MDRawSnapshotStack));
+    }
+
+    dirent->stream_type = MD_LINUX_SNAPSHOT;
+    dirent->location = info.location();
+    return true;
+  }
+
+  // Writes the MD_LINUX_HANDLER_TIMING stream, with the phases that ran.
+  bool WriteHandlerTimingStream(MDRawDirectory* dirent) {
+    unsigned count = 0;
+    for (unsigned i = 0; i < kHandlerPhaseCount; ++i) {
+      if (timings_[i].count)
+        ++count;
+    }
+
+    TypedMDRVA<MDRawHandlerTimingList> list(&minidump_writer_);
+    if (!list.AllocateObjectAndArray(count, sizeof(MDRawHandlerTiming)))
+      return false;
+    my_memset(list.get(), 0, sizeof(MDRawHandlerTimingList));
+    list.get()->size_of_header = sizeof(MDRawHandlerTimingList);
+    list.get()->size_of_entry = sizeof(MDRawHandlerTiming);
+    list.get()->number_of_entries = count;
+    list.get()->start_time = handler_start_ns_;
+    unsigned index = 0;
+    for (unsigned i = 0; i < kHandlerPhaseCount; ++i) {
+      if (timings_[i].count) {
+        list.CopyIndexAfterObject(index++, &timings_[i],
+                                  sizeof(MDRawHandlerTiming));
+      }
+    }
+
+    dirent->stream_type = MD_LINUX_HANDLER_TIMING;
+    dirent->location = list.location();
+    return true;
+  }
+
   void set_minidump_size_limit(off_t limit) { minidump_size_limit_ = limit; }
 
+  void set_size_limit_policy(MinidumpSizeLimitPolicy policy) {
+    size_limit_policy_ = policy;
+  }
+
+  // Write the minidump compressed; see common/minidump_compression.h.
+  void set_compressed(bool compressed) {
+    minidump_writer_.set_compressed(compressed);
+  }
+
+  // Writes the annotations in |annotations|, an address in the crashing
+  // process, to the dump.  |annotations| may be NULL.
+  void set_annotations(const CrashAnnotations* annotations) {
+    annotations_ = annotations;
+  }
+
+  // Has up to |helpers| helper tasks read the modules' files for their
+  // identifiers; see LinuxDumper::StartIdentifierHelpers().  With none, the
+  // files are read one at a time as the module list is written.
+  void set_identifier_helpers(unsigned int helpers) {
+    identifier_helpers_ = helpers;
+  }
+
+  // Writes the dump as the next snapshot of |series|, which may be NULL.
+  void set_snapshot_series(MinidumpSnapshotSeries* series) {
+    snapshot_series_ = series;
+  }
+
+  // Has the phases of writing the minidump timed in |statistics|, which may
+  // be NULL.
+  void set_statistics(MinidumpWriterStatistics* statistics) {
+    statistics_ = statistics;
+    if (statistics_)
+      my_memset(statistics_, 0, sizeof(*statistics_));
+  }
+
  private:
   void* Alloc(unsigned bytes) {
     return dumper_->allocator()->Alloc(bytes);
@@ -780,6 +1477,20 @@ class MinidumpWriter {
     return dumper_->crash_thread();
   }
 
+  MDRawHandlerTiming* timing(MDHandlerPhase phase) {
+    return &timings_[phase - 1];
+  }
+
+  // Adds the time from |start_ns| until now to |phase|, and returns now.
+  uint64_t EndPhase(MDHandlerPhase phase, uint64_t start_ns) {
+    const uint64_t end_ns = MonotonicNanoseconds();
+    MDRawHandlerTiming* phase_timing = timing(phase);
+    if (phase_timing->count++ == 0)
+      phase_timing->start_time = start_ns - handler_start_ns_;
+    phase_timing->duration += end_ns - start_ns;
+    return end_ns;
+  }
+
   void NullifyDirectoryEntry(MDRawDirectory* dirent) {
     dirent->stream_type = 0;
     dirent->location.data_size = 0;
@@ -1108,59 +1819,12 @@ class MinidumpWriter {
       return false;
 
     // We can't stat the files because several of the files that we want to
-    // read are kernel seqfiles, which always have a length of zero. So we have
-    // to read as much as we can into a buffer.
-    static const unsigned kBufSize = 1024 - 2*sizeof(void*);
-    struct Buffers {
-      Buffers* next;
-      size_t len;
-      uint8_t data[kBufSize];
-    } *buffers = reinterpret_cast<Buffers*>(Alloc(sizeof(Buffers)));
-    buffers->next = NULL;
-    buffers->len = 0;
-
-    size_t total = 0;
-    for (Buffers* bufptr = buffers;;) {
-      ssize_t r;
-      do {
-        r = sys_read(fd, &bufptr->data[bufptr->len], kBufSize - bufptr->len);
-      } while (r == -1 && errno == EINTR);
-
-      if (r < 1)
-        break;
-
-      total += r;
-      bufptr->len += r;
-      if (bufptr->len == kBufSize) {
-        bufptr->next = reinterpret_cast<Buffers*>(Alloc(sizeof(Buffers)));
-        bufptr = bufptr->next;
-        bufptr->next = NULL;
-        bufptr->len = 0;
-      }
-    }
+    // read are kernel seqfiles, which always have a length of zero. So the
+    // file is copied to the end of the dump as it is read, and its size
+    // filled in afterwards.
+    const bool copied = minidump_writer_.CopyFile(fd, result);
     sys_close(fd);
-
-    if (!total)
-      return false;
-
-    UntypedMDRVA memory(&minidump_writer_);
-    if (!memory.Allocate(total))
-      return false;
-    for (MDRVA pos = memory.position(); buffers; buffers = buffers->next) {
-      // Check for special case of a zero-length buffer.  This should only
-      // occur if a file's size happens to be a multiple of the buffer's
-      // size, in which case the final sys_read() will have resulted in
-      // zero bytes being read after the final buffer was just allocated.
-      if (buffers->len == 0) {
-        // This can only occur with final buffer.
-        assert(buffers->next == NULL);
-        continue;
-      }
-      memory.Copy(pos, &buffers->data, buffers->len);
-      pos += buffers->len;
-    }
-    *result = memory.location();
-    return true;
+    return copied && result->data_size != 0;
   }
 
   bool WriteOSInformation(MDRawSystemInfo* sys_info) {
@@ -1232,27 +1896,60 @@ class MinidumpWriter {
   LinuxDumper* dumper_;
   MinidumpFileWriter minidump_writer_;
   off_t minidump_size_limit_;
+  MinidumpSizeLimitPolicy size_limit_policy_;
   MDLocationDescriptor crashing_thread_context_;
-  // Blocks of memory written to the dump. These are all currently
-  // written while writing the thread list stream, but saved here
-  // so a memory list stream can be written afterwards.
+  // The memory to be dumped. These ranges are collected while writing the
+  // thread list stream and merged when they are written.
+  wasteful_vector<MemoryRange> memory_ranges_;
+  // Blocks of memory written to the dump, one per merged memory range.
+  // These are all currently written while writing the thread list stream,
+  // but saved here so a memory list stream can be written afterwards.
   wasteful_vector<MDMemoryDescriptor> memory_blocks_;
   // Additional information about some mappings provided by the caller.
   const MappingList& mapping_list_;
   // Additional memory regions to be included in the dump,
   // provided by the caller.
   const AppMemoryList& app_memory_list_;
+  // Where the process keeps its annotations, or NULL.
+  const CrashAnnotations* annotations_;
+  // The most helper tasks to read the modules' files on.
+  unsigned int identifier_helpers_;
+  // The snapshot series the dump is part of, or NULL, whether the dump is
+  // a delta, its MD_LINUX_SNAPSHOT header, and, for a delta, the stacks
+  // its threads would have held.
+  MinidumpSnapshotSeries* snapshot_series_;
+  bool snapshot_delta_;
+  MDRawSnapshotInfo snapshot_info_;
+  wasteful_vector<MDRawSnapshotStack> snapshot_stacks_;
+
+  // Where to record how long writing the minidump takes, or NULL, and when
+  // the stream being written was started.
+  MinidumpWriterStatistics* statistics_;
+  uint64_t stream_start_ns_;
+
+  // When the handler was entered, and how long each of its phases took,
+  // for the MD_LINUX_HANDLER_TIMING stream.  timings_[i] is phase i + 1.
+  uint64_t handler_start_ns_;
+  MDRawHandlerTiming timings_[kHandlerPhaseCount];
 };
 
 
 bool WriteMinidumpImpl(const char* minidump_path,
                        int minidump_fd,
                        off_t minidump_size_limit,
+                       MinidumpSizeLimitPolicy size_limit_policy,
+                       bool compressed,
                        pid_t crashing_process,
                        const void* blob, size_t blob_size,
                        const MappingList& mappings,
-                       const AppMemoryList& appmem) {
+                       const AppMemoryList& appmem,
+                       const ModuleIdentifierCache* module_identifiers,
+                       const CrashAnnotations* annotations,
+                       unsigned int identifier_helpers,
+                       MinidumpSnapshotSeries* snapshot_series,
+                       MinidumpWriterStatistics* statistics) {
   LinuxPtraceDumper dumper(crashing_process);
+  dumper.set_module_identifier_cache(module_identifiers);
   const ExceptionHandler::CrashContext* context = NULL;
   if (blob) {
     if (blob_size != sizeof(ExceptionHandler::CrashContext))
@@ -1267,9 +1964,21 @@ bool WriteMinidumpImpl(const char* minidump_path,
                         appmem, &dumper);
   // Set desired limit for file size of minidump (-1 means no limit).
   writer.set_minidump_size_limit(minidump_size_limit);
+  writer.set_size_limit_policy(size_limit_policy);
+  writer.set_compressed(compressed);
+  writer.set_annotations(annotations);
+  writer.set_identifier_helpers(identifier_helpers);
+  writer.set_snapshot_series(snapshot_series);
+  writer.set_statistics(statistics);
+  const uint64_t start_ns = statistics ? MonotonicNanoseconds() : 0;
   if (!writer.Init())
     return false;
-  return writer.Dump();
+  const bool dumped = writer.Dump();
+  if (statistics) {
+    statistics->total_ns = MonotonicNanoseconds() - start_ns;
+    statistics->allocator_pages = dumper.allocator()->pages_allocated();
+  }
+  return dumped;
 }
 
 }  // namespace
@@ -1279,15 +1988,19 @@ namespace google_breakpad {
 bool WriteMinidump(const char* minidump_path, pid_t crashing_process,
                    const void* blob, size_t blob_size) {
   return WriteMinidumpImpl(minidump_path, -1, -1,
+                           kSizeLimitTruncateExtraThreads, false,
                            crashing_process, blob, blob_size,
-                           MappingList(), AppMemoryList());
+                           MappingList(), AppMemoryList(), NULL, NULL, 0, NULL,
+                           NULL);
 }
 
 bool WriteMinidump(int minidump_fd, pid_t crashing_process,
                    const void* blob, size_t blob_size) {
   return WriteMinidumpImpl(NULL, minidump_fd, -1,
+                           kSizeLimitTruncateExtraThreads, false,
                            crashing_process, blob, blob_size,
-                           MappingList(), AppMemoryList());
+                           MappingList(), AppMemoryList(), NULL, NULL, 0, NULL,
+                           NULL);
 }
 
 bool WriteMinidump(const char* minidump_path, pid_t process,
@@ -1307,38 +2020,262 @@ bool WriteMinidump(const char* minidump_path, pid_t crashing_process,
                    const void* blob, size_t blob_size,
                    const MappingList& mappings,
                    const AppMemoryList& appmem) {
-  return WriteMinidumpImpl(minidump_path, -1, -1, crashing_process,
+  return WriteMinidumpImpl(minidump_path, -1, -1,
+                           kSizeLimitTruncateExtraThreads, false, crashing_process,
                            blob, blob_size,
-                           mappings, appmem);
+                           mappings, appmem, NULL, NULL, 0, NULL, NULL);
 }
 
 bool WriteMinidump(int minidump_fd, pid_t crashing_process,
                    const void* blob, size_t blob_size,
                    const MappingList& mappings,
                    const AppMemoryList& appmem) {
-  return WriteMinidumpImpl(NULL, minidump_fd, -1, crashing_process,
+  return WriteMinidumpImpl(NULL, minidump_fd, -1,
+                           kSizeLimitTruncateExtraThreads, false, crashing_process,
                            blob, blob_size,
-                           mappings, appmem);
+                           mappings, appmem, NULL, NULL, 0, NULL, NULL);
+}
+
+bool WriteMinidump(const char* minidump_path, off_t minidump_size_limit,
+                   pid_t crashing_process,
+                   const void* blob, size_t blob_size,
+                   const MappingList& mappings,
+                   const AppMemoryList& appmem) {
+  return WriteMinidumpImpl(minidump_path, -1, minidump_size_limit,
+                           kSizeLimitTruncateExtraThreads, false,
+                           crashing_process, blob, blob_size,
+                           mappings, appmem, NULL, NULL, 0, NULL, NULL);
+}
+
+bool WriteMinidump(int minidump_fd, off_t minidump_size_limit,
+                   pid_t crashing_process,
+                   const void* blob, size_t blob_size,
+                   const MappingList& mappings,
+                   const AppMemoryList& appmem) {
+  return WriteMinidumpImpl(NULL, minidump_fd, minidump_size_limit,
+                           kSizeLimitTruncateExtraThreads, false,
+                           crashing_process, blob, blob_size,
+                           mappings, appmem, NULL, NULL, 0, NULL, NULL);
+}
+
+bool WriteMinidump(const char* minidump_path, off_t minidump_size_limit,
+                   bool compressed,
+                   pid_t crashing_process,
+                   const void* blob, size_t blob_size,
+                   const MappingList& mappings,
+                   const AppMemoryList& appmem) {
+  return WriteMinidumpImpl(minidump_path, -1, minidump_size_limit,
+                           kSizeLimitTruncateExtraThreads, compressed,
+                           crashing_process, blob, blob_size,
+                           mappings, appmem, NULL, NULL, 0, NULL, NULL);
+}
+
+bool WriteMinidump(int minidump_fd, off_t minidump_size_limit,
+                   bool compressed,
+                   pid_t crashing_process,
+                   const void* blob, size_t blob_size,
+                   const MappingList& mappings,
+                   const AppMemoryList& appmem) {
+  return WriteMinidumpImpl(NULL, minidump_fd, minidump_size_limit,
+                           kSizeLimitTruncateExtraThreads, compressed,
+                           crashing_process, blob, blob_size,
+                           mappings, appmem, NULL, NULL, 0, NULL, NULL);
 }
 
 bool WriteMinidump(const char* minidump_path, off_t minidump_size_limit,
+                   MinidumpSizeLimitPolicy size_limit_policy,
+                   bool compressed,
                    pid_t crashing_process,
                    const void* blob, size_t blob_size,
                    const MappingList& mappings,
                    const AppMemoryList& appmem) {
   return WriteMinidumpImpl(minidump_path, -1, minidump_size_limit,
+                           size_limit_policy, compressed,
                            crashing_process, blob, blob_size,
-                           mappings, appmem);
+                           mappings, appmem, NULL, NULL, 0, NULL, NULL);
 }
 
 bool WriteMinidump(int minidump_fd, off_t minidump_size_limit,
+                   MinidumpSizeLimitPolicy size_limit_policy,
+                   bool compressed,
                    pid_t crashing_process,
                    const void* blob, size_t blob_size,
                    const MappingList& mappings,
                    const AppMemoryList& appmem) {
   return WriteMinidumpImpl(NULL, minidump_fd, minidump_size_limit,
+                           size_limit_policy, compressed,
+                           crashing_process, blob, blob_size,
+                           mappings, appmem, NULL, NULL, 0, NULL, NULL);
+}
+
+bool WriteMinidump(const char* minidump_path, off_t minidump_size_limit,
+                   MinidumpSizeLimitPolicy size_limit_policy,
+                   bool compressed,
+                   pid_t crashing_process,
+                   const void* blob, size_t blob_size,
+                   const MappingList& mappings,
+                   const AppMemoryList& appmem,
+                   const ModuleIdentifierCache* module_identifiers) {
+  return WriteMinidumpImpl(minidump_path, -1, minidump_size_limit,
+                           size_limit_policy, compressed,
+                           crashing_process, blob, blob_size,
+                           mappings, appmem, module_identifiers, NULL, 0, NULL,
+                           NULL);
+}
+
+bool WriteMinidump(int minidump_fd, off_t minidump_size_limit,
+                   MinidumpSizeLimitPolicy size_limit_policy,
+                   bool compressed,
+                   pid_t crashing_process,
+                   const void* blob, size_t blob_size,
+                   const MappingList& mappings,
+                   const AppMemoryList& appmem,
+                   const ModuleIdentifierCache* module_identifiers) {
+  return WriteMinidumpImpl(NULL, minidump_fd, minidump_size_limit,
+                           size_limit_policy, compressed,
+                           crashing_process, blob, blob_size,
+                           mappings, appmem, module_identifiers, NULL, 0, NULL,
+                           NULL);
+}
+
+bool WriteMinidump(const char* minidump_path, off_t minidump_size_limit,
+                   MinidumpSizeLimitPolicy size_limit_policy,
+                   bool compressed,
+                   pid_t crashing_process,
+                   const void* blob, size_t blob_size,
+                   const MappingList& mappings,
+                   const AppMemoryList& appmem,
+                   const ModuleIdentifierCache* module_identifiers,
+                   MinidumpWriterStatistics* statistics) {
+  return WriteMinidumpImpl(minidump_path, -1, minidump_size_limit,
+                           size_limit_policy, compressed,
+                           crashing_process, blob, blob_size,
+                           mappings, appmem, module_identifiers, NULL, 0, NULL,
+                           statistics);
+}
+
+bool WriteMinidump(int minidump_fd, off_t minidump_size_limit,
+                   MinidumpSizeLimitPolicy size_limit_policy,
+                   bool compressed,
+                   pid_t crashing_process,
+                   const void* blob, size_t blob_size,
+                   const MappingList& mappings,
+                   const AppMemoryList& appmem,
+                   const ModuleIdentifierCache* module_identifiers,
+                   MinidumpWriterStatistics* statistics) {
+  return WriteMinidumpImpl(NULL, minidump_fd, minidump_size_limit,
+                           size_limit_policy, compressed,
+                           crashing_process, blob, blob_size,
+                           mappings, appmem, module_identifiers, NULL, 0, NULL,
+                           statistics);
+}
+
+bool WriteMinidump(const char* minidump_path, off_t minidump_size_limit,
+                   MinidumpSizeLimitPolicy size_limit_policy,
+                   bool compressed,
+                   pid_t crashing_process,
+                   const void* blob, size_t blob_size,
+                   const MappingList& mappings,
+                   const AppMemoryList& appmem,
+                   const ModuleIdentifierCache* module_identifiers,
+                   const CrashAnnotations* annotations,
+                   MinidumpWriterStatistics* statistics) {
+  return WriteMinidumpImpl(minidump_path, -1, minidump_size_limit,
+                           size_limit_policy, compressed,
+                           crashing_process, blob, blob_size,
+                           mappings, appmem, module_identifiers, annotations,
+                           0, NULL, statistics);
+}
+
+bool WriteMinidump(int minidump_fd, off_t minidump_size_limit,
+                   MinidumpSizeLimitPolicy size_limit_policy,
+                   bool compressed,
+                   pid_t crashing_process,
+                   const void* blob, size_t blob_size,
+                   const MappingList& mappings,
+                   const AppMemoryList& appmem,
+                   const ModuleIdentifierCache* module_identifiers,
+                   const CrashAnnotations* annotations,
+                   MinidumpWriterStatistics* statistics) {
+  return WriteMinidumpImpl(NULL, minidump_fd, minidump_size_limit,
+                           size_limit_policy, compressed,
+                           crashing_process, blob, blob_size,
+                           mappings, appmem, module_identifiers, annotations,
+                           0, NULL, statistics);
+}
+
+bool WriteMinidump(const char* minidump_path, off_t minidump_size_limit,
+                   MinidumpSizeLimitPolicy size_limit_policy,
+                   bool compressed,
+                   pid_t crashing_process,
+                   const void* blob, size_t blob_size,
+                   const MappingList& mappings,
+                   const AppMemoryList& appmem,
+                   const ModuleIdentifierCache* module_identifiers,
+                   const CrashAnnotations* annotations,
+                   unsigned int identifier_helpers,
+                   MinidumpWriterStatistics* statistics) {
+  return WriteMinidumpImpl(minidump_path, -1, minidump_size_limit,
+                           size_limit_policy, compressed,
+                           crashing_process, blob, blob_size,
+                           mappings, appmem, module_identifiers, annotations,
+                           identifier_helpers, NULL, statistics);
+}
+
+bool WriteMinidump(int minidump_fd, off_t minidump_size_limit,
+                   MinidumpSizeLimitPolicy size_limit_policy,
+                   bool compressed,
+                   pid_t crashing_process,
+                   const void* blob, size_t blob_size,
+                   const MappingList& mappings,
+                   const AppMemoryList& appmem,
+                   const ModuleIdentifierCache* module_identifiers,
+                   const CrashAnnotations* annotations,
+                   unsigned int identifier_helpers,
+                   MinidumpWriterStatistics* statistics) {
+  return WriteMinidumpImpl(NULL, minidump_fd, minidump_size_limit,
+                           size_limit_policy, compressed,
+                           crashing_process, blob, blob_size,
+                           mappings, appmem, module_identifiers, annotations,
+                           identifier_helpers, NULL, statistics);
+}
+
+bool WriteMinidump(const char* minidump_path, off_t minidump_size_limit,
+                   MinidumpSizeLimitPolicy size_limit_policy,
+                   bool compressed,
+                   pid_t crashing_process,
+                   const void* blob, size_t blob_size,
+                   const MappingList& mappings,
+                   const AppMemoryList& appmem,
+                   const ModuleIdentifierCache* module_identifiers,
+                   const CrashAnnotations* annotations,
+                   unsigned int identifier_helpers,
+                   MinidumpSnapshotSeries* snapshot_series,
+                   MinidumpWriterStatistics* statistics) {
+  return WriteMinidumpImpl(minidump_path, -1, minidump_size_limit,
+                           size_limit_policy, compressed,
+                           crashing_process, blob, blob_size,
+                           mappings, appmem, module_identifiers, annotations,
+                           identifier_helpers, snapshot_series, statistics);
+}
+
+bool WriteMinidump(int minidump_fd, off_t minidump_size_limit,
+                   MinidumpSizeLimitPolicy size_limit_policy,
+                   bool compressed,
+                   pid_t crashing_process,
+                   const void* blob, size_t blob_size,
+                   const MappingList& mappings,
+                   const AppMemoryList& appmem,
+                   const ModuleIdentifierCache* module_identifiers,
+                   const CrashAnnotations* annotations,
+                   unsigned int identifier_helpers,
+                   MinidumpSnapshotSeries* snapshot_series,
+                   MinidumpWriterStatistics* statistics) {
+  return WriteMinidumpImpl(NULL, minidump_fd, minidump_size_limit,
+                           size_limit_policy, compressed,
                            crashing_process, blob, blob_size,
-                           mappings, appmem);
+                           mappings, appmem, module_identifiers, annotations,
+                           identifier_helpers, snapshot_series, statistics);
 }
 
 bool WriteMinidump(const char* filename,
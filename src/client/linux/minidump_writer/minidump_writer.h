@@ -43,6 +43,8 @@
 
 namespace google_breakpad {
 
+class CrashAnnotations;
+
 class ExceptionHandler;
 
 #if defined(__aarch64__)
@@ -67,6 +69,58 @@ struct AppMemory {
 };
 typedef std::list<AppMemory> AppMemoryList;
 
+// How the minidump size limit, when there is one, is applied.
+enum MinidumpSizeLimitPolicy {
+  // Once the dump looks likely to exceed the limit, dump only the first
+  // couple of kilobytes of stack for every thread after the first 20.
+  kSizeLimitTruncateExtraThreads,
+  // Treat the limit as a byte budget and fill it with the memory most
+  // useful to the stack walker first: the crashing thread's stack and the
+  // memory around its registers, then the top of every other thread's
+  // stack, then the rest of those stacks.  Application-provided regions are
+  // always dumped and count against the budget.
+  kSizeLimitBudgeted
+};
+
+// How long the phases of writing a minidump took, and what they used, for
+// measuring the writer. Times are in nanoseconds of CLOCK_MONOTONIC.
+struct MinidumpWriterStatistics {
+  // The most streams that are timed individually.
+  static const unsigned kMaxStreams = 16;
+
+  // Reading the process's threads, mappings and auxiliary vector.
+  uint64_t init_ns;
+  // Suspending the process's threads.
+  uint64_t suspend_ns;
+  // Writing each stream, in the order of the stream directory.
+  unsigned stream_count;
+  uint32_t stream_types[kMaxStreams];
+  uint64_t stream_ns[kMaxStreams];
+  // Everything, from reading the process to resuming its threads.
+  uint64_t total_ns;
+  // The pages that the dumper's allocator took from the kernel, which it
+  // holds until the minidump is written.
+  size_t allocator_pages;
+  // The size of the minidump.
+  size_t minidump_size;
+};
+
+// The state of a series of snapshot minidumps of a live process; see
+// MD_LINUX_SNAPSHOT.  Zero it to start a series.  The first minidump
+// written with it is complete, and clears the process's soft-dirty bits;
+// each one after that holds only the memory the process has written since.
+// If the bits can't be cleared, because the kernel lacks soft-dirty
+// tracking, or the process is a different one, the next minidump is
+// complete and starts the series again.  The writer runs in a process of
+// its own, so this should be in memory shared with it.
+struct MinidumpSnapshotSeries {
+  // The process snapshotted, and the number of the next delta, or 0 if
+  // the next minidump is to be a base.
+  pid_t process_id;
+  uint32_t next_sequence;
+  MDGUID series_id;
+};
+
 // Writes a minidump to the filesystem. These functions do not malloc nor use
 // libc functions which may. Thus, it can be used in contexts where the state
 // of the heap may be corrupt.
@@ -114,6 +168,159 @@ bool WriteMinidump(int minidump_fd, off_t minidump_size_limit,
                    const MappingList& mappings,
                    const AppMemoryList& appdata);
 
+// These overloads also allow writing the minidump in the compressed format
+// described in common/minidump_compression.h, which Minidump in the
+// processor reads transparently.
+bool WriteMinidump(const char* minidump_path, off_t minidump_size_limit,
+                   bool compressed,
+                   pid_t crashing_process,
+                   const void* blob, size_t blob_size,
+                   const MappingList& mappings,
+                   const AppMemoryList& appdata);
+bool WriteMinidump(int minidump_fd, off_t minidump_size_limit,
+                   bool compressed,
+                   pid_t crashing_process,
+                   const void* blob, size_t blob_size,
+                   const MappingList& mappings,
+                   const AppMemoryList& appdata);
+
+// These overloads also allow choosing how the size limit is applied.
+bool WriteMinidump(const char* minidump_path, off_t minidump_size_limit,
+                   MinidumpSizeLimitPolicy size_limit_policy,
+                   bool compressed,
+                   pid_t crashing_process,
+                   const void* blob, size_t blob_size,
+                   const MappingList& mappings,
+                   const AppMemoryList& appdata);
+bool WriteMinidump(int minidump_fd, off_t minidump_size_limit,
+                   MinidumpSizeLimitPolicy size_limit_policy,
+                   bool compressed,
+                   pid_t crashing_process,
+                   const void* blob, size_t blob_size,
+                   const MappingList& mappings,
+                   const AppMemoryList& appdata);
+
+// These overloads also allow passing precomputed identifiers for the modules
+// of |crashing_process|, which are then used instead of reading the modules'
+// files.  |module_identifiers| may be NULL.
+bool WriteMinidump(const char* minidump_path, off_t minidump_size_limit,
+                   MinidumpSizeLimitPolicy size_limit_policy,
+                   bool compressed,
+                   pid_t crashing_process,
+                   const void* blob, size_t blob_size,
+                   const MappingList& mappings,
+                   const AppMemoryList& appdata,
+                   const ModuleIdentifierCache* module_identifiers);
+bool WriteMinidump(int minidump_fd, off_t minidump_size_limit,
+                   MinidumpSizeLimitPolicy size_limit_policy,
+                   bool compressed,
+                   pid_t crashing_process,
+                   const void* blob, size_t blob_size,
+                   const MappingList& mappings,
+                   const AppMemoryList& appdata,
+                   const ModuleIdentifierCache* module_identifiers);
+
+// These overloads also fill in |statistics|, which may be NULL.
+bool WriteMinidump(const char* minidump_path, off_t minidump_size_limit,
+                   MinidumpSizeLimitPolicy size_limit_policy,
+                   bool compressed,
+                   pid_t crashing_process,
+                   const void* blob, size_t blob_size,
+                   const MappingList& mappings,
+                   const AppMemoryList& appdata,
+                   const ModuleIdentifierCache* module_identifiers,
+                   MinidumpWriterStatistics* statistics);
+bool WriteMinidump(int minidump_fd, off_t minidump_size_limit,
+                   MinidumpSizeLimitPolicy size_limit_policy,
+                   bool compressed,
+                   pid_t crashing_process,
+                   const void* blob, size_t blob_size,
+                   const MappingList& mappings,
+                   const AppMemoryList& appdata,
+                   const ModuleIdentifierCache* module_identifiers,
+                   MinidumpWriterStatistics* statistics);
+
+// These overloads also write the annotations recorded in |annotations|,
+// which may be NULL, to a MD_LINUX_ANNOTATIONS stream.  |annotations| is
+// read from |crashing_process|, at the same address.
+bool WriteMinidump(const char* minidump_path, off_t minidump_size_limit,
+                   MinidumpSizeLimitPolicy size_limit_policy,
+                   bool compressed,
+                   pid_t crashing_process,
+                   const void* blob, size_t blob_size,
+                   const MappingList& mappings,
+                   const AppMemoryList& appdata,
+                   const ModuleIdentifierCache* module_identifiers,
+                   const CrashAnnotations* annotations,
+                   MinidumpWriterStatistics* statistics);
+bool WriteMinidump(int minidump_fd, off_t minidump_size_limit,
+                   MinidumpSizeLimitPolicy size_limit_policy,
+                   bool compressed,
+                   pid_t crashing_process,
+                   const void* blob, size_t blob_size,
+                   const MappingList& mappings,
+                   const AppMemoryList& appdata,
+                   const ModuleIdentifierCache* module_identifiers,
+                   const CrashAnnotations* annotations,
+                   MinidumpWriterStatistics* statistics);
+
+// These overloads also have up to |identifier_helpers| helper tasks read
+// the files of the modules whose build IDs aren't in the crashing
+// process's memory while the thread stacks are copied, rather than
+// reading the files one at a time as the module list is written, as 0
+// does.
+bool WriteMinidump(const char* minidump_path, off_t minidump_size_limit,
+                   MinidumpSizeLimitPolicy size_limit_policy,
+                   bool compressed,
+                   pid_t crashing_process,
+                   const void* blob, size_t blob_size,
+                   const MappingList& mappings,
+                   const AppMemoryList& appdata,
+                   const ModuleIdentifierCache* module_identifiers,
+                   const CrashAnnotations* annotations,
+                   unsigned int identifier_helpers,
+                   MinidumpWriterStatistics* statistics);
+bool WriteMinidump(int minidump_fd, off_t minidump_size_limit,
+                   MinidumpSizeLimitPolicy size_limit_policy,
+                   bool compressed,
+                   pid_t crashing_process,
+                   const void* blob, size_t blob_size,
+                   const MappingList& mappings,
+                   const AppMemoryList& appdata,
+                   const ModuleIdentifierCache* module_identifiers,
+                   const CrashAnnotations* annotations,
+                   unsigned int identifier_helpers,
+                   MinidumpWriterStatistics* statistics);
+
+// These overloads also write the minidump as the next snapshot of
+// |snapshot_series|, which may be NULL.  Only live processes are
+// snapshotted; the budgeted size limit is applied before unwritten pages
+// are left out.
+bool WriteMinidump(const char* minidump_path, off_t minidump_size_limit,
+                   MinidumpSizeLimitPolicy size_limit_policy,
+                   bool compressed,
+                   pid_t crashing_process,
+                   const void* blob, size_t blob_size,
+                   const MappingList& mappings,
+                   const AppMemoryList& appdata,
+                   const ModuleIdentifierCache* module_identifiers,
+                   const CrashAnnotations* annotations,
+                   unsigned int identifier_helpers,
+                   MinidumpSnapshotSeries* snapshot_series,
+                   MinidumpWriterStatistics* statistics);
+bool WriteMinidump(int minidump_fd, off_t minidump_size_limit,
+                   MinidumpSizeLimitPolicy size_limit_policy,
+                   bool compressed,
+                   pid_t crashing_process,
+                   const void* blob, size_t blob_size,
+                   const MappingList& mappings,
+                   const AppMemoryList& appdata,
+                   const ModuleIdentifierCache* module_identifiers,
+                   const CrashAnnotations* annotations,
+                   unsigned int identifier_helpers,
+                   MinidumpSnapshotSeries* snapshot_series,
+                   MinidumpWriterStatistics* statistics);
+
 bool WriteMinidump(const char* filename,
                    const MappingList& mappings,
                    const AppMemoryList& appdata,
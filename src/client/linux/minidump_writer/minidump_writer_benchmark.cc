@@ -0,0 +1,524 @@
+// Copyright (c) 2016 Google Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+// notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above
+// copyright notice, this list of conditions and the following disclaimer
+// in the documentation and/or other materials provided with the
+// distribution.
+//     * Neither the name of Google Inc. nor the names of its
+// contributors may be used to endorse or promote products derived from
+// this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+// minidump_writer_benchmark.cc: Measures how long the Linux client takes to
+// write a minidump.
+//
+// Each run forks a synthetic victim process with a configurable number of
+// threads, each with a given amount of stack in use, a number of extra
+// mappings, and application memory regions to be included in the minidump.
+// The victims are dumped in two ways:
+//  - from this process with WriteMinidump(), which reports how long reading
+//    the process, suspending its threads and writing each stream took, and
+//    how many pages the dumper's allocator used;
+//  - by an ExceptionHandler installed in the victim, which is then made to
+//    crash.  This gives the handler's latency, from the faulting instruction
+//    to the minidump callback.
+// Each figure is reported as the median, minimum and maximum over the
+// iterations.  Errors go to stderr, results to stdout.
+
+#include <dirent.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <ucontext.h>
+#include <unistd.h>
+
+#include <string>
+#include <vector>
+
+#include "client/linux/handler/exception_handler.h"
+#include "client/linux/handler/minidump_descriptor.h"
+#include "client/linux/minidump_writer/minidump_writer.h"
+#include "common/benchmark_helpers.h"
+#include "common/linux/eintr_wrapper.h"
+#include "common/using_std_string.h"
+#include "google_breakpad/common/minidump_format.h"
+
+namespace {
+
+using google_breakpad::AppMemory;
+using google_breakpad::AppMemoryList;
+using google_breakpad::ExceptionHandler;
+using google_breakpad::MappingList;
+using google_breakpad::Milliseconds;
+using google_breakpad::MinidumpDescriptor;
+using google_breakpad::MinidumpWriterStatistics;
+using google_breakpad::MonotonicNanoseconds;
+using google_breakpad::ParseCount;
+using google_breakpad::Samples;
+using google_breakpad::kSizeLimitTruncateExtraThreads;
+using std::vector;
+
+// Each level of a victim thread's recursion uses this much stack.
+const size_t kStackFrameSize = 1024;
+
+// Stack given to each victim thread beyond what it is asked to use.
+const size_t kStackSlack = 64 * 1024;
+
+struct BenchmarkOptions {
+  BenchmarkOptions()
+      : thread_count(8),
+        stack_kilobytes(32),
+        mapping_count(256),
+        app_memory_count(4),
+        app_memory_kilobytes(64),
+        iterations(20) {}
+
+  unsigned long thread_count;
+  unsigned long stack_kilobytes;
+  unsigned long mapping_count;
+  unsigned long app_memory_count;
+  unsigned long app_memory_kilobytes;
+  unsigned long iterations;
+};
+
+// State shared between this process and a victim, in a MAP_SHARED page.
+struct SharedState {
+  // The number of victim threads that have used their stack.
+  volatile unsigned long threads_ready;
+  // When the victim crashed, and when its minidump callback ran.
+  volatile uint64_t crash_ns;
+  volatile uint64_t callback_ns;
+};
+
+// The arguments of a victim thread.
+struct VictimThread {
+  SharedState* shared;
+  size_t depth;
+};
+
+// Reports that the calling thread is ready, and waits to be dumped.
+void Park(SharedState* shared) {
+  __sync_fetch_and_add(&shared->threads_ready, 1);
+  // threads_ready is never reset while this victim lives; testing it keeps
+  // the compiler from deciding that UseStack() recurses forever.
+  while (shared->threads_ready)
+    pause();
+}
+
+// Uses |depth| frames of kStackFrameSize bytes of stack, then parks.
+void UseStack(SharedState* shared, size_t depth) {
+  volatile char frame[kStackFrameSize];
+  memset(const_cast<char*>(frame), static_cast<int>(depth), sizeof(frame));
+  if (depth > 1)
+    UseStack(shared, depth - 1);
+  else
+    Park(shared);
+  // Keep the frame live across the call.
+  frame[0] = 0;
+}
+
+void* VictimThreadMain(void* argument) {
+  VictimThread* thread = static_cast<VictimThread*>(argument);
+  UseStack(thread->shared, thread->depth);
+  return NULL;
+}
+
+bool MinidumpWritten(const MinidumpDescriptor& descriptor, void* context,
+                     bool succeeded) {
+  SharedState* shared = static_cast<SharedState*>(context);
+  if (succeeded)
+    shared->callback_ns = MonotonicNanoseconds();
+  return true;
+}
+
+// Runs the victim: sets up the mappings, app memory and threads described
+// by |options|, optionally installs an ExceptionHandler writing to
+// |dump_directory|, then tells the benchmark it's ready by writing to
+// |ready_fd|.  It then crashes when 'c' is read from |control_fd|, and
+// exits when anything else is, or at end of file.
+void RunVictim(const BenchmarkOptions& options,
+               const AppMemoryList& app_memory, SharedState* shared,
+               int ready_fd, int control_fd, bool install_handler,
+               const string& dump_directory) {
+  // Alternate the protection of the extra mappings, so that the kernel
+  // doesn't merge neighbouring ones.
+  const size_t page_size = getpagesize();
+  for (unsigned long i = 0; i < options.mapping_count; ++i) {
+    const int protection = (i % 2) ? PROT_READ : PROT_READ | PROT_WRITE;
+    if (mmap(NULL, page_size, protection, MAP_PRIVATE | MAP_ANONYMOUS, -1,
+             0) == MAP_FAILED) {
+      perror("mmap");
+      _exit(1);
+    }
+  }
+
+  ExceptionHandler* handler = NULL;
+  if (install_handler) {
+    handler = new ExceptionHandler(MinidumpDescriptor(dump_directory), NULL,
+                                   MinidumpWritten, shared, true, -1);
+  }
+  for (AppMemoryList::const_iterator iter = app_memory.begin();
+       iter != app_memory.end(); ++iter) {
+    memset(iter->ptr, 0x5a, iter->length);
+    if (handler)
+      handler->RegisterAppMemory(iter->ptr, iter->length);
+  }
+
+  vector<VictimThread> threads(options.thread_count);
+  pthread_attr_t attributes;
+  pthread_attr_init(&attributes);
+  pthread_attr_setstacksize(&attributes,
+                            options.stack_kilobytes * 1024 + kStackSlack);
+  for (unsigned long i = 0; i < options.thread_count; ++i) {
+    threads[i].shared = shared;
+    threads[i].depth = options.stack_kilobytes * 1024 / kStackFrameSize;
+    if (threads[i].depth == 0)
+      threads[i].depth = 1;
+    pthread_t thread;
+    if (pthread_create(&thread, &attributes, VictimThreadMain,
+                       &threads[i]) != 0) {
+      fprintf(stderr, "Couldn't create victim thread %lu\n", i);
+      _exit(1);
+    }
+  }
+  while (shared->threads_ready < options.thread_count)
+    usleep(1000);
+
+  char command = 'r';
+  HANDLE_EINTR(write(ready_fd, &command, 1));
+  if (HANDLE_EINTR(read(control_fd, &command, 1)) == 1 && command == 'c') {
+    shared->crash_ns = MonotonicNanoseconds();
+    *reinterpret_cast<volatile int*>(NULL) = 0;
+  }
+  _exit(0);
+}
+
+// A victim process, and the pipes to and from it.
+struct Victim {
+  pid_t pid;
+  int control_fd;
+};
+
+// Forks a victim and waits until it's ready.  Returns false if it doesn't
+// get ready.
+bool StartVictim(const BenchmarkOptions& options,
+                 const AppMemoryList& app_memory, SharedState* shared,
+                 bool install_handler, const string& dump_directory,
+                 Victim* victim) {
+  int ready[2], control[2];
+  if (pipe(ready) != 0 || pipe(control) != 0) {
+    perror("pipe");
+    return false;
+  }
+  shared->threads_ready = 0;
+  shared->crash_ns = 0;
+  shared->callback_ns = 0;
+  fflush(NULL);
+
+  victim->pid = fork();
+  if (victim->pid < 0) {
+    perror("fork");
+    return false;
+  }
+  if (victim->pid == 0) {
+    close(ready[0]);
+    close(control[1]);
+    RunVictim(options, app_memory, shared, ready[1], control[0],
+              install_handler, dump_directory);
+  }
+  close(ready[1]);
+  close(control[0]);
+  victim->control_fd = control[1];
+
+  char command;
+  const bool started = HANDLE_EINTR(read(ready[0], &command, 1)) == 1;
+  close(ready[0]);
+  if (!started) {
+    fprintf(stderr, "The victim didn't start\n");
+    close(victim->control_fd);
+    waitpid(victim->pid, NULL, 0);
+  }
+  return started;
+}
+
+// Sends |command| to |victim| and waits for it to finish.
+void StopVictim(const Victim& victim, char command) {
+  HANDLE_EINTR(write(victim.control_fd, &command, 1));
+  close(victim.control_fd);
+  HANDLE_EINTR(waitpid(victim.pid, NULL, 0));
+}
+
+// Removes the minidumps written to |directory|.
+void RemoveMinidumps(const string& directory) {
+  DIR* dir = opendir(directory.c_str());
+  if (!dir)
+    return;
+  while (struct dirent* entry = readdir(dir)) {
+    const string name = entry->d_name;
+    if (name.size() > 4 && name.compare(name.size() - 4, 4, ".dmp") == 0)
+      unlink((directory + "/" + name).c_str());
+  }
+  closedir(dir);
+}
+
+// Prints the median, minimum and maximum of |samples|, which are in
+// milliseconds.
+void PrintTimes(const char* name, Samples* samples) {
+  if (samples->empty())
+    return;
+  printf("  %-24s %9.3f ms  (%.3f - %.3f)\n", name, samples->Median(),
+         samples->Min(), samples->Max());
+}
+
+// A readable name for the stream type |stream_type|.
+const char* StreamName(uint32_t stream_type) {
+  switch (stream_type) {
+    case MD_UNUSED_STREAM: return "(not written)";
+    case MD_THREAD_LIST_STREAM: return "thread list";
+    case MD_MODULE_LIST_STREAM: return "module list";
+    case MD_MEMORY_LIST_STREAM: return "memory list";
+    case MD_EXCEPTION_STREAM: return "exception";
+    case MD_SYSTEM_INFO_STREAM: return "system info";
+    case MD_LINUX_CPU_INFO: return "/proc/cpuinfo";
+    case MD_LINUX_PROC_STATUS: return "/proc/<pid>/status";
+    case MD_LINUX_LSB_RELEASE: return "/etc/lsb-release";
+    case MD_LINUX_CMD_LINE: return "/proc/<pid>/cmdline";
+    case MD_LINUX_ENVIRON: return "/proc/<pid>/environ";
+    case MD_LINUX_AUXV: return "/proc/<pid>/auxv";
+    case MD_LINUX_MAPS: return "/proc/<pid>/maps";
+    case MD_LINUX_DSO_DEBUG: return "DSO debug";
+    default: return "other";
+  }
+}
+
+// Dumps a victim |options.iterations| times with WriteMinidump() and
+// prints the statistics.
+bool BenchmarkWriteMinidump(const BenchmarkOptions& options,
+                            const AppMemoryList& app_memory,
+                            SharedState* shared,
+                            const string& dump_directory) {
+  Victim victim;
+  if (!StartVictim(options, app_memory, shared, false, dump_directory,
+                   &victim)) {
+    return false;
+  }
+
+  // The victim is blamed on its main thread, whose registers are taken
+  // from this context.
+  ExceptionHandler::CrashContext context;
+  memset(&context, 0, sizeof(context));
+  getcontext(&context.context);
+  context.tid = victim.pid;
+
+  const string path = dump_directory + "/benchmark.dmp";
+  Samples init, suspend, total, pages, size;
+  vector<Samples> streams(MinidumpWriterStatistics::kMaxStreams);
+  uint32_t stream_types[MinidumpWriterStatistics::kMaxStreams];
+  unsigned stream_count = 0;
+  bool succeeded = true;
+  for (unsigned long i = 0; i < options.iterations && succeeded; ++i) {
+    MinidumpWriterStatistics statistics;
+    unlink(path.c_str());
+    if (!google_breakpad::WriteMinidump(path.c_str(), -1,
+                                        kSizeLimitTruncateExtraThreads, false,
+                                        victim.pid, &context, sizeof(context),
+                                        MappingList(), app_memory, NULL,
+                                        &statistics)) {
+      fprintf(stderr, "WriteMinidump failed\n");
+      succeeded = false;
+      break;
+    }
+    init.Add(Milliseconds(statistics.init_ns));
+    suspend.Add(Milliseconds(statistics.suspend_ns));
+    total.Add(Milliseconds(statistics.total_ns));
+    pages.Add(statistics.allocator_pages);
+    size.Add(statistics.minidump_size);
+    stream_count = statistics.stream_count;
+    for (unsigned j = 0; j < stream_count; ++j) {
+      stream_types[j] = statistics.stream_types[j];
+      streams[j].Add(Milliseconds(statistics.stream_ns[j]));
+    }
+  }
+  unlink(path.c_str());
+  StopVictim(victim, 'x');
+  if (!succeeded)
+    return false;
+
+  printf("WriteMinidump, median (min - max) of %lu:\n", options.iterations);
+  PrintTimes("read process", &init);
+  PrintTimes("suspend threads", &suspend);
+  for (unsigned j = 0; j < stream_count; ++j)
+    PrintTimes(StreamName(stream_types[j]), &streams[j]);
+  PrintTimes("total", &total);
+  printf("  %-24s %9lu pages (%lu - %lu)\n", "allocator",
+         static_cast<unsigned long>(pages.Median()),
+         static_cast<unsigned long>(pages.Min()),
+         static_cast<unsigned long>(pages.Max()));
+  printf("  %-24s %9lu bytes\n", "minidump size",
+         static_cast<unsigned long>(size.Median()));
+  return true;
+}
+
+// Crashes |options.iterations| victims with an ExceptionHandler installed
+// and prints the time from each crash to its minidump callback.
+bool BenchmarkHandler(const BenchmarkOptions& options,
+                      const AppMemoryList& app_memory, SharedState* shared,
+                      const string& dump_directory) {
+  Samples latency;
+  for (unsigned long i = 0; i < options.iterations; ++i) {
+    Victim victim;
+    if (!StartVictim(options, app_memory, shared, true, dump_directory,
+                     &victim)) {
+      return false;
+    }
+    StopVictim(victim, 'c');
+    RemoveMinidumps(dump_directory);
+    if (!shared->crash_ns || !shared->callback_ns) {
+      fprintf(stderr, "The victim's handler didn't write a minidump\n");
+      return false;
+    }
+    latency.Add(Milliseconds(shared->callback_ns - shared->crash_ns));
+  }
+
+  printf("ExceptionHandler, median (min - max) of %lu:\n",
+         options.iterations);
+  PrintTimes("crash to callback", &latency);
+  return true;
+}
+
+void usage(const char* program_name) {
+  BenchmarkOptions defaults;
+  fprintf(stderr, "usage: %s [-t threads] [-s stack-kb] [-m mappings] "
+          "[-a regions]\n"
+          "          [-A region-kb] [-n iterations] [-d directory] "
+          "[-W | -H]\n"
+          "    -t : Threads in the victim (default %lu)\n"
+          "    -s : Kilobytes of stack each thread uses (default %lu)\n"
+          "    -m : Extra one-page mappings in the victim (default %lu)\n"
+          "    -a : Application memory regions to dump (default %lu)\n"
+          "    -A : Kilobytes in each application memory region "
+          "(default %lu)\n"
+          "    -n : Number of minidumps written each way (default %lu)\n"
+          "    -d : Directory for the minidumps (default /tmp)\n"
+          "    -W : Only measure WriteMinidump\n"
+          "    -H : Only measure the ExceptionHandler\n",
+          program_name, defaults.thread_count, defaults.stack_kilobytes,
+          defaults.mapping_count, defaults.app_memory_count,
+          defaults.app_memory_kilobytes, defaults.iterations);
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  BenchmarkOptions options;
+  string dump_directory = "/tmp";
+  bool measure_writer = true;
+  bool measure_handler = true;
+  int ch;
+  while ((ch = getopt(argc, argv, "ht:s:m:a:A:n:d:WH")) != -1) {
+    bool valid = true;
+    switch (ch) {
+      case 't':
+        valid = ParseCount('t', optarg, 1, 10000, &options.thread_count);
+        break;
+      case 's':
+        valid = ParseCount('s', optarg, 1, 1024 * 1024,
+                           &options.stack_kilobytes);
+        break;
+      case 'm':
+        valid = ParseCount('m', optarg, 0, 1000000, &options.mapping_count);
+        break;
+      case 'a':
+        valid = ParseCount('a', optarg, 0, 10000, &options.app_memory_count);
+        break;
+      case 'A':
+        valid = ParseCount('A', optarg, 1, 1024 * 1024,
+                           &options.app_memory_kilobytes);
+        break;
+      case 'n':
+        valid = ParseCount('n', optarg, 1, 1000000, &options.iterations);
+        break;
+      case 'd':
+        dump_directory = optarg;
+        break;
+      case 'W':
+        measure_handler = false;
+        break;
+      case 'H':
+        measure_writer = false;
+        break;
+      default:
+        valid = false;
+        break;
+    }
+    if (!valid) {
+      usage(argv[0]);
+      return 1;
+    }
+  }
+  if (optind != argc || (!measure_writer && !measure_handler)) {
+    usage(argv[0]);
+    return 1;
+  }
+
+  // The app memory is allocated here, before the victims are forked, so
+  // that it is at the same addresses in them.
+  AppMemoryList app_memory;
+  for (unsigned long i = 0; i < options.app_memory_count; ++i) {
+    AppMemory region;
+    region.length = options.app_memory_kilobytes * 1024;
+    region.ptr = malloc(region.length);
+    if (!region.ptr) {
+      fprintf(stderr, "Couldn't allocate the application memory\n");
+      return 1;
+    }
+    app_memory.push_back(region);
+  }
+
+  SharedState* shared = static_cast<SharedState*>(
+      mmap(NULL, sizeof(SharedState), PROT_READ | PROT_WRITE,
+           MAP_SHARED | MAP_ANONYMOUS, -1, 0));
+  if (shared == MAP_FAILED) {
+    perror("mmap");
+    return 1;
+  }
+
+  printf("victim: %lu threads using %lu kB of stack each, %lu extra "
+         "mappings, %lu app memory regions of %lu kB\n",
+         options.thread_count, options.stack_kilobytes,
+         options.mapping_count, options.app_memory_count,
+         options.app_memory_kilobytes);
+
+  if (measure_writer &&
+      !BenchmarkWriteMinidump(options, app_memory, shared, dump_directory)) {
+    return 1;
+  }
+  if (measure_handler &&
+      !BenchmarkHandler(options, app_memory, shared, dump_directory)) {
+    return 1;
+  }
+  return 0;
+}
@@ -32,13 +32,16 @@
 #include <sys/stat.h>
 #include <sys/syscall.h>
 #include <sys/types.h>
+#include <time.h>
 #include <ucontext.h>
 #include <unistd.h>
 
 #include <string>
 
 #include "breakpad_googletest_includes.h"
+#include "client/linux/dump_writer_common/raw_context_cpu.h"
 #include "client/linux/handler/exception_handler.h"
+#include "client/linux/minidump_writer/crash_annotations.h"
 #include "client/linux/minidump_writer/linux_dumper.h"
 #include "client/linux/minidump_writer/minidump_writer.h"
 #include "client/linux/minidump_writer/minidump_writer_unittest_utils.h"
@@ -46,6 +49,7 @@
 #include "common/linux/file_id.h"
 #include "common/linux/ignore_ret.h"
 #include "common/linux/safe_readlink.h"
+#include "common/minidump_compression.h"
 #include "common/scoped_ptr.h"
 #include "common/tests/auto_tempdir.h"
 #include "common/tests/file_utils.h"
@@ -458,6 +462,7 @@ TEST(MinidumpWriterTest, AdditionalMemory) {
   close(fds[0]);
 
   ExceptionHandler::CrashContext context;
+  memset(&context, 0, sizeof(context));
 
   // This needs a valid context for minidump writing to work, but getting
   // a useful one from the child is too much work, so just use one from
@@ -500,6 +505,368 @@ TEST(MinidumpWriterTest, AdditionalMemory) {
   close(fds[1]);
 }
 
+// Test that overlapping and adjoining memory regions are written as a
+// single block.
+TEST(MinidumpWriterTest, MergedAdditionalMemory) {
+  int fds[2];
+  ASSERT_NE(-1, pipe(fds));
+
+  const uint32_t kMemorySize = 3 * sysconf(_SC_PAGESIZE);
+  uint8_t* memory = new uint8_t[kMemorySize];
+  const uintptr_t kMemoryAddress = reinterpret_cast<uintptr_t>(memory);
+  for (uint32_t i = 0; i < kMemorySize; ++i) {
+    memory[i] = i % 255;
+  }
+
+  const pid_t child = fork();
+  if (child == 0) {
+    close(fds[1]);
+    char b;
+    HANDLE_EINTR(read(fds[0], &b, sizeof(b)));
+    close(fds[0]);
+    syscall(__NR_exit);
+  }
+  close(fds[0]);
+
+  ExceptionHandler::CrashContext context;
+  memset(&context, 0, sizeof(context));
+  ASSERT_EQ(0, getcontext(&context.context));
+  context.tid = child;
+
+  AutoTempDir temp_dir;
+  string templ = temp_dir.path() + kMDWriterUnitTestFileName;
+  unlink(templ.c_str());
+
+  MappingList mappings;
+  AppMemoryList memory_list;
+
+  // The last third of the memory, the first half overlapping the middle
+  // third, and the middle third, out of order.
+  const uint32_t kThird = kMemorySize / 3;
+  AppMemory app_memory;
+  app_memory.ptr = memory + 2 * kThird;
+  app_memory.length = kThird;
+  memory_list.push_back(app_memory);
+  app_memory.ptr = memory;
+  app_memory.length = kMemorySize / 2;
+  memory_list.push_back(app_memory);
+  app_memory.ptr = memory + kThird;
+  app_memory.length = kThird;
+  memory_list.push_back(app_memory);
+  ASSERT_TRUE(WriteMinidump(templ.c_str(), child, &context, sizeof(context),
+                            mappings, memory_list));
+
+  Minidump minidump(templ);
+  ASSERT_TRUE(minidump.Read());
+
+  MinidumpMemoryList* dump_memory_list = minidump.GetMemoryList();
+  ASSERT_TRUE(dump_memory_list);
+  const MinidumpMemoryRegion* region =
+    dump_memory_list->GetMemoryRegionForAddress(kMemoryAddress + kThird);
+  ASSERT_TRUE(region);
+
+  EXPECT_EQ(kMemoryAddress, region->GetBase());
+  EXPECT_EQ(kMemorySize, region->GetSize());
+  EXPECT_EQ(0, memcmp(region->GetMemory(), memory, kMemorySize));
+
+  delete[] memory;
+  close(fds[1]);
+}
+
+// Test that a compressed minidump reads back the same as an uncompressed one.
+TEST(MinidumpWriterTest, CompressedMinidump) {
+  int fds[2];
+  ASSERT_NE(-1, pipe(fds));
+
+  // Mostly zeros, as much of the memory in a real minidump is, with a
+  // pattern at the end.
+  const uint32_t kMemorySize = 16 * sysconf(_SC_PAGESIZE);
+  uint8_t* memory = new uint8_t[kMemorySize];
+  const uintptr_t kMemoryAddress = reinterpret_cast<uintptr_t>(memory);
+  memset(memory, 0, kMemorySize);
+  for (uint32_t i = kMemorySize - 1000; i < kMemorySize; ++i) {
+    memory[i] = i % 255;
+  }
+
+  const pid_t child = fork();
+  if (child == 0) {
+    close(fds[1]);
+    char b;
+    HANDLE_EINTR(read(fds[0], &b, sizeof(b)));
+    close(fds[0]);
+    syscall(__NR_exit);
+  }
+  close(fds[0]);
+
+  ExceptionHandler::CrashContext context;
+  memset(&context, 0, sizeof(context));
+  ASSERT_EQ(0, getcontext(&context.context));
+  context.tid = child;
+
+  AutoTempDir temp_dir;
+  const string plain_path = temp_dir.path() + "/plain.dmp";
+  const string compressed_path = temp_dir.path() + "/compressed.dmp";
+
+  MappingList mappings;
+  AppMemoryList memory_list;
+  AppMemory app_memory;
+  app_memory.ptr = memory;
+  app_memory.length = kMemorySize;
+  memory_list.push_back(app_memory);
+  ASSERT_TRUE(WriteMinidump(plain_path.c_str(), -1, false, child,
+                            &context, sizeof(context),
+                            mappings, memory_list));
+  ASSERT_TRUE(WriteMinidump(compressed_path.c_str(), -1, true, child,
+                            &context, sizeof(context),
+                            mappings, memory_list));
+  close(fds[1]);
+
+  struct stat plain_stat, compressed_stat;
+  ASSERT_EQ(0, stat(plain_path.c_str(), &plain_stat));
+  ASSERT_EQ(0, stat(compressed_path.c_str(), &compressed_stat));
+  EXPECT_LT(compressed_stat.st_size, plain_stat.st_size);
+
+  int fd = open(compressed_path.c_str(), O_RDONLY);
+  ASSERT_NE(-1, fd);
+  uint32_t signature = 0;
+  ASSERT_EQ(static_cast<ssize_t>(sizeof(signature)),
+            read(fd, &signature, sizeof(signature)));
+  close(fd);
+  EXPECT_EQ(kCompressedMinidumpSignature, signature);
+
+  Minidump plain(plain_path);
+  ASSERT_TRUE(plain.Read());
+  Minidump compressed(compressed_path);
+  ASSERT_TRUE(compressed.Read());
+
+  ASSERT_TRUE(plain.GetThreadList());
+  ASSERT_TRUE(compressed.GetThreadList());
+  EXPECT_EQ(plain.GetThreadList()->thread_count(),
+            compressed.GetThreadList()->thread_count());
+  ASSERT_TRUE(plain.GetModuleList());
+  ASSERT_TRUE(compressed.GetModuleList());
+  EXPECT_EQ(plain.GetModuleList()->module_count(),
+            compressed.GetModuleList()->module_count());
+
+  MinidumpMemoryList* dump_memory_list = compressed.GetMemoryList();
+  ASSERT_TRUE(dump_memory_list);
+  const MinidumpMemoryRegion* region =
+    dump_memory_list->GetMemoryRegionForAddress(kMemoryAddress);
+  ASSERT_TRUE(region);
+  EXPECT_EQ(kMemoryAddress, region->GetBase());
+  EXPECT_EQ(kMemorySize, region->GetSize());
+  EXPECT_EQ(0, memcmp(region->GetMemory(), memory, kMemorySize));
+
+  delete[] memory;
+}
+
+// Reads all of the file at |path| into |contents|.
+static bool ReadWholeFile(const string& path, string* contents) {
+  int fd = open(path.c_str(), O_RDONLY);
+  if (fd == -1)
+    return false;
+  contents->clear();
+  char buffer[4096];
+  ssize_t r;
+  while ((r = HANDLE_EINTR(read(fd, buffer, sizeof(buffer)))) > 0)
+    contents->append(buffer, r);
+  close(fd);
+  return r == 0;
+}
+
+// Reads the stream of type |stream_type| from |minidump| into |contents|.
+static bool ReadStream(Minidump* minidump, uint32_t stream_type,
+                       string* contents) {
+  uint32_t length;
+  if (!minidump->SeekToStreamType(stream_type, &length))
+    return false;
+  contents->resize(length);
+  return length == 0 || minidump->ReadBytes(&(*contents)[0], length);
+}
+
+// Test that the streams copied from /proc files hold the whole file, both
+// when they are copied inside the kernel and when they are read and written
+// (which a compressed minidump needs).
+TEST(MinidumpWriterTest, ProcFileStreams) {
+  int fds[2];
+  ASSERT_NE(-1, pipe(fds));
+
+  const pid_t child = fork();
+  if (child == 0) {
+    close(fds[1]);
+    char b;
+    HANDLE_EINTR(read(fds[0], &b, sizeof(b)));
+    close(fds[0]);
+    syscall(__NR_exit);
+  }
+  close(fds[0]);
+
+  ExceptionHandler::CrashContext context;
+  memset(&context, 0, sizeof(context));
+  ASSERT_EQ(0, getcontext(&context.context));
+  context.tid = child;
+
+  AutoTempDir temp_dir;
+  const string plain_path = temp_dir.path() + "/plain.dmp";
+  const string compressed_path = temp_dir.path() + "/compressed.dmp";
+  ASSERT_TRUE(WriteMinidump(plain_path.c_str(), -1, false, child,
+                            &context, sizeof(context),
+                            MappingList(), AppMemoryList()));
+  ASSERT_TRUE(WriteMinidump(compressed_path.c_str(), -1, true, child,
+                            &context, sizeof(context),
+                            MappingList(), AppMemoryList()));
+
+  char proc_path[64];
+  string maps, cmdline;
+  snprintf(proc_path, sizeof(proc_path), "/proc/%d/maps", child);
+  ASSERT_TRUE(ReadWholeFile(proc_path, &maps));
+  snprintf(proc_path, sizeof(proc_path), "/proc/%d/cmdline", child);
+  ASSERT_TRUE(ReadWholeFile(proc_path, &cmdline));
+  close(fds[1]);
+  ASSERT_FALSE(maps.empty());
+
+  const string* paths[] = { &plain_path, &compressed_path };
+  for (size_t i = 0; i < sizeof(paths) / sizeof(paths[0]); ++i) {
+    Minidump minidump(*paths[i]);
+    ASSERT_TRUE(minidump.Read());
+    string stream;
+    ASSERT_TRUE(ReadStream(&minidump, MD_LINUX_MAPS, &stream));
+    EXPECT_EQ(maps, stream);
+    ASSERT_TRUE(ReadStream(&minidump, MD_LINUX_CMD_LINE, &stream));
+    EXPECT_EQ(cmdline, stream);
+  }
+}
+
+// Test that the annotations a process records are written to the
+// MD_LINUX_ANNOTATIONS stream, read from the process at dump time.
+TEST(MinidumpWriterTest, Annotations) {
+  CrashAnnotations* annotations = new CrashAnnotations;
+  int fds[2], ready_fds[2];
+  ASSERT_NE(-1, pipe(fds));
+  ASSERT_NE(-1, pipe(ready_fds));
+
+  const pid_t child = fork();
+  if (child == 0) {
+    close(fds[1]);
+    close(ready_fds[0]);
+    CrashAnnotations::ThreadRing* ring = annotations->RegisterThread();
+    ring->Record("request", "first");
+    ring->Record("request", "second");
+    char b = 0;
+    HANDLE_EINTR(write(ready_fds[1], &b, sizeof(b)));
+    HANDLE_EINTR(read(fds[0], &b, sizeof(b)));
+    syscall(__NR_exit);
+  }
+  close(fds[0]);
+  close(ready_fds[1]);
+  char b;
+  ASSERT_EQ(1, HANDLE_EINTR(read(ready_fds[0], &b, sizeof(b))));
+  close(ready_fds[0]);
+
+  ExceptionHandler::CrashContext context;
+  memset(&context, 0, sizeof(context));
+  ASSERT_EQ(0, getcontext(&context.context));
+  context.tid = child;
+
+  AutoTempDir temp_dir;
+  const string path = temp_dir.path() + kMDWriterUnitTestFileName;
+  ASSERT_TRUE(WriteMinidump(path.c_str(), -1, kSizeLimitTruncateExtraThreads,
+                            false, child, &context, sizeof(context),
+                            MappingList(), AppMemoryList(), NULL,
+                            annotations, NULL));
+  close(fds[1]);
+  // The annotations were recorded in the child only.
+  delete annotations;
+
+  Minidump minidump(path);
+  ASSERT_TRUE(minidump.Read());
+  string stream;
+  ASSERT_TRUE(ReadStream(&minidump, MD_LINUX_ANNOTATIONS, &stream));
+  ASSERT_EQ(MDRawAnnotationList_minsize + 2 * sizeof(MDRawAnnotation),
+            stream.size());
+  uint32_t count;
+  memcpy(&count, stream.data(), sizeof(count));
+  EXPECT_EQ(2U, count);
+  MDRawAnnotation records[2];
+  memcpy(records, stream.data() + MDRawAnnotationList_minsize,
+         sizeof(records));
+  for (uint32_t i = 0; i < 2; ++i) {
+    EXPECT_EQ(static_cast<uint32_t>(child), records[i].thread_id);
+    EXPECT_EQ(i, records[i].sequence);
+    EXPECT_STREQ("request", records[i].key);
+  }
+  EXPECT_STREQ("first", records[0].value);
+  EXPECT_STREQ("second", records[1].value);
+}
+
+// Test that the phases of writing the dump are timed from the handler's
+// start in the MD_LINUX_HANDLER_TIMING stream.
+TEST(MinidumpWriterTest, HandlerTiming) {
+  int fds[2];
+  ASSERT_NE(-1, pipe(fds));
+
+  const pid_t child = fork();
+  if (child == 0) {
+    close(fds[1]);
+    char b;
+    HANDLE_EINTR(read(fds[0], &b, sizeof(b)));
+    close(fds[0]);
+    syscall(__NR_exit);
+  }
+  close(fds[0]);
+
+  ExceptionHandler::CrashContext context;
+  memset(&context, 0, sizeof(context));
+  ASSERT_EQ(0, getcontext(&context.context));
+  context.tid = child;
+  struct timespec now;
+  ASSERT_EQ(0, clock_gettime(CLOCK_MONOTONIC, &now));
+  context.handler_start_ns =
+      static_cast<uint64_t>(now.tv_sec) * 1000000000 + now.tv_nsec;
+
+  AutoTempDir temp_dir;
+  const string path = temp_dir.path() + kMDWriterUnitTestFileName;
+  ASSERT_TRUE(WriteMinidump(path.c_str(), child, &context, sizeof(context)));
+  close(fds[1]);
+
+  Minidump minidump(path);
+  ASSERT_TRUE(minidump.Read());
+  MinidumpHandlerTiming* handler_timing = minidump.GetHandlerTiming();
+  ASSERT_TRUE(handler_timing);
+  EXPECT_EQ(context.handler_start_ns, handler_timing->start_time());
+
+  // The phases in the order they start: writing the streams starts
+  // before the memory is copied, which is done while writing the thread
+  // list, and the module identifiers are computed afterwards, while
+  // writing the module list.
+  const uint32_t kPhases[] = {
+    MD_HANDLER_PHASE_HANDLER, MD_HANDLER_PHASE_ENUMERATE,
+    MD_HANDLER_PHASE_SUSPEND, MD_HANDLER_PHASE_WRITE,
+    MD_HANDLER_PHASE_MEMORY, MD_HANDLER_PHASE_IDENTIFIERS
+  };
+  const unsigned kPhaseCount = sizeof(kPhases) / sizeof(kPhases[0]);
+  ASSERT_EQ(kPhaseCount, handler_timing->timing_count());
+  uint64_t phase_start = 0;
+  for (unsigned i = 0; i < kPhaseCount; ++i) {
+    const MDRawHandlerTiming* timing =
+        handler_timing->GetTimingForPhase(kPhases[i]);
+    ASSERT_TRUE(timing);
+    EXPECT_LE(1U, timing->count);
+    EXPECT_LE(phase_start, timing->start_time);
+    phase_start = timing->start_time;
+  }
+  EXPECT_EQ(0U, handler_timing->GetTimingAtIndex(0)->start_time);
+
+  const MDRawHandlerTiming* memory =
+      handler_timing->GetTimingForPhase(MD_HANDLER_PHASE_MEMORY);
+  const MDRawHandlerTiming* write =
+      handler_timing->GetTimingForPhase(MD_HANDLER_PHASE_WRITE);
+  EXPECT_EQ(1U, memory->count);
+  EXPECT_LE(write->start_time, memory->start_time);
+  EXPECT_LE(memory->start_time + memory->duration,
+            write->start_time + write->duration);
+}
+
 // Test that an invalid thread stack pointer still results in a minidump.
 TEST(MinidumpWriterTest, InvalidStackPointer) {
   int fds[2];
@@ -516,6 +883,7 @@ TEST(MinidumpWriterTest, InvalidStackPointer) {
   close(fds[0]);
 
   ExceptionHandler::CrashContext context;
+  memset(&context, 0, sizeof(context));
 
   // This needs a valid context for minidump writing to work, but getting
   // a useful one from the child is too much work, so just use one from
@@ -749,6 +1117,114 @@ TEST(MinidumpWriterTest, MinidumpSizeLimit) {
               total_normal_stack_size - min_expected_reduction);
   }
 
+  // Fourth, write a minidump with a size limit applied as a budget that
+  // holds about half of the stack memory.
+  {
+    // The definitions of kLimitMinidumpFudgeFactor and
+    // kLimitMaxExtraThreadStackLen here were copied from class
+    // MinidumpWriter in minidump_writer.cc.
+    static const unsigned kLimitMinidumpFudgeFactor = 64 * 1024;
+    static const unsigned kLimitMaxExtraThreadStackLen = 2 * 1024;
+    const unsigned stack_budget = total_normal_stack_size / 2;
+    const off_t minidump_size_limit = stack_budget +
+        kLimitMinidumpFudgeFactor +
+        kNumberOfThreadsInHelperProgram * sizeof(RawContextCPU);
+
+    string budget_dump = temp_dir.path() +
+        "/minidump-writer-unittest-budget.dmp";
+    ASSERT_TRUE(WriteMinidump(budget_dump.c_str(), minidump_size_limit,
+                              kSizeLimitBudgeted, false,
+                              child_pid, NULL, 0,
+                              MappingList(), AppMemoryList()));
+    struct stat st;
+    ASSERT_EQ(0, stat(budget_dump.c_str(), &st));
+    EXPECT_LT(st.st_size, normal_file_size);
+
+    Minidump minidump(budget_dump);
+    ASSERT_TRUE(minidump.Read());
+    MinidumpThreadList* dump_thread_list = minidump.GetThreadList();
+    ASSERT_TRUE(dump_thread_list);
+    unsigned total_budget_stack_size = 0;
+    unsigned int threads_with_top_frames = 0;
+    for (unsigned int i = 0; i < dump_thread_list->thread_count(); i++) {
+      MinidumpThread* thread = dump_thread_list->GetThreadAtIndex(i);
+      ASSERT_TRUE(thread->thread() != NULL);
+      MinidumpMemoryRegion* memory = thread->GetMemory();
+      if (!memory)
+        continue;
+      total_budget_stack_size += memory->GetSize();
+      if (memory->GetSize() >= kLimitMaxExtraThreadStackLen)
+        ++threads_with_top_frames;
+    }
+
+    // The budget is filled, less the few kilobytes of the dump written
+    // before the thread list, and never overrun.
+    EXPECT_LE(total_budget_stack_size, stack_budget);
+    EXPECT_GT(total_budget_stack_size, stack_budget - 8 * 1024);
+
+    // Every thread keeps its top frames when the budget allows it.
+    if (stack_budget >=
+        kNumberOfThreadsInHelperProgram * kLimitMaxExtraThreadStackLen +
+        8 * 1024) {
+      EXPECT_EQ(dump_thread_list->thread_count(), threads_with_top_frames);
+    }
+  }
+
+  // Fifth, write the same budgeted minidump with one page of the helper
+  // program listed several times as application memory. The page is only
+  // written once, so it must only be charged to the budget once.
+  {
+    static const unsigned kLimitMinidumpFudgeFactor = 64 * 1024;
+    const unsigned kPageCopies = 4;
+    const unsigned page_size = sysconf(_SC_PAGESIZE);
+    const unsigned stack_budget = total_normal_stack_size / 2;
+    const off_t minidump_size_limit = stack_budget + page_size +
+        kLimitMinidumpFudgeFactor +
+        kNumberOfThreadsInHelperProgram * sizeof(RawContextCPU);
+
+    char maps_path[64];
+    snprintf(maps_path, sizeof(maps_path), "/proc/%d/maps", child_pid);
+    FILE* maps = fopen(maps_path, "r");
+    ASSERT_TRUE(maps != NULL);
+    unsigned long first_mapping = 0;
+    ASSERT_EQ(1, fscanf(maps, "%lx-", &first_mapping));
+    fclose(maps);
+
+    AppMemoryList memory_list;
+    AppMemory app_memory;
+    app_memory.ptr = reinterpret_cast<void*>(first_mapping);
+    app_memory.length = page_size;
+    for (unsigned i = 0; i < kPageCopies; ++i)
+      memory_list.push_back(app_memory);
+
+    string budget_dump = temp_dir.path() +
+        "/minidump-writer-unittest-budget-app-memory.dmp";
+    ASSERT_TRUE(WriteMinidump(budget_dump.c_str(), minidump_size_limit,
+                              kSizeLimitBudgeted, false,
+                              child_pid, NULL, 0,
+                              MappingList(), memory_list));
+
+    Minidump minidump(budget_dump);
+    ASSERT_TRUE(minidump.Read());
+    MinidumpThreadList* dump_thread_list = minidump.GetThreadList();
+    ASSERT_TRUE(dump_thread_list);
+    unsigned total_budget_stack_size = 0;
+    for (unsigned int i = 0; i < dump_thread_list->thread_count(); i++) {
+      MinidumpThread* thread = dump_thread_list->GetThreadAtIndex(i);
+      ASSERT_TRUE(thread->thread() != NULL);
+      MinidumpMemoryRegion* memory = thread->GetMemory();
+      if (memory)
+        total_budget_stack_size += memory->GetSize();
+    }
+
+    // The stacks get as much as without the application memory.
+    EXPECT_LE(total_budget_stack_size, stack_budget);
+    EXPECT_GT(total_budget_stack_size, stack_budget - 8 * 1024);
+    MinidumpMemoryList* dump_memory_list = minidump.GetMemoryList();
+    ASSERT_TRUE(dump_memory_list);
+    EXPECT_TRUE(dump_memory_list->GetMemoryRegionForAddress(first_mapping));
+  }
+
   // Kill the helper program.
   kill(child_pid, SIGKILL);
 }
@@ -0,0 +1,298 @@
+// Copyright (c) 2016 Google Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+// notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above
+// copyright notice, this list of conditions and the following disclaimer
+// in the documentation and/or other materials provided with the
+// distribution.
+//     * Neither the name of Google Inc. nor the names of its
+// contributors may be used to endorse or promote products derived from
+// this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+// module_identifier_cache.cc: Implementation of ModuleIdentifierCache.
+//
+// See module_identifier_cache.h for documentation.
+
+#include "client/linux/minidump_writer/module_identifier_cache.h"
+
+#include <elf.h>
+#include <errno.h>
+#include <limits.h>
+#include <link.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "client/linux/dump_writer_common/mapping_info.h"
+#include "common/linux/file_id.h"
+#include "common/linux/linux_libc_support.h"
+#include "common/linux/memory_mapped_file.h"
+
+namespace google_breakpad {
+
+namespace {
+
+struct UpdateState {
+  ModuleIdentifierCache* cache;
+  size_t added;
+  bool first;
+};
+
+#if defined(__GLIBC__)
+// Reads the dynamic linker's load and unload counters from the first module
+// reported by dl_iterate_phdr.
+int ReadLoadCounters(struct dl_phdr_info* info, size_t size, void* data) {
+  unsigned long long* counters = static_cast<unsigned long long*>(data);
+  if (size < offsetof(struct dl_phdr_info, dlpi_subs) +
+             sizeof(info->dlpi_subs)) {
+    return 1;
+  }
+  counters[0] = info->dlpi_adds;
+  counters[1] = info->dlpi_subs;
+  return 1;
+}
+#endif
+
+}  // namespace
+
+ModuleIdentifierCache::ModuleIdentifierCache()
+    : first_block_(NULL),
+      last_block_(NULL),
+      adds_(0),
+      subs_(0),
+      thread_running_(false),
+      stopping_(false),
+      interval_ms_(0) {
+  pthread_mutex_init(&mutex_, NULL);
+  pthread_cond_init(&stop_cond_, NULL);
+}
+
+ModuleIdentifierCache::~ModuleIdentifierCache() {
+  StopBackgroundUpdates();
+  Block* block = first_block_;
+  while (block) {
+    for (size_t i = 0; i < block->count; ++i)
+      delete [] block->entries[i].path;
+    Block* next = block->next;
+    delete block;
+    block = next;
+  }
+  pthread_cond_destroy(&stop_cond_);
+  pthread_mutex_destroy(&mutex_);
+}
+
+size_t ModuleIdentifierCache::Update() {
+  pthread_mutex_lock(&mutex_);
+#if defined(__GLIBC__)
+  unsigned long long counters[2] = { 0, 0 };
+  dl_iterate_phdr(ReadLoadCounters, counters);
+  if (counters[0] != 0 && counters[0] == adds_ && counters[1] == subs_) {
+    pthread_mutex_unlock(&mutex_);
+    return 0;
+  }
+  adds_ = counters[0];
+  subs_ = counters[1];
+#endif
+  UpdateState state = { this, 0, true };
+  dl_iterate_phdr(UpdateCallback, &state);
+  pthread_mutex_unlock(&mutex_);
+  return state.added;
+}
+
+// static
+int ModuleIdentifierCache::UpdateCallback(struct dl_phdr_info* info,
+                                          size_t size, void* data) {
+  UpdateState* state = static_cast<UpdateState*>(data);
+  bool first = state->first;
+  state->first = false;
+
+  const char* name = info->dlpi_name ? info->dlpi_name : "";
+  // The main executable, which is always reported first, has no name. Any
+  // other unnamed module, such as the VDSO on some systems, has no file.
+  if (!name[0] && !first)
+    return 0;
+
+  std::pair<uintptr_t, string> key(info->dlpi_addr, name);
+  if (!state->cache->seen_.insert(key).second)
+    return 0;
+
+  if (state->cache->AddModuleLocked(info))
+    ++state->added;
+  return 0;
+}
+
+bool ModuleIdentifierCache::AddModuleLocked(struct dl_phdr_info* info) {
+  // The module's first mapping is that of its lowest loadable segment.
+  const ElfW(Phdr)* first_load = NULL;
+  for (ElfW(Half) i = 0; i < info->dlpi_phnum; ++i) {
+    const ElfW(Phdr)* phdr = &info->dlpi_phdr[i];
+    if (phdr->p_type == PT_LOAD &&
+        (!first_load || phdr->p_vaddr < first_load->p_vaddr)) {
+      first_load = phdr;
+    }
+  }
+  if (!first_load)
+    return false;
+
+  // /proc/self/maps names mappings by their canonical path, which may differ
+  // from the one the module was loaded from.
+  const char* name = info->dlpi_name;
+  if (!name || !name[0])
+    name = "/proc/self/exe";
+  char path[PATH_MAX];
+  if (!realpath(name, path))
+    return false;
+
+  const uintptr_t page_mask = ~static_cast<uintptr_t>(getpagesize() - 1);
+  Entry entry;
+  entry.start_addr = (info->dlpi_addr + first_load->p_vaddr) & page_mask;
+  entry.offset = first_load->p_offset & page_mask;
+
+  MemoryMappedFile mapped_file(path, entry.offset);
+  if (!mapped_file.data() || mapped_file.size() < SELFMAG)
+    return false;
+  if (!FileID::ElfFileIdentifierFromMappedFile(mapped_file.data(),
+                                               entry.identifier)) {
+    return false;
+  }
+
+  const size_t path_len = strlen(path);
+  char* path_copy = new char[path_len + 1];
+  memcpy(path_copy, path, path_len + 1);
+  entry.path = path_copy;
+  AppendLocked(entry);
+  return true;
+}
+
+void ModuleIdentifierCache::AppendLocked(const Entry& entry) {
+  if (!last_block_ || last_block_->count == kEntriesPerBlock) {
+    Block* block = new Block;
+    block->count = 0;
+    block->next = NULL;
+    __sync_synchronize();
+    if (last_block_)
+      last_block_->next = block;
+    else
+      first_block_ = block;
+    last_block_ = block;
+  }
+
+  // Readers only look at entries below |count|, so the entry has to be
+  // complete before |count| covers it.
+  const size_t count = last_block_->count;
+  last_block_->entries[count] = entry;
+  __sync_synchronize();
+  last_block_->count = count + 1;
+}
+
+bool ModuleIdentifierCache::Lookup(const MappingInfo& mapping,
+                                   uint8_t identifier[sizeof(MDGUID)]) const {
+  // If a module was replaced by another one with the same path and address,
+  // the later entry wins.
+  const Entry* found = NULL;
+  for (const Block* block = first_block_; block; block = block->next) {
+    const size_t count = block->count;
+    __sync_synchronize();
+    for (size_t i = 0; i < count; ++i) {
+      const Entry& entry = block->entries[i];
+      if (entry.start_addr == mapping.start_addr &&
+          entry.offset == mapping.offset &&
+          my_strcmp(entry.path, mapping.name) == 0) {
+        found = &entry;
+      }
+    }
+  }
+  if (!found)
+    return false;
+  my_memcpy(identifier, found->identifier, sizeof(MDGUID));
+  return true;
+}
+
+size_t ModuleIdentifierCache::module_count() const {
+  size_t count = 0;
+  for (const Block* block = first_block_; block; block = block->next)
+    count += block->count;
+  return count;
+}
+
+bool ModuleIdentifierCache::StartBackgroundUpdates(int interval_ms) {
+  pthread_mutex_lock(&mutex_);
+  if (thread_running_ || interval_ms <= 0) {
+    pthread_mutex_unlock(&mutex_);
+    return false;
+  }
+  interval_ms_ = interval_ms;
+  stopping_ = false;
+  thread_running_ =
+      pthread_create(&thread_, NULL, BackgroundThread, this) == 0;
+  const bool started = thread_running_;
+  pthread_mutex_unlock(&mutex_);
+  return started;
+}
+
+void ModuleIdentifierCache::StopBackgroundUpdates() {
+  pthread_mutex_lock(&mutex_);
+  if (!thread_running_) {
+    pthread_mutex_unlock(&mutex_);
+    return;
+  }
+  stopping_ = true;
+  pthread_cond_signal(&stop_cond_);
+  pthread_mutex_unlock(&mutex_);
+
+  pthread_join(thread_, NULL);
+
+  pthread_mutex_lock(&mutex_);
+  thread_running_ = false;
+  stopping_ = false;
+  pthread_mutex_unlock(&mutex_);
+}
+
+// static
+void* ModuleIdentifierCache::BackgroundThread(void* data) {
+  ModuleIdentifierCache* cache = static_cast<ModuleIdentifierCache*>(data);
+  for (;;) {
+    cache->Update();
+
+    pthread_mutex_lock(&cache->mutex_);
+    struct timespec deadline;
+    clock_gettime(CLOCK_REALTIME, &deadline);
+    deadline.tv_sec += cache->interval_ms_ / 1000;
+    deadline.tv_nsec += (cache->interval_ms_ % 1000) * 1000000L;
+    if (deadline.tv_nsec >= 1000000000L) {
+      deadline.tv_sec++;
+      deadline.tv_nsec -= 1000000000L;
+    }
+    while (!cache->stopping_ &&
+           pthread_cond_timedwait(&cache->stop_cond_, &cache->mutex_,
+                                  &deadline) != ETIMEDOUT) {
+    }
+    const bool stopping = cache->stopping_;
+    pthread_mutex_unlock(&cache->mutex_);
+    if (stopping)
+      break;
+  }
+  return NULL;
+}
+
+}  // namespace google_breakpad
@@ -0,0 +1,155 @@
+// Copyright (c) 2016 Google Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+// notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above
+// copyright notice, this list of conditions and the following disclaimer
+// in the documentation and/or other materials provided with the
+// distribution.
+//     * Neither the name of Google Inc. nor the names of its
+// contributors may be used to endorse or promote products derived from
+// this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+// module_identifier_cache.h: ModuleIdentifierCache, a store of the ELF file
+// identifiers of the modules loaded into the current process.
+//
+// When writing a minidump, LinuxDumper normally opens and maps the file
+// behind every mapped module to find its build ID, or to hash its text
+// section when it has none.  In a process with many shared libraries that
+// is a large part of the time spent handling a crash, and it is done in the
+// worst possible context.  A ModuleIdentifierCache computes the same
+// identifiers ahead of time, from the list of loaded modules reported by
+// dl_iterate_phdr, so the dumper only has to look them up.
+//
+// The cache has to be refreshed after modules are loaded, either by calling
+// Update() (e.g. after dlopen) or by letting a background thread poll for
+// new modules (StartBackgroundUpdates).  Modules the cache does not know
+// about are still identified from their files at dump time.
+//
+// Entries are only ever appended, and are published in a way that lets
+// Lookup run without locks, so it is safe to call from a compromised
+// context while another thread is updating the cache.
+
+#ifndef CLIENT_LINUX_MINIDUMP_WRITER_MODULE_IDENTIFIER_CACHE_H_
+#define CLIENT_LINUX_MINIDUMP_WRITER_MODULE_IDENTIFIER_CACHE_H_
+
+#include <pthread.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include <set>
+#include <string>
+#include <utility>
+
+#include "common/using_std_string.h"
+#include "google_breakpad/common/minidump_format.h"
+
+struct dl_phdr_info;
+
+namespace google_breakpad {
+
+struct MappingInfo;
+
+class ModuleIdentifierCache {
+ public:
+  ModuleIdentifierCache();
+  ~ModuleIdentifierCache();
+
+  // Computes the identifiers of the modules loaded since the last update.
+  // Returns the number of modules added to the cache.  Not async-signal
+  // safe.
+  size_t Update();
+
+  // Starts a thread that calls Update() every |interval_ms| milliseconds,
+  // after an initial update.  Returns false if the thread could not be
+  // started or is already running.
+  bool StartBackgroundUpdates(int interval_ms);
+
+  // Stops the background thread, if any.  Called by the destructor.
+  void StopBackgroundUpdates();
+
+  // Copies the cached identifier of the module whose first mapping is
+  // |mapping| into |identifier| and returns true, or returns false if the
+  // module is not in the cache.  Async-signal safe.
+  bool Lookup(const MappingInfo& mapping,
+              uint8_t identifier[sizeof(MDGUID)]) const;
+
+  // The number of modules in the cache.
+  size_t module_count() const;
+
+ private:
+  struct Entry {
+    // Start address and file offset of the module's first mapping, and the
+    // canonical path of its file, which is what /proc/self/maps shows.
+    uintptr_t start_addr;
+    uintptr_t offset;
+    const char* path;
+    uint8_t identifier[sizeof(MDGUID)];
+  };
+
+  static const size_t kEntriesPerBlock = 64;
+
+  struct Block {
+    Entry entries[kEntriesPerBlock];
+    // Number of valid entries, stored only after they are fully written.
+    volatile size_t count;
+    Block* volatile next;
+  };
+
+  // Modules already seen by Update(), keyed by load bias and the name
+  // reported by the dynamic linker, whether or not they could be cached.
+  typedef std::set<std::pair<uintptr_t, string> > SeenSet;
+
+  static int UpdateCallback(struct dl_phdr_info* info, size_t size,
+                            void* data);
+  static void* BackgroundThread(void* data);
+
+  // Computes and appends the entry for one module.  The caller must hold
+  // mutex_.
+  bool AddModuleLocked(struct dl_phdr_info* info);
+
+  // Publishes a new entry.  The caller must hold mutex_.
+  void AppendLocked(const Entry& entry);
+
+  Block* volatile first_block_;
+  Block* last_block_;
+  SeenSet seen_;
+
+  // Load counters reported by the dynamic linker at the last update, used
+  // to skip updates when no module was loaded or unloaded since.
+  unsigned long long adds_;
+  unsigned long long subs_;
+
+  mutable pthread_mutex_t mutex_;
+
+  pthread_t thread_;
+  bool thread_running_;
+  bool stopping_;
+  int interval_ms_;
+  pthread_cond_t stop_cond_;
+
+  // Disallow copy constructor and assignment operator.
+  ModuleIdentifierCache(const ModuleIdentifierCache&);
+  void operator=(const ModuleIdentifierCache&);
+};
+
+}  // namespace google_breakpad
+
+#endif  // CLIENT_LINUX_MINIDUMP_WRITER_MODULE_IDENTIFIER_CACHE_H_
@@ -0,0 +1,120 @@
+// Copyright (c) 2016 Google Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+// notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above
+// copyright notice, this list of conditions and the following disclaimer
+// in the documentation and/or other materials provided with the
+// distribution.
+//     * Neither the name of Google Inc. nor the names of its
+// contributors may be used to endorse or promote products derived from
+// this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+// module_identifier_cache_unittest.cc:
+// Unit tests for google_breakpad::ModuleIdentifierCache.
+
+#include <string.h>
+#include <unistd.h>
+
+#include "breakpad_googletest_includes.h"
+#include "client/linux/minidump_writer/linux_ptrace_dumper.h"
+#include "client/linux/minidump_writer/module_identifier_cache.h"
+
+using namespace google_breakpad;
+
+namespace {
+
+typedef testing::Test ModuleIdentifierCacheTest;
+
+// Returns the mapping of the module holding this test's code.
+const MappingInfo* FindOwnMapping(const LinuxDumper& dumper) {
+  return dumper.FindMapping(reinterpret_cast<void*>(&FindOwnMapping));
+}
+
+TEST(ModuleIdentifierCacheTest, MatchesIdentifiersFromFiles) {
+  ModuleIdentifierCache cache;
+  EXPECT_GT(cache.Update(), 0U);
+  EXPECT_GT(cache.module_count(), 0U);
+
+  LinuxPtraceDumper dumper(getpid());
+  ASSERT_TRUE(dumper.Init());
+
+  const MappingInfo* own_mapping = FindOwnMapping(dumper);
+  ASSERT_TRUE(own_mapping);
+  uint8_t identifier[sizeof(MDGUID)];
+  EXPECT_TRUE(cache.Lookup(*own_mapping, identifier));
+
+  size_t hits = 0;
+  for (size_t i = 0; i < dumper.mappings().size(); ++i) {
+    const MappingInfo& mapping = *dumper.mappings()[i];
+    uint8_t cached_identifier[sizeof(MDGUID)];
+    if (!cache.Lookup(mapping, cached_identifier))
+      continue;
+    ++hits;
+    ASSERT_TRUE(dumper.ElfFileIdentifierForMapping(mapping, true, i,
+                                                   identifier));
+    EXPECT_EQ(0, memcmp(identifier, cached_identifier, sizeof(identifier)))
+        << mapping.name;
+  }
+  EXPECT_EQ(cache.module_count(), hits);
+
+  // Nothing was loaded in the meantime.
+  EXPECT_EQ(0U, cache.Update());
+}
+
+TEST(ModuleIdentifierCacheTest, DumperUsesCache) {
+  ModuleIdentifierCache cache;
+  cache.Update();
+
+  LinuxPtraceDumper dumper(getpid());
+  ASSERT_TRUE(dumper.Init());
+  const MappingInfo* own_mapping = FindOwnMapping(dumper);
+  ASSERT_TRUE(own_mapping);
+
+  uint8_t identifier[sizeof(MDGUID)];
+  ASSERT_TRUE(cache.Lookup(*own_mapping, identifier));
+
+  uint8_t dumper_identifier[sizeof(MDGUID)];
+  dumper.set_module_identifier_cache(&cache);
+  ASSERT_TRUE(dumper.ElfFileIdentifierForMapping(*own_mapping, false, 0,
+                                                 dumper_identifier));
+  EXPECT_EQ(0, memcmp(identifier, dumper_identifier, sizeof(identifier)));
+
+  // Mappings that don't start a cached module aren't found.
+  MappingInfo unknown = *own_mapping;
+  unknown.start_addr += getpagesize();
+  EXPECT_FALSE(cache.Lookup(unknown, identifier));
+}
+
+TEST(ModuleIdentifierCacheTest, BackgroundUpdates) {
+  ModuleIdentifierCache cache;
+  ASSERT_TRUE(cache.StartBackgroundUpdates(10));
+  EXPECT_FALSE(cache.StartBackgroundUpdates(10));
+  for (int i = 0; i < 500 && cache.module_count() == 0; ++i)
+    usleep(10000);
+  EXPECT_GT(cache.module_count(), 0U);
+  cache.StopBackgroundUpdates();
+
+  // Stopping again is harmless, and updates can be restarted.
+  cache.StopBackgroundUpdates();
+  EXPECT_TRUE(cache.StartBackgroundUpdates(10));
+}
+
+}  // namespace
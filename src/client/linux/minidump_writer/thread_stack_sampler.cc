@@ -0,0 +1,243 @@
+// Copyright (c) 2016, Google Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+// notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above
+// copyright notice, this list of conditions and the following disclaimer
+// in the documentation and/or other materials provided with the
+// distribution.
+//     * Neither the name of Google Inc. nor the names of its
+// contributors may be used to endorse or promote products derived from
+// this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+// thread_stack_sampler.cc: Implement google_breakpad::ThreadStackSampler.
+// See thread_stack_sampler.h for details.
+
+#include "client/linux/minidump_writer/thread_stack_sampler.h"
+
+#include <assert.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <algorithm>
+
+#include "client/linux/dump_writer_common/thread_info.h"
+#include "client/linux/minidump_writer/linux_ptrace_dumper.h"
+#include "common/linux/eintr_wrapper.h"
+
+namespace google_breakpad {
+
+namespace {
+
+// A LinuxPtraceDumper that enumerates only what the sampler needs at
+// a time, instead of everything Init() reads.
+class SamplingDumper : public LinuxPtraceDumper {
+ public:
+  explicit SamplingDumper(pid_t pid) : LinuxPtraceDumper(pid) {}
+
+  bool InitThreads() { return EnumerateThreads(); }
+  bool InitMappings() { return ReadAuxv() && EnumerateMappings(); }
+};
+
+// Bytes below the stack pointer that leaf functions may use without
+// moving it.
+#if defined(__x86_64)
+const uintptr_t kRedZoneSize = 128;
+#else
+const uintptr_t kRedZoneSize = 0;
+#endif
+
+uint64_t NowNanoseconds() {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return static_cast<uint64_t>(now.tv_sec) * 1000000000 + now.tv_nsec;
+}
+
+// Reads the file at |path| and returns its FNV-1a hash and length in
+// |hash| and |length|. Files in /proc report a size of zero, so the file
+// is read until its end.
+bool HashFile(const char* path, uint64_t* hash, size_t* length) {
+  const int fd = open(path, O_RDONLY);
+  if (fd < 0)
+    return false;
+
+  *hash = 14695981039346656037ULL;
+  *length = 0;
+  uint8_t buffer[4096];
+  ssize_t result;
+  while ((result = HANDLE_EINTR(read(fd, buffer, sizeof(buffer)))) > 0) {
+    for (ssize_t i = 0; i < result; ++i) {
+      *hash ^= buffer[i];
+      *hash *= 1099511628211ULL;
+    }
+    *length += result;
+  }
+  close(fd);
+  return result == 0;
+}
+
+}  // namespace
+
+ThreadStackSampler::ThreadStackSampler(pid_t pid,
+                                       size_t stack_bytes,
+                                       size_t max_samples)
+    : pid_(pid),
+      stack_bytes_(stack_bytes),
+      samples_(std::max(max_samples, static_cast<size_t>(1))),
+      first_(0),
+      count_(0),
+      next_sequence_(0),
+      maps_hash_(0),
+      maps_length_(0),
+      mapping_generation_(0) {
+}
+
+ThreadStackSampler::~ThreadStackSampler() {
+}
+
+bool ThreadStackSampler::TakeSample() {
+  if (!UpdateMappings())
+    return false;
+
+  SamplingDumper dumper(pid_);
+  if (!dumper.InitThreads())
+    return false;
+
+  const uint64_t start_time = NowNanoseconds();
+  if (!dumper.ThreadsSuspend()) {
+    dumper.ThreadsResume();
+    return false;
+  }
+
+  // Reuse the slot after the newest sample, which is the oldest one once
+  // the ring is full.
+  Sample& sample = samples_[(first_ + count_) % samples_.size()];
+  sample.threads.clear();
+  sample.stack_data.clear();
+
+  ThreadInfo info;
+  for (size_t i = 0; i < dumper.threads().size(); ++i) {
+    if (!dumper.GetThreadInfoByIndex(i, &info))
+      continue;
+
+    ThreadSample thread;
+    thread.tid = dumper.threads()[i];
+    info.FillCPUContext(&thread.context);
+    thread.stack_start = info.stack_pointer;
+    thread.stack_size = 0;
+    thread.stack_offset = sample.stack_data.size();
+
+    const MappingInfo* stack_mapping = FindMapping(info.stack_pointer);
+    if (stack_mapping) {
+      const uintptr_t mapping_end =
+          stack_mapping->start_addr + stack_mapping->size;
+      thread.stack_start =
+          info.stack_pointer - stack_mapping->start_addr > kRedZoneSize ?
+              info.stack_pointer - kRedZoneSize : stack_mapping->start_addr;
+      thread.stack_size = std::min(
+          stack_bytes_, static_cast<size_t>(mapping_end - thread.stack_start));
+      sample.stack_data.resize(thread.stack_offset + thread.stack_size);
+      dumper.CopyFromProcess(&sample.stack_data[thread.stack_offset],
+                             thread.tid,
+                             reinterpret_cast<void*>(thread.stack_start),
+                             thread.stack_size);
+    }
+    sample.threads.push_back(thread);
+  }
+
+  dumper.ThreadsResume();
+  sample.pause_ns = NowNanoseconds() - start_time;
+  sample.time_ns = start_time;
+  sample.sequence = next_sequence_++;
+  sample.mapping_generation = mapping_generation_;
+
+  if (count_ < samples_.size())
+    ++count_;
+  else
+    first_ = (first_ + 1) % samples_.size();
+  return true;
+}
+
+const ThreadStackSampler::Sample& ThreadStackSampler::GetSample(
+    size_t index) const {
+  assert(index < count_);
+  return samples_[(first_ + index) % samples_.size()];
+}
+
+bool ThreadStackSampler::UpdateMappings() {
+  char maps_path[NAME_MAX];
+  snprintf(maps_path, sizeof(maps_path), "/proc/%d/maps", pid_);
+  uint64_t hash;
+  size_t length;
+  if (!HashFile(maps_path, &hash, &length))
+    return false;
+  if (mapping_generation_ > 0 && hash == maps_hash_ && length == maps_length_)
+    return true;
+
+  SamplingDumper dumper(pid_);
+  if (!dumper.InitMappings())
+    return false;
+
+  mappings_.clear();
+  modules_.clear();
+  for (size_t i = 0; i < dumper.mappings().size(); ++i) {
+    const MappingInfo& mapping = *dumper.mappings()[i];
+    mappings_.push_back(mapping);
+    if (!mapping.exec)
+      continue;
+
+    Module module;
+    module.mapping = mapping;
+    if (!dumper.ElfFileIdentifierForMapping(mapping, false, 0,
+                                            module.identifier)) {
+      memset(module.identifier, 0, sizeof(module.identifier));
+    }
+    modules_.push_back(module);
+  }
+  std::sort(mappings_.begin(), mappings_.end(), MappingStartLess());
+
+  maps_hash_ = hash;
+  maps_length_ = length;
+  ++mapping_generation_;
+  return true;
+}
+
+const MappingInfo* ThreadStackSampler::FindMapping(uintptr_t address) const {
+  // Find the last mapping starting at or below |address|.
+  size_t low = 0;
+  size_t high = mappings_.size();
+  while (low < high) {
+    const size_t mid = low + (high - low) / 2;
+    if (mappings_[mid].start_addr <= address)
+      low = mid + 1;
+    else
+      high = mid;
+  }
+  if (low == 0)
+    return NULL;
+  const MappingInfo& mapping = mappings_[low - 1];
+  return address - mapping.start_addr < mapping.size ? &mapping : NULL;
+}
+
+}  // namespace google_breakpad
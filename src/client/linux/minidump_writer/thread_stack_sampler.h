@@ -0,0 +1,166 @@
+// Copyright (c) 2016, Google Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+// notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above
+// copyright notice, this list of conditions and the following disclaimer
+// in the documentation and/or other materials provided with the
+// distribution.
+//     * Neither the name of Google Inc. nor the names of its
+// contributors may be used to endorse or promote products derived from
+// this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+// thread_stack_sampler.h: Define the google_breakpad::ThreadStackSampler
+// class, which periodically samples the threads of another process.
+//
+// Writing a full minidump to diagnose a hang stops the process for a long
+// time: every mapping is read and identified, and up to 32 KiB of every
+// stack is copied. A ThreadStackSampler captures much less at each call
+// to TakeSample():
+//  - the CPU context of every thread;
+//  - the top |stack_bytes| of every thread's stack, starting just below
+//    the stack pointer (to include the red zone) and clipped to the stack
+//    mapping.
+// Samples are kept in a ring of a fixed number of entries, whose buffers
+// are reused, so that a long-running sampler does not keep allocating.
+//
+// Mappings and module identifiers are read once and only refreshed when
+// the content of /proc/<pid>/maps changes. Each sample records the mapping
+// generation it was taken under; mappings() always describes the latest
+// generation.
+//
+// The threads are suspended with ptrace while a sample is taken, so the
+// sampler has to run in a process other than the sampled one, e.g. a
+// watchdog process, and that process needs permission to ptrace it. It
+// runs in a normal context.
+
+#ifndef CLIENT_LINUX_MINIDUMP_WRITER_THREAD_STACK_SAMPLER_H_
+#define CLIENT_LINUX_MINIDUMP_WRITER_THREAD_STACK_SAMPLER_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+#include <vector>
+
+#include "client/linux/dump_writer_common/mapping_info.h"
+#include "client/linux/dump_writer_common/raw_context_cpu.h"
+#include "google_breakpad/common/minidump_format.h"
+
+namespace google_breakpad {
+
+class ThreadStackSampler {
+ public:
+  // The state of one thread in a sample.
+  struct ThreadSample {
+    pid_t tid;
+    RawContextCPU context;
+    // The captured part of the stack: |stack_size| bytes at |stack_start|
+    // in the sampled process, stored at |stack_offset| in the sample's
+    // |stack_data|.
+    uintptr_t stack_start;
+    size_t stack_size;
+    size_t stack_offset;
+  };
+
+  struct Sample {
+    // Counts samples taken by this sampler, from 0.
+    uint64_t sequence;
+    // CLOCK_MONOTONIC time at which the threads were suspended.
+    uint64_t time_ns;
+    // How long the threads were kept suspended.
+    uint64_t pause_ns;
+    // The mapping generation that the sample was taken under.
+    unsigned mapping_generation;
+    std::vector<ThreadSample> threads;
+    std::vector<uint8_t> stack_data;
+  };
+
+  // A mapping with execute permission and the identifier of its file.
+  struct Module {
+    MappingInfo mapping;
+    uint8_t identifier[sizeof(MDGUID)];
+  };
+
+  // Samples the threads of |pid|, keeping |stack_bytes| of each stack and
+  // the last |max_samples| samples.
+  ThreadStackSampler(pid_t pid, size_t stack_bytes, size_t max_samples);
+  ~ThreadStackSampler();
+
+  // Takes a sample, refreshing the mappings first if they changed. When
+  // the ring is full, the oldest sample is replaced. Returns false if the
+  // process could not be sampled.
+  bool TakeSample();
+
+  // The samples in the ring, oldest first.
+  size_t sample_count() const { return count_; }
+  const Sample& GetSample(size_t index) const;
+
+  // The current mappings of the process, and the modules among them.
+  // Both are empty before the first sample.
+  const std::vector<MappingInfo>& mappings() const { return mappings_; }
+  const std::vector<Module>& modules() const { return modules_; }
+
+  // Incremented every time the mappings are refreshed. 0 before the first
+  // sample.
+  unsigned mapping_generation() const { return mapping_generation_; }
+
+ private:
+  // Re-reads the mappings and module identifiers if /proc/<pid>/maps has
+  // changed since the last call. Returns false if it could not be read.
+  bool UpdateMappings();
+
+  // Sorts MappingInfos by start address.
+  struct MappingStartLess {
+    bool operator()(const MappingInfo& a, const MappingInfo& b) const {
+      return a.start_addr < b.start_addr;
+    }
+  };
+
+  // Returns the current mapping containing |address|, or NULL.
+  const MappingInfo* FindMapping(uintptr_t address) const;
+
+  const pid_t pid_;
+  const size_t stack_bytes_;
+
+  // Ring of samples. The oldest of the |count_| valid entries is at
+  // |first_|.
+  std::vector<Sample> samples_;
+  size_t first_;
+  size_t count_;
+  uint64_t next_sequence_;
+
+  // Hash and length of the maps file that |mappings_| was built from.
+  uint64_t maps_hash_;
+  size_t maps_length_;
+  unsigned mapping_generation_;
+
+  // Sorted by start address.
+  std::vector<MappingInfo> mappings_;
+  std::vector<Module> modules_;
+
+  // Disallow copy ctor and operator=
+  ThreadStackSampler(const ThreadStackSampler&);
+  void operator=(const ThreadStackSampler&);
+};
+
+}  // namespace google_breakpad
+
+#endif  // CLIENT_LINUX_MINIDUMP_WRITER_THREAD_STACK_SAMPLER_H_
@@ -0,0 +1,155 @@
+// Copyright (c) 2016, Google Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+// notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above
+// copyright notice, this list of conditions and the following disclaimer
+// in the documentation and/or other materials provided with the
+// distribution.
+//     * Neither the name of Google Inc. nor the names of its
+// contributors may be used to endorse or promote products derived from
+// this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+// thread_stack_sampler_unittest.cc: Unit tests for
+// google_breakpad::ThreadStackSampler.
+
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "breakpad_googletest_includes.h"
+#include "client/linux/minidump_writer/thread_stack_sampler.h"
+#include "common/linux/eintr_wrapper.h"
+
+using namespace google_breakpad;
+
+namespace {
+
+// Runs a child process that maps a new page for every byte written to its
+// command pipe, and acknowledges each one on its reply pipe.
+class ThreadStackSamplerTest : public testing::Test {
+ public:
+  virtual void SetUp() {
+    int command[2];
+    int reply[2];
+    ASSERT_EQ(0, pipe(command));
+    ASSERT_EQ(0, pipe(reply));
+    child_ = fork();
+    if (child_ == 0) {
+      close(command[1]);
+      close(reply[0]);
+      char byte;
+      while (HANDLE_EINTR(read(command[0], &byte, 1)) == 1) {
+        // Alternate the protection so the new page is never merged into
+        // the previous one.
+        static int count = 0;
+        mmap(NULL, getpagesize(), ++count % 2 ? PROT_READ : PROT_NONE,
+             MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (HANDLE_EINTR(write(reply[1], &byte, 1)) != 1)
+          break;
+      }
+      _exit(0);
+    }
+    close(command[0]);
+    close(reply[1]);
+    command_fd_ = command[1];
+    reply_fd_ = reply[0];
+  }
+
+  virtual void TearDown() {
+    close(command_fd_);
+    close(reply_fd_);
+    int status;
+    HANDLE_EINTR(waitpid(child_, &status, 0));
+  }
+
+  void MapPageInChild() {
+    char byte = 'm';
+    ASSERT_EQ(1, HANDLE_EINTR(write(command_fd_, &byte, 1)));
+    ASSERT_EQ(1, HANDLE_EINTR(read(reply_fd_, &byte, 1)));
+  }
+
+ protected:
+  pid_t child_;
+  int command_fd_;
+  int reply_fd_;
+};
+
+}  // namespace
+
+TEST_F(ThreadStackSamplerTest, CapturesContextAndStackTop) {
+  const size_t kStackBytes = 1024;
+  ThreadStackSampler sampler(child_, kStackBytes, 4);
+  EXPECT_EQ(0U, sampler.mapping_generation());
+  ASSERT_TRUE(sampler.TakeSample());
+  ASSERT_EQ(1U, sampler.sample_count());
+  EXPECT_EQ(1U, sampler.mapping_generation());
+  EXPECT_FALSE(sampler.mappings().empty());
+  EXPECT_FALSE(sampler.modules().empty());
+
+  const ThreadStackSampler::Sample& sample = sampler.GetSample(0);
+  EXPECT_EQ(0U, sample.sequence);
+  EXPECT_EQ(1U, sample.mapping_generation);
+  ASSERT_EQ(1U, sample.threads.size());
+  const ThreadStackSampler::ThreadSample& thread = sample.threads[0];
+  EXPECT_EQ(child_, thread.tid);
+  EXPECT_GT(thread.stack_size, 0U);
+  EXPECT_LE(thread.stack_size, kStackBytes);
+  EXPECT_EQ(0U, thread.stack_offset);
+  EXPECT_EQ(thread.stack_size, sample.stack_data.size());
+}
+
+TEST_F(ThreadStackSamplerTest, RefreshesMappingsOnlyWhenChanged) {
+  ThreadStackSampler sampler(child_, 256, 4);
+  ASSERT_TRUE(sampler.TakeSample());
+  ASSERT_TRUE(sampler.TakeSample());
+  EXPECT_EQ(1U, sampler.mapping_generation());
+  const size_t mapping_count = sampler.mappings().size();
+
+  MapPageInChild();
+  ASSERT_TRUE(sampler.TakeSample());
+  EXPECT_EQ(2U, sampler.mapping_generation());
+  EXPECT_EQ(mapping_count + 1, sampler.mappings().size());
+  EXPECT_EQ(1U, sampler.GetSample(1).mapping_generation);
+  EXPECT_EQ(2U, sampler.GetSample(2).mapping_generation);
+}
+
+TEST_F(ThreadStackSamplerTest, RingKeepsNewestSamples) {
+  ThreadStackSampler sampler(child_, 256, 2);
+  for (int i = 0; i < 5; ++i)
+    ASSERT_TRUE(sampler.TakeSample());
+  ASSERT_EQ(2U, sampler.sample_count());
+  EXPECT_EQ(3U, sampler.GetSample(0).sequence);
+  EXPECT_EQ(4U, sampler.GetSample(1).sequence);
+  EXPECT_LE(sampler.GetSample(0).time_ns, sampler.GetSample(1).time_ns);
+}
+
+TEST(ThreadStackSamplerNoProcessTest, FailsForMissingProcess) {
+  pid_t child = fork();
+  if (child == 0)
+    _exit(0);
+  int status;
+  ASSERT_EQ(child, HANDLE_EINTR(waitpid(child, &status, 0)));
+
+  ThreadStackSampler sampler(child, 256, 2);
+  EXPECT_FALSE(sampler.TakeSample());
+  EXPECT_EQ(0U, sampler.sample_count());
+}
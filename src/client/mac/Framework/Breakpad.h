@@ -163,6 +163,12 @@ typedef bool (*BreakpadFilterCallback)(int exception_type,
 //                                will write the dump file in-process and then
 //                                launch the reporter executable as a child
 //                                process.
+//
+// BREAKPAD_INSPECTOR_SERVICE     The bootstrap name of an Inspector already
+//                                running as a server ("Inspector --server
+//                                <name>").  If set, crashes are sent to it
+//                                instead of to an Inspector launched for the
+//                                crash.
 //=============================================================================
 // The BREAKPAD_PRODUCT, BREAKPAD_VERSION and BREAKPAD_URL are
 // required to have non-NULL values.  By default, the BREAKPAD_PRODUCT
@@ -259,10 +265,19 @@ void BreakpadSetFilterCallback(BreakpadRef ref,
 // TODO (nealsid): separate server parameter dictionary from the
 // dictionary used to configure Breakpad, and document limits for each
 // independently.
+//
+// The key/value storage is kept read-only between updates, and making it
+// writable costs two system calls.  Setting a key to the value it already
+// has, reading a value, or removing a key that isn't there doesn't make
+// it writable.
 void BreakpadSetKeyValue(BreakpadRef ref, NSString *key, NSString *value);
 NSString *BreakpadKeyValue(BreakpadRef ref, NSString *key);
 void BreakpadRemoveKeyValue(BreakpadRef ref, NSString *key);
 
+// Sets all the keys of |keyValues| to their NSString values, or removes
+// those whose value is NSNull, making the storage writable at most once.
+void BreakpadSetKeyValues(BreakpadRef ref, NSDictionary *keyValues);
+
 // You can use this method to specify parameters that will be uploaded
 // to the crash server.  They will be automatically encoded as
 // necessary.  Note that as mentioned above there are limits on both
@@ -36,6 +36,7 @@
 #include <assert.h>
 #import <Foundation/Foundation.h>
 #include <pthread.h>
+#include <string.h>
 #include <sys/stat.h>
 #include <sys/sysctl.h>
 
@@ -60,6 +61,7 @@
 #define catch(X)  if (false)
 #endif  // __EXCEPTIONS
 
+using google_breakpad::MachMsgPortDescriptor;
 using google_breakpad::MachPortSender;
 using google_breakpad::MachReceiveMessage;
 using google_breakpad::MachSendMessage;
@@ -94,31 +96,46 @@ pthread_mutex_t gDictionaryMutex;
 // Stack-based object for thread-safe access to a memory-protected region.
 // It's assumed that normally the memory block (allocated by the allocator)
 // is protected (read-only).  Creating a stack-based instance of
-// ProtectedMemoryLocker will unprotect this block after taking the lock.
-// Its destructor will first re-protect the memory then release the lock.
+// ProtectedMemoryLocker takes the lock, and unprotects this block unless
+// it is created kReadOnly, in which case Unprotect() does so once a write
+// turns out to be needed.  Its destructor will first re-protect the memory,
+// if it was unprotected, then release the lock.
 class ProtectedMemoryLocker {
  public:
+  enum Access { kReadOnly, kReadWrite };
+
   ProtectedMemoryLocker(pthread_mutex_t *mutex,
-                        ProtectedMemoryAllocator *allocator)
+                        ProtectedMemoryAllocator *allocator,
+                        Access access = kReadWrite)
       : mutex_(mutex),
-        allocator_(allocator) {
+        allocator_(allocator),
+        unprotected_(false) {
     // Lock the mutex
     __attribute__((unused)) int rv = pthread_mutex_lock(mutex_);
     assert(rv == 0);
 
-    // Unprotect the memory
-    allocator_->Unprotect();
+    if (access == kReadWrite)
+      Unprotect();
   }
 
   ~ProtectedMemoryLocker() {
     // First protect the memory
-    allocator_->Protect();
+    if (unprotected_)
+      allocator_->Protect();
 
     // Then unlock the mutex
     __attribute__((unused)) int rv = pthread_mutex_unlock(mutex_);
     assert(rv == 0);
   };
 
+  // Makes the memory writable until the locker goes away.
+  void Unprotect() {
+    if (!unprotected_) {
+      allocator_->Unprotect();
+      unprotected_ = true;
+    }
+  }
+
  private:
   ProtectedMemoryLocker();
   ProtectedMemoryLocker(const ProtectedMemoryLocker&);
@@ -126,6 +143,7 @@ class ProtectedMemoryLocker {
 
   pthread_mutex_t           *mutex_;
   ProtectedMemoryAllocator  *allocator_;
+  bool                      unprotected_;
 };
 
 //=============================================================================
@@ -155,6 +173,9 @@ class Breakpad {
   void SetKeyValue(NSString *key, NSString *value);
   NSString *KeyValue(NSString *key);
   void RemoveKeyValue(NSString *key);
+  // Returns true if |key| already has |value|, or has no value if |value|
+  // is nil, so that setting it would not change anything.
+  bool HasKeyValue(NSString *key, NSString *value);
 
   void GenerateAndSendReport();
 
@@ -167,6 +188,7 @@ class Breakpad {
   Breakpad()
     : handler_(NULL),
       config_params_(NULL),
+      inspector_service_port_(MACH_PORT_NULL),
       send_and_exit_(true),
       filter_callback_(NULL),
       filter_callback_context_(NULL) {
@@ -212,6 +234,10 @@ class Breakpad {
 
   OnDemandServer          inspector_;
 
+  // Send right to the Inspector server, if BREAKPAD_INSPECTOR_SERVICE is set,
+  // in which case inspector_ is not used.
+  mach_port_t             inspector_service_port_;
+
   bool                    send_and_exit_;  // Exit after sending, if true
 
   BreakpadFilterCallback  filter_callback_;
@@ -374,41 +400,57 @@ bool Breakpad::InitializeInProcess(NSDictionary* parameters) {
 
 //=============================================================================
 bool Breakpad::InitializeOutOfProcess(NSDictionary* parameters) {
-  // Get path to Inspector executable.
-  NSString *inspectorPathString = KeyValue(@BREAKPAD_INSPECTOR_LOCATION);
-
-  // Standardize path (resolve symlinkes, etc.)  and escape spaces
-  inspectorPathString = [inspectorPathString stringByStandardizingPath];
-  inspectorPathString = [[inspectorPathString componentsSeparatedByString:@" "]
-                                              componentsJoinedByString:@"\\ "];
-
-  // Create an on-demand server object representing the Inspector.
-  // In case of a crash, we simply need to call the LaunchOnDemand()
-  // method on it, then send a mach message to its service port.
-  // It will then launch and perform a process inspection of our crashed state.
-  // See the HandleException() method for the details.
+  NSString *inspectorService =
+      [parameters objectForKey:@BREAKPAD_INSPECTOR_SERVICE];
+  if (inspectorService) {
+    // An Inspector server is already running, so there is nothing to
+    // launch.  Look it up now rather than at crash time.
+    kern_return_t kr = bootstrap_look_up(
+        bootstrap_port,
+        const_cast<char*>([inspectorService UTF8String]),
+        &inspector_service_port_);
+    if (kr != KERN_SUCCESS) {
+      return false;
+    }
+  } else {
+    // Get path to Inspector executable.
+    NSString *inspectorPathString = KeyValue(@BREAKPAD_INSPECTOR_LOCATION);
+
+    // Standardize path (resolve symlinkes, etc.)  and escape spaces
+    inspectorPathString = [inspectorPathString stringByStandardizingPath];
+    inspectorPathString =
+        [[inspectorPathString componentsSeparatedByString:@" "]
+                              componentsJoinedByString:@"\\ "];
+
+    // Create an on-demand server object representing the Inspector.
+    // In case of a crash, we simply need to call the LaunchOnDemand()
+    // method on it, then send a mach message to its service port.
+    // It will then launch and perform a process inspection of our crashed
+    // state.
+    // See the HandleException() method for the details.
 #define RECEIVE_PORT_NAME "com.Breakpad.Inspector"
 
-  name_t portName;
-  snprintf(portName, sizeof(name_t),  "%s%d", RECEIVE_PORT_NAME, getpid());
+    name_t portName;
+    snprintf(portName, sizeof(name_t),  "%s%d", RECEIVE_PORT_NAME, getpid());
 
-  // Save the location of the Inspector
-  strlcpy(inspector_path_, [inspectorPathString fileSystemRepresentation],
-          sizeof(inspector_path_));
+    // Save the location of the Inspector
+    strlcpy(inspector_path_, [inspectorPathString fileSystemRepresentation],
+            sizeof(inspector_path_));
 
-  // Append a single command-line argument to the Inspector path
-  // representing the bootstrap name of the launch-on-demand receive port.
-  // When the Inspector is launched, it can use this to lookup the port
-  // by calling bootstrap_check_in().
-  strlcat(inspector_path_, " ", sizeof(inspector_path_));
-  strlcat(inspector_path_, portName, sizeof(inspector_path_));
+    // Append a single command-line argument to the Inspector path
+    // representing the bootstrap name of the launch-on-demand receive port.
+    // When the Inspector is launched, it can use this to lookup the port
+    // by calling bootstrap_check_in().
+    strlcat(inspector_path_, " ", sizeof(inspector_path_));
+    strlcat(inspector_path_, portName, sizeof(inspector_path_));
 
-  kern_return_t kr = inspector_.Initialize(inspector_path_,
-                                           portName,
-                                           true);        // shutdown on exit
+    kern_return_t kr = inspector_.Initialize(inspector_path_,
+                                             portName,
+                                             true);        // shutdown on exit
 
-  if (kr != KERN_SUCCESS) {
-    return false;
+    if (kr != KERN_SUCCESS) {
+      return false;
+    }
   }
 
   // Create the handler (allocating it in our special protected pool)
@@ -661,6 +703,17 @@ NSString *Breakpad::KeyValue(NSString *key) {
   return value ? [NSString stringWithUTF8String:value] : nil;
 }
 
+//=============================================================================
+bool Breakpad::HasKeyValue(NSString *key, NSString *value) {
+  if (!config_params_ || !key)
+    return true;
+
+  const char *current = config_params_->GetValueForKey([key UTF8String]);
+  if (!value)
+    return current == NULL;
+  return current && strcmp(current, [value UTF8String]) == 0;
+}
+
 //=============================================================================
 void Breakpad::RemoveKeyValue(NSString *key) {
   if (!config_params_ || !key) return;
@@ -688,15 +741,34 @@ bool Breakpad::HandleException(int exception_type,
     if (!should_handle) return false;
   }
 
-  // We need to reset the memory protections to be read/write,
-  // since LaunchOnDemand() requires changing state.
-  gBreakpadAllocator->Unprotect();
-  // Configure the server to launch when we message the service port.
-  // The reason we do this here, rather than at startup, is that we
-  // can leak a bootstrap service entry if this method is called and
-  // there never ends up being a crash.
-  inspector_.LaunchOnDemand();
-  gBreakpadAllocator->Protect();
+  kern_return_t result = KERN_SUCCESS;
+
+  // The port the Inspector receives our messages on.  An Inspector server
+  // takes the receive right of session_port from us, and keeps its
+  // messages from ours apart from those of other crashed processes.
+  mach_port_t inspector_port;
+  ReceivePort session_port;
+
+  if (inspector_service_port_ != MACH_PORT_NULL) {
+    MachSendMessage session_message(kMsgType_InspectorSessionRequest);
+    session_message.AddDescriptor(
+        MachMsgPortDescriptor(session_port.GetPort(),
+                              MACH_MSG_TYPE_MOVE_RECEIVE));
+    MachPortSender service_sender(inspector_service_port_);
+    result = service_sender.SendMessage(session_message, 2000);
+    inspector_port = session_port.GetPort();
+  } else {
+    // We need to reset the memory protections to be read/write,
+    // since LaunchOnDemand() requires changing state.
+    gBreakpadAllocator->Unprotect();
+    // Configure the server to launch when we message the service port.
+    // The reason we do this here, rather than at startup, is that we
+    // can leak a bootstrap service entry if this method is called and
+    // there never ends up being a crash.
+    inspector_.LaunchOnDemand();
+    gBreakpadAllocator->Protect();
+    inspector_port = inspector_.GetServicePort();
+  }
 
   // The Inspector should send a message to this port to verify it
   // received our information and has finished the inspection.
@@ -716,9 +788,10 @@ bool Breakpad::HandleException(int exception_type,
   info.parameter_count = config_params_->GetCount();
   message.SetData(&info, sizeof(info));
 
-  MachPortSender sender(inspector_.GetServicePort());
+  MachPortSender sender(inspector_port);
 
-  kern_return_t result = sender.SendMessage(message, 2000);
+  if (result == KERN_SUCCESS)
+    result = sender.SendMessage(message, 2000);
 
   if (result == KERN_SUCCESS) {
     // Now, send a series of key-value pairs to the Inspector.
@@ -747,8 +820,7 @@ bool Breakpad::HandleException(int exception_type,
 
 #if VERBOSE
   PRINT_MACH_RESULT(result, "Breakpad: SendMessage ");
-  printf("Breakpad: Inspector service port = %#x\n",
-    inspector_.GetServicePort());
+  printf("Breakpad: Inspector service port = %#x\n", inspector_port);
 #endif
 
   // If we don't want any forwarding, return true here to indicate that we've
@@ -895,15 +967,47 @@ void BreakpadSetKeyValue(BreakpadRef ref, NSString *key, NSString *value) {
     Breakpad *breakpad = (Breakpad *)ref;
 
     if (breakpad && key && gKeyValueAllocator) {
-      ProtectedMemoryLocker locker(&gDictionaryMutex, gKeyValueAllocator);
-
-      breakpad->SetKeyValue(key, value);
+      // Setting a key to the value it already has, as callers that set
+      // their annotations on every request often do, leaves the memory
+      // protected.
+      ProtectedMemoryLocker locker(&gDictionaryMutex, gKeyValueAllocator,
+                                   ProtectedMemoryLocker::kReadOnly);
+
+      if (!breakpad->HasKeyValue(key, value)) {
+        locker.Unprotect();
+        breakpad->SetKeyValue(key, value);
+      }
     }
   } catch(...) {    // don't let exceptions leave this C API
     fprintf(stderr, "BreakpadSetKeyValue() : error\n");
   }
 }
 
+//=============================================================================
+void BreakpadSetKeyValues(BreakpadRef ref, NSDictionary *keyValues) {
+  try {
+    // Not called at exception time
+    Breakpad *breakpad = (Breakpad *)ref;
+
+    if (breakpad && keyValues && gKeyValueAllocator) {
+      ProtectedMemoryLocker locker(&gDictionaryMutex, gKeyValueAllocator,
+                                   ProtectedMemoryLocker::kReadOnly);
+
+      for (NSString *key in keyValues) {
+        NSString *value = [keyValues objectForKey:key];
+        if (value == (id)[NSNull null])
+          value = nil;
+        if (!breakpad->HasKeyValue(key, value)) {
+          locker.Unprotect();
+          breakpad->SetKeyValue(key, value);
+        }
+      }
+    }
+  } catch(...) {    // don't let exceptions leave this C API
+    fprintf(stderr, "BreakpadSetKeyValues() : error\n");
+  }
+}
+
 void BreakpadAddUploadParameter(BreakpadRef ref,
                                 NSString *key,
                                 NSString *value) {
@@ -916,11 +1020,15 @@ void BreakpadAddUploadParameter(BreakpadRef ref,
     Breakpad *breakpad = (Breakpad *)ref;
 
     if (breakpad && key && gKeyValueAllocator) {
-      ProtectedMemoryLocker locker(&gDictionaryMutex, gKeyValueAllocator);
+      ProtectedMemoryLocker locker(&gDictionaryMutex, gKeyValueAllocator,
+                                   ProtectedMemoryLocker::kReadOnly);
 
       NSString *prefixedKey = [@BREAKPAD_SERVER_PARAMETER_PREFIX
 				stringByAppendingString:key];
-      breakpad->SetKeyValue(prefixedKey, value);
+      if (!breakpad->HasKeyValue(prefixedKey, value)) {
+        locker.Unprotect();
+        breakpad->SetKeyValue(prefixedKey, value);
+      }
     }
   } catch(...) {    // don't let exceptions leave this C API
     fprintf(stderr, "BreakpadSetKeyValue() : error\n");
@@ -934,11 +1042,15 @@ void BreakpadRemoveUploadParameter(BreakpadRef ref,
     Breakpad *breakpad = (Breakpad *)ref;
 
     if (breakpad && key && gKeyValueAllocator) {
-      ProtectedMemoryLocker locker(&gDictionaryMutex, gKeyValueAllocator);
+      ProtectedMemoryLocker locker(&gDictionaryMutex, gKeyValueAllocator,
+                                   ProtectedMemoryLocker::kReadOnly);
 
       NSString *prefixedKey = [NSString stringWithFormat:@"%@%@",
                                         @BREAKPAD_SERVER_PARAMETER_PREFIX, key];
-      breakpad->RemoveKeyValue(prefixedKey);
+      if (!breakpad->HasKeyValue(prefixedKey, nil)) {
+        locker.Unprotect();
+        breakpad->RemoveKeyValue(prefixedKey);
+      }
     }
   } catch(...) {    // don't let exceptions leave this C API
     fprintf(stderr, "BreakpadRemoveKeyValue() : error\n");
@@ -955,7 +1067,9 @@ NSString *BreakpadKeyValue(BreakpadRef ref, NSString *key) {
     if (!breakpad || !key || !gKeyValueAllocator)
       return nil;
 
-    ProtectedMemoryLocker locker(&gDictionaryMutex, gKeyValueAllocator);
+    // Reading doesn't need the memory to be writable.
+    ProtectedMemoryLocker locker(&gDictionaryMutex, gKeyValueAllocator,
+                                 ProtectedMemoryLocker::kReadOnly);
 
     value = breakpad->KeyValue(key);
   } catch(...) {    // don't let exceptions leave this C API
@@ -972,9 +1086,13 @@ void BreakpadRemoveKeyValue(BreakpadRef ref, NSString *key) {
     Breakpad *breakpad = (Breakpad *)ref;
 
     if (breakpad && key && gKeyValueAllocator) {
-      ProtectedMemoryLocker locker(&gDictionaryMutex, gKeyValueAllocator);
+      ProtectedMemoryLocker locker(&gDictionaryMutex, gKeyValueAllocator,
+                                   ProtectedMemoryLocker::kReadOnly);
 
-      breakpad->RemoveKeyValue(key);
+      if (!breakpad->HasKeyValue(key, nil)) {
+        locker.Unprotect();
+        breakpad->RemoveKeyValue(key);
+      }
     }
   } catch(...) {    // don't let exceptions leave this C API
     fprintf(stderr, "BreakpadRemoveKeyValue() : error\n");
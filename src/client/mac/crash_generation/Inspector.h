@@ -34,16 +34,21 @@
 
 #import <Foundation/Foundation.h>
 #include <mach/mach.h>
+#include <time.h>
+
+#include <map>
 
 #import "client/mac/crash_generation/ConfigFile.h"
 #import "client/mac/handler/minidump_generator.h"
+#import "common/mac/MachIPC.h"
 
 
 // Types of mach messsages (message IDs)
 enum {
   kMsgType_InspectorInitialInfo = 0,    // data is InspectorInfo
   kMsgType_InspectorKeyValuePair = 1,   // data is KeyValueMessageData
-  kMsgType_InspectorAcknowledgement = 2 // no data sent
+  kMsgType_InspectorAcknowledgement = 2, // no data sent
+  kMsgType_InspectorSessionRequest = 3  // no data; a receive right is sent
 };
 
 // Initial information sent from the crashed process by
@@ -111,7 +116,7 @@ class MinidumpLocation {
 //=============================================================================
 class Inspector {
  public:
-  Inspector() {};
+  Inspector();
 
   // given a bootstrap service name, receives mach messages
   // from a crashed process, then inspects it, creates a minidump file
@@ -119,6 +124,11 @@ class Inspector {
   void            Inspect(const char *receive_port_name);
 
  private:
+  friend class InspectorServer;
+
+  // For InspectorServer, which feeds the messages to the Inspector itself.
+  explicit Inspector(DynamicImageCache *image_cache);
+
   // The Inspector is invoked with its bootstrap port set to the bootstrap
   // subset established in OnDemandServer.mm OnDemandServer::Initialize.
   // For proper communication with the system, the sender (which will inherit
@@ -136,9 +146,22 @@ class Inspector {
 
   kern_return_t   ReadMessages();
 
+  // Take the crash information and the crashed process's ports from the
+  // initial message, and a parameter from each key/value message.
+  // ReadKeyValue returns false if the message holds no parameter.
+  void            ReadInitialInfo(MachReceiveMessage &message);
+  bool            ReadKeyValue(MachReceiveMessage &message);
+
+  // Inspects the task, acknowledges and launches the reporter, once all
+  // messages have been read.
+  void            InspectAndReport();
+
   bool            InspectTask();
   kern_return_t   SendAcknowledgement();
 
+  // Releases the rights to the crashed process's ports.
+  void            ReleasePorts();
+
   // The bootstrap port in which the inspector is registered and into which it
   // must check in.
   mach_port_t     bootstrap_subset_port_;
@@ -152,10 +175,72 @@ class Inspector {
   mach_port_t     crashing_thread_;
   mach_port_t     handler_thread_;
   mach_port_t     ack_port_;
+  unsigned int    parameter_count_;
 
   SimpleStringDictionary config_params_;
 
   ConfigFile      config_file_;
+
+  // Shared with other Inspectors in the same process; may be NULL.
+  DynamicImageCache *image_cache_;
+};
+
+//=============================================================================
+// Serves crashed processes from a persistent Inspector process, started by
+// "Inspector --server <service name>" (usually as a launchd agent with the
+// service name in its MachServices), instead of launching an Inspector for
+// each crash.
+//
+// A crashed process sends a kMsgType_InspectorSessionRequest message to the
+// service, moving the receive right of a port of its own along with it, then
+// sends the usual Inspector messages to that port.  All these session ports
+// are received on one port set, so the messages of many crashed processes
+// may arrive interleaved.  Once a session has all its messages, the process
+// is inspected on a thread of its own, and the images of the dyld shared
+// cache that one inspection reads are reused by the next.
+class InspectorServer {
+ public:
+  InspectorServer();
+  ~InspectorServer();
+
+  // Checks in to |service_name| and serves crashed processes until an
+  // error occurs.
+  void            Serve(const char *service_name);
+
+ private:
+  struct Session {
+    explicit Session(DynamicImageCache *image_cache)
+        : inspector(image_cache),
+          initial_info_read(false),
+          messages_read(0),
+          parameters_read(0),
+          start_time(time(NULL)) {}
+
+    Inspector     inspector;
+    bool          initial_info_read;
+    unsigned int  messages_read;    // key/value messages
+    unsigned int  parameters_read;  // key/value messages with a parameter
+    time_t        start_time;
+  };
+  typedef std::map<mach_port_t, Session*> SessionMap;
+
+  void            StartSession(MachReceiveMessage &message);
+  void            ReadSessionMessage(MachReceiveMessage &message);
+
+  // Destroys the session port and, if |inspect|, hands the session to a
+  // new thread that inspects the process; otherwise deletes the session.
+  void            EndSession(SessionMap::iterator session, bool inspect);
+
+  // Ends the sessions whose process stopped sending messages.
+  void            ExpireSessions();
+
+  static void     *InspectorThread(void *session_pointer);
+
+  mach_port_t     service_rcv_port_;
+  mach_port_t     port_set_;
+  SessionMap      sessions_;
+
+  DynamicImageCache image_cache_;
 };
 
 
@@ -31,6 +31,7 @@
 
 #include <cstdio>
 #include <iostream>
+#include <pthread.h>
 #include <servers/bootstrap.h>
 #include <stdio.h>
 #include <string.h>
@@ -51,6 +52,28 @@
 
 namespace google_breakpad {
 
+// How long a crashed process may take between its Inspector messages.
+static const mach_msg_timeout_t kMessageTimeoutMs = 1000;
+
+//=============================================================================
+Inspector::Inspector()
+    : remote_task_(MACH_PORT_NULL),
+      crashing_thread_(MACH_PORT_NULL),
+      handler_thread_(MACH_PORT_NULL),
+      ack_port_(MACH_PORT_NULL),
+      parameter_count_(0),
+      image_cache_(NULL) {
+}
+
+Inspector::Inspector(DynamicImageCache *image_cache)
+    : remote_task_(MACH_PORT_NULL),
+      crashing_thread_(MACH_PORT_NULL),
+      handler_thread_(MACH_PORT_NULL),
+      ack_port_(MACH_PORT_NULL),
+      parameter_count_(0),
+      image_cache_(image_cache) {
+}
+
 //=============================================================================
 void Inspector::Inspect(const char *receive_port_name) {
   kern_return_t result = ResetBootstrapPort();
@@ -64,25 +87,7 @@ void Inspector::Inspect(const char *receive_port_name) {
     result = ReadMessages();
 
     if (result == KERN_SUCCESS) {
-      // Inspect the task and write a minidump file.
-      bool wrote_minidump = InspectTask();
-
-      // Send acknowledgement to the crashed process that the inspection
-      // has finished.  It will then be able to cleanly exit.
-      // The return value is ignored because failure isn't fatal. If the process
-      // didn't get the message there's nothing we can do, and we still want to
-      // send the report.
-      SendAcknowledgement();
-
-      if (wrote_minidump) {
-        // Ask the user if he wants to upload the crash report to a server,
-        // and do so if he agrees.
-        LaunchReporter(
-            config_params_.GetValueForKey(BREAKPAD_REPORTER_EXE_LOCATION),
-            config_file_.GetFilePath());
-      } else {
-        fprintf(stderr, "Inspection of crashed process failed\n");
-      }
+      InspectAndReport();
 
       // Now that we're done reading messages, cleanup the service, but only
       // if there was an actual exception
@@ -97,6 +102,29 @@ void Inspector::Inspect(const char *receive_port_name) {
   }
 }
 
+//=============================================================================
+void Inspector::InspectAndReport() {
+  // Inspect the task and write a minidump file.
+  bool wrote_minidump = InspectTask();
+
+  // Send acknowledgement to the crashed process that the inspection
+  // has finished.  It will then be able to cleanly exit.
+  // The return value is ignored because failure isn't fatal. If the process
+  // didn't get the message there's nothing we can do, and we still want to
+  // send the report.
+  SendAcknowledgement();
+
+  if (wrote_minidump) {
+    // Ask the user if he wants to upload the crash report to a server,
+    // and do so if he agrees.
+    LaunchReporter(
+        config_params_.GetValueForKey(BREAKPAD_REPORTER_EXE_LOCATION),
+        config_file_.GetFilePath());
+  } else {
+    fprintf(stderr, "Inspection of crashed process failed\n");
+  }
+}
+
 //=============================================================================
 kern_return_t Inspector::ResetBootstrapPort() {
   // A reasonable default, in case anything fails.
@@ -195,33 +223,11 @@ kern_return_t Inspector::ReadMessages() {
   ReceivePort receive_port(service_rcv_port_);
 
   MachReceiveMessage message;
-  kern_return_t result = receive_port.WaitForMessage(&message, 1000);
+  kern_return_t result = receive_port.WaitForMessage(&message,
+                                                     kMessageTimeoutMs);
 
   if (result == KERN_SUCCESS) {
-    InspectorInfo &info = (InspectorInfo &)*message.GetData();
-    exception_type_ = info.exception_type;
-    exception_code_ = info.exception_code;
-    exception_subcode_ = info.exception_subcode;
-
-#if VERBOSE
-    printf("message ID = %d\n", message.GetMessageID());
-#endif
-
-    remote_task_ = message.GetTranslatedPort(0);
-    crashing_thread_ = message.GetTranslatedPort(1);
-    handler_thread_ = message.GetTranslatedPort(2);
-    ack_port_ = message.GetTranslatedPort(3);
-
-#if VERBOSE
-    printf("exception_type = %d\n", exception_type_);
-    printf("exception_code = %d\n", exception_code_);
-    printf("exception_subcode = %d\n", exception_subcode_);
-    printf("remote_task = %d\n", remote_task_);
-    printf("crashing_thread = %d\n", crashing_thread_);
-    printf("handler_thread = %d\n", handler_thread_);
-    printf("ack_port_ = %d\n", ack_port_);
-    printf("parameter count = %d\n", info.parameter_count);
-#endif
+    ReadInitialInfo(message);
 
     // In certain situations where multiple crash requests come
     // through quickly, we can end up with the mach IPC messages not
@@ -232,29 +238,20 @@ kern_return_t Inspector::ReadMessages() {
     // The initial message contains the number of key value pairs that
     // we are expected to read.
     // Read each key/value pair, one mach message per key/value pair.
-    for (unsigned int i = 0; i < info.parameter_count; ++i) {
+    for (unsigned int i = 0; i < parameter_count_; ++i) {
       MachReceiveMessage parameter_message;
-      result = receive_port.WaitForMessage(&parameter_message, 1000);
+      result = receive_port.WaitForMessage(&parameter_message,
+                                           kMessageTimeoutMs);
 
       if(result == KERN_SUCCESS) {
-        KeyValueMessageData &key_value_data =
-          (KeyValueMessageData&)*parameter_message.GetData();
-        // If we get a blank key, make sure we don't increment the
-        // parameter count; in some cases (notably on-demand generation
-        // many times in a short period of time) caused the Mach IPC
-        // messages to not come through correctly.
-        if (strlen(key_value_data.key) == 0) {
-          continue;
-        }
-        parameters_read++;
-
-        config_params_.SetKeyValue(key_value_data.key, key_value_data.value);
+        if (ReadKeyValue(parameter_message))
+          parameters_read++;
       } else {
         PRINT_MACH_RESULT(result, "Inspector: key/value message");
         break;
       }
     }
-    if (parameters_read != info.parameter_count) {
+    if (parameters_read != parameter_count_) {
       return KERN_FAILURE;
     }
   }
@@ -262,6 +259,51 @@ kern_return_t Inspector::ReadMessages() {
   return result;
 }
 
+//=============================================================================
+void Inspector::ReadInitialInfo(MachReceiveMessage &message) {
+  InspectorInfo &info = (InspectorInfo &)*message.GetData();
+  exception_type_ = info.exception_type;
+  exception_code_ = info.exception_code;
+  exception_subcode_ = info.exception_subcode;
+  parameter_count_ = info.parameter_count;
+
+#if VERBOSE
+  printf("message ID = %d\n", message.GetMessageID());
+#endif
+
+  remote_task_ = message.GetTranslatedPort(0);
+  crashing_thread_ = message.GetTranslatedPort(1);
+  handler_thread_ = message.GetTranslatedPort(2);
+  ack_port_ = message.GetTranslatedPort(3);
+
+#if VERBOSE
+  printf("exception_type = %d\n", exception_type_);
+  printf("exception_code = %d\n", exception_code_);
+  printf("exception_subcode = %d\n", exception_subcode_);
+  printf("remote_task = %d\n", remote_task_);
+  printf("crashing_thread = %d\n", crashing_thread_);
+  printf("handler_thread = %d\n", handler_thread_);
+  printf("ack_port_ = %d\n", ack_port_);
+  printf("parameter count = %d\n", info.parameter_count);
+#endif
+}
+
+//=============================================================================
+bool Inspector::ReadKeyValue(MachReceiveMessage &message) {
+  KeyValueMessageData &key_value_data =
+    (KeyValueMessageData&)*message.GetData();
+  // If we get a blank key, make sure we don't increment the
+  // parameter count; in some cases (notably on-demand generation
+  // many times in a short period of time) caused the Mach IPC
+  // messages to not come through correctly.
+  if (strlen(key_value_data.key) == 0) {
+    return false;
+  }
+
+  config_params_.SetKeyValue(key_value_data.key, key_value_data.value);
+  return true;
+}
+
 //=============================================================================
 bool Inspector::InspectTask() {
   // keep the task quiet while we're looking at it
@@ -320,7 +362,7 @@ bool Inspector::InspectTask() {
                           minidumpLocation.GetID());
 
 
-  MinidumpGenerator generator(remote_task_, handler_thread_);
+  MinidumpGenerator generator(remote_task_, handler_thread_, image_cache_);
 
   if (exception_type_ && exception_code_) {
     generator.SetExceptionInformation(exception_type_,
@@ -358,5 +400,183 @@ kern_return_t Inspector::SendAcknowledgement() {
   return KERN_INVALID_NAME;
 }
 
-} // namespace google_breakpad
+//=============================================================================
+void Inspector::ReleasePorts() {
+  mach_port_t ports[] = {
+    remote_task_, crashing_thread_, handler_thread_, ack_port_
+  };
+  for (size_t i = 0; i < sizeof(ports) / sizeof(ports[0]); ++i) {
+    if (MACH_PORT_VALID(ports[i]))
+      mach_port_deallocate(mach_task_self(), ports[i]);
+  }
+  remote_task_ = crashing_thread_ = handler_thread_ = ack_port_ =
+      MACH_PORT_NULL;
+}
+
+#pragma mark -
+
+//=============================================================================
+InspectorServer::InspectorServer()
+    : service_rcv_port_(MACH_PORT_NULL),
+      port_set_(MACH_PORT_NULL) {
+}
 
+InspectorServer::~InspectorServer() {
+  while (!sessions_.empty())
+    EndSession(sessions_.begin(), false);
+  if (port_set_ != MACH_PORT_NULL)
+    mach_port_destroy(mach_task_self(), port_set_);
+}
+
+//=============================================================================
+void InspectorServer::Serve(const char *service_name) {
+  mach_port_t self_task = mach_task_self();
+
+  kern_return_t kr = bootstrap_check_in(bootstrap_port,
+                                        (char*)service_name,
+                                        &service_rcv_port_);
+  if (kr != KERN_SUCCESS) {
+    PRINT_MACH_RESULT(kr, "InspectorServer: bootstrap_check_in()");
+    return;
+  }
+
+  kr = mach_port_allocate(self_task, MACH_PORT_RIGHT_PORT_SET, &port_set_);
+  if (kr == KERN_SUCCESS)
+    kr = mach_port_move_member(self_task, service_rcv_port_, port_set_);
+  if (kr != KERN_SUCCESS) {
+    PRINT_MACH_RESULT(kr, "InspectorServer: port set");
+    return;
+  }
+
+  // Read the system information up front, rather than racing to do it
+  // from the first inspector threads.
+  MinidumpGenerator::GatherSystemInformation();
+
+  // Receiving on the port set receives on all of its ports.  The port set
+  // is destroyed by our destructor; ReceivePort's mach_port_deallocate
+  // doesn't apply to port sets and leaves it alone.
+  ReceivePort receive_port(port_set_);
+
+  while (true) {
+    MachReceiveMessage message;
+    kr = receive_port.WaitForMessage(&message, kMessageTimeoutMs);
+
+    if (kr == KERN_SUCCESS) {
+      if (message.GetLocalPort() == service_rcv_port_)
+        StartSession(message);
+      else
+        ReadSessionMessage(message);
+    } else if (kr != MACH_RCV_TIMED_OUT) {
+      PRINT_MACH_RESULT(kr, "InspectorServer: WaitForMessage()");
+      return;
+    }
+
+    ExpireSessions();
+  }
+}
+
+//=============================================================================
+void InspectorServer::StartSession(MachReceiveMessage &message) {
+  if (message.GetMessageID() != kMsgType_InspectorSessionRequest ||
+      message.GetDescriptorCount() != 1) {
+    return;
+  }
+
+  mach_port_t session_port = message.GetTranslatedPort(0);
+  kern_return_t kr = mach_port_move_member(mach_task_self(),
+                                           session_port,
+                                           port_set_);
+  if (kr != KERN_SUCCESS) {
+    PRINT_MACH_RESULT(kr, "InspectorServer: mach_port_move_member()");
+    mach_port_mod_refs(mach_task_self(), session_port,
+                       MACH_PORT_RIGHT_RECEIVE, -1);
+    return;
+  }
+
+  sessions_[session_port] = new Session(&image_cache_);
+}
+
+//=============================================================================
+void InspectorServer::ReadSessionMessage(MachReceiveMessage &message) {
+  SessionMap::iterator it = sessions_.find(message.GetLocalPort());
+  if (it == sessions_.end())
+    return;
+  Session *session = it->second;
+
+  if (!session->initial_info_read) {
+    if (message.GetMessageID() != kMsgType_InspectorInitialInfo ||
+        message.GetDescriptorCount() != 4) {
+      EndSession(it, false);
+      return;
+    }
+    session->inspector.ReadInitialInfo(message);
+    session->initial_info_read = true;
+  } else {
+    // As in Inspector::ReadMessages, a blank key counts as a message but
+    // not as a parameter, and fails the session.
+    session->messages_read++;
+    if (session->inspector.ReadKeyValue(message))
+      session->parameters_read++;
+  }
+
+  unsigned int parameter_count = session->inspector.parameter_count_;
+  if (session->messages_read == parameter_count)
+    EndSession(it, session->parameters_read == parameter_count);
+}
+
+//=============================================================================
+void InspectorServer::EndSession(SessionMap::iterator session, bool inspect) {
+  // Destroying the receive right also takes the port out of the port set.
+  mach_port_mod_refs(mach_task_self(), session->first,
+                     MACH_PORT_RIGHT_RECEIVE, -1);
+
+  // The inspection thread owns the session from here on.
+  bool started = false;
+  if (inspect) {
+    pthread_t thread;
+    pthread_attr_t attributes;
+    pthread_attr_init(&attributes);
+    pthread_attr_setdetachstate(&attributes, PTHREAD_CREATE_DETACHED);
+    started = pthread_create(&thread, &attributes, InspectorThread,
+                             session->second) == 0;
+    pthread_attr_destroy(&attributes);
+    if (!started)
+      fprintf(stderr, "InspectorServer: failed to start inspection\n");
+  }
+
+  if (!started) {
+    session->second->inspector.ReleasePorts();
+    delete session->second;
+  }
+  sessions_.erase(session);
+}
+
+//=============================================================================
+void InspectorServer::ExpireSessions() {
+  // A crashed process gives up on us after a few seconds anyway.
+  const time_t kSessionTimeoutSeconds = 10;
+  time_t now = time(NULL);
+
+  SessionMap::iterator it = sessions_.begin();
+  while (it != sessions_.end()) {
+    SessionMap::iterator session = it++;
+    if (now - session->second->start_time > kSessionTimeoutSeconds)
+      EndSession(session, false);
+  }
+}
+
+//=============================================================================
+// static
+void *InspectorServer::InspectorThread(void *session_pointer) {
+  NSAutoreleasePool *pool = [[NSAutoreleasePool alloc] init];
+
+  Session *session = static_cast<Session*>(session_pointer);
+  session->inspector.InspectAndReport();
+  session->inspector.ReleasePorts();
+  delete session;
+
+  [pool release];
+  return NULL;
+}
+
+} // namespace google_breakpad
@@ -31,6 +31,7 @@
 
 #import "client/mac/crash_generation/Inspector.h"
 #import <Cocoa/Cocoa.h>
+#include <string.h>
 
 namespace google_breakpad {
 
@@ -47,6 +48,14 @@ int main(int argc, char *const argv[]) {
 
   NSAutoreleasePool *pool = [[NSAutoreleasePool alloc] init];
 
+  if (argc == 3 && strcmp(argv[1], "--server") == 0) {
+    // Serve crashed processes until something goes wrong.
+    google_breakpad::InspectorServer server;
+    server.Serve(argv[2]);
+    [pool release];
+    return 1;
+  }
+
   if (argc != 2) {
     exit(0);
   }
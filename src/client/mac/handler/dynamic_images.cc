@@ -38,7 +38,9 @@ extern "C" { // needed to compile on Leopard
 #include <assert.h>
 #include <AvailabilityMacros.h>
 #include <dlfcn.h>
+#include <mach/shared_region.h>
 #include <mach/task_info.h>
+#include <string.h>
 #include <sys/sysctl.h>
 #include <TargetConditionals.h>
 #include <unistd.h>
@@ -47,8 +49,6 @@ extern "C" { // needed to compile on Leopard
 #include <string>
 #include <vector>
 
-#include "breakpad_nlist_64.h"
-
 #if !TARGET_OS_IPHONE
 #include <CoreServices/CoreServices.h>
 
@@ -56,6 +56,14 @@ extern "C" { // needed to compile on Leopard
 #define MAC_OS_X_VERSION_10_6 1060
 #endif
 
+// Systems older than Mac OS X 10.6 have no TASK_DYLD_INFO, and the address
+// of _dyld_all_image_infos has to be looked up in the symbol table of dyld
+// on disk instead.  Builds that can't run on them leave that out.
+#if MAC_OS_X_VERSION_MIN_REQUIRED < MAC_OS_X_VERSION_10_6
+#define BREAKPAD_DYLD_NLIST_FALLBACK 1
+#include "breakpad_nlist_64.h"
+#endif
+
 #if MAC_OS_X_VERSION_MAX_ALLOWED < MAC_OS_X_VERSION_10_6
 
 // Fallback declarations for TASK_DYLD_INFO and friends, introduced in
@@ -148,33 +156,84 @@ static mach_vm_size_t GetMemoryRegionSize(task_port_t target_task,
 
 #define kMaxStringLength 8192
 //==============================================================================
-// Reads a NULL-terminated string from another task.
+// Reads NULL-terminated strings from another task through a window of its
+// memory, so that strings stored close together cost a single read.  The
+// paths of images in the dyld shared cache are laid out together in the
+// cache, so most of them are served from the same window.
 //
 // Warning!  This will not read any strings longer than kMaxStringLength-1
 //
-static string ReadTaskString(task_port_t target_task,
-                             const uint64_t address) {
-  // The problem is we don't know how much to read until we know how long
-  // the string is. And we don't know how long the string is, until we've read
-  // the memory!  So, we'll try to read kMaxStringLength bytes
-  // (or as many bytes as we can until we reach the end of the vm region).
-  mach_vm_size_t size_to_end;
-  GetMemoryRegionSize(target_task, address, &size_to_end);
-
-  if (size_to_end > 0) {
-    mach_vm_size_t size_to_read =
-      size_to_end > kMaxStringLength ? kMaxStringLength : size_to_end;
-
-    vector<uint8_t> bytes;
-    if (ReadTaskMemory(target_task, address, (size_t)size_to_read, bytes) !=
+class TaskStringReader {
+ public:
+  explicit TaskStringReader(task_port_t target_task)
+      : target_task_(target_task),
+        window_(kWindowSize),
+        window_address_(0),
+        window_length_(0) {
+  }
+
+  string Read(const uint64_t address) {
+    string result;
+    if (FindInWindow(address, &result))
+      return result;
+
+    // The problem is we don't know how much to read until we know how long
+    // the string is. And we don't know how long the string is, until we've
+    // read the memory!  So, we'll try to read a whole window (or as many
+    // bytes as we can until we reach the end of the vm region).
+    mach_vm_size_t size_to_end;
+    GetMemoryRegionSize(target_task_, address, &size_to_end);
+    if (size_to_end == 0)
+      return string();
+
+    size_t size_to_read =
+        size_to_end > window_.size() ? window_.size() : (size_t)size_to_end;
+    window_length_ = 0;
+    if (ReadTaskMemory(target_task_, address, size_to_read, &window_[0]) !=
         KERN_SUCCESS)
       return string();
+    window_address_ = address;
+    window_length_ = size_to_read;
 
-    return string(reinterpret_cast<const char*>(&bytes[0]));
+    FindInWindow(address, &result);
+    return result;
   }
 
-  return string();
-}
+ private:
+  static const size_t kWindowSize = 64 * 1024;
+
+  // Sets |result| to the string at |address| and returns true if the string
+  // starts in the window and ends in the window or within kMaxStringLength.
+  bool FindInWindow(const uint64_t address, string *result) {
+    if (address < window_address_ ||
+        address >= window_address_ + window_length_)
+      return false;
+
+    const char *start =
+        reinterpret_cast<const char*>(&window_[address - window_address_]);
+    size_t available = window_address_ + window_length_ - address;
+    if (available > kMaxStringLength - 1)
+      available = kMaxStringLength - 1;
+    const char *end = static_cast<const char*>(memchr(start, 0, available));
+    if (!end) {
+      // A string that runs to the end of the window may continue past it,
+      // unless the window already ended where the readable memory does or
+      // the string has reached its maximum length.
+      if (address != window_address_ &&
+          available < kMaxStringLength - 1)
+        return false;
+      end = start + available;
+    }
+
+    result->assign(start, end - start);
+    return true;
+  }
+
+  task_port_t target_task_;
+  vector<uint8_t> window_;
+  uint64_t window_address_;
+  size_t window_length_;
+};
 
 //==============================================================================
 // Reads an address range from another task. The bytes read will be returned
@@ -212,6 +271,76 @@ kern_return_t ReadTaskMemory(task_port_t target_task,
   return KERN_SUCCESS;
 }
 
+kern_return_t ReadTaskMemory(task_port_t target_task,
+                             const uint64_t address,
+                             size_t length,
+                             void *buffer) {
+  mach_vm_size_t bytes_read = 0;
+  kern_return_t r =
+      mach_vm_read_overwrite(target_task,
+                             address,
+                             length,
+                             reinterpret_cast<mach_vm_address_t>(buffer),
+                             &bytes_read);
+  if (r == KERN_SUCCESS && bytes_read != length)
+    return KERN_FAILURE;
+  return r;
+}
+
+//==============================================================================
+kern_return_t TaskMemoryMapping::Map(task_port_t target_task,
+                                     const uint64_t address,
+                                     size_t length) {
+  Unmap();
+
+  int systemPageSize = getpagesize();
+  mach_vm_address_t page_address = address & (-systemPageSize);
+  mach_vm_address_t last_page_address =
+      (address + length + (systemPageSize - 1)) & (-systemPageSize);
+  mach_vm_size_t page_size = last_page_address - page_address;
+
+  mach_vm_address_t local_address = 0;
+  vm_prot_t current_protection;
+  vm_prot_t max_protection;
+  kern_return_t r = mach_vm_remap(mach_task_self(),
+                                  &local_address,
+                                  page_size,
+                                  0,  // mask
+                                  VM_FLAGS_ANYWHERE,
+                                  target_task,
+                                  page_address,
+                                  false,  // share the pages, don't copy
+                                  &current_protection,
+                                  &max_protection,
+                                  VM_INHERIT_NONE);
+  if (r != KERN_SUCCESS)
+    return r;
+
+  if (!(current_protection & VM_PROT_READ)) {
+    mach_vm_deallocate(mach_task_self(), local_address, page_size);
+    return KERN_PROTECTION_FAILURE;
+  }
+
+  // The pages are shared with the other task, so make sure nothing in this
+  // one can write to them.
+  mach_vm_protect(mach_task_self(), local_address, page_size, false,
+                  VM_PROT_READ);
+
+  mapped_address_ = local_address;
+  mapped_size_ = page_size;
+  data_ = reinterpret_cast<const uint8_t*>(local_address) +
+          (address - page_address);
+  return KERN_SUCCESS;
+}
+
+void TaskMemoryMapping::Unmap() {
+  if (mapped_size_)
+    mach_vm_deallocate(mach_task_self(), mapped_address_, mapped_size_);
+  mapped_address_ = 0;
+  mapped_size_ = 0;
+  data_ = NULL;
+}
+
 #pragma mark -
 
 //==============================================================================
@@ -333,15 +462,109 @@ uint32_t DynamicImage::GetFileType() {
 
 #pragma mark -
 
+//==============================================================================
+DynamicImageCache::DynamicImageCache() {
+  pthread_mutex_init(&mutex_, NULL);
+}
+
+DynamicImageCache::~DynamicImageCache() {
+  pthread_mutex_destroy(&mutex_);
+}
+
+bool DynamicImageCache::Key::operator<(const Key &other) const {
+  if (load_address != other.load_address)
+    return load_address < other.load_address;
+  if (cpu_type != other.cpu_type)
+    return cpu_type < other.cpu_type;
+  if (file_path_address != other.file_path_address)
+    return file_path_address < other.file_path_address;
+  return file_mod_date < other.file_mod_date;
+}
+
+const DynamicImageCache::Entry *DynamicImageCache::Lookup(
+    cpu_type_t cpu_type,
+    uint64_t load_address,
+    uint64_t file_path_address,
+    uint64_t file_mod_date) {
+  Key key = { cpu_type, load_address, file_path_address, file_mod_date };
+  pthread_mutex_lock(&mutex_);
+  std::map<Key, Entry>::const_iterator it = entries_.find(key);
+  const Entry *entry = it == entries_.end() ? NULL : &it->second;
+  pthread_mutex_unlock(&mutex_);
+  return entry;
+}
+
+void DynamicImageCache::Insert(cpu_type_t cpu_type,
+                               uint64_t load_address,
+                               uint64_t file_path_address,
+                               uint64_t file_mod_date,
+                               const uint8_t *header,
+                               size_t header_size,
+                               const string &file_path) {
+  Key key = { cpu_type, load_address, file_path_address, file_mod_date };
+  pthread_mutex_lock(&mutex_);
+  // Another thread may have added the same image meanwhile; its entry is
+  // just as good, and may be in use, so leave it alone.
+  if (entries_.find(key) == entries_.end()) {
+    Entry &entry = entries_[key];
+    entry.header.assign(header, header + header_size);
+    entry.file_path = file_path;
+  }
+  pthread_mutex_unlock(&mutex_);
+}
+
+// static
+bool DynamicImageCache::IsInSharedRegion(cpu_type_t cpu_type,
+                                         uint64_t address) {
+  uint64_t base, size;
+  switch (cpu_type) {
+    case CPU_TYPE_I386:
+      base = SHARED_REGION_BASE_I386;
+      size = SHARED_REGION_SIZE_I386;
+      break;
+    case CPU_TYPE_X86_64:
+      base = SHARED_REGION_BASE_X86_64;
+      size = SHARED_REGION_SIZE_X86_64;
+      break;
+#ifdef SHARED_REGION_BASE_ARM
+    case CPU_TYPE_ARM:
+      base = SHARED_REGION_BASE_ARM;
+      size = SHARED_REGION_SIZE_ARM;
+      break;
+#endif
+#ifdef SHARED_REGION_BASE_ARM64
+    case CPU_TYPE_ARM64:
+      base = SHARED_REGION_BASE_ARM64;
+      size = SHARED_REGION_SIZE_ARM64;
+      break;
+#endif
+    default:
+      return false;
+  }
+  return address >= base && address - base < size;
+}
+
+#pragma mark -
+
 //==============================================================================
 // Loads information about dynamically loaded code in the given task.
 DynamicImages::DynamicImages(mach_port_t task)
     : task_(task),
       cpu_type_(DetermineTaskCPUType(task)),
+      image_cache_(NULL),
+      image_list_() {
+  ReadImageInfoForTask();
+}
+
+DynamicImages::DynamicImages(mach_port_t task, DynamicImageCache *image_cache)
+    : task_(task),
+      cpu_type_(DetermineTaskCPUType(task)),
+      image_cache_(image_cache),
       image_list_() {
   ReadImageInfoForTask();
 }
 
+#if defined(BREAKPAD_DYLD_NLIST_FALLBACK)
 template<typename MachBits>
 static uint64_t LookupSymbol(const char* symbol_name,
                              const char* filename,
@@ -364,11 +587,6 @@ static uint64_t LookupSymbol(const char* symbol_name,
   return list.n_value;
 }
 
-#if TARGET_OS_IPHONE
-static bool HasTaskDyldInfo() {
-  return true;
-}
-#else
 static SInt32 GetOSVersionInternal() {
   SInt32 os_version = 0;
   Gestalt(gestaltSystemVersion, &os_version);
@@ -379,27 +597,11 @@ static SInt32 GetOSVersion() {
   static SInt32 os_version = GetOSVersionInternal();
   return os_version;
 }
-
-static bool HasTaskDyldInfo() {
-#if MAC_OS_X_VERSION_MIN_REQUIRED >= MAC_OS_X_VERSION_10_6
-  return true;
-#else
-  return GetOSVersion() >= 0x1060;
-#endif
-}
-#endif  // TARGET_OS_IPHONE
+#endif  // BREAKPAD_DYLD_NLIST_FALLBACK
 
 uint64_t DynamicImages::GetDyldAllImageInfosPointer() {
-  if (HasTaskDyldInfo()) {
-    task_dyld_info_data_t task_dyld_info;
-    mach_msg_type_number_t count = TASK_DYLD_INFO_COUNT;
-    if (task_info(task_, TASK_DYLD_INFO, (task_info_t)&task_dyld_info,
-                  &count) != KERN_SUCCESS) {
-      return 0;
-    }
-
-    return (uint64_t)task_dyld_info.all_image_info_addr;
-  } else {
+#if defined(BREAKPAD_DYLD_NLIST_FALLBACK)
+  if (GetOSVersion() < 0x1060) {
     const char *imageSymbolName = "_dyld_all_image_infos";
     const char *dyldPath = "/usr/lib/dyld";
 
@@ -407,6 +609,16 @@ uint64_t DynamicImages::GetDyldAllImageInfosPointer() {
       return LookupSymbol<MachO64>(imageSymbolName, dyldPath, cpu_type_);
     return LookupSymbol<MachO32>(imageSymbolName, dyldPath, cpu_type_);
   }
+#endif
+
+  task_dyld_info_data_t task_dyld_info;
+  mach_msg_type_number_t count = TASK_DYLD_INFO_COUNT;
+  if (task_info(task_, TASK_DYLD_INFO, (task_info_t)&task_dyld_info,
+                &count) != KERN_SUCCESS) {
+    return 0;
+  }
+
+  return (uint64_t)task_dyld_info.all_image_info_addr;
 }
 
 //==============================================================================
@@ -425,93 +637,145 @@ void ReadImageInfo(DynamicImages& images,
   // Here we make the assumption that dyld loaded at the same address in
   // the crashed process vs. this one.  This is an assumption made in
   // "dyld_debug.c" and is said to be nearly always valid.
-  vector<uint8_t> dyld_all_info_bytes;
+  dyld_all_image_infos dyldInfo;
   if (ReadTaskMemory(images.task_,
                      image_list_address,
-                     sizeof(dyld_all_image_infos),
-                     dyld_all_info_bytes) != KERN_SUCCESS)
+                     sizeof(dyldInfo),
+                     &dyldInfo) != KERN_SUCCESS)
     return;
 
-  dyld_all_image_infos *dyldInfo =
-    reinterpret_cast<dyld_all_image_infos*>(&dyld_all_info_bytes[0]);
-
   // number of loaded images
-  int count = dyldInfo->infoArrayCount;
+  int count = dyldInfo.infoArrayCount;
+  if (count <= 0)
+    return;
 
   // Read an array of dyld_image_info structures each containing
   // information about a loaded image.
-  vector<uint8_t> dyld_info_array_bytes;
-    if (ReadTaskMemory(images.task_,
-                       dyldInfo->infoArray,
-                       count * sizeof(dyld_image_info),
-                       dyld_info_array_bytes) != KERN_SUCCESS)
-      return;
-
-    dyld_image_info *infoArray =
-        reinterpret_cast<dyld_image_info*>(&dyld_info_array_bytes[0]);
-    images.image_list_.reserve(count);
-
-    for (int i = 0; i < count; ++i) {
-      dyld_image_info &info = infoArray[i];
+  vector<dyld_image_info> infoArray(count);
+  if (ReadTaskMemory(images.task_,
+                     dyldInfo.infoArray,
+                     count * sizeof(dyld_image_info),
+                     &infoArray[0]) != KERN_SUCCESS)
+    return;
 
-      // First read just the mach_header from the image in the task.
-      vector<uint8_t> mach_header_bytes;
-      if (ReadTaskMemory(images.task_,
+  images.image_list_.reserve(count);
+
+  // Every image's header is read into this one buffer.  The first read
+  // goes up to the next kHeaderReadSize boundary, which covers the header
+  // and load commands of almost every image without a second read and,
+  // since images are page aligned, never reaches an unmapped page.
+  const size_t kHeaderReadSize = 4096;
+  vector<uint8_t> mach_header_bytes(kHeaderReadSize);
+  TaskStringReader string_reader(images.task_);
+
+  // processDetachedFromSharedRegion is only there from version 2 on.
+  DynamicImageCache *image_cache = images.image_cache_;
+  if (dyldInfo.version < 2 || dyldInfo.processDetachedFromSharedRegion)
+    image_cache = NULL;
+
+  for (int i = 0; i < count; ++i) {
+    dyld_image_info &info = infoArray[i];
+
+    bool cacheable = image_cache &&
+        DynamicImageCache::IsInSharedRegion(images.cpu_type_,
+                                            info.load_address_);
+    if (cacheable) {
+      const DynamicImageCache::Entry *entry =
+          image_cache->Lookup(images.cpu_type_, info.load_address_,
+                              info.file_path_, info.file_mod_date_);
+      // Check the mach_header itself, which is a small read, in case the
+      // task has something other than the shared cache at this address.
+      mach_header_type header;
+      if (entry &&
+          ReadTaskMemory(images.task_,
                          info.load_address_,
-                         sizeof(mach_header_type),
-                         mach_header_bytes) != KERN_SUCCESS)
-        continue;  // bail on this dynamic image
-
-      mach_header_type *header =
-          reinterpret_cast<mach_header_type*>(&mach_header_bytes[0]);
-
-      // Now determine the total amount necessary to read the header
-      // plus all of the load commands.
-      size_t header_size =
-          sizeof(mach_header_type) + header->sizeofcmds;
+                         sizeof(header),
+                         &header) == KERN_SUCCESS &&
+          entry->header.size() >= sizeof(header) &&
+          memcmp(&entry->header[0], &header, sizeof(header)) == 0) {
+        DynamicImage *new_image =
+            new DynamicImage(const_cast<uint8_t*>(&entry->header[0]),
+                             entry->header.size(),
+                             info.load_address_,
+                             entry->file_path,
+                             static_cast<uintptr_t>(info.file_mod_date_),
+                             images.task_,
+                             images.cpu_type_);
+        if (new_image->IsValid()) {
+          images.image_list_.push_back(DynamicImageRef(new_image));
+        } else {
+          delete new_image;
+        }
+        continue;
+      }
+    }
 
+    size_t bytes_read =
+        kHeaderReadSize - (info.load_address_ % kHeaderReadSize);
+    if (bytes_read < sizeof(mach_header_type))
+      bytes_read = sizeof(mach_header_type);
+    if (ReadTaskMemory(images.task_,
+                       info.load_address_,
+                       bytes_read,
+                       &mach_header_bytes[0]) != KERN_SUCCESS)
+      continue;  // bail on this dynamic image
+
+    mach_header_type *header =
+        reinterpret_cast<mach_header_type*>(&mach_header_bytes[0]);
+
+    // Now determine the total amount necessary to read the header
+    // plus all of the load commands, and read whatever is left of it.
+    size_t header_size =
+        sizeof(mach_header_type) + header->sizeofcmds;
+
+    if (header_size > bytes_read) {
+      if (mach_header_bytes.size() < header_size)
+        mach_header_bytes.resize(header_size);
       if (ReadTaskMemory(images.task_,
-                         info.load_address_,
-                         header_size,
-                         mach_header_bytes) != KERN_SUCCESS)
+                         info.load_address_ + bytes_read,
+                         header_size - bytes_read,
+                         &mach_header_bytes[bytes_read]) != KERN_SUCCESS)
         continue;
+    }
 
-      // Read the file name from the task's memory space.
-      string file_path;
-      if (info.file_path_) {
-        // Although we're reading kMaxStringLength bytes, it's copied in the
-        // the DynamicImage constructor below with the correct string length,
-        // so it's not really wasting memory.
-        file_path = ReadTaskString(images.task_, info.file_path_);
-      }
+    // Read the file name from the task's memory space.
+    string file_path;
+    if (info.file_path_) {
+      file_path = string_reader.Read(info.file_path_);
+    }
 
-      // Create an object representing this image and add it to our list.
-      DynamicImage *new_image;
-      new_image = new DynamicImage(&mach_header_bytes[0],
-                                   header_size,
-                                   info.load_address_,
-                                   file_path,
-                                   static_cast<uintptr_t>(info.file_mod_date_),
-                                   images.task_,
-                                   images.cpu_type_);
-
-      if (new_image->IsValid()) {
-        images.image_list_.push_back(DynamicImageRef(new_image));
-      } else {
-        delete new_image;
+    // Create an object representing this image and add it to our list.
+    DynamicImage *new_image;
+    new_image = new DynamicImage(&mach_header_bytes[0],
+                                 header_size,
+                                 info.load_address_,
+                                 file_path,
+                                 static_cast<uintptr_t>(info.file_mod_date_),
+                                 images.task_,
+                                 images.cpu_type_);
+
+    if (new_image->IsValid()) {
+      images.image_list_.push_back(DynamicImageRef(new_image));
+      if (cacheable) {
+        image_cache->Insert(images.cpu_type_, info.load_address_,
+                            info.file_path_, info.file_mod_date_,
+                            &mach_header_bytes[0], header_size, file_path);
       }
+    } else {
+      delete new_image;
     }
+  }
 
-    // sorts based on loading address
-    sort(images.image_list_.begin(), images.image_list_.end());
-    // remove duplicates - this happens in certain strange cases
-    // You can see it in DashboardClient when Google Gadgets plugin
-    // is installed.  Apple's crash reporter log and gdb "info shared"
-    // both show the same library multiple times at the same address
+  // sorts based on loading address
+  sort(images.image_list_.begin(), images.image_list_.end());
+  // remove duplicates - this happens in certain strange cases
+  // You can see it in DashboardClient when Google Gadgets plugin
+  // is installed.  Apple's crash reporter log and gdb "info shared"
+  // both show the same library multiple times at the same address
 
-    vector<DynamicImageRef>::iterator it = unique(images.image_list_.begin(),
-                                                  images.image_list_.end());
-    images.image_list_.erase(it, images.image_list_.end());
+  vector<DynamicImageRef>::iterator it = unique(images.image_list_.begin(),
+                                                images.image_list_.end());
+  images.image_list_.erase(it, images.image_list_.end());
 }
 
 void DynamicImages::ReadImageInfoForTask() {
@@ -40,8 +40,10 @@
 #include <mach/mach.h>
 #include <mach-o/dyld.h>
 #include <mach-o/loader.h>
+#include <pthread.h>
 #include <sys/types.h>
 
+#include <map>
 #include <string>
 #include <vector>
 
@@ -227,6 +229,64 @@ class DynamicImageRef {
   DynamicImage  *p;
 };
 
+//==============================================================================
+// Headers and paths of images in the dyld shared cache, kept across
+// DynamicImages objects.  Every task attached to the shared region maps the
+// same shared cache at the same address, so a process that inspects many
+// tasks, like the Inspector in server mode, only needs to read each of
+// these images from the first task it looks at.  Images outside the shared
+// region, and every image of a task detached from it, are always read from
+// the task.
+//
+// A cache may be shared by DynamicImages objects on several threads.
+class DynamicImageCache {
+ public:
+  DynamicImageCache();
+  ~DynamicImageCache();
+
+  struct Entry {
+    vector<uint8_t> header;  // mach_header plus load commands
+    string file_path;
+  };
+
+  // Returns the entry for the image of |cpu_type| loaded at |load_address|
+  // with the given dyld_image_info path address and mod date, or NULL.
+  // Entries are never removed, so the result stays valid for the lifetime
+  // of the cache.
+  const Entry *Lookup(cpu_type_t cpu_type,
+                      uint64_t load_address,
+                      uint64_t file_path_address,
+                      uint64_t file_mod_date);
+
+  void Insert(cpu_type_t cpu_type,
+              uint64_t load_address,
+              uint64_t file_path_address,
+              uint64_t file_mod_date,
+              const uint8_t *header,
+              size_t header_size,
+              const string &file_path);
+
+  // Returns true if |address| is in the shared region of tasks of
+  // |cpu_type|, where the images in the cache live.
+  static bool IsInSharedRegion(cpu_type_t cpu_type, uint64_t address);
+
+ private:
+  DynamicImageCache(const DynamicImageCache &);
+  DynamicImageCache &operator=(const DynamicImageCache &);
+
+  struct Key {
+    cpu_type_t cpu_type;
+    uint64_t load_address;
+    uint64_t file_path_address;
+    uint64_t file_mod_date;
+
+    bool operator<(const Key &other) const;
+  };
+
+  pthread_mutex_t mutex_;
+  std::map<Key, Entry> entries_;
+};
+
 // Helper function to deal with 32-bit/64-bit Mach-O differences.
 class DynamicImages;
 template<typename MachBits>
@@ -240,6 +300,11 @@ class DynamicImages {
  public:
   explicit DynamicImages(mach_port_t task);
 
+  // Like the above, but takes the headers of images in the shared cache
+  // from |image_cache| when it has them, and adds those it doesn't have.
+  // |image_cache| may be NULL, and must outlive this object.
+  DynamicImages(mach_port_t task, DynamicImageCache *image_cache);
+
   ~DynamicImages() {
     for (int i = 0; i < GetImageCount(); ++i) {
       delete image_list_[i];
@@ -304,6 +369,7 @@ class DynamicImages {
 
   mach_port_t              task_;
   cpu_type_t               cpu_type_;  // CPU type of task_
+  DynamicImageCache        *image_cache_;
   vector<DynamicImageRef>  image_list_;
 };
 
@@ -314,6 +380,44 @@ kern_return_t ReadTaskMemory(task_port_t target_task,
                              size_t length,
                              vector<uint8_t> &bytes);
 
+// Copy |length| bytes of memory at a particular location in another
+// task into |buffer|, which must have room for them.  Unlike the form
+// above, this does not map pages into the calling task, which makes it
+// cheaper for small reads.
+kern_return_t ReadTaskMemory(task_port_t target_task,
+                             const uint64_t address,
+                             size_t length,
+                             void *buffer);
+
+// Maps a range of memory in another task into this one, read-only, for
+// as long as the object lives or until Unmap is called.  The pages are
+// shared with the other task rather than copied, so large ranges such as
+// thread stacks can be written out straight from the mapping.  The other
+// task should be suspended while the mapping is in use.
+class TaskMemoryMapping {
+ public:
+  TaskMemoryMapping() : mapped_address_(0), mapped_size_(0), data_(NULL) {}
+  ~TaskMemoryMapping() { Unmap(); }
+
+  // Maps |length| bytes at |address| in |target_task|, replacing any
+  // earlier mapping.
+  kern_return_t Map(task_port_t target_task,
+                    const uint64_t address,
+                    size_t length);
+  void Unmap();
+
+  // The mapped bytes, or NULL if nothing is mapped.
+  const void *data() const { return data_; }
+
+ private:
+  TaskMemoryMapping(const TaskMemoryMapping &);
+  TaskMemoryMapping &operator=(const TaskMemoryMapping &);
+
+  mach_vm_address_t mapped_address_;  // page-aligned start of the mapping
+  mach_vm_size_t mapped_size_;
+  const uint8_t *data_;
+};
+
 }   // namespace google_breakpad
 
 #endif // CLIENT_MAC_HANDLER_DYNAMIC_IMAGES_H__
@@ -38,8 +38,11 @@
 #include <mach/vm_map.h>
 #define mach_vm_address_t vm_address_t
 #define mach_vm_deallocate vm_deallocate
+#define mach_vm_protect vm_protect
 #define mach_vm_read vm_read
+#define mach_vm_read_overwrite vm_read_overwrite
 #define mach_vm_region_recurse vm_region_recurse_64
+#define mach_vm_remap vm_remap
 #define mach_vm_size_t vm_size_t
 #else
 #include <mach/mach_vm.h>
@@ -68,6 +68,25 @@ namespace google_breakpad {
 #define LC_SEGMENT_ARCH LC_SEGMENT
 #endif
 
+// Writes |length| bytes of |task|'s memory at |address| into |memory|,
+// which must already be allocated.  The pages are mapped into this
+// process read-only and written straight from the mapping, which saves
+// copying every stack into a buffer first.  If they cannot be mapped,
+// they are copied out instead.
+static bool WriteTaskMemory(task_port_t task,
+                            mach_vm_address_t address,
+                            size_t length,
+                            UntypedMDRVA *memory) {
+  TaskMemoryMapping mapping;
+  if (mapping.Map(task, address, length) == KERN_SUCCESS)
+    return memory->Copy(mapping.data(), length);
+
+  vector<uint8_t> bytes;
+  if (ReadTaskMemory(task, address, length, bytes) != KERN_SUCCESS)
+    return false;
+  return memory->Copy(&bytes[0], length);
+}
+
 // constructor when generating from within the crashed process
 MinidumpGenerator::MinidumpGenerator()
     : writer_(),
@@ -87,7 +106,8 @@ MinidumpGenerator::MinidumpGenerator()
 // constructor when generating from a different process than the
 // crashed process
 MinidumpGenerator::MinidumpGenerator(mach_port_t crashing_task,
-                                     mach_port_t handler_thread)
+                                     mach_port_t handler_thread,
+                                     DynamicImageCache *image_cache)
     : writer_(),
       exception_type_(0),
       exception_code_(0),
@@ -100,7 +120,7 @@ MinidumpGenerator::MinidumpGenerator(mach_port_t crashing_task,
       dynamic_images_(NULL),
       memory_blocks_(&allocator_) {
   if (crashing_task != mach_task_self()) {
-    dynamic_images_ = new DynamicImages(crashing_task_);
+    dynamic_images_ = new DynamicImages(crashing_task_, image_cache);
     cpu_type_ = dynamic_images_->GetCPUType();
   } else {
     dynamic_images_ = NULL;
@@ -342,15 +362,7 @@ bool MinidumpGenerator::WriteStackFromStartAddress(
       return false;
 
     if (dynamic_images_) {
-      vector<uint8_t> stack_memory;
-      if (ReadTaskMemory(crashing_task_,
-                         start_addr,
-                         size,
-                         stack_memory) != KERN_SUCCESS) {
-        return false;
-      }
-
-      result = memory.Copy(&stack_memory[0], size);
+      result = WriteTaskMemory(crashing_task_, start_addr, size, &memory);
     } else {
       result = memory.Copy(reinterpret_cast<const void *>(start_addr), size);
     }
@@ -1087,15 +1099,12 @@ bool MinidumpGenerator::WriteMemoryListStream(
 
     if (dynamic_images_) {
       // Out-of-process.
-      vector<uint8_t> memory;
-      if (ReadTaskMemory(crashing_task_,
-                         ip_memory_d.start_of_memory_range,
-                         ip_memory_d.memory.data_size,
-                         memory) != KERN_SUCCESS) {
+      if (!WriteTaskMemory(crashing_task_,
+                           ip_memory_d.start_of_memory_range,
+                           ip_memory_d.memory.data_size,
+                           &ip_memory)) {
         return false;
       }
-
-      ip_memory.Copy(&memory[0], ip_memory_d.memory.data_size);
     } else {
       // In-process, just copy from local memory.
       ip_memory.Copy(
@@ -83,7 +83,10 @@ using std::string;
 class MinidumpGenerator {
  public:
   MinidumpGenerator();
-  MinidumpGenerator(mach_port_t crashing_task, mach_port_t handler_thread);
+  // |image_cache|, if not NULL, is passed on to the DynamicImages of
+  // |crashing_task|.
+  MinidumpGenerator(mach_port_t crashing_task, mach_port_t handler_thread,
+                    DynamicImageCache *image_cache = NULL);
 
   virtual ~MinidumpGenerator();
 
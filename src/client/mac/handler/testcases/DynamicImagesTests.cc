@@ -41,6 +41,12 @@ DynamicImagesTests test2(TEST_INVOCATION(DynamicImagesTests,
                                          ReadTaskMemoryTest));
 DynamicImagesTests test3(TEST_INVOCATION(DynamicImagesTests,
                                          ReadLibrariesFromLocalTaskTest));
+DynamicImagesTests test4(TEST_INVOCATION(DynamicImagesTests,
+                                         ReadTaskMemoryIntoBufferTest));
+DynamicImagesTests test5(TEST_INVOCATION(DynamicImagesTests,
+                                         ReadImagePathsFromLocalTaskTest));
+DynamicImagesTests test6(TEST_INVOCATION(DynamicImagesTests,
+                                         TaskMemoryMappingTest));
 
 DynamicImagesTests::DynamicImagesTests(TestInvocation *invocation)
     : TestCase(invocation) {
@@ -68,6 +74,65 @@ void DynamicImagesTests::ReadTaskMemoryTest() {
   CPTAssert(0 == memcmp(&buf[0], (const void*)addr, getpagesize()));
 }
 
+void DynamicImagesTests::ReadTaskMemoryIntoBufferTest() {
+  kern_return_t kr;
+
+  // Read a range that neither starts nor ends on a page boundary.
+  const char *addr = reinterpret_cast<const char*>(&test2) + 1;
+  std::vector<uint8_t> buf(getpagesize() + 7);
+
+  kr = google_breakpad::ReadTaskMemory(mach_task_self(),
+                                       (uint64_t)addr,
+                                       buf.size(),
+                                       &buf[0]);
+
+  CPTAssert(kr == KERN_SUCCESS);
+
+  CPTAssert(0 == memcmp(&buf[0], addr, buf.size()));
+}
+
+void DynamicImagesTests::TaskMemoryMappingTest() {
+  kern_return_t kr;
+
+  // Map a range that straddles a page boundary.
+  std::vector<uint8_t> source(getpagesize() * 3);
+  for (size_t i = 0; i < source.size(); ++i)
+    source[i] = static_cast<uint8_t>(i * 7);
+  const uint8_t *addr = &source[getpagesize() - 16];
+  const size_t length = getpagesize();
+
+  google_breakpad::TaskMemoryMapping mapping;
+  kr = mapping.Map(mach_task_self(), (uint64_t)addr, length);
+
+  CPTAssert(kr == KERN_SUCCESS);
+  CPTAssert(mapping.data() != NULL);
+  CPTAssert(mapping.data() != addr);
+  CPTAssert(0 == memcmp(mapping.data(), addr, length));
+
+  mapping.Unmap();
+  CPTAssert(mapping.data() == NULL);
+}
+
+void DynamicImagesTests::ReadImagePathsFromLocalTaskTest() {
+  google_breakpad::DynamicImages images(mach_task_self());
+
+  // Every image dyld reports should be found, path included.
+  for (uint32_t i = 0; i < _dyld_image_count(); ++i) {
+    const char *name = _dyld_get_image_name(i);
+    uint64_t header = (uint64_t)_dyld_get_image_header(i);
+    bool found = false;
+    for (int j = 0; j < images.GetImageCount(); ++j) {
+      google_breakpad::DynamicImage *image = images.GetImage(j);
+      if (image->GetLoadAddress() == header) {
+        CPTAssert(image->GetFilePath() == name);
+        found = true;
+        break;
+      }
+    }
+    CPTAssert(found);
+  }
+}
+
 void DynamicImagesTests::ReadLibrariesFromLocalTaskTest() {
 
   mach_port_t me = mach_task_self();
@@ -46,7 +46,10 @@ class DynamicImagesTests : public TestCase {
   virtual ~DynamicImagesTests();
 
   void ReadTaskMemoryTest();
+  void ReadTaskMemoryIntoBufferTest();
+  void TaskMemoryMappingTest();
   void ReadLibrariesFromLocalTaskTest();
+  void ReadImagePathsFromLocalTaskTest();
 };
 
 #endif /* _CLIENT_MAC_HANDLER_TESTCASES_DYNAMICIMAGESTESTS_H__ */
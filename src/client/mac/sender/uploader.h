@@ -75,6 +75,11 @@ extern NSString *const kDefaultServerType;
 
 - (void)report;
 
+// Writes the request body that report would send to |path|, and returns the
+// request to upload it with, for a background NSURLSession upload.  Returns
+// nil if there is no minidump or the file can't be written.
+- (NSURLRequest *)reportRequestWithBodyWrittenToFile:(NSString *)path;
+
 // Upload the given data to the crash server.
 - (void)uploadData:(NSData *)data name:(NSString *)name;
 
@@ -575,6 +575,34 @@ NSDictionary *readConfigurationData(const char *configFile) {
   [upload release];
 }
 
+//=============================================================================
+- (NSURLRequest *)reportRequestWithBodyWrittenToFile:(NSString *)path {
+  if (!minidumpContents_)
+    return nil;
+
+  NSURL *url = [NSURL URLWithString:[parameters_ objectForKey:@BREAKPAD_URL]];
+  HTTPMultipartUpload *upload = [[HTTPMultipartUpload alloc] initWithURL:url];
+  NSMutableDictionary *uploadParameters = [NSMutableDictionary dictionary];
+
+  NSURLRequest *request = nil;
+  if ([self populateServerDictionary:uploadParameters]) {
+    [upload setParameters:uploadParameters];
+    [upload addFileContents:minidumpContents_ name:@"upload_file_minidump"];
+    if (logFileData_) {
+      [upload addFileContents:logFileData_ name:@"log"];
+    }
+
+    NSError *error = nil;
+    request = [upload requestWithBodyWrittenToFile:path error:&error];
+    if (!request) {
+      fprintf(stderr, "Breakpad Uploader: Error writing request file: %s\n",
+              [[error description] UTF8String]);
+    }
+  }
+  [upload release];
+  return request;
+}
+
 - (void)uploadData:(NSData *)data name:(NSString *)name {
   NSURL *url = [NSURL URLWithString:[parameters_ objectForKey:@BREAKPAD_URL]];
   NSMutableDictionary *uploadParameters = [NSMutableDictionary dictionary];
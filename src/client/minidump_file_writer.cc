@@ -31,6 +31,7 @@
 //
 // See minidump_file_writer.h for documentation.
 
+#include <errno.h>
 #include <fcntl.h>
 #include <limits.h>
 #include <stdio.h>
@@ -39,8 +40,11 @@
 
 #include "client/minidump_file_writer-inl.h"
 #include "common/linux/linux_libc_support.h"
+#include "common/minidump_compression.h"
 #include "common/string_conversion.h"
 #if defined(__linux__) && __linux__
+#include <sys/syscall.h>
+
 #include "third_party/lss/linux_syscall_support.h"
 #endif
 
@@ -52,12 +56,27 @@ MinidumpFileWriter::MinidumpFileWriter()
     : file_(-1),
       close_file_when_destroyed_(true),
       position_(0),
-      size_(0) {
+      size_(0),
+      buffers_allocated_(false),
+      buffer_use_count_(0),
+      copy_buffer_(NULL),
+      compressed_(false),
+      compressed_size_(0),
+      frame_buffer_(NULL),
+      hash_table_(NULL) {
+  for (int i = 0; i < kWriteBufferCount; ++i) {
+    buffers_[i].data = NULL;
+    buffers_[i].position = 0;
+    buffers_[i].used = 0;
+    buffers_[i].last_use = 0;
+  }
 }
 
 MinidumpFileWriter::~MinidumpFileWriter() {
   if (close_file_when_destroyed_)
     Close();
+  else if (file_ != -1)
+    Flush();
 }
 
 bool MinidumpFileWriter::Open(const char *path) {
@@ -81,9 +100,8 @@ bool MinidumpFileWriter::Close() {
   bool result = true;
 
   if (file_ != -1) {
-    if (-1 == ftruncate(file_, position_)) {
-       return false;
-    }
+    if (!Flush())
+      return false;
 #if defined(__linux__) && __linux__
     result = (sys_close(file_) == 0);
 #else
@@ -95,6 +113,21 @@ bool MinidumpFileWriter::Close() {
   return result;
 }
 
+bool MinidumpFileWriter::Flush() {
+  if (file_ == -1)
+    return false;
+  if (!FlushBuffers())
+    return false;
+  if (!compressed_)
+    return ftruncate(file_, position_) == 0;
+
+  // Record the size of the minidump, which may extend past the last data
+  // written, in a frame of its own.
+  if (!WriteFrame(position_, NULL, 0))
+    return false;
+  return ftruncate(file_, compressed_size_) == 0;
+}
+
 bool MinidumpFileWriter::CopyStringToMDString(const wchar_t *str,
                                               unsigned int length,
                                               TypedMDRVA<MDString> *mdstring) {
@@ -230,11 +263,8 @@ MDRVA MinidumpFileWriter::Allocate(size_t size) {
     if (growth < minimal_growth)
       growth = minimal_growth;
 
-    size_t new_size = size_ + growth;
-    if (ftruncate(file_, new_size) != 0)
-      return kInvalidMDRVA;
-
-    size_ = new_size;
+    // The file itself is only extended when it is flushed or closed.
+    size_ += growth;
   }
 
   MDRVA current_position = position_;
@@ -243,6 +273,73 @@ MDRVA MinidumpFileWriter::Allocate(size_t size) {
   return current_position;
 }
 
+bool MinidumpFileWriter::CopyFile(int fd, MDLocationDescriptor *location) {
+  assert(file_ != -1);
+
+  size_t total = 0;
+  if (!SendFile(fd, position_, &total)) {
+    if (!copy_buffer_) {
+      copy_buffer_ =
+          reinterpret_cast<uint8_t*>(allocator_.Alloc(kCopyBufferSize));
+      if (!copy_buffer_)
+        return false;
+    }
+    for (;;) {
+      ssize_t r;
+      do {
+#if defined(__linux__) && __linux__
+        r = sys_read(fd, copy_buffer_, kCopyBufferSize);
+#else
+        r = read(fd, copy_buffer_, kCopyBufferSize);
+#endif
+      } while (r == -1 && errno == EINTR);
+      if (r < 1)
+        break;
+      if (!WriteOut(position_ + static_cast<MDRVA>(total), copy_buffer_, r))
+        return false;
+      total += r;
+    }
+  }
+
+  location->data_size = static_cast<uint32_t>(total);
+  location->rva = position_;
+  if (total && Allocate(total) == kInvalidMDRVA)
+    return false;
+  return true;
+}
+
+bool MinidumpFileWriter::SendFile(int fd, MDRVA position, size_t *copied) {
+  *copied = 0;
+#if defined(__linux__) && __linux__ && defined(__NR_sendfile)
+  // Compressed minidumps are written as frames, which sendfile can't make.
+  if (compressed_)
+    return false;
+
+  // sendfile writes at the file offset of file_.
+  if (sys_lseek(file_, position, SEEK_SET) != static_cast<off_t>(position))
+    return false;
+
+  // Each call sends at most this many bytes.
+  static const size_t kSendSize = 1 << 20;
+  for (;;) {
+    long sent;
+    do {
+      sent = syscall(__NR_sendfile, file_, fd, NULL, kSendSize);
+    } while (sent < 0 && errno == EINTR);
+    if (sent < 0) {
+      // Per-process /proc files, for one, can't be sent.  If some of the
+      // file was sent, keep it; what was read can't be read again.
+      return *copied != 0;
+    }
+    if (sent == 0)
+      return true;
+    *copied += sent;
+  }
+#else
+  return false;
+#endif
+}
+
 bool MinidumpFileWriter::Copy(MDRVA position, const void *src, ssize_t size) {
   assert(src);
   assert(size);
@@ -252,13 +349,137 @@ bool MinidumpFileWriter::Copy(MDRVA position, const void *src, ssize_t size) {
   if (static_cast<size_t>(size + position) > size_)
     return false;
 
+  if (!buffers_allocated_) {
+    buffers_allocated_ = true;
+    for (int i = 0; i < kWriteBufferCount; ++i) {
+      buffers_[i].data =
+          reinterpret_cast<uint8_t*>(allocator_.Alloc(kWriteBufferSize));
+    }
+  }
+
+  const size_t length = static_cast<size_t>(size);
+  const size_t end = position + length;
+
+  // Look for a buffer that the data extends or overwrites, and flush any
+  // other buffer holding bytes in the same range, so that no stale copy of
+  // them is written out later.
+  WriteBuffer *target = NULL;
+  for (int i = 0; i < kWriteBufferCount; ++i) {
+    WriteBuffer *buffer = &buffers_[i];
+    if (!buffer->data)
+      continue;
+    const size_t buffer_end = buffer->position + buffer->used;
+    if (!target && buffer->used &&
+        position >= buffer->position && position <= buffer_end &&
+        end <= buffer->position + kWriteBufferSize) {
+      target = buffer;
+    } else if (buffer->used && position < buffer_end &&
+               end > buffer->position) {
+      if (!FlushBuffer(buffer))
+        return false;
+    }
+  }
+
+  // Otherwise start a new run in an empty or the least recently used
+  // buffer.  Data too large for a buffer goes straight to the file.
+  if (!target && length < kWriteBufferSize) {
+    for (int i = 0; i < kWriteBufferCount; ++i) {
+      WriteBuffer *buffer = &buffers_[i];
+      if (!buffer->data)
+        continue;
+      if (!target ||
+          (target->used &&
+           (!buffer->used || buffer->last_use < target->last_use))) {
+        target = buffer;
+      }
+    }
+    if (target) {
+      if (!FlushBuffer(target))
+        return false;
+      target->position = position;
+    }
+  }
+
+  if (!target)
+    return WriteOut(position, src, length);
+
+  my_memcpy(target->data + (position - target->position), src, length);
+  if (end - target->position > target->used)
+    target->used = end - target->position;
+  target->last_use = ++buffer_use_count_;
+  return true;
+}
+
+bool MinidumpFileWriter::WriteOut(MDRVA position, const void *src,
+                                  size_t size) {
+  if (!compressed_)
+    return WriteToFile(position, src, size);
+
+  const uint8_t *data = static_cast<const uint8_t*>(src);
+  while (size) {
+    const size_t frame_size = size < kCompressedMinidumpMaxFrameSize ?
+        size : kCompressedMinidumpMaxFrameSize;
+    if (!WriteFrame(position, data, frame_size))
+      return false;
+    position += static_cast<MDRVA>(frame_size);
+    data += frame_size;
+    size -= frame_size;
+  }
+  return true;
+}
+
+bool MinidumpFileWriter::WriteFrame(MDRVA position, const uint8_t *src,
+                                    size_t size) {
+  if (!frame_buffer_) {
+    frame_buffer_ = reinterpret_cast<uint8_t*>(allocator_.Alloc(
+        sizeof(CompressedMinidumpHeader) + sizeof(CompressedMinidumpFrame) +
+        kCompressedMinidumpMaxFrameSize));
+    hash_table_ = reinterpret_cast<uint16_t*>(allocator_.Alloc(
+        kCompressBlockHashTableSize * sizeof(uint16_t)));
+    if (!frame_buffer_ || !hash_table_)
+      return false;
+  }
+
+  // The file header goes in front of the first frame.
+  size_t header_size = 0;
+  if (compressed_size_ == 0) {
+    CompressedMinidumpHeader header;
+    header.signature = kCompressedMinidumpSignature;
+    header.version = kCompressedMinidumpVersion;
+    my_memcpy(frame_buffer_, &header, sizeof(header));
+    header_size = sizeof(header);
+  }
+
+  CompressedMinidumpFrame frame;
+  frame.offset = position;
+  frame.size = static_cast<uint32_t>(size);
+  uint8_t *const data = frame_buffer_ + header_size + sizeof(frame);
+  // Keep the data as is unless compressing it saves space.
+  size_t stored_size =
+      size ? CompressBlock(src, size, data, size - 1, hash_table_) : 0;
+  if (size && !stored_size) {
+    my_memcpy(data, src, size);
+    stored_size = size;
+  }
+  frame.stored_size = static_cast<uint32_t>(stored_size);
+  my_memcpy(frame_buffer_ + header_size, &frame, sizeof(frame));
+
+  const size_t total = header_size + sizeof(frame) + stored_size;
+  if (!WriteToFile(compressed_size_, frame_buffer_, total))
+    return false;
+  compressed_size_ += total;
+  return true;
+}
+
+bool MinidumpFileWriter::WriteToFile(off_t offset, const void *src,
+                                     size_t size) {
   // Seek and write the data
 #if defined(__linux__) && __linux__
-  if (sys_lseek(file_, position, SEEK_SET) == static_cast<off_t>(position)) {
-    if (sys_write(file_, src, size) == size) {
+  if (sys_lseek(file_, offset, SEEK_SET) == offset) {
+    if (sys_write(file_, src, size) == static_cast<ssize_t>(size)) {
 #else
-  if (lseek(file_, position, SEEK_SET) == static_cast<off_t>(position)) {
-    if (write(file_, src, size) == size) {
+  if (lseek(file_, offset, SEEK_SET) == offset) {
+    if (write(file_, src, size) == static_cast<ssize_t>(size)) {
 #endif
       return true;
     }
@@ -267,6 +488,23 @@ bool MinidumpFileWriter::Copy(MDRVA position, const void *src, ssize_t size) {
   return false;
 }
 
+bool MinidumpFileWriter::FlushBuffer(WriteBuffer *buffer) {
+  if (!buffer->used)
+    return true;
+  const size_t used = buffer->used;
+  buffer->used = 0;
+  return WriteOut(buffer->position, buffer->data, used);
+}
+
+bool MinidumpFileWriter::FlushBuffers() {
+  bool result = true;
+  for (int i = 0; i < kWriteBufferCount; ++i) {
+    if (!FlushBuffer(&buffers_[i]))
+      result = false;
+  }
+  return result;
+}
+
 bool UntypedMDRVA::Allocate(size_t size) {
   assert(size_ == 0);
   size_ = size;
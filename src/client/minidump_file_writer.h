@@ -36,6 +36,7 @@
 
 #include <string>
 
+#include "common/memory.h"
 #include "google_breakpad/common/minidump_format.h"
 
 namespace google_breakpad {
@@ -47,6 +48,10 @@ template<typename MDType> class TypedMDRVA;
 // strings using the definitions in minidump_format.h.  Since this class is
 // expected to be used in a situation where the current process may be
 // damaged, it will not allocate heap memory.
+//
+// Small writes are combined in buffers obtained from a PageAllocator and
+// reach the file when a buffer fills up, or the writer is flushed, closed or
+// destroyed, so that a dump takes far fewer system calls to write.
 // Sample usage:
 // MinidumpFileWriter writer;
 // writer.Open("/tmp/minidump.dmp");
@@ -91,6 +96,13 @@ public:
   // Return true on success, or false on failure.
   bool Close();
 
+  // Write any buffered data to the file, and extend the file to cover
+  // everything allocated so far.  This happens automatically on Close() and
+  // on destruction, but is needed to check the result when the file was
+  // specified with SetFile.
+  // Return true on success, or false on failure.
+  bool Flush();
+
   // Copy the contents of |str| to a MDString and write it to the file.
   // |str| is expected to be either UTF-16 or UTF-32 depending on the size
   // of wchar_t.
@@ -113,9 +125,26 @@ public:
   // Return true on success, or false on failure
   bool Copy(MDRVA position, const void *src, ssize_t size);
 
+  // Copies the rest of the file |fd| to the current position and sets
+  // |location| to where it was written.  The size need not be known in
+  // advance, which suits /proc files that report a size of 0.  Where the
+  // kernel can send from |fd|, the data is copied with sendfile and never
+  // enters this process; otherwise it is read and written out in chunks.
+  // Either way it takes no buffer memory beyond one chunk, which matters
+  // for large files such as /proc/<pid>/maps.  An empty file gives a
+  // |location| with a data_size of 0.
+  // Return true on success, or false on failure
+  bool CopyFile(int fd, MDLocationDescriptor *location);
+
   // Return the current position for writing to the minidump
   inline MDRVA position() const { return position_; }
 
+  // Write the minidump in the compressed format described in
+  // common/minidump_compression.h.  Must be called before any data is
+  // written.
+  void set_compressed(bool compressed) { compressed_ = compressed; }
+  bool compressed() const { return compressed_; }
+
  private:
   friend class UntypedMDRVA;
 
@@ -124,6 +153,46 @@ public:
   // unable to allocate the bytes.
   MDRVA Allocate(size_t size);
 
+  // A run of bytes destined for [position, position + used) in the file.
+  struct WriteBuffer {
+    uint8_t *data;
+    MDRVA position;
+    size_t used;
+    // Larger values were used more recently.
+    unsigned int last_use;
+  };
+
+  // The number and size of write buffers.  Several buffers let writes that
+  // alternate between regions, such as a stream's list entries and the data
+  // appended for each of them, still be combined.
+  static const int kWriteBufferCount = 4;
+  static const size_t kWriteBufferSize = 32 * 1024;
+
+  // The size of the chunks that CopyFile reads when it can't use sendfile.
+  static const size_t kCopyBufferSize = 32 * 1024;
+
+  // Copy the rest of |fd| to |position| inside the kernel.  Set |*copied|
+  // to the number of bytes copied.  Return false, having read nothing from
+  // |fd|, if the kernel can't do it.
+  bool SendFile(int fd, MDRVA position, size_t *copied);
+
+  // Write |size| bytes from |src| to |position| in the minidump, as frames
+  // if the minidump is compressed.
+  bool WriteOut(MDRVA position, const void *src, size_t size);
+
+  // Append a frame holding |size| bytes from |src|, which are destined for
+  // |position| in the minidump, to the compressed file.
+  bool WriteFrame(MDRVA position, const uint8_t *src, size_t size);
+
+  // Write |size| bytes from |src| to |offset| in the file.
+  bool WriteToFile(off_t offset, const void *src, size_t size);
+
+  // Write out the contents of |buffer| and empty it.
+  bool FlushBuffer(WriteBuffer *buffer);
+
+  // Write out and empty every buffer.
+  bool FlushBuffers();
+
   // The file descriptor for the output file.
   int file_;
 
@@ -136,6 +205,24 @@ public:
   // Current allocated size
   size_t size_;
 
+  // Allocator for the write buffers, which are obtained on first use.  If
+  // that fails, data is written to the file directly.
+  PageAllocator allocator_;
+  WriteBuffer buffers_[kWriteBufferCount];
+  bool buffers_allocated_;
+  unsigned int buffer_use_count_;
+
+  // The chunk buffer for CopyFile, obtained on first use.
+  uint8_t *copy_buffer_;
+
+  // Whether the minidump is written compressed, the number of bytes of the
+  // compressed file written so far, and the compressor's scratch space,
+  // obtained on first use.
+  bool compressed_;
+  off_t compressed_size_;
+  uint8_t *frame_buffer_;
+  uint16_t *hash_table_;
+
   // Copy |length| characters from |str| to |mdstring|.  These are distinct
   // because the underlying MDString is a UTF-16 based string.  The wchar_t
   // variant may need to create a MDString that has more characters than the
@@ -245,7 +332,7 @@ class TypedMDRVA : public UntypedMDRVA {
   // Copy |item| to |index|
   // Must have been allocated using AllocateArray().
   // Return true on success, or false on failure
-  bool CopyIndex(unsigned int index, MDType *item);
+  bool CopyIndex(unsigned int index, const MDType *item);
 
   // Copy |size| bytes starting at |str| to |index|
   // Must have been allocated using AllocateObjectAndArray().
@@ -99,6 +99,16 @@ struct CustomClientInfo {
   size_t count;
 };
 
+// Header of the shared memory section through which a registered client
+// keeps the server's copy of its custom info entries up to date, so that
+// the server need not read them from the client's memory while the client
+// waits for its dump.  The entries follow the header.
+struct CustomInfoSectionHeader {
+  // Incremented by the client before and after it copies the entries, so
+  // it is odd while they are being written and zero until they first are.
+  volatile LONG sequence;
+};
+
 // Message structure for IPC between crash client and crash server.
 struct ProtocolMessage {
   ProtocolMessage()
@@ -111,7 +121,8 @@ struct ProtocolMessage {
         custom_client_info(),
         dump_request_handle(NULL),
         dump_generated_handle(NULL),
-        server_alive_handle(NULL) {
+        server_alive_handle(NULL),
+        custom_info_section(NULL) {
   }
 
   // Creates an instance with the given parameters.
@@ -134,7 +145,8 @@ struct ProtocolMessage {
       custom_client_info(custom_info),
       dump_request_handle(arg_dump_request_handle),
       dump_generated_handle(arg_dump_generated_handle),
-      server_alive_handle(arg_server_alive) {
+      server_alive_handle(arg_server_alive),
+      custom_info_section(NULL) {
   }
 
   // Tag in the message.
@@ -170,6 +182,11 @@ struct ProtocolMessage {
   // if server process goes down.
   HANDLE server_alive_handle;
 
+  // Handle to the client's custom info section, which starts with a
+  // CustomInfoSectionHeader.  NULL if the client has no custom info or
+  // the server could not create the section.
+  HANDLE custom_info_section;
+
  private:
   // Disable copy ctor and operator=.
   ProtocolMessage(const ProtocolMessage& msg);
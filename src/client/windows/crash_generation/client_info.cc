@@ -28,6 +28,9 @@
 // OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 #include "client/windows/crash_generation/client_info.h"
+
+#include <string.h>
+
 #include "client/windows/common/ipc_protocol.h"
 
 static const wchar_t kCustomInfoProcessUptimeName[] = L"ptime";
@@ -48,6 +51,8 @@ ClientInfo::ClientInfo(CrashGenerationServer* crash_server,
       ex_info_(ex_info),
       assert_info_(assert_info),
       custom_client_info_(custom_client_info),
+      custom_info_section_(NULL),
+      custom_info_view_(NULL),
       thread_id_(thread_id),
       process_handle_(NULL),
       dump_requested_handle_(NULL),
@@ -84,7 +89,39 @@ bool ClientInfo::Initialize() {
                                        TRUE,    // Manual reset.
                                        FALSE,   // Initial state.
                                        NULL);   // Name.
-  return dump_generated_handle_ != NULL;
+  if (!dump_generated_handle_) {
+    return false;
+  }
+
+  CreateCustomInfoSection();
+  return true;
+}
+
+void ClientInfo::CreateCustomInfoSection() {
+  if (custom_client_info_.count == 0 ||
+      custom_client_info_.count > kMaxCustomInfoEntries) {
+    return;
+  }
+
+  DWORD size = static_cast<DWORD>(
+      sizeof(CustomInfoSectionHeader) +
+      sizeof(CustomInfoEntry) * custom_client_info_.count);
+  custom_info_section_ = CreateFileMapping(INVALID_HANDLE_VALUE,  // Paging file.
+                                           NULL,  // Security attributes.
+                                           PAGE_READWRITE,
+                                           0,     // Maximum size, high.
+                                           size,  // Maximum size, low.
+                                           NULL);  // Name.
+  if (!custom_info_section_) {
+    return;
+  }
+
+  custom_info_view_ = reinterpret_cast<const CustomInfoSectionHeader*>(
+      MapViewOfFile(custom_info_section_, FILE_MAP_READ, 0, 0, size));
+  if (!custom_info_view_) {
+    CloseHandle(custom_info_section_);
+    custom_info_section_ = NULL;
+  }
 }
 
 void ClientInfo::UnregisterDumpRequestWaitAndBlockUntilNoPending() {
@@ -131,6 +168,14 @@ ClientInfo::~ClientInfo() {
   if (dump_generated_handle_) {
     CloseHandle(dump_generated_handle_);
   }
+
+  if (custom_info_view_) {
+    UnmapViewOfFile(custom_info_view_);
+  }
+
+  if (custom_info_section_) {
+    CloseHandle(custom_info_section_);
+  }
 }
 
 bool ClientInfo::GetClientExceptionInfo(EXCEPTION_POINTERS** ex_info) const {
@@ -199,6 +244,11 @@ bool ClientInfo::PopulateCustomInfo() {
         kCustomInfoProcessUptimeName);
   }
 
+  if (ReadCustomInfoSection()) {
+    SetProcessUptime();
+    return true;
+  }
+
   if (!ReadProcessMemory(process_handle_,
                          custom_client_info_.entries,
                          custom_info_entries_.get(),
@@ -211,6 +261,24 @@ bool ClientInfo::PopulateCustomInfo() {
   return (bytes_count == read_count);
 }
 
+bool ClientInfo::ReadCustomInfoSection() {
+  if (!custom_info_view_) {
+    return false;
+  }
+
+  LONG sequence = custom_info_view_->sequence;
+  MemoryBarrier();
+  if (sequence == 0 || (sequence & 1) != 0) {
+    return false;
+  }
+
+  memcpy(custom_info_entries_.get(),
+         custom_info_view_ + 1,
+         sizeof(CustomInfoEntry) * custom_client_info_.count);
+  MemoryBarrier();
+  return custom_info_view_->sequence == sequence;
+}
+
 CustomClientInfo ClientInfo::GetCustomInfo() const {
   CustomClientInfo custom_info;
   custom_info.entries = custom_info_entries_.get();
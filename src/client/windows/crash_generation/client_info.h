@@ -69,6 +69,7 @@ class ClientInfo {
   const CustomClientInfo& custom_client_info() const {
     return custom_client_info_;
   }
+  HANDLE custom_info_section() const { return custom_info_section_; }
 
   void set_dump_request_wait_handle(HANDLE value) {
     dump_request_wait_handle_ = value;
@@ -91,7 +92,9 @@ class ClientInfo {
   bool GetClientExceptionInfo(EXCEPTION_POINTERS** ex_info) const;
   bool GetClientThreadId(DWORD* thread_id) const;
 
-  // Reads the custom information from the client process address space.
+  // Reads the custom information from the client's custom info section,
+  // or from the client process address space if the client has not
+  // written the section.
   bool PopulateCustomInfo();
 
   // Returns the client custom information.
@@ -102,6 +105,15 @@ class ClientInfo {
   // stores it in the last entry of client custom info.
   void SetProcessUptime();
 
+  // Creates the section through which the client shares its custom info
+  // entries with the server.  The client does without one on failure.
+  void CreateCustomInfoSection();
+
+  // Copies the custom info entries from the client's custom info section.
+  // Returns false if the client has not written it, or was writing it
+  // when it asked for the dump.
+  bool ReadCustomInfoSection();
+
   // Crash generation server.
   CrashGenerationServer* crash_server_;
 
@@ -136,6 +148,12 @@ class ClientInfo {
   // is called.
   scoped_array<CustomInfoEntry> custom_info_entries_;
 
+  // Section shared with the client, starting with a
+  // CustomInfoSectionHeader followed by the client's custom info entries,
+  // and a read-only view of it.  NULL if there is no section.
+  HANDLE custom_info_section_;
+  const CustomInfoSectionHeader* custom_info_view_;
+
   // Address of a variable in the client process address space that
   // will contain the thread id of the crashing client thread.
   //
@@ -37,10 +37,12 @@
       'sources': [
         'client_info.cc',
         'crash_generation_server.cc',
+        'dump_scheduler.cc',
         'minidump_generator.cc',
         'client_info.h',
         'crash_generation_client.h',
         'crash_generation_server.h',
+        'dump_scheduler.h',
         'minidump_generator.h',
       ],
       'dependencies': [
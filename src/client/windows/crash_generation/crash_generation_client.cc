@@ -103,7 +103,9 @@ CrashGenerationClient::CrashGenerationClient(
           crash_generated_(NULL),
           server_alive_(NULL),
           exception_pointers_(NULL),
-          custom_info_() {
+          custom_info_(),
+          custom_info_section_(NULL),
+          custom_info_view_(NULL) {
   memset(&assert_info_, 0, sizeof(assert_info_));
   if (custom_info) {
     custom_info_ = *custom_info;
@@ -123,7 +125,9 @@ CrashGenerationClient::CrashGenerationClient(
           crash_generated_(NULL),
           server_alive_(NULL),
           exception_pointers_(NULL),
-          custom_info_() {
+          custom_info_(),
+          custom_info_section_(NULL),
+          custom_info_view_(NULL) {
   memset(&assert_info_, 0, sizeof(assert_info_));
   if (custom_info) {
     custom_info_ = *custom_info;
@@ -142,6 +146,14 @@ CrashGenerationClient::~CrashGenerationClient() {
   if (server_alive_) {
     CloseHandle(server_alive_);
   }
+
+  if (custom_info_view_) {
+    UnmapViewOfFile(custom_info_view_);
+  }
+
+  if (custom_info_section_) {
+    CloseHandle(custom_info_section_);
+  }
 }
 
 // Performs the registration step with the server process.
@@ -160,6 +172,7 @@ CrashGenerationClient::~CrashGenerationClient() {
 // * Address of an instance of MDRawAssertionInfo that will contain
 //   relevant information in case of non-exception crashes like assertion
 //   failures and pure calls.
+// * Address and number of the custom info entries.
 //
 // In return the client expects the following information from the server:
 //
@@ -171,6 +184,8 @@ CrashGenerationClient::~CrashGenerationClient() {
 //   dump generation for the server to finish dump generation.
 // * Handle to a mutex object that client can wait on to make sure
 //   server is still alive.
+// * Optionally, handle to a section that client can copy its custom info
+//   entries into when it requests a dump.
 //
 // If any step of the expected behavior mentioned above fails, the
 // registration step is not considered successful and hence out-of-process
@@ -267,6 +282,12 @@ bool CrashGenerationClient::RegisterClient(HANDLE pipe) {
   server_alive_ = reply.server_alive_handle;
   server_process_id_ = reply.id;
 
+  if (reply.custom_info_section) {
+    custom_info_section_ = reply.custom_info_section;
+    custom_info_view_ = reinterpret_cast<CustomInfoSectionHeader*>(
+        MapViewOfFile(custom_info_section_, FILE_MAP_WRITE, 0, 0, 0));
+  }
+
   return true;
 }
 
@@ -334,6 +355,7 @@ bool CrashGenerationClient::RequestDump(EXCEPTION_POINTERS* ex_info,
     memset(&assert_info_, 0, sizeof(assert_info_));
   }
 
+  CopyCustomInfoToSection();
   return SignalCrashEventAndWait();
 }
 
@@ -373,6 +395,18 @@ bool CrashGenerationClient::SignalCrashEventAndWait() {
   return result == WAIT_OBJECT_0;
 }
 
+void CrashGenerationClient::CopyCustomInfoToSection() {
+  if (!custom_info_view_) {
+    return;
+  }
+
+  InterlockedIncrement(&custom_info_view_->sequence);
+  memcpy(custom_info_view_ + 1,
+         custom_info_.entries,
+         sizeof(CustomInfoEntry) * custom_info_.count);
+  InterlockedIncrement(&custom_info_view_->sequence);
+}
+
 HANDLE CrashGenerationClient::DuplicatePipeToClientProcess(const wchar_t* pipe_name,
                                                            HANDLE hProcess) {
   for (int i = 0; i < kPipeConnectMaxAttempts; ++i) {
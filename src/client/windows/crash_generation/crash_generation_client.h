@@ -136,6 +136,11 @@ class CrashGenerationClient {
   // Signals the crash event and wait for the server to generate crash.
   bool SignalCrashEventAndWait();
 
+  // Copies the custom info entries into the section shared with the
+  // server, so that it need not read them from this process while this
+  // process waits for the dump.
+  void CopyCustomInfoToSection();
+
   // Pipe name to use to talk to server.
   std::wstring pipe_name_;
 
@@ -146,6 +151,11 @@ class CrashGenerationClient {
   // Custom client information
   CustomClientInfo custom_info_;
 
+  // Custom info section duplicated from server process, and a view of
+  // it.  NULL if the server gave none.
+  HANDLE custom_info_section_;
+  CustomInfoSectionHeader* custom_info_view_;
+
   // Type of dump to generate.
   MINIDUMP_TYPE dump_type_;
 
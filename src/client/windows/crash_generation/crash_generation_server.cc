@@ -54,6 +54,9 @@ static const DWORD kDumpGeneratedEventAccess = EVENT_MODIFY_STATE |
 // Access flags for the client on the mutex.
 static const DWORD kMutexAccess = SYNCHRONIZE;
 
+// Access flags for the client on its custom info section.
+static const DWORD kCustomInfoSectionAccess = FILE_MAP_WRITE;
+
 // Attribute flags for the pipe.
 static const DWORD kPipeAttr = FILE_FLAG_FIRST_PIPE_INSTANCE |
                                PIPE_ACCESS_DUPLEX |
@@ -64,12 +67,8 @@ static const DWORD kPipeMode = PIPE_TYPE_MESSAGE |
                                PIPE_READMODE_MESSAGE |
                                PIPE_WAIT;
 
-// For pipe I/O, execute the callback in the wait thread itself,
-// since the callback does very little work. The callback executes
-// the code for one of the states of the server state machine and
-// the code for all of the states perform async I/O and hence
-// finish very quickly.
-static const ULONG kPipeIOThreadFlags = WT_EXECUTEINWAITTHREAD;
+// Completion key that tells a completion thread to exit.
+static const ULONG_PTR kQuitCompletionKey = 0;
 
 // Dump request threads will, most likely, generate dumps. That may
 // take some time to finish, so specify WT_EXECUTELONGFUNCTION flag.
@@ -109,8 +108,8 @@ CrashGenerationServer::CrashGenerationServer(
     const std::wstring* dump_path)
     : pipe_name_(pipe_name),
       pipe_sec_attrs_(pipe_sec_attrs),
-      pipe_(NULL),
-      pipe_wait_handle_(NULL),
+      pipe_instance_count_(1),
+      completion_port_(NULL),
       server_alive_handle_(NULL),
       connect_callback_(connect_callback),
       connect_context_(connect_context),
@@ -121,17 +120,31 @@ CrashGenerationServer::CrashGenerationServer(
       upload_request_callback_(upload_request_callback),
       upload_context_(upload_context),
       generate_dumps_(generate_dumps),
+      dump_memory_budget_(0),
       dump_path_(dump_path ? *dump_path : L""),
-      server_state_(IPC_SERVER_STATE_UNINITIALIZED),
+      started_(false),
       shutting_down_(false),
-      overlapped_(),
-      client_info_(NULL),
       pre_fetch_custom_info_(true) {
   InitializeCriticalSection(&sync_);
 }
 
-// This should never be called from the OnPipeConnected callback.
-// Otherwise the UnregisterWaitEx call below will cause a deadlock.
+CrashGenerationServer::PipeInstance::PipeInstance()
+    : pipe(NULL),
+      state(IPC_SERVER_STATE_UNINITIALIZED),
+      overlapped(),
+      client_info(NULL) {
+  InitializeCriticalSection(&sync);
+}
+
+CrashGenerationServer::PipeInstance::~PipeInstance() {
+  if (pipe) {
+    CloseHandle(pipe);
+  }
+  DeleteCriticalSection(&sync);
+}
+
+// This should never be called from a completion thread. Otherwise the
+// wait for the completion threads below will cause a deadlock.
 CrashGenerationServer::~CrashGenerationServer() {
   // New scope to release the lock automatically.
   {
@@ -149,28 +162,40 @@ CrashGenerationServer::~CrashGenerationServer() {
   // not even from another thread.
 
   // Even if there are no current worker threads running, it is possible that
-  // an I/O request is pending on the pipe right now but not yet done.
-  // In fact, it's very likely this is the case unless we are in an ERROR
-  // state. If we don't wait for the pending I/O to be done, then when the I/O
-  // completes, it may write to invalid memory. AppVerifier will flag this
-  // problem too. So we disconnect from the pipe and then wait for the server
-  // to get into error state so that the pending I/O will fail and get
-  // cleared.
-  DisconnectNamedPipe(pipe_);
+  // an I/O request is pending on a pipe instance right now but not yet done.
+  // In fact, it's very likely this is the case unless the instance is in an
+  // ERROR state. If we don't wait for the pending I/O to be done, then when
+  // the I/O completes, it may write to invalid memory. AppVerifier will flag
+  // this problem too. So we disconnect from the pipe instances and then wait
+  // for them to get into error state so that the pending I/O will fail and
+  // get cleared.
+  for (size_t i = 0; i < instances_.size(); ++i) {
+    if (instances_[i]->pipe) {
+      DisconnectNamedPipe(instances_[i]->pipe);
+    }
+  }
   int num_tries = 100;
-  while (num_tries-- && server_state_ != IPC_SERVER_STATE_ERROR) {
+  while (num_tries-- && !AllInstancesStopped()) {
     Sleep(10);
   }
 
-  // Unregister wait on the pipe.
-  if (pipe_wait_handle_) {
-    // Wait for already executing callbacks to finish.
-    UnregisterWaitEx(pipe_wait_handle_, INVALID_HANDLE_VALUE);
+  // Stop the completion threads and wait for already executing state
+  // transitions to finish.
+  for (size_t i = 0; i < completion_threads_.size(); ++i) {
+    PostQueuedCompletionStatus(completion_port_, 0, kQuitCompletionKey, NULL);
+  }
+  for (size_t i = 0; i < completion_threads_.size(); ++i) {
+    WaitForSingleObject(completion_threads_[i], INFINITE);
+    CloseHandle(completion_threads_[i]);
   }
 
-  // Close the pipe to avoid further client connections.
-  if (pipe_) {
-    CloseHandle(pipe_);
+  // Close the pipe instances to avoid further client connections.
+  for (size_t i = 0; i < instances_.size(); ++i) {
+    delete instances_[i];
+  }
+
+  if (completion_port_) {
+    CloseHandle(completion_port_);
   }
 
   // Request all ClientInfo objects to unregister all waits.
@@ -201,74 +226,109 @@ CrashGenerationServer::~CrashGenerationServer() {
     CloseHandle(server_alive_handle_);
   }
 
-  if (overlapped_.hEvent) {
-    CloseHandle(overlapped_.hEvent);
-  }
-
   DeleteCriticalSection(&sync_);
 }
 
 bool CrashGenerationServer::Start() {
-  if (server_state_ != IPC_SERVER_STATE_UNINITIALIZED) {
+  if (started_) {
     return false;
   }
 
-  server_state_ = IPC_SERVER_STATE_INITIAL;
+  started_ = true;
 
   server_alive_handle_ = CreateMutex(NULL, TRUE, NULL);
   if (!server_alive_handle_) {
     return false;
   }
 
-  // Event to signal the client connection and pipe reads and writes.
-  overlapped_.hEvent = CreateEvent(NULL,   // Security descriptor.
-                                   TRUE,   // Manual reset.
-                                   FALSE,  // Initially nonsignaled.
-                                   NULL);  // Name.
-  if (!overlapped_.hEvent) {
+  SYSTEM_INFO system_info;
+  GetSystemInfo(&system_info);
+  int processor_count = static_cast<int>(system_info.dwNumberOfProcessors);
+  if (processor_count < 1) {
+    processor_count = 1;
+  }
+  int instance_count = pipe_instance_count_ > 0 ? pipe_instance_count_
+                                                : processor_count;
+  if (instance_count > PIPE_UNLIMITED_INSTANCES) {
+    instance_count = PIPE_UNLIMITED_INSTANCES;
+  }
+  int thread_count = instance_count < processor_count ? instance_count
+                                                      : processor_count;
+
+  completion_port_ = CreateIoCompletionPort(INVALID_HANDLE_VALUE,
+                                            NULL,
+                                            0,
+                                            thread_count);
+  if (!completion_port_) {
     return false;
   }
 
-  // Register a callback with the thread pool for the client connection.
-  if (!RegisterWaitForSingleObject(&pipe_wait_handle_,
-                                   overlapped_.hEvent,
-                                   OnPipeConnected,
-                                   this,
-                                   INFINITE,
-                                   kPipeIOThreadFlags)) {
-    return false;
+  for (int i = 0; i < instance_count; ++i) {
+    PipeInstance* instance = new PipeInstance;
+    instances_.push_back(instance);
+
+    // Only the first instance may claim the pipe name, so that another
+    // server can't have created the pipe first.
+    DWORD pipe_attr = i == 0 ? kPipeAttr
+                             : kPipeAttr & ~FILE_FLAG_FIRST_PIPE_INSTANCE;
+    HANDLE pipe = CreateNamedPipe(pipe_name_.c_str(),
+                                  pipe_attr,
+                                  kPipeMode,
+                                  instance_count,
+                                  kOutBufferSize,
+                                  kInBufferSize,
+                                  0,
+                                  pipe_sec_attrs_);
+    if (pipe == INVALID_HANDLE_VALUE) {
+      return false;
+    }
+    instance->pipe = pipe;
+
+    if (!CreateIoCompletionPort(pipe,
+                                completion_port_,
+                                reinterpret_cast<ULONG_PTR>(instance),
+                                0)) {
+      return false;
+    }
   }
 
-  pipe_ = CreateNamedPipe(pipe_name_.c_str(),
-                          kPipeAttr,
-                          kPipeMode,
-                          1,
-                          kOutBufferSize,
-                          kInBufferSize,
-                          0,
-                          pipe_sec_attrs_);
-  if (pipe_ == INVALID_HANDLE_VALUE) {
-    return false;
+  for (int i = 0; i < thread_count; ++i) {
+    HANDLE thread = CreateThread(NULL,                  // lpThreadAttributes
+                                 0,                     // dwStackSize
+                                 CompletionThreadMain,  // lpStartAddress
+                                 this,                  // lpParameter
+                                 0,                     // dwCreationFlags
+                                 NULL);                 // lpThreadId
+    if (!thread) {
+      return false;
+    }
+    completion_threads_.push_back(thread);
   }
 
-  // Kick-start the state machine. This will initiate an asynchronous wait
-  // for client connections.
-  if (!SetEvent(overlapped_.hEvent)) {
-    server_state_ = IPC_SERVER_STATE_ERROR;
-    return false;
+  // Kick-start the state machine of each instance. This will initiate an
+  // asynchronous wait for client connections.
+  for (size_t i = 0; i < instances_.size(); ++i) {
+    PipeInstance* instance = instances_[i];
+    instance->state = IPC_SERVER_STATE_INITIAL;
+    if (!PostQueuedCompletionStatus(completion_port_,
+                                    0,
+                                    reinterpret_cast<ULONG_PTR>(instance),
+                                    NULL)) {
+      instance->state = IPC_SERVER_STATE_ERROR;
+      return false;
+    }
   }
 
-  // If we are in error state, it's because we failed to start listening.
   return true;
 }
 
-// If the server thread serving clients ever gets into the
-// ERROR state, reset the event, close the pipe and remain
-// in the error state forever. Error state means something
+// If a pipe instance ever gets into the ERROR state, close it and
+// remain in the error state forever. Error state means something
 // that we didn't account for has happened, and it's dangerous
-// to do anything unknowingly.
-void CrashGenerationServer::HandleErrorState() {
-  assert(server_state_ == IPC_SERVER_STATE_ERROR);
+// to do anything unknowingly. The other instances keep serving
+// clients.
+void CrashGenerationServer::HandleErrorState(PipeInstance* instance) {
+  assert(instance->state == IPC_SERVER_STATE_ERROR);
 
   // If the server is shutting down anyway, don't clean up
   // here since shut down process will clean up.
@@ -276,19 +336,9 @@ void CrashGenerationServer::HandleErrorState() {
     return;
   }
 
-  if (pipe_wait_handle_) {
-    UnregisterWait(pipe_wait_handle_);
-    pipe_wait_handle_ = NULL;
-  }
-
-  if (pipe_) {
-    CloseHandle(pipe_);
-    pipe_ = NULL;
-  }
-
-  if (overlapped_.hEvent) {
-    CloseHandle(overlapped_.hEvent);
-    overlapped_.hEvent = NULL;
+  if (instance->pipe) {
+    CloseHandle(instance->pipe);
+    instance->pipe = NULL;
   }
 }
 
@@ -297,15 +347,11 @@ void CrashGenerationServer::HandleErrorState() {
 // finishes synchronously, directly go into the CONNECTED state;
 // otherwise go into the CONNECTING state. For any problems, go
 // into the ERROR state.
-void CrashGenerationServer::HandleInitialState() {
-  assert(server_state_ == IPC_SERVER_STATE_INITIAL);
+void CrashGenerationServer::HandleInitialState(PipeInstance* instance) {
+  assert(instance->state == IPC_SERVER_STATE_INITIAL);
 
-  if (!ResetEvent(overlapped_.hEvent)) {
-    EnterErrorState();
-    return;
-  }
-
-  bool success = ConnectNamedPipe(pipe_, &overlapped_) != FALSE;
+  bool success = ConnectNamedPipe(instance->pipe,
+                                  &instance->overlapped) != FALSE;
   DWORD error_code = success ? ERROR_SUCCESS : GetLastError();
 
   // From MSDN, it is not clear that when ConnectNamedPipe is used
@@ -315,15 +361,15 @@ void CrashGenerationServer::HandleInitialState() {
 
   switch (error_code) {
     case ERROR_IO_PENDING:
-      EnterStateWhenSignaled(IPC_SERVER_STATE_CONNECTING);
+      EnterStateWhenSignaled(instance, IPC_SERVER_STATE_CONNECTING);
       break;
 
     case ERROR_PIPE_CONNECTED:
-      EnterStateImmediately(IPC_SERVER_STATE_CONNECTED);
+      EnterStateImmediately(instance, IPC_SERVER_STATE_CONNECTED);
       break;
 
     default:
-      EnterErrorState();
+      EnterErrorState(instance);
       break;
   }
 }
@@ -334,20 +380,20 @@ void CrashGenerationServer::HandleInitialState() {
 // go into the CONNECTED state. If the result indicates I/O is still
 // INCOMPLETE, remain in the CONNECTING state. For any problems,
 // go into the DISCONNECTING state.
-void CrashGenerationServer::HandleConnectingState() {
-  assert(server_state_ == IPC_SERVER_STATE_CONNECTING);
+void CrashGenerationServer::HandleConnectingState(PipeInstance* instance) {
+  assert(instance->state == IPC_SERVER_STATE_CONNECTING);
 
   DWORD bytes_count = 0;
-  bool success = GetOverlappedResult(pipe_,
-                                     &overlapped_,
+  bool success = GetOverlappedResult(instance->pipe,
+                                     &instance->overlapped,
                                      &bytes_count,
                                      FALSE) != FALSE;
   DWORD error_code = success ? ERROR_SUCCESS : GetLastError();
 
   if (success) {
-    EnterStateImmediately(IPC_SERVER_STATE_CONNECTED);
+    EnterStateImmediately(instance, IPC_SERVER_STATE_CONNECTED);
   } else if (error_code != ERROR_IO_INCOMPLETE) {
-    EnterStateImmediately(IPC_SERVER_STATE_DISCONNECTING);
+    EnterStateImmediately(instance, IPC_SERVER_STATE_DISCONNECTING);
   } else {
     // remain in CONNECTING state
   }
@@ -357,27 +403,27 @@ void CrashGenerationServer::HandleConnectingState() {
 // try to issue an asynchronous read from the pipe. If read completes
 // synchronously or if I/O is pending then go into the READING state.
 // For any problems, go into the DISCONNECTING state.
-void CrashGenerationServer::HandleConnectedState() {
-  assert(server_state_ == IPC_SERVER_STATE_CONNECTED);
+void CrashGenerationServer::HandleConnectedState(PipeInstance* instance) {
+  assert(instance->state == IPC_SERVER_STATE_CONNECTED);
 
   DWORD bytes_count = 0;
-  memset(&msg_, 0, sizeof(msg_));
-  bool success = ReadFile(pipe_,
-                          &msg_,
-                          sizeof(msg_),
+  memset(&instance->msg, 0, sizeof(instance->msg));
+  bool success = ReadFile(instance->pipe,
+                          &instance->msg,
+                          sizeof(instance->msg),
                           &bytes_count,
-                          &overlapped_) != FALSE;
+                          &instance->overlapped) != FALSE;
   DWORD error_code = success ? ERROR_SUCCESS : GetLastError();
 
   // Note that the asynchronous read issued above can finish before the
   // code below executes. But, it is okay to change state after issuing
   // the asynchronous read. This is because even if the asynchronous read
-  // is done, the callback for it would not be executed until the current
-  // thread finishes its execution.
+  // is done, its completion would not be handled until the current
+  // thread finishes its execution and leaves the instance's sync.
   if (success || error_code == ERROR_IO_PENDING) {
-    EnterStateWhenSignaled(IPC_SERVER_STATE_READING);
+    EnterStateWhenSignaled(instance, IPC_SERVER_STATE_READING);
   } else {
-    EnterStateImmediately(IPC_SERVER_STATE_DISCONNECTING);
+    EnterStateImmediately(instance, IPC_SERVER_STATE_DISCONNECTING);
   }
 }
 
@@ -385,21 +431,21 @@ void CrashGenerationServer::HandleConnectedState() {
 // try to get the result of the async read. If async read is done,
 // go into the READ_DONE state. For any problems, go into the
 // DISCONNECTING state.
-void CrashGenerationServer::HandleReadingState() {
-  assert(server_state_ == IPC_SERVER_STATE_READING);
+void CrashGenerationServer::HandleReadingState(PipeInstance* instance) {
+  assert(instance->state == IPC_SERVER_STATE_READING);
 
   DWORD bytes_count = 0;
-  bool success = GetOverlappedResult(pipe_,
-                                     &overlapped_,
+  bool success = GetOverlappedResult(instance->pipe,
+                                     &instance->overlapped,
                                      &bytes_count,
                                      FALSE) != FALSE;
   if (success && bytes_count == sizeof(ProtocolMessage)) {
-    EnterStateImmediately(IPC_SERVER_STATE_READ_DONE);
+    EnterStateImmediately(instance, IPC_SERVER_STATE_READ_DONE);
     return;
   }
 
   assert(!CheckForIOIncomplete(success));
-  EnterStateImmediately(IPC_SERVER_STATE_DISCONNECTING);
+  EnterStateImmediately(instance, IPC_SERVER_STATE_DISCONNECTING);
 }
 
 // When the server thread serving the client is in the READ_DONE state,
@@ -408,107 +454,106 @@ void CrashGenerationServer::HandleReadingState() {
 // write the response to the pipe asynchronously. If that succeeds,
 // go into the WRITING state. For any problems, go into the DISCONNECTING
 // state.
-void CrashGenerationServer::HandleReadDoneState() {
-  assert(server_state_ == IPC_SERVER_STATE_READ_DONE);
+void CrashGenerationServer::HandleReadDoneState(PipeInstance* instance) {
+  assert(instance->state == IPC_SERVER_STATE_READ_DONE);
 
-  if (!IsClientRequestValid(msg_)) {
-    EnterStateImmediately(IPC_SERVER_STATE_DISCONNECTING);
+  if (!IsClientRequestValid(instance->msg)) {
+    EnterStateImmediately(instance, IPC_SERVER_STATE_DISCONNECTING);
     return;
   }
 
-  if (msg_.tag == MESSAGE_TAG_UPLOAD_REQUEST) {
+  if (instance->msg.tag == MESSAGE_TAG_UPLOAD_REQUEST) {
     if (upload_request_callback_)
-      upload_request_callback_(upload_context_, msg_.id);
-    EnterStateImmediately(IPC_SERVER_STATE_DISCONNECTING);
+      upload_request_callback_(upload_context_, instance->msg.id);
+    EnterStateImmediately(instance, IPC_SERVER_STATE_DISCONNECTING);
     return;
   }
 
   scoped_ptr<ClientInfo> client_info(
       new ClientInfo(this,
-                     msg_.id,
-                     msg_.dump_type,
-                     msg_.thread_id,
-                     msg_.exception_pointers,
-                     msg_.assert_info,
-                     msg_.custom_client_info));
+                     instance->msg.id,
+                     instance->msg.dump_type,
+                     instance->msg.thread_id,
+                     instance->msg.exception_pointers,
+                     instance->msg.assert_info,
+                     instance->msg.custom_client_info));
 
   if (!client_info->Initialize()) {
-    EnterStateImmediately(IPC_SERVER_STATE_DISCONNECTING);
+    EnterStateImmediately(instance, IPC_SERVER_STATE_DISCONNECTING);
     return;
   }
 
   // Issues an asynchronous WriteFile call if successful.
   // Iff successful, assigns ownership of the client_info pointer to the server
   // instance, in which case we must be sure not to free it in this function.
-  if (!RespondToClient(client_info.get())) {
-    EnterStateImmediately(IPC_SERVER_STATE_DISCONNECTING);
+  if (!RespondToClient(instance, client_info.get())) {
+    EnterStateImmediately(instance, IPC_SERVER_STATE_DISCONNECTING);
     return;
   }
 
   // This is only valid as long as it can be found in the clients_ list
-  client_info_ = client_info.release();
+  instance->client_info = client_info.release();
 
   // Note that the asynchronous write issued by RespondToClient function
   // can finish before  the code below executes. But it is okay to change
   // state after issuing the asynchronous write. This is because even if
-  // the asynchronous write is done, the callback for it would not be
-  // executed until the current thread finishes its execution.
-  EnterStateWhenSignaled(IPC_SERVER_STATE_WRITING);
+  // the asynchronous write is done, its completion would not be handled
+  // until the current thread finishes its execution.
+  EnterStateWhenSignaled(instance, IPC_SERVER_STATE_WRITING);
 }
 
 // When the server thread serving the clients is in the WRITING state,
 // try to get the result of the async write. If the async write is done,
 // go into the WRITE_DONE state. For any problems, go into the
 // DISONNECTING state.
-void CrashGenerationServer::HandleWritingState() {
-  assert(server_state_ == IPC_SERVER_STATE_WRITING);
+void CrashGenerationServer::HandleWritingState(PipeInstance* instance) {
+  assert(instance->state == IPC_SERVER_STATE_WRITING);
 
   DWORD bytes_count = 0;
-  bool success = GetOverlappedResult(pipe_,
-                                     &overlapped_,
+  bool success = GetOverlappedResult(instance->pipe,
+                                     &instance->overlapped,
                                      &bytes_count,
                                      FALSE) != FALSE;
   if (success) {
-    EnterStateImmediately(IPC_SERVER_STATE_WRITE_DONE);
+    EnterStateImmediately(instance, IPC_SERVER_STATE_WRITE_DONE);
     return;
   }
 
   assert(!CheckForIOIncomplete(success));
-  EnterStateImmediately(IPC_SERVER_STATE_DISCONNECTING);
+  EnterStateImmediately(instance, IPC_SERVER_STATE_DISCONNECTING);
 }
 
 // When the server thread serving the clients is in the WRITE_DONE state,
 // try to issue an async read on the pipe. If the read completes synchronously
-// or if I/O is still pending then go into the READING_ACK state. For any
-// issues, go into the DISCONNECTING state.
-void CrashGenerationServer::HandleWriteDoneState() {
-  assert(server_state_ == IPC_SERVER_STATE_WRITE_DONE);
+// or if I/O is still pending then go into the READING_ACK state once its
+// completion is dequeued. For any issues, go into the DISCONNECTING state.
+void CrashGenerationServer::HandleWriteDoneState(PipeInstance* instance) {
+  assert(instance->state == IPC_SERVER_STATE_WRITE_DONE);
 
   DWORD bytes_count = 0;
-  bool success = ReadFile(pipe_,
-                           &msg_,
-                           sizeof(msg_),
+  bool success = ReadFile(instance->pipe,
+                           &instance->msg,
+                           sizeof(instance->msg),
                            &bytes_count,
-                           &overlapped_) != FALSE;
+                           &instance->overlapped) != FALSE;
   DWORD error_code = success ? ERROR_SUCCESS : GetLastError();
 
-  if (success) {
-    EnterStateImmediately(IPC_SERVER_STATE_READING_ACK);
-  } else if (error_code == ERROR_IO_PENDING) {
-    EnterStateWhenSignaled(IPC_SERVER_STATE_READING_ACK);
+  // A read that completes synchronously still queues a completion.
+  if (success || error_code == ERROR_IO_PENDING) {
+    EnterStateWhenSignaled(instance, IPC_SERVER_STATE_READING_ACK);
   } else {
-    EnterStateImmediately(IPC_SERVER_STATE_DISCONNECTING);
+    EnterStateImmediately(instance, IPC_SERVER_STATE_DISCONNECTING);
   }
 }
 
 // When the server thread serving the clients is in the READING_ACK state,
 // try to get result of async read. Go into the DISCONNECTING state.
-void CrashGenerationServer::HandleReadingAckState() {
-  assert(server_state_ == IPC_SERVER_STATE_READING_ACK);
+void CrashGenerationServer::HandleReadingAckState(PipeInstance* instance) {
+  assert(instance->state == IPC_SERVER_STATE_READING_ACK);
 
   DWORD bytes_count = 0;
-  bool success = GetOverlappedResult(pipe_,
-                                     &overlapped_,
+  bool success = GetOverlappedResult(instance->pipe,
+                                     &instance->overlapped,
                                      &bytes_count,
                                      FALSE) != FALSE;
   if (success) {
@@ -518,13 +563,13 @@ void CrashGenerationServer::HandleReadingAckState() {
       // Note that there is only a single copy of the ClientInfo of the
       // currently connected client.  However it is being referenced from
       // two different places:
-      //  - the client_info_ member
+      //  - the pipe instance's client_info member
       //  - the clients_ list
       // The lifetime of this ClientInfo depends on the lifetime of the
       // client process - basically it can go away at any time.
       // However, as long as it is referenced by the clients_ list it
       // is guaranteed to be valid. Enter the critical section and check
-      // to see whether the client_info_ can be found in the list.
+      // to see whether the client_info can be found in the list.
       // If found, execute the callback and only then leave the critical
       // section.
       AutoCriticalSection lock(&sync_);
@@ -532,46 +577,41 @@ void CrashGenerationServer::HandleReadingAckState() {
       bool client_is_still_alive = false;
       std::list<ClientInfo*>::iterator iter;
       for (iter = clients_.begin(); iter != clients_.end(); ++iter) {
-        if (client_info_ == *iter) {
+        if (instance->client_info == *iter) {
           client_is_still_alive = true;
           break;
         }
       }
 
       if (client_is_still_alive) {
-        connect_callback_(connect_context_, client_info_);
+        connect_callback_(connect_context_, instance->client_info);
       }
     }
   } else {
     assert(!CheckForIOIncomplete(success));
   }
 
-  EnterStateImmediately(IPC_SERVER_STATE_DISCONNECTING);
+  EnterStateImmediately(instance, IPC_SERVER_STATE_DISCONNECTING);
 }
 
 // When the server thread serving the client is in the DISCONNECTING state,
-// disconnect from the pipe and reset the event. If anything fails, go into
-// the ERROR state. If it goes well, go into the INITIAL state and set the
-// event to start all over again.
-void CrashGenerationServer::HandleDisconnectingState() {
-  assert(server_state_ == IPC_SERVER_STATE_DISCONNECTING);
+// disconnect from the pipe. If anything fails, go into the ERROR state. If
+// it goes well, go into the INITIAL state and queue a completion to start
+// all over again.
+void CrashGenerationServer::HandleDisconnectingState(PipeInstance* instance) {
+  assert(instance->state == IPC_SERVER_STATE_DISCONNECTING);
 
   // Done serving the client.
-  client_info_ = NULL;
+  instance->client_info = NULL;
 
-  overlapped_.Internal = NULL;
-  overlapped_.InternalHigh = NULL;
-  overlapped_.Offset = 0;
-  overlapped_.OffsetHigh = 0;
-  overlapped_.Pointer = NULL;
+  instance->overlapped.Internal = NULL;
+  instance->overlapped.InternalHigh = NULL;
+  instance->overlapped.Offset = 0;
+  instance->overlapped.OffsetHigh = 0;
+  instance->overlapped.Pointer = NULL;
 
-  if (!ResetEvent(overlapped_.hEvent)) {
-    EnterErrorState();
-    return;
-  }
-
-  if (!DisconnectNamedPipe(pipe_)) {
-    EnterErrorState();
+  if (!DisconnectNamedPipe(instance->pipe)) {
+    EnterErrorState(instance);
     return;
   }
 
@@ -581,23 +621,31 @@ void CrashGenerationServer::HandleDisconnectingState() {
     return;
   }
 
-  EnterStateImmediately(IPC_SERVER_STATE_INITIAL);
+  EnterStateImmediately(instance, IPC_SERVER_STATE_INITIAL);
 }
 
-void CrashGenerationServer::EnterErrorState() {
-  SetEvent(overlapped_.hEvent);
-  server_state_ = IPC_SERVER_STATE_ERROR;
+void CrashGenerationServer::EnterErrorState(PipeInstance* instance) {
+  instance->state = IPC_SERVER_STATE_ERROR;
+  PostQueuedCompletionStatus(completion_port_,
+                             0,
+                             reinterpret_cast<ULONG_PTR>(instance),
+                             NULL);
 }
 
-void CrashGenerationServer::EnterStateWhenSignaled(IPCServerState state) {
-  server_state_ = state;
+void CrashGenerationServer::EnterStateWhenSignaled(PipeInstance* instance,
+                                                   IPCServerState state) {
+  instance->state = state;
 }
 
-void CrashGenerationServer::EnterStateImmediately(IPCServerState state) {
-  server_state_ = state;
+void CrashGenerationServer::EnterStateImmediately(PipeInstance* instance,
+                                                  IPCServerState state) {
+  instance->state = state;
 
-  if (!SetEvent(overlapped_.hEvent)) {
-    server_state_ = IPC_SERVER_STATE_ERROR;
+  if (!PostQueuedCompletionStatus(completion_port_,
+                                  0,
+                                  reinterpret_cast<ULONG_PTR>(instance),
+                                  NULL)) {
+    instance->state = IPC_SERVER_STATE_ERROR;
   }
 }
 
@@ -645,6 +693,17 @@ bool CrashGenerationServer::PrepareReply(const ClientInfo& client_info,
     reply->server_alive_handle = NULL;
   }
 
+  if (reply->custom_info_section) {
+    DuplicateHandle(client_info.process_handle(),  // hSourceProcessHandle
+                    reply->custom_info_section,    // hSourceHandle
+                    NULL,                          // hTargetProcessHandle
+                    0,                             // lpTargetHandle
+                    0,                             // dwDesiredAccess
+                    FALSE,                         // bInheritHandle
+                    DUPLICATE_CLOSE_SOURCE);       // dwOptions
+    reply->custom_info_section = NULL;
+  }
+
   return false;
 }
 
@@ -681,21 +740,34 @@ bool CrashGenerationServer::CreateClientHandles(const ClientInfo& client_info,
     return false;
   }
 
+  // The client's custom info is read from its memory if it has no section.
+  if (client_info.custom_info_section() &&
+      !DuplicateHandle(current_process,
+                       client_info.custom_info_section(),
+                       client_info.process_handle(),
+                       &reply->custom_info_section,
+                       kCustomInfoSectionAccess,
+                       FALSE,
+                       0)) {
+    reply->custom_info_section = NULL;
+  }
+
   return true;
 }
 
-bool CrashGenerationServer::RespondToClient(ClientInfo* client_info) {
+bool CrashGenerationServer::RespondToClient(PipeInstance* instance,
+                                            ClientInfo* client_info) {
   ProtocolMessage reply;
   if (!PrepareReply(*client_info, &reply)) {
     return false;
   }
 
   DWORD bytes_count = 0;
-  bool success = WriteFile(pipe_,
+  bool success = WriteFile(instance->pipe,
                             &reply,
                             sizeof(reply),
                             &bytes_count,
-                            &overlapped_) != FALSE;
+                            &instance->overlapped) != FALSE;
   DWORD error_code = success ? ERROR_SUCCESS : GetLastError();
 
   if (!success && error_code != ERROR_IO_PENDING) {
@@ -707,64 +779,66 @@ bool CrashGenerationServer::RespondToClient(ClientInfo* client_info) {
   return AddClient(client_info);
 }
 
-// The server thread servicing the clients runs this method. The method
+// The completion threads servicing the clients run this method. The method
 // implements the state machine described in ReadMe.txt along with the
 // helper methods HandleXXXState.
-void CrashGenerationServer::HandleConnectionRequest() {
-  // If the server is shutting down, get into ERROR state, reset the event so
-  // more workers don't run and return immediately.
+void CrashGenerationServer::HandleConnectionRequest(
+    PipeInstance* instance) {
+  AutoCriticalSection lock(&instance->sync);
+
+  // If the server is shutting down, get into ERROR state without issuing
+  // more I/O and return immediately.
   if (shutting_down_) {
-    server_state_ = IPC_SERVER_STATE_ERROR;
-    ResetEvent(overlapped_.hEvent);
+    instance->state = IPC_SERVER_STATE_ERROR;
     return;
   }
 
-  switch (server_state_) {
+  switch (instance->state) {
     case IPC_SERVER_STATE_ERROR:
-      HandleErrorState();
+      HandleErrorState(instance);
       break;
 
     case IPC_SERVER_STATE_INITIAL:
-      HandleInitialState();
+      HandleInitialState(instance);
       break;
 
     case IPC_SERVER_STATE_CONNECTING:
-      HandleConnectingState();
+      HandleConnectingState(instance);
       break;
 
     case IPC_SERVER_STATE_CONNECTED:
-      HandleConnectedState();
+      HandleConnectedState(instance);
       break;
 
     case IPC_SERVER_STATE_READING:
-      HandleReadingState();
+      HandleReadingState(instance);
       break;
 
     case IPC_SERVER_STATE_READ_DONE:
-      HandleReadDoneState();
+      HandleReadDoneState(instance);
       break;
 
     case IPC_SERVER_STATE_WRITING:
-      HandleWritingState();
+      HandleWritingState(instance);
       break;
 
     case IPC_SERVER_STATE_WRITE_DONE:
-      HandleWriteDoneState();
+      HandleWriteDoneState(instance);
       break;
 
     case IPC_SERVER_STATE_READING_ACK:
-      HandleReadingAckState();
+      HandleReadingAckState(instance);
       break;
 
     case IPC_SERVER_STATE_DISCONNECTING:
-      HandleDisconnectingState();
+      HandleDisconnectingState(instance);
       break;
 
     default:
       assert(false);
       // This indicates that we added one more state without
       // adding handling code.
-      server_state_ = IPC_SERVER_STATE_ERROR;
+      instance->state = IPC_SERVER_STATE_ERROR;
       break;
   }
 }
@@ -809,12 +883,43 @@ bool CrashGenerationServer::AddClient(ClientInfo* client_info) {
 }
 
 // static
-void CALLBACK CrashGenerationServer::OnPipeConnected(void* context, BOOLEAN) {
+DWORD WINAPI CrashGenerationServer::CompletionThreadMain(void* context) {
   assert(context);
 
   CrashGenerationServer* obj =
       reinterpret_cast<CrashGenerationServer*>(context);
-  obj->HandleConnectionRequest();
+  for (;;) {
+    DWORD bytes_count = 0;
+    ULONG_PTR key = kQuitCompletionKey;
+    OVERLAPPED* overlapped = NULL;
+    // Failed I/O is dequeued too, with a FALSE result; the state machine
+    // gets the I/O's result from the pipe instance itself.
+    BOOL success = GetQueuedCompletionStatus(obj->completion_port_,
+                                             &bytes_count,
+                                             &key,
+                                             &overlapped,
+                                             INFINITE);
+    if (!success && !overlapped) {
+      // The port itself failed.
+      break;
+    }
+    if (key == kQuitCompletionKey) {
+      break;
+    }
+    obj->HandleConnectionRequest(reinterpret_cast<PipeInstance*>(key));
+  }
+  return 0;
+}
+
+bool CrashGenerationServer::AllInstancesStopped() const {
+  for (size_t i = 0; i < instances_.size(); ++i) {
+    IPCServerState state = instances_[i]->state;
+    if (state != IPC_SERVER_STATE_ERROR &&
+        state != IPC_SERVER_STATE_UNINITIALIZED) {
+      return false;
+    }
+  }
+  return true;
 }
 
 // static
@@ -922,6 +1027,7 @@ bool CrashGenerationServer::GenerateDump(const ClientInfo& client,
                                    client.assert_info(),
                                    client.dump_type(),
                                    true);
+  dump_generator.set_memory_budget(dump_memory_budget_);
   if (!dump_generator.GenerateDumpFile(dump_path)) {
     return false;
   }
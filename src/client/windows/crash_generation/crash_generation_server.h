@@ -32,6 +32,7 @@
 
 #include <list>
 #include <string>
+#include <vector>
 #include "client/windows/common/ipc_protocol.h"
 #include "client/windows/crash_generation/minidump_generator.h"
 #include "common/scoped_ptr.h"
@@ -44,7 +45,8 @@ class ClientInfo;
 // minidump files for client processes that request dump generation. When
 // the server is requested to start listening for clients (by calling the
 // Start method), it creates a named pipe and waits for the clients to
-// register. In response, it hands them event handles that the client can
+// register, handshaking with as many of them at once as the pipe has
+// instances. In response, it hands them event handles that the client can
 // signal to request dump generation. When the clients request dump
 // generation in this way, the server generates Windows minidump files.
 class CrashGenerationServer {
@@ -106,6 +108,23 @@ class CrashGenerationServer {
     pre_fetch_custom_info_ = do_pre_fetch;
   }
 
+  // Limits the memory in each generated dump to about |bytes|; see
+  // MinidumpGenerator::set_memory_budget. 0, the default, means no limit.
+  void set_dump_memory_budget(size_t bytes) {
+    dump_memory_budget_ = bytes;
+  }
+
+  // Sets the number of instances of the pipe, which is how many clients
+  // can be registering at the same time.  With the default of 1, clients
+  // that start together register one after another, each waiting for the
+  // pipe while the others handshake.  Servers with many clients starting
+  // at once should use more; 0 means one instance per processor.  The
+  // instances are serviced by a pool of threads, at most one per
+  // processor.  Must be called before Start.
+  void set_pipe_instance_count(int count) {
+    pipe_instance_count_ = count;
+  }
+
  private:
   // Various states the client can be in during the handshake with
   // the server.
@@ -149,19 +168,47 @@ class CrashGenerationServer {
     IPC_SERVER_STATE_DISCONNECTING
   };
 
+  // One instance of the named pipe, with the state of the handshake with
+  // the client connected to it.  Completions of its I/O are queued on the
+  // server's completion port with the instance as the key.
+  struct PipeInstance {
+    PipeInstance();
+    ~PipeInstance();
+
+    // Handle to the pipe instance.
+    HANDLE pipe;
+
+    // State of the server in performing the IPC with the client.
+    IPCServerState state;
+
+    // Overlapped instance for async I/O on the pipe.
+    OVERLAPPED overlapped;
+
+    // Message object used in IPC with the client.
+    ProtocolMessage msg;
+
+    // Client Info for the client that's connecting to the server.
+    ClientInfo* client_info;
+
+    // Held while a completion thread runs the state machine, so that the
+    // completion of I/O issued in one state is not handled until the
+    // state has been left.
+    CRITICAL_SECTION sync;
+  };
+
   //
   // Helper methods to handle various server IPC states.
   //
-  void HandleErrorState();
-  void HandleInitialState();
-  void HandleConnectingState();
-  void HandleConnectedState();
-  void HandleReadingState();
-  void HandleReadDoneState();
-  void HandleWritingState();
-  void HandleWriteDoneState();
-  void HandleReadingAckState();
-  void HandleDisconnectingState();
+  void HandleErrorState(PipeInstance* instance);
+  void HandleInitialState(PipeInstance* instance);
+  void HandleConnectingState(PipeInstance* instance);
+  void HandleConnectedState(PipeInstance* instance);
+  void HandleReadingState(PipeInstance* instance);
+  void HandleReadDoneState(PipeInstance* instance);
+  void HandleWritingState(PipeInstance* instance);
+  void HandleWriteDoneState(PipeInstance* instance);
+  void HandleReadingAckState(PipeInstance* instance);
+  void HandleDisconnectingState(PipeInstance* instance);
 
   // Prepares reply for a client from the given parameters.
   bool PrepareReply(const ClientInfo& client_info,
@@ -174,18 +221,23 @@ class CrashGenerationServer {
   bool CreateClientHandles(const ClientInfo& client_info,
                            ProtocolMessage* reply) const;
 
-  // Response to the given client. Return true if all steps of
-  // responding to the client succeed, false otherwise.
-  bool RespondToClient(ClientInfo* client_info);
+  // Response to the given client on the given pipe instance. Return true
+  // if all steps of responding to the client succeed, false otherwise.
+  bool RespondToClient(PipeInstance* instance, ClientInfo* client_info);
 
-  // Handles a connection request from the client.
-  void HandleConnectionRequest();
+  // Handles a connection request from the client on the given pipe
+  // instance.
+  void HandleConnectionRequest(PipeInstance* instance);
 
   // Handles a dump request from the client.
   void HandleDumpRequest(const ClientInfo& client_info);
 
-  // Callback for pipe connected event.
-  static void CALLBACK OnPipeConnected(void* context, BOOLEAN timer_or_wait);
+  // Thread procedure of the threads servicing the completion port.
+  static DWORD WINAPI CompletionThreadMain(void* context);
+
+  // Returns true once no pipe instance has I/O or a state transition
+  // pending.  Only meaningful after shutting_down_ is set.
+  bool AllInstancesStopped() const;
 
   // Callback for a dump request.
   static void CALLBACK OnDumpRequest(void* context, BOOLEAN timer_or_wait);
@@ -202,20 +254,20 @@ class CrashGenerationServer {
   // Generates dump for the given client.
   bool GenerateDump(const ClientInfo& client, std::wstring* dump_path);
 
-  // Puts the server in a permanent error state and sets a signal such that
-  // the state will be immediately entered after the current state transition
-  // is complete.
-  void EnterErrorState();
+  // Puts the pipe instance in a permanent error state and queues a
+  // completion such that the state will be immediately entered after the
+  // current state transition is complete.
+  void EnterErrorState(PipeInstance* instance);
 
-  // Puts the server in the specified state and sets a signal such that the
-  // state is immediately entered after the current state transition is
-  // complete.
-  void EnterStateImmediately(IPCServerState state);
+  // Puts the pipe instance in the specified state and queues a completion
+  // such that the state is immediately entered after the current state
+  // transition is complete.
+  void EnterStateImmediately(PipeInstance* instance, IPCServerState state);
 
-  // Puts the server in the specified state. No signal will be set, so the state
-  // transition will only occur when signaled manually or by completion of an
+  // Puts the pipe instance in the specified state. No completion will be
+  // queued, so the state transition will only occur on completion of an
   // asynchronous IO operation.
-  void EnterStateWhenSignaled(IPCServerState state);
+  void EnterStateWhenSignaled(PipeInstance* instance, IPCServerState state);
 
   // Sync object for thread-safe access to the shared list of clients.
   CRITICAL_SECTION sync_;
@@ -229,11 +281,17 @@ class CrashGenerationServer {
   // Pipe security attributes
   SECURITY_ATTRIBUTES* pipe_sec_attrs_;
 
-  // Handle to the pipe used for handshake with clients.
-  HANDLE pipe_;
+  // Number of pipe instances to create; see set_pipe_instance_count.
+  int pipe_instance_count_;
+
+  // Instances of the pipe used for handshake with clients.
+  std::vector<PipeInstance*> instances_;
+
+  // Completion port for I/O on the pipe instances.
+  HANDLE completion_port_;
 
-  // Pipe wait handle.
-  HANDLE pipe_wait_handle_;
+  // Threads servicing completion_port_.
+  std::vector<HANDLE> completion_threads_;
 
   // Handle to server-alive mutex.
   HANDLE server_alive_handle_;
@@ -265,30 +323,21 @@ class CrashGenerationServer {
   // Whether to generate dumps.
   bool generate_dumps_;
 
+  // See set_dump_memory_budget.
+  size_t dump_memory_budget_;
+
   // Wether to populate custom information up-front.
   bool pre_fetch_custom_info_;
 
   // The dump path for the server.
   const std::wstring dump_path_;
 
-  // State of the server in performing the IPC with the client.
-  // Note that since we restrict the pipe to one instance, we
-  // only need to keep one state of the server. Otherwise, server
-  // would have one state per client it is talking to.
-  IPCServerState server_state_;
+  // Whether Start has been called.
+  bool started_;
 
   // Whether the server is shutting down.
   bool shutting_down_;
 
-  // Overlapped instance for async I/O on the pipe.
-  OVERLAPPED overlapped_;
-
-  // Message object used in IPC with the client.
-  ProtocolMessage msg_;
-
-  // Client Info for the client that's connecting to the server.
-  ClientInfo* client_info_;
-
   // Disable copy ctor and operator=.
   CrashGenerationServer(const CrashGenerationServer& crash_server);
   CrashGenerationServer& operator=(const CrashGenerationServer& crash_server);
@@ -0,0 +1,144 @@
+// Copyright (c) 2016, Google Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+// notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above
+// copyright notice, this list of conditions and the following disclaimer
+// in the documentation and/or other materials provided with the
+// distribution.
+//     * Neither the name of Google Inc. nor the names of its
+// contributors may be used to endorse or promote products derived from
+// this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "client/windows/crash_generation/dump_scheduler.h"
+
+#include <assert.h>
+
+#include "client/windows/common/auto_critical_section.h"
+
+namespace google_breakpad {
+
+// Dumps allowed at once by the shared scheduler.
+static const int kDefaultMaxConcurrentDumps = 2;
+
+DumpScheduler::DumpScheduler(int max_concurrent_dumps)
+    : max_concurrent_dumps_(max_concurrent_dumps < 1 ? 1
+                                                     : max_concurrent_dumps),
+      active_dumps_(0) {
+  InitializeCriticalSection(&sync_);
+  InitializeCriticalSection(&dbghelp_lock_);
+}
+
+DumpScheduler::~DumpScheduler() {
+  assert(active_dumps_ == 0);
+  assert(waiting_crash_dumps_.empty() && waiting_diagnostic_dumps_.empty());
+  DeleteCriticalSection(&dbghelp_lock_);
+  DeleteCriticalSection(&sync_);
+}
+
+// static
+DumpScheduler* DumpScheduler::GetInstance() {
+  static DumpScheduler* volatile instance = NULL;
+  if (!instance) {
+    DumpScheduler* scheduler = new DumpScheduler(kDefaultMaxConcurrentDumps);
+    if (InterlockedCompareExchangePointer(
+            reinterpret_cast<PVOID volatile*>(&instance),
+            scheduler,
+            NULL) != NULL) {
+      // Another thread created it first.
+      delete scheduler;
+    }
+  }
+  return instance;
+}
+
+void DumpScheduler::set_max_concurrent_dumps(int max_concurrent_dumps) {
+  AutoCriticalSection lock(&sync_);
+  max_concurrent_dumps_ = max_concurrent_dumps < 1 ? 1 : max_concurrent_dumps;
+  AdmitWaitingDumps();
+}
+
+void DumpScheduler::BeginDump(Priority priority) {
+  HANDLE admitted = NULL;
+  {
+    AutoCriticalSection lock(&sync_);
+    // Dumps that arrive while others of the same or higher priority wait
+    // get in line behind them.
+    bool others_first = !waiting_crash_dumps_.empty() ||
+        (priority == PRIORITY_DIAGNOSTIC &&
+         !waiting_diagnostic_dumps_.empty());
+    if (active_dumps_ < max_concurrent_dumps_ && !others_first) {
+      ++active_dumps_;
+      return;
+    }
+
+    admitted = CreateEvent(NULL, FALSE, FALSE, NULL);
+    if (!admitted) {
+      // Write the dump anyway rather than lose it.
+      ++active_dumps_;
+      return;
+    }
+    if (priority == PRIORITY_CRASH) {
+      waiting_crash_dumps_.push_back(admitted);
+    } else {
+      waiting_diagnostic_dumps_.push_back(admitted);
+    }
+  }
+
+  // EndDump counts this dump as active when it admits it.
+  WaitForSingleObject(admitted, INFINITE);
+  CloseHandle(admitted);
+}
+
+void DumpScheduler::EndDump() {
+  AutoCriticalSection lock(&sync_);
+  assert(active_dumps_ > 0);
+  --active_dumps_;
+  AdmitWaitingDumps();
+}
+
+int DumpScheduler::active_dumps() const {
+  AutoCriticalSection lock(&sync_);
+  return active_dumps_;
+}
+
+int DumpScheduler::waiting_dumps() const {
+  AutoCriticalSection lock(&sync_);
+  return static_cast<int>(waiting_crash_dumps_.size() +
+                          waiting_diagnostic_dumps_.size());
+}
+
+void DumpScheduler::AdmitWaitingDumps() {
+  while (active_dumps_ < max_concurrent_dumps_) {
+    std::deque<HANDLE>* queue = &waiting_crash_dumps_;
+    if (queue->empty()) {
+      queue = &waiting_diagnostic_dumps_;
+    }
+    if (queue->empty()) {
+      return;
+    }
+    HANDLE admitted = queue->front();
+    queue->pop_front();
+    ++active_dumps_;
+    SetEvent(admitted);
+  }
+}
+
+}  // namespace google_breakpad
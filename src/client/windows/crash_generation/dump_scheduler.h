@@ -0,0 +1,133 @@
+// Copyright (c) 2016, Google Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+// notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above
+// copyright notice, this list of conditions and the following disclaimer
+// in the documentation and/or other materials provided with the
+// distribution.
+//     * Neither the name of Google Inc. nor the names of its
+// contributors may be used to endorse or promote products derived from
+// this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef CLIENT_WINDOWS_CRASH_GENERATION_DUMP_SCHEDULER_H_
+#define CLIENT_WINDOWS_CRASH_GENERATION_DUMP_SCHEDULER_H_
+
+#include <windows.h>
+
+#include <deque>
+
+namespace google_breakpad {
+
+// Admits minidump writes in priority order, a bounded number at a time, and
+// owns the lock that serializes calls into dbghelp, which is not
+// thread-safe.
+//
+// Without it, every client that crashes during a crash storm starts writing
+// its dump at once on its own thread pool thread, and all of them contend
+// for dbghelp.  With it, a few dumps are in progress at any time, the rest
+// wait in line, and dumps of crashed clients go ahead of diagnostic dumps
+// of live processes.
+class DumpScheduler {
+ public:
+  enum Priority {
+    // Dumps of clients that crashed or asked for a dump, as written by
+    // CrashGenerationServer.
+    PRIORITY_CRASH,
+
+    // Dumps taken for diagnostics, such as by
+    // ExceptionHandler::WriteMinidumpForChild.
+    PRIORITY_DIAGNOSTIC
+  };
+
+  // Admits one dump for the lifetime of the object.
+  class AutoDump {
+   public:
+    AutoDump(DumpScheduler* scheduler, Priority priority)
+        : scheduler_(scheduler) {
+      scheduler_->BeginDump(priority);
+    }
+    ~AutoDump() { scheduler_->EndDump(); }
+
+   private:
+    // Disable copy ctor and operator=.
+    AutoDump(const AutoDump&);
+    AutoDump& operator=(const AutoDump&);
+
+    DumpScheduler* scheduler_;
+  };
+
+  // Creates a scheduler that lets up to max_concurrent_dumps dumps be in
+  // progress at once.
+  explicit DumpScheduler(int max_concurrent_dumps);
+  ~DumpScheduler();
+
+  // Returns the scheduler shared by all dump writers in the process.  It
+  // allows two dumps at once, so that one can be prepared while another
+  // is in dbghelp.
+  static DumpScheduler* GetInstance();
+
+  // Changes the number of dumps that may be in progress at once, admitting
+  // waiting dumps if it grows.  Values below 1 are treated as 1.
+  void set_max_concurrent_dumps(int max_concurrent_dumps);
+  int max_concurrent_dumps() const { return max_concurrent_dumps_; }
+
+  // Blocks until a dump of the given priority may be written.  Waiting
+  // crash dumps are admitted before waiting diagnostic dumps, and dumps of
+  // the same priority in the order they arrived.  Every call must be
+  // matched by a call to EndDump.
+  void BeginDump(Priority priority);
+
+  // Ends a dump admitted by BeginDump, admitting the next waiting one.
+  void EndDump();
+
+  // The number of dumps in progress and waiting.
+  int active_dumps() const;
+  int waiting_dumps() const;
+
+  // The lock that every call into dbghelp made while writing a dump must
+  // hold.
+  CRITICAL_SECTION* dbghelp_lock() { return &dbghelp_lock_; }
+
+ private:
+  // Admits waiting dumps while there is room.  The caller must hold sync_.
+  void AdmitWaitingDumps();
+
+  // Sync object for the counts and queues below.
+  mutable CRITICAL_SECTION sync_;
+
+  // See dbghelp_lock().
+  CRITICAL_SECTION dbghelp_lock_;
+
+  int max_concurrent_dumps_;
+  int active_dumps_;
+
+  // Events of the dumps waiting to be admitted, one queue per priority.
+  std::deque<HANDLE> waiting_crash_dumps_;
+  std::deque<HANDLE> waiting_diagnostic_dumps_;
+
+  // Disable copy ctor and operator=.
+  DumpScheduler(const DumpScheduler&);
+  DumpScheduler& operator=(const DumpScheduler&);
+};
+
+}  // namespace google_breakpad
+
+#endif  // CLIENT_WINDOWS_CRASH_GENERATION_DUMP_SCHEDULER_H_
@@ -244,6 +244,306 @@ ULONG CALLBACK HandleTraceData::RecordHandleOperations(
   return ERROR_SUCCESS;
 }
 
+// Bytes of memory included around each register of the crashing thread in
+// budgeted dumps, half of them below the address it holds.
+const ULONG kRegisterMemorySize = 1024;
+
+// Register values below this are taken to be small integers rather than
+// addresses.
+const ULONG64 kMinRegisterAddress = 0x10000;
+
+// A helper class used to keep the memory in a minidump within a budget.
+// Acting as the MINIDUMP_CALLBACK_ROUTINE, it includes each thread's stack
+// while the budget allows (the crashing thread's in any case), then the
+// memory around the addresses in the crashing thread's registers, then
+// pages sampled evenly from the process's private read-write memory, until
+// the budget is spent.
+class MemoryBudget {
+ public:
+  // Any callback in |chained_callback| is called first, and memory it adds
+  // is included without counting against the budget.
+  MemoryBudget(HANDLE process_handle,
+               DWORD crashing_thread_id,
+               size_t budget,
+               MINIDUMP_CALLBACK_INFORMATION* chained_callback);
+
+  // Fills |callback_info| to have MiniDumpWriteDump call this object.
+  void GetCallbackInformation(MINIDUMP_CALLBACK_INFORMATION* callback_info);
+
+ private:
+  struct Range {
+    ULONG64 base;
+    ULONG64 size;
+  };
+
+  static BOOL CALLBACK Callback(PVOID context,
+                                const PMINIDUMP_CALLBACK_INPUT input,
+                                PMINIDUMP_CALLBACK_OUTPUT output);
+
+  // Decides whether to keep the stack of |thread|, and notes the crashing
+  // thread's registers.
+  void OnThread(const MINIDUMP_THREAD_CALLBACK& thread, ULONG* write_flags);
+
+  // Produces the next range of memory to add, returning false when done.
+  bool OnMemory(ULONG64* base, ULONG* size);
+
+  // Adds the readable parts of [base, base + size) to ranges_, as far as
+  // the budget allows. Returns false once the budget is spent.
+  bool AddRange(ULONG64 base, ULONG64 size);
+
+  // Adds pages sampled evenly from the private read-write memory of the
+  // process, outside the stacks, to fill the rest of the budget.
+  void SampleHeap();
+
+  // Returns whether |address| falls in one of the stacks.
+  bool IsInStack(ULONG64 address) const;
+
+  HANDLE process_handle_;
+  DWORD crashing_thread_id_;
+  size_t budget_;
+  size_t used_;
+  MINIDUMP_CALLBACK_INFORMATION* chained_callback_;
+
+  // Register values of the crashing thread.
+  std::vector<ULONG64> registers_;
+
+  // The stacks of all threads, whether included or not.
+  std::vector<Range> stacks_;
+
+  // Memory to add, in order, and the next one to hand out.
+  std::vector<Range> ranges_;
+  size_t next_range_;
+  bool planned_;
+};
+
+MemoryBudget::MemoryBudget(HANDLE process_handle,
+                           DWORD crashing_thread_id,
+                           size_t budget,
+                           MINIDUMP_CALLBACK_INFORMATION* chained_callback)
+    : process_handle_(process_handle),
+      crashing_thread_id_(crashing_thread_id),
+      budget_(budget),
+      used_(0),
+      chained_callback_(chained_callback),
+      next_range_(0),
+      planned_(false) {
+}
+
+void MemoryBudget::GetCallbackInformation(
+    MINIDUMP_CALLBACK_INFORMATION* callback_info) {
+  callback_info->CallbackRoutine = Callback;
+  callback_info->CallbackParam = this;
+}
+
+// static
+BOOL CALLBACK MemoryBudget::Callback(PVOID context,
+                                     const PMINIDUMP_CALLBACK_INPUT input,
+                                     PMINIDUMP_CALLBACK_OUTPUT output) {
+  MemoryBudget* self = reinterpret_cast<MemoryBudget*>(context);
+
+  BOOL result = TRUE;
+  if (self->chained_callback_ && self->chained_callback_->CallbackRoutine) {
+    result = self->chained_callback_->CallbackRoutine(
+        self->chained_callback_->CallbackParam, input, output);
+  }
+
+  switch (input->CallbackType) {
+    case ThreadCallback:
+      self->OnThread(input->Thread, &output->ThreadWriteFlags);
+      return result;
+
+    case MemoryCallback:
+      // Memory the chained callback adds goes first.
+      if (result && output->MemorySize != 0) {
+        return TRUE;
+      }
+      return self->OnMemory(&output->MemoryBase, &output->MemorySize);
+
+    default:
+      return result;
+  }
+}
+
+void MemoryBudget::OnThread(const MINIDUMP_THREAD_CALLBACK& thread,
+                            ULONG* write_flags) {
+  const CONTEXT& context = thread.Context;
+#if defined(_M_IX86)
+  ULONG64 stack_pointer = context.Esp;
+#elif defined(_M_X64)
+  ULONG64 stack_pointer = context.Rsp;
+#else
+  ULONG64 stack_pointer = 0;
+#endif
+
+  // Only the part of the stack above the stack pointer is written.
+  ULONG64 stack_top = thread.StackBase > thread.StackEnd ? thread.StackBase
+                                                         : thread.StackEnd;
+  ULONG64 stack_bottom = thread.StackBase > thread.StackEnd ? thread.StackEnd
+                                                            : thread.StackBase;
+  Range stack = { stack_bottom, stack_top - stack_bottom };
+  stacks_.push_back(stack);
+  if (stack_pointer > stack_bottom && stack_pointer < stack_top) {
+    stack_bottom = stack_pointer;
+  }
+  size_t stack_size = static_cast<size_t>(stack_top - stack_bottom);
+
+  if (thread.ThreadId == crashing_thread_id_) {
+    used_ += stack_size;
+#if defined(_M_IX86)
+    ULONG64 registers[] = {
+      context.Eax, context.Ebx, context.Ecx, context.Edx,
+      context.Esi, context.Edi, context.Ebp, context.Esp, context.Eip
+    };
+#elif defined(_M_X64)
+    ULONG64 registers[] = {
+      context.Rax, context.Rbx, context.Rcx, context.Rdx,
+      context.Rsi, context.Rdi, context.Rbp, context.Rsp,
+      context.R8, context.R9, context.R10, context.R11,
+      context.R12, context.R13, context.R14, context.R15,
+      context.Rip
+    };
+#else
+    ULONG64 registers[] = { 0 };
+#endif
+    registers_.assign(registers,
+                      registers + sizeof(registers) / sizeof(registers[0]));
+    return;
+  }
+
+  if (used_ + stack_size > budget_) {
+    *write_flags &= ~ThreadWriteStack;
+    return;
+  }
+  used_ += stack_size;
+}
+
+bool MemoryBudget::OnMemory(ULONG64* base, ULONG* size) {
+  if (!planned_) {
+    // All threads have been seen by now, so the stacks are accounted for.
+    planned_ = true;
+    for (size_t i = 0; i < registers_.size(); ++i) {
+      ULONG64 address = registers_[i];
+      if (address < kMinRegisterAddress || IsInStack(address)) {
+        continue;
+      }
+      if (!AddRange(address - kRegisterMemorySize / 2, kRegisterMemorySize)) {
+        break;
+      }
+    }
+    SampleHeap();
+  }
+
+  if (next_range_ == ranges_.size()) {
+    return false;
+  }
+  *base = ranges_[next_range_].base;
+  *size = static_cast<ULONG>(ranges_[next_range_].size);
+  ++next_range_;
+  return true;
+}
+
+bool MemoryBudget::AddRange(ULONG64 base, ULONG64 size) {
+  ULONG64 end = base + size;
+  while (base < end) {
+    if (used_ >= budget_) {
+      return false;
+    }
+
+    MEMORY_BASIC_INFORMATION info;
+    if (!VirtualQueryEx(process_handle_,
+                        reinterpret_cast<void*>(base),
+                        &info,
+                        sizeof(info))) {
+      return true;
+    }
+    ULONG64 region_end = reinterpret_cast<ULONG64>(info.BaseAddress) +
+                         info.RegionSize;
+    ULONG64 chunk_end = region_end < end ? region_end : end;
+    bool readable = info.State == MEM_COMMIT &&
+                    (info.Protect & (PAGE_NOACCESS | PAGE_GUARD)) == 0;
+    if (readable) {
+      ULONG64 chunk_size = chunk_end - base;
+      if (chunk_size > budget_ - used_) {
+        chunk_size = budget_ - used_;
+      }
+      Range range = { base, chunk_size };
+      ranges_.push_back(range);
+      used_ += static_cast<size_t>(chunk_size);
+    }
+    base = chunk_end;
+  }
+  return used_ < budget_;
+}
+
+void MemoryBudget::SampleHeap() {
+  if (used_ >= budget_) {
+    return;
+  }
+
+  SYSTEM_INFO system_info;
+  GetSystemInfo(&system_info);
+  ULONG64 page_size = system_info.dwPageSize;
+
+  // Find the candidate pages first, so that the samples can be spread over
+  // all of them.
+  std::vector<Range> regions;
+  ULONG64 page_count = 0;
+  ULONG64 address = 0;
+  MEMORY_BASIC_INFORMATION info;
+  while (VirtualQueryEx(process_handle_,
+                        reinterpret_cast<void*>(address),
+                        &info,
+                        sizeof(info))) {
+    ULONG64 region_base = reinterpret_cast<ULONG64>(info.BaseAddress);
+    if (info.State == MEM_COMMIT && info.Type == MEM_PRIVATE &&
+        (info.Protect & PAGE_READWRITE) != 0 &&
+        (info.Protect & PAGE_GUARD) == 0 &&
+        !IsInStack(region_base)) {
+      Range region = { region_base, info.RegionSize };
+      regions.push_back(region);
+      page_count += info.RegionSize / page_size;
+    }
+    ULONG64 next = region_base + info.RegionSize;
+    if (next <= address) {
+      break;
+    }
+    address = next;
+  }
+
+  ULONG64 sample_count = (budget_ - used_) / page_size;
+  if (page_count == 0 || sample_count == 0) {
+    return;
+  }
+  ULONG64 stride = (page_count + sample_count - 1) / sample_count;
+
+  ULONG64 page_index = 0;
+  for (size_t i = 0; i < regions.size(); ++i) {
+    for (ULONG64 page = regions[i].base;
+         page < regions[i].base + regions[i].size;
+         page += page_size, ++page_index) {
+      if (page_index % stride != 0) {
+        continue;
+      }
+      if (used_ + page_size > budget_) {
+        return;
+      }
+      Range range = { page, page_size };
+      ranges_.push_back(range);
+      used_ += static_cast<size_t>(page_size);
+    }
+  }
+}
+
+bool MemoryBudget::IsInStack(ULONG64 address) const {
+  for (size_t i = 0; i < stacks_.size(); ++i) {
+    if (address >= stacks_[i].base &&
+        address - stacks_[i].base < stacks_[i].size) {
+      return true;
+    }
+  }
+  return false;
+}
+
 }  // namespace
 
 namespace google_breakpad {
@@ -275,6 +575,8 @@ MinidumpGenerator::MinidumpGenerator(
       full_dump_file_is_internal_(false),
       additional_streams_(NULL),
       callback_info_(NULL),
+      priority_(DumpScheduler::PRIORITY_CRASH),
+      memory_budget_(0),
       write_dump_(NULL),
       create_uuid_(NULL) {
   InitializeCriticalSection(&module_load_sync_);
@@ -314,6 +616,9 @@ bool MinidumpGenerator::WriteMinidump() {
     return false;
   }
 
+  DumpScheduler* scheduler = DumpScheduler::GetInstance();
+  DumpScheduler::AutoDump admitted(scheduler, priority_);
+
   MINIDUMP_EXCEPTION_INFORMATION* dump_exception_pointers = NULL;
   MINIDUMP_EXCEPTION_INFORMATION dump_exception_info;
 
@@ -424,6 +729,7 @@ bool MinidumpGenerator::WriteMinidump() {
 
   bool result_full_memory = true;
   if (full_memory_dump) {
+    AutoCriticalSection dbghelp_lock(scheduler->dbghelp_lock());
     result_full_memory = write_dump(
         process_handle_,
         process_id_,
@@ -441,15 +747,34 @@ bool MinidumpGenerator::WriteMinidump() {
     ++user_streams.UserStreamCount;
   }
 
+  MINIDUMP_TYPE minidump_type =
+      static_cast<MINIDUMP_TYPE>((dump_type_ & (~MiniDumpWithFullMemory))
+                                  | MiniDumpNormal);
+  MINIDUMP_CALLBACK_INFORMATION* minidump_callback = callback_info_;
+
+  // With a memory budget, the budget decides what memory goes in, rather
+  // than the dump type.
+  MemoryBudget memory_budget(process_handle_, thread_id_, memory_budget_,
+                             callback_info_);
+  MINIDUMP_CALLBACK_INFORMATION budget_callback;
+  if (memory_budget_) {
+    minidump_type = static_cast<MINIDUMP_TYPE>(
+        minidump_type & ~(MiniDumpWithIndirectlyReferencedMemory |
+                          MiniDumpWithPrivateReadWriteMemory |
+                          MiniDumpWithDataSegs));
+    memory_budget.GetCallbackInformation(&budget_callback);
+    minidump_callback = &budget_callback;
+  }
+
+  AutoCriticalSection dbghelp_lock(scheduler->dbghelp_lock());
   bool result_minidump = write_dump(
       process_handle_,
       process_id_,
       dump_file_,
-      static_cast<MINIDUMP_TYPE>((dump_type_ & (~MiniDumpWithFullMemory))
-                                  | MiniDumpNormal),
+      minidump_type,
       exception_pointers_ ? &dump_exception_info : NULL,
       &user_streams,
-      callback_info_) != FALSE;
+      minidump_callback) != FALSE;
 
   return result_minidump && result_full_memory;
 }
@@ -35,6 +35,7 @@
 #include <rpc.h>
 #include <list>
 #include <string>
+#include "client/windows/crash_generation/dump_scheduler.h"
 #include "google_breakpad/common/minidump_format.h"
 
 namespace google_breakpad {
@@ -90,9 +91,23 @@ class MinidumpGenerator {
     callback_info_ = callback_info;
   }
 
+  // Limits the memory written to the minidump to about |bytes|, chosen in
+  // order of usefulness: each thread's stack in full, then memory around
+  // the addresses in the crashing thread's registers, then pages sampled
+  // from the process's heap. The dump type's own memory flags are ignored.
+  // 0, the default, disables the budget. Doesn't affect the full memory
+  // dump, if one is requested.
+  void set_memory_budget(size_t bytes) { memory_budget_ = bytes; }
+
+  // Sets the priority with which WriteMinidump waits its turn in the
+  // process's DumpScheduler. The default is DumpScheduler::PRIORITY_CRASH.
+  void set_priority(DumpScheduler::Priority priority) {
+    priority_ = priority;
+  }
+
   // Writes the minidump with the given parameters. Stores the
   // dump file path in the dump_path parameter if dump generation
-  // succeeds.
+  // succeeds. Waits for the DumpScheduler to admit the dump first.
   bool WriteMinidump();
 
  private:
@@ -186,6 +201,12 @@ class MinidumpGenerator {
   // The user defined callback for the various stages of the dump process.
   MINIDUMP_CALLBACK_INFORMATION* callback_info_;
 
+  // Priority of the dump in the DumpScheduler.
+  DumpScheduler::Priority priority_;
+
+  // See set_memory_budget.
+  size_t memory_budget_;
+
   // Critical section to sychronize action of loading modules dynamically.
   CRITICAL_SECTION module_load_sync_;
 
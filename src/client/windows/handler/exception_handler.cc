@@ -35,7 +35,9 @@
 
 #include "common/windows/string_utils-inl.h"
 
+#include "client/windows/common/auto_critical_section.h"
 #include "client/windows/common/ipc_protocol.h"
+#include "client/windows/crash_generation/dump_scheduler.h"
 #include "client/windows/handler/exception_handler.h"
 #include "common/windows/guid_string.h"
 
@@ -57,6 +59,191 @@ vector<ExceptionHandler*>* ExceptionHandler::handler_stack_ = NULL;
 LONG ExceptionHandler::handler_stack_index_ = 0;
 CRITICAL_SECTION ExceptionHandler::handler_stack_critical_section_;
 volatile LONG ExceptionHandler::instance_count_ = 0;
+volatile bool ExceptionHandler::share_handler_thread_ = false;
+ExceptionHandler::HandlerThread*
+    ExceptionHandler::shared_handler_thread_ = NULL;
+LONG ExceptionHandler::shared_handler_thread_users_ = 0;
+
+// A thread on which ExceptionHandlers write minidumps.  Each handler writes
+// its dumps on a thread other than the requesting one because that's the
+// only way to reliably guarantee sufficient stack space in an exception,
+// and it allows an easy way to get a snapshot of the requesting thread's
+// context outside of an exception.
+class ExceptionHandler::HandlerThread {
+ public:
+  // Creates the synchronization primitives and starts the thread.  If that
+  // fails, IsValid() returns false and every request fails.
+  HandlerThread();
+
+  // Stops the thread, which must no longer be in use.
+  ~HandlerThread();
+
+  bool IsValid() const { return thread_ != NULL; }
+
+  // Has the thread call handler->WriteMinidumpWithException on behalf of
+  // the calling thread, waits for it, and returns its result.  Requests
+  // made at the same time, through any handler using this thread, are
+  // handled one after another.
+  bool WriteMinidump(ExceptionHandler* handler,
+                     EXCEPTION_POINTERS* exinfo,
+                     MDRawAssertionInfo* assertion);
+
+ private:
+  // Runs the main loop for the handler thread.
+  static DWORD WINAPI ThreadMain(void* lpParameter);
+
+  HANDLE thread_;
+  DWORD thread_id_;
+
+  // True if the thread is being stopped.
+  // Starting with MSVC 2005, Visual C has stronger guarantees on volatile vars.
+  // It has release semantics on write and acquire semantics on reads.
+  // See the msdn documentation.
+  volatile bool is_shutdown_;
+
+  // The critical section enforcing the requirement that only one request be
+  // handled at a time.
+  CRITICAL_SECTION critical_section_;
+
+  // Semaphores used to move a request between the requesting thread and
+  // the handler thread.  start_semaphore_ is signalled by the requesting
+  // thread to wake up the handler thread.  finish_semaphore_ is signalled by
+  // the handler thread to wake up the requesting thread when the request is
+  // complete.
+  HANDLE start_semaphore_;
+  HANDLE finish_semaphore_;
+
+  // The handler the current request was made through, and the result of
+  // the request, passed from the handler thread back to the requesting
+  // thread.
+  ExceptionHandler* handler_;
+  bool return_value_;
+
+  // disallow copy ctor and operator=
+  explicit HandlerThread(const HandlerThread&);
+  void operator=(const HandlerThread&);
+};
+
+ExceptionHandler::HandlerThread::HandlerThread()
+    : thread_(NULL),
+      thread_id_(0),
+      is_shutdown_(false),
+      start_semaphore_(NULL),
+      finish_semaphore_(NULL),
+      handler_(NULL),
+      return_value_(false) {
+  InitializeCriticalSection(&critical_section_);
+  start_semaphore_ = CreateSemaphore(NULL, 0, 1, NULL);
+  assert(start_semaphore_ != NULL);
+
+  finish_semaphore_ = CreateSemaphore(NULL, 0, 1, NULL);
+  assert(finish_semaphore_ != NULL);
+
+  // Don't attempt to create the thread if we could not create the semaphores.
+  if (finish_semaphore_ != NULL && start_semaphore_ != NULL) {
+    thread_ = CreateThread(NULL,         // lpThreadAttributes
+                           kExceptionHandlerThreadInitialStackSize,
+                           ThreadMain,
+                           this,         // lpParameter
+                           0,            // dwCreationFlags
+                           &thread_id_);
+    assert(thread_ != NULL);
+  }
+}
+
+ExceptionHandler::HandlerThread::~HandlerThread() {
+  if (thread_ != NULL) {
+#ifdef BREAKPAD_NO_TERMINATE_THREAD
+    // The handler thread is either waiting on the semaphore to handle a
+    // crash or it is handling a crash. Coming out of the wait is fast but
+    // wait more in the eventuality a crash is handled.  This compilation
+    // option results in a deadlock if the exception handler is destroyed
+    // while executing code inside DllMain.
+    is_shutdown_ = true;
+    ReleaseSemaphore(start_semaphore_, 1, NULL);
+    WaitForSingleObject(thread_, kWaitForHandlerThreadMs);
+#else
+    TerminateThread(thread_, 1);
+#endif  // BREAKPAD_NO_TERMINATE_THREAD
+
+    CloseHandle(thread_);
+    thread_ = NULL;
+  }
+  DeleteCriticalSection(&critical_section_);
+  if (start_semaphore_ != NULL)
+    CloseHandle(start_semaphore_);
+  if (finish_semaphore_ != NULL)
+    CloseHandle(finish_semaphore_);
+}
+
+bool ExceptionHandler::HandlerThread::WriteMinidump(
+    ExceptionHandler* handler,
+    EXCEPTION_POINTERS* exinfo,
+    MDRawAssertionInfo* assertion) {
+  // There isn't much we can do if the handler thread was not successfully
+  // created, or if it is the one asking: it would wait for itself forever.
+  // The latter can happen when a shared thread crashes while writing a
+  // dump and another handler using it catches the exception.
+  if (thread_ == NULL || GetCurrentThreadId() == thread_id_)
+    return false;
+
+  EnterCriticalSection(&critical_section_);
+
+  // Set up data to be passed in to the handler thread.
+  handler_ = handler;
+  handler->requesting_thread_id_ = GetCurrentThreadId();
+  handler->exception_info_ = exinfo;
+  handler->assertion_ = assertion;
+
+  // This causes the handler thread to call WriteMinidumpWithException.
+  ReleaseSemaphore(start_semaphore_, 1, NULL);
+
+  // Wait until WriteMinidumpWithException is done and collect its return value.
+  WaitForSingleObject(finish_semaphore_, INFINITE);
+  bool status = return_value_;
+
+  // Clean up.
+  handler->requesting_thread_id_ = 0;
+  handler->exception_info_ = NULL;
+  handler->assertion_ = NULL;
+  handler_ = NULL;
+
+  LeaveCriticalSection(&critical_section_);
+
+  return status;
+}
+
+// static
+DWORD ExceptionHandler::HandlerThread::ThreadMain(void* lpParameter) {
+  HandlerThread* self = reinterpret_cast<HandlerThread*>(lpParameter);
+  assert(self);
+  assert(self->start_semaphore_ != NULL);
+  assert(self->finish_semaphore_ != NULL);
+
+  while (true) {
+    if (WaitForSingleObject(self->start_semaphore_, INFINITE) ==
+        WAIT_OBJECT_0) {
+      // Perform the requested action.
+      if (self->is_shutdown_) {
+        // The thread is being stopped.
+        break;
+      } else {
+        ExceptionHandler* handler = self->handler_;
+        self->return_value_ =
+            handler->WriteMinidumpWithException(handler->requesting_thread_id_,
+                                                handler->exception_info_,
+                                                handler->assertion_);
+      }
+
+      // Allow the requesting thread to proceed.
+      ReleaseSemaphore(self->finish_semaphore_, 1, NULL);
+    }
+  }
+
+  // This statement is not reached when the thread is unconditionally
+  // terminated by the HandlerThread destructor.
+  return 0;
+}
 
 ExceptionHandler::ExceptionHandler(const wstring& dump_path,
                                    FilterCallback filter,
@@ -166,14 +353,28 @@ void ExceptionHandler::Initialize(
 #endif  // _MSC_VER >= 1400
   previous_pch_ = NULL;
   handler_thread_ = NULL;
-  is_shutdown_ = false;
-  handler_start_semaphore_ = NULL;
-  handler_finish_semaphore_ = NULL;
+  shares_handler_thread_ = false;
   requesting_thread_id_ = 0;
   exception_info_ = NULL;
   assertion_ = NULL;
-  handler_return_value_ = false;
   handle_debug_exceptions_ = false;
+  prepare_dump_file_ = false;
+  prepared_dump_file_ = INVALID_HANDLE_VALUE;
+
+  // There is a race condition here. If the first instance has not yet
+  // initialized the critical section, the second (and later) instances may
+  // try to use uninitialized critical section object. The feature of multiple
+  // instances in one module is not used much, so leave it as is for now.
+  // One way to solve this in the current design (that is, keeping the static
+  // handler stack) is to use spin locks with volatile bools to synchronize
+  // the handler stack. This works only if the compiler guarantees to generate
+  // cache coherent code for volatile.
+  // TODO(munjal): Fix this in a better way by changing the design if possible.
+
+  // Lazy initialization of the handler_stack_critical_section_
+  if (instance_count == 1) {
+    InitializeCriticalSection(&handler_stack_critical_section_);
+  }
 
   // Attempt to use out-of-process if user has specified a pipe or a
   // crash generation client.
@@ -201,28 +402,19 @@ void ExceptionHandler::Initialize(
     // or registration with the server process failed. In either case,
     // setup to do in-process crash generation.
 
-    // Set synchronization primitives and the handler thread.  Each
-    // ExceptionHandler object gets its own handler thread because that's the
-    // only way to reliably guarantee sufficient stack space in an exception,
-    // and it allows an easy way to get a snapshot of the requesting thread's
-    // context outside of an exception.
-    InitializeCriticalSection(&handler_critical_section_);
-    handler_start_semaphore_ = CreateSemaphore(NULL, 0, 1, NULL);
-    assert(handler_start_semaphore_ != NULL);
-
-    handler_finish_semaphore_ = CreateSemaphore(NULL, 0, 1, NULL);
-    assert(handler_finish_semaphore_ != NULL);
-
-    // Don't attempt to create the thread if we could not create the semaphores.
-    if (handler_finish_semaphore_ != NULL && handler_start_semaphore_ != NULL) {
-      DWORD thread_id;
-      handler_thread_ = CreateThread(NULL,         // lpThreadAttributes
-                                     kExceptionHandlerThreadInitialStackSize,
-                                     ExceptionHandlerThreadMain,
-                                     this,         // lpParameter
-                                     0,            // dwCreationFlags
-                                     &thread_id);
-      assert(handler_thread_ != NULL);
+    // Set up the handler thread: a new one for this object, or the shared
+    // one if that was asked for, starting it if this is its first user.
+    if (share_handler_thread_) {
+      EnterCriticalSection(&handler_stack_critical_section_);
+      if (!shared_handler_thread_) {
+        shared_handler_thread_ = new HandlerThread();
+      }
+      ++shared_handler_thread_users_;
+      handler_thread_ = shared_handler_thread_;
+      shares_handler_thread_ = true;
+      LeaveCriticalSection(&handler_stack_critical_section_);
+    } else {
+      handler_thread_ = new HandlerThread();
     }
 
     dbghelp_module_ = LoadLibrary(L"dbghelp.dll");
@@ -251,21 +443,6 @@ void ExceptionHandler::Initialize(
   instruction_memory.length = 0;
   app_memory_info_.push_back(instruction_memory);
 
-  // There is a race condition here. If the first instance has not yet
-  // initialized the critical section, the second (and later) instances may
-  // try to use uninitialized critical section object. The feature of multiple
-  // instances in one module is not used much, so leave it as is for now.
-  // One way to solve this in the current design (that is, keeping the static
-  // handler stack) is to use spin locks with volatile bools to synchronize
-  // the handler stack. This works only if the compiler guarantees to generate
-  // cache coherent code for volatile.
-  // TODO(munjal): Fix this in a better way by changing the design if possible.
-
-  // Lazy initialization of the handler_stack_critical_section_
-  if (instance_count == 1) {
-    InitializeCriticalSection(&handler_stack_critical_section_);
-  }
-
   if (handler_types != HANDLER_NONE) {
     EnterCriticalSection(&handler_stack_critical_section_);
 
@@ -292,6 +469,8 @@ void ExceptionHandler::Initialize(
 }
 
 ExceptionHandler::~ExceptionHandler() {
+  DiscardPreparedDumpFile();
+
   if (dbghelp_module_) {
     FreeLibrary(dbghelp_module_);
   }
@@ -340,28 +519,22 @@ ExceptionHandler::~ExceptionHandler() {
     LeaveCriticalSection(&handler_stack_critical_section_);
   }
 
-  // Some of the objects were only initialized if out of process
-  // registration was not done.
-  if (!IsOutOfProcess()) {
-#ifdef BREAKPAD_NO_TERMINATE_THREAD
-    // Clean up the handler thread and synchronization primitives. The handler
-    // thread is either waiting on the semaphore to handle a crash or it is
-    // handling a crash. Coming out of the wait is fast but wait more in the
-    // eventuality a crash is handled.  This compilation option results in a
-    // deadlock if the exception handler is destroyed while executing code
-    // inside DllMain.
-    is_shutdown_ = true;
-    ReleaseSemaphore(handler_start_semaphore_, 1, NULL);
-    WaitForSingleObject(handler_thread_, kWaitForHandlerThreadMs);
-#else
-    TerminateThread(handler_thread_, 1);
-#endif  // BREAKPAD_NO_TERMINATE_THREAD
-
-    CloseHandle(handler_thread_);
+  // The handler thread only exists if out of process registration was not
+  // done.  A shared one is stopped along with its last user, outside the
+  // critical section, since stopping it may wait for a dump to finish.
+  if (handler_thread_) {
+    HandlerThread* unused_handler_thread = handler_thread_;
+    if (shares_handler_thread_) {
+      EnterCriticalSection(&handler_stack_critical_section_);
+      if (--shared_handler_thread_users_ == 0) {
+        shared_handler_thread_ = NULL;
+      } else {
+        unused_handler_thread = NULL;
+      }
+      LeaveCriticalSection(&handler_stack_critical_section_);
+    }
+    delete unused_handler_thread;
     handler_thread_ = NULL;
-    DeleteCriticalSection(&handler_critical_section_);
-    CloseHandle(handler_start_semaphore_);
-    CloseHandle(handler_finish_semaphore_);
   }
 
   // There is a race condition in the code below: if this instance is
@@ -380,34 +553,13 @@ bool ExceptionHandler::RequestUpload(DWORD crash_id) {
 }
 
 // static
-DWORD ExceptionHandler::ExceptionHandlerThreadMain(void* lpParameter) {
-  ExceptionHandler* self = reinterpret_cast<ExceptionHandler *>(lpParameter);
-  assert(self);
-  assert(self->handler_start_semaphore_ != NULL);
-  assert(self->handler_finish_semaphore_ != NULL);
-
-  while (true) {
-    if (WaitForSingleObject(self->handler_start_semaphore_, INFINITE) ==
-        WAIT_OBJECT_0) {
-      // Perform the requested action.
-      if (self->is_shutdown_) {
-        // The instance of the exception handler is being destroyed.
-        break;
-      } else {
-        self->handler_return_value_ =
-            self->WriteMinidumpWithException(self->requesting_thread_id_,
-                                             self->exception_info_,
-                                             self->assertion_);
-      }
-
-      // Allow the requesting thread to proceed.
-      ReleaseSemaphore(self->handler_finish_semaphore_, 1, NULL);
-    }
-  }
+bool ExceptionHandler::get_share_handler_thread() {
+  return share_handler_thread_;
+}
 
-  // This statement is not reached when the thread is unconditionally
-  // terminated by the ExceptionHandler destructor.
-  return 0;
+// static
+void ExceptionHandler::set_share_handler_thread(bool share_handler_thread) {
+  share_handler_thread_ = share_handler_thread;
 }
 
 // HandleException and HandleInvalidParameter must create an
@@ -691,39 +843,13 @@ void ExceptionHandler::HandlePureVirtualCall() {
 
 bool ExceptionHandler::WriteMinidumpOnHandlerThread(
     EXCEPTION_POINTERS* exinfo, MDRawAssertionInfo* assertion) {
-  EnterCriticalSection(&handler_critical_section_);
-
   // There isn't much we can do if the handler thread
   // was not successfully created.
-  if (handler_thread_ == NULL) {
-    LeaveCriticalSection(&handler_critical_section_);
+  if (handler_thread_ == NULL || !handler_thread_->IsValid()) {
     return false;
   }
 
-  // The handler thread should only be created when the semaphores are valid.
-  assert(handler_start_semaphore_ != NULL);
-  assert(handler_finish_semaphore_ != NULL);
-
-  // Set up data to be passed in to the handler thread.
-  requesting_thread_id_ = GetCurrentThreadId();
-  exception_info_ = exinfo;
-  assertion_ = assertion;
-
-  // This causes the handler thread to call WriteMinidumpWithException.
-  ReleaseSemaphore(handler_start_semaphore_, 1, NULL);
-
-  // Wait until WriteMinidumpWithException is done and collect its return value.
-  WaitForSingleObject(handler_finish_semaphore_, INFINITE);
-  bool status = handler_return_value_;
-
-  // Clean up.
-  requesting_thread_id_ = 0;
-  exception_info_ = NULL;
-  assertion_ = NULL;
-
-  LeaveCriticalSection(&handler_critical_section_);
-
-  return status;
+  return handler_thread_->WriteMinidump(this, exinfo, assertion);
 }
 
 bool ExceptionHandler::WriteMinidump() {
@@ -770,6 +896,12 @@ bool ExceptionHandler::WriteMinidumpForChild(HANDLE child,
                                              const wstring& dump_path,
                                              MinidumpCallback callback,
                                              void* callback_context) {
+  // Take a turn behind dumps of crashed clients, if this process serves
+  // any, before suspending the child.
+  DumpScheduler* scheduler = DumpScheduler::GetInstance();
+  DumpScheduler::AutoDump admitted(scheduler,
+                                   DumpScheduler::PRIORITY_DIAGNOSTIC);
+
   EXCEPTION_RECORD ex;
   CONTEXT ctx;
   EXCEPTION_POINTERS exinfo = { NULL, NULL };
@@ -801,10 +933,12 @@ bool ExceptionHandler::WriteMinidumpForChild(HANDLE child,
 
   ExceptionHandler handler(dump_path, NULL, callback, callback_context,
                            HANDLER_NONE);
+  AutoCriticalSection dbghelp_lock(scheduler->dbghelp_lock());
   bool success = handler.WriteMinidumpWithExceptionForProcess(
       child_blamed_thread,
       exinfo.ExceptionRecord ? &exinfo : NULL,
       NULL, child, false);
+  dbghelp_lock.Release();
 
   if (last_suspend_count != kFailedToSuspendThread) {
     ResumeThread(child_thread_handle);
@@ -904,13 +1038,19 @@ bool ExceptionHandler::WriteMinidumpWithExceptionForProcess(
     bool write_requester_stream) {
   bool success = false;
   if (minidump_write_dump_) {
-    HANDLE dump_file = CreateFile(next_minidump_path_c_,
-                                  GENERIC_WRITE,
-                                  0,  // no sharing
-                                  NULL,
-                                  CREATE_NEW,  // fail if exists
-                                  FILE_ATTRIBUTE_NORMAL,
-                                  NULL);
+    // Use the prepared file if there is one.  It belongs to this dump from
+    // here on, whether or not the dump succeeds.
+    HANDLE dump_file = prepared_dump_file_;
+    prepared_dump_file_ = INVALID_HANDLE_VALUE;
+    if (dump_file == INVALID_HANDLE_VALUE) {
+      dump_file = CreateFile(next_minidump_path_c_,
+                             GENERIC_WRITE,
+                             0,  // no sharing
+                             NULL,
+                             CREATE_NEW,  // fail if exists
+                             FILE_ATTRIBUTE_NORMAL,
+                             NULL);
+    }
     if (dump_file != INVALID_HANDLE_VALUE) {
       MINIDUMP_EXCEPTION_INFORMATION except_info;
       except_info.ThreadId = requesting_thread_id;
@@ -1040,6 +1180,50 @@ void ExceptionHandler::UpdateNextID() {
 
   next_minidump_path_ = minidump_path;
   next_minidump_path_c_ = next_minidump_path_.c_str();
+
+  PrepareDumpFile();
+}
+
+void ExceptionHandler::set_prepare_dump_file(bool prepare_dump_file) {
+  prepare_dump_file_ = prepare_dump_file;
+  if (prepare_dump_file_) {
+    if (prepared_dump_file_ == INVALID_HANDLE_VALUE) {
+      PrepareDumpFile();
+    }
+  } else {
+    DiscardPreparedDumpFile();
+  }
+}
+
+void ExceptionHandler::PrepareDumpFile() {
+  DiscardPreparedDumpFile();
+
+  // In the out-of-process case the server names and creates the file.
+  if (!prepare_dump_file_ || IsOutOfProcess() || !next_minidump_path_c_) {
+    return;
+  }
+
+  prepared_dump_file_ = CreateFile(next_minidump_path_c_,
+                                   GENERIC_WRITE,
+                                   0,  // no sharing
+                                   NULL,
+                                   CREATE_NEW,  // fail if exists
+                                   FILE_ATTRIBUTE_NORMAL,
+                                   NULL);
+  if (prepared_dump_file_ != INVALID_HANDLE_VALUE) {
+    prepared_dump_path_ = next_minidump_path_;
+  }
+}
+
+void ExceptionHandler::DiscardPreparedDumpFile() {
+  if (prepared_dump_file_ == INVALID_HANDLE_VALUE) {
+    return;
+  }
+
+  CloseHandle(prepared_dump_file_);
+  prepared_dump_file_ = INVALID_HANDLE_VALUE;
+  DeleteFile(prepared_dump_path_.c_str());
+  prepared_dump_path_.clear();
 }
 
 void ExceptionHandler::RegisterAppMemory(void* ptr, size_t length) {
@@ -263,6 +263,28 @@ class ExceptionHandler {
     handle_debug_exceptions_ = handle_debug_exceptions;
   }
 
+  // Controls whether the file for the next minidump is created ahead of
+  // time.  When enabled, the handler thread writes into an already-open
+  // file instead of creating one after the exception, which shortens the
+  // time to a finished dump and avoids the process heap allocations that
+  // CreateFile makes while converting the path.  A new file is prepared
+  // whenever the dump path or ID changes; one that is never written to is
+  // deleted when the handler is destroyed.  Has no effect when dumps are
+  // generated out of process.
+  bool get_prepare_dump_file() const { return prepare_dump_file_; }
+  void set_prepare_dump_file(bool prepare_dump_file);
+
+  // Controls whether ExceptionHandlers created afterwards share a single
+  // process-wide handler thread instead of starting one each.  Processes
+  // that create many in-process handlers, such as one per loaded plugin,
+  // otherwise pay for an idle thread with a reserved stack per handler,
+  // and every one of them takes part in each DLL_THREAD_ATTACH
+  // notification.  Dumps requested through handlers that share the thread
+  // are written one at a time.  Handlers that already exist keep the
+  // thread they were created with.  Off by default.
+  static bool get_share_handler_thread();
+  static void set_share_handler_thread(bool share_handler_thread);
+
   // Returns whether out-of-process dump generation is used or not.
   bool IsOutOfProcess() const { return crash_generation_client_.get() != NULL; }
 
@@ -274,6 +296,10 @@ class ExceptionHandler {
  private:
   friend class AutoExceptionHandler;
 
+  // The thread on which minidumps are written, and the means of handing
+  // requests to it.  Defined in exception_handler.cc.
+  class HandlerThread;
+
   // Initializes the instance with given values.
   void Initialize(const wstring& dump_path,
                   FilterCallback filter,
@@ -300,9 +326,6 @@ class ExceptionHandler {
   // Function pointer type for UuidCreate, which is looked up dynamically.
   typedef RPC_STATUS (RPC_ENTRY *UuidCreate_type)(UUID* Uuid);
 
-  // Runs the main loop for the exception handler thread.
-  static DWORD WINAPI ExceptionHandlerThreadMain(void* lpParameter);
-
   // Called on the exception thread when an unhandled exception occurs.
   // Signals the exception handler thread to handle the exception.
   static LONG WINAPI HandleException(EXCEPTION_POINTERS* exinfo);
@@ -371,6 +394,14 @@ class ExceptionHandler {
   // path of the next minidump to be written in next_minidump_path_.
   void UpdateNextID();
 
+  // Creates the file at next_minidump_path_ and keeps it open in
+  // prepared_dump_file_, if prepare_dump_file_ is set.  Any previously
+  // prepared file is discarded first.
+  void PrepareDumpFile();
+
+  // Closes and deletes the prepared file, if there is one.
+  void DiscardPreparedDumpFile();
+
   FilterCallback filter_;
   MinidumpCallback callback_;
   void* callback_context_;
@@ -427,29 +458,15 @@ class ExceptionHandler {
   // virtual function calls.
   _purecall_handler previous_pch_;
 
-  // The exception handler thread.
-  HANDLE handler_thread_;
-
-  // True if the exception handler is being destroyed.
-  // Starting with MSVC 2005, Visual C has stronger guarantees on volatile vars.
-  // It has release semantics on write and acquire semantics on reads.
-  // See the msdn documentation.
-  volatile bool is_shutdown_;
+  // The thread that writes this handler's minidumps.  NULL when dumps are
+  // generated out of process.  If shares_handler_thread_ is true, this is
+  // shared_handler_thread_, and other handlers use it too.
+  HandlerThread* handler_thread_;
+  bool shares_handler_thread_;
 
-  // The critical section enforcing the requirement that only one exception be
-  // handled by a handler at a time.
-  CRITICAL_SECTION handler_critical_section_;
-
-  // Semaphores used to move exception handling between the exception thread
-  // and the handler thread.  handler_start_semaphore_ is signalled by the
-  // exception thread to wake up the handler thread when an exception occurs.
-  // handler_finish_semaphore_ is signalled by the handler thread to wake up
-  // the exception thread when handling is complete.
-  HANDLE handler_start_semaphore_;
-  HANDLE handler_finish_semaphore_;
-
-  // The next 2 fields contain data passed from the requesting thread to
-  // the handler thread.
+  // The next 3 fields contain data passed from the requesting thread to
+  // the handler thread.  They are only set while the requesting thread
+  // holds the handler thread's lock.
 
   // The thread ID of the thread requesting the dump (either the exception
   // thread or any other thread that called WriteMinidump directly).
@@ -463,15 +480,21 @@ class ExceptionHandler {
   // pointer to the assertion information.  It is NULL at other times.
   MDRawAssertionInfo* assertion_;
 
-  // The return value of the handler, passed from the handler thread back to
-  // the requesting thread.
-  bool handler_return_value_;
-
   // If true, the handler will intercept EXCEPTION_BREAKPOINT and
   // EXCEPTION_SINGLE_STEP exceptions.  Leave this false (the default)
   // to not interfere with debuggers.
   bool handle_debug_exceptions_;
 
+  // If true, the file for the next minidump is created before it is needed.
+  bool prepare_dump_file_;
+
+  // The open, still empty file for the next minidump, and its path.  The
+  // handle is INVALID_HANDLE_VALUE when no file is prepared.  The path is
+  // kept separately from next_minidump_path_ so that the file can be
+  // deleted after the ID has changed.
+  HANDLE prepared_dump_file_;
+  wstring prepared_dump_path_;
+
   // Callers can request additional memory regions to be included in
   // the dump.
   AppMemoryList app_memory_info_;
@@ -489,11 +512,19 @@ class ExceptionHandler {
   // to support multiple stacked Breakpad handlers.
   static LONG handler_stack_index_;
 
-  // handler_stack_critical_section_ guards operations on handler_stack_ and
-  // handler_stack_index_. The critical section is initialized by the
-  // first instance of the class and destroyed by the last instance of it.
+  // handler_stack_critical_section_ guards operations on handler_stack_,
+  // handler_stack_index_ and the shared handler thread's fields. The
+  // critical section is initialized by the first instance of the class and
+  // destroyed by the last instance of it.
   static CRITICAL_SECTION handler_stack_critical_section_;
 
+  // Whether new instances use shared_handler_thread_, and that thread with
+  // the number of instances using it.  The thread is created for the first
+  // of them and stopped when the last is destroyed.
+  static volatile bool share_handler_thread_;
+  static HandlerThread* shared_handler_thread_;
+  static LONG shared_handler_thread_users_;
+
   // The number of instances of this class.
   static volatile LONG instance_count_;
 
@@ -49,7 +49,8 @@ CrashReportSender::CrashReportSender(const wstring &checkpoint_file)
     : checkpoint_file_(checkpoint_file),
       max_reports_per_day_(-1),
       last_sent_date_(-1),
-      reports_sent_(0) {
+      reports_sent_(0),
+      upload_session_(new HTTPUploadSession()) {
   FILE *fd;
   if (OpenCheckpointFile(L"r", &fd) == 0) {
     ReadCheckpoint(fd);
@@ -57,6 +58,9 @@ CrashReportSender::CrashReportSender(const wstring &checkpoint_file)
   }
 }
 
+CrashReportSender::~CrashReportSender() {
+}
+
 ReportResult CrashReportSender::SendCrashReport(
     const wstring &url, const map<wstring, wstring> &parameters,
     const wstring &dump_file_name, wstring *report_code) {
@@ -69,8 +73,8 @@ ReportResult CrashReportSender::SendCrashReport(
 
   int http_response = 0;
   bool result = HTTPUpload::SendRequest(
-    url, parameters, dump_file_name, L"upload_file_minidump", NULL, report_code,
-    &http_response);
+    upload_session_.get(), url, parameters, dump_file_name,
+    L"upload_file_minidump", NULL, report_code, &http_response);
 
   if (result) {
     ReportSent(today);
@@ -45,11 +45,15 @@
 #include <map>
 #include <string>
 
+#include "common/scoped_ptr.h"
+
 namespace google_breakpad {
 
 using std::wstring;
 using std::map;
 
+class HTTPUploadSession;
+
 typedef enum {
   RESULT_FAILED = 0,  // Failed to communicate with the server; try later.
   RESULT_REJECTED,    // Successfully sent the crash report, but the
@@ -66,7 +70,7 @@ class CrashReportSender {
   // state to this file.  A checkpoint file is required for
   // set_max_reports_per_day() to function properly.
   explicit CrashReportSender(const wstring &checkpoint_file);
-  ~CrashReportSender() {}
+  ~CrashReportSender();
 
   // Sets the maximum number of crash reports that will be sent in a 24-hour
   // period.  This uses the state persisted to the checkpoint file.
@@ -87,6 +91,8 @@ class CrashReportSender {
   // the return value is RESULT_SUCCEEDED), a code uniquely identifying the
   // report will be returned in report_code.
   // (Otherwise, report_code will be unchanged.)
+  // Reports sent one after another by the same CrashReportSender share a
+  // wininet session and, when they go to the same server, a connection.
   ReportResult SendCrashReport(const wstring &url,
                                const map<wstring, wstring> &parameters,
                                const wstring &dump_file_name,
@@ -112,6 +118,8 @@ class CrashReportSender {
   int last_sent_date_;
   // Number of reports sent on last_sent_date_
   int reports_sent_;
+  // Session kept open for the reports sent by this instance.
+  scoped_ptr<HTTPUploadSession> upload_session_;
 
   // Disallow copy constructor and operator=
   explicit CrashReportSender(const CrashReportSender &);
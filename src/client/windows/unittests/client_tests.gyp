@@ -42,7 +42,8 @@
         'minidump_test.cc',
         'dump_analysis.cc',
         'dump_analysis.h',
-        'crash_generation_server_test.cc'
+        'crash_generation_server_test.cc',
+        'dump_scheduler_test.cc'
       ],
       'dependencies': [
         'testing.gyp:gtest',
@@ -35,6 +35,7 @@
 #include "client/windows/common/ipc_protocol.h"
 
 using testing::_;
+using testing::Invoke;
 
 namespace {
 
@@ -52,6 +53,8 @@ const DWORD kPipeMode = PIPE_READMODE_MESSAGE;
 
 int kCustomInfoCount = 2;
 
+const int kPoolSize = 4;
+
 google_breakpad::CustomInfoEntry kCustomInfoEntries[] = {
     google_breakpad::CustomInfoEntry(L"prod", L"CrashGenerationServerTest"),
     google_breakpad::CustomInfoEntry(L"ver", L"1.0"),
@@ -68,6 +71,7 @@ class CrashGenerationServerTest : public ::testing::Test {
                                  CallOnClientUploadRequested, &mock_callbacks_,
                                  false,
                                  NULL),
+        pipe_instance_count_(1),
         thread_id_(0),
         exception_pointers_(NULL) {
     memset(&assert_info_, 0, sizeof(assert_info_));
@@ -99,10 +103,11 @@ class CrashGenerationServerTest : public ::testing::Test {
   };
 
   void SetUp() {
+    crash_generation_server_.set_pipe_instance_count(pipe_instance_count_);
     ASSERT_TRUE(crash_generation_server_.Start());
   }
 
-  void FaultyClient(ClientFault fault_type) {
+  void OpenPipe(HANDLE* result) {
     HANDLE pipe = CreateFile(kPipeName,
                              kPipeDesiredAccess,
                              0,
@@ -130,12 +135,23 @@ class CrashGenerationServerTest : public ::testing::Test {
 
     DWORD mode = kPipeMode;
     ASSERT_TRUE(SetNamedPipeHandleState(pipe, &mode, NULL, NULL));
+    *result = pipe;
+  }
+
+  void FaultyClient(ClientFault fault_type) {
+    HANDLE pipe = INVALID_HANDLE_VALUE;
+    ASSERT_NO_FATAL_FAILURE(OpenPipe(&pipe));
 
     DoFaultyClient(fault_type, pipe);
 
     CloseHandle(pipe);
   }
 
+  // Registers over a pipe opened with OpenPipe.
+  void RegisterClient(HANDLE pipe) {
+    DoFaultyClient(NO_FAULT, pipe);
+  }
+
   void DoTestFault(ClientFault fault) {
     EXPECT_CALL(mock_callbacks_, OnClientConnected(_)).Times(0);
     ASSERT_NO_FATAL_FAILURE(FaultyClient(fault));
@@ -156,6 +172,9 @@ class CrashGenerationServerTest : public ::testing::Test {
 
   MockCrashGenerationServerCallbacks mock_callbacks_;
 
+  // Applied to the server by SetUp.
+  int pipe_instance_count_;
+
  private:
   // Depends on the caller to successfully open the pipe before invocation and
   // to close it immediately afterwards.
@@ -303,4 +322,46 @@ TEST_F(CrashGenerationServerTest, SendInvalidAck) {
   ASSERT_NO_FATAL_FAILURE(FaultyClient(CLOSE_AFTER_CONNECT));
 }
 
+class CrashGenerationServerPoolTest : public CrashGenerationServerTest {
+ public:
+  CrashGenerationServerPoolTest() {
+    pipe_instance_count_ = kPoolSize;
+  }
+
+ protected:
+  static void CountConnection(const google_breakpad::ClientInfo*) {
+    InterlockedIncrement(&connection_count_);
+  }
+
+  static volatile LONG connection_count_;
+};
+
+volatile LONG CrashGenerationServerPoolTest::connection_count_ = 0;
+
+// With a pool of pipe instances, clients are connected at the same time
+// instead of waiting for the pipe, and register in any order.
+TEST_F(CrashGenerationServerPoolTest, ConcurrentClients) {
+  connection_count_ = 0;
+  EXPECT_CALL(mock_callbacks_, OnClientConnected(_))
+      .Times(kPoolSize)
+      .WillRepeatedly(Invoke(&CountConnection));
+
+  HANDLE pipes[kPoolSize];
+  for (int i = 0; i < kPoolSize; ++i) {
+    ASSERT_NO_FATAL_FAILURE(OpenPipe(&pipes[i]));
+  }
+  for (int i = kPoolSize - 1; i >= 0; --i) {
+    ASSERT_NO_FATAL_FAILURE(RegisterClient(pipes[i]));
+    CloseHandle(pipes[i]);
+  }
+
+  // The connection callback runs once the server reads the ack, after the
+  // client is done; the instances don't serialize this as a single pipe
+  // would, so wait for it.
+  for (int tries = 0; tries < 100 && connection_count_ < kPoolSize; ++tries) {
+    Sleep(10);
+  }
+  ASSERT_EQ(kPoolSize, connection_count_);
+}
+
 }  // anonymous namespace
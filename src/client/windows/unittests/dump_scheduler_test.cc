@@ -0,0 +1,138 @@
+// Copyright (c) 2016, Google Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+// notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above
+// copyright notice, this list of conditions and the following disclaimer
+// in the documentation and/or other materials provided with the
+// distribution.
+//     * Neither the name of Google Inc. nor the names of its
+// contributors may be used to endorse or promote products derived from
+// this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include <windows.h>
+
+#include "testing/gtest/include/gtest/gtest.h"
+
+#include "client/windows/crash_generation/dump_scheduler.h"
+
+namespace {
+
+using google_breakpad::DumpScheduler;
+
+// A thread that writes a pretend dump through a DumpScheduler and notes
+// when it was admitted.
+struct DumpThread {
+  DumpScheduler* scheduler;
+  DumpScheduler::Priority priority;
+  volatile LONG* admissions;
+  LONG order;
+  HANDLE thread;
+};
+
+DWORD WINAPI DumpThreadMain(void* context) {
+  DumpThread* dump = static_cast<DumpThread*>(context);
+  DumpScheduler::AutoDump admitted(dump->scheduler, dump->priority);
+  dump->order = InterlockedIncrement(dump->admissions);
+  return 0;
+}
+
+void StartDumpThread(DumpThread* dump) {
+  dump->order = 0;
+  dump->thread = CreateThread(NULL, 0, DumpThreadMain, dump, 0, NULL);
+  ASSERT_TRUE(dump->thread != NULL);
+}
+
+void FinishDumpThread(DumpThread* dump) {
+  EXPECT_EQ(WAIT_OBJECT_0, WaitForSingleObject(dump->thread, 5000));
+  CloseHandle(dump->thread);
+}
+
+// Waits for the scheduler to have |count| dumps waiting.
+bool WaitForWaitingDumps(DumpScheduler* scheduler, int count) {
+  for (int tries = 0; tries < 500; ++tries) {
+    if (scheduler->waiting_dumps() == count) {
+      return true;
+    }
+    Sleep(10);
+  }
+  return false;
+}
+
+TEST(DumpSchedulerTest, LimitsConcurrentDumps) {
+  DumpScheduler scheduler(2);
+  scheduler.BeginDump(DumpScheduler::PRIORITY_CRASH);
+  scheduler.BeginDump(DumpScheduler::PRIORITY_DIAGNOSTIC);
+  EXPECT_EQ(2, scheduler.active_dumps());
+
+  volatile LONG admissions = 0;
+  DumpThread dump = { &scheduler, DumpScheduler::PRIORITY_CRASH, &admissions };
+  ASSERT_NO_FATAL_FAILURE(StartDumpThread(&dump));
+  ASSERT_TRUE(WaitForWaitingDumps(&scheduler, 1));
+  EXPECT_EQ(0, dump.order);
+
+  scheduler.EndDump();
+  FinishDumpThread(&dump);
+  EXPECT_EQ(1, dump.order);
+
+  scheduler.EndDump();
+  EXPECT_EQ(0, scheduler.active_dumps());
+  EXPECT_EQ(0, scheduler.waiting_dumps());
+}
+
+TEST(DumpSchedulerTest, CrashDumpsGoFirst) {
+  DumpScheduler scheduler(1);
+  scheduler.BeginDump(DumpScheduler::PRIORITY_CRASH);
+
+  volatile LONG admissions = 0;
+  DumpThread diagnostic = { &scheduler, DumpScheduler::PRIORITY_DIAGNOSTIC,
+                            &admissions };
+  DumpThread crash = { &scheduler, DumpScheduler::PRIORITY_CRASH,
+                       &admissions };
+  ASSERT_NO_FATAL_FAILURE(StartDumpThread(&diagnostic));
+  ASSERT_TRUE(WaitForWaitingDumps(&scheduler, 1));
+  ASSERT_NO_FATAL_FAILURE(StartDumpThread(&crash));
+  ASSERT_TRUE(WaitForWaitingDumps(&scheduler, 2));
+
+  scheduler.EndDump();
+  FinishDumpThread(&crash);
+  FinishDumpThread(&diagnostic);
+  EXPECT_EQ(1, crash.order);
+  EXPECT_EQ(2, diagnostic.order);
+}
+
+TEST(DumpSchedulerTest, GrowingTheLimitAdmitsWaitingDumps) {
+  DumpScheduler scheduler(1);
+  scheduler.BeginDump(DumpScheduler::PRIORITY_CRASH);
+
+  volatile LONG admissions = 0;
+  DumpThread dump = { &scheduler, DumpScheduler::PRIORITY_DIAGNOSTIC,
+                      &admissions };
+  ASSERT_NO_FATAL_FAILURE(StartDumpThread(&dump));
+  ASSERT_TRUE(WaitForWaitingDumps(&scheduler, 1));
+
+  scheduler.set_max_concurrent_dumps(2);
+  FinishDumpThread(&dump);
+  EXPECT_EQ(1, dump.order);
+
+  scheduler.EndDump();
+}
+
+}  // namespace
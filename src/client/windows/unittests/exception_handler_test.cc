@@ -393,6 +393,85 @@ TEST_F(ExceptionHandlerTest, WriteMinidumpTest) {
   // TODO(ted): more comprehensive tests...
 }
 
+// Test that a minidump is written into the prepared file, and that an
+// unused prepared file does not outlive the handler.
+TEST_F(ExceptionHandlerTest, PreparedDumpFileTest) {
+  {
+    ExceptionHandler handler(temp_path_,
+                             NULL,
+                             DumpCallback,
+                             NULL,
+                             ExceptionHandler::HANDLER_ALL);
+    handler.set_prepare_dump_file(true);
+    ASSERT_TRUE(handler.get_prepare_dump_file());
+
+    // Disable GTest SEH handler
+    testing::DisableExceptionHandlerInScope disable_exception_handler;
+
+    ASSERT_TRUE(handler.WriteMinidump());
+    ASSERT_FALSE(dump_file.empty());
+    ASSERT_TRUE(DoesPathExist(dump_file.c_str()));
+
+    // The next file was prepared when the ID changed, so a second dump
+    // goes to a different file.
+    std::wstring first_dump_file = dump_file;
+    ASSERT_TRUE(handler.WriteMinidump());
+    ASSERT_NE(first_dump_file, dump_file);
+    ::DeleteFile(first_dump_file.c_str());
+  }
+
+  string minidump_filename;
+  ASSERT_TRUE(WindowsStringUtils::safe_wcstombs(dump_file,
+                                                &minidump_filename));
+  Minidump minidump(minidump_filename);
+  ASSERT_TRUE(minidump.Read());
+
+  // The file prepared after the second dump was deleted with the handler,
+  // leaving only the dump that was written.
+  std::wstring pattern(temp_path_);
+  pattern += L"\\*.dmp";
+  WIN32_FIND_DATA find_data;
+  HANDLE find_handle = FindFirstFile(pattern.c_str(), &find_data);
+  ASSERT_NE(INVALID_HANDLE_VALUE, find_handle);
+  int dump_count = 0;
+  do {
+    ++dump_count;
+  } while (FindNextFile(find_handle, &find_data));
+  FindClose(find_handle);
+  EXPECT_EQ(1, dump_count);
+}
+
+// Test that handlers sharing a handler thread can each write minidumps,
+// including after another user of the thread is gone.
+TEST_F(ExceptionHandlerTest, SharedHandlerThreadTest) {
+  ASSERT_FALSE(ExceptionHandler::get_share_handler_thread());
+  ExceptionHandler::set_share_handler_thread(true);
+  scoped_ptr<ExceptionHandler> first(
+      new ExceptionHandler(temp_path_, NULL, DumpCallback, NULL,
+                           ExceptionHandler::HANDLER_NONE));
+  ExceptionHandler second(temp_path_, NULL, DumpCallback, NULL,
+                          ExceptionHandler::HANDLER_NONE);
+  ExceptionHandler::set_share_handler_thread(false);
+
+  // Disable GTest SEH handler
+  testing::DisableExceptionHandlerInScope disable_exception_handler;
+
+  ASSERT_TRUE(first->WriteMinidump());
+  std::wstring first_dump_file = dump_file;
+  ASSERT_TRUE(DoesPathExist(first_dump_file.c_str()));
+  first.reset();
+
+  ASSERT_TRUE(second.WriteMinidump());
+  ASSERT_NE(first_dump_file, dump_file);
+  ::DeleteFile(first_dump_file.c_str());
+
+  string minidump_filename;
+  ASSERT_TRUE(WindowsStringUtils::safe_wcstombs(dump_file,
+                                                &minidump_filename));
+  Minidump minidump(minidump_filename);
+  ASSERT_TRUE(minidump.Read());
+}
+
 // Test that an additional memory region can be included in the minidump.
 TEST_F(ExceptionHandlerTest, AdditionalMemory) {
   SYSTEM_INFO si;
@@ -86,7 +86,7 @@ class MinidumpTest: public testing::Test {
     }
   }
 
-  bool WriteDump(ULONG flags) {
+  bool WriteDump(ULONG flags, size_t memory_budget = 0) {
     using google_breakpad::MinidumpGenerator;
 
     // Fake exception is access violation on write to this.
@@ -113,6 +113,7 @@ class MinidumpTest: public testing::Test {
                                 NULL,
                                 static_cast<MINIDUMP_TYPE>(flags),
                                 TRUE);
+    generator.set_memory_budget(memory_budget);
     generator.GenerateDumpFile(&dump_file_);
     generator.GenerateFullDumpFile(&full_dump_file_);
     // And write a dump
@@ -127,6 +128,14 @@ class MinidumpTest: public testing::Test {
   std::wstring dump_path_;
 };
 
+// Returns the size of the file at |file_path|, or 0 on error.
+ULONG64 GetFileSize(const std::wstring& file_path) {
+  WIN32_FILE_ATTRIBUTE_DATA data;
+  if (!::GetFileAttributesEx(file_path.c_str(), GetFileExInfoStandard, &data))
+    return 0;
+  return (static_cast<ULONG64>(data.nFileSizeHigh) << 32) | data.nFileSizeLow;
+}
+
 // We need to be able to get file information from Windows
 bool HasFileInfo(const std::wstring& file_path) {
   DWORD dummy;
@@ -272,6 +281,33 @@ TEST_F(MinidumpTest, LargerDump) {
   EXPECT_FALSE(mini.HasStream(TokenStream));
 }
 
+TEST_F(MinidumpTest, BudgetedDump) {
+  // Dump streams other than memory, such as the module list, take up to
+  // this much room.
+  const ULONG64 kOverhead = 256 * 1024;
+  const size_t kSmallBudget = 64 * 1024;
+  const size_t kLargeBudget = 4 * 1024 * 1024;
+
+  ASSERT_TRUE(WriteDump(kLargerDumpType, kSmallBudget));
+  ULONG64 small_size = GetFileSize(dump_file_);
+  {
+    DumpAnalysis mini(dump_file_);
+    EXPECT_TRUE(mini.HasStream(ThreadListStream));
+    EXPECT_TRUE(mini.HasStream(MemoryListStream));
+    EXPECT_TRUE(mini.HasStream(ExceptionStream));
+  }
+  ::DeleteFile(dump_file_.c_str());
+
+  ASSERT_TRUE(WriteDump(kLargerDumpType, kLargeBudget));
+  ULONG64 large_size = GetFileSize(dump_file_);
+
+  EXPECT_GT(small_size, 0U);
+  EXPECT_LT(small_size, kSmallBudget + kOverhead);
+  EXPECT_LT(large_size, kLargeBudget + kOverhead);
+  // The larger budget is filled with sampled heap pages.
+  EXPECT_GT(large_size, small_size);
+}
+
 TEST_F(MinidumpTest, FullDump) {
   ASSERT_TRUE(WriteDump(kFullDumpType));
   ASSERT_TRUE(dump_file_ != L"");
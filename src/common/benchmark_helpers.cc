@@ -0,0 +1,108 @@
+// Copyright (c) 2016 Google Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+// notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above
+// copyright notice, this list of conditions and the following disclaimer
+// in the documentation and/or other materials provided with the
+// distribution.
+//     * Neither the name of Google Inc. nor the names of its
+// contributors may be used to endorse or promote products derived from
+// this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+// benchmark_helpers.cc: Timing, statistics and option parsing shared by
+// Breakpad's benchmark programs.
+
+#include "common/benchmark_helpers.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/resource.h>
+#include <time.h>
+#endif  // _WIN32
+
+#include <algorithm>
+
+namespace google_breakpad {
+
+uint64_t MonotonicNanoseconds() {
+#ifdef _WIN32
+  LARGE_INTEGER now, frequency;
+  QueryPerformanceCounter(&now);
+  QueryPerformanceFrequency(&frequency);
+  return static_cast<uint64_t>(now.QuadPart / frequency.QuadPart) *
+             1000000000 +
+         static_cast<uint64_t>(now.QuadPart % frequency.QuadPart) *
+             1000000000 / frequency.QuadPart;
+#else
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return static_cast<uint64_t>(now.tv_sec) * 1000000000 + now.tv_nsec;
+#endif  // _WIN32
+}
+
+double Milliseconds(uint64_t nanoseconds) {
+  return nanoseconds / 1e6;
+}
+
+double Samples::Median() {
+  std::sort(values_.begin(), values_.end());
+  return values_[values_.size() / 2];
+}
+
+double Samples::Min() const {
+  return *std::min_element(values_.begin(), values_.end());
+}
+
+double Samples::Max() const {
+  return *std::max_element(values_.begin(), values_.end());
+}
+
+long PeakResidentSetKilobytes() {
+#ifndef _WIN32
+  struct rusage usage;
+  if (getrusage(RUSAGE_SELF, &usage) != 0)
+    return 0;
+#ifdef __APPLE__
+  return usage.ru_maxrss / 1024;
+#else
+  return usage.ru_maxrss;
+#endif
+#else  // _WIN32
+  return 0;
+#endif  // _WIN32
+}
+
+bool ParseCount(char option, const char* value, unsigned long minimum,
+                unsigned long maximum, unsigned long* count) {
+  char* end;
+  *count = strtoul(value, &end, 10);
+  if (end == value || *end != '\0' || *count < minimum || *count > maximum) {
+    fprintf(stderr, "Invalid value for -%c: %s\n", option, value);
+    return false;
+  }
+  return true;
+}
+
+}  // namespace google_breakpad
@@ -0,0 +1,76 @@
+// Copyright (c) 2016 Google Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+// notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above
+// copyright notice, this list of conditions and the following disclaimer
+// in the documentation and/or other materials provided with the
+// distribution.
+//     * Neither the name of Google Inc. nor the names of its
+// contributors may be used to endorse or promote products derived from
+// this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+// benchmark_helpers.h: Timing, statistics and option parsing shared by
+// Breakpad's benchmark programs.
+
+#ifndef COMMON_BENCHMARK_HELPERS_H_
+#define COMMON_BENCHMARK_HELPERS_H_
+
+#include <vector>
+
+#include "google_breakpad/common/breakpad_types.h"
+
+namespace google_breakpad {
+
+// The time of a monotonic clock in nanoseconds.  On Linux this is
+// CLOCK_MONOTONIC, which all processes share.
+uint64_t MonotonicNanoseconds();
+
+double Milliseconds(uint64_t nanoseconds);
+
+// Collects the values of one figure over a benchmark's iterations.
+class Samples {
+ public:
+  void Add(double value) { values_.push_back(value); }
+
+  bool empty() const { return values_.empty(); }
+
+  // These must not be called while the samples are empty.
+  double Median();
+  double Min() const;
+  double Max() const;
+
+ private:
+  std::vector<double> values_;
+};
+
+// The peak resident set size of this process in kilobytes, or 0 if it
+// can't be determined.
+long PeakResidentSetKilobytes();
+
+// Parses a decimal count given to option |option|, which must be at least
+// |minimum| and at most |maximum|.  Prints an error and returns false if
+// |value| isn't one.
+bool ParseCount(char option, const char* value, unsigned long minimum,
+                unsigned long maximum, unsigned long* count);
+
+}  // namespace google_breakpad
+
+#endif  // COMMON_BENCHMARK_HELPERS_H_
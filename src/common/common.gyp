@@ -76,6 +76,8 @@
         'dwarf/types.h',
         'dwarf_cfi_to_module.cc',
         'dwarf_cfi_to_module.h',
+        'dwarf_cu_cache.cc',
+        'dwarf_cu_cache.h',
         'dwarf_cu_to_module.cc',
         'dwarf_cu_to_module.h',
         'dwarf_line_to_module.cc',
@@ -89,7 +91,11 @@
         'linux/eintr_wrapper.h',
         'linux/elf_core_dump.cc',
         'linux/elf_core_dump.h',
+        'linux/elf_core_stream_reader.cc',
+        'linux/elf_core_stream_reader.h',
         'linux/elf_gnu_compat.h',
+        'linux/elf_section_index.cc',
+        'linux/elf_section_index.h',
         'linux/elf_symbols_to_module.cc',
         'linux/elf_symbols_to_module.h',
         'linux/elfutils-inl.h',
@@ -145,6 +151,7 @@
         'md5.h',
         'memory.h',
         'memory_range.h',
+        'minidump_compression.h',
         'module.cc',
         'module.h',
         'scoped_ptr.h',
@@ -163,6 +170,7 @@
         'stabs_to_module.h',
         'string_conversion.cc',
         'string_conversion.h',
+        'string_interner.h',
         'symbol_data.h',
         'test_assembler.cc',
         'test_assembler.h',
@@ -186,6 +194,16 @@
       'include_dirs': [
         '..',
       ],
+      'conditions': [
+        ['OS=="linux"', {
+          'link_settings': {
+            # linux/dump_symbols.cc inflates compressed debug sections.
+            'libraries': [
+              '-lz',
+            ],
+          },
+        }],
+      ],
     },
     {
       'target_name': 'common_unittests',
@@ -198,10 +216,14 @@
         'dwarf/dwarf2reader_cfi_unittest.cc',
         'dwarf/dwarf2reader_die_unittest.cc',
         'dwarf_cfi_to_module_unittest.cc',
+        'dwarf_cu_cache_unittest.cc',
         'dwarf_cu_to_module_unittest.cc',
         'dwarf_line_to_module_unittest.cc',
+        'linux/crc32_unittest.cc',
         'linux/dump_symbols_unittest.cc',
         'linux/elf_core_dump_unittest.cc',
+        'linux/elf_core_stream_reader_unittest.cc',
+        'linux/elf_section_index_unittest.cc',
         'linux/elf_symbols_to_module_unittest.cc',
         'linux/file_id_unittest.cc',
         'linux/google_crashdump_uploader_test.cc',
@@ -219,6 +241,7 @@
         'simple_string_dictionary_unittest.cc',
         'stabs_reader_unittest.cc',
         'stabs_to_module_unittest.cc',
+        'string_interner_unittest.cc',
         'test_assembler_unittest.cc',
         'tests/auto_tempdir.h',
         'tests/file_utils.cc',
@@ -88,9 +88,24 @@ inline uint64 ByteReader::ReadEightBytes(const char* signed_buffer) const {
 // Read an unsigned LEB128 number.  Each byte contains 7 bits of
 // information, plus one bit saying whether the number continues or
 // not.
+//
+// Most LEB128 numbers in DWARF data (abbreviation codes, attribute
+// names and forms, small constants) fit in one or two bytes, so those
+// are decoded without entering the loop.  Only bytes that belong to
+// the number are ever read.
 
 inline uint64 ByteReader::ReadUnsignedLEB128(const char* buffer,
                                              size_t* len) const {
+  const unsigned char* bytes = reinterpret_cast<const unsigned char*>(buffer);
+  if (!(bytes[0] & 0x80)) {
+    *len = 1;
+    return bytes[0];
+  }
+  if (!(bytes[1] & 0x80)) {
+    *len = 2;
+    return (bytes[0] & 0x7f) | (static_cast<uint64>(bytes[1]) << 7);
+  }
+
   uint64 result = 0;
   size_t num_read = 0;
   unsigned int shift = 0;
@@ -112,10 +127,23 @@ inline uint64 ByteReader::ReadUnsignedLEB128(const char* buffer,
 }
 
 // Read a signed LEB128 number.  These are like regular LEB128
-// numbers, except the last byte may have a sign bit set.
+// numbers, except the last byte may have a sign bit set.  As above,
+// one- and two-byte numbers take a fast path.
 
 inline int64 ByteReader::ReadSignedLEB128(const char* buffer,
                                           size_t* len) const {
+  const unsigned char* bytes = reinterpret_cast<const unsigned char*>(buffer);
+  if (!(bytes[0] & 0x80)) {
+    *len = 1;
+    return (bytes[0] & 0x40) ? static_cast<int64>(bytes[0]) - 0x80
+                             : static_cast<int64>(bytes[0]);
+  }
+  if (!(bytes[1] & 0x80)) {
+    *len = 2;
+    const int64 value = (bytes[0] & 0x7f) | (static_cast<int64>(bytes[1]) << 7);
+    return (bytes[1] & 0x40) ? value - 0x4000 : value;
+  }
+
   int64 result = 0;
   unsigned int shift = 0;
   size_t num_read = 0;
@@ -86,6 +86,36 @@ TEST_F(Reader, SimpleConstructor) {
   EXPECT_EQ(0xfec319c9, reader.ReadAddress(data + 35));
 }
 
+// One- and two-byte LEB128 numbers take a separate path; check the values
+// on either side of each length boundary.
+TEST_F(Reader, ShortLEB128) {
+  ByteReader reader(ENDIANNESS_LITTLE);
+  const uint64_t unsigned_values[] = { 0, 1, 0x7f, 0x80, 0x3fff, 0x4000 };
+  const size_t unsigned_sizes[] = { 1, 1, 1, 2, 2, 3 };
+  const int64_t signed_values[] = { 0, 0x3f, -0x40, 0x40, -0x41,
+                                    0x1fff, -0x2000, 0x2000, -0x2001 };
+  const size_t signed_sizes[] = { 1, 1, 1, 2, 2, 2, 2, 3, 3 };
+  CFISection section(kLittleEndian, 4);
+  for (size_t i = 0; i < sizeof(unsigned_values) / sizeof(uint64_t); i++)
+    section.ULEB128(unsigned_values[i]);
+  for (size_t i = 0; i < sizeof(signed_values) / sizeof(int64_t); i++)
+    section.LEB128(signed_values[i]);
+  ASSERT_TRUE(section.GetContents(&contents));
+  const char *data = contents.data();
+  size_t leb128_size;
+  for (size_t i = 0; i < sizeof(unsigned_values) / sizeof(uint64_t); i++) {
+    EXPECT_EQ(unsigned_values[i],
+              reader.ReadUnsignedLEB128(data, &leb128_size));
+    EXPECT_EQ(unsigned_sizes[i], leb128_size);
+    data += leb128_size;
+  }
+  for (size_t i = 0; i < sizeof(signed_values) / sizeof(int64_t); i++) {
+    EXPECT_EQ(signed_values[i], reader.ReadSignedLEB128(data, &leb128_size));
+    EXPECT_EQ(signed_sizes[i], leb128_size);
+    data += leb128_size;
+  }
+}
+
 TEST_F(Reader, ValidEncodings) {
   ByteReader reader(ENDIANNESS_LITTLE);
   EXPECT_TRUE(reader.ValidEncoding(
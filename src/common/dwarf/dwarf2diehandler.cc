@@ -112,6 +112,14 @@ bool DIEDispatcher::StartDIE(uint64 offset, enum DwarfTag tag) {
   return handler != NULL;
 }
 
+bool DIEDispatcher::SkipChildren(uint64 offset) {
+  // StartDIE has just returned false, so the top of the stack is either
+  // this DIE's own NULL-handler entry or that of an ignored ancestor.
+  // The reader's EndDIE call for this DIE will pop the former.
+  assert(!die_handlers_.empty() && !die_handlers_.top().handler_);
+  return true;
+}
+
 void DIEDispatcher::EndDIE(uint64 offset) {
   assert(!die_handlers_.empty());
   HandlerStack *entry = &die_handlers_.top();
@@ -294,6 +294,9 @@ class DIEDispatcher: public Dwarf2Handler {
                             uint8 offset_size, uint64 cu_length,
                             uint8 dwarf_version);
   bool StartDIE(uint64 offset, enum DwarfTag tag);
+  // A DIE that StartDIE declined has no handler, and neither do any of
+  // its descendants, so the reader may always skip them.
+  bool SkipChildren(uint64 offset);
   void ProcessAttributeUnsigned(uint64 offset,
                                 enum DwarfAttribute attr,
                                 enum DwarfForm form,
@@ -179,6 +179,55 @@ TEST(Dwarf2DIEHandler, SkipRootDIEChildren) {
   die_dispatcher.EndDIE(0x7d08242b4b510cf2LL);
 }
 
+// A child that FindChildHandler declines may be skipped along with its
+// whole subtree, with just an EndDIE call for the child itself; the
+// dispatcher should then carry on with the child's siblings.
+TEST(Dwarf2DIEHandler, SkipDeclinedSubtree) {
+  MockRootDIEHandler mock_root_handler;
+  MockDIEHandler *mock_child_handler = new(MockDIEHandler);
+  DIEDispatcher die_dispatcher(&mock_root_handler);
+
+  {
+    InSequence s;
+
+    EXPECT_CALL(mock_root_handler,
+                StartCompilationUnit(0x6b4a8e2f1c0d3759LL, 0x08, 0x04,
+                                     0x1f2e3d4c5b6a7988LL, 0x04))
+      .WillOnce(Return(true));
+    EXPECT_CALL(mock_root_handler,
+                StartRootDIE(0x2a5e8cc1d7f30b64LL, (DwarfTag) 0x4e1a6f09))
+      .WillOnce(Return(true));
+    EXPECT_CALL(mock_root_handler, EndAttributes())
+      .WillOnce(Return(true));
+    EXPECT_CALL(mock_root_handler,
+                FindChildHandler(0x5d0c3b7a91e42f68LL, (DwarfTag) 0x7a3c2d11))
+      .WillOnce(Return((DIEHandler *) NULL));
+    EXPECT_CALL(mock_root_handler,
+                FindChildHandler(0x71f94e2a6c8b0d35LL, (DwarfTag) 0x2c5e7b90))
+      .WillOnce(Return(mock_child_handler));
+    EXPECT_CALL(*mock_child_handler, EndAttributes())
+      .WillOnce(Return(false));
+    EXPECT_CALL(*mock_child_handler, Finish())
+      .WillOnce(Return());
+    EXPECT_CALL(mock_root_handler, Finish())
+      .WillOnce(Return());
+  }
+
+  EXPECT_TRUE(die_dispatcher.StartCompilationUnit(0x6b4a8e2f1c0d3759LL,
+                                                  0x08, 0x04,
+                                                  0x1f2e3d4c5b6a7988LL, 0x04));
+  EXPECT_TRUE(die_dispatcher.StartDIE(0x2a5e8cc1d7f30b64LL,
+                                      (DwarfTag) 0x4e1a6f09));
+  EXPECT_FALSE(die_dispatcher.StartDIE(0x5d0c3b7a91e42f68LL,
+                                       (DwarfTag) 0x7a3c2d11));
+  EXPECT_TRUE(die_dispatcher.SkipChildren(0x5d0c3b7a91e42f68LL));
+  die_dispatcher.EndDIE(0x5d0c3b7a91e42f68LL);
+  EXPECT_TRUE(die_dispatcher.StartDIE(0x71f94e2a6c8b0d35LL,
+                                      (DwarfTag) 0x2c5e7b90));
+  die_dispatcher.EndDIE(0x71f94e2a6c8b0d35LL);
+  die_dispatcher.EndDIE(0x2a5e8cc1d7f30b64LL);
+}
+
 // The dispatcher should pass attribute values through to the die
 // handler accurately.
 TEST(Dwarf2DIEHandler, PassAttributeValues) {
@@ -38,6 +38,7 @@
 #include <stdio.h>
 #include <string.h>
 
+#include <algorithm>
 #include <map>
 #include <memory>
 #include <stack>
@@ -55,7 +56,47 @@ CompilationUnit::CompilationUnit(const SectionMap& sections, uint64 offset,
                                  ByteReader* reader, Dwarf2Handler* handler)
     : offset_from_section_start_(offset), reader_(reader),
       sections_(sections), handler_(handler), abbrevs_(NULL),
-      string_buffer_(NULL), string_buffer_length_(0) {}
+      abbrev_cache_(NULL), string_buffer_(NULL), string_buffer_length_(0) {}
+
+CompilationUnit::AbbrevCache::AbbrevCache() {
+  pthread_mutex_init(&mutex_, NULL);
+}
+
+CompilationUnit::AbbrevCache::~AbbrevCache() {
+  for (AbbrevTableMap::iterator it = tables_.begin();
+       it != tables_.end(); ++it)
+    delete it->second;
+  pthread_mutex_destroy(&mutex_);
+}
+
+size_t CompilationUnit::AbbrevCache::size() const {
+  pthread_mutex_lock(&mutex_);
+  size_t size = tables_.size();
+  pthread_mutex_unlock(&mutex_);
+  return size;
+}
+
+const std::vector<CompilationUnit::Abbrev>*
+CompilationUnit::AbbrevCache::Find(uint64 offset) const {
+  pthread_mutex_lock(&mutex_);
+  AbbrevTableMap::const_iterator it = tables_.find(offset);
+  const std::vector<Abbrev>* table = it == tables_.end() ? NULL : it->second;
+  pthread_mutex_unlock(&mutex_);
+  return table;
+}
+
+const std::vector<CompilationUnit::Abbrev>*
+CompilationUnit::AbbrevCache::Insert(uint64 offset,
+                                     std::vector<Abbrev>* table) {
+  pthread_mutex_lock(&mutex_);
+  std::pair<AbbrevTableMap::iterator, bool> result =
+      tables_.insert(std::make_pair(offset, table));
+  const std::vector<Abbrev>* cached = result.first->second;
+  pthread_mutex_unlock(&mutex_);
+  if (!result.second)
+    delete table;
+  return cached;
+}
 
 // Read a DWARF2/3 abbreviation section.
 // Each abbrev consists of a abbreviation number, a tag, a byte
@@ -69,6 +110,17 @@ void CompilationUnit::ReadAbbrevs() {
   if (abbrevs_)
     return;
 
+  if (!abbrev_cache_) {
+    abbrevs_ = ParseAbbrevs();
+    return;
+  }
+
+  abbrevs_ = abbrev_cache_->Find(header_.abbrev_offset);
+  if (!abbrevs_)
+    abbrevs_ = abbrev_cache_->Insert(header_.abbrev_offset, ParseAbbrevs());
+}
+
+std::vector<CompilationUnit::Abbrev>* CompilationUnit::ParseAbbrevs() {
   // First get the debug_abbrev section.  ".debug_abbrev" is the name
   // recommended in the DWARF spec, and used on Linux;
   // "__debug_abbrev" is the name used in Mac OS X Mach-O files.
@@ -77,8 +129,8 @@ void CompilationUnit::ReadAbbrevs() {
     iter = sections_.find("__debug_abbrev");
   assert(iter != sections_.end());
 
-  abbrevs_ = new std::vector<Abbrev>;
-  abbrevs_->resize(1);
+  std::vector<Abbrev>* abbrevs = new std::vector<Abbrev>;
+  abbrevs->resize(1);
 
   // The only way to check whether we are reading over the end of the
   // buffer would be to first compute the size of the leb128 data by
@@ -91,12 +143,14 @@ void CompilationUnit::ReadAbbrevs() {
 #endif
 
   while (1) {
-    CompilationUnit::Abbrev abbrev;
     size_t len;
     const uint64 number = reader_->ReadUnsignedLEB128(abbrevptr, &len);
 
     if (number == 0)
       break;
+    assert(number == abbrevs->size());
+    abbrevs->push_back(Abbrev());
+    CompilationUnit::Abbrev& abbrev = abbrevs->back();
     abbrev.number = number;
     abbrevptr += len;
 
@@ -126,22 +180,178 @@ void CompilationUnit::ReadAbbrevs() {
       const enum DwarfForm form = static_cast<enum DwarfForm>(formtemp);
       abbrev.attributes.push_back(std::make_pair(name, form));
     }
-    assert(abbrev.number == abbrevs_->size());
-    abbrevs_->push_back(abbrev);
+    PlanSkipDIE(&abbrev);
   }
+  return abbrevs;
 }
 
-// Skips a single DIE's attributes.
+// static
+void CompilationUnit::PlanSkipDIE(Abbrev* abbrev) {
+  Abbrev::SkipStep step = { 0, 0, 0, false, DW_FORM_addr };
+  abbrev->sibling_index = -1;
+  for (AttributeList::const_iterator i = abbrev->attributes.begin();
+       i != abbrev->attributes.end();
+       i++) {
+    if (i->first == DW_AT_sibling && abbrev->sibling_index < 0)
+      abbrev->sibling_index = static_cast<int>(i - abbrev->attributes.begin());
+    switch (i->second) {
+      case DW_FORM_flag_present:
+        break;
+      case DW_FORM_data1:
+      case DW_FORM_flag:
+      case DW_FORM_ref1:
+        step.fixed_size += 1;
+        break;
+      case DW_FORM_ref2:
+      case DW_FORM_data2:
+        step.fixed_size += 2;
+        break;
+      case DW_FORM_ref4:
+      case DW_FORM_data4:
+        step.fixed_size += 4;
+        break;
+      case DW_FORM_ref8:
+      case DW_FORM_data8:
+      case DW_FORM_ref_sig8:
+        step.fixed_size += 8;
+        break;
+      case DW_FORM_addr:
+        step.address_count++;
+        break;
+      case DW_FORM_strp:
+      case DW_FORM_sec_offset:
+        step.offset_count++;
+        break;
+      default:
+        // DW_FORM_ref_addr depends on the CU's version, and everything
+        // else has to be read; leave those to SkipAttribute.
+        step.has_form = true;
+        step.form = i->second;
+        abbrev->skip_plan.push_back(step);
+        step.fixed_size = step.address_count = step.offset_count = 0;
+        step.has_form = false;
+        break;
+    }
+  }
+  if (step.fixed_size || step.address_count || step.offset_count)
+    abbrev->skip_plan.push_back(step);
+}
+
+// Skips a single DIE's attributes, following the abbreviation's plan.
 const char* CompilationUnit::SkipDIE(const char* start,
                                               const Abbrev& abbrev) {
-  for (AttributeList::const_iterator i = abbrev.attributes.begin();
-       i != abbrev.attributes.end();
-       i++)  {
-    start = SkipAttribute(start, i->second);
+  const uint64 address_size = reader_->AddressSize();
+  const uint64 offset_size = reader_->OffsetSize();
+  for (std::vector<Abbrev::SkipStep>::const_iterator i =
+           abbrev.skip_plan.begin();
+       i != abbrev.skip_plan.end();
+       i++) {
+    start += i->fixed_size + i->address_count * address_size +
+             i->offset_count * offset_size;
+    if (i->has_form) {
+      start = SkipAttribute(start, i->form);
+      if (!start)
+        return NULL;
+    }
   }
   return start;
 }
 
+// Skips a DIE and its subtree, jumping to DW_AT_sibling where possible
+// and otherwise walking the descendants' attributes without reporting
+// them.
+const char* CompilationUnit::SkipDIEAndChildren(const char* start,
+                                                const Abbrev& abbrev,
+                                                const char* end) {
+  const Abbrev* current = &abbrev;
+  uint64 depth = 0;
+  while (1) {
+    const char* sibling =
+        current->has_children ? FindSibling(start, *current, end) : NULL;
+    if (sibling) {
+      start = sibling;
+    } else {
+      start = SkipDIE(start, *current);
+      if (!start)
+        return NULL;
+      if (current->has_children)
+        depth++;
+    }
+
+    // Find the next DIE to skip, leaving finished lists of children.
+    while (1) {
+      if (depth == 0)
+        return start;
+      if (start >= end)
+        return end;
+      size_t len;
+      const uint64 abbrev_num = reader_->ReadUnsignedLEB128(start, &len);
+      start += len;
+      if (abbrev_num == 0) {
+        depth--;
+        continue;
+      }
+      current = &abbrevs_->at(static_cast<size_t>(abbrev_num));
+      break;
+    }
+  }
+}
+
+const char* CompilationUnit::FindSibling(const char* start,
+                                         const Abbrev& abbrev,
+                                         const char* end) {
+  if (abbrev.sibling_index < 0)
+    return NULL;
+  for (int i = 0; i < abbrev.sibling_index; i++) {
+    start = SkipAttribute(start, abbrev.attributes[i].second);
+    if (!start)
+      return NULL;
+  }
+
+  size_t len;
+  enum DwarfForm form = abbrev.attributes[abbrev.sibling_index].second;
+  if (form == DW_FORM_indirect) {
+    form = static_cast<enum DwarfForm>(reader_->ReadUnsignedLEB128(start,
+                                                                   &len));
+    start += len;
+  }
+
+  // The offset of the sibling from the start of this compilation unit.
+  uint64 offset;
+  switch (form) {
+    case DW_FORM_ref1:
+      offset = reader_->ReadOneByte(start);
+      break;
+    case DW_FORM_ref2:
+      offset = reader_->ReadTwoBytes(start);
+      break;
+    case DW_FORM_ref4:
+      offset = reader_->ReadFourBytes(start);
+      break;
+    case DW_FORM_ref8:
+      offset = reader_->ReadEightBytes(start);
+      break;
+    case DW_FORM_ref_udata:
+      offset = reader_->ReadUnsignedLEB128(start, &len);
+      break;
+    case DW_FORM_ref_addr: {
+      const uint64 section_offset = header_.version == 2 ?
+          reader_->ReadAddress(start) : reader_->ReadOffset(start);
+      if (section_offset < offset_from_section_start_)
+        return NULL;
+      offset = section_offset - offset_from_section_start_;
+      break;
+    }
+    default:
+      return NULL;
+  }
+
+  if (offset <= static_cast<uint64>(start - buffer_) ||
+      offset > static_cast<uint64>(end - buffer_))
+    return NULL;
+  return buffer_ + offset;
+}
+
 // Skips a single attribute form's data.
 const char* CompilationUnit::SkipAttribute(const char* start,
                                                     enum DwarfForm form) {
@@ -502,6 +712,14 @@ void CompilationUnit::ProcessDIEs() {
     const Abbrev& abbrev = abbrevs_->at(static_cast<size_t>(abbrev_num));
     const enum DwarfTag tag = abbrev.tag;
     if (!handler_->StartDIE(absolute_offset, tag)) {
+      if (abbrev.has_children && handler_->SkipChildren(absolute_offset)) {
+        dieptr = SkipDIEAndChildren(dieptr, abbrev,
+                                    lengthstart + header_.length);
+        handler_->EndDIE(absolute_offset);
+        if (!dieptr)
+          return;
+        continue;
+      }
       dieptr = SkipDIE(dieptr, abbrev);
     } else {
       dieptr = ProcessDIE(absolute_offset, dieptr, abbrev);
@@ -2084,16 +2302,51 @@ bool CallFrameInfo::ReadFDEFields(FDE *fde) {
   return true;
 }
   
-bool CallFrameInfo::Start() {
+void CallFrameInfo::SplitEntries(size_t count,
+                                 std::vector<size_t> *offsets) const {
+  offsets->clear();
+  offsets->push_back(0);
+  if (count <= 1)
+    return;
+
+  size_t range_size = buffer_length_ / count;
+  size_t offset = 0;
+  while (offset < buffer_length_) {
+    // Read the initial length without disturbing reader_'s offset size,
+    // which the parser sets for itself.
+    if (buffer_length_ - offset < 4)
+      return;
+    uint64 length = reader_->ReadFourBytes(buffer_ + offset);
+    size_t length_size = 4;
+    if (length == 0xffffffff) {
+      if (buffer_length_ - offset < 12)
+        return;
+      length = reader_->ReadEightBytes(buffer_ + offset + 4);
+      length_size = 12;
+    }
+    if ((length == 0 && eh_frame_) ||
+        length > buffer_length_ - offset - length_size)
+      return;
+    offset += length_size + length;
+
+    if (offset < buffer_length_ &&
+        offset - offsets->back() >= range_size &&
+        offsets->size() < count)
+      offsets->push_back(offset);
+  }
+}
+
+bool CallFrameInfo::StartRange(size_t begin, size_t end) {
   const char *buffer_end = buffer_ + buffer_length_;
+  const char *range_end = buffer_ + std::min(end, buffer_length_);
   const char *cursor;
   bool all_ok = true;
   const char *entry_end;
   bool ok;
 
-  // Traverse all the entries in buffer_, skipping CIEs and offering
+  // Traverse all the entries in the range, skipping CIEs and offering
   // FDEs to the handler.
-  for (cursor = buffer_; cursor < buffer_end;
+  for (cursor = buffer_ + begin; cursor < range_end;
        cursor = entry_end, all_ok = all_ok && ok) {
     FDE fde;
 
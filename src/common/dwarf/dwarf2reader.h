@@ -40,7 +40,8 @@
 #ifndef COMMON_DWARF_DWARF2READER_H__
 #define COMMON_DWARF_DWARF2READER_H__
 
-#include <list>
+#include <pthread.h>
+
 #include <map>
 #include <string>
 #include <utility>
@@ -59,7 +60,7 @@ class LineInfoHandler;
 // This maps from a string naming a section to a pair containing a
 // the data for the section, and the size of the section.
 typedef std::map<string, std::pair<const char*, uint64> > SectionMap;
-typedef std::list<std::pair<enum DwarfAttribute, enum DwarfForm> >
+typedef std::vector<std::pair<enum DwarfAttribute, enum DwarfForm> >
     AttributeList;
 typedef AttributeList::iterator AttributeIterator;
 typedef AttributeList::const_iterator ConstAttributeIterator;
@@ -217,6 +218,7 @@ class LineInfoHandler {
 
 class CompilationUnit {
  public:
+  class AbbrevCache;
 
   // Initialize a compilation unit.  This requires a map of sections,
   // the offset of this compilation unit in the .debug_info section, a
@@ -224,9 +226,15 @@ class CompilationUnit {
   CompilationUnit(const SectionMap& sections, uint64 offset,
                   ByteReader* reader, Dwarf2Handler* handler);
   virtual ~CompilationUnit() {
-    if (abbrevs_) delete abbrevs_;
+    if (abbrevs_ && !abbrev_cache_) delete abbrevs_;
   }
 
+  // Share parsed abbreviation tables with the other compilation units
+  // using CACHE, which must outlive this CompilationUnit and be used
+  // only with units from the same .debug_abbrev section.  Call this
+  // before Start.
+  void set_abbrev_cache(AbbrevCache* cache) { abbrev_cache_ = cache; }
+
   // Begin reading a Dwarf2 compilation unit, and calling the
   // callbacks in the Dwarf2Handler
 
@@ -242,10 +250,28 @@ class CompilationUnit {
   // The abbreviation tells how to read a DWARF2/3 DIE, and consist of a
   // tag and a list of attributes, as well as the data form of each attribute.
   struct Abbrev {
+    // One step of a plan for skipping a DIE with this abbreviation: a
+    // run of attributes whose sizes are known without reading them,
+    // followed by at most one attribute that must be decoded to find
+    // its size.  Address- and offset-sized attributes are counted
+    // rather than sized, since CUs with different address or offset
+    // sizes may share one abbreviation table.
+    struct SkipStep {
+      uint64 fixed_size;
+      uint32 address_count;
+      uint32 offset_count;
+      bool has_form;
+      enum DwarfForm form;
+    };
+
     uint64 number;
     enum DwarfTag tag;
     bool has_children;
     AttributeList attributes;
+    std::vector<SkipStep> skip_plan;
+
+    // The index in attributes of the DW_AT_sibling attribute, or -1.
+    int sibling_index;
   };
 
   // A DWARF2/3 compilation unit header.  This is not the same size as
@@ -261,9 +287,18 @@ class CompilationUnit {
   // Reads the DWARF2/3 header for this compilation unit.
   void ReadHeader();
 
-  // Reads the DWARF2/3 abbreviations for this compilation unit
+  // Reads the DWARF2/3 abbreviations for this compilation unit, or
+  // finds them in abbrev_cache_.
   void ReadAbbrevs();
 
+  // Parses the abbreviation table at header_.abbrev_offset into a new
+  // vector, which the caller owns.
+  std::vector<Abbrev>* ParseAbbrevs();
+
+  // Fills in abbrev->skip_plan and abbrev->sibling_index from
+  // abbrev->attributes.
+  static void PlanSkipDIE(Abbrev* abbrev);
+
   // Processes a single DIE for this compilation unit and return a new
   // pointer just past the end of it
   const char* ProcessDIE(uint64 dieoffset,
@@ -285,6 +320,19 @@ class CompilationUnit {
   const char* SkipDIE(const char* start,
                                const Abbrev& abbrev);
 
+  // Skips the die with attributes specified in ABBREV starting at START,
+  // along with all its descendants, and return the new place to position
+  // the stream to.  END is the end of this compilation unit's DIEs.
+  const char* SkipDIEAndChildren(const char* start, const Abbrev& abbrev,
+                                 const char* end);
+
+  // If ABBREV has a DW_AT_sibling attribute, return a pointer to the
+  // sibling of the die whose attributes start at START.  Return NULL if
+  // there is no such attribute, or if its value does not point forward
+  // within this compilation unit.
+  const char* FindSibling(const char* start, const Abbrev& abbrev,
+                          const char* end);
+
   // Skips the attribute starting at START, with FORM, and return the
   // new place to position the stream to.
   const char* SkipAttribute(const char* start,
@@ -312,8 +360,12 @@ class CompilationUnit {
 
   // Set of DWARF2/3 abbreviations for this compilation unit.  Indexed
   // by abbreviation number, which means that abbrevs_[0] is not
-  // valid.
-  std::vector<Abbrev>* abbrevs_;
+  // valid.  Owned by abbrev_cache_, if we have one.
+  const std::vector<Abbrev>* abbrevs_;
+
+  // The cache of abbreviation tables shared with other compilation
+  // units, or NULL.
+  AbbrevCache* abbrev_cache_;
 
   // String section buffer and length, if we have a string section.
   // This is here to avoid doing a section lookup for strings in
@@ -322,6 +374,41 @@ class CompilationUnit {
   uint64 string_buffer_length_;
 };
 
+// A cache of the abbreviation tables parsed by CompilationUnits, keyed
+// by their offset in .debug_abbrev.  Linkers often leave many
+// compilation units sharing a single table, which then only needs to
+// be parsed once.  The cache may be shared by CompilationUnits being
+// read on different threads.
+class CompilationUnit::AbbrevCache {
+ public:
+  AbbrevCache();
+  ~AbbrevCache();
+
+  // The number of distinct tables cached.
+  size_t size() const;
+
+ private:
+  friend class CompilationUnit;
+
+  typedef std::map<uint64, const std::vector<Abbrev>*> AbbrevTableMap;
+
+  // Returns the table at OFFSET, or NULL if it hasn't been cached.
+  const std::vector<Abbrev>* Find(uint64 offset) const;
+
+  // Caches TABLE, which was parsed from OFFSET, taking ownership of it.
+  // If another unit cached the table at OFFSET first, TABLE is deleted.
+  // Returns the cached table.
+  const std::vector<Abbrev>* Insert(uint64 offset,
+                                    std::vector<Abbrev>* table);
+
+  AbbrevTableMap tables_;
+  mutable pthread_mutex_t mutex_;
+
+  // Disallow copy constructor and assignment operator.
+  AbbrevCache(const AbbrevCache&);
+  void operator=(const AbbrevCache&);
+};
+
 // This class is the main interface between the reader and the
 // client.  The virtual functions inside this get called for
 // interesting events that happen during DWARF2 reading.
@@ -344,6 +431,14 @@ class Dwarf2Handler {
   // section. Return false if you would like to skip this DIE.
   virtual bool StartDIE(uint64 offset, enum DwarfTag tag) { return false; }
 
+  // Called when StartDIE has returned false for a DIE at OFFSET that has
+  // children.  Return true if none of the DIE's descendants are of
+  // interest either: the reader then skips the whole subtree, using the
+  // DIE's DW_AT_sibling attribute when it has one, and calls EndDIE for
+  // the DIE straight away.  Return false to have the children reported
+  // as usual.
+  virtual bool SkipChildren(uint64 offset) { return false; }
+
   // Called when we have an attribute with unsigned data to give to our
   // handler. The attribute is for the DIE at OFFSET from the beginning of the
   // .debug_info section. Its name is ATTR, its form is FORM, and its value is
@@ -649,7 +744,21 @@ class CallFrameInfo {
   // Parse the entries in BUFFER, reporting what we find to HANDLER.
   // Return true if we reach the end of the section successfully, or
   // false if we encounter an error.
-  bool Start();
+  bool Start() { return StartRange(0, buffer_length_); }
+
+  // Like Start, but only parse the entries that begin at offsets from
+  // BEGIN up to END in BUFFER. BEGIN must be the offset of an entry;
+  // SplitEntries finds suitable offsets. FDEs may refer to CIEs
+  // anywhere in BUFFER. Return true if we reach END successfully.
+  bool StartRange(size_t begin, size_t end);
+
+  // Divide BUFFER at entry boundaries into at most COUNT ranges of
+  // similar size, and set OFFSETS to the offset of the start of each
+  // range, the first being zero. Ranges that can be parsed one after
+  // another with StartRange, offering the same entries as Start. If we
+  // can't make sense of an entry's length, or reach an .eh_frame
+  // terminator, the last range runs from there to the end of BUFFER.
+  void SplitEntries(size_t count, std::vector<size_t> *offsets) const;
 
   // Return the textual name of KIND. For error reporting.
   static const char *KindName(EntryKind kind);
@@ -436,6 +436,60 @@ TEST_F(CFI, TwoFDEsTwoCIEs) {
   EXPECT_TRUE(parser.Start());
 }
 
+// Ranges found by SplitEntries can be parsed separately, even when an
+// FDE's CIE lies in another range.
+TEST_F(CFI, SplitEntries) {
+  CFISection section(kLittleEndian, 8);
+  Label cie1, cie2;
+  section
+      .Mark(&cie1)
+      .CIEHeader(0x694d5d45, 0x4233221b, 0xbf45e65a, 3, "")
+      .FinishEntry()
+      .FDEHeader(cie2, 0x778b27dfe5871f05ULL, 0x324ace3448070926ULL)
+      .FinishEntry()
+      .FDEHeader(cie1, 0xf6054ca18b10bf5fULL, 0x45fdb970d8bca342ULL)
+      .FinishEntry()
+      .Mark(&cie2)
+      .CIEHeader(0xfba3fad7, 0x6287e1fd, 0x61d2c581, 2, "")
+      .FinishEntry();
+
+  {
+    InSequence s;
+    EXPECT_CALL(handler,
+                Entry(_, 0x778b27dfe5871f05ULL, 0x324ace3448070926ULL, 2,
+                      "", 0x61d2c581))
+        .WillOnce(Return(true));
+    EXPECT_CALL(handler, End()).WillOnce(Return(true));
+    EXPECT_CALL(handler,
+                Entry(_, 0xf6054ca18b10bf5fULL, 0x45fdb970d8bca342ULL, 3,
+                      "", 0xbf45e65a))
+        .WillOnce(Return(true));
+    EXPECT_CALL(handler, End()).WillOnce(Return(true));
+  }
+
+  string contents;
+  EXPECT_TRUE(section.GetContents(&contents));
+  ByteReader byte_reader(ENDIANNESS_LITTLE);
+  byte_reader.SetAddressSize(8);
+  CallFrameInfo parser(contents.data(), contents.size(),
+                       &byte_reader, &handler, &reporter);
+
+  vector<size_t> offsets;
+  parser.SplitEntries(1, &offsets);
+  ASSERT_EQ(1U, offsets.size());
+  EXPECT_EQ(0U, offsets[0]);
+
+  // One entry per range at most.
+  parser.SplitEntries(10, &offsets);
+  ASSERT_EQ(4U, offsets.size());
+  EXPECT_EQ(0U, offsets[0]);
+  offsets.push_back(contents.size());
+  for (size_t i = 0; i + 1 < offsets.size(); i++) {
+    EXPECT_LT(offsets[i], offsets[i + 1]);
+    EXPECT_TRUE(parser.StartRange(offsets[i], offsets[i + 1]));
+  }
+}
+
 // An FDE whose CIE specifies a version we don't recognize.
 TEST_F(CFI, BadVersion) {
   CFISection section(kBigEndian, 4);
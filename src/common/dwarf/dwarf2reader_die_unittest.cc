@@ -76,6 +76,7 @@ class MockDwarf2Handler: public Dwarf2Handler {
                                           uint8 offset_size, uint64 cu_length,
                                           uint8 dwarf_version));
   MOCK_METHOD2(StartDIE, bool(uint64 offset, enum DwarfTag tag));
+  MOCK_METHOD1(SkipChildren, bool(uint64 offset));
   MOCK_METHOD4(ProcessAttributeUnsigned, void(uint64 offset,
                                               DwarfAttribute attr,
                                               enum DwarfForm form,
@@ -227,6 +228,52 @@ INSTANTIATE_TEST_CASE_P(
                       DwarfHeaderParams(kBigEndian,    8, 4, 4),
                       DwarfHeaderParams(kBigEndian,    8, 4, 8)));
 
+struct AbbrevCache: public DIEFixture, public Test { };
+
+TEST_F(AbbrevCache, SharedTable) {
+  Label abbrev_table = abbrevs.Here();
+  abbrevs.Abbrev(1, dwarf2reader::DW_TAG_compile_unit,
+                 dwarf2reader::DW_children_no)
+      .Attribute(dwarf2reader::DW_AT_name, dwarf2reader::DW_FORM_string)
+      .EndAbbrev()
+      .EndTable();
+
+  info.set_format_size(4);
+  info.set_endianness(kLittleEndian);
+  info.Header(2, abbrev_table, 4)
+      .ULEB128(1)                     // DW_TAG_compile_unit, no children
+      .AppendCString("sam");          // DW_AT_name, DW_FORM_string
+  info.Finish();
+
+  // Both readers should see the same DIE, though the second one uses
+  // the table parsed by the first.
+  EXPECT_CALL(handler, StartCompilationUnit(0, 4, 4, _, 2))
+      .Times(2).WillRepeatedly(Return(true));
+  EXPECT_CALL(handler, StartDIE(_, dwarf2reader::DW_TAG_compile_unit))
+      .Times(2).WillRepeatedly(Return(true));
+  EXPECT_CALL(handler, ProcessAttributeString(_, dwarf2reader::DW_AT_name,
+                                              dwarf2reader::DW_FORM_string,
+                                              "sam"))
+      .Times(2).WillRepeatedly(Return());
+  EXPECT_CALL(handler, EndDIE(_)).Times(2).WillRepeatedly(Return());
+
+  ByteReader byte_reader(ENDIANNESS_LITTLE);
+  CompilationUnit::AbbrevCache cache;
+  const SectionMap &section_map = MakeSectionMap();
+  {
+    CompilationUnit parser(section_map, 0, &byte_reader, &handler);
+    parser.set_abbrev_cache(&cache);
+    EXPECT_EQ(parser.Start(), info_contents.size());
+  }
+  EXPECT_EQ(1U, cache.size());
+  {
+    CompilationUnit parser(section_map, 0, &byte_reader, &handler);
+    parser.set_abbrev_cache(&cache);
+    EXPECT_EQ(parser.Start(), info_contents.size());
+  }
+  EXPECT_EQ(1U, cache.size());
+}
+
 struct DwarfFormsFixture: public DIEFixture {
   // Start a compilation unit, as directed by |params|, containing one
   // childless DIE of the given tag, with one attribute of the given name
@@ -454,6 +501,211 @@ TEST_P(DwarfForms, ref_sig8_not_first) {
   ParseCompilationUnit(GetParam(), 98);
 }
 
+// A DIE whose handler declines it is skipped using its abbreviation's
+// skip plan. Mix fixed-size, address-sized, offset-sized and variable-size
+// forms, and check that the next DIE is read from the right place.
+TEST_P(DwarfForms, skip_die) {
+  const DwarfHeaderParams &params = GetParam();
+  Label abbrev_table = abbrevs.Here();
+  abbrevs.Abbrev(1, dwarf2reader::DW_TAG_compile_unit,
+                 dwarf2reader::DW_children_yes)
+      .Attribute(dwarf2reader::DW_AT_name, dwarf2reader::DW_FORM_data1)
+      .EndAbbrev()
+      .Abbrev(2, dwarf2reader::DW_TAG_subprogram, dwarf2reader::DW_children_no)
+      .Attribute((DwarfAttribute) 0x2001, dwarf2reader::DW_FORM_data1)
+      .Attribute((DwarfAttribute) 0x2002, dwarf2reader::DW_FORM_addr)
+      .Attribute((DwarfAttribute) 0x2003, dwarf2reader::DW_FORM_strp)
+      .Attribute((DwarfAttribute) 0x2004, dwarf2reader::DW_FORM_udata)
+      .Attribute((DwarfAttribute) 0x2005, dwarf2reader::DW_FORM_flag_present)
+      .Attribute((DwarfAttribute) 0x2006, dwarf2reader::DW_FORM_ref_addr)
+      .Attribute((DwarfAttribute) 0x2007, dwarf2reader::DW_FORM_block1)
+      .Attribute((DwarfAttribute) 0x2008, dwarf2reader::DW_FORM_sdata)
+      .Attribute((DwarfAttribute) 0x2009, dwarf2reader::DW_FORM_data2)
+      .Attribute((DwarfAttribute) 0x200a, dwarf2reader::DW_FORM_string)
+      .Attribute((DwarfAttribute) 0x200b, dwarf2reader::DW_FORM_sec_offset)
+      .Attribute((DwarfAttribute) 0x200c, dwarf2reader::DW_FORM_indirect)
+      .Attribute((DwarfAttribute) 0x200d, dwarf2reader::DW_FORM_ref4)
+      .EndAbbrev()
+      .Abbrev(3, dwarf2reader::DW_TAG_variable, dwarf2reader::DW_children_no)
+      .Attribute(dwarf2reader::DW_AT_name, dwarf2reader::DW_FORM_data4)
+      .EndAbbrev()
+      .EndTable();
+
+  info.set_format_size(params.format_size);
+  info.set_endianness(params.endianness);
+  info.Header(params.version, abbrev_table, params.address_size)
+      .ULEB128(1).D8(0x2a)
+      .ULEB128(2)
+      .D8(0x11)
+      .Append(params.endianness, params.address_size, 0x1234)
+      .Append(params.endianness, params.format_size, 0x5678)
+      .ULEB128(0x3fff)
+      .Append(params.endianness,
+              params.version == 2 ? params.address_size : params.format_size,
+              0x9abc)
+      .D8(3).D8(0xde).D8(0xad).D8(0xbe)
+      .LEB128(-200)
+      .D16(0x4321)
+      .AppendCString("skipped")
+      .Append(params.endianness, params.format_size, 0xdef0)
+      .ULEB128(dwarf2reader::DW_FORM_data8).D64(0x0123456789abcdefULL)
+      .D32(0x87654321)
+      .ULEB128(3).D32(0xcafef00d)
+      .D8(0);
+  info.Finish();
+
+  ExpectBeginCompilationUnit(params, dwarf2reader::DW_TAG_compile_unit);
+  EXPECT_CALL(handler, ProcessAttributeUnsigned(_, dwarf2reader::DW_AT_name,
+                                                dwarf2reader::DW_FORM_data1,
+                                                0x2a))
+      .InSequence(s)
+      .WillOnce(Return());
+  EXPECT_CALL(handler, StartDIE(_, dwarf2reader::DW_TAG_subprogram))
+      .InSequence(s)
+      .WillOnce(Return(false));
+  EXPECT_CALL(handler, EndDIE(_))
+      .InSequence(s)
+      .WillOnce(Return());
+  EXPECT_CALL(handler, StartDIE(_, dwarf2reader::DW_TAG_variable))
+      .InSequence(s)
+      .WillOnce(Return(true));
+  EXPECT_CALL(handler, ProcessAttributeUnsigned(_, dwarf2reader::DW_AT_name,
+                                                dwarf2reader::DW_FORM_data4,
+                                                0xcafef00d))
+      .InSequence(s)
+      .WillOnce(Return());
+  EXPECT_CALL(handler, EndDIE(_))
+      .InSequence(s)
+      .WillOnce(Return());
+  ExpectEndCompilationUnit();
+
+  ParseCompilationUnit(params);
+}
+
+// When the handler declines a DIE and its children, the reader jumps to
+// the DIE's DW_AT_sibling without looking at the children at all; these
+// ones would not even parse.
+TEST_P(DwarfForms, skip_children_sibling) {
+  const DwarfHeaderParams &params = GetParam();
+  Label abbrev_table = abbrevs.Here();
+  abbrevs.Abbrev(1, dwarf2reader::DW_TAG_compile_unit,
+                 dwarf2reader::DW_children_yes)
+      .EndAbbrev()
+      .Abbrev(2, dwarf2reader::DW_TAG_structure_type,
+              dwarf2reader::DW_children_yes)
+      .Attribute(dwarf2reader::DW_AT_name, dwarf2reader::DW_FORM_string)
+      .Attribute(dwarf2reader::DW_AT_sibling, dwarf2reader::DW_FORM_ref4)
+      .EndAbbrev()
+      .Abbrev(3, dwarf2reader::DW_TAG_variable, dwarf2reader::DW_children_no)
+      .Attribute(dwarf2reader::DW_AT_name, dwarf2reader::DW_FORM_data4)
+      .EndAbbrev()
+      .EndTable();
+
+  Label sibling;
+  info.set_format_size(params.format_size);
+  info.set_endianness(params.endianness);
+  info.Header(params.version, abbrev_table, params.address_size)
+      .ULEB128(1)
+      .ULEB128(2).AppendCString("declined").D32(sibling)
+      .ULEB128(0x7f).Append(7, 0xff)
+      .Mark(&sibling)
+      .ULEB128(3).D32(0xcafef00d)
+      .D8(0);
+  info.Finish();
+
+  ExpectBeginCompilationUnit(params, dwarf2reader::DW_TAG_compile_unit);
+  EXPECT_CALL(handler, StartDIE(_, dwarf2reader::DW_TAG_structure_type))
+      .InSequence(s)
+      .WillOnce(Return(false));
+  EXPECT_CALL(handler, SkipChildren(_))
+      .InSequence(s)
+      .WillOnce(Return(true));
+  EXPECT_CALL(handler, EndDIE(_))
+      .InSequence(s)
+      .WillOnce(Return());
+  EXPECT_CALL(handler, StartDIE(_, dwarf2reader::DW_TAG_variable))
+      .InSequence(s)
+      .WillOnce(Return(true));
+  EXPECT_CALL(handler, ProcessAttributeUnsigned(_, dwarf2reader::DW_AT_name,
+                                                dwarf2reader::DW_FORM_data4,
+                                                0xcafef00d))
+      .InSequence(s)
+      .WillOnce(Return());
+  EXPECT_CALL(handler, EndDIE(_))
+      .InSequence(s)
+      .WillOnce(Return());
+  ExpectEndCompilationUnit();
+
+  ParseCompilationUnit(params);
+}
+
+// Without DW_AT_sibling, the reader walks the declined subtree itself,
+// reporting none of it.
+TEST_P(DwarfForms, skip_children_walk) {
+  const DwarfHeaderParams &params = GetParam();
+  Label abbrev_table = abbrevs.Here();
+  abbrevs.Abbrev(1, dwarf2reader::DW_TAG_compile_unit,
+                 dwarf2reader::DW_children_yes)
+      .EndAbbrev()
+      .Abbrev(2, dwarf2reader::DW_TAG_structure_type,
+              dwarf2reader::DW_children_yes)
+      .Attribute(dwarf2reader::DW_AT_name, dwarf2reader::DW_FORM_string)
+      .EndAbbrev()
+      .Abbrev(3, dwarf2reader::DW_TAG_variable, dwarf2reader::DW_children_no)
+      .Attribute(dwarf2reader::DW_AT_name, dwarf2reader::DW_FORM_data4)
+      .EndAbbrev()
+      .Abbrev(4, dwarf2reader::DW_TAG_subprogram,
+              dwarf2reader::DW_children_yes)
+      .Attribute(dwarf2reader::DW_AT_low_pc, dwarf2reader::DW_FORM_addr)
+      .Attribute(dwarf2reader::DW_AT_decl_line, dwarf2reader::DW_FORM_udata)
+      .EndAbbrev()
+      .Abbrev(5, dwarf2reader::DW_TAG_formal_parameter,
+              dwarf2reader::DW_children_no)
+      .Attribute(dwarf2reader::DW_AT_name, dwarf2reader::DW_FORM_string)
+      .EndAbbrev()
+      .EndTable();
+
+  info.set_format_size(params.format_size);
+  info.set_endianness(params.endianness);
+  info.Header(params.version, abbrev_table, params.address_size)
+      .ULEB128(1)
+      .ULEB128(2).AppendCString("declined")
+      .ULEB128(4).Append(params.address_size, 0x42).ULEB128(300)
+      .ULEB128(5).AppendCString("x")
+      .ULEB128(5).AppendCString("y")
+      .D8(0)
+      .ULEB128(5).AppendCString("z")
+      .D8(0)
+      .ULEB128(3).D32(0xcafef00d)
+      .D8(0);
+  info.Finish();
+
+  ExpectBeginCompilationUnit(params, dwarf2reader::DW_TAG_compile_unit);
+  EXPECT_CALL(handler, StartDIE(_, dwarf2reader::DW_TAG_structure_type))
+      .InSequence(s)
+      .WillOnce(Return(false));
+  EXPECT_CALL(handler, SkipChildren(_))
+      .InSequence(s)
+      .WillOnce(Return(true));
+  EXPECT_CALL(handler, EndDIE(_))
+      .InSequence(s)
+      .WillOnce(Return());
+  EXPECT_CALL(handler, StartDIE(_, dwarf2reader::DW_TAG_variable))
+      .InSequence(s)
+      .WillOnce(Return(true));
+  EXPECT_CALL(handler, ProcessAttributeUnsigned(_, dwarf2reader::DW_AT_name,
+                                                dwarf2reader::DW_FORM_data4,
+                                                0xcafef00d))
+      .InSequence(s)
+      .WillOnce(Return());
+  EXPECT_CALL(handler, EndDIE(_))
+      .InSequence(s)
+      .WillOnce(Return());
+  ExpectEndCompilationUnit();
+
+  ParseCompilationUnit(params);
+}
+
 // Tests for the other attribute forms could go here.
 
 INSTANTIATE_TEST_CASE_P(
@@ -0,0 +1,490 @@
+// Copyright (c) 2016 Google Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+// notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above
+// copyright notice, this list of conditions and the following disclaimer
+// in the documentation and/or other materials provided with the
+// distribution.
+//     * Neither the name of Google Inc. nor the names of its
+// contributors may be used to endorse or promote products derived from
+// this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+// Implement the DwarfCUCache class; see dwarf_cu_cache.h.
+
+// For <inttypes.h> PRI* macros, before anything else might #include it.
+#ifndef __STDC_FORMAT_MACROS
+#define __STDC_FORMAT_MACROS
+#endif  /* __STDC_FORMAT_MACROS */
+
+#include "common/dwarf_cu_cache.h"
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <map>
+#include <vector>
+
+#include "common/md5.h"
+
+namespace google_breakpad {
+
+namespace {
+
+using dwarf2reader::DwarfAttribute;
+using dwarf2reader::DwarfForm;
+using dwarf2reader::DwarfTag;
+using std::map;
+using std::vector;
+
+// Part of every digest, so that entries written by a version of dump_syms
+// that digested units or read them differently are never used.
+const char kFormatVersion[] = "DwarfCUCache 1";
+
+// Read an unsigned LEB128 number at CURSOR, which must be before END,
+// into VALUE, and advance CURSOR past it. Return false if the number
+// runs past END.
+bool ReadULEB128(const char** cursor, const char* end, uint64* value) {
+  *value = 0;
+  int shift = 0;
+  while (*cursor < end) {
+    unsigned char byte = **cursor;
+    ++*cursor;
+    if (shift < 64)
+      *value |= static_cast<uint64>(byte & 0x7f) << shift;
+    shift += 7;
+    if (!(byte & 0x80))
+      return true;
+  }
+  return false;
+}
+
+// Feeds the parts of a compilation unit and its line number program that
+// DwarfCUToModule's results depend on into an MD5 digest, with strings,
+// references and addresses in forms that don't change when the unit is
+// merely moved.
+class UnitDigester : public dwarf2reader::Dwarf2Handler,
+                     public dwarf2reader::LineInfoHandler {
+ public:
+  explicit UnitDigester(uint64 unit_offset)
+      : unit_offset_(unit_offset),
+        has_base_(false),
+        base_(0),
+        has_line_program_(false),
+        line_program_offset_(0) {
+    MD5Init(&context_);
+    AddString(kFormatVersion);
+  }
+
+  bool has_line_program() const { return has_line_program_; }
+  uint64 line_program_offset() const { return line_program_offset_; }
+  uint64 base() const { return base_; }
+
+  // Dwarf2Handler methods.
+  bool StartCompilationUnit(uint64 offset, uint8 address_size,
+                            uint8 offset_size, uint64 cu_length,
+                            uint8 dwarf_version) {
+    AddTag('U');
+    Add(address_size);
+    Add(dwarf_version);
+    return true;
+  }
+  bool StartDIE(uint64 offset, DwarfTag tag) {
+    AddTag('D');
+    Add(tag);
+    return true;
+  }
+  void EndDIE(uint64 offset) {
+    AddTag('E');
+  }
+  void ProcessAttributeUnsigned(uint64 offset, DwarfAttribute attr,
+                                DwarfForm form, uint64 data) {
+    AddAttribute(attr, form);
+    if (attr == dwarf2reader::DW_AT_stmt_list) {
+      // The line number program goes in by content, once the DIEs are done.
+      has_line_program_ = true;
+      line_program_offset_ = data;
+    } else if (form == dwarf2reader::DW_FORM_addr) {
+      AddAddress(data);
+    } else if (form != dwarf2reader::DW_FORM_sec_offset) {
+      // Offsets into other sections change whenever anything before them
+      // does, and DwarfCUToModule doesn't follow them.
+      Add(data);
+    }
+  }
+  void ProcessAttributeSigned(uint64 offset, DwarfAttribute attr,
+                              DwarfForm form, int64 data) {
+    AddAttribute(attr, form);
+    Add(static_cast<uint64>(data));
+  }
+  void ProcessAttributeReference(uint64 offset, DwarfAttribute attr,
+                                 DwarfForm form, uint64 data) {
+    AddAttribute(attr, form);
+    Add(form == dwarf2reader::DW_FORM_ref_addr ? data : data - unit_offset_);
+  }
+  void ProcessAttributeBuffer(uint64 offset, DwarfAttribute attr,
+                              DwarfForm form, const char* data, uint64 len) {
+    // DwarfCUToModule ignores blocks, and location expressions hold
+    // absolute addresses.
+    AddAttribute(attr, form);
+  }
+  void ProcessAttributeString(uint64 offset, DwarfAttribute attr,
+                              DwarfForm form, const string& data) {
+    // Inline strings and strings in .debug_str mean the same thing.
+    AddAttribute(attr, dwarf2reader::DW_FORM_string);
+    AddString(data);
+  }
+  void ProcessAttributeSignature(uint64 offset, DwarfAttribute attr,
+                                 DwarfForm form, uint64 signature) {
+    AddAttribute(attr, form);
+    Add(signature);
+  }
+
+  // LineInfoHandler methods. Modification times and lengths of files
+  // don't matter to DwarfLineToModule, nor do columns.
+  void DefineDir(const string& name, uint32 dir_num) {
+    AddTag('d');
+    AddString(name);
+    Add(dir_num);
+  }
+  void DefineFile(const string& name, int32 file_num, uint32 dir_num,
+                  uint64 mod_time, uint64 length) {
+    AddTag('f');
+    AddString(name);
+    Add(static_cast<uint64>(file_num));
+    Add(dir_num);
+  }
+  void AddLine(uint64 address, uint64 length, uint32 file_num,
+               uint32 line_num, uint32 column_num) {
+    AddTag('l');
+    AddAddress(address);
+    Add(length);
+    Add(file_num);
+    Add(line_num);
+  }
+
+  // Mark the end of the line number program, or its absence.
+  void EndLineProgram() {
+    AddTag('L');
+  }
+
+  // Return the digest as a string of hex digits.
+  string Finish() {
+    Flush();
+    unsigned char digest[16];
+    MD5Final(digest, &context_);
+    char hex[sizeof(digest) * 2 + 1];
+    for (size_t i = 0; i < sizeof(digest); i++)
+      snprintf(hex + i * 2, 3, "%02x", digest[i]);
+    return string(hex, sizeof(digest) * 2);
+  }
+
+ private:
+  // Add ADDRESS, relative to the first nonzero address added. Units whose
+  // code is in several sections have a zero DW_AT_low_pc, and discarded
+  // functions are left at zero; neither says where the unit is.
+  void AddAddress(uint64 address) {
+    if (address == 0) {
+      AddTag('0');
+      return;
+    }
+    if (!has_base_) {
+      base_ = address;
+      has_base_ = true;
+    }
+    AddTag('a');
+    Add(address - base_);
+  }
+
+  void AddTag(char tag) {
+    buffer_.push_back(tag);
+    if (buffer_.size() >= kBufferSize)
+      Flush();
+  }
+  void Add(uint64 value) {
+    for (int i = 0; i < 8; i++)
+      buffer_.push_back(static_cast<char>(value >> (i * 8)));
+    if (buffer_.size() >= kBufferSize)
+      Flush();
+  }
+  void AddString(const string& value) {
+    Add(value.size());
+    buffer_.append(value);
+    if (buffer_.size() >= kBufferSize)
+      Flush();
+  }
+  void AddAttribute(DwarfAttribute attr, DwarfForm form) {
+    AddTag('A');
+    Add(attr);
+    Add(form);
+  }
+  void Flush() {
+    MD5Update(&context_,
+              reinterpret_cast<const unsigned char*>(buffer_.data()),
+              buffer_.size());
+    buffer_.clear();
+  }
+
+  static const size_t kBufferSize = 4096;
+
+  uint64 unit_offset_;
+  bool has_base_;
+  uint64 base_;
+  bool has_line_program_;
+  uint64 line_program_offset_;
+  MD5Context context_;
+  // Bytes not yet passed to MD5Update.
+  string buffer_;
+};
+
+// Parse the hexadecimal number at CURSOR, followed by a space, into
+// VALUE, and advance CURSOR past the space.
+bool ParseHex(char** cursor, uint64* value) {
+  char* end;
+  *value = strtoull(*cursor, &end, 16);
+  if (end == *cursor || *end != ' ')
+    return false;
+  *cursor = end + 1;
+  return true;
+}
+
+}  // namespace
+
+DwarfCUCache::DwarfCUCache(const string& directory)
+    : directory_(directory) {
+}
+
+bool DwarfCUCache::CanCache(const dwarf2reader::SectionMap& sections) {
+  dwarf2reader::SectionMap::const_iterator abbrevs =
+      sections.find(".debug_abbrev");
+  if (abbrevs == sections.end())
+    return false;
+  const char* cursor = abbrevs->second.first;
+  const char* end = cursor + abbrevs->second.second;
+  // The section is a series of tables, each a series of abbreviations
+  // ended by a zero code.
+  while (cursor < end) {
+    uint64 code, tag;
+    if (!ReadULEB128(&cursor, end, &code))
+      return false;
+    if (code == 0)
+      continue;
+    // Skip the tag and the has-children flag.
+    if (!ReadULEB128(&cursor, end, &tag) || cursor == end)
+      return false;
+    ++cursor;
+    for (;;) {
+      uint64 attr, form;
+      if (!ReadULEB128(&cursor, end, &attr) ||
+          !ReadULEB128(&cursor, end, &form))
+        return false;
+      if (attr == 0 && form == 0)
+        break;
+      if (form == dwarf2reader::DW_FORM_ref_addr ||
+          form == dwarf2reader::DW_FORM_indirect)
+        return false;
+    }
+  }
+  return true;
+}
+
+bool DwarfCUCache::DigestCompilationUnit(
+    const dwarf2reader::SectionMap& sections, uint64 offset,
+    dwarf2reader::ByteReader* byte_reader,
+    dwarf2reader::CompilationUnit::AbbrevCache* abbrev_cache,
+    string* digest, uint64* base) {
+  dwarf2reader::SectionMap::const_iterator debug_info =
+      sections.find(".debug_info");
+  if (debug_info == sections.end() || offset >= debug_info->second.second)
+    return false;
+
+  UnitDigester digester(offset);
+  dwarf2reader::CompilationUnit reader(sections, offset, byte_reader,
+                                       &digester);
+  if (abbrev_cache)
+    reader.set_abbrev_cache(abbrev_cache);
+  reader.Start();
+
+  if (digester.has_line_program()) {
+    dwarf2reader::SectionMap::const_iterator debug_line =
+        sections.find(".debug_line");
+    // DwarfCUToModule ignores a line number program it can't find.
+    if (debug_line != sections.end() &&
+        digester.line_program_offset() < debug_line->second.second) {
+      uint64 line_offset = digester.line_program_offset();
+      dwarf2reader::LineInfo lines(debug_line->second.first + line_offset,
+                                   debug_line->second.second - line_offset,
+                                   byte_reader, &digester);
+      lines.Start();
+    }
+    digester.EndLineProgram();
+  }
+
+  *digest = digester.Finish();
+  *base = digester.base();
+  return true;
+}
+
+bool DwarfCUCache::Read(const string& digest, uint64 base,
+                        Module* module) const {
+  FILE* file = fopen(EntryPath(digest).c_str(), "r");
+  if (!file)
+    return false;
+
+  vector<Module::File*> files;
+  vector<Module::Function*> functions;
+  bool ok = true;
+  char* line = NULL;
+  size_t capacity = 0;
+  ssize_t length;
+  while (ok && (length = getline(&line, &capacity, file)) > 0) {
+    // An entry is only renamed into place once it is complete, but a
+    // line without its newline is truncated all the same.
+    if (line[length - 1] != '\n') {
+      ok = false;
+      break;
+    }
+    line[length - 1] = '\0';
+    char* cursor = line;
+    if (strncmp(cursor, "FILE ", 5) == 0) {
+      cursor += 5;
+      char* end;
+      unsigned long number = strtoul(cursor, &end, 10);
+      if (end == cursor || *end != ' ' || number != files.size()) {
+        ok = false;
+        break;
+      }
+      files.push_back(module->FindFile(string(end + 1)));
+    } else if (strncmp(cursor, "FUNC ", 5) == 0) {
+      cursor += 5;
+      uint64 address, size, parameter_size;
+      if (!ParseHex(&cursor, &address) || !ParseHex(&cursor, &size) ||
+          !ParseHex(&cursor, &parameter_size) || *cursor == '\0') {
+        ok = false;
+        break;
+      }
+      Module::Function* function = new Module::Function;
+      function->name = cursor;
+      function->address = base + address;
+      function->size = size;
+      function->parameter_size = parameter_size;
+      functions.push_back(function);
+    } else {
+      uint64 address, size;
+      char* end;
+      if (functions.empty() || !ParseHex(&cursor, &address) ||
+          !ParseHex(&cursor, &size)) {
+        ok = false;
+        break;
+      }
+      long number = strtol(cursor, &end, 10);
+      if (end == cursor || *end != ' ') {
+        ok = false;
+        break;
+      }
+      cursor = end + 1;
+      unsigned long file_number = strtoul(cursor, &end, 10);
+      if (end == cursor || *end != '\0' || file_number >= files.size()) {
+        ok = false;
+        break;
+      }
+      Module::Line source_line;
+      source_line.address = base + address;
+      source_line.size = size;
+      source_line.file = files[file_number];
+      source_line.number = number;
+      functions.back()->lines.push_back(source_line);
+    }
+  }
+  free(line);
+  if (ferror(file))
+    ok = false;
+  fclose(file);
+
+  if (!ok) {
+    for (size_t i = 0; i < functions.size(); i++)
+      delete functions[i];
+    return false;
+  }
+  module->AddFunctions(functions.begin(), functions.end());
+  return true;
+}
+
+bool DwarfCUCache::Write(const string& digest, uint64 base,
+                         Module* module) const {
+  vector<Module::Function*> functions;
+  module->GetFunctions(&functions, functions.end());
+
+  // Write the entry under a temporary name and rename it into place, so
+  // that processes reading the directory never see half an entry.
+  string temp_path = directory_ + "/.tmp.XXXXXX";
+  vector<char> temp_name(temp_path.begin(), temp_path.end());
+  temp_name.push_back('\0');
+  int fd = mkstemp(&temp_name[0]);
+  if (fd < 0)
+    return false;
+  FILE* file = fdopen(fd, "w");
+  if (!file) {
+    close(fd);
+    unlink(&temp_name[0]);
+    return false;
+  }
+
+  // Number the files in the order the lines first use them.
+  map<const Module::File*, int> file_numbers;
+  for (size_t i = 0; i < functions.size(); i++) {
+    const vector<Module::Line>& lines = functions[i]->lines;
+    for (size_t j = 0; j < lines.size(); j++) {
+      int number = file_numbers.size();
+      if (file_numbers.insert(std::make_pair(lines[j].file, number)).second)
+        fprintf(file, "FILE %d %s\n", number, lines[j].file->name.c_str());
+    }
+  }
+  for (size_t i = 0; i < functions.size(); i++) {
+    const Module::Function* function = functions[i];
+    fprintf(file, "FUNC %" PRIx64 " %" PRIx64 " %" PRIx64 " %s\n",
+            function->address - base, function->size,
+            function->parameter_size, function->name.c_str());
+    for (size_t j = 0; j < function->lines.size(); j++) {
+      const Module::Line& line = function->lines[j];
+      fprintf(file, "%" PRIx64 " %" PRIx64 " %d %d\n",
+              line.address - base, line.size, line.number,
+              file_numbers[line.file]);
+    }
+  }
+
+  bool ok = !ferror(file);
+  if (fclose(file) != 0)
+    ok = false;
+  if (ok && rename(&temp_name[0], EntryPath(digest).c_str()) != 0)
+    ok = false;
+  if (!ok)
+    unlink(&temp_name[0]);
+  return ok;
+}
+
+string DwarfCUCache::EntryPath(const string& digest) const {
+  return directory_ + "/" + digest;
+}
+
+}  // namespace google_breakpad
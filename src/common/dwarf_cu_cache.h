@@ -0,0 +1,109 @@
+// -*- mode: c++ -*-
+
+// Copyright (c) 2016 Google Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+// notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above
+// copyright notice, this list of conditions and the following disclaimer
+// in the documentation and/or other materials provided with the
+// distribution.
+//     * Neither the name of Google Inc. nor the names of its
+// contributors may be used to endorse or promote products derived from
+// this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+// dwarf_cu_cache.h: Define DwarfCUCache, an on-disk cache of the
+// functions and lines DwarfCUToModule produces for DWARF compilation
+// units, so that dump_syms need only read the units of a binary that
+// have changed since it last saw them.
+
+#ifndef COMMON_DWARF_CU_CACHE_H__
+#define COMMON_DWARF_CU_CACHE_H__
+
+#include <string>
+
+#include "common/module.h"
+#include "common/dwarf/bytereader.h"
+#include "common/dwarf/dwarf2reader.h"
+#include "common/using_std_string.h"
+
+namespace google_breakpad {
+
+// Each entry holds the functions of one compilation unit, keyed by a
+// digest of what DwarfCUToModule reads from it: its DIEs' tags and
+// attributes, with strings by content rather than by offset, references
+// relative to the unit, and nonzero addresses relative to the unit's
+// first, and the files and lines of its line number program, with
+// addresses relative to the same base. A unit that is unchanged but was
+// linked at another address, or whose strings and line program moved,
+// has the same digest, and its cached functions are shifted to its new
+// base. Location expressions and other attributes DwarfCUToModule
+// ignores contribute their names and forms but not their values.
+//
+// A unit's functions can depend on another unit's DIEs only through
+// DW_FORM_ref_addr references, so files whose abbreviations use that
+// form (or DW_FORM_indirect) are not cached at all; see CanCache.
+//
+// Warnings DwarfCUToModule would report for a unit are not repeated when
+// its functions come from the cache.
+class DwarfCUCache {
+ public:
+  // Create a cache keeping its entries in DIRECTORY, which must exist.
+  // Several processes and threads may share a directory.
+  explicit DwarfCUCache(const string& directory);
+
+  const string& directory() const { return directory_; }
+
+  // Return true if the compilation units in SECTIONS' .debug_info can be
+  // cached: that is, if SECTIONS' .debug_abbrev can be read and none of
+  // its abbreviations allow references into other units.
+  static bool CanCache(const dwarf2reader::SectionMap& sections);
+
+  // Set DIGEST to the digest of the compilation unit at OFFSET in
+  // SECTIONS' .debug_info, as a string of hex digits, and BASE to the
+  // address that the unit's addresses are taken relative to. Use
+  // BYTE_READER and, if it isn't NULL, ABBREV_CACHE to read the unit.
+  // Return false if the unit can't be read.
+  static bool DigestCompilationUnit(
+      const dwarf2reader::SectionMap& sections, uint64 offset,
+      dwarf2reader::ByteReader* byte_reader,
+      dwarf2reader::CompilationUnit::AbbrevCache* abbrev_cache,
+      string* digest, uint64* base);
+
+  // If the cache has an entry for DIGEST, add its functions to MODULE
+  // with BASE added to their addresses, and return true. Otherwise, or if
+  // the entry can't be read, leave MODULE's functions alone and return
+  // false.
+  bool Read(const string& digest, uint64 base, Module* module) const;
+
+  // Write MODULE's functions, with BASE subtracted from their addresses,
+  // as the entry for DIGEST. Return false if the entry can't be written.
+  bool Write(const string& digest, uint64 base, Module* module) const;
+
+ private:
+  // Return the path of DIGEST's entry.
+  string EntryPath(const string& digest) const;
+
+  string directory_;
+};
+
+}  // namespace google_breakpad
+
+#endif  // COMMON_DWARF_CU_CACHE_H__
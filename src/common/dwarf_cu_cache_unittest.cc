@@ -0,0 +1,341 @@
+// Copyright (c) 2016 Google Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+// notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above
+// copyright notice, this list of conditions and the following disclaimer
+// in the documentation and/or other materials provided with the
+// distribution.
+//     * Neither the name of Google Inc. nor the names of its
+// contributors may be used to endorse or promote products derived from
+// this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+// dwarf_cu_cache_unittest.cc: Unit tests for google_breakpad::DwarfCUCache.
+
+#include <stdio.h>
+
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "breakpad_googletest_includes.h"
+#include "common/dwarf_cu_cache.h"
+#include "common/dwarf_cu_to_module.h"
+#include "common/dwarf_line_to_module.h"
+#include "common/module.h"
+#include "common/test_assembler.h"
+#include "common/tests/auto_tempdir.h"
+#include "common/dwarf/dwarf2diehandler.h"
+#include "common/dwarf/dwarf2reader_test_common.h"
+#include "common/using_std_string.h"
+
+namespace {
+
+using google_breakpad::AutoTempDir;
+using google_breakpad::DwarfCUCache;
+using google_breakpad::DwarfCUToModule;
+using google_breakpad::DwarfLineToModule;
+using google_breakpad::Module;
+using google_breakpad::test_assembler::Label;
+using google_breakpad::test_assembler::Section;
+using google_breakpad::test_assembler::kLittleEndian;
+using std::vector;
+
+// Reads line programs the way dump_syms does.
+class LineReader : public DwarfCUToModule::LineToModuleHandler {
+ public:
+  explicit LineReader(dwarf2reader::ByteReader* byte_reader)
+      : byte_reader_(byte_reader) { }
+  void StartCompilationUnit(const string& compilation_dir) {
+    compilation_dir_ = compilation_dir;
+  }
+  void ReadProgram(const char* program, uint64 length,
+                   Module* module, vector<Module::Line>* lines) {
+    DwarfLineToModule handler(module, compilation_dir_, lines);
+    dwarf2reader::LineInfo parser(program, length, byte_reader_, &handler);
+    parser.Start();
+  }
+
+ private:
+  dwarf2reader::ByteReader* byte_reader_;
+  string compilation_dir_;
+};
+
+class DwarfCUCacheTest : public ::testing::Test {
+ public:
+  DwarfCUCacheTest()
+      : byte_reader_(dwarf2reader::ENDIANNESS_LITTLE),
+        unit_offset_(0) { }
+
+  // Set the sections to hold a compilation unit linked at TEXT_ADDRESS,
+  // with a function FUNCTION_NAME declared and then defined by a DIE
+  // referring to the declaration, and two lines. If MOVED, put other
+  // units, strings and line programs before the unit's own in their
+  // sections.
+  void Build(uint64_t text_address, const string& function_name,
+             bool moved) {
+    TestAbbrevTable abbrevs;
+    abbrevs.Abbrev(1, dwarf2reader::DW_TAG_compile_unit,
+                   dwarf2reader::DW_children_yes)
+        .Attribute(dwarf2reader::DW_AT_name, dwarf2reader::DW_FORM_strp)
+        .Attribute(dwarf2reader::DW_AT_comp_dir, dwarf2reader::DW_FORM_string)
+        .Attribute(dwarf2reader::DW_AT_stmt_list, dwarf2reader::DW_FORM_data4)
+        .Attribute(dwarf2reader::DW_AT_low_pc, dwarf2reader::DW_FORM_addr)
+        .EndAbbrev()
+        .Abbrev(2, dwarf2reader::DW_TAG_subprogram,
+                dwarf2reader::DW_children_no)
+        .Attribute(dwarf2reader::DW_AT_name, dwarf2reader::DW_FORM_strp)
+        .Attribute(dwarf2reader::DW_AT_declaration, dwarf2reader::DW_FORM_flag)
+        .EndAbbrev()
+        .Abbrev(3, dwarf2reader::DW_TAG_subprogram,
+                dwarf2reader::DW_children_no)
+        .Attribute(dwarf2reader::DW_AT_specification,
+                   dwarf2reader::DW_FORM_ref4)
+        .Attribute(dwarf2reader::DW_AT_low_pc, dwarf2reader::DW_FORM_addr)
+        .Attribute(dwarf2reader::DW_AT_high_pc, dwarf2reader::DW_FORM_addr)
+        .EndAbbrev()
+        .EndTable();
+    abbrevs.GetContents(&abbrev_);
+
+    Section str(kLittleEndian);
+    if (moved)
+      str.AppendCString("some other unit's strings");
+    uint64_t unit_name = str.Size();
+    str.AppendCString("unit.cc");
+    uint64_t name = str.Size();
+    str.AppendCString(function_name);
+    str.GetContents(&str_);
+
+    line_.clear();
+    if (moved)
+      line_.append(0x40, '\0');
+    uint64_t stmt_list = line_.size();
+    AppendLineProgram(text_address);
+
+    info_.clear();
+    if (moved) {
+      // A unit without DIEs.
+      TestCompilationUnit empty;
+      empty.set_endianness(kLittleEndian);
+      empty.set_format_size(4);
+      empty.Header(2, Label(0), 8).Finish();
+      empty.GetContents(&info_);
+    }
+    unit_offset_ = info_.size();
+    TestCompilationUnit unit;
+    unit.set_endianness(kLittleEndian);
+    unit.set_format_size(4);
+    unit.Header(2, Label(0), 8);
+    Label declaration;
+    unit.ULEB128(1).D32(unit_name).AppendCString("/src").D32(stmt_list)
+        .D64(text_address);
+    unit.Mark(&declaration).ULEB128(2).D32(name).D8(1);
+    unit.ULEB128(3).D32(declaration - unit.start())
+        .D64(text_address).D64(text_address + 0x20);
+    unit.D8(0);
+    unit.Finish();
+    string contents;
+    unit.GetContents(&contents);
+    info_.append(contents);
+
+    sections_.clear();
+    sections_[".debug_abbrev"] = std::make_pair(abbrev_.data(),
+                                                abbrev_.size());
+    sections_[".debug_info"] = std::make_pair(info_.data(), info_.size());
+    sections_[".debug_str"] = std::make_pair(str_.data(), str_.size());
+    sections_[".debug_line"] = std::make_pair(line_.data(), line_.size());
+  }
+
+  // Return the unit's digest, setting BASE.
+  string Digest(uint64_t* base) {
+    string digest;
+    uint64 unit_base = 0;
+    EXPECT_TRUE(DwarfCUCache::DigestCompilationUnit(sections_, unit_offset_,
+                                                    &byte_reader_, NULL,
+                                                    &digest, &unit_base));
+    *base = unit_base;
+    return digest;
+  }
+
+  // Read the unit into MODULE as dump_syms would.
+  void ReadUnit(Module* module) {
+    DwarfCUToModule::FileContext file_context("test", module, true);
+    for (dwarf2reader::SectionMap::const_iterator it = sections_.begin();
+         it != sections_.end(); ++it) {
+      file_context.AddSectionToSectionMap(it->first, it->second.first,
+                                          it->second.second);
+    }
+    LineReader line_reader(&byte_reader_);
+    DwarfCUToModule::WarningReporter reporter("test", unit_offset_);
+    DwarfCUToModule root_handler(&file_context, &line_reader, &reporter);
+    dwarf2reader::DIEDispatcher die_dispatcher(&root_handler);
+    dwarf2reader::CompilationUnit reader(file_context.section_map(),
+                                         unit_offset_, &byte_reader_,
+                                         &die_dispatcher);
+    reader.Start();
+  }
+
+  static string SymbolFile(Module* module) {
+    std::stringstream stream;
+    EXPECT_TRUE(module->Write(stream, ALL_SYMBOL_DATA));
+    return stream.str();
+  }
+
+ private:
+  // Append a line program for the unit to line_: two lines of unit.cc,
+  // starting at TEXT_ADDRESS.
+  void AppendLineProgram(uint64_t text_address) {
+    Section program(kLittleEndian);
+    program.start() = 0;
+    Label unit_length, header_length, after_length, header_start,
+        header_end, end;
+    program.D32(unit_length).Mark(&after_length)
+        .D16(2)                   // version
+        .D32(header_length).Mark(&header_start)
+        .D8(1)                    // minimum_instruction_length
+        .D8(1)                    // default_is_stmt
+        .D8(static_cast<uint8_t>(-5))  // line_base
+        .D8(14)                   // line_range
+        .D8(13);                  // opcode_base
+    const uint8_t kStandardOpcodeLengths[] = {0, 1, 1, 1, 1, 0, 0, 0, 1, 0,
+                                              0, 1};
+    program.Append(kStandardOpcodeLengths, sizeof(kStandardOpcodeLengths));
+    program.D8(0)                 // no include_directories
+        .AppendCString("unit.cc").ULEB128(0).ULEB128(0).ULEB128(0)
+        .D8(0)                    // end of file_names
+        .Mark(&header_end);
+    header_length = header_end - header_start;
+    program.D8(0).ULEB128(9).D8(dwarf2reader::DW_LNE_set_address)
+        .D64(text_address)
+        .D8(dwarf2reader::DW_LNS_advance_line).LEB128(9)
+        .D8(dwarf2reader::DW_LNS_copy)
+        .D8(dwarf2reader::DW_LNS_advance_pc).ULEB128(0x10)
+        .D8(dwarf2reader::DW_LNS_advance_line).LEB128(1)
+        .D8(dwarf2reader::DW_LNS_copy)
+        .D8(dwarf2reader::DW_LNS_advance_pc).ULEB128(0x10)
+        .D8(0).ULEB128(1).D8(dwarf2reader::DW_LNE_end_sequence)
+        .Mark(&end);
+    unit_length = end - after_length;
+    string contents;
+    program.GetContents(&contents);
+    line_.append(contents);
+  }
+
+ protected:
+  dwarf2reader::ByteReader byte_reader_;
+  dwarf2reader::SectionMap sections_;
+  uint64_t unit_offset_;
+
+ private:
+  string abbrev_, info_, str_, line_;
+};
+
+TEST_F(DwarfCUCacheTest, DigestIgnoresPlacement) {
+  uint64_t base, moved_base;
+  Build(0x1000, "function", false);
+  string digest = Digest(&base);
+  Build(0x7000, "function", true);
+  string moved_digest = Digest(&moved_base);
+  EXPECT_EQ(32U, digest.size());
+  EXPECT_EQ(digest, moved_digest);
+  EXPECT_EQ(0x1000U, base);
+  EXPECT_EQ(0x7000U, moved_base);
+}
+
+TEST_F(DwarfCUCacheTest, DigestReflectsContents) {
+  uint64_t base;
+  Build(0x1000, "function", false);
+  string digest = Digest(&base);
+  Build(0x1000, "renamed", false);
+  EXPECT_NE(digest, Digest(&base));
+}
+
+TEST_F(DwarfCUCacheTest, CanCache) {
+  Build(0x1000, "function", false);
+  EXPECT_TRUE(DwarfCUCache::CanCache(sections_));
+
+  TestAbbrevTable abbrevs;
+  abbrevs.Abbrev(1, dwarf2reader::DW_TAG_subprogram,
+                 dwarf2reader::DW_children_no)
+      .Attribute(dwarf2reader::DW_AT_specification,
+                 dwarf2reader::DW_FORM_ref_addr)
+      .EndAbbrev()
+      .EndTable();
+  string contents;
+  abbrevs.GetContents(&contents);
+  sections_[".debug_abbrev"] = std::make_pair(contents.data(),
+                                              contents.size());
+  EXPECT_FALSE(DwarfCUCache::CanCache(sections_));
+
+  sections_.erase(".debug_abbrev");
+  EXPECT_FALSE(DwarfCUCache::CanCache(sections_));
+}
+
+// A unit's functions taken from the cache for a build where it moved are
+// the same as those read from that build.
+TEST_F(DwarfCUCacheTest, CachedUnitMatchesReading) {
+  AutoTempDir temp_dir;
+  DwarfCUCache cache(temp_dir.path());
+
+  uint64_t base;
+  Build(0x1000, "function", false);
+  string digest = Digest(&base);
+  Module module("name", "os", "arch", "id");
+  EXPECT_FALSE(cache.Read(digest, base, &module));
+  ReadUnit(&module);
+  ASSERT_TRUE(cache.Write(digest, base, &module));
+
+  Build(0x7000, "function", true);
+  ASSERT_EQ(digest, Digest(&base));
+  Module expected("name", "os", "arch", "id");
+  ReadUnit(&expected);
+  Module cached("name", "os", "arch", "id");
+  ASSERT_TRUE(cache.Read(digest, base, &cached));
+  EXPECT_EQ(SymbolFile(&expected), SymbolFile(&cached));
+  EXPECT_EQ("MODULE os arch id name\n"
+            "FILE 0 /src/unit.cc\n"
+            "FUNC 7000 20 0 function\n"
+            "7000 10 10 0\n"
+            "7010 10 11 0\n",
+            SymbolFile(&cached));
+}
+
+TEST_F(DwarfCUCacheTest, IgnoresDamagedEntries) {
+  AutoTempDir temp_dir;
+  DwarfCUCache cache(temp_dir.path());
+  const char* const kEntries[] = {
+    "FUNC 0 20 0 function\n0 10 10 0\n",        // no such file
+    "FILE 0 unit.cc\nFUNC 0 20 0 function\n0 10",  // truncated
+    "0 10 10 0\n",                              // line outside function
+  };
+  for (size_t i = 0; i < sizeof(kEntries) / sizeof(kEntries[0]); i++) {
+    FILE* file = fopen((temp_dir.path() + "/damaged").c_str(), "w");
+    ASSERT_TRUE(file != NULL);
+    fputs(kEntries[i], file);
+    fclose(file);
+    Module module("name", "os", "arch", "id");
+    EXPECT_FALSE(cache.Read("damaged", 0x1000, &module)) << kEntries[i];
+    vector<Module::Function*> functions;
+    module.GetFunctions(&functions, functions.end());
+    EXPECT_TRUE(functions.empty());
+  }
+}
+
+}  // namespace
@@ -43,13 +43,15 @@
 #include <cxxabi.h>
 #endif
 #include <inttypes.h>
+#include <pthread.h>
 #include <stdio.h>
 
 #include <algorithm>
+#include <deque>
 #include <utility>
 
 #include "common/dwarf_line_to_module.h"
-#include "common/unordered.h"
+#include "common/string_interner.h"
 
 namespace google_breakpad {
 
@@ -74,25 +76,30 @@ using std::vector;
 // contents for later reference.
 //
 // A Specification holds information gathered from a declaration DIE that
-// we may need if we find a DW_AT_specification link pointing to it.
+// we may need if we find a DW_AT_specification link pointing to it. Its
+// names are held by the file's string interner.
 struct DwarfCUToModule::Specification {
+  Specification()
+      : qualified_name(""), enclosing_name(""), unqualified_name("") { }
+
   // The qualified name that can be found by demangling DW_AT_MIPS_linkage_name.
-  string qualified_name;
+  const char *qualified_name;
 
   // The name of the enclosing scope, or the empty string if there is none.
-  string enclosing_name;
+  const char *enclosing_name;
 
   // The name for the specification DIE itself, without any enclosing
   // name components.
-  string unqualified_name;
+  const char *unqualified_name;
 };
 
-// An abstract origin -- base definition of an inline function.
+// An abstract origin -- base definition of an inline function. Its name
+// is held by the file's string interner.
 struct AbstractOrigin {
-  AbstractOrigin() : name() {}
-  explicit AbstractOrigin(const string& name) : name(name) {}
+  AbstractOrigin() : name("") {}
+  explicit AbstractOrigin(const char *name) : name(name) {}
 
-  string name;
+  const char *name;
 };
 
 typedef map<uint64, AbstractOrigin> AbstractOriginByOffset;
@@ -100,24 +107,10 @@ typedef map<uint64, AbstractOrigin> AbstractOriginByOffset;
 // Data global to the DWARF-bearing file that is private to the
 // DWARF-to-Module process.
 struct DwarfCUToModule::FilePrivate {
-  // A set of strings used in this CU. Before storing a string in one of
-  // our data structures, insert it into this set, and then use the string
-  // from the set.
-  //
-  // In some STL implementations, strings are reference-counted internally,
-  // meaning that simply using strings from this set, even if passed by
-  // value, assigned, or held directly in structures and containers
-  // (map<string, ...>, for example), causes those strings to share a
-  // single instance of each distinct piece of text. GNU's libstdc++ uses
-  // reference counts, and I believe MSVC did as well, at some point.
-  // However, C++ '11 implementations are moving away from reference
-  // counting.
-  //
-  // In other implementations, string assignments copy the string's text,
-  // so this set will actually hold yet another copy of the string (although
-  // everything will still work). To improve memory consumption portably,
-  // we will probably need to use pointers to strings held in this set.
-  unordered_set<string> common_strings;
+  // The names found in this file's DIEs. The handlers, specifications
+  // and abstract origins refer to names held here rather than keeping
+  // copies of their own, so each distinct name is stored just once.
+  StringInterner strings;
 
   // A map from offsets of DIEs within the .debug_info section to
   // Specifications describing those DIEs. Specification references can
@@ -125,6 +118,46 @@ struct DwarfCUToModule::FilePrivate {
   SpecificationByOffset specifications;
 
   AbstractOriginByOffset origins;
+
+  // True if compilation units are being processed concurrently. The
+  // members above must then only be used with MUTEX held.
+  bool parallel;
+
+  // The offsets of the compilation units being processed, in increasing
+  // order, and whether each has been processed yet.
+  vector<uint64> cu_offsets;
+  vector<bool> cu_done;
+
+  pthread_mutex_t mutex;
+
+  // Signaled whenever an element of CU_DONE is set.
+  pthread_cond_t cu_done_changed;
+
+  FilePrivate() : parallel(false) {
+    pthread_mutex_init(&mutex, NULL);
+    pthread_cond_init(&cu_done_changed, NULL);
+  }
+  ~FilePrivate() {
+    pthread_cond_destroy(&cu_done_changed);
+    pthread_mutex_destroy(&mutex);
+  }
+
+  // Holds FILE_PRIVATE's mutex for the lifetime of this object, if its
+  // compilation units are being processed concurrently.
+  class AutoLock {
+   public:
+    explicit AutoLock(FilePrivate *file_private)
+        : mutex_(file_private->parallel ? &file_private->mutex : NULL) {
+      if (mutex_)
+        pthread_mutex_lock(mutex_);
+    }
+    ~AutoLock() {
+      if (mutex_)
+        pthread_mutex_unlock(mutex_);
+    }
+   private:
+    pthread_mutex_t *mutex_;
+  };
 };
 
 DwarfCUToModule::FileContext::FileContext(const string &filename,
@@ -133,7 +166,17 @@ DwarfCUToModule::FileContext::FileContext(const string &filename,
     : filename_(filename),
       module_(module),
       handle_inter_cu_refs_(handle_inter_cu_refs),
-      file_private_(new FilePrivate()) {
+      owned_file_private_(new FilePrivate()),
+      file_private_(owned_file_private_.get()) {
+}
+
+DwarfCUToModule::FileContext::FileContext(FileContext *shared,
+                                          Module *module)
+    : filename_(shared->filename_),
+      section_map_(shared->section_map_),
+      module_(module),
+      handle_inter_cu_refs_(shared->handle_inter_cu_refs_),
+      file_private_(shared->file_private_) {
 }
 
 DwarfCUToModule::FileContext::~FileContext() {
@@ -153,11 +196,60 @@ DwarfCUToModule::FileContext::section_map() const {
   return section_map_;
 }
 
+void DwarfCUToModule::FileContext::SetCompilationUnitOffsets(
+    const vector<uint64> &offsets) {
+  file_private_->parallel = true;
+  file_private_->cu_offsets = offsets;
+  file_private_->cu_done.assign(offsets.size(), false);
+}
+
+void DwarfCUToModule::FileContext::CompilationUnitDone(uint64 offset) {
+  FilePrivate *file_private = file_private_;
+  if (!file_private->parallel)
+    return;
+  vector<uint64>::const_iterator it =
+      std::lower_bound(file_private->cu_offsets.begin(),
+                       file_private->cu_offsets.end(), offset);
+  if (it == file_private->cu_offsets.end() || *it != offset)
+    return;
+  FilePrivate::AutoLock lock(file_private);
+  file_private->cu_done[it - file_private->cu_offsets.begin()] = true;
+  pthread_cond_broadcast(&file_private->cu_done_changed);
+}
+
 void DwarfCUToModule::FileContext::ClearSpecifications() {
-  if (!handle_inter_cu_refs_)
+  // Other compilation units may still be using the specifications when
+  // they are processed concurrently; unhandled inter-CU references are
+  // caught by IsUnhandledInterCUReference either way.
+  if (!handle_inter_cu_refs_ && !file_private_->parallel)
     file_private_->specifications.clear();
 }
 
+bool DwarfCUToModule::FileContext::WaitForReference(
+    uint64 offset, uint64 compilation_unit_start) {
+  FilePrivate *file_private = file_private_;
+  if (!file_private->parallel)
+    return true;
+  const vector<uint64> &cu_offsets = file_private->cu_offsets;
+
+  // Find the unit holding OFFSET, and the unit after the referring one.
+  size_t target = std::upper_bound(cu_offsets.begin(), cu_offsets.end(),
+                                   offset) - cu_offsets.begin();
+  size_t next = std::upper_bound(cu_offsets.begin(), cu_offsets.end(),
+                                 compilation_unit_start) - cu_offsets.begin();
+  if (target > next)
+    return false;
+  if (target == 0 || target == next)
+    return true;
+
+  // Units are handed out in order, so the one we're waiting for is
+  // either done or being processed, and never waits for us.
+  FilePrivate::AutoLock lock(file_private);
+  while (!file_private->cu_done[target - 1])
+    pthread_cond_wait(&file_private->cu_done_changed, &file_private->mutex);
+  return true;
+}
+
 bool DwarfCUToModule::FileContext::IsUnhandledInterCUReference(
     uint64 offset, uint64 compilation_unit_start) const {
   if (handle_inter_cu_refs_)
@@ -227,7 +319,9 @@ class DwarfCUToModule::GenericDIEHandler: public dwarf2reader::DIEHandler {
         parent_context_(parent_context),
         offset_(offset),
         declaration_(false),
-        specification_(NULL) { }
+        specification_(NULL),
+        name_attribute_(""),
+        demangled_name_("") { }
 
   // Derived classes' ProcessAttributeUnsigned can defer to this to
   // handle DW_AT_declaration, or simply not override it.
@@ -262,13 +356,9 @@ class DwarfCUToModule::GenericDIEHandler: public dwarf2reader::DIEHandler {
   DIEContext *parent_context_;
   uint64 offset_;
 
-  // Place the name in the global set of strings. Even though this looks
-  // like a copy, all the major std::string implementations use reference
-  // counting internally, so the effect is to have all the data structures
-  // share copies of strings whenever possible.
-  // FIXME: Should this return something like a string_ref to avoid the
-  // assumption about how strings are implemented?
-  string AddStringToPool(const string &str);
+  // Intern STR in the file's string pool, returning a pointer to the
+  // pooled copy that lives as long as the FileContext.
+  const char *AddStringToPool(const char *str);
 
   // If this DIE has a DW_AT_declaration attribute, this is its value.
   // It is false on DIEs with no DW_AT_declaration attribute.
@@ -280,13 +370,13 @@ class DwarfCUToModule::GenericDIEHandler: public dwarf2reader::DIEHandler {
   Specification *specification_;
 
   // The value of the DW_AT_name attribute, or the empty string if the
-  // DIE has no such attribute.
-  string name_attribute_;
+  // DIE has no such attribute. Held by the file's string pool.
+  const char *name_attribute_;
 
   // The demangled value of the DW_AT_MIPS_linkage_name attribute, or the empty
   // string if the DIE has no such attribute or its content could not be
-  // demangled.
-  string demangled_name_;
+  // demangled. Held by the file's string pool.
+  const char *demangled_name_;
 };
 
 void DwarfCUToModule::GenericDIEHandler::ProcessAttributeUnsigned(
@@ -316,12 +406,19 @@ void DwarfCUToModule::GenericDIEHandler::ProcessAttributeReference(
       // here, but it's better to leave the real work to our
       // EndAttribute member function, at which point we know we have
       // seen all the DIE's attributes.
-      SpecificationByOffset *specifications =
-          &file_context->file_private_->specifications;
-      SpecificationByOffset::iterator spec = specifications->find(data);
-      if (spec != specifications->end()) {
-        specification_ = &spec->second;
-      } else {
+      bool found = false;
+      if (file_context->WaitForReference(
+              data, cu_context_->reporter->cu_offset())) {
+        FilePrivate::AutoLock lock(file_context->file_private_);
+        SpecificationByOffset *specifications =
+            &file_context->file_private_->specifications;
+        SpecificationByOffset::iterator spec = specifications->find(data);
+        if (spec != specifications->end()) {
+          specification_ = &spec->second;
+          found = true;
+        }
+      }
+      if (!found) {
         // Technically, there's no reason a DW_AT_specification
         // couldn't be a forward reference, but supporting that would
         // be a lot of work (changing to a two-pass structure), and I
@@ -335,10 +432,11 @@ void DwarfCUToModule::GenericDIEHandler::ProcessAttributeReference(
   }
 }
 
-string DwarfCUToModule::GenericDIEHandler::AddStringToPool(const string &str) {
-  pair<unordered_set<string>::iterator, bool> result =
-    cu_context_->file_context->file_private_->common_strings.insert(str);
-  return *result.first;
+const char *DwarfCUToModule::GenericDIEHandler::AddStringToPool(
+    const char *str) {
+  FilePrivate *file_private = cu_context_->file_context->file_private_;
+  FilePrivate::AutoLock lock(file_private);
+  return file_private->strings.Intern(str);
 }
 
 void DwarfCUToModule::GenericDIEHandler::ProcessAttributeString(
@@ -347,7 +445,7 @@ void DwarfCUToModule::GenericDIEHandler::ProcessAttributeString(
     const string &data) {
   switch (attr) {
     case dwarf2reader::DW_AT_name:
-      name_attribute_ = AddStringToPool(data);
+      name_attribute_ = AddStringToPool(data.c_str());
       break;
     case dwarf2reader::DW_AT_MIPS_linkage_name: {
       char* demangled = NULL;
@@ -368,54 +466,58 @@ string DwarfCUToModule::GenericDIEHandler::ComputeQualifiedName() {
   // Use the demangled name, if one is available. Demangled names are
   // preferable to those inferred from the DWARF structure because they
   // include argument types.
-  const string *qualified_name = NULL;
-  if (!demangled_name_.empty()) {
+  const char *qualified_name = NULL;
+  if (*demangled_name_) {
     // Found it is this DIE.
-    qualified_name = &demangled_name_;
-  } else if (specification_ && !specification_->qualified_name.empty()) {
+    qualified_name = demangled_name_;
+  } else if (specification_ && *specification_->qualified_name) {
     // Found it on the specification.
-    qualified_name = &specification_->qualified_name;
+    qualified_name = specification_->qualified_name;
   }
 
-  const string *unqualified_name;
-  const string *enclosing_name;
+  const char *unqualified_name = NULL;
+  const char *enclosing_name = NULL;
   if (!qualified_name) {
     // Find our unqualified name. If the DIE has its own DW_AT_name
     // attribute, then use that; otherwise, check our specification.
-    if (name_attribute_.empty() && specification_)
-      unqualified_name = &specification_->unqualified_name;
+    if (!*name_attribute_ && specification_)
+      unqualified_name = specification_->unqualified_name;
     else
-      unqualified_name = &name_attribute_;
+      unqualified_name = name_attribute_;
 
     // Find the name of our enclosing context. If we have a
     // specification, it's the specification's enclosing context that
     // counts; otherwise, use this DIE's context.
     if (specification_)
-      enclosing_name = &specification_->enclosing_name;
+      enclosing_name = specification_->enclosing_name;
     else
-      enclosing_name = &parent_context_->name;
+      enclosing_name = parent_context_->name.c_str();
   }
 
   // If this DIE was marked as a declaration, record its names in the
   // specification table.
   if (declaration_) {
+    FilePrivate *file_private = cu_context_->file_context->file_private_;
+    FilePrivate::AutoLock lock(file_private);
     Specification spec;
     if (qualified_name) {
-      spec.qualified_name = *qualified_name;
+      spec.qualified_name = qualified_name;
     } else {
-      spec.enclosing_name = *enclosing_name;
-      spec.unqualified_name = *unqualified_name;
+      // The parent context's name isn't pooled yet.
+      spec.enclosing_name = specification_ ?
+          enclosing_name : file_private->strings.Intern(enclosing_name);
+      spec.unqualified_name = unqualified_name;
     }
-    cu_context_->file_context->file_private_->specifications[offset_] = spec;
+    file_private->specifications[offset_] = spec;
   }
 
   if (qualified_name)
-    return *qualified_name;
+    return qualified_name;
 
   // Combine the enclosing name and unqualified name to produce our
   // own fully-qualified name.
-  return cu_context_->language->MakeQualifiedName(*enclosing_name,
-                                                  *unqualified_name);
+  return cu_context_->language->MakeQualifiedName(enclosing_name,
+                                                  unqualified_name);
 }
 
 // A handler class for DW_TAG_subprogram DIEs.
@@ -492,12 +594,20 @@ void DwarfCUToModule::FuncHandler::ProcessAttributeReference(
     uint64 data) {
   switch (attr) {
     case dwarf2reader::DW_AT_abstract_origin: {
-      const AbstractOriginByOffset& origins =
-          cu_context_->file_context->file_private_->origins;
-      AbstractOriginByOffset::const_iterator origin = origins.find(data);
-      if (origin != origins.end()) {
-        abstract_origin_ = &(origin->second);
-      } else {
+      FileContext *file_context = cu_context_->file_context;
+      bool found = false;
+      if (file_context->WaitForReference(
+              data, cu_context_->reporter->cu_offset())) {
+        FilePrivate::AutoLock lock(file_context->file_private_);
+        const AbstractOriginByOffset& origins =
+            file_context->file_private_->origins;
+        AbstractOriginByOffset::const_iterator origin = origins.find(data);
+        if (origin != origins.end()) {
+          abstract_origin_ = &(origin->second);
+          found = true;
+        }
+      }
+      if (!found) {
         cu_context_->reporter->UnknownAbstractOrigin(offset_, data);
       }
       break;
@@ -548,8 +658,10 @@ void DwarfCUToModule::FuncHandler::Finish() {
        cu_context_->functions.push_back(func.release());
      }
   } else if (inline_) {
-    AbstractOrigin origin(name_);
-    cu_context_->file_context->file_private_->origins[offset_] = origin;
+    FilePrivate *file_private = cu_context_->file_context->file_private_;
+    FilePrivate::AutoLock lock(file_private);
+    AbstractOrigin origin(file_private->strings.Intern(name_));
+    file_private->origins[offset_] = origin;
   }
 }
 
@@ -781,7 +893,18 @@ void DwarfCUToModule::SetLanguage(DwarfLanguage language) {
   }
 }
 
-void DwarfCUToModule::ReadSourceLines(uint64 offset) {
+void DwarfCUToModule::LineToModuleHandler::StreamProgram(
+    const char *program, uint64 length, Module *module,
+    DwarfLineToModule::LineSink *sink) {
+  vector<Module::Line> lines;
+  ReadProgram(program, length, module, &lines);
+  for (vector<Module::Line>::const_iterator it = lines.begin();
+       it != lines.end(); ++it)
+    sink->AddLine(*it);
+}
+
+void DwarfCUToModule::ReadSourceLines(uint64 offset,
+                                      DwarfLineToModule::LineSink *sink) {
   const dwarf2reader::SectionMap &section_map
       = cu_context_->file_context->section_map();
   dwarf2reader::SectionMap::const_iterator map_entry
@@ -800,8 +923,8 @@ void DwarfCUToModule::ReadSourceLines(uint64 offset) {
     cu_context_->reporter->BadLineInfoOffset(offset);
     return;
   }
-  line_reader_->ReadProgram(section_start + offset, section_length - offset,
-                            cu_context_->file_context->module_, &lines_);
+  line_reader_->StreamProgram(section_start + offset, section_length - offset,
+                              cu_context_->file_context->module_, sink);
 }
 
 namespace {
@@ -813,75 +936,160 @@ inline bool within(const T &item, Module::Address address) {
   // start of ITEM, or if it falls after ITEM's end.
   return address - item.address < item.size;
 }
-}
 
-void DwarfCUToModule::AssignLinesToFunctions() {
-  vector<Module::Function *> *functions = &cu_context_->functions;
-  WarningReporter *reporter = cu_context_->reporter;
+// Apportions a stream of lines, sorted by address, to the line lists
+// of a vector of functions, also sorted by address. Each line is
+// consumed as soon as the assignment has moved past it, so only a
+// handful of lines are held at any time.
+//
+// This would be simpler if we assumed that source line entries
+// don't cross function boundaries.  However, there's no real reason
+// to assume that (say) a series of function definitions on the same
+// line wouldn't get coalesced into one line number entry.  The
+// DWARF spec certainly makes no such promises.
+//
+// So treat the functions and lines as peers, and take the trouble
+// to compute their ranges' intersections precisely.  In any case,
+// the hair here is a constant factor for performance; the
+// complexity from here on out is linear.
+class LineAssigner {
+ public:
+  LineAssigner(vector<Module::Function *> *functions,
+               DwarfCUToModule::WarningReporter *reporter)
+      : functions_(functions),
+        reporter_(reporter),
+        func_index_(0),
+        line_serial_(0),
+        current_(0),
+        started_(false),
+        stopped_(false),
+        last_line_used_(kNoLine),
+        last_function_cited_(NULL),
+        last_line_cited_(kNoLine) { }
+
+  // Add LINE, which must not start before any line added earlier, and
+  // assign as much as we can of the lines received so far.
+  void AddLine(const Module::Line &line) {
+    if (stopped_)
+      return;
+    lines_.push_back(line);
+    Run(false);
+  }
 
-  // This would be simpler if we assumed that source line entries
-  // don't cross function boundaries.  However, there's no real reason
-  // to assume that (say) a series of function definitions on the same
-  // line wouldn't get coalesced into one line number entry.  The
-  // DWARF spec certainly makes no such promises.
-  //
-  // So treat the functions and lines as peers, and take the trouble
-  // to compute their ranges' intersections precisely.  In any case,
-  // the hair here is a constant factor for performance; the
-  // complexity from here on out is linear.
+  // Assign the remaining lines, given that no more will arrive.
+  void Finish() { Run(true); }
 
-  // Put both our functions and lines in order by address.
-  std::sort(functions->begin(), functions->end(),
-            Module::Function::CompareByAddress);
-  std::sort(lines_.begin(), lines_.end(), Module::Line::CompareByAddress);
+  // The functions found to include code covered by no line. The caller
+  // reports these once it knows the assignment will stand.
+  const vector<Module::Function *> &uncovered_functions() const {
+    return uncovered_functions_;
+  }
+
+ private:
+  static const uint64 kNoLine = ~static_cast<uint64>(0);
+
+  // Make a single pass through the functions and the lines from lower
+  // to higher addresses, populating each Function's lines vector with
+  // the lines that fall within the function's address range. If FINAL
+  // is false, stop when we need a line that hasn't arrived yet.
+  void Run(bool final);
+
+  // Discard the lines that end at or before ADDRESS.
+  void SkipLinesBefore(Module::Address address) {
+    // If lines overlap, then we could go around more than once. We
+    // don't worry too much about what result we produce in that case,
+    // just as long as we don't hang or crash.
+    while (!lines_.empty()
+           && address >= lines_.front().address
+           && !within(lines_.front(), address)) {
+      lines_.pop_front();
+      line_serial_++;
+    }
+  }
+
+  // Stop assigning lines, discarding any that arrive later.
+  void Stop() {
+    stopped_ = true;
+    lines_.clear();
+  }
+
+  vector<Module::Function *> *functions_;
+  DwarfCUToModule::WarningReporter *reporter_;
+
+  // The earliest function that contains or starts after current_.
+  size_t func_index_;
+
+  // The lines received but not yet consumed. The front of the queue
+  // is the earliest line that contains or starts after current_.
+  std::deque<Module::Line> lines_;
+
+  // The position of lines_.front() in the stream of lines added, used
+  // to identify lines once they have been consumed.
+  uint64 line_serial_;
+
+  // The address of the transition we have reached.
+  Module::Address current_;
+
+  // True once current_ has been set to the first transition.
+  bool started_;
+
+  // True if we have reached the end of the address space.
+  bool stopped_;
 
   // The last line that we used any piece of.  We use this only for
   // generating warnings.
-  const Module::Line *last_line_used = NULL;
+  uint64 last_line_used_;
 
   // The last function and line we warned about --- so we can avoid
   // doing so more than once.
-  const Module::Function *last_function_cited = NULL;
-  const Module::Line *last_line_cited = NULL;
-
-  // Make a single pass through both vectors from lower to higher
-  // addresses, populating each Function's lines vector with lines
-  // from our lines_ vector that fall within the function's address
-  // range.
-  vector<Module::Function *>::iterator func_it = functions->begin();
-  vector<Module::Line>::const_iterator line_it = lines_.begin();
-
-  Module::Address current;
-
-  // Pointers to the referents of func_it and line_it, or NULL if the
-  // iterator is at the end of the sequence.
-  Module::Function *func;
-  const Module::Line *line;
-
-  // Start current at the beginning of the first line or function,
-  // whichever is earlier.
-  if (func_it != functions->end() && line_it != lines_.end()) {
-    func = *func_it;
-    line = &*line_it;
-    current = std::min(func->address, line->address);
-  } else if (line_it != lines_.end()) {
-    func = NULL;
-    line = &*line_it;
-    current = line->address;
-  } else if (func_it != functions->end()) {
-    func = *func_it;
-    line = NULL;
-    current = (*func_it)->address;
-  } else {
+  const Module::Function *last_function_cited_;
+  uint64 last_line_cited_;
+
+  vector<Module::Function *> uncovered_functions_;
+};
+
+void LineAssigner::Run(bool final) {
+  if (stopped_)
     return;
+
+  if (!started_) {
+    if (lines_.empty() && !final)
+      return;
+    // Start current_ at the beginning of the first line or function,
+    // whichever is earlier.
+    if (func_index_ < functions_->size() && !lines_.empty()) {
+      current_ = std::min((*functions_)[func_index_]->address,
+                          lines_.front().address);
+    } else if (!lines_.empty()) {
+      current_ = lines_.front().address;
+    } else if (func_index_ < functions_->size()) {
+      current_ = (*functions_)[func_index_]->address;
+    } else {
+      Stop();
+      return;
+    }
+    started_ = true;
+  } else {
+    // Lines received since we last stopped may end before current_.
+    SkipLinesBefore(current_);
   }
 
-  while (func || line) {
+  for (;;) {
+    // Pointers to the current function and line, or NULL if we have
+    // run out of them.
+    Module::Function *func = func_index_ < functions_->size()
+                             ? (*functions_)[func_index_] : NULL;
+    const Module::Line *line = lines_.empty() ? NULL : &lines_.front();
+    if (!line && !final)
+      return;
+    if (!func && !line)
+      return;
+
     // This loop has two invariants that hold at the top.
     //
-    // First, at least one of the iterators is not at the end of its
-    // sequence, and those that are not refer to the earliest
-    // function or line that contains or starts after CURRENT.
+    // First, at least one of func and line is not NULL, and those that
+    // are not refer to the earliest function or line that contains or
+    // starts after CURRENT.
     //
     // Note that every byte is in one of four states: it is covered
     // or not covered by a function, and, independently, it is
@@ -906,31 +1114,31 @@ void DwarfCUToModule::AssignLinesToFunctions() {
     // iterator. So neither iterator moves.
 
     // Assert the first invariant (see above).
-    assert(!func || current < func->address || within(*func, current));
-    assert(!line || current < line->address || within(*line, current));
+    assert(!func || current_ < func->address || within(*func, current_));
+    assert(!line || current_ < line->address || within(*line, current_));
 
     // The next transition after CURRENT.
     Module::Address next_transition;
 
     // Figure out which state we're in, add lines or warn, and compute
     // the next transition address.
-    if (func && current >= func->address) {
-      if (line && current >= line->address) {
+    if (func && current_ >= func->address) {
+      if (line && current_ >= line->address) {
         // Covered by both a line and a function.
-        Module::Address func_left = func->size - (current - func->address);
-        Module::Address line_left = line->size - (current - line->address);
+        Module::Address func_left = func->size - (current_ - func->address);
+        Module::Address line_left = line->size - (current_ - line->address);
         // This may overflow, but things work out.
-        next_transition = current + std::min(func_left, line_left);
+        next_transition = current_ + std::min(func_left, line_left);
         Module::Line l = *line;
-        l.address = current;
-        l.size = next_transition - current;
+        l.address = current_;
+        l.size = next_transition - current_;
         func->lines.push_back(l);
-        last_line_used = line;
+        last_line_used_ = line_serial_;
       } else {
         // Covered by a function, but no line.
-        if (func != last_function_cited) {
-          reporter->UncoveredFunction(*func);
-          last_function_cited = func;
+        if (func != last_function_cited_) {
+          uncovered_functions_.push_back(func);
+          last_function_cited_ = func;
         }
         if (line && within(*func, line->address))
           next_transition = line->address;
@@ -939,7 +1147,7 @@ void DwarfCUToModule::AssignLinesToFunctions() {
           next_transition = func->address + func->size;
       }
     } else {
-      if (line && current >= line->address) {
+      if (line && current_ >= line->address) {
         // Covered by a line, but no function.
         //
         // If GCC emits padding after one function to align the start
@@ -951,12 +1159,12 @@ void DwarfCUToModule::AssignLinesToFunctions() {
         // some of the line we're about to skip, and it ends at the
         // start of the next function, then assume this is what
         // happened, and don't warn.
-        if (line != last_line_cited
+        if (line_serial_ != last_line_cited_
             && !(func
-                 && line == last_line_used
+                 && line_serial_ == last_line_used_
                  && func->address - line->address == line->size)) {
-          reporter->UncoveredLine(*line);
-          last_line_cited = line;
+          reporter_->UncoveredLine(*line);
+          last_line_cited_ = line_serial_;
         }
         if (func && within(*line, func->address))
           next_transition = func->address;
@@ -982,28 +1190,98 @@ void DwarfCUToModule::AssignLinesToFunctions() {
     // next_transition may end up being zero, in which case we've completed
     // our pass. Handle that here, instead of trying to deal with it in
     // each place we compute next_transition.
-    if (!next_transition)
-      break;
+    if (!next_transition) {
+      Stop();
+      return;
+    }
 
-    // Advance iterators as needed. If lines overlap or functions overlap,
-    // then we could go around more than once. We don't worry too much
-    // about what result we produce in that case, just as long as we don't
-    // hang or crash.
-    while (func_it != functions->end()
-           && next_transition >= (*func_it)->address
-           && !within(**func_it, next_transition))
-      func_it++;
-    func = (func_it != functions->end()) ? *func_it : NULL;
-    while (line_it != lines_.end()
-           && next_transition >= line_it->address
-           && !within(*line_it, next_transition))
-      line_it++;
-    line = (line_it != lines_.end()) ? &*line_it : NULL;
+    // Advance past the functions and lines that end at or before the
+    // next transition.
+    while (func_index_ < functions_->size()
+           && next_transition >= (*functions_)[func_index_]->address
+           && !within(*(*functions_)[func_index_], next_transition))
+      func_index_++;
+    SkipLinesBefore(next_transition);
 
     // We must make progress.
-    assert(next_transition > current);
-    current = next_transition;
+    assert(next_transition > current_);
+    current_ = next_transition;
+  }
+}
+
+// Feeds lines to a LineAssigner while they arrive in address order,
+// setting aside any that don't.
+class LineAssignerSink: public DwarfLineToModule::LineSink {
+ public:
+  explicit LineAssignerSink(LineAssigner *assigner)
+      : assigner_(assigner), last_address_(0) { }
+
+  void AddLine(const Module::Line &line) {
+    if (line.address < last_address_) {
+      out_of_order_.push_back(line);
+      return;
+    }
+    last_address_ = line.address;
+    assigner_->AddLine(line);
   }
+
+  vector<Module::Line> *out_of_order() { return &out_of_order_; }
+
+ private:
+  LineAssigner *assigner_;
+  Module::Address last_address_;
+  vector<Module::Line> out_of_order_;
+};
+}
+
+void DwarfCUToModule::AssignLinesToFunctions() {
+  vector<Module::Function *> *functions = &cu_context_->functions;
+  WarningReporter *reporter = cu_context_->reporter;
+
+  // Put our functions in order by address. Line programs usually
+  // present lines in address order too, so we can assign each line as
+  // soon as it is decoded.
+  std::sort(functions->begin(), functions->end(),
+            Module::Function::CompareByAddress);
+
+  LineAssigner assigner(functions, reporter);
+  LineAssignerSink sink(&assigner);
+  if (has_source_line_info_)
+    ReadSourceLines(source_line_offset_, &sink);
+  assigner.Finish();
+
+  vector<Module::Line> *leftovers = sink.out_of_order();
+  if (leftovers->empty()) {
+    for (vector<Module::Function *>::const_iterator it =
+             assigner.uncovered_functions().begin();
+         it != assigner.uncovered_functions().end(); ++it)
+      reporter->UncoveredFunction(**it);
+    return;
+  }
+
+  // Some lines arrived out of order. The pieces already assigned cover
+  // exactly the code the in-order lines did, so pool them with the
+  // leftovers, sort, and assign everything again. Any lines left
+  // uncovered by functions have already been reported, but whether a
+  // function is uncovered depends on all the lines, so we ignore the
+  // first pass's opinion on that.
+  for (vector<Module::Function *>::iterator func = functions->begin();
+       func != functions->end(); ++func) {
+    leftovers->insert(leftovers->end(),
+                      (*func)->lines.begin(), (*func)->lines.end());
+    (*func)->lines.clear();
+  }
+  std::sort(leftovers->begin(), leftovers->end(),
+            Module::Line::CompareByAddress);
+  LineAssigner reassigner(functions, reporter);
+  for (vector<Module::Line>::const_iterator line = leftovers->begin();
+       line != leftovers->end(); ++line)
+    reassigner.AddLine(*line);
+  reassigner.Finish();
+  for (vector<Module::Function *>::const_iterator it =
+           reassigner.uncovered_functions().begin();
+       it != reassigner.uncovered_functions().end(); ++it)
+    reporter->UncoveredFunction(**it);
 }
 
 void DwarfCUToModule::Finish() {
@@ -1015,13 +1293,10 @@ void DwarfCUToModule::Finish() {
   if (!cu_context_->language->HasFunctions())
     return;
 
-  // Read source line info, if we have any.
-  if (has_source_line_info_)
-    ReadSourceLines(source_line_offset_);
-
   vector<Module::Function *> *functions = &cu_context_->functions;
 
-  // Dole out lines to the appropriate functions.
+  // Read source line info, if we have any, and dole out lines to the
+  // appropriate functions.
   AssignLinesToFunctions();
 
   // Add our functions, which now have source lines assigned to them,
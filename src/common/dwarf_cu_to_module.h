@@ -41,6 +41,7 @@
 
 #include <string>
 
+#include "common/dwarf_line_to_module.h"
 #include "common/language.h"
 #include "common/module.h"
 #include "common/dwarf/bytereader.h"
@@ -75,11 +76,25 @@ class DwarfCUToModule: public dwarf2reader::RootDIEHandler {
   // then providing it to the DwarfCUToModule instance for each
   // compilation unit we process in that file. Set HANDLE_INTER_CU_REFS
   // to true to handle debugging symbols with DW_FORM_ref_addr entries.
+  //
+  // To process a file's compilation units on several threads at once,
+  // call SetCompilationUnitOffsets on one FileContext, create one
+  // FileContext per compilation unit that shares its inter-CU data (see
+  // the second constructor), and call CompilationUnitDone once each unit
+  // has been processed. References into an earlier unit then wait for
+  // that unit to finish, so the results are the same as when the units
+  // are processed in order.
   class FileContext {
    public:
     FileContext(const string &filename,
                 Module *module,
                 bool handle_inter_cu_refs);
+
+    // Create a FileContext that contributes definitions to MODULE but
+    // shares SHARED's filename, section map, and inter-CU data. SHARED
+    // must outlive the new FileContext.
+    FileContext(FileContext *shared, Module *module);
+
     ~FileContext();
 
     // Add CONTENTS of size LENGTH to the section map as NAME.
@@ -92,12 +107,27 @@ class DwarfCUToModule: public dwarf2reader::RootDIEHandler {
 
     const dwarf2reader::SectionMap& section_map() const;
 
+    // Prepare to process the compilation units starting at OFFSETS, which
+    // must be in increasing order, concurrently.
+    void SetCompilationUnitOffsets(const vector<uint64> &offsets);
+
+    // Note that the compilation unit starting at OFFSET has been
+    // processed, waking any units waiting to refer to its DIEs.
+    void CompilationUnitDone(uint64 offset);
+
    private:
     friend class DwarfCUToModule;
 
     // Clears all the Specifications if HANDLE_INTER_CU_REFS_ is false.
     void ClearSpecifications();
 
+    // Returns true if the DIE at OFFSET, referred to by the compilation
+    // unit starting at COMPILATION_UNIT_START, may already have been
+    // recorded. When compilation units are processed concurrently, this
+    // waits for the unit holding OFFSET to finish, and returns false if
+    // that unit would only have been processed later.
+    bool WaitForReference(uint64 offset, uint64 compilation_unit_start);
+
     // Given an OFFSET and a CU that starts at COMPILATION_UNIT_START, returns
     // true if this is an inter-compilation unit reference that is not being
     // handled.
@@ -117,8 +147,10 @@ class DwarfCUToModule: public dwarf2reader::RootDIEHandler {
     // True if we are handling references between compilation units.
     const bool handle_inter_cu_refs_;
 
-    // Inter-compilation unit data used internally by the handlers.
-    scoped_ptr<FilePrivate> file_private_;
+    // Inter-compilation unit data used internally by the handlers. This
+    // is owned_file_private_, unless it is shared with another FileContext.
+    scoped_ptr<FilePrivate> owned_file_private_;
+    FilePrivate *file_private_;
   };
 
   // An abstract base class for handlers that handle DWARF line data
@@ -142,6 +174,14 @@ class DwarfCUToModule: public dwarf2reader::RootDIEHandler {
     // lines to LINES.
     virtual void ReadProgram(const char *program, uint64 length,
                              Module *module, vector<Module::Line> *lines) = 0;
+
+    // Like ReadProgram, but pass each line to SINK as it is decoded,
+    // without accumulating them. The default definition calls
+    // ReadProgram and then hands SINK the lines it produced; handlers
+    // that can decode incrementally should override it.
+    virtual void StreamProgram(const char *program, uint64 length,
+                               Module *module,
+                               DwarfLineToModule::LineSink *sink);
   };
 
   // The interface DwarfCUToModule uses to report warnings. The member
@@ -271,15 +311,17 @@ class DwarfCUToModule: public dwarf2reader::RootDIEHandler {
   void SetLanguage(DwarfLanguage language);
 
   // Read source line information at OFFSET in the .debug_line
-  // section.  Record source files in module_, but record source lines
-  // in lines_; we apportion them to functions in
-  // AssignLinesToFunctions.
-  void ReadSourceLines(uint64 offset);
-
-  // Assign the lines in lines_ to the individual line lists of the
-  // functions in functions_.  (DWARF line information maps an entire
-  // compilation unit at a time, and gives no indication of which
-  // lines belong to which functions, beyond their addresses.)
+  // section.  Record source files in module_, and pass source lines
+  // to SINK as they are decoded.
+  void ReadSourceLines(uint64 offset, DwarfLineToModule::LineSink *sink);
+
+  // Read this compilation unit's source lines and assign them to the
+  // individual line lists of the functions in functions_.  (DWARF line
+  // information maps an entire compilation unit at a time, and gives no
+  // indication of which lines belong to which functions, beyond their
+  // addresses.)  Lines are merged into functions as the line program is
+  // decoded; only lines that arrive out of address order are held until
+  // the end.
   void AssignLinesToFunctions();
 
   // The only reason cu_context_ and child_context_ are pointers is
@@ -303,11 +345,6 @@ class DwarfCUToModule: public dwarf2reader::RootDIEHandler {
   // The offset of this compilation unit's line number information in
   // the .debug_line section.
   uint64 source_line_offset_;
-
-  // The line numbers we have seen thus far.  We accumulate these here
-  // during parsing.  Then, in Finish, we call AssignLinesToFunctions
-  // to dole them out to the appropriate functions.
-  vector<Module::Line> lines_;
 };
 
 }  // namespace google_breakpad
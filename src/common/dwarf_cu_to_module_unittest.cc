@@ -990,6 +990,29 @@ TEST_F(FuncLinePairing, LineAtEndOfAddressSpace) {
   TestLine(1, 0, 0xfffffffffffffffaULL, 5, "line-file", 63351048);
 }
 
+// Lines that arrive out of address order after some lines have already
+// been assigned must not disturb the pieces assigned earlier.
+TEST_F(FuncLinePairing, LateLineBetweenAssigned) {
+  PushLine(10, 10, "line-file", 79794388);
+  PushLine(30, 10, "line-file", 60012368);
+  PushLine(20, 10, "line-file", 23805671);
+
+  StartCU();
+  DefineFunction(&root_handler_, "function1", 10, 15, NULL);
+  DefineFunction(&root_handler_, "function2", 25, 15, NULL);
+  root_handler_.Finish();
+
+  TestFunctionCount(2);
+  TestFunction(0, "function1", 10, 15);
+  TestLineCount(0, 2);
+  TestLine(0, 0, 10, 10, "line-file", 79794388);
+  TestLine(0, 1, 20, 5, "line-file", 23805671);
+  TestFunction(1, "function2", 25, 15);
+  TestLineCount(1, 2);
+  TestLine(1, 0, 25, 5, "line-file", 23805671);
+  TestLine(1, 1, 30, 10, "line-file", 60012368);
+}
+
 // A function with more than one uncovered area should only be warned
 // about once.
 TEST_F(FuncLinePairing, WarnOnceFunc) {
@@ -1488,6 +1511,68 @@ TEST_F(Specifications, InterCU) {
   EXPECT_STREQ("class_A::member_func_B", functions[0]->name.c_str());
 }
 
+TEST_F(Specifications, SharedFileContext) {
+  Module m("module-name", "module-os", "module-arch", "module-id");
+  DwarfCUToModule::FileContext fc("dwarf-filename", &m, true);
+  vector<uint64> offsets;
+  offsets.push_back(0x100);
+  offsets.push_back(0x200);
+  fc.SetCompilationUnitOffsets(offsets);
+  MockLineToModuleHandler lr;
+  EXPECT_CALL(lr, ReadProgram(_,_,_,_)).Times(0);
+
+  // Kludge: satisfy reporter_'s expectation.
+  reporter_.SetCUName("compilation-unit-name");
+
+  // First CU.  Declares func_A, and refers to a DIE in the second CU,
+  // which a sequential reader wouldn't have seen yet either.
+  Module m1("module-name", "module-os", "module-arch", "module-id");
+  {
+    DwarfCUToModule::FileContext fc1(&fc, &m1);
+    MockWarningReporter reporter1("dwarf-filename", 0x100);
+    EXPECT_CALL(reporter1, UnknownSpecification(_, 0x210)).Times(1);
+    DwarfCUToModule root1_handler(&fc1, &lr, &reporter1);
+    ASSERT_TRUE(root1_handler.StartCompilationUnit(0x100, 1, 2, 3, 3));
+    ASSERT_TRUE(root1_handler.StartRootDIE(0x10b,
+                                           dwarf2reader::DW_TAG_compile_unit));
+    ASSERT_TRUE(root1_handler.EndAttributes());
+    DeclarationDIE(&root1_handler, 0x110,
+                   dwarf2reader::DW_TAG_subprogram, "func_A", "");
+    DIEHandler *class_B_handler
+      = StartSpecifiedDIE(&root1_handler, dwarf2reader::DW_TAG_class_type,
+                          0x210);
+    class_B_handler->Finish();
+    delete class_B_handler;
+    root1_handler.Finish();
+  }
+  fc.CompilationUnitDone(0x100);
+
+  // Second CU.  Defines func_A.
+  Module m2("module-name", "module-os", "module-arch", "module-id");
+  {
+    DwarfCUToModule::FileContext fc2(&fc, &m2);
+    MockWarningReporter reporter2("dwarf-filename", 0x200);
+    EXPECT_CALL(reporter2, UncoveredFunction(_)).WillOnce(Return());
+    DwarfCUToModule root2_handler(&fc2, &lr, &reporter2);
+    ASSERT_TRUE(root2_handler.StartCompilationUnit(0x200, 1, 2, 3, 3));
+    ASSERT_TRUE(root2_handler.StartRootDIE(0x20b,
+                                           dwarf2reader::DW_TAG_compile_unit));
+    ASSERT_TRUE(root2_handler.EndAttributes());
+    DefinitionDIE(&root2_handler, dwarf2reader::DW_TAG_subprogram,
+                  0x110, "", 0x9e1d35adfa2d1e27ULL, 0x5b1dd8eb05c2a4e1ULL);
+    root2_handler.Finish();
+  }
+  fc.CompilationUnitDone(0x200);
+
+  m.TakeFunctions(&m1);
+  m.TakeFunctions(&m2);
+  vector<Module::Function *> functions;
+  m.GetFunctions(&functions, functions.end());
+  ASSERT_EQ(1U, functions.size());
+  EXPECT_STREQ("func_A", functions[0]->name.c_str());
+  EXPECT_EQ(0x9e1d35adfa2d1e27ULL, functions[0]->address);
+}
+
 TEST_F(Specifications, UnhandledInterCU) {
   Module m("module-name", "module-os", "module-arch", "module-id");
   DwarfCUToModule::FileContext fc("dwarf-filename", &m, false);
@@ -67,7 +67,8 @@ void DwarfLineToModule::DefineDir(const string &name, uint32 dir_num) {
   // Directory number zero is reserved to mean the compilation
   // directory. Silently ignore attempts to redefine it.
   if (dir_num != 0)
-    directories_[dir_num] = ExpandPath(name, compilation_dir_);
+    directories_[dir_num] =
+        module_->InternPathPart(ExpandPath(name, compilation_dir_));
 }
 
 void DwarfLineToModule::DefineFile(const string &name, int32 file_num,
@@ -78,11 +79,11 @@ void DwarfLineToModule::DefineFile(const string &name, int32 file_num,
   else if (file_num > highest_file_number_)
     highest_file_number_ = file_num;
 
-  string dir_name;
+  const char *dir_name = NULL;
   if (dir_num == 0) {
     // Directory number zero is the compilation directory, and is stored as
     // an attribute on the compilation unit, rather than in the program table.
-    dir_name = compilation_dir_;
+    dir_name = compilation_dir_part_;
   } else {
     DirectoryTable::const_iterator directory_it = directories_.find(dir_num);
     if (directory_it != directories_.end()) {
@@ -93,14 +94,16 @@ void DwarfLineToModule::DefineFile(const string &name, int32 file_num,
                 " directory numbers\n");
         warned_bad_directory_number_ = true;
       }
+      dir_name = module_->InternPathPart(string());
     }
   }
 
-  string full_name = ExpandPath(name, dir_name);
-
   // Find a Module::File object of the given name, and add it to the
-  // file table.
-  files_[file_num] = module_->FindFile(full_name);
+  // file table. The module remembers files by directory and name, so
+  // headers that every compilation unit includes are only joined to
+  // their directories once.
+  files_[file_num] =
+      module_->FindFileInDirectory(dir_name, module_->InternPathPart(name));
 }
 
 void DwarfLineToModule::AddLine(uint64 address, uint64 length,
@@ -137,7 +140,10 @@ void DwarfLineToModule::AddLine(uint64 address, uint64 length,
   line.size = length;
   line.file = file;
   line.number = line_num;
-  lines_->push_back(line);
+  if (lines_)
+    lines_->push_back(line);
+  else
+    sink_->AddLine(line);
 }
 
 } // namespace google_breakpad
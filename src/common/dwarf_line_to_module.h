@@ -113,6 +113,17 @@ namespace google_breakpad {
 // - If a line starts immediately after an omitted line, omit it too.
 class DwarfLineToModule: public dwarf2reader::LineInfoHandler {
  public:
+  // An interface for clients that would rather receive lines one at a
+  // time, as the line number program is decoded, than have them all
+  // accumulated in a vector.
+  class LineSink {
+   public:
+    virtual ~LineSink() { }
+
+    // Accept LINE, which the parser has just finished decoding.
+    virtual void AddLine(const Module::Line &line) = 0;
+  };
+
   // As the DWARF line info parser passes us line records, add source
   // files to MODULE, and add all lines to the end of LINES. LINES
   // need not be empty. If the parser hands us a zero-length line, we
@@ -124,12 +135,28 @@ class DwarfLineToModule: public dwarf2reader::LineInfoHandler {
                     vector<Module::Line> *lines)
       : module_(module),
         compilation_dir_(compilation_dir),
+        compilation_dir_part_(module->InternPathPart(compilation_dir)),
         lines_(lines),
+        sink_(NULL),
         highest_file_number_(-1),
         omitted_line_end_(0),
         warned_bad_file_number_(false),
         warned_bad_directory_number_(false) { }
   
+  // As above, but pass each line to SINK as soon as it is decoded,
+  // instead of adding it to a vector.
+  DwarfLineToModule(Module *module, const string& compilation_dir,
+                    LineSink *sink)
+      : module_(module),
+        compilation_dir_(compilation_dir),
+        compilation_dir_part_(module->InternPathPart(compilation_dir)),
+        lines_(NULL),
+        sink_(sink),
+        highest_file_number_(-1),
+        omitted_line_end_(0),
+        warned_bad_file_number_(false),
+        warned_bad_directory_number_(false) { }
+
   ~DwarfLineToModule() { }
 
   void DefineDir(const string &name, uint32 dir_num);
@@ -141,7 +168,7 @@ class DwarfLineToModule: public dwarf2reader::LineInfoHandler {
 
  private:
 
-  typedef std::map<uint32, string> DirectoryTable;
+  typedef std::map<uint32, const char *> DirectoryTable;
   typedef std::map<uint32, Module::File *> FileTable;
 
   // The module we're contributing debugging info to. Owned by our
@@ -152,6 +179,9 @@ class DwarfLineToModule: public dwarf2reader::LineInfoHandler {
   // lines are being accumulated.
   string compilation_dir_;
 
+  // compilation_dir_, as interned by module_->InternPathPart.
+  const char *compilation_dir_part_;
+
   // The vector of lines we're accumulating. Owned by our client.
   //
   // In a Module, as in a breakpad symbol file, lines belong to
@@ -163,7 +193,12 @@ class DwarfLineToModule: public dwarf2reader::LineInfoHandler {
   // whoever constructed this sort it all out.
   vector<Module::Line> *lines_;
 
-  // A table mapping directory numbers to paths.
+  // If lines_ is NULL, the sink to which we pass lines instead. Owned by
+  // our client.
+  LineSink *sink_;
+
+  // A table mapping directory numbers to paths, as interned by
+  // module_->InternPathPart.
   DirectoryTable directories_;
 
   // A table mapping file numbers to Module::File pointers.
@@ -389,3 +389,27 @@ TEST(Omitted, Mix2) {
   EXPECT_EQ(67355743, lines[0].number);
   EXPECT_EQ(23365776, lines[1].number);
 }
+
+// A sink that collects the lines it is passed.
+class CollectingSink: public DwarfLineToModule::LineSink {
+ public:
+  void AddLine(const Module::Line &line) { lines.push_back(line); }
+  vector<Module::Line> lines;
+};
+
+TEST(Sink, LinesPassedInOrder) {
+  Module m("name", "os", "architecture", "id");
+  CollectingSink sink;
+  DwarfLineToModule h(&m, "/", &sink);
+
+  h.DefineFile("file1", 1, 0, 0, 0);
+  h.AddLine(0x40, 0x10, 1, 37469824, 0);
+  h.AddLine(0x20, 0x10, 1, 95614174, 0);
+  h.AddLine(0x50, 0, 1, 49520831, 0);
+
+  ASSERT_EQ(2U, sink.lines.size());
+  EXPECT_EQ(0x40U, sink.lines[0].address);
+  EXPECT_EQ(37469824, sink.lines[0].number);
+  EXPECT_EQ(0x20U, sink.lines[1].address);
+  EXPECT_EQ(95614174, sink.lines[1].number);
+}
@@ -0,0 +1,321 @@
+// Copyright (c) 2016 Google Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+// notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above
+// copyright notice, this list of conditions and the following disclaimer
+// in the documentation and/or other materials provided with the
+// distribution.
+//     * Neither the name of Google Inc. nor the names of its
+// contributors may be used to endorse or promote products derived from
+// this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+// crash_report_spooler.cc: Implement google_breakpad::CrashReportSpooler.
+// See crash_report_spooler.h for details.
+
+#include "common/linux/crash_report_spooler.h"
+
+#include <dirent.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <set>
+#include <utility>
+
+#include "common/linux/memory_mapped_file.h"
+#include "common/memory_range.h"
+#include "google_breakpad/common/minidump_format.h"
+
+namespace google_breakpad {
+
+namespace {
+
+static const char kDumpSuffix[] = ".dmp";
+static const char kRejectedSuffix[] = ".rejected";
+
+// Returns the instruction pointer in the CPU context |context|, or false
+// if its CPU isn't recognized.
+bool GetInstructionPointer(const MemoryRange &context, uint64_t *ip) {
+  // AMD64 contexts start with spill space rather than the context flags,
+  // so they are recognized by their size, as MinidumpContext does.
+  if (context.length() == sizeof(MDRawContextAMD64)) {
+    *ip = context.GetData<MDRawContextAMD64>(0)->rip;
+    return true;
+  }
+  const uint32_t *context_flags = context.GetData<uint32_t>(0);
+  if (!context_flags)
+    return false;
+  switch (*context_flags & MD_CONTEXT_CPU_MASK) {
+    case MD_CONTEXT_X86:
+      if (const MDRawContextX86 *x86 = context.GetData<MDRawContextX86>(0)) {
+        *ip = x86->eip;
+        return true;
+      }
+      break;
+    case MD_CONTEXT_ARM:
+      if (const MDRawContextARM *arm = context.GetData<MDRawContextARM>(0)) {
+        *ip = arm->iregs[MD_CONTEXT_ARM_REG_PC];
+        return true;
+      }
+      break;
+    case MD_CONTEXT_ARM64:
+      if (const MDRawContextARM64 *arm64 =
+              context.GetData<MDRawContextARM64>(0)) {
+        *ip = arm64->iregs[MD_CONTEXT_ARM64_REG_PC];
+        return true;
+      }
+      break;
+  }
+  return false;
+}
+
+// Returns the file name, without its directory, of the module in
+// |module_list| that contains |address|, along with the module's base
+// address.  Returns false if no module contains |address|.
+bool FindModule(const MemoryRange &dump, const MemoryRange &module_list,
+                uint64_t address, string *name, uint64_t *base) {
+  const uint32_t *count = module_list.GetData<uint32_t>(0);
+  if (!count)
+    return false;
+  for (uint32_t i = 0; i < *count; ++i) {
+    const MDRawModule *module = reinterpret_cast<const MDRawModule *>(
+        module_list.GetArrayElement(sizeof(uint32_t), MD_MODULE_SIZE, i));
+    if (!module)
+      return false;
+    if (address < module->base_of_image ||
+        address - module->base_of_image >= module->size_of_image) {
+      continue;
+    }
+    // Module names are UTF-16; a lossy narrowing is enough for a key.
+    name->clear();
+    const uint32_t *length = dump.GetData<uint32_t>(module->module_name_rva);
+    for (uint32_t j = 0; length && j < *length / 2; ++j) {
+      const uint16_t *c = dump.GetArrayElement<uint16_t>(
+          module->module_name_rva + sizeof(uint32_t), j);
+      if (!c)
+        break;
+      if (*c == '/')
+        name->clear();
+      else
+        name->push_back(static_cast<char>(*c));
+    }
+    *base = module->base_of_image;
+    return true;
+  }
+  return false;
+}
+
+}  // namespace
+
+CrashReportSpooler::Options::Options()
+    : file_part_name("upload_file_minidump"),
+      compress(false),
+      max_batch(4),
+      batch_interval_seconds(10),
+      initial_backoff_seconds(30),
+      max_backoff_seconds(3600),
+      dedupe_seconds(3600) {
+}
+
+CrashReportSpooler::CrashReportSpooler(const Options &options)
+    : options_(options),
+      next_batch_time_(0),
+      backoff_seconds_(0),
+      uploaded_(0),
+      duplicates_(0),
+      failures_(0),
+      rejected_(0) {
+  session_.set_proxy(options_.proxy, options_.proxy_user_pwd);
+  session_.set_compress(options_.compress);
+}
+
+CrashReportSpooler::~CrashReportSpooler() {}
+
+bool CrashReportSpooler::Init(string *error_description) {
+  return session_.Init(error_description);
+}
+
+int CrashReportSpooler::RunOnce(time_t now) {
+  if (now < next_batch_time_)
+    return next_batch_time_ - now;
+
+  // Forget signatures that are too old to suppress duplicates.
+  for (map<string, time_t>::iterator iter = recent_signatures_.begin();
+       iter != recent_signatures_.end();) {
+    if (now - iter->second >= options_.dedupe_seconds)
+      recent_signatures_.erase(iter++);
+    else
+      ++iter;
+  }
+
+  // Pick the oldest dumps that aren't duplicates of a recent upload, or
+  // of another dump in this batch.
+  vector<string> dumps = ListDumps(now);
+  vector<HTTPUploadSession::Request> requests;
+  vector<string> signatures;
+  std::set<string> batch_signatures;
+  for (size_t i = 0; i < dumps.size() &&
+                     requests.size() < static_cast<size_t>(options_.max_batch);
+       ++i) {
+    string signature = GetSignature(dumps[i]);
+    if (!signature.empty() &&
+        (recent_signatures_.count(signature) ||
+         !batch_signatures.insert(signature).second)) {
+      unlink(dumps[i].c_str());
+      ++duplicates_;
+      continue;
+    }
+    HTTPUploadSession::Request request;
+    request.url = options_.url;
+    request.parameters = options_.parameters;
+    request.upload_file = dumps[i];
+    request.file_part_name = options_.file_part_name;
+    requests.push_back(request);
+    signatures.push_back(signature);
+  }
+
+  bool failed = false;
+  if (!requests.empty()) {
+    SendRequests(&requests);
+    for (size_t i = 0; i < requests.size(); ++i) {
+      const HTTPUploadSession::Request &request = requests[i];
+      if (request.success) {
+        unlink(request.upload_file.c_str());
+        if (!signatures[i].empty())
+          recent_signatures_[signatures[i]] = now;
+        ++uploaded_;
+      } else if (request.response_code >= 400 &&
+                 request.response_code < 500 &&
+                 request.response_code != 408 &&
+                 request.response_code != 429) {
+        // The server won't take this dump; keep it for inspection, out of
+        // the way of the dumps behind it.
+        rename(request.upload_file.c_str(),
+               (request.upload_file + kRejectedSuffix).c_str());
+        ++rejected_;
+      } else {
+        ++failures_;
+        failed = true;
+      }
+    }
+  }
+
+  if (failed) {
+    backoff_seconds_ = backoff_seconds_ ?
+        std::min(2 * backoff_seconds_, options_.max_backoff_seconds) :
+        options_.initial_backoff_seconds;
+  } else {
+    backoff_seconds_ = 0;
+  }
+  int wait = std::max(backoff_seconds_, options_.batch_interval_seconds);
+  next_batch_time_ = now + wait;
+  return wait;
+}
+
+// static
+string CrashReportSpooler::GetMinidumpSignature(const string &path) {
+  MemoryMappedFile mapped_file;
+  if (!mapped_file.Map(path.c_str(), 0))
+    return "";
+  MemoryRange dump = mapped_file.content();
+  const MDRawHeader *header = dump.GetData<MDRawHeader>(0);
+  if (!header || header->signature != MD_HEADER_SIGNATURE)
+    return "";
+
+  const MDRawExceptionStream *exception = NULL;
+  MemoryRange module_list;
+  for (uint32_t i = 0; i < header->stream_count; ++i) {
+    const MDRawDirectory *directory = dump.GetArrayElement<MDRawDirectory>(
+        header->stream_directory_rva, i);
+    if (!directory)
+      return "";
+    if (directory->stream_type == MD_EXCEPTION_STREAM) {
+      exception = dump.GetData<MDRawExceptionStream>(directory->location.rva);
+    } else if (directory->stream_type == MD_MODULE_LIST_STREAM) {
+      module_list = dump.Subrange(directory->location.rva,
+                                  directory->location.data_size);
+    }
+  }
+  if (!exception)
+    return "";
+
+  uint64_t address = exception->exception_record.exception_address;
+  GetInstructionPointer(dump.Subrange(exception->thread_context.rva,
+                                      exception->thread_context.data_size),
+                        &address);
+  char buffer[128];
+  string module_name;
+  uint64_t module_base;
+  if (FindModule(dump, module_list, address, &module_name, &module_base)) {
+    snprintf(buffer, sizeof(buffer), "%08x|%s|0x%llx",
+             exception->exception_record.exception_code,
+             module_name.c_str(),
+             static_cast<unsigned long long>(address - module_base));
+  } else {
+    snprintf(buffer, sizeof(buffer), "%08x|0x%llx",
+             exception->exception_record.exception_code,
+             static_cast<unsigned long long>(address));
+  }
+  return buffer;
+}
+
+string CrashReportSpooler::GetSignature(const string &path) {
+  return GetMinidumpSignature(path);
+}
+
+void CrashReportSpooler::SendRequests(
+    vector<HTTPUploadSession::Request> *requests) {
+  session_.SendRequests(requests, options_.max_batch);
+}
+
+vector<string> CrashReportSpooler::ListDumps(time_t now) const {
+  vector<std::pair<time_t, string> > dumps;
+  DIR *directory = opendir(options_.spool_directory.c_str());
+  if (!directory)
+    return vector<string>();
+  const size_t suffix_length = sizeof(kDumpSuffix) - 1;
+  while (struct dirent *entry = readdir(directory)) {
+    size_t length = strlen(entry->d_name);
+    if (length <= suffix_length ||
+        strcmp(entry->d_name + length - suffix_length, kDumpSuffix) != 0) {
+      continue;
+    }
+    string path = options_.spool_directory + "/" + entry->d_name;
+    struct stat st;
+    if (stat(path.c_str(), &st) != 0 || !S_ISREG(st.st_mode) ||
+        now - st.st_mtime < kSettleSeconds) {
+      continue;
+    }
+    dumps.push_back(std::make_pair(st.st_mtime, path));
+  }
+  closedir(directory);
+
+  std::sort(dumps.begin(), dumps.end());
+  vector<string> paths(dumps.size());
+  for (size_t i = 0; i < dumps.size(); ++i)
+    paths[i] = dumps[i].second;
+  return paths;
+}
+
+}  // namespace google_breakpad
@@ -0,0 +1,138 @@
+// Copyright (c) 2016 Google Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+// notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above
+// copyright notice, this list of conditions and the following disclaimer
+// in the documentation and/or other materials provided with the
+// distribution.
+//     * Neither the name of Google Inc. nor the names of its
+// contributors may be used to endorse or promote products derived from
+// this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+// crash_report_spooler.h: Define the google_breakpad::CrashReportSpooler
+// class, which uploads the minidumps left in a spool directory.
+
+#ifndef COMMON_LINUX_CRASH_REPORT_SPOOLER_H_
+#define COMMON_LINUX_CRASH_REPORT_SPOOLER_H_
+
+#include <time.h>
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include "common/linux/http_upload.h"
+#include "common/using_std_string.h"
+
+namespace google_breakpad {
+
+// CrashReportSpooler uploads the minidumps (files named *.dmp) that
+// crashing processes leave in a spool directory.  It is meant to be driven
+// by a long-lived daemon, so that a crash loop across a fleet reaches the
+// crash server as a steady trickle of reports instead of a burst:
+//  - A dump whose crash signature matches one uploaded recently is deleted
+//    without being uploaded.
+//  - Dumps are uploaded in batches of at most |max_batch|, no more often
+//    than every |batch_interval_seconds|, over one HTTPUploadSession, so
+//    connections to the server stay open.
+//  - After a failed upload, batches back off exponentially from
+//    |initial_backoff_seconds| up to |max_backoff_seconds|.  Dumps that the
+//    server rejects with a 4xx status are renamed to *.dmp.rejected and
+//    not retried.
+class CrashReportSpooler {
+ public:
+  struct Options {
+    Options();
+
+    string spool_directory;
+    string url;
+    string file_part_name;          // Default "upload_file_minidump".
+    map<string, string> parameters;  // Sent with every dump.
+    string proxy;
+    string proxy_user_pwd;
+    bool compress;                  // Default false.
+
+    int max_batch;                  // Default 4.
+    int batch_interval_seconds;     // Default 10.
+    int initial_backoff_seconds;    // Default 30.
+    int max_backoff_seconds;        // Default 3600.
+    int dedupe_seconds;             // Default 3600.
+  };
+
+  explicit CrashReportSpooler(const Options &options);
+  virtual ~CrashReportSpooler();
+
+  // Loads libcurl.  Returns false, setting error_description if it is
+  // non-NULL, if that fails.
+  bool Init(string *error_description);
+
+  // Uploads the next batch of dumps if one is due at time |now|.  Returns
+  // the number of seconds to wait before calling RunOnce again.
+  int RunOnce(time_t now);
+
+  // Returns a crash signature for the minidump at |path|, made of the
+  // exception code and the crash address, relative to the module that
+  // contains it.  Returns an empty string if the dump has no exception.
+  static string GetMinidumpSignature(const string &path);
+
+  int uploaded() const { return uploaded_; }
+  int duplicates() const { return duplicates_; }
+  int failures() const { return failures_; }
+  int rejected() const { return rejected_; }
+
+ protected:
+  // Returns the crash signature of the dump at |path|.  Dumps with equal,
+  // non-empty signatures are duplicates.  Defaults to
+  // GetMinidumpSignature.
+  virtual string GetSignature(const string &path);
+
+  // Sends |requests|, filling in their results.  Defaults to sending them
+  // concurrently over |session_|.
+  virtual void SendRequests(vector<HTTPUploadSession::Request> *requests);
+
+ private:
+  // Dumps younger than this may still be being written, and are left
+  // for a later batch.
+  static const int kSettleSeconds = 5;
+
+  // Returns the paths of the dumps in the spool directory that are ready
+  // to upload at time |now|, oldest first.
+  vector<string> ListDumps(time_t now) const;
+
+  Options options_;
+  HTTPUploadSession session_;
+
+  // Signatures of recently uploaded dumps, with the time of the upload.
+  map<string, time_t> recent_signatures_;
+
+  time_t next_batch_time_;
+  int backoff_seconds_;  // 0 unless the last batch failed.
+
+  int uploaded_;
+  int duplicates_;
+  int failures_;
+  int rejected_;
+};
+
+}  // namespace google_breakpad
+
+#endif  // COMMON_LINUX_CRASH_REPORT_SPOOLER_H_
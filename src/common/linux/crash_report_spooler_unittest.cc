@@ -0,0 +1,225 @@
+// Copyright (c) 2016 Google Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+// notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above
+// copyright notice, this list of conditions and the following disclaimer
+// in the documentation and/or other materials provided with the
+// distribution.
+//     * Neither the name of Google Inc. nor the names of its
+// contributors may be used to endorse or promote products derived from
+// this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+// crash_report_spooler_unittest.cc: Unit tests for
+// google_breakpad::CrashReportSpooler.
+
+#include <stdlib.h>
+#include <sys/stat.h>
+#include <utime.h>
+
+#include <string>
+#include <vector>
+
+#include "breakpad_googletest_includes.h"
+#include "common/linux/crash_report_spooler.h"
+#include "common/tests/auto_tempdir.h"
+#include "common/tests/file_utils.h"
+#include "common/using_std_string.h"
+
+namespace {
+
+using google_breakpad::AutoTempDir;
+using google_breakpad::CrashReportSpooler;
+using google_breakpad::HTTPUploadSession;
+using google_breakpad::WriteFile;
+using std::map;
+using std::vector;
+
+// A spooler whose dumps have made-up signatures, and whose uploads get
+// canned responses.
+class TestSpooler : public CrashReportSpooler {
+ public:
+  explicit TestSpooler(const Options &options)
+      : CrashReportSpooler(options) {}
+
+  // Signatures by dump file name.  Dumps not listed have none.
+  map<string, string> signatures;
+  // The status codes of the next uploads; uploads succeed once it's empty.
+  vector<long> response_codes;
+  // The file names of the dumps that were sent.
+  vector<string> sent;
+
+ protected:
+  virtual string GetSignature(const string &path) {
+    return signatures[Basename(path)];
+  }
+
+  virtual void SendRequests(vector<HTTPUploadSession::Request> *requests) {
+    for (size_t i = 0; i < requests->size(); ++i) {
+      HTTPUploadSession::Request &request = (*requests)[i];
+      sent.push_back(Basename(request.upload_file));
+      request.response_code = 200;
+      if (!response_codes.empty()) {
+        request.response_code = response_codes.front();
+        response_codes.erase(response_codes.begin());
+      }
+      request.success = request.response_code == 200;
+    }
+  }
+
+ private:
+  static string Basename(const string &path) {
+    return path.substr(path.rfind('/') + 1);
+  }
+};
+
+class CrashReportSpoolerTest : public ::testing::Test {
+ public:
+  void SetUp() {
+    options_.spool_directory = temp_dir_.path();
+    options_.url = "http://localhost/upload";
+    options_.max_batch = 2;
+    options_.batch_interval_seconds = 10;
+    options_.initial_backoff_seconds = 30;
+    options_.max_backoff_seconds = 100;
+    options_.dedupe_seconds = 1000;
+    now_ = time(NULL) + 100;
+  }
+
+  // Creates the dump |name| in the spool directory, |age| seconds old.
+  void AddDump(const string &name, int age) {
+    string path = Path(name);
+    ASSERT_TRUE(WriteFile(path.c_str(), "MDMP", 4));
+    struct utimbuf times;
+    times.actime = times.modtime = now_ - age;
+    ASSERT_EQ(0, utime(path.c_str(), &times));
+  }
+
+  bool Exists(const string &name) {
+    struct stat st;
+    return stat(Path(name).c_str(), &st) == 0;
+  }
+
+  string Path(const string &name) {
+    return temp_dir_.path() + "/" + name;
+  }
+
+  AutoTempDir temp_dir_;
+  CrashReportSpooler::Options options_;
+  time_t now_;
+};
+
+TEST_F(CrashReportSpoolerTest, BatchesAndDropsDuplicates) {
+  TestSpooler spooler(options_);
+  spooler.signatures["a.dmp"] = "crash 1";
+  spooler.signatures["b.dmp"] = "crash 1";
+  spooler.signatures["c.dmp"] = "crash 2";
+  spooler.signatures["e.dmp"] = "crash 3";
+  AddDump("a.dmp", 60);
+  AddDump("b.dmp", 50);
+  AddDump("c.dmp", 40);
+  AddDump("d.dmp", 30);
+  AddDump("e.dmp", 20);
+  AddDump("notes.txt", 20);
+  // Too new; it may still be being written.
+  AddDump("f.dmp", 1);
+
+  // b.dmp repeats a.dmp's crash, so it's dropped from the first batch.
+  EXPECT_EQ(10, spooler.RunOnce(now_));
+  ASSERT_EQ(2U, spooler.sent.size());
+  EXPECT_EQ("a.dmp", spooler.sent[0]);
+  EXPECT_EQ("c.dmp", spooler.sent[1]);
+  EXPECT_FALSE(Exists("a.dmp"));
+  EXPECT_FALSE(Exists("b.dmp"));
+  EXPECT_FALSE(Exists("c.dmp"));
+  EXPECT_EQ(1, spooler.duplicates());
+
+  // Nothing happens until the next batch is due.
+  EXPECT_EQ(4, spooler.RunOnce(now_ + 6));
+  EXPECT_EQ(2U, spooler.sent.size());
+
+  EXPECT_EQ(10, spooler.RunOnce(now_ + 10));
+  ASSERT_EQ(4U, spooler.sent.size());
+  EXPECT_EQ("d.dmp", spooler.sent[2]);
+  EXPECT_EQ("e.dmp", spooler.sent[3]);
+
+  EXPECT_EQ(10, spooler.RunOnce(now_ + 20));
+  ASSERT_EQ(5U, spooler.sent.size());
+  EXPECT_EQ("f.dmp", spooler.sent[4]);
+  EXPECT_TRUE(Exists("notes.txt"));
+
+  // A repeat of a recently uploaded crash is dropped, until the upload
+  // is old enough to be forgotten.
+  spooler.signatures["g.dmp"] = "crash 2";
+  AddDump("g.dmp", 60);
+  spooler.RunOnce(now_ + 30);
+  EXPECT_EQ(5U, spooler.sent.size());
+  EXPECT_FALSE(Exists("g.dmp"));
+  EXPECT_EQ(2, spooler.duplicates());
+
+  spooler.signatures["h.dmp"] = "crash 2";
+  AddDump("h.dmp", 60);
+  spooler.RunOnce(now_ + 1000);
+  ASSERT_EQ(6U, spooler.sent.size());
+  EXPECT_EQ("h.dmp", spooler.sent[5]);
+  EXPECT_EQ(6, spooler.uploaded());
+}
+
+TEST_F(CrashReportSpoolerTest, BacksOffAfterFailures) {
+  TestSpooler spooler(options_);
+  AddDump("a.dmp", 60);
+  AddDump("b.dmp", 50);
+
+  // A 404 rejects the dump for good; a 503 is retried later.
+  spooler.response_codes.push_back(404);
+  spooler.response_codes.push_back(503);
+  EXPECT_EQ(30, spooler.RunOnce(now_));
+  EXPECT_FALSE(Exists("a.dmp"));
+  EXPECT_TRUE(Exists("a.dmp.rejected"));
+  EXPECT_TRUE(Exists("b.dmp"));
+  EXPECT_EQ(1, spooler.rejected());
+  EXPECT_EQ(1, spooler.failures());
+
+  spooler.response_codes.push_back(503);
+  EXPECT_EQ(60, spooler.RunOnce(now_ + 30));
+  spooler.response_codes.push_back(0);
+  EXPECT_EQ(100, spooler.RunOnce(now_ + 90));
+  spooler.response_codes.push_back(503);
+  EXPECT_EQ(100, spooler.RunOnce(now_ + 190));
+  EXPECT_EQ(4, spooler.failures());
+  EXPECT_TRUE(Exists("b.dmp"));
+
+  EXPECT_EQ(10, spooler.RunOnce(now_ + 290));
+  EXPECT_FALSE(Exists("b.dmp"));
+  EXPECT_EQ(1, spooler.uploaded());
+  EXPECT_EQ(6U, spooler.sent.size());
+}
+
+TEST(CrashReportSpoolerSignatureTest, Minidump) {
+  const char *srcdir = getenv("srcdir");
+  string path = string(srcdir ? srcdir : ".") +
+                "/src/processor/testdata/linux_null_read_av.dmp";
+  EXPECT_EQ("0000000b|null_read_av|0x2170",
+            CrashReportSpooler::GetMinidumpSignature(path));
+  EXPECT_EQ("", CrashReportSpooler::GetMinidumpSignature(path + ".missing"));
+}
+
+}  // namespace
@@ -29,21 +29,190 @@
 
 #include "common/linux/crc32.h"
 
+#include <pthread.h>
+#include <string.h>
+
+#if defined(__aarch64__) && defined(__ARM_FEATURE_CRC32)
+#include <arm_acle.h>
+#define CRC32_ARM64 1
+#elif defined(__GNUC__) && !defined(__ANDROID__) && \
+    (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define CRC32_PCLMUL 1
+#endif
+
 namespace google_breakpad {
 
-// This implementation is based on the sample implementation in RFC 1952.
+// The portable implementation is based on the sample implementation in
+// RFC 1952, extended to consume eight bytes per step ("slicing-by-8"):
+// kCrc32Table[k][b] is the CRC of byte b followed by k zero bytes, so the
+// contributions of eight consecutive bytes can be looked up independently
+// and combined with XOR.
+//
+// All of the implementations below operate on the CRC with its pre- and
+// post-conditioning (the inversions) removed; UpdateCrc32 applies those.
+
+namespace {
 
 // CRC32 polynomial, in reversed form.
 // See RFC 1952, or http://en.wikipedia.org/wiki/Cyclic_redundancy_check
-static const uint32_t kCrc32Polynomial = 0xEDB88320;
-static uint32_t kCrc32Table[256] = { 0 };
+const uint32_t kCrc32Polynomial = 0xEDB88320;
+
+uint32_t kCrc32Table[8][256];
+
+typedef uint32_t (*Crc32Function)(uint32_t crc, const uint8_t* buf,
+                                  size_t len);
+
+// The implementation chosen for the running processor.
+Crc32Function update_crc32;
+
+pthread_once_t crc32_once = PTHREAD_ONCE_INIT;
+
+uint32_t UpdateCrc32Bytewise(uint32_t c, const uint8_t* u, size_t len) {
+  for (size_t i = 0; i < len; ++i)
+    c = kCrc32Table[0][(c ^ u[i]) & 0xFF] ^ (c >> 8);
+  return c;
+}
+
+uint32_t UpdateCrc32SliceBy8(uint32_t c, const uint8_t* u, size_t len) {
+  while (len >= 8) {
+    // Assemble the words bytewise: this is endian-neutral, and compilers
+    // turn it into plain loads on little-endian targets.
+    uint32_t low = c ^ (u[0] | u[1] << 8 | u[2] << 16 |
+                        static_cast<uint32_t>(u[3]) << 24);
+    uint32_t high = u[4] | u[5] << 8 | u[6] << 16 |
+                    static_cast<uint32_t>(u[7]) << 24;
+    c = kCrc32Table[7][low & 0xFF] ^
+        kCrc32Table[6][(low >> 8) & 0xFF] ^
+        kCrc32Table[5][(low >> 16) & 0xFF] ^
+        kCrc32Table[4][low >> 24] ^
+        kCrc32Table[3][high & 0xFF] ^
+        kCrc32Table[2][(high >> 8) & 0xFF] ^
+        kCrc32Table[1][(high >> 16) & 0xFF] ^
+        kCrc32Table[0][high >> 24];
+    u += 8;
+    len -= 8;
+  }
+  return UpdateCrc32Bytewise(c, u, len);
+}
+
+#if defined(CRC32_ARM64)
+
+uint32_t UpdateCrc32Arm64(uint32_t c, const uint8_t* u, size_t len) {
+  while (len >= 8) {
+    uint64_t word;
+    memcpy(&word, u, sizeof(word));
+    c = __crc32d(c, word);
+    u += 8;
+    len -= 8;
+  }
+  while (len--)
+    c = __crc32b(c, *u++);
+  return c;
+}
+
+#elif defined(CRC32_PCLMUL)
+
+// Fold the buffer with carry-less multiplication, as described in
+// "Fast CRC Computation for Generic Polynomials Using PCLMULQDQ
+// Instruction", V. Gopal, E. Ozturk, et al., Intel, 2009. The constants
+// are powers of x modulo the bit-reflected polynomial. LEN must be at
+// least 64 and a multiple of 16.
+__attribute__((target("sse4.1,pclmul")))
+uint32_t FoldCrc32Pclmul(uint32_t crc, const uint8_t* buf, size_t len) {
+  const __m128i k1k2 = _mm_set_epi64x(0x01c6e41596LL, 0x0154442bd4LL);
+  const __m128i k3k4 = _mm_set_epi64x(0x00ccaa009eLL, 0x01751997d0LL);
+  const __m128i k5k0 = _mm_set_epi64x(0, 0x0163cd6124LL);
+  const __m128i poly = _mm_set_epi64x(0x01f7011641LL, 0x01db710641LL);
+  __m128i x0, x1, x2, x3, x4, x5, x6, x7, x8;
 
-#define arraysize(f) (sizeof(f) / sizeof(*f))
+  x1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(buf + 0x00));
+  x2 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(buf + 0x10));
+  x3 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(buf + 0x20));
+  x4 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(buf + 0x30));
+  x1 = _mm_xor_si128(x1, _mm_cvtsi32_si128(crc));
+  buf += 64;
+  len -= 64;
 
-static void EnsureCrc32TableInited() {
-  if (kCrc32Table[arraysize(kCrc32Table) - 1])
-    return;  // already inited
-  for (uint32_t i = 0; i < arraysize(kCrc32Table); ++i) {
+  // Fold four 128-bit lanes in parallel, 64 bytes at a time.
+  x0 = k1k2;
+  while (len >= 64) {
+    x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+    x6 = _mm_clmulepi64_si128(x2, x0, 0x00);
+    x7 = _mm_clmulepi64_si128(x3, x0, 0x00);
+    x8 = _mm_clmulepi64_si128(x4, x0, 0x00);
+    x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+    x2 = _mm_clmulepi64_si128(x2, x0, 0x11);
+    x3 = _mm_clmulepi64_si128(x3, x0, 0x11);
+    x4 = _mm_clmulepi64_si128(x4, x0, 0x11);
+    x1 = _mm_xor_si128(_mm_xor_si128(x1, x5), _mm_loadu_si128(
+        reinterpret_cast<const __m128i*>(buf + 0x00)));
+    x2 = _mm_xor_si128(_mm_xor_si128(x2, x6), _mm_loadu_si128(
+        reinterpret_cast<const __m128i*>(buf + 0x10)));
+    x3 = _mm_xor_si128(_mm_xor_si128(x3, x7), _mm_loadu_si128(
+        reinterpret_cast<const __m128i*>(buf + 0x20)));
+    x4 = _mm_xor_si128(_mm_xor_si128(x4, x8), _mm_loadu_si128(
+        reinterpret_cast<const __m128i*>(buf + 0x30)));
+    buf += 64;
+    len -= 64;
+  }
+
+  // Fold the four lanes into one.
+  x0 = k3k4;
+  x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+  x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+  x1 = _mm_xor_si128(_mm_xor_si128(x1, x2), x5);
+  x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+  x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+  x1 = _mm_xor_si128(_mm_xor_si128(x1, x3), x5);
+  x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+  x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+  x1 = _mm_xor_si128(_mm_xor_si128(x1, x4), x5);
+
+  // Fold in any remaining 16-byte blocks.
+  while (len >= 16) {
+    x2 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(buf));
+    x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+    x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+    x1 = _mm_xor_si128(_mm_xor_si128(x1, x2), x5);
+    buf += 16;
+    len -= 16;
+  }
+
+  // Fold 128 bits down to 64.
+  x2 = _mm_clmulepi64_si128(x1, x0, 0x10);
+  x3 = _mm_setr_epi32(~0, 0, ~0, 0);
+  x1 = _mm_xor_si128(_mm_srli_si128(x1, 8), x2);
+  x0 = k5k0;
+  x2 = _mm_srli_si128(x1, 4);
+  x1 = _mm_and_si128(x1, x3);
+  x1 = _mm_clmulepi64_si128(x1, x0, 0x00);
+  x1 = _mm_xor_si128(x1, x2);
+
+  // Barrett reduction to 32 bits.
+  x0 = poly;
+  x2 = _mm_and_si128(x1, x3);
+  x2 = _mm_clmulepi64_si128(x2, x0, 0x10);
+  x2 = _mm_and_si128(x2, x3);
+  x2 = _mm_clmulepi64_si128(x2, x0, 0x00);
+  x1 = _mm_xor_si128(x1, x2);
+  return _mm_extract_epi32(x1, 1);
+}
+
+uint32_t UpdateCrc32Pclmul(uint32_t c, const uint8_t* u, size_t len) {
+  if (len >= 64) {
+    size_t fold_len = len & ~static_cast<size_t>(15);
+    c = FoldCrc32Pclmul(c, u, fold_len);
+    u += fold_len;
+    len -= fold_len;
+  }
+  return UpdateCrc32SliceBy8(c, u, len);
+}
+
+#endif
+
+void InitCrc32() {
+  for (uint32_t i = 0; i < 256; ++i) {
     uint32_t c = i;
     for (size_t j = 0; j < 8; ++j) {
       if (c & 1) {
@@ -52,18 +221,31 @@ static void EnsureCrc32TableInited() {
         c >>= 1;
       }
     }
-    kCrc32Table[i] = c;
+    kCrc32Table[0][i] = c;
+  }
+  for (uint32_t i = 0; i < 256; ++i) {
+    for (size_t k = 1; k < 8; ++k) {
+      uint32_t c = kCrc32Table[k - 1][i];
+      kCrc32Table[k][i] = kCrc32Table[0][c & 0xFF] ^ (c >> 8);
+    }
   }
+
+  update_crc32 = UpdateCrc32SliceBy8;
+#if defined(CRC32_ARM64)
+  update_crc32 = UpdateCrc32Arm64;
+#elif defined(CRC32_PCLMUL)
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("pclmul") && __builtin_cpu_supports("sse4.1"))
+    update_crc32 = UpdateCrc32Pclmul;
+#endif
 }
 
-uint32_t UpdateCrc32(uint32_t start, const void* buf, size_t len) {
-  EnsureCrc32TableInited();
+}  // namespace
 
+uint32_t UpdateCrc32(uint32_t start, const void* buf, size_t len) {
+  pthread_once(&crc32_once, InitCrc32);
   uint32_t c = start ^ 0xFFFFFFFF;
-  const uint8_t* u = static_cast<const uint8_t*>(buf);
-  for (size_t i = 0; i < len; ++i) {
-    c = kCrc32Table[(c ^ u[i]) & 0xFF] ^ (c >> 8);
-  }
+  c = update_crc32(c, static_cast<const uint8_t*>(buf), len);
   return c ^ 0xFFFFFFFF;
 }
 
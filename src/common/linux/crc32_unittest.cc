@@ -0,0 +1,97 @@
+// Copyright (c) 2016 Google Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+// notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above
+// copyright notice, this list of conditions and the following disclaimer
+// in the documentation and/or other materials provided with the
+// distribution.
+//     * Neither the name of Google Inc. nor the names of its
+// contributors may be used to endorse or promote products derived from
+// this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+// crc32_unittest.cc: Unit tests for google_breakpad::UpdateCrc32.
+
+#include <stdint.h>
+#include <string.h>
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "breakpad_googletest_includes.h"
+#include "common/linux/crc32.h"
+
+namespace {
+
+using google_breakpad::ComputeCrc32;
+using google_breakpad::UpdateCrc32;
+
+// A bit-at-a-time CRC-32, to check the table-driven and hardware
+// implementations against.
+uint32_t ReferenceCrc32(uint32_t start, const uint8_t* buf, size_t len) {
+  uint32_t c = ~start;
+  for (size_t i = 0; i < len; ++i) {
+    c ^= buf[i];
+    for (int j = 0; j < 8; ++j)
+      c = (c & 1) ? 0xEDB88320 ^ (c >> 1) : c >> 1;
+  }
+  return ~c;
+}
+
+TEST(Crc32, KnownValues) {
+  EXPECT_EQ(0U, ComputeCrc32("", 0));
+  EXPECT_EQ(0xCBF43926U, ComputeCrc32(std::string("123456789")));
+  EXPECT_EQ(0x414FA339U,
+            ComputeCrc32("The quick brown fox jumps over the lazy dog", 43));
+}
+
+// Different lengths and alignments take different paths through the
+// implementation; check they all agree with the reference.
+TEST(Crc32, LengthsAndAlignments) {
+  std::vector<uint8_t> data(1024);
+  uint32_t seed = 0x2545F491;
+  for (size_t i = 0; i < data.size(); ++i) {
+    seed = seed * 1103515245 + 12345;
+    data[i] = seed >> 24;
+  }
+  for (size_t offset = 0; offset < 16; ++offset) {
+    for (size_t len = 0; len + offset <= data.size(); len += 7) {
+      ASSERT_EQ(ReferenceCrc32(0x1234, &data[offset], len),
+                UpdateCrc32(0x1234, &data[offset], len))
+          << "offset " << offset << ", length " << len;
+    }
+  }
+}
+
+TEST(Crc32, Incremental) {
+  std::vector<uint8_t> data(4096);
+  for (size_t i = 0; i < data.size(); ++i)
+    data[i] = i * 31 + (i >> 8);
+  uint32_t whole = ComputeCrc32(&data[0], data.size());
+  uint32_t pieces = 0;
+  for (size_t i = 0; i < data.size(); i += 100) {
+    size_t len = std::min(static_cast<size_t>(100), data.size() - i);
+    pieces = UpdateCrc32(pieces, &data[i], len);
+  }
+  EXPECT_EQ(whole, pieces);
+}
+
+}  // namespace
@@ -35,18 +35,23 @@
 #include "common/linux/dump_symbols.h"
 
 #include <assert.h>
+#include <dirent.h>
 #include <elf.h>
 #include <errno.h>
 #include <fcntl.h>
 #include <link.h>
+#include <pthread.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <sys/mman.h>
 #include <sys/stat.h>
+#include <time.h>
 #include <unistd.h>
+#include <zlib.h>
 
 #include <iostream>
+#include <map>
 #include <set>
 #include <string>
 #include <utility>
@@ -55,10 +60,12 @@
 #include "common/dwarf/bytereader-inl.h"
 #include "common/dwarf/dwarf2diehandler.h"
 #include "common/dwarf_cfi_to_module.h"
+#include "common/dwarf_cu_cache.h"
 #include "common/dwarf_cu_to_module.h"
 #include "common/dwarf_line_to_module.h"
 #include "common/linux/crc32.h"
 #include "common/linux/eintr_wrapper.h"
+#include "common/linux/elf_section_index.h"
 #include "common/linux/elfutils.h"
 #include "common/linux/elfutils-inl.h"
 #include "common/linux/elf_symbols_to_module.h"
@@ -75,13 +82,15 @@
 namespace {
 
 using google_breakpad::DumpOptions;
+using google_breakpad::DumpStatistics;
 using google_breakpad::DwarfCFIToModule;
+using google_breakpad::DwarfCUCache;
 using google_breakpad::DwarfCUToModule;
 using google_breakpad::DwarfLineToModule;
 using google_breakpad::ElfClass;
 using google_breakpad::ElfClass32;
 using google_breakpad::ElfClass64;
-using google_breakpad::FindElfSectionByName;
+using google_breakpad::ElfSectionIndex;
 using google_breakpad::GetOffset;
 using google_breakpad::IsValidElf;
 using google_breakpad::Module;
@@ -95,6 +104,15 @@ using google_breakpad::scoped_ptr;
 #define EM_AARCH64      183
 #endif
 
+// Define the compressed section flag and type if the host's elf.h predates
+// them.
+#ifndef SHF_COMPRESSED
+#define SHF_COMPRESSED  (1 << 11)
+#endif
+#ifndef ELFCOMPRESS_ZLIB
+#define ELFCOMPRESS_ZLIB 1
+#endif
+
 //
 // FDWrapper
 //
@@ -152,6 +170,303 @@ class MmapWrapper {
   size_t size_;
 };
 
+// Return the time of CLOCK_MONOTONIC, in nanoseconds.
+uint64_t MonotonicNanoseconds() {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return static_cast<uint64_t>(now.tv_sec) * 1000000000 + now.tv_nsec;
+}
+
+// Return the member PHASE of OPTIONS' statistics, or NULL if OPTIONS
+// doesn't ask for statistics.
+uint64_t* Phase(const DumpOptions& options, uint64_t DumpStatistics::*phase) {
+  return options.statistics ? &(options.statistics->*phase) : NULL;
+}
+
+//
+// PhaseTimer
+//
+// Adds the time from its construction to its destruction to *TOTAL, if
+// TOTAL is not NULL.
+//
+class PhaseTimer {
+ public:
+  explicit PhaseTimer(uint64_t* total)
+      : total_(total), start_(total ? MonotonicNanoseconds() : 0) {}
+  ~PhaseTimer() {
+    if (total_)
+      *total_ += MonotonicNanoseconds() - start_;
+  }
+
+ private:
+  uint64_t* total_;
+  uint64_t start_;
+};
+
+// Inflate the zlib stream of INPUT_SIZE bytes at INPUT into OUTPUT, which
+// must already have the uncompressed size. Return false if the stream is
+// malformed or does not inflate to exactly that size.
+bool InflateZlibStream(const char* input, uint64_t input_size,
+                       std::vector<char>* output) {
+  z_stream stream;
+  memset(&stream, 0, sizeof(stream));
+  if (inflateInit(&stream) != Z_OK)
+    return false;
+
+  // zlib counts in uInt, so feed sections larger than that in pieces.
+  const uint64_t kPiece = 1 << 30;
+  uint64_t input_left = input_size;
+  uint64_t output_left = output->size();
+  stream.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(input));
+  stream.next_out = reinterpret_cast<Bytef*>(output->empty() ? NULL :
+                                             &(*output)[0]);
+  int result;
+  do {
+    if (stream.avail_in == 0 && input_left > 0) {
+      stream.avail_in = static_cast<uInt>(std::min(input_left, kPiece));
+      input_left -= stream.avail_in;
+    }
+    if (stream.avail_out == 0 && output_left > 0) {
+      stream.avail_out = static_cast<uInt>(std::min(output_left, kPiece));
+      output_left -= stream.avail_out;
+    }
+    result = inflate(&stream, Z_NO_FLUSH);
+  } while (result == Z_OK);
+  inflateEnd(&stream);
+  return result == Z_STREAM_END &&
+         stream.avail_out == 0 && output_left == 0;
+}
+
+// A compressed section's zlib stream, and the buffer to inflate it into.
+struct InflateJob {
+  const char* stream;
+  uint64_t stream_size;
+  std::vector<char>* output;
+  bool inflated;
+};
+
+// The state shared by threads inflating sections in parallel. Each thread
+// takes the next job until there are none left.
+struct ParallelInflater {
+  std::vector<InflateJob> jobs;
+  pthread_mutex_t mutex;
+  size_t next;
+};
+
+void* InflateSections(void* arg) {
+  ParallelInflater* state = static_cast<ParallelInflater*>(arg);
+  for (;;) {
+    pthread_mutex_lock(&state->mutex);
+    size_t index = state->next;
+    if (index < state->jobs.size())
+      state->next++;
+    pthread_mutex_unlock(&state->mutex);
+    if (index >= state->jobs.size())
+      break;
+
+    InflateJob& job = state->jobs[index];
+    job.inflated = InflateZlibStream(job.stream, job.stream_size,
+                                     job.output);
+  }
+  return NULL;
+}
+
+//
+// ElfSectionContents
+//
+// Finds an ELF file's sections and their contents, inflating compressed
+// debugging sections into buffers that live as long as this object.
+// Sections may be compressed either with the SHF_COMPRESSED flag and an
+// ELF compression header, or by the older convention of a ".zdebug_"
+// name and a "ZLIB" header; the latter are known here by their ".debug_"
+// names.
+//
+template<typename ElfClass>
+class ElfSectionContents {
+ public:
+  typedef typename ElfClass::Ehdr Ehdr;
+  typedef typename ElfClass::Shdr Shdr;
+  typedef typename ElfClass::Word Word;
+
+  ElfSectionContents(const string& obj_file, const Ehdr* elf_header,
+                     const ElfSectionIndex& index)
+      : obj_file_(obj_file),
+        elf_header_(elf_header),
+        index_(index),
+        sections_(GetOffset<ElfClass, Shdr>(elf_header,
+                                            elf_header->e_shoff)) {
+    const Shdr* section_names = sections_ + elf_header->e_shstrndx;
+    names_ = GetOffset<ElfClass, char>(elf_header, section_names->sh_offset);
+  }
+
+  int count() const { return elf_header_->e_shnum; }
+  const Shdr* section(int i) const { return sections_ + i; }
+
+  // Return SECTION's name, with a ".zdebug_" prefix changed to ".debug_".
+  string Name(const Shdr* section) const {
+    const char* name = names_ + section->sh_name;
+    if (strncmp(name, ".zdebug_", 8) == 0)
+      return string(".") + (name + 2);
+    return name;
+  }
+
+  // Return the section of type TYPE with the given NAME, as
+  // FindElfSectionByName does, or a ".zdebug_" section of that type that
+  // goes by NAME.
+  const Shdr* Find(const char* name, Word type) const {
+    int i = index_.Find(name, type);
+    if (i < 0 && strncmp(name, ".debug_", 7) == 0) {
+      string zname = string(".z") + (name + 1);
+      i = index_.Find(zname.c_str(), type);
+    }
+    return i < 0 ? NULL : sections_ + i;
+  }
+
+  // Ask the kernel to start reading SECTIONS' contents into memory, in
+  // the order given, without waiting for it to. On filesystems where a
+  // page fault is a round trip to a server, this keeps the reads ahead of
+  // the parser rather than taking one fault at a time as it goes.
+  void Prefetch(const std::vector<const Shdr*>& sections) const {
+    const uintptr_t page_size = sysconf(_SC_PAGESIZE);
+    for (size_t i = 0; i < sections.size(); i++) {
+      const Shdr* section = sections[i];
+      if (!section || section->sh_type == SHT_NOBITS || section->sh_size == 0)
+        continue;
+      uintptr_t start = reinterpret_cast<uintptr_t>(elf_header_) +
+                        section->sh_offset;
+      uintptr_t end = start + section->sh_size;
+      start &= ~(page_size - 1);
+      // This is only advice; a failure costs nothing but the prefetch.
+      madvise(reinterpret_cast<void*>(start), end - start, MADV_WILLNEED);
+    }
+  }
+
+  // Return true if SECTION holds compressed data.
+  bool IsCompressed(const Shdr* section) const {
+    return section->sh_type != SHT_NOBITS &&
+           ((section->sh_flags & SHF_COMPRESSED) ||
+            strncmp(names_ + section->sh_name, ".zdebug_", 8) == 0);
+  }
+
+  // Inflate those of SECTIONS that are compressed, one section per
+  // thread on up to NUM_THREADS threads. Sections that can't be
+  // inflated are reported, and Get then fails for them.
+  void Inflate(const std::vector<const Shdr*>& sections, int num_threads) {
+    ParallelInflater state;
+    std::vector<const Shdr*> queued;
+    for (size_t i = 0; i < sections.size(); i++) {
+      const Shdr* section = sections[i];
+      if (!IsCompressed(section) || inflated_.count(section))
+        continue;
+      InflateJob job;
+      uint64_t size;
+      if (!ReadCompressionHeader(section, &job.stream, &job.stream_size,
+                                 &size)) {
+        fprintf(stderr, "%s: section '%s' has an unsupported compression"
+                " header\n", obj_file_.c_str(), names_ + section->sh_name);
+        continue;
+      }
+      job.output = &inflated_[section];
+      job.output->resize(size);
+      job.inflated = false;
+      state.jobs.push_back(job);
+      queued.push_back(section);
+    }
+
+    state.next = 0;
+    pthread_mutex_init(&state.mutex, NULL);
+    if (static_cast<size_t>(num_threads) > state.jobs.size())
+      num_threads = state.jobs.size();
+    std::vector<pthread_t> threads;
+    for (int i = 1; i < num_threads; i++) {
+      pthread_t thread;
+      if (pthread_create(&thread, NULL, InflateSections, &state) != 0)
+        break;
+      threads.push_back(thread);
+    }
+    InflateSections(&state);
+    for (size_t i = 0; i < threads.size(); i++)
+      pthread_join(threads[i], NULL);
+    pthread_mutex_destroy(&state.mutex);
+
+    for (size_t i = 0; i < queued.size(); i++) {
+      if (!state.jobs[i].inflated) {
+        fprintf(stderr, "%s: section '%s' could not be decompressed\n",
+                obj_file_.c_str(), names_ + queued[i]->sh_name);
+        inflated_.erase(queued[i]);
+      }
+    }
+  }
+
+  // Set *CONTENTS and *SIZE to SECTION's contents, inflated if it is
+  // compressed. Return false if it is compressed but has not been
+  // inflated.
+  bool Get(const Shdr* section, const char** contents, uint64_t* size) const {
+    if (!IsCompressed(section)) {
+      *contents = GetOffset<ElfClass, char>(elf_header_, section->sh_offset);
+      *size = section->sh_size;
+      return true;
+    }
+    typename std::map<const Shdr*, std::vector<char> >::const_iterator it =
+        inflated_.find(section);
+    if (it == inflated_.end())
+      return false;
+    *contents = it->second.empty() ? NULL : &it->second[0];
+    *size = it->second.size();
+    return true;
+  }
+
+ private:
+  // Find the zlib stream in the compressed SECTION and the size it
+  // inflates to. Return false if the header is truncated or names a
+  // compression other than zlib.
+  bool ReadCompressionHeader(const Shdr* section, const char** stream,
+                             uint64_t* stream_size, uint64_t* size) const {
+    const char* contents =
+        GetOffset<ElfClass, char>(elf_header_, section->sh_offset);
+    uint64_t header_size;
+    if (section->sh_flags & SHF_COMPRESSED) {
+      // An ElfN_Chdr, in the file's byte order: a 32-bit type, padding on
+      // 64-bit files, and then the address-sized uncompressed size.
+      header_size = ElfClass::kAddrSize == 4 ? 12 : 24;
+      if (section->sh_size < header_size)
+        return false;
+      uint32_t type;
+      memcpy(&type, contents, sizeof(type));
+      if (type != ELFCOMPRESS_ZLIB)
+        return false;
+      if (ElfClass::kAddrSize == 4) {
+        uint32_t size32;
+        memcpy(&size32, contents + 4, sizeof(size32));
+        *size = size32;
+      } else {
+        memcpy(size, contents + 8, sizeof(*size));
+      }
+    } else {
+      // "ZLIB", followed by the uncompressed size as a big-endian 64-bit
+      // number.
+      header_size = 12;
+      if (section->sh_size < header_size || memcmp(contents, "ZLIB", 4) != 0)
+        return false;
+      *size = 0;
+      for (int i = 4; i < 12; i++)
+        *size = (*size << 8) | static_cast<unsigned char>(contents[i]);
+    }
+    *stream = contents + header_size;
+    *stream_size = section->sh_size - header_size;
+    return true;
+  }
+
+  const string& obj_file_;
+  const Ehdr* elf_header_;
+  const ElfSectionIndex& index_;
+  const Shdr* sections_;
+  const char* names_;
+
+  // The inflated contents of compressed sections.
+  std::map<const Shdr*, std::vector<char> > inflated_;
+};
+
 // Find the preferred loading address of the binary.
 template<typename ElfClass>
 typename ElfClass::Addr GetLoadingAddress(
@@ -201,34 +516,231 @@ bool LoadStabs(const typename ElfClass::Ehdr* elf_header,
 #endif  // NO_STABS_SUPPORT
 
 // A line-to-module loader that accepts line number info parsed by
-// dwarf2reader::LineInfo and populates a Module and a line vector
-// with the results.
+// dwarf2reader::LineInfo and populates a Module and a line vector,
+// or passes the lines to a sink, with the results.
 class DumperLineToModule: public DwarfCUToModule::LineToModuleHandler {
  public:
-  // Create a line-to-module converter using BYTE_READER.
-  explicit DumperLineToModule(dwarf2reader::ByteReader *byte_reader)
-      : byte_reader_(byte_reader) { }
+  // Create a line-to-module converter using BYTE_READER. If NANOSECONDS
+  // is not NULL, add the time spent handling line programs to it.
+  explicit DumperLineToModule(dwarf2reader::ByteReader *byte_reader,
+                              uint64_t* nanoseconds = NULL)
+      : byte_reader_(byte_reader), nanoseconds_(nanoseconds) { }
   void StartCompilationUnit(const string& compilation_dir) {
     compilation_dir_ = compilation_dir;
   }
   void ReadProgram(const char* program, uint64 length,
                    Module* module, std::vector<Module::Line>* lines) {
+    PhaseTimer timer(nanoseconds_);
     DwarfLineToModule handler(module, compilation_dir_, lines);
     dwarf2reader::LineInfo parser(program, length, byte_reader_, &handler);
     parser.Start();
   }
+  void StreamProgram(const char* program, uint64 length,
+                     Module* module, DwarfLineToModule::LineSink* sink) {
+    PhaseTimer timer(nanoseconds_);
+    DwarfLineToModule handler(module, compilation_dir_, sink);
+    dwarf2reader::LineInfo parser(program, length, byte_reader_, &handler);
+    parser.Start();
+  }
  private:
   string compilation_dir_;
   dwarf2reader::ByteReader *byte_reader_;
+  uint64_t* nanoseconds_;
 };
 
+// Set OFFSETS to the offsets of the compilation units in the .debug_info
+// section DEBUG_INFO, of length LENGTH, by following the lengths in the
+// units' headers with BYTE_READER. Return false if the headers don't
+// exactly cover the section.
+bool FindCompilationUnits(const char* debug_info, uint64 length,
+                          const dwarf2reader::ByteReader* byte_reader,
+                          std::vector<uint64>* offsets) {
+  uint64 offset = 0;
+  while (offset < length) {
+    if (length - offset < 4)
+      return false;
+    uint64 unit_length = byte_reader->ReadFourBytes(debug_info + offset);
+    uint64 header_length = 4;
+    if (unit_length == 0xffffffff) {
+      if (length - offset < 12)
+        return false;
+      unit_length = byte_reader->ReadEightBytes(debug_info + offset + 4);
+      header_length = 12;
+    }
+    if (unit_length > length - offset - header_length)
+      return false;
+    offsets->push_back(offset);
+    offset += header_length + unit_length;
+  }
+  return true;
+}
+
+// The state shared by threads reading a file's compilation units in
+// parallel. Units are handed out in order; each is read into a Module of
+// its own, which is then merged into the file's Module in order.
+struct ParallelDwarfReader {
+  DwarfCUToModule::FileContext* file_context;
+  dwarf2reader::CompilationUnit::AbbrevCache* abbrev_cache;
+  const string* dwarf_filename;
+  dwarf2reader::Endianness endianness;
+  Module* module;
+  std::vector<uint64> offsets;
+  // If not NULL, each thread adds the time it spent on line programs to
+  // this, under MUTEX.
+  uint64_t* line_nanoseconds;
+  // If not NULL, units found here are not read, and the others are added
+  // to it.
+  DwarfCUCache* cu_cache;
+  // The number of units found in CU_CACHE, counted under MUTEX.
+  uint64_t cached_units;
+
+  pthread_mutex_t mutex;
+  // Signaled whenever an element of RESULTS is set.
+  pthread_cond_t result_ready;
+  // The index of the next compilation unit to read.
+  size_t next;
+  // The Module read from each compilation unit, or NULL if it isn't
+  // ready yet.
+  std::vector<Module*> results;
+};
+
+void* ReadCompilationUnits(void* arg) {
+  ParallelDwarfReader* state = static_cast<ParallelDwarfReader*>(arg);
+  dwarf2reader::ByteReader byte_reader(state->endianness);
+  uint64_t line_nanoseconds = 0;
+  DumperLineToModule line_to_module(
+      &byte_reader, state->line_nanoseconds ? &line_nanoseconds : NULL);
+  for (;;) {
+    pthread_mutex_lock(&state->mutex);
+    size_t index = state->next;
+    if (index < state->offsets.size())
+      state->next++;
+    pthread_mutex_unlock(&state->mutex);
+    if (index >= state->offsets.size())
+      break;
+
+    uint64 offset = state->offsets[index];
+    Module* cu_module = new Module(state->module->name(),
+                                   state->module->os(),
+                                   state->module->architecture(),
+                                   state->module->identifier());
+    string digest;
+    uint64 base = 0;
+    bool cached = false;
+    if (state->cu_cache &&
+        DwarfCUCache::DigestCompilationUnit(
+            state->file_context->section_map(), offset, &byte_reader,
+            state->abbrev_cache, &digest, &base)) {
+      cached = state->cu_cache->Read(digest, base, cu_module);
+    }
+    if (!cached) {
+      DwarfCUToModule::FileContext file_context(state->file_context,
+                                                cu_module);
+      DwarfCUToModule::WarningReporter reporter(*state->dwarf_filename,
+                                                offset);
+      DwarfCUToModule root_handler(&file_context, &line_to_module,
+                                   &reporter);
+      dwarf2reader::DIEDispatcher die_dispatcher(&root_handler);
+      dwarf2reader::CompilationUnit reader(file_context.section_map(),
+                                           offset,
+                                           &byte_reader,
+                                           &die_dispatcher);
+      reader.set_abbrev_cache(state->abbrev_cache);
+      reader.Start();
+    }
+    if (!cached && !digest.empty())
+      state->cu_cache->Write(digest, base, cu_module);
+    state->file_context->CompilationUnitDone(offset);
+
+    pthread_mutex_lock(&state->mutex);
+    if (cached)
+      state->cached_units++;
+    state->results[index] = cu_module;
+    pthread_cond_broadcast(&state->result_ready);
+    pthread_mutex_unlock(&state->mutex);
+  }
+  if (state->line_nanoseconds) {
+    pthread_mutex_lock(&state->mutex);
+    *state->line_nanoseconds += line_nanoseconds;
+    pthread_mutex_unlock(&state->mutex);
+  }
+  return NULL;
+}
+
+// Read the compilation units at OFFSETS in FILE_CONTEXT's .debug_info
+// section into MODULE using up to NUM_THREADS threads. If
+// LINE_NANOSECONDS is not NULL, add the threads' time spent on line
+// programs to it. If CU_CACHE is not NULL, take the units it has from it
+// rather than reading them, add the others to it, and return the number
+// it had.
+uint64_t LoadDwarfInParallel(const string& dwarf_filename,
+                             dwarf2reader::Endianness endianness,
+                             const std::vector<uint64>& offsets,
+                             int num_threads,
+                             DwarfCUToModule::FileContext* file_context,
+                             dwarf2reader::CompilationUnit::AbbrevCache*
+                                 abbrev_cache,
+                             uint64_t* line_nanoseconds,
+                             DwarfCUCache* cu_cache,
+                             Module* module) {
+  ParallelDwarfReader state;
+  state.file_context = file_context;
+  state.abbrev_cache = abbrev_cache;
+  state.dwarf_filename = &dwarf_filename;
+  state.endianness = endianness;
+  state.module = module;
+  state.offsets = offsets;
+  state.line_nanoseconds = line_nanoseconds;
+  state.cu_cache = cu_cache;
+  state.cached_units = 0;
+  state.next = 0;
+  state.results.assign(offsets.size(), NULL);
+  pthread_mutex_init(&state.mutex, NULL);
+  pthread_cond_init(&state.result_ready, NULL);
+  file_context->SetCompilationUnitOffsets(offsets);
+
+  if (static_cast<size_t>(num_threads) > offsets.size())
+    num_threads = offsets.size();
+  std::vector<pthread_t> threads;
+  for (int i = 0; i < num_threads; i++) {
+    pthread_t thread;
+    if (pthread_create(&thread, NULL, ReadCompilationUnits, &state) != 0)
+      break;
+    threads.push_back(thread);
+  }
+
+  // If no threads could be started, read everything on this one.
+  if (threads.empty())
+    ReadCompilationUnits(&state);
+
+  // Merge the units' functions in order, as they become ready, so that
+  // duplicates are resolved the same way as when reading sequentially.
+  for (size_t i = 0; i < offsets.size(); i++) {
+    pthread_mutex_lock(&state.mutex);
+    while (!state.results[i])
+      pthread_cond_wait(&state.result_ready, &state.mutex);
+    Module* cu_module = state.results[i];
+    pthread_mutex_unlock(&state.mutex);
+    module->TakeFunctions(cu_module);
+    delete cu_module;
+  }
+  for (size_t i = 0; i < threads.size(); i++)
+    pthread_join(threads[i], NULL);
+
+  pthread_cond_destroy(&state.result_ready);
+  pthread_mutex_destroy(&state.mutex);
+  return state.cached_units;
+}
+
 template<typename ElfClass>
 bool LoadDwarf(const string& dwarf_filename,
-               const typename ElfClass::Ehdr* elf_header,
+               const ElfSectionContents<ElfClass>& sections,
                const bool big_endian,
                bool handle_inter_cu_refs,
+               int num_threads,
+               DwarfCUCache* cu_cache,
+               DumpStatistics* statistics,
                Module* module) {
-  typedef typename ElfClass::Shdr Shdr;
 
   const dwarf2reader::Endianness endianness = big_endian ?
       dwarf2reader::ENDIANNESS_BIG : dwarf2reader::ENDIANNESS_LITTLE;
@@ -239,32 +751,58 @@ bool LoadDwarf(const string& dwarf_filename,
                                             module,
                                             handle_inter_cu_refs);
 
-  // Build a map of the ELF file's sections.
-  const Shdr* sections =
-      GetOffset<ElfClass, Shdr>(elf_header, elf_header->e_shoff);
-  int num_sections = elf_header->e_shnum;
-  const Shdr* section_names = sections + elf_header->e_shstrndx;
-  for (int i = 0; i < num_sections; i++) {
-    const Shdr* section = &sections[i];
-    string name = GetOffset<ElfClass, char>(elf_header,
-                                            section_names->sh_offset) +
-                  section->sh_name;
-    const char* contents = GetOffset<ElfClass, char>(elf_header,
-                                                     section->sh_offset);
-    file_context.AddSectionToSectionMap(name, contents, section->sh_size);
+  // Build a map of the ELF file's sections, leaving out compressed
+  // sections that weren't inflated.
+  for (int i = 0; i < sections.count(); i++) {
+    const char* contents;
+    uint64_t size;
+    if (sections.Get(sections.section(i), &contents, &size)) {
+      file_context.AddSectionToSectionMap(sections.Name(sections.section(i)),
+                                          contents, size);
+    }
   }
 
   // Parse all the compilation units in the .debug_info section.
-  DumperLineToModule line_to_module(&byte_reader);
+  uint64_t* line_nanoseconds = statistics ? &statistics->lines_ns : NULL;
+  DumperLineToModule line_to_module(&byte_reader, line_nanoseconds);
   dwarf2reader::SectionMap::const_iterator debug_info_entry =
       file_context.section_map().find(".debug_info");
-  assert(debug_info_entry != file_context.section_map().end());
+  // The section is missing if it was compressed and couldn't be inflated.
+  if (debug_info_entry == file_context.section_map().end())
+    return false;
   const std::pair<const char*, uint64>& debug_info_section =
       debug_info_entry->second;
   // This should never have been called if the file doesn't have a
   // .debug_info section.
   assert(debug_info_section.first);
   uint64 debug_info_length = debug_info_section.second;
+
+  // Compilation units often share abbreviation tables; parse each once.
+  dwarf2reader::CompilationUnit::AbbrevCache abbrev_cache;
+
+  // Units can only be cached if none refers to another's DIEs.
+  if (cu_cache && !DwarfCUCache::CanCache(file_context.section_map()))
+    cu_cache = NULL;
+
+  // If asked to, and the units' headers can be trusted, read the
+  // compilation units on several threads. Cached units are handled the
+  // same way, since each unit's functions must be kept apart.
+  std::vector<uint64> offsets;
+  if ((num_threads > 1 || cu_cache) &&
+      FindCompilationUnits(debug_info_section.first, debug_info_length,
+                           &byte_reader, &offsets) &&
+      (offsets.size() > 1 || cu_cache)) {
+    uint64_t cached_units =
+        LoadDwarfInParallel(dwarf_filename, endianness, offsets, num_threads,
+                            &file_context, &abbrev_cache, line_nanoseconds,
+                            cu_cache, module);
+    if (statistics) {
+      statistics->compilation_units += offsets.size();
+      statistics->cached_compilation_units += cached_units;
+    }
+    return true;
+  }
+
   for (uint64 offset = 0; offset < debug_info_length;) {
     // Make a handler for the root DIE that populates MODULE with the
     // data that was found.
@@ -277,8 +815,11 @@ bool LoadDwarf(const string& dwarf_filename,
                                          offset,
                                          &byte_reader,
                                          &die_dispatcher);
+    reader.set_abbrev_cache(&abbrev_cache);
     // Process the entire compilation unit; get the offset of the next.
     offset += reader.Start();
+    if (statistics)
+      statistics->compilation_units++;
   }
   return true;
 }
@@ -312,15 +853,51 @@ bool DwarfCFIRegisterNames(const typename ElfClass::Ehdr* elf_header,
   }
 }
 
+// The state shared by threads reading ranges of a CFI section in
+// parallel. Each range is read into a Module of its own.
+struct ParallelCFIReader {
+  const char* cfi;
+  size_t cfi_size;
+  bool eh_frame;
+  // A ByteReader with the section's bases set; each thread uses a copy.
+  const dwarf2reader::ByteReader* byte_reader;
+  const std::vector<string>* register_names;
+  DwarfCFIToModule::Reporter* module_reporter;
+  dwarf2reader::CallFrameInfo::Reporter* dwarf_reporter;
+  // The offsets at which the ranges begin, followed by the section size.
+  std::vector<size_t> offsets;
+  // The Module into which each range is read.
+  std::vector<Module*> modules;
+};
+
+// Read one range of a CFI section. ARG points to a pair of the shared
+// state and the index of the range.
+void* ReadCFIRange(void* arg) {
+  std::pair<ParallelCFIReader*, size_t>* range =
+      static_cast<std::pair<ParallelCFIReader*, size_t>*>(arg);
+  ParallelCFIReader* state = range->first;
+  size_t index = range->second;
+  dwarf2reader::ByteReader byte_reader(*state->byte_reader);
+  DwarfCFIToModule handler(state->modules[index], *state->register_names,
+                           state->module_reporter);
+  dwarf2reader::CallFrameInfo parser(state->cfi, state->cfi_size,
+                                     &byte_reader, &handler,
+                                     state->dwarf_reporter, state->eh_frame);
+  parser.StartRange(state->offsets[index], state->offsets[index + 1]);
+  return NULL;
+}
+
 template<typename ElfClass>
 bool LoadDwarfCFI(const string& dwarf_filename,
                   const typename ElfClass::Ehdr* elf_header,
+                  const ElfSectionContents<ElfClass>& sections,
                   const char* section_name,
                   const typename ElfClass::Shdr* section,
                   const bool eh_frame,
                   const typename ElfClass::Shdr* got_section,
                   const typename ElfClass::Shdr* text_section,
                   const bool big_endian,
+                  int num_threads,
                   Module* module) {
   // Find the appropriate set of register names for this file's
   // architecture.
@@ -336,9 +913,11 @@ bool LoadDwarfCFI(const string& dwarf_filename,
       dwarf2reader::ENDIANNESS_BIG : dwarf2reader::ENDIANNESS_LITTLE;
 
   // Find the call frame information and its size.
-  const char* cfi =
-      GetOffset<ElfClass, char>(elf_header, section->sh_offset);
-  size_t cfi_size = section->sh_size;
+  const char* cfi;
+  uint64_t section_size;
+  if (!sections.Get(section, &cfi, &section_size))
+    return false;
+  size_t cfi_size = section_size;
 
   // Plug together the parser, handler, and their entourages.
   DwarfCFIToModule::Reporter module_reporter(dwarf_filename, section_name);
@@ -360,7 +939,56 @@ bool LoadDwarfCFI(const string& dwarf_filename,
   dwarf2reader::CallFrameInfo parser(cfi, cfi_size,
                                      &byte_reader, &handler, &dwarf_reporter,
                                      eh_frame);
-  parser.Start();
+  // The ranges read in parallel are all held in memory until they are
+  // merged, so a module with a memory budget is read on one thread.
+  if (num_threads <= 1 || module->memory_budget()) {
+    parser.Start();
+    return true;
+  }
+
+  ParallelCFIReader state;
+  state.cfi = cfi;
+  state.cfi_size = cfi_size;
+  state.eh_frame = eh_frame;
+  state.byte_reader = &byte_reader;
+  state.register_names = &register_names;
+  state.module_reporter = &module_reporter;
+  state.dwarf_reporter = &dwarf_reporter;
+  parser.SplitEntries(num_threads, &state.offsets);
+  state.offsets.push_back(cfi_size);
+  for (size_t i = 0; i + 1 < state.offsets.size(); i++) {
+    state.modules.push_back(new Module(module->name(), module->os(),
+                                       module->architecture(),
+                                       module->identifier()));
+  }
+
+  // Read the first range on this thread, and the others on threads of
+  // their own.
+  std::vector<pthread_t> threads;
+  std::vector<std::pair<ParallelCFIReader*, size_t> > args;
+  for (size_t i = 0; i < state.modules.size(); i++)
+    args.push_back(std::make_pair(&state, i));
+  std::vector<bool> started(args.size(), false);
+  for (size_t i = 1; i < args.size(); i++) {
+    pthread_t thread;
+    if (pthread_create(&thread, NULL, ReadCFIRange, &args[i]) == 0) {
+      threads.push_back(thread);
+      started[i] = true;
+    }
+  }
+  for (size_t i = 0; i < args.size(); i++) {
+    if (!started[i])
+      ReadCFIRange(&args[i]);
+  }
+  for (size_t i = 0; i < threads.size(); i++)
+    pthread_join(threads[i], NULL);
+
+  // Merge the ranges' entries in order, so the symbol file is the same as
+  // when reading on one thread.
+  for (size_t i = 0; i < state.modules.size(); i++) {
+    module->TakeStackFrameEntries(state.modules[i]);
+    delete state.modules[i];
+  }
   return true;
 }
 
@@ -413,13 +1041,43 @@ bool ElfEndianness(const typename ElfClass::Ehdr* elf_header,
   return false;
 }
 
+// Set *CRC to the CRC-32 of the contents of the file open on FD. Map the
+// file if we can, since debug files can be large and the checksum then
+// runs straight over the page cache; otherwise, read it. Return false if
+// the file can't be read.
+bool FileCrc32(int fd, uint32_t* crc) {
+  struct stat st;
+  if (fstat(fd, &st) == 0 && st.st_size > 0) {
+    void* contents = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (contents != MAP_FAILED) {
+      madvise(contents, st.st_size, MADV_SEQUENTIAL);
+      *crc = google_breakpad::ComputeCrc32(contents, st.st_size);
+      munmap(contents, st.st_size);
+      return true;
+    }
+  }
+
+  *crc = 0;
+  while (true) {
+    const size_t kReadSize = 65536;
+    char buf[kReadSize];
+    ssize_t bytes_read = HANDLE_EINTR(read(fd, &buf, kReadSize));
+    if (bytes_read < 0)
+      return false;
+    if (bytes_read == 0)
+      return true;
+    *crc = google_breakpad::UpdateCrc32(*crc, buf, bytes_read);
+  }
+}
+
 // Read the .gnu_debuglink and get the debug file name. If anything goes
 // wrong, return an empty string.
 string ReadDebugLink(const char* debuglink,
                      const size_t debuglink_size,
                      const bool big_endian,
                      const string& obj_file,
-                     const std::vector<string>& debug_dirs) {
+                     const std::vector<string>& debug_dirs,
+                     google_breakpad::DebugDirectoryCache* cache) {
   size_t debuglink_len = strlen(debuglink) + 5;  // Include '\0' + CRC32.
   debuglink_len = 4 * ((debuglink_len + 3) / 4);  // Round up to 4 bytes.
 
@@ -436,6 +1094,8 @@ string ReadDebugLink(const char* debuglink,
   std::vector<string>::const_iterator it;
   for (it = debug_dirs.begin(); it < debug_dirs.end(); ++it) {
     const string& debug_dir = *it;
+    if (cache && !cache->MayContain(debug_dir, debuglink))
+      continue;
     debuglink_path = debug_dir + "/" + debuglink;
     debuglink_fd = open(debuglink_path.c_str(), O_RDONLY);
     if (debuglink_fd < 0)
@@ -450,19 +1110,11 @@ string ReadDebugLink(const char* debuglink,
     uint32_t expected_crc =
         byte_reader.ReadFourBytes(&debuglink[debuglink_size - 4]);
 
-    uint32_t actual_crc = 0;
-    while (true) {
-      const size_t kReadSize = 4096;
-      char buf[kReadSize];
-      ssize_t bytes_read = HANDLE_EINTR(read(debuglink_fd, &buf, kReadSize));
-      if (bytes_read < 0) {
-        fprintf(stderr, "Error reading debug ELF file %s.\n",
-                debuglink_path.c_str());
-        return string();
-      }
-      if (bytes_read == 0)
-        break;
-      actual_crc = google_breakpad::UpdateCrc32(actual_crc, buf, bytes_read);
+    uint32_t actual_crc;
+    if (!FileCrc32(debuglink_fd, &actual_crc)) {
+      fprintf(stderr, "Error reading debug ELF file %s.\n",
+              debuglink_path.c_str());
+      return string();
     }
     if (actual_crc != expected_crc) {
       fprintf(stderr, "Error reading debug ELF file - CRC32 mismatch: %s\n",
@@ -565,6 +1217,7 @@ template<typename ElfClass>
 bool LoadSymbols(const string& obj_file,
                  const bool big_endian,
                  const typename ElfClass::Ehdr* elf_header,
+                 const ElfSectionIndex& section_index,
                  const bool read_gnu_debug_link,
                  LoadSymbolsInfo<ElfClass>* info,
                  const DumpOptions& options,
@@ -584,26 +1237,68 @@ bool LoadSymbols(const string& obj_file,
       elf_header->e_machine == EM_MIPS ? SHT_MIPS_DWARF : SHT_PROGBITS;
   const Shdr* sections =
       GetOffset<ElfClass, Shdr>(elf_header, elf_header->e_shoff);
-  const Shdr* section_names = sections + elf_header->e_shstrndx;
-  const char* names =
-      GetOffset<ElfClass, char>(elf_header, section_names->sh_offset);
-  const char *names_end = names + section_names->sh_size;
   bool found_debug_info_section = false;
   bool found_usable_info = false;
 
+  // Find the DWARF sections this dump will read, and inflate those of
+  // them that are compressed.
+  ElfSectionContents<ElfClass> section_contents(obj_file, elf_header,
+                                                section_index);
+  const Shdr* dwarf_section = NULL;
+  if (options.symbol_data != ONLY_CFI)
+    dwarf_section = section_contents.Find(".debug_info", debug_section_type);
+  const Shdr* dwarf_cfi_section = NULL;
+  if (options.symbol_data != NO_CFI) {
+    dwarf_cfi_section = section_contents.Find(".debug_frame",
+                                              debug_section_type);
+  }
+
+  // Start reading the sections the dump will read, in about the order it
+  // reads them, so that the I/O overlaps with inflating and parsing.
+  std::vector<const Shdr*> prefetch_sections;
+  if (dwarf_section) {
+    const char* const kDwarfSections[] = {
+      ".debug_abbrev", ".debug_str", ".debug_line"
+    };
+    for (size_t i = 0; i < sizeof(kDwarfSections) / sizeof(*kDwarfSections);
+         i++) {
+      prefetch_sections.push_back(
+          section_contents.Find(kDwarfSections[i], debug_section_type));
+    }
+    prefetch_sections.push_back(dwarf_section);
+  }
+  prefetch_sections.push_back(dwarf_cfi_section);
+  if (options.symbol_data != NO_CFI)
+    prefetch_sections.push_back(section_contents.Find(".eh_frame",
+                                                      SHT_PROGBITS));
+  section_contents.Prefetch(prefetch_sections);
+
+  std::vector<const Shdr*> compressed_sections;
+  for (int i = 0; i < section_contents.count(); i++) {
+    const Shdr* section = section_contents.section(i);
+    if (!section_contents.IsCompressed(section))
+      continue;
+    string name = section_contents.Name(section);
+    if (name == ".debug_frame" ? dwarf_cfi_section != NULL
+        : dwarf_section != NULL && name.compare(0, 7, ".debug_") == 0)
+      compressed_sections.push_back(section);
+  }
+  if (!compressed_sections.empty()) {
+    PhaseTimer timer(Phase(options, &DumpStatistics::inflate_ns));
+    section_contents.Inflate(compressed_sections, options.num_threads);
+  }
+
   if (options.symbol_data != ONLY_CFI) {
 #ifndef NO_STABS_SUPPORT
     // Look for STABS debugging information, and load it if present.
-    const Shdr* stab_section =
-      FindElfSectionByName<ElfClass>(".stab", SHT_PROGBITS,
-                                     sections, names, names_end,
-                                     elf_header->e_shnum);
+    const Shdr* stab_section = section_contents.Find(".stab", SHT_PROGBITS);
     if (stab_section) {
       const Shdr* stabstr_section = stab_section->sh_link + sections;
       if (stabstr_section) {
         found_debug_info_section = true;
         found_usable_info = true;
         info->LoadedSection(".stab");
+        PhaseTimer timer(Phase(options, &DumpStatistics::debug_info_ns));
         if (!LoadStabs<ElfClass>(elf_header, stab_section, stabstr_section,
                                  big_endian, module)) {
           fprintf(stderr, "%s: \".stab\" section found, but failed to load"
@@ -613,17 +1308,16 @@ bool LoadSymbols(const string& obj_file,
     }
 #endif  // NO_STABS_SUPPORT
 
-    // Look for DWARF debugging information, and load it if present.
-    const Shdr* dwarf_section =
-      FindElfSectionByName<ElfClass>(".debug_info", debug_section_type,
-                                     sections, names, names_end,
-                                     elf_header->e_shnum);
+    // Load the DWARF debugging information, if present.
     if (dwarf_section) {
       found_debug_info_section = true;
       found_usable_info = true;
       info->LoadedSection(".debug_info");
-      if (!LoadDwarf<ElfClass>(obj_file, elf_header, big_endian,
-                               options.handle_inter_cu_refs, module)) {
+      PhaseTimer timer(Phase(options, &DumpStatistics::debug_info_ns));
+      if (!LoadDwarf<ElfClass>(obj_file, section_contents, big_endian,
+                               options.handle_inter_cu_refs,
+                               options.num_threads, options.dwarf_cu_cache,
+                               options.statistics, module)) {
         fprintf(stderr, "%s: \".debug_info\" section found, but failed to load "
                 "DWARF debugging information\n", obj_file.c_str());
       }
@@ -633,18 +1327,16 @@ bool LoadSymbols(const string& obj_file,
   if (options.symbol_data != NO_CFI) {
     // Dwarf Call Frame Information (CFI) is actually independent from
     // the other DWARF debugging information, and can be used alone.
-    const Shdr* dwarf_cfi_section =
-        FindElfSectionByName<ElfClass>(".debug_frame", debug_section_type,
-                                       sections, names, names_end,
-                                       elf_header->e_shnum);
     if (dwarf_cfi_section) {
       // Ignore the return value of this function; even without call frame
       // information, the other debugging information could be perfectly
       // useful.
       info->LoadedSection(".debug_frame");
+      PhaseTimer timer(Phase(options, &DumpStatistics::cfi_ns));
       bool result =
-          LoadDwarfCFI<ElfClass>(obj_file, elf_header, ".debug_frame",
-                                 dwarf_cfi_section, false, 0, 0, big_endian,
+          LoadDwarfCFI<ElfClass>(obj_file, elf_header, section_contents,
+                                 ".debug_frame", dwarf_cfi_section, false,
+                                 0, 0, big_endian, options.num_threads,
                                  module);
       found_usable_info = found_usable_info || result;
     }
@@ -652,26 +1344,20 @@ bool LoadSymbols(const string& obj_file,
     // Linux C++ exception handling information can also provide
     // unwinding data.
     const Shdr* eh_frame_section =
-        FindElfSectionByName<ElfClass>(".eh_frame", SHT_PROGBITS,
-                                       sections, names, names_end,
-                                       elf_header->e_shnum);
+        section_contents.Find(".eh_frame", SHT_PROGBITS);
     if (eh_frame_section) {
       // Pointers in .eh_frame data may be relative to the base addresses of
       // certain sections. Provide those sections if present.
-      const Shdr* got_section =
-          FindElfSectionByName<ElfClass>(".got", SHT_PROGBITS,
-                                         sections, names, names_end,
-                                         elf_header->e_shnum);
-      const Shdr* text_section =
-          FindElfSectionByName<ElfClass>(".text", SHT_PROGBITS,
-                                         sections, names, names_end,
-                                         elf_header->e_shnum);
+      const Shdr* got_section = section_contents.Find(".got", SHT_PROGBITS);
+      const Shdr* text_section = section_contents.Find(".text", SHT_PROGBITS);
       info->LoadedSection(".eh_frame");
+      PhaseTimer timer(Phase(options, &DumpStatistics::cfi_ns));
       // As above, ignore the return value of this function.
       bool result =
-          LoadDwarfCFI<ElfClass>(obj_file, elf_header, ".eh_frame",
-                                 eh_frame_section, true,
-                                 got_section, text_section, big_endian, module);
+          LoadDwarfCFI<ElfClass>(obj_file, elf_header, section_contents,
+                                 ".eh_frame", eh_frame_section, true,
+                                 got_section, text_section, big_endian,
+                                 options.num_threads, module);
       found_usable_info = found_usable_info || result;
     }
   }
@@ -684,9 +1370,7 @@ bool LoadSymbols(const string& obj_file,
     // Failed, but maybe there's a .gnu_debuglink section?
     if (read_gnu_debug_link) {
       const Shdr* gnu_debuglink_section
-          = FindElfSectionByName<ElfClass>(".gnu_debuglink", SHT_PROGBITS,
-                                           sections, names,
-                                           names_end, elf_header->e_shnum);
+          = section_contents.Find(".gnu_debuglink", SHT_PROGBITS);
       if (gnu_debuglink_section) {
         if (!info->debug_dirs().empty()) {
           found_debug_info_section = true;
@@ -694,12 +1378,14 @@ bool LoadSymbols(const string& obj_file,
           const char* debuglink_contents =
               GetOffset<ElfClass, char>(elf_header,
                                         gnu_debuglink_section->sh_offset);
+          PhaseTimer timer(Phase(options, &DumpStatistics::debuglink_ns));
           string debuglink_file =
               ReadDebugLink(debuglink_contents,
                             gnu_debuglink_section->sh_size,
                             big_endian,
                             obj_file,
-                            info->debug_dirs());
+                            info->debug_dirs(),
+                            options.debug_directory_cache);
           info->set_debuglink_file(debuglink_file);
         } else {
           fprintf(stderr, ".gnu_debuglink section found in '%s', "
@@ -713,16 +1399,11 @@ bool LoadSymbols(const string& obj_file,
   }
 
   if (options.symbol_data != ONLY_CFI) {
-    const Shdr* dynsym_section =
-      FindElfSectionByName<ElfClass>(".dynsym", SHT_DYNSYM,
-                                     sections, names, names_end,
-                                     elf_header->e_shnum);
-    const Shdr* dynstr_section =
-      FindElfSectionByName<ElfClass>(".dynstr", SHT_STRTAB,
-                                     sections, names, names_end,
-                                     elf_header->e_shnum);
+    const Shdr* dynsym_section = section_contents.Find(".dynsym", SHT_DYNSYM);
+    const Shdr* dynstr_section = section_contents.Find(".dynstr", SHT_STRTAB);
     if (dynsym_section && dynstr_section) {
       info->LoadedSection(".dynsym");
+      PhaseTimer timer(Phase(options, &DumpStatistics::symbol_table_ns));
 
       const uint8_t* dynsyms =
           GetOffset<ElfClass, uint8_t>(elf_header,
@@ -811,9 +1492,18 @@ bool ReadSymbolDataElfClass(const typename ElfClass::Ehdr* elf_header,
 
   *out_module = NULL;
 
+  // Index the sections once for all the lookups below.
+  ElfSectionIndex section_index(elf_header);
+
   unsigned char identifier[16];
-  if (!google_breakpad::FileID::ElfFileIdentifierFromMappedFile(elf_header,
-                                                                identifier)) {
+  bool have_identifier;
+  {
+    PhaseTimer timer(Phase(options, &DumpStatistics::identifier_ns));
+    have_identifier =
+        google_breakpad::FileID::ElfFileIdentifierFromMappedFile(
+            elf_header, section_index, identifier);
+  }
+  if (!have_identifier) {
     fprintf(stderr, "%s: unable to generate file identifier\n",
             obj_filename.c_str());
     return false;
@@ -837,8 +1527,10 @@ bool ReadSymbolDataElfClass(const typename ElfClass::Ehdr* elf_header,
 
   LoadSymbolsInfo<ElfClass> info(debug_dirs);
   scoped_ptr<Module> module(new Module(name, os, architecture, id));
+  if (options.memory_budget)
+    module->SetMemoryBudget(options.memory_budget, options.temp_directory);
   if (!LoadSymbols<ElfClass>(obj_filename, big_endian, elf_header,
-                             !debug_dirs.empty(), &info,
+                             section_index, !debug_dirs.empty(), &info,
                              options, module.get())) {
     const string debuglink_file = info.debuglink_file();
     if (debuglink_file.empty())
@@ -848,8 +1540,13 @@ bool ReadSymbolDataElfClass(const typename ElfClass::Ehdr* elf_header,
     fprintf(stderr, "Found debugging info in %s\n", debuglink_file.c_str());
     MmapWrapper debug_map_wrapper;
     Ehdr* debug_elf_header = NULL;
-    if (!LoadELF(debuglink_file, &debug_map_wrapper,
-                 reinterpret_cast<void**>(&debug_elf_header)))
+    bool loaded;
+    {
+      PhaseTimer timer(Phase(options, &DumpStatistics::load_ns));
+      loaded = LoadELF(debuglink_file, &debug_map_wrapper,
+                       reinterpret_cast<void**>(&debug_elf_header));
+    }
+    if (!loaded)
       return false;
     // Sanity checks to make sure everything matches up.
     const char *debug_architecture =
@@ -876,9 +1573,10 @@ bool ReadSymbolDataElfClass(const typename ElfClass::Ehdr* elf_header,
       return false;
     }
 
+    ElfSectionIndex debug_section_index(debug_elf_header);
     if (!LoadSymbols<ElfClass>(debuglink_file, debug_big_endian,
-                               debug_elf_header, false, &info,
-                               options, module.get())) {
+                               debug_elf_header, debug_section_index, false,
+                               &info, options, module.get())) {
       return false;
     }
   }
@@ -891,6 +1589,38 @@ bool ReadSymbolDataElfClass(const typename ElfClass::Ehdr* elf_header,
 
 namespace google_breakpad {
 
+DebugDirectoryCache::DebugDirectoryCache() {
+  pthread_mutex_init(&mutex_, NULL);
+}
+
+DebugDirectoryCache::~DebugDirectoryCache() {
+  pthread_mutex_destroy(&mutex_);
+}
+
+bool DebugDirectoryCache::MayContain(const string& directory,
+                                     const string& name) {
+  if (name.find('/') != string::npos)
+    return true;
+
+  pthread_mutex_lock(&mutex_);
+  ListingMap::iterator it = listings_.find(directory);
+  if (it == listings_.end()) {
+    it = listings_.insert(std::make_pair(directory, Listing())).first;
+    Listing& listing = it->second;
+    DIR* dir = opendir(directory.c_str());
+    if (dir) {
+      struct dirent* entry;
+      while ((entry = readdir(dir)) != NULL)
+        listing.names.insert(entry->d_name);
+      closedir(dir);
+      listing.complete = true;
+    }
+  }
+  bool result = !it->second.complete || it->second.names.count(name) > 0;
+  pthread_mutex_unlock(&mutex_);
+  return result;
+}
+
 // Not explicitly exported, but not static so it can be used in unit tests.
 bool ReadSymbolDataInternal(const uint8_t* obj_file,
                             const string& obj_filename,
@@ -925,7 +1655,11 @@ bool WriteSymbolFile(const string &obj_file,
   if (!ReadSymbolData(obj_file, debug_dirs, options, &module))
     return false;
 
-  bool result = module->Write(sym_stream, options.symbol_data);
+  bool result;
+  {
+    PhaseTimer timer(Phase(options, &DumpStatistics::write_ns));
+    result = module->Write(sym_stream, options.symbol_data);
+  }
   delete module;
   return result;
 }
@@ -936,11 +1670,33 @@ bool ReadSymbolData(const string& obj_file,
                     Module** module) {
   MmapWrapper map_wrapper;
   void* elf_header = NULL;
-  if (!LoadELF(obj_file, &map_wrapper, &elf_header))
+  bool loaded;
+  {
+    PhaseTimer timer(Phase(options, &DumpStatistics::load_ns));
+    loaded = LoadELF(obj_file, &map_wrapper, &elf_header);
+  }
+  if (!loaded)
     return false;
 
   return ReadSymbolDataInternal(reinterpret_cast<uint8_t*>(elf_header),
                                 obj_file, debug_dirs, options, module);
 }
 
+bool ReadModuleIdentifier(const string& obj_file, string* name, string* id) {
+  MmapWrapper map_wrapper;
+  void* elf_header = NULL;
+  if (!LoadELF(obj_file, &map_wrapper, &elf_header))
+    return false;
+
+  unsigned char identifier[16];
+  if (!FileID::ElfFileIdentifierFromMappedFile(elf_header, identifier)) {
+    fprintf(stderr, "%s: unable to generate file identifier\n",
+            obj_file.c_str());
+    return false;
+  }
+  *name = BaseFileName(obj_file);
+  *id = FormatIdentifier(identifier);
+  return true;
+}
+
 }  // namespace google_breakpad
@@ -35,7 +35,12 @@
 #ifndef COMMON_LINUX_DUMP_SYMBOLS_H__
 #define COMMON_LINUX_DUMP_SYMBOLS_H__
 
+#include <pthread.h>
+#include <stdint.h>
+
 #include <iostream>
+#include <map>
+#include <set>
 #include <string>
 #include <vector>
 
@@ -44,16 +49,130 @@
 
 namespace google_breakpad {
 
+class DwarfCUCache;
 class Module;
 
+// A record of the contents of the directories searched for the debug
+// files named by .gnu_debuglink sections. When many files are dumped
+// against the same debug directories, sharing one cache means each
+// directory is listed once, rather than probed for every file. A cache
+// may be used by several threads at once.
+class DebugDirectoryCache {
+ public:
+  DebugDirectoryCache();
+  ~DebugDirectoryCache();
+
+  // Return true if DIRECTORY may contain a file named NAME. The first
+  // query about a directory lists its contents. Names containing a
+  // slash, and directories that can't be listed, are always assumed to
+  // be present, so that the caller falls back to opening the file.
+  bool MayContain(const string& directory, const string& name);
+
+ private:
+  struct Listing {
+    Listing() : complete(false) { }
+    // False if the directory couldn't be listed.
+    bool complete;
+    std::set<string> names;
+  };
+
+  typedef std::map<string, Listing> ListingMap;
+
+  ListingMap listings_;
+  pthread_mutex_t mutex_;
+
+  // Disallow copy constructor and assignment operator.
+  DebugDirectoryCache(const DebugDirectoryCache&);
+  void operator=(const DebugDirectoryCache&);
+};
+
+// How long each phase of reading a file's symbols took, in nanoseconds,
+// for benchmarking. Times accumulate over the files read, and include
+// both the file named and its .gnu_debuglink file, if any.
+struct DumpStatistics {
+  DumpStatistics()
+      : load_ns(0),
+        identifier_ns(0),
+        debuglink_ns(0),
+        inflate_ns(0),
+        debug_info_ns(0),
+        lines_ns(0),
+        cfi_ns(0),
+        symbol_table_ns(0),
+        write_ns(0),
+        compilation_units(0),
+        cached_compilation_units(0) {
+  }
+
+  // Mapping and checking the ELF files.
+  uint64_t load_ns;
+  // Computing the module identifier.
+  uint64_t identifier_ns;
+  // Finding and checksumming the .gnu_debuglink file.
+  uint64_t debuglink_ns;
+  // Decompressing compressed debugging sections.
+  uint64_t inflate_ns;
+  // Reading the DWARF .debug_info section, or STABS.
+  uint64_t debug_info_ns;
+  // Decoding line number programs and assigning their lines to
+  // functions. This is part of debug_info_ns, but when compilation units
+  // are read on several threads it is summed over the threads, and so
+  // may exceed it.
+  uint64_t lines_ns;
+  // Reading .debug_frame and .eh_frame.
+  uint64_t cfi_ns;
+  // Reading .dynsym.
+  uint64_t symbol_table_ns;
+  // Writing the symbol file, in WriteSymbolFile.
+  uint64_t write_ns;
+
+  // The number of DWARF compilation units read.
+  uint64_t compilation_units;
+  // The number of those whose functions were taken from
+  // DumpOptions::dwarf_cu_cache instead.
+  uint64_t cached_compilation_units;
+};
+
 struct DumpOptions {
   DumpOptions(SymbolData symbol_data, bool handle_inter_cu_refs)
       : symbol_data(symbol_data),
-        handle_inter_cu_refs(handle_inter_cu_refs) {
+        handle_inter_cu_refs(handle_inter_cu_refs),
+        num_threads(1),
+        memory_budget(0),
+        temp_directory("/tmp"),
+        debug_directory_cache(NULL),
+        dwarf_cu_cache(NULL),
+        statistics(NULL) {
   }
 
   SymbolData symbol_data;
   bool handle_inter_cu_refs;
+
+  // The number of threads to use for reading DWARF compilation units and
+  // call frame information. The symbol file is the same regardless of
+  // this setting.
+  int num_threads;
+
+  // If not zero, about the most memory in bytes to hold functions and
+  // call frame information in, beyond which they are written out to
+  // temporary files in TEMP_DIRECTORY and merged back when the symbol
+  // file is written. See Module::SetMemoryBudget. Call frame
+  // information is then read on one thread.
+  size_t memory_budget;
+  string temp_directory;
+
+  // If not NULL, the cache to consult when searching the debug
+  // directories for a .gnu_debuglink file. Not owned.
+  DebugDirectoryCache* debug_directory_cache;
+
+  // If not NULL, the cache to take the functions of DWARF compilation
+  // units from, if it has them from an earlier dump, and to add the
+  // others to. See DwarfCUCache. Not owned.
+  DwarfCUCache* dwarf_cu_cache;
+
+  // If not NULL, the phases of reading symbols are timed, and their
+  // times added to this. Not owned.
+  DumpStatistics* statistics;
 };
 
 // Find all the debugging information in OBJ_FILE, an ELF executable
@@ -75,6 +194,11 @@ bool ReadSymbolData(const string& obj_file,
                     const DumpOptions& options,
                     Module** module);
 
+// Set NAME and ID to the module name and identifier that ReadSymbolData
+// would give OBJ_FILE's symbols, without reading its debugging
+// information. Return false if OBJ_FILE is not a valid ELF file.
+bool ReadModuleIdentifier(const string& obj_file, string* name, string* id);
+
 }  // namespace google_breakpad
 
 #endif  // COMMON_LINUX_DUMP_SYMBOLS_H__
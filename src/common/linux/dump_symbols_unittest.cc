@@ -33,8 +33,10 @@
 // Unittests for google_breakpad::DumpSymbols
 
 #include <elf.h>
+#include <fcntl.h>
 #include <link.h>
 #include <stdio.h>
+#include <unistd.h>
 
 #include <sstream>
 #include <vector>
@@ -43,6 +45,7 @@
 #include "common/linux/dump_symbols.h"
 #include "common/linux/synth_elf.h"
 #include "common/module.h"
+#include "common/tests/auto_tempdir.h"
 #include "common/using_std_string.h"
 
 namespace google_breakpad {
@@ -169,4 +172,25 @@ TEST_F(DumpSymbols, SimplePublic64) {
             s.str());
 }
 
+TEST(DebugDirectoryCache, MayContain) {
+  AutoTempDir temp_dir;
+  string present = temp_dir.path() + "/present.debug";
+  int fd = open(present.c_str(), O_CREAT | O_WRONLY, 0600);
+  ASSERT_GE(fd, 0);
+  close(fd);
+
+  DebugDirectoryCache cache;
+  EXPECT_TRUE(cache.MayContain(temp_dir.path(), "present.debug"));
+  EXPECT_FALSE(cache.MayContain(temp_dir.path(), "absent.debug"));
+  EXPECT_TRUE(cache.MayContain(temp_dir.path(), "sub/absent.debug"));
+  EXPECT_TRUE(cache.MayContain(temp_dir.path() + "/missing", "any.debug"));
+
+  // The listing is taken once, so files created later aren't seen.
+  string late = temp_dir.path() + "/late.debug";
+  fd = open(late.c_str(), O_CREAT | O_WRONLY, 0600);
+  ASSERT_GE(fd, 0);
+  close(fd);
+  EXPECT_FALSE(cache.MayContain(temp_dir.path(), "late.debug"));
+}
+
 }  // namespace google_breakpad
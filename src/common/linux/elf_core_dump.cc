@@ -35,6 +35,8 @@
 #include <stddef.h>
 #include <string.h>
 
+#include <algorithm>
+
 namespace google_breakpad {
 
 // Implementation of ElfCoreDump::Note.
@@ -95,14 +97,25 @@ size_t ElfCoreDump::Note::AlignedSize(size_t size) {
 
 // Implementation of ElfCoreDump.
 
-ElfCoreDump::ElfCoreDump() {}
+ElfCoreDump::ElfCoreDump()
+    : load_segments_indexed_(false),
+      load_segments_overlap_(false),
+      last_segment_(0) {
+}
 
 ElfCoreDump::ElfCoreDump(const MemoryRange& content)
-    : content_(content) {
+    : content_(content),
+      load_segments_indexed_(false),
+      load_segments_overlap_(false),
+      last_segment_(0) {
 }
 
 void ElfCoreDump::SetContent(const MemoryRange& content) {
   content_ = content;
+  load_segments_.clear();
+  load_segments_indexed_ = false;
+  load_segments_overlap_ = false;
+  last_segment_ = 0;
 }
 
 bool ElfCoreDump::IsValid() const {
@@ -146,7 +159,76 @@ unsigned ElfCoreDump::GetProgramHeaderCount() const {
   return header ? header->e_phnum : 0;
 }
 
+void ElfCoreDump::IndexLoadSegments() {
+  if (load_segments_indexed_)
+    return;
+
+  load_segments_.clear();
+  for (unsigned i = 0, n = GetProgramHeaderCount(); i < n; ++i) {
+    const Phdr* program = GetProgramHeader(i);
+    if (!program || program->p_type != PT_LOAD || program->p_filesz == 0)
+      continue;
+    LoadSegment segment;
+    segment.start = program->p_vaddr;
+    segment.size = program->p_filesz;
+    segment.file_offset = program->p_offset;
+    load_segments_.push_back(segment);
+  }
+  std::stable_sort(load_segments_.begin(), load_segments_.end(),
+                   LoadSegmentLess());
+
+  load_segments_overlap_ = false;
+  for (size_t i = 1; i < load_segments_.size(); ++i) {
+    const LoadSegment& previous = load_segments_[i - 1];
+    if (load_segments_[i].start - previous.start < previous.size) {
+      load_segments_overlap_ = true;
+      break;
+    }
+  }
+  last_segment_ = 0;
+  load_segments_indexed_ = true;
+}
+
+size_t ElfCoreDump::FindLoadSegment(Addr virtual_address) {
+  size_t count = load_segments_.size();
+  if (last_segment_ < count) {
+    const LoadSegment& last = load_segments_[last_segment_];
+    if (virtual_address >= last.start &&
+        virtual_address - last.start < last.size) {
+      return last_segment_;
+    }
+  }
+
+  LoadSegment key;
+  key.start = virtual_address;
+  std::vector<LoadSegment>::const_iterator next =
+      std::upper_bound(load_segments_.begin(), load_segments_.end(), key,
+                       LoadSegmentLess());
+  if (next == load_segments_.begin())
+    return count;
+  size_t index = next - load_segments_.begin() - 1;
+  const LoadSegment& segment = load_segments_[index];
+  if (virtual_address - segment.start >= segment.size)
+    return count;
+  last_segment_ = index;
+  return index;
+}
+
 bool ElfCoreDump::CopyData(void* buffer, Addr virtual_address, size_t length) {
+  IndexLoadSegments();
+  if (!load_segments_overlap_) {
+    size_t index = FindLoadSegment(virtual_address);
+    if (index == load_segments_.size())
+      return false;
+    const LoadSegment& segment = load_segments_[index];
+    const void* data = content_.GetData(
+        segment.file_offset + (virtual_address - segment.start), length);
+    if (!data)
+      return false;
+    memcpy(buffer, data, length);
+    return true;
+  }
+
   for (unsigned i = 0, n = GetProgramHeaderCount(); i < n; ++i) {
     const Phdr* program = GetProgramHeader(i);
     if (program->p_type != PT_LOAD)
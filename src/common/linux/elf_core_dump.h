@@ -37,6 +37,8 @@
 #include <link.h>
 #include <stddef.h>
 
+#include <vector>
+
 #include "common/memory_range.h"
 
 namespace google_breakpad {
@@ -131,7 +133,8 @@ class ElfCoreDump {
   // Copies |length| bytes of data starting at |virtual_address| in the core
   // dump to |buffer|. |buffer| should be a valid pointer to a buffer of at
   // least |length| bytes. Returns true if the data to be copied is found in
-  // the core dump, or false otherwise.
+  // the core dump, or false otherwise. The PT_LOAD segments are indexed by
+  // address on the first call, so lookups take logarithmic time.
   bool CopyData(void* buffer, Addr virtual_address, size_t length);
 
   // Returns the first note found in the note section of the core dump, or
@@ -139,8 +142,43 @@ class ElfCoreDump {
   Note GetFirstNote() const;
 
  private:
+  // The part of a PT_LOAD segment that is backed by data in the core dump.
+  struct LoadSegment {
+    Addr start;  // p_vaddr
+    Addr size;   // p_filesz
+    size_t file_offset;  // p_offset
+  };
+
+  // Sorts LoadSegments by start address.
+  struct LoadSegmentLess {
+    bool operator()(const LoadSegment& a, const LoadSegment& b) const {
+      return a.start < b.start;
+    }
+  };
+
+  // Builds |load_segments_| from the program headers, unless it has already
+  // been built for the current content.
+  void IndexLoadSegments();
+
+  // Returns the index in |load_segments_| of the segment containing
+  // |virtual_address|, or load_segments_.size() if there is none.
+  size_t FindLoadSegment(Addr virtual_address);
+
   // Core dump content.
   MemoryRange content_;
+
+  // PT_LOAD segments with file data, sorted by start address. Only valid
+  // if |load_segments_indexed_| is true.
+  std::vector<LoadSegment> load_segments_;
+  bool load_segments_indexed_;
+
+  // True if any two segments in |load_segments_| overlap, in which case
+  // CopyData falls back to scanning the program headers in file order.
+  bool load_segments_overlap_;
+
+  // Index in |load_segments_| of the segment found by the last lookup.
+  // Consecutive reads tend to hit the same segment.
+  size_t last_segment_;
 };
 
 }  // namespace google_breakpad
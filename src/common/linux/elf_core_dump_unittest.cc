@@ -254,3 +254,67 @@ TEST(ElfCoreDumpTest, ValidCoreFile) {
   EXPECT_EQ(num_pr_fpvalid, num_nt_prxfpreg);
 #endif
 }
+
+TEST(ElfCoreDumpTest, CopyData) {
+  // Lay out a core with an ELF header, five program headers and the data
+  // of three PT_LOAD segments, listed out of address order.
+  const unsigned kNumPrograms = 5;
+  const size_t kDataOffset =
+      sizeof(ElfCoreDump::Ehdr) + kNumPrograms * sizeof(ElfCoreDump::Phdr);
+  string content(kDataOffset + 3 * 16, '\0');
+  for (size_t i = 0; i < 3 * 16; ++i)
+    content[kDataOffset + i] = static_cast<char>(i);
+
+  ElfCoreDump::Ehdr* header =
+      reinterpret_cast<ElfCoreDump::Ehdr*>(&content[0]);
+  header->e_phoff = sizeof(ElfCoreDump::Ehdr);
+  header->e_phentsize = sizeof(ElfCoreDump::Phdr);
+  header->e_phnum = kNumPrograms;
+  ElfCoreDump::Phdr* programs =
+      reinterpret_cast<ElfCoreDump::Phdr*>(&content[header->e_phoff]);
+  const ElfCoreDump::Addr kAddresses[] = { 0x3000, 0x1000, 0x2000 };
+  for (unsigned i = 0; i < 3; ++i) {
+    programs[i].p_type = PT_LOAD;
+    programs[i].p_vaddr = kAddresses[i];
+    programs[i].p_offset = kDataOffset + i * 16;
+    programs[i].p_filesz = 16;
+    programs[i].p_memsz = 0x1000;
+  }
+  // A PT_LOAD segment without data in the core, and a note.
+  programs[3].p_type = PT_LOAD;
+  programs[3].p_vaddr = 0x4000;
+  programs[3].p_memsz = 0x1000;
+  programs[4].p_type = PT_NOTE;
+  programs[4].p_vaddr = 0x5000;
+  programs[4].p_offset = kDataOffset;
+  programs[4].p_filesz = 16;
+
+  ElfCoreDump core(MemoryRange(content.data(), content.size()));
+  uint8_t buffer[4];
+  ASSERT_TRUE(core.CopyData(buffer, 0x1000, 4));
+  EXPECT_EQ(16, buffer[0]);
+  EXPECT_EQ(19, buffer[3]);
+  ASSERT_TRUE(core.CopyData(buffer, 0x1004, 4));
+  EXPECT_EQ(20, buffer[0]);
+  ASSERT_TRUE(core.CopyData(buffer, 0x300c, 4));
+  EXPECT_EQ(12, buffer[0]);
+  ASSERT_TRUE(core.CopyData(buffer, 0x2000, 1));
+  EXPECT_EQ(32, buffer[0]);
+
+  // Addresses outside of the data of any PT_LOAD segment.
+  EXPECT_FALSE(core.CopyData(buffer, 0x0fff, 1));
+  EXPECT_FALSE(core.CopyData(buffer, 0x1010, 1));
+  EXPECT_FALSE(core.CopyData(buffer, 0x4000, 1));
+  EXPECT_FALSE(core.CopyData(buffer, 0x5000, 1));
+  // Reads past the end of the core file.
+  EXPECT_FALSE(core.CopyData(buffer, 0x200e, 4));
+
+  // Overlapping segments are searched in program header order.
+  programs[1].p_vaddr = 0x3008;
+  core.SetContent(MemoryRange(content.data(), content.size()));
+  ASSERT_TRUE(core.CopyData(buffer, 0x3008, 1));
+  EXPECT_EQ(8, buffer[0]);
+  ASSERT_TRUE(core.CopyData(buffer, 0x3010, 1));
+  EXPECT_EQ(24, buffer[0]);
+  EXPECT_FALSE(core.CopyData(buffer, 0x1000, 1));
+}
@@ -0,0 +1,279 @@
+// Copyright (c) 2016, Google Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+// notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above
+// copyright notice, this list of conditions and the following disclaimer
+// in the documentation and/or other materials provided with the
+// distribution.
+//     * Neither the name of Google Inc. nor the names of its
+// contributors may be used to endorse or promote products derived from
+// this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+// elf_core_stream_reader.cc: Implement google_breakpad::ElfCoreStreamReader.
+// See elf_core_stream_reader.h for details.
+
+#include "common/linux/elf_core_stream_reader.h"
+
+#include <string.h>
+#include <sys/procfs.h>
+#include <unistd.h>
+
+#include <algorithm>
+
+#include "common/linux/eintr_wrapper.h"
+
+namespace google_breakpad {
+
+namespace {
+
+// Larger PT_NOTE segments are taken as a sign of a corrupt core dump.
+const size_t kMaxNoteSize = 256 * 1024 * 1024;
+
+// Size of the chunks in which discarded data is read.
+const size_t kSkipBufferSize = 64 * 1024;
+
+}  // namespace
+
+ElfCoreStreamReader::ElfCoreStreamReader()
+    : page_size_(sysconf(_SC_PAGESIZE)),
+      offset_(0),
+      discarded_(0) {
+  memset(&header_, 0, sizeof(header_));
+}
+
+bool ElfCoreStreamReader::Read(int fd) {
+  offset_ = 0;
+  discarded_ = 0;
+  programs_.clear();
+  windows_.clear();
+  pieces_.clear();
+  data_.clear();
+  content_.clear();
+
+  if (!ReadFully(fd, &header_, sizeof(header_)))
+    return false;
+  if (header_.e_ident[0] != ELFMAG0 ||
+      header_.e_ident[1] != ELFMAG1 ||
+      header_.e_ident[2] != ELFMAG2 ||
+      header_.e_ident[3] != ELFMAG3 ||
+      header_.e_ident[4] != ElfCoreDump::kClass ||
+      header_.e_version != EV_CURRENT ||
+      header_.e_type != ET_CORE ||
+      header_.e_phentsize != sizeof(Phdr) ||
+      header_.e_phnum == 0 ||
+      header_.e_phnum == PN_XNUM) {
+    return false;
+  }
+
+  programs_.resize(header_.e_phnum);
+  if (!SkipTo(fd, header_.e_phoff) ||
+      !ReadFully(fd, &programs_[0], programs_.size() * sizeof(Phdr))) {
+    return false;
+  }
+
+  // Visit the segments in the order in which they appear in the stream.
+  std::vector<const Phdr*> segments;
+  for (size_t i = 0; i < programs_.size(); ++i) {
+    const Phdr& program = programs_[i];
+    if ((program.p_type == PT_NOTE || program.p_type == PT_LOAD) &&
+        program.p_filesz > 0) {
+      segments.push_back(&program);
+    }
+  }
+  std::stable_sort(segments.begin(), segments.end(), OffsetLess());
+
+  for (size_t i = 0; i < segments.size(); ++i) {
+    const Phdr* program = segments[i];
+    if (program->p_type == PT_LOAD) {
+      if (!ReadLoadSegment(fd, program))
+        return false;
+      continue;
+    }
+
+    if (program->p_filesz > kMaxNoteSize || !SkipTo(fd, program->p_offset))
+      return false;
+    Piece piece = { program, 0, program->p_filesz, data_.size() };
+    data_.resize(data_.size() + piece.size);
+    if (!ReadFully(fd, &data_[piece.data_offset], piece.size))
+      return false;
+    pieces_.push_back(piece);
+    AddRegisterWindows(MemoryRange(&data_[piece.data_offset], piece.size));
+  }
+
+  BuildContent();
+  return true;
+}
+
+MemoryRange ElfCoreStreamReader::content() const {
+  if (content_.empty())
+    return MemoryRange();
+  return MemoryRange(&content_[0], content_.size());
+}
+
+bool ElfCoreStreamReader::ReadFully(int fd, void* buffer, size_t length) {
+  char* bytes = static_cast<char*>(buffer);
+  while (length > 0) {
+    ssize_t result = HANDLE_EINTR(read(fd, bytes, length));
+    if (result <= 0)
+      return false;
+    bytes += result;
+    length -= result;
+    offset_ += result;
+  }
+  return true;
+}
+
+bool ElfCoreStreamReader::SkipTo(int fd, size_t offset) {
+  // Segments are visited in stream order, so only overlapping segments
+  // would need to go back.
+  if (offset < offset_)
+    return false;
+  size_t length = offset - offset_;
+  if (length == 0)
+    return true;
+  discarded_ += length;
+
+  // Regular files can simply be seeked over.
+  if (lseek(fd, length, SEEK_CUR) != -1) {
+    offset_ = offset;
+    return true;
+  }
+
+  std::vector<char> buffer(std::min(length, kSkipBufferSize));
+  while (length > 0) {
+    size_t chunk = std::min(length, buffer.size());
+    if (!ReadFully(fd, &buffer[0], chunk))
+      return false;
+    length -= chunk;
+  }
+  return true;
+}
+
+void ElfCoreStreamReader::AddRegisterWindows(const MemoryRange& notes) {
+  for (ElfCoreDump::Note note(notes); note.IsValid();
+       note = note.GetNextNote()) {
+    if (note.GetType() != NT_PRSTATUS)
+      continue;
+    const elf_prstatus* status =
+        note.GetDescription().GetData<elf_prstatus>(0);
+    if (!status)
+      continue;
+
+    const size_t num_registers =
+        sizeof(status->pr_reg) / sizeof(status->pr_reg[0]);
+    for (size_t i = 0; i < num_registers; ++i) {
+      Addr page = static_cast<Addr>(status->pr_reg[i]) & ~(page_size_ - 1);
+      Range window;
+      window.start = page >= page_size_ ? page - page_size_ : 0;
+      window.end = page + kRegisterWindowSize;
+      if (window.end < page)
+        window.end = ~static_cast<Addr>(0);
+      windows_.push_back(window);
+    }
+  }
+
+  // Sort and merge the windows, so that ReadLoadSegment can keep their
+  // intersections with a segment in address order.
+  std::sort(windows_.begin(), windows_.end(), RangeLess());
+  size_t merged = 0;
+  for (size_t i = 0; i < windows_.size(); ++i) {
+    if (merged > 0 && windows_[i].start <= windows_[merged - 1].end) {
+      windows_[merged - 1].end =
+          std::max(windows_[merged - 1].end, windows_[i].end);
+    } else {
+      windows_[merged++] = windows_[i];
+    }
+  }
+  windows_.resize(merged);
+}
+
+bool ElfCoreStreamReader::ReadLoadSegment(int fd, const Phdr* program) {
+  const Addr start = program->p_vaddr;
+  const Addr end = start + program->p_filesz;
+  if (end < start)
+    return false;
+
+  std::vector<Range> keep;
+  if (program->p_filesz <= kSmallSegmentSize) {
+    Range all = { start, end };
+    keep.push_back(all);
+  } else {
+    Range first_page = { start, start + page_size_ };
+    keep.push_back(first_page);
+    for (size_t i = 0; i < windows_.size(); ++i) {
+      Range range = { std::max(start, windows_[i].start),
+                      std::min(end, windows_[i].end) };
+      if (range.start >= range.end)
+        continue;
+      if (range.start <= keep.back().end)
+        keep.back().end = std::max(keep.back().end, range.end);
+      else
+        keep.push_back(range);
+    }
+  }
+
+  for (size_t i = 0; i < keep.size(); ++i) {
+    Piece piece = { program, keep[i].start, keep[i].end - keep[i].start,
+                    data_.size() };
+    if (!SkipTo(fd, program->p_offset + (piece.start - start)))
+      return false;
+    data_.resize(data_.size() + piece.size);
+    if (!ReadFully(fd, &data_[piece.data_offset], piece.size))
+      return false;
+    pieces_.push_back(piece);
+  }
+  return true;
+}
+
+void ElfCoreStreamReader::BuildContent() {
+  const size_t data_start = sizeof(Ehdr) + pieces_.size() * sizeof(Phdr);
+  content_.resize(data_start + data_.size());
+
+  Ehdr header = header_;
+  header.e_phoff = sizeof(Ehdr);
+  header.e_phnum = pieces_.size();
+  header.e_shoff = 0;
+  header.e_shnum = 0;
+  header.e_shstrndx = SHN_UNDEF;
+  memcpy(&content_[0], &header, sizeof(header));
+
+  for (size_t i = 0; i < pieces_.size(); ++i) {
+    const Piece& piece = pieces_[i];
+    Phdr program = *piece.program;
+    program.p_offset = data_start + piece.data_offset;
+    if (program.p_type == PT_LOAD) {
+      program.p_vaddr = piece.start;
+      program.p_paddr = 0;
+      program.p_filesz = piece.size;
+      program.p_memsz = piece.size;
+    }
+    memcpy(&content_[sizeof(Ehdr) + i * sizeof(Phdr)], &program,
+           sizeof(program));
+  }
+  if (!data_.empty())
+    memcpy(&content_[data_start], &data_[0], data_.size());
+
+  // Release the staging copy of the data.
+  std::vector<char>().swap(data_);
+  pieces_.clear();
+}
+
+}  // namespace google_breakpad
@@ -0,0 +1,172 @@
+// Copyright (c) 2016, Google Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+// notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above
+// copyright notice, this list of conditions and the following disclaimer
+// in the documentation and/or other materials provided with the
+// distribution.
+//     * Neither the name of Google Inc. nor the names of its
+// contributors may be used to endorse or promote products derived from
+// this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+// elf_core_stream_reader.h: Define the google_breakpad::ElfCoreStreamReader
+// class, which reads an ELF core dump from a stream in one forward pass and
+// keeps only the parts of it needed to write a minidump.
+//
+// A core dump handed to a core_pattern pipe handler can only be read once,
+// front to back, and may be many gigabytes in size. ElfCoreStreamReader
+// buffers the notes and the following parts of the PT_LOAD segments, and
+// discards everything else as it is read:
+//  - the first page of every segment, which holds the ELF headers of mapped
+//    modules and the linux-gate page;
+//  - small segments in their entirety, which covers the writable data of
+//    most modules, including the dynamic linker's r_debug;
+//  - the memory around every value in the general purpose registers of each
+//    thread that points into a segment, from one page below the value's page
+//    to kRegisterWindowSize above it. This covers the stack that
+//    MinidumpWriter captures for each thread, and the code around each
+//    instruction pointer.
+//
+// The kept data is laid out as a compact ELF core dump in memory, with one
+// PT_LOAD program header per kept range, so that it can be handed to
+// ElfCoreDump. Reads of discarded data then fail like reads of data missing
+// from the core dump.
+//
+// Linux writes the PT_NOTE segment before the PT_LOAD segments. If a core
+// dump puts its notes after its PT_LOAD segments, the register values are
+// not known while the segments are read, and only first pages and small
+// segments are kept.
+
+#ifndef COMMON_LINUX_ELF_CORE_STREAM_READER_H_
+#define COMMON_LINUX_ELF_CORE_STREAM_READER_H_
+
+#include <stddef.h>
+
+#include <vector>
+
+#include "common/linux/elf_core_dump.h"
+#include "common/memory_range.h"
+
+namespace google_breakpad {
+
+class ElfCoreStreamReader {
+ public:
+  // PT_LOAD segments with at most this many bytes of data are kept whole.
+  static const size_t kSmallSegmentSize = 1024 * 1024;
+
+  // Bytes kept above the page of each register value. Matches the amount
+  // of stack that MinidumpWriter captures for a thread.
+  static const size_t kRegisterWindowSize = 32 * 1024;
+
+  ElfCoreStreamReader();
+
+  // Reads a core dump from |fd| up to the end of its last PT_NOTE or
+  // PT_LOAD segment. Returns false if the core dump is not valid or the
+  // stream ends early.
+  bool Read(int fd);
+
+  // Returns the compact core dump built by Read, or an empty range if Read
+  // has not succeeded.
+  MemoryRange content() const;
+
+  // Returns the number of bytes read from the stream, and the number of
+  // those that were discarded.
+  size_t bytes_read() const { return offset_; }
+  size_t bytes_discarded() const { return discarded_; }
+
+ private:
+  typedef ElfCoreDump::Addr Addr;
+  typedef ElfCoreDump::Ehdr Ehdr;
+  typedef ElfCoreDump::Phdr Phdr;
+
+  // A range of addresses [start, end).
+  struct Range {
+    Addr start;
+    Addr end;
+  };
+
+  // Sorts Ranges by start address.
+  struct RangeLess {
+    bool operator()(const Range& a, const Range& b) const {
+      return a.start < b.start;
+    }
+  };
+
+  // Sorts program headers by file offset.
+  struct OffsetLess {
+    bool operator()(const Phdr* a, const Phdr* b) const {
+      return a->p_offset < b->p_offset;
+    }
+  };
+
+  // A kept part of a segment, found at |data_offset| in |data_|.
+  struct Piece {
+    const Phdr* program;
+    Addr start;
+    size_t size;
+    size_t data_offset;
+  };
+
+  // Reads |length| bytes from the stream into |buffer|.
+  bool ReadFully(int fd, void* buffer, size_t length);
+
+  // Reads and discards bytes from the stream until |offset|.
+  bool SkipTo(int fd, size_t offset);
+
+  // Adds a register window for every general purpose register value of
+  // every thread found in the notes of |notes|.
+  void AddRegisterWindows(const MemoryRange& notes);
+
+  // Reads the segment of |program| and keeps the parts of it described
+  // above.
+  bool ReadLoadSegment(int fd, const Phdr* program);
+
+  // Lays out |content_| from |header_|, |programs_|, |pieces_| and |data_|.
+  void BuildContent();
+
+  size_t page_size_;
+
+  // Position in the stream, and the number of bytes skipped so far.
+  size_t offset_;
+  size_t discarded_;
+
+  Ehdr header_;
+  std::vector<Phdr> programs_;
+
+  // Address ranges to keep, sorted and merged once the notes are read.
+  std::vector<Range> windows_;
+
+  std::vector<Piece> pieces_;
+
+  // Note and PT_LOAD data kept from the stream, in stream order.
+  std::vector<char> data_;
+
+  // The compact core dump.
+  std::vector<char> content_;
+
+  // Disallow copy ctor and operator=
+  ElfCoreStreamReader(const ElfCoreStreamReader&);
+  void operator=(const ElfCoreStreamReader&);
+};
+
+}  // namespace google_breakpad
+
+#endif  // COMMON_LINUX_ELF_CORE_STREAM_READER_H_
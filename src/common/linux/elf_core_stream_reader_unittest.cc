@@ -0,0 +1,304 @@
+// Copyright (c) 2016, Google Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+// notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above
+// copyright notice, this list of conditions and the following disclaimer
+// in the documentation and/or other materials provided with the
+// distribution.
+//     * Neither the name of Google Inc. nor the names of its
+// contributors may be used to endorse or promote products derived from
+// this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+// elf_core_stream_reader_unittest.cc: Unit tests for
+// google_breakpad::ElfCoreStreamReader.
+
+#include <fcntl.h>
+#include <string.h>
+#include <sys/procfs.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <string>
+
+#include "breakpad_googletest_includes.h"
+#include "common/linux/elf_core_dump.h"
+#include "common/linux/elf_core_stream_reader.h"
+#include "common/tests/auto_tempdir.h"
+#include "common/tests/file_utils.h"
+#include "common/using_std_string.h"
+
+using google_breakpad::AutoTempDir;
+using google_breakpad::ElfCoreDump;
+using google_breakpad::ElfCoreStreamReader;
+using google_breakpad::MemoryRange;
+using google_breakpad::WriteFile;
+
+namespace {
+
+typedef ElfCoreDump::Addr Addr;
+
+const Addr kLargeSegmentAddress = 0x10000000;
+const size_t kLargeSegmentSize = 4 * 1024 * 1024;
+const Addr kSmallSegmentAddress = 0x20000000;
+const size_t kSmallSegmentSize = 0x3000;
+const Addr kStackPointer = kLargeSegmentAddress + 0x200123;
+
+class ElfCoreStreamReaderTest : public testing::Test {
+ public:
+  void SetUp() {
+    page_size_ = sysconf(_SC_PAGESIZE);
+  }
+
+  // Lays out a core dump with a note holding one NT_PRSTATUS, a large and
+  // a small PT_LOAD segment and a PT_LOAD segment without data. If
+  // |notes_last| is true, the note data follows the segment data.
+  string MakeCore(bool notes_last) {
+    const unsigned kNumPrograms = 4;
+    const size_t kNameSize = 8;  // "CORE" padded to the note alignment.
+    const size_t note_size =
+        sizeof(ElfCoreDump::Nhdr) + kNameSize + sizeof(elf_prstatus);
+    const size_t headers_size =
+        sizeof(ElfCoreDump::Ehdr) + kNumPrograms * sizeof(ElfCoreDump::Phdr);
+    size_t offset = headers_size;
+    size_t note_offset = offset;
+    if (!notes_last)
+      offset += note_size;
+    const size_t large_offset = offset;
+    offset += kLargeSegmentSize;
+    const size_t small_offset = offset;
+    offset += kSmallSegmentSize;
+    if (notes_last) {
+      note_offset = offset;
+      offset += note_size;
+    }
+
+    string core(offset, '\0');
+    for (size_t i = headers_size; i < core.size(); ++i)
+      core[i] = static_cast<char>(i * 7 + (i >> 12));
+
+    ElfCoreDump::Ehdr* header = reinterpret_cast<ElfCoreDump::Ehdr*>(&core[0]);
+    memcpy(header->e_ident, ELFMAG, SELFMAG);
+    header->e_ident[EI_CLASS] = ElfCoreDump::kClass;
+    header->e_version = EV_CURRENT;
+    header->e_type = ET_CORE;
+    header->e_phoff = sizeof(ElfCoreDump::Ehdr);
+    header->e_phentsize = sizeof(ElfCoreDump::Phdr);
+    header->e_phnum = kNumPrograms;
+
+    ElfCoreDump::Phdr* programs =
+        reinterpret_cast<ElfCoreDump::Phdr*>(&core[header->e_phoff]);
+    programs[0].p_type = PT_NOTE;
+    programs[0].p_offset = note_offset;
+    programs[0].p_filesz = note_size;
+    programs[1].p_type = PT_LOAD;
+    programs[1].p_vaddr = kLargeSegmentAddress;
+    programs[1].p_offset = large_offset;
+    programs[1].p_filesz = kLargeSegmentSize;
+    programs[1].p_memsz = kLargeSegmentSize;
+    programs[2].p_type = PT_LOAD;
+    programs[2].p_vaddr = kSmallSegmentAddress;
+    programs[2].p_offset = small_offset;
+    programs[2].p_filesz = kSmallSegmentSize;
+    programs[2].p_memsz = kSmallSegmentSize;
+    programs[3].p_type = PT_LOAD;
+    programs[3].p_vaddr = 0x30000000;
+    programs[3].p_memsz = 0x1000;
+
+    memset(&core[note_offset], 0, note_size);
+    ElfCoreDump::Nhdr* note =
+        reinterpret_cast<ElfCoreDump::Nhdr*>(&core[note_offset]);
+    note->n_namesz = 5;
+    note->n_descsz = sizeof(elf_prstatus);
+    note->n_type = NT_PRSTATUS;
+    memcpy(&core[note_offset + sizeof(*note)], "CORE", 5);
+    elf_prstatus status;
+    memset(&status, 0, sizeof(status));
+    status.pr_pid = 1234;
+    status.pr_reg[0] = kStackPointer;
+    memcpy(&core[note_offset + sizeof(*note) + kNameSize], &status,
+           sizeof(status));
+
+    core_ = core;
+    large_offset_ = large_offset;
+    small_offset_ = small_offset;
+    return core;
+  }
+
+  // Feeds |core| to |reader| through a pipe.
+  bool ReadThroughPipe(const string& core, ElfCoreStreamReader* reader) {
+    int fds[2];
+    if (pipe(fds) != 0)
+      return false;
+    pid_t child = fork();
+    if (child == 0) {
+      close(fds[0]);
+      const char* data = core.data();
+      size_t length = core.size();
+      while (length > 0) {
+        ssize_t result = write(fds[1], data, length);
+        if (result <= 0)
+          _exit(1);
+        data += result;
+        length -= result;
+      }
+      _exit(0);
+    }
+    close(fds[1]);
+    bool result = reader->Read(fds[0]);
+    close(fds[0]);
+    int status;
+    waitpid(child, &status, 0);
+    return result;
+  }
+
+  // Returns true if |length| bytes at |address| can be read from |core| and
+  // match the data at |file_offset| in the original core dump.
+  bool Matches(ElfCoreDump* core, Addr address, size_t file_offset,
+               size_t length) {
+    string buffer(length, '\0');
+    return core->CopyData(&buffer[0], address, length) &&
+           buffer == core_.substr(file_offset, length);
+  }
+
+ protected:
+  size_t page_size_;
+
+  // The last core dump built by MakeCore, and the file offsets of its
+  // PT_LOAD segments.
+  string core_;
+  size_t large_offset_;
+  size_t small_offset_;
+};
+
+}  // namespace
+
+TEST_F(ElfCoreStreamReaderTest, KeepsNotesStacksAndSmallSegments) {
+  string core = MakeCore(false);
+  ElfCoreStreamReader reader;
+  ASSERT_TRUE(ReadThroughPipe(core, &reader));
+  EXPECT_EQ(core.size(), reader.bytes_read());
+  EXPECT_GT(reader.bytes_discarded(), kLargeSegmentSize / 2);
+  EXPECT_LT(reader.content().length(), kLargeSegmentSize / 2);
+
+  ElfCoreDump dump(reader.content());
+  ASSERT_TRUE(dump.IsValid());
+  ElfCoreDump::Note note = dump.GetFirstNote();
+  ASSERT_TRUE(note.IsValid());
+  EXPECT_EQ(static_cast<ElfCoreDump::Word>(NT_PRSTATUS), note.GetType());
+  const elf_prstatus* status =
+      note.GetDescription().GetData<elf_prstatus>(0);
+  ASSERT_TRUE(status);
+  EXPECT_EQ(1234, status->pr_pid);
+  EXPECT_FALSE(note.GetNextNote().IsValid());
+
+  const size_t large_offset = large_offset_;
+  const size_t small_offset = small_offset_;
+
+  // The first page of the large segment.
+  EXPECT_TRUE(Matches(&dump, kLargeSegmentAddress, large_offset, 16));
+  EXPECT_TRUE(Matches(&dump, kLargeSegmentAddress + page_size_ - 16,
+                      large_offset + page_size_ - 16, 16));
+  EXPECT_FALSE(Matches(&dump, kLargeSegmentAddress + page_size_,
+                       large_offset + page_size_, 1));
+
+  // The window around the stack pointer.
+  const Addr stack_page = kStackPointer & ~(page_size_ - 1);
+  const Addr window_start = stack_page - page_size_;
+  const Addr window_end =
+      stack_page + ElfCoreStreamReader::kRegisterWindowSize;
+  EXPECT_FALSE(Matches(&dump, window_start - 1,
+                       large_offset + (window_start - 1 - kLargeSegmentAddress),
+                       1));
+  EXPECT_TRUE(Matches(&dump, window_start,
+                      large_offset + (window_start - kLargeSegmentAddress),
+                      window_end - window_start));
+  EXPECT_FALSE(Matches(&dump, window_end,
+                       large_offset + (window_end - kLargeSegmentAddress),
+                       1));
+
+  // The whole small segment.
+  EXPECT_TRUE(Matches(&dump, kSmallSegmentAddress, small_offset,
+                      kSmallSegmentSize));
+
+  // The segment without data.
+  uint8_t byte;
+  EXPECT_FALSE(dump.CopyData(&byte, 0x30000000, 1));
+}
+
+TEST_F(ElfCoreStreamReaderTest, SeeksInRegularFiles) {
+  string core = MakeCore(false);
+  AutoTempDir temp_dir;
+  string path = temp_dir.path() + "/core";
+  ASSERT_TRUE(WriteFile(path.c_str(), core.data(), core.size()));
+
+  ElfCoreStreamReader piped_reader;
+  ASSERT_TRUE(ReadThroughPipe(core, &piped_reader));
+
+  int fd = open(path.c_str(), O_RDONLY);
+  ASSERT_GE(fd, 0);
+  ElfCoreStreamReader reader;
+  EXPECT_TRUE(reader.Read(fd));
+  close(fd);
+  EXPECT_EQ(core.size(), reader.bytes_read());
+  ASSERT_EQ(piped_reader.content().length(), reader.content().length());
+  EXPECT_EQ(0, memcmp(piped_reader.content().data(), reader.content().data(),
+                      reader.content().length()));
+}
+
+TEST_F(ElfCoreStreamReaderTest, NotesAfterSegments) {
+  string core = MakeCore(true);
+  ElfCoreStreamReader reader;
+  ASSERT_TRUE(ReadThroughPipe(core, &reader));
+
+  ElfCoreDump dump(reader.content());
+  ASSERT_TRUE(dump.IsValid());
+  EXPECT_EQ(static_cast<ElfCoreDump::Word>(NT_PRSTATUS),
+            dump.GetFirstNote().GetType());
+
+  // Without the registers, only first pages and small segments are kept.
+  EXPECT_TRUE(Matches(&dump, kLargeSegmentAddress, large_offset_, 16));
+  EXPECT_FALSE(Matches(&dump, kStackPointer,
+                       large_offset_ + (kStackPointer - kLargeSegmentAddress),
+                       1));
+  EXPECT_TRUE(Matches(&dump, kSmallSegmentAddress, small_offset_,
+                      kSmallSegmentSize));
+}
+
+TEST_F(ElfCoreStreamReaderTest, InvalidCores) {
+  string core = MakeCore(false);
+  ElfCoreStreamReader reader;
+
+  // The stream ends inside the last segment.
+  EXPECT_FALSE(ReadThroughPipe(core.substr(0, core.size() - 1), &reader));
+  EXPECT_TRUE(reader.content().IsEmpty());
+
+  // Not a core dump.
+  string executable = core;
+  reinterpret_cast<ElfCoreDump::Ehdr*>(&executable[0])->e_type = ET_EXEC;
+  EXPECT_FALSE(ReadThroughPipe(executable, &reader));
+
+  // The stream ends inside the headers.
+  EXPECT_FALSE(ReadThroughPipe(core.substr(0, 16), &reader));
+
+  // Reading a valid core dump afterwards still works.
+  EXPECT_TRUE(ReadThroughPipe(core, &reader));
+  EXPECT_FALSE(reader.content().IsEmpty());
+}
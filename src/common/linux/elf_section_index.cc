@@ -0,0 +1,136 @@
+// Copyright (c) 2016, Google Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+// notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above
+// copyright notice, this list of conditions and the following disclaimer
+// in the documentation and/or other materials provided with the
+// distribution.
+//     * Neither the name of Google Inc. nor the names of its
+// contributors may be used to endorse or promote products derived from
+// this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+// elf_section_index.cc: Implement google_breakpad::ElfSectionIndex.
+// See elf_section_index.h for details.
+
+#include "common/linux/elf_section_index.h"
+
+#include <assert.h>
+#include <string.h>
+
+#include <utility>
+
+#include "common/linux/elfutils.h"
+#include "common/linux/elfutils-inl.h"
+
+namespace google_breakpad {
+
+ElfSectionIndex::ElfSectionIndex(const void* elf_base)
+    : elf_base_(static_cast<const char*>(elf_base)),
+      elf_class_(ELFCLASSNONE) {
+  if (!IsValidElf(elf_base))
+    return;
+  int elf_class = ElfClass(elf_base);
+  if (elf_class == ELFCLASS32) {
+    Build<ElfClass32>();
+  } else if (elf_class == ELFCLASS64) {
+    Build<ElfClass64>();
+  } else {
+    return;
+  }
+  elf_class_ = elf_class;
+}
+
+template<typename ElfClass>
+void ElfSectionIndex::Build() {
+  typedef typename ElfClass::Ehdr Ehdr;
+  typedef typename ElfClass::Shdr Shdr;
+
+  const Ehdr* elf_header = reinterpret_cast<const Ehdr*>(elf_base_);
+  int count = elf_header->e_shnum;
+  if (count == 0 || elf_header->e_shstrndx >= count)
+    return;
+  const Shdr* sections =
+      GetOffset<ElfClass, Shdr>(elf_header, elf_header->e_shoff);
+  const Shdr* section_names = sections + elf_header->e_shstrndx;
+  const char* names =
+      GetOffset<ElfClass, char>(elf_header, section_names->sh_offset);
+  uint64_t names_size = section_names->sh_size;
+
+  offsets_.resize(count);
+  sizes_.resize(count);
+  by_name_.rehash(count);
+  for (int i = 0; i < count; i++) {
+    offsets_[i] = sections[i].sh_offset;
+    sizes_[i] = sections[i].sh_size;
+    by_type_[sections[i].sh_type].push_back(i);
+
+    // Like FindElfSectionByName, only index names that end within the
+    // name table, and leave out empty ones.
+    uint64_t name_offset = sections[i].sh_name;
+    if (name_offset >= names_size)
+      continue;
+    const char* name = names + name_offset;
+    if (name[0] == '\0' || !memchr(name, '\0', names_size - name_offset))
+      continue;
+    // The first section of a given name and type is the one found.
+    by_name_.insert(std::make_pair(Key(name, sections[i].sh_type), i));
+  }
+}
+
+int ElfSectionIndex::Find(const char* name, uint32_t type) const {
+  unordered_map<Key, int, KeyHash>::const_iterator it =
+      by_name_.find(Key(name, type));
+  return it == by_name_.end() ? -1 : it->second;
+}
+
+const std::vector<int>& ElfSectionIndex::FindAllOfType(uint32_t type) const {
+  static const std::vector<int> kNone;
+  unordered_map<uint32_t, std::vector<int> >::const_iterator it =
+      by_type_.find(type);
+  return it == by_type_.end() ? kNone : it->second;
+}
+
+bool ElfSectionIndex::FindContents(const char* name, uint32_t type,
+                                   const void** start, size_t* size) const {
+  *start = NULL;
+  *size = 0;
+  int i = Find(name, type);
+  if (i < 0 || sizes_[i] == 0)
+    return false;
+  *start = elf_base_ + offsets_[i];
+  *size = sizes_[i];
+  return true;
+}
+
+bool ElfSectionIndex::Key::operator==(const Key& other) const {
+  return type == other.type && strcmp(name, other.name) == 0;
+}
+
+size_t ElfSectionIndex::KeyHash::operator()(const Key& key) const {
+  size_t hash = static_cast<size_t>(2166136261U);
+  for (const char* p = key.name; *p; p++) {
+    hash ^= static_cast<unsigned char>(*p);
+    hash *= 16777619U;
+  }
+  return hash ^ key.type;
+}
+
+}  // namespace google_breakpad
@@ -0,0 +1,111 @@
+// Copyright (c) 2016, Google Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+// notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above
+// copyright notice, this list of conditions and the following disclaimer
+// in the documentation and/or other materials provided with the
+// distribution.
+//     * Neither the name of Google Inc. nor the names of its
+// contributors may be used to endorse or promote products derived from
+// this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+// elf_section_index.h: Define ElfSectionIndex, which finds the sections
+// of a mapped ELF image by name and type without scanning the section
+// header table each time.
+//
+// FindElfSection and FindElfSectionByName compare names against every
+// section header on every call. That suits code that runs in a crashed
+// process and can't allocate, but dump_syms looks up a dozen sections
+// per image, and images built with -ffunction-sections can have tens of
+// thousands of them.
+
+#ifndef COMMON_LINUX_ELF_SECTION_INDEX_H_
+#define COMMON_LINUX_ELF_SECTION_INDEX_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <vector>
+
+#include "common/unordered.h"
+
+namespace google_breakpad {
+
+class ElfSectionIndex {
+ public:
+  // Index the sections of the ELF image mapped at ELF_BASE, which must
+  // stay mapped as long as this index is used. If ELF_BASE isn't a
+  // 32- or 64-bit ELF image, the index is empty.
+  explicit ElfSectionIndex(const void* elf_base);
+
+  // The ELF class of the image, or ELFCLASSNONE if it isn't one.
+  int elf_class() const { return elf_class_; }
+
+  // Return the number of the first section of type TYPE named NAME, as
+  // FindElfSectionByName would find it, or -1 if there is none. The
+  // number indexes the image's section header table.
+  int Find(const char* name, uint32_t type) const;
+
+  // Return the numbers of the sections of type TYPE, in increasing order.
+  const std::vector<int>& FindAllOfType(uint32_t type) const;
+
+  // Behave like FindElfSection: if the image has a non-empty section of
+  // type TYPE named NAME, set *START and *SIZE to its contents and return
+  // true. Otherwise, set them to NULL and zero and return false.
+  bool FindContents(const char* name, uint32_t type,
+                    const void** start, size_t* size) const;
+
+ private:
+  // A section's name and type. Names point into the image's section
+  // name table.
+  struct Key {
+    Key(const char* name, uint32_t type) : name(name), type(type) { }
+    bool operator==(const Key& other) const;
+    const char* name;
+    uint32_t type;
+  };
+
+  // The FNV-1a hash of the name's bytes, mixed with the type.
+  struct KeyHash {
+    size_t operator()(const Key& key) const;
+  };
+
+  template<typename ElfClass>
+  void Build();
+
+  const char* elf_base_;
+  int elf_class_;
+
+  // Where each section's contents are, by section number.
+  std::vector<uint64_t> offsets_;
+  std::vector<uint64_t> sizes_;
+
+  unordered_map<Key, int, KeyHash> by_name_;
+  unordered_map<uint32_t, std::vector<int> > by_type_;
+
+  // Disallow copy constructor and assignment operator.
+  ElfSectionIndex(const ElfSectionIndex&);
+  void operator=(const ElfSectionIndex&);
+};
+
+}  // namespace google_breakpad
+
+#endif  // COMMON_LINUX_ELF_SECTION_INDEX_H_
@@ -0,0 +1,186 @@
+// Copyright (c) 2016, Google Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+// notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above
+// copyright notice, this list of conditions and the following disclaimer
+// in the documentation and/or other materials provided with the
+// distribution.
+//     * Neither the name of Google Inc. nor the names of its
+// contributors may be used to endorse or promote products derived from
+// this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+// elf_section_index_unittest.cc: Unit tests for ElfSectionIndex.
+
+#include <elf.h>
+#include <string.h>
+
+#include <string>
+#include <vector>
+
+#include "breakpad_googletest_includes.h"
+#include "common/linux/elf_gnu_compat.h"
+#include "common/linux/elf_section_index.h"
+#include "common/linux/elfutils.h"
+#include "common/linux/file_id.h"
+#include "common/linux/synth_elf.h"
+#include "common/test_assembler.h"
+#include "common/using_std_string.h"
+
+using google_breakpad::ElfClass32;
+using google_breakpad::ElfClass64;
+using google_breakpad::ElfSectionIndex;
+using google_breakpad::FileID;
+using google_breakpad::FindElfSection;
+using google_breakpad::kMDGUIDSize;
+using google_breakpad::synth_elf::ELF;
+using google_breakpad::synth_elf::Notes;
+using google_breakpad::test_assembler::kLittleEndian;
+using google_breakpad::test_assembler::Section;
+using std::vector;
+using ::testing::Types;
+
+namespace {
+
+template<typename ElfClass>
+class ElfSectionIndexTest : public testing::Test {
+ public:
+  ElfSectionIndexTest()
+      : elf_(EM_386, ElfClass::kClass, kLittleEndian),
+        text_(kLittleEndian),
+        data_(kLittleEndian),
+        other_data_(kLittleEndian),
+        empty_(kLittleEndian) {
+    for (int i = 0; i < 64; i++)
+      text_.D8(i * 7);
+    data_.Append(16, 0xd1);
+    other_data_.Append(8, 0xd2);
+    text_index_ = elf_.AddSection(".text", text_, SHT_PROGBITS);
+    data_index_ = elf_.AddSection(".data", data_, SHT_PROGBITS);
+    elf_.AddSection(".data", other_data_, SHT_PROGBITS);
+    note_index_ = elf_.AddSection(".data", other_data_, SHT_NOTE);
+    elf_.AddSection(".empty", empty_, SHT_PROGBITS);
+  }
+
+  // Finish elf_ and copy its contents to image_.
+  void Finish() {
+    elf_.Finish();
+    string contents;
+    ASSERT_TRUE(elf_.GetContents(&contents));
+    image_.assign(contents.begin(), contents.end());
+  }
+
+  ELF elf_;
+  Section text_, data_, other_data_, empty_;
+  int text_index_, data_index_, note_index_;
+  vector<uint8_t> image_;
+};
+
+typedef Types<ElfClass32, ElfClass64> ElfClasses;
+
+TYPED_TEST_CASE(ElfSectionIndexTest, ElfClasses);
+
+TYPED_TEST(ElfSectionIndexTest, Find) {
+  this->Finish();
+  ElfSectionIndex index(&this->image_[0]);
+  const int elf_class = TypeParam::kClass;
+  EXPECT_EQ(elf_class, index.elf_class());
+  EXPECT_EQ(this->text_index_, index.Find(".text", SHT_PROGBITS));
+  // The first section of a name and type is found.
+  EXPECT_EQ(this->data_index_, index.Find(".data", SHT_PROGBITS));
+  EXPECT_EQ(this->note_index_, index.Find(".data", SHT_NOTE));
+  EXPECT_EQ(-1, index.Find(".text", SHT_NOTE));
+  EXPECT_EQ(-1, index.Find(".bss", SHT_PROGBITS));
+  EXPECT_EQ(-1, index.Find("", SHT_PROGBITS));
+
+  const vector<int>& notes = index.FindAllOfType(SHT_NOTE);
+  ASSERT_EQ(1U, notes.size());
+  EXPECT_EQ(this->note_index_, notes[0]);
+  EXPECT_EQ(4U, index.FindAllOfType(SHT_PROGBITS).size());
+  EXPECT_TRUE(index.FindAllOfType(SHT_DYNSYM).empty());
+}
+
+// FindContents agrees with FindElfSection.
+TYPED_TEST(ElfSectionIndexTest, FindContents) {
+  this->Finish();
+  const void* image = &this->image_[0];
+  ElfSectionIndex index(image);
+  const char* const kNames[] = { ".text", ".data", ".empty", ".bss" };
+  for (size_t i = 0; i < sizeof(kNames) / sizeof(kNames[0]); i++) {
+    const void* start;
+    size_t size;
+    const void* expected_start;
+    size_t expected_size;
+    bool expected = FindElfSection(image, kNames[i], SHT_PROGBITS,
+                                   &expected_start, &expected_size, NULL);
+    EXPECT_EQ(expected, index.FindContents(kNames[i], SHT_PROGBITS,
+                                           &start, &size)) << kNames[i];
+    EXPECT_EQ(expected_start, start) << kNames[i];
+    EXPECT_EQ(expected_size, size) << kNames[i];
+  }
+  const void* start;
+  size_t size;
+  ASSERT_TRUE(index.FindContents(".data", SHT_PROGBITS, &start, &size));
+  EXPECT_EQ(16U, size);
+  EXPECT_EQ(0xd1, *static_cast<const uint8_t*>(start));
+}
+
+// FileID finds the same identifier with an index as without one.
+TYPED_TEST(ElfSectionIndexTest, FileIdentifier) {
+  const uint8_t kBuildID[] = { 0x10, 0x32, 0x54, 0x76, 0x98, 0xba, 0xdc,
+                               0xfe, 0x01, 0x23, 0x45, 0x67 };
+  Notes notes(kLittleEndian);
+  notes.AddNote(NT_GNU_BUILD_ID, "GNU", kBuildID, sizeof(kBuildID));
+  this->elf_.AddSection(".note.gnu.build-id", notes, SHT_NOTE);
+  this->Finish();
+  ElfSectionIndex index(&this->image_[0]);
+  uint8_t expected[kMDGUIDSize], identifier[kMDGUIDSize];
+  ASSERT_TRUE(FileID::ElfFileIdentifierFromMappedFile(&this->image_[0],
+                                                      expected));
+  ASSERT_TRUE(FileID::ElfFileIdentifierFromMappedFile(&this->image_[0],
+                                                      index, identifier));
+  EXPECT_EQ(0, memcmp(expected, identifier, kMDGUIDSize));
+  EXPECT_EQ(0, memcmp(kBuildID, identifier, sizeof(kBuildID)));
+}
+
+TYPED_TEST(ElfSectionIndexTest, TextHashIdentifier) {
+  this->Finish();
+  ElfSectionIndex index(&this->image_[0]);
+  uint8_t expected[kMDGUIDSize], identifier[kMDGUIDSize];
+  ASSERT_TRUE(FileID::ElfFileIdentifierFromMappedFile(&this->image_[0],
+                                                      expected));
+  ASSERT_TRUE(FileID::ElfFileIdentifierFromMappedFile(&this->image_[0],
+                                                      index, identifier));
+  EXPECT_EQ(0, memcmp(expected, identifier, kMDGUIDSize));
+}
+
+TEST(ElfSectionIndex, NotElf) {
+  const char kNotElf[64] = "not an ELF file";
+  ElfSectionIndex index(kNotElf);
+  EXPECT_EQ(ELFCLASSNONE, index.elf_class());
+  EXPECT_EQ(-1, index.Find(".text", SHT_PROGBITS));
+  EXPECT_TRUE(index.FindAllOfType(SHT_PROGBITS).empty());
+  const void* start;
+  size_t size;
+  EXPECT_FALSE(index.FindContents(".text", SHT_PROGBITS, &start, &size));
+  EXPECT_TRUE(start == NULL);
+}
+
+}  // namespace
@@ -35,6 +35,8 @@
 #include <elf.h>
 #include <string.h>
 
+#include <vector>
+
 #include "common/byte_cursor.h"
 #include "common/module.h"
 
@@ -152,16 +154,20 @@ bool ELFSymbolsToModule(const uint8_t *symtab_section,
   // The iterator walking the symbol table.
   ELFSymbolIterator iterator(&symbols, big_endian, value_size);
 
+  // Gather the externs and hand them to the module all at once, so it can
+  // sort them in one go.
+  std::vector<Module::Extern *> externs;
   while(!iterator->at_end) {
     if (ELF32_ST_TYPE(iterator->info) == STT_FUNC &&
         iterator->shndx != SHN_UNDEF) {
       Module::Extern *ext = new Module::Extern;
       ext->name = SymbolString(iterator->name_offset, strings);
       ext->address = iterator->value;
-      module->AddExtern(ext);
+      externs.push_back(ext);
     }
     ++iterator;
   }
+  module->AddExterns(externs.begin(), externs.end());
   return true;
 }
 
@@ -41,6 +41,7 @@
 #include <algorithm>
 
 #include "common/linux/elf_gnu_compat.h"
+#include "common/linux/elf_section_index.h"
 #include "common/linux/elfutils.h"
 #include "common/linux/linux_libc_support.h"
 #include "common/linux/memory_mapped_file.h"
@@ -87,9 +88,27 @@ static bool ElfClassBuildIDNoteIdentifier(const void *section, size_t length,
   return true;
 }
 
+// Find the section of type |section_type| named |section_name| in the
+// ELF binary at |elf_mapped_base|, using |sections| if it is not NULL,
+// as FindElfSection does.
+static bool FindSection(const void *elf_mapped_base,
+                        const ElfSectionIndex* sections,
+                        const char *section_name,
+                        uint32_t section_type,
+                        const void **section_start,
+                        size_t *section_size) {
+  if (sections) {
+    return sections->FindContents(section_name, section_type,
+                                  section_start, section_size);
+  }
+  return FindElfSection(elf_mapped_base, section_name, section_type,
+                        section_start, section_size, NULL);
+}
+
 // Attempt to locate a .note.gnu.build-id section in an ELF binary
 // and copy as many bytes of it as will fit into |identifier|.
 static bool FindElfBuildIDNote(const void *elf_mapped_base,
+                               const ElfSectionIndex* sections,
                                uint8_t identifier[kMDGUIDSize]) {
   void* note_section;
   size_t note_size;
@@ -97,8 +116,8 @@ static bool FindElfBuildIDNote(const void *elf_mapped_base,
   if ((!FindElfSegment(elf_mapped_base, PT_NOTE,
                        (const void**)&note_section, &note_size, &elfclass) ||
       note_size == 0)  &&
-      (!FindElfSection(elf_mapped_base, ".note.gnu.build-id", SHT_NOTE,
-                       (const void**)&note_section, &note_size, &elfclass) ||
+      (!FindSection(elf_mapped_base, sections, ".note.gnu.build-id",
+                    SHT_NOTE, (const void**)&note_section, &note_size) ||
       note_size == 0)) {
     return false;
   }
@@ -117,11 +136,12 @@ static bool FindElfBuildIDNote(const void *elf_mapped_base,
 // Attempt to locate the .text section of an ELF binary and generate
 // a simple hash by XORing the first page worth of bytes into |identifier|.
 static bool HashElfTextSection(const void *elf_mapped_base,
+                               const ElfSectionIndex* sections,
                                uint8_t identifier[kMDGUIDSize]) {
   void* text_section;
   size_t text_size;
-  if (!FindElfSection(elf_mapped_base, ".text", SHT_PROGBITS,
-                      (const void**)&text_section, &text_size, NULL) ||
+  if (!FindSection(elf_mapped_base, sections, ".text", SHT_PROGBITS,
+                   (const void**)&text_section, &text_size) ||
       text_size == 0) {
     return false;
   }
@@ -141,11 +161,20 @@ static bool HashElfTextSection(const void *elf_mapped_base,
 bool FileID::ElfFileIdentifierFromMappedFile(const void* base,
                                              uint8_t identifier[kMDGUIDSize]) {
   // Look for a build id note first.
-  if (FindElfBuildIDNote(base, identifier))
+  if (FindElfBuildIDNote(base, NULL, identifier))
     return true;
 
   // Fall back on hashing the first page of the text section.
-  return HashElfTextSection(base, identifier);
+  return HashElfTextSection(base, NULL, identifier);
+}
+
+// static
+bool FileID::ElfFileIdentifierFromMappedFile(const void* base,
+                                             const ElfSectionIndex& sections,
+                                             uint8_t identifier[kMDGUIDSize]) {
+  if (FindElfBuildIDNote(base, &sections, identifier))
+    return true;
+  return HashElfTextSection(base, &sections, identifier);
 }
 
 bool FileID::ElfFileIdentifier(uint8_t identifier[kMDGUIDSize]) {
@@ -40,6 +40,8 @@
 
 namespace google_breakpad {
 
+class ElfSectionIndex;
+
 static const size_t kMDGUIDSize = sizeof(MDGUID);
 
 class FileID {
@@ -61,6 +63,12 @@ class FileID {
   static bool ElfFileIdentifierFromMappedFile(const void* base,
                                               uint8_t identifier[kMDGUIDSize]);
 
+  // As above, but find the file's sections using |sections|, an index of
+  // the file mapped at |base|, rather than scanning its section headers.
+  static bool ElfFileIdentifierFromMappedFile(const void* base,
+                                              const ElfSectionIndex& sections,
+                                              uint8_t identifier[kMDGUIDSize]);
+
   // Convert the |identifier| data to a NULL terminated string.  The string will
   // be formatted as a UUID (e.g., 22F065BB-FC9C-49F7-80FE-26A7CEBD7BCE).
   // The |buffer| should be at least 37 bytes long to receive all of the data
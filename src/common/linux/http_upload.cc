@@ -27,10 +27,21 @@
 // (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
 // OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
+
 #include "common/linux/http_upload.h"
 
 #include <assert.h>
 #include <dlfcn.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/select.h>
+#include <sys/stat.h>
+#include <zlib.h>
+
+#include <algorithm>
+
 #include "third_party/curl/curl.h"
 
 namespace {
@@ -47,6 +58,14 @@ static size_t WriteCallback(void *ptr, size_t size,
   return real_size;
 }
 
+// Looks up |name| in the library |handle| and stores it in |function|.
+// Returns true if the symbol was found.
+template<typename Function>
+static bool LoadFunction(void *handle, const char *name, Function *function) {
+  *reinterpret_cast<void **>(function) = dlsym(handle, name);
+  return *function != NULL;
+}
+
 }  // namespace
 
 namespace google_breakpad {
@@ -70,6 +89,272 @@ bool HTTPUpload::SendRequest(const string &url,
   if (!CheckParameters(parameters))
     return false;
 
+  HTTPUploadSession session;
+  if (!session.Init(error_description))
+    return false;
+  session.set_proxy(proxy, proxy_user_pwd);
+  session.set_ca_certificate_file(ca_certificate_file);
+  return session.SendRequest(url, parameters, upload_file, file_part_name,
+                             response_body, response_code,
+                             error_description);
+}
+
+// static
+bool HTTPUpload::CheckParameters(const map<string, string> &parameters) {
+  for (map<string, string>::const_iterator pos = parameters.begin();
+       pos != parameters.end(); ++pos) {
+    const string &str = pos->first;
+    if (str.size() == 0)
+      return false;  // disallow empty parameter names
+    for (unsigned int i = 0; i < str.size(); ++i) {
+      int c = str[i];
+      if (c < 32 || c == '"' || c > 127) {
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+
+// Implementation of HTTPUploadSession.
+
+struct HTTPUploadSession::Curl {
+  Curl() : multi(NULL) {}
+
+  CURL* (*easy_init)(void);
+  CURLcode (*easy_setopt)(CURL *, CURLoption, ...);
+  CURLcode (*easy_getinfo)(CURL *, CURLINFO, ...);
+  void (*easy_reset)(CURL *);
+  void (*easy_cleanup)(CURL *);
+  const char* (*easy_strerror)(CURLcode);
+  struct curl_slist* (*slist_append)(struct curl_slist *, const char *);
+  void (*slist_free_all)(struct curl_slist *);
+  CURLM* (*multi_init)(void);
+  CURLMcode (*multi_add_handle)(CURLM *, CURL *);
+  CURLMcode (*multi_remove_handle)(CURLM *, CURL *);
+  CURLMcode (*multi_perform)(CURLM *, int *);
+  CURLMcode (*multi_fdset)(CURLM *, fd_set *, fd_set *, fd_set *, int *);
+  CURLMcode (*multi_timeout)(CURLM *, long *);
+  CURLMsg* (*multi_info_read)(CURLM *, int *);
+  CURLMcode (*multi_cleanup)(CURLM *);
+
+  // All transfers go through this multi handle, which owns the cache of
+  // open connections.
+  CURLM *multi;
+
+  // Easy handles of finished transfers, ready to be reused.
+  vector<CURL *> idle_handles;
+};
+
+struct HTTPUploadSession::Zlib {
+  int (*deflate_init2)(z_streamp, int, int, int, int, int, const char *, int);
+  int (*deflate)(z_streamp, int);
+  int (*deflate_end)(z_streamp);
+};
+
+// Generates the multipart/form-data body of a request while libcurl reads
+// it, so that the upload file is never held in memory.  If a Zlib is
+// given, the body is gzip compressed on the way.
+class HTTPUploadSession::RequestBody {
+ public:
+  explicit RequestBody(const Zlib *zlib)
+      : zlib_(zlib),
+        file_(NULL),
+        file_size_(0),
+        position_(0),
+        failed_(false),
+        stream_initialized_(false),
+        plain_finished_(false),
+        stream_finished_(false) {
+    memset(&stream_, 0, sizeof(stream_));
+  }
+
+  ~RequestBody() {
+    if (file_)
+      fclose(file_);
+    if (stream_initialized_)
+      zlib_->deflate_end(&stream_);
+  }
+
+  // Opens the upload file and lays out the body.  Returns false, setting
+  // |error_description|, on failure.
+  bool Init(const map<string, string> &parameters,
+            const string &upload_file,
+            const string &file_part_name,
+            const string &boundary,
+            string *error_description) {
+    file_ = fopen(upload_file.c_str(), "rb");
+    struct stat st;
+    if (!file_ || fstat(fileno(file_), &st) != 0) {
+      *error_description = "Could not read " + upload_file + ": " +
+                           strerror(errno);
+      return false;
+    }
+    file_size_ = st.st_size;
+
+    for (map<string, string>::const_iterator iter = parameters.begin();
+         iter != parameters.end(); ++iter) {
+      header_ += "--" + boundary + "\r\n"
+                 "Content-Disposition: form-data; name=\"" + iter->first +
+                 "\"\r\n\r\n" + iter->second + "\r\n";
+    }
+    string::size_type slash = upload_file.rfind('/');
+    string filename = slash == string::npos ?
+                      upload_file : upload_file.substr(slash + 1);
+    header_ += "--" + boundary + "\r\n"
+               "Content-Disposition: form-data; name=\"" + file_part_name +
+               "\"; filename=\"" + filename + "\"\r\n"
+               "Content-Type: application/octet-stream\r\n\r\n";
+    trailer_ = "\r\n--" + boundary + "--\r\n";
+
+    if (zlib_) {
+      // 16 added to the window bits selects the gzip format.
+      if (zlib_->deflate_init2(&stream_, Z_DEFAULT_COMPRESSION, Z_DEFLATED,
+                               15 + 16, 8, Z_DEFAULT_STRATEGY,
+                               ZLIB_VERSION, sizeof(stream_)) != Z_OK) {
+        *error_description = "Could not initialize zlib";
+        return false;
+      }
+      stream_initialized_ = true;
+    }
+    return true;
+  }
+
+  bool compressed() const { return zlib_ != NULL; }
+
+  // The size of the uncompressed body.
+  curl_off_t size() const {
+    return header_.size() + file_size_ + trailer_.size();
+  }
+
+  // True if reading the upload file failed.
+  bool failed() const { return failed_; }
+
+  // libcurl's CURLOPT_READFUNCTION.
+  static size_t ReadCallback(char *buffer, size_t size, size_t nmemb,
+                             void *userp) {
+    RequestBody *body = reinterpret_cast<RequestBody *>(userp);
+    size_t length = size * nmemb;
+    if (!(body->compressed() ? body->ReadCompressed(buffer, &length)
+                             : body->ReadPlain(buffer, &length))) {
+      body->failed_ = true;
+      return CURL_READFUNC_ABORT;
+    }
+    return length;
+  }
+
+ private:
+  // Copies up to |*length| bytes of the uncompressed body, starting at
+  // |position_|, to |buffer|, and sets |*length| to the number copied.
+  // Returns false if the upload file could not be read.
+  bool ReadPlain(char *buffer, size_t *length) {
+    size_t done = 0;
+    while (done < *length) {
+      size_t file_start = header_.size();
+      size_t file_end = file_start + file_size_;
+      size_t count;
+      if (position_ < file_start) {
+        count = std::min(*length - done, file_start - position_);
+        memcpy(buffer + done, header_.data() + position_, count);
+      } else if (position_ < file_end) {
+        count = fread(buffer + done, 1,
+                      std::min(*length - done, file_end - position_), file_);
+        if (count == 0)
+          return false;
+      } else if (position_ < file_end + trailer_.size()) {
+        count = std::min(*length - done,
+                         file_end + trailer_.size() - position_);
+        memcpy(buffer + done, trailer_.data() + position_ - file_end, count);
+      } else {
+        break;
+      }
+      done += count;
+      position_ += count;
+    }
+    *length = done;
+    return true;
+  }
+
+  // Fills |buffer| with up to |*length| bytes of the compressed body,
+  // and sets |*length| to the number produced.  Returns false on failure.
+  bool ReadCompressed(char *buffer, size_t *length) {
+    stream_.next_out = reinterpret_cast<Bytef *>(buffer);
+    stream_.avail_out = *length;
+    while (stream_.avail_out > 0 && !stream_finished_) {
+      if (stream_.avail_in == 0 && !plain_finished_) {
+        size_t input_length = sizeof(input_);
+        if (!ReadPlain(input_, &input_length))
+          return false;
+        plain_finished_ = input_length == 0;
+        stream_.next_in = reinterpret_cast<Bytef *>(input_);
+        stream_.avail_in = input_length;
+      }
+      int result = zlib_->deflate(&stream_,
+                                  plain_finished_ ? Z_FINISH : Z_NO_FLUSH);
+      if (result == Z_STREAM_END) {
+        stream_finished_ = true;
+      } else if (result != Z_OK && result != Z_BUF_ERROR) {
+        return false;
+      }
+    }
+    *length -= stream_.avail_out;
+    return true;
+  }
+
+  const Zlib *zlib_;
+
+  string header_;   // The parameters and the file part's headers.
+  FILE *file_;
+  size_t file_size_;
+  string trailer_;  // The final boundary.
+  size_t position_;  // Offset in the uncompressed body.
+  bool failed_;
+
+  z_stream stream_;
+  bool stream_initialized_;
+  bool plain_finished_;   // All of the uncompressed body is in |stream_|.
+  bool stream_finished_;  // All of the compressed body has been produced.
+  char input_[64 * 1024];
+};
+
+struct HTTPUploadSession::Transfer {
+  Transfer() : request(NULL), handle(NULL), body(NULL), headers(NULL) {}
+
+  HTTPUploadSession::Request *request;
+  CURL *handle;
+  RequestBody *body;
+  struct curl_slist *headers;
+};
+
+HTTPUploadSession::HTTPUploadSession()
+    : curl_lib_(NULL),
+      curl_(NULL),
+      zlib_lib_(NULL),
+      zlib_(NULL),
+      zlib_tried_(false),
+      compress_(false) {
+}
+
+HTTPUploadSession::~HTTPUploadSession() {
+  if (curl_) {
+    for (size_t i = 0; i < curl_->idle_handles.size(); ++i)
+      curl_->easy_cleanup(curl_->idle_handles[i]);
+    if (curl_->multi)
+      curl_->multi_cleanup(curl_->multi);
+    delete curl_;
+  }
+  if (curl_lib_)
+    dlclose(curl_lib_);
+  delete zlib_;
+  if (zlib_lib_)
+    dlclose(zlib_lib_);
+}
+
+bool HTTPUploadSession::Init(string *error_description) {
+  if (curl_)
+    return true;
+
   // We may have been linked statically; if curl_easy_init is in the
   // current binary, no need to search for a dynamic version.
   void* curl_lib = dlopen(NULL, RTLD_NOW);
@@ -98,119 +383,273 @@ bool HTTPUpload::SendRequest(const string &url,
     return false;
   }
 
-  CURL* (*curl_easy_init)(void);
-  *(void**) (&curl_easy_init) = dlsym(curl_lib, "curl_easy_init");
-  CURL *curl = (*curl_easy_init)();
+  Curl *curl = new Curl;
+  if (!LoadFunction(curl_lib, "curl_easy_init", &curl->easy_init) ||
+      !LoadFunction(curl_lib, "curl_easy_setopt", &curl->easy_setopt) ||
+      !LoadFunction(curl_lib, "curl_easy_getinfo", &curl->easy_getinfo) ||
+      !LoadFunction(curl_lib, "curl_easy_reset", &curl->easy_reset) ||
+      !LoadFunction(curl_lib, "curl_easy_cleanup", &curl->easy_cleanup) ||
+      !LoadFunction(curl_lib, "curl_easy_strerror", &curl->easy_strerror) ||
+      !LoadFunction(curl_lib, "curl_slist_append", &curl->slist_append) ||
+      !LoadFunction(curl_lib, "curl_slist_free_all", &curl->slist_free_all) ||
+      !LoadFunction(curl_lib, "curl_multi_init", &curl->multi_init) ||
+      !LoadFunction(curl_lib, "curl_multi_add_handle",
+                    &curl->multi_add_handle) ||
+      !LoadFunction(curl_lib, "curl_multi_remove_handle",
+                    &curl->multi_remove_handle) ||
+      !LoadFunction(curl_lib, "curl_multi_perform", &curl->multi_perform) ||
+      !LoadFunction(curl_lib, "curl_multi_fdset", &curl->multi_fdset) ||
+      !LoadFunction(curl_lib, "curl_multi_timeout", &curl->multi_timeout) ||
+      !LoadFunction(curl_lib, "curl_multi_info_read",
+                    &curl->multi_info_read) ||
+      !LoadFunction(curl_lib, "curl_multi_cleanup", &curl->multi_cleanup) ||
+      !(curl->multi = curl->multi_init())) {
+    if (error_description != NULL)
+      *error_description = "libcurl is missing required functions";
+    delete curl;
+    dlclose(curl_lib);
+    return false;
+  }
+
+  curl_lib_ = curl_lib;
+  curl_ = curl;
   if (error_description != NULL)
     *error_description = "No Error";
+  return true;
+}
 
-  if (!curl) {
-    dlclose(curl_lib);
+bool HTTPUploadSession::SendRequest(const string &url,
+                                    const map<string, string> &parameters,
+                                    const string &upload_file,
+                                    const string &file_part_name,
+                                    string *response_body,
+                                    long *response_code,
+                                    string *error_description) {
+  vector<Request> requests(1);
+  Request &request = requests[0];
+  request.url = url;
+  request.parameters = parameters;
+  request.upload_file = upload_file;
+  request.file_part_name = file_part_name;
+  SendRequests(&requests, 1);
+
+  if (response_body != NULL)
+    response_body->swap(request.response_body);
+  if (response_code != NULL)
+    *response_code = request.response_code;
+  if (error_description != NULL)
+    *error_description = request.error_description;
+  return request.success;
+}
+
+bool HTTPUploadSession::SendRequests(vector<Request> *requests,
+                                     int max_concurrent) {
+  if (max_concurrent < 1)
+    max_concurrent = 1;
+
+  vector<Transfer> transfers(requests->size());
+  size_t next = 0;
+  int running = 0;
+  bool all_succeeded = true;
+  while (true) {
+    while (running < max_concurrent && next < requests->size()) {
+      if (StartTransfer(&(*requests)[next], &transfers[next])) {
+        ++running;
+      } else {
+        all_succeeded = false;
+      }
+      ++next;
+    }
+    if (running == 0)
+      break;
+
+    int still_running;
+    while (curl_->multi_perform(curl_->multi, &still_running) ==
+           CURLM_CALL_MULTI_PERFORM) {
+    }
+
+    bool finished_any = false;
+    int queued;
+    while (CURLMsg *message = curl_->multi_info_read(curl_->multi,
+                                                     &queued)) {
+      if (message->msg != CURLMSG_DONE)
+        continue;
+      char *transfer;
+      curl_->easy_getinfo(message->easy_handle, CURLINFO_PRIVATE, &transfer);
+      FinishTransfer(reinterpret_cast<Transfer *>(transfer),
+                     message->data.result);
+      if (!reinterpret_cast<Transfer *>(transfer)->request->success)
+        all_succeeded = false;
+      --running;
+      finished_any = true;
+    }
+    if (!finished_any && still_running > 0)
+      Wait();
+  }
+  return all_succeeded;
+}
+
+bool HTTPUploadSession::LoadZlib() {
+  if (!zlib_tried_) {
+    zlib_tried_ = true;
+    zlib_lib_ = dlopen("libz.so.1", RTLD_NOW);
+    if (!zlib_lib_)
+      zlib_lib_ = dlopen("libz.so", RTLD_NOW);
+    if (zlib_lib_) {
+      Zlib *zlib = new Zlib;
+      if (LoadFunction(zlib_lib_, "deflateInit2_", &zlib->deflate_init2) &&
+          LoadFunction(zlib_lib_, "deflate", &zlib->deflate) &&
+          LoadFunction(zlib_lib_, "deflateEnd", &zlib->deflate_end)) {
+        zlib_ = zlib;
+      } else {
+        delete zlib;
+      }
+    }
+  }
+  return zlib_ != NULL;
+}
+
+bool HTTPUploadSession::StartTransfer(Request *request, Transfer *transfer) {
+  request->response_body.clear();
+  request->response_code = 0;
+  request->success = false;
+  if (!curl_) {
+    request->error_description = "libcurl is not loaded";
+    return false;
+  }
+  if (!HTTPUpload::CheckParameters(request->parameters)) {
+    request->error_description = "Invalid parameter name";
     return false;
   }
 
-  CURLcode err_code = CURLE_OK;
-  CURLcode (*curl_easy_setopt)(CURL *, CURLoption, ...);
-  *(void**) (&curl_easy_setopt) = dlsym(curl_lib, "curl_easy_setopt");
-  (*curl_easy_setopt)(curl, CURLOPT_URL, url.c_str());
-  (*curl_easy_setopt)(curl, CURLOPT_USERAGENT, kUserAgent);
+  RequestBody *body = NULL;
+  char boundary[64];
+  if (!request->head_only) {
+    snprintf(boundary, sizeof(boundary),
+             "---------------------------%08x%08x", rand(), rand());
+    body = new RequestBody(compress_ && LoadZlib() ? zlib_ : NULL);
+    if (!body->Init(request->parameters, request->upload_file,
+                    request->file_part_name, boundary,
+                    &request->error_description)) {
+      delete body;
+      return false;
+    }
+  }
+
+  CURL *curl;
+  if (!curl_->idle_handles.empty()) {
+    curl = curl_->idle_handles.back();
+    curl_->idle_handles.pop_back();
+    curl_->easy_reset(curl);
+  } else if (!(curl = curl_->easy_init())) {
+    request->error_description = "Curl initialization failed";
+    delete body;
+    return false;
+  }
+
+  curl_->easy_setopt(curl, CURLOPT_URL, request->url.c_str());
+  curl_->easy_setopt(curl, CURLOPT_USERAGENT, kUserAgent);
   // Set proxy information if necessary.
-  if (!proxy.empty())
-    (*curl_easy_setopt)(curl, CURLOPT_PROXY, proxy.c_str());
-  if (!proxy_user_pwd.empty())
-    (*curl_easy_setopt)(curl, CURLOPT_PROXYUSERPWD, proxy_user_pwd.c_str());
-
-  if (!ca_certificate_file.empty())
-    (*curl_easy_setopt)(curl, CURLOPT_CAINFO, ca_certificate_file.c_str());
-
-  struct curl_httppost *formpost = NULL;
-  struct curl_httppost *lastptr = NULL;
-  // Add form data.
-  CURLFORMcode (*curl_formadd)(struct curl_httppost **, struct curl_httppost **, ...);
-  *(void**) (&curl_formadd) = dlsym(curl_lib, "curl_formadd");
-  map<string, string>::const_iterator iter = parameters.begin();
-  for (; iter != parameters.end(); ++iter)
-    (*curl_formadd)(&formpost, &lastptr,
-                 CURLFORM_COPYNAME, iter->first.c_str(),
-                 CURLFORM_COPYCONTENTS, iter->second.c_str(),
-                 CURLFORM_END);
-
-  // Add form file.
-  (*curl_formadd)(&formpost, &lastptr,
-               CURLFORM_COPYNAME, file_part_name.c_str(),
-               CURLFORM_FILE, upload_file.c_str(),
-               CURLFORM_END);
-
-  (*curl_easy_setopt)(curl, CURLOPT_HTTPPOST, formpost);
-
-  // Disable 100-continue header.
-  struct curl_slist *headerlist = NULL;
-  char buf[] = "Expect:";
-  struct curl_slist* (*curl_slist_append)(struct curl_slist *, const char *);
-  *(void**) (&curl_slist_append) = dlsym(curl_lib, "curl_slist_append");
-  headerlist = (*curl_slist_append)(headerlist, buf);
-  (*curl_easy_setopt)(curl, CURLOPT_HTTPHEADER, headerlist);
-
-  if (response_body != NULL) {
-    (*curl_easy_setopt)(curl, CURLOPT_WRITEFUNCTION, WriteCallback);
-    (*curl_easy_setopt)(curl, CURLOPT_WRITEDATA,
-                     reinterpret_cast<void *>(response_body));
+  if (!proxy_.empty())
+    curl_->easy_setopt(curl, CURLOPT_PROXY, proxy_.c_str());
+  if (!proxy_user_pwd_.empty())
+    curl_->easy_setopt(curl, CURLOPT_PROXYUSERPWD, proxy_user_pwd_.c_str());
+  if (!ca_certificate_file_.empty())
+    curl_->easy_setopt(curl, CURLOPT_CAINFO, ca_certificate_file_.c_str());
+
+  struct curl_slist *headers = NULL;
+  if (request->head_only) {
+    curl_->easy_setopt(curl, CURLOPT_NOBODY, 1L);
+  } else {
+    curl_->easy_setopt(curl, CURLOPT_POST, 1L);
+    curl_->easy_setopt(curl, CURLOPT_READFUNCTION,
+                       RequestBody::ReadCallback);
+    curl_->easy_setopt(curl, CURLOPT_READDATA, body);
+
+    // Disable 100-continue header.
+    headers = curl_->slist_append(headers, "Expect:");
+    string content_type =
+        string("Content-Type: multipart/form-data; boundary=") + boundary;
+    headers = curl_->slist_append(headers, content_type.c_str());
+    if (body->compressed()) {
+      // The compressed size isn't known until the body has been sent.
+      headers = curl_->slist_append(headers, "Content-Encoding: gzip");
+      headers = curl_->slist_append(headers, "Transfer-Encoding: chunked");
+    } else {
+      curl_->easy_setopt(curl, CURLOPT_POSTFIELDSIZE_LARGE, body->size());
+    }
   }
+  curl_->easy_setopt(curl, CURLOPT_HTTPHEADER, headers);
+
+  curl_->easy_setopt(curl, CURLOPT_WRITEFUNCTION, WriteCallback);
+  curl_->easy_setopt(curl, CURLOPT_WRITEDATA,
+                     reinterpret_cast<void *>(&request->response_body));
 
   // Fail if 400+ is returned from the web server.
-  (*curl_easy_setopt)(curl, CURLOPT_FAILONERROR, 1);
-
-  CURLcode (*curl_easy_perform)(CURL *);
-  *(void**) (&curl_easy_perform) = dlsym(curl_lib, "curl_easy_perform");
-  err_code = (*curl_easy_perform)(curl);
-  if (response_code != NULL) {
-    CURLcode (*curl_easy_getinfo)(CURL *, CURLINFO, ...);
-    *(void**) (&curl_easy_getinfo) = dlsym(curl_lib, "curl_easy_getinfo");
-    (*curl_easy_getinfo)(curl, CURLINFO_RESPONSE_CODE, response_code);
-  }
-  const char* (*curl_easy_strerror)(CURLcode);
-  *(void**) (&curl_easy_strerror) = dlsym(curl_lib, "curl_easy_strerror");
+  curl_->easy_setopt(curl, CURLOPT_FAILONERROR, 1L);
+  curl_->easy_setopt(curl, CURLOPT_PRIVATE, transfer);
+
+  transfer->request = request;
+  transfer->handle = curl;
+  transfer->body = body;
+  transfer->headers = headers;
+  if (curl_->multi_add_handle(curl_->multi, curl) != CURLM_OK) {
+    FinishTransfer(transfer, CURLE_FAILED_INIT);
+    request->error_description = "Could not start the transfer";
+    return false;
+  }
+  return true;
+}
+
+void HTTPUploadSession::FinishTransfer(Transfer *transfer, int result) {
+  CURLcode err_code = static_cast<CURLcode>(result);
+  Request *request = transfer->request;
+  curl_->easy_getinfo(transfer->handle, CURLINFO_RESPONSE_CODE,
+                      &request->response_code);
 #ifndef NDEBUG
-  if (err_code != CURLE_OK)
+  // A failed HEAD request just means that the URL doesn't exist.
+  if (err_code != CURLE_OK && !request->head_only)
     fprintf(stderr, "Failed to send http request to %s, error: %s\n",
-            url.c_str(),
-            (*curl_easy_strerror)(err_code));
+            request->url.c_str(),
+            curl_->easy_strerror(err_code));
 #endif
-  if (error_description != NULL)
-    *error_description = (*curl_easy_strerror)(err_code);
-
-  void (*curl_easy_cleanup)(CURL *);
-  *(void**) (&curl_easy_cleanup) = dlsym(curl_lib, "curl_easy_cleanup");
-  (*curl_easy_cleanup)(curl);
-  if (formpost != NULL) {
-    void (*curl_formfree)(struct curl_httppost *);
-    *(void**) (&curl_formfree) = dlsym(curl_lib, "curl_formfree");
-    (*curl_formfree)(formpost);
-  }
-  if (headerlist != NULL) {
-    void (*curl_slist_free_all)(struct curl_slist *);
-    *(void**) (&curl_slist_free_all) = dlsym(curl_lib, "curl_slist_free_all");
-    (*curl_slist_free_all)(headerlist);
-  }
-  dlclose(curl_lib);
-  return err_code == CURLE_OK;
+  if (transfer->body && transfer->body->failed()) {
+    request->error_description =
+        "Could not read " + request->upload_file;
+  } else {
+    request->error_description = curl_->easy_strerror(err_code);
+  }
+  request->success = err_code == CURLE_OK;
+
+  curl_->multi_remove_handle(curl_->multi, transfer->handle);
+  curl_->idle_handles.push_back(transfer->handle);
+  curl_->slist_free_all(transfer->headers);
+  delete transfer->body;
+  transfer->handle = NULL;
+  transfer->body = NULL;
+  transfer->headers = NULL;
 }
 
-// static
-bool HTTPUpload::CheckParameters(const map<string, string> &parameters) {
-  for (map<string, string>::const_iterator pos = parameters.begin();
-       pos != parameters.end(); ++pos) {
-    const string &str = pos->first;
-    if (str.size() == 0)
-      return false;  // disallow empty parameter names
-    for (unsigned int i = 0; i < str.size(); ++i) {
-      int c = str[i];
-      if (c < 32 || c == '"' || c > 127) {
-        return false;
-      }
-    }
-  }
-  return true;
+void HTTPUploadSession::Wait() {
+  long timeout_ms = -1;
+  curl_->multi_timeout(curl_->multi, &timeout_ms);
+  if (timeout_ms == 0)
+    return;
+  // libcurl may not know when it next needs to run; check back soon.
+  if (timeout_ms < 0 || timeout_ms > 100)
+    timeout_ms = 100;
+
+  fd_set read_fds, write_fds, error_fds;
+  FD_ZERO(&read_fds);
+  FD_ZERO(&write_fds);
+  FD_ZERO(&error_fds);
+  int max_fd = -1;
+  curl_->multi_fdset(curl_->multi, &read_fds, &write_fds, &error_fds,
+                     &max_fd);
+  struct timeval timeout;
+  timeout.tv_sec = timeout_ms / 1000;
+  timeout.tv_usec = (timeout_ms % 1000) * 1000;
+  select(max_fd + 1, &read_fds, &write_fds, &error_fds, &timeout);
 }
 
 }  // namespace google_breakpad
@@ -30,18 +30,22 @@
 // HTTPUpload provides a "nice" API to send a multipart HTTP(S) POST
 // request using libcurl.  It currently supports requests that contain
 // a set of string parameters (key/value pairs), and a file to upload.
+// HTTPUploadSession sends the same requests, but keeps connections open
+// between them and can compress the request body.
 
 #ifndef COMMON_LINUX_HTTP_UPLOAD_H__
 #define COMMON_LINUX_HTTP_UPLOAD_H__
 
 #include <map>
 #include <string>
+#include <vector>
 
 #include "common/using_std_string.h"
 
 namespace google_breakpad {
 
 using std::map;
+using std::vector;
 
 class HTTPUpload {
  public:
@@ -75,6 +79,8 @@ class HTTPUpload {
   // any quote (") characters.  Returns true if so.
   static bool CheckParameters(const map<string, string> &parameters);
 
+  friend class HTTPUploadSession;
+
   // No instances of this class should be created.
   // Disallow all constructors, destructors, and operator=.
   HTTPUpload();
@@ -83,6 +89,111 @@ class HTTPUpload {
   ~HTTPUpload();
 };
 
+// HTTPUploadSession keeps libcurl loaded and reuses its connections from
+// one request to the next, so that sending many files to the same server
+// pays for the TCP and TLS handshakes only once.  Requests can be sent one
+// at a time or as a batch that is transferred concurrently.  The upload
+// file is streamed from disk, and can be gzip compressed on the way.
+// A session must only be used by one thread at a time.
+class HTTPUploadSession {
+ public:
+  // A request for SendRequests.  The fields below |file_part_name| are
+  // filled in when the request completes, as described for
+  // HTTPUpload::SendRequest.  If |head_only| is true, the request is a
+  // HEAD request for |url|, which checks whether it exists without
+  // uploading anything; the parameters and upload file are ignored.
+  struct Request {
+    Request() : head_only(false), response_code(0), success(false) {}
+
+    string url;
+    bool head_only;
+    map<string, string> parameters;
+    string upload_file;
+    string file_part_name;
+
+    string response_body;
+    long response_code;
+    string error_description;
+    bool success;
+  };
+
+  HTTPUploadSession();
+  ~HTTPUploadSession();
+
+  // Loads libcurl.  Returns false if it can't be found, setting
+  // error_description if it is non-NULL.  Requests fail until Init
+  // has succeeded.
+  bool Init(string *error_description);
+
+  void set_proxy(const string &proxy, const string &proxy_user_pwd) {
+    proxy_ = proxy;
+    proxy_user_pwd_ = proxy_user_pwd;
+  }
+  void set_ca_certificate_file(const string &ca_certificate_file) {
+    ca_certificate_file_ = ca_certificate_file;
+  }
+
+  // If true, request bodies are gzip compressed while they are sent, with
+  // "Content-Encoding: gzip" and chunked transfer encoding; the server
+  // must accept both.  Bodies are sent uncompressed if zlib can't be
+  // loaded.  Defaults to false.
+  void set_compress(bool compress) { compress_ = compress; }
+
+  // Sends a request, with the same arguments and results as
+  // HTTPUpload::SendRequest.
+  bool SendRequest(const string &url,
+                   const map<string, string> &parameters,
+                   const string &upload_file,
+                   const string &file_part_name,
+                   string *response_body,
+                   long *response_code,
+                   string *error_description);
+
+  // Sends all of |requests|, with up to |max_concurrent| of them in
+  // flight at a time, and fills in their results.  Returns true if every
+  // request succeeded.
+  bool SendRequests(vector<Request> *requests, int max_concurrent);
+
+ private:
+  // The libcurl entry points, and the handles kept between requests.
+  struct Curl;
+  // The zlib entry points.
+  struct Zlib;
+  // Produces the body of a request as libcurl reads it.
+  class RequestBody;
+  // A request that libcurl is transferring.
+  struct Transfer;
+
+  // Loads zlib if it hasn't been tried yet.  Returns true if it is loaded.
+  bool LoadZlib();
+
+  // Sets up the transfer of |request| and hands it to libcurl.  Returns
+  // false, with the error in |request|, if the request can't be sent.
+  bool StartTransfer(Request *request, Transfer *transfer);
+
+  // Records the results of |transfer| in its request and releases the
+  // resources it held.
+  void FinishTransfer(Transfer *transfer, int result);
+
+  // Waits until libcurl has work to do for the running transfers.
+  void Wait();
+
+  void *curl_lib_;
+  Curl *curl_;
+  void *zlib_lib_;
+  Zlib *zlib_;
+  bool zlib_tried_;
+
+  string proxy_;
+  string proxy_user_pwd_;
+  string ca_certificate_file_;
+  bool compress_;
+
+  // Disallow copy constructor and operator=.
+  explicit HTTPUploadSession(const HTTPUploadSession &);
+  void operator=(const HTTPUploadSession &);
+};
+
 }  // namespace google_breakpad
 
 #endif  // COMMON_LINUX_HTTP_UPLOAD_H__
@@ -75,7 +75,8 @@ int tkill(pid_t tid, int sig) {
   return syscall(__NR_tkill, tid, sig);
 }
 
-// Core file size limit set to 1 MB, which is big enough for test purposes.
+// Default core file size limit of 1 MB, which is big enough for most test
+// purposes.
 const rlim_t kCoreSizeLimit = 1024 * 1024;
 
 void *thread_function(void *data) {
@@ -98,7 +99,8 @@ namespace google_breakpad {
 
 CrashGenerator::CrashGenerator()
     : shared_memory_(NULL),
-      shared_memory_size_(0) {
+      shared_memory_size_(0),
+      core_size_limit_(kCoreSizeLimit) {
 }
 
 CrashGenerator::~CrashGenerator() {
@@ -188,7 +190,7 @@ bool CrashGenerator::CreateChildCrash(
       perror("CrashGenerator: Failed to change directory");
       exit(1);
     }
-    if (SetCoreFileSizeLimit(kCoreSizeLimit)) {
+    if (SetCoreFileSizeLimit(core_size_limit_)) {
       CreateThreadsInChildProcess(num_threads);
       string proc_dir = GetDirectoryOfProcFilesCopy();
       if (mkdir(proc_dir.c_str(), 0755) == -1) {
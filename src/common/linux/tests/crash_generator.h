@@ -65,6 +65,11 @@ class CrashGenerator {
   // Returns the directory of a copy of proc files of the child process.
   string GetDirectoryOfProcFilesCopy() const;
 
+  // Sets the core file size limit that CreateChildCrash() gives the child
+  // process.  The default of 1 MB holds the notes but not, as a rule, the
+  // memory of every thread.
+  void set_core_size_limit(rlim_t limit) { core_size_limit_ = limit; }
+
   // Creates a crash (and a core dump file) by creating a child process with
   // |num_threads| threads, and the terminating the child process by sending
   // a signal with number |crash_signal| to the |crash_thread|-th thread.
@@ -110,6 +115,9 @@ class CrashGenerator {
 
   // Number of bytes mapped for |shared_memory_|.
   size_t shared_memory_size_;
+
+  // Core file size limit of the child process.
+  rlim_t core_size_limit_;
 };
 
 }  // namespace google_breakpad
@@ -56,6 +56,12 @@
 
 // Set the data and return the response
 - (NSData *)send:(NSError **)error;
+
+// Writes the body that send: would send to |path|, and returns the request
+// to send it with, for uploading from a file with NSURLSession.  Returns nil
+// if the file can't be written.
+- (NSURLRequest *)requestWithBodyWrittenToFile:(NSString *)path
+                                         error:(NSError **)error;
 - (NSHTTPURLResponse *)response;
 
 @end
@@ -37,6 +37,9 @@
 - (NSData *)formDataForKey:(NSString *)key value:(NSString *)value;
 - (NSData *)formDataForFileContents:(NSData *)contents name:(NSString *)name;
 - (NSData *)formDataForFile:(NSString *)file name:(NSString *)name;
+// The POST request, without its body, and the body.
+- (NSMutableURLRequest *)postRequest;
+- (NSData *)postBody;
 @end
 
 @implementation HTTPMultipartUpload
@@ -142,16 +145,22 @@
 }
 
 //=============================================================================
-- (NSData *)send:(NSError **)error {
+- (NSMutableURLRequest *)postRequest {
   NSMutableURLRequest *req =
     [[NSMutableURLRequest alloc]
           initWithURL:url_ cachePolicy:NSURLRequestUseProtocolCachePolicy
       timeoutInterval:10.0 ];
 
-  NSMutableData *postBody = [NSMutableData data];
-
   [req setValue:[NSString stringWithFormat:@"multipart/form-data; boundary=%@",
     boundary_] forHTTPHeaderField:@"Content-type"];
+  [req setHTTPMethod:@"POST"];
+
+  return [req autorelease];
+}
+
+//=============================================================================
+- (NSData *)postBody {
+  NSMutableData *postBody = [NSMutableData data];
 
   // Add any parameters to the message
   NSArray *parameterKeys = [parameters_ allKeys];
@@ -185,8 +194,13 @@
   NSString *epilogue = [NSString stringWithFormat:@"\r\n--%@--\r\n", boundary_];
   [postBody appendData:[epilogue dataUsingEncoding:NSUTF8StringEncoding]];
 
-  [req setHTTPBody:postBody];
-  [req setHTTPMethod:@"POST"];
+  return postBody;
+}
+
+//=============================================================================
+- (NSData *)send:(NSError **)error {
+  NSMutableURLRequest *req = [self postRequest];
+  [req setHTTPBody:[self postBody]];
 
   [response_ release];
   response_ = nil;
@@ -200,11 +214,19 @@
                                              error:error];
     [response_ retain];
   }
-  [req release];
 
   return data;
 }
 
+//=============================================================================
+- (NSURLRequest *)requestWithBodyWrittenToFile:(NSString *)path
+                                         error:(NSError **)error {
+  if (![[self postBody] writeToFile:path options:NSDataWritingAtomic
+                              error:error])
+    return nil;
+  return [self postRequest];
+}
+
 //=============================================================================
 - (NSHTTPURLResponse *)response {
   return response_;
@@ -237,6 +237,10 @@ class MachMessage {
 class MachReceiveMessage : public MachMessage {
  public:
   MachReceiveMessage() : MachMessage() {};
+
+  // The port the message was received on, which tells messages received
+  // on a port set apart
+  mach_port_t GetLocalPort() const { return head.msgh_local_port; }
 };
 
 //==============================================================================
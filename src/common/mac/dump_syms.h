@@ -59,12 +59,12 @@ class DumpSymbols {
         input_pathname_(),
         object_filename_(),
         contents_(),
-        selected_object_file_(),
-        selected_object_name_() { }
+        contents_size_(),
+        selected_object_file_() { }
   ~DumpSymbols() {
     [input_pathname_ release];
     [object_filename_ release];
-    [contents_ release];
+    UnmapContents();
   }
 
   // Prepare to read debugging information from |filename|. |filename| may be
@@ -122,18 +122,50 @@ class DumpSymbols {
   // module object and must delete it when finished.
   bool ReadSymbolData(Module** module);
 
+  // Read the debugging information of every object file in this dumper's
+  // file, each on its own thread, ignoring the selected architecture. Store
+  // one module per object file in |modules|, in the order
+  // AvailableArchitectures lists them; an object file that could not be read
+  // gets a NULL entry. The caller owns the modules. Return true if every
+  // object file was read; otherwise, report the problems and return false.
+  bool ReadAllSymbolData(vector<Module*> *modules);
+
  private:
   // Used internally.
   class DumperLineToModule;
   class LoadCommandDumper;
+  struct ObjectFileJob;
+
+  // Map object_filename_ into memory as contents_. On failure, report the
+  // problem and return false.
+  bool MapContents();
+
+  // Unmap contents_, if it is mapped.
+  void UnmapContents();
+
+  // Return an identifier string for |object_file|, one of the object files
+  // in object_files_.
+  std::string Identifier(const struct fat_arch *object_file);
 
-  // Return an identifier string for the file this DumpSymbols is dumping.
-  std::string Identifier();
+  // Gather into |job| everything needed to read |object_file|, so that
+  // ReadObjectFile can run without touching Foundation objects or this
+  // dumper's mutable state. On failure, report the problem and return false.
+  bool PrepareObjectFileJob(const struct fat_arch *object_file,
+                            ObjectFileJob *job);
+
+  // Read the object file described by |job| into a new module, stored in
+  // job->module. Several calls may run at once on different jobs.
+  bool ReadObjectFile(ObjectFileJob *job) const;
+
+  // A pthread start routine that calls ReadObjectFile on an ObjectFileJob.
+  static void *ReadObjectFileThread(void *job);
 
   // Read debugging information from |dwarf_sections|, which was taken from
   // |macho_reader|, and add it to |module|. On success, return true;
   // on failure, report the problem and return false.
+  // |object_name| identifies the object file in error messages.
   bool ReadDwarf(google_breakpad::Module *module,
+                 const string &object_name,
                  const mach_o::Reader &macho_reader,
                  const mach_o::SectionMap &dwarf_sections,
                  bool handle_inter_cu_refs) const;
@@ -144,6 +176,7 @@ class DumpSymbols {
   // .debug_frame data. On success, return true; on failure, report
   // the problem and return false.
   bool ReadCFI(google_breakpad::Module *module,
+               const string &object_name,
                const mach_o::Reader &macho_reader,
                const mach_o::Section &section,
                bool eh_frame) const;
@@ -164,8 +197,11 @@ class DumpSymbols {
   // within that bundle.
   NSString *object_filename_;
 
-  // The complete contents of object_filename_, mapped into memory.
-  NSData *contents_;
+  // The complete contents of object_filename_, mapped read-only into
+  // memory, and its size. Sections are parsed in place, so pages are read
+  // from the file only when the debugging information in them is needed.
+  const uint8_t *contents_;
+  size_t contents_size_;
 
   // A vector of fat_arch structures describing the object files
   // object_filename_ contains. If object_filename_ refers to a fat binary,
@@ -176,12 +212,6 @@ class DumpSymbols {
   // The object file in object_files_ selected to dump, or NULL if
   // SetArchitecture hasn't been called yet.
   const struct fat_arch *selected_object_file_;
-
-  // A string that identifies the selected object file, for use in error
-  // messages.  This is usually object_filename_, but if that refers to a
-  // fat binary, it includes an indication of the particular architecture
-  // within that binary.
-  string selected_object_name_;
 };
 
 }  // namespace google_breakpad
@@ -36,9 +36,16 @@
 #include "common/mac/dump_syms.h"
 
 #include <Foundation/Foundation.h>
+#include <errno.h>
+#include <fcntl.h>
 #include <mach-o/arch.h>
 #include <mach-o/fat.h>
+#include <pthread.h>
 #include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
 #include <ostream>
 #include <string>
@@ -134,37 +141,14 @@ bool DumpSymbols::Read(NSString *filename) {
     object_filename_ = [input_pathname_ retain];
   }
 
-  // Read the file's contents into memory.
-  //
-  // The documentation for dataWithContentsOfMappedFile says:
-  //
-  //     Because of file mapping restrictions, this method should only be
-  //     used if the file is guaranteed to exist for the duration of the
-  //     data object’s existence. It is generally safer to use the
-  //     dataWithContentsOfFile: method.
-  //
-  // I gather this means that OS X doesn't have (or at least, that method
-  // doesn't use) a form of mapping like Linux's MAP_PRIVATE, where the
-  // process appears to get its own copy of the data, and changes to the
-  // file don't affect memory and vice versa).
-  NSError *error;
-  contents_ = [NSData dataWithContentsOfFile:object_filename_
-                                     options:0
-                                       error:&error];
-  if (!contents_) {
-    fprintf(stderr, "Error reading object file: %s: %s\n",
-            [object_filename_ fileSystemRepresentation],
-            [[error localizedDescription] UTF8String]);
+  if (!MapContents())
     return false;
-  }
-  [contents_ retain];
 
   // Get the list of object files present in the file.
   FatReader::Reporter fat_reporter([object_filename_
                                     fileSystemRepresentation]);
   FatReader fat_reader(&fat_reporter);
-  if (!fat_reader.Read(reinterpret_cast<const uint8_t *>([contents_ bytes]),
-                       [contents_ length])) {
+  if (!fat_reader.Read(contents_, contents_size_)) {
     return false;
   }
 
@@ -184,6 +168,55 @@ bool DumpSymbols::Read(NSString *filename) {
   return true;
 }
 
+bool DumpSymbols::MapContents() {
+  UnmapContents();
+
+  // Map the file rather than reading it: a universal binary's debugging
+  // information may be far larger than the parts of it we dump, and build
+  // outputs often live on network file systems. The file must not change
+  // while this dumper uses it.
+  const char *path = [object_filename_ fileSystemRepresentation];
+  int fd = open(path, O_RDONLY);
+  if (fd < 0) {
+    fprintf(stderr, "Error opening object file: %s: %s\n",
+            path, strerror(errno));
+    return false;
+  }
+
+  struct stat st;
+  if (fstat(fd, &st) != 0) {
+    fprintf(stderr, "Error reading object file: %s: %s\n",
+            path, strerror(errno));
+    close(fd);
+    return false;
+  }
+  if (st.st_size == 0) {
+    fprintf(stderr, "Object file is empty: %s\n", path);
+    close(fd);
+    return false;
+  }
+
+  void *contents = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (contents == MAP_FAILED) {
+    fprintf(stderr, "Error mapping object file: %s: %s\n",
+            path, strerror(errno));
+    return false;
+  }
+
+  contents_ = reinterpret_cast<const uint8_t *>(contents);
+  contents_size_ = st.st_size;
+  return true;
+}
+
+void DumpSymbols::UnmapContents() {
+  if (contents_) {
+    munmap(const_cast<uint8_t *>(contents_), contents_size_);
+    contents_ = NULL;
+    contents_size_ = 0;
+  }
+}
+
 bool DumpSymbols::SetArchitecture(cpu_type_t cpu_type,
                                   cpu_subtype_t cpu_subtype) {
   // Find the best match for the architecture the user requested.
@@ -207,11 +240,11 @@ bool DumpSymbols::SetArchitecture(const std::string &arch_name) {
   return arch_set;
 }
 
-string DumpSymbols::Identifier() {
+string DumpSymbols::Identifier(const struct fat_arch *object_file) {
   FileID file_id([object_filename_ fileSystemRepresentation]);
   unsigned char identifier_bytes[16];
-  cpu_type_t cpu_type = selected_object_file_->cputype;
-  cpu_subtype_t cpu_subtype = selected_object_file_->cpusubtype;
+  cpu_type_t cpu_type = object_file->cputype;
+  cpu_subtype_t cpu_subtype = object_file->cpusubtype;
   if (!file_id.MachoIdentifier(cpu_type, cpu_subtype, identifier_bytes)) {
     fprintf(stderr, "Unable to calculate UUID of mach-o binary %s!\n",
             [object_filename_ fileSystemRepresentation]);
@@ -231,8 +264,8 @@ string DumpSymbols::Identifier() {
 }
 
 // A line-to-module loader that accepts line number info parsed by
-// dwarf2reader::LineInfo and populates a Module and a line vector
-// with the results.
+// dwarf2reader::LineInfo and populates a Module and a line vector,
+// or passes the lines to a sink, with the results.
 class DumpSymbols::DumperLineToModule:
       public DwarfCUToModule::LineToModuleHandler {
  public:
@@ -250,12 +283,19 @@ class DumpSymbols::DumperLineToModule:
     dwarf2reader::LineInfo parser(program, length, byte_reader_, &handler);
     parser.Start();
   }
+  void StreamProgram(const char *program, uint64 length,
+                     Module *module, DwarfLineToModule::LineSink *sink) {
+    DwarfLineToModule handler(module, compilation_dir_, sink);
+    dwarf2reader::LineInfo parser(program, length, byte_reader_, &handler);
+    parser.Start();
+  }
  private:
   string compilation_dir_;
   dwarf2reader::ByteReader *byte_reader_;  // WEAK
 };
 
 bool DumpSymbols::ReadDwarf(google_breakpad::Module *module,
+                            const string &object_name,
                             const mach_o::Reader &macho_reader,
                             const mach_o::SectionMap &dwarf_sections,
                             bool handle_inter_cu_refs) const {
@@ -265,7 +305,7 @@ bool DumpSymbols::ReadDwarf(google_breakpad::Module *module,
                          : dwarf2reader::ENDIANNESS_LITTLE);
 
   // Construct a context for this file.
-  DwarfCUToModule::FileContext file_context(selected_object_name_,
+  DwarfCUToModule::FileContext file_context(object_name,
                                             module,
                                             handle_inter_cu_refs);
 
@@ -287,20 +327,22 @@ bool DumpSymbols::ReadDwarf(google_breakpad::Module *module,
   // There had better be a __debug_info section!
   if (!debug_info_section.first) {
     fprintf(stderr, "%s: __DWARF segment of file has no __debug_info section\n",
-            selected_object_name_.c_str());
+            object_name.c_str());
     return false;
   }
 
   // Build a line-to-module loader for the root handler to use.
   DumperLineToModule line_to_module(&byte_reader);
 
+  // Compilation units often share abbreviation tables; parse each once.
+  dwarf2reader::CompilationUnit::AbbrevCache abbrev_cache;
+
   // Walk the __debug_info section, one compilation unit at a time.
   uint64 debug_info_length = debug_info_section.second;
   for (uint64 offset = 0; offset < debug_info_length;) {
     // Make a handler for the root DIE that populates MODULE with the
     // debug info.
-    DwarfCUToModule::WarningReporter reporter(selected_object_name_,
-                                              offset);
+    DwarfCUToModule::WarningReporter reporter(object_name, offset);
     DwarfCUToModule root_handler(&file_context, &line_to_module, &reporter);
     // Make a Dwarf2Handler that drives our DIEHandler.
     dwarf2reader::DIEDispatcher die_dispatcher(&root_handler);
@@ -309,6 +351,7 @@ bool DumpSymbols::ReadDwarf(google_breakpad::Module *module,
                                                offset,
                                                &byte_reader,
                                                &die_dispatcher);
+    dwarf_reader.set_abbrev_cache(&abbrev_cache);
     // Process the entire compilation unit; get the offset of the next.
     offset += dwarf_reader.Start();
   }
@@ -317,6 +360,7 @@ bool DumpSymbols::ReadDwarf(google_breakpad::Module *module,
 }
 
 bool DumpSymbols::ReadCFI(google_breakpad::Module *module,
+                          const string &object_name,
                           const mach_o::Reader &macho_reader,
                           const mach_o::Section &section,
                           bool eh_frame) const {
@@ -340,7 +384,7 @@ bool DumpSymbols::ReadCFI(google_breakpad::Module *module,
       const NXArchInfo *arch = google_breakpad::BreakpadGetArchInfoFromCpuType(
           macho_reader.cpu_type(), macho_reader.cpu_subtype());
       fprintf(stderr, "%s: cannot convert DWARF call frame information for ",
-              selected_object_name_.c_str());
+              object_name.c_str());
       if (arch)
         fprintf(stderr, "architecture '%s'", arch->name);
       else
@@ -356,7 +400,7 @@ bool DumpSymbols::ReadCFI(google_breakpad::Module *module,
   size_t cfi_size = section.contents.Size();
 
   // Plug together the parser, handler, and their entourages.
-  DwarfCFIToModule::Reporter module_reporter(selected_object_name_,
+  DwarfCFIToModule::Reporter module_reporter(object_name,
                                              section.section_name);
   DwarfCFIToModule handler(module, register_names, &module_reporter);
   dwarf2reader::ByteReader byte_reader(macho_reader.big_endian() ?
@@ -368,7 +412,7 @@ bool DumpSymbols::ReadCFI(google_breakpad::Module *module,
   // this is the only base address the CFI parser will need.
   byte_reader.SetCFIDataBase(section.address, cfi);
 
-  dwarf2reader::CallFrameInfo::Reporter dwarf_reporter(selected_object_name_,
+  dwarf2reader::CallFrameInfo::Reporter dwarf_reporter(object_name,
                                                        section.section_name);
   dwarf2reader::CallFrameInfo parser(cfi, cfi_size,
                                      &byte_reader, &handler, &dwarf_reporter,
@@ -383,14 +427,17 @@ class DumpSymbols::LoadCommandDumper:
       public mach_o::Reader::LoadCommandHandler {
  public:
   // Create a load command dumper handling load commands from READER's
-  // file, and adding data to MODULE.
+  // file, and adding data to MODULE. OBJECT_NAME identifies READER's file
+  // in error messages.
   LoadCommandDumper(const DumpSymbols &dumper,
                     google_breakpad::Module *module,
+                    const string &object_name,
                     const mach_o::Reader &reader,
                     SymbolData symbol_data,
                     bool handle_inter_cu_refs)
       : dumper_(dumper),
         module_(module),
+        object_name_(object_name),
         reader_(reader),
         symbol_data_(symbol_data),
         handle_inter_cu_refs_(handle_inter_cu_refs) { }
@@ -401,32 +448,48 @@ class DumpSymbols::LoadCommandDumper:
  private:
   const DumpSymbols &dumper_;
   google_breakpad::Module *module_;  // WEAK
+  const string &object_name_;
   const mach_o::Reader &reader_;
   const SymbolData symbol_data_;
   const bool handle_inter_cu_refs_;
 };
 
-bool DumpSymbols::LoadCommandDumper::SegmentCommand(const Segment &segment) {
-  mach_o::SectionMap section_map;
-  if (!reader_.MapSegmentSections(segment, &section_map))
-    return false;
+// Tell the kernel that |contents|, which lies within a mapped file, is
+// about to be read from start to end, so that it reads ahead and drops
+// pages behind.
+static void AdviseSequentialRead(const ByteBuffer &contents) {
+  if (contents.Size() == 0)
+    return;
+  uintptr_t page_size = getpagesize();
+  uintptr_t start = reinterpret_cast<uintptr_t>(contents.start);
+  uintptr_t page_start = start & ~(page_size - 1);
+  madvise(reinterpret_cast<void *>(page_start),
+          contents.Size() + (start - page_start), MADV_SEQUENTIAL);
+}
 
+bool DumpSymbols::LoadCommandDumper::SegmentCommand(const Segment &segment) {
+  // Only look at the sections of the segments we read, and in __TEXT only
+  // at the one section we need.
   if (segment.name == "__TEXT") {
     module_->SetLoadAddress(segment.vmaddr);
     if (symbol_data_ != NO_CFI) {
-      mach_o::SectionMap::const_iterator eh_frame =
-          section_map.find("__eh_frame");
-      if (eh_frame != section_map.end()) {
+      Section eh_frame;
+      if (reader_.FindSegmentSection(segment, "__eh_frame", &eh_frame)) {
         // If there is a problem reading this, don't treat it as a fatal error.
-        dumper_.ReadCFI(module_, reader_, eh_frame->second, true);
+        dumper_.ReadCFI(module_, object_name_, reader_, eh_frame, true);
       }
     }
     return true;
   }
 
   if (segment.name == "__DWARF") {
+    mach_o::SectionMap section_map;
+    if (!reader_.MapSegmentSections(segment, &section_map))
+      return false;
+
     if (symbol_data_ != ONLY_CFI) {
-      if (!dumper_.ReadDwarf(module_, reader_, section_map,
+      AdviseSequentialRead(segment.contents);
+      if (!dumper_.ReadDwarf(module_, object_name_, reader_, section_map,
                              handle_inter_cu_refs_)) {
         return false;
       }
@@ -436,7 +499,8 @@ bool DumpSymbols::LoadCommandDumper::SegmentCommand(const Segment &segment) {
           = section_map.find("__debug_frame");
       if (debug_frame != section_map.end()) {
         // If there is a problem reading this, don't treat it as a fatal error.
-        dumper_.ReadCFI(module_, reader_, debug_frame->second, false);
+        dumper_.ReadCFI(module_, object_name_, reader_, debug_frame->second,
+                        false);
       }
     }
   }
@@ -461,6 +525,110 @@ bool DumpSymbols::LoadCommandDumper::SymtabCommand(const ByteBuffer &entries,
   return true;
 }
 
+// Everything needed to read one object file, gathered by
+// PrepareObjectFileJob, and the result of reading it.
+struct DumpSymbols::ObjectFileJob {
+  ObjectFileJob()
+      : dumper(NULL), object_file(NULL), contents(NULL), module(NULL),
+        result(false) { }
+
+  const DumpSymbols *dumper;
+  const struct fat_arch *object_file;
+
+  // The start of the universal binary or Mach-O file containing
+  // object_file. The object file itself starts object_file->offset bytes in.
+  const uint8_t *contents;
+
+  // A string that identifies the object file, for use in error messages.
+  // This is usually the file name, but for a fat binary it also names the
+  // particular architecture within that binary.
+  string object_name;
+
+  // The name, architecture and identifier for the MODULE record.
+  string module_name;
+  string arch_name;
+  string identifier;
+
+  // The module read from the object file, owned by the caller, and whether
+  // ReadObjectFile succeeded.
+  Module *module;
+  bool result;
+};
+
+bool DumpSymbols::PrepareObjectFileJob(const struct fat_arch *object_file,
+                                       ObjectFileJob *job) {
+  // Find the name of the object file's architecture, to appear in
+  // the MODULE record and in error messages.
+  const NXArchInfo *arch_info =
+      google_breakpad::BreakpadGetArchInfoFromCpuType(
+          object_file->cputype, object_file->cpusubtype);
+  if (!arch_info) {
+    fprintf(stderr, "%s: unrecognized cpu type 0x%x, subtype 0x%x\n",
+            [object_filename_ fileSystemRepresentation],
+            object_file->cputype, object_file->cpusubtype);
+    return false;
+  }
+
+  const char *arch_name = arch_info->name;
+  if (strcmp(arch_name, "i386") == 0)
+    arch_name = "x86";
+
+  // Produce a name to use in error messages that includes the
+  // filename, and the architecture, if there is more than one.
+  job->object_name = [object_filename_ UTF8String];
+  if (object_files_.size() > 1) {
+    job->object_name += ", architecture ";
+    job->object_name += arch_name;
+  }
+
+  // Choose an identifier string, to appear in the MODULE record.
+  job->identifier = Identifier(object_file);
+  if (job->identifier.empty())
+    return false;
+  job->identifier += "0";
+
+  job->dumper = this;
+  job->object_file = object_file;
+  job->contents = contents_;
+  job->module_name = [[object_filename_ lastPathComponent] UTF8String];
+  job->arch_name = arch_name;
+  return true;
+}
+
+bool DumpSymbols::ReadObjectFile(ObjectFileJob *job) const {
+  // Create a module to hold the debugging information.
+  scoped_ptr<Module> module(new Module(job->module_name,
+                                       "mac",
+                                       job->arch_name,
+                                       job->identifier));
+
+  // Parse the object file.
+  mach_o::Reader::Reporter reporter(job->object_name);
+  mach_o::Reader reader(&reporter);
+  if (!reader.Read(job->contents + job->object_file->offset,
+                   job->object_file->size,
+                   job->object_file->cputype,
+                   job->object_file->cpusubtype))
+    return false;
+
+  // Walk its load commands, and deal with whatever is there.
+  LoadCommandDumper load_command_dumper(*this, module.get(), job->object_name,
+                                        reader, symbol_data_,
+                                        handle_inter_cu_refs_);
+  if (!reader.WalkLoadCommands(&load_command_dumper))
+    return false;
+
+  job->module = module.release();
+  return true;
+}
+
+// static
+void *DumpSymbols::ReadObjectFileThread(void *context) {
+  ObjectFileJob *job = reinterpret_cast<ObjectFileJob *>(context);
+  job->result = job->dumper->ReadObjectFile(job);
+  return NULL;
+}
+
 bool DumpSymbols::ReadSymbolData(Module** out_module) {
   // Select an object file, if SetArchitecture hasn't been called to set one
   // explicitly.
@@ -484,58 +652,58 @@ bool DumpSymbols::ReadSymbolData(Module** out_module) {
 
   assert(selected_object_file_);
 
-  // Find the name of the selected file's architecture, to appear in
-  // the MODULE record and in error messages.
-  const NXArchInfo *selected_arch_info =
-      google_breakpad::BreakpadGetArchInfoFromCpuType(
-          selected_object_file_->cputype, selected_object_file_->cpusubtype);
-
-  const char *selected_arch_name = selected_arch_info->name;
-  if (strcmp(selected_arch_name, "i386") == 0)
-    selected_arch_name = "x86";
-
-  // Produce a name to use in error messages that includes the
-  // filename, and the architecture, if there is more than one.
-  selected_object_name_ = [object_filename_ UTF8String];
-  if (object_files_.size() > 1) {
-    selected_object_name_ += ", architecture ";
-    selected_object_name_ + selected_arch_name;
-  }
-
-  // Compute a module name, to appear in the MODULE record.
-  NSString *module_name = [object_filename_ lastPathComponent];
-
-  // Choose an identifier string, to appear in the MODULE record.
-  string identifier = Identifier();
-  if (identifier.empty())
+  ObjectFileJob job;
+  if (!PrepareObjectFileJob(selected_object_file_, &job) ||
+      !ReadObjectFile(&job))
     return false;
-  identifier += "0";
-
-  // Create a module to hold the debugging information.
-  scoped_ptr<Module> module(new Module([module_name UTF8String],
-                                       "mac",
-                                       selected_arch_name,
-                                       identifier));
 
-  // Parse the selected object file.
-  mach_o::Reader::Reporter reporter(selected_object_name_);
-  mach_o::Reader reader(&reporter);
-  if (!reader.Read(reinterpret_cast<const uint8_t *>([contents_ bytes])
-                   + selected_object_file_->offset,
-                   selected_object_file_->size,
-                   selected_object_file_->cputype,
-                   selected_object_file_->cpusubtype))
-    return false;
-
-  // Walk its load commands, and deal with whatever is there.
-  LoadCommandDumper load_command_dumper(*this, module.get(), reader,
-                                        symbol_data_, handle_inter_cu_refs_);
-  if (!reader.WalkLoadCommands(&load_command_dumper))
-    return false;
+  *out_module = job.module;
+  return true;
+}
 
-  *out_module = module.release();
+bool DumpSymbols::ReadAllSymbolData(vector<Module*> *modules) {
+  modules->clear();
+
+  // Gather what each object file needs on this thread, so that the readers
+  // only share contents_, which no one writes. A job that could not be
+  // prepared keeps a NULL dumper.
+  vector<ObjectFileJob> jobs(object_files_.size());
+  for (size_t i = 0; i < object_files_.size(); i++)
+    PrepareObjectFileJob(&object_files_[i], &jobs[i]);
+
+  // DWARF parsing recurses once per level of DIE nesting, so give each
+  // reader as much stack as the main thread has.
+  pthread_attr_t attributes;
+  pthread_attr_init(&attributes);
+  pthread_attr_setstacksize(&attributes, 8 * 1024 * 1024);
+
+  // Read each object file on its own thread. A single object file, or one
+  // whose thread cannot be started, is read on this thread instead.
+  vector<pthread_t> threads(jobs.size());
+  vector<bool> started(jobs.size(), false);
+  for (size_t i = 0; i < jobs.size(); i++) {
+    if (!jobs[i].dumper)
+      continue;
+    if (jobs.size() > 1 &&
+        pthread_create(&threads[i], &attributes, ReadObjectFileThread,
+                       &jobs[i]) == 0) {
+      started[i] = true;
+    } else {
+      ReadObjectFileThread(&jobs[i]);
+    }
+  }
+  pthread_attr_destroy(&attributes);
+
+  bool result = true;
+  for (size_t i = 0; i < jobs.size(); i++) {
+    if (started[i])
+      pthread_join(threads[i], NULL);
+    if (!jobs[i].result)
+      result = false;
+    modules->push_back(jobs[i].module);
+  }
 
-  return true;
+  return result;
 }
 
 bool DumpSymbols::WriteSymbolFile(std::ostream &stream) {
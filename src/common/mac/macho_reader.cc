@@ -531,5 +531,39 @@ bool Reader::MapSegmentSections(const Segment &segment,
   return WalkSegmentSections(segment, &mapper);
 }
 
+// A SectionHandler that looks for the section with a given name, stopping
+// the walk when it finds it.
+class Reader::SectionFinder: public SectionHandler {
+ public:
+  // Create a SectionHandler that stores the section named NAME in
+  // SECTION.
+  SectionFinder(const string &name, Section *section)
+      : name_(name), section_(section), found_() { }
+  bool HandleSection(const Section &section) {
+    if (section.section_name != name_)
+      return true;
+    *section_ = section;
+    found_ = true;
+    return false;
+  }
+  bool found() const { return found_; }
+ private:
+  // The name of the section we're looking for.
+  const string &name_;
+
+  // Where we should store the section if we find it. (WEAK)
+  Section *section_;
+
+  // True if we found the section.
+  bool found_;
+};
+
+bool Reader::FindSegmentSection(const Segment &segment, const string &name,
+                                Section *section) const {
+  SectionFinder finder(name, section);
+  WalkSegmentSections(segment, &finder);
+  return finder.found();
+}
+
 }  // namespace mach_o
 }  // namespace google_breakpad
@@ -418,10 +418,18 @@ class Reader {
   bool MapSegmentSections(const Segment &segment, SectionMap *section_map)
     const;
 
+  // Find the section named |name| in |segment|, and set |section| to
+  // describe it. Unlike MapSegmentSections, this stops at the first match
+  // and builds no map. Return true if the section was found; otherwise,
+  // return false, reporting any problem parsing the section list.
+  bool FindSegmentSection(const Segment &segment, const string &name,
+                          Section *section) const;
+
  private:
   // Used internally.
   class SegmentFinder;
   class SectionMapper;
+  class SectionFinder;
 
   // We use this to report problems parsing the file's contents. (WEAK)
   Reporter *reporter_;
@@ -1671,6 +1671,46 @@ TEST_F(LoadCommand, MapSegmentSections) {
               MatchSection(false, "bergamot", "head", 0x13e6c8a9));
 }
 
+TEST_F(LoadCommand, FindSegmentSection) {
+  WithConfiguration config(kBigEndian, 64);
+
+  LoadedSection section1, section2;
+  section1.Append("pomelo");
+  section2.Append("yuzu");
+
+  LoadedSection segment;
+  segment.address() = 0x2d8c1a3e5f704b96ULL;
+  segment.Place(&section1).Place(&section2);
+
+  SegmentLoadCommand segment_command;
+  segment_command
+      .Header("abdomen", segment, 0x2bd72d6d, 0x54c6a8e1, 0x6e7f81a0)
+      .AppendSectionEntry("citron", "abdomen", 4, 0x5a0b71d3, section1)
+      .AppendSectionEntry("kumquat", "abdomen", 4, 0x1ff6d5c8, section2);
+
+  LoadCommands commands;
+  commands.Place(&segment_command);
+
+  MachOFile file;
+  file.Header(&commands).Place(&segment);
+
+  ReadFile(&file, true, CPU_TYPE_ANY, 0);
+
+  Segment actual_segment;
+  ASSERT_TRUE(reader.FindSegment("abdomen", &actual_segment));
+
+  Section section;
+  EXPECT_FALSE(reader.FindSegmentSection(actual_segment, "lime", &section));
+
+  ASSERT_TRUE(reader.FindSegmentSection(actual_segment, "kumquat", &section));
+  EXPECT_THAT(section, MatchSection(true, "kumquat", "abdomen",
+                                    0x2d8c1a3e5f704b96ULL + 6));
+
+  ASSERT_TRUE(reader.FindSegmentSection(actual_segment, "citron", &section));
+  EXPECT_THAT(section, MatchSection(true, "citron", "abdomen",
+                                    0x2d8c1a3e5f704b96ULL));
+}
+
 TEST_F(LoadCommand, FindSegment) {
   WithConfiguration config(kBigEndian, 32);
 
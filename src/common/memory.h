@@ -56,8 +56,9 @@ namespace google_breakpad {
 // This is very simple allocator which fetches pages from the kernel directly.
 // Thus, it can be used even when the heap may be corrupted.
 //
-// There is no free operation. The pages are only freed when the object is
-// destroyed.
+// Blocks may be handed back with Free, which keeps them on free lists, one
+// per power-of-two size class, for later allocations to reuse. The pages
+// themselves are only freed when the object is destroyed.
 class PageAllocator {
  public:
   PageAllocator()
@@ -65,6 +66,8 @@ class PageAllocator {
         last_(NULL),
         current_page_(NULL),
         page_offset_(0) {
+    for (size_t i = 0; i < kNumSizeClasses; ++i)
+      free_lists_[i] = NULL;
   }
 
   ~PageAllocator() {
@@ -75,6 +78,9 @@ class PageAllocator {
     if (!bytes)
       return NULL;
 
+    if (void* const reused = AllocFromFreeLists(bytes))
+      return reused;
+
     if (current_page_ && page_size_ - page_offset_ >= bytes) {
       uint8_t *const ret = current_page_ + page_offset_;
       page_offset_ += bytes;
@@ -100,6 +106,41 @@ class PageAllocator {
     return ret + sizeof(PageHeader);
   }
 
+  // Returns the |bytes| long block at |p|, obtained from Alloc, for reuse.
+  // The most recent allocation is simply taken back; other blocks go on a
+  // free list. Blocks too small or misaligned to hold a free list entry are
+  // dropped.
+  void Free(void* p, size_t bytes) {
+    uint8_t* const block = static_cast<uint8_t*>(p);
+    if (!block || !bytes)
+      return;
+
+    if (current_page_ && block >= current_page_ &&
+        block + bytes == current_page_ + page_offset_) {
+      page_offset_ -= bytes;
+      return;
+    }
+
+    if (bytes < sizeof(FreeBlock) ||
+        reinterpret_cast<uintptr_t>(block) % sizeof(FreeBlock*) != 0) {
+      return;
+    }
+    FreeBlock* const free_block = reinterpret_cast<FreeBlock*>(block);
+    free_block->size = bytes;
+    const size_t size_class = FloorLog2(bytes);
+    free_block->next = free_lists_[size_class];
+    free_lists_[size_class] = free_block;
+  }
+
+  // Returns the number of pages obtained from the kernel so far.
+  // This method exists for testing purposes only.
+  size_t pages_allocated() const {
+    size_t pages = 0;
+    for (PageHeader* header = last_; header; header = header->next)
+      pages += header->num_pages;
+    return pages;
+  }
+
   // Checks whether the page allocator owns the passed-in pointer.
   // This method exists for testing pursposes only.
   bool OwnsPointer(const void* p) {
@@ -113,6 +154,61 @@ class PageAllocator {
   }
 
  private:
+  // The start of a block on a free list.
+  struct FreeBlock {
+    FreeBlock* next;
+    size_t size;
+  };
+
+  // Free list i holds blocks of at least 2^i and less than 2^(i+1) bytes.
+  static const size_t kNumSizeClasses = sizeof(size_t) * 8;
+
+  // How many blocks of a request's own size class Alloc looks at.
+  static const int kMaxFreeListScan = 8;
+
+  static size_t FloorLog2(size_t n) {
+    size_t log = 0;
+    while (n >>= 1)
+      ++log;
+    return log;
+  }
+
+  // Takes a block of at least |bytes| bytes off the free lists, putting
+  // back what is left of it if that is large enough to be reused. Returns
+  // NULL if no free block is large enough.
+  void* AllocFromFreeLists(size_t bytes) {
+    // Blocks in the class of |bytes| itself may or may not be large enough,
+    // so only the first few are looked at.
+    size_t size_class = FloorLog2(bytes);
+    FreeBlock** link = &free_lists_[size_class];
+    for (int i = 0; *link && i < kMaxFreeListScan; ++i) {
+      if ((*link)->size >= bytes)
+        return TakeFreeBlock(link, bytes);
+      link = &(*link)->next;
+    }
+
+    // Every block in the classes above is large enough.
+    for (++size_class; size_class < kNumSizeClasses; ++size_class) {
+      if (free_lists_[size_class])
+        return TakeFreeBlock(&free_lists_[size_class], bytes);
+    }
+    return NULL;
+  }
+
+  // Unlinks the block at |*link| and returns its first |bytes| bytes,
+  // putting the rest back if that is large enough to be reused.
+  void* TakeFreeBlock(FreeBlock** link, size_t bytes) {
+    FreeBlock* const block = *link;
+    *link = block->next;
+
+    // Split at an aligned offset so the remainder can hold an entry.
+    const size_t used =
+        (bytes + sizeof(FreeBlock*) - 1) & ~(sizeof(FreeBlock*) - 1);
+    if (block->size >= used + sizeof(FreeBlock))
+      Free(reinterpret_cast<uint8_t*>(block) + used, block->size - used);
+    return block;
+  }
+
   uint8_t *GetNPages(size_t num_pages) {
 #if defined(__x86_64__) || defined(__aarch64__)
     void *a = sys_mmap(NULL, page_size_ * num_pages, PROT_READ | PROT_WRITE,
@@ -156,6 +252,7 @@ class PageAllocator {
   PageHeader *last_;
   uint8_t *current_page_;
   size_t page_offset_;
+  FreeBlock* free_lists_[kNumSizeClasses];
 };
 
 // Wrapper to use with STL containers
@@ -172,8 +269,8 @@ struct PageStdAllocator : public std::allocator<T> {
     return static_cast<pointer>(allocator_.Alloc(sizeof(T) * n));
   }
 
-  inline void deallocate(pointer, size_type) {
-    // The PageAllocator doesn't free.
+  inline void deallocate(pointer p, size_type n) {
+    allocator_.Free(p, sizeof(T) * n);
   }
 
   template <typename U> struct rebind {
@@ -191,7 +288,8 @@ struct PageStdAllocator : public std::allocator<T> {
 
 // A wasteful vector is a std::vector, except that it allocates memory from a
 // PageAllocator. It's wasteful because, when resizing, it always allocates a
-// whole new array since the PageAllocator doesn't support realloc.
+// whole new array since the PageAllocator doesn't support realloc. The old
+// array is handed back to the PageAllocator, so later allocations reuse it.
 template<class T>
 class wasteful_vector : public std::vector<T, PageStdAllocator<T> > {
  public:
@@ -62,6 +62,43 @@ TEST(PageAllocatorTest, LargeObject) {
   }
 }
 
+TEST(PageAllocatorTest, FreeMostRecentAllocation) {
+  PageAllocator allocator;
+
+  void* p = allocator.Alloc(100);
+  ASSERT_FALSE(p == NULL);
+  allocator.Free(p, 100);
+  EXPECT_EQ(p, allocator.Alloc(100));
+}
+
+TEST(PageAllocatorTest, FreeReusesBlocks) {
+  PageAllocator allocator;
+
+  uint8_t* p = reinterpret_cast<uint8_t*>(allocator.Alloc(256));
+  ASSERT_FALSE(p == NULL);
+  ASSERT_FALSE(allocator.Alloc(8) == NULL);
+  allocator.Free(p, 256);
+
+  // The freed block is split, and both halves are handed out again.
+  EXPECT_EQ(p, allocator.Alloc(128));
+  EXPECT_EQ(p + 128, allocator.Alloc(100));
+  void* q = allocator.Alloc(128);
+  ASSERT_FALSE(q == NULL);
+  EXPECT_FALSE(q >= p && q < p + 256);
+}
+
+TEST(PageAllocatorTest, FreeLargeObject) {
+  PageAllocator allocator;
+
+  void* p = allocator.Alloc(10000);
+  ASSERT_FALSE(p == NULL);
+  ASSERT_FALSE(allocator.Alloc(8) == NULL);
+  const size_t pages = allocator.pages_allocated();
+  allocator.Free(p, 10000);
+  EXPECT_EQ(p, allocator.Alloc(9000));
+  EXPECT_EQ(pages, allocator.pages_allocated());
+}
+
 namespace {
 typedef testing::Test WastefulVectorTest;
 }
@@ -95,3 +132,24 @@ TEST(WastefulVectorTest, UsesPageAllocator) {
   v.push_back(1);
   ASSERT_TRUE(allocator_.OwnsPointer(&v[0]));
 }
+
+TEST(WastefulVectorTest, ReusesMemory) {
+  PageAllocator allocator_;
+  const unsigned kCount = 100000;
+
+  {
+    wasteful_vector<unsigned> v(&allocator_);
+    for (unsigned i = 0; i < kCount; ++i)
+      v.push_back(i);
+  }
+  const size_t pages = allocator_.pages_allocated();
+
+  // A second vector of the same size fits in the arrays the first one
+  // left behind.
+  wasteful_vector<unsigned> v(&allocator_);
+  for (unsigned i = 0; i < kCount; ++i)
+    v.push_back(i);
+  EXPECT_EQ(pages, allocator_.pages_allocated());
+  for (unsigned i = 0; i < kCount; ++i)
+    ASSERT_EQ(i, v[i]);
+}
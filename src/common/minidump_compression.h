@@ -0,0 +1,254 @@
+// Copyright (c) 2016 Google Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+// notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above
+// copyright notice, this list of conditions and the following disclaimer
+// in the documentation and/or other materials provided with the
+// distribution.
+//     * Neither the name of Google Inc. nor the names of its
+// contributors may be used to endorse or promote products derived from
+// this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+// minidump_compression.h: The compressed minidump format, and the block
+// compressor used to produce it.
+//
+// A compressed minidump is a sequence of frames, each holding a run of
+// bytes of the minidump image and where they go.  Frames appear in the
+// order they were written; a frame may overwrite bytes from an earlier one,
+// which lets a writer that seeks back to fill in headers produce the file
+// in a single sequential pass.  Bytes that no frame covers are zero.
+//
+//   CompressedMinidumpHeader
+//   CompressedMinidumpFrame, followed by |stored_size| bytes
+//   ...
+//
+// A frame's data is stored as is when |stored_size| equals |size|, and
+// otherwise as one block in the LZ4 block format, which is what the
+// compressor below produces.  A frame with a |size| of zero carries no
+// data and records in |offset| the size of the minidump image.
+//
+// All integers are in the byte order of the machine that wrote the file;
+// the signature serves as a byte order mark.
+//
+// The compressor does not allocate memory, call into libc or need more than
+// a small scratch table from its caller, so it can be used from a
+// compromised context.
+
+#ifndef COMMON_MINIDUMP_COMPRESSION_H_
+#define COMMON_MINIDUMP_COMPRESSION_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace google_breakpad {
+
+// 'BPZD' in the byte order of the writer.
+const uint32_t kCompressedMinidumpSignature = 0x445a5042;
+const uint32_t kCompressedMinidumpVersion = 1;
+
+// The largest amount of data a single frame may hold.
+const size_t kCompressedMinidumpMaxFrameSize = 64 * 1024;
+
+struct CompressedMinidumpHeader {
+  uint32_t signature;
+  uint32_t version;
+};
+
+struct CompressedMinidumpFrame {
+  // Where the frame's data goes in the minidump image.
+  uint64_t offset;
+  // The size of the data once decompressed.
+  uint32_t size;
+  // The number of bytes following this frame.
+  uint32_t stored_size;
+};
+
+// Reads the four bytes at |p| as a little-endian integer.
+inline uint32_t CompressionLoad32(const uint8_t* p) {
+  return p[0] | (p[1] << 8) | (p[2] << 16) |
+         (static_cast<uint32_t>(p[3]) << 24);
+}
+
+// Copies |size| bytes from |src| to |dest|, which must not overlap.
+inline void CompressionCopy(uint8_t* dest, const uint8_t* src, size_t size) {
+  for (size_t i = 0; i < size; ++i)
+    dest[i] = src[i];
+}
+
+// The number of entries in the hash table CompressBlock() needs.
+const size_t kCompressBlockHashTableSize = 1 << 12;
+
+// Compresses the |size| bytes at |src|, which must be no more than
+// kCompressedMinidumpMaxFrameSize, into at most |capacity| bytes at |dest|.
+// |hash_table| is scratch space of kCompressBlockHashTableSize entries.
+// Returns the compressed size, or 0 if the data does not compress into
+// |capacity| bytes.
+inline size_t CompressBlock(const uint8_t* src, size_t size,
+                            uint8_t* dest, size_t capacity,
+                            uint16_t* hash_table) {
+  // As in LZ4, matches are at least 4 bytes long, the last 5 bytes are
+  // always literals and no match starts in the last 12 bytes.
+  static const size_t kMinMatch = 4;
+  static const size_t kLastLiterals = 5;
+  static const size_t kMatchLimit = 12;
+
+  for (size_t i = 0; i < kCompressBlockHashTableSize; ++i)
+    hash_table[i] = 0;
+
+  size_t ip = 0;
+  size_t anchor = 0;
+  size_t op = 0;
+  const size_t match_limit = size > kMatchLimit ? size - kMatchLimit : 0;
+
+  while (ip < match_limit) {
+    const uint32_t sequence = CompressionLoad32(src + ip);
+    const size_t hash = (sequence * 2654435761U) >> (32 - 12);
+    const size_t ref = hash_table[hash];
+    hash_table[hash] = static_cast<uint16_t>(ip);
+
+    if (ref >= ip || CompressionLoad32(src + ref) != sequence) {
+      ++ip;
+      continue;
+    }
+
+    size_t match_length = kMinMatch;
+    while (ip + match_length < size - kLastLiterals &&
+           src[ref + match_length] == src[ip + match_length]) {
+      ++match_length;
+    }
+
+    // The token, the literals, the offset and the length bytes.
+    const size_t literal_length = ip - anchor;
+    const size_t needed = 1 + literal_length + literal_length / 255 + 1 +
+                          2 + (match_length - kMinMatch) / 255 + 1;
+    if (op + needed > capacity)
+      return 0;
+
+    uint8_t* token = dest + op++;
+    if (literal_length >= 15) {
+      *token = 15 << 4;
+      size_t remaining = literal_length - 15;
+      for (; remaining >= 255; remaining -= 255)
+        dest[op++] = 255;
+      dest[op++] = static_cast<uint8_t>(remaining);
+    } else {
+      *token = static_cast<uint8_t>(literal_length << 4);
+    }
+    CompressionCopy(dest + op, src + anchor, literal_length);
+    op += literal_length;
+
+    const size_t offset = ip - ref;
+    dest[op++] = static_cast<uint8_t>(offset);
+    dest[op++] = static_cast<uint8_t>(offset >> 8);
+
+    const size_t extra_length = match_length - kMinMatch;
+    if (extra_length >= 15) {
+      *token |= 15;
+      size_t remaining = extra_length - 15;
+      for (; remaining >= 255; remaining -= 255)
+        dest[op++] = 255;
+      dest[op++] = static_cast<uint8_t>(remaining);
+    } else {
+      *token |= static_cast<uint8_t>(extra_length);
+    }
+
+    ip += match_length;
+    anchor = ip;
+  }
+
+  // The final sequence is literals only.
+  const size_t literal_length = size - anchor;
+  if (op + 1 + literal_length + literal_length / 255 + 1 > capacity)
+    return 0;
+  if (literal_length >= 15) {
+    dest[op++] = 15 << 4;
+    size_t remaining = literal_length - 15;
+    for (; remaining >= 255; remaining -= 255)
+      dest[op++] = 255;
+    dest[op++] = static_cast<uint8_t>(remaining);
+  } else {
+    dest[op++] = static_cast<uint8_t>(literal_length << 4);
+  }
+  CompressionCopy(dest + op, src + anchor, literal_length);
+  op += literal_length;
+  return op;
+}
+
+// Decompresses the |src_size| bytes of a block produced by CompressBlock()
+// into exactly |dest_size| bytes at |dest|.  Returns false if the block is
+// malformed or does not decompress to |dest_size| bytes.
+inline bool DecompressBlock(const uint8_t* src, size_t src_size,
+                            uint8_t* dest, size_t dest_size) {
+  size_t ip = 0;
+  size_t op = 0;
+  while (ip < src_size) {
+    const uint8_t token = src[ip++];
+
+    size_t literal_length = token >> 4;
+    if (literal_length == 15) {
+      uint8_t byte;
+      do {
+        if (ip >= src_size)
+          return false;
+        byte = src[ip++];
+        literal_length += byte;
+      } while (byte == 255);
+    }
+    if (literal_length > src_size - ip || literal_length > dest_size - op)
+      return false;
+    CompressionCopy(dest + op, src + ip, literal_length);
+    ip += literal_length;
+    op += literal_length;
+
+    // The last sequence has no match.
+    if (ip == src_size)
+      break;
+
+    if (src_size - ip < 2)
+      return false;
+    const size_t offset = src[ip] | (src[ip + 1] << 8);
+    ip += 2;
+    if (offset == 0 || offset > op)
+      return false;
+
+    size_t match_length = token & 15;
+    if (match_length == 15) {
+      uint8_t byte;
+      do {
+        if (ip >= src_size)
+          return false;
+        byte = src[ip++];
+        match_length += byte;
+      } while (byte == 255);
+    }
+    match_length += 4;
+    if (match_length > dest_size - op)
+      return false;
+    // The match may overlap the bytes it produces.
+    for (size_t i = 0; i < match_length; ++i, ++op)
+      dest[op] = dest[op - offset];
+  }
+  return op == dest_size;
+}
+
+}  // namespace google_breakpad
+
+#endif  // COMMON_MINIDUMP_COMPRESSION_H_
@@ -36,17 +36,532 @@
 #include <assert.h>
 #include <errno.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
 
+#include <algorithm>
 #include <iostream>
 #include <utility>
 
 namespace google_breakpad {
 
-using std::dec;
-using std::endl;
-using std::hex;
+namespace {
 
+// Formats symbol file records into a large buffer, which is written to
+// a stream only when it fills up. Symbol files can run to hundreds of
+// megabytes, and formatting each field through the stream's
+// manipulators, then flushing after every record with endl, is slow.
+class RecordWriter {
+ public:
+  explicit RecordWriter(std::ostream &stream) : stream_(stream) {
+    buffer_.reserve(kBufferSize + kBufferSize / 4);
+  }
+
+  void Append(const string &text) { buffer_.append(text); }
+  void Append(const char *text) { buffer_.append(text); }
+  void Append(char c) { buffer_.push_back(c); }
+
+  // Append VALUE in lowercase hexadecimal, without leading zeros.
+  void AppendHex(uint64_t value) {
+    char digits[16];
+    int count = 0;
+    do {
+      digits[count++] = "0123456789abcdef"[value & 0xf];
+      value >>= 4;
+    } while (value);
+    while (count)
+      buffer_.push_back(digits[--count]);
+  }
+
+  // Append VALUE in decimal.
+  void AppendDecimal(int64_t value) {
+    uint64_t magnitude = value;
+    if (value < 0) {
+      buffer_.push_back('-');
+      magnitude = -magnitude;
+    }
+    char digits[20];
+    int count = 0;
+    do {
+      digits[count++] = '0' + magnitude % 10;
+      magnitude /= 10;
+    } while (magnitude);
+    while (count)
+      buffer_.push_back(digits[--count]);
+  }
+
+  // End the current record, writing the buffer out if it is full.
+  // Return false if writing to the stream failed.
+  bool EndRecord() {
+    buffer_.push_back('\n');
+    if (buffer_.size() < kBufferSize)
+      return true;
+    return Flush();
+  }
+
+  // Write out everything buffered so far and flush the stream. Return
+  // false if writing to the stream failed.
+  bool Flush() {
+    stream_.write(buffer_.data(), buffer_.size());
+    buffer_.clear();
+    stream_.flush();
+    return stream_.good();
+  }
+
+ private:
+  static const size_t kBufferSize = 256 * 1024;
+
+  std::ostream &stream_;
+  string buffer_;
+};
+
+// Append RULE_MAP to WRITER, in the form appropriate for 'STACK CFI'
+// records, without a final newline.
+void WriteRuleMap(const Module::RuleMap &rule_map, RecordWriter *writer) {
+  for (Module::RuleMap::const_iterator it = rule_map.begin();
+       it != rule_map.end(); ++it) {
+    if (it != rule_map.begin())
+      writer->Append(' ');
+    writer->Append(it->first);
+    writer->Append(": ");
+    writer->Append(it->second);
+  }
+}
+
+// Append the records for FUNC and its lines to WRITER, with addresses
+// relative to LOAD_ADDRESS. Return false if writing to the stream failed.
+bool WriteFunction(const Module::Function &func, Module::Address load_address,
+                   RecordWriter *writer) {
+  writer->Append("FUNC ");
+  writer->AppendHex(func.address - load_address);
+  writer->Append(' ');
+  writer->AppendHex(func.size);
+  writer->Append(' ');
+  writer->AppendHex(func.parameter_size);
+  writer->Append(' ');
+  writer->Append(func.name);
+  if (!writer->EndRecord())
+    return false;
+
+  for (vector<Module::Line>::const_iterator line_it = func.lines.begin();
+       line_it != func.lines.end(); ++line_it) {
+    writer->AppendHex(line_it->address - load_address);
+    writer->Append(' ');
+    writer->AppendHex(line_it->size);
+    writer->Append(' ');
+    writer->AppendDecimal(line_it->number);
+    writer->Append(' ');
+    writer->AppendDecimal(line_it->file->source_id);
+    if (!writer->EndRecord())
+      return false;
+  }
+  return true;
+}
+
+// Append the 'STACK CFI INIT' and 'STACK CFI' records for ENTRY to
+// WRITER, with addresses relative to LOAD_ADDRESS. Return false if
+// writing to the stream failed.
+bool WriteStackFrameEntry(const Module::StackFrameEntry &entry,
+                          Module::Address load_address,
+                          RecordWriter *writer) {
+  writer->Append("STACK CFI INIT ");
+  writer->AppendHex(entry.address - load_address);
+  writer->Append(' ');
+  writer->AppendHex(entry.size);
+  writer->Append(' ');
+  WriteRuleMap(entry.initial_rules, writer);
+  if (!writer->EndRecord())
+    return false;
+
+  // Write out this entry's delta rules as 'STACK CFI' records.
+  for (Module::RuleChangeMap::const_iterator delta_it =
+           entry.rule_changes.begin();
+       delta_it != entry.rule_changes.end(); ++delta_it) {
+    writer->Append("STACK CFI ");
+    writer->AppendHex(delta_it->first - load_address);
+    writer->Append(' ');
+    WriteRuleMap(delta_it->second, writer);
+    if (!writer->EndRecord())
+      return false;
+  }
+  return true;
+}
+
+// Sort EXTERNS by address, keeping externs at the same address in the
+// order they were added. Symbol tables are often in address order
+// already, so check before sorting.
+void SortExternsByAddress(vector<Module::Extern *> *externs) {
+  for (size_t i = 1; i < externs->size(); i++) {
+    if ((*externs)[i - 1]->address > (*externs)[i]->address) {
+      std::stable_sort(externs->begin(), externs->end(),
+                       Module::ExternCompare());
+      return;
+    }
+  }
+}
+
+// Functions and stack frame entries written out to the temporary files
+// of a module with a memory budget are encoded as sequences of 64-bit
+// integers and length-prefixed strings, in host byte order. Lines keep
+// their File pointers, since files stay in memory.
+
+// An estimate of the bytes a map node takes besides its value.
+const size_t kMapNodeBytes = 32;
+
+// Encoded data is written out in chunks of this size.
+const size_t kSpillChunkBytes = 1024 * 1024;
+
+size_t FunctionBytes(const Module::Function *function) {
+  return sizeof(*function) + function->name.capacity() +
+      function->lines.capacity() * sizeof(Module::Line);
+}
+
+size_t RuleMapBytes(const Module::RuleMap &rule_map) {
+  size_t bytes = 0;
+  for (Module::RuleMap::const_iterator it = rule_map.begin();
+       it != rule_map.end(); ++it) {
+    bytes += kMapNodeBytes + sizeof(*it) + it->first.capacity() +
+        it->second.capacity();
+  }
+  return bytes;
+}
+
+size_t StackFrameEntryBytes(const Module::StackFrameEntry *entry) {
+  size_t bytes = sizeof(*entry) + RuleMapBytes(entry->initial_rules);
+  for (Module::RuleChangeMap::const_iterator it = entry->rule_changes.begin();
+       it != entry->rule_changes.end(); ++it)
+    bytes += kMapNodeBytes + sizeof(*it) + RuleMapBytes(it->second);
+  return bytes;
+}
+
+void EncodeUInt64(uint64_t value, string *out) {
+  out->append(reinterpret_cast<const char *>(&value), sizeof(value));
+}
+
+void EncodeString(const string &value, string *out) {
+  EncodeUInt64(value.size(), out);
+  out->append(value);
+}
+
+void EncodeRuleMap(const Module::RuleMap &rule_map, string *out) {
+  EncodeUInt64(rule_map.size(), out);
+  for (Module::RuleMap::const_iterator it = rule_map.begin();
+       it != rule_map.end(); ++it) {
+    EncodeString(it->first, out);
+    EncodeString(it->second, out);
+  }
+}
+
+void EncodeFunction(const Module::Function &function, string *out) {
+  EncodeUInt64(function.address, out);
+  EncodeUInt64(function.size, out);
+  EncodeUInt64(function.parameter_size, out);
+  EncodeString(function.name, out);
+  EncodeUInt64(function.lines.size(), out);
+  for (vector<Module::Line>::const_iterator it = function.lines.begin();
+       it != function.lines.end(); ++it) {
+    EncodeUInt64(it->address, out);
+    EncodeUInt64(it->size, out);
+    EncodeUInt64(static_cast<int64_t>(it->number), out);
+    EncodeUInt64(reinterpret_cast<uintptr_t>(it->file), out);
+  }
+}
+
+void EncodeStackFrameEntry(const Module::StackFrameEntry &entry,
+                           string *out) {
+  EncodeUInt64(entry.address, out);
+  EncodeUInt64(entry.size, out);
+  EncodeRuleMap(entry.initial_rules, out);
+  EncodeUInt64(entry.rule_changes.size(), out);
+  for (Module::RuleChangeMap::const_iterator it = entry.rule_changes.begin();
+       it != entry.rule_changes.end(); ++it) {
+    EncodeUInt64(it->first, out);
+    EncodeRuleMap(it->second, out);
+  }
+}
+
+// Create an unlinked temporary file in DIRECTORY, and return its
+// descriptor, or -1 on failure.
+int CreateSpillFile(const string &directory) {
+  string path = directory + "/dump_syms.XXXXXX";
+  vector<char> path_template(path.begin(), path.end());
+  path_template.push_back('\0');
+  int fd = mkstemp(&path_template[0]);
+  if (fd >= 0)
+    unlink(&path_template[0]);
+  return fd;
+}
+
+// Write BUFFER to FD at *OFFSET, advance *OFFSET past it and clear
+// BUFFER. Return false if writing failed.
+bool WriteSpillChunk(int fd, uint64_t *offset, string *buffer) {
+  size_t written = 0;
+  while (written < buffer->size()) {
+    ssize_t result = pwrite(fd, buffer->data() + written,
+                            buffer->size() - written, *offset + written);
+    if (result < 0 && errno == EINTR)
+      continue;
+    if (result <= 0)
+      return false;
+    written += result;
+  }
+  *offset += written;
+  buffer->clear();
+  return true;
+}
+
+// Decodes data written to a temporary file, starting at a given offset,
+// reading it in large chunks.
+class SpillReader {
+ public:
+  SpillReader(int fd, uint64_t offset)
+      : fd_(fd), offset_(offset), position_(0), failed_(false) { }
+
+  // True if reading the file failed, or ran past its end. Values read
+  // since then are zero or empty.
+  bool failed() const { return failed_; }
+
+  uint64_t ReadUInt64() {
+    uint64_t value = 0;
+    Read(&value, sizeof(value));
+    return value;
+  }
+
+  void ReadString(string *value) {
+    uint64_t size = ReadUInt64();
+    value->clear();
+    while (size > 0 && !failed_) {
+      if (position_ == buffer_.size() && !Fill())
+        return;
+      size_t count = std::min<uint64_t>(size, buffer_.size() - position_);
+      value->append(&buffer_[position_], count);
+      position_ += count;
+      size -= count;
+    }
+  }
+
+  void ReadRuleMap(Module::RuleMap *rule_map) {
+    rule_map->clear();
+    string name;
+    for (uint64_t count = ReadUInt64(); count > 0 && !failed_; --count) {
+      ReadString(&name);
+      ReadString(&(*rule_map)[name]);
+    }
+  }
+
+  void ReadFunction(Module::Function *function) {
+    function->address = ReadUInt64();
+    function->size = ReadUInt64();
+    function->parameter_size = ReadUInt64();
+    ReadString(&function->name);
+    function->lines.clear();
+    uint64_t count = ReadUInt64();
+    if (!failed_)
+      function->lines.reserve(count);
+    for (; count > 0 && !failed_; --count) {
+      Module::Line line;
+      line.address = ReadUInt64();
+      line.size = ReadUInt64();
+      line.number = static_cast<int>(static_cast<int64_t>(ReadUInt64()));
+      line.file = reinterpret_cast<Module::File *>(
+          static_cast<uintptr_t>(ReadUInt64()));
+      function->lines.push_back(line);
+    }
+  }
+
+  void ReadStackFrameEntry(Module::StackFrameEntry *entry) {
+    entry->address = ReadUInt64();
+    entry->size = ReadUInt64();
+    ReadRuleMap(&entry->initial_rules);
+    entry->rule_changes.clear();
+    for (uint64_t count = ReadUInt64(); count > 0 && !failed_; --count) {
+      Module::Address address = ReadUInt64();
+      ReadRuleMap(&entry->rule_changes[address]);
+    }
+  }
+
+ private:
+  static const size_t kBufferSize = 64 * 1024;
+
+  void Read(void *data, size_t size) {
+    char *out = static_cast<char *>(data);
+    while (size > 0) {
+      if (position_ == buffer_.size() && !Fill())
+        return;
+      size_t count = std::min(size, buffer_.size() - position_);
+      memcpy(out, &buffer_[position_], count);
+      position_ += count;
+      out += count;
+      size -= count;
+    }
+  }
+
+  // Read the next chunk of the file into buffer_. Return false, and set
+  // failed_, if there is none.
+  bool Fill() {
+    buffer_.resize(kBufferSize);
+    ssize_t result;
+    do {
+      result = pread(fd_, &buffer_[0], kBufferSize, offset_);
+    } while (result < 0 && errno == EINTR);
+    if (result <= 0) {
+      buffer_.clear();
+      position_ = 0;
+      failed_ = true;
+      return false;
+    }
+    buffer_.resize(result);
+    position_ = 0;
+    offset_ += result;
+    return true;
+  }
+
+  int fd_;
+  uint64_t offset_;
+  vector<char> buffer_;
+  size_t position_;
+  bool failed_;
+};
+
+// Report that data written to a temporary file could not be read back.
+// Return false.
+bool ReportSpillReadError() {
+  fprintf(stderr, "error reading back temporary symbol data\n");
+  return false;
+}
+
+}  // namespace
+
+// Merges the runs of functions a module has written out with the
+// functions it holds in memory, in FunctionCompare order, skipping
+// functions with the same address and name as one already returned. At
+// equal positions, functions from earlier runs, added earlier, come
+// first, so the one kept is the first added, as in SortFunctions.
+class Module::FunctionMerger {
+ public:
+  // MODULE's functions_ must be sorted.
+  explicit FunctionMerger(const Module *module)
+      : pending_(NULL), has_last_(false), last_address_(0), failed_(false) {
+    for (size_t i = 0; i < module->function_runs_.size(); i++) {
+      Source *source = new Source(i);
+      source->reader = new SpillReader(module->function_spill_fd_,
+                                       module->function_runs_[i].offset);
+      source->remaining = module->function_runs_[i].count;
+      sources_.push_back(source);
+    }
+    Source *in_memory = new Source(sources_.size());
+    in_memory->next = module->functions_.begin();
+    in_memory->end = module->functions_.end();
+    sources_.push_back(in_memory);
+
+    for (size_t i = 0; i < sources_.size(); i++) {
+      if (Advance(sources_[i]))
+        heap_.push_back(sources_[i]);
+    }
+    std::make_heap(heap_.begin(), heap_.end(), Later());
+  }
+
+  ~FunctionMerger() {
+    for (size_t i = 0; i < sources_.size(); i++) {
+      delete sources_[i]->reader;
+      delete sources_[i];
+    }
+  }
+
+  // Return the next function, or NULL if there are no more or reading
+  // a run failed. The function is valid until the next call.
+  const Function *Next() {
+    for (;;) {
+      if (pending_ && Advance(pending_)) {
+        heap_.push_back(pending_);
+        std::push_heap(heap_.begin(), heap_.end(), Later());
+      }
+      pending_ = NULL;
+      if (failed_ || heap_.empty())
+        return NULL;
+
+      std::pop_heap(heap_.begin(), heap_.end(), Later());
+      pending_ = heap_.back();
+      heap_.pop_back();
+      const Function *function = pending_->current;
+      if (has_last_ && function->address == last_address_ &&
+          function->name == last_name_)
+        continue;
+      has_last_ = true;
+      last_address_ = function->address;
+      last_name_ = function->name;
+      return function;
+    }
+  }
+
+  bool failed() const { return failed_; }
+
+ private:
+  struct Source {
+    explicit Source(size_t index)
+        : index(index), reader(NULL), remaining(0), current(NULL) { }
+
+    // The position of this source among the runs, in the order added.
+    size_t index;
+
+    // For a run written out, its reader, the functions left to read, and
+    // the last function read.
+    SpillReader *reader;
+    size_t remaining;
+    Function function;
+
+    // For the functions in memory, the next and end.
+    vector<Function *>::const_iterator next, end;
+
+    // The function this source is at.
+    const Function *current;
+  };
+
+  // Orders sources so that a heap returns the earliest first.
+  struct Later {
+    bool operator()(const Source *a, const Source *b) const {
+      if (FunctionCompare()(b->current, a->current))
+        return true;
+      if (FunctionCompare()(a->current, b->current))
+        return false;
+      return a->index > b->index;
+    }
+  };
+
+  // Move SOURCE to its next function. Return false if it has no more,
+  // or reading it failed.
+  bool Advance(Source *source) {
+    if (!source->reader) {
+      if (source->next == source->end)
+        return false;
+      source->current = *source->next++;
+      return true;
+    }
+    if (source->remaining == 0)
+      return false;
+    source->remaining--;
+    source->reader->ReadFunction(&source->function);
+    if (source->reader->failed()) {
+      failed_ = true;
+      return false;
+    }
+    source->current = &source->function;
+    return true;
+  }
+
+  vector<Source *> sources_;
+  vector<Source *> heap_;
+
+  // The source of the function last returned, to advance on the next
+  // call, and that function's address and name.
+  Source *pending_;
+  bool has_last_;
+  Address last_address_;
+  string last_name_;
+
+  bool failed_;
+};
 
 Module::Module(const string &name, const string &os,
                const string &architecture, const string &id) :
@@ -54,12 +569,23 @@ Module::Module(const string &name, const string &os,
     os_(os),
     architecture_(architecture),
     id_(id),
-    load_address_(0) { }
+    load_address_(0),
+    functions_sorted_(true),
+    externs_sorted_(true),
+    memory_budget_(0),
+    function_bytes_(0),
+    stack_frame_entry_bytes_(0),
+    function_spill_fd_(-1),
+    function_spill_size_(0),
+    stack_frame_spill_fd_(-1),
+    spilled_stack_frame_entries_(0),
+    stack_frame_spill_size_(0),
+    spill_error_(false) { }
 
 Module::~Module() {
   for (FileByNameMap::iterator it = files_.begin(); it != files_.end(); ++it)
     delete it->second;
-  for (FunctionSet::iterator it = functions_.begin();
+  for (vector<Function *>::iterator it = functions_.begin();
        it != functions_.end(); ++it) {
     delete *it;
   }
@@ -67,63 +593,354 @@ Module::~Module() {
        it != stack_frame_entries_.end(); ++it) {
     delete *it;
   }
-  for (ExternSet::iterator it = externs_.begin(); it != externs_.end(); ++it)
+  for (vector<Extern *>::iterator it = externs_.begin();
+       it != externs_.end(); ++it) {
     delete *it;
+  }
+  CloseSpillFiles();
+}
+
+void Module::SetMemoryBudget(size_t bytes, const string &temp_directory) {
+  memory_budget_ = bytes;
+  temp_directory_ = temp_directory;
+  SpillIfOverBudget();
 }
 
 void Module::SetLoadAddress(Address address) {
   load_address_ = address;
 }
 
-void Module::AddFunction(Function *function) {
+void Module::AppendFunction(Function *function) {
   // FUNC lines must not hold an empty name, so catch the problem early if
   // callers try to add one.
   assert(!function->name.empty());
-  std::pair<FunctionSet::iterator,bool> ret = functions_.insert(function);
-  if (!ret.second) {
-    // Free the duplicate that was not inserted because this Module
-    // now owns it.
-    delete function;
-  }
+  // Duplicates are dropped when the functions are sorted.
+  if (!functions_.empty() && !FunctionCompare()(functions_.back(), function))
+    functions_sorted_ = false;
+  functions_.push_back(function);
+  function_bytes_ += FunctionBytes(function);
+  // Externs that repeat this function must now be dropped.
+  if (!externs_.empty())
+    externs_sorted_ = false;
+}
+
+void Module::AddFunction(Function *function) {
+  AppendFunction(function);
+  SpillIfOverBudget();
 }
 
 void Module::AddFunctions(vector<Function *>::iterator begin,
                           vector<Function *>::iterator end) {
+  functions_.reserve(functions_.size() + (end - begin));
   for (vector<Function *>::iterator it = begin; it != end; ++it)
-    AddFunction(*it);
+    AppendFunction(*it);
+  SpillIfOverBudget();
+}
+
+void Module::TakeFunctions(Module *other) {
+  map<File *, File *> file_map;
+  for (FileByNameMap::iterator it = other->files_.begin();
+       it != other->files_.end(); ++it)
+    file_map[it->second] = FindFile(it->second->name);
+
+  other->Unspill();
+  other->SortFunctions();
+  functions_.reserve(functions_.size() + other->functions_.size());
+  for (vector<Function *>::iterator it = other->functions_.begin();
+       it != other->functions_.end(); ++it) {
+    Function *function = *it;
+    for (vector<Line>::iterator line = function->lines.begin();
+         line != function->lines.end(); ++line)
+      line->file = file_map[line->file];
+    AppendFunction(function);
+  }
+  other->functions_.clear();
+  other->function_bytes_ = 0;
+  SpillIfOverBudget();
 }
 
 void Module::AddStackFrameEntry(StackFrameEntry *stack_frame_entry) {
   stack_frame_entries_.push_back(stack_frame_entry);
+  stack_frame_entry_bytes_ += StackFrameEntryBytes(stack_frame_entry);
+  SpillIfOverBudget();
+}
+
+void Module::TakeStackFrameEntries(Module *other) {
+  other->Unspill();
+  stack_frame_entries_.insert(stack_frame_entries_.end(),
+                              other->stack_frame_entries_.begin(),
+                              other->stack_frame_entries_.end());
+  stack_frame_entry_bytes_ += other->stack_frame_entry_bytes_;
+  other->stack_frame_entries_.clear();
+  other->stack_frame_entry_bytes_ = 0;
+  SpillIfOverBudget();
+}
+
+void Module::SpillIfOverBudget() {
+  if (memory_budget_ == 0 ||
+      function_bytes_ + stack_frame_entry_bytes_ <= memory_budget_)
+    return;
+
+  bool functions_first = function_bytes_ >= stack_frame_entry_bytes_;
+  bool ok = functions_first ? SpillFunctions() : SpillStackFrameEntries();
+  if (ok && function_bytes_ + stack_frame_entry_bytes_ > memory_budget_)
+    ok = functions_first ? SpillStackFrameEntries() : SpillFunctions();
+  if (!ok) {
+    fprintf(stderr, "error writing temporary symbol data to %s: %s;"
+            " keeping it in memory\n", temp_directory_.c_str(),
+            strerror(errno));
+    memory_budget_ = 0;
+  }
+}
+
+bool Module::SpillFunctions() {
+  if (functions_.empty())
+    return true;
+  if (function_spill_fd_ < 0 &&
+      (function_spill_fd_ = CreateSpillFile(temp_directory_)) < 0)
+    return false;
+
+  SortFunctions();
+  uint64_t offset = function_spill_size_;
+  string buffer;
+  for (vector<Function *>::const_iterator it = functions_.begin();
+       it != functions_.end(); ++it) {
+    EncodeFunction(**it, &buffer);
+    if (buffer.size() >= kSpillChunkBytes &&
+        !WriteSpillChunk(function_spill_fd_, &offset, &buffer))
+      return false;
+  }
+  if (!WriteSpillChunk(function_spill_fd_, &offset, &buffer))
+    return false;
+
+  FunctionRun run = { function_spill_size_, functions_.size() };
+  function_runs_.push_back(run);
+  function_spill_size_ = offset;
+  for (vector<Function *>::iterator it = functions_.begin();
+       it != functions_.end(); ++it)
+    delete *it;
+  functions_.clear();
+  function_bytes_ = 0;
+  return true;
+}
+
+bool Module::SpillStackFrameEntries() {
+  if (stack_frame_entries_.empty())
+    return true;
+  if (stack_frame_spill_fd_ < 0 &&
+      (stack_frame_spill_fd_ = CreateSpillFile(temp_directory_)) < 0)
+    return false;
+
+  uint64_t offset = stack_frame_spill_size_;
+  string buffer;
+  for (vector<StackFrameEntry *>::const_iterator it =
+           stack_frame_entries_.begin();
+       it != stack_frame_entries_.end(); ++it) {
+    EncodeStackFrameEntry(**it, &buffer);
+    if (buffer.size() >= kSpillChunkBytes &&
+        !WriteSpillChunk(stack_frame_spill_fd_, &offset, &buffer))
+      return false;
+  }
+  if (!WriteSpillChunk(stack_frame_spill_fd_, &offset, &buffer))
+    return false;
+
+  stack_frame_spill_size_ = offset;
+  spilled_stack_frame_entries_ += stack_frame_entries_.size();
+  for (vector<StackFrameEntry *>::iterator it = stack_frame_entries_.begin();
+       it != stack_frame_entries_.end(); ++it)
+    delete *it;
+  stack_frame_entries_.clear();
+  stack_frame_entry_bytes_ = 0;
+  return true;
+}
+
+void Module::Unspill() {
+  if (!function_runs_.empty()) {
+    // The functions written out were added before those in memory.
+    vector<Function *> functions;
+    for (size_t i = 0; i < function_runs_.size() && !spill_error_; i++) {
+      SpillReader reader(function_spill_fd_, function_runs_[i].offset);
+      for (size_t j = 0; j < function_runs_[i].count; j++) {
+        Function *function = new Function;
+        reader.ReadFunction(function);
+        if (reader.failed()) {
+          delete function;
+          spill_error_ = true;
+          break;
+        }
+        functions.push_back(function);
+        function_bytes_ += FunctionBytes(function);
+      }
+    }
+    functions.insert(functions.end(), functions_.begin(), functions_.end());
+    functions_.swap(functions);
+    functions_sorted_ = false;
+  }
+
+  if (spilled_stack_frame_entries_ > 0) {
+    vector<StackFrameEntry *> entries;
+    SpillReader reader(stack_frame_spill_fd_, 0);
+    for (size_t i = 0; i < spilled_stack_frame_entries_; i++) {
+      StackFrameEntry *entry = new StackFrameEntry;
+      reader.ReadStackFrameEntry(entry);
+      if (reader.failed()) {
+        delete entry;
+        spill_error_ = true;
+        break;
+      }
+      entries.push_back(entry);
+      stack_frame_entry_bytes_ += StackFrameEntryBytes(entry);
+    }
+    entries.insert(entries.end(), stack_frame_entries_.begin(),
+                   stack_frame_entries_.end());
+    stack_frame_entries_.swap(entries);
+  }
+
+  if (spill_error_)
+    ReportSpillReadError();
+  CloseSpillFiles();
+}
+
+void Module::CloseSpillFiles() {
+  if (function_spill_fd_ >= 0)
+    close(function_spill_fd_);
+  if (stack_frame_spill_fd_ >= 0)
+    close(stack_frame_spill_fd_);
+  function_spill_fd_ = stack_frame_spill_fd_ = -1;
+  function_runs_.clear();
+  function_spill_size_ = stack_frame_spill_size_ = 0;
+  spilled_stack_frame_entries_ = 0;
 }
 
 void Module::AddExtern(Extern *ext) {
-  Function func;
-  func.name = ext->name;
-  func.address = ext->address;
+  // Externs that duplicate a function, or another extern's address, are
+  // dropped when the externs are sorted.
+  externs_sorted_ = false;
+  externs_.push_back(ext);
+}
+
+void Module::AddExterns(vector<Extern *>::iterator begin,
+                        vector<Extern *>::iterator end) {
+  externs_.reserve(externs_.size() + (end - begin));
+  for (vector<Extern *>::iterator it = begin; it != end; ++it)
+    AddExtern(*it);
+}
+
+void Module::SortFunctions() {
+  if (functions_sorted_)
+    return;
+
+  // As in SortExterns, a stable sort keeps the first function added
+  // with each address and name ahead of its duplicates.
+  std::stable_sort(functions_.begin(), functions_.end(), FunctionCompare());
+  vector<Function *>::iterator kept = functions_.begin();
+  for (vector<Function *>::iterator it = functions_.begin();
+       it != functions_.end(); ++it) {
+    if (kept != functions_.begin() &&
+        !FunctionCompare()(*(kept - 1), *it))
+      delete *it;
+    else
+      *kept++ = *it;
+  }
+  functions_.erase(kept, functions_.end());
+  functions_sorted_ = true;
+}
+
+void Module::SortExterns() {
+  if (externs_sorted_)
+    return;
 
   // Since parsing debug section and public info are not necessarily
-  // mutually exclusive, check if the symbol has already been read
-  // as a function to avoid duplicates.
-  if (functions_.find(&func) == functions_.end()) {
-    std::pair<ExternSet::iterator,bool> ret = externs_.insert(ext);
-    if (!ret.second) {
-      // Free the duplicate that was not inserted because this Module
-      // now owns it.
-      delete ext;
+  // mutually exclusive, drop externs that have already been read as
+  // functions.
+  SortFunctions();
+
+  // A stable sort keeps the externs at each address in the order they
+  // were added, so the first of them is the one kept.
+  SortExternsByAddress(&externs_);
+  Function func;
+  vector<Extern *>::iterator kept = externs_.begin();
+  for (vector<Extern *>::iterator it = externs_.begin();
+       it != externs_.end(); ++it) {
+    func.name = (*it)->name;
+    func.address = (*it)->address;
+    if (std::binary_search(functions_.begin(), functions_.end(), &func,
+                           FunctionCompare()))
+      delete *it;
+    else if (kept != externs_.begin() &&
+             (*(kept - 1))->address == (*it)->address)
+      delete *it;
+    else
+      *kept++ = *it;
+  }
+  externs_.erase(kept, externs_.end());
+  externs_sorted_ = true;
+}
+
+void Module::PrepareSpilledWrite() {
+  for (FileByNameMap::iterator file_it = files_.begin();
+       file_it != files_.end(); ++file_it) {
+    file_it->second->source_id = -1;
+  }
+
+  // Merge the functions once, marking the files their lines cite, as
+  // AssignSourceIds does, and the externs that repeat them, as
+  // SortExterns would find with its binary search.
+  SortFunctions();
+  SortExternsByAddress(&externs_);
+  vector<bool> repeats_function(externs_.size());
+  Extern key;
+  FunctionMerger merger(this);
+  while (const Function *func = merger.Next()) {
+    for (vector<Line>::const_iterator line_it = func->lines.begin();
+         line_it != func->lines.end(); ++line_it)
+      line_it->file->source_id = 0;
+    key.address = func->address;
+    std::pair<vector<Extern *>::iterator, vector<Extern *>::iterator> range =
+        std::equal_range(externs_.begin(), externs_.end(), &key,
+                         ExternCompare());
+    for (vector<Extern *>::iterator it = range.first; it != range.second;
+         ++it) {
+      if ((*it)->name == func->name)
+        repeats_function[it - externs_.begin()] = true;
     }
-  } else {
-    delete ext;
+  }
+  if (merger.failed())
+    spill_error_ = true;
+
+  vector<Extern *>::iterator kept = externs_.begin();
+  for (size_t i = 0; i < externs_.size(); i++) {
+    Extern *ext = externs_[i];
+    if (repeats_function[i])
+      delete ext;
+    else if (kept != externs_.begin() &&
+             (*(kept - 1))->address == ext->address)
+      delete ext;
+    else
+      *kept++ = ext;
+  }
+  externs_.erase(kept, externs_.end());
+  externs_sorted_ = true;
+
+  int next_source_id = 0;
+  for (FileByNameMap::iterator file_it = files_.begin();
+       file_it != files_.end(); ++file_it) {
+    if (!file_it->second->source_id)
+      file_it->second->source_id = next_source_id++;
   }
 }
 
 void Module::GetFunctions(vector<Function *> *vec,
                           vector<Function *>::iterator i) {
+  Unspill();
+  SortFunctions();
   vec->insert(i, functions_.begin(), functions_.end());
 }
 
 void Module::GetExterns(vector<Extern *> *vec,
                         vector<Extern *>::iterator i) {
+  Unspill();
+  SortExterns();
   vec->insert(i, externs_.begin(), externs_.end());
 }
 
@@ -160,17 +977,46 @@ Module::File *Module::FindExistingFile(const string &name) {
   return (it == files_.end()) ? NULL : it->second;
 }
 
+const char *Module::InternPathPart(const string &part) {
+  return path_parts_.Intern(part);
+}
+
+Module::File *Module::FindFileInDirectory(const char *directory,
+                                          const char *name) {
+  PathParts key(directory, name);
+  FileByPathPartsMap::const_iterator it = files_by_path_parts_.find(key);
+  if (it != files_by_path_parts_.end())
+    return it->second;
+
+  File *file;
+  size_t directory_length = strlen(directory);
+  if (name[0] == '/' || directory_length == 0) {
+    file = FindFile(name);
+  } else {
+    string path(directory, directory_length);
+    if (directory[directory_length - 1] != '/')
+      path += '/';
+    path += name;
+    file = FindFile(path);
+  }
+  files_by_path_parts_[key] = file;
+  return file;
+}
+
 void Module::GetFiles(vector<File *> *vec) {
   vec->clear();
   for (FileByNameMap::iterator it = files_.begin(); it != files_.end(); ++it)
     vec->push_back(it->second);
 }
 
-void Module::GetStackFrameEntries(vector<StackFrameEntry *> *vec) const {
+void Module::GetStackFrameEntries(vector<StackFrameEntry *> *vec) {
+  Unspill();
   *vec = stack_frame_entries_;
 }
 
 void Module::AssignSourceIds() {
+  Unspill();
+
   // First, give every source file an id of -1.
   for (FileByNameMap::iterator file_it = files_.begin();
        file_it != files_.end(); ++file_it) {
@@ -179,7 +1025,8 @@ void Module::AssignSourceIds() {
 
   // Next, mark all files actually cited by our functions' line number
   // info, by setting each one's source id to zero.
-  for (FunctionSet::const_iterator func_it = functions_.begin();
+  SortFunctions();
+  for (vector<Function *>::const_iterator func_it = functions_.begin();
        func_it != functions_.end(); ++func_it) {
     Function *func = *func_it;
     for (vector<Line>::iterator line_it = func->lines.begin();
@@ -205,100 +1052,104 @@ bool Module::ReportError() {
   return false;
 }
 
-bool Module::WriteRuleMap(const RuleMap &rule_map, std::ostream &stream) {
-  for (RuleMap::const_iterator it = rule_map.begin();
-       it != rule_map.end(); ++it) {
-    if (it != rule_map.begin())
-      stream << ' ';
-    stream << it->first << ": " << it->second;
-  }
-  return stream.good();
-}
-
 bool Module::Write(std::ostream &stream, SymbolData symbol_data) {
-  stream << "MODULE " << os_ << " " << architecture_ << " "
-         << id_ << " " << name_ << endl;
-  if (!stream.good())
+  RecordWriter writer(stream);
+  writer.Append("MODULE ");
+  writer.Append(os_);
+  writer.Append(' ');
+  writer.Append(architecture_);
+  writer.Append(' ');
+  writer.Append(id_);
+  writer.Append(' ');
+  writer.Append(name_);
+  if (!writer.EndRecord())
     return ReportError();
 
+  if (spill_error_)
+    return ReportSpillReadError();
+
   if (symbol_data != ONLY_CFI) {
-    AssignSourceIds();
+    // With functions written out to the temporary file, merge them
+    // with those in memory rather than reading them all back.
+    bool spilled = !function_runs_.empty();
+    if (spilled) {
+      PrepareSpilledWrite();
+      if (spill_error_)
+        return ReportSpillReadError();
+    } else {
+      AssignSourceIds();
+    }
 
     // Write out files.
     for (FileByNameMap::iterator file_it = files_.begin();
          file_it != files_.end(); ++file_it) {
       File *file = file_it->second;
       if (file->source_id >= 0) {
-        stream << "FILE " << file->source_id << " " <<  file->name << endl;
-        if (!stream.good())
+        writer.Append("FILE ");
+        writer.AppendDecimal(file->source_id);
+        writer.Append(' ');
+        writer.Append(file->name);
+        if (!writer.EndRecord())
           return ReportError();
       }
     }
 
-    // Write out functions and their lines.
-    for (FunctionSet::const_iterator func_it = functions_.begin();
-         func_it != functions_.end(); ++func_it) {
-      Function *func = *func_it;
-      stream << "FUNC " << hex
-             << (func->address - load_address_) << " "
-             << func->size << " "
-             << func->parameter_size << " "
-             << func->name << dec << endl;
-      if (!stream.good())
-        return ReportError();
-
-      for (vector<Line>::iterator line_it = func->lines.begin();
-           line_it != func->lines.end(); ++line_it) {
-        stream << hex
-               << (line_it->address - load_address_) << " "
-               << line_it->size << " "
-               << dec
-               << line_it->number << " "
-               << line_it->file->source_id << endl;
-        if (!stream.good())
+    // Write out functions and their lines.  AssignSourceIds or
+    // PrepareSpilledWrite has sorted them.
+    if (spilled) {
+      FunctionMerger merger(this);
+      while (const Function *func = merger.Next()) {
+        if (!WriteFunction(*func, load_address_, &writer))
+          return ReportError();
+      }
+      if (merger.failed())
+        return ReportSpillReadError();
+    } else {
+      for (vector<Function *>::const_iterator func_it = functions_.begin();
+           func_it != functions_.end(); ++func_it) {
+        if (!WriteFunction(**func_it, load_address_, &writer))
           return ReportError();
       }
     }
 
     // Write out 'PUBLIC' records.
-    for (ExternSet::const_iterator extern_it = externs_.begin();
+    SortExterns();
+    for (vector<Extern *>::const_iterator extern_it = externs_.begin();
          extern_it != externs_.end(); ++extern_it) {
       Extern *ext = *extern_it;
-      stream << "PUBLIC " << hex
-             << (ext->address - load_address_) << " 0 "
-             << ext->name << dec << endl;
+      writer.Append("PUBLIC ");
+      writer.AppendHex(ext->address - load_address_);
+      writer.Append(" 0 ");
+      writer.Append(ext->name);
+      if (!writer.EndRecord())
+        return ReportError();
     }
   }
 
   if (symbol_data != NO_CFI) {
-    // Write out 'STACK CFI INIT' and 'STACK CFI' records.
-    vector<StackFrameEntry *>::const_iterator frame_it;
-    for (frame_it = stack_frame_entries_.begin();
-         frame_it != stack_frame_entries_.end(); ++frame_it) {
-      StackFrameEntry *entry = *frame_it;
-      stream << "STACK CFI INIT " << hex
-             << (entry->address - load_address_) << " "
-             << entry->size << " " << dec;
-      if (!stream.good()
-          || !WriteRuleMap(entry->initial_rules, stream))
-        return ReportError();
-
-      stream << endl;
-
-      // Write out this entry's delta rules as 'STACK CFI' records.
-      for (RuleChangeMap::const_iterator delta_it = entry->rule_changes.begin();
-           delta_it != entry->rule_changes.end(); ++delta_it) {
-        stream << "STACK CFI " << hex
-               << (delta_it->first - load_address_) << " " << dec;
-        if (!stream.good()
-            || !WriteRuleMap(delta_it->second, stream))
+    // Write out 'STACK CFI INIT' and 'STACK CFI' records, first for the
+    // entries written out to the temporary file, in the order added.
+    if (spilled_stack_frame_entries_ > 0) {
+      SpillReader reader(stack_frame_spill_fd_, 0);
+      StackFrameEntry entry;
+      for (size_t i = 0; i < spilled_stack_frame_entries_; i++) {
+        reader.ReadStackFrameEntry(&entry);
+        if (reader.failed())
+          return ReportSpillReadError();
+        if (!WriteStackFrameEntry(entry, load_address_, &writer))
           return ReportError();
-
-        stream << endl;
       }
     }
+    for (vector<StackFrameEntry *>::const_iterator frame_it =
+             stack_frame_entries_.begin();
+         frame_it != stack_frame_entries_.end(); ++frame_it) {
+      if (!WriteStackFrameEntry(**frame_it, load_address_, &writer))
+        return ReportError();
+    }
   }
 
+  if (!writer.Flush())
+    return ReportError();
   return true;
 }
 
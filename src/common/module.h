@@ -42,9 +42,12 @@
 #include <map>
 #include <set>
 #include <string>
+#include <utility>
 #include <vector>
 
+#include "common/string_interner.h"
 #include "common/symbol_data.h"
+#include "common/unordered.h"
 #include "common/using_std_string.h"
 #include "google_breakpad/common/breakpad_types.h"
 
@@ -175,6 +178,22 @@ class Module {
          const string &id);
   ~Module();
 
+  // Keep the functions and stack frame entries held in memory to about
+  // BYTES, by writing them out to unlinked temporary files in
+  // TEMP_DIRECTORY whenever they grow past it: functions as runs sorted
+  // by address, which Write merges, and stack frame entries in the order
+  // they were added. Names and lines go with them; files and externs stay
+  // in memory. The symbol file written is the same as without a budget.
+  // Functions and entries written out are read back into memory if
+  // GetFunctions, GetExterns, GetStackFrameEntries, AssignSourceIds, or
+  // another module's TakeFunctions or TakeStackFrameEntries needs them. If a temporary file can't be written,
+  // the module reports the error and keeps everything in memory from
+  // then on. A BYTES of zero, the default, sets no budget. With a
+  // budget, a function or stack frame entry added to the module may be
+  // freed as soon as it is added.
+  void SetMemoryBudget(size_t bytes, const string &temp_directory);
+  size_t memory_budget() const { return memory_budget_; }
+
   // Set the module's load address to LOAD_ADDRESS; addresses given
   // for functions and lines will be written to the Breakpad symbol
   // file as offsets from this address.  Construction initializes this
@@ -200,16 +219,32 @@ class Module {
   void AddFunctions(vector<Function *>::iterator begin,
                     vector<Function *>::iterator end);
 
+  // Move all of OTHER's functions to this module, as if by AddFunction,
+  // in address order. Their lines are made to refer to this module's
+  // files of the same names. OTHER is left with no functions.
+  void TakeFunctions(Module *other);
+
   // Add STACK_FRAME_ENTRY to the module.
   // This module owns all StackFrameEntry objects added with this
   // function: destroying the module destroys them as well.
   void AddStackFrameEntry(StackFrameEntry *stack_frame_entry);
 
+  // Move all of OTHER's stack frame entries to the end of this module's,
+  // as if by AddStackFrameEntry, in the order OTHER received them.
+  // OTHER is left with no stack frame entries.
+  void TakeStackFrameEntries(Module *other);
+
   // Add PUBLIC to the module.
   // This module owns all Extern objects added with this function:
   // destroying the module destroys them as well.
   void AddExtern(Extern *ext);
 
+  // Add all the externs in [BEGIN,END) to the module, as if by AddExtern.
+  // This module owns all Extern objects added with this function:
+  // destroying the module destroys them as well.
+  void AddExterns(vector<Extern *>::iterator begin,
+                  vector<Extern *>::iterator end);
+
   // If this module has a file named NAME, return a pointer to it. If
   // it has none, then create one and return a pointer to the new
   // file. This module owns all File objects created using these
@@ -221,6 +256,20 @@ class Module {
   // Otherwise, return NULL.
   File *FindExistingFile(const string &name);
 
+  // Return a pointer to a NUL-terminated copy of PART, a directory or a
+  // file's name, suitable for passing to FindFileInDirectory. Interning
+  // equal strings yields the same pointer, which stays valid for the
+  // lifetime of this module.
+  const char *InternPathPart(const string &part);
+
+  // Return FindFile(NAME) if NAME is absolute or DIRECTORY is empty, and
+  // FindFile(DIRECTORY + "/" + NAME) otherwise. DIRECTORY and NAME must
+  // have been returned by InternPathPart. The result is remembered under
+  // the pair of pointers, so finding the same file again, as readers of
+  // line number tables do for every compilation unit that includes a
+  // given header, neither builds nor compares its full name.
+  File *FindFileInDirectory(const char *directory, const char *name);
+
   // Insert pointers to the functions added to this module at I in
   // VEC. The pointed-to Functions are still owned by this module.
   // (Since this is effectively a copy of the function list, this is
@@ -247,7 +296,7 @@ class Module {
   // effectively a copy of the stack frame entry list, this is mostly
   // useful for testing; other uses should probably get
   // a more appropriate interface.)
-  void GetStackFrameEntries(vector<StackFrameEntry *> *vec) const;
+  void GetStackFrameEntries(vector<StackFrameEntry *> *vec);
 
   // Find those files in this module that are actually referred to by
   // functions' line number data, and assign them source id numbers.
@@ -276,14 +325,53 @@ class Module {
   string identifier() const { return id_; }
 
  private:
+  class FunctionMerger;
+
+  // A run of functions written out by SpillIfOverBudget: COUNT functions
+  // starting at OFFSET in function_spill_fd_, sorted without duplicates.
+  struct FunctionRun {
+    uint64_t offset;
+    size_t count;
+  };
+
   // Report an error that has occurred writing the symbol file, using
   // errno to find the appropriate cause.  Return false.
   static bool ReportError();
 
-  // Write RULE_MAP to STREAM, in the form appropriate for 'STACK CFI'
-  // records, without a final newline. Return true if all goes well;
-  // if an error occurs, return false, and leave errno set.
-  static bool WriteRuleMap(const RuleMap &rule_map, std::ostream &stream);
+  // Add FUNCTION to functions_, and count the memory it takes.
+  void AppendFunction(Function *function);
+
+  // If the functions and stack frame entries in memory take more than
+  // the memory budget, write out the larger of the two, and then the
+  // other if that wasn't enough.
+  void SpillIfOverBudget();
+
+  // Write functions_ out as a new run, or stack_frame_entries_ out
+  // after the entries already written, and free them. Return false if
+  // writing failed, leaving them in memory.
+  bool SpillFunctions();
+  bool SpillStackFrameEntries();
+
+  // Read every function and stack frame entry written out back into
+  // memory, and drop the temporary files.
+  void Unspill();
+
+  // With functions written out, do what AssignSourceIds and SortExterns
+  // do for Write, merging the runs to find the files and functions that
+  // will be written.
+  void PrepareSpilledWrite();
+
+  // Close the temporary files and forget what was written to them.
+  void CloseSpillFiles();
+
+  // Sort functions_ with FunctionCompare, keeping only the first
+  // function added with each address and name.
+  void SortFunctions();
+
+  // Sort externs_ by address, dropping those with the same address and
+  // name as a function, and keeping only the first of the rest added at
+  // each address.
+  void SortExterns();
 
   // Module header entries.
   string name_, os_, architecture_, id_;
@@ -303,25 +391,67 @@ class Module {
   // pointers to the Files' names.
   typedef map<const string *, File *, CompareStringPtrs> FileByNameMap;
 
-  // A set containing Function structures, sorted by address.
-  typedef set<Function *, FunctionCompare> FunctionSet;
-
-  // A set containing Extern structures, sorted by address.
-  typedef set<Extern *, ExternCompare> ExternSet;
+  // A map from interned directories and names, as passed to
+  // FindFileInDirectory, to File structures.
+  typedef std::pair<const char *, const char *> PathParts;
+  struct HashPathParts {
+    size_t operator()(const PathParts &parts) const {
+      return reinterpret_cast<uintptr_t>(parts.first) * 31 +
+             reinterpret_cast<uintptr_t>(parts.second);
+    }
+  };
+  typedef unordered_map<PathParts, File *, HashPathParts> FileByPathPartsMap;
 
   // The module owns all the files and functions that have been added
   // to it; destroying the module frees the Files and Functions these
-  // point to.
-  FileByNameMap files_;    // This module's source files.
-  FunctionSet functions_;  // This module's functions.
+  // point to. Like externs_ below, functions_ is kept in the order the
+  // functions were added, and only sorted and stripped of duplicates by
+  // SortFunctions when needed.
+  FileByNameMap files_;          // This module's source files.
+  StringInterner path_parts_;    // Directories and names of files.
+  FileByPathPartsMap files_by_path_parts_;
+  vector<Function *> functions_;  // This module's functions.
+
+  // True if functions_ is known to be sorted without duplicates.
+  bool functions_sorted_;
 
   // The module owns all the call frame info entries that have been
   // added to it.
   vector<StackFrameEntry *> stack_frame_entries_;
 
   // The module owns all the externs that have been added to it;
-  // destroying the module frees the Externs these point to.
-  ExternSet externs_;
+  // destroying the module frees the Externs these point to. They are
+  // kept in the order they were added, and only sorted and stripped of
+  // duplicate addresses by SortExterns when they are needed, so that
+  // adding many externs doesn't build a tree of them one by one.
+  vector<Extern *> externs_;
+
+  // True if externs_ is known to be sorted by address, without
+  // duplicates and without externs that repeat a function.
+  bool externs_sorted_;
+
+  // The memory budget, and the directory for the temporary files, if
+  // one was set.
+  size_t memory_budget_;
+  string temp_directory_;
+
+  // Estimates of the bytes functions_ and stack_frame_entries_ take.
+  size_t function_bytes_;
+  size_t stack_frame_entry_bytes_;
+
+  // The temporary files, or -1 if not yet created, and how much has
+  // been written to each: the runs of functions in the first, and the
+  // stack frame entries in the second, which come before those in
+  // stack_frame_entries_.
+  int function_spill_fd_;
+  vector<FunctionRun> function_runs_;
+  uint64_t function_spill_size_;
+  int stack_frame_spill_fd_;
+  size_t spilled_stack_frame_entries_;
+  uint64_t stack_frame_spill_size_;
+
+  // True if reading back a temporary file failed; Write then fails.
+  bool spill_error_;
 };
 
 }  // namespace google_breakpad
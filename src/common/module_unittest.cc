@@ -42,8 +42,10 @@
 
 #include "breakpad_googletest_includes.h"
 #include "common/module.h"
+#include "common/tests/auto_tempdir.h"
 #include "common/using_std_string.h"
 
+using google_breakpad::AutoTempDir;
 using google_breakpad::Module;
 using std::stringstream;
 using std::vector;
@@ -396,6 +398,26 @@ TEST(Construct, UniqueFiles) {
   EXPECT_TRUE(m.FindExistingFile("baz") == NULL);
 }
 
+TEST(Construct, FilesInDirectories) {
+  Module m(MODULE_NAME, MODULE_OS, MODULE_ARCH, MODULE_ID);
+  const char *dir = m.InternPathPart("/usr/include");
+  const char *dir_with_slash = m.InternPathPart("/usr/include/");
+  const char *no_dir = m.InternPathPart("");
+  const char *name = m.InternPathPart("stdio.h");
+  EXPECT_EQ(dir, m.InternPathPart(string("/usr/include")));
+
+  Module::File *file = m.FindFileInDirectory(dir, name);
+  EXPECT_EQ("/usr/include/stdio.h", file->name);
+  EXPECT_EQ(file, m.FindFileInDirectory(dir, name));
+  EXPECT_EQ(file, m.FindFileInDirectory(dir_with_slash, name));
+  EXPECT_EQ(file, m.FindExistingFile("/usr/include/stdio.h"));
+  EXPECT_EQ(file, m.FindFileInDirectory(
+      no_dir, m.InternPathPart("/usr/include/stdio.h")));
+  EXPECT_EQ(file, m.FindFileInDirectory(
+      m.InternPathPart("/src"), m.InternPathPart("/usr/include/stdio.h")));
+  EXPECT_EQ("stdio.h", m.FindFileInDirectory(no_dir, name)->name);
+}
+
 TEST(Construct, DuplicateFunctions) {
   stringstream s;
   Module m(MODULE_NAME, MODULE_OS, MODULE_ARCH, MODULE_ID);
@@ -436,6 +458,76 @@ TEST(Construct, FunctionsWithSameAddress) {
                contents.c_str());
 }
 
+TEST(Construct, TakeFunctions) {
+  stringstream s;
+  Module m(MODULE_NAME, MODULE_OS, MODULE_ARCH, MODULE_ID);
+  Module other(MODULE_NAME, MODULE_OS, MODULE_ARCH, MODULE_ID);
+
+  // A function already in M, with the same address and name as one of
+  // OTHER's, which should be dropped when they are merged.
+  m.AddFunction(generate_duplicate_function("_without_form"));
+  other.AddFunction(generate_duplicate_function("_without_form"));
+
+  Module::Function *function = new Module::Function;
+  function->name = "function";
+  function->address = 0x1000;
+  function->size = 0x10;
+  function->parameter_size = 0;
+  Module::Line line = { 0x1000, 0x10, other.FindFile("file"), 67519080 };
+  function->lines.push_back(line);
+  other.AddFunction(function);
+
+  m.TakeFunctions(&other);
+
+  vector<Module::Function *> functions;
+  other.GetFunctions(&functions, functions.end());
+  EXPECT_TRUE(functions.empty());
+  m.GetFunctions(&functions, functions.end());
+  EXPECT_EQ(2U, functions.size());
+
+  // The line must now refer to M's file.
+  EXPECT_EQ(m.FindExistingFile("file"), function->lines[0].file);
+
+  m.Write(s, ALL_SYMBOL_DATA);
+  string contents = s.str();
+  EXPECT_STREQ("MODULE os-name architecture id-string name with spaces\n"
+               "FILE 0 file\n"
+               "FUNC 1000 10 0 function\n"
+               "1000 10 67519080 0\n"
+               "FUNC d35402aac7a7ad5c 200b26e605f99071 f14ac4fed48c4a99"
+               " _without_form\n",
+               contents.c_str());
+}
+
+TEST(Construct, TakeStackFrameEntries) {
+  Module m(MODULE_NAME, MODULE_OS, MODULE_ARCH, MODULE_ID);
+  Module other(MODULE_NAME, MODULE_OS, MODULE_ARCH, MODULE_ID);
+
+  Module::StackFrameEntry *entry1 = new Module::StackFrameEntry();
+  entry1->address = 0x2000;
+  entry1->size = 0x10;
+  m.AddStackFrameEntry(entry1);
+  Module::StackFrameEntry *entry2 = new Module::StackFrameEntry();
+  entry2->address = 0x3000;
+  entry2->size = 0x10;
+  other.AddStackFrameEntry(entry2);
+  Module::StackFrameEntry *entry3 = new Module::StackFrameEntry();
+  entry3->address = 0x1000;
+  entry3->size = 0x10;
+  other.AddStackFrameEntry(entry3);
+
+  m.TakeStackFrameEntries(&other);
+
+  vector<Module::StackFrameEntry *> entries;
+  m.GetStackFrameEntries(&entries);
+  ASSERT_EQ(3U, entries.size());
+  EXPECT_EQ(entry1, entries[0]);
+  EXPECT_EQ(entry2, entries[1]);
+  EXPECT_EQ(entry3, entries[2]);
+  other.GetStackFrameEntries(&entries);
+  EXPECT_TRUE(entries.empty());
+}
+
 // Externs should be written out as PUBLIC records, sorted by
 // address.
 TEST(Construct, Externs) {
@@ -465,6 +557,38 @@ TEST(Construct, Externs) {
 
 // Externs with the same address should only keep the first entry
 // added.
+// Externs added in bulk should be sorted by address, keeping the first
+// extern added at each address.
+TEST(Construct, AddExterns) {
+  stringstream s;
+  Module m(MODULE_NAME, MODULE_OS, MODULE_ARCH, MODULE_ID);
+
+  vector<Module::Extern *> externs;
+  Module::Extern *extern1 = new(Module::Extern);
+  extern1->address = 0xffff;
+  extern1->name = "_xyz";
+  externs.push_back(extern1);
+  Module::Extern *extern2 = new(Module::Extern);
+  extern2->address = 0xaaaa;
+  extern2->name = "_abc";
+  externs.push_back(extern2);
+  Module::Extern *extern3 = new(Module::Extern);
+  extern3->address = 0xffff;
+  extern3->name = "_def";
+  externs.push_back(extern3);
+
+  m.AddExterns(externs.begin(), externs.end());
+
+  m.Write(s, ALL_SYMBOL_DATA);
+  string contents = s.str();
+
+  EXPECT_STREQ("MODULE " MODULE_OS " " MODULE_ARCH " "
+               MODULE_ID " " MODULE_NAME "\n"
+               "PUBLIC aaaa 0 _abc\n"
+               "PUBLIC ffff 0 _xyz\n",
+               contents.c_str());
+}
+
 TEST(Construct, DuplicateExterns) {
   stringstream s;
   Module m(MODULE_NAME, MODULE_OS, MODULE_ARCH, MODULE_ID);
@@ -488,3 +612,191 @@ TEST(Construct, DuplicateExterns) {
                "PUBLIC ffff 0 _xyz\n",
                contents.c_str());
 }
+
+// An extern with the same address and name as a function is dropped,
+// whichever of the two was added first. Functions added out of order
+// are written in address order.
+TEST(Construct, ExternsMatchingFunctions) {
+  stringstream s;
+  Module m(MODULE_NAME, MODULE_OS, MODULE_ARCH, MODULE_ID);
+
+  Module::Extern *extern1 = new(Module::Extern);
+  extern1->address = 0xd35402aac7a7ad5cLL;
+  extern1->name = "_without_form";
+  m.AddExtern(extern1);
+
+  Module::Function *function = new(Module::Function);
+  function->name = "_first";
+  function->address = 0x2000;
+  function->size = 0x10;
+  function->parameter_size = 0;
+  m.AddFunction(generate_duplicate_function("_without_form"));
+  m.AddFunction(function);
+
+  Module::Extern *extern2 = new(Module::Extern);
+  extern2->address = 0x2000;
+  extern2->name = "_first";
+  m.AddExtern(extern2);
+  Module::Extern *extern3 = new(Module::Extern);
+  extern3->address = 0x3000;
+  extern3->name = "_public";
+  m.AddExtern(extern3);
+
+  m.Write(s, ALL_SYMBOL_DATA);
+  string contents = s.str();
+
+  EXPECT_STREQ("MODULE " MODULE_OS " " MODULE_ARCH " "
+               MODULE_ID " " MODULE_NAME "\n"
+               "FUNC 2000 10 0 _first\n"
+               "FUNC d35402aac7a7ad5c 200b26e605f99071 f14ac4fed48c4a99"
+               " _without_form\n"
+               "PUBLIC 3000 0 _public\n",
+               contents.c_str());
+}
+
+// Add to M functions out of address order, with lines and duplicates,
+// externs, some repeating functions, and stack frame entries.
+static void PopulateModule(Module *m) {
+  Module::File *files[3] = {
+    m->FindFile("c.cc"), m->FindFile("a.cc"), m->FindFile("b.cc")
+  };
+  m->FindFile("unused.cc");
+  for (int i = 0; i < 40; i++) {
+    Module::Function *function = new(Module::Function);
+    // Addresses repeat every 16 functions, and most names with them; the
+    // first of each address and name added is kept.
+    function->address = 0x1000 + ((i * 7) % 16) * 0x100;
+    function->name = (i % 3 == 0) ? "same_name"
+                                  : "name_" + string(1, 'a' + i % 16);
+    function->size = 0x80 + i;
+    function->parameter_size = i;
+    for (int j = 0; j < i % 4; j++) {
+      Module::Line line = { function->address + j * 0x10, 0x10,
+                            files[(i + j) % 2], 100 * i + j };
+      function->lines.push_back(line);
+    }
+    if (i % 5 == 0) {
+      Module::Extern *ext = new(Module::Extern);
+      ext->address = function->address;
+      ext->name = (i % 10 == 0) ? function->name : "public_name";
+      m->AddExtern(ext);
+    }
+    // With a budget, the module may free the function right away.
+    m->AddFunction(function);
+
+    Module::StackFrameEntry *entry = new(Module::StackFrameEntry);
+    entry->address = 0x9000 - i * 0x40;
+    entry->size = 0x40;
+    entry->initial_rules[".cfa"] = "sp 8 +";
+    entry->initial_rules[".ra"] = ".cfa 8 - ^";
+    if (i % 2)
+      entry->rule_changes[entry->address + 4][".cfa"] = "sp 16 +";
+    m->AddStackFrameEntry(entry);
+  }
+  Module::Extern *ext = new(Module::Extern);
+  ext->address = 0xf000;
+  ext->name = "last_public";
+  m->AddExtern(ext);
+  m->SetLoadAddress(0x800);
+}
+
+static string WriteModule(Module *m, SymbolData symbol_data) {
+  stringstream s;
+  EXPECT_TRUE(m->Write(s, symbol_data));
+  return s.str();
+}
+
+// A module with a memory budget writes out its functions and stack frame
+// entries as it goes, and merges them back into the same symbol file.
+TEST(MemoryBudget, WritesSameSymbolFile) {
+  AutoTempDir temp_dir;
+  Module expected(MODULE_NAME, MODULE_OS, MODULE_ARCH, MODULE_ID);
+  PopulateModule(&expected);
+  string expected_contents = WriteModule(&expected, ALL_SYMBOL_DATA);
+
+  // Budgets that write out every addition, a few at a time, and never.
+  const size_t budgets[] = { 1, 1000, 1 << 30 };
+  for (size_t i = 0; i < sizeof(budgets) / sizeof(budgets[0]); i++) {
+    Module m(MODULE_NAME, MODULE_OS, MODULE_ARCH, MODULE_ID);
+    m.SetMemoryBudget(budgets[i], temp_dir.path());
+    PopulateModule(&m);
+    EXPECT_EQ(expected_contents, WriteModule(&m, ALL_SYMBOL_DATA))
+        << "budget " << budgets[i];
+    // Writing again reads the temporary files again.
+    EXPECT_EQ(expected_contents, WriteModule(&m, ALL_SYMBOL_DATA));
+  }
+}
+
+TEST(MemoryBudget, SymbolDataSubsets) {
+  AutoTempDir temp_dir;
+  Module expected(MODULE_NAME, MODULE_OS, MODULE_ARCH, MODULE_ID);
+  PopulateModule(&expected);
+  Module m(MODULE_NAME, MODULE_OS, MODULE_ARCH, MODULE_ID);
+  m.SetMemoryBudget(1, temp_dir.path());
+  PopulateModule(&m);
+  EXPECT_EQ(WriteModule(&expected, NO_CFI), WriteModule(&m, NO_CFI));
+  EXPECT_EQ(WriteModule(&expected, ONLY_CFI), WriteModule(&m, ONLY_CFI));
+}
+
+// Asking for the functions, externs or entries reads them back into
+// memory, after which the module still writes the same symbol file.
+TEST(MemoryBudget, ReadBack) {
+  AutoTempDir temp_dir;
+  Module expected(MODULE_NAME, MODULE_OS, MODULE_ARCH, MODULE_ID);
+  PopulateModule(&expected);
+  Module m(MODULE_NAME, MODULE_OS, MODULE_ARCH, MODULE_ID);
+  m.SetMemoryBudget(1000, temp_dir.path());
+  PopulateModule(&m);
+
+  vector<Module::Function *> expected_functions, functions;
+  expected.GetFunctions(&expected_functions, expected_functions.end());
+  m.GetFunctions(&functions, functions.end());
+  ASSERT_EQ(expected_functions.size(), functions.size());
+  for (size_t i = 0; i < functions.size(); i++) {
+    EXPECT_EQ(expected_functions[i]->address, functions[i]->address);
+    EXPECT_EQ(expected_functions[i]->name, functions[i]->name);
+    EXPECT_EQ(expected_functions[i]->size, functions[i]->size);
+    EXPECT_EQ(expected_functions[i]->lines.size(),
+              functions[i]->lines.size());
+  }
+
+  vector<Module::StackFrameEntry *> expected_entries, entries;
+  expected.GetStackFrameEntries(&expected_entries);
+  m.GetStackFrameEntries(&entries);
+  ASSERT_EQ(expected_entries.size(), entries.size());
+  for (size_t i = 0; i < entries.size(); i++) {
+    EXPECT_EQ(expected_entries[i]->address, entries[i]->address);
+    EXPECT_TRUE(expected_entries[i]->initial_rules ==
+                entries[i]->initial_rules);
+    EXPECT_TRUE(expected_entries[i]->rule_changes ==
+                entries[i]->rule_changes);
+  }
+
+  EXPECT_EQ(WriteModule(&expected, ALL_SYMBOL_DATA),
+            WriteModule(&m, ALL_SYMBOL_DATA));
+}
+
+// Taking the functions and entries of a module that has written them
+// out reads them back first.
+TEST(MemoryBudget, TakeFromSpilledModule) {
+  AutoTempDir temp_dir;
+  Module expected(MODULE_NAME, MODULE_OS, MODULE_ARCH, MODULE_ID);
+  PopulateModule(&expected);
+  Module from(MODULE_NAME, MODULE_OS, MODULE_ARCH, MODULE_ID);
+  from.SetMemoryBudget(1, temp_dir.path());
+  PopulateModule(&from);
+
+  Module to(MODULE_NAME, MODULE_OS, MODULE_ARCH, MODULE_ID);
+  to.TakeFunctions(&from);
+  to.TakeStackFrameEntries(&from);
+  vector<Module::Extern *> externs;
+  from.GetExterns(&externs, externs.end());
+  for (size_t i = 0; i < externs.size(); i++) {
+    Module::Extern *ext = new(Module::Extern);
+    *ext = *externs[i];
+    to.AddExtern(ext);
+  }
+  to.SetLoadAddress(0x800);
+  EXPECT_EQ(WriteModule(&expected, ALL_SYMBOL_DATA),
+            WriteModule(&to, ALL_SYMBOL_DATA));
+}
@@ -0,0 +1,78 @@
+// Copyright (c) 2016 Google Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+// notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above
+// copyright notice, this list of conditions and the following disclaimer
+// in the documentation and/or other materials provided with the
+// distribution.
+//     * Neither the name of Google Inc. nor the names of its
+// contributors may be used to endorse or promote products derived from
+// this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+// probes.h: Static tracepoints at points of interest in the client and
+// the processor.
+//
+// On Linux, when <sys/sdt.h> from SystemTap is available, each
+// BREAKPAD_PROBE* use becomes a USDT probe in the "breakpad" provider,
+// named after its first argument with "__" read as "-".  A probe that
+// nothing is attached to is a single nop, and its arguments are left
+// where the compiler already has them, so the probes stay compiled in.
+// List and attach to them with, e.g.:
+//
+//   bpftrace -l 'usdt:/path/to/minidump_stackwalk:breakpad:*'
+//   bpftrace -e 'usdt:minidump_stackwalk:breakpad:resolver__load__start
+//                { @start[tid] = nsecs; }'
+//
+// Elsewhere, or when BREAKPAD_NO_SDT_PROBES is defined, the macros expand
+// to nothing and their arguments are not evaluated, so arguments must not
+// have side effects.  Probes in the client run in the compromised context
+// of a crash, and may only be given values that are already at hand.
+
+#ifndef COMMON_PROBES_H_
+#define COMMON_PROBES_H_
+
+#if defined(__linux__) && !defined(BREAKPAD_NO_SDT_PROBES) && \
+    defined(__has_include)
+#if __has_include(<sys/sdt.h>)
+#define BREAKPAD_HAVE_SDT_PROBES 1
+#endif
+#endif
+
+#if defined(BREAKPAD_HAVE_SDT_PROBES)
+#include <sys/sdt.h>
+
+#define BREAKPAD_PROBE(name) DTRACE_PROBE(breakpad, name)
+#define BREAKPAD_PROBE1(name, a1) DTRACE_PROBE1(breakpad, name, a1)
+#define BREAKPAD_PROBE2(name, a1, a2) DTRACE_PROBE2(breakpad, name, a1, a2)
+#define BREAKPAD_PROBE3(name, a1, a2, a3) \
+    DTRACE_PROBE3(breakpad, name, a1, a2, a3)
+
+#else  // BREAKPAD_HAVE_SDT_PROBES
+
+#define BREAKPAD_PROBE(name) do { } while (0)
+#define BREAKPAD_PROBE1(name, a1) do { } while (0)
+#define BREAKPAD_PROBE2(name, a1, a2) do { } while (0)
+#define BREAKPAD_PROBE3(name, a1, a2, a3) do { } while (0)
+
+#endif  // BREAKPAD_HAVE_SDT_PROBES
+
+#endif  // COMMON_PROBES_H_
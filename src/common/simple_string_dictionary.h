@@ -31,10 +31,15 @@
 #define COMMON_SIMPLE_STRING_DICTIONARY_H_
 
 #include <assert.h>
+#include <stdint.h>
 #include <string.h>
 
 #include "common/basictypes.h"
 
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+#endif
+
 namespace google_breakpad {
 
 // Opaque type for the serialized representation of a NonAllocatingMap. One is
@@ -42,6 +47,64 @@ namespace google_breakpad {
 // the constructors.
 struct SerializedNonAllocatingMap;
 
+// The atomic operations that NonAllocatingMap's writers use.  They are
+// builtins with GCC and Clang, and Interlocked intrinsics, which are full
+// barriers, with MSVC.
+namespace non_allocating_map_atomic {
+
+#if defined(__GNUC__) || defined(__clang__)
+
+inline uint32_t LoadAcquire(const uint32_t* source) {
+  return __atomic_load_n(source, __ATOMIC_ACQUIRE);
+}
+
+inline void StoreRelease(uint32_t* dest, uint32_t value) {
+  __atomic_store_n(dest, value, __ATOMIC_RELEASE);
+}
+
+inline void StoreRelease(char* dest, char value) {
+  __atomic_store_n(dest, value, __ATOMIC_RELEASE);
+}
+
+// Replaces *|dest| with |desired| if it is |expected|.  Returns true if it
+// did.
+inline bool CompareAndSwapAcquire(uint32_t* dest, uint32_t expected,
+                                  uint32_t desired) {
+  return __atomic_compare_exchange_n(dest, &expected, desired, false,
+                                     __ATOMIC_ACQUIRE, __ATOMIC_ACQUIRE);
+}
+
+#elif defined(_MSC_VER)
+
+inline uint32_t LoadAcquire(const uint32_t* source) {
+  volatile long* word =
+      reinterpret_cast<volatile long*>(const_cast<uint32_t*>(source));
+  return static_cast<uint32_t>(_InterlockedCompareExchange(word, 0, 0));
+}
+
+inline void StoreRelease(uint32_t* dest, uint32_t value) {
+  _InterlockedExchange(reinterpret_cast<volatile long*>(dest),
+                       static_cast<long>(value));
+}
+
+inline void StoreRelease(char* dest, char value) {
+  _InterlockedExchange8(dest, value);
+}
+
+inline bool CompareAndSwapAcquire(uint32_t* dest, uint32_t expected,
+                                  uint32_t desired) {
+  return static_cast<uint32_t>(_InterlockedCompareExchange(
+             reinterpret_cast<volatile long*>(dest),
+             static_cast<long>(desired), static_cast<long>(expected))) ==
+         expected;
+}
+
+#else
+#error "NonAllocatingMap needs atomic operations for this compiler"
+#endif
+
+}  // namespace non_allocating_map_atomic
+
 // NonAllocatingMap is an implementation of a map/dictionary collection that
 // uses a fixed amount of storage, so that it does not perform any dynamic
 // allocations for its operations.
@@ -54,6 +117,26 @@ struct SerializedNonAllocatingMap;
 // and includes space for a \0 byte. This gives space for KeySize-1 and
 // ValueSize-1 characters in an entry. NumEntries is the total number of
 // entries that will fit in the map.
+//
+// Keys are found by open addressing: an entry sits at, or a few places after,
+// the slot its key hashes to, and a state word per slot, kept outside of the
+// entries, holds a part of the key's hash.  Setting, getting and removing a
+// key takes a few probes rather than a scan of every entry.  The state words
+// are not part of the serialized map; they are rebuilt from the entries when
+// a map is deserialized.
+//
+// Several threads may call SetKeyValue and RemoveKey at once without a lock.
+// A writer claims a slot with a compare-and-swap on its state word and only
+// then writes the entry, so two writers never write one entry at the same
+// time.  A writer that finds a slot claimed by another waits a bounded time
+// for it and then gives up its write, since the other writer may be the one
+// its own thread was interrupted in, by a signal handler.  A slot,
+// once given to a key, is only handed to another key after the first one is
+// removed, and a removed key that is set again gets its old slot back.
+// Readers, such as a crash handler serializing the map, never wait: keys and
+// values are always NUL-terminated, though a value being written may be read
+// half old and half new.  Copying, assigning and deserializing a map must not
+// race with writers to it.
 template <size_t KeySize, size_t ValueSize, size_t NumEntries>
 class NonAllocatingMap {
  public:
@@ -101,7 +184,7 @@ class NonAllocatingMap {
     DISALLOW_COPY_AND_ASSIGN(Iterator);
   };
 
-  NonAllocatingMap() : entries_() {
+  NonAllocatingMap() : entries_(), states_() {
   }
 
   NonAllocatingMap(const NonAllocatingMap& other) {
@@ -115,16 +198,31 @@ class NonAllocatingMap {
     if (other.key_size == key_size && other.value_size == value_size &&
         other.num_entries == num_entries) {
       memcpy(entries_, other.entries_, sizeof(entries_));
+      memcpy(states_, other.states_, sizeof(states_));
     }
     return *this;
   }
 
   // Constructs a map from its serialized form. |map| should be the out
   // parameter from Serialize() and |size| should be its return value.
-  NonAllocatingMap(const SerializedNonAllocatingMap* map, size_t size) {
+  NonAllocatingMap(const SerializedNonAllocatingMap* map, size_t size)
+      : entries_(), states_() {
     assert(size == sizeof(entries_));
     if (size == sizeof(entries_)) {
-      memcpy(entries_, map, size);
+      // The serialized map may come from a build that placed its entries
+      // differently, so each one is inserted again.
+      const Entry* entries = reinterpret_cast<const Entry*>(map);
+      for (size_t i = 0; i < num_entries; ++i) {
+        if (entries[i].is_active()) {
+          char key[KeySize];
+          memcpy(key, entries[i].key, key_size);
+          key[key_size - 1] = '\0';
+          char value[ValueSize];
+          memcpy(value, entries[i].value, value_size);
+          value[value_size - 1] = '\0';
+          SetKeyValue(key, value);
+        }
+      }
     }
   }
 
@@ -147,17 +245,26 @@ class NonAllocatingMap {
     if (!key)
       return NULL;
 
-    const Entry* entry = GetConstEntryForKey(key);
-    if (!entry)
-      return NULL;
-
-    return entry->value;
+    uint32_t hash = HashKey(key);
+    for (size_t probe = 0; probe < num_entries; ++probe) {
+      size_t slot = (hash + probe) % num_entries;
+      uint32_t state = LoadState(slot);
+      if ((state & kStateMask) == kEmpty)
+        break;
+      if ((state & kStateMask) == kActive &&
+          (state & kHashMask) == HashBits(hash) &&
+          strncmp(key, entries_[slot].key, key_size) == 0) {
+        return entries_[slot].value;
+      }
+    }
+    return NULL;
   }
 
   // Stores |value| into |key|, replacing the existing value if |key| is
   // already present. |key| must not be NULL. If |value| is NULL, the key is
   // removed from the map. If there is no more space in the map, then the
-  // operation silently fails.
+  // operation silently fails, as it does if another writer holds a slot
+  // that it needs for too long.
   void SetKeyValue(const char* key, const char* value) {
     if (!value) {
       RemoveKey(key);
@@ -173,25 +280,24 @@ class NonAllocatingMap {
     if (key[0] == '\0')
       return;
 
-    Entry* entry = GetEntryForKey(key);
-
-    // If it does not yet exist, attempt to insert it.
-    if (!entry) {
-      for (size_t i = 0; i < num_entries; ++i) {
-        if (!entries_[i].is_active()) {
-          entry = &entries_[i];
-
-          strncpy(entry->key, key, key_size);
-          entry->key[key_size - 1] = '\0';
-
-          break;
-        }
-      }
+    uint32_t hash = HashKey(key);
+    size_t slot;
+    uint32_t state;
+    if (!AcquireSlot(key, hash, &slot, &state))
+      return;  // The map is out of space, or a writer is in the way.
+
+    // The slot is ours until its state is stored again.
+    Entry* entry = &entries_[slot];
+    if ((state & kStateMask) == kActive) {
+      CopyString(entry->value, value, value_size);
+    } else {
+      // A new key, or a removed one.  The key is written last so that the
+      // entry only becomes active with its value in place.
+      CopyString(entry->value, value, value_size);
+      CopyString(entry->key + 1, key[0] ? key + 1 : "", key_size - 1);
+      StoreChar(&entry->key[0], key[0]);
     }
-
-    // If the map is out of space, entry will be NULL.
-    if (!entry)
-      return;
+    StoreState(slot, kActive | HashBits(hash));
 
 #ifndef NDEBUG
     // Sanity check that the key only appears once.
@@ -202,26 +308,45 @@ class NonAllocatingMap {
     }
     assert(count == 1);
 #endif
-
-    strncpy(entry->value, value, value_size);
-    entry->value[value_size - 1] = '\0';
   }
 
   // Given |key|, removes any associated value. |key| must not be NULL. If
-  // the key is not found, this is a noop.
+  // the key is not found, this is a noop.  Like SetKeyValue, this silently
+  // fails if another writer holds a slot that it needs for too long.
   void RemoveKey(const char* key) {
     assert(key);
     if (!key)
       return;
 
-    Entry* entry = GetEntryForKey(key);
-    if (entry) {
-      entry->key[0] = '\0';
+    uint32_t hash = HashKey(key);
+    for (size_t probe = 0; probe < num_entries; ++probe) {
+      size_t slot = (hash + probe) % num_entries;
+      uint32_t state;
+      if (!WaitForWriter(slot, &state))
+        return;
+      if ((state & kStateMask) == kEmpty)
+        break;
+      if ((state & kStateMask) != kActive ||
+          (state & kHashMask) != HashBits(hash) ||
+          strncmp(key, entries_[slot].key, key_size) != 0) {
+        continue;
+      }
+      if (!ClaimSlot(slot, state))
+        continue;  // Another writer got in first; look again.
+
+      // The slot is kept for the key, which finds it again by the first
+      // character, saved in the state, and the rest of the key, left in
+      // the entry.
+      Entry* entry = &entries_[slot];
+      unsigned char first = static_cast<unsigned char>(entry->key[0]);
+      StoreChar(&entry->key[0], '\0');
       entry->value[0] = '\0';
+      StoreState(slot, kRemoved | HashBits(hash) | first);
+      break;
     }
 
 #ifndef NDEBUG
-    assert(GetEntryForKey(key) == NULL);
+    assert(GetValueForKey(key) == NULL);
 #endif
   }
 
@@ -235,20 +360,177 @@ class NonAllocatingMap {
   }
 
  private:
-  const Entry* GetConstEntryForKey(const char* key) const {
-    for (size_t i = 0; i < num_entries; ++i) {
-      if (strncmp(key, entries_[i].key, key_size) == 0) {
-        return &entries_[i];
-      }
+  // A slot's state word: what the slot holds, in the top two bits; a bit
+  // set while a writer owns it; part of its key's hash; and, for a removed
+  // key, the key's first character.  Slots go from kEmpty to kActive, and
+  // then between kActive and kRemoved; they never become kEmpty again.
+  static const uint32_t kStateMask = 3u << 30;
+  static const uint32_t kEmpty = 0;
+  static const uint32_t kActive = 1u << 30;
+  static const uint32_t kRemoved = 2u << 30;
+  static const uint32_t kWriting = 1u << 29;
+  static const uint32_t kHashMask = 0x1fffffu << 8;
+  static const uint32_t kCharMask = 0xff;
+
+  // FNV-1a over the part of |key| that fits in an entry.
+  static uint32_t HashKey(const char* key) {
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < key_size - 1 && key[i]; ++i) {
+      hash ^= static_cast<unsigned char>(key[i]);
+      hash *= 16777619u;
     }
-    return NULL;
+    return hash;
+  }
+
+  static uint32_t HashBits(uint32_t hash) {
+    return (hash >> 3) << 8 & kHashMask;
+  }
+
+  // Copies at most |size| - 1 characters of |source| to |dest| and NUL-
+  // terminates it, without ever writing the last byte of a full-size
+  // buffer, which stays NUL for readers that catch a copy in progress.
+  static void CopyString(char* dest, const char* source, size_t size) {
+    size_t length = 0;
+    while (length < size - 1 && source[length])
+      ++length;
+    memcpy(dest, source, length);
+    if (length < size - 1)
+      dest[length] = '\0';
+  }
+
+  static void StoreChar(char* dest, char c) {
+    non_allocating_map_atomic::StoreRelease(dest, c);
+  }
+
+  uint32_t LoadState(size_t slot) const {
+    return non_allocating_map_atomic::LoadAcquire(&states_[slot]);
+  }
+
+  void StoreState(size_t slot, uint32_t state) {
+    non_allocating_map_atomic::StoreRelease(&states_[slot], state);
+  }
+
+  // Takes |slot| for writing if its state is still |state|.
+  bool ClaimSlot(size_t slot, uint32_t state) {
+    return non_allocating_map_atomic::CompareAndSwapAcquire(
+        &states_[slot], state, state | kWriting);
+  }
+
+  // How many times a writer looks at a slot that another writer owns
+  // before giving up on it.  Writers own a slot for the time it takes to
+  // copy one entry, unless they are interrupted.
+  static const int kMaxWriterWaits = 1 << 20;
+
+  // Sets |state| to the state of |slot| once no other writer owns it.
+  // Returns false if another writer still owns it after kMaxWriterWaits
+  // looks, as it always will if that writer was interrupted by a signal
+  // handler that is now the caller.
+  bool WaitForWriter(size_t slot, uint32_t* state) const {
+    for (int i = 0; i < kMaxWriterWaits; ++i) {
+      *state = LoadState(slot);
+      if (!(*state & kWriting))
+        return true;
+    }
+    return false;
+  }
+
+  // Returns true if the slot with state |state| belongs to |key|, which
+  // hashes to |hash|, whether the key is active or removed.
+  bool SlotHoldsKey(size_t slot, uint32_t state, const char* key,
+                    uint32_t hash) const {
+    if ((state & kHashMask) != HashBits(hash))
+      return false;
+    const Entry& entry = entries_[slot];
+    if ((state & kStateMask) == kActive)
+      return strncmp(key, entry.key, key_size) == 0;
+    if ((state & kStateMask) == kRemoved)
+      return static_cast<unsigned char>(key[0]) == (state & kCharMask) &&
+          strncmp(key + 1, entry.key + 1, key_size - 1) == 0;
+    return false;
   }
 
-  Entry* GetEntryForKey(const char* key) {
-    return const_cast<Entry*>(GetConstEntryForKey(key));
+  // Finds the slot of |key|, or a free one for it, and claims it for
+  // writing.  Returns false if the map has no room for the key, or if
+  // WaitForWriter gives up on a slot on the way.
+  bool AcquireSlot(const char* key, uint32_t hash, size_t* slot_out,
+                   uint32_t* state_out) {
+    while (true) {
+      // The first slot in the probe sequence that could take the key: a
+      // removed one, or the empty slot that ends the sequence.
+      size_t free_slot = num_entries;
+      uint32_t free_state = 0;
+      bool retry = false;
+      for (size_t probe = 0; probe < num_entries; ++probe) {
+        size_t slot = (hash + probe) % num_entries;
+        uint32_t state;
+        if (!WaitForWriter(slot, &state))
+          return false;
+        if (SlotHoldsKey(slot, state, key, hash)) {
+          if (!ClaimSlot(slot, state)) {
+            retry = true;
+            break;
+          }
+          *slot_out = slot;
+          *state_out = state;
+          return true;
+        }
+        if (free_slot == num_entries &&
+            (state & kStateMask) != kActive) {
+          free_slot = slot;
+          free_state = state;
+        }
+        if ((state & kStateMask) == kEmpty)
+          break;
+      }
+      if (retry)
+        continue;
+      if (free_slot == num_entries)
+        return false;
+      if (!ClaimSlot(free_slot, free_state))
+        continue;
+
+      // Another writer may be putting the key in a different slot.
+      // Writers settle on the earlier slot: this one gives way to a key
+      // in an earlier slot, waiting for any writer there, and a writer in
+      // a later slot will give way to this one, so it is not waited for.
+      bool duplicate = false;
+      bool past_free_slot = false;
+      for (size_t probe = 0; probe < num_entries; ++probe) {
+        size_t slot = (hash + probe) % num_entries;
+        if (slot == free_slot) {
+          past_free_slot = true;
+          continue;
+        }
+        uint32_t state;
+        if (past_free_slot) {
+          state = LoadState(slot);
+        } else if (!WaitForWriter(slot, &state)) {
+          StoreState(free_slot, free_state);
+          return false;
+        }
+        if ((state & kStateMask) == kEmpty)
+          break;
+        if ((state & kStateMask) == kActive &&
+            SlotHoldsKey(slot, state, key, hash)) {
+          duplicate = true;
+          break;
+        }
+      }
+      if (duplicate) {
+        StoreState(free_slot, free_state);
+        continue;
+      }
+
+      *slot_out = free_slot;
+      *state_out = free_state;
+      return true;
+    }
   }
 
   Entry entries_[NumEntries];
+
+  // Per-slot state words, parallel to entries_ and not serialized.
+  uint32_t states_[NumEntries];
 };
 
 // For historical reasons this specialized version is available with the same
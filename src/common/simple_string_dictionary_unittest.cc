@@ -27,6 +27,11 @@
 // (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
 // OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
+#include <signal.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
 #include "breakpad_googletest_includes.h"
 #include "common/simple_string_dictionary.h"
 
@@ -288,6 +293,99 @@ TEST(NonAllocatingMapTest, OutOfSpace) {
   EXPECT_FALSE(map.GetValueForKey("c"));
 }
 
+// Keys that are removed and added again, many more of them over time than
+// the map holds, must keep finding free entries.
+TEST(NonAllocatingMapTest, Churn) {
+  NonAllocatingMap<5, 5, 8> map;
+  char key[5];
+  for (int i = 0; i < 1000; ++i) {
+    snprintf(key, sizeof(key), "k%d", i % 100);
+    map.SetKeyValue(key, "v");
+    if (i >= 7) {
+      snprintf(key, sizeof(key), "k%d", (i - 7) % 100);
+      map.RemoveKey(key);
+    }
+    EXPECT_EQ(i < 7 ? i + 1u : 7u, map.GetCount());
+  }
+  for (int i = 993; i < 1000; ++i) {
+    snprintf(key, sizeof(key), "k%d", i % 100);
+    EXPECT_STREQ("v", map.GetValueForKey(key));
+  }
+
+  // Filling the last entry still works, and nothing more fits.
+  map.SetKeyValue("last", "1");
+  EXPECT_EQ(8u, map.GetCount());
+  map.SetKeyValue("more", "2");
+  EXPECT_EQ(8u, map.GetCount());
+  EXPECT_FALSE(map.GetValueForKey("more"));
+  EXPECT_STREQ("1", map.GetValueForKey("last"));
+}
+
+// A serialized map may place its entries anywhere.
+TEST(NonAllocatingMapTest, DeserializeAnyOrder) {
+  typedef NonAllocatingMap<4, 5, 4> TestMap;
+  TestMap::Entry entries[4];
+  memset(entries, 0, sizeof(entries));
+  strcpy(entries[3].key, "one");
+  strcpy(entries[3].value, "abc");
+  strcpy(entries[1].key, "two");
+  strcpy(entries[1].value, "def");
+
+  TestMap map(reinterpret_cast<const SerializedNonAllocatingMap*>(entries),
+              sizeof(entries));
+  EXPECT_EQ(2u, map.GetCount());
+  EXPECT_STREQ("abc", map.GetValueForKey("one"));
+  EXPECT_STREQ("def", map.GetValueForKey("two"));
+
+  map.SetKeyValue("one", "ghi");
+  map.SetKeyValue("tre", "jkl");
+  EXPECT_EQ(3u, map.GetCount());
+  EXPECT_STREQ("ghi", map.GetValueForKey("one"));
+  EXPECT_STREQ("jkl", map.GetValueForKey("tre"));
+}
+
+typedef NonAllocatingMap<10, 10, 10> InterruptedMap;
+InterruptedMap* g_interrupted_map;
+char* g_unreadable_value;
+
+// Writes to g_interrupted_map while SetKeyValue is stopped on
+// g_unreadable_value, then lets SetKeyValue go on.
+void WriteToInterruptedMap(int signal) {
+  g_interrupted_map->SetKeyValue("key", "handler");
+  g_interrupted_map->RemoveKey("key");
+  mprotect(g_unreadable_value, getpagesize(), PROT_READ);
+}
+
+// A signal handler that writes to a key that its thread was interrupted
+// writing gives up rather than waiting forever for that thread.
+TEST(NonAllocatingMapTest, WriteFromInterruptingSignalHandler) {
+  size_t page_size = getpagesize();
+  void* page = mmap(NULL, page_size, PROT_READ | PROT_WRITE,
+                    MAP_PRIVATE | MAP_ANON, -1, 0);
+  ASSERT_NE(MAP_FAILED, page);
+  g_unreadable_value = static_cast<char*>(page);
+  strcpy(g_unreadable_value, "value");
+  ASSERT_EQ(0, mprotect(page, page_size, PROT_NONE));
+
+  InterruptedMap map;
+  g_interrupted_map = &map;
+  struct sigaction action, old_segv_action, old_bus_action;
+  memset(&action, 0, sizeof(action));
+  action.sa_handler = WriteToInterruptedMap;
+  sigemptyset(&action.sa_mask);
+  ASSERT_EQ(0, sigaction(SIGSEGV, &action, &old_segv_action));
+  ASSERT_EQ(0, sigaction(SIGBUS, &action, &old_bus_action));
+
+  // Reading the value faults after "key" has claimed its slot.
+  map.SetKeyValue("key", g_unreadable_value);
+
+  sigaction(SIGSEGV, &old_segv_action, NULL);
+  sigaction(SIGBUS, &old_bus_action, NULL);
+  EXPECT_EQ(1u, map.GetCount());
+  EXPECT_STREQ("value", map.GetValueForKey("key"));
+  munmap(page, page_size);
+}
+
 #ifndef NDEBUG
 
 TEST(NonAllocatingMapTest, NullKey) {
@@ -0,0 +1,151 @@
+// Copyright (c) 2016 Google Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+// notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above
+// copyright notice, this list of conditions and the following disclaimer
+// in the documentation and/or other materials provided with the
+// distribution.
+//     * Neither the name of Google Inc. nor the names of its
+// contributors may be used to endorse or promote products derived from
+// this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+// string_interner.h: Define the google_breakpad::StringInterner class,
+// which keeps a single copy of each distinct string handed to it in a
+// memory arena.
+//
+// The DWARF reader sees the same names --- namespaces, classes, template
+// instantiations --- over and over, once for every DIE that mentions
+// them. Holding each of them in its own std::string costs a heap block
+// per DIE; interning them costs one copy per distinct name, and a
+// pointer per use.
+
+#ifndef COMMON_STRING_INTERNER_H_
+#define COMMON_STRING_INTERNER_H_
+
+#include <stddef.h>
+#include <string.h>
+
+#include <string>
+#include <vector>
+
+#include "common/unordered.h"
+#include "common/using_std_string.h"
+
+namespace google_breakpad {
+
+// A StringInterner is not thread-safe; callers sharing one between
+// threads must serialize calls to Intern.
+class StringInterner {
+ public:
+  StringInterner() : block_free_(NULL), block_left_(0) { }
+
+  ~StringInterner() {
+    for (size_t i = 0; i < blocks_.size(); i++)
+      delete [] blocks_[i];
+  }
+
+  // Return a NUL-terminated copy of the LENGTH bytes at DATA, which
+  // stays valid for the lifetime of this interner. Interning equal
+  // strings yields the same pointer.
+  const char *Intern(const char *data, size_t length) {
+    Key key(data, length);
+    Index::const_iterator it = index_.find(key);
+    if (it != index_.end())
+      return it->data;
+
+    char *copy = Allocate(length + 1);
+    memcpy(copy, data, length);
+    copy[length] = '\0';
+    index_.insert(Key(copy, length));
+    return copy;
+  }
+
+  const char *Intern(const string &str) {
+    return Intern(str.data(), str.size());
+  }
+
+  const char *Intern(const char *str) {
+    return Intern(str, strlen(str));
+  }
+
+  // The number of distinct strings interned.
+  size_t size() const { return index_.size(); }
+
+ private:
+  struct Key {
+    Key(const char *data, size_t length) : data(data), length(length) { }
+    bool operator==(const Key &other) const {
+      return length == other.length && memcmp(data, other.data, length) == 0;
+    }
+    const char *data;
+    size_t length;
+  };
+
+  // The FNV-1a hash of the key's bytes.
+  struct KeyHash {
+    size_t operator()(const Key &key) const {
+      size_t hash = static_cast<size_t>(2166136261U);
+      for (size_t i = 0; i < key.length; i++) {
+        hash ^= static_cast<unsigned char>(key.data[i]);
+        hash *= 16777619U;
+      }
+      return hash;
+    }
+  };
+
+  typedef unordered_set<Key, KeyHash> Index;
+
+  // Strings are carved out of blocks of this size; longer ones get a
+  // block of their own.
+  static const size_t kBlockSize = 64 * 1024;
+
+  char *Allocate(size_t size) {
+    if (size > kBlockSize / 4) {
+      char *block = new char[size];
+      blocks_.push_back(block);
+      return block;
+    }
+    if (size > block_left_) {
+      block_free_ = new char[kBlockSize];
+      block_left_ = kBlockSize;
+      blocks_.push_back(block_free_);
+    }
+    char *result = block_free_;
+    block_free_ += size;
+    block_left_ -= size;
+    return result;
+  }
+
+  Index index_;
+  std::vector<char *> blocks_;
+
+  // The unused tail of the current block.
+  char *block_free_;
+  size_t block_left_;
+
+  // Disallow copy constructor and assignment operator.
+  StringInterner(const StringInterner &);
+  void operator=(const StringInterner &);
+};
+
+}  // namespace google_breakpad
+
+#endif  // COMMON_STRING_INTERNER_H_
@@ -0,0 +1,87 @@
+// Copyright (c) 2016 Google Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+// notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above
+// copyright notice, this list of conditions and the following disclaimer
+// in the documentation and/or other materials provided with the
+// distribution.
+//     * Neither the name of Google Inc. nor the names of its
+// contributors may be used to endorse or promote products derived from
+// this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+// string_interner_unittest.cc: Unit tests for google_breakpad::StringInterner.
+
+#include <stdio.h>
+#include <string.h>
+
+#include <string>
+
+#include "breakpad_googletest_includes.h"
+#include "common/string_interner.h"
+#include "common/using_std_string.h"
+
+using google_breakpad::StringInterner;
+
+TEST(StringInterner, EqualStringsShareStorage) {
+  StringInterner interner;
+  string name("std::vector<int, std::allocator<int> >");
+  const char *first = interner.Intern(name);
+  const char *second = interner.Intern(name.c_str());
+  EXPECT_EQ(first, second);
+  EXPECT_NE(name.c_str(), first);
+  EXPECT_STREQ(name.c_str(), first);
+  EXPECT_EQ(1U, interner.size());
+}
+
+TEST(StringInterner, DistinctStrings) {
+  StringInterner interner;
+  const char *a = interner.Intern("a");
+  const char *ab = interner.Intern("ab");
+  const char *b = interner.Intern("ab", 1);
+  EXPECT_STREQ("a", a);
+  EXPECT_STREQ("ab", ab);
+  EXPECT_EQ(a, b);
+  EXPECT_EQ(2U, interner.size());
+
+  const char *empty = interner.Intern("");
+  EXPECT_STREQ("", empty);
+  EXPECT_EQ(empty, interner.Intern(string()));
+}
+
+TEST(StringInterner, ManyAndLongStrings) {
+  StringInterner interner;
+  // Enough strings to fill several blocks, and some too long to share one.
+  const char *pointers[5000];
+  for (int i = 0; i < 5000; i++) {
+    char prefix[10];
+    snprintf(prefix, sizeof(prefix), "%09d", i);
+    string str(i % 100 == 0 ? 20000 : 40, 'x');
+    str.replace(0, 9, prefix);
+    pointers[i] = interner.Intern(str);
+  }
+  EXPECT_EQ(5000U, interner.size());
+  for (int i = 0; i < 5000; i++) {
+    char prefix[10];
+    snprintf(prefix, sizeof(prefix), "%09d", i);
+    EXPECT_EQ(0, strncmp(prefix, pointers[i], 9));
+    EXPECT_EQ(i % 100 == 0 ? 20000U : 40U, strlen(pointers[i]));
+  }
+}
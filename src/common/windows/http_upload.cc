@@ -32,19 +32,17 @@
 // Disable exception handler warnings.
 #pragma warning(disable:4530)
 
-#include <fstream>
-
 #include "common/windows/string_utils-inl.h"
 
 #include "common/windows/http_upload.h"
 
 namespace google_breakpad {
 
-using std::ifstream;
-using std::ios;
-
 static const wchar_t kUserAgent[] = L"Breakpad/1.0 (Windows)";
 
+// Size of the chunks in which the upload file is read and sent.
+static const DWORD kUploadChunkSize = 64 * 1024;
+
 // Helper class which closes an internet handle when it goes away
 class HTTPUpload::AutoInternetHandle {
  public:
@@ -61,6 +59,59 @@ class HTTPUpload::AutoInternetHandle {
   HINTERNET handle_;
 };
 
+HTTPUploadSession::HTTPUploadSession()
+    : internet_(NULL),
+      connection_(NULL),
+      host_(),
+      port_(0) {
+}
+
+HTTPUploadSession::~HTTPUploadSession() {
+  if (connection_) {
+    InternetCloseHandle(connection_);
+  }
+  if (internet_) {
+    InternetCloseHandle(internet_);
+  }
+}
+
+HINTERNET HTTPUploadSession::GetConnection(const wstring &host,
+                                           INTERNET_PORT port) {
+  if (connection_ && host == host_ && port == port_) {
+    return connection_;
+  }
+
+  if (connection_) {
+    InternetCloseHandle(connection_);
+    connection_ = NULL;
+  }
+
+  if (!internet_) {
+    internet_ = InternetOpen(kUserAgent,
+                             INTERNET_OPEN_TYPE_PRECONFIG,
+                             NULL,  // proxy name
+                             NULL,  // proxy bypass
+                             0);    // flags
+    if (!internet_) {
+      return NULL;
+    }
+  }
+
+  connection_ = InternetConnect(internet_,
+                                host.c_str(),
+                                port,
+                                NULL,    // user name
+                                NULL,    // password
+                                INTERNET_SERVICE_HTTP,
+                                0,       // flags
+                                NULL);   // context
+  if (connection_) {
+    host_ = host;
+    port_ = port;
+  }
+  return connection_;
+}
+
 // static
 bool HTTPUpload::SendRequest(const wstring &url,
                              const map<wstring, wstring> &parameters,
@@ -69,6 +120,21 @@ bool HTTPUpload::SendRequest(const wstring &url,
                              int *timeout,
                              wstring *response_body,
                              int *response_code) {
+  HTTPUploadSession session;
+  return SendRequest(&session, url, parameters, upload_file, file_part_name,
+                     timeout, response_body, response_code);
+}
+
+// static
+bool HTTPUpload::SendRequest(HTTPUploadSession *session,
+                             const wstring &url,
+                             const map<wstring, wstring> &parameters,
+                             const wstring &upload_file,
+                             const wstring &file_part_name,
+                             int *timeout,
+                             wstring *response_body,
+                             int *response_code) {
+  assert(session);
   if (response_code) {
     *response_code = 0;
   }
@@ -100,30 +166,14 @@ bool HTTPUpload::SendRequest(const wstring &url,
     return false;
   }
 
-  AutoInternetHandle internet(InternetOpen(kUserAgent,
-                                           INTERNET_OPEN_TYPE_PRECONFIG,
-                                           NULL,  // proxy name
-                                           NULL,  // proxy bypass
-                                           0));   // flags
-  if (!internet.get()) {
-    return false;
-  }
-
-  AutoInternetHandle connection(InternetConnect(internet.get(),
-                                                host,
-                                                components.nPort,
-                                                NULL,    // user name
-                                                NULL,    // password
-                                                INTERNET_SERVICE_HTTP,
-                                                0,       // flags
-                                                NULL));  // context
-  if (!connection.get()) {
+  HINTERNET connection = session->GetConnection(host, components.nPort);
+  if (!connection) {
     return false;
   }
 
   DWORD http_open_flags = secure ? INTERNET_FLAG_SECURE : 0;
-  http_open_flags |= INTERNET_FLAG_NO_COOKIES;
-  AutoInternetHandle request(HttpOpenRequest(connection.get(),
+  http_open_flags |= INTERNET_FLAG_NO_COOKIES | INTERNET_FLAG_KEEP_CONNECTION;
+  AutoInternetHandle request(HttpOpenRequest(connection,
                                              L"POST",
                                              path,
                                              NULL,    // version
@@ -142,9 +192,9 @@ bool HTTPUpload::SendRequest(const wstring &url,
                         static_cast<DWORD>(-1),
                         HTTP_ADDREQ_FLAG_ADD);
 
-  string request_body;
-  if (!GenerateRequestBody(parameters, upload_file,
-                           file_part_name, boundary, &request_body)) {
+  string body_prefix, body_suffix;
+  if (!GenerateRequestBody(parameters, upload_file, file_part_name, boundary,
+                           &body_prefix, &body_suffix)) {
     return false;
   }
 
@@ -164,9 +214,8 @@ bool HTTPUpload::SendRequest(const wstring &url,
     }
   }
 
-  if (!HttpSendRequest(request.get(), NULL, 0,
-                       const_cast<char *>(request_body.data()),
-                       static_cast<DWORD>(request_body.size()))) {
+  if (!SendRequestBody(request.get(), body_prefix, upload_file,
+                       body_suffix)) {
     return false;
   }
 
@@ -271,29 +320,26 @@ bool HTTPUpload::GenerateRequestBody(const map<wstring, wstring> &parameters,
                                      const wstring &upload_file,
                                      const wstring &file_part_name,
                                      const wstring &boundary,
-                                     string *request_body) {
-  vector<char> contents;
-  if (!GetFileContents(upload_file, &contents)) {
-    return false;
-  }
-
+                                     string *body_prefix,
+                                     string *body_suffix) {
   string boundary_str = WideToUTF8(boundary);
   if (boundary_str.empty()) {
     return false;
   }
 
-  request_body->clear();
+  body_prefix->clear();
 
   // Append each of the parameter pairs as a form-data part
   for (map<wstring, wstring>::const_iterator pos = parameters.begin();
        pos != parameters.end(); ++pos) {
-    request_body->append("--" + boundary_str + "\r\n");
-    request_body->append("Content-Disposition: form-data; name=\"" +
-                         WideToUTF8(pos->first) + "\"\r\n\r\n" +
-                         WideToUTF8(pos->second) + "\r\n");
+    body_prefix->append("--" + boundary_str + "\r\n");
+    body_prefix->append("Content-Disposition: form-data; name=\"" +
+                        WideToUTF8(pos->first) + "\"\r\n\r\n" +
+                        WideToUTF8(pos->second) + "\r\n");
   }
 
-  // Now append the upload file as a binary (octet-stream) part
+  // Now append the header of the upload file's binary (octet-stream) part;
+  // the file itself is sent by SendRequestBody.
   string filename_utf8 = WideToUTF8(upload_file);
   if (filename_utf8.empty()) {
     return false;
@@ -304,55 +350,84 @@ bool HTTPUpload::GenerateRequestBody(const map<wstring, wstring> &parameters,
     return false;
   }
 
-  request_body->append("--" + boundary_str + "\r\n");
-  request_body->append("Content-Disposition: form-data; "
-                       "name=\"" + file_part_name_utf8 + "\"; "
-                       "filename=\"" + filename_utf8 + "\"\r\n");
-  request_body->append("Content-Type: application/octet-stream\r\n");
-  request_body->append("\r\n");
+  body_prefix->append("--" + boundary_str + "\r\n");
+  body_prefix->append("Content-Disposition: form-data; "
+                      "name=\"" + file_part_name_utf8 + "\"; "
+                      "filename=\"" + filename_utf8 + "\"\r\n");
+  body_prefix->append("Content-Type: application/octet-stream\r\n");
+  body_prefix->append("\r\n");
 
-  if (!contents.empty()) {
-      request_body->append(&(contents[0]), contents.size());
-  }
-  request_body->append("\r\n");
-  request_body->append("--" + boundary_str + "--\r\n");
+  *body_suffix = "\r\n--" + boundary_str + "--\r\n";
   return true;
 }
 
 // static
-bool HTTPUpload::GetFileContents(const wstring &filename,
-                                 vector<char> *contents) {
-  bool rv = false;
-  // The "open" method on pre-MSVC8 ifstream implementations doesn't accept a
-  // wchar_t* filename, so use _wfopen directly in that case.  For VC8 and
-  // later, _wfopen has been deprecated in favor of _wfopen_s, which does
-  // not exist in earlier versions, so let the ifstream open the file itself.
-  // GCC doesn't support wide file name and opening on FILE* requires ugly
-  // hacks, so fallback to multi byte file.
-#ifdef _MSC_VER
-  ifstream file;
-  file.open(filename.c_str(), ios::binary);
-#else // GCC
-  ifstream file(WideToMBCP(filename, CP_ACP).c_str(), ios::binary);
-#endif  // _MSC_VER >= 1400
-  if (file.is_open()) {
-    file.seekg(0, ios::end);
-    std::streamoff length = file.tellg();
-    // Check for loss of data when converting lenght from std::streamoff into
-    // std::vector<char>::size_type
-    std::vector<char>::size_type vector_size =
-        static_cast<std::vector<char>::size_type>(length);
-    if (static_cast<std::streamoff>(vector_size) == length) {
-      contents->resize(vector_size);
-      if (length != 0) {
-        file.seekg(0, ios::beg);
-        file.read(&((*contents)[0]), length);
-      }
-      rv = true;
+bool HTTPUpload::SendRequestBody(HINTERNET request,
+                                 const string &body_prefix,
+                                 const wstring &upload_file,
+                                 const string &body_suffix) {
+  HANDLE file = CreateFile(upload_file.c_str(),
+                           GENERIC_READ,
+                           FILE_SHARE_READ,
+                           NULL,  // security attributes
+                           OPEN_EXISTING,
+                           FILE_FLAG_SEQUENTIAL_SCAN,
+                           NULL);  // template file
+  if (file == INVALID_HANDLE_VALUE) {
+    return false;
+  }
+
+  bool result = false;
+  LARGE_INTEGER file_size;
+  if (GetFileSizeEx(file, &file_size)) {
+    ULONGLONG body_size = body_prefix.size() + file_size.QuadPart +
+                          body_suffix.size();
+    INTERNET_BUFFERS buffers;
+    memset(&buffers, 0, sizeof(buffers));
+    buffers.dwStructSize = sizeof(buffers);
+    buffers.dwBufferTotal = static_cast<DWORD>(body_size);
+    result = body_size == buffers.dwBufferTotal &&
+             HttpSendRequestEx(request, &buffers, NULL, 0, 0) &&
+             WriteRequestData(request, body_prefix.data(),
+                              body_prefix.size());
+
+    vector<char> chunk(kUploadChunkSize);
+    ULONGLONG remaining = file_size.QuadPart;
+    while (result && remaining > 0) {
+      DWORD to_read = remaining < kUploadChunkSize ?
+          static_cast<DWORD>(remaining) : kUploadChunkSize;
+      DWORD bytes_read = 0;
+      result = ReadFile(file, &chunk[0], to_read, &bytes_read, NULL) &&
+               bytes_read > 0 &&
+               WriteRequestData(request, &chunk[0], bytes_read);
+      remaining -= bytes_read;
+    }
+
+    result = result &&
+             WriteRequestData(request, body_suffix.data(),
+                              body_suffix.size()) &&
+             HttpEndRequest(request, NULL, 0, 0);
+  }
+
+  CloseHandle(file);
+  return result;
+}
+
+// static
+bool HTTPUpload::WriteRequestData(HINTERNET request,
+                                  const char *data,
+                                  size_t size) {
+  while (size > 0) {
+    DWORD bytes_written = 0;
+    if (!InternetWriteFile(request, data, static_cast<DWORD>(size),
+                           &bytes_written) ||
+        bytes_written == 0) {
+      return false;
     }
-    file.close();
+    data += bytes_written;
+    size -= bytes_written;
   }
-  return rv;
+  return true;
 }
 
 // static
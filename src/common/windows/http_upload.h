@@ -30,6 +30,9 @@
 // HTTPUpload provides a "nice" API to send a multipart HTTP(S) POST
 // request using wininet.  It currently supports requests that contain
 // a set of string parameters (key/value pairs), and a file to upload.
+// The file is streamed from disk as the request is sent.  Callers that
+// send several requests can keep the wininet session and connection open
+// between them with an HTTPUploadSession.
 
 #ifndef COMMON_WINDOWS_HTTP_UPLOAD_H_
 #define COMMON_WINDOWS_HTTP_UPLOAD_H_
@@ -52,6 +55,34 @@ using std::wstring;
 using std::map;
 using std::vector;
 
+// Holds a wininet session, and a connection to the server that the last
+// request was sent to, across calls to HTTPUpload::SendRequest, so that
+// requests to the same server reuse them along with the keep-alive
+// sockets that wininet pools under the session.  An HTTPUploadSession must
+// not be used by more than one thread at a time.
+class HTTPUploadSession {
+ public:
+  HTTPUploadSession();
+  ~HTTPUploadSession();
+
+ private:
+  friend class HTTPUpload;
+
+  // Returns a connection to the given server, opening the session and the
+  // connection if needed.  The connection is owned by the session, and
+  // stays valid until the next call.  Returns NULL on failure.
+  HINTERNET GetConnection(const wstring &host, INTERNET_PORT port);
+
+  HINTERNET internet_;
+  HINTERNET connection_;
+  wstring host_;
+  INTERNET_PORT port_;
+
+  // Disallow copy constructor and operator=.
+  explicit HTTPUploadSession(const HTTPUploadSession &);
+  void operator=(const HTTPUploadSession &);
+};
+
 class HTTPUpload {
  public:
   // Sends the given set of parameters, along with the contents of
@@ -73,6 +104,17 @@ class HTTPUpload {
                           wstring *response_body,
                           int *response_code);
 
+  // Like the above, but sends the request with the session and connection
+  // kept by |session|.
+  static bool SendRequest(HTTPUploadSession *session,
+                          const wstring &url,
+                          const map<wstring, wstring> &parameters,
+                          const wstring &upload_file,
+                          const wstring &file_part_name,
+                          int *timeout,
+                          wstring *response_body,
+                          int *response_code);
+
  private:
   class AutoInternetHandle;
 
@@ -89,16 +131,27 @@ class HTTPUpload {
   static wstring GenerateRequestHeader(const wstring &boundary);
 
   // Given a set of parameters, an upload filename, and a file part name,
-  // generates a multipart request body string with these parameters
-  // and minidump contents.  Returns true on success.
+  // generates the parts of a multipart request body that come before and
+  // after the contents of the file.  Returns true on success.
   static bool GenerateRequestBody(const map<wstring, wstring> &parameters,
                                   const wstring &upload_file,
                                   const wstring &file_part_name,
                                   const wstring &boundary,
-                                  string *request_body);
-
-  // Fills the supplied vector with the contents of filename.
-  static bool GetFileContents(const wstring &filename, vector<char> *contents);
+                                  string *body_prefix,
+                                  string *body_suffix);
+
+  // Sends a request with a body made of body_prefix, the contents of
+  // upload_file and body_suffix, reading the file in chunks as they are
+  // sent.  Returns true on success.
+  static bool SendRequestBody(HINTERNET request,
+                              const string &body_prefix,
+                              const wstring &upload_file,
+                              const string &body_suffix);
+
+  // Writes all of the given data to the request.  Returns true on success.
+  static bool WriteRequestData(HINTERNET request,
+                               const char *data,
+                               size_t size);
 
   // Converts a UTF8 string to UTF16.
   static wstring UTF8ToWide(const string &utf8);
@@ -34,10 +34,13 @@
 #include <atlbase.h>
 #include <dia2.h>
 #include <ImageHlp.h>
+#include <stdarg.h>
 #include <stdio.h>
 
+#include <algorithm>
 #include <limits>
 #include <set>
+#include <vector>
 
 #include "common/windows/dia_util.h"
 #include "common/windows/guid_string.h"
@@ -105,6 +108,13 @@ namespace {
 
 using std::vector;
 
+// Once this much output has been buffered, it is written to the map file.
+const size_t kOutputBufferSize = 1 << 20;
+
+// PrintFunctions does not start a thread for fewer rvas than this.  Each
+// thread has to open its own session first.
+const size_t kMinRVAsPerShard = 64;
+
 // A helper class to scope a PLOADED_IMAGE.
 class AutoImage {
  public:
@@ -123,7 +133,21 @@ class AutoImage {
 
 }  // namespace
 
-PDBSourceLineWriter::PDBSourceLineWriter() : output_(NULL) {
+struct PDBSourceLineWriter::FunctionShard {
+  // The writer that started the shard.  Only its file name, image map and
+  // file id maps are used, and those are not modified while shards run.
+  const PDBSourceLineWriter *parent;
+  const DWORD *begin;
+  const DWORD *end;
+  const std::set<DWORD> *public_only_rvas;
+
+  // The shard's records and whether printing them succeeded.
+  string output;
+  bool result;
+};
+
+PDBSourceLineWriter::PDBSourceLineWriter()
+    : format_(ANY_FILE), thread_count_(1), output_(NULL) {
 }
 
 PDBSourceLineWriter::~PDBSourceLineWriter() {
@@ -194,6 +218,8 @@ bool PDBSourceLineWriter::Open(const wstring &file, FileFormat format) {
     fprintf(stderr, "openSession failed\n");
   }
 
+  file_ = file;
+  format_ = format;
   return true;
 }
 
@@ -233,8 +259,8 @@ bool PDBSourceLineWriter::PrintLines(IDiaEnumLineNumbers *lines) {
     AddressRangeVector ranges;
     MapAddressRange(image_map_, AddressRange(rva, length), &ranges);
     for (size_t i = 0; i < ranges.size(); ++i) {
-      fprintf(output_, "%x %x %d %d\n", ranges[i].rva, ranges[i].length,
-              line_num, source_id);
+      Print("%x %x %d %d\n", ranges[i].rva, ranges[i].length,
+            line_num, source_id);
     }
     line.Release();
   }
@@ -278,8 +304,8 @@ bool PDBSourceLineWriter::PrintFunction(IDiaSymbol *function,
   MapAddressRange(image_map_, AddressRange(rva, static_cast<DWORD>(length)),
                   &ranges);
   for (size_t i = 0; i < ranges.size(); ++i) {
-    fprintf(output_, "FUNC %x %x %x %ws\n",
-            ranges[i].rva, ranges[i].length, stack_param_size, name);
+    Print("FUNC %x %x %x %ws\n",
+          ranges[i].rva, ranges[i].length, stack_param_size, name);
   }
 
   CComPtr<IDiaEnumLineNumbers> lines;
@@ -330,7 +356,7 @@ bool PDBSourceLineWriter::PrintSourceFiles() {
       if (!FileIDIsCached(file_name_string)) {
         // this is a new file name, cache it and output a FILE line.
         CacheFileID(file_name_string, file_id);
-        fwprintf(output_, L"FILE %d %s\n", file_id, file_name);
+        Print("FILE %d %ws\n", file_id, file_name);
       } else {
         // this file name has already been seen, just save this
         // ID for later lookup.
@@ -404,40 +430,64 @@ bool PDBSourceLineWriter::PrintFunctions() {
     symbols.Release();
   }
 
-  std::set<DWORD>::iterator it;
-
   // For each rva, dump the first symbol DIA knows about at the address.
-  for (it = rvas.begin(); it != rvas.end(); ++it) {
-    CComPtr<IDiaSymbol> symbol = NULL;
-    // If the symbol is not in the public list, look for SymTagFunction. This is
-    // a workaround to a bug where DIA will hang if searching for a private
-    // symbol at an address where only a public symbol exists.
-    // See http://connect.microsoft.com/VisualStudio/feedback/details/722366
-    if (public_only_rvas.count(*it) == 0) {
-      if (SUCCEEDED(session_->findSymbolByRVA(*it, SymTagFunction, &symbol))) {
-        // Sometimes findSymbolByRVA returns S_OK, but NULL.
-        if (symbol) {
-          if (!PrintFunction(symbol, symbol))
-            return false;
-          symbol.Release();
-        }
-      } else {
-        fprintf(stderr, "findSymbolByRVA SymTagFunction failed\n");
-        return false;
+  // Looking the symbols up and printing their lines is the slow part of
+  // dumping a large pdb, so split the rvas into contiguous ranges and
+  // print each range with its own session when more threads are allowed.
+  std::vector<DWORD> sorted_rvas(rvas.begin(), rvas.end());
+  const DWORD *rvas_begin = sorted_rvas.empty() ? NULL : &sorted_rvas[0];
+  const DWORD *rvas_end = rvas_begin + sorted_rvas.size();
+
+  size_t thread_count;
+  if (thread_count_ > 0) {
+    thread_count = thread_count_;
+  } else {
+    SYSTEM_INFO system_info;
+    GetSystemInfo(&system_info);
+    thread_count = system_info.dwNumberOfProcessors;
+  }
+  thread_count = (std::min)(thread_count,
+                            sorted_rvas.size() / kMinRVAsPerShard);
+
+  if (thread_count <= 1) {
+    if (!PrintFunctionsAtRVAs(rvas_begin, rvas_end, public_only_rvas))
+      return false;
+  } else {
+    std::vector<FunctionShard> shards(thread_count);
+    std::vector<HANDLE> threads(thread_count);
+    for (size_t i = 0; i < thread_count; ++i) {
+      FunctionShard &shard = shards[i];
+      shard.parent = this;
+      shard.begin = rvas_begin + sorted_rvas.size() * i / thread_count;
+      shard.end = rvas_begin + sorted_rvas.size() * (i + 1) / thread_count;
+      shard.public_only_rvas = &public_only_rvas;
+      shard.result = false;
+      threads[i] = CreateThread(NULL, 0, PrintFunctionShard, &shard, 0, NULL);
+      if (!threads[i]) {
+        // Do this shard on the calling thread instead.
+        PrintFunctionShard(&shard);
       }
-    } else if (SUCCEEDED(session_->findSymbolByRVA(*it,
-                                                   SymTagPublicSymbol,
-                                                   &symbol))) {
-      // Sometimes findSymbolByRVA returns S_OK, but NULL.
-      if (symbol) {
-        if (!PrintCodePublicSymbol(symbol))
-          return false;
-        symbol.Release();
+    }
+
+    bool result = true;
+    for (size_t i = 0; i < thread_count; ++i) {
+      if (threads[i]) {
+        WaitForSingleObject(threads[i], INFINITE);
+        CloseHandle(threads[i]);
+      }
+      // Append in rva order, so that the output does not depend on the
+      // thread count or on which shard finished first.
+      if (result && shards[i].result) {
+        output_buffer_.append(shards[i].output);
+        string().swap(shards[i].output);
+        if (output_ && output_buffer_.size() >= kOutputBufferSize)
+          FlushOutput();
+      } else {
+        result = false;
       }
-    } else {
-      fprintf(stderr, "findSymbolByRVA SymTagPublicSymbol failed\n");
-      return false;
     }
+    if (!result)
+      return false;
   }
 
   // When building with PGO, the compiler can split functions into
@@ -496,6 +546,74 @@ bool PDBSourceLineWriter::PrintFunctions() {
   return true;
 }
 
+bool PDBSourceLineWriter::PrintFunctionsAtRVAs(
+    const DWORD *begin, const DWORD *end,
+    const std::set<DWORD> &public_only_rvas) {
+  // For each rva, dump the first symbol DIA knows about at the address.
+  for (const DWORD *it = begin; it != end; ++it) {
+    CComPtr<IDiaSymbol> symbol = NULL;
+    // If the symbol is not in the public list, look for SymTagFunction. This is
+    // a workaround to a bug where DIA will hang if searching for a private
+    // symbol at an address where only a public symbol exists.
+    // See http://connect.microsoft.com/VisualStudio/feedback/details/722366
+    if (public_only_rvas.count(*it) == 0) {
+      if (SUCCEEDED(session_->findSymbolByRVA(*it, SymTagFunction, &symbol))) {
+        // Sometimes findSymbolByRVA returns S_OK, but NULL.
+        if (symbol) {
+          if (!PrintFunction(symbol, symbol))
+            return false;
+          symbol.Release();
+        }
+      } else {
+        fprintf(stderr, "findSymbolByRVA SymTagFunction failed\n");
+        return false;
+      }
+    } else if (SUCCEEDED(session_->findSymbolByRVA(*it,
+                                                   SymTagPublicSymbol,
+                                                   &symbol))) {
+      // Sometimes findSymbolByRVA returns S_OK, but NULL.
+      if (symbol) {
+        if (!PrintCodePublicSymbol(symbol))
+          return false;
+        symbol.Release();
+      }
+    } else {
+      fprintf(stderr, "findSymbolByRVA SymTagPublicSymbol failed\n");
+      return false;
+    }
+  }
+  return true;
+}
+
+// static
+DWORD WINAPI PDBSourceLineWriter::PrintFunctionShard(void *parameter) {
+  FunctionShard *shard = static_cast<FunctionShard*>(parameter);
+  const PDBSourceLineWriter *parent = shard->parent;
+
+  // DIA sessions must not be shared between threads, so the shard opens
+  // the file again.  Open initializes COM on this thread.
+  PDBSourceLineWriter writer;
+  if (!writer.Open(parent->file_, parent->format_) || !writer.session_) {
+    fprintf(stderr, "failed to open a session for a function shard\n");
+    return 0;
+  }
+
+  // Addresses are translated with the parent's image map, as on the main
+  // session.
+  OmapData omap_data;
+  if (GetOmapDataAndDisableTranslation(writer.session_, &omap_data)) {
+    writer.image_map_ = parent->image_map_;
+    writer.file_ids_ = parent->file_ids_;
+    shard->result = writer.PrintFunctionsAtRVAs(shard->begin, shard->end,
+                                                *shard->public_only_rvas);
+    writer.output_buffer_.swap(shard->output);
+  }
+
+  writer.Close();
+  CoUninitialize();
+  return 0;
+}
+
 #undef max
 
 bool PDBSourceLineWriter::PrintFrameDataUsingPDB() {
@@ -630,14 +748,14 @@ bool PDBSourceLineWriter::PrintFrameDataUsingPDB() {
 
       for (size_t i = 0; i < frame_infos.size(); ++i) {
         const FrameInfo& fi(frame_infos[i]);
-        fprintf(output_, "STACK WIN %x %x %x %x %x %x %x %x %x %d ",
-                type, fi.rva, fi.code_size, fi.prolog_size,
-                0 /* epilog_size */, parameter_size, saved_register_size,
-                local_size, max_stack_size, program_string_result == S_OK);
+        Print("STACK WIN %x %x %x %x %x %x %x %x %x %d ",
+              type, fi.rva, fi.code_size, fi.prolog_size,
+              0 /* epilog_size */, parameter_size, saved_register_size,
+              local_size, max_stack_size, program_string_result == S_OK);
         if (program_string_result == S_OK) {
-          fprintf(output_, "%ws\n", program_string);
+          Print("%ws\n", program_string);
         } else {
-          fprintf(output_, "%d\n", allocates_base_pointer);
+          Print("%d\n", allocates_base_pointer);
         }
       }
 
@@ -776,11 +894,11 @@ bool PDBSourceLineWriter::PrintFrameDataUsingEXE() {
         unwind_info = NULL;
       }
     } while (unwind_info);
-    fprintf(output_, "STACK CFI INIT %x %x .cfa: $rsp .ra: .cfa %d - ^\n",
-            funcs[i].BeginAddress,
-            funcs[i].EndAddress - funcs[i].BeginAddress, rip_offset);
-    fprintf(output_, "STACK CFI %x .cfa: $rsp %d +\n",
-            funcs[i].BeginAddress, stack_size);
+    Print("STACK CFI INIT %x %x .cfa: $rsp .ra: .cfa %d - ^\n",
+          funcs[i].BeginAddress,
+          funcs[i].EndAddress - funcs[i].BeginAddress, rip_offset);
+    Print("STACK CFI %x .cfa: $rsp %d +\n",
+          funcs[i].BeginAddress, stack_size);
   }
 
   return true;
@@ -819,8 +937,8 @@ bool PDBSourceLineWriter::PrintCodePublicSymbol(IDiaSymbol *symbol) {
   AddressRangeVector ranges;
   MapAddressRange(image_map_, AddressRange(rva, 1), &ranges);
   for (size_t i = 0; i < ranges.size(); ++i) {
-    fprintf(output_, "PUBLIC %x %x %ws\n", ranges[i].rva,
-            stack_param_size > 0 ? stack_param_size : 0, name);
+    Print("PUBLIC %x %x %ws\n", ranges[i].rva,
+          stack_param_size > 0 ? stack_param_size : 0, name);
   }
   return true;
 }
@@ -834,22 +952,61 @@ bool PDBSourceLineWriter::PrintPDBInfo() {
   // Hard-code "windows" for the OS because that's the only thing that makes
   // sense for PDB files.  (This might not be strictly correct for Windows CE
   // support, but we don't care about that at the moment.)
-  fprintf(output_, "MODULE windows %ws %ws %ws\n",
-          info.cpu.c_str(), info.debug_identifier.c_str(),
-          info.debug_file.c_str());
+  Print("MODULE windows %ws %ws %ws\n",
+        info.cpu.c_str(), info.debug_identifier.c_str(),
+        info.debug_file.c_str());
 
   return true;
 }
 
+void PDBSourceLineWriter::Print(const char *format, ...) {
+  // Most records fit in a small buffer.  Long names are measured first and
+  // formatted directly into the output buffer.
+  char record[512];
+  va_list args;
+  va_start(args, format);
+  int length = _vsnprintf(record, sizeof(record), format, args);
+  va_end(args);
+  if (length >= 0 && length < static_cast<int>(sizeof(record))) {
+    output_buffer_.append(record, length);
+  } else {
+    va_start(args, format);
+    length = _vscprintf(format, args);
+    va_end(args);
+    if (length < 0)
+      return;
+
+    size_t offset = output_buffer_.size();
+    output_buffer_.resize(offset + length + 1);
+    va_start(args, format);
+    _vsnprintf(&output_buffer_[offset], length + 1, format, args);
+    va_end(args);
+    output_buffer_.resize(offset + length);
+  }
+
+  if (output_ && output_buffer_.size() >= kOutputBufferSize)
+    FlushOutput();
+}
+
+bool PDBSourceLineWriter::FlushOutput() {
+  bool result = true;
+  if (output_ && !output_buffer_.empty()) {
+    result = fwrite(output_buffer_.data(), 1, output_buffer_.size(),
+                    output_) == output_buffer_.size();
+  }
+  output_buffer_.clear();
+  return result;
+}
+
 bool PDBSourceLineWriter::PrintPEInfo() {
   PEModuleInfo info;
   if (!GetPEInfo(&info)) {
     return false;
   }
 
-  fprintf(output_, "INFO CODE_ID %ws %ws\n",
-          info.code_identifier.c_str(),
-          info.code_file.c_str());
+  Print("INFO CODE_ID %ws %ws\n",
+        info.code_identifier.c_str(),
+        info.code_file.c_str());
   return true;
 }
 
@@ -1136,6 +1293,7 @@ bool PDBSourceLineWriter::WriteMap(FILE *map_file) {
       PrintFunctions() &&
       PrintFrameData();
 
+  ret = FlushOutput() && ret;
   output_ = NULL;
   return ret;
 }
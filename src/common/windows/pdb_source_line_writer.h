@@ -36,6 +36,7 @@
 #include <atlcomcli.h>
 
 #include <hash_map>
+#include <set>
 #include <string>
 
 #include "common/windows/omap.h"
@@ -46,6 +47,7 @@ struct IDiaSymbol;
 
 namespace google_breakpad {
 
+using std::string;
 using std::wstring;
 using stdext::hash_map;
 
@@ -114,6 +116,15 @@ class PDBSourceLineWriter {
   // Returns true on success.
   bool WriteMap(FILE *map_file);
 
+  // Sets the number of threads WriteMap may use to print functions and
+  // their line records.  Each extra thread opens its own DIA session on
+  // the file passed to Open and prints a contiguous range of function
+  // addresses; the ranges are written out in address order, so the map
+  // file is the same as with a single thread.  0 means one thread per
+  // processor.  The default is 1, which does all of the work on the
+  // calling thread.
+  void set_thread_count(int thread_count) { thread_count_ = thread_count; }
+
   // Closes the current pdb file and its associated resources.
   void Close();
 
@@ -147,6 +158,19 @@ class PDBSourceLineWriter {
   // Outputs all functions as described above.  Returns true on success.
   bool PrintFunctions();
 
+  // Outputs the function or public symbol at each rva in [begin, end).
+  // Rvas in public_only_rvas are looked up as public symbols only.
+  // Returns true on success.
+  bool PrintFunctionsAtRVAs(const DWORD *begin, const DWORD *end,
+                            const std::set<DWORD> &public_only_rvas);
+
+  // The work for one of the threads started by PrintFunctions.
+  struct FunctionShard;
+
+  // Opens a separate session on the pdb file and prints the shard's
+  // functions into its own output.  Runs on a worker thread.
+  static DWORD WINAPI PrintFunctionShard(void *shard);
+
   // Outputs all of the source files in the session's pdb file.
   // Returns true on success.
   bool PrintSourceFiles();
@@ -179,6 +203,14 @@ class PDBSourceLineWriter {
   // which consists of its timestamp and file size.
   bool PrintPEInfo();
 
+  // Formats a record into output_buffer_, flushing the buffer to output_
+  // once it is large enough.
+  void Print(const char *format, ...);
+
+  // Writes output_buffer_ to output_, if there is an output file, and
+  // empties it.  Returns false if the write fails.
+  bool FlushOutput();
+
   // Returns true if this filename has already been seen,
   // and an ID is stored for it, or false if it has not.
   bool FileIDIsCached(const wstring &file) {
@@ -231,11 +263,23 @@ class PDBSourceLineWriter {
   // pdb file.
   wstring code_file_;
 
+  // The file and format passed to Open, so that worker threads can open
+  // sessions of their own.
+  wstring file_;
+  FileFormat format_;
+
+  // The number of threads to use for PrintFunctions.  See
+  // set_thread_count.
+  int thread_count_;
+
   // The session for the currently-open pdb file.
   CComPtr<IDiaSession> session_;
 
-  // The current output file for this WriteMap invocation.
+  // The current output file for this WriteMap invocation.  Records are
+  // collected in output_buffer_ and written out in large blocks.  Shard
+  // writers have no output file and keep everything in their buffer.
   FILE *output_;
+  string output_buffer_;
 
   // There may be many duplicate filenames with different IDs.
   // This maps from the DIA "unique ID" to a single ID per unique
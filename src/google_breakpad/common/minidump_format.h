@@ -342,7 +342,10 @@ typedef enum {
   MD_LINUX_ENVIRON               = 0x47670007,  /* /proc/$x/environ   */
   MD_LINUX_AUXV                  = 0x47670008,  /* /proc/$x/auxv      */
   MD_LINUX_MAPS                  = 0x47670009,  /* /proc/$x/maps      */
-  MD_LINUX_DSO_DEBUG             = 0x4767000A   /* MDRawDebug{32,64}  */
+  MD_LINUX_DSO_DEBUG             = 0x4767000A,  /* MDRawDebug{32,64}  */
+  MD_LINUX_ANNOTATIONS           = 0x4767000B,  /* MDRawAnnotationList */
+  MD_LINUX_HANDLER_TIMING        = 0x4767000C,  /* MDRawHandlerTimingList */
+  MD_LINUX_SNAPSHOT              = 0x4767000D   /* MDRawSnapshotInfo */
 } MDStreamType;  /* MINIDUMP_STREAM_TYPE */
 
 
@@ -964,6 +967,101 @@ typedef struct {
   uint64_t  dynamic;
 } MDRawDebug64;
 
+/* The annotations that the threads of a Linux process recorded in their
+ * CrashAnnotations rings, for MD_LINUX_ANNOTATIONS.  A thread's annotations
+ * are listed oldest first, and only the most recent ones that its ring
+ * held at the time of the dump are included. */
+
+#define MD_ANNOTATION_KEY_SIZE 32
+#define MD_ANNOTATION_VALUE_SIZE 96
+
+typedef struct {
+  uint32_t  thread_id;  /* The thread that recorded the annotation. */
+  uint32_t  sequence;   /* Its place among the thread's annotations. */
+  char      key[MD_ANNOTATION_KEY_SIZE];      /* 0-terminated */
+  char      value[MD_ANNOTATION_VALUE_SIZE];  /* 0-terminated */
+} MDRawAnnotation;
+
+typedef struct {
+  uint32_t        number_of_annotations;
+  MDRawAnnotation annotations[1];
+} MDRawAnnotationList;
+
+static const size_t MDRawAnnotationList_minsize =
+    offsetof(MDRawAnnotationList, annotations[0]);
+
+/* How long the phases of handling a Linux crash took, for
+ * MD_LINUX_HANDLER_TIMING.  The list is followed by number_of_entries
+ * MDRawHandlerTiming entries, one for each phase that ran.  Times are in
+ * nanoseconds of CLOCK_MONOTONIC.  Phases may nest: the time spent writing
+ * the dump includes the time spent computing module identifiers and
+ * copying memory.  The phases are numbered by what they do, not by when
+ * they run: the memory is copied before the module identifiers are
+ * computed.  The time spent writing this stream itself, and whatever the
+ * handler does after the dump is written, is not recorded. */
+
+typedef enum {
+  /* From the signal handler being entered to the minidump writer
+   * starting, which includes cloning the dumping process or handing the
+   * crash to the dump helper. */
+  MD_HANDLER_PHASE_HANDLER     = 1,
+  /* Reading the process's threads, mappings and auxiliary vector. */
+  MD_HANDLER_PHASE_ENUMERATE   = 2,
+  /* Suspending the process's threads. */
+  MD_HANDLER_PHASE_SUSPEND     = 3,
+  /* Computing the identifiers of the process's modules. */
+  MD_HANDLER_PHASE_IDENTIFIERS = 4,
+  /* Copying thread stacks and other memory from the process. */
+  MD_HANDLER_PHASE_MEMORY      = 5,
+  /* Writing the minidump's streams. */
+  MD_HANDLER_PHASE_WRITE       = 6
+} MDHandlerPhase;
+
+typedef struct {
+  uint32_t  size_of_header;     /* sizeof(MDRawHandlerTimingList) */
+  uint32_t  size_of_entry;      /* sizeof(MDRawHandlerTiming) */
+  uint32_t  number_of_entries;
+  uint32_t  reserved;
+  uint64_t  start_time;  /* When the handler was entered. */
+} MDRawHandlerTimingList;
+
+typedef struct {
+  uint32_t  phase;       /* MDHandlerPhase */
+  uint32_t  count;       /* How many times the phase ran. */
+  uint64_t  start_time;  /* When it first started, after the list's
+                          * start_time. */
+  uint64_t  duration;    /* The time spent in it in all. */
+} MDRawHandlerTiming;
+
+/* Marks a minidump as one of a series of snapshots of a live Linux
+ * process, for MD_LINUX_SNAPSHOT.  The first of a series, the base, is a
+ * complete minidump, taken just before the kernel's soft-dirty bits for the
+ * process were cleared.  Each later one, a delta, has the base's series_id
+ * and a higher sequence number.  A delta's memory list holds only the
+ * pages of its memory ranges that the process wrote after the base was
+ * taken, its threads' stack descriptors are empty, and the stacks they
+ * would have held are listed after this header as number_of_entries
+ * MDRawSnapshotStack entries.  Overlaying a delta's memory on its base's
+ * rebuilds a complete minidump; memory in neither was not written since
+ * the base and was not in it. */
+
+typedef struct {
+  uint32_t  size_of_header;     /* sizeof(MDRawSnapshotInfo) */
+  uint32_t  size_of_entry;      /* sizeof(MDRawSnapshotStack) */
+  uint32_t  number_of_entries;  /* 0 in a base. */
+  uint32_t  sequence;           /* 0 for the base, then 1, 2, ... */
+  MDGUID    series_id;          /* The same in every snapshot of a series. */
+  uint32_t  process_id;
+  uint32_t  page_size;          /* The granularity of a delta's memory. */
+} MDRawSnapshotInfo;
+
+typedef struct {
+  uint32_t  thread_id;
+  uint32_t  reserved;
+  uint64_t  start_of_memory_range;
+  uint64_t  size;
+} MDRawSnapshotStack;
+
 #if defined(_MSC_VER)
 #pragma warning(pop)
 #endif  /* _MSC_VER */
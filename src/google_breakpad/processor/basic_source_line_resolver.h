@@ -48,6 +48,8 @@ namespace google_breakpad {
 
 using std::map;
 
+class TaskExecutor;
+
 class BasicSourceLineResolver : public SourceLineResolverBase {
  public:
   BasicSourceLineResolver();
@@ -56,6 +58,15 @@ class BasicSourceLineResolver : public SourceLineResolverBase {
   using SourceLineResolverBase::LoadModule;
   using SourceLineResolverBase::LoadModuleUsingMapBuffer;
   using SourceLineResolverBase::LoadModuleUsingMemoryBuffer;
+  using SourceLineResolverBase::LoadModuleUsingMappedFile;
+  using SourceLineResolverBase::LoadModuleUsingCompressedFile;
+  using SourceLineResolverBase::LoadModuleUsingIndexedFile;
+  using SourceLineResolverBase::CanLoadModulesUsingIndexedFiles;
+  using SourceLineResolverBase::LoadModuleUsingDigest;
+  using SourceLineResolverBase::CanShareModulesByDigest;
+  using SourceLineResolverBase::DeferSourceLines;
+  using SourceLineResolverBase::HasDeferredSourceLines;
+  using SourceLineResolverBase::LoadSourceLinesUsingMemoryBuffer;
   using SourceLineResolverBase::ShouldDeleteMemoryBufferAfterLoadModule;
   using SourceLineResolverBase::UnloadModule;
   using SourceLineResolverBase::HasModule;
@@ -63,6 +74,45 @@ class BasicSourceLineResolver : public SourceLineResolverBase {
   using SourceLineResolverBase::FillSourceLineInfo;
   using SourceLineResolverBase::FindWindowsFrameInfo;
   using SourceLineResolverBase::FindCFIFrameInfo;
+  using SourceLineResolverBase::CanLookUpConcurrently;
+
+  // Sets the number of threads used to parse each large symbol file.  With
+  // the default of 1 (or 0), symbol files are parsed on the loading thread.
+  // With more, the symbol data is split into chunks at record boundaries;
+  // the loading thread parses the first chunk while additional threads
+  // parse the rest, and the results are stored in symbol file order, so
+  // the loaded module is the same either way.  Small symbol files are
+  // always parsed on the loading thread, as are all symbol files on
+  // Windows.  This setting applies to every BasicSourceLineResolver, and
+  // should not be changed while symbols are being loaded.
+  static void set_load_thread_count(unsigned int load_thread_count) {
+    load_thread_count_ = load_thread_count;
+  }
+  static unsigned int load_thread_count() { return load_thread_count_; }
+
+  // Sets the executor that the chunks of a symbol file being parsed on
+  // several threads are parsed on, ahead of its other work, instead of on
+  // threads started for each symbol file.  Chunks that no executor thread
+  // has started by the time the loading thread is done with its own are
+  // parsed on the loading thread.  NULL, the default, starts threads.  Like
+  // set_load_thread_count, this applies to every BasicSourceLineResolver.
+  // Does not take ownership of |executor|.
+  static void set_load_executor(TaskExecutor *executor) {
+    load_executor_ = executor;
+  }
+  static TaskExecutor *load_executor() { return load_executor_; }
+
+  // Each module keeps its functions and public symbols in an arena of
+  // large blocks that is freed all at once when the module is unloaded,
+  // rather than allocating them one at a time.  If |huge_page_arenas| is
+  // true, those blocks are backed by transparent huge pages where the
+  // system supports them, which cuts TLB misses in lookups across large
+  // modules but rounds each module's arena up to 2MB.  False by default.
+  // Applies to modules loaded afterwards, by every BasicSourceLineResolver.
+  static void set_huge_page_arenas(bool huge_page_arenas) {
+    huge_page_arenas_ = huge_page_arenas;
+  }
+  static bool huge_page_arenas() { return huge_page_arenas_; }
 
  private:
   // friend declarations:
@@ -73,9 +123,21 @@ class BasicSourceLineResolver : public SourceLineResolverBase {
 
   // Function derives from SourceLineResolverBase::Function.
   struct Function;
+  // PublicSymbol derives from SourceLineResolverBase::PublicSymbol.
+  struct PublicSymbol;
   // Module implements SourceLineResolverBase::Module interface.
   class Module;
 
+  // The number of threads used to parse a symbol file.  See
+  // set_load_thread_count.
+  static unsigned int load_thread_count_;
+
+  // See set_load_executor.
+  static TaskExecutor *load_executor_;
+
+  // See set_huge_page_arenas.
+  static bool huge_page_arenas_;
+
   // Disallow unwanted copy ctor and assignment operator
   BasicSourceLineResolver(const BasicSourceLineResolver&);
   void operator=(const BasicSourceLineResolver&);
@@ -133,6 +195,13 @@ class SymbolParseHelper {
   // Used for success checks after strtoull and strtol.
   static bool IsValidAfterNumber(char *after_number);
 
+  // Parse a whole record field as a number, the way strtoull and strtol
+  // followed by IsValidAfterNumber do.  Fields that are nothing but a short
+  // run of digits are decoded directly; anything else (signs, "0x" prefixes,
+  // out-of-range values) is left to the C library.  Returns true on success.
+  static bool ParseHexField(char *field, uint64_t *value);
+  static bool ParseLongField(char *field, int base, long *value);
+
   // Only allow static methods.
   SymbolParseHelper();
   SymbolParseHelper(const SymbolParseHelper&);
@@ -0,0 +1,122 @@
+// Copyright (c) 2016 Google Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+// notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above
+// copyright notice, this list of conditions and the following disclaimer
+// in the documentation and/or other materials provided with the
+// distribution.
+//     * Neither the name of Google Inc. nor the names of its
+// contributors may be used to endorse or promote products derived from
+// this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+// block_caching_minidump_reader.h: BlockCachingMinidumpReader, a
+// MinidumpReader that reads another one a block at a time and keeps the
+// blocks it has read.
+//
+// Minidump reads a few bytes at a time: a stream's count, then each of its
+// entries, then the strings and records they point to.  Passed straight
+// to a reader that makes a request for each read, that is thousands of
+// requests per dump.  BlockCachingMinidumpReader rounds each read out to
+// whole blocks, fetches the blocks it doesn't have with one read of the
+// underlying reader for each contiguous run, and keeps the most recently
+// used |max_blocks| of them, so that processing a dump costs a few dozen
+// requests for the few megabytes it touches.  Reads larger than the whole
+// cache are passed through uncached.
+//
+// Like Minidump itself, a BlockCachingMinidumpReader is not thread-safe.
+
+#ifndef GOOGLE_BREAKPAD_PROCESSOR_BLOCK_CACHING_MINIDUMP_READER_H__
+#define GOOGLE_BREAKPAD_PROCESSOR_BLOCK_CACHING_MINIDUMP_READER_H__
+
+#include <stddef.h>
+
+#include <list>
+#include <map>
+#include <vector>
+
+#include "google_breakpad/common/breakpad_types.h"
+#include "google_breakpad/processor/minidump_reader.h"
+
+namespace google_breakpad {
+
+class BlockCachingMinidumpReader : public MinidumpReader {
+ public:
+  // The defaults suit readers with a high cost per request: 64kB blocks,
+  // and up to 16MB of them.
+  static const size_t kDefaultBlockSize = 64 * 1024;
+  static const size_t kDefaultMaxBlocks = 256;
+
+  // Reads |source|, which must outlive this object, in blocks of
+  // |block_size| bytes, keeping at most |max_blocks| of them.
+  BlockCachingMinidumpReader(MinidumpReader* source,
+                             size_t block_size,
+                             size_t max_blocks);
+  virtual ~BlockCachingMinidumpReader();
+
+  // MinidumpReader implementation.
+  virtual uint64_t size() const;
+  virtual bool ReadAt(uint64_t offset, void* buffer, size_t count);
+
+  // The number of reads made of the source, and the bytes they read.
+  uint64_t source_reads() const { return source_reads_; }
+  uint64_t source_bytes() const { return source_bytes_; }
+
+  // The number of blocks held.
+  size_t cached_blocks() const { return blocks_.size(); }
+
+ private:
+  struct Block {
+    uint64_t index;
+    std::vector<uint8_t> data;
+  };
+  typedef std::list<Block> BlockList;
+
+  // Reads blocks |first| to |last| of the source into the cache, except
+  // those already held, and marks them all most recently used.  Returns
+  // false if a read of the source fails.
+  bool FetchBlocks(uint64_t first, uint64_t last);
+
+  // Reads |count| bytes at |offset| from the source.
+  bool ReadSource(uint64_t offset, void* buffer, size_t count);
+
+  // Drops the least recently used blocks until at most max_blocks_ remain.
+  void Trim();
+
+  MinidumpReader* source_;
+  const size_t block_size_;
+  const size_t max_blocks_;
+
+  // The blocks held, most recently used first, and an index of them by
+  // block number.
+  BlockList recent_;
+  std::map<uint64_t, BlockList::iterator> blocks_;
+
+  uint64_t source_reads_;
+  uint64_t source_bytes_;
+
+  // Disallow copy constructor and assignment operator.
+  BlockCachingMinidumpReader(const BlockCachingMinidumpReader&);
+  void operator=(const BlockCachingMinidumpReader&);
+};
+
+}  // namespace google_breakpad
+
+#endif  // GOOGLE_BREAKPAD_PROCESSOR_BLOCK_CACHING_MINIDUMP_READER_H__
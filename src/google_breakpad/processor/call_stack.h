@@ -47,29 +47,54 @@
 
 #include <vector>
 
+#include "google_breakpad/processor/frame_arena.h"
+
 namespace google_breakpad {
 
 using std::vector;
 
+class CodeModule;
 struct StackFrame;
 template<typename T> class linked_ptr;
 
-class CallStack {
+class CallStack : public FrameArenaAllocated {
  public:
   CallStack() { Clear(); }
   ~CallStack();
 
-  // Resets the CallStack to its initial empty state
+  // Resets the CallStack to its initial empty state.  The storage of the
+  // frame vector is kept for the frames of the next walk.
   void Clear();
   
   const vector<StackFrame*>* frames() const { return &frames_; }
 
+  // True if the walk stopped early because its WalkBudget ran out, so
+  // that the outermost frames are missing.
+  bool truncated() const { return truncated_; }
+
+  // The modules whose symbols the walk consulted while judging candidate
+  // return addresses found by stack scanning, each listed once.  The
+  // frames this walk found could differ if their symbols changed, as could
+  // those found with the call frame info of the frames' own modules.
+  const vector<const CodeModule*>* scanned_modules() const {
+    return &scanned_modules_;
+  }
+
  private:
   // Stackwalker is responsible for building the frames_ vector.
+  // ProcessStateSerializer rebuilds it from a serialized stack.
   friend class Stackwalker;
+  friend class ProcessStateSerializer;
+  // ProcessState keeps the frame vectors of the stacks it clears.
+  friend class ProcessState;
 
   // Storage for pushed frames.
   vector<StackFrame*> frames_;
+
+  bool truncated_;
+
+  // The modules are not owned by the CallStack.
+  vector<const CodeModule*> scanned_modules_;
 };
 
 }  // namespace google_breakpad
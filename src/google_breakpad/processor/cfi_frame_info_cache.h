@@ -0,0 +1,135 @@
+// Copyright (c) 2016 Google Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+// notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above
+// copyright notice, this list of conditions and the following disclaimer
+// in the documentation and/or other materials provided with the
+// distribution.
+//     * Neither the name of Google Inc. nor the names of its
+// contributors may be used to endorse or promote products derived from
+// this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+// cfi_frame_info_cache.h: CFIFrameInfoCache, a bounded, thread-safe cache
+// of the CFI rules in effect at particular instructions.
+//
+// Building the CFIFrameInfo for an instruction means finding the function's
+// STACK CFI INIT record and applying every STACK CFI delta record up to
+// the instruction.  The same few instructions (allocator, locking and
+// dispatch frames) show up in thread after thread and dump after dump, so
+// StackFrameSymbolizer can be given a CFIFrameInfoCache
+// (StackFrameSymbolizer::set_cfi_frame_info_cache) to remember the rules
+// it prepared.  Entries are keyed by the module's debug file and debug
+// identifier and by the instruction's offset within the module, so one
+// cache may be shared by any number of symbolizers, on any number of
+// threads, and across dumps.  When the cache is full, the least recently
+// used entry is discarded.
+
+#ifndef GOOGLE_BREAKPAD_PROCESSOR_CFI_FRAME_INFO_CACHE_H__
+#define GOOGLE_BREAKPAD_PROCESSOR_CFI_FRAME_INFO_CACHE_H__
+
+#include <stddef.h>
+
+#include <list>
+#include <map>
+#include <string>
+
+#include "common/using_std_string.h"
+#include "google_breakpad/common/breakpad_types.h"
+
+namespace google_breakpad {
+
+class CFIFrameInfo;
+class CodeModule;
+class Mutex;
+
+class CFIFrameInfoCache {
+ public:
+  // Creates a cache holding at most |max_entries| entries.
+  explicit CFIFrameInfoCache(size_t max_entries);
+  ~CFIFrameInfoCache();
+
+  // Looks up the rules for the instruction at |address| in |module|.
+  // Returns false if they aren't cached.  Otherwise returns true and sets
+  // |cfi_frame_info| to a new copy of the cached rules, which the caller
+  // owns, or to NULL if the module is known to have no CFI for |address|.
+  bool Lookup(const CodeModule* module, uint64_t address,
+              CFIFrameInfo** cfi_frame_info);
+
+  // Remembers a copy of |cfi_frame_info| as the rules for the instruction
+  // at |address| in |module|.  |cfi_frame_info| may be NULL to record that
+  // there are no rules for it.  Modules without a debug identifier can't
+  // be told apart reliably and are not cached.
+  void Store(const CodeModule* module, uint64_t address,
+             const CFIFrameInfo* cfi_frame_info);
+
+  // Discards every entry.  The counters are not reset.
+  void Clear();
+
+  size_t max_entries() const { return max_entries_; }
+  size_t size() const;
+
+  // The number of Lookup calls that were and were not answered from the
+  // cache.
+  uint64_t hits() const;
+  uint64_t misses() const;
+
+ private:
+  struct Key {
+    Key(const string& set_module, uint64_t set_offset)
+        : module(set_module), offset(set_offset) {}
+    bool operator<(const Key& that) const {
+      // Offsets are cheaper to compare and rarely equal.
+      if (offset != that.offset)
+        return offset < that.offset;
+      return module < that.module;
+    }
+
+    string module;
+    uint64_t offset;
+  };
+
+  struct Entry;
+  typedef std::map<Key, Entry*> EntryMap;
+  typedef std::list<Entry*> EntryList;
+
+  // Returns false if |module| can't be cached.
+  static bool KeyForAddress(const CodeModule* module, uint64_t address,
+                            Key* key);
+
+  size_t max_entries_;
+  EntryMap entries_;
+
+  // All entries, most recently used first.
+  EntryList recent_;
+
+  uint64_t hits_;
+  uint64_t misses_;
+
+  Mutex* mutex_;
+
+  // Disallow copy constructor and assignment operator.
+  CFIFrameInfoCache(const CFIFrameInfoCache&);
+  void operator=(const CFIFrameInfoCache&);
+};
+
+}  // namespace google_breakpad
+
+#endif  // GOOGLE_BREAKPAD_PROCESSOR_CFI_FRAME_INFO_CACHE_H__
@@ -35,6 +35,8 @@
 #ifndef GOOGLE_BREAKPAD_PROCESSOR_CODE_MODULES_H__
 #define GOOGLE_BREAKPAD_PROCESSOR_CODE_MODULES_H__
 
+#include <stddef.h>
+
 #include "google_breakpad/common/breakpad_types.h"
 
 namespace google_breakpad {
@@ -55,6 +57,20 @@ class CodeModules {
   // comparison with pointers returned by the other Get methods.
   virtual const CodeModule* GetModuleForAddress(uint64_t address) const = 0;
 
+  // Looks up the modules at |count| addresses at once, storing the module
+  // whose code is present at addresses[i], or NULL, in modules[i].
+  // Implementations may sort the addresses so that those falling in the
+  // same module share one search, which makes this cheaper than calling
+  // GetModuleForAddress in a loop when the addresses cluster, as the words
+  // examined by a stack scan do.  The default implementation does call
+  // GetModuleForAddress in a loop.
+  virtual void GetModulesForAddresses(const uint64_t* addresses,
+                                      size_t count,
+                                      const CodeModule** modules) const {
+    for (size_t i = 0; i < count; ++i)
+      modules[i] = GetModuleForAddress(addresses[i]);
+  }
+
   // Returns the module corresponding to the main executable.  If there is
   // no main executable, returns NULL.  Ownership of the returned CodeModule
   // is retained by the CodeModules object; pointers returned by this method
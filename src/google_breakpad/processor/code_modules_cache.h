@@ -0,0 +1,123 @@
+// Copyright (c) 2016 Google Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+// notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above
+// copyright notice, this list of conditions and the following disclaimer
+// in the documentation and/or other materials provided with the
+// distribution.
+//     * Neither the name of Google Inc. nor the names of its
+// contributors may be used to endorse or promote products derived from
+// this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+// code_modules_cache.h: CodeModulesCache, a bounded, thread-safe cache of
+// immutable module lists shared by the dumps that load the same modules.
+//
+// A ProcessState holds its own copy of the dump's module list, which
+// MinidumpProcessor makes with CodeModules::Copy: a range map and a copy
+// of every module with all of its name strings.  Crashes of one build
+// load the same modules at the same addresses, so a processor working
+// through many of them builds the same list over and over.  Given a
+// CodeModulesCache (MinidumpProcessor::set_code_modules_cache), the
+// processor asks the cache for the copy instead, and dumps whose module
+// lists match share one copy, counted by reference, which is never
+// modified and is freed once neither the cache nor any ProcessState uses
+// it.
+//
+// Module lists match if they hold the same modules, each with the same
+// address range, files, identifiers and version, and the same main
+// module, in any order.  One cache may be shared by any number of
+// processors, on any number of threads.  When the cache is full, the
+// least recently used list is dropped from it.
+
+#ifndef GOOGLE_BREAKPAD_PROCESSOR_CODE_MODULES_CACHE_H__
+#define GOOGLE_BREAKPAD_PROCESSOR_CODE_MODULES_CACHE_H__
+
+#include <stddef.h>
+
+#include <list>
+#include <map>
+
+#include "google_breakpad/common/breakpad_types.h"
+
+namespace google_breakpad {
+
+class CodeModules;
+class Mutex;
+
+class CodeModulesCache {
+ public:
+  // Creates a cache holding at most |max_entries| module lists.
+  explicit CodeModulesCache(size_t max_entries);
+
+  // Drops the cache's module lists.  Copies handed out stay valid.
+  ~CodeModulesCache();
+
+  // Returns a copy of |modules| for the caller to own and delete, as
+  // CodeModules::Copy does.  If a matching list is in the cache, the copy
+  // shares it; otherwise a new immutable copy is made and added to the
+  // cache.
+  const CodeModules* Copy(const CodeModules* modules);
+
+  // Drops every module list.  The counters are not reset.
+  void Clear();
+
+  size_t max_entries() const { return max_entries_; }
+  size_t size() const;
+
+  // The number of Copy calls that did and didn't find a matching list.
+  uint64_t hits() const;
+  uint64_t misses() const;
+
+ private:
+  class Entry;
+  class SharedModules;
+
+  typedef std::list<Entry*> EntryList;
+  typedef std::multimap<uint64_t, EntryList::iterator> EntryMap;
+
+  // Returns a hash of |modules| that doesn't depend on their order.
+  static uint64_t Hash(const CodeModules* modules);
+
+  // Returns true if |a| and |b| hold the same modules.
+  static bool Matches(const CodeModules* a, const CodeModules* b);
+
+  size_t max_entries_;
+
+  // The entries in recent_, by the hash of their module lists.
+  EntryMap entries_;
+
+  // All entries, most recently used first.  Each holds a reference to its
+  // entry.
+  EntryList recent_;
+
+  uint64_t hits_;
+  uint64_t misses_;
+
+  Mutex* mutex_;
+
+  // Disallow copy constructor and assignment operator.
+  CodeModulesCache(const CodeModulesCache&);
+  void operator=(const CodeModulesCache&);
+};
+
+}  // namespace google_breakpad
+
+#endif  // GOOGLE_BREAKPAD_PROCESSOR_CODE_MODULES_CACHE_H__
@@ -0,0 +1,112 @@
+// Copyright (c) 2016 Google Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+// notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above
+// copyright notice, this list of conditions and the following disclaimer
+// in the documentation and/or other materials provided with the
+// distribution.
+//     * Neither the name of Google Inc. nor the names of its
+// contributors may be used to endorse or promote products derived from
+// this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+// crash_signature_cache.h: CrashSignatureCache, a bounded, thread-safe set
+// of the crashes recently processed, so that duplicates can be skipped.
+//
+// When one crash floods a crash server, nearly every incoming minidump is
+// another copy of it, and walking all of its threads and rating its
+// exploitability again tells nothing new.  Given a CrashSignatureCache
+// (MinidumpProcessor::set_crash_signature_cache), MinidumpProcessor walks
+// the requesting thread first, computes the minidump's signature from it,
+// and returns PROCESS_DUPLICATE_CRASH without walking the other threads if
+// the signature is already in the cache.
+//
+// A signature is a 64-bit hash of the crash reason, the module list (each
+// module's debug file and debug identifier, in list order) and the
+// requesting thread's instruction addresses, each as an offset in its
+// module, so that it doesn't depend on where the modules were loaded.  One
+// cache may be shared by any number of processors, on any number of
+// threads.  When the cache is full, the least recently seen signature is
+// discarded.
+
+#ifndef GOOGLE_BREAKPAD_PROCESSOR_CRASH_SIGNATURE_CACHE_H__
+#define GOOGLE_BREAKPAD_PROCESSOR_CRASH_SIGNATURE_CACHE_H__
+
+#include <stddef.h>
+
+#include <list>
+#include <map>
+
+#include "google_breakpad/common/breakpad_types.h"
+
+namespace google_breakpad {
+
+class Mutex;
+class ProcessState;
+
+class CrashSignatureCache {
+ public:
+  // Creates a cache holding at most |max_entries| signatures.
+  explicit CrashSignatureCache(size_t max_entries);
+  ~CrashSignatureCache();
+
+  // Returns the signature of |process_state|, or 0 if it has no requesting
+  // thread to compute one from.
+  static uint64_t Signature(const ProcessState& process_state);
+
+  // Records |signature| as seen, returning true if it already had been.
+  // Signature 0 is never recorded.
+  bool Record(uint64_t signature);
+
+  // Discards every signature.  The counters are not reset.
+  void Clear();
+
+  size_t max_entries() const { return max_entries_; }
+  size_t size() const;
+
+  // The number of Record calls whose signature had and hadn't been seen.
+  uint64_t hits() const;
+  uint64_t misses() const;
+
+ private:
+  typedef std::list<uint64_t> SignatureList;
+  typedef std::map<uint64_t, SignatureList::iterator> SignatureMap;
+
+  size_t max_entries_;
+
+  // Each signature's position in recent_.
+  SignatureMap signatures_;
+
+  // All signatures, most recently seen first.
+  SignatureList recent_;
+
+  uint64_t hits_;
+  uint64_t misses_;
+
+  Mutex* mutex_;
+
+  // Disallow copy constructor and assignment operator.
+  CrashSignatureCache(const CrashSignatureCache&);
+  void operator=(const CrashSignatureCache&);
+};
+
+}  // namespace google_breakpad
+
+#endif  // GOOGLE_BREAKPAD_PROCESSOR_CRASH_SIGNATURE_CACHE_H__
@@ -67,6 +67,9 @@ class DumpContext : public DumpObject {
   // MDRawContext, since it varies per-CPU architecture.
   bool GetInstructionPointer(uint64_t* ip) const;
 
+  // Likewise for the stack pointer.
+  bool GetStackPointer(uint64_t* sp) const;
+
   // Print a human-readable representation of the object to stdout.
   void Print();
 
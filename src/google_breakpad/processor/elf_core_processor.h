@@ -0,0 +1,85 @@
+// Copyright (c) 2016 Google Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+// notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above
+// copyright notice, this list of conditions and the following disclaimer
+// in the documentation and/or other materials provided with the
+// distribution.
+//     * Neither the name of Google Inc. nor the names of its
+// contributors may be used to endorse or promote products derived from
+// this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+// elf_core_processor.h: The processor for Linux ELF core files.
+//
+// ElfCoreProcessor walks the stack of every thread of a core file straight
+// from the mapped core, the way MinidumpProcessor walks a minidump, so
+// that a core need not be converted with core2md first.  Only cores of the
+// processor's own CPU can be read.  See elf_core.h for how the threads,
+// modules and memory are found.
+
+#ifndef GOOGLE_BREAKPAD_PROCESSOR_ELF_CORE_PROCESSOR_H__
+#define GOOGLE_BREAKPAD_PROCESSOR_ELF_CORE_PROCESSOR_H__
+
+#include <string>
+
+#include "common/using_std_string.h"
+#include "google_breakpad/common/breakpad_types.h"
+#include "google_breakpad/processor/process_result.h"
+
+namespace google_breakpad {
+
+class ElfCore;
+class ProcessState;
+class StackFrameSymbolizer;
+
+class ElfCoreProcessor {
+ public:
+  // Initializes the ElfCoreProcessor with a stack frame symbolizer.
+  // Does not take ownership of frame_symbolizer, which must NOT be NULL.
+  explicit ElfCoreProcessor(StackFrameSymbolizer* frame_symbolizer);
+
+  virtual ~ElfCoreProcessor();
+
+  // Processes the core file at |core_path| and fills process_state with
+  // the result.  The core is unmapped before returning, so the entries of
+  // process_state's thread_memory_regions are NULL.
+  ProcessResult Process(const string& core_path, ProcessState* process_state);
+
+  // Processes |core| and fills process_state with the result.
+  // process_state refers to the memory of |core|, so |core| must outlive
+  // it.
+  ProcessResult Process(ElfCore* core, ProcessState* process_state);
+
+  // Returns a description of the signal |signal_number|, named as
+  // MinidumpProcessor names the signals of Linux minidumps.
+  static string GetCrashReason(int signal_number);
+
+ private:
+  StackFrameSymbolizer* frame_symbolizer_;
+
+  // Disallow copy constructor and assignment operator.
+  ElfCoreProcessor(const ElfCoreProcessor&);
+  void operator=(const ElfCoreProcessor&);
+};
+
+}  // namespace google_breakpad
+
+#endif  // GOOGLE_BREAKPAD_PROCESSOR_ELF_CORE_PROCESSOR_H__
@@ -46,6 +46,8 @@
 
 namespace google_breakpad {
 
+class InstructionAnalysisCache;
+
 class Exploitability {
  public:
   virtual ~Exploitability() {}
@@ -56,6 +58,22 @@ class Exploitability {
   ExploitabilityRating CheckExploitability();
   bool AddressIsAscii(uint64_t);
 
+  // Enables or disables disassembling the code at the crash address.  The
+  // rating is much cheaper to compute without it, but then rests only on
+  // the exception, the addresses involved and whether the crash address is
+  // on the stack.  Analysis is on by default.
+  void set_analyze_instructions(bool analyze_instructions) {
+    analyze_instructions_ = analyze_instructions;
+  }
+  bool analyze_instructions() const { return analyze_instructions_; }
+
+  // Sets a cache of what analyzing the code at crash addresses found,
+  // which may be shared with other engines.  Does not take ownership of
+  // |cache|, which may be NULL (the default) to analyze the code every time.
+  void set_instruction_analysis_cache(InstructionAnalysisCache* cache) {
+    instruction_analysis_cache_ = cache;
+  }
+
  protected:
   Exploitability(Minidump *dump,
                  ProcessState *process_state);
@@ -63,6 +81,8 @@ class Exploitability {
   Minidump *dump_;
   ProcessState *process_state_;
   SystemInfo *system_info_;
+  bool analyze_instructions_;
+  InstructionAnalysisCache *instruction_analysis_cache_;
 
  private:
   virtual ExploitabilityRating CheckPlatformExploitability() = 0;
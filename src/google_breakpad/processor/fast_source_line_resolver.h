@@ -67,7 +67,17 @@ class FastSourceLineResolver : public SourceLineResolverBase {
   using SourceLineResolverBase::LoadModule;
   using SourceLineResolverBase::LoadModuleUsingMapBuffer;
   using SourceLineResolverBase::LoadModuleUsingMemoryBuffer;
+  using SourceLineResolverBase::LoadModuleUsingMappedFile;
+  using SourceLineResolverBase::LoadModuleUsingCompressedFile;
+  using SourceLineResolverBase::LoadModuleUsingIndexedFile;
+  using SourceLineResolverBase::CanLoadModulesUsingIndexedFiles;
+  using SourceLineResolverBase::LoadModuleUsingDigest;
+  using SourceLineResolverBase::CanShareModulesByDigest;
+  using SourceLineResolverBase::DeferSourceLines;
+  using SourceLineResolverBase::HasDeferredSourceLines;
+  using SourceLineResolverBase::LoadSourceLinesUsingMemoryBuffer;
   using SourceLineResolverBase::UnloadModule;
+  using SourceLineResolverBase::CanLookUpConcurrently;
 
  private:
   // Friend declarations.
@@ -0,0 +1,181 @@
+// Copyright (c) 2016 Google Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+// notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above
+// copyright notice, this list of conditions and the following disclaimer
+// in the documentation and/or other materials provided with the
+// distribution.
+//     * Neither the name of Google Inc. nor the names of its
+// contributors may be used to endorse or promote products derived from
+// this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+// frame_arena.h: FrameArena, a region allocator for the stack frames and
+// call stacks of a ProcessState.
+//
+// Walking a dump allocates a stack frame for every frame of every thread,
+// and all of them live exactly as long as the ProcessState that holds
+// them.  FrameArena hands out their memory from large blocks and takes
+// it all back at once, when the ProcessState is cleared.  A ProcessState
+// that is cleared and reused keeps its blocks for the next dump.
+//
+// StackFrame and CallStack derive from FrameArenaAllocated, which lets them
+// be created in an arena with
+//   new (arena) StackFrameX86()
+// and still be destroyed with a plain delete: delete runs the destructor
+// as usual, and returns the memory to the heap only if it didn't come from
+// an arena.  Creating them with a NULL arena, or with a plain new, uses the
+// heap.
+
+#ifndef GOOGLE_BREAKPAD_PROCESSOR_FRAME_ARENA_H__
+#define GOOGLE_BREAKPAD_PROCESSOR_FRAME_ARENA_H__
+
+#include <stddef.h>
+
+#include <new>
+#include <vector>
+
+#include "processor/mutex.h"
+
+namespace google_breakpad {
+
+class FrameArena {
+ public:
+  FrameArena() : next_(NULL), remaining_(0), spare_count_(0) {}
+  ~FrameArena() { Reset(); }
+
+  // Returns |size| bytes aligned for any frame or call stack.  Stack walker
+  // threads may allocate from one arena at the same time.
+  void* Allocate(size_t size) {
+    size = (size + kAlignment - 1) & ~(kAlignment - 1);
+    AutoMutex lock(&mutex_);
+    if (size > kBlockSize / 4) {
+      // Large objects get a block of their own, so that they don't waste
+      // the rest of the current one.
+      char* block = new char[size];
+      large_blocks_.push_back(block);
+      return block;
+    }
+    if (size > remaining_) {
+      if (spare_count_) {
+        // Blocks kept by Rewind follow the blocks in use.
+        next_ = blocks_[blocks_.size() - spare_count_--];
+      } else {
+        next_ = new char[kBlockSize];
+        blocks_.push_back(next_);
+      }
+      remaining_ = kBlockSize;
+    }
+    char* memory = next_;
+    next_ += size;
+    remaining_ -= size;
+    return memory;
+  }
+
+  // Frees all memory handed out by the arena.  The objects in it must
+  // already have been destroyed.
+  void Reset() {
+    AutoMutex lock(&mutex_);
+    for (size_t i = 0; i < blocks_.size(); ++i)
+      delete [] blocks_[i];
+    for (size_t i = 0; i < large_blocks_.size(); ++i)
+      delete [] large_blocks_[i];
+    blocks_.clear();
+    large_blocks_.clear();
+    next_ = NULL;
+    remaining_ = 0;
+    spare_count_ = 0;
+  }
+
+  // Takes back all memory handed out by the arena, like Reset, but keeps
+  // its standard-size blocks to hand out again instead of freeing them.
+  // Blocks of large objects are freed.  The objects in the arena must
+  // already have been destroyed.
+  void Rewind() {
+    AutoMutex lock(&mutex_);
+    for (size_t i = 0; i < large_blocks_.size(); ++i)
+      delete [] large_blocks_[i];
+    large_blocks_.clear();
+    next_ = NULL;
+    remaining_ = 0;
+    spare_count_ = blocks_.size();
+  }
+
+  // The number of blocks the arena holds, including those kept by Rewind.
+  size_t block_count() const {
+    AutoMutex lock(&mutex_);
+    return blocks_.size() + large_blocks_.size();
+  }
+
+  static const size_t kAlignment = 16;
+  static const size_t kBlockSize = 64 * 1024;
+
+ private:
+  mutable Mutex mutex_;
+  // Standard-size blocks, in the order they were first used.  The last
+  // spare_count_ of them were kept by Rewind and are not in use.
+  std::vector<char*> blocks_;
+  std::vector<char*> large_blocks_;
+  char* next_;
+  size_t remaining_;
+  size_t spare_count_;
+
+  // Disallow copy constructor and assignment operator.
+  FrameArena(const FrameArena&);
+  void operator=(const FrameArena&);
+};
+
+// A base class for objects that may be placed in a FrameArena.  Each
+// object is preceded by the arena it was allocated from, or NULL if it
+// came from the heap, so that operator delete knows what to do with it.
+class FrameArenaAllocated {
+ public:
+  static void* operator new(size_t size) {
+    return Allocate(size, NULL);
+  }
+  static void* operator new(size_t size, FrameArena* arena) {
+    return Allocate(size, arena);
+  }
+  static void operator delete(void* object) {
+    if (!object)
+      return;
+    char* memory = static_cast<char*>(object) - FrameArena::kAlignment;
+    if (!*reinterpret_cast<FrameArena**>(memory))
+      ::operator delete(memory);
+  }
+  // Called if a constructor throws after operator new(size, arena).
+  static void operator delete(void* object, FrameArena*) {
+    operator delete(object);
+  }
+
+ private:
+  static void* Allocate(size_t size, FrameArena* arena) {
+    size += FrameArena::kAlignment;
+    char* memory = static_cast<char*>(arena ? arena->Allocate(size) :
+                                              ::operator new(size));
+    *reinterpret_cast<FrameArena**>(memory) = arena;
+    return memory + FrameArena::kAlignment;
+  }
+};
+
+}  // namespace google_breakpad
+
+#endif  // GOOGLE_BREAKPAD_PROCESSOR_FRAME_ARENA_H__
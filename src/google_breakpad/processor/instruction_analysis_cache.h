@@ -0,0 +1,141 @@
+// Copyright (c) 2016 Google Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+// notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above
+// copyright notice, this list of conditions and the following disclaimer
+// in the documentation and/or other materials provided with the
+// distribution.
+//     * Neither the name of Google Inc. nor the names of its
+// contributors may be used to endorse or promote products derived from
+// this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+// instruction_analysis_cache.h: InstructionAnalysisCache, a bounded,
+// thread-safe cache of how the instructions at a crash address were rated.
+//
+// When a Windows x86 crash is a bad read or write, ExploitabilityWin
+// disassembles up to a couple of kilobytes of code starting at the
+// faulting instruction, looking for branches, writes and block moves
+// through the bad address.  Crashes of one build tend to fault at the same
+// few instructions, so the exploitability engine can be given an
+// InstructionAnalysisCache (MinidumpProcessor::
+// set_instruction_analysis_cache) to remember what the disassembly found.
+// Entries are keyed by the module's debug file and debug identifier, by
+// the instruction's offset within the module, by how many bytes of code
+// the dump held there and by whether the fault was a read or a write, so
+// one cache may be shared by any number of processors, on any number of
+// threads, and across dumps.  When the cache is full, the least recently
+// used entry is discarded.
+
+#ifndef GOOGLE_BREAKPAD_PROCESSOR_INSTRUCTION_ANALYSIS_CACHE_H__
+#define GOOGLE_BREAKPAD_PROCESSOR_INSTRUCTION_ANALYSIS_CACHE_H__
+
+#include <stddef.h>
+
+#include <list>
+#include <map>
+#include <string>
+
+#include "common/using_std_string.h"
+#include "google_breakpad/common/breakpad_types.h"
+
+namespace google_breakpad {
+
+class CodeModule;
+class Mutex;
+
+class InstructionAnalysisCache {
+ public:
+  // Creates a cache holding at most |max_entries| entries.
+  explicit InstructionAnalysisCache(size_t max_entries);
+  ~InstructionAnalysisCache();
+
+  // Looks up the weight that analyzing the |length| bytes of code at
+  // |address| in |module| added to a crash's rating, for a bad write if
+  // |bad_write| is true and a bad read otherwise.  Returns false if it
+  // isn't cached.
+  bool Lookup(const CodeModule* module, uint64_t address, size_t length,
+              bool bad_write, uint32_t* weight);
+
+  // Remembers |weight| as the result of analyzing the code described by
+  // the other arguments, as for Lookup.  Modules without a debug
+  // identifier can't be told apart reliably and are not cached.
+  void Store(const CodeModule* module, uint64_t address, size_t length,
+             bool bad_write, uint32_t weight);
+
+  // Discards every entry.  The counters are not reset.
+  void Clear();
+
+  size_t max_entries() const { return max_entries_; }
+  size_t size() const;
+
+  // The number of Lookup calls that were and were not answered from the
+  // cache.
+  uint64_t hits() const;
+  uint64_t misses() const;
+
+ private:
+  struct Key {
+    Key() : offset(0), length(0), bad_write(false) {}
+    bool operator<(const Key& that) const {
+      // Offsets are cheaper to compare and rarely equal.
+      if (offset != that.offset)
+        return offset < that.offset;
+      if (length != that.length)
+        return length < that.length;
+      if (bad_write != that.bad_write)
+        return that.bad_write;
+      return module < that.module;
+    }
+
+    string module;
+    uint64_t offset;
+    size_t length;
+    bool bad_write;
+  };
+
+  struct Entry;
+  typedef std::map<Key, Entry*> EntryMap;
+  typedef std::list<Entry*> EntryList;
+
+  // Returns false if |module| can't be cached.
+  static bool MakeKey(const CodeModule* module, uint64_t address,
+                      size_t length, bool bad_write, Key* key);
+
+  size_t max_entries_;
+  EntryMap entries_;
+
+  // All entries, most recently used first.
+  EntryList recent_;
+
+  uint64_t hits_;
+  uint64_t misses_;
+
+  Mutex* mutex_;
+
+  // Disallow copy constructor and assignment operator.
+  InstructionAnalysisCache(const InstructionAnalysisCache&);
+  void operator=(const InstructionAnalysisCache&);
+};
+
+}  // namespace google_breakpad
+
+#endif  // GOOGLE_BREAKPAD_PROCESSOR_INSTRUCTION_ANALYSIS_CACHE_H__
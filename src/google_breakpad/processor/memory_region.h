@@ -39,6 +39,8 @@
 #define GOOGLE_BREAKPAD_PROCESSOR_MEMORY_REGION_H__
 
 
+#include <stddef.h>
+
 #include "google_breakpad/common/breakpad_types.h"
 
 
@@ -68,6 +70,17 @@ class MemoryRegion {
   virtual bool GetMemoryAtAddress(uint64_t address, uint32_t* value) const = 0;
   virtual bool GetMemoryAtAddress(uint64_t address, uint64_t* value) const = 0;
 
+  // Returns a pointer to the |size| bytes at |address| if the region holds
+  // them contiguously and in the running program's byte order, so that a
+  // caller reading many values may load them directly.  Returns NULL if
+  // the range is not entirely within the region, or if the region can't
+  // provide such a view, which is what regions do unless they override
+  // this.  The pointer is valid for as long as the region's contents are.
+  virtual const uint8_t* GetContiguousMemory(uint64_t address,
+                                             uint32_t size) const {
+    return NULL;
+  }
+
   // Print a human-readable representation of the object to stdout.
   virtual void Print() const = 0;
 };
@@ -35,6 +35,8 @@
 // - system information (os type / version)
 // - cpu context (state of the registers)
 // - list of mmaps
+// A compact microdump keeps only the stack words that a stack walker needs
+// (see microdump_writer.h); the rest of its stack reads as zero.
 
 #ifndef GOOGLE_BREAKPAD_PROCESSOR_MICRODUMP_H__
 #define GOOGLE_BREAKPAD_PROCESSOR_MICRODUMP_H__
@@ -88,6 +90,10 @@ class MicrodumpMemoryRegion : public MemoryRegion {
   virtual bool GetMemoryAtAddress(uint64_t address, uint32_t* value) const;
   virtual bool GetMemoryAtAddress(uint64_t address, uint64_t* value) const;
 
+  // Returns contents_ directly when the running program is little-endian.
+  virtual const uint8_t* GetContiguousMemory(uint64_t address,
+                                             uint32_t size) const;
+
   // Print a human-readable representation of the object to stdout.
   virtual void Print() const;
 
@@ -97,6 +103,9 @@ class MicrodumpMemoryRegion : public MemoryRegion {
   template<typename ValueType>
   bool GetMemoryLittleEndian(uint64_t address, ValueType* value) const;
 
+  // Microdump decodes the stack contents straight into contents_.
+  friend class Microdump;
+
   uint64_t base_address_;
   std::vector<uint8_t> contents_;
 };
@@ -106,6 +115,15 @@ class MicrodumpMemoryRegion : public MemoryRegion {
 class Microdump {
  public:
   explicit Microdump(const string& contents);
+
+  // Parses the first microdump in the |size| bytes at |data|, which need
+  // not be null-terminated and may hold other log lines around the
+  // microdump. The data is read in place. If |end| is not NULL, sets
+  // *|end| to the offset just past the microdump's END line, or to |size|
+  // if there is none, so that many microdumps can be read from one large
+  // log by parsing each from where the last one ended.
+  Microdump(const char* data, size_t size, size_t* end);
+
   virtual ~Microdump() {}
 
   DumpContext* GetContext() { return context_.get(); }
@@ -114,6 +132,9 @@ class Microdump {
   SystemInfo* GetSystemInfo() { return system_info_.get(); }
 
  private:
+  // Parses the microdump for the constructors.
+  void Parse(const char* data, size_t size, size_t* end);
+
   scoped_ptr<MicrodumpContext> context_;
   scoped_ptr<MicrodumpMemoryRegion> stack_region_;
   scoped_ptr<MicrodumpModules> modules_;
@@ -33,18 +33,37 @@
 #ifndef GOOGLE_BREAKPAD_PROCESSOR_MICRODUMP_PROCESSOR_H__
 #define GOOGLE_BREAKPAD_PROCESSOR_MICRODUMP_PROCESSOR_H__
 
+#include <stddef.h>
+
 #include <string>
+#include <vector>
 
 #include "common/using_std_string.h"
 #include "google_breakpad/processor/process_result.h"
 
 namespace google_breakpad {
 
+class Microdump;
 class ProcessState;
 class StackFrameSymbolizer;
  
 class MicrodumpProcessor {
  public:
+  // Receives the results of ProcessBatch.
+  class BatchCallback {
+   public:
+    virtual ~BatchCallback() {}
+
+    // Called once for each microdump in the batch, with its index in the
+    // batch and what Process would have returned for it.  |process_state|
+    // is only valid for the duration of the call.  Calls may come from
+    // walker threads and in any order, but never more than one at a time.
+    virtual void Processed(size_t index,
+                           ProcessResult result,
+                           ProcessState* process_state) = 0;
+  };
+
+
   // Initializes the MicrodumpProcessor with a stack frame symbolizer.
   // Does not take ownership of frame_symbolizer, which must NOT be NULL.
   explicit MicrodumpProcessor(StackFrameSymbolizer* frame_symbolizer);
@@ -54,8 +73,50 @@ class MicrodumpProcessor {
   // Processes the microdump contents and fills process_state with the result.
   google_breakpad::ProcessResult Process(const string& microdump_contents,
                                          ProcessState* process_state);
+
+  // Processes each of |microdumps| as Process would, handing the results to
+  // |callback|.  The microdumps are grouped by the set of modules they
+  // list (by debug file and identifier), and the groups are processed one
+  // after another, so that the symbols for a set of modules are loaded once
+  // and used for every microdump in the group.  Before each group, the
+  // StackFrameSymbolizer is Reset, and symbols an earlier group loaded for
+  // a different build of one of the group's modules are unloaded from the
+  // resolver.  With more than one walker thread, the microdumps of a group
+  // are walked concurrently; see set_walker_thread_count.
+  void ProcessBatch(const std::vector<string>& microdumps,
+                    BatchCallback* callback);
+
+  // Sets the number of threads ProcessBatch uses to walk microdumps.  With
+  // the default of 1 (or 0), they are walked one after another on the
+  // calling thread.  With more, they are walked in parallel, but symbols
+  // are loaded one at a time, and are looked up one at a time too unless
+  // the resolver can look them up concurrently (see
+  // SourceLineResolverInterface::CanLookUpConcurrently).  Walker threads
+  // are not available on Windows, where microdumps are always walked on
+  // the calling thread.
+  void set_walker_thread_count(unsigned int walker_thread_count) {
+    walker_thread_count_ = walker_thread_count;
+  }
+  unsigned int walker_thread_count() const { return walker_thread_count_; }
+
  private:
+  struct MicrodumpBatch;
+
+  // Walks the stack in |microdump| with |frame_symbolizer| and fills
+  // |process_state| with the result.  |process_state| refers to the
+  // microdump's stack memory, so |microdump| must outlive it.
+  static ProcessResult ProcessMicrodump(Microdump* microdump,
+                                        StackFrameSymbolizer* frame_symbolizer,
+                                        ProcessState* process_state);
+
+  // Processes the microdumps of |batch| (a MicrodumpBatch) until none
+  // remain.  Run by each walker thread.
+  static void* ProcessBatchThreadMain(void* batch);
+
   StackFrameSymbolizer* frame_symbolizer_;
+
+  // The number of threads ProcessBatch uses.  See set_walker_thread_count.
+  unsigned int walker_thread_count_;
 };
 
 }  // namespace google_breakpad
@@ -74,6 +74,12 @@
 // Minidump::ReadString will return a string object to the user, and the user
 // is responsible for its deletion.
 //
+// A Minidump may also be backed by memory rather than by a stream, either
+// by mapping the minidump file or by wrapping a buffer owned by the caller.
+// In that case, memory regions and (for minidumps that don't need to be
+// byte-swapped) CodeView records are returned as pointers into the backing
+// memory instead of being copied onto the heap.
+//
 // Author: Mark Mentovai
 
 #ifndef GOOGLE_BREAKPAD_PROCESSOR_MINIDUMP_H__
@@ -104,6 +110,9 @@ using std::vector;
 
 
 class Minidump;
+class MinidumpReader;
+class MinidumpSystemInfo;
+class Mutex;
 template<typename AddressType, typename EntryType> class RangeMap;
 
 
@@ -226,6 +235,10 @@ class MinidumpMemoryRegion : public MinidumpObject,
   bool GetMemoryAtAddress(uint64_t address, uint32_t* value) const;
   bool GetMemoryAtAddress(uint64_t address, uint64_t* value) const;
 
+  // Returns the region's own copy of the bytes, unless the minidump's byte
+  // order differs from the running program's.
+  const uint8_t* GetContiguousMemory(uint64_t address, uint32_t size) const;
+
   // Print a human-readable representation of the object to stdout.
   void Print() const;
 
@@ -254,6 +267,11 @@ class MinidumpMemoryRegion : public MinidumpObject,
 
   // Cached memory.
   mutable vector<uint8_t>* memory_;
+
+  // Points to the region's contents: either the storage of memory_, or, if
+  // the minidump is backed by memory, the minidump's own copy of the
+  // region.  NULL until GetMemory has succeeded.
+  mutable const uint8_t* memory_data_;
 };
 
 
@@ -337,9 +355,19 @@ class MinidumpThreadList : public MinidumpStream {
  private:
   friend class Minidump;
 
-  typedef map<uint32_t, MinidumpThread*> IDToThreadMap;
+  // Pairs of thread ID and thread, sorted by ID.
+  typedef std::pair<uint32_t, MinidumpThread*> IDToThread;
+  typedef vector<IDToThread> IDToThreadMap;
   typedef vector<MinidumpThread> MinidumpThreads;
 
+  // Orders IDToThread entries by thread ID, for lookups in
+  // id_to_thread_map_.
+  struct IDToThreadLess {
+    bool operator()(const IDToThread& entry, uint32_t thread_id) const {
+      return entry.first < thread_id;
+    }
+  };
+
   static const uint32_t kStreamType = MD_THREAD_LIST_STREAM;
 
   bool Read(uint32_t aExpectedSize);
@@ -348,7 +376,9 @@ class MinidumpThreadList : public MinidumpStream {
   // default is 256.
   static uint32_t max_threads_;
 
-  // Access to threads using the thread ID as the key.
+  // Access to threads using the thread ID as the key.  Its storage is kept
+  // when the list is read again, so that a Minidump that is reset and
+  // reused does not allocate it anew for every minidump.
   IDToThreadMap    id_to_thread_map_;
 
   // The list of threads.
@@ -361,6 +391,16 @@ class MinidumpThreadList : public MinidumpStream {
 // code modules.  Access is provided to various data referenced indirectly
 // by MDRawModule, such as the module's name and a specification for where
 // to locate debugging information for the module.
+//
+// That data is read from the minidump the first time a getter needs it,
+// rather than by MinidumpModuleList::Read.  So a module whose name can't be
+// read no longer makes the whole module list fail to read: the error is
+// logged when the module is first looked at, and its getters return empty
+// strings.  The first reads are serialized by a lock that the modules of a
+// MinidumpModuleList share, and later calls take no lock and don't read
+// from the minidump, so the const getters of its modules may be called from
+// several threads at once.  A first read still uses the Minidump's file
+// position, so nothing else may read from the same Minidump meanwhile.
 class MinidumpModule : public MinidumpObject,
                        public CodeModule {
  public:
@@ -400,14 +440,14 @@ class MinidumpModule : public MinidumpObject,
   // MDCVInfoPDB70 by default.  Returns a pointer to the CodeView record on
   // success, and NULL on failure.  On success, the optional |size| argument
   // is set to the size of the CodeView record.
-  const uint8_t* GetCVRecord(uint32_t* size);
+  const uint8_t* GetCVRecord(uint32_t* size) const;
 
   // The miscellaneous debug record, which is obsolete.  Current toolchains
   // do not generate this type of debugging information (dbg), and this
   // field is not expected to be present.  Returns a pointer to the debugging
   // record on success, and NULL on failure.  On success, the optional |size|
   // argument is set to the size of the debugging record.
-  const MDImageDebugMisc* GetMiscRecord(uint32_t* size);
+  const MDImageDebugMisc* GetMiscRecord(uint32_t* size) const;
 
   // Print a human-readable representation of the object to stdout.
   void Print();
@@ -416,7 +456,9 @@ class MinidumpModule : public MinidumpObject,
   // These objects are managed by MinidumpModuleList.
   friend class MinidumpModuleList;
 
-  explicit MinidumpModule(Minidump* minidump);
+  // |auxiliary_data_mutex| is the module list's lock for
+  // ReadAuxiliaryData.
+  MinidumpModule(Minidump* minidump, Mutex* auxiliary_data_mutex);
 
   // This works like MinidumpStream::Read, but is driven by
   // MinidumpModuleList.  No size checking is done, because
@@ -424,12 +466,21 @@ class MinidumpModule : public MinidumpObject,
   bool Read();
 
   // Reads indirectly-referenced data, including the module name, CodeView
-  // record, and miscellaneous debugging record.  This is necessary to allow
-  // MinidumpModuleList to fully construct MinidumpModule objects without
-  // requiring seeks to read a contiguous set of MinidumpModule objects.
-  // All auxiliary data should be available when Read is called, in order to
-  // allow the CodeModule getters to be const methods.
-  bool ReadAuxiliaryData();
+  // record, and miscellaneous debugging record.  Most modules in a large
+  // dump are never looked at, so this is not done by Read, but the first
+  // time one of the CodeModule getters needs the data; errors are logged
+  // then.  Returns false if the module name could not be read, in which
+  // case the getters that need it return empty strings.  has_debug_info_
+  // is set if the debugging records were read as well.  The first call
+  // reads the data under auxiliary_data_mutex_ and then sets
+  // auxiliary_data_read_, and later calls return without locking once
+  // they see it set.
+  bool ReadAuxiliaryData() const;
+
+  // Read and check the CodeView and miscellaneous debugging records for
+  // ReadAuxiliaryData, returning false if a record could not be used.
+  bool ReadCVRecord() const;
+  bool ReadMiscRecord() const;
 
   // The largest number of bytes that will be read from a minidump for a
   // CodeView record or miscellaneous debugging record, respectively.  The
@@ -437,38 +488,51 @@ class MinidumpModule : public MinidumpObject,
   static uint32_t max_cv_bytes_;
   static uint32_t max_misc_bytes_;
 
-  // True after a successful Read.  This is different from valid_, which is
-  // not set true until ReadAuxiliaryData also completes successfully.
-  // module_valid_ is only used by ReadAuxiliaryData and the functions it
-  // calls to determine whether the object is ready for auxiliary data to
-  // be read.
-  bool              module_valid_;
+  // Serializes ReadAuxiliaryData with that of the other modules in the
+  // list, since they all read through the minidump's file position.  Owned
+  // by the MinidumpModuleList.
+  Mutex*            auxiliary_data_mutex_;
+
+  // True once ReadAuxiliaryData has run, whether or not it succeeded.
+  // Set with a release store and tested with an acquire load, so that a
+  // thread that sees it set also sees the data read before it was set.
+  mutable bool      auxiliary_data_read_;
 
   // True if debug info was read from the module.  Certain modules
   // may contain debug records in formats we don't support,
   // so we can just set this to false to ignore them.
-  bool              has_debug_info_;
+  mutable bool      has_debug_info_;
+
+  // The minidump's system info, for code_identifier.  Got by
+  // ReadAuxiliaryData.
+  mutable MinidumpSystemInfo* system_info_;
 
   MDRawModule       module_;
 
   // Cached module name.
-  const string*     name_;
+  mutable const string* name_;
 
   // Cached CodeView record - this is MDCVInfoPDB20 or (likely)
   // MDCVInfoPDB70, or possibly something else entirely.  Stored as a uint8_t
   // because the structure contains a variable-sized string and its exact
-  // size cannot be known until it is processed.
-  vector<uint8_t>* cv_record_;
+  // size cannot be known until it is processed.  This is NULL if the
+  // record is used in place from a memory-backed minidump.
+  mutable vector<uint8_t>* cv_record_;
+
+  // Points to the CodeView record: either the storage of cv_record_, or the
+  // record within a memory-backed minidump.  NULL unless ReadCVRecord has
+  // succeeded.
+  mutable const uint8_t* cv_record_data_;
 
   // If cv_record_ is present, cv_record_signature_ contains a copy of the
   // CodeView record's first four bytes, for ease of determinining the
   // type of structure that cv_record_ contains.
-  uint32_t cv_record_signature_;
+  mutable uint32_t cv_record_signature_;
 
   // Cached MDImageDebugMisc (usually not present), stored as uint8_t
   // because the structure contains a variable-sized string and its exact
   // size cannot be known until it is processed.
-  vector<uint8_t>* misc_record_;
+  mutable vector<uint8_t>* misc_record_;
 };
 
 
@@ -491,6 +555,9 @@ class MinidumpModuleList : public MinidumpStream,
     return valid_ ? module_count_ : 0;
   }
   virtual const MinidumpModule* GetModuleForAddress(uint64_t address) const;
+  virtual void GetModulesForAddresses(const uint64_t* addresses,
+                                      size_t count,
+                                      const CodeModule** modules) const;
   virtual const MinidumpModule* GetMainModule() const;
   virtual const MinidumpModule* GetModuleAtSequence(
       unsigned int sequence) const;
@@ -521,6 +588,9 @@ class MinidumpModuleList : public MinidumpStream,
 
   MinidumpModules *modules_;
   uint32_t module_count_;
+
+  // Shared by modules_ to read their auxiliary data one at a time.
+  Mutex* auxiliary_data_mutex_;
 };
 
 
@@ -533,6 +603,11 @@ class MinidumpModuleList : public MinidumpStream,
 // surrounding the instruction pointer in the case of an exception.  Other
 // types of minidumps may contain significantly more memory regions.  Full-
 // memory minidumps contain all of a process' mapped memory.
+//
+// Only the memory descriptors are read by Read, which indexes them by
+// address.  A MinidumpMemoryRegion is not created for a region until it is
+// requested, and its contents are not read until they are needed, so the
+// cost of using a large memory list follows the regions that are touched.
 class MinidumpMemoryList : public MinidumpStream {
  public:
   virtual ~MinidumpMemoryList();
@@ -551,6 +626,27 @@ class MinidumpMemoryList : public MinidumpStream {
   // the address identified by address.
   virtual MinidumpMemoryRegion* GetMemoryRegionForAddress(uint64_t address);
 
+  // A range of memory to be found by GetMemorySpans.
+  struct SpanRequest {
+    uint64_t address;
+    uint32_t size;
+  };
+
+  // Finds the memory of each of |count| requests at once, storing in
+  // spans[i] a pointer to the dump's copy of the |size| bytes at
+  // requests[i].address, or NULL if no single region holds all of them.
+  // The requests are sorted by address and resolved in one pass over the
+  // regions, so many small requests cost little more than one lookup per
+  // region they fall in.  The pointers are into each region's memory,
+  // which is the minidump's own image when it is mapped or otherwise
+  // backed by memory, so no bytes are copied.  Like
+  // MinidumpMemoryRegion::GetContiguousMemory, nothing is found in a
+  // minidump of the other byte order.  The pointers remain valid until
+  // the list is read again or destroyed.  Returns the number of requests
+  // found.
+  size_t GetMemorySpans(const SpanRequest* requests, size_t count,
+                        const uint8_t** spans);
+
   // Print a human-readable representation of the object to stdout.
   void Print();
 
@@ -558,8 +654,8 @@ class MinidumpMemoryList : public MinidumpStream {
   friend class Minidump;
   friend class MockMinidumpMemoryList;
 
-  typedef vector<MDMemoryDescriptor>   MemoryDescriptors;
-  typedef vector<MinidumpMemoryRegion> MemoryRegions;
+  typedef vector<MDMemoryDescriptor>    MemoryDescriptors;
+  typedef vector<MinidumpMemoryRegion*> MemoryRegions;
 
   static const uint32_t kStreamType = MD_MEMORY_LIST_STREAM;
 
@@ -567,8 +663,14 @@ class MinidumpMemoryList : public MinidumpStream {
 
   bool Read(uint32_t expected_size);
 
+  // Deletes the MinidumpMemoryRegion objects created by
+  // GetMemoryRegionAtIndex, and empties regions_.
+  void FreeRegions();
+
   // The largest number of memory regions that will be read from a minidump.
-  // The default is 256.
+  // The default is not to impose a limit.  Descriptors are read in bounded
+  // batches, so storage is only allocated for descriptors actually present
+  // in the minidump.
   static uint32_t max_regions_;
 
   // Access to memory regions using addresses as the key.
@@ -580,7 +682,8 @@ class MinidumpMemoryList : public MinidumpStream {
   // purpose.
   MemoryDescriptors *descriptors_;
 
-  // The list of regions.
+  // The list of regions, parallel to descriptors_.  Each entry is NULL until
+  // the region is first requested.
   MemoryRegions *regions_;
   uint32_t region_count_;
 };
@@ -782,6 +885,42 @@ class MinidumpBreakpadInfo : public MinidumpStream {
   MDRawBreakpadInfo breakpad_info_;
 };
 
+// MinidumpHandlerTiming wraps MDRawHandlerTimingList, an optional stream in
+// which the Linux exception handler records how long the phases of
+// handling the crash took.
+class MinidumpHandlerTiming : public MinidumpStream {
+ public:
+  // When the handler was entered, in nanoseconds of CLOCK_MONOTONIC.
+  uint64_t start_time() const { return valid_ ? start_time_ : 0; }
+
+  unsigned int timing_count() const {
+    return valid_ ? static_cast<unsigned int>(timings_.size()) : 0;
+  }
+  const MDRawHandlerTiming* GetTimingAtIndex(unsigned int index) const;
+
+  // Returns the timing of phase, an MDHandlerPhase, or NULL if the phase
+  // didn't run.
+  const MDRawHandlerTiming* GetTimingForPhase(uint32_t phase) const;
+
+  // Returns a short name for phase, an MDHandlerPhase.
+  static const char* PhaseName(uint32_t phase);
+
+  // Print a human-readable representation of the object to stdout.
+  void Print();
+
+ private:
+  friend class Minidump;
+
+  static const uint32_t kStreamType = MD_LINUX_HANDLER_TIMING;
+
+  explicit MinidumpHandlerTiming(Minidump* minidump_);
+
+  bool Read(uint32_t expected_size_);
+
+  uint64_t start_time_;
+  vector<MDRawHandlerTiming> timings_;
+};
+
 // MinidumpMemoryInfo wraps MDRawMemoryInfo, which provides information
 // about mapped memory regions in a process, including their ranges
 // and protection.
@@ -853,16 +992,64 @@ class MinidumpMemoryInfoList : public MinidumpStream {
 };
 
 
+// MinidumpMemoryReadLog records the ranges of a minidump's memory that are
+// read through its MinidumpMemoryRegions, so that a tool can tell which
+// memory processing a minidump depended on.  Reads of whole regions, such
+// as the stack views that the stackwalkers take, are recorded in full.
+// Code that uses a region's memory directly with GetMemory records what it
+// uses with Add.  Overlapping and adjacent ranges are merged.  A log may
+// be shared by threads walking stacks in parallel.
+class MinidumpMemoryReadLog {
+ public:
+  // Maps the start of each range read to its end.
+  typedef map<uint64_t, uint64_t> RangeMap;
+
+  MinidumpMemoryReadLog();
+  ~MinidumpMemoryReadLog();
+
+  // Records that the size bytes at address were read.
+  void Add(uint64_t address, uint64_t size);
+
+  // Returns the ranges read so far, ordered by address, none of which
+  // overlap or touch.
+  RangeMap ranges() const;
+
+  void Clear();
+
+ private:
+  RangeMap ranges_;
+  Mutex* mutex_;
+
+  // Disallow copy constructor and assignment operator.
+  MinidumpMemoryReadLog(const MinidumpMemoryReadLog&);
+  void operator=(const MinidumpMemoryReadLog&);
+};
+
+
 // Minidump is the user's interface to a minidump file.  It wraps MDRawHeader
 // and provides access to the minidump's top-level stream directory.
 class Minidump {
  public:
   // path is the pathname of a file containing the minidump.
   explicit Minidump(const string& path);
+  // If map_file is true, the file at path is mapped into memory when it is
+  // opened, and data is read from the mapping without going through a
+  // stream.  If the file can't be mapped, it is read as a stream instead.
+  // The file must not be truncated while the Minidump object exists.
+  Minidump(const string& path, bool map_file);
   // input is an istream wrapping minidump data. Minidump holds a
   // weak pointer to input, and the caller must ensure that the stream
   // is valid as long as the Minidump object is.
   explicit Minidump(std::istream& input);
+  // data is a buffer of size bytes containing minidump data.  Minidump
+  // holds a weak pointer to data, and the caller must ensure that the
+  // buffer is valid and unmodified as long as the Minidump object is.
+  Minidump(const uint8_t* data, size_t size);
+  // reader provides random access to minidump data kept elsewhere, such as
+  // in remote storage, and only the parts of the minidump that are used
+  // are read from it.  Minidump holds a weak pointer to reader, and the
+  // caller must ensure that it is valid as long as the Minidump object is.
+  explicit Minidump(MinidumpReader* reader);
 
   virtual ~Minidump();
 
@@ -910,6 +1097,7 @@ class Minidump {
   virtual MinidumpSystemInfo* GetSystemInfo();
   virtual MinidumpMiscInfo* GetMiscInfo();
   virtual MinidumpBreakpadInfo* GetBreakpadInfo();
+  virtual MinidumpHandlerTiming* GetHandlerTiming();
   virtual MinidumpMemoryInfoList* GetMemoryInfoList();
 
   // The next set of methods are provided for users who wish to access
@@ -935,6 +1123,12 @@ class Minidump {
   // Returns the current position of the minidump file.
   off_t Tell();
 
+  // If the minidump is backed by memory, returns a pointer to the count
+  // bytes at offset in the minidump, without copying them and without
+  // changing the current position.  Returns NULL if the minidump is read
+  // from a stream, or if the requested range is not within the minidump.
+  const uint8_t* GetMappedBytes(off_t offset, size_t count) const;
+
   // The next 2 methods are medium-level I/O routines.
 
   // ReadString returns a string which is owned by the caller!  offset
@@ -961,29 +1155,92 @@ class Minidump {
   // Print a human-readable representation of the object to stdout.
   void Print();
 
+  // Closes the current minidump and points this object at another one, as
+  // though it had been constructed anew with path (keeping the map_file
+  // setting), with data and size, or with reader.  Read() must be called
+  // before the new minidump is used.  The stream index and the stream
+  // objects read from the previous minidump are kept and reused, so a batch
+  // processor that resets one Minidump for each file avoids reallocating
+  // them every time.  Streams obtained from the previous minidump become
+  // invalid.
+  void Reset(const string& path);
+  void Reset(const uint8_t* data, size_t size);
+  void Reset(MinidumpReader* reader);
+
+  // If log is not NULL, the memory read through this minidump's memory
+  // regions is recorded in it from now on.  The caller owns log, which
+  // must outlive its use here.
+  void set_memory_read_log(MinidumpMemoryReadLog* log) {
+    memory_read_log_ = log;
+  }
+  MinidumpMemoryReadLog* memory_read_log() const { return memory_read_log_; }
+
  private:
   // MinidumpStreamInfo is used in the MinidumpStreamMap.  It lets
   // the Minidump object locate interesting streams quickly, and
   // provides a convenient place to stash MinidumpStream objects.
   struct MinidumpStreamInfo {
-    MinidumpStreamInfo() : stream_index(0), stream(NULL) {}
-    ~MinidumpStreamInfo() { delete stream; }
+    MinidumpStreamInfo(uint32_t type, unsigned int index)
+        : stream_type(type), stream_index(index), stream(NULL) {}
+
+    uint32_t        stream_type;
 
     // Index into the MinidumpDirectoryEntries vector
     unsigned int    stream_index;
 
-    // Pointer to the stream if cached, or NULL if not yet populated
+    // Pointer to the stream if cached, or NULL if not yet populated.
+    // Owned by the Minidump, which deletes it in ~Minidump.
     MinidumpStream* stream;
   };
 
+  // Orders MinidumpStreamInfo entries by stream type, for lookups in
+  // stream_map_.
+  struct MinidumpStreamInfoLess {
+    bool operator()(const MinidumpStreamInfo& info,
+                    uint32_t stream_type) const {
+      return info.stream_type < stream_type;
+    }
+  };
+
   typedef vector<MDRawDirectory> MinidumpDirectoryEntries;
-  typedef map<uint32_t, MinidumpStreamInfo> MinidumpStreamMap;
+  // Sorted by stream type, with at most one entry for each type.
+  typedef vector<MinidumpStreamInfo> MinidumpStreamMap;
 
   template<typename T> T* GetStream(T** stream);
 
+  // Returns the entry for stream_type in stream_map_, or NULL if there
+  // is none.
+  MinidumpStreamInfo* FindStreamInfo(uint32_t stream_type);
+
+  // Moves the streams cached in stream_map_ to spare_streams_ and empties
+  // stream_map_, keeping the storage of both.
+  void ReleaseStreams();
+
+  // Closes the minidump, releasing any file, stream or mapping that was
+  // opened for it.
+  void Close();
+
   // Opens the minidump file, or if already open, seeks to the beginning.
   bool Open();
 
+  // Does the work of Read, which adds the tracepoints around it.
+  bool ReadHeaderAndDirectory();
+
+  // Maps the minidump file at path_ into memory, setting data_ and
+  // data_size_.  Returns false if the file can't be mapped.
+  bool MapFile();
+
+  // Unmaps the minidump file if it was mapped by MapFile.
+  void UnmapFile();
+
+  // If the opened minidump is in the compressed format written by the
+  // client's MinidumpFileWriter (see common/minidump_compression.h),
+  // decompresses it into decompressed_ and points data_ at that, so that
+  // the rest of the processing sees an ordinary minidump.  Leaves the
+  // position at the beginning of the minidump.  Returns false if the
+  // minidump can't be read or is compressed but corrupt.
+  bool DecompressIfCompressed();
+
   // The largest number of top-level streams that will be read from a minidump.
   // Note that streams are only read (and only consume memory) as needed,
   // when directed by the caller.  The default is 128.
@@ -1003,14 +1260,43 @@ class Minidump {
   // Access to streams using the stream type as the key.
   MinidumpStreamMap*        stream_map_;
 
-  // The pathname of the minidump file to process, set in the constructor.
-  // This may be empty if the minidump was opened directly from a stream.
-  const string              path_;
+  // Streams read from an earlier minidump, or an earlier Read() of this
+  // one, that GetStream reads again instead of allocating new ones.  Each
+  // entry's stream_index is unused.
+  MinidumpStreamMap         spare_streams_;
+
+  // The pathname of the minidump file to process, set in the constructor
+  // or by Reset.  This may be empty if the minidump was opened directly
+  // from a stream.
+  string                    path_;
 
   // The stream for all file I/O.  Used by ReadBytes and SeekSet.
   // Set based on the path in Open, or directly in the constructor.
   std::istream*             stream_;
 
+  // Used in place of stream_ for all I/O if the minidump is backed by
+  // memory.  data_ is either the mapping made by MapFile or a buffer owned
+  // by the caller.  data_offset_ is the current position within data_, or
+  // within reader_'s data.
+  const uint8_t*            data_;
+  size_t                    data_size_;
+  off_t                     data_offset_;
+
+  // Used in place of stream_ for all I/O if the minidump was constructed
+  // with a MinidumpReader, which the caller owns.
+  MinidumpReader*           reader_;
+
+  // Where the memory read from the minidump is recorded, if anywhere.
+  MinidumpMemoryReadLog*    memory_read_log_;
+
+  // The decompressed image of a compressed minidump, which data_ points to.
+  vector<uint8_t>           decompressed_;
+
+  // True if path_ should be mapped by MapFile when it is opened, and
+  // mapped_ is true if data_ is a mapping that must be unmapped.
+  bool                      map_file_;
+  bool                      mapped_;
+
   // swap_ is true if the minidump file should be byte-swapped.  If the
   // minidump was produced by a CPU that is other-endian than the CPU
   // processing the minidump, this will be true.  If the two CPUs are
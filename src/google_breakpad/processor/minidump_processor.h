@@ -36,18 +36,60 @@
 #include "common/using_std_string.h"
 #include "google_breakpad/common/breakpad_types.h"
 #include "google_breakpad/processor/process_result.h"
+#include "google_breakpad/processor/walk_budget.h"
 
 namespace google_breakpad {
 
+class CallStack;
+class CodeModulesCache;
+class CrashSignatureCache;
+class FrameArena;
+class InstructionAnalysisCache;
 class Minidump;
 class ProcessState;
+struct ProcessStatistics;
 class StackFrameSymbolizer;
 class SourceLineResolverInterface;
 class SymbolSupplier;
 struct SystemInfo;
+class TaskExecutor;
+class UnwindPolicy;
 
 class MinidumpProcessor {
  public:
+  // Receives the requesting thread's stack ahead of the rest of the
+  // minidump; see set_requesting_thread_callback.
+  class RequestingThreadCallback {
+   public:
+    virtual ~RequestingThreadCallback() {}
+
+    // Called once Process has walked and symbolized the requesting
+    // thread, with |process_state| holding that thread as its only one,
+    // along with the system information, crash reason and module list.
+    // Frames from other threads, exploitability and statistics are still
+    // to come.  |process_state| is only valid for the duration of the
+    // call.  Returns true for Process to go on to the other threads, or
+    // false for Process to return PROCESS_OK with |process_state| as it
+    // is.
+    virtual bool RequestingThreadWalked(const ProcessState& process_state) = 0;
+  };
+
+  // Receives each thread's stack as soon as it has been walked; see
+  // set_thread_sink.
+  class ThreadSink {
+   public:
+    virtual ~ThreadSink() {}
+
+    // Called with the stack of the thread at |thread_index| in
+    // ProcessState::threads.  |process_state| holds the system
+    // information, crash reason and module list, and the threads before
+    // |thread_index|, whose stacks are empty unless they were kept.
+    // |stack| is only valid for the duration of the call.
+    virtual void ThreadWalked(const ProcessState& process_state,
+                              int thread_index,
+                              const CallStack& stack) = 0;
+  };
+
   // Initializes this MinidumpProcessor.  supplier should be an
   // implementation of the SymbolSupplier abstract base class.
   MinidumpProcessor(SymbolSupplier* supplier,
@@ -77,6 +119,196 @@ class MinidumpProcessor {
   // result.
   ProcessResult Process(Minidump* minidump,
                         ProcessState* process_state);
+
+  // Sets the number of threads used to walk the stacks of a minidump's
+  // threads, the calling thread among them.  With the default of 1 (or 0),
+  // stacks are walked one after another on the calling thread.  With more,
+  // the stacks are walked concurrently, and ProcessState still receives
+  // the threads in the minidump's order.  Symbols are loaded one at a
+  // time, and are looked up one at a time too unless the resolver can look
+  // them up concurrently (see
+  // SourceLineResolverInterface::CanLookUpConcurrently), but the rest of
+  // the stack walks proceed in parallel.
+  // The requesting thread's stack is walked first.  With exploitability
+  // enabled, the calling thread walks it and rates the crash while the
+  // other threads walk the others.  With a task executor (see
+  // set_task_executor), the walks run on its threads, however many there
+  // are, as soon as this is more than 1.  Walker threads are not available
+  // on Windows, where stacks are always walked on the calling thread.
+  void set_walker_thread_count(unsigned int walker_thread_count) {
+    walker_thread_count_ = walker_thread_count;
+  }
+  unsigned int walker_thread_count() const { return walker_thread_count_; }
+
+  // Sets the number of threads used to fetch symbols ahead of the stack
+  // walks.  With more than the default of 0, Process starts fetching the
+  // symbols for the minidump's modules on that many background threads (or
+  // that many at a time on the task executor) as soon as it has the module
+  // list, beginning with the modules that the
+  // crashed (or requesting) thread's stack refers to, so that the walks
+  // seldom have to wait for a slow symbol store.  See
+  // StackFrameSymbolizer::PrefetchSymbols for what this requires of the
+  // symbol supplier.
+  void set_symbol_prefetch_thread_count(unsigned int thread_count) {
+    symbol_prefetch_thread_count_ = thread_count;
+  }
+  unsigned int symbol_prefetch_thread_count() const {
+    return symbol_prefetch_thread_count_;
+  }
+
+  // Sets the executor that stack walks and symbol prefetches run on, so
+  // that they share its threads with whatever else is submitted to it,
+  // such as the work of other processors or of symbol loading (see
+  // BasicSourceLineResolver::set_load_executor).  Without one, the
+  // default, Process starts threads of its own for each minidump.  Does
+  // not take ownership of |executor|, which may be NULL.
+  void set_task_executor(TaskExecutor* executor) {
+    task_executor_ = executor;
+  }
+  TaskExecutor* task_executor() const { return task_executor_; }
+
+  // Limits the prefetch to the first |module_limit| modules in that order.
+  // Fetched symbols are held in memory until they are used, so a limit
+  // keeps dumps with many modules from holding the symbols for all of them
+  // at once.  0, the default, prefetches every module.
+  void set_symbol_prefetch_module_limit(unsigned int module_limit) {
+    symbol_prefetch_module_limit_ = module_limit;
+  }
+  unsigned int symbol_prefetch_module_limit() const {
+    return symbol_prefetch_module_limit_;
+  }
+
+  // Enables or disables collecting a ProcessStatistics for each minidump
+  // processed, available from ProcessState::statistics: how long each
+  // phase of processing took, and how the stack frames were found.
+  // Collection is off by default.
+  void set_collect_statistics(bool collect_statistics) {
+    collect_statistics_ = collect_statistics;
+  }
+  bool collect_statistics() const { return collect_statistics_; }
+
+  // Enables or disables reusing, for the rest of a minidump, how each
+  // instruction address was symbolized the first time one of the
+  // minidump's threads had a frame there.  Idle threads that share most of
+  // their stacks then look up each shared frame's symbols once rather than
+  // once per thread.  The results are the same either way, unless the
+  // StackFrameSymbolizer can symbolize an address differently from one
+  // frame to the next.  Memoization is off by default.
+  void set_memoize_frames(bool memoize_frames) {
+    memoize_frames_ = memoize_frames;
+  }
+  bool memoize_frames() const { return memoize_frames_; }
+
+  // Enables or disables looking up source files and lines only for the
+  // frames of the requesting (usually crashed) thread.  The resolver then
+  // loads modules without their source lines, which are most of a large
+  // symbol file and aren't needed to walk stacks, and the requesting
+  // thread's frames get them once all the stacks are walked: the symbol
+  // data for each module on its stack is read a second time to add them.
+  // Other threads' frames still get function names.  If the minidump has
+  // no requesting thread, no frame gets source lines.  Process sets this
+  // on the resolver with SourceLineResolverInterface::DeferSourceLines,
+  // which only some resolvers, BasicSourceLineResolver among them,
+  // support; with others, this just symbolizes every frame fully.  Modules
+  // loaded without their source lines are not shared through a resolver's
+  // module cache.  This is off by default.
+  void set_source_lines_for_requesting_thread_only(bool requesting_only) {
+    source_lines_for_requesting_thread_only_ = requesting_only;
+  }
+  bool source_lines_for_requesting_thread_only() const {
+    return source_lines_for_requesting_thread_only_;
+  }
+
+  // Sets a callback that Process hands the requesting (usually crashed)
+  // thread's stack to before walking any other thread, so that a crash
+  // signature can be had long before the whole minidump is processed.  The
+  // other threads are then walked with the symbols already loaded, and the
+  // ProcessState ends up as it would without a callback, except that the
+  // modules the requesting thread needed may come first in the lists of
+  // modules without symbols or with corrupt symbols.  Minidumps without a
+  // requesting thread are processed as usual, without a call.  Does not
+  // take ownership of |callback|, which may be NULL (the default).
+  void set_requesting_thread_callback(RequestingThreadCallback* callback) {
+    requesting_thread_callback_ = callback;
+  }
+
+  // Sets a sink that Process hands each thread's stack to, in thread
+  // order, as soon as the thread has been walked.  Process then frees the
+  // stack and leaves an empty CallStack in its place in
+  // ProcessState::threads, so that the frames of only one thread are held
+  // at a time however many threads the minidump has.  The requesting
+  // thread's stack is kept, for exploitability rating and for the crash
+  // signature.  Frame counts in ProcessStatistics still cover every
+  // thread.  Stacks are walked one after another on the calling thread
+  // while a sink is set, whatever set_walker_thread_count says.  The sink
+  // is not called for threads that are never walked because the
+  // requesting thread callback stopped processing or the crash is a
+  // duplicate.  Does not take ownership of |sink|, which may be NULL (the
+  // default).
+  void set_thread_sink(ThreadSink* sink) { thread_sink_ = sink; }
+
+  // Sets a cache of the signatures of crashes already processed (see
+  // CrashSignatureCache).  Process then walks the requesting thread before
+  // any other, and if the minidump's signature is in the cache, it returns
+  // PROCESS_DUPLICATE_CRASH with just that thread walked, skipping the
+  // other threads and exploitability.  Otherwise it records the signature
+  // and goes on.  The requesting thread callback is not called for
+  // duplicates.  A cache may be shared by any number of processors.  Does
+  // not take ownership of |cache|, which may be NULL (the default).
+  void set_crash_signature_cache(CrashSignatureCache* cache) {
+    crash_signature_cache_ = cache;
+  }
+
+  // Limits the work that walking the stacks of each minidump may do: the
+  // time taken, the frames walked, the stack words scanned and the size of
+  // the symbol data read, across all of its threads.  When any of these
+  // runs out, each walk stops at its next frame and its CallStack is
+  // marked truncated (CallStack::truncated); the threads left to walk get
+  // just their context frames.  Process still returns PROCESS_OK.  The
+  // requesting thread is walked first when there is a requesting thread
+  // callback or a crash signature cache.  The default limits nothing.
+  void set_walk_budget_limits(const WalkBudget::Limits& limits) {
+    walk_budget_limits_ = limits;
+  }
+  const WalkBudget::Limits& walk_budget_limits() const {
+    return walk_budget_limits_;
+  }
+
+  // Sets the policy that tells stack walkers which methods of finding
+  // callers to try for frames in each module (see UnwindPolicy).  The
+  // policy must not change while minidumps are processed with it, and
+  // may be shared by any number of processors.  Does not take ownership
+  // of |policy|, which may be NULL (the default) to try every method.
+  void set_unwind_policy(const UnwindPolicy* policy) {
+    unwind_policy_ = policy;
+  }
+
+  // Enables or disables disassembling the code at the crash address when
+  // rating exploitability.  Without it, rating is much cheaper but less
+  // discerning; see Exploitability::set_analyze_instructions.  Analysis is
+  // on by default, and has no effect unless exploitability is enabled.
+  void set_analyze_instructions(bool analyze_instructions) {
+    analyze_instructions_ = analyze_instructions;
+  }
+  bool analyze_instructions() const { return analyze_instructions_; }
+
+  // Sets a cache of what disassembling the code at crash addresses found,
+  // which the exploitability engine consults before disassembling again.
+  // A cache may be shared by any number of processors.  Does not take
+  // ownership of |cache|, which may be NULL (the default).
+  void set_instruction_analysis_cache(InstructionAnalysisCache* cache) {
+    instruction_analysis_cache_ = cache;
+  }
+
+  // Sets a cache of module lists (see CodeModulesCache), through which
+  // the ProcessStates of minidumps with the same modules share one copy of
+  // the module list instead of each making its own.  A cache may be shared
+  // by any number of processors.  Does not take ownership of |cache|,
+  // which may be NULL (the default).
+  void set_code_modules_cache(CodeModulesCache* cache) {
+    code_modules_cache_ = cache;
+  }
+
   // Populates the cpu_* fields of the |info| parameter with textual
   // representations of the CPU type that the minidump in |dump| was
   // produced on.  Returns false if this information is not available in
@@ -126,6 +358,25 @@ class MinidumpProcessor {
   static string GetAssertion(Minidump* dump);
 
  private:
+  // Fills in the source lines of the requesting thread's frames, which the
+  // resolver left out; see set_source_lines_for_requesting_thread_only.
+  // Returns false if the symbol supplier interrupted processing.
+  bool FillRequestingThreadSourceLines(ProcessState* process_state);
+
+  // Rates the exploitability of the crash in |dump| from the requesting
+  // thread's stack in |process_state|, timing it in |statistics| (if not
+  // NULL).
+  void CheckExploitability(Minidump* dump, ProcessState* process_state,
+                           ProcessStatistics* statistics);
+
+  // Hands the thread last added to |process_state| to thread_sink_.
+  // Unless |keep| is true, the thread's stack is then replaced by an empty
+  // one, after its frames are counted in |statistics| (if not NULL), and
+  // |thread_arena|, which the stack was allocated from, is reset.
+  void SendToThreadSink(ProcessState* process_state, bool keep,
+                        FrameArena* thread_arena,
+                        ProcessStatistics* statistics);
+
   StackFrameSymbolizer* frame_symbolizer_;
   // Indicate whether resolver_helper_ is owned by this instance.
   bool own_frame_symbolizer_;
@@ -134,6 +385,48 @@ class MinidumpProcessor {
   // guess how likely it is that the crash represents an exploitable
   // memory corruption issue.
   bool enable_exploitability_;
+
+  // The number of threads used to walk stacks.  See set_walker_thread_count.
+  unsigned int walker_thread_count_;
+
+  // See set_task_executor.
+  TaskExecutor* task_executor_;
+
+  // See set_symbol_prefetch_thread_count and
+  // set_symbol_prefetch_module_limit.
+  unsigned int symbol_prefetch_thread_count_;
+  unsigned int symbol_prefetch_module_limit_;
+
+  // See set_collect_statistics.
+  bool collect_statistics_;
+
+  // See set_memoize_frames.
+  bool memoize_frames_;
+
+  // See set_source_lines_for_requesting_thread_only.
+  bool source_lines_for_requesting_thread_only_;
+
+  // See set_requesting_thread_callback.
+  RequestingThreadCallback* requesting_thread_callback_;
+
+  // See set_crash_signature_cache.
+  CrashSignatureCache* crash_signature_cache_;
+
+  // See set_thread_sink.
+  ThreadSink* thread_sink_;
+
+  // See set_walk_budget_limits.
+  WalkBudget::Limits walk_budget_limits_;
+
+  // See set_unwind_policy.
+  const UnwindPolicy* unwind_policy_;
+
+  // See set_analyze_instructions and set_instruction_analysis_cache.
+  bool analyze_instructions_;
+  InstructionAnalysisCache* instruction_analysis_cache_;
+
+  // See set_code_modules_cache.
+  CodeModulesCache* code_modules_cache_;
 };
 
 }  // namespace google_breakpad
@@ -0,0 +1,64 @@
+// Copyright (c) 2016 Google Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+// notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above
+// copyright notice, this list of conditions and the following disclaimer
+// in the documentation and/or other materials provided with the
+// distribution.
+//     * Neither the name of Google Inc. nor the names of its
+// contributors may be used to endorse or promote products derived from
+// this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+// minidump_reader.h: MinidumpReader, random access to minidump data kept
+// somewhere other than a local file or memory buffer.
+//
+// Minidump reads a dump's header and directory, then seeks to and reads
+// only the streams, records and memory regions that it is asked for.  A
+// dump kept in remote storage can therefore be processed without first
+// downloading the whole of it, by handing Minidump a MinidumpReader that
+// fetches the ranges it reads, for instance with HTTP range requests.
+// Minidump's reads are small and often close together, so such a reader
+// should normally be wrapped in a BlockCachingMinidumpReader.
+
+#ifndef GOOGLE_BREAKPAD_PROCESSOR_MINIDUMP_READER_H__
+#define GOOGLE_BREAKPAD_PROCESSOR_MINIDUMP_READER_H__
+
+#include <stddef.h>
+
+#include "google_breakpad/common/breakpad_types.h"
+
+namespace google_breakpad {
+
+class MinidumpReader {
+ public:
+  virtual ~MinidumpReader() {}
+
+  // The size of the minidump in bytes.
+  virtual uint64_t size() const = 0;
+
+  // Reads the |count| bytes at |offset| in the minidump into |buffer|.
+  // Returns false if they could not all be read.
+  virtual bool ReadAt(uint64_t offset, void* buffer, size_t count) = 0;
+};
+
+}  // namespace google_breakpad
+
+#endif  // GOOGLE_BREAKPAD_PROCESSOR_MINIDUMP_READER_H__
@@ -0,0 +1,74 @@
+// Copyright (c) 2016 Google Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+// notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above
+// copyright notice, this list of conditions and the following disclaimer
+// in the documentation and/or other materials provided with the
+// distribution.
+//     * Neither the name of Google Inc. nor the names of its
+// contributors may be used to endorse or promote products derived from
+// this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+// minidump_snapshot.h: MinidumpSnapshot, which rebuilds a complete
+// minidump from a snapshot delta and the base of its series.
+//
+// A series of snapshot minidumps of a live Linux process (see
+// MD_LINUX_SNAPSHOT) starts with a complete base.  Each later delta holds
+// the process's threads, modules and other streams as they were when it
+// was taken, but only the memory written since the base, and its threads'
+// stacks are empty.  MinidumpSnapshot overlays the delta's memory on the
+// base's and points the delta's threads at their rebuilt stacks, so that
+// the result processes like any other minidump.  Stack bytes in neither
+// minidump were unmapped in the base, and are zero.  Memory the base
+// holds outside the delta's ranges is carried over as it was in the base.
+
+#ifndef GOOGLE_BREAKPAD_PROCESSOR_MINIDUMP_SNAPSHOT_H__
+#define GOOGLE_BREAKPAD_PROCESSOR_MINIDUMP_SNAPSHOT_H__
+
+#include <string>
+#include <vector>
+
+#include "common/using_std_string.h"
+#include "google_breakpad/common/minidump_format.h"
+
+namespace google_breakpad {
+
+class Minidump;
+
+class MinidumpSnapshot {
+ public:
+  // Reads the MD_LINUX_SNAPSHOT stream of |dump|, which must have been
+  // read, into |info| and, for a delta, the stacks it lists into
+  // |stacks|.  Returns false if |dump| is not a snapshot.
+  static bool ReadInfo(Minidump* dump, MDRawSnapshotInfo* info,
+                       std::vector<MDRawSnapshotStack>* stacks);
+
+  // Sets |full| to a complete minidump rebuilt from the delta whose image
+  // is |delta| and the base of its series, whose image is |base|.  Both
+  // must be uncompressed and in this machine's byte order.  Returns false
+  // if they aren't a base and a delta of the same series, or can't be
+  // read.
+  static bool Rebuild(const string& base, const string& delta, string* full);
+};
+
+}  // namespace google_breakpad
+
+#endif  // GOOGLE_BREAKPAD_PROCESSOR_MINIDUMP_SNAPSHOT_H__
@@ -0,0 +1,147 @@
+// Copyright (c) 2016 Google Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+// notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above
+// copyright notice, this list of conditions and the following disclaimer
+// in the documentation and/or other materials provided with the
+// distribution.
+//     * Neither the name of Google Inc. nor the names of its
+// contributors may be used to endorse or promote products derived from
+// this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+// minidump_validator.h: MinidumpValidator, which checks a minidump for
+// the damage that would make processing it fail or go wrong, without
+// walking stacks or loading symbols.
+//
+// A truncated or corrupt minidump is normally only noticed once
+// MinidumpProcessor::Process has fetched symbols for it and started
+// walking its threads.  MinidumpValidator reads just the header, the
+// stream directory and the streams that processing depends on, and
+// checks:
+//
+//   - that every stream in the directory lies within the minidump,
+//   - that the thread list can be read, along with each thread and its
+//     ID, and that at most one thread is the requesting thread: the
+//     checks that make Process fail,
+//   - that the module list can be read, which rejects overlapping
+//     modules and modules that wrap around the address space,
+//   - that the system info, exception and memory list streams can be
+//     read, if present,
+//   - and that the requesting thread has a context, and stack memory
+//     that lies within the minidump and holds its stack pointer.
+//
+// The result is a verdict, the problems found, and the inputs of the
+// crash's signature that can be known without walking its stack (see
+// CrashSignatureCache), so that a queue can reject a minidump that can't
+// be processed, or deprioritize one that will process badly or that
+// duplicates a crash already seen, before doing any expensive work.
+// Validating a minidump opened with map_file set takes no I/O beyond
+// faulting in the pages of the streams read.
+
+#ifndef GOOGLE_BREAKPAD_PROCESSOR_MINIDUMP_VALIDATOR_H__
+#define GOOGLE_BREAKPAD_PROCESSOR_MINIDUMP_VALIDATOR_H__
+
+#include <string>
+#include <vector>
+
+#include "common/using_std_string.h"
+#include "google_breakpad/common/breakpad_types.h"
+#include "google_breakpad/processor/process_result.h"
+
+namespace google_breakpad {
+
+class Minidump;
+
+class MinidumpValidator {
+ public:
+  enum Verdict {
+    // Nothing wrong was found.
+    VERDICT_VALID,
+    // The minidump can be processed, but some of what processing reports
+    // will be missing or wrong.
+    VERDICT_DEGRADED,
+    // MinidumpProcessor::Process would fail.
+    VERDICT_INVALID
+  };
+
+  struct Problem {
+    // A short identifier, such as "stream_out_of_bounds".
+    string code;
+    // The stream, thread or address involved, if any.
+    string detail;
+    // True if the problem makes processing fail.
+    bool fatal;
+  };
+
+  // A module's identity, as the signature hashes it.
+  struct Module {
+    string debug_file;
+    string debug_identifier;
+  };
+
+  struct Result {
+    Result() { Clear(); }
+    void Clear();
+
+    Verdict verdict;
+
+    // What MinidumpProcessor::Process would return, if it fails; PROCESS_OK
+    // otherwise.
+    ProcessResult process_result;
+
+    std::vector<Problem> problems;
+
+    // The crash reason and address, as MinidumpProcessor::GetCrashReason
+    // gives them, if the minidump has an exception stream.
+    bool crashed;
+    string crash_reason;
+    uint64_t crash_address;
+
+    // The requesting thread, and the instruction pointer in its context.
+    // If the instruction pointer is in a module, |instruction_module| is
+    // that module's index in |modules| and |instruction_offset| is the
+    // instruction's offset in it; otherwise |instruction_module| is -1.
+    bool has_requesting_thread;
+    uint32_t requesting_thread_id;
+    bool has_instruction_pointer;
+    uint64_t instruction_pointer;
+    int instruction_module;
+    uint64_t instruction_offset;
+
+    // The module list, in order.
+    std::vector<Module> modules;
+  };
+
+  // Reads and checks |dump|, which need not have been read, filling
+  // |result|.  |result| may be reused from one minidump to the next.
+  static void Validate(Minidump* dump, Result* result);
+
+  // The name of |verdict|: "valid", "degraded" or "invalid".
+  static const char* VerdictName(Verdict verdict);
+
+ private:
+  // Only static methods.
+  MinidumpValidator();
+};
+
+}  // namespace google_breakpad
+
+#endif  // GOOGLE_BREAKPAD_PROCESSOR_MINIDUMP_VALIDATOR_H__
@@ -0,0 +1,131 @@
+// Copyright (c) 2016 Google Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+// notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above
+// copyright notice, this list of conditions and the following disclaimer
+// in the documentation and/or other materials provided with the
+// distribution.
+//     * Neither the name of Google Inc. nor the names of its
+// contributors may be used to endorse or promote products derived from
+// this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+// missing_symbol_cache.h: MissingSymbolCache, a thread-safe record of the
+// modules that a symbol supplier recently had no symbols for.
+//
+// A StackFrameSymbolizer remembers the modules whose symbols are missing
+// only until it is Reset, which MinidumpProcessor does at the start of every
+// minidump.  Each new minidump therefore asks the supplier again about
+// every system library without symbols, and for SimpleSymbolSupplier that
+// means probing the file system once per configured symbol path.
+// Attaching a MissingSymbolCache (StackFrameSymbolizer::
+// set_missing_symbol_cache) lets a module that was missing be skipped,
+// without asking the supplier, until the entry is older than the cache's
+// time to live.  Entries are keyed by the module's debug file and debug
+// identifier, so modules lacking either are never cached.
+//
+// One cache may be shared by any number of symbolizers, and may be saved to
+// and loaded from a file so that the entries outlive the process.
+
+#ifndef GOOGLE_BREAKPAD_PROCESSOR_MISSING_SYMBOL_CACHE_H__
+#define GOOGLE_BREAKPAD_PROCESSOR_MISSING_SYMBOL_CACHE_H__
+
+#include <stddef.h>
+#include <time.h>
+
+#include <map>
+#include <string>
+#include <utility>
+
+#include "common/using_std_string.h"
+
+namespace google_breakpad {
+
+class CodeModule;
+class Mutex;
+
+class MissingSymbolCache {
+ public:
+  // Creates an empty cache whose entries expire |time_to_live| seconds
+  // after they were recorded.
+  explicit MissingSymbolCache(time_t time_to_live);
+  ~MissingSymbolCache();
+
+  time_t time_to_live() const { return time_to_live_; }
+
+  // Returns true if the symbols for |module| were recorded as missing
+  // within the time to live.
+  bool IsMissing(const CodeModule* module);
+
+  // Records that the symbols for |module| are missing as of now.
+  void RecordMissing(const CodeModule* module);
+
+  // Forgets about |module|, for example because its symbols have just been
+  // added to the symbol store.
+  void Forget(const CodeModule* module);
+
+  // Forgets about every module.
+  void Clear();
+
+  // The number of entries, including any that have expired but have not
+  // been looked up since.
+  size_t size() const;
+
+  // Adds the unexpired entries in the file at |path|, written by Save, to
+  // the cache.  An entry already in the cache keeps the later of the two
+  // times.  Returns false, leaving the cache unchanged, if the file can't be
+  // read or is malformed.
+  bool Load(const string& path);
+
+  // Writes the unexpired entries to the file at |path|, replacing it.  The
+  // file is written under a temporary name and renamed into place, so a
+  // concurrent Load never sees a partial file, but entries recorded in the
+  // file by another process since this cache loaded it are lost.  Returns
+  // false on failure.
+  bool Save(const string& path) const;
+
+ private:
+  // (debug_file, debug_identifier)
+  typedef std::pair<string, string> Key;
+  typedef std::map<Key, time_t> EntryMap;
+
+  // Sets |key| to the cache key for |module|, returning false if |module|
+  // lacks the identifying information needed.
+  static bool KeyForModule(const CodeModule* module, Key* key);
+
+  bool IsExpired(time_t recorded, time_t now) const {
+    return now - recorded >= time_to_live_ || recorded > now;
+  }
+
+  time_t time_to_live_;
+
+  // When each missing module was recorded.
+  EntryMap entries_;
+
+  Mutex* mutex_;
+
+  // Disallow copy constructor and assignment operator.
+  MissingSymbolCache(const MissingSymbolCache&);
+  void operator=(const MissingSymbolCache&);
+};
+
+}  // namespace google_breakpad
+
+#endif  // GOOGLE_BREAKPAD_PROCESSOR_MISSING_SYMBOL_CACHE_H__
@@ -56,9 +56,14 @@ enum ProcessResult {
   PROCESS_ERROR_DUPLICATE_REQUESTING_THREADS,  // There was more than one
                                                // requesting thread.
 
-  PROCESS_SYMBOL_SUPPLIER_INTERRUPTED          // The dump processing was
+  PROCESS_SYMBOL_SUPPLIER_INTERRUPTED,         // The dump processing was
                                                // interrupted by the
                                                // SymbolSupplier(not fatal).
+
+  PROCESS_DUPLICATE_CRASH                      // The crash's signature was
+                                               // in the CrashSignatureCache,
+                                               // so only the requesting
+                                               // thread was walked.
 };
 
 }  // namespace google_breakpad
@@ -39,8 +39,10 @@
 
 #include "common/using_std_string.h"
 #include "google_breakpad/common/breakpad_types.h"
+#include "google_breakpad/processor/frame_arena.h"
 #include "google_breakpad/processor/system_info.h"
 #include "google_breakpad/processor/minidump.h"
+#include "google_breakpad/processor/process_statistics.h"
 
 namespace google_breakpad {
 
@@ -48,6 +50,7 @@ using std::vector;
 
 class CallStack;
 class CodeModules;
+struct StackFrame;
 
 enum ExploitabilityRating {
   EXPLOITABILITY_HIGH,                 // The crash likely represents
@@ -92,7 +95,10 @@ class ProcessState {
   ProcessState() : modules_(NULL) { Clear(); }
   ~ProcessState();
 
-  // Resets the ProcessState to its default values
+  // Resets the ProcessState to its default values.  The storage of its
+  // vectors, of its frame arena and of the frame vectors of its call
+  // stacks is kept, so that a ProcessState reused for each dump in a batch
+  // does not allocate it anew every time.
   void Clear();
 
   // Accessors.  See the data declarations below.
@@ -116,12 +122,30 @@ class ProcessState {
     return &modules_with_corrupt_symbols_;
   }
   ExploitabilityRating exploitability() const { return exploitability_; }
+  const vector<MDRawHandlerTiming>* handler_timings() const {
+    return &handler_timings_;
+  }
+  const ProcessStatistics* statistics() const { return &statistics_; }
 
  private:
-  // MinidumpProcessor and MicrodumpProcessor are responsible for building
-  // ProcessState objects.
+  // MinidumpProcessor, MicrodumpProcessor and ElfCoreProcessor are
+  // responsible for building ProcessState objects.  ProcessStateSerializer rebuilds them from their
+  // serialized form, and ProcessStateUpdater brings them up to date when
+  // symbols change.
+  friend class ElfCoreProcessor;
   friend class MinidumpProcessor;
   friend class MicrodumpProcessor;
+  friend class ProcessStateSerializer;
+  friend class ProcessStateUpdater;
+
+  // Returns a new, empty CallStack allocated in arena (or on the heap if
+  // arena is NULL), giving it frame vector storage kept from a stack that
+  // was cleared, if there is any.
+  CallStack* NewCallStack(FrameArena* arena);
+
+  // Deletes stack, keeping the storage of its frame vector for
+  // NewCallStack.
+  void DeleteCallStack(CallStack* stack);
 
   // The time-date stamp of the minidump (time_t format)
   uint32_t time_date_stamp_;
@@ -165,6 +189,13 @@ class ProcessState {
   vector<CallStack*> threads_;
   vector<MemoryRegion*> thread_memory_regions_;
 
+  // Holds the memory of the call stacks in threads_ and of their frames,
+  // when the processor allocated them there.  Rewound by Clear.
+  FrameArena frame_arena_;
+
+  // Empty frame vectors kept by DeleteCallStack for NewCallStack.
+  vector<vector<StackFrame*> > spare_frames_;
+
   // OS and CPU information.
   SystemInfo system_info_;
 
@@ -182,6 +213,15 @@ class ProcessState {
   // engine. When the exploitability engine is not enabled this
   // defaults to EXPLOITABILITY_NONE.
   ExploitabilityRating exploitability_;
+
+  // How long the phases of handling the crash took in the Linux exception
+  // handler, from the minidump's MD_LINUX_HANDLER_TIMING stream.  Empty if
+  // the minidump has none.
+  vector<MDRawHandlerTiming> handler_timings_;
+
+  // How long processing took, phase by phase, and how the stack frames were
+  // found.  All zero unless MinidumpProcessor was asked to collect them.
+  ProcessStatistics statistics_;
 };
 
 }  // namespace google_breakpad
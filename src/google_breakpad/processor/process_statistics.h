@@ -0,0 +1,117 @@
+// Copyright (c) 2016 Google Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+// notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above
+// copyright notice, this list of conditions and the following disclaimer
+// in the documentation and/or other materials provided with the
+// distribution.
+//     * Neither the name of Google Inc. nor the names of its
+// contributors may be used to endorse or promote products derived from
+// this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+// process_statistics.h: Where the time went while a minidump was processed.
+//
+// MinidumpProcessor fills in a ProcessStatistics, available from
+// ProcessState::statistics, for each minidump it processes once statistics
+// are enabled with MinidumpProcessor::set_collect_statistics.  The numbers
+// are meant for monitoring a processing service: spotting minidumps that
+// are slow to walk, and symbol stores that are slow to answer.
+
+#ifndef GOOGLE_BREAKPAD_PROCESSOR_PROCESS_STATISTICS_H__
+#define GOOGLE_BREAKPAD_PROCESSOR_PROCESS_STATISTICS_H__
+
+#include <vector>
+
+#include "google_breakpad/common/breakpad_types.h"
+
+namespace google_breakpad {
+
+struct ProcessStatistics {
+ public:
+  ProcessStatistics() { Clear(); }
+
+  // Resets the ProcessStatistics object to its default values.
+  void Clear() {
+    read_seconds = 0;
+    module_setup_seconds = 0;
+    symbol_fetch_seconds = 0;
+    symbol_parse_seconds = 0;
+    stackwalk_seconds = 0;
+    exploitability_seconds = 0;
+    thread_stackwalk_seconds.clear();
+    symbol_fetch_count = 0;
+    symbol_parse_count = 0;
+    context_frame_count = 0;
+    cfi_frame_count = 0;
+    frame_pointer_frame_count = 0;
+    scanned_frame_count = 0;
+    other_frame_count = 0;
+  }
+
+  // The wall-clock time, in seconds, spent in Minidump::Read.  Only
+  // measured when MinidumpProcessor is given the minidump's path and reads
+  // it itself; zero otherwise.
+  double read_seconds;
+
+  // The time spent reading the minidump's system information, exception,
+  // assertion and module list before any stack is walked.
+  double module_setup_seconds;
+
+  // The time the stack walks spent waiting for the SymbolSupplier, and for
+  // a symbol resolver to parse what it returned.  Both are part of
+  // stackwalk_seconds.  Symbols fetched ahead of time by prefetch threads
+  // only count for as long as a walk had to wait for them.
+  double symbol_fetch_seconds;
+  double symbol_parse_seconds;
+
+  // The time spent walking the stacks of all threads, from the first walk
+  // to the last, which with walker threads is less than the sum of
+  // thread_stackwalk_seconds.
+  double stackwalk_seconds;
+
+  // The time each thread's stack took to walk, in the order of
+  // ProcessState::threads.  Zero for a thread that could not be walked.
+  std::vector<double> thread_stackwalk_seconds;
+
+  // The time spent rating exploitability, when that is enabled.
+  double exploitability_seconds;
+
+  // The number of requests the stack walks made to the SymbolSupplier for
+  // symbols, and the number of times a resolver was given symbols to parse.
+  // A module may take more than one of each, for instance when a serialized
+  // symbol file is looked for before the symbols are read.
+  int symbol_fetch_count;
+  int symbol_parse_count;
+
+  // The frames walked across all threads, by how they were found: from a
+  // thread's context, by call frame information, by frame pointer, by
+  // scanning the stack (with or without the help of call frame information)
+  // or otherwise.
+  uint64_t context_frame_count;
+  uint64_t cfi_frame_count;
+  uint64_t frame_pointer_frame_count;
+  uint64_t scanned_frame_count;
+  uint64_t other_frame_count;
+};
+
+}  // namespace google_breakpad
+
+#endif  // GOOGLE_BREAKPAD_PROCESSOR_PROCESS_STATISTICS_H__
@@ -44,6 +44,7 @@
 #include <map>
 #include <set>
 #include <string>
+#include <utility>
 
 #include "google_breakpad/processor/source_line_resolver_interface.h"
 
@@ -56,9 +57,33 @@ using std::set;
 // ModuleFactory is a simple factory interface for creating a Module instance
 // at run-time.
 class ModuleFactory;
+class SymbolModuleCache;
 
 class SourceLineResolverBase : public SourceLineResolverInterface {
  public:
+  // The memory taken by a loaded module's symbols, in bytes, by kind of
+  // record.  The sizes are estimates: they count the records and the
+  // containers holding them, but not allocator overhead.
+  struct ModuleMemoryUsage {
+    ModuleMemoryUsage()
+        : files(0), functions(0), lines(0), public_symbols(0),
+          frame_info(0), other(0) {}
+
+    size_t total() const {
+      return files + functions + lines + public_symbols + frame_info + other;
+    }
+
+    size_t files;
+    size_t functions;
+    size_t lines;
+    size_t public_symbols;
+    // STACK WIN and STACK CFI records.
+    size_t frame_info;
+    // Symbol data held in a form that isn't broken down by kind, such as
+    // the compressed maps of a compressed serialized module.
+    size_t other;
+  };
+
   // Read the symbol_data from a file with given file_name.
   // The part of code was originally in BasicSourceLineResolver::Module's
   // LoadMap() method.
@@ -68,6 +93,103 @@ class SourceLineResolverBase : public SourceLineResolverInterface {
                              char **symbol_data,
                              size_t *symbol_data_size);
 
+  // Shares parsed symbols through |module_cache|, which may also be attached
+  // to other resolvers, possibly on other threads.  Modules found in the
+  // cache are used without being loaded again, and modules loaded by this
+  // resolver are added to it.  Must be called before any module is loaded.
+  // The resolver does not take ownership of |module_cache|, which must
+  // outlive it.
+  void set_module_cache(SymbolModuleCache *module_cache);
+  SymbolModuleCache *module_cache() const { return module_cache_; }
+
+  // Parses |map_file| as a new version of the symbols for |module| and
+  // publishes it in module_cache_, replacing any cached version.  Other
+  // resolvers attached to the cache, and this one, switch to the new
+  // version the next time they check for the module, without having to be
+  // restarted or to reload their other modules.  The symbols are parsed
+  // before the cache is touched, so a resolver set aside for reloading can
+  // do this on a background thread while the others keep resolving.
+  // Returns false if there is no cache, |module| can't be cached, or
+  // |map_file| can't be read.
+  bool ReloadModule(const CodeModule *module, const string &map_file);
+
+  // Remembers what FillSourceLineInfo found at up to |entries| recently
+  // looked up addresses, so that frames at the same addresses, which
+  // recur across the threads of a dump and across dumps of one build, are
+  // filled in without searching the module's functions and lines again.
+  // Entries are keyed by loaded module and the address's offset within it,
+  // so they stay valid while a module is loaded at different base addresses.
+  // A small cache suffices; an address whose slot is taken by another
+  // replaces it.  0, the default, disables the cache.  Clears the cache.
+  void set_frame_cache_size(size_t entries);
+  size_t frame_cache_size() const { return frame_cache_size_; }
+
+  // If true, FillSourceLineInfo points a frame's shared_function_name and
+  // shared_source_file_name at the loaded module's own copies of the names
+  // rather than copying them into function_name and source_file_name.
+  // This saves two string copies per frame, but the names are then only
+  // valid while the module stays loaded; read them with
+  // StackFrame::FunctionName and StackFrame::SourceFileName.  The default
+  // is false.
+  void set_share_names(bool share_names);
+  bool share_names() const { return share_names_; }
+
+  // If true, modules are frozen once their symbols are loaded, which lays
+  // out their Windows stack walking information in flat arrays that are
+  // quicker to search.  This suits long-running resolvers that look up many
+  // frames in each module.  Applies to modules loaded afterwards.  The
+  // default is false.
+  void set_freeze_modules(bool freeze_modules) {
+    freeze_modules_ = freeze_modules;
+  }
+  bool freeze_modules() const { return freeze_modules_; }
+
+  // If true, LoadModuleUsingIndexedFile loads modules whose symbol files
+  // have a sidecar index (see SymbolFileIndex) on demand: only the records
+  // covering the addresses looked up are parsed.  This suits resolvers that
+  // look up a few frames in large modules.  Such modules are not shared
+  // through the module cache.  The default is false.
+  void set_load_modules_lazily(bool load_modules_lazily) {
+    load_modules_lazily_ = load_modules_lazily;
+  }
+  bool load_modules_lazily() const { return load_modules_lazily_; }
+
+  // Fills |usage| with the memory taken by the symbols loaded for
+  // |module|.  Returns false if none are loaded.  A module shared through
+  // the module cache is counted by every resolver using it.
+  bool GetModuleMemoryUsage(const CodeModule *module,
+                            ModuleMemoryUsage *usage);
+
+  // The memory taken by the symbols of all loaded modules, in bytes.
+  size_t memory_used();
+
+  // An address to look up with SymbolizeAddresses.
+  struct AddressLookup {
+    const CodeModule *module;
+    uint64_t address;
+  };
+
+  // What SymbolizeAddresses found at an address.  The names point at the
+  // loaded module's own copies of them, so each distinct name is stored
+  // once however many addresses share it; they are only valid while the
+  // module stays loaded.  Fields are NULL or 0 where nothing was found.
+  struct SymbolizedAddress {
+    const char *function_name;
+    const char *source_file_name;
+    int source_line;
+    // The address's offset into its function or public symbol.
+    uint64_t function_offset;
+  };
+
+  // Looks up the |count| addresses in |lookups| at once, storing what was
+  // found for lookups[i] in results[i].  The lookups are sorted by module
+  // and address, and each module walks its functions and their lines once
+  // for all of its addresses, which is much cheaper than calling
+  // FillSourceLineInfo for each when there are many.  Addresses in modules
+  // that aren't loaded are left unresolved.  The frame cache isn't used.
+  void SymbolizeAddresses(const AddressLookup *lookups, size_t count,
+                          SymbolizedAddress *results);
+
  protected:
   // Users are not allowed create SourceLineResolverBase instance directly.
   SourceLineResolverBase(ModuleFactory *module_factory);
@@ -81,12 +203,29 @@ class SourceLineResolverBase : public SourceLineResolverInterface {
                                            char *memory_buffer,
                                            size_t memory_buffer_size);
   virtual bool ShouldDeleteMemoryBufferAfterLoadModule();
+  virtual bool LoadModuleUsingMappedFile(const CodeModule *module,
+                                         const string &map_file);
+  virtual bool LoadModuleUsingCompressedFile(const CodeModule *module,
+                                             const string &compressed_file);
+  virtual bool LoadModuleUsingIndexedFile(const CodeModule *module,
+                                          const string &map_file,
+                                          const string &index_file);
+  virtual bool CanLoadModulesUsingIndexedFiles();
+  virtual bool LoadModuleUsingDigest(const CodeModule *module,
+                                     const string &digest);
+  virtual bool CanShareModulesByDigest();
+  virtual bool DeferSourceLines(bool defer);
+  virtual bool HasDeferredSourceLines(const CodeModule *module);
+  virtual bool LoadSourceLinesUsingMemoryBuffer(const CodeModule *module,
+                                                char *memory_buffer,
+                                                size_t memory_buffer_size);
   virtual void UnloadModule(const CodeModule *module);
   virtual bool HasModule(const CodeModule *module);
   virtual bool IsModuleCorrupt(const CodeModule *module);
   virtual void FillSourceLineInfo(StackFrame *frame);
   virtual WindowsFrameInfo *FindWindowsFrameInfo(const StackFrame *frame);
   virtual CFIFrameInfo *FindCFIFrameInfo(const StackFrame *frame);
+  virtual bool CanLookUpConcurrently(const CodeModule *module);
 
   // Nested structs and classes.
   struct Line;
@@ -111,12 +250,81 @@ class SourceLineResolverBase : public SourceLineResolverInterface {
   typedef std::map<string, char*, CompareString> MemoryMap;
   MemoryMap *memory_buffers_;
 
+  // All of the mapped symbol files that loaded modules refer to, with their
+  // sizes.
+  typedef std::map<string, std::pair<char*, size_t>, CompareString>
+      MappedFileMap;
+  MappedFileMap *mapped_files_;
+
   // Creates a concrete module at run-time.
   ModuleFactory *module_factory_;
 
+  // The shared cache, if any, and the loaded modules that belong to it
+  // rather than to this resolver.
+  SymbolModuleCache *module_cache_;
+  ModuleSet *cached_modules_;
+
+  // module_cache_->generation() when DropStaleModules last ran.
+  uint32_t cache_generation_;
+
+  // The digests passed to LoadModuleUsingDigest for modules not yet
+  // loaded, by code file.
+  std::map<string, string> pending_digests_;
+
  private:
-  // ModuleFactory needs to have access to protected type Module.
+  // ModuleFactory and SymbolModuleCache need to have access to protected
+  // type Module.
   friend class ModuleFactory;
+  friend class SymbolModuleCache;
+
+  struct FrameCacheEntry;
+
+  // Returns the slot of the frame cache for |address| in |module|.
+  FrameCacheEntry *FrameCacheSlot(const Module *module, uint64_t address);
+
+  // Looks |module| up in module_cache_ and, if found, makes it a loaded
+  // module of this resolver.  Returns true on success.
+  bool LoadModuleFromCache(const CodeModule *module);
+
+  // Makes |cached_module|, acquired from module_cache_, a loaded module of
+  // this resolver.
+  void AddCachedModule(const CodeModule *module, Module *cached_module,
+                       bool corrupt);
+
+  // Makes |symbol_module|, freshly loaded from |size| bytes of symbol
+  // data, a loaded module of this resolver, adding it to module_cache_ if
+  // |use_cache| is true, under the digest pending for |module| if any.
+  // |cache_buffer| is the symbol data the module refers to, if it does,
+  // for module_cache_ to own.
+  void AddLoadedModule(const CodeModule *module, Module *symbol_module,
+                       bool use_cache, char *cache_buffer, size_t size);
+
+  // Frees a loaded module, or returns it to module_cache_ if it came
+  // from there.
+  void ReleaseModule(const string &code_file, Module *symbol_module);
+
+  // Releases the cached modules that module_cache_ has since replaced or
+  // invalidated, so that they are looked up again.
+  void DropStaleModules();
+
+  // Unmaps a mapped symbol file.
+  static void UnmapSymbolFile(char *data, size_t size);
+
+  // See set_frame_cache_size.  frame_cache_size_ is 0 or a power of two.
+  FrameCacheEntry *frame_cache_;
+  size_t frame_cache_size_;
+
+  // See set_share_names.
+  bool share_names_;
+
+  // See set_freeze_modules.
+  bool freeze_modules_;
+
+  // See set_load_modules_lazily.
+  bool load_modules_lazily_;
+
+  // See DeferSourceLines.
+  bool defer_source_lines_;
 
   // Disallow unwanted copy ctor and assignment operator
   SourceLineResolverBase(const SourceLineResolverBase&);
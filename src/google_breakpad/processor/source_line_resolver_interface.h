@@ -79,6 +79,97 @@ class SourceLineResolverInterface {
   // alive during the lifetime of the corresponding Module.
   virtual bool ShouldDeleteMemoryBufferAfterLoadModule() = 0;
 
+  // Adds a module by mapping map_file into memory and using the symbol data
+  // in place, rather than reading it into a heap buffer.  This is only
+  // possible for resolvers that keep their memory buffer (see
+  // ShouldDeleteMemoryBufferAfterLoadModule) and leave it unmodified, and
+  // map_file must hold symbol data in the form such a resolver loads.
+  // Returns false if the module could not be loaded this way, in which case
+  // the caller may still load it by other means.
+  virtual bool LoadModuleUsingMappedFile(const CodeModule *module,
+                                         const string &map_file) {
+    return false;
+  }
+
+  // Adds a module from compressed_file, a gzip- or zstd-compressed text
+  // symbol file, parsing the symbol data as it is decompressed instead of
+  // decompressing it all into memory first.  This is only possible for
+  // resolvers that let go of their memory buffer after loading (see
+  // ShouldDeleteMemoryBufferAfterLoadModule).  Returns false if the module
+  // could not be loaded this way, in which case the caller may still load
+  // it by other means.
+  virtual bool LoadModuleUsingCompressedFile(const CodeModule *module,
+                                             const string &compressed_file) {
+    return false;
+  }
+
+  // Adds a module from the text symbol file map_file without parsing it
+  // up front.  index_file is map_file's sidecar index, which says where
+  // the records covering each address are, and those records are parsed
+  // the first time an address they cover is looked up.  This is only
+  // possible for resolvers that let go of their memory buffer after
+  // loading (see ShouldDeleteMemoryBufferAfterLoadModule) and have been
+  // asked to load modules this way.  Returns false if the module could
+  // not be loaded this way, in which case the caller may still load it by
+  // other means.
+  virtual bool LoadModuleUsingIndexedFile(const CodeModule *module,
+                                          const string &map_file,
+                                          const string &index_file) {
+    return false;
+  }
+
+  // Returns true if LoadModuleUsingIndexedFile may succeed, so that it is
+  // worth looking for indexed symbol files.
+  virtual bool CanLoadModulesUsingIndexedFiles() {
+    return false;
+  }
+
+  // Adds a module by sharing the symbols another module with the same
+  // symbol records, identified by |digest| (see
+  // SymbolSupplier::GetSymbolFileDigest), has already loaded, possibly
+  // under another debug file or identifier.  If there are none, the
+  // resolver remembers |digest| and returns false; the caller then loads
+  // the module by other means, and its symbols are shared under |digest|
+  // from then on.
+  virtual bool LoadModuleUsingDigest(const CodeModule *module,
+                                     const string &digest) {
+    return false;
+  }
+
+  // Returns true if LoadModuleUsingDigest may succeed, so that it is worth
+  // asking for symbol file digests.
+  virtual bool CanShareModulesByDigest() {
+    return false;
+  }
+
+  // If |defer| is true, modules loaded by LoadModuleUsingMemoryBuffer from
+  // now on are loaded without their source file and line data, which is
+  // most of a large symbol file but isn't needed to walk a stack.  Their
+  // frames get function names but no source lines until
+  // LoadSourceLinesUsingMemoryBuffer adds them.  This is only possible for
+  // resolvers that let go of their memory buffer after loading (see
+  // ShouldDeleteMemoryBufferAfterLoadModule).  Modules already loaded keep
+  // what they have.  Returns false if the resolver can't defer source lines
+  // (the default).
+  virtual bool DeferSourceLines(bool defer) {
+    return false;
+  }
+
+  // Returns true if |module| was loaded without its source lines, and they
+  // haven't been added since.
+  virtual bool HasDeferredSourceLines(const CodeModule *module) {
+    return false;
+  }
+
+  // Adds the source lines deferred when |module| was loaded from its symbol
+  // data, which must be passed again, as to LoadModuleUsingMemoryBuffer.
+  // Returns false if |module| has no deferred source lines.
+  virtual bool LoadSourceLinesUsingMemoryBuffer(const CodeModule *module,
+                                                char *memory_buffer,
+                                                size_t memory_buffer_size) {
+    return false;
+  }
+
   // Request that the specified module be unloaded from this resolver.
   // A resolver may choose to ignore such a request.
   virtual void UnloadModule(const CodeModule *module) = 0;
@@ -107,6 +198,17 @@ class SourceLineResolverInterface {
   // returned CFIFrameInfo object.
   virtual CFIFrameInfo *FindCFIFrameInfo(const StackFrame *frame) = 0;
 
+  // Returns true if |module| has been loaded, and IsModuleCorrupt,
+  // FillSourceLineInfo, FindWindowsFrameInfo and FindCFIFrameInfo may be
+  // called for its frames on several threads at once, as long as nothing
+  // else is called on the resolver meanwhile.  Returns false if they
+  // change the resolver or the module, for example to cache what they
+  // find or to parse symbols on demand, or if |module| isn't loaded (the
+  // default).  Asking changes nothing, so this may be called the same way.
+  virtual bool CanLookUpConcurrently(const CodeModule *module) {
+    return false;
+  }
+
  protected:
   // SourceLineResolverInterface cannot be instantiated except by subclasses
   SourceLineResolverInterface() {}
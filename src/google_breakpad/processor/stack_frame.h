@@ -34,12 +34,13 @@
 
 #include "common/using_std_string.h"
 #include "google_breakpad/common/breakpad_types.h"
+#include "google_breakpad/processor/frame_arena.h"
 
 namespace google_breakpad {
 
 class CodeModule;
 
-struct StackFrame {
+struct StackFrame : public FrameArenaAllocated {
   // Indicates how well the instruction pointer derived during
   // stack walking is trusted. Since the stack walker can resort to
   // stack scanning, it can wind up with dubious frames.
@@ -62,6 +63,8 @@ struct StackFrame {
         source_file_name(),
         source_line(),
         source_line_base(),
+        shared_function_name(NULL),
+        shared_source_file_name(NULL),
         trust(FRAME_TRUST_NONE) {}
   virtual ~StackFrame() {}
 
@@ -90,6 +93,17 @@ struct StackFrame {
   // register. See the comments for 'instruction', below, for details.
   virtual uint64_t ReturnAddress() const { return instruction; }
 
+  // Return the function and source file names, whether they are held in
+  // function_name and source_file_name or shared with the resolver (see
+  // shared_function_name, below).  Never NULL; empty if unknown.
+  const char* FunctionName() const {
+    return shared_function_name ? shared_function_name : function_name.c_str();
+  }
+  const char* SourceFileName() const {
+    return shared_source_file_name ? shared_source_file_name :
+                                     source_file_name.c_str();
+  }
+
   // The program counter location as an absolute virtual address.
   //
   // - For the innermost called frame in a stack, this will be an exact
@@ -134,6 +148,16 @@ struct StackFrame {
   // are not available.
   uint64_t source_line_base;
 
+  // When the resolver shares its names with frames
+  // (SourceLineResolverBase::set_share_names), it points these at the
+  // function and source file names in its symbols and leaves function_name
+  // and source_file_name empty, which saves copying the names into every
+  // frame.  They remain valid only as long as the module stays loaded in
+  // the resolver.  NULL otherwise.  Use FunctionName and SourceFileName to
+  // read the names either way.
+  const char* shared_function_name;
+  const char* shared_source_file_name;
+
   // Amount of trust the stack walker has in the instruction pointer
   // of this frame.
   FrameTrust trust;
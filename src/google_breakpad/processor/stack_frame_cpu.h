@@ -149,6 +149,30 @@ struct StackFramePPC64 : public StackFrame {
   int context_validity;
 };
 
+// The registers of an AMD64 frame that walking the stack can recover,
+// named as in MDRawContextAMD64.  Frames keep these rather than a whole
+// MDRawContextAMD64, whose floating point and vector state makes it about
+// nine times as large.
+struct StackFrameAMD64Registers {
+  uint64_t rax;
+  uint64_t rcx;
+  uint64_t rdx;
+  uint64_t rbx;
+  uint64_t rsp;
+  uint64_t rbp;
+  uint64_t rsi;
+  uint64_t rdi;
+  uint64_t r8;
+  uint64_t r9;
+  uint64_t r10;
+  uint64_t r11;
+  uint64_t r12;
+  uint64_t r13;
+  uint64_t r14;
+  uint64_t r15;
+  uint64_t rip;
+};
+
 struct StackFrameAMD64 : public StackFrame {
   // ContextValidity has one entry for each register that we might be able
   // to recover.
@@ -174,7 +198,11 @@ struct StackFrameAMD64 : public StackFrame {
     CONTEXT_VALID_ALL  = -1
   };
 
-  StackFrameAMD64() : context(), context_validity(CONTEXT_VALID_NONE) {}
+  StackFrameAMD64()
+      : context(),
+        context_validity(CONTEXT_VALID_NONE),
+        full_context(NULL) {}
+  ~StackFrameAMD64();
 
   // Overriden to return the return address as saved on the stack.
   virtual uint64_t ReturnAddress() const;
@@ -182,7 +210,13 @@ struct StackFrameAMD64 : public StackFrame {
   // Register state. This is only fully valid for the topmost frame in a
   // stack. In other frames, which registers are present depends on what
   // debugging information we had available. Refer to context_validity.
-  MDRawContextAMD64 context;
+  //
+  // This is not an MDRawContextAMD64, as it was in earlier releases.  The
+  // registers it keeps have the same names, so code that reads them builds
+  // unchanged, but code that reads context_flags, the floating point or
+  // vector state, or passes context as an MDRawContextAMD64 must use
+  // full_context, which only the topmost frame has.
+  StackFrameAMD64Registers context;
 
   // For each register in context whose value has been recovered, we set
   // the corresponding CONTEXT_VALID_ bit in context_validity.
@@ -192,6 +226,16 @@ struct StackFrameAMD64 : public StackFrame {
   // yields an int when applied to enum values, and C++ doesn't
   // silently convert from ints to enums.
   int context_validity;
+
+  // The whole CPU context of the topmost frame, including the floating
+  // point and vector registers, or NULL in the other frames.  Owned by the
+  // frame.
+  MDRawContextAMD64* full_context;
+
+ private:
+  // Disallow copy constructor and assignment operator.
+  StackFrameAMD64(const StackFrameAMD64&);
+  void operator=(const StackFrameAMD64&);
 };
 
 struct StackFrameSPARC : public StackFrame {
@@ -270,6 +314,14 @@ struct StackFrameARM : public StackFrame {
   int context_validity;
 };
 
+// The integer registers of an ARM64 frame, which are all that walking the
+// stack can recover, named as in MDRawContextARM64.  Frames keep these
+// rather than a whole MDRawContextARM64, whose floating point registers
+// make it three times as large.
+struct StackFrameARM64Registers {
+  uint64_t iregs[MD_CONTEXT_ARM64_GPR_COUNT];
+};
+
 struct StackFrameARM64 : public StackFrame {
   // A flag for each register we might know. Note that we can't use an enum
   // here as there are 33 values to represent.
@@ -316,7 +368,9 @@ struct StackFrameARM64 : public StackFrame {
   static const uint64_t CONTEXT_VALID_PC   = CONTEXT_VALID_X32;
 
   StackFrameARM64() : context(),
-                      context_validity(CONTEXT_VALID_NONE) {}
+                      context_validity(CONTEXT_VALID_NONE),
+                      full_context(NULL) {}
+  ~StackFrameARM64();
 
   // Return the validity flag for register xN.
   static uint64_t RegisterValidFlag(int n) {
@@ -327,11 +381,26 @@ struct StackFrameARM64 : public StackFrame {
   // stack.  In other frames, the values of nonvolatile registers may be
   // present, given sufficient debugging information.  Refer to
   // context_validity.
-  MDRawContextARM64 context;
+  //
+  // This is not an MDRawContextARM64, as it was in earlier releases.  iregs
+  // keeps its name, so code that reads it builds unchanged, but code that
+  // reads context_flags, cpsr, the floating point state, or passes context
+  // as an MDRawContextARM64 must use full_context, which only the topmost
+  // frame has.
+  StackFrameARM64Registers context;
 
   // For each register in context whose value has been recovered, we set
   // the corresponding CONTEXT_VALID_ bit in context_validity.
   uint64_t context_validity;
+
+  // The whole CPU context of the topmost frame, including the floating
+  // point registers, or NULL in the other frames.  Owned by the frame.
+  MDRawContextARM64* full_context;
+
+ private:
+  // Disallow copy constructor and assignment operator.
+  StackFrameARM64(const StackFrameARM64&);
+  void operator=(const StackFrameARM64&);
 };
 
 struct StackFrameMIPS : public StackFrame {  
@@ -35,8 +35,10 @@
 #ifndef GOOGLE_BREAKPAD_PROCESSOR_STACK_FRAME_SYMBOLIZER_H__
 #define GOOGLE_BREAKPAD_PROCESSOR_STACK_FRAME_SYMBOLIZER_H__
 
+#include <map>
 #include <set>
 #include <string>
+#include <vector>
 
 #include "common/using_std_string.h"
 #include "google_breakpad/common/breakpad_types.h"
@@ -44,9 +46,16 @@
 
 namespace google_breakpad {
 class CFIFrameInfo;
+class CFIFrameInfoCache;
 class CodeModules;
+class ElfUnwindInfo;
+class MissingSymbolCache;
+struct ProcessStatistics;
 class SymbolSupplier;
 class SourceLineResolverInterface;
+class SymbolFileIndex;
+class TaskExecutor;
+class WalkBudget;
 struct StackFrame;
 struct SystemInfo;
 struct WindowsFrameInfo;
@@ -71,7 +80,7 @@ class StackFrameSymbolizer {
   StackFrameSymbolizer(SymbolSupplier* supplier,
                        SourceLineResolverInterface* resolver);
 
-  virtual ~StackFrameSymbolizer() { }
+  virtual ~StackFrameSymbolizer();
 
   // Encapsulate the step of resolving source line info for a stack frame.
   // "frame" must not be NULL.
@@ -79,15 +88,65 @@ class StackFrameSymbolizer {
                                               const SystemInfo* system_info,
                                               StackFrame* stack_frame);
 
+  // Symbolizes |stack_frame|, which FillSourceLineInfo has symbolized
+  // before, again, after adding the source lines that the resolver
+  // deferred when it loaded the frame's module (see
+  // SourceLineResolverInterface::DeferSourceLines), if it did.  The
+  // module's symbols are fetched from the supplier again for them, once
+  // per module.  Frames whose module isn't loaded are left alone.
+  virtual SymbolizerResult FillDeferredSourceLines(
+      const SystemInfo* system_info,
+      StackFrame* stack_frame);
+
+  // Decides whether |address|, which lies in |module|, falls within a
+  // function that the module's symbols describe, without loading them,
+  // for judging candidate return addresses found by stack scanning.  The
+  // answer comes from the FUNC and PUBLIC records listed in the module's
+  // symbol file index (see SymbolSupplier::GetIndexedSymbolFile), which
+  // is opened once per Reset, and agrees with whether FillSourceLineInfo
+  // would give the address a function name.  Sets |*in_function| and
+  // returns true if it can tell that way, or returns false if the
+  // module's symbols are already loaded, are known to be missing, or have
+  // no index; FillSourceLineInfo should then be asked instead.
+  virtual bool IsInFunctionWithoutLoading(const CodeModule* module,
+                                          const SystemInfo* system_info,
+                                          uint64_t address,
+                                          bool* in_function);
+
   virtual WindowsFrameInfo* FindWindowsFrameInfo(const StackFrame* frame);
 
+  // Returns the CFI rules for |frame|, from the cache set with
+  // set_cfi_frame_info_cache if possible.  If the frame's module has no
+  // symbols, the rules are looked up in its binary's .eh_frame instead,
+  // when the supplier can find the binary (see
+  // SymbolSupplier::GetBinaryFile).  The caller owns the result.
   virtual CFIFrameInfo* FindCFIFrameInfo(const StackFrame* frame);
 
+  // These do what FillSourceLineInfo, FindWindowsFrameInfo and
+  // FindCFIFrameInfo do, if that takes only symbols already loaded into a
+  // resolver that can look them up concurrently (see
+  // SourceLineResolverInterface::CanLookUpConcurrently) and changes no
+  // state of the symbolizer's own.  Several threads may then call them at
+  // once, as long as nothing else is called on the symbolizer meanwhile;
+  // SerializedStackFrameSymbolizer relies on this.  Each returns true and
+  // stores what the other would return in its last argument if it could
+  // answer, or returns false if the other must be called instead.  A
+  // subclass that overrides one of the others should override its
+  // counterpart to match, or to return false.
+  virtual bool FillLoadedSourceLineInfo(const CodeModules* modules,
+                                        StackFrame* stack_frame,
+                                        SymbolizerResult* result);
+  virtual bool FindLoadedWindowsFrameInfo(const StackFrame* frame,
+                                          WindowsFrameInfo** frame_info);
+  virtual bool FindLoadedCFIFrameInfo(const StackFrame* frame,
+                                      CFIFrameInfo** cfi_frame_info);
+
   // Reset internal (locally owned) data as if the helper is re-instantiated.
   // A typical case is to call Reset() after processing an individual report
   // before start to process next one, in order to reset internal information
   // about missing symbols found so far.
-  virtual void Reset() { no_symbol_modules_.clear(); }
+  // Reset also stops any symbol prefetch in progress.
+  virtual void Reset();
 
   // Returns true if there is valid implementation for stack symbolization.
   virtual bool HasImplementation() { return resolver_ && supplier_; }
@@ -95,12 +154,115 @@ class StackFrameSymbolizer {
   SourceLineResolverInterface* resolver() { return resolver_; }
   SymbolSupplier* supplier() { return supplier_; }
 
+  // Remembers the CFI rules looked up by FindCFIFrameInfo in |cache|, which
+  // may be shared with other symbolizers.  The symbolizer does not take
+  // ownership of |cache|.  NULL, the default, disables caching.
+  void set_cfi_frame_info_cache(CFIFrameInfoCache* cache) {
+    cfi_frame_info_cache_ = cache;
+  }
+  CFIFrameInfoCache* cfi_frame_info_cache() { return cfi_frame_info_cache_; }
+
+  // Records the modules the supplier has no symbols for in |cache|, and
+  // skips the modules recorded there, which lets what was learned about
+  // missing symbols outlive Reset.  |cache| may be shared with other
+  // symbolizers.  The symbolizer does not take ownership of |cache|.  NULL,
+  // the default, asks the supplier about each module once per Reset.
+  void set_missing_symbol_cache(MissingSymbolCache* cache) {
+    missing_symbol_cache_ = cache;
+  }
+  MissingSymbolCache* missing_symbol_cache() { return missing_symbol_cache_; }
+
+  // Adds the time spent fetching and parsing symbols, and the number of
+  // times each was done, to |statistics| from now on.  The
+  // symbolizer does not take ownership of |statistics|.  NULL, the default,
+  // stops collecting.
+  void set_statistics(ProcessStatistics* statistics) {
+    statistics_ = statistics;
+  }
+  ProcessStatistics* statistics() { return statistics_; }
+
+  // Charges the size of the symbol data read from the supplier to |budget|
+  // from now on.  Symbols that are mapped or parsed straight from a file
+  // are not charged.  The symbolizer does not take ownership of |budget|.
+  // NULL, the default, stops charging.
+  void set_walk_budget(WalkBudget* budget) { walk_budget_ = budget; }
+  WalkBudget* walk_budget() { return walk_budget_; }
+
+  // Starts fetching the symbols for |modules| from the supplier, up to
+  // |thread_count| at a time, in the order given, so that they are at hand
+  // by the time FillSourceLineInfo first needs them.  This hides the
+  // latency of a supplier that reads symbols from slow or remote storage.
+  // FillSourceLineInfo waits only for a module whose symbols are still
+  // being fetched, and fetches them itself if no fetch has started on that
+  // module yet.  The resolver still parses symbols on the thread that
+  // first uses them.
+  //
+  // The fetches are speculative tasks on |executor|, or on |thread_count|
+  // threads of the symbolizer's own if |executor| is NULL.  They call the
+  // supplier's GetMappableSymbolFile and GetSymbolFile (the variant that
+  // returns the symbol data) concurrently with each other and with the
+  // thread using this symbolizer, so the supplier must be safe to use that
+  // way; SimpleSymbolSupplier is.  Symbols that have been fetched are held
+  // in memory until they are used or the prefetch is stopped.  The modules
+  // and |system_info| must stay valid until then.  Any prefetch already in
+  // progress is stopped first.  Does nothing if |thread_count| is 0, or on
+  // Windows.
+  void PrefetchSymbols(const std::vector<const CodeModule*>& modules,
+                       const SystemInfo* system_info,
+                       unsigned int thread_count,
+                       TaskExecutor* executor);
+
+  // Stops the prefetch started by PrefetchSymbols.  Modules not yet started
+  // are skipped, fetches in progress are waited for, and symbols fetched
+  // but never used are discarded.
+  void StopPrefetch();
+
  protected:
   SymbolSupplier* supplier_;
   SourceLineResolverInterface* resolver_;
+  CFIFrameInfoCache* cfi_frame_info_cache_;
+  MissingSymbolCache* missing_symbol_cache_;
+  ProcessStatistics* statistics_;
+  WalkBudget* walk_budget_;
+
   // A list of modules known to have symbols missing. This helps avoid
   // repeated lookups for the missing symbols within one minidump.
   std::set<string> no_symbol_modules_;
+
+ private:
+  struct SymbolPrefetch;
+
+  // Loads the symbols for |module| that a prefetch thread fetched, and fills
+  // in |frame| from them.  Returns false, leaving |result| untouched, if
+  // there is nothing usable for |module| in the prefetch.
+  bool FillSourceLineInfoFromPrefetch(const CodeModule* module,
+                                      StackFrame* frame,
+                                      SymbolizerResult* result);
+
+  // Closes the indexes in scan_indexes_.
+  void ClearScanIndexes();
+
+  // Looks up the CFI rules for |frame| in the resolver, or failing that,
+  // in the binary of a module without symbols.
+  CFIFrameInfo* FindUncachedCFIFrameInfo(const StackFrame* frame);
+
+  // Closes the binaries in binary_unwind_infos_.
+  void ClearBinaryUnwindInfos();
+
+  // Add to statistics_, if it is set.
+  void RecordSymbolFetch(double seconds);
+  void RecordSymbolParse(double seconds);
+
+  // The prefetch in progress, or NULL.
+  SymbolPrefetch* prefetch_;
+
+  // The symbol file indexes opened by IsInFunctionWithoutLoading, by
+  // code file.  NULL for a module that has no index.
+  std::map<string, SymbolFileIndex*> scan_indexes_;
+
+  // The binaries opened by FindCFIFrameInfo, by code file.  NULL for a
+  // module whose binary wasn't found.
+  std::map<string, ElfUnwindInfo*> binary_unwind_infos_;
 };
 
 }  // namespace google_breakpad
@@ -41,6 +41,8 @@
 #ifndef GOOGLE_BREAKPAD_PROCESSOR_STACKWALKER_H__
 #define GOOGLE_BREAKPAD_PROCESSOR_STACKWALKER_H__
 
+#include <string.h>
+
 #include <set>
 #include <string>
 #include <vector>
@@ -50,12 +52,16 @@
 #include "google_breakpad/processor/code_modules.h"
 #include "google_breakpad/processor/memory_region.h"
 #include "google_breakpad/processor/stack_frame_symbolizer.h"
+#include "google_breakpad/processor/walk_budget.h"
 
 namespace google_breakpad {
 
 class CallStack;
 class DumpContext;
+class FrameArena;
 class StackFrameSymbolizer;
+class SymbolizedFrameMemo;
+class UnwindPolicy;
 
 using std::set;
 using std::vector;
@@ -101,6 +107,36 @@ class Stackwalker {
     max_frames_scanned_ = max_frames_scanned;
   }
 
+  // Symbolizes frames from |memo| where it can, and records the frames this
+  // walker symbolizes in it, so that the walkers of a dump's threads need
+  // to symbolize each instruction only once.  |memo| must only be shared by
+  // walkers of the same dump.  The walker does not take ownership of
+  // |memo|.  NULL, the default, symbolizes every frame.
+  void set_symbolized_frame_memo(SymbolizedFrameMemo* memo) {
+    frame_memo_ = memo;
+  }
+
+  // Allocates the frames this walker creates in |arena|, which must
+  // outlive the CallStack they are walked into.  The walker does not take
+  // ownership of |arena|.  NULL, the default, allocates them on the heap.
+  void set_frame_arena(FrameArena* arena) { frame_arena_ = arena; }
+
+  // Charges the frames this walker walks and the stack words it scans to
+  // |budget|, and stops the walk, marking the CallStack truncated, once
+  // |budget| runs out.  |budget| may be shared by walkers on several
+  // threads.  The walker does not take ownership of |budget|.  NULL, the
+  // default, walks without a budget.
+  void set_walk_budget(WalkBudget* budget) { walk_budget_ = budget; }
+
+  // Finds the callers of frames only with the methods |policy| allows for
+  // their modules (see UnwindPolicy).  The walker does not take ownership
+  // of |policy|, which must not change during a walk.  NULL, the default,
+  // tries every method for every frame.
+  void set_unwind_policy(const UnwindPolicy* policy) {
+    unwind_policy_ = policy;
+    policy_module_ = NULL;
+  }
+
  protected:
   // system_info identifies the operating system, NULL or empty if unknown.
   // memory identifies a MemoryRegion that provides the stack memory
@@ -126,6 +162,31 @@ class Stackwalker {
   // Returns false otherwise.
   bool InstructionAddressSeemsValid(uint64_t address);
 
+  // Sets |lowest| and |highest| to the lowest and highest addresses
+  // covered by any module in modules_.  Returns false if there are no
+  // modules.  The bounds are computed on first use and then remembered.
+  bool GetModuleAddressBounds(uint64_t* lowest, uint64_t* highest);
+
+  // Returns the UnwindPolicy::Method values for the methods to try when
+  // finding the caller of |frame|, which must have been symbolized.
+  int AllowedUnwindMethods(const StackFrame* frame);
+
+  // Reads the value at |address| in the stack memory into |value|, as
+  // memory_->GetMemoryAtAddress does.  Within the view of the stack that
+  // Walk takes from MemoryRegion::GetContiguousMemory, this is a plain
+  // load rather than a virtual call.
+  template<typename ValueType>
+  bool ReadStackMemory(uint64_t address, ValueType* value) const {
+    if (stack_view_ && address >= stack_view_base_ &&
+        sizeof(ValueType) <= stack_view_size_ &&
+        address - stack_view_base_ <= stack_view_size_ - sizeof(ValueType)) {
+      memcpy(value, stack_view_ + (address - stack_view_base_),
+             sizeof(ValueType));
+      return true;
+    }
+    return memory_->GetMemoryAtAddress(address, value);
+  }
+
   // The default number of words to search through on the stack
   // for a return address.
   static const int kRASearchWords;
@@ -154,23 +215,75 @@ class Stackwalker {
   // When returning true, sets location_found to the address at which
   // the value was found, and ip_found to the value contained at that
   // location in memory.
+  //
+  // The stack is read a chunk of words at a time.  Each chunk is first
+  // narrowed down to the words that fall within the span of the loaded
+  // modules, which rejects most stack data (small integers, stack and heap
+  // pointers) with two compares, before the remaining candidates are looked
+  // up in the module list together and checked in stack order.
   template<typename InstructionType>
   bool ScanForReturnAddress(InstructionType location_start,
                             InstructionType* location_found,
                             InstructionType* ip_found,
                             int searchwords) {
-    for (InstructionType location = location_start;
-         location <= location_start + searchwords * sizeof(InstructionType);
-         location += sizeof(InstructionType)) {
-      InstructionType ip;
-      if (!memory_->GetMemoryAtAddress(location, &ip))
-        break;
-
-      if (modules_ && modules_->GetModuleForAddress(ip) &&
-          InstructionAddressSeemsValid(ip)) {
-        *ip_found = ip;
-        *location_found = location;
-        return true;
+    uint64_t lowest, highest;
+    if (!GetModuleAddressBounds(&lowest, &highest))
+      return false;
+
+    const int kChunkWords = 64;
+    InstructionType words[kChunkWords];
+    int candidates[kChunkWords];
+    uint64_t candidate_addresses[kChunkWords];
+    const CodeModule* candidate_modules[kChunkWords];
+
+    const InstructionType location_end =
+        location_start + searchwords * sizeof(InstructionType);
+    InstructionType location = location_start;
+    bool readable = true;
+    while (readable && location <= location_end) {
+      int word_count = 0;
+      while (word_count < kChunkWords) {
+        InstructionType word_location =
+            location + word_count * sizeof(InstructionType);
+        if (word_location > location_end)
+          break;
+        if (!ReadStackMemory(word_location, &words[word_count])) {
+          readable = false;
+          break;
+        }
+        ++word_count;
+      }
+
+      // Collect the indices of in-span words without branching on each
+      // word, so this loop costs the same however the words are laid out.
+      int candidate_count = 0;
+      for (int i = 0; i < word_count; ++i) {
+        candidates[candidate_count] = i;
+        candidate_count += words[i] >= lowest && words[i] <= highest;
+      }
+
+      // Look the candidates up together, so that those landing in the
+      // same module share one search of the module list.
+      for (int i = 0; i < candidate_count; ++i)
+        candidate_addresses[i] = words[candidates[i]];
+      modules_->GetModulesForAddresses(candidate_addresses, candidate_count,
+                                       candidate_modules);
+
+      for (int i = 0; i < candidate_count; ++i) {
+        InstructionType ip = words[candidates[i]];
+        if (candidate_modules[i] && InstructionAddressSeemsValid(ip)) {
+          *ip_found = ip;
+          *location_found =
+              location + candidates[i] * sizeof(InstructionType);
+          return true;
+        }
+      }
+
+      location += word_count * sizeof(InstructionType);
+
+      if (walk_budget_ && !walk_budget_->ChargeScannedWords(word_count)) {
+        walk_budget_ran_out_ = true;
+        return false;
       }
     }
     // nothing found
@@ -193,7 +306,46 @@ class Stackwalker {
   // The StackFrameSymbolizer implementation.
   StackFrameSymbolizer* frame_symbolizer_;
 
+  // Where subclasses allocate their frames, with
+  // new (frame_arena_) StackFrameCPU().  See set_frame_arena.
+  FrameArena* frame_arena_;
+
+  // See set_walk_budget.  May be NULL.
+  WalkBudget* walk_budget_;
+
+  // Set when a scan stops because walk_budget_ ran out, so that Walk marks
+  // the stack truncated even if the walk then ends for want of a caller.
+  bool walk_budget_ran_out_;
+
  private:
+  // Fills in |frame|'s module and source line information, from
+  // frame_memo_ if possible.
+  StackFrameSymbolizer::SymbolizerResult SymbolizeFrame(StackFrame* frame);
+
+  // See set_symbolized_frame_memo.  May be NULL.
+  SymbolizedFrameMemo* frame_memo_;
+
+  // See set_unwind_policy.  May be NULL.  The methods for the module last
+  // looked up are remembered, as consecutive frames often share one.
+  const UnwindPolicy* unwind_policy_;
+  const CodeModule* policy_module_;
+  int policy_methods_;
+
+  // The whole of memory_, if it provides a contiguous view, which Walk
+  // fetches before each walk; NULL otherwise.  See ReadStackMemory.
+  const uint8_t* stack_view_;
+  uint64_t stack_view_base_;
+  uint64_t stack_view_size_;
+
+  // The span of modules_, filled in by GetModuleAddressBounds.
+  bool module_bounds_computed_;
+  uint64_t modules_lowest_;
+  uint64_t modules_highest_;
+
+  // The scanned_modules_ of the CallStack being walked, which
+  // InstructionAddressSeemsValid adds to.  NULL outside of Walk.
+  vector<const CodeModule*>* scanned_modules_;
+
   // Obtains the context frame, the innermost called procedure in a stack
   // trace.  Returns NULL on failure.  GetContextFrame allocates a new
   // StackFrame (or StackFrame subclass), ownership of which is taken by
@@ -0,0 +1,164 @@
+// Copyright (c) 2016 Google Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+// notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above
+// copyright notice, this list of conditions and the following disclaimer
+// in the documentation and/or other materials provided with the
+// distribution.
+//     * Neither the name of Google Inc. nor the names of its
+// contributors may be used to endorse or promote products derived from
+// this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+// symbol_affinity_router.h: SymbolAffinityRouter, which spreads minidumps
+// over the nodes of a processing cluster so that each node keeps seeing
+// the same modules.
+//
+// When minidumps are handed to processing nodes at random, every node
+// ends up parsing and caching nearly every popular module, and a
+// cluster's symbol cache holds as many copies of each as it has nodes.
+// SymbolAffinityRouter instead gives each module an owner by consistent
+// hashing of its debug file and debug identifier, and sends a minidump to
+// the node that owns most of it: the owners of its dominant modules, the
+// largest ones that have debug identifiers, vote with their modules'
+// sizes.  Each node's cache then mostly holds the modules it owns.
+//
+// Only the module list is needed to route a minidump, so a router can
+// work from Minidump::Read and Minidump::GetModuleList without processing
+// anything.  Each node has |replicas| points on the hash ring, so when a
+// node joins or leaves, only the modules owned by it change owner.
+//
+// The router counts, for each node, the dominant modules of the
+// minidumps sent to it that it had been sent before (hits) and that it
+// had not (misses).  These estimate the node's symbol cache hits,
+// assuming the cache keeps whatever it is given.  A node that leaves
+// forgets what it was sent.
+//
+// SymbolAffinityRouter is not thread-safe.
+
+#ifndef GOOGLE_BREAKPAD_PROCESSOR_SYMBOL_AFFINITY_ROUTER_H__
+#define GOOGLE_BREAKPAD_PROCESSOR_SYMBOL_AFFINITY_ROUTER_H__
+
+#include <stddef.h>
+
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "common/using_std_string.h"
+#include "google_breakpad/common/breakpad_types.h"
+
+namespace google_breakpad {
+
+class CodeModule;
+class CodeModules;
+
+class SymbolAffinityRouter {
+ public:
+  // What was routed to one node.
+  struct NodeStats {
+    NodeStats() : minidumps(0), hits(0), misses(0), modules(0) {}
+
+    string name;
+    uint64_t minidumps;
+    uint64_t hits;
+    uint64_t misses;
+
+    // The number of distinct dominant modules the node was sent.
+    size_t modules;
+  };
+
+  static const int kDefaultReplicas = 64;
+  static const size_t kDefaultDominantModules = 8;
+
+  // Creates a router without nodes.  Each node gets |replicas| points on
+  // the hash ring, and each minidump is routed by its
+  // |dominant_module_count| largest modules.
+  SymbolAffinityRouter(int replicas, size_t dominant_module_count);
+
+  // Adds the node |name|.  Returns false if there already is one.
+  // Otherwise, sets |*moved_modules|, if given, to the number of modules
+  // that were sent to some other node and are now owned by |name|.
+  bool AddNode(const string& name, size_t* moved_modules);
+
+  // Removes the node |name|, and what it was sent.  Returns false if there
+  // is no such node.  Otherwise, sets |*moved_modules|, if given, to the
+  // number of modules it was sent, which now have other owners.
+  bool RemoveNode(const string& name, size_t* moved_modules);
+
+  size_t node_count() const { return nodes_.size(); }
+
+  // Sets |*dominant| to the modules of |modules| that route a minidump
+  // with them, largest first.
+  void DominantModules(const CodeModules* modules,
+                       std::vector<const CodeModule*>* dominant) const;
+
+  // Returns the key that |module| is routed by, "<debug_file>|<debug_id>"
+  // as in SymbolModuleCache, or an empty string if it lacks either.
+  static string KeyForModule(const CodeModule* module);
+
+  // Returns the node that owns the module with |key|, or an empty string
+  // if there are no nodes.
+  string NodeForKey(const string& key) const;
+
+  // Returns the node to send a minidump with |modules| to, and records it
+  // in the node's statistics.  A minidump without dominant modules, such
+  // as one whose module list could not be read (|modules| NULL), goes to
+  // the owner of |fallback_key|, which might be its path.  Returns an
+  // empty string if there are no nodes.
+  string Route(const CodeModules* modules, const string& fallback_key);
+
+  // Sets |*stats| to the statistics of each node, ordered by name.
+  void GetStats(std::vector<NodeStats>* stats) const;
+
+ private:
+  // A node and what it was sent.
+  struct Node {
+    NodeStats stats;
+
+    // The keys of the dominant modules it was sent.
+    std::set<string> modules;
+  };
+
+  typedef std::map<string, Node> NodeMap;
+
+  // The hash ring: each point, and the node whose it is.
+  typedef std::map<uint64_t, string> Ring;
+
+  // Returns the point on the ring of |key|.
+  static uint64_t Hash(const string& key);
+
+  // Returns the point on the ring of replica |replica| of node |name|.
+  static uint64_t ReplicaHash(const string& name, int replica);
+
+  int replicas_;
+  size_t dominant_module_count_;
+  NodeMap nodes_;
+  Ring ring_;
+
+  // Disallow copy constructor and assignment operator.
+  SymbolAffinityRouter(const SymbolAffinityRouter&);
+  void operator=(const SymbolAffinityRouter&);
+};
+
+}  // namespace google_breakpad
+
+#endif  // GOOGLE_BREAKPAD_PROCESSOR_SYMBOL_AFFINITY_ROUTER_H__
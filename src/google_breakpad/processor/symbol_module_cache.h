@@ -0,0 +1,266 @@
+// Copyright (c) 2016 Google Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+// notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above
+// copyright notice, this list of conditions and the following disclaimer
+// in the documentation and/or other materials provided with the
+// distribution.
+//     * Neither the name of Google Inc. nor the names of its
+// contributors may be used to endorse or promote products derived from
+// this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+// symbol_module_cache.h: SymbolModuleCache, a thread-safe store of parsed
+// symbol modules that may be shared by any number of source line resolvers.
+//
+// Each resolver normally parses and owns its own copy of every symbol file
+// it loads.  A service running several MinidumpProcessor instances side by
+// side therefore holds, and has paid to parse, one copy of each popular
+// module per processor.  Attaching the same SymbolModuleCache to each of
+// those resolvers (SourceLineResolverBase::set_module_cache) makes them
+// share a single parsed copy, keyed by the module's debug file and debug
+// identifier.
+//
+// Deterministic builds and rebuilt containers produce the same library
+// under many debug identifiers, whose symbol files differ in little but
+// their MODULE lines.  A resolver whose symbol supplier reports a digest
+// of a module's symbol records (SymbolSupplier::GetSymbolFileDigest)
+// shares the module already cached under that digest, whatever its debug
+// file and identifier, rather than parsing another copy.
+//
+// Cached modules are reference counted; a resolver holds a reference from
+// the time it first loads or finds the module until it unloads it or is
+// destroyed.  Modules no longer referenced by any resolver stay in the cache
+// until the total size of cached symbol data exceeds the memory budget, at
+// which point the least recently released ones are discarded, or those an
+// EvictionPolicy chooses.
+//
+// Symbols can be replaced while the cache is in use.  A resolver's
+// ReloadModule parses a new version and publishes it in place of the
+// cached one, and a symbol supplier that learns a symbol file changed can
+// call Invalidate to drop the cached copy.  Neither waits for the
+// resolvers using the old version: they keep it, and their lookups keep
+// working, until they next check for the module with HasModule, at which
+// point they switch to the current version.  The old version is freed once
+// the last of them lets go of it.  Other cached modules are unaffected.
+//
+// The cache must outlive every resolver attached to it.
+
+#ifndef GOOGLE_BREAKPAD_PROCESSOR_SYMBOL_MODULE_CACHE_H__
+#define GOOGLE_BREAKPAD_PROCESSOR_SYMBOL_MODULE_CACHE_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <list>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "common/using_std_string.h"
+#include "google_breakpad/processor/source_line_resolver_base.h"
+
+namespace google_breakpad {
+
+class CodeModule;
+class Mutex;
+
+class SymbolModuleCache {
+ public:
+  // Chooses which unreferenced module to evict when the cache is over its
+  // memory budget.
+  class EvictionPolicy {
+   public:
+    // An unreferenced module that may be evicted.
+    struct Candidate {
+      // The module's debug file and debug identifier, separated by '|'.
+      string key;
+
+      // The size of the module's symbol data, which the budget counts.
+      size_t size;
+
+      // The memory the module's parsed symbols take.
+      SourceLineResolverBase::ModuleMemoryUsage memory_usage;
+
+      // The cache's use count when a resolver last acquired or released
+      // the module.
+      uint64_t last_use;
+    };
+
+    virtual ~EvictionPolicy() {}
+
+    // Returns the index in |candidates| of the module to evict next.
+    // |candidates| is never empty and lists the least recently released
+    // module first.  |use_count| is the cache's current use count.  Called
+    // with the cache locked, so it must not call back into the cache.
+    virtual size_t ChooseVictim(const std::vector<Candidate> &candidates,
+                                uint64_t use_count) = 0;
+  };
+
+  // Creates a cache that retains unreferenced modules for as long as the
+  // size of all cached symbol data stays within |memory_budget| bytes.
+  // Modules in use by a resolver are never evicted, so the budget may be
+  // exceeded temporarily.
+  explicit SymbolModuleCache(size_t memory_budget);
+  ~SymbolModuleCache();
+
+  size_t memory_budget() const { return memory_budget_; }
+
+  // Changes the memory budget, evicting unreferenced modules as needed.
+  void set_memory_budget(size_t memory_budget);
+
+  // The number of modules and bytes of symbol data currently cached,
+  // including modules that are no longer referenced.
+  size_t module_count() const;
+  size_t memory_used() const;
+
+  // The number of times a module was shared by digest with another debug
+  // file or identifier, rather than parsed again.
+  uint64_t digest_share_count() const;
+
+  // Drops the cached symbols for the module with |debug_file| and
+  // |debug_identifier|, or for all modules, so that resolvers fetch them
+  // from their symbol suppliers the next time they need them.  Modules
+  // sharing the symbols by digest fetch them again too.  Safe to call
+  // while resolvers on other threads use the cache.
+  void Invalidate(const string &debug_file, const string &debug_identifier);
+  void InvalidateAll();
+
+  // Changes whenever cached symbols are replaced or invalidated.  Cheap
+  // enough to check before every lookup.
+  uint32_t generation() const;
+
+  // Evicts the modules |eviction_policy| chooses instead of the least
+  // recently released ones.  NULL restores the default.  The cache does
+  // not take ownership of |eviction_policy|, which must outlive it.
+  void set_eviction_policy(EvictionPolicy *eviction_policy);
+
+ private:
+  friend class SourceLineResolverBase;
+
+  typedef SourceLineResolverBase::Module Module;
+
+  struct Entry;
+  class SharedModule;
+
+  typedef std::map<string, Entry*> EntryMap;
+  typedef std::list<Entry*> EntryList;
+
+  // Returns the cache key for |module|, or an empty string if |module| lacks
+  // the identifying information needed to share it safely.
+  static string KeyForModule(const CodeModule* module);
+
+  // Returns a new reference to the cached symbols for |module|, or NULL.
+  // Sets |corrupt| to whether the symbols were found to be corrupt on load.
+  Module* Acquire(const CodeModule* module, bool* corrupt);
+
+  // Returns a new reference to the cached symbols whose digest is
+  // |digest|, or NULL.  Sets |corrupt| as Acquire does.
+  Module* AcquireByDigest(const string& digest, bool* corrupt);
+
+  // Adds freshly loaded |symbols| for |module| to the cache and returns a
+  // reference to the cached copy.  The cache takes ownership of |symbols|
+  // and of |buffer|, which may be NULL if |symbols| does not refer to it
+  // after loading.  |size| is the size of the symbol data.  |digest|, if
+  // not empty, is the digest of the symbols, under which other modules may
+  // then acquire them.  If another resolver cached the same module first,
+  // |symbols| and |buffer| are freed and the existing copy is returned
+  // instead.  Returns NULL if the module can't be cached, in which case
+  // nothing is taken over.
+  Module* Insert(const CodeModule* module, Module* symbols, char* buffer,
+                 size_t size, const string& digest, bool* corrupt);
+
+  // Replaces the cached symbols for |module| with freshly loaded
+  // |symbols|, taking ownership of |symbols| and |buffer| as Insert does.
+  // Resolvers holding the old version keep it until they release it.
+  // Returns false if the module can't be cached, in which case nothing is
+  // taken over.
+  bool Publish(const CodeModule* module, Module* symbols, char* buffer,
+               size_t size);
+
+  // Drops a reference obtained from Acquire or Insert.
+  void Release(Module* module);
+
+  // Returns true if |module|, a reference obtained from Acquire or Insert,
+  // has since been replaced or invalidated.
+  bool IsStale(Module* module) const;
+
+  // Removes |entry| from entries_ and marks it stale, freeing it now if it
+  // is unreferenced and otherwise when its last reference is released.
+  // The caller must hold mutex_.
+  void DetachLocked(Entry* entry);
+
+  // Makes |entry| the one acquired by |digest|, unless |digest| is empty
+  // or another entry has it.  The caller must hold mutex_.
+  void AddDigestLocked(Entry* entry, const string& digest);
+
+  // Removes |entry| from entries_ and digests_.  The caller must hold
+  // mutex_.
+  void UnindexLocked(Entry* entry);
+
+  // Frees |entry|, which is no longer in entries_ or unused_.  The caller
+  // must hold mutex_.
+  void DeleteLocked(Entry* entry);
+
+  // Frees unreferenced entries until memory_used_ fits the budget.  The
+  // caller must hold mutex_.
+  void EvictLocked();
+
+  size_t memory_budget_;
+  size_t memory_used_;
+  EntryMap entries_;
+
+  // The entries whose symbols have a known digest, by digest.
+  EntryMap digests_;
+  uint64_t digest_share_count_;
+
+  // See generation().  Updated under mutex_, but read without it.
+  uint32_t generation_;
+
+  // Unreferenced entries, least recently released first.
+  EntryList unused_;
+
+  // Counts the acquisitions and releases of modules, as a clock for
+  // EvictionPolicy::Candidate::last_use.
+  uint64_t use_count_;
+
+  // Not owned; NULL to evict the least recently released entries first.
+  EvictionPolicy *eviction_policy_;
+
+  Mutex* mutex_;
+
+  // Disallow copy constructor and assignment operator.
+  SymbolModuleCache(const SymbolModuleCache&);
+  void operator=(const SymbolModuleCache&);
+};
+
+// Evicts the module that has gone unused for longest relative to the memory
+// it takes, that is, the one with the largest product of its parsed size
+// and the number of uses since it was last used.  A large module is kept
+// while it is in regular use, but goes before small ones once it isn't.
+class SizeWeightedEvictionPolicy : public SymbolModuleCache::EvictionPolicy {
+ public:
+  virtual size_t ChooseVictim(const std::vector<Candidate> &candidates,
+                              uint64_t use_count);
+};
+
+}  // namespace google_breakpad
+
+#endif  // GOOGLE_BREAKPAD_PROCESSOR_SYMBOL_MODULE_CACHE_H__
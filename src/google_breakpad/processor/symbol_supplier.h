@@ -92,6 +92,75 @@ class SymbolSupplier {
 
   // Frees the data buffer allocated for the module in GetCStringSymbolData.
   virtual void FreeSymbolData(const CodeModule *module) = 0;
+
+  // Retrieves the path of a symbol file for the given CodeModule that is
+  // already in the serialized form FastSourceLineResolver uses in place (see
+  // ModuleSerializer), placing it in symbol_file if successful.  Such a file
+  // can be mapped into memory instead of being read with
+  // GetCStringSymbolData.  StackFrameSymbolizer asks for one first when its
+  // resolver supports it, and falls back to GetCStringSymbolData if the
+  // result is NOT_FOUND or the file can't be loaded.  The default
+  // implementation never finds one.
+  virtual SymbolResult GetMappableSymbolFile(const CodeModule *module,
+                                             const SystemInfo *system_info,
+                                             string *symbol_file) {
+    return NOT_FOUND;
+  }
+
+  // Retrieves the path of a gzip- or zstd-compressed text symbol file for
+  // the given CodeModule, placing it in symbol_file if successful.
+  // StackFrameSymbolizer asks for one first when its resolver can parse
+  // symbols as they are decompressed (see
+  // SourceLineResolverInterface::LoadModuleUsingCompressedFile), and falls
+  // back to the other methods if the result is NOT_FOUND or the file can't
+  // be loaded.  The default implementation never finds one.
+  virtual SymbolResult GetCompressedSymbolFile(const CodeModule *module,
+                                               const SystemInfo *system_info,
+                                               string *symbol_file) {
+    return NOT_FOUND;
+  }
+
+  // Retrieves the path of a text symbol file for the given CodeModule that
+  // has a sidecar index, placing it in symbol_file and the index's path in
+  // index_file if successful.  StackFrameSymbolizer asks for one first
+  // when its resolver can load symbols on demand (see
+  // SourceLineResolverInterface::LoadModuleUsingIndexedFile), and falls
+  // back to the other methods if the result is NOT_FOUND or the file can't
+  // be loaded.  The default implementation never finds one.
+  virtual SymbolResult GetIndexedSymbolFile(const CodeModule *module,
+                                            const SystemInfo *system_info,
+                                            string *symbol_file,
+                                            string *index_file) {
+    return NOT_FOUND;
+  }
+
+  // Retrieves a digest of the symbol records of the given CodeModule's
+  // symbol file, placing it in digest if successful.  Modules whose
+  // symbol files have the same digest have the same symbols, even under
+  // different debug files or identifiers, as when a deterministic build is
+  // repackaged; a digest therefore leaves out the MODULE line, which names
+  // them.  StackFrameSymbolizer asks for one first when its resolver can
+  // share modules between such symbol files (see
+  // SourceLineResolverInterface::LoadModuleUsingDigest), and falls back to
+  // loading the symbol file if the result is NOT_FOUND or no module with
+  // the digest is loaded yet.  The default implementation never finds one.
+  virtual SymbolResult GetSymbolFileDigest(const CodeModule *module,
+                                           const SystemInfo *system_info,
+                                           string *digest) {
+    return NOT_FOUND;
+  }
+
+  // Retrieves the path of the ELF binary that the given CodeModule was
+  // loaded from, placing it in binary_file if successful.  When a module
+  // has no symbol file, StackFrameSymbolizer looks up CFI in the binary's
+  // own .eh_frame instead (see ElfUnwindInfo), provided that its build ID
+  // matches the module's debug identifier.  The default implementation
+  // never finds one.
+  virtual SymbolResult GetBinaryFile(const CodeModule *module,
+                                     const SystemInfo *system_info,
+                                     string *binary_file) {
+    return NOT_FOUND;
+  }
 };
 
 }  // namespace google_breakpad
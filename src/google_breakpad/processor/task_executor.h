@@ -0,0 +1,215 @@
+// Copyright (c) 2016 Google Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+// notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above
+// copyright notice, this list of conditions and the following disclaimer
+// in the documentation and/or other materials provided with the
+// distribution.
+//     * Neither the name of Google Inc. nor the names of its
+// contributors may be used to endorse or promote products derived from
+// this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+// task_executor.h: TaskExecutor, the threads that the processor's
+// concurrent work runs on, TaskGroup, which waits for a set of tasks, and
+// WorkStealingExecutor, the default TaskExecutor.
+//
+// Stack walks, symbol prefetches, parallel symbol parsing and the requests
+// of minidump_stackwalk's daemon and batch modes can all run concurrently.
+// Given their own threads, several of them together would start far more
+// threads than there are cores.  Given one TaskExecutor instead, they share
+// its threads, and its priorities decide what runs first: work that a
+// result is waiting on, such as the requesting thread's walk or the
+// symbols a walk is blocked on, goes ahead of ordinary work, which goes
+// ahead of speculative work such as symbol prefetches.
+//
+// Work is submitted through a TaskGroup, whose Wait takes back the tasks
+// that no executor thread has started and runs them on the waiting thread.
+// A waiting thread thus never depends on a free executor thread, so tasks
+// may themselves wait for other tasks, and an executor with no threads at
+// all (as on Windows) runs everything on the threads that wait.  The
+// waiting thread only ever runs its own group's tasks, so it never runs
+// unrelated work while holding locks of its own.
+
+#ifndef GOOGLE_BREAKPAD_PROCESSOR_TASK_EXECUTOR_H__
+#define GOOGLE_BREAKPAD_PROCESSOR_TASK_EXECUTOR_H__
+
+#include <stddef.h>
+
+#include "google_breakpad/common/breakpad_types.h"
+
+namespace google_breakpad {
+
+class TaskGroup;
+
+// A unit of work.  A task may be submitted again once it has run, even
+// from its own Run.
+class Task {
+ public:
+  Task() : group_(NULL) {}
+  virtual ~Task() {}
+
+  virtual void Run() = 0;
+
+ private:
+  friend class TaskExecutor;
+  friend class TaskGroup;
+
+  // The group the task was last submitted through.
+  TaskGroup* group_;
+};
+
+class TaskExecutor {
+ public:
+  // The order in which queued tasks are started, most urgent first.
+  enum Priority {
+    // Work that a result is waiting on.
+    PRIORITY_CRITICAL,
+    PRIORITY_NORMAL,
+    // Work that may turn out not to be needed.
+    PRIORITY_SPECULATIVE,
+    PRIORITY_COUNT
+  };
+
+  // The kinds of work that tasks are counted under.
+  enum Stage {
+    STAGE_STACKWALK,
+    STAGE_SYMBOL_FETCH,
+    STAGE_SYMBOL_PARSE,
+    STAGE_REQUEST,
+    STAGE_COUNT
+  };
+
+  // The counts of the tasks of one stage.
+  struct StageMetrics {
+    StageMetrics()
+        : submitted(0), completed(0), withdrawn(0), queue_depth(0),
+          max_queue_depth(0) {}
+
+    uint64_t submitted;
+    // Run by the executor's threads.
+    uint64_t completed;
+    // Taken back by a TaskGroup to run on the waiting thread.
+    uint64_t withdrawn;
+    // Queued and not yet started, now and at most.
+    size_t queue_depth;
+    size_t max_queue_depth;
+  };
+
+  virtual ~TaskExecutor() {}
+
+  // Queues |task| to run on one of the executor's threads, ahead of any
+  // task of lower |priority|.  The executor does not take ownership of
+  // |task|.  Use TaskGroup::Submit, which calls this.
+  virtual void Submit(Task* task, Priority priority, Stage stage) = 0;
+
+  // Removes a task submitted through |group| that no thread has started
+  // from the queue, and returns it for the caller to run, or returns NULL
+  // if there is none.  Use TaskGroup::Wait, which calls this.
+  virtual Task* Withdraw(const TaskGroup* group) = 0;
+
+  // Returns the counts of the tasks submitted under |stage|.
+  virtual StageMetrics GetStageMetrics(Stage stage) const = 0;
+
+  // Returns a short name for |stage|, such as "stackwalk".
+  static const char* StageName(Stage stage);
+
+ protected:
+  // Runs |task| and tells its group that it has finished.  Executors run
+  // tasks only through this.
+  static void RunTask(Task* task);
+
+  // Returns the group |task| was submitted through.
+  static const TaskGroup* GroupOf(const Task* task) { return task->group_; }
+};
+
+// The tasks submitted for one piece of work.  A group must not be
+// destroyed while its tasks may run; the destructor waits for them.
+class TaskGroup {
+ public:
+  // Submits tasks to |executor|, which may be NULL to run each task as
+  // soon as it is submitted, on the submitting thread.
+  explicit TaskGroup(TaskExecutor* executor);
+  ~TaskGroup();
+
+  void Submit(Task* task, TaskExecutor::Priority priority,
+              TaskExecutor::Stage stage);
+
+  // Returns once every task submitted through the group has run, running
+  // those that haven't started on the calling thread, most urgent first.
+  // Tasks submitted while waiting are waited for too.
+  void Wait();
+
+ private:
+  friend class TaskExecutor;
+
+  struct Sync;
+
+  void Finished();
+
+  TaskExecutor* executor_;
+
+  // The tasks submitted that haven't finished.
+  size_t outstanding_;
+
+  Sync* sync_;
+
+  // Disallow copy constructor and assignment operator.
+  TaskGroup(const TaskGroup&);
+  void operator=(const TaskGroup&);
+};
+
+// A TaskExecutor with a fixed number of threads.  Each thread has its own
+// queues, one per priority.  A task submitted by one of the threads goes
+// on that thread's queues, and others on the queues of the threads in
+// turn.  A thread starts the most urgent task it can find: the newest in
+// its own queue of the highest priority with any task, or failing that,
+// the oldest in another thread's queue of that priority.  Tasks that
+// spawn tasks thus mostly keep their data on the thread that made it,
+// while idle threads steal the oldest, and usually largest, work.
+class WorkStealingExecutor : public TaskExecutor {
+ public:
+  // Starts |thread_count| threads, or none on Windows.  With none, tasks
+  // run only when their groups wait for them.
+  explicit WorkStealingExecutor(unsigned int thread_count);
+
+  // Stops the threads once the tasks already queued have run.
+  virtual ~WorkStealingExecutor();
+
+  virtual void Submit(Task* task, Priority priority, Stage stage);
+  virtual Task* Withdraw(const TaskGroup* group);
+  virtual StageMetrics GetStageMetrics(Stage stage) const;
+
+  // The number of threads started.
+  unsigned int thread_count() const;
+
+ private:
+  struct State;
+
+  State* state_;
+
+  // Disallow copy constructor and assignment operator.
+  WorkStealingExecutor(const WorkStealingExecutor&);
+  void operator=(const WorkStealingExecutor&);
+};
+
+}  // namespace google_breakpad
+
+#endif  // GOOGLE_BREAKPAD_PROCESSOR_TASK_EXECUTOR_H__
@@ -0,0 +1,172 @@
+// Copyright (c) 2016 Google Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+// notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above
+// copyright notice, this list of conditions and the following disclaimer
+// in the documentation and/or other materials provided with the
+// distribution.
+//     * Neither the name of Google Inc. nor the names of its
+// contributors may be used to endorse or promote products derived from
+// this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+// unwind_policy.h: UnwindPolicy, which tells stack walkers which methods
+// of finding a frame's caller to try for frames in each module, and
+// UnwindStatistics, which counts how well each method did across many
+// processed minidumps.
+//
+// A walker finds a frame's caller with stack walking information from
+// the module's symbols (CFI, or on x86 also Windows frame data), then by
+// following the frame pointer, then by scanning the stack for a return
+// address, stopping at the first that works.  For some modules, scanning
+// almost only finds garbage; for others, frame pointers always work and
+// looking for stack walking information first is wasted effort.  An
+// UnwindPolicy lists the methods to try for such modules.  Modules it
+// doesn't name are walked with every method.
+//
+// A policy is kept in a text file, one module per line:
+//
+//   <module> <method>[,<method>...]
+//
+// where <module> is the file name of the module's debug file, and each
+// <method> is "cfi", "fp" or "scan", or the whole list is "none".  Blank
+// lines and lines starting with '#' are ignored.
+//
+// A policy can be refined from the statistics of the minidumps it was
+// used on, with UnwindPolicy::Update.  Whether a recovered frame was
+// right isn't known, so UnwindStatistics takes a frame whose own caller
+// was then found with stack walking information or the frame pointer as
+// confirmed: a frame found by a wrong guess rarely leads on to a
+// consistent frame.
+
+#ifndef GOOGLE_BREAKPAD_PROCESSOR_UNWIND_POLICY_H__
+#define GOOGLE_BREAKPAD_PROCESSOR_UNWIND_POLICY_H__
+
+#include <map>
+#include <string>
+
+#include "common/using_std_string.h"
+#include "google_breakpad/common/breakpad_types.h"
+
+namespace google_breakpad {
+
+class CodeModule;
+class ProcessState;
+
+class UnwindStatistics {
+ public:
+  // The frames that one method found, and how many of them were
+  // confirmed.
+  struct MethodCounts {
+    MethodCounts() : frames(0), confirmed(0) {}
+
+    uint64_t frames;
+    uint64_t confirmed;
+  };
+
+  // The frames found from frames in one module, by method.
+  struct ModuleCounts {
+    MethodCounts cfi;
+    MethodCounts frame_pointer;
+    MethodCounts scan;
+  };
+
+  // Counts the callers found in every stack of |process_state|.  A
+  // caller is counted for the module of the frame it was found from.
+  // The last frame of each stack is not counted, as nothing shows
+  // whether it was right.
+  void Add(const ProcessState& process_state);
+
+  // The counts, by debug file name.
+  const std::map<string, ModuleCounts>& modules() const { return modules_; }
+
+ private:
+  std::map<string, ModuleCounts> modules_;
+};
+
+class UnwindPolicy {
+ public:
+  // The methods of finding a frame's caller, as a bit mask.
+  enum Method {
+    METHOD_CFI = 1 << 0,
+    METHOD_FRAME_POINTER = 1 << 1,
+    METHOD_SCAN = 1 << 2,
+    ALL_METHODS = METHOD_CFI | METHOD_FRAME_POINTER | METHOD_SCAN
+  };
+
+  // The thresholds with which Update changes a module's methods.
+  struct UpdateOptions {
+    UpdateOptions()
+        : min_frames(100),
+          min_confirmed_fraction(0.2),
+          reliable_fraction(0.99) {}
+
+    // The frames a method must have found from a module before its
+    // results change the module's methods.
+    uint64_t min_frames;
+
+    // Frame pointer recovery and stack scanning are skipped for a module
+    // when fewer of the frames they found were confirmed.
+    double min_confirmed_fraction;
+
+    // Stack walking information is skipped for a module when it never
+    // found a frame, and at least this much of the frames found by the
+    // frame pointer were confirmed.
+    double reliable_fraction;
+  };
+
+  UnwindPolicy() {}
+
+  // Replaces the policy with the one in |text|, in the file format
+  // described above.  Returns false, leaving the policy empty, if a line
+  // is malformed.
+  bool Parse(const string& text);
+
+  // Replaces the policy with the one in the file at |path|.  Returns
+  // false if the file can't be read or is malformed.
+  bool LoadFromFile(const string& path);
+
+  // Returns the policy in the file format, with modules in name order.
+  string Serialize() const;
+
+  // Sets the methods for frames in the module with the debug file name
+  // |module| to |methods|, a combination of Method values.
+  void SetModuleMethods(const string& module, int methods);
+
+  // Returns the methods to try for frames in |module|, which may be NULL.
+  int AllowedMethods(const CodeModule* module) const;
+
+  // Skips, for each module in |statistics|, the methods that the
+  // thresholds in |options| show to be futile.  Methods are only ever
+  // removed: a method a module doesn't try gathers no evidence for it.
+  void Update(const UnwindStatistics& statistics,
+              const UpdateOptions& options);
+
+  // The number of modules with methods set.
+  size_t module_count() const { return modules_.size(); }
+
+ private:
+  // Methods by debug file name.
+  std::map<string, int> modules_;
+};
+
+}  // namespace google_breakpad
+
+#endif  // GOOGLE_BREAKPAD_PROCESSOR_UNWIND_POLICY_H__
@@ -0,0 +1,131 @@
+// Copyright (c) 2016 Google Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+// notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above
+// copyright notice, this list of conditions and the following disclaimer
+// in the documentation and/or other materials provided with the
+// distribution.
+//     * Neither the name of Google Inc. nor the names of its
+// contributors may be used to endorse or promote products derived from
+// this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+// walk_budget.h: WalkBudget, a limit on the work the stack walks of one
+// minidump may do.
+//
+// Stackwalker stops a walk after max_frames frames, and stops scanning for
+// return addresses after max_frames_scanned scanned frames, but a minidump
+// with a corrupt stack can still keep a walker busy for a long time: each
+// scan reads and looks up dozens of stack words, and every module that a
+// scanned address lands in may need its symbols loaded.  A WalkBudget
+// bounds the time, frames, scanned stack words and symbol bytes that all
+// of a minidump's walks may use between them.  Once any of them runs out,
+// each walk stops at its next frame, keeping the frames it has, and its
+// CallStack is marked truncated.  A thread walked after the budget ran out
+// keeps just its context frame.
+//
+// MinidumpProcessor creates a WalkBudget for each minidump it processes
+// from the limits given to MinidumpProcessor::set_walk_budget_limits.  The
+// walkers of one minidump may share a budget from any number of threads.
+
+#ifndef GOOGLE_BREAKPAD_PROCESSOR_WALK_BUDGET_H__
+#define GOOGLE_BREAKPAD_PROCESSOR_WALK_BUDGET_H__
+
+#include "google_breakpad/common/breakpad_types.h"
+
+namespace google_breakpad {
+
+class Mutex;
+class Stopwatch;
+
+class WalkBudget {
+ public:
+  // What a budget allows.  0 means no limit.
+  struct Limits {
+    Limits() : seconds(0), frames(0), scanned_words(0), symbol_bytes(0) {}
+
+    // Returns true if nothing is limited.
+    bool IsUnlimited() const {
+      return seconds <= 0 && frames == 0 && scanned_words == 0 &&
+             symbol_bytes == 0;
+    }
+
+    // The wall-clock time, in seconds, from the budget's creation.
+    double seconds;
+
+    // The frames walked, across all threads.
+    uint64_t frames;
+
+    // The stack words read while scanning for return addresses.
+    uint64_t scanned_words;
+
+    // The size of the symbol data read into memory to symbolize frames.
+    uint64_t symbol_bytes;
+  };
+
+  // Creates a budget with |limits|, whose time starts running at once.
+  explicit WalkBudget(const Limits& limits);
+  ~WalkBudget();
+
+  // Counts one frame.  Returns false if the budget has run out, in which
+  // case the walk should stop.
+  bool ChargeFrame();
+
+  // Counts |words| scanned stack words.  Returns false if the budget has
+  // run out, in which case the scan should stop.
+  bool ChargeScannedWords(uint64_t words);
+
+  // Counts |bytes| of symbol data.  Walks notice when this exhausts the
+  // budget at their next frame.
+  void ChargeSymbolBytes(uint64_t bytes);
+
+  // Returns true once any limit has been reached.
+  bool exhausted() const;
+
+  const Limits& limits() const { return limits_; }
+
+  // What has been charged so far.
+  uint64_t frames() const;
+  uint64_t scanned_words() const;
+  uint64_t symbol_bytes() const;
+
+ private:
+  // Returns true, and remembers it, if any limit has been reached.  Must
+  // be called with mutex_ held.
+  bool CheckExhaustedLocked();
+
+  const Limits limits_;
+  Stopwatch* stopwatch_;
+
+  uint64_t frames_;
+  uint64_t scanned_words_;
+  uint64_t symbol_bytes_;
+  bool exhausted_;
+
+  Mutex* mutex_;
+
+  // Disallow copy constructor and assignment operator.
+  WalkBudget(const WalkBudget&);
+  void operator=(const WalkBudget&);
+};
+
+}  // namespace google_breakpad
+
+#endif  // GOOGLE_BREAKPAD_PROCESSOR_WALK_BUDGET_H__
@@ -39,7 +39,6 @@
 #include <assert.h>
 
 #include "google_breakpad/processor/code_module.h"
-#include "processor/linked_ptr.h"
 #include "processor/logging.h"
 #include "processor/range_map-inl.h"
 
@@ -47,7 +46,7 @@ namespace google_breakpad {
 
 BasicCodeModules::BasicCodeModules(const CodeModules *that)
     : main_address_(0),
-      map_(new RangeMap<uint64_t, linked_ptr<const CodeModule> >()) {
+      map_(new RangeMap<uint64_t, const CodeModule*>()) {
   BPLOG_IF(ERROR, !that) << "BasicCodeModules::BasicCodeModules requires "
                             "|that|";
   assert(that);
@@ -64,37 +63,61 @@ BasicCodeModules::BasicCodeModules(const CodeModules *that)
     // GetModuleAtIndex because ordering is unimportant when slurping the
     // entire list, and GetModuleAtIndex may be faster than
     // GetModuleAtSequence.
-    linked_ptr<const CodeModule> module(
-        that->GetModuleAtIndex(module_sequence)->Copy());
-    if (!map_->StoreRange(module->base_address(), module->size(), module)) {
-      BPLOG(ERROR) << "Module " << module->code_file() <<
-                      " could not be stored";
-    }
+    StoreModule(that->GetModuleAtIndex(module_sequence)->Copy());
   }
+
+  // Copies are not modified after construction, and are searched for every
+  // frame the stackwalker examines.
+  map_->Freeze();
 }
 
 BasicCodeModules::BasicCodeModules()
   : main_address_(0),
-    map_(new RangeMap<uint64_t, linked_ptr<const CodeModule> >()) {
+    map_(new RangeMap<uint64_t, const CodeModule*>()) {
 }
 
 BasicCodeModules::~BasicCodeModules() {
+  int count = map_->GetCount();
+  for (int index = 0; index < count; ++index) {
+    const CodeModule *module;
+    if (map_->RetrieveRangeAtIndex(index, &module, NULL, NULL))
+      delete module;
+  }
   delete map_;
 }
 
+bool BasicCodeModules::StoreModule(const CodeModule *module) {
+  if (!map_->StoreRange(module->base_address(), module->size(), module)) {
+    BPLOG(ERROR) << "Module " << module->code_file() <<
+                    " could not be stored";
+    delete module;
+    return false;
+  }
+  return true;
+}
+
 unsigned int BasicCodeModules::module_count() const {
   return map_->GetCount();
 }
 
 const CodeModule* BasicCodeModules::GetModuleForAddress(
     uint64_t address) const {
-  linked_ptr<const CodeModule> module;
+  const CodeModule *module;
   if (!map_->RetrieveRange(address, &module, NULL, NULL)) {
     BPLOG(INFO) << "No module at " << HexString(address);
     return NULL;
   }
 
-  return module.get();
+  return module;
+}
+
+void BasicCodeModules::GetModulesForAddresses(
+    const uint64_t* addresses, size_t count,
+    const CodeModule** modules) const {
+  if (count == 0)
+    return;
+
+  map_->RetrieveRanges(addresses, count, NULL, modules);
 }
 
 const CodeModule* BasicCodeModules::GetMainModule() const {
@@ -103,13 +126,13 @@ const CodeModule* BasicCodeModules::GetMainModule() const {
 
 const CodeModule* BasicCodeModules::GetModuleAtSequence(
     unsigned int sequence) const {
-  linked_ptr<const CodeModule> module;
+  const CodeModule *module;
   if (!map_->RetrieveRangeAtIndex(sequence, &module, NULL, NULL)) {
     BPLOG(ERROR) << "RetrieveRangeAtIndex failed for sequence " << sequence;
     return NULL;
   }
 
-  return module.get();
+  return module;
 }
 
 const CodeModule* BasicCodeModules::GetModuleAtIndex(
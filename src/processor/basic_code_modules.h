@@ -45,7 +45,6 @@
 
 namespace google_breakpad {
 
-template<typename T> class linked_ptr;
 template<typename AddressType, typename EntryType> class RangeMap;
 
 class BasicCodeModules : public CodeModules {
@@ -54,7 +53,9 @@ class BasicCodeModules : public CodeModules {
   // implementation.  This is useful to make a copy of the data relevant to
   // the CodeModules and CodeModule interfaces without requiring all of the
   // resources that other implementations may require.  A copy will be
-  // made of each contained CodeModule using CodeModule::Copy.
+  // made of each contained CodeModule using CodeModule::Copy.  The copy is
+  // not modified afterwards, so it may be searched by several threads at
+  // once.
   explicit BasicCodeModules(const CodeModules *that);
 
   virtual ~BasicCodeModules();
@@ -62,6 +63,9 @@ class BasicCodeModules : public CodeModules {
   // See code_modules.h for descriptions of these methods.
   virtual unsigned int module_count() const;
   virtual const CodeModule* GetModuleForAddress(uint64_t address) const;
+  virtual void GetModulesForAddresses(const uint64_t* addresses,
+                                      size_t count,
+                                      const CodeModule** modules) const;
   virtual const CodeModule* GetMainModule() const;
   virtual const CodeModule* GetModuleAtSequence(unsigned int sequence) const;
   virtual const CodeModule* GetModuleAtIndex(unsigned int index) const;
@@ -70,12 +74,18 @@ class BasicCodeModules : public CodeModules {
  protected:
   BasicCodeModules();
 
+  // Adds |module|, taking ownership of it.  Returns false, deleting
+  // |module|, if it overlaps a module already added.
+  bool StoreModule(const CodeModule *module);
+
   // The base address of the main module.
   uint64_t main_address_;
 
   // The map used to contain each CodeModule, keyed by each CodeModule's
-  // address range.
-  RangeMap<uint64_t, linked_ptr<const CodeModule> > *map_;
+  // address range.  The map owns the modules.  Lookups hand out plain
+  // pointers rather than reference-counted ones, so that they don't write
+  // to the map.
+  RangeMap<uint64_t, const CodeModule*> *map_;
 
  private:
   // Disallow copy constructor and assignment operator.
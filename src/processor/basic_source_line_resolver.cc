@@ -38,17 +38,26 @@
 #include <sys/types.h>
 #include <sys/stat.h>
 
+#ifndef _WIN32
+#include <pthread.h>
+#endif  // _WIN32
+
+#include <algorithm>
+#include <deque>
 #include <limits>
 #include <map>
 #include <utility>
 #include <vector>
 
+#include "common/scoped_ptr.h"
 #include "google_breakpad/processor/basic_source_line_resolver.h"
+#include "google_breakpad/processor/task_executor.h"
 #include "processor/basic_source_line_resolver_types.h"
+#include "processor/logging.h"
 #include "processor/module_factory.h"
+#include "processor/symbol_file_decompressor.h"
 
-#include "processor/tokenize.h"
-
+using std::deque;
 using std::map;
 using std::vector;
 using std::make_pair;
@@ -64,6 +73,24 @@ static const char *kWhitespace = " \r\n";
 static const int kMaxErrorsPrinted = 5;
 static const int kMaxErrorsBeforeBailing = 100;
 
+// Symbol data is only split among loader threads if each would get at least
+// this many bytes of it.
+static const size_t kMinBytesPerLoadThread = 1 << 20;
+
+// Compressed symbol files are decompressed and parsed in blocks of about
+// this many bytes, and at most this many blocks wait to be parsed.
+static const size_t kDecompressedBlockSize = 1 << 20;
+static const size_t kMaxQueuedBlocks = 2;
+
+// For GetMemoryUsage: the bytes a std::map node takes beside its value,
+// and the bytes a string's characters take.
+static const size_t kMapNodeBytes = 4 * sizeof(void *);
+static size_t StringBytes(const string &s) { return s.capacity() + 1; }
+
+unsigned int BasicSourceLineResolver::load_thread_count_ = 1;
+TaskExecutor *BasicSourceLineResolver::load_executor_ = NULL;
+bool BasicSourceLineResolver::huge_page_arenas_ = false;
+
 BasicSourceLineResolver::BasicSourceLineResolver() :
     SourceLineResolverBase(new BasicModuleFactory) { }
 
@@ -81,13 +108,222 @@ void BasicSourceLineResolver::Module::LogParseError(
   }
 }
 
+// A record parsed from the symbol data.  Line records that follow a
+// function in the same chunk are added to it directly, and never become
+// Records.  A Record owns the objects it points to until StoreRecord takes
+// them over.
+struct BasicSourceLineResolver::Module::Record {
+  enum Kind {
+    NO_RECORD,         // A MODULE or INFO line, which are ignored.
+    ERROR_RECORD,      // A line that couldn't be parsed.
+    FILE_RECORD,       // FILE: |index| and |text| are set.
+    FUNC_RECORD,       // FUNC: |function|, NULL if the line was bad.
+    LINE_RECORD,       // A line record that may belong to a function in an
+                       // earlier chunk: |line|, unless |error| is set.
+    PUBLIC_RECORD,     // PUBLIC: |public_symbol|, NULL if it is ignored.
+    STACK_WIN_RECORD,  // STACK WIN: |frame_info|, and its type in |index|.
+    STACK_CFI_INIT_RECORD,  // STACK CFI INIT: |address|, |size|, |text|.
+    STACK_CFI_RECORD   // STACK CFI: |address| and |text|.
+  };
+
+  Record()
+      : kind(NO_RECORD), line_number(0), error(NULL), index(0), address(0),
+        size(0), text(NULL), function(NULL), line(), public_symbol(NULL),
+        frame_info(NULL) { }
+
+  Kind kind;
+
+  // The record's line number, counted from the start of its chunk.
+  int line_number;
+
+  // If non-NULL, the parse error to log when the record is stored.
+  const char *error;
+
+  long index;
+  MemAddr address;
+  MemAddr size;
+
+  // Points into the symbol data.
+  const char *text;
+
+  Function *function;
+  Line line;
+  PublicSymbol *public_symbol;
+  WindowsFrameInfo *frame_info;
+};
+
+struct BasicSourceLineResolver::Module::Chunk : public Task {
+  Chunk()
+      : module(NULL), arena(NULL), buffer(NULL), follows_records(false),
+        line_count(0), num_errors(0) { }
+
+  ~Chunk() {
+    // Free whatever wasn't stored, if storing stopped early.
+    for (vector<Record>::iterator record = records.begin();
+         record != records.end(); ++record) {
+      delete record->function;
+      delete record->public_symbol;
+      delete record->frame_info;
+    }
+  }
+
+  // Parses the chunk on an executor thread, leaving its records for
+  // StoreRecord.
+  virtual void Run() { module->ParseRecords(this, NULL); }
+
+  Module *module;
+
+  // Where the functions and public symbols parsed from the chunk are
+  // allocated: the module's arena, or for a chunk parsed on a loader
+  // thread, |own_arena|, which the module's arena adopts once the chunk is
+  // stored.
+  ModuleArena *arena;
+  scoped_ptr<ModuleArena> own_arena;
+
+  // The chunk's null-terminated symbol data.
+  char *buffer;
+
+  // True if the chunk isn't at the start of the symbol data, in which case
+  // line records at its start may belong to a function in an earlier chunk.
+  bool follows_records;
+
+  // The number of lines parsed, and the parse errors found among them.
+  int line_count;
+  int num_errors;
+
+  vector<Record> records;
+
+  // The lines of the functions among |records|, until StoreRecord moves
+  // them to the module's table.
+  vector<Line> lines;
+};
+
+struct BasicSourceLineResolver::Module::StoreState {
+  StoreState() : first_line_number(0), num_errors(0), copy_cfi_rules(false) { }
+
+  struct CStringLess {
+    bool operator()(const char *s1, const char *s2) const {
+      return strcmp(s1, s2) < 0;
+    }
+  };
+
+  // The function that line records are added to, if any.
+  linked_ptr<Function> cur_func;
+
+  // The number of lines in the chunks before the one being stored, used to
+  // turn record line numbers into symbol file line numbers.
+  int first_line_number;
+
+  int num_errors;
+
+  // The index in cfi_rules_ of each rule set stored so far, keyed by its
+  // text in the symbol data.
+  map<const char *, int, CStringLess> cfi_rule_indices;
+
+  // True if the symbol data is freed a block at a time while loading, in
+  // which case the keys of cfi_rule_indices point into cfi_rule_texts
+  // instead.
+  bool copy_cfi_rules;
+  deque<string> cfi_rule_texts;
+};
+
+struct BasicSourceLineResolver::Module::LazyState {
+  LazyState() : windows_frame_info_loaded(false), freeze(false) {
+    // Blocks are freed once they are stored.
+    state.copy_cfi_rules = true;
+  }
+
+  scoped_ptr<SymbolFileIndex> index;
+
+  // Whether each block of each kind in the index has been stored.
+  vector<bool> loaded[SymbolFileIndex::KIND_COUNT];
+
+  bool windows_frame_info_loaded;
+
+  // True if Freeze was called before the STACK WIN records were loaded.
+  bool freeze;
+
+  // Kept from one block to the next, so that each CFI rule set is stored
+  // once.
+  StoreState state;
+};
+
+// static
+bool BasicSourceLineResolver::Function::AddressBeforeLine(MemAddr address,
+                                                          const Line &line) {
+  return address < line.address;
+}
+
+const BasicSourceLineResolver::Line *
+BasicSourceLineResolver::Function::FindLine(MemAddr address) const {
+  if (line_count == 0)
+    return NULL;
+  const Line *begin = &(*line_table)[first_line];
+  const Line *end = begin + line_count;
+  const Line *line = std::upper_bound(begin, end, address, AddressBeforeLine);
+  if (line == begin)
+    return NULL;
+  --line;
+  // Compare in an overflow-friendly way.
+  if (address - line->address >= line->size)
+    return NULL;
+  return line;
+}
+
+bool BasicSourceLineResolver::Function::AddLine(const Line &line,
+                                                vector<Line> *table) {
+  MemAddr high = line.address + line.size - 1;
+  if (line.size == 0 || high < line.address) {
+    BPLOG_IF(INFO, line.size != 0) << "AddLine failed, " <<
+                                      HexString(line.address) << "+" <<
+                                      HexString(line.size) << ", " <<
+                                      HexString(high);
+    return false;
+  }
+
+  // Lines are only ever added at the end of the table, so that inserting
+  // one moves no other function's lines.
+  MoveLines(table);
+
+  vector<Line>::iterator begin = table->begin() + first_line;
+  vector<Line>::iterator position =
+      std::upper_bound(begin, table->end(), line.address, AddressBeforeLine);
+  if (position != begin) {
+    const Line &previous = *(position - 1);
+    if (line.address - previous.address < previous.size)
+      return false;
+  }
+  if (position != table->end() && position->address <= high)
+    return false;
+
+  table->insert(position, line);
+  ++line_count;
+  return true;
+}
+
+void BasicSourceLineResolver::Function::MoveLines(vector<Line> *table) {
+  if (line_table == table && first_line + line_count == table->size())
+    return;
+
+  size_t new_first_line = table->size();
+  if (line_count > 0) {
+    // Copied first, as the lines may come from |table| itself.
+    vector<Line> lines(line_table->begin() + first_line,
+                       line_table->begin() + first_line + line_count);
+    table->insert(table->end(), lines.begin(), lines.end());
+  }
+  line_table = table;
+  first_line = new_first_line;
+}
+
+BasicSourceLineResolver::Module::~Module() {
+  delete lazy_;
+}
+
 bool BasicSourceLineResolver::Module::LoadMapFromMemory(
     char *memory_buffer,
     size_t memory_buffer_size) {
-  linked_ptr<Function> cur_func;
-  int line_number = 0;
-  int num_errors = 0;
-  char *save_ptr;
+  StoreState state;
 
   // If the length is 0, we can still pretend we have a symbol file. This is
   // for scenarios that want to test symbol lookup, but don't necessarily care
@@ -118,40 +354,439 @@ bool BasicSourceLineResolver::Module::LoadMapFromMemory(
   if (has_null_terminator_in_the_middle) {
     LogParseError(
        "Null terminator is not expected in the middle of the symbol data",
-       line_number,
-       &num_errors);
+       0,
+       &state.num_errors);
   }
 
+  if (!ParseRecordsInParallel(memory_buffer, last_null_terminator, &state)) {
+    Chunk chunk;
+    chunk.module = this;
+    chunk.arena = &arena_;
+    chunk.buffer = memory_buffer;
+    ParseRecords(&chunk, &state);
+  }
+  if (state.num_errors > 0)
+    is_corrupt_ = true;
+  return true;
+}
+
+bool BasicSourceLineResolver::Module::LoadMapWithoutSourceLinesFromMemory(
+    char *memory_buffer,
+    size_t memory_buffer_size) {
+  load_phase_ = LOAD_WITHOUT_SOURCE_LINES;
+  bool result = LoadMapFromMemory(memory_buffer, memory_buffer_size);
+  load_phase_ = LOAD_ALL;
+  source_lines_deferred_ = true;
+  return result;
+}
+
+bool BasicSourceLineResolver::Module::LoadSourceLinesFromMemory(
+    char *memory_buffer,
+    size_t memory_buffer_size) {
+  if (!source_lines_deferred_)
+    return false;
+  load_phase_ = LOAD_SOURCE_LINES;
+  bool result = LoadMapFromMemory(memory_buffer, memory_buffer_size);
+  load_phase_ = LOAD_ALL;
+  source_lines_deferred_ = false;
+  return result;
+}
+
+namespace {
+
+// Reads the symbol data from a SymbolFileDecompressor in null-terminated
+// blocks that end at line breaks.
+class SymbolBlockReader {
+ public:
+  explicit SymbolBlockReader(SymbolFileDecompressor *decompressor)
+      : decompressor_(decompressor), data_size_(0), done_(false),
+        failed_(false) { }
+
+  // Returns the next block, which the caller must delete[], and sets
+  // |*block_size| to its size, not counting the null terminator.  Returns
+  // NULL at the end of the data, or if it can't be read.
+  char *ReadBlock(size_t *block_size) {
+    if (done_)
+      return NULL;
+
+    // The block starts with the partial line left over from the last one.
+    size_t capacity = kDecompressedBlockSize;
+    if (capacity < leftover_.size() * 2)
+      capacity = leftover_.size() * 2;
+    scoped_array<char> block(new char[capacity + 1]);
+    memcpy(block.get(), leftover_.data(), leftover_.size());
+    size_t size = leftover_.size();
+    leftover_.clear();
+
+    while (true) {
+      bool at_end = false;
+      while (size < capacity) {
+        size_t bytes_read;
+        if (!decompressor_->Read(block.get() + size, capacity - size,
+                                 &bytes_read)) {
+          done_ = failed_ = true;
+          return NULL;
+        }
+        if (bytes_read == 0) {
+          at_end = true;
+          break;
+        }
+        size += bytes_read;
+      }
+
+      if (at_end) {
+        done_ = true;
+        if (size == 0)
+          return NULL;
+        break;
+      }
+
+      // End the block after its last line break, and keep the rest for the
+      // next one.
+      size_t end = size;
+      while (end > 0 && block[end - 1] != '\n' && block[end - 1] != '\r')
+        --end;
+      if (end > 0) {
+        leftover_.assign(block.get() + end, size - end);
+        size = end;
+        break;
+      }
+
+      // A single line fills the block; make room for more of it.
+      scoped_array<char> larger(new char[capacity * 2 + 1]);
+      memcpy(larger.get(), block.get(), size);
+      block.swap(larger);
+      capacity *= 2;
+    }
+
+    block[size] = '\0';
+    data_size_ += size;
+    *block_size = size;
+    return block.release();
+  }
+
+  // The number of bytes returned in blocks so far.
+  size_t data_size() const { return data_size_; }
+
+  // True if the data couldn't all be read.
+  bool failed() const { return failed_; }
+
+ private:
+  SymbolFileDecompressor *decompressor_;
+  string leftover_;
+  size_t data_size_;
+  bool done_;
+  bool failed_;
+};
+
+}  // namespace
+
+#ifndef _WIN32
+struct BasicSourceLineResolver::Module::BlockQueue {
+  explicit BlockQueue(SymbolFileDecompressor *decompressor)
+      : reader(decompressor), finished(false), cancelled(false) {
+    pthread_mutex_init(&mutex, NULL);
+    pthread_cond_init(&changed, NULL);
+  }
+
+  ~BlockQueue() {
+    for (size_t i = 0; i < blocks.size(); ++i)
+      delete [] blocks[i].first;
+    pthread_cond_destroy(&changed);
+    pthread_mutex_destroy(&mutex);
+  }
+
+  SymbolBlockReader reader;
+
+  // Guards the members below, and is signalled when they change.
+  pthread_mutex_t mutex;
+  pthread_cond_t changed;
+
+  // Blocks that are ready to parse, with their sizes.
+  deque<std::pair<char *, size_t> > blocks;
+
+  // Set by the decompressing thread once it has queued the last block.
+  bool finished;
+
+  // Set by the parsing thread to stop the decompressing thread early.
+  bool cancelled;
+};
+
+// static
+void *BasicSourceLineResolver::Module::DecompressThreadMain(void *arg) {
+  BlockQueue *queue = static_cast<BlockQueue*>(arg);
+  while (true) {
+    size_t block_size = 0;
+    char *block = queue->reader.ReadBlock(&block_size);
+
+    pthread_mutex_lock(&queue->mutex);
+    while (block && !queue->cancelled &&
+           queue->blocks.size() >= kMaxQueuedBlocks) {
+      pthread_cond_wait(&queue->changed, &queue->mutex);
+    }
+    bool stop = !block || queue->cancelled;
+    if (stop) {
+      delete [] block;
+      queue->finished = true;
+    } else {
+      queue->blocks.push_back(make_pair(block, block_size));
+    }
+    pthread_cond_broadcast(&queue->changed);
+    pthread_mutex_unlock(&queue->mutex);
+    if (stop)
+      return NULL;
+  }
+}
+#endif  // _WIN32
+
+bool BasicSourceLineResolver::Module::LoadMapFromDecompressor(
+    SymbolFileDecompressor *decompressor, size_t *data_size) {
+  StoreState state;
+  // Each block is freed once it is stored, so CFI rule sets can't be
+  // looked up by the text in the symbol data.
+  state.copy_cfi_rules = true;
+  bool first_block = true;
+  bool failed;
+
+#ifndef _WIN32
+  BlockQueue queue(decompressor);
+  pthread_t thread;
+  if (pthread_create(&thread, NULL, DecompressThreadMain, &queue) == 0) {
+    while (true) {
+      pthread_mutex_lock(&queue.mutex);
+      while (queue.blocks.empty() && !queue.finished)
+        pthread_cond_wait(&queue.changed, &queue.mutex);
+      if (queue.blocks.empty()) {
+        pthread_mutex_unlock(&queue.mutex);
+        break;
+      }
+      scoped_array<char> block(queue.blocks.front().first);
+      size_t block_size = queue.blocks.front().second;
+      queue.blocks.pop_front();
+      pthread_cond_broadcast(&queue.changed);
+      pthread_mutex_unlock(&queue.mutex);
+
+      ParseBlock(block.get(), block_size, first_block, &state);
+      first_block = false;
+      if (state.num_errors > kMaxErrorsBeforeBailing)
+        break;
+    }
+
+    pthread_mutex_lock(&queue.mutex);
+    queue.cancelled = true;
+    pthread_cond_broadcast(&queue.changed);
+    pthread_mutex_unlock(&queue.mutex);
+    pthread_join(thread, NULL);
+
+    *data_size = queue.reader.data_size();
+    failed = queue.reader.failed();
+    is_corrupt_ = state.num_errors > 0;
+    return !failed;
+  }
+  BPLOG(ERROR) << "Could not create decompressing thread; decompressing "
+                  "on the loading thread";
+#endif  // _WIN32
+
+  SymbolBlockReader reader(decompressor);
+  size_t block_size;
+  char *block_data;
+  while ((block_data = reader.ReadBlock(&block_size)) != NULL) {
+    scoped_array<char> block(block_data);
+    ParseBlock(block.get(), block_size, first_block, &state);
+    first_block = false;
+    if (state.num_errors > kMaxErrorsBeforeBailing)
+      break;
+  }
+  *data_size = reader.data_size();
+  failed = reader.failed();
+  is_corrupt_ = state.num_errors > 0;
+  return !failed;
+}
+
+bool BasicSourceLineResolver::Module::LoadMapFromIndexedFile(
+    const string &map_file, const string &index_file) {
+  SymbolFileIndex *index = SymbolFileIndex::Open(map_file, index_file);
+  if (!index)
+    return false;
+
+  lazy_ = new LazyState();
+  lazy_->index.reset(index);
+  for (int kind = 0; kind < SymbolFileIndex::KIND_COUNT; ++kind) {
+    lazy_->loaded[kind].resize(
+        index->entry_count(static_cast<SymbolFileIndex::Kind>(kind)), false);
+  }
+  return true;
+}
+
+void BasicSourceLineResolver::Module::LoadIndexedRecords(MemAddr address) {
+  size_t i;
+  if (lazy_->index->FindNearest(SymbolFileIndex::FUNCTIONS, address, &i))
+    LoadIndexedBlock(SymbolFileIndex::FUNCTIONS, i);
+  if (lazy_->index->FindNearest(SymbolFileIndex::PUBLICS, address, &i))
+    LoadIndexedBlock(SymbolFileIndex::PUBLICS, i);
+}
+
+void BasicSourceLineResolver::Module::LoadIndexedFile(int id) {
+  size_t i;
+  if (id >= 0 &&
+      lazy_->index->FindNearest(SymbolFileIndex::FILES, id, &i) &&
+      lazy_->index->entry(SymbolFileIndex::FILES, i).address ==
+          static_cast<uint64_t>(id)) {
+    LoadIndexedBlock(SymbolFileIndex::FILES, i);
+  }
+}
+
+void BasicSourceLineResolver::Module::LoadIndexedCFI(MemAddr address) {
+  size_t i;
+  if (lazy_->index->FindNearest(SymbolFileIndex::CFI, address, &i))
+    LoadIndexedBlock(SymbolFileIndex::CFI, i);
+}
+
+void BasicSourceLineResolver::Module::LoadIndexedWindowsFrameInfo() {
+  if (lazy_->windows_frame_info_loaded)
+    return;
+  lazy_->windows_frame_info_loaded = true;
+  size_t count = lazy_->index->entry_count(SymbolFileIndex::WINDOWS);
+  for (size_t i = 0; i < count; ++i)
+    LoadIndexedBlock(SymbolFileIndex::WINDOWS, i);
+  if (lazy_->freeze)
+    FreezeWindowsFrameInfo();
+}
+
+void BasicSourceLineResolver::Module::LoadIndexedBlock(
+    SymbolFileIndex::Kind kind, size_t i) {
+  if (lazy_->loaded[kind][i])
+    return;
+  lazy_->loaded[kind][i] = true;
+
+  // Line numbers in parse errors count from the start of the block, and
+  // each block may log its own errors.
+  StoreState *state = &lazy_->state;
+  state->first_line_number = 0;
+  state->num_errors = 0;
+
+  const SymbolFileIndexEntry &entry = lazy_->index->entry(kind, i);
+  const char *text = lazy_->index->BlockText(entry);
+  if (!text) {
+    LogParseError("Symbol file index entry lies outside the symbol file", 0,
+                  &state->num_errors);
+    is_corrupt_ = true;
+    return;
+  }
+  size_t length = static_cast<size_t>(entry.length);
+  scoped_array<char> block(new char[length + 1]);
+  memcpy(block.get(), text, length);
+  block[length] = '\0';
+  ParseBlock(block.get(), length, true, state);
+
+  // Line records in later blocks never belong to this block's function.
+  state->cur_func.reset();
+  if (state->num_errors > 0)
+    is_corrupt_ = true;
+}
+
+void BasicSourceLineResolver::Module::ParseBlock(char *block,
+                                                 size_t block_size,
+                                                 bool first_block,
+                                                 StoreState *state) {
+  bool has_null_terminator = false;
+  for (size_t i = 0; i < block_size; ++i) {
+    if (block[i] == '\0') {
+      block[i] = '_';
+      has_null_terminator = true;
+    }
+  }
+  if (has_null_terminator) {
+    LogParseError(
+       "Null terminator is not expected in the middle of the symbol data",
+       0,
+       &state->num_errors);
+  }
+
+  Chunk chunk;
+  chunk.module = this;
+  chunk.arena = &arena_;
+  chunk.buffer = block;
+  chunk.follows_records = !first_block;
+  ParseRecords(&chunk, state);
+  state->first_line_number += chunk.line_count;
+}
+
+void BasicSourceLineResolver::Module::ParseRecords(Chunk *chunk,
+                                                   StoreState *state) {
+  // The function that line records belong to.  In a chunk that follows
+  // others, it isn't known until the chunk's first FUNC or PUBLIC record.
+  Function *cur_func = NULL;
+  bool cur_func_known = !chunk->follows_records;
+  // Whether to pass over line records: those of a load without source
+  // lines, and, when adding source lines, those of a function that wasn't
+  // loaded.
+  bool skip_lines = load_phase_ == LOAD_WITHOUT_SOURCE_LINES;
+  // Where line records are added to |cur_func|: records that aren't stored
+  // right away can't touch the module.
+  vector<Line> *line_table = state ? &lines_ : &chunk->lines;
+  int line_number = 0;
+  char *save_ptr;
+
   char *buffer;
-  buffer = strtok_r(memory_buffer, "\r\n", &save_ptr);
+  buffer = strtok_r(chunk->buffer, "\r\n", &save_ptr);
 
   while (buffer != NULL) {
     ++line_number;
 
-    if (strncmp(buffer, "FILE ", 5) == 0) {
-      if (!ParseFile(buffer)) {
-        LogParseError("ParseFile on buffer failed", line_number, &num_errors);
+    Record record;
+    record.line_number = line_number;
+    if (strncmp(buffer, "FILE ", 5) == 0 &&
+        load_phase_ == LOAD_WITHOUT_SOURCE_LINES) {
+      // Loaded with the source lines.
+    } else if (strncmp(buffer, "FILE ", 5) == 0) {
+      record.kind = Record::FILE_RECORD;
+      if (!ParseFile(buffer, &record)) {
+        record.kind = Record::ERROR_RECORD;
+        record.error = "ParseFile on buffer failed";
       }
     } else if (strncmp(buffer, "STACK ", 6) == 0) {
-      if (!ParseStackInfo(buffer)) {
-        LogParseError("ParseStackInfo failed", line_number, &num_errors);
+      if (load_phase_ == LOAD_SOURCE_LINES) {
+        // Loaded with the rest of the map.
+      } else if (!ParseStackInfo(buffer, &record)) {
+        record.kind = Record::ERROR_RECORD;
+        record.error = "ParseStackInfo failed";
+      }
+    } else if (strncmp(buffer, "FUNC ", 5) == 0 &&
+               load_phase_ == LOAD_SOURCE_LINES) {
+      // Add the lines that follow to the function loaded with the rest of
+      // the map.  A function that failed to parse was counted as an error
+      // then.
+      uint64_t address;
+      uint64_t size;
+      long stack_param_size;
+      char *name;
+      cur_func = NULL;
+      if (SymbolParseHelper::ParseFunction(buffer, &address, &size,
+                                           &stack_param_size, &name)) {
+        cur_func = FindLoadedFunction(address, size);
       }
+      cur_func_known = true;
+      skip_lines = !cur_func;
     } else if (strncmp(buffer, "FUNC ", 5) == 0) {
-      cur_func.reset(ParseFunction(buffer));
-      if (!cur_func.get()) {
-        LogParseError("ParseFunction failed", line_number, &num_errors);
-      } else {
-        // StoreRange will fail if the function has an invalid address or size.
-        // We'll silently ignore this, the function and any corresponding lines
-        // will be destroyed when cur_func is released.
-        functions_.StoreRange(cur_func->address, cur_func->size, cur_func);
+      record.kind = Record::FUNC_RECORD;
+      record.function = ParseFunction(buffer, chunk->arena);
+      if (!record.function) {
+        record.error = "ParseFunction failed";
       }
+      cur_func = record.function;
+      cur_func_known = true;
     } else if (strncmp(buffer, "PUBLIC ", 7) == 0) {
       // Clear cur_func: public symbols don't contain line number information.
-      cur_func.reset();
-
-      if (!ParsePublicSymbol(buffer)) {
-        LogParseError("ParsePublicSymbol failed", line_number, &num_errors);
+      cur_func = NULL;
+      cur_func_known = true;
+      skip_lines = load_phase_ == LOAD_WITHOUT_SOURCE_LINES;
+
+      if (load_phase_ != LOAD_SOURCE_LINES) {
+        record.kind = Record::PUBLIC_RECORD;
+        if (!ParsePublicSymbol(buffer, chunk->arena, &record)) {
+          record.error = "ParsePublicSymbol failed";
+        }
       }
     } else if (strncmp(buffer, "MODULE ", 7) == 0) {
       // Ignore these.  They're not of any use to BasicSourceLineResolver,
@@ -164,31 +799,316 @@ bool BasicSourceLineResolver::Module::LoadMapFromMemory(
       // Ignore these as well, they're similarly just for housekeeping.
       //
       // INFO CODE_ID <code id> <filename>
+    } else if (skip_lines) {
+      // Loaded later, or never, as the function isn't.
+    } else if (!cur_func_known) {
+      // Let StoreRecord find the function, once the earlier chunks have
+      // been stored.
+      record.kind = Record::LINE_RECORD;
+      if (!ParseLine(buffer, &record.line)) {
+        record.error = "ParseLine failed";
+      }
+    } else if (!cur_func) {
+      record.kind = Record::ERROR_RECORD;
+      record.error = "Found source line data without a function";
     } else {
-      if (!cur_func.get()) {
-        LogParseError("Found source line data without a function",
-                       line_number, &num_errors);
+      Line line;
+      if (!ParseLine(buffer, &line)) {
+        record.kind = Record::ERROR_RECORD;
+        record.error = "ParseLine failed";
       } else {
-        Line *line = ParseLine(buffer);
-        if (!line) {
-          LogParseError("ParseLine failed", line_number, &num_errors);
-        } else {
-          cur_func->lines.StoreRange(line->address, line->size,
-                                     linked_ptr<Line>(line));
-        }
+        cur_func->AddLine(line, line_table);
       }
     }
-    if (num_errors > kMaxErrorsBeforeBailing) {
+
+    if (record.kind != Record::NO_RECORD) {
+      if (record.error) {
+        ++chunk->num_errors;
+      }
+      if (state) {
+        StoreRecord(&record, state);
+      } else {
+        chunk->records.push_back(record);
+      }
+    }
+    if ((state ? state->num_errors : chunk->num_errors) >
+        kMaxErrorsBeforeBailing) {
       break;
     }
     buffer = strtok_r(NULL, "\r\n", &save_ptr);
   }
-  is_corrupt_ = num_errors > 0;
+  chunk->line_count = line_number;
+}
+
+bool BasicSourceLineResolver::Module::ParseRecordsInParallel(
+    char *memory_buffer, size_t data_size, StoreState *state) {
+#ifndef _WIN32
+  // Source lines are added to the functions already loaded, which
+  // StoreRecord doesn't know how to find.
+  if (load_phase_ == LOAD_SOURCE_LINES)
+    return false;
+
+  size_t chunk_count = BasicSourceLineResolver::load_thread_count();
+  if (chunk_count > data_size / kMinBytesPerLoadThread) {
+    chunk_count = data_size / kMinBytesPerLoadThread;
+  }
+  if (chunk_count < 2) {
+    return false;
+  }
+
+  // Split the data into roughly equal chunks by replacing a line break near
+  // each boundary with a null terminator.  If the data runs out of line
+  // breaks early, the last chunk just gets the rest.
+  scoped_array<Chunk> chunks(new Chunk[chunk_count]);
+  char *data_end = memory_buffer + data_size;
+  char *chunk_start = memory_buffer;
+  size_t used_chunks = 0;
+  while (used_chunks < chunk_count) {
+    Chunk *chunk = &chunks[used_chunks++];
+    chunk->module = this;
+    if (chunk == &chunks[0]) {
+      chunk->arena = &arena_;
+    } else {
+      chunk->own_arena.reset(new ModuleArena(arena_.huge_pages()));
+      chunk->arena = chunk->own_arena.get();
+    }
+    chunk->buffer = chunk_start;
+    chunk->follows_records = chunk_start != memory_buffer;
+    if (used_chunks == chunk_count) {
+      break;
+    }
+    char *split = memory_buffer + data_size / chunk_count * used_chunks;
+    if (split < chunk_start) {
+      split = chunk_start;
+    }
+    split = strpbrk(split, "\r\n");
+    if (!split || split + 1 >= data_end) {
+      break;
+    }
+    *split = '\0';
+    chunk_start = split + 1;
+  }
+
+  // Hand every chunk but the first to the load executor, or failing that
+  // to threads started for this symbol file.  Chunks that no thread has
+  // started by the time the first is parsed are parsed here instead.
+  TaskExecutor *executor = BasicSourceLineResolver::load_executor();
+  scoped_ptr<WorkStealingExecutor> own_executor(
+      executor ? NULL : new WorkStealingExecutor(used_chunks - 1));
+  TaskGroup group(executor ? executor : own_executor.get());
+  for (size_t i = 1; i < used_chunks; ++i) {
+    group.Submit(&chunks[i], TaskExecutor::PRIORITY_CRITICAL,
+                 TaskExecutor::STAGE_SYMBOL_PARSE);
+  }
+
+  // The first chunk can be stored as it's parsed, since nothing precedes it.
+  ParseRecords(&chunks[0], state);
+  group.Wait();
+
+  // Store the remaining chunks' records in order, stopping where a serial
+  // parse would have given up.
+  for (size_t i = 1; i < used_chunks; ++i) {
+    if (state->num_errors > kMaxErrorsBeforeBailing) {
+      break;
+    }
+    state->first_line_number += chunks[i - 1].line_count;
+    vector<Record> &records = chunks[i].records;
+    for (size_t j = 0; j < records.size(); ++j) {
+      StoreRecord(&records[j], state);
+      if (state->num_errors > kMaxErrorsBeforeBailing) {
+        break;
+      }
+    }
+  }
+  for (size_t i = 1; i < used_chunks; ++i) {
+    arena_.Adopt(chunks[i].arena);
+  }
   return true;
+#else  // _WIN32
+  return false;
+#endif  // _WIN32
+}
+
+void BasicSourceLineResolver::Module::StoreRecord(Record *record,
+                                                  StoreState *state) {
+  switch (record->kind) {
+    case Record::NO_RECORD:
+    case Record::ERROR_RECORD:
+      break;
+
+    case Record::FILE_RECORD: {
+      std::pair<FileMap::iterator, bool> inserted =
+          files_.insert(make_pair(static_cast<int>(record->index),
+                                  string(record->text)));
+      if (inserted.second) {
+        record_bytes_.files += kMapNodeBytes + sizeof(FileMap::value_type) +
+                               StringBytes(inserted.first->second);
+      }
+      break;
+    }
+
+    case Record::FUNC_RECORD:
+      state->cur_func.reset(record->function);
+      record->function = NULL;
+      if (state->cur_func.get()) {
+        // Lines parsed on a loader thread are still in its chunk.
+        state->cur_func->MoveLines(&lines_);
+        // StoreRange will fail if the function has an invalid address or
+        // size.  We'll silently ignore this, the function will be destroyed
+        // when cur_func is released, and its lines are left unused.
+        if (functions_.StoreRange(state->cur_func->address,
+                                  state->cur_func->size, state->cur_func)) {
+          record_bytes_.functions +=
+              kMapNodeBytes + 2 * sizeof(MemAddr) +
+              sizeof(linked_ptr<Function>) + sizeof(Function) +
+              StringBytes(state->cur_func->name);
+        }
+      }
+      break;
+
+    case Record::LINE_RECORD:
+      if (!state->cur_func.get()) {
+        record->error = "Found source line data without a function";
+      } else if (!record->error) {
+        state->cur_func->AddLine(record->line, &lines_);
+      }
+      break;
+
+    case Record::PUBLIC_RECORD:
+      // Clear cur_func: public symbols don't contain line number information.
+      state->cur_func.reset();
+      if (record->public_symbol) {
+        linked_ptr<PublicSymbol> symbol(record->public_symbol);
+        record->public_symbol = NULL;
+        if (public_symbols_.Store(symbol->address, symbol)) {
+          record_bytes_.public_symbols +=
+              kMapNodeBytes + sizeof(MemAddr) +
+              sizeof(linked_ptr<PublicSymbol>) + sizeof(PublicSymbol) +
+              StringBytes(symbol->name);
+        } else {
+          record->error = "ParsePublicSymbol failed";
+        }
+      }
+      break;
+
+    case Record::STACK_WIN_RECORD:
+      // TODO(mmentovai): I wanted to use StoreRange's return value as this
+      // method's return value, but MSVC infrequently outputs stack info that
+      // violates the containment rules.  This happens with a section of code
+      // in strncpy_s in test_app.cc (testdata/minidump2).  There, problem
+      // looks like this:
+      //   STACK WIN 4 4242 1a a 0 ...  (STACK WIN 4 base size prolog 0 ...)
+      //   STACK WIN 4 4243 2e 9 0 ...
+      // ContainedRangeMap treats these two blocks as conflicting.  In reality,
+      // when the prolog lengths are taken into account, the actual code of
+      // these blocks doesn't conflict.  However, we can't take the prolog
+      // lengths into account directly here because we'd wind up with a
+      // different set of range conflicts when MSVC outputs stack info like
+      // this:
+      //   STACK WIN 4 1040 73 33 0 ...
+      //   STACK WIN 4 105a 59 19 0 ...
+      // because in both of these entries, the beginning of the code after the
+      // prolog is at 0x1073, and the last byte of contained code is at
+      // 0x10b2.  Perhaps we could get away with storing ranges by
+      // rva + prolog_size if ContainedRangeMap were modified to allow
+      // replacement of already-stored values.
+      {
+        size_t frame_info_bytes =
+            kMapNodeBytes + sizeof(MemAddr) +
+            sizeof(ContainedRangeMap< MemAddr, linked_ptr<WindowsFrameInfo> >) +
+            sizeof(WindowsFrameInfo) +
+            StringBytes(record->frame_info->program_string);
+        if (windows_frame_info_[record->index].StoreRange(
+                record->address, record->size,
+                linked_ptr<WindowsFrameInfo>(record->frame_info))) {
+          record_bytes_.frame_info += frame_info_bytes;
+        }
+        record->frame_info = NULL;
+      }
+      break;
+
+    case Record::STACK_CFI_INIT_RECORD:
+      if (cfi_initial_rules_.StoreRange(record->address, record->size,
+                                        InternCFIRules(record->text, state))) {
+        record_bytes_.frame_info +=
+            kMapNodeBytes + 2 * sizeof(MemAddr) + sizeof(int);
+      }
+      break;
+
+    case Record::STACK_CFI_RECORD: {
+      size_t delta_count = cfi_delta_rules_.size();
+      cfi_delta_rules_[record->address] = InternCFIRules(record->text, state);
+      if (cfi_delta_rules_.size() != delta_count) {
+        record_bytes_.frame_info +=
+            kMapNodeBytes + sizeof(std::map<MemAddr, int>::value_type);
+      }
+      break;
+    }
+  }
+
+  if (record->error) {
+    LogParseError(record->error,
+                  state->first_line_number + record->line_number,
+                  &state->num_errors);
+  }
+}
+
+int BasicSourceLineResolver::Module::InternCFIRules(const char *rules,
+                                                    StoreState *state) {
+  map<const char *, int, StoreState::CStringLess>::iterator it =
+      state->cfi_rule_indices.lower_bound(rules);
+  if (it != state->cfi_rule_indices.end() && strcmp(it->first, rules) == 0)
+    return it->second;
+  int index = static_cast<int>(cfi_rules_.size());
+  cfi_rules_.push_back(rules);
+  record_bytes_.frame_info += StringBytes(cfi_rules_.back());
+  if (state->copy_cfi_rules) {
+    state->cfi_rule_texts.push_back(rules);
+    rules = state->cfi_rule_texts.back().c_str();
+  }
+  state->cfi_rule_indices.insert(it, make_pair(rules, index));
+  return index;
+}
+
+void BasicSourceLineResolver::Module::GetMemoryUsage(
+    ModuleMemoryUsage *usage) const {
+  *usage = record_bytes_;
+  usage->lines = lines_.capacity() * sizeof(Line);
+  usage->frame_info += cfi_rules_.capacity() * sizeof(string);
+}
+
+void BasicSourceLineResolver::Module::Freeze() {
+  // Frozen maps can't be added to.
+  if (lazy_ && !lazy_->windows_frame_info_loaded) {
+    lazy_->freeze = true;
+    return;
+  }
+  FreezeWindowsFrameInfo();
 }
 
-void BasicSourceLineResolver::Module::LookupAddress(StackFrame *frame) const {
+void BasicSourceLineResolver::Module::FreezeWindowsFrameInfo() {
+  for (int i = 0; i < WindowsFrameInfo::STACK_INFO_LAST; ++i)
+    windows_frame_info_[i].Freeze();
+}
+
+BasicSourceLineResolver::Function *
+BasicSourceLineResolver::Module::FindLoadedFunction(MemAddr address,
+                                                    MemAddr size) const {
+  linked_ptr<Function> loaded;
+  MemAddr loaded_base, loaded_size;
+  if (!functions_.RetrieveRange(address, &loaded, &loaded_base,
+                                &loaded_size) ||
+      loaded_base != address || loaded_size != size) {
+    return NULL;
+  }
+  return loaded.get();
+}
+
+void BasicSourceLineResolver::Module::LookupAddress(StackFrame *frame,
+                                                    bool share_names) const {
   MemAddr address = frame->instruction - frame->module->base_address();
+  if (lazy_)
+    const_cast<Module*>(this)->LoadIndexedRecords(address);
 
   // First, look for a FUNC record that covers address. Use
   // RetrieveNearestRange instead of RetrieveRange so that, if there
@@ -204,30 +1124,110 @@ void BasicSourceLineResolver::Module::LookupAddress(StackFrame *frame) const {
   if (functions_.RetrieveNearestRange(address, &func,
                                       &function_base, &function_size) &&
       address >= function_base && address - function_base < function_size) {
-    frame->function_name = func->name;
+    if (share_names)
+      frame->shared_function_name = func->name.c_str();
+    else
+      frame->function_name = func->name;
     frame->function_base = frame->module->base_address() + function_base;
 
-    linked_ptr<Line> line;
-    MemAddr line_base;
-    if (func->lines.RetrieveRange(address, &line, &line_base, NULL)) {
-      FileMap::const_iterator it = files_.find(line->source_file_id);
+    const Line *found_line = func->FindLine(address);
+    if (found_line) {
+      // Copied, as loading a file on demand may grow the line table.
+      Line line = *found_line;
+      FileMap::const_iterator it = files_.find(line.source_file_id);
+      if (it == files_.end() && lazy_) {
+        const_cast<Module*>(this)->LoadIndexedFile(line.source_file_id);
+        it = files_.find(line.source_file_id);
+      }
       if (it != files_.end()) {
-        frame->source_file_name = files_.find(line->source_file_id)->second;
+        if (share_names)
+          frame->shared_source_file_name = it->second.c_str();
+        else
+          frame->source_file_name = it->second;
       }
-      frame->source_line = line->line;
-      frame->source_line_base = frame->module->base_address() + line_base;
+      frame->source_line = line.line;
+      frame->source_line_base = frame->module->base_address() + line.address;
     }
   } else if (public_symbols_.Retrieve(address,
                                       &public_symbol, &public_address) &&
              (!func.get() || public_address > function_base)) {
-    frame->function_name = public_symbol->name;
+    if (share_names)
+      frame->shared_function_name = public_symbol->name.c_str();
+    else
+      frame->function_name = public_symbol->name;
     frame->function_base = frame->module->base_address() + public_address;
   }
 }
 
+void BasicSourceLineResolver::Module::LookupAddresses(
+    const MemAddr *addresses, size_t count, SymbolizedAddress *results) const {
+  // Parsing records on demand may move the line tables, so a module loaded
+  // from an indexed file looks its addresses up one at a time.
+  if (lazy_) {
+    SourceLineResolverBase::Module::LookupAddresses(addresses, count,
+                                                    results);
+    return;
+  }
+
+  FileMap::const_iterator file = files_.end();
+  size_t i = 0;
+  while (i < count) {
+    const MemAddr address = addresses[i];
+    linked_ptr<Function> func;
+    MemAddr function_base;
+    MemAddr function_size;
+    if (functions_.RetrieveNearestRange(address, &func,
+                                        &function_base, &function_size) &&
+        address >= function_base && address - function_base < function_size) {
+      // The run of addresses in this function, and their lines, are in
+      // ascending order.
+      const Line *line = func->line_count ?
+          &(*func->line_table)[func->first_line] : NULL;
+      const Line *lines_end = line + func->line_count;
+      for (; i < count && addresses[i] - function_base < function_size; ++i) {
+        SymbolizedAddress *result = &results[i];
+        result->function_name = func->name.c_str();
+        result->function_offset = addresses[i] - function_base;
+        result->source_file_name = NULL;
+        result->source_line = 0;
+        while (line != lines_end && addresses[i] >= line->address &&
+               addresses[i] - line->address >= line->size) {
+          ++line;
+        }
+        if (line == lines_end || addresses[i] < line->address)
+          continue;
+        if (file == files_.end() || file->first != line->source_file_id)
+          file = files_.find(line->source_file_id);
+        if (file != files_.end())
+          result->source_file_name = file->second.c_str();
+        result->source_line = line->line;
+      }
+      continue;
+    }
+
+    SymbolizedAddress *result = &results[i++];
+    result->function_name = NULL;
+    result->source_file_name = NULL;
+    result->source_line = 0;
+    result->function_offset = 0;
+    linked_ptr<PublicSymbol> public_symbol;
+    MemAddr public_address;
+    if (public_symbols_.Retrieve(address, &public_symbol, &public_address) &&
+        (!func.get() || public_address > function_base)) {
+      result->function_name = public_symbol->name.c_str();
+      result->function_offset = address - public_address;
+    }
+  }
+}
+
 WindowsFrameInfo *BasicSourceLineResolver::Module::FindWindowsFrameInfo(
     const StackFrame *frame) const {
   MemAddr address = frame->instruction - frame->module->base_address();
+  if (lazy_) {
+    Module *self = const_cast<Module*>(this);
+    self->LoadIndexedWindowsFrameInfo();
+    self->LoadIndexedRecords(address);
+  }
   scoped_ptr<WindowsFrameInfo> result(new WindowsFrameInfo());
 
   // We only know about WindowsFrameInfo::STACK_INFO_FRAME_DATA and
@@ -278,7 +1278,9 @@ CFIFrameInfo *BasicSourceLineResolver::Module::FindCFIFrameInfo(
     const StackFrame *frame) const {
   MemAddr address = frame->instruction - frame->module->base_address();
   MemAddr initial_base, initial_size;
-  string initial_rules;
+  int initial_rules;
+  if (lazy_)
+    const_cast<Module*>(this)->LoadIndexedCFI(address);
 
   // Find the initial rule whose range covers this address. That
   // provides an initial set of register recovery rules. Then, walk
@@ -292,47 +1294,52 @@ CFIFrameInfo *BasicSourceLineResolver::Module::FindCFIFrameInfo(
   // Create a frame info structure, and populate it with the rules from
   // the STACK CFI INIT record.
   scoped_ptr<CFIFrameInfo> rules(new CFIFrameInfo());
-  if (!ParseCFIRuleSet(initial_rules, rules.get()))
+  if (!ParseCFIRuleSet(cfi_rules_[initial_rules].c_str(), rules.get()))
     return NULL;
 
   // Find the first delta rule that falls within the initial rule's range.
-  map<MemAddr, string>::const_iterator delta =
+  map<MemAddr, int>::const_iterator delta =
     cfi_delta_rules_.lower_bound(initial_base);
 
   // Apply delta rules up to and including the frame's address.
   while (delta != cfi_delta_rules_.end() && delta->first <= address) {
-    ParseCFIRuleSet(delta->second, rules.get());
+    ParseCFIRuleSet(cfi_rules_[delta->second].c_str(), rules.get());
     delta++;
   }
 
   return rules.release();
 }
 
-bool BasicSourceLineResolver::Module::ParseFile(char *file_line) {
+// static
+bool BasicSourceLineResolver::Module::ParseFile(char *file_line,
+                                                Record *record) {
   long index;
   char *filename;
   if (SymbolParseHelper::ParseFile(file_line, &index, &filename)) {
-    files_.insert(make_pair(index, string(filename)));
+    record->index = index;
+    record->text = filename;
     return true;
   }
   return false;
 }
 
+// static
 BasicSourceLineResolver::Function*
-BasicSourceLineResolver::Module::ParseFunction(char *function_line) {
+BasicSourceLineResolver::Module::ParseFunction(char *function_line,
+                                               ModuleArena *arena) {
   uint64_t address;
   uint64_t size;
   long stack_param_size;
   char *name;
   if (SymbolParseHelper::ParseFunction(function_line, &address, &size,
                                        &stack_param_size, &name)) {
-    return new Function(name, address, size, stack_param_size);
+    return new (arena) Function(name, address, size, stack_param_size);
   }
   return NULL;
 }
 
-BasicSourceLineResolver::Line* BasicSourceLineResolver::Module::ParseLine(
-    char *line_line) {
+// static
+bool BasicSourceLineResolver::Module::ParseLine(char *line_line, Line *line) {
   uint64_t address;
   uint64_t size;
   long line_number;
@@ -340,12 +1347,16 @@ BasicSourceLineResolver::Line* BasicSourceLineResolver::Module::ParseLine(
 
   if (SymbolParseHelper::ParseLine(line_line, &address, &size, &line_number,
                                    &source_file)) {
-    return new Line(address, size, source_file, line_number);
+    *line = Line(address, size, source_file, line_number);
+    return true;
   }
-  return NULL;
+  return false;
 }
 
-bool BasicSourceLineResolver::Module::ParsePublicSymbol(char *public_line) {
+// static
+bool BasicSourceLineResolver::Module::ParsePublicSymbol(char *public_line,
+                                                        ModuleArena *arena,
+                                                        Record *record) {
   uint64_t address;
   long stack_param_size;
   char *name;
@@ -362,14 +1373,16 @@ bool BasicSourceLineResolver::Module::ParsePublicSymbol(char *public_line) {
       return true;
     }
 
-    linked_ptr<PublicSymbol> symbol(new PublicSymbol(name, address,
-                                                     stack_param_size));
-    return public_symbols_.Store(address, symbol);
+    record->public_symbol =
+        new (arena) PublicSymbol(name, address, stack_param_size);
+    return true;
   }
   return false;
 }
 
-bool BasicSourceLineResolver::Module::ParseStackInfo(char *stack_info_line) {
+// static
+bool BasicSourceLineResolver::Module::ParseStackInfo(char *stack_info_line,
+                                                     Record *record) {
   // Skip "STACK " prefix.
   stack_info_line += 6;
 
@@ -386,47 +1399,30 @@ bool BasicSourceLineResolver::Module::ParseStackInfo(char *stack_info_line) {
   if (strcmp(platform, "WIN") == 0) {
     int type = 0;
     uint64_t rva, code_size;
-    linked_ptr<WindowsFrameInfo>
-      stack_frame_info(WindowsFrameInfo::ParseFromString(stack_info_line,
-                                                         type,
-                                                         rva,
-                                                         code_size));
+    WindowsFrameInfo *stack_frame_info =
+        WindowsFrameInfo::ParseFromString(stack_info_line, type, rva,
+                                          code_size);
     if (stack_frame_info == NULL)
       return false;
 
-    // TODO(mmentovai): I wanted to use StoreRange's return value as this
-    // method's return value, but MSVC infrequently outputs stack info that
-    // violates the containment rules.  This happens with a section of code
-    // in strncpy_s in test_app.cc (testdata/minidump2).  There, problem looks
-    // like this:
-    //   STACK WIN 4 4242 1a a 0 ...  (STACK WIN 4 base size prolog 0 ...)
-    //   STACK WIN 4 4243 2e 9 0 ...
-    // ContainedRangeMap treats these two blocks as conflicting.  In reality,
-    // when the prolog lengths are taken into account, the actual code of
-    // these blocks doesn't conflict.  However, we can't take the prolog lengths
-    // into account directly here because we'd wind up with a different set
-    // of range conflicts when MSVC outputs stack info like this:
-    //   STACK WIN 4 1040 73 33 0 ...
-    //   STACK WIN 4 105a 59 19 0 ...
-    // because in both of these entries, the beginning of the code after the
-    // prolog is at 0x1073, and the last byte of contained code is at 0x10b2.
-    // Perhaps we could get away with storing ranges by rva + prolog_size
-    // if ContainedRangeMap were modified to allow replacement of
-    // already-stored values.
-
-    windows_frame_info_[type].StoreRange(rva, code_size, stack_frame_info);
+    record->kind = Record::STACK_WIN_RECORD;
+    record->index = type;
+    record->address = rva;
+    record->size = code_size;
+    record->frame_info = stack_frame_info;
     return true;
   } else if (strcmp(platform, "CFI") == 0) {
     // DWARF CFI stack frame info
-    return ParseCFIFrameInfo(stack_info_line);
+    return ParseCFIFrameInfo(stack_info_line, record);
   } else {
     // Something unrecognized.
     return false;
   }
 }
 
+// static
 bool BasicSourceLineResolver::Module::ParseCFIFrameInfo(
-    char *stack_info_line) {
+    char *stack_info_line, Record *record) {
   char *cursor;
 
   // Is this an INIT record or a delta record?
@@ -445,9 +1441,10 @@ bool BasicSourceLineResolver::Module::ParseCFIFrameInfo(
     char *initial_rules = strtok_r(NULL, "\r\n", &cursor);
     if (!initial_rules) return false;
 
-    MemAddr address = strtoul(address_field, NULL, 16);
-    MemAddr size    = strtoul(size_field,    NULL, 16);
-    cfi_initial_rules_.StoreRange(address, size, initial_rules);
+    record->kind = Record::STACK_CFI_INIT_RECORD;
+    record->address = strtoul(address_field, NULL, 16);
+    record->size    = strtoul(size_field,    NULL, 16);
+    record->text = initial_rules;
     return true;
   }
 
@@ -455,8 +1452,69 @@ bool BasicSourceLineResolver::Module::ParseCFIFrameInfo(
   char *address_field = init_or_address;
   char *delta_rules = strtok_r(NULL, "\r\n", &cursor);
   if (!delta_rules) return false;
-  MemAddr address = strtoul(address_field, NULL, 16);
-  cfi_delta_rules_[address] = delta_rules;
+  record->kind = Record::STACK_CFI_RECORD;
+  record->address = strtoul(address_field, NULL, 16);
+  record->text = delta_rules;
+  return true;
+}
+
+// Splits a symbol file record into |max_tokens| fields, exactly as
+// Tokenize(line, kWhitespace, max_tokens, ...) would, but in one pass over
+// the line and without allocating: the first max_tokens - 1 fields are
+// separated by runs of whitespace, and the last field is the rest of the
+// line up to the first line break.  Returns false if there are fewer
+// fields.
+static bool SplitRecord(char *line, int max_tokens, char **tokens) {
+  char *cursor = line;
+  for (int i = 0; i < max_tokens - 1; ++i) {
+    while (*cursor == ' ' || *cursor == '\r' || *cursor == '\n')
+      ++cursor;
+    if (*cursor == '\0')
+      return false;
+    tokens[i] = cursor;
+    while (*cursor != '\0' && *cursor != ' ' && *cursor != '\r' &&
+           *cursor != '\n')
+      ++cursor;
+    if (*cursor != '\0')
+      *cursor++ = '\0';
+  }
+
+  while (*cursor == '\r' || *cursor == '\n')
+    ++cursor;
+  if (*cursor == '\0')
+    return false;
+  tokens[max_tokens - 1] = cursor;
+  while (*cursor != '\0' && *cursor != '\r' && *cursor != '\n')
+    ++cursor;
+  *cursor = '\0';
+  return true;
+}
+
+// Returns the value of the hex digit |c|, or 16 if it is not one.
+static inline unsigned int DigitValue(unsigned char c) {
+  unsigned int digit = c - '0';
+  if (digit < 10)
+    return digit;
+  digit = (c | 0x20) - 'a';
+  return digit < 6 ? digit + 10 : 16;
+}
+
+// Decodes |field| if it consists of nothing but one to |max_digits| digits
+// in |base|, which must be 10 or 16.  Returns false for anything else,
+// without looking further than max_digits + 1 characters.
+static bool ParseDigits(const char *field, unsigned int base, int max_digits,
+                        uint64_t *value) {
+  uint64_t result = 0;
+  int count = 0;
+  for (; field[count] != '\0'; ++count) {
+    unsigned int digit = DigitValue(field[count]);
+    if (digit >= base || count == max_digits)
+      return false;
+    result = result * base + digit;
+  }
+  if (count == 0)
+    return false;
+  *value = result;
   return true;
 }
 
@@ -467,14 +1525,12 @@ bool SymbolParseHelper::ParseFile(char *file_line, long *index,
   assert(strncmp(file_line, "FILE ", 5) == 0);
   file_line += 5;  // skip prefix
 
-  vector<char*> tokens;
-  if (!Tokenize(file_line, kWhitespace, 2, &tokens)) {
+  char *tokens[2];
+  if (!SplitRecord(file_line, 2, tokens)) {
     return false;
   }
 
-  char *after_number;
-  *index = strtol(tokens[0], &after_number, 10);
-  if (!IsValidAfterNumber(after_number) || *index < 0 ||
+  if (!ParseLongField(tokens[0], 10, index) || *index < 0 ||
       *index == std::numeric_limits<long>::max()) {
     return false;
   }
@@ -495,24 +1551,20 @@ bool SymbolParseHelper::ParseFunction(char *function_line, uint64_t *address,
   assert(strncmp(function_line, "FUNC ", 5) == 0);
   function_line += 5;  // skip prefix
 
-  vector<char*> tokens;
-  if (!Tokenize(function_line, kWhitespace, 4, &tokens)) {
+  char *tokens[4];
+  if (!SplitRecord(function_line, 4, tokens)) {
     return false;
   }
 
-  char *after_number;
-  *address = strtoull(tokens[0], &after_number, 16);
-  if (!IsValidAfterNumber(after_number) ||
+  if (!ParseHexField(tokens[0], address) ||
       *address == std::numeric_limits<unsigned long long>::max()) {
     return false;
   }
-  *size = strtoull(tokens[1], &after_number, 16);
-  if (!IsValidAfterNumber(after_number) ||
+  if (!ParseHexField(tokens[1], size) ||
       *size == std::numeric_limits<unsigned long long>::max()) {
     return false;
   }
-  *stack_param_size = strtol(tokens[2], &after_number, 16);
-  if (!IsValidAfterNumber(after_number) ||
+  if (!ParseLongField(tokens[2], 16, stack_param_size) ||
       *stack_param_size == std::numeric_limits<long>::max() ||
       *stack_param_size < 0) {
     return false;
@@ -527,29 +1579,24 @@ bool SymbolParseHelper::ParseLine(char *line_line, uint64_t *address,
                                   uint64_t *size, long *line_number,
                                   long *source_file) {
   // <address> <size> <line number> <source file id>
-  vector<char*> tokens;
-  if (!Tokenize(line_line, kWhitespace, 4, &tokens)) {
+  char *tokens[4];
+  if (!SplitRecord(line_line, 4, tokens)) {
     return false;
   }
 
-  char *after_number;
-  *address  = strtoull(tokens[0], &after_number, 16);
-  if (!IsValidAfterNumber(after_number) ||
+  if (!ParseHexField(tokens[0], address) ||
       *address == std::numeric_limits<unsigned long long>::max()) {
     return false;
   }
-  *size = strtoull(tokens[1], &after_number, 16);
-  if (!IsValidAfterNumber(after_number) ||
+  if (!ParseHexField(tokens[1], size) ||
       *size == std::numeric_limits<unsigned long long>::max()) {
     return false;
   }
-  *line_number = strtol(tokens[2], &after_number, 10);
-  if (!IsValidAfterNumber(after_number) ||
+  if (!ParseLongField(tokens[2], 10, line_number) ||
       *line_number == std::numeric_limits<long>::max()) {
     return false;
   }
-  *source_file = strtol(tokens[3], &after_number, 10);
-  if (!IsValidAfterNumber(after_number) || *source_file < 0 ||
+  if (!ParseLongField(tokens[3], 10, source_file) || *source_file < 0 ||
       *source_file == std::numeric_limits<long>::max()) {
     return false;
   }
@@ -576,19 +1623,16 @@ bool SymbolParseHelper::ParsePublicSymbol(char *public_line,
   assert(strncmp(public_line, "PUBLIC ", 7) == 0);
   public_line += 7;  // skip prefix
 
-  vector<char*> tokens;
-  if (!Tokenize(public_line, kWhitespace, 3, &tokens)) {
+  char *tokens[3];
+  if (!SplitRecord(public_line, 3, tokens)) {
     return false;
   }
 
-  char *after_number;
-  *address = strtoull(tokens[0], &after_number, 16);
-  if (!IsValidAfterNumber(after_number) ||
+  if (!ParseHexField(tokens[0], address) ||
       *address == std::numeric_limits<unsigned long long>::max()) {
     return false;
   }
-  *stack_param_size = strtol(tokens[1], &after_number, 16);
-  if (!IsValidAfterNumber(after_number) ||
+  if (!ParseLongField(tokens[1], 16, stack_param_size) ||
       *stack_param_size == std::numeric_limits<long>::max() ||
       *stack_param_size < 0) {
     return false;
@@ -606,4 +1650,31 @@ bool SymbolParseHelper::IsValidAfterNumber(char *after_number) {
   return false;
 }
 
+// static
+bool SymbolParseHelper::ParseHexField(char *field, uint64_t *value) {
+  if (ParseDigits(field, 16, 16, value)) {
+    return true;
+  }
+
+  char *after_number;
+  *value = strtoull(field, &after_number, 16);
+  return IsValidAfterNumber(after_number);
+}
+
+// static
+bool SymbolParseHelper::ParseLongField(char *field, int base, long *value) {
+  // Any run of this many digits fits in a long, in either base.
+  int max_digits = base == 16 ? sizeof(long) * 2 - 1
+                              : std::numeric_limits<long>::digits10;
+  uint64_t digits;
+  if (ParseDigits(field, base, max_digits, &digits)) {
+    *value = static_cast<long>(digits);
+    return true;
+  }
+
+  char *after_number;
+  *value = strtol(field, &after_number, base);
+  return IsValidAfterNumber(after_number);
+}
+
 }  // namespace google_breakpad
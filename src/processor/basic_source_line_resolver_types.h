@@ -39,6 +39,7 @@
 
 #include <map>
 #include <string>
+#include <vector>
 
 #include "common/scoped_ptr.h"
 #include "google_breakpad/processor/basic_source_line_resolver.h"
@@ -49,14 +50,17 @@
 #include "processor/contained_range_map-inl.h"
 
 #include "processor/linked_ptr.h"
+#include "processor/module_arena.h"
 #include "google_breakpad/processor/stack_frame.h"
 #include "processor/cfi_frame_info.h"
+#include "processor/symbol_file_index.h"
 #include "processor/windows_frame_info.h"
 
 namespace google_breakpad {
 
-struct
-BasicSourceLineResolver::Function : public SourceLineResolverBase::Function {
+// Functions are allocated in the arena of their module.
+struct BasicSourceLineResolver::Function
+    : public SourceLineResolverBase::Function, public ArenaObject {
   Function(const string &function_name,
            MemAddr function_address,
            MemAddr code_size,
@@ -64,17 +68,56 @@ BasicSourceLineResolver::Function : public SourceLineResolverBase::Function {
                                           function_address,
                                           code_size,
                                           set_parameter_size),
-                                     lines() { }
-  RangeMap< MemAddr, linked_ptr<Line> > lines;
+                                     line_table(NULL),
+                                     first_line(0),
+                                     line_count(0) { }
+
+  // Returns the line covering |address|, or NULL if there is none.
+  const Line *FindLine(MemAddr address) const;
+
+  // Adds |line| to the function, keeping its lines in |*table|.  Like
+  // RangeMap::StoreRange, refuses empty lines and lines that overlap
+  // others, returning false.
+  bool AddLine(const Line &line, std::vector<Line> *table);
+
+  // Moves the function's lines to the end of |*table|, unless they are
+  // already there.
+  void MoveLines(std::vector<Line> *table);
+
+  // The function's lines, sorted by address and not overlapping, are
+  // (*line_table)[first_line, first_line + line_count).  A module keeps
+  // all its functions' lines in a single table, which saves allocating
+  // each line separately.  While a function is parsed on a loader thread,
+  // its lines are in a table of the chunk being parsed.
+  std::vector<Line> *line_table;
+  size_t first_line;
+  size_t line_count;
+
  private:
   typedef SourceLineResolverBase::Function Base;
+
+  // Orders lines by address, for searching a function's lines.
+  static bool AddressBeforeLine(MemAddr address, const Line &line);
+};
+
+// Public symbols are allocated in the arena of their module.
+struct BasicSourceLineResolver::PublicSymbol
+    : public SourceLineResolverBase::PublicSymbol, public ArenaObject {
+  PublicSymbol(const string &set_name,
+               MemAddr set_address,
+               int set_parameter_size)
+      : SourceLineResolverBase::PublicSymbol(set_name, set_address,
+                                             set_parameter_size) { }
 };
 
 
 class BasicSourceLineResolver::Module : public SourceLineResolverBase::Module {
  public:
-  explicit Module(const string &name) : name_(name), is_corrupt_(false) { }
-  virtual ~Module() { }
+  explicit Module(const string &name)
+      : name_(name), arena_(BasicSourceLineResolver::huge_page_arenas()),
+        is_corrupt_(false), lazy_(NULL), load_phase_(LOAD_ALL),
+        source_lines_deferred_(false) { }
+  virtual ~Module();
 
   // Loads a map from the given buffer in char* type.
   // Does NOT have ownership of memory_buffer.
@@ -84,13 +127,48 @@ class BasicSourceLineResolver::Module : public SourceLineResolverBase::Module {
   virtual bool LoadMapFromMemory(char *memory_buffer,
                                  size_t memory_buffer_size);
 
+  // Loads a map from |decompressor|.  Each block of symbol data is parsed
+  // and stored while the next is decompressed on another thread, and then
+  // freed, so the whole text is never in memory at once.
+  virtual bool LoadMapFromDecompressor(SymbolFileDecompressor *decompressor,
+                                       size_t *data_size);
+
+  // Loads a map from |map_file| on demand, using |index_file|, its
+  // SymbolFileIndex.  Both stay mapped, and each lookup first parses the
+  // blocks of records covering its address that haven't been parsed yet.
+  // Parse errors in records parsed after loading are logged and make
+  // IsCorrupt true, but a resolver only checks that when loading.
+  virtual bool LoadMapFromIndexedFile(const string &map_file,
+                                      const string &index_file);
+
+  // Loads a map from |memory_buffer| like LoadMapFromMemory, but skips the
+  // FILE and line records, which are most of a large symbol file.  Lookups
+  // find functions but no source lines until LoadSourceLinesFromMemory
+  // adds them, from the same symbol data.
+  virtual bool LoadMapWithoutSourceLinesFromMemory(char *memory_buffer,
+                                                   size_t memory_buffer_size);
+  virtual bool LoadSourceLinesFromMemory(char *memory_buffer,
+                                         size_t memory_buffer_size);
+  virtual bool HasDeferredSourceLines() const {
+    return source_lines_deferred_;
+  }
+
   // Tells whether the loaded symbol data is corrupt.  Return value is
   // undefined, if the symbol data hasn't been loaded yet.
   virtual bool IsCorrupt() const { return is_corrupt_; }
 
   // Looks up the given relative address, and fills the StackFrame struct
   // with the result.
-  virtual void LookupAddress(StackFrame *frame) const;
+  virtual void LookupAddress(StackFrame *frame, bool share_names) const;
+
+  // Looks up sorted addresses, finding each function once for the run of
+  // addresses in it and walking forward through its lines.
+  virtual void LookupAddresses(const MemAddr *addresses, size_t count,
+                               SymbolizedAddress *results) const;
+
+  // Freezes the STACK WIN maps.  For a module loaded by
+  // LoadMapFromIndexedFile, that waits until they are loaded.
+  virtual void Freeze();
 
   // If Windows stack walking information is available covering ADDRESS,
   // return a WindowsFrameInfo structure describing it. If the information
@@ -105,6 +183,8 @@ class BasicSourceLineResolver::Module : public SourceLineResolverBase::Module {
   // returned CFIFrameInfo object.
   virtual CFIFrameInfo *FindCFIFrameInfo(const StackFrame *frame) const;
 
+  virtual void GetMemoryUsage(ModuleMemoryUsage *usage) const;
+
  private:
   // Friend declarations.
   friend class BasicSourceLineResolver;
@@ -113,6 +193,33 @@ class BasicSourceLineResolver::Module : public SourceLineResolverBase::Module {
 
   typedef std::map<int, string> FileMap;
 
+  // The records that ParseRecords stores.
+  enum LoadPhase {
+    LOAD_ALL,
+    // All but FILE and line records.
+    LOAD_WITHOUT_SOURCE_LINES,
+    // Only FILE and line records, adding the line records to the functions
+    // already loaded.
+    LOAD_SOURCE_LINES
+  };
+
+  // A record parsed from the symbol data, on its way to the module's maps.
+  struct Record;
+
+  // A piece of the symbol data, along with the records parsed from it that
+  // haven't been stored yet.
+  struct Chunk;
+
+  // What StoreRecord carries from one record to the next.
+  struct StoreState;
+
+  // Blocks of decompressed symbol data passed from the decompressing
+  // thread to the parsing thread.
+  struct BlockQueue;
+
+  // The index and parse state of a module loaded by LoadMapFromIndexedFile.
+  struct LazyState;
+
   // Logs parse errors.  |*num_errors| is increased every time LogParseError is
   // called.
   static void LogParseError(
@@ -120,29 +227,92 @@ class BasicSourceLineResolver::Module : public SourceLineResolverBase::Module {
       int line_number,
       int *num_errors);
 
-  // Parses a file declaration
-  bool ParseFile(char *file_line);
+  // Parses the records in |chunk->buffer|.  If |state| is non-NULL, each
+  // record is stored as soon as it is parsed.  Otherwise, the records are
+  // left in |chunk->records| for StoreRecord, and the module isn't modified,
+  // so that several chunks may be parsed at once.  Line records are added to
+  // the preceding function immediately when it is in the same chunk.
+  void ParseRecords(Chunk *chunk, StoreState *state);
+
+  // Splits the |data_size| bytes of null-terminated symbol data in
+  // |memory_buffer| into chunks and parses them on several threads, storing
+  // the results using |state|.  Returns false without doing anything if the
+  // data should be parsed on the calling thread instead.
+  bool ParseRecordsInParallel(char *memory_buffer, size_t data_size,
+                              StoreState *state);
+
+  // Parses and stores the records in |block|, |block_size| bytes of
+  // null-terminated symbol data read by LoadMapFromDecompressor.
+  // |first_block| is true for the block at the start of the symbol data.
+  void ParseBlock(char *block, size_t block_size, bool first_block,
+                  StoreState *state);
+
+  // Decompressing thread entry point for LoadMapFromDecompressor: reads
+  // blocks into the BlockQueue pointed to by |arg|.
+  static void *DecompressThreadMain(void *arg);
 
-  // Parses a function declaration, returning a new Function object.
-  Function* ParseFunction(char *function_line);
+  // Stores a parsed |record| in the module's maps, and logs its error, if
+  // any.  Takes ownership of the objects |record| points to.
+  void StoreRecord(Record *record, StoreState *state);
 
-  // Parses a line declaration, returning a new Line object.
-  Line* ParseLine(char *line_line);
+  // Parses a file declaration.
+  static bool ParseFile(char *file_line, Record *record);
 
-  // Parses a PUBLIC symbol declaration, storing it in public_symbols_.
+  // Parses a function declaration, returning a new Function object
+  // allocated in |arena|.
+  static Function* ParseFunction(char *function_line, ModuleArena *arena);
+
+  // Parses a line declaration into |*line|.  Returns false if an error
+  // occurs.
+  static bool ParseLine(char *line_line, Line *line);
+
+  // Parses a PUBLIC symbol declaration, allocating the symbol in |arena|.
   // Returns false if an error occurs.
-  bool ParsePublicSymbol(char *public_line);
+  static bool ParsePublicSymbol(char *public_line, ModuleArena *arena,
+                                Record *record);
+
+  // Parses a STACK WIN or STACK CFI frame info declaration.
+  static bool ParseStackInfo(char *stack_info_line, Record *record);
+
+  // Parses a STACK CFI record.
+  static bool ParseCFIFrameInfo(char *stack_info_line, Record *record);
 
-  // Parses a STACK WIN or STACK CFI frame info declaration, storing
-  // it in the appropriate table.
-  bool ParseStackInfo(char *stack_info_line);
+  // Returns the index in cfi_rules_ of the rule set RULES, adding it if
+  // this is its first appearance.
+  int InternCFIRules(const char *rules, StoreState *state);
 
-  // Parses a STACK CFI record, storing it in cfi_frame_info_.
-  bool ParseCFIFrameInfo(char *stack_info_line);
+  // For modules loaded by LoadMapFromIndexedFile: parse and store the
+  // blocks of records that lookups at |address|, or of the file with |id|,
+  // or of STACK WIN records, need, unless they already have been.  The
+  // lookups are const, but parsing on demand only adds what a full load
+  // would have stored up front, so they call these through const_cast.
+  void LoadIndexedRecords(MemAddr address);
+  void LoadIndexedFile(int id);
+  void LoadIndexedCFI(MemAddr address);
+  void LoadIndexedWindowsFrameInfo();
+
+  // Parses and stores the |i|th block of |kind| in the index.
+  void LoadIndexedBlock(SymbolFileIndex::Kind kind, size_t i);
+
+  // Freezes the STACK WIN maps.
+  void FreezeWindowsFrameInfo();
+
+  // Returns the loaded function with the given address and size, or NULL
+  // if there is none.
+  Function *FindLoadedFunction(MemAddr address, MemAddr size) const;
 
   string name_;
   FileMap files_;
+
+  // Holds the functions and public symbols, and so must be destroyed after
+  // the maps that point to them.  See BasicSourceLineResolver::
+  // set_huge_page_arenas.
+  ModuleArena arena_;
   RangeMap< MemAddr, linked_ptr<Function> > functions_;
+
+  // The lines of every function in functions_, each function's in one
+  // contiguous span.
+  std::vector<Line> lines_;
   AddressMap< MemAddr, linked_ptr<PublicSymbol> > public_symbols_;
   bool is_corrupt_;
 
@@ -158,18 +328,36 @@ class BasicSourceLineResolver::Module : public SourceLineResolverBase::Module {
   // although the file may contain hundreds of thousands of STACK CFI
   // records, walking a stack will only ever use a few of them, so it's
   // best to delay parsing a record until it's actually needed.
+  //
+  // Far fewer distinct rule sets appear than records, so each is stored
+  // once in cfi_rules_, and the maps below hold indices into it.
+  std::vector<string> cfi_rules_;
 
   // STACK CFI INIT records: for each range, an initial set of register
   // recovery rules. The RangeMap's itself gives the starting and ending
   // addresses.
-  RangeMap<MemAddr, string> cfi_initial_rules_;
+  RangeMap<MemAddr, int> cfi_initial_rules_;
 
   // STACK CFI records: at a given address, the changes to the register
   // recovery rules that take effect at that address. The map key is the
   // starting address; the ending address is the key of the next entry in
   // this map, or the end of the range as given by the cfi_initial_rules_
   // entry (which FindCFIFrameInfo looks up first).
-  std::map<MemAddr, string> cfi_delta_rules_;
+  std::map<MemAddr, int> cfi_delta_rules_;
+
+  // Owned; NULL unless the module was loaded by LoadMapFromIndexedFile.
+  LazyState *lazy_;
+
+  // What the current load stores, and whether LoadSourceLinesFromMemory
+  // has yet to add the source lines.
+  LoadPhase load_phase_;
+  bool source_lines_deferred_;
+
+  // The memory taken by the records stored so far, counted as they are
+  // stored.  Only the CFI rule set strings are counted in frame_info, not
+  // cfi_rules_ itself, and lines is left for GetMemoryUsage to fill in
+  // from lines_.
+  ModuleMemoryUsage record_bytes_;
 };
 
 }  // namespace google_breakpad
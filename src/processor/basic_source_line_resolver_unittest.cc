@@ -29,28 +29,40 @@
 
 #include <assert.h>
 #include <stdio.h>
+#include <unistd.h>
 
 #include <string>
+#include <vector>
 
 #include "breakpad_googletest_includes.h"
 #include "common/scoped_ptr.h"
+#include "common/tests/auto_tempdir.h"
 #include "common/using_std_string.h"
 #include "google_breakpad/processor/basic_source_line_resolver.h"
 #include "google_breakpad/processor/code_module.h"
 #include "google_breakpad/processor/stack_frame.h"
 #include "google_breakpad/processor/memory_region.h"
+#include "google_breakpad/processor/symbol_module_cache.h"
 #include "processor/linked_ptr.h"
 #include "processor/logging.h"
+#include "processor/symbol_file_decompressor.h"
+#include "processor/symbol_file_index.h"
 #include "processor/windows_frame_info.h"
 #include "processor/cfi_frame_info.h"
 
 namespace {
 
+using google_breakpad::AutoTempDir;
 using google_breakpad::BasicSourceLineResolver;
 using google_breakpad::CFIFrameInfo;
 using google_breakpad::CodeModule;
 using google_breakpad::MemoryRegion;
+using google_breakpad::SizeWeightedEvictionPolicy;
+using google_breakpad::SourceLineResolverBase;
 using google_breakpad::StackFrame;
+using google_breakpad::SymbolFileDecompressor;
+using google_breakpad::SymbolFileIndex;
+using google_breakpad::SymbolModuleCache;
 using google_breakpad::WindowsFrameInfo;
 using google_breakpad::linked_ptr;
 using google_breakpad::scoped_ptr;
@@ -59,21 +71,27 @@ using google_breakpad::SymbolParseHelper;
 class TestCodeModule : public CodeModule {
  public:
   TestCodeModule(string code_file) : code_file_(code_file) {}
+  TestCodeModule(string code_file, string debug_file, string debug_identifier)
+      : code_file_(code_file),
+        debug_file_(debug_file),
+        debug_identifier_(debug_identifier) {}
   virtual ~TestCodeModule() {}
 
   virtual uint64_t base_address() const { return 0; }
   virtual uint64_t size() const { return 0xb000; }
   virtual string code_file() const { return code_file_; }
   virtual string code_identifier() const { return ""; }
-  virtual string debug_file() const { return ""; }
-  virtual string debug_identifier() const { return ""; }
+  virtual string debug_file() const { return debug_file_; }
+  virtual string debug_identifier() const { return debug_identifier_; }
   virtual string version() const { return ""; }
   virtual const CodeModule* Copy() const {
-    return new TestCodeModule(code_file_);
+    return new TestCodeModule(code_file_, debug_file_, debug_identifier_);
   }
 
  private:
   string code_file_;
+  string debug_file_;
+  string debug_identifier_;
 };
 
 // A mock memory region object, for use by the STACK CFI tests.
@@ -155,8 +173,10 @@ static bool VerifyEmpty(const StackFrame &frame) {
 
 static void ClearSourceLineInfo(StackFrame *frame) {
   frame->function_name.clear();
+  frame->shared_function_name = NULL;
   frame->module = NULL;
   frame->source_file_name.clear();
+  frame->shared_source_file_name = NULL;
   frame->source_line = 0;
 }
 
@@ -410,6 +430,928 @@ TEST_F(TestBasicSourceLineResolver, TestUnload)
   ASSERT_TRUE(resolver.HasModule(&module1));
 }
 
+TEST_F(TestBasicSourceLineResolver, TestFrameCache)
+{
+  TestCodeModule module1("module1");
+  ASSERT_TRUE(resolver.LoadModule(&module1, testdata_dir + "/module1.out"));
+
+  // A cache large enough for every address, and one that keeps evicting,
+  // must both answer exactly like no cache at all, time after time.
+  const size_t kCacheSizes[] = { 1024, 1 };
+  for (size_t i = 0; i < sizeof(kCacheSizes) / sizeof(kCacheSizes[0]); ++i) {
+    BasicSourceLineResolver cached_resolver;
+    cached_resolver.set_frame_cache_size(kCacheSizes[i]);
+    EXPECT_EQ(kCacheSizes[i], cached_resolver.frame_cache_size());
+    ASSERT_TRUE(cached_resolver.LoadModule(&module1,
+                                           testdata_dir + "/module1.out"));
+    for (int pass = 0; pass < 2; ++pass) {
+      for (uint64_t address = 0x800; address < 0x3100; address += 0x18) {
+        StackFrame expected;
+        expected.instruction = address;
+        expected.module = &module1;
+        resolver.FillSourceLineInfo(&expected);
+
+        StackFrame frame;
+        frame.instruction = address;
+        frame.module = &module1;
+        cached_resolver.FillSourceLineInfo(&frame);
+        EXPECT_EQ(expected.function_name, frame.function_name);
+        EXPECT_EQ(expected.function_base, frame.function_base);
+        EXPECT_EQ(expected.source_file_name, frame.source_file_name);
+        EXPECT_EQ(expected.source_line, frame.source_line);
+        EXPECT_EQ(expected.source_line_base, frame.source_line_base);
+      }
+    }
+  }
+
+  // Entries for an unloaded module are forgotten, even if the module's
+  // code file is then loaded with other symbols.
+  BasicSourceLineResolver cached_resolver;
+  cached_resolver.set_frame_cache_size(16);
+  ASSERT_TRUE(cached_resolver.LoadModule(&module1,
+                                         testdata_dir + "/module1.out"));
+  StackFrame frame;
+  frame.instruction = 0x2004;
+  frame.module = &module1;
+  cached_resolver.FillSourceLineInfo(&frame);
+  ASSERT_TRUE(frame.function_name.empty());
+  cached_resolver.UnloadModule(&module1);
+  ASSERT_TRUE(cached_resolver.LoadModule(&module1,
+                                         testdata_dir + "/module2.out"));
+  ClearSourceLineInfo(&frame);
+  frame.module = &module1;
+  cached_resolver.FillSourceLineInfo(&frame);
+  ASSERT_EQ("Function2_1", frame.function_name);
+}
+
+TEST_F(TestBasicSourceLineResolver, TestShareNames)
+{
+  TestCodeModule module1("module1");
+  ASSERT_TRUE(resolver.LoadModule(&module1, testdata_dir + "/module1.out"));
+
+  // Shared names read the same as copied ones, with or without the frame
+  // cache, but leave the frame's own strings empty.
+  const size_t kCacheSizes[] = { 0, 16 };
+  for (size_t i = 0; i < sizeof(kCacheSizes) / sizeof(kCacheSizes[0]); ++i) {
+    BasicSourceLineResolver sharing_resolver;
+    sharing_resolver.set_frame_cache_size(kCacheSizes[i]);
+    sharing_resolver.set_share_names(true);
+    EXPECT_TRUE(sharing_resolver.share_names());
+    ASSERT_TRUE(sharing_resolver.LoadModule(&module1,
+                                            testdata_dir + "/module1.out"));
+    for (int pass = 0; pass < 2; ++pass) {
+      for (uint64_t address = 0x800; address < 0x3100; address += 0x18) {
+        StackFrame expected;
+        expected.instruction = address;
+        expected.module = &module1;
+        resolver.FillSourceLineInfo(&expected);
+
+        StackFrame frame;
+        frame.instruction = address;
+        frame.module = &module1;
+        sharing_resolver.FillSourceLineInfo(&frame);
+        EXPECT_TRUE(frame.function_name.empty());
+        EXPECT_TRUE(frame.source_file_name.empty());
+        EXPECT_EQ(expected.function_name, frame.FunctionName());
+        EXPECT_EQ(expected.function_base, frame.function_base);
+        EXPECT_EQ(expected.source_file_name, frame.SourceFileName());
+        EXPECT_EQ(expected.source_line, frame.source_line);
+        EXPECT_EQ(expected.source_line_base, frame.source_line_base);
+      }
+    }
+  }
+
+  StackFrame frame;
+  frame.instruction = 0x1000;
+  frame.module = &module1;
+  resolver.FillSourceLineInfo(&frame);
+  EXPECT_EQ("Function1_1", frame.function_name);
+  EXPECT_STREQ("Function1_1", frame.FunctionName());
+  EXPECT_TRUE(frame.shared_function_name == NULL);
+}
+
+TEST_F(TestBasicSourceLineResolver, TestFreezeModules)
+{
+  TestCodeModule module1("module1");
+  ASSERT_TRUE(resolver.LoadModule(&module1, testdata_dir + "/module1.out"));
+
+  BasicSourceLineResolver frozen_resolver;
+  frozen_resolver.set_freeze_modules(true);
+  EXPECT_TRUE(frozen_resolver.freeze_modules());
+  ASSERT_TRUE(frozen_resolver.LoadModule(&module1,
+                                         testdata_dir + "/module1.out"));
+
+  // Frozen modules find the same Windows stack walking information.
+  for (uint64_t address = 0x800; address < 0x3100; address += 0x10) {
+    StackFrame frame;
+    frame.instruction = address;
+    frame.module = &module1;
+    scoped_ptr<WindowsFrameInfo> expected(
+        resolver.FindWindowsFrameInfo(&frame));
+    scoped_ptr<WindowsFrameInfo> found(
+        frozen_resolver.FindWindowsFrameInfo(&frame));
+    ASSERT_EQ(expected.get() != NULL, found.get() != NULL);
+    if (!expected.get())
+      continue;
+    EXPECT_EQ(expected->type_, found->type_);
+    EXPECT_EQ(expected->prolog_size, found->prolog_size);
+    EXPECT_EQ(expected->program_string, found->program_string);
+  }
+}
+
+TEST_F(TestBasicSourceLineResolver, TestSymbolizeAddresses)
+{
+  TestCodeModule module1("module1", "module1.pdb", "ID1");
+  TestCodeModule module2("module2", "module2.pdb", "ID2");
+  TestCodeModule module3("module3");
+  ASSERT_TRUE(resolver.LoadModule(&module1, testdata_dir + "/module1.out"));
+  ASSERT_TRUE(resolver.LoadModule(&module2, testdata_dir + "/module2.out"));
+
+  // Interleave the modules and visit the addresses out of order, with
+  // repeats, and lookups that find nothing.
+  std::vector<SourceLineResolverBase::AddressLookup> lookups;
+  for (uint64_t address = 0x3100; address >= 0x800; address -= 0x6) {
+    SourceLineResolverBase::AddressLookup lookup = { &module1, address };
+    lookups.push_back(lookup);
+    lookup.module = (address & 0x10) ? &module2 : &module3;
+    lookups.push_back(lookup);
+    lookup.module = &module1;
+    lookup.address = address ^ 0x4;
+    lookups.push_back(lookup);
+  }
+  SourceLineResolverBase::AddressLookup no_module = { NULL, 0x1000 };
+  lookups.push_back(no_module);
+
+  // Modules shared through a module cache find the same.
+  SymbolModuleCache cache(1 << 20);
+  BasicSourceLineResolver cached_resolver;
+  cached_resolver.set_module_cache(&cache);
+  ASSERT_TRUE(cached_resolver.LoadModule(&module1,
+                                         testdata_dir + "/module1.out"));
+  ASSERT_TRUE(cached_resolver.LoadModule(&module2,
+                                         testdata_dir + "/module2.out"));
+  BasicSourceLineResolver *resolvers[] = { &resolver, &cached_resolver };
+
+  for (size_t r = 0; r < sizeof(resolvers) / sizeof(resolvers[0]); ++r) {
+    std::vector<SourceLineResolverBase::SymbolizedAddress> results(
+        lookups.size());
+    resolvers[r]->SymbolizeAddresses(&lookups[0], lookups.size(),
+                                     &results[0]);
+    for (size_t i = 0; i < lookups.size(); ++i) {
+      StackFrame expected;
+      expected.instruction = lookups[i].address;
+      expected.module = lookups[i].module;
+      resolver.FillSourceLineInfo(&expected);
+      const SourceLineResolverBase::SymbolizedAddress &result = results[i];
+      EXPECT_EQ(expected.function_name,
+                result.function_name ? result.function_name : "");
+      EXPECT_EQ(expected.function_name.empty() ? 0 :
+                    expected.instruction - expected.function_base,
+                result.function_offset);
+      EXPECT_EQ(expected.source_file_name,
+                result.source_file_name ? result.source_file_name : "");
+      EXPECT_EQ(expected.source_line, result.source_line);
+    }
+  }
+
+  // Each name is stored once.
+  SourceLineResolverBase::AddressLookup same_function[] = {
+    { &module1, 0x1000 }, { &module1, 0x1008 }
+  };
+  SourceLineResolverBase::SymbolizedAddress results[2];
+  resolver.SymbolizeAddresses(same_function, 2, results);
+  EXPECT_STREQ("Function1_1", results[0].function_name);
+  EXPECT_EQ(results[0].function_name, results[1].function_name);
+  EXPECT_EQ(results[0].source_file_name, results[1].source_file_name);
+  EXPECT_EQ(46, results[1].source_line);
+  EXPECT_EQ(8U, results[1].function_offset);
+}
+
+TEST_F(TestBasicSourceLineResolver, TestSharedModuleCache)
+{
+  SymbolModuleCache cache(1 << 20);
+  BasicSourceLineResolver resolver1;
+  resolver1.set_module_cache(&cache);
+  BasicSourceLineResolver resolver2;
+  resolver2.set_module_cache(&cache);
+
+  TestCodeModule module1("module1", "module1.pdb", "ID1");
+  ASSERT_TRUE(resolver1.LoadModule(&module1, testdata_dir + "/module1.out"));
+  ASSERT_EQ(1U, cache.module_count());
+  ASSERT_EQ(1001U, cache.memory_used());
+
+  // The second resolver finds the module without loading it.
+  ASSERT_TRUE(resolver2.HasModule(&module1));
+  ASSERT_EQ(1U, cache.module_count());
+  StackFrame frame;
+  frame.instruction = 0x1000;
+  frame.module = &module1;
+  resolver2.FillSourceLineInfo(&frame);
+  ASSERT_EQ("Function1_1", frame.function_name);
+  ASSERT_EQ("file1_1.cc", frame.source_file_name);
+  ASSERT_EQ(44, frame.source_line);
+
+  // Corruption is remembered along with the module.
+  TestCodeModule module3("module3", "module3.pdb", "ID3");
+  ASSERT_TRUE(resolver1.LoadModule(&module3,
+                                   testdata_dir + "/module3_bad.out"));
+  ASSERT_TRUE(resolver1.IsModuleCorrupt(&module3));
+  ASSERT_TRUE(resolver2.HasModule(&module3));
+  ASSERT_TRUE(resolver2.IsModuleCorrupt(&module3));
+
+  // Modules without a debug identifier are not shared.
+  TestCodeModule module2("module2");
+  ASSERT_TRUE(resolver1.LoadModule(&module2, testdata_dir + "/module2.out"));
+  ASSERT_FALSE(resolver2.HasModule(&module2));
+  ASSERT_EQ(2U, cache.module_count());
+
+  // Unloading from one resolver leaves the other's copy usable.
+  resolver1.UnloadModule(&module1);
+  ASSERT_EQ(2U, cache.module_count());
+  frame.function_name.clear();
+  resolver2.FillSourceLineInfo(&frame);
+  ASSERT_EQ("Function1_1", frame.function_name);
+}
+
+TEST_F(TestBasicSourceLineResolver, TestShareModulesByDigest)
+{
+  BasicSourceLineResolver uncached;
+  TestCodeModule module1("module1", "module1.pdb", "ID1");
+  ASSERT_FALSE(uncached.CanShareModulesByDigest());
+  ASSERT_FALSE(uncached.LoadModuleUsingDigest(&module1, "digest1"));
+
+  SymbolModuleCache cache(1 << 20);
+  BasicSourceLineResolver resolver1;
+  resolver1.set_module_cache(&cache);
+  BasicSourceLineResolver resolver2;
+  resolver2.set_module_cache(&cache);
+  ASSERT_TRUE(resolver1.CanShareModulesByDigest());
+
+  // Nothing has the digest yet, so the module is loaded as usual and its
+  // symbols are cached under the digest.
+  ASSERT_FALSE(resolver1.LoadModuleUsingDigest(&module1, "digest1"));
+  ASSERT_TRUE(resolver1.LoadModule(&module1, testdata_dir + "/module1.out"));
+  ASSERT_EQ(1U, cache.module_count());
+
+  // The same library rebuilt under another debug identifier shares them.
+  TestCodeModule rebuilt("rebuilt", "module1.pdb", "ID1B");
+  ASSERT_TRUE(resolver2.LoadModuleUsingDigest(&rebuilt, "digest1"));
+  ASSERT_EQ(1U, cache.module_count());
+  ASSERT_EQ(1U, cache.digest_share_count());
+  StackFrame frame;
+  frame.instruction = 0x1000;
+  frame.module = &rebuilt;
+  resolver2.FillSourceLineInfo(&frame);
+  ASSERT_EQ("Function1_1", frame.function_name);
+  ASSERT_EQ(44, frame.source_line);
+
+  // Another digest doesn't match.
+  TestCodeModule other("other", "other.pdb", "ID9");
+  ASSERT_FALSE(resolver2.LoadModuleUsingDigest(&other, "digest2"));
+  ASSERT_FALSE(resolver2.HasModule(&other));
+
+  // Invalidating the symbols drops the digest too.
+  resolver2.UnloadModule(&rebuilt);
+  cache.Invalidate("module1.pdb", "ID1");
+  ASSERT_FALSE(resolver2.LoadModuleUsingDigest(&rebuilt, "digest1"));
+}
+
+TEST_F(TestBasicSourceLineResolver, TestModuleCacheEviction)
+{
+  // Room for one copy of module1.out, not for module2.out too.
+  SymbolModuleCache cache(1500);
+  TestCodeModule module1("module1", "module1.pdb", "ID1");
+  TestCodeModule module2("module2", "module2.pdb", "ID2");
+  {
+    BasicSourceLineResolver first;
+    first.set_module_cache(&cache);
+    ASSERT_TRUE(first.LoadModule(&module1, testdata_dir + "/module1.out"));
+    ASSERT_TRUE(first.LoadModule(&module2, testdata_dir + "/module2.out"));
+    // Modules in use are kept even though they exceed the budget.
+    ASSERT_EQ(2U, cache.module_count());
+    ASSERT_EQ(1665U, cache.memory_used());
+    first.UnloadModule(&module1);
+  }
+
+  // module1 was released first, so it was evicted; module2 stays.
+  ASSERT_EQ(1U, cache.module_count());
+  ASSERT_EQ(664U, cache.memory_used());
+
+  BasicSourceLineResolver second;
+  second.set_module_cache(&cache);
+  ASSERT_FALSE(second.HasModule(&module1));
+  ASSERT_TRUE(second.HasModule(&module2));
+
+  cache.set_memory_budget(0);
+  ASSERT_EQ(1U, cache.module_count());
+  second.UnloadModule(&module2);
+  ASSERT_EQ(0U, cache.module_count());
+  ASSERT_EQ(0U, cache.memory_used());
+}
+
+// Evicts the most recently released module, and records what it was
+// offered.
+class NewestFirstEvictionPolicy : public SymbolModuleCache::EvictionPolicy {
+ public:
+  virtual size_t ChooseVictim(const std::vector<Candidate> &candidates,
+                              uint64_t use_count) {
+    this->candidates = candidates;
+    return candidates.size() - 1;
+  }
+
+  std::vector<Candidate> candidates;
+};
+
+TEST_F(TestBasicSourceLineResolver, TestModuleCacheEvictionPolicy)
+{
+  SymbolModuleCache cache(1 << 20);
+  NewestFirstEvictionPolicy policy;
+  cache.set_eviction_policy(&policy);
+  TestCodeModule module1("module1", "module1.pdb", "ID1");
+  TestCodeModule module2("module2", "module2.pdb", "ID2");
+  {
+    BasicSourceLineResolver resolver;
+    resolver.set_module_cache(&cache);
+    ASSERT_TRUE(resolver.LoadModule(&module1, testdata_dir + "/module1.out"));
+    ASSERT_TRUE(resolver.LoadModule(&module2, testdata_dir + "/module2.out"));
+    resolver.UnloadModule(&module1);
+  }
+  ASSERT_EQ(2U, cache.module_count());
+
+  // Room for module1.out, not for module2.out too.  module2 was released
+  // last, so the policy chooses it over module1.
+  cache.set_memory_budget(1500);
+  ASSERT_EQ(2U, policy.candidates.size());
+  ASSERT_EQ("module1.pdb|ID1", policy.candidates[0].key);
+  ASSERT_EQ(1001U, policy.candidates[0].size);
+  ASSERT_LT(0U, policy.candidates[0].memory_usage.functions);
+  ASSERT_EQ("module2.pdb|ID2", policy.candidates[1].key);
+  ASSERT_LT(policy.candidates[0].last_use, policy.candidates[1].last_use);
+  ASSERT_EQ(1U, cache.module_count());
+  ASSERT_EQ(1001U, cache.memory_used());
+
+  BasicSourceLineResolver resolver;
+  resolver.set_module_cache(&cache);
+  ASSERT_TRUE(resolver.HasModule(&module1));
+  ASSERT_FALSE(resolver.HasModule(&module2));
+}
+
+TEST_F(TestBasicSourceLineResolver, TestSizeWeightedEvictionPolicy)
+{
+  SizeWeightedEvictionPolicy policy;
+  std::vector<SymbolModuleCache::EvictionPolicy::Candidate> candidates(2);
+  candidates[0].memory_usage.functions = 100;
+  candidates[0].last_use = 1;
+  candidates[1].memory_usage.functions = 1000;
+  candidates[1].last_use = 99;
+
+  // A module unused for long goes before a larger one in recent use...
+  ASSERT_EQ(0U, policy.ChooseVictim(candidates, 100));
+  // ...unless the larger one is large enough.
+  candidates[1].memory_usage.functions = 100000;
+  ASSERT_EQ(1U, policy.ChooseVictim(candidates, 100));
+}
+
+TEST_F(TestBasicSourceLineResolver, TestModuleMemoryUsage)
+{
+  TestCodeModule module1("module1");
+  TestCodeModule module2("module2");
+  SourceLineResolverBase::ModuleMemoryUsage usage;
+  ASSERT_FALSE(resolver.GetModuleMemoryUsage(&module1, &usage));
+  ASSERT_EQ(0U, resolver.memory_used());
+
+  ASSERT_TRUE(resolver.LoadModule(&module1, testdata_dir + "/module1.out"));
+  ASSERT_TRUE(resolver.GetModuleMemoryUsage(&module1, &usage));
+  ASSERT_LT(0U, usage.files);
+  ASSERT_LT(0U, usage.functions);
+  ASSERT_LT(0U, usage.lines);
+  ASSERT_LT(0U, usage.public_symbols);
+  ASSERT_LT(0U, usage.frame_info);
+  ASSERT_EQ(0U, usage.other);
+  ASSERT_EQ(usage.total(), resolver.memory_used());
+
+  ASSERT_TRUE(resolver.LoadModule(&module2, testdata_dir + "/module2.out"));
+  SourceLineResolverBase::ModuleMemoryUsage usage2;
+  ASSERT_TRUE(resolver.GetModuleMemoryUsage(&module2, &usage2));
+  ASSERT_LT(0U, usage2.functions);
+  ASSERT_EQ(usage.total() + usage2.total(), resolver.memory_used());
+
+  resolver.UnloadModule(&module1);
+  ASSERT_FALSE(resolver.GetModuleMemoryUsage(&module1, &usage));
+  ASSERT_EQ(usage2.total(), resolver.memory_used());
+}
+
+TEST_F(TestBasicSourceLineResolver, TestModuleCacheReload)
+{
+  SymbolModuleCache cache(1 << 20);
+  BasicSourceLineResolver resolver;
+  resolver.set_module_cache(&cache);
+  BasicSourceLineResolver reloader;
+  reloader.set_module_cache(&cache);
+
+  TestCodeModule module1("module1", "module1.pdb", "ID1");
+  TestCodeModule module2("module2", "module2.pdb", "ID2");
+  ASSERT_TRUE(resolver.LoadModule(&module1, testdata_dir + "/module1.out"));
+  ASSERT_TRUE(resolver.LoadModule(&module2, testdata_dir + "/module2.out"));
+  ASSERT_EQ(1665U, cache.memory_used());
+  uint32_t generation = cache.generation();
+
+  StackFrame frame;
+  frame.instruction = 0x1000;
+  frame.module = &module1;
+  resolver.FillSourceLineInfo(&frame);
+  ASSERT_EQ("Function1_1", frame.function_name);
+
+  // Publish different symbols for module1.  The resolver keeps using the
+  // version it holds until it checks for the module again.
+  ASSERT_TRUE(reloader.ReloadModule(&module1, testdata_dir + "/module2.out"));
+  ASSERT_NE(generation, cache.generation());
+  ASSERT_EQ(2U, cache.module_count());
+  ASSERT_EQ(1665U + 664U, cache.memory_used());
+  frame.function_name.clear();
+  resolver.FillSourceLineInfo(&frame);
+  ASSERT_EQ("Function1_1", frame.function_name);
+
+  // Once it does, it switches to the new version, and the old one is freed.
+  ASSERT_TRUE(resolver.HasModule(&module1));
+  ASSERT_EQ(2U * 664U, cache.memory_used());
+  frame.function_name.clear();
+  resolver.FillSourceLineInfo(&frame);
+  ASSERT_EQ("", frame.function_name);
+  frame.instruction = 0x2000;
+  resolver.FillSourceLineInfo(&frame);
+  ASSERT_EQ("Function2_1", frame.function_name);
+
+  // module2 was left alone.
+  frame.module = &module2;
+  frame.function_name.clear();
+  resolver.FillSourceLineInfo(&frame);
+  ASSERT_EQ("Function2_1", frame.function_name);
+
+  // Modules without a debug identifier can't be reloaded.
+  TestCodeModule module3("module3");
+  ASSERT_FALSE(reloader.ReloadModule(&module3, testdata_dir + "/module1.out"));
+
+  // Invalidated modules are fetched again, not found in the cache.
+  cache.Invalidate("module2.pdb", "ID2");
+  ASSERT_TRUE(resolver.HasModule(&module1));
+  ASSERT_FALSE(resolver.HasModule(&module2));
+  ASSERT_EQ(1U, cache.module_count());
+  ASSERT_EQ(664U, cache.memory_used());
+
+  cache.InvalidateAll();
+  ASSERT_FALSE(resolver.HasModule(&module1));
+  ASSERT_EQ(0U, cache.module_count());
+  ASSERT_EQ(0U, cache.memory_used());
+}
+
+// Builds several megabytes of symbol data: FILE, FUNC, line, PUBLIC, STACK
+// WIN and STACK CFI records for |function_count| functions.  If
+// |bad_lines| is non-zero, that many unparseable lines are inserted
+// right after the FILE records.
+static string MakeLargeSymbolData(int function_count, int bad_lines) {
+  string data = "MODULE windows x86 111111111111111111111111111111111 big.pdb\n";
+  char line[256];
+  for (int i = 0; i < 50; ++i) {
+    snprintf(line, sizeof(line), "FILE %d big_file_%d.cc\n", i, i);
+    data += line;
+  }
+  for (int i = 0; i < bad_lines; ++i) {
+    data += "FUNC this is not a function\n";
+  }
+  for (int i = 0; i < function_count; ++i) {
+    unsigned int address = 0x1000 + i * 0x100;
+    snprintf(line, sizeof(line), "FUNC %x 100 4 BigFunction_%d\n",
+             address, i);
+    data += line;
+    for (int j = 0; j < 4; ++j) {
+      snprintf(line, sizeof(line), "%x 40 %d %d\n",
+               address + j * 0x40, i * 10 + j, i % 50);
+      data += line;
+    }
+  }
+  for (int i = 0; i < function_count; ++i) {
+    snprintf(line, sizeof(line), "PUBLIC %x 8 BigPublic_%d\n",
+             0x10000000 + i * 0x10, i);
+    data += line;
+  }
+  for (int i = 0; i < function_count; ++i) {
+    unsigned int address = 0x1000 + i * 0x100;
+    snprintf(line, sizeof(line),
+             "STACK WIN 4 %x 100 1 0 0 0 0 0 1 $eip %d + ^ =\n",
+             address, i);
+    data += line;
+    snprintf(line, sizeof(line),
+             "STACK CFI INIT %x 100 .cfa: $esp %d + .ra: .cfa 4 - ^\n",
+             address, i);
+    data += line;
+    snprintf(line, sizeof(line), "STACK CFI %x .cfa: $esp %d +\n",
+             address + 0x80, i + 8);
+    data += line;
+  }
+  return data;
+}
+
+// Checks that |parallel| resolves every function in MakeLargeSymbolData's
+// output the same way as |serial|.
+static void ExpectSameLookups(BasicSourceLineResolver *serial,
+                              BasicSourceLineResolver *parallel,
+                              const CodeModule *module,
+                              int function_count) {
+  for (int i = 0; i < function_count; ++i) {
+    uint64_t addresses[] = {
+      0x1000 + i * 0x100 + 0x50,
+      0x1000 + i * 0x100 + 0xc0,
+      0x10000000 + i * 0x10 + 4
+    };
+    for (size_t j = 0; j < sizeof(addresses) / sizeof(addresses[0]); ++j) {
+      StackFrame serial_frame;
+      serial_frame.instruction = addresses[j];
+      serial_frame.module = module;
+      serial->FillSourceLineInfo(&serial_frame);
+      StackFrame parallel_frame;
+      parallel_frame.instruction = addresses[j];
+      parallel_frame.module = module;
+      parallel->FillSourceLineInfo(&parallel_frame);
+      ASSERT_EQ(serial_frame.function_name, parallel_frame.function_name);
+      ASSERT_EQ(serial_frame.function_base, parallel_frame.function_base);
+      ASSERT_EQ(serial_frame.source_file_name,
+                parallel_frame.source_file_name);
+      ASSERT_EQ(serial_frame.source_line, parallel_frame.source_line);
+
+      scoped_ptr<WindowsFrameInfo> serial_windows(
+          serial->FindWindowsFrameInfo(&serial_frame));
+      scoped_ptr<WindowsFrameInfo> parallel_windows(
+          parallel->FindWindowsFrameInfo(&parallel_frame));
+      ASSERT_EQ(serial_windows.get() != NULL, parallel_windows.get() != NULL);
+      if (serial_windows.get()) {
+        ASSERT_EQ(serial_windows->program_string,
+                  parallel_windows->program_string);
+      }
+
+      scoped_ptr<CFIFrameInfo> serial_cfi(
+          serial->FindCFIFrameInfo(&serial_frame));
+      scoped_ptr<CFIFrameInfo> parallel_cfi(
+          parallel->FindCFIFrameInfo(&parallel_frame));
+      ASSERT_EQ(serial_cfi.get() != NULL, parallel_cfi.get() != NULL);
+      if (serial_cfi.get()) {
+        ASSERT_EQ(serial_cfi->Serialize(), parallel_cfi->Serialize());
+      }
+    }
+  }
+}
+
+TEST_F(TestBasicSourceLineResolver, TestParallelLoad)
+{
+  const int kFunctionCount = 20000;
+  string data = MakeLargeSymbolData(kFunctionCount, 0);
+  ASSERT_GT(data.size(), 4U << 20);
+  TestCodeModule module("big");
+
+  BasicSourceLineResolver serial;
+  ASSERT_TRUE(serial.LoadModuleUsingMapBuffer(&module, data));
+  ASSERT_FALSE(serial.IsModuleCorrupt(&module));
+
+  // Enough threads that chunk boundaries fall among the line records.
+  BasicSourceLineResolver::set_load_thread_count(7);
+  BasicSourceLineResolver parallel;
+  bool loaded = parallel.LoadModuleUsingMapBuffer(&module, data);
+  BasicSourceLineResolver::set_load_thread_count(1);
+  ASSERT_TRUE(loaded);
+  ASSERT_FALSE(parallel.IsModuleCorrupt(&module));
+
+  StackFrame frame;
+  frame.instruction = 0x1000 + 1234 * 0x100 + 0x90;
+  frame.module = &module;
+  parallel.FillSourceLineInfo(&frame);
+  ASSERT_EQ("BigFunction_1234", frame.function_name);
+  ASSERT_EQ("big_file_34.cc", frame.source_file_name);
+  ASSERT_EQ(12342, frame.source_line);
+
+  ExpectSameLookups(&serial, &parallel, &module, kFunctionCount);
+}
+
+TEST_F(TestBasicSourceLineResolver, TestParallelLoadGivesUp)
+{
+  // Too many bad lines make the loader stop before the good records, no
+  // matter how the data is split.
+  const int kFunctionCount = 20000;
+  string data = MakeLargeSymbolData(kFunctionCount, 150);
+  TestCodeModule module("big");
+
+  BasicSourceLineResolver serial;
+  ASSERT_TRUE(serial.LoadModuleUsingMapBuffer(&module, data));
+  ASSERT_TRUE(serial.IsModuleCorrupt(&module));
+
+  BasicSourceLineResolver::set_load_thread_count(4);
+  BasicSourceLineResolver parallel;
+  bool loaded = parallel.LoadModuleUsingMapBuffer(&module, data);
+  BasicSourceLineResolver::set_load_thread_count(1);
+  ASSERT_TRUE(loaded);
+  ASSERT_TRUE(parallel.IsModuleCorrupt(&module));
+
+  StackFrame frame;
+  frame.instruction = 0x1000 + 1234 * 0x100;
+  frame.module = &module;
+  parallel.FillSourceLineInfo(&frame);
+  ASSERT_TRUE(frame.function_name.empty());
+
+  ExpectSameLookups(&serial, &parallel, &module, kFunctionCount);
+}
+
+// Writes |data| to |path| as a gzip file, in stored (uncompressed) deflate
+// blocks, so that the test doesn't need a compressor.
+static bool WriteStoredGzipFile(const string &path, const string &data) {
+  uint32_t crc_table[256];
+  for (uint32_t i = 0; i < 256; ++i) {
+    uint32_t c = i;
+    for (int k = 0; k < 8; ++k)
+      c = (c & 1) ? 0xedb88320 ^ (c >> 1) : c >> 1;
+    crc_table[i] = c;
+  }
+  uint32_t crc = 0xffffffff;
+  for (size_t i = 0; i < data.size(); ++i)
+    crc = crc_table[(crc ^ static_cast<unsigned char>(data[i])) & 0xff] ^
+          (crc >> 8);
+  crc ^= 0xffffffff;
+
+  string gzip("\x1f\x8b\x08\0\0\0\0\0\0\xff", 10);
+  size_t offset = 0;
+  do {
+    size_t size = data.size() - offset;
+    if (size > 0xffff)
+      size = 0xffff;
+    bool final_block = offset + size == data.size();
+    gzip += static_cast<char>(final_block ? 1 : 0);
+    gzip += static_cast<char>(size & 0xff);
+    gzip += static_cast<char>(size >> 8);
+    gzip += static_cast<char>(~size & 0xff);
+    gzip += static_cast<char>((~size >> 8) & 0xff);
+    gzip.append(data, offset, size);
+    offset += size;
+  } while (offset < data.size());
+  for (int i = 0; i < 4; ++i)
+    gzip += static_cast<char>((crc >> (i * 8)) & 0xff);
+  for (int i = 0; i < 4; ++i)
+    gzip += static_cast<char>((data.size() >> (i * 8)) & 0xff);
+
+  FILE *file = fopen(path.c_str(), "wb");
+  if (!file)
+    return false;
+  bool written = fwrite(gzip.data(), 1, gzip.size(), file) == gzip.size();
+  return fclose(file) == 0 && written;
+}
+
+// Writes |data| to |path| as a zstd file, in raw (uncompressed) blocks.
+static bool WriteRawZstdFile(const string &path, const string &data) {
+  // Magic number, a frame header with no content size or checksum, and a
+  // 128 KiB window.
+  string zstd("\x28\xb5\x2f\xfd\x00\x38", 6);
+  size_t offset = 0;
+  do {
+    size_t size = data.size() - offset;
+    if (size > 128 * 1024)
+      size = 128 * 1024;
+    bool last_block = offset + size == data.size();
+    uint32_t header = static_cast<uint32_t>(size << 3) | (last_block ? 1 : 0);
+    for (int i = 0; i < 3; ++i)
+      zstd += static_cast<char>((header >> (i * 8)) & 0xff);
+    zstd.append(data, offset, size);
+    offset += size;
+  } while (offset < data.size());
+
+  FILE *file = fopen(path.c_str(), "wb");
+  if (!file)
+    return false;
+  bool written = fwrite(zstd.data(), 1, zstd.size(), file) == zstd.size();
+  return fclose(file) == 0 && written;
+}
+
+TEST_F(TestBasicSourceLineResolver, TestLoadCompressedFile)
+{
+  const int kFunctionCount = 20000;
+  string data = MakeLargeSymbolData(kFunctionCount, 0);
+  TestCodeModule module("big");
+
+  BasicSourceLineResolver serial;
+  ASSERT_TRUE(serial.LoadModuleUsingMapBuffer(&module, data));
+
+  AutoTempDir temp_dir;
+  string gzip_path = temp_dir.path() + "/big.sym.gz";
+  ASSERT_TRUE(WriteStoredGzipFile(gzip_path, data));
+  BasicSourceLineResolver gzip_resolver;
+  ASSERT_TRUE(gzip_resolver.LoadModuleUsingCompressedFile(&module,
+                                                          gzip_path));
+  ASSERT_FALSE(gzip_resolver.IsModuleCorrupt(&module));
+  ExpectSameLookups(&serial, &gzip_resolver, &module, kFunctionCount);
+
+  string zstd_path = temp_dir.path() + "/big.sym.zst";
+  ASSERT_TRUE(WriteRawZstdFile(zstd_path, data));
+  scoped_ptr<SymbolFileDecompressor> zstd_decompressor(
+      SymbolFileDecompressor::Open(zstd_path));
+  if (!zstd_decompressor.get()) {
+    fprintf(stderr, "libzstd is not available; skipping zstd\n");
+    return;
+  }
+  BasicSourceLineResolver zstd_resolver;
+  ASSERT_TRUE(zstd_resolver.LoadModuleUsingCompressedFile(&module,
+                                                          zstd_path));
+  ASSERT_FALSE(zstd_resolver.IsModuleCorrupt(&module));
+  ExpectSameLookups(&serial, &zstd_resolver, &module, kFunctionCount);
+}
+
+TEST_F(TestBasicSourceLineResolver, TestLoadBadCompressedFile)
+{
+  string data = MakeLargeSymbolData(100, 0);
+  TestCodeModule module("big");
+  AutoTempDir temp_dir;
+
+  // Text symbol files aren't compressed symbol files.
+  string text_path = temp_dir.path() + "/big.sym";
+  FILE *file = fopen(text_path.c_str(), "wb");
+  ASSERT_TRUE(file);
+  fwrite(data.data(), 1, data.size(), file);
+  fclose(file);
+  ASSERT_FALSE(resolver.LoadModuleUsingCompressedFile(&module, text_path));
+  ASSERT_FALSE(resolver.HasModule(&module));
+
+  // A truncated file is an error rather than a module with fewer symbols.
+  string gzip_path = temp_dir.path() + "/big.sym.gz";
+  ASSERT_TRUE(WriteStoredGzipFile(gzip_path, data));
+  ASSERT_EQ(0, truncate(gzip_path.c_str(), data.size() / 2));
+  ASSERT_FALSE(resolver.LoadModuleUsingCompressedFile(&module, gzip_path));
+  ASSERT_FALSE(resolver.HasModule(&module));
+
+  ASSERT_FALSE(resolver.LoadModuleUsingCompressedFile(
+      &module, temp_dir.path() + "/missing.sym.gz"));
+}
+
+static bool WriteFile(const string &path, const string &data) {
+  FILE *file = fopen(path.c_str(), "wb");
+  if (!file)
+    return false;
+  bool written = fwrite(data.data(), 1, data.size(), file) == data.size();
+  return fclose(file) == 0 && written;
+}
+
+TEST_F(TestBasicSourceLineResolver, TestLoadIndexedFile)
+{
+  const int kFunctionCount = 2000;
+  string data = MakeLargeSymbolData(kFunctionCount, 0);
+  TestCodeModule module("big");
+
+  BasicSourceLineResolver serial;
+  ASSERT_TRUE(serial.LoadModuleUsingMapBuffer(&module, data));
+
+  AutoTempDir temp_dir;
+  string symbol_path = temp_dir.path() + "/big.sym";
+  string index_path = symbol_path + ".idx";
+  string index;
+  SymbolFileIndex::Build(data.data(), data.size(), &index);
+  ASSERT_TRUE(WriteFile(symbol_path, data));
+  ASSERT_TRUE(WriteFile(index_path, index));
+
+  // Only resolvers asked to load modules lazily do.
+  BasicSourceLineResolver eager;
+  ASSERT_FALSE(eager.CanLoadModulesUsingIndexedFiles());
+  ASSERT_FALSE(eager.LoadModuleUsingIndexedFile(&module, symbol_path,
+                                                index_path));
+
+  BasicSourceLineResolver lazy;
+  lazy.set_load_modules_lazily(true);
+  ASSERT_TRUE(lazy.CanLoadModulesUsingIndexedFiles());
+  ASSERT_TRUE(lazy.LoadModuleUsingIndexedFile(&module, symbol_path,
+                                              index_path));
+  ASSERT_FALSE(lazy.IsModuleCorrupt(&module));
+  ExpectSameLookups(&serial, &lazy, &module, kFunctionCount);
+
+  // STACK WIN records are loaded before the maps holding them are frozen.
+  BasicSourceLineResolver frozen;
+  frozen.set_load_modules_lazily(true);
+  frozen.set_freeze_modules(true);
+  ASSERT_TRUE(frozen.LoadModuleUsingIndexedFile(&module, symbol_path,
+                                                index_path));
+  ExpectSameLookups(&serial, &frozen, &module, kFunctionCount);
+}
+
+TEST_F(TestBasicSourceLineResolver, TestLoadBadIndexedFile)
+{
+  string data = MakeLargeSymbolData(100, 0);
+  TestCodeModule module("big");
+  AutoTempDir temp_dir;
+  string symbol_path = temp_dir.path() + "/big.sym";
+  string index_path = symbol_path + ".idx";
+  ASSERT_TRUE(WriteFile(symbol_path, data));
+  resolver.set_load_modules_lazily(true);
+
+  ASSERT_FALSE(resolver.LoadModuleUsingIndexedFile(&module, symbol_path,
+                                                   index_path));
+
+  // A symbol file isn't an index.
+  ASSERT_FALSE(resolver.LoadModuleUsingIndexedFile(&module, symbol_path,
+                                                   symbol_path));
+
+  // Nor is an index for a symbol file that has since changed.
+  string index;
+  SymbolFileIndex::Build(data.data(), data.size(), &index);
+  ASSERT_TRUE(WriteFile(index_path, index));
+  ASSERT_TRUE(WriteFile(symbol_path, data + "PUBLIC 1 0 Extra\n"));
+  ASSERT_FALSE(resolver.LoadModuleUsingIndexedFile(&module, symbol_path,
+                                                   index_path));
+
+  // Nor is a truncated index.
+  ASSERT_TRUE(WriteFile(symbol_path, data));
+  ASSERT_TRUE(WriteFile(index_path, index.substr(0, index.size() - 1)));
+  ASSERT_FALSE(resolver.LoadModuleUsingIndexedFile(&module, symbol_path,
+                                                   index_path));
+  ASSERT_FALSE(resolver.HasModule(&module));
+}
+
+TEST_F(TestBasicSourceLineResolver, TestDeferSourceLines)
+{
+  const int kFunctionCount = 200;
+  string data = MakeLargeSymbolData(kFunctionCount, 0);
+  TestCodeModule module("big");
+
+  BasicSourceLineResolver full;
+  ASSERT_TRUE(full.LoadModuleUsingMapBuffer(&module, data));
+
+  ASSERT_TRUE(resolver.DeferSourceLines(true));
+  ASSERT_TRUE(resolver.LoadModuleUsingMapBuffer(&module, data));
+  ASSERT_FALSE(resolver.IsModuleCorrupt(&module));
+  ASSERT_TRUE(resolver.HasDeferredSourceLines(&module));
+  ASSERT_FALSE(full.HasDeferredSourceLines(&module));
+
+  // Everything but the source lines is there.
+  StackFrame frame;
+  frame.instruction = 0x1000 + 123 * 0x100 + 0x90;
+  frame.module = &module;
+  resolver.FillSourceLineInfo(&frame);
+  ASSERT_EQ("BigFunction_123", frame.function_name);
+  ASSERT_EQ(0x1000U + 123 * 0x100, frame.function_base);
+  ASSERT_TRUE(frame.source_file_name.empty());
+  ASSERT_EQ(0, frame.source_line);
+  scoped_ptr<WindowsFrameInfo> windows_frame_info(
+      resolver.FindWindowsFrameInfo(&frame));
+  ASSERT_TRUE(windows_frame_info.get());
+  scoped_ptr<CFIFrameInfo> cfi_frame_info(resolver.FindCFIFrameInfo(&frame));
+  ASSERT_TRUE(cfi_frame_info.get());
+
+  // Adding them makes the module the same as one loaded in full.
+  std::vector<char> buffer(data.begin(), data.end());
+  ASSERT_TRUE(resolver.LoadSourceLinesUsingMemoryBuffer(&module, &buffer[0],
+                                                        buffer.size()));
+  ASSERT_FALSE(resolver.IsModuleCorrupt(&module));
+  ASSERT_FALSE(resolver.HasDeferredSourceLines(&module));
+  ExpectSameLookups(&full, &resolver, &module, kFunctionCount);
+
+  // They can only be added once.
+  buffer.assign(data.begin(), data.end());
+  ASSERT_FALSE(resolver.LoadSourceLinesUsingMemoryBuffer(&module, &buffer[0],
+                                                         buffer.size()));
+}
+
+TEST_F(TestBasicSourceLineResolver, TestUnorderedLines)
+{
+  // Line records needn't be in address order.  One that overlaps an
+  // earlier line of its function is dropped, as is an empty one.
+  string data =
+      "FILE 1 file1.cc\n"
+      "FUNC 1000 100 0 Function1\n"
+      "1080 10 30 1\n"
+      "1000 10 10 1\n"
+      "1040 10 20 1\n"
+      "1048 10 99 1\n"
+      "1050 0 98 1\n"
+      "FUNC 2000 100 0 Function2\n"
+      "2000 100 40 1\n";
+  TestCodeModule module("unordered");
+  ASSERT_TRUE(resolver.LoadModuleUsingMapBuffer(&module, data));
+  ASSERT_FALSE(resolver.IsModuleCorrupt(&module));
+
+  const struct {
+    uint64_t address;
+    int line;
+    uint64_t line_base;
+  } kLookups[] = {
+    { 0x1000, 10, 0x1000 },
+    { 0x100f, 10, 0x1000 },
+    { 0x1010, 0, 0 },
+    { 0x104f, 20, 0x1040 },
+    { 0x1050, 0, 0 },
+    { 0x1085, 30, 0x1080 },
+    { 0x20ff, 40, 0x2000 },
+  };
+  for (size_t i = 0; i < sizeof(kLookups) / sizeof(kLookups[0]); ++i) {
+    StackFrame frame;
+    frame.instruction = kLookups[i].address;
+    frame.module = &module;
+    resolver.FillSourceLineInfo(&frame);
+    EXPECT_EQ(kLookups[i].line, frame.source_line) << i;
+    EXPECT_EQ(kLookups[i].line_base, frame.source_line_base) << i;
+  }
+}
+
 // Test parsing of valid FILE lines.  The format is:
 // FILE <id> <filename>
 TEST(SymbolParseHelper, ParseFileValid) {
@@ -483,6 +1425,16 @@ TEST(SymbolParseHelper, ParseFunctionValid) {
   EXPECT_EQ(0ULL, size);
   EXPECT_EQ(0, stack_param_size);
   EXPECT_EQ("function name", string(name));
+
+  // Test full-width, upper-case and "0x"-prefixed numbers, extra separators,
+  // and a line ending.
+  char kTestLine3[] = "FUNC  fedcba9876543210 0xAbC\r0010  function name\r\n";
+  ASSERT_TRUE(SymbolParseHelper::ParseFunction(kTestLine3, &address, &size,
+                                               &stack_param_size, &name));
+  EXPECT_EQ(0xfedcba9876543210ULL, address);
+  EXPECT_EQ(0xabcULL, size);
+  EXPECT_EQ(0x10, stack_param_size);
+  EXPECT_EQ(" function name", string(name));
 }
 
 // Test parsing of invalid FUNC lines.  The format is:
@@ -0,0 +1,160 @@
+// Copyright (c) 2016 Google Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+// notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above
+// copyright notice, this list of conditions and the following disclaimer
+// in the documentation and/or other materials provided with the
+// distribution.
+//     * Neither the name of Google Inc. nor the names of its
+// contributors may be used to endorse or promote products derived from
+// this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+// block_caching_minidump_reader.cc: Implementation of
+// BlockCachingMinidumpReader.
+//
+// See block_caching_minidump_reader.h for documentation.
+
+#include "google_breakpad/processor/block_caching_minidump_reader.h"
+
+#include <string.h>
+
+#include <algorithm>
+
+#include "processor/logging.h"
+
+namespace google_breakpad {
+
+const size_t BlockCachingMinidumpReader::kDefaultBlockSize;
+const size_t BlockCachingMinidumpReader::kDefaultMaxBlocks;
+
+BlockCachingMinidumpReader::BlockCachingMinidumpReader(
+    MinidumpReader* source, size_t block_size, size_t max_blocks)
+    : source_(source),
+      block_size_(block_size ? block_size : 1),
+      max_blocks_(max_blocks),
+      recent_(),
+      blocks_(),
+      source_reads_(0),
+      source_bytes_(0) {
+}
+
+BlockCachingMinidumpReader::~BlockCachingMinidumpReader() {
+}
+
+uint64_t BlockCachingMinidumpReader::size() const {
+  return source_->size();
+}
+
+bool BlockCachingMinidumpReader::ReadAt(uint64_t offset, void* buffer,
+                                        size_t count) {
+  const uint64_t size = source_->size();
+  if (offset > size || count > size - offset) {
+    BPLOG(ERROR) << "BlockCachingMinidumpReader read past end at " <<
+                    offset << "+" << count << "/" << size;
+    return false;
+  }
+  if (count == 0)
+    return true;
+
+  const uint64_t first = offset / block_size_;
+  const uint64_t last = (offset + count - 1) / block_size_;
+  if (last - first >= max_blocks_)
+    return ReadSource(offset, buffer, count);
+  if (!FetchBlocks(first, last))
+    return false;
+
+  uint8_t* destination = static_cast<uint8_t*>(buffer);
+  const uint64_t end = offset + count;
+  for (uint64_t index = first; index <= last; ++index) {
+    const Block& block = *blocks_[index];
+    const uint64_t block_start = index * block_size_;
+    const uint64_t from = std::max(offset, block_start) - block_start;
+    const uint64_t to = std::min<uint64_t>(end - block_start,
+                                           block.data.size());
+    memcpy(destination, &block.data[from], to - from);
+    destination += to - from;
+  }
+
+  // The blocks just read are the most recent, and there are no more than
+  // max_blocks_ of them, so they stay.
+  Trim();
+  return true;
+}
+
+bool BlockCachingMinidumpReader::FetchBlocks(uint64_t first, uint64_t last) {
+  const uint64_t size = source_->size();
+  uint64_t index = first;
+  while (index <= last) {
+    std::map<uint64_t, BlockList::iterator>::iterator held =
+        blocks_.find(index);
+    if (held != blocks_.end()) {
+      recent_.splice(recent_.begin(), recent_, held->second);
+      ++index;
+      continue;
+    }
+
+    // Fetch the whole run of missing blocks with one read.
+    uint64_t run_last = index;
+    while (run_last < last && blocks_.find(run_last + 1) == blocks_.end())
+      ++run_last;
+    const uint64_t run_start = index * block_size_;
+    const size_t run_size = static_cast<size_t>(
+        std::min<uint64_t>((run_last - index + 1) * block_size_,
+                           size - run_start));
+    std::vector<uint8_t> data(run_size);
+    if (!ReadSource(run_start, &data[0], run_size))
+      return false;
+
+    for (uint64_t block_index = index; block_index <= run_last;
+         ++block_index) {
+      const size_t from = static_cast<size_t>(
+          (block_index - index) * block_size_);
+      const size_t to = std::min(from + block_size_, run_size);
+      recent_.push_front(Block());
+      recent_.front().index = block_index;
+      recent_.front().data.assign(data.begin() + from, data.begin() + to);
+      blocks_[block_index] = recent_.begin();
+    }
+    index = run_last + 1;
+  }
+  return true;
+}
+
+bool BlockCachingMinidumpReader::ReadSource(uint64_t offset, void* buffer,
+                                            size_t count) {
+  ++source_reads_;
+  source_bytes_ += count;
+  if (!source_->ReadAt(offset, buffer, count)) {
+    BPLOG(ERROR) << "BlockCachingMinidumpReader could not read " <<
+                    offset << "+" << count;
+    return false;
+  }
+  return true;
+}
+
+void BlockCachingMinidumpReader::Trim() {
+  while (blocks_.size() > max_blocks_) {
+    blocks_.erase(recent_.back().index);
+    recent_.pop_back();
+  }
+}
+
+}  // namespace google_breakpad
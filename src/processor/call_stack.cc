@@ -48,6 +48,9 @@ void CallStack::Clear() {
        ++iterator) {
     delete *iterator;
   }
+  frames_.clear();
+  truncated_ = false;
+  scanned_modules_.clear();
 }
 
 }  // namespace google_breakpad
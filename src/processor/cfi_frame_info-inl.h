@@ -40,6 +40,28 @@
 
 namespace google_breakpad {
 
+template <typename RegisterType, class RawContextType>
+SimpleCFIWalker<RegisterType, RawContextType>::SimpleCFIWalker(
+    const RegisterSet *register_map, size_t map_size)
+    : register_map_(register_map), map_size_(map_size) {
+  for (size_t i = 0; i < map_size_; i++)
+    register_names_.push_back(register_map_[i].name);
+
+  for (size_t i = 0; i < map_size_; i++) {
+    const char *alternate_name = register_map_[i].alternate_name;
+    if (!alternate_name) {
+      alternate_numbers_.push_back(kNoAlternate);
+    } else if (strcmp(alternate_name, ".cfa") == 0) {
+      alternate_numbers_.push_back(kAlternateCFA);
+    } else if (strcmp(alternate_name, ".ra") == 0) {
+      alternate_numbers_.push_back(kAlternateRA);
+    } else {
+      alternate_numbers_.push_back(static_cast<int>(register_names_.size()));
+      register_names_.push_back(alternate_name);
+    }
+  }
+}
+
 template <typename RegisterType, class RawContextType>
 bool SimpleCFIWalker<RegisterType, RawContextType>::FindCallerRegisters(
     const MemoryRegion &memory,
@@ -48,22 +70,23 @@ bool SimpleCFIWalker<RegisterType, RawContextType>::FindCallerRegisters(
     int callee_validity,
     RawContextType *caller_context,
     int *caller_validity) const {
-  typedef CFIFrameInfo::RegisterValueMap<RegisterType> ValueMap;
-  ValueMap callee_registers;
-  ValueMap caller_registers;
-  // Just for brevity.
-  typename ValueMap::const_iterator caller_none = caller_registers.end();
+  typedef CFIFrameInfo::RegisterFile<RegisterType> RegisterFile;
+  RegisterFile callee_registers;
+  RegisterFile caller_registers;
+  RegisterType caller_cfa, caller_ra;
 
   // Populate callee_registers with register values from callee_context.
   for (size_t i = 0; i < map_size_; i++) {
     const RegisterSet &r = register_map_[i];
     if (callee_validity & r.validity_flag)
-      callee_registers[r.name] = callee_context.*r.context_member;
+      callee_registers.Set(i, callee_context.*r.context_member);
   }
 
   // Apply the rules, and see what register values they yield.
-  if (!cfi_frame_info.FindCallerRegs<RegisterType>(callee_registers, memory,
-                                                   &caller_registers))
+  if (!cfi_frame_info.FindCallerRegs<RegisterType>(
+          &register_names_[0], static_cast<int>(register_names_.size()),
+          callee_registers, memory, &caller_registers,
+          &caller_cfa, &caller_ra))
     return false;
 
   // Populate *caller_context with the values the rules placed in
@@ -72,25 +95,27 @@ bool SimpleCFIWalker<RegisterType, RawContextType>::FindCallerRegisters(
   *caller_validity = 0;
   for (size_t i = 0; i < map_size_; i++) {
     const RegisterSet &r = register_map_[i];
-    typename ValueMap::const_iterator caller_entry;
 
     // Did the rules provide a value for this register by its name?
-    caller_entry = caller_registers.find(r.name);
-    if (caller_entry != caller_none) {
-      caller_context->*r.context_member = caller_entry->second;
+    if (caller_registers.Has(i)) {
+      caller_context->*r.context_member = caller_registers.Get(i);
       *caller_validity |= r.validity_flag;
       continue;
     }
 
     // Did the rules provide a value for this register under its
     // alternate name?
-    if (r.alternate_name) {
-      caller_entry = caller_registers.find(r.alternate_name);
-      if (caller_entry != caller_none) {
-        caller_context->*r.context_member = caller_entry->second;
-        *caller_validity |= r.validity_flag;
-        continue;
-      }
+    int alternate = alternate_numbers_[i];
+    if (alternate == kAlternateCFA || alternate == kAlternateRA) {
+      caller_context->*r.context_member =
+          alternate == kAlternateCFA ? caller_cfa : caller_ra;
+      *caller_validity |= r.validity_flag;
+      continue;
+    }
+    if (alternate >= 0 && caller_registers.Has(alternate)) {
+      caller_context->*r.context_member = caller_registers.Get(alternate);
+      *caller_validity |= r.validity_flag;
+      continue;
     }
 
     // Is this a callee-saves register? The walker assumes that these
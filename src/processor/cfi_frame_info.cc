@@ -34,18 +34,406 @@
 
 #include "processor/cfi_frame_info.h"
 
+#include <assert.h>
+#include <ctype.h>
 #include <string.h>
 
+#include <limits>
 #include <sstream>
+#include <vector>
 
-#include "common/scoped_ptr.h"
+#include "common/probes.h"
 #include "processor/postfix_evaluator-inl.h"
 
 namespace google_breakpad {
 
-#ifdef _WIN32
-#define strtok_r strtok_s
-#endif
+namespace {
+
+using std::vector;
+
+// A CFI rule expression compiled into a short instruction sequence.
+// PostfixEvaluator keeps its stack as strings, formatting every
+// intermediate result with an ostringstream and parsing it back with an
+// istringstream when it is used.  A compiled rule resolves each literal
+// once, when it is compiled, and evaluates on a fixed-size stack of
+// values without allocating.
+//
+// STACK CFI rules only compute a value from literals, registers, the
+// binary operators and ^, so that is all Compile accepts.  For anything
+// else, including assignments and malformed expressions, Compile fails
+// and the rule should be given to PostfixEvaluator instead, which also
+// takes care of reporting the error.
+template<typename V>
+class CompiledRule {
+ public:
+  CompiledRule() : cfa_name_(-1) { }
+
+  bool Compile(const string &expression);
+
+  // Resolves the registers the compiled rule uses to their numbers in a
+  // RegisterFile, given the table of register names.  A name that is not
+  // in the table is never found when the rule is evaluated.
+  void NumberRegisters(const char * const *register_names,
+                       int register_count);
+
+  // Evaluates the rule, looking registers up in |registers|.  If |cfa| is
+  // not NULL, it is the value of ".cfa", overriding any in |registers|.
+  bool Evaluate(const CFIFrameInfo::RegisterValueMap<V> &registers,
+                const V *cfa, const MemoryRegion &memory, V *result) const;
+
+  // As above, for a rule whose registers have been numbered.
+  bool Evaluate(const CFIFrameInfo::RegisterFile<V> &registers,
+                const V *cfa, const MemoryRegion &memory, V *result) const;
+
+ private:
+  // Looks the register names_[name] up in a RegisterValueMap.
+  class MapLookup {
+   public:
+    MapLookup(const CompiledRule &rule,
+              const CFIFrameInfo::RegisterValueMap<V> &registers)
+        : rule_(rule), registers_(registers) { }
+    bool operator()(int name, V *value) const {
+      typename CFIFrameInfo::RegisterValueMap<V>::const_iterator it =
+          registers_.find(rule_.names_[name]);
+      if (it == registers_.end())
+        return false;
+      *value = it->second;
+      return true;
+    }
+   private:
+    const CompiledRule &rule_;
+    const CFIFrameInfo::RegisterValueMap<V> &registers_;
+  };
+
+  // Looks the register names_[name] up in a RegisterFile, by the number
+  // NumberRegisters found for it.
+  class FileLookup {
+   public:
+    FileLookup(const CompiledRule &rule,
+               const CFIFrameInfo::RegisterFile<V> &registers)
+        : rule_(rule), registers_(registers) { }
+    bool operator()(int name, V *value) const {
+      int number = rule_.numbers_[name];
+      if (number < 0 || !registers_.Has(number))
+        return false;
+      *value = registers_.Get(number);
+      return true;
+    }
+   private:
+    const CompiledRule &rule_;
+    const CFIFrameInfo::RegisterFile<V> &registers_;
+  };
+
+  // Evaluates the rule, fetching register values with |lookup|.
+  template<typename Lookup>
+  bool Run(const Lookup &lookup, const V *cfa, const MemoryRegion &memory,
+           V *result) const;
+
+  enum Opcode {
+    OP_LITERAL,
+    OP_REGISTER,
+    OP_ADD,
+    OP_SUBTRACT,
+    OP_MULTIPLY,
+    OP_DIVIDE_QUOTIENT,
+    OP_DIVIDE_MODULUS,
+    OP_ALIGN,
+    OP_DEREFERENCE
+  };
+
+  struct Instruction {
+    Instruction(Opcode set_opcode, V set_operand)
+        : opcode(set_opcode), operand(set_operand) { }
+
+    Opcode opcode;
+    // The literal for OP_LITERAL, or the index into names_ for
+    // OP_REGISTER.
+    V operand;
+  };
+
+  // The deepest stack a rule may need.  Rules produced by dump_syms need
+  // no more than three or four entries.
+  static const int kMaxDepth = 32;
+
+  // Returns true if |token| is a literal, storing its value in |value|.
+  // Mirrors PostfixEvaluator::PopValueOrIdentifier.
+  static bool ParseLiteral(const string &token, V *value);
+
+  vector<Instruction> code_;
+  vector<string> names_;
+  // The register number of each entry in names_, or -1; filled in by
+  // NumberRegisters.
+  vector<int> numbers_;
+  // The index of ".cfa" in names_, or -1.
+  int cfa_name_;
+};
+
+template<typename V>
+bool CompiledRule<V>::ParseLiteral(const string &token, V *value) {
+  size_t start = token[0] == '-' ? 1 : 0;
+  if (start == token.size())
+    return false;
+
+  // Plain decimal numbers are by far the most common literal.  Anything
+  // else that might still be one is left to istringstream, so that the
+  // result agrees with PostfixEvaluator exactly.
+  bool digits = true;
+  for (size_t i = start; i < token.size() && digits; ++i)
+    digits = isdigit(static_cast<unsigned char>(token[i])) != 0;
+  if (digits) {
+    const V max = std::numeric_limits<V>::max();
+    V literal = 0;
+    for (size_t i = start; i < token.size(); ++i) {
+      V digit = token[i] - '0';
+      if (literal > (max - digit) / 10)
+        return false;  // istringstream fails on overflow, too.
+      literal = literal * 10 + digit;
+    }
+    *value = start ? -literal : literal;
+    return true;
+  }
+
+  char first = token[start];
+  if (!isdigit(static_cast<unsigned char>(first)) &&
+      first != '-' && first != '+')
+    return false;
+
+  std::istringstream token_stream(token.substr(start));
+  V literal = V();
+  if (token_stream >> literal && token_stream.peek() == EOF) {
+    *value = start ? -literal : literal;
+    return true;
+  }
+  return false;
+}
+
+template<typename V>
+bool CompiledRule<V>::Compile(const string &expression) {
+  code_.clear();
+  names_.clear();
+  numbers_.clear();
+  cfa_name_ = -1;
+
+  int depth = 0;
+  size_t position = 0;
+  while (position < expression.size()) {
+    if (isspace(static_cast<unsigned char>(expression[position]))) {
+      ++position;
+      continue;
+    }
+    size_t end = position;
+    while (end < expression.size() &&
+           !isspace(static_cast<unsigned char>(expression[end])))
+      ++end;
+    string token(expression, position, end - position);
+    position = end;
+
+    Opcode opcode;
+    if (token == "+")
+      opcode = OP_ADD;
+    else if (token == "-")
+      opcode = OP_SUBTRACT;
+    else if (token == "*")
+      opcode = OP_MULTIPLY;
+    else if (token == "/")
+      opcode = OP_DIVIDE_QUOTIENT;
+    else if (token == "%")
+      opcode = OP_DIVIDE_MODULUS;
+    else if (token == "@")
+      opcode = OP_ALIGN;
+    else if (token == "^")
+      opcode = OP_DEREFERENCE;
+    else if (token[0] == '=')
+      return false;
+    else
+      opcode = OP_LITERAL;
+
+    if (opcode == OP_DEREFERENCE) {
+      if (depth < 1)
+        return false;
+      code_.push_back(Instruction(opcode, 0));
+    } else if (opcode != OP_LITERAL) {
+      if (depth < 2)
+        return false;
+      --depth;
+      code_.push_back(Instruction(opcode, 0));
+    } else {
+      if (++depth > kMaxDepth)
+        return false;
+      V literal;
+      if (ParseLiteral(token, &literal)) {
+        code_.push_back(Instruction(OP_LITERAL, literal));
+      } else {
+        size_t name = 0;
+        while (name < names_.size() && names_[name] != token)
+          ++name;
+        if (name == names_.size()) {
+          names_.push_back(token);
+          if (token == ".cfa")
+            cfa_name_ = name;
+        }
+        code_.push_back(Instruction(OP_REGISTER, name));
+      }
+    }
+  }
+
+  // A rule must leave exactly one value behind.
+  return depth == 1;
+}
+
+template<typename V>
+void CompiledRule<V>::NumberRegisters(const char * const *register_names,
+                                      int register_count) {
+  numbers_.assign(names_.size(), -1);
+  for (size_t name = 0; name < names_.size(); ++name) {
+    for (int number = 0; number < register_count; ++number) {
+      if (names_[name] == register_names[number]) {
+        numbers_[name] = number;
+        break;
+      }
+    }
+  }
+}
+
+template<typename V>
+bool CompiledRule<V>::Evaluate(
+    const CFIFrameInfo::RegisterValueMap<V> &registers, const V *cfa,
+    const MemoryRegion &memory, V *result) const {
+  return Run(MapLookup(*this, registers), cfa, memory, result);
+}
+
+template<typename V>
+bool CompiledRule<V>::Evaluate(
+    const CFIFrameInfo::RegisterFile<V> &registers, const V *cfa,
+    const MemoryRegion &memory, V *result) const {
+  return Run(FileLookup(*this, registers), cfa, memory, result);
+}
+
+template<typename V>
+template<typename Lookup>
+bool CompiledRule<V>::Run(const Lookup &lookup, const V *cfa,
+                          const MemoryRegion &memory, V *result) const {
+  V stack[kMaxDepth];
+  int depth = 0;
+
+  for (typename vector<Instruction>::const_iterator it = code_.begin();
+       it != code_.end(); ++it) {
+    switch (it->opcode) {
+      case OP_LITERAL:
+        stack[depth++] = it->operand;
+        break;
+
+      case OP_REGISTER: {
+        int name = static_cast<int>(it->operand);
+        if (cfa && name == cfa_name_) {
+          stack[depth++] = *cfa;
+          break;
+        }
+        if (!lookup(name, &stack[depth])) {
+          BPLOG(INFO) << "Identifier " << names_[name] << " not in dictionary";
+          return false;
+        }
+        ++depth;
+        break;
+      }
+
+      case OP_DEREFERENCE: {
+        V address = stack[depth - 1];
+        if (!memory.GetMemoryAtAddress(address, &stack[depth - 1])) {
+          BPLOG(ERROR) << "Could not dereference memory at address " <<
+                          HexString(address);
+          return false;
+        }
+        break;
+      }
+
+      default: {
+        V operand2 = stack[--depth];
+        V &operand1 = stack[depth - 1];
+        switch (it->opcode) {
+          case OP_ADD:
+            operand1 = operand1 + operand2;
+            break;
+          case OP_SUBTRACT:
+            operand1 = operand1 - operand2;
+            break;
+          case OP_MULTIPLY:
+            operand1 = operand1 * operand2;
+            break;
+          case OP_DIVIDE_QUOTIENT:
+            operand1 = operand1 / operand2;
+            break;
+          case OP_DIVIDE_MODULUS:
+            operand1 = operand1 % operand2;
+            break;
+          case OP_ALIGN:
+            operand1 = operand1 & (static_cast<V>(-1) ^ (operand2 - 1));
+            break;
+          default:
+            BPLOG(ERROR) << "Not reached!";
+            return false;
+        }
+        break;
+      }
+    }
+  }
+
+  *result = stack[0];
+  return true;
+}
+
+// Evaluates |rule|, compiled if possible.
+template<typename V>
+bool EvaluateRule(const string &rule,
+                  const CFIFrameInfo::RegisterValueMap<V> &registers,
+                  const V *cfa, const MemoryRegion &memory, V *result) {
+  CompiledRule<V> compiled;
+  if (compiled.Compile(rule))
+    return compiled.Evaluate(registers, cfa, memory, result);
+
+  CFIFrameInfo::RegisterValueMap<V> working = registers;
+  if (cfa)
+    working[".cfa"] = *cfa;
+  PostfixEvaluator<V> evaluator(&working, &memory);
+  return evaluator.EvaluateForValue(rule, result);
+}
+
+// Evaluates |rule| against numbered registers, compiled if possible.
+template<typename V>
+bool EvaluateRule(const string &rule,
+                  const char * const *register_names, int register_count,
+                  const CFIFrameInfo::RegisterFile<V> &registers,
+                  const V *cfa, const MemoryRegion &memory, V *result) {
+  CompiledRule<V> compiled;
+  if (compiled.Compile(rule)) {
+    compiled.NumberRegisters(register_names, register_count);
+    return compiled.Evaluate(registers, cfa, memory, result);
+  }
+
+  // PostfixEvaluator only knows registers by name.
+  CFIFrameInfo::RegisterValueMap<V> working;
+  for (int number = 0; number < register_count; ++number) {
+    if (registers.Has(number))
+      working[register_names[number]] = registers.Get(number);
+  }
+  if (cfa)
+    working[".cfa"] = *cfa;
+  PostfixEvaluator<V> evaluator(&working, &memory);
+  return evaluator.EvaluateForValue(rule, result);
+}
+
+// Returns the number of the register named |name| in |register_names|, or
+// -1.
+int RegisterNumber(const string &name,
+                   const char * const *register_names, int register_count) {
+  for (int number = 0; number < register_count; ++number) {
+    if (name == register_names[number])
+      return number;
+  }
+  return -1;
+}
+
+}  // namespace
 
 template<typename V>
 bool CFIFrameInfo::FindCallerRegs(const RegisterValueMap<V> &registers,
@@ -56,31 +444,24 @@ bool CFIFrameInfo::FindCallerRegs(const RegisterValueMap<V> &registers,
   if (cfa_rule_.empty() || ra_rule_.empty())
     return false;
 
-  RegisterValueMap<V> working;
-  PostfixEvaluator<V> evaluator(&working, &memory);
-
   caller_registers->clear();
 
   // First, compute the CFA.
   V cfa;
-  working = registers;
-  if (!evaluator.EvaluateForValue(cfa_rule_, &cfa))
+  if (!EvaluateRule(cfa_rule_, registers, static_cast<const V*>(NULL), memory,
+                    &cfa))
     return false;
 
   // Then, compute the return address.
   V ra;
-  working = registers;
-  working[".cfa"] = cfa;
-  if (!evaluator.EvaluateForValue(ra_rule_, &ra))
+  if (!EvaluateRule(ra_rule_, registers, &cfa, memory, &ra))
     return false;
 
   // Now, compute values for all the registers register_rules_ mentions.
   for (RuleMap::const_iterator it = register_rules_.begin();
        it != register_rules_.end(); it++) {
     V value;
-    working = registers;
-    working[".cfa"] = cfa;
-    if (!evaluator.EvaluateForValue(it->second, &value))
+    if (!EvaluateRule(it->second, registers, &cfa, memory, &value))
       return false;
     (*caller_registers)[it->first] = value;
   }
@@ -88,6 +469,58 @@ bool CFIFrameInfo::FindCallerRegs(const RegisterValueMap<V> &registers,
   (*caller_registers)[".ra"] = ra;
   (*caller_registers)[".cfa"] = cfa;
 
+  BREAKPAD_PROBE3(cfi__caller__regs, static_cast<uint64_t>(cfa),
+                  static_cast<uint64_t>(ra), register_rules_.size());
+  return true;
+}
+
+template<typename V>
+bool CFIFrameInfo::FindCallerRegs(const char * const *register_names,
+                                  int register_count,
+                                  const RegisterFile<V> &registers,
+                                  const MemoryRegion &memory,
+                                  RegisterFile<V> *caller_registers,
+                                  V *caller_cfa, V *caller_ra) const {
+  assert(register_count <= RegisterFile<V>::kMaxRegisters);
+
+  // If there are not rules for both .ra and .cfa in effect at this address,
+  // don't use this CFI data for stack walking.
+  if (cfa_rule_.empty() || ra_rule_.empty())
+    return false;
+
+  caller_registers->Clear();
+
+  // First, compute the CFA.
+  V cfa;
+  if (!EvaluateRule(cfa_rule_, register_names, register_count, registers,
+                    static_cast<const V*>(NULL), memory, &cfa))
+    return false;
+
+  // Then, compute the return address.
+  V ra;
+  if (!EvaluateRule(ra_rule_, register_names, register_count, registers,
+                    &cfa, memory, &ra))
+    return false;
+
+  // Now, compute values for all the registers register_rules_ mentions.
+  // Rules for registers the caller has no number for must still succeed,
+  // but their values are not kept.
+  for (RuleMap::const_iterator it = register_rules_.begin();
+       it != register_rules_.end(); it++) {
+    V value;
+    if (!EvaluateRule(it->second, register_names, register_count, registers,
+                      &cfa, memory, &value))
+      return false;
+    int number = RegisterNumber(it->first, register_names, register_count);
+    if (number >= 0)
+      caller_registers->Set(number, value);
+  }
+
+  *caller_cfa = cfa;
+  *caller_ra = ra;
+
+  BREAKPAD_PROBE3(cfi__caller__regs, static_cast<uint64_t>(cfa),
+                  static_cast<uint64_t>(ra), register_rules_.size());
   return true;
 }
 
@@ -100,6 +533,20 @@ template bool CFIFrameInfo::FindCallerRegs<uint64_t>(
     const RegisterValueMap<uint64_t> &registers,
     const MemoryRegion &memory,
     RegisterValueMap<uint64_t> *caller_registers) const;
+template bool CFIFrameInfo::FindCallerRegs<uint32_t>(
+    const char * const *register_names,
+    int register_count,
+    const RegisterFile<uint32_t> &registers,
+    const MemoryRegion &memory,
+    RegisterFile<uint32_t> *caller_registers,
+    uint32_t *caller_cfa, uint32_t *caller_ra) const;
+template bool CFIFrameInfo::FindCallerRegs<uint64_t>(
+    const char * const *register_names,
+    int register_count,
+    const RegisterFile<uint64_t> &registers,
+    const MemoryRegion &memory,
+    RegisterFile<uint64_t> *caller_registers,
+    uint64_t *caller_cfa, uint64_t *caller_ra) const;
 
 string CFIFrameInfo::Serialize() const {
   std::ostringstream stream;
@@ -124,25 +571,23 @@ string CFIFrameInfo::Serialize() const {
 }
 
 bool CFIRuleParser::Parse(const string &rule_set) {
-  size_t rule_set_len = rule_set.size();
-  scoped_array<char> working_copy(new char[rule_set_len + 1]);
-  memcpy(working_copy.get(), rule_set.data(), rule_set_len);
-  working_copy[rule_set_len] = '\0';
+  return Parse(rule_set.c_str());
+}
 
+bool CFIRuleParser::Parse(const char *rule_set) {
   name_.clear();
   expression_.clear();
 
-  char *cursor;
   static const char token_breaks[] = " \t\r\n";
-  char *token = strtok_r(working_copy.get(), token_breaks, &cursor);
+  const char *token = rule_set + strspn(rule_set, token_breaks);
 
   for (;;) {
     // End of rule set?
-    if (!token) return Report();
+    if (!*token) return Report();
 
     // Register/pseudoregister name?
-    size_t token_len = strlen(token);
-    if (token_len >= 1 && token[token_len - 1] == ':') {
+    size_t token_len = strcspn(token, token_breaks);
+    if (token[token_len - 1] == ':') {
       // Names can't be empty.
       if (token_len < 2) return false;
       // If there is any pending content, report it.
@@ -153,12 +598,12 @@ bool CFIRuleParser::Parse(const string &rule_set) {
       expression_.clear();
     } else {
       // Another expression component.
-      assert(token_len > 0); // strtok_r guarantees this, I think.
       if (!expression_.empty())
         expression_ += ' ';
-      expression_ += token;
+      expression_.append(token, token_len);
     }
-    token = strtok_r(NULL, token_breaks, &cursor);
+    token += token_len;
+    token += strspn(token, token_breaks);
   }
 }
 
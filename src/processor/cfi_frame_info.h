@@ -40,6 +40,7 @@
 
 #include <map>
 #include <string>
+#include <vector>
 
 #include "common/using_std_string.h"
 #include "google_breakpad/common/breakpad_types.h"
@@ -69,6 +70,40 @@ class CFIFrameInfo {
   template<typename ValueType> class RegisterValueMap: 
     public map<string, ValueType> { };
 
+  // A fixed-size set of register values, indexed by register number.
+  // Each stack walker numbers its architecture's registers from zero, in
+  // the order of a table of their names as they appear in STACK CFI rules.
+  // Unlike a RegisterValueMap, a RegisterFile never allocates, and looking
+  // a register up is an array access.
+  template<typename ValueType> class RegisterFile {
+   public:
+    // The most registers a RegisterFile can hold.
+    static const int kMaxRegisters = 64;
+
+    RegisterFile() : valid_(0) { }
+
+    // Return true if register NUMBER has a value.
+    bool Has(int number) const { return (valid_ >> number) & 1; }
+
+    // Return the value of register NUMBER, which must have one.
+    ValueType Get(int number) const { return values_[number]; }
+
+    // Set the value of register NUMBER.
+    void Set(int number, ValueType value) {
+      values_[number] = value;
+      valid_ |= static_cast<uint64_t>(1) << number;
+    }
+
+    // Forget the values of all registers.
+    void Clear() { valid_ = 0; }
+
+   private:
+    ValueType values_[kMaxRegisters];
+
+    // Bit N is set if values_[N] holds register N's value.
+    uint64_t valid_;
+  };
+
   // Set the expression for computing a call frame address, return
   // address, or register's value. At least the CFA rule and the RA
   // rule must be set before calling FindCallerRegs.
@@ -100,6 +135,21 @@ class CFIFrameInfo {
                       const MemoryRegion &memory,
                       RegisterValueMap<ValueType> *caller_registers) const;
 
+  // As above, but with registers identified by number. REGISTER_NAMES is
+  // the table numbering REGISTER_COUNT registers, at most
+  // RegisterFile::kMaxRegisters. Rules for registers that are not in the
+  // table must still be evaluated successfully, but their values are not
+  // kept. The CFA and return address are stored in *CALLER_CFA and
+  // *CALLER_RA.
+  template<typename ValueType>
+  bool FindCallerRegs(const char * const *register_names,
+                      int register_count,
+                      const RegisterFile<ValueType> &registers,
+                      const MemoryRegion &memory,
+                      RegisterFile<ValueType> *caller_registers,
+                      ValueType *caller_cfa,
+                      ValueType *caller_ra) const;
+
   // Serialize the rules in this object into a string in the format
   // of STACK CFI records.
   string Serialize() const;
@@ -164,6 +214,9 @@ class CFIRuleParser {
   // Return true if parsing was successful, false otherwise.
   bool Parse(const string &rule_set);
 
+  // The same, for the NUL-terminated RULE_SET, which is read in place.
+  bool Parse(const char *rule_set);
+
  private:
   // Report any accumulated rule to handler_
   bool Report();
@@ -240,8 +293,7 @@ class SimpleCFIWalker {
   // architecture's register set. REGISTER_MAP is an array of
   // RegisterSet structures; MAP_SIZE is the number of elements in the
   // array.
-  SimpleCFIWalker(const RegisterSet *register_map, size_t map_size)
-      : register_map_(register_map), map_size_(map_size) { }
+  SimpleCFIWalker(const RegisterSet *register_map, size_t map_size);
 
   // Compute the calling frame's raw context given the callee's raw
   // context.
@@ -264,8 +316,25 @@ class SimpleCFIWalker {
                            int *caller_validity) const;
 
  private:
+  // Values for alternate_numbers_ entries that stand for the CFA and the
+  // return address rather than a register.
+  enum {
+    kNoAlternate = -1,
+    kAlternateCFA = -2,
+    kAlternateRA = -3
+  };
+
   const RegisterSet *register_map_;
   size_t map_size_;
+
+  // The names numbering the registers for CFIFrameInfo::FindCallerRegs:
+  // register_map_[I].name is register I, and the alternate names other
+  // than ".cfa" and ".ra" follow the names.
+  std::vector<const char *> register_names_;
+
+  // For each register_map_ entry, the number of its alternate name in
+  // register_names_, or one of the values above.
+  std::vector<int> alternate_numbers_;
 };
 
 }  // namespace google_breakpad
@@ -0,0 +1,155 @@
+// Copyright (c) 2016 Google Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+// notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above
+// copyright notice, this list of conditions and the following disclaimer
+// in the documentation and/or other materials provided with the
+// distribution.
+//     * Neither the name of Google Inc. nor the names of its
+// contributors may be used to endorse or promote products derived from
+// this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+// cfi_frame_info_cache.cc: Implementation of CFIFrameInfoCache.
+//
+// See cfi_frame_info_cache.h for documentation.
+
+#include "google_breakpad/processor/cfi_frame_info_cache.h"
+
+#include <utility>
+
+#include "common/scoped_ptr.h"
+#include "google_breakpad/processor/code_module.h"
+#include "processor/cfi_frame_info.h"
+#include "processor/mutex.h"
+
+namespace google_breakpad {
+
+struct CFIFrameInfoCache::Entry {
+  Entry(const Key& set_key, CFIFrameInfo* set_cfi_frame_info)
+      : key(set_key), cfi_frame_info(set_cfi_frame_info) {}
+  ~Entry() { delete cfi_frame_info; }
+
+  Key key;
+  // NULL if there is no CFI for the address.
+  CFIFrameInfo* cfi_frame_info;
+  // This entry's position in recent_.
+  EntryList::iterator position;
+};
+
+CFIFrameInfoCache::CFIFrameInfoCache(size_t max_entries)
+    : max_entries_(max_entries),
+      hits_(0),
+      misses_(0),
+      mutex_(new Mutex) {
+}
+
+CFIFrameInfoCache::~CFIFrameInfoCache() {
+  Clear();
+  delete mutex_;
+}
+
+// static
+bool CFIFrameInfoCache::KeyForAddress(const CodeModule* module,
+                                      uint64_t address, Key* key) {
+  if (!module)
+    return false;
+  string debug_file = module->debug_file();
+  string debug_identifier = module->debug_identifier();
+  if (debug_file.empty() || debug_identifier.empty())
+    return false;
+  key->module = debug_file + "|" + debug_identifier;
+  key->offset = address - module->base_address();
+  return true;
+}
+
+bool CFIFrameInfoCache::Lookup(const CodeModule* module, uint64_t address,
+                               CFIFrameInfo** cfi_frame_info) {
+  Key key("", 0);
+  if (!KeyForAddress(module, address, &key))
+    return false;
+
+  AutoMutex lock(mutex_);
+  EntryMap::iterator it = entries_.find(key);
+  if (it == entries_.end()) {
+    ++misses_;
+    return false;
+  }
+
+  ++hits_;
+  Entry* entry = it->second;
+  recent_.splice(recent_.begin(), recent_, entry->position);
+  *cfi_frame_info = entry->cfi_frame_info ?
+      new CFIFrameInfo(*entry->cfi_frame_info) : NULL;
+  return true;
+}
+
+void CFIFrameInfoCache::Store(const CodeModule* module, uint64_t address,
+                              const CFIFrameInfo* cfi_frame_info) {
+  Key key("", 0);
+  if (max_entries_ == 0 || !KeyForAddress(module, address, &key))
+    return;
+
+  // Copy outside the lock.
+  scoped_ptr<CFIFrameInfo> copy(
+      cfi_frame_info ? new CFIFrameInfo(*cfi_frame_info) : NULL);
+
+  AutoMutex lock(mutex_);
+  if (entries_.find(key) != entries_.end()) {
+    // Another thread got here first.
+    return;
+  }
+
+  while (entries_.size() >= max_entries_) {
+    Entry* oldest = recent_.back();
+    recent_.pop_back();
+    entries_.erase(oldest->key);
+    delete oldest;
+  }
+
+  Entry* entry = new Entry(key, copy.release());
+  entry->position = recent_.insert(recent_.begin(), entry);
+  entries_.insert(std::make_pair(key, entry));
+}
+
+void CFIFrameInfoCache::Clear() {
+  AutoMutex lock(mutex_);
+  for (EntryList::iterator it = recent_.begin(); it != recent_.end(); ++it)
+    delete *it;
+  recent_.clear();
+  entries_.clear();
+}
+
+size_t CFIFrameInfoCache::size() const {
+  AutoMutex lock(mutex_);
+  return entries_.size();
+}
+
+uint64_t CFIFrameInfoCache::hits() const {
+  AutoMutex lock(mutex_);
+  return hits_;
+}
+
+uint64_t CFIFrameInfoCache::misses() const {
+  AutoMutex lock(mutex_);
+  return misses_;
+}
+
+}  // namespace google_breakpad
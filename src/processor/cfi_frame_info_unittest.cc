@@ -30,20 +30,27 @@
 // Original author: Jim Blandy <jimb@mozilla.com> <jimb@red-bean.com>
 
 // cfi_frame_info_unittest.cc: Unit tests for CFIFrameInfo,
-// CFIRuleParser, CFIFrameInfoParseHandler, and SimpleCFIWalker.
+// CFIRuleParser, CFIFrameInfoParseHandler, SimpleCFIWalker, and
+// CFIFrameInfoCache.
 
 #include <string.h>
 
 #include "breakpad_googletest_includes.h"
+#include "common/scoped_ptr.h"
 #include "common/using_std_string.h"
+#include "processor/basic_code_module.h"
 #include "processor/cfi_frame_info.h"
+#include "google_breakpad/processor/cfi_frame_info_cache.h"
 #include "google_breakpad/processor/memory_region.h"
 
+using google_breakpad::BasicCodeModule;
 using google_breakpad::CFIFrameInfo;
+using google_breakpad::CFIFrameInfoCache;
 using google_breakpad::CFIFrameInfoParseHandler;
 using google_breakpad::CFIRuleParser;
 using google_breakpad::MemoryRegion;
 using google_breakpad::SimpleCFIWalker;
+using google_breakpad::scoped_ptr;
 using testing::_;
 using testing::A;
 using testing::AtMost;
@@ -160,6 +167,48 @@ TEST_F(Simple, RulesOverride) {
             cfi.Serialize());
 }
 
+TEST_F(Simple, Literals) {
+  ExpectNoMemoryReferences();
+
+  registers["18446744073709551616"] = 0x2a;
+  cfi.SetCFARule("-16 8 @");
+  cfi.SetRARule("18446744073709551616");
+  cfi.SetRegisterRule("reg", "+7 -3 %");
+  ASSERT_TRUE(cfi.FindCallerRegs<uint64_t>(registers, memory,
+                                            &caller_registers));
+  ASSERT_EQ(3U, caller_registers.size());
+  ASSERT_EQ(-16ULL, caller_registers[".cfa"]);
+  // Too large to be a literal, so it names a register.
+  ASSERT_EQ(0x2aU, caller_registers[".ra"]);
+  ASSERT_EQ(7U, caller_registers["reg"]);
+}
+
+TEST_F(Simple, Dereference) {
+  EXPECT_CALL(memory, GetMemoryAtAddress(0x1000, A<uint64_t *>()))
+      .WillOnce(DoAll(SetArgumentPointee<1>(0x5000ULL), Return(true)));
+  EXPECT_CALL(memory, GetMemoryAtAddress(0x4ff8, A<uint64_t *>()))
+      .WillOnce(Return(false));
+
+  registers["$sp"] = 0xff8;
+  cfi.SetCFARule("$sp 8 + ^");
+  cfi.SetRARule(".cfa 8 - ^");
+  ASSERT_FALSE(cfi.FindCallerRegs<uint64_t>(registers, memory,
+                                             &caller_registers));
+}
+
+TEST_F(Simple, Malformed) {
+  ExpectNoMemoryReferences();
+
+  cfi.SetCFARule("1 +");
+  cfi.SetRARule("0");
+  ASSERT_FALSE(cfi.FindCallerRegs<uint64_t>(registers, memory,
+                                             &caller_registers));
+
+  cfi.SetCFARule("1 2");
+  ASSERT_FALSE(cfi.FindCallerRegs<uint64_t>(registers, memory,
+                                             &caller_registers));
+}
+
 class Scope: public CFIFixture, public Test { };
 
 // There should be no value for .cfa in scope when evaluating the CFA rule.
@@ -290,6 +339,88 @@ TEST_F(Scope, SeparateTempsRA) {
                                              &caller_registers));
 }
 
+class Numbered: public CFIFixture, public Test {
+ public:
+  static const char * const register_names[3];
+  CFIFrameInfo::RegisterFile<uint64_t> file, caller_file;
+  uint64_t caller_cfa, caller_ra;
+};
+
+const char * const Numbered::register_names[3] = { "$r0", "$r1", "$sp" };
+
+// Rules see registers by number, and set them by number.
+TEST_F(Numbered, RegisterRules) {
+  ExpectNoMemoryReferences();
+
+  file.Set(1, 0x3e9d5c2a6b8f1e07ULL);
+  file.Set(2, 0x7ffe0c4d9a2b1000ULL);
+  cfi.SetCFARule("$sp 16 +");
+  cfi.SetRARule(".cfa 8 -");
+  cfi.SetRegisterRule("$r0", "$r1");
+  cfi.SetRegisterRule("$sp", ".cfa");
+  ASSERT_TRUE(cfi.FindCallerRegs<uint64_t>(register_names, 3, file, memory,
+                                            &caller_file,
+                                            &caller_cfa, &caller_ra));
+  EXPECT_EQ(0x7ffe0c4d9a2b1010ULL, caller_cfa);
+  EXPECT_EQ(0x7ffe0c4d9a2b1008ULL, caller_ra);
+  ASSERT_TRUE(caller_file.Has(0));
+  EXPECT_EQ(0x3e9d5c2a6b8f1e07ULL, caller_file.Get(0));
+  EXPECT_FALSE(caller_file.Has(1));
+  ASSERT_TRUE(caller_file.Has(2));
+  EXPECT_EQ(0x7ffe0c4d9a2b1010ULL, caller_file.Get(2));
+}
+
+// A rule may not use a register that has no value, or no number.
+TEST_F(Numbered, MissingRegisters) {
+  ExpectNoMemoryReferences();
+
+  cfi.SetCFARule("$r0");
+  cfi.SetRARule("0");
+  ASSERT_FALSE(cfi.FindCallerRegs<uint64_t>(register_names, 3, file, memory,
+                                             &caller_file,
+                                             &caller_cfa, &caller_ra));
+
+  file.Set(0, 0x45f1c3a0ULL);
+  cfi.SetRegisterRule("$r1", "$r5");
+  ASSERT_FALSE(cfi.FindCallerRegs<uint64_t>(register_names, 3, file, memory,
+                                             &caller_file,
+                                             &caller_cfa, &caller_ra));
+}
+
+// Rules for registers without numbers are evaluated, but not kept.
+TEST_F(Numbered, UnnumberedRules) {
+  ExpectNoMemoryReferences();
+
+  cfi.SetCFARule("7046");
+  cfi.SetRARule("1529");
+  cfi.SetRegisterRule("$r7", ".cfa 1 +");
+  ASSERT_TRUE(cfi.FindCallerRegs<uint64_t>(register_names, 3, file, memory,
+                                            &caller_file,
+                                            &caller_cfa, &caller_ra));
+  EXPECT_FALSE(caller_file.Has(0));
+  EXPECT_FALSE(caller_file.Has(1));
+  EXPECT_FALSE(caller_file.Has(2));
+
+  cfi.SetRegisterRule("$r7", "$r9");
+  ASSERT_FALSE(cfi.FindCallerRegs<uint64_t>(register_names, 3, file, memory,
+                                             &caller_file,
+                                             &caller_cfa, &caller_ra));
+}
+
+// Rules that only PostfixEvaluator handles still see numbered registers.
+TEST_F(Numbered, Assignments) {
+  ExpectNoMemoryReferences();
+
+  file.Set(2, 0x1000);
+  cfi.SetCFARule("$temp1 $sp 32 + = $temp1");
+  cfi.SetRARule("$temp1 .cfa 4 - = $temp1");
+  ASSERT_TRUE(cfi.FindCallerRegs<uint64_t>(register_names, 3, file, memory,
+                                            &caller_file,
+                                            &caller_cfa, &caller_ra));
+  EXPECT_EQ(0x1020U, caller_cfa);
+  EXPECT_EQ(0x101cU, caller_ra);
+}
+
 class MockCFIRuleParserHandler: public CFIRuleParser::Handler {
  public:
   MOCK_METHOD1(CFARule, void(const string &));
@@ -544,3 +675,61 @@ TEST_F(SimpleWalker, Walk) {
   EXPECT_EQ(stack_top + 24,        caller_context.sp);
   EXPECT_EQ(0xba5ad6d9acce28deULL, caller_context.pc);
 }
+
+TEST(CFIFrameInfoCache, LookupAndStore) {
+  CFIFrameInfoCache cache(10);
+  BasicCodeModule module(0x10000, 0x1000, "module", "",
+                         "module.pdb", "ID", "");
+  // The same module, loaded elsewhere in another dump.
+  BasicCodeModule moved(0x40000, 0x1000, "module", "",
+                        "module.pdb", "ID", "");
+  CFIFrameInfo cfi;
+  cfi.SetCFARule("$esp 4 +");
+  cfi.SetRARule(".cfa 4 - ^");
+
+  CFIFrameInfo *found;
+  EXPECT_FALSE(cache.Lookup(&module, 0x10010, &found));
+  cache.Store(&module, 0x10010, &cfi);
+  cache.Store(&module, 0x10020, NULL);
+  EXPECT_EQ(2U, cache.size());
+
+  ASSERT_TRUE(cache.Lookup(&moved, 0x40010, &found));
+  scoped_ptr<CFIFrameInfo> copy(found);
+  ASSERT_TRUE(copy.get());
+  EXPECT_EQ(cfi.Serialize(), copy->Serialize());
+
+  ASSERT_TRUE(cache.Lookup(&module, 0x10020, &found));
+  EXPECT_FALSE(found);
+  EXPECT_FALSE(cache.Lookup(&module, 0x10030, &found));
+
+  EXPECT_EQ(2U, cache.hits());
+  EXPECT_EQ(2U, cache.misses());
+
+  // Modules without a debug identifier are never cached.
+  BasicCodeModule anonymous(0x10000, 0x1000, "module", "", "", "", "");
+  cache.Store(&anonymous, 0x10040, &cfi);
+  EXPECT_FALSE(cache.Lookup(&anonymous, 0x10040, &found));
+  EXPECT_EQ(2U, cache.size());
+
+  cache.Clear();
+  EXPECT_EQ(0U, cache.size());
+  EXPECT_FALSE(cache.Lookup(&module, 0x10010, &found));
+}
+
+TEST(CFIFrameInfoCache, Eviction) {
+  CFIFrameInfoCache cache(2);
+  BasicCodeModule module(0x10000, 0x1000, "module", "",
+                         "module.pdb", "ID", "");
+  CFIFrameInfo *found;
+
+  cache.Store(&module, 0x10000, NULL);
+  cache.Store(&module, 0x10004, NULL);
+  // Using the first entry makes the second the least recently used.
+  EXPECT_TRUE(cache.Lookup(&module, 0x10000, &found));
+  cache.Store(&module, 0x10008, NULL);
+
+  EXPECT_EQ(2U, cache.size());
+  EXPECT_TRUE(cache.Lookup(&module, 0x10000, &found));
+  EXPECT_FALSE(cache.Lookup(&module, 0x10004, &found));
+  EXPECT_TRUE(cache.Lookup(&module, 0x10008, &found));
+}
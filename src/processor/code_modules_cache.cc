@@ -0,0 +1,294 @@
+// Copyright (c) 2016 Google Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+// notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above
+// copyright notice, this list of conditions and the following disclaimer
+// in the documentation and/or other materials provided with the
+// distribution.
+//     * Neither the name of Google Inc. nor the names of its
+// contributors may be used to endorse or promote products derived from
+// this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+// code_modules_cache.cc: Implementation of CodeModulesCache.
+//
+// See code_modules_cache.h for documentation.
+
+#include "google_breakpad/processor/code_modules_cache.h"
+
+#include <string>
+#include <utility>
+
+#include "common/using_std_string.h"
+#include "google_breakpad/processor/code_module.h"
+#include "google_breakpad/processor/code_modules.h"
+#include "processor/basic_code_modules.h"
+#include "processor/mutex.h"
+
+namespace google_breakpad {
+
+namespace {
+
+// Adds |size| bytes at |data| to the 64-bit FNV-1a hash |*hash|.
+void HashBytes(const void* data, size_t size, uint64_t* hash) {
+  const unsigned char* bytes = static_cast<const unsigned char*>(data);
+  for (size_t i = 0; i < size; ++i) {
+    *hash ^= bytes[i];
+    *hash *= 1099511628211ULL;
+  }
+}
+
+// Adds |value| and a terminator to |*hash|, so that adjacent strings can't
+// run together.
+void HashString(const string& value, uint64_t* hash) {
+  HashBytes(value.data(), value.size(), hash);
+  HashBytes("", 1, hash);
+}
+
+void HashNumber(uint64_t value, uint64_t* hash) {
+  unsigned char bytes[8];
+  for (int i = 0; i < 8; ++i)
+    bytes[i] = static_cast<unsigned char>(value >> (i * 8));
+  HashBytes(bytes, sizeof(bytes), hash);
+}
+
+bool SameModule(const CodeModule* a, const CodeModule* b) {
+  return a->base_address() == b->base_address() &&
+         a->size() == b->size() &&
+         a->code_file() == b->code_file() &&
+         a->code_identifier() == b->code_identifier() &&
+         a->debug_file() == b->debug_file() &&
+         a->debug_identifier() == b->debug_identifier() &&
+         a->version() == b->version();
+}
+
+}  // namespace
+
+// A cached module list, with the references to it held by the cache and
+// by the copies handed out.
+class CodeModulesCache::Entry {
+ public:
+  Entry(uint64_t hash, const CodeModules* modules)
+      : hash_(hash), modules_(new BasicCodeModules(modules)), references_(1) {}
+
+  uint64_t hash() const { return hash_; }
+  const CodeModules* modules() const { return modules_; }
+
+  void AddReference() {
+    AutoMutex lock(&mutex_);
+    ++references_;
+  }
+
+  // Drops a reference, deleting the entry when it was the last.
+  void Release() {
+    bool last;
+    {
+      AutoMutex lock(&mutex_);
+      last = --references_ == 0;
+    }
+    if (last)
+      delete this;
+  }
+
+ private:
+  ~Entry() { delete modules_; }
+
+  const uint64_t hash_;
+  const CodeModules* const modules_;
+  int references_;
+  Mutex mutex_;
+};
+
+// A copy handed out by CodeModulesCache::Copy, which reads the entry's
+// module list and holds a reference to it.
+class CodeModulesCache::SharedModules : public CodeModules {
+ public:
+  // Takes over a reference to |entry|.
+  explicit SharedModules(Entry* entry)
+      : entry_(entry), modules_(entry->modules()) {}
+  virtual ~SharedModules() { entry_->Release(); }
+
+  virtual unsigned int module_count() const {
+    return modules_->module_count();
+  }
+  virtual const CodeModule* GetModuleForAddress(uint64_t address) const {
+    return modules_->GetModuleForAddress(address);
+  }
+  virtual void GetModulesForAddresses(const uint64_t* addresses,
+                                      size_t count,
+                                      const CodeModule** modules) const {
+    modules_->GetModulesForAddresses(addresses, count, modules);
+  }
+  virtual const CodeModule* GetMainModule() const {
+    return modules_->GetMainModule();
+  }
+  virtual const CodeModule* GetModuleAtSequence(unsigned int sequence) const {
+    return modules_->GetModuleAtSequence(sequence);
+  }
+  virtual const CodeModule* GetModuleAtIndex(unsigned int index) const {
+    return modules_->GetModuleAtIndex(index);
+  }
+  virtual const CodeModules* Copy() const {
+    entry_->AddReference();
+    return new SharedModules(entry_);
+  }
+
+ private:
+  Entry* entry_;
+  const CodeModules* modules_;
+
+  // Disallow copy constructor and assignment operator.
+  SharedModules(const SharedModules&);
+  void operator=(const SharedModules&);
+};
+
+CodeModulesCache::CodeModulesCache(size_t max_entries)
+    : max_entries_(max_entries),
+      hits_(0),
+      misses_(0),
+      mutex_(new Mutex) {
+}
+
+CodeModulesCache::~CodeModulesCache() {
+  Clear();
+  delete mutex_;
+}
+
+// static
+uint64_t CodeModulesCache::Hash(const CodeModules* modules) {
+  // Module hashes are summed, so that the order of the list doesn't matter.
+  uint64_t sum = 0;
+  unsigned int module_count = modules->module_count();
+  for (unsigned int i = 0; i < module_count; ++i) {
+    const CodeModule* module = modules->GetModuleAtIndex(i);
+    uint64_t hash = 14695981039346656037ULL;
+    HashNumber(module->base_address(), &hash);
+    HashNumber(module->size(), &hash);
+    HashString(module->code_file(), &hash);
+    HashString(module->debug_identifier(), &hash);
+    sum += hash;
+  }
+  const CodeModule* main_module = modules->GetMainModule();
+  uint64_t hash = 14695981039346656037ULL;
+  HashNumber(module_count, &hash);
+  HashNumber(main_module ? main_module->base_address() : 0, &hash);
+  HashNumber(sum, &hash);
+  return hash;
+}
+
+// static
+bool CodeModulesCache::Matches(const CodeModules* a, const CodeModules* b) {
+  unsigned int module_count = a->module_count();
+  if (module_count != b->module_count())
+    return false;
+  const CodeModule* a_main = a->GetMainModule();
+  const CodeModule* b_main = b->GetMainModule();
+  if (!a_main != !b_main ||
+      (a_main && a_main->base_address() != b_main->base_address())) {
+    return false;
+  }
+  // Modules don't overlap, so a module at each of |a|'s base addresses
+  // that matches one of |b|'s, with as many modules in each, makes the
+  // lists the same.
+  for (unsigned int i = 0; i < module_count; ++i) {
+    const CodeModule* module = a->GetModuleAtIndex(i);
+    const CodeModule* other = b->GetModuleForAddress(module->base_address());
+    if (!other || !SameModule(module, other))
+      return false;
+  }
+  return true;
+}
+
+const CodeModules* CodeModulesCache::Copy(const CodeModules* modules) {
+  uint64_t hash = Hash(modules);
+  {
+    AutoMutex lock(mutex_);
+    std::pair<EntryMap::iterator, EntryMap::iterator> range =
+        entries_.equal_range(hash);
+    for (EntryMap::iterator it = range.first; it != range.second; ++it) {
+      Entry* entry = *it->second;
+      // Comparing under the lock keeps the entry from being dropped
+      // meanwhile; it is only done when the hashes match, which is nearly
+      // always a hit.
+      if (Matches(modules, entry->modules())) {
+        ++hits_;
+        recent_.splice(recent_.begin(), recent_, it->second);
+        entry->AddReference();
+        return new SharedModules(entry);
+      }
+    }
+    ++misses_;
+  }
+
+  // Copy the list outside the lock.  If another thread adds the same list
+  // meanwhile, both are cached, and the older one ages out.
+  Entry* entry = new Entry(hash, modules);
+  if (max_entries_ == 0 ||
+      entry->modules()->module_count() != modules->module_count()) {
+    // The copy isn't cached.  If modules overlapped, some were left out of
+    // it, and it could never match another list.
+    return new SharedModules(entry);
+  }
+  entry->AddReference();
+  const CodeModules* copy = new SharedModules(entry);
+
+  AutoMutex lock(mutex_);
+  while (recent_.size() >= max_entries_) {
+    Entry* oldest = recent_.back();
+    std::pair<EntryMap::iterator, EntryMap::iterator> range =
+        entries_.equal_range(oldest->hash());
+    for (EntryMap::iterator it = range.first; it != range.second; ++it) {
+      if (*it->second == oldest) {
+        entries_.erase(it);
+        break;
+      }
+    }
+    recent_.pop_back();
+    oldest->Release();
+  }
+  entries_.insert(
+      std::make_pair(hash, recent_.insert(recent_.begin(), entry)));
+  return copy;
+}
+
+void CodeModulesCache::Clear() {
+  AutoMutex lock(mutex_);
+  for (EntryList::iterator it = recent_.begin(); it != recent_.end(); ++it)
+    (*it)->Release();
+  recent_.clear();
+  entries_.clear();
+}
+
+size_t CodeModulesCache::size() const {
+  AutoMutex lock(mutex_);
+  return recent_.size();
+}
+
+uint64_t CodeModulesCache::hits() const {
+  AutoMutex lock(mutex_);
+  return hits_;
+}
+
+uint64_t CodeModulesCache::misses() const {
+  AutoMutex lock(mutex_);
+  return misses_;
+}
+
+}  // namespace google_breakpad
@@ -0,0 +1,99 @@
+// Copyright (c) 2016 Google Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+// notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above
+// copyright notice, this list of conditions and the following disclaimer
+// in the documentation and/or other materials provided with the
+// distribution.
+//     * Neither the name of Google Inc. nor the names of its
+// contributors may be used to endorse or promote products derived from
+// this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+// compressed_module_format.h: The compressed form of the serialized modules
+// that ModuleSerializer writes and FastSourceLineResolver loads.
+//
+// Each map of a serialized module is cut into blocks of
+// kCompressedModuleBlockSize bytes, the last of which may be shorter, and
+// each block is compressed on its own with CompressBlock() from
+// common/minidump_compression.h.  A directory up front records where every
+// block is, so that a resolver can decompress a map when a lookup first
+// needs it without touching the rest of the file.
+//
+//   CompressedModuleHeader
+//   CompressedModuleMap, for each of the |map_count| maps
+//   CompressedModuleBlock, for each block of each map, in map order
+//   the blocks' data
+//
+// A block is stored as is when its |stored_size| equals its size, and
+// otherwise in the LZ4 block format.
+//
+// All integers are in the byte order of the machine that wrote the file;
+// the signature serves as a byte order mark.  An uncompressed serialized
+// module starts with its is_corrupt flag, 0 or 1, so its first byte never
+// matches the signature's.
+
+#ifndef PROCESSOR_COMPRESSED_MODULE_FORMAT_H__
+#define PROCESSOR_COMPRESSED_MODULE_FORMAT_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "common/minidump_compression.h"
+
+namespace google_breakpad {
+
+// 'BPZM' in the byte order of the writer.
+const uint32_t kCompressedModuleSignature = 0x4d5a5042;
+const uint32_t kCompressedModuleVersion = 1;
+
+// The size of every block but the last of each map.
+const size_t kCompressedModuleBlockSize = kCompressedMinidumpMaxFrameSize;
+
+struct CompressedModuleHeader {
+  uint32_t signature;
+  uint32_t version;
+  uint32_t map_count;
+  // The serialized module's is_corrupt flag.
+  uint32_t is_corrupt;
+};
+
+struct CompressedModuleMap {
+  // The size of the map once decompressed.
+  uint32_t size;
+  // The index of the map's first block in the block directory.
+  uint32_t first_block;
+};
+
+struct CompressedModuleBlock {
+  // Where the block's data is, from the start of the file.
+  uint32_t offset;
+  uint32_t stored_size;
+};
+
+// Returns the number of blocks a map of |size| bytes is cut into.
+inline uint32_t CompressedModuleBlockCount(uint32_t size) {
+  return static_cast<uint32_t>(
+      (size + kCompressedModuleBlockSize - 1) / kCompressedModuleBlockSize);
+}
+
+}  // namespace google_breakpad
+
+#endif  // PROCESSOR_COMPRESSED_MODULE_FORMAT_H__
@@ -40,6 +40,8 @@
 
 #include <assert.h>
 
+#include <algorithm>
+
 #include "processor/logging.h"
 
 
@@ -56,6 +58,11 @@ ContainedRangeMap<AddressType, EntryType>::~ContainedRangeMap() {
 template<typename AddressType, typename EntryType>
 bool ContainedRangeMap<AddressType, EntryType>::StoreRange(
     const AddressType &base, const AddressType &size, const EntryType &entry) {
+  if (frozen_) {
+    BPLOG(ERROR) << "StoreRange failed, the map is frozen";
+    return false;
+  }
+
   AddressType high = base + size - 1;
 
   // Check for undersize or overflow.
@@ -72,6 +79,23 @@ bool ContainedRangeMap<AddressType, EntryType>::StoreRange(
   if (!map_)
     map_ = new AddressToRangeMap();
 
+  // Symbol files list their ranges in address order, so a new range usually
+  // lies either above all of the children stored so far or within the last
+  // of them.  Either takes a comparison or two to check, without searching
+  // the map, so that loading sorted ranges is linear overall.
+  if (map_->empty() || base > map_->rbegin()->first) {
+    map_->insert(map_->end(),
+                 MapValue(high, new ContainedRangeMap(base, entry, NULL)));
+    return true;
+  }
+  MapIterator iterator_last = --map_->end();
+  if (base >= iterator_last->second->base_ && high <= iterator_last->first) {
+    // An identical range fails as below.
+    if (iterator_last->second->base_ == base && iterator_last->first == high)
+      return false;
+    return iterator_last->second->StoreRange(base, size, entry);
+  }
+
   MapIterator iterator_base = map_->lower_bound(base);
   MapIterator iterator_high = map_->lower_bound(high);
   MapIterator iterator_end = map_->end();
@@ -154,6 +178,25 @@ bool ContainedRangeMap<AddressType, EntryType>::RetrieveRange(
                              "|entry|";
   assert(entry);
 
+  if (frozen_) {
+    // Descend from the root one level at a time, as below, remembering the
+    // most specific range found.
+    const FrozenRange *parent = &(*frozen_)[0];
+    bool found = false;
+    while (parent->child_count) {
+      const FrozenRange *first = &(*frozen_)[parent->first_child];
+      const FrozenRange *last = first + parent->child_count;
+      const FrozenRange *child =
+          std::lower_bound(first, last, address, FrozenRangeHighLess);
+      if (child == last || address < child->base)
+        break;
+      *entry = child->entry;
+      found = true;
+      parent = child;
+    }
+    return found;
+  }
+
   // If nothing was ever stored, then there's nothing to retrieve.
   if (!map_)
     return false;
@@ -178,8 +221,40 @@ bool ContainedRangeMap<AddressType, EntryType>::RetrieveRange(
 }
 
 
+template<typename AddressType, typename EntryType>
+void ContainedRangeMap<AddressType, EntryType>::Freeze() {
+  delete frozen_;
+  frozen_ = new FrozenRanges();
+
+  // Lay the tree out breadth first, so that the children of each range
+  // follow one another.  nodes[i] is the tree node of (*frozen_)[i].
+  std::vector<const ContainedRangeMap*> nodes;
+  FrozenRange root = FrozenRange();
+  frozen_->push_back(root);
+  nodes.push_back(this);
+  for (size_t i = 0; i < nodes.size(); ++i) {
+    (*frozen_)[i].first_child = frozen_->size();
+    (*frozen_)[i].child_count = nodes[i]->map_ ? nodes[i]->map_->size() : 0;
+    if (!nodes[i]->map_)
+      continue;
+    for (MapConstIterator child = nodes[i]->map_->begin();
+         child != nodes[i]->map_->end(); ++child) {
+      FrozenRange range = FrozenRange();
+      range.base = child->second->base_;
+      range.high = child->first;
+      range.entry = child->second->entry_;
+      frozen_->push_back(range);
+      nodes.push_back(child->second);
+    }
+  }
+}
+
+
 template<typename AddressType, typename EntryType>
 void ContainedRangeMap<AddressType, EntryType>::Clear() {
+  delete frozen_;
+  frozen_ = NULL;
+
   if (map_) {
     MapConstIterator end = map_->end();
     for (MapConstIterator child = map_->begin(); child != end; ++child)
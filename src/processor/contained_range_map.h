@@ -55,6 +55,11 @@
 // is the only node directly accessible to the user, and represents the
 // entire address space.
 //
+// A map that won't change again may be frozen, which copies the tree into
+// a flat array in which the children of each range are stored contiguously,
+// sorted by address.  Retrieval then takes one binary search per level of
+// the tree instead of chasing pointers through std::map nodes.
+//
 // Author: Mark Mentovai
 
 #ifndef PROCESSOR_CONTAINED_RANGE_MAP_H__
@@ -62,6 +67,7 @@
 
 
 #include <map>
+#include <vector>
 
 
 namespace google_breakpad {
@@ -75,7 +81,7 @@ class ContainedRangeMap {
   // The default constructor creates a ContainedRangeMap with no geometry
   // and no entry, and as such is only suitable for the root node of a
   // ContainedRangeMap tree.
-  ContainedRangeMap() : base_(), entry_(), map_(NULL) {}
+  ContainedRangeMap() : base_(), entry_(), map_(NULL), frozen_(NULL) {}
 
   ~ContainedRangeMap();
 
@@ -101,9 +107,16 @@ class ContainedRangeMap {
   // leaving the node on which it is called intact.  Because the only
   // meaningful things contained by a root node are descendants, this
   // is sufficient to restore an entire ContainedRangeMap to its initial
-  // empty state when called on the root node.
+  // empty state when called on the root node.  Clear also thaws a frozen
+  // map.
   void Clear();
 
+  // Copies the ranges into a flat array that RetrieveRange searches from
+  // then on.  StoreRange fails on a frozen map.  The tree is kept, so that
+  // a frozen map can still be serialized.  Only call this on the root.
+  void Freeze();
+  bool frozen() const { return frozen_ != NULL; }
+
  private:
   friend class ContainedRangeMapSerializer<AddressType, EntryType>;
   friend class ModuleComparer;
@@ -115,12 +128,30 @@ class ContainedRangeMap {
   typedef typename AddressToRangeMap::iterator MapIterator;
   typedef typename AddressToRangeMap::value_type MapValue;
 
+  // A range of a frozen map.  The children of a range are the child_count
+  // ranges from first_child on, in order of address.  The first range of
+  // a frozen map stands for the root.
+  struct FrozenRange {
+    AddressType base;
+    AddressType high;
+    EntryType entry;
+    size_t first_child;
+    size_t child_count;
+  };
+  typedef std::vector<FrozenRange> FrozenRanges;
+
+  // Orders ranges by their high address, for std::lower_bound.
+  static bool FrozenRangeHighLess(const FrozenRange &range,
+                                  const AddressType &address) {
+    return range.high < address;
+  }
+
   // Creates a new ContainedRangeMap with the specified base address, entry,
   // and initial child map, which may be NULL.  This is only used internally
   // by ContainedRangeMap when it creates a new child.
   ContainedRangeMap(const AddressType &base, const EntryType &entry,
                     AddressToRangeMap *map)
-      : base_(base), entry_(entry), map_(map) {}
+      : base_(base), entry_(entry), map_(map), frozen_(NULL) {}
 
   // The base address of this range.  The high address does not need to
   // be stored, because it is used as the key to an object in its parent's
@@ -141,6 +172,10 @@ class ContainedRangeMap {
   // address.  This is a pointer to avoid allocating map structures for
   // leaf nodes, where they are not needed.
   AddressToRangeMap *map_;
+
+  // The flattened ranges, once the root is frozen.  NULL otherwise, and
+  // always NULL in child ranges.
+  FrozenRanges *frozen_;
 };
 
 
@@ -247,6 +247,35 @@ static bool RunTests() {
 
 #ifdef GENERATE_TEST_DATA
   printf("  };\n");
+#else  // GENERATE_TEST_DATA
+  // A frozen map must retrieve exactly what the tree did, and refuse
+  // further stores.
+  crm.Freeze();
+  ASSERT_TRUE(crm.frozen());
+  ASSERT_FALSE(crm.StoreRange(100, 10, 49));
+  for (unsigned int address = 0; address < test_high; ++address) {
+    int value;
+    if (!crm.RetrieveRange(address, &value))
+      value = 0;
+    if (value != test_data[address]) {
+      fprintf(stderr, "FAIL: frozen retrieve %d expected %d observed %d "
+              "@ %s:%d\n", address, test_data[address], value,
+              __FILE__, __LINE__);
+      return false;
+    }
+  }
+
+  // Clear thaws the map.
+  crm.Clear();
+  ASSERT_FALSE(crm.frozen());
+  int value;
+  ASSERT_FALSE(crm.RetrieveRange(10, &value));
+  ASSERT_TRUE(crm.StoreRange(100, 10, 49));
+
+  // An empty map can be frozen too.
+  ContainedRangeMap<unsigned int, int> empty;
+  empty.Freeze();
+  ASSERT_FALSE(empty.RetrieveRange(0, &value));
 #endif  // GENERATE_TEST_DATA
 
   return true;
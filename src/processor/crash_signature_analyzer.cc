@@ -0,0 +1,136 @@
+// Copyright (c) 2016 Google Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+// notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above
+// copyright notice, this list of conditions and the following disclaimer
+// in the documentation and/or other materials provided with the
+// distribution.
+//     * Neither the name of Google Inc. nor the names of its
+// contributors may be used to endorse or promote products derived from
+// this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+// crash_signature_analyzer.cc: Implementation of CrashSignatureAnalyzer.
+//
+// See crash_signature_analyzer.h for documentation.
+
+#include "processor/crash_signature_analyzer.h"
+
+#include "google_breakpad/processor/call_stack.h"
+#include "google_breakpad/processor/code_module.h"
+#include "google_breakpad/processor/crash_signature_cache.h"
+#include "google_breakpad/processor/fast_source_line_resolver.h"
+#include "google_breakpad/processor/minidump_processor.h"
+#include "google_breakpad/processor/process_state.h"
+#include "google_breakpad/processor/stack_frame.h"
+#include "processor/logging.h"
+#include "processor/pathname_stripper.h"
+#include "processor/simple_symbol_supplier.h"
+
+namespace google_breakpad {
+
+namespace {
+
+// Returns a one-line description of |frame|.
+string DescribeFrame(const StackFrame& frame) {
+  if (!frame.module)
+    return HexString(frame.instruction);
+  string module = PathnameStripper::File(frame.module->code_file());
+  if (!frame.function_name.empty()) {
+    return module + "!" + frame.function_name + "+" +
+           HexString(frame.instruction - frame.function_base);
+  }
+  return module + "+" +
+         HexString(frame.instruction - frame.module->base_address());
+}
+
+// Takes the signature and frames from the requesting thread as soon as it
+// is walked, and stops processing there.
+class SignatureCallback : public MinidumpProcessor::RequestingThreadCallback {
+ public:
+  SignatureCallback(size_t max_frames,
+                    uint64_t* signature,
+                    string* crash_reason,
+                    std::vector<string>* frames)
+      : max_frames_(max_frames),
+        signature_(signature),
+        crash_reason_(crash_reason),
+        frames_(frames),
+        called_(false) {}
+
+  virtual bool RequestingThreadWalked(const ProcessState& process_state) {
+    called_ = true;
+    *signature_ = CrashSignatureCache::Signature(process_state);
+    *crash_reason_ = process_state.crash_reason();
+    const std::vector<StackFrame*>* stack_frames =
+        process_state.threads()->at(process_state.requesting_thread())->
+        frames();
+    for (size_t i = 0; i < stack_frames->size() && i < max_frames_; ++i)
+      frames_->push_back(DescribeFrame(*stack_frames->at(i)));
+    return false;
+  }
+
+  bool called() const { return called_; }
+
+ private:
+  size_t max_frames_;
+  uint64_t* signature_;
+  string* crash_reason_;
+  std::vector<string>* frames_;
+  bool called_;
+};
+
+}  // namespace
+
+CrashSignatureAnalyzer::CrashSignatureAnalyzer(
+    const std::vector<string>& symbol_paths)
+    : symbol_paths_(symbol_paths),
+      max_frames_(kDefaultMaxFrames) {
+}
+
+bool CrashSignatureAnalyzer::Analyze(const string& minidump_file,
+                                     uint64_t* signature,
+                                     string* crash_reason,
+                                     std::vector<string>* frames) const {
+  *signature = 0;
+  crash_reason->clear();
+  frames->clear();
+
+  // Neither the supplier nor the resolver may be shared between threads,
+  // and both are cheap to make: the resolver maps symbol files in place.
+  SimpleSymbolSupplier supplier(symbol_paths_);
+  FastSourceLineResolver resolver;
+  MinidumpProcessor processor(&supplier, &resolver);
+  SignatureCallback callback(max_frames_, signature, crash_reason, frames);
+  processor.set_requesting_thread_callback(&callback);
+
+  ProcessState process_state;
+  ProcessResult result = processor.Process(minidump_file, &process_state);
+  if (result != PROCESS_OK || !callback.called()) {
+    BPLOG(INFO) << "No crash signature for " << minidump_file;
+    *signature = 0;
+    crash_reason->clear();
+    frames->clear();
+    return false;
+  }
+  return *signature != 0;
+}
+
+}  // namespace google_breakpad
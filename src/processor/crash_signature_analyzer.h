@@ -0,0 +1,88 @@
+// Copyright (c) 2016 Google Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+// notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above
+// copyright notice, this list of conditions and the following disclaimer
+// in the documentation and/or other materials provided with the
+// distribution.
+//     * Neither the name of Google Inc. nor the names of its
+// contributors may be used to endorse or promote products derived from
+// this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+// crash_signature_analyzer.h: CrashSignatureAnalyzer, which finds a
+// minidump's crash signature and its crashing thread's top frames by
+// walking just that thread.
+//
+// This is meant for the host that receives the minidumps, such as a
+// CrashGenerationServer's (see client/linux/crash_generation/
+// dump_analyzer.h), so that it can recognize a crash it has already
+// reported without sending the whole minidump away to find out.  Symbols
+// come from serialized fast-resolver files (<name>.sym.fast, as written
+// by serialize_symbol_store) in a SimpleSymbolSupplier layout, which are
+// mapped rather than parsed; modules without one are walked unsymbolized.
+// The signature is CrashSignatureCache::Signature's, so it matches what a
+// MinidumpProcessor with a crash signature cache computes for the same
+// minidump.
+
+#ifndef PROCESSOR_CRASH_SIGNATURE_ANALYZER_H__
+#define PROCESSOR_CRASH_SIGNATURE_ANALYZER_H__
+
+#include <string>
+#include <vector>
+
+#include "common/using_std_string.h"
+#include "google_breakpad/common/breakpad_types.h"
+
+namespace google_breakpad {
+
+class CrashSignatureAnalyzer {
+ public:
+  // The number of frames reported unless changed with set_max_frames().
+  static const size_t kDefaultMaxFrames = 5;
+
+  // Creates an analyzer that looks for symbols under |symbol_paths|.
+  explicit CrashSignatureAnalyzer(const std::vector<string>& symbol_paths);
+
+  // Sets how many of the crashing thread's innermost frames Analyze
+  // describes.
+  void set_max_frames(size_t max_frames) { max_frames_ = max_frames; }
+  size_t max_frames() const { return max_frames_; }
+
+  // Walks the requesting (usually crashed) thread of the minidump at
+  // |minidump_file|, and sets |*signature| to its crash signature,
+  // |*crash_reason| to the crash reason, and |*frames| to descriptions of
+  // the thread's innermost frames, such as "libfoo.so!Foo::Bar+0x1c", or
+  // "libfoo.so+0x21c" for a frame without a function name.  Returns false,
+  // with |*signature| 0, if the minidump can't be read or has no
+  // requesting thread.  May be called on any number of threads at once.
+  bool Analyze(const string& minidump_file,
+               uint64_t* signature,
+               string* crash_reason,
+               std::vector<string>* frames) const;
+
+ private:
+  std::vector<string> symbol_paths_;
+  size_t max_frames_;
+};
+
+}  // namespace google_breakpad
+
+#endif  // PROCESSOR_CRASH_SIGNATURE_ANALYZER_H__
@@ -0,0 +1,175 @@
+// Copyright (c) 2016 Google Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+// notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above
+// copyright notice, this list of conditions and the following disclaimer
+// in the documentation and/or other materials provided with the
+// distribution.
+//     * Neither the name of Google Inc. nor the names of its
+// contributors may be used to endorse or promote products derived from
+// this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+// crash_signature_analyzer_unittest.cc: Unit tests for
+// CrashSignatureAnalyzer.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+
+#include <string>
+#include <vector>
+
+#include "breakpad_googletest_includes.h"
+#include "common/scoped_ptr.h"
+#include "common/tests/auto_tempdir.h"
+#include "common/using_std_string.h"
+#include "google_breakpad/processor/basic_source_line_resolver.h"
+#include "google_breakpad/processor/crash_signature_cache.h"
+#include "google_breakpad/processor/minidump_processor.h"
+#include "google_breakpad/processor/process_state.h"
+#include "processor/crash_signature_analyzer.h"
+#include "processor/module_serializer.h"
+#include "processor/simple_symbol_supplier.h"
+
+namespace {
+
+using google_breakpad::AutoTempDir;
+using google_breakpad::BasicSourceLineResolver;
+using google_breakpad::CrashSignatureAnalyzer;
+using google_breakpad::CrashSignatureCache;
+using google_breakpad::MinidumpProcessor;
+using google_breakpad::ModuleSerializer;
+using google_breakpad::PROCESS_OK;
+using google_breakpad::ProcessState;
+using google_breakpad::SimpleSymbolSupplier;
+using google_breakpad::scoped_array;
+using std::vector;
+
+class CrashSignatureAnalyzerTest : public ::testing::Test {
+ public:
+  CrashSignatureAnalyzerTest()
+      : testdata_dir_(string(getenv("srcdir") ? getenv("srcdir") : ".") +
+                      "/src/processor/testdata"),
+        minidump_file_(testdata_dir_ + "/minidump2.dmp") {}
+
+  // Writes the serialized form of the test symbol file for |module| with
+  // identifier |id| to the same place under symbols_dir_, with ".fast"
+  // appended to its name.
+  void SerializeSymbols(const string& module, const string& id,
+                        const string& name) {
+    string symbol_file = testdata_dir_ + "/symbols/" + module + "/" + id +
+                         "/" + name;
+    FILE* in = fopen(symbol_file.c_str(), "rb");
+    ASSERT_TRUE(in);
+    string symbol_data;
+    char buffer[4096];
+    size_t count;
+    while ((count = fread(buffer, 1, sizeof(buffer), in)) > 0)
+      symbol_data.append(buffer, count);
+    fclose(in);
+
+    ModuleSerializer serializer;
+    unsigned int serialized_size;
+    scoped_array<char> serialized(serializer.SerializeSymbolFileData(
+        symbol_data, &serialized_size));
+    ASSERT_TRUE(serialized.get());
+
+    string directory = symbols_dir_.path() + "/" + module;
+    mkdir(directory.c_str(), 0755);
+    directory += "/" + id;
+    mkdir(directory.c_str(), 0755);
+    string fast_file = directory + "/" + name + ".fast";
+    FILE* out = fopen(fast_file.c_str(), "wb");
+    ASSERT_TRUE(out);
+    ASSERT_EQ(serialized_size,
+              fwrite(serialized.get(), 1, serialized_size, out));
+    fclose(out);
+  }
+
+  // Returns the signature that processing the whole minidump with the
+  // text symbol files finds.
+  uint64_t FullySymbolizedSignature() {
+    SimpleSymbolSupplier supplier(testdata_dir_ + "/symbols");
+    BasicSourceLineResolver resolver;
+    MinidumpProcessor processor(&supplier, &resolver);
+    ProcessState state;
+    EXPECT_EQ(PROCESS_OK, processor.Process(minidump_file_, &state));
+    return CrashSignatureCache::Signature(state);
+  }
+
+  string testdata_dir_;
+  string minidump_file_;
+  AutoTempDir symbols_dir_;
+};
+
+TEST_F(CrashSignatureAnalyzerTest, WithSerializedSymbols) {
+  SerializeSymbols("test_app.pdb", "5A9832E5287241C1838ED98914E9B7FF1",
+                   "test_app.sym");
+  SerializeSymbols("kernel32.pdb", "BCE8785C57B44245A669896B6A19B9542",
+                   "kernel32.sym");
+  CrashSignatureAnalyzer analyzer(vector<string>(1, symbols_dir_.path()));
+
+  uint64_t signature;
+  string crash_reason;
+  vector<string> frames;
+  ASSERT_TRUE(analyzer.Analyze(minidump_file_, &signature, &crash_reason,
+                               &frames));
+  EXPECT_EQ(FullySymbolizedSignature(), signature);
+  EXPECT_EQ("EXCEPTION_ACCESS_VIOLATION_WRITE", crash_reason);
+  ASSERT_EQ(4U, frames.size());
+  EXPECT_EQ(0U, frames[0].find(
+      "test_app.exe!`anonymous namespace'::CrashFunction+0x"));
+  EXPECT_EQ(0U, frames[1].find("test_app.exe!main+0x"));
+  EXPECT_EQ(0U, frames[2].find("test_app.exe!__tmainCRTStartup+0x"));
+  EXPECT_EQ(0U, frames[3].find("kernel32.dll!"));
+
+  analyzer.set_max_frames(1);
+  ASSERT_TRUE(analyzer.Analyze(minidump_file_, &signature, &crash_reason,
+                               &frames));
+  EXPECT_EQ(1U, frames.size());
+}
+
+TEST_F(CrashSignatureAnalyzerTest, WithoutSymbols) {
+  CrashSignatureAnalyzer analyzer(vector<string>(1, symbols_dir_.path()));
+  uint64_t signature;
+  string crash_reason;
+  vector<string> frames;
+  ASSERT_TRUE(analyzer.Analyze(minidump_file_, &signature, &crash_reason,
+                               &frames));
+  EXPECT_NE(0U, signature);
+  ASSERT_FALSE(frames.empty());
+  EXPECT_EQ(0U, frames[0].find("test_app.exe+0x"));
+}
+
+TEST_F(CrashSignatureAnalyzerTest, MissingMinidump) {
+  CrashSignatureAnalyzer analyzer(vector<string>(1, symbols_dir_.path()));
+  uint64_t signature = 1;
+  string crash_reason = "reason";
+  vector<string> frames(1, "frame");
+  EXPECT_FALSE(analyzer.Analyze(symbols_dir_.path() + "/missing.dmp",
+                                &signature, &crash_reason, &frames));
+  EXPECT_EQ(0U, signature);
+  EXPECT_TRUE(crash_reason.empty());
+  EXPECT_TRUE(frames.empty());
+}
+
+}  // namespace
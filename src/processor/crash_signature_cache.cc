@@ -0,0 +1,174 @@
+// Copyright (c) 2016 Google Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+// notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above
+// copyright notice, this list of conditions and the following disclaimer
+// in the documentation and/or other materials provided with the
+// distribution.
+//     * Neither the name of Google Inc. nor the names of its
+// contributors may be used to endorse or promote products derived from
+// this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+// crash_signature_cache.cc: Implementation of CrashSignatureCache.
+//
+// See crash_signature_cache.h for documentation.
+
+#include "google_breakpad/processor/crash_signature_cache.h"
+
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "common/using_std_string.h"
+#include "google_breakpad/processor/call_stack.h"
+#include "google_breakpad/processor/code_module.h"
+#include "google_breakpad/processor/code_modules.h"
+#include "google_breakpad/processor/process_state.h"
+#include "google_breakpad/processor/stack_frame.h"
+#include "processor/mutex.h"
+
+namespace google_breakpad {
+
+namespace {
+
+// Adds |size| bytes at |data| to the 64-bit FNV-1a hash |*hash|.
+void HashBytes(const void* data, size_t size, uint64_t* hash) {
+  const unsigned char* bytes = static_cast<const unsigned char*>(data);
+  for (size_t i = 0; i < size; ++i) {
+    *hash ^= bytes[i];
+    *hash *= 1099511628211ULL;
+  }
+}
+
+// Adds |value| and a terminator to |*hash|, so that adjacent strings can't
+// run together.
+void HashString(const string& value, uint64_t* hash) {
+  HashBytes(value.data(), value.size(), hash);
+  HashBytes("", 1, hash);
+}
+
+void HashNumber(uint64_t value, uint64_t* hash) {
+  unsigned char bytes[8];
+  for (int i = 0; i < 8; ++i)
+    bytes[i] = static_cast<unsigned char>(value >> (i * 8));
+  HashBytes(bytes, sizeof(bytes), hash);
+}
+
+}  // namespace
+
+CrashSignatureCache::CrashSignatureCache(size_t max_entries)
+    : max_entries_(max_entries),
+      hits_(0),
+      misses_(0),
+      mutex_(new Mutex) {
+}
+
+CrashSignatureCache::~CrashSignatureCache() {
+  delete mutex_;
+}
+
+// static
+uint64_t CrashSignatureCache::Signature(const ProcessState& process_state) {
+  int requesting_thread = process_state.requesting_thread();
+  if (requesting_thread < 0 ||
+      static_cast<size_t>(requesting_thread) >=
+          process_state.threads()->size()) {
+    return 0;
+  }
+
+  uint64_t hash = 14695981039346656037ULL;
+  HashString(process_state.crash_reason(), &hash);
+
+  const CodeModules* modules = process_state.modules();
+  unsigned int module_count = modules ? modules->module_count() : 0;
+  HashNumber(module_count, &hash);
+  for (unsigned int i = 0; i < module_count; ++i) {
+    const CodeModule* module = modules->GetModuleAtIndex(i);
+    HashString(module->debug_file(), &hash);
+    HashString(module->debug_identifier(), &hash);
+  }
+
+  const std::vector<StackFrame*>* frames =
+      process_state.threads()->at(requesting_thread)->frames();
+  HashNumber(frames->size(), &hash);
+  for (std::vector<StackFrame*>::const_iterator frame = frames->begin();
+       frame != frames->end();
+       ++frame) {
+    const CodeModule* module = (*frame)->module;
+    if (module) {
+      HashString(module->debug_file(), &hash);
+      HashNumber((*frame)->instruction - module->base_address(), &hash);
+    } else {
+      HashString(string(), &hash);
+      HashNumber((*frame)->instruction, &hash);
+    }
+  }
+
+  // 0 means there is no signature.
+  return hash ? hash : 1;
+}
+
+bool CrashSignatureCache::Record(uint64_t signature) {
+  if (signature == 0)
+    return false;
+
+  AutoMutex lock(mutex_);
+  SignatureMap::iterator it = signatures_.find(signature);
+  if (it != signatures_.end()) {
+    ++hits_;
+    recent_.splice(recent_.begin(), recent_, it->second);
+    return true;
+  }
+
+  ++misses_;
+  if (max_entries_ == 0)
+    return false;
+  while (signatures_.size() >= max_entries_) {
+    signatures_.erase(recent_.back());
+    recent_.pop_back();
+  }
+  signatures_.insert(
+      std::make_pair(signature, recent_.insert(recent_.begin(), signature)));
+  return false;
+}
+
+void CrashSignatureCache::Clear() {
+  AutoMutex lock(mutex_);
+  recent_.clear();
+  signatures_.clear();
+}
+
+size_t CrashSignatureCache::size() const {
+  AutoMutex lock(mutex_);
+  return signatures_.size();
+}
+
+uint64_t CrashSignatureCache::hits() const {
+  AutoMutex lock(mutex_);
+  return hits_;
+}
+
+uint64_t CrashSignatureCache::misses() const {
+  AutoMutex lock(mutex_);
+  return misses_;
+}
+
+}  // namespace google_breakpad
@@ -0,0 +1,630 @@
+// Copyright (c) 2016 Google Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+// notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above
+// copyright notice, this list of conditions and the following disclaimer
+// in the documentation and/or other materials provided with the
+// distribution.
+//     * Neither the name of Google Inc. nor the names of its
+// contributors may be used to endorse or promote products derived from
+// this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+// elf_core.cc: Implementation of ElfCore.
+//
+// See elf_core.h for documentation.
+
+#include "processor/elf_core.h"
+
+#include <elf.h>
+#include <inttypes.h>
+#include <link.h>
+#include <signal.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/procfs.h>
+
+#include <algorithm>
+
+#include "client/linux/dump_writer_common/raw_context_cpu.h"
+#include "client/linux/dump_writer_common/thread_info.h"
+#include "processor/basic_code_module.h"
+#include "processor/elf_unwind_info.h"
+#include "processor/logging.h"
+#include "processor/pathname_stripper.h"
+
+// Older system headers lack the notes added in Linux 3.7.
+#ifndef NT_SIGINFO
+#define NT_SIGINFO 0x53494749
+#endif
+#ifndef NT_FILE
+#define NT_FILE 0x46494c45
+#endif
+
+namespace google_breakpad {
+
+namespace {
+
+// Bounds on what is read from the core's memory, which may be corrupt.
+const size_t kMaxProgramHeaders = 256;
+const size_t kMaxNoteSegmentSize = 64 * 1024;
+const size_t kMaxDynamicEntries = 4096;
+const size_t kMaxLinkMapEntries = 4096;
+const size_t kMaxPathLength = 4096;
+
+// A thread context filled by ThreadInfo::FillCPUContext, as core2md
+// writes it to a minidump.
+class ElfCoreContext : public DumpContext {
+ public:
+  // Takes ownership of |context|.
+  explicit ElfCoreContext(RawContextCPU* context) {
+    SetContextFlags(context->context_flags);
+#if defined(__i386__)
+    SetContextX86(context);
+#elif defined(__x86_64__)
+    SetContextAMD64(context);
+#elif defined(__ARM_EABI__)
+    SetContextARM(context);
+#elif defined(__aarch64__)
+    SetContextARM64(context);
+#elif defined(__mips__)
+    SetContextMIPS(context);
+#endif
+    valid_ = true;
+  }
+};
+
+bool IsBigEndian() {
+  const uint16_t kOne = 1;
+  return *reinterpret_cast<const uint8_t*>(&kOne) != 1;
+}
+
+}  // namespace
+
+//
+// ElfCoreMemoryRegion
+//
+
+bool ElfCoreMemoryRegion::GetMemoryAtAddress(uint64_t address,
+                                             uint8_t* value) const {
+  return GetMemory(address, value);
+}
+
+bool ElfCoreMemoryRegion::GetMemoryAtAddress(uint64_t address,
+                                             uint16_t* value) const {
+  return GetMemory(address, value);
+}
+
+bool ElfCoreMemoryRegion::GetMemoryAtAddress(uint64_t address,
+                                             uint32_t* value) const {
+  return GetMemory(address, value);
+}
+
+bool ElfCoreMemoryRegion::GetMemoryAtAddress(uint64_t address,
+                                             uint64_t* value) const {
+  return GetMemory(address, value);
+}
+
+const uint8_t* ElfCoreMemoryRegion::GetContiguousMemory(
+    uint64_t address, uint32_t size) const {
+  if (address < base_address_ || size > size_ ||
+      address - base_address_ > size_ - size)
+    return NULL;
+  return data_ + (address - base_address_);
+}
+
+template<typename ValueType>
+bool ElfCoreMemoryRegion::GetMemory(uint64_t address,
+                                    ValueType* value) const {
+  const uint8_t* memory = GetContiguousMemory(address, sizeof(ValueType));
+  if (!memory)
+    return false;
+  memcpy(value, memory, sizeof(ValueType));
+  return true;
+}
+
+void ElfCoreMemoryRegion::Print() const {
+  printf("ElfCoreMemoryRegion\n");
+  printf("  base_address = 0x%" PRIx64 "\n", base_address_);
+  printf("  size         = 0x%x\n", size_);
+  printf("\n");
+}
+
+//
+// ElfCore
+//
+
+ElfCore::ElfCore()
+    : modules_(new ElfCoreModules()),
+      crash_signal_(0),
+      crash_address_(0),
+      process_id_(0),
+      entry_address_(0),
+      program_headers_address_(0),
+      program_header_count_(0),
+      vdso_address_(0) {
+}
+
+ElfCore::~ElfCore() {}
+
+// static
+ElfCore* ElfCore::Open(const string& path) {
+  scoped_ptr<ElfCore> core(new ElfCore());
+  if (!core->mapped_file_.Map(path.c_str(), 0)) {
+    BPLOG(ERROR) << "Could not map core file " << path;
+    return NULL;
+  }
+  core->core_.SetContent(core->mapped_file_.content());
+  if (!core->core_.IsValid()) {
+    BPLOG(ERROR) << path << " is not a core file of this CPU";
+    return NULL;
+  }
+  if (!core->ReadNotes()) {
+    BPLOG(ERROR) << "Could not read the notes of core file " << path;
+    return NULL;
+  }
+
+  SystemInfo* info = &core->system_info_;
+  info->os = "Linux";
+  info->os_short = "linux";
+#if defined(__i386__)
+  info->cpu = "x86";
+#elif defined(__x86_64__)
+  info->cpu = "amd64";
+#elif defined(__ARM_EABI__)
+  info->cpu = "arm";
+#elif defined(__aarch64__)
+  info->cpu = "arm64";
+#elif defined(__mips__)
+  info->cpu = "mips";
+#endif
+  return core.release();
+}
+
+uint32_t ElfCore::GetThreadId(unsigned int index) const {
+  return index < threads_.size() ? threads_[index].id : 0;
+}
+
+DumpContext* ElfCore::GetThreadContext(unsigned int index) const {
+  return index < threads_.size() ? threads_[index].context.get() : NULL;
+}
+
+MemoryRegion* ElfCore::GetThreadMemory(unsigned int index) const {
+  return index < threads_.size() ? threads_[index].memory.get() : NULL;
+}
+
+bool ElfCore::ReadNotes() {
+  // The notes are ordered as linux_core_dumper.cc describes: each
+  // NT_PRSTATUS is followed by the other notes of its thread, and the
+  // process-wide notes follow the first.
+  std::vector<ThreadInfo> infos;
+  std::vector<FileMapping> file_mappings;
+  bool found_siginfo = false;
+  for (ElfCoreDump::Note note = core_.GetFirstNote();
+       note.IsValid();
+       note = note.GetNextNote()) {
+    MemoryRange description = note.GetDescription();
+    switch (note.GetType()) {
+      case NT_PRSTATUS: {
+        if (description.length() != sizeof(elf_prstatus)) {
+          BPLOG(ERROR) << "NT_PRSTATUS note of unexpected size "
+                       << description.length();
+          return false;
+        }
+        const elf_prstatus* status =
+            reinterpret_cast<const elf_prstatus*>(description.data());
+        ThreadInfo info;
+        memset(&info, 0, sizeof(info));
+        info.tgid = status->pr_pgrp;
+        info.ppid = status->pr_ppid;
+#if defined(__mips__)
+        for (int i = EF_REG0; i <= EF_REG31; i++)
+          info.regs.regs[i - EF_REG0] = status->pr_reg[i];
+        info.regs.lo = status->pr_reg[EF_LO];
+        info.regs.hi = status->pr_reg[EF_HI];
+        info.regs.epc = status->pr_reg[EF_CP0_EPC];
+        info.regs.badvaddr = status->pr_reg[EF_CP0_BADVADDR];
+        info.regs.status = status->pr_reg[EF_CP0_STATUS];
+        info.regs.cause = status->pr_reg[EF_CP0_CAUSE];
+#else
+        memcpy(&info.regs, status->pr_reg, sizeof(info.regs));
+#endif
+        if (infos.empty())
+          crash_signal_ = status->pr_info.si_signo;
+        infos.push_back(info);
+        Thread thread;
+        thread.id = status->pr_pid;
+        threads_.push_back(thread);
+        break;
+      }
+#if defined(__i386__) || defined(__x86_64__)
+      case NT_FPREGSET: {
+        if (infos.empty() ||
+            description.length() != sizeof(infos.back().fpregs)) {
+          BPLOG(ERROR) << "Unexpected NT_FPREGSET note";
+          return false;
+        }
+        memcpy(&infos.back().fpregs, description.data(),
+               sizeof(infos.back().fpregs));
+        break;
+      }
+#endif
+#if defined(__i386__)
+      case NT_PRXFPREG: {
+        if (infos.empty() ||
+            description.length() != sizeof(infos.back().fpxregs)) {
+          BPLOG(ERROR) << "Unexpected NT_PRXFPREG note";
+          return false;
+        }
+        memcpy(&infos.back().fpxregs, description.data(),
+               sizeof(infos.back().fpxregs));
+        break;
+      }
+#endif
+      case NT_PRPSINFO: {
+        if (description.length() == sizeof(elf_prpsinfo)) {
+          const elf_prpsinfo* info =
+              reinterpret_cast<const elf_prpsinfo*>(description.data());
+          process_id_ = info->pr_pid;
+          // The command line starts with the path the executable was run
+          // by, and pr_fname holds up to 15 characters of its name.
+          executable_path_.assign(info->pr_psargs,
+                                  strnlen(info->pr_psargs,
+                                          sizeof(info->pr_psargs)));
+          executable_path_ = executable_path_.substr(
+              0, executable_path_.find(' '));
+          if (executable_path_.empty()) {
+            executable_path_.assign(info->pr_fname,
+                                    strnlen(info->pr_fname,
+                                            sizeof(info->pr_fname)));
+          }
+        }
+        break;
+      }
+      case NT_SIGINFO: {
+        // Only the thread that received the signal has one.
+        if (found_siginfo || description.length() < sizeof(siginfo_t))
+          break;
+        found_siginfo = true;
+        siginfo_t siginfo;
+        memcpy(&siginfo, description.data(), sizeof(siginfo));
+        if (siginfo.si_signo == SIGSEGV || siginfo.si_signo == SIGBUS ||
+            siginfo.si_signo == SIGILL || siginfo.si_signo == SIGFPE ||
+            siginfo.si_signo == SIGTRAP) {
+          crash_address_ = reinterpret_cast<uintptr_t>(siginfo.si_addr);
+        }
+        break;
+      }
+      case NT_AUXV: {
+        for (size_t i = 0;
+             (i + 1) * sizeof(ElfW(auxv_t)) <= description.length();
+             ++i) {
+          ElfW(auxv_t) entry;
+          memcpy(&entry, description.data() + i * sizeof(entry),
+                 sizeof(entry));
+          if (entry.a_type == AT_ENTRY)
+            entry_address_ = entry.a_un.a_val;
+          else if (entry.a_type == AT_PHDR)
+            program_headers_address_ = entry.a_un.a_val;
+          else if (entry.a_type == AT_PHNUM)
+            program_header_count_ = entry.a_un.a_val;
+          else if (entry.a_type == AT_SYSINFO_EHDR)
+            vdso_address_ = entry.a_un.a_val;
+        }
+        break;
+      }
+      case NT_FILE: {
+        if (!ReadFileNote(description, &file_mappings))
+          return false;
+        break;
+      }
+    }
+  }
+
+  if (threads_.empty()) {
+    BPLOG(ERROR) << "Core file has no threads";
+    return false;
+  }
+
+  for (size_t i = 0; i < threads_.size(); ++i) {
+    RawContextCPU* raw_context = new RawContextCPU();
+    memset(raw_context, 0, sizeof(*raw_context));
+    infos[i].FillCPUContext(raw_context);
+    threads_[i].context.reset(new ElfCoreContext(raw_context));
+    uint64_t stack_pointer;
+    if (threads_[i].context->GetStackPointer(&stack_pointer))
+      threads_[i].memory.reset(SegmentAt(stack_pointer));
+  }
+
+  if (!file_mappings.empty()) {
+    AddFileModules(file_mappings);
+    // The vDSO has no file, so NT_FILE leaves it out.  The client names
+    // it linux-gate.so.
+    if (vdso_address_)
+      AddModule(vdso_address_, 0, "linux-gate.so");
+  } else {
+    AddLinkMapModules();
+  }
+
+  const CodeModule* main_module = modules_->GetModuleForAddress(
+      entry_address_);
+  if (!main_module && modules_->module_count() > 0)
+    main_module = modules_->GetModuleAtSequence(0);
+  if (main_module)
+    modules_->set_main_address(main_module->base_address());
+  return true;
+}
+
+bool ElfCore::ReadFileNote(const MemoryRange& description,
+                           std::vector<FileMapping>* file_mappings) {
+  // The note holds the number of mappings and the page size, then the
+  // start, end and offset in pages of each mapping, then the path of each,
+  // terminated by a NUL.
+  const size_t kWordSize = sizeof(Addr);
+  Addr count, page_size;
+  if (description.length() < 2 * kWordSize) {
+    BPLOG(ERROR) << "NT_FILE note is truncated";
+    return false;
+  }
+  memcpy(&count, description.data(), kWordSize);
+  memcpy(&page_size, description.data() + kWordSize, kWordSize);
+  if (count > (description.length() - 2 * kWordSize) / (3 * kWordSize)) {
+    BPLOG(ERROR) << "NT_FILE note is truncated";
+    return false;
+  }
+
+  const char* path =
+      reinterpret_cast<const char*>(description.data()) +
+      (2 + 3 * count) * kWordSize;
+  const char* end =
+      reinterpret_cast<const char*>(description.data()) + description.length();
+  for (Addr i = 0; i < count; ++i) {
+    const char* path_end = static_cast<const char*>(
+        memchr(path, '\0', end - path));
+    if (!path_end) {
+      BPLOG(ERROR) << "NT_FILE note is truncated";
+      return false;
+    }
+    Addr words[3];
+    memcpy(words, description.data() + (2 + 3 * i) * kWordSize,
+           sizeof(words));
+    FileMapping mapping;
+    mapping.start = words[0];
+    mapping.end = words[1];
+    mapping.offset = words[2] * page_size;
+    mapping.path.assign(path, path_end);
+    file_mappings->push_back(mapping);
+    path = path_end + 1;
+  }
+  return true;
+}
+
+void ElfCore::AddFileModules(const std::vector<FileMapping>& file_mappings) {
+  // The kernel lists mappings by address, so the segments of a module
+  // follow its first mapping, which starts at offset 0 of its file.
+  size_t i = 0;
+  while (i < file_mappings.size()) {
+    const FileMapping& first = file_mappings[i];
+    Addr end = first.end;
+    size_t next = i + 1;
+    while (next < file_mappings.size() &&
+           file_mappings[next].path == first.path &&
+           file_mappings[next].offset != 0) {
+      end = file_mappings[next].end;
+      ++next;
+    }
+    if (first.offset == 0)
+      AddModule(first.start, end, first.path);
+    i = next;
+  }
+}
+
+void ElfCore::AddLinkMapModules() {
+  if (!program_headers_address_ || !program_header_count_ ||
+      program_header_count_ > kMaxProgramHeaders) {
+    BPLOG(INFO) << "Core file has no NT_FILE note or program headers";
+    return;
+  }
+  std::vector<Phdr> headers(program_header_count_);
+  if (!core_.CopyData(&headers[0], program_headers_address_,
+                      headers.size() * sizeof(Phdr))) {
+    BPLOG(INFO) << "Core file doesn't hold the program headers";
+    return;
+  }
+
+  // The executable's load bias is where its program headers are, less
+  // where they were linked to be.
+  Addr load_bias = 0, dynamic = 0, start = 0;
+  bool found_phdr = false, found_load = false;
+  for (size_t i = 0; i < headers.size(); ++i) {
+    if (headers[i].p_type == PT_PHDR) {
+      load_bias = program_headers_address_ - headers[i].p_vaddr;
+      found_phdr = true;
+    }
+  }
+  if (!found_phdr) {
+    BPLOG(INFO) << "Executable has no PT_PHDR program header";
+    return;
+  }
+  for (size_t i = 0; i < headers.size(); ++i) {
+    if (headers[i].p_type == PT_DYNAMIC) {
+      dynamic = load_bias + headers[i].p_vaddr;
+    } else if (headers[i].p_type == PT_LOAD && !found_load) {
+      start = load_bias + headers[i].p_vaddr - headers[i].p_offset;
+      found_load = true;
+    }
+  }
+  // The link_map entry of the executable has no name, so it is named
+  // from NT_PRPSINFO.
+  if (found_load)
+    AddModule(start, 0, executable_path_);
+
+  Addr debug = 0;
+  for (size_t i = 0; dynamic && i < kMaxDynamicEntries; ++i) {
+    ElfW(Dyn) entry;
+    if (!core_.CopyData(&entry, dynamic + i * sizeof(entry), sizeof(entry)) ||
+        entry.d_tag == DT_NULL) {
+      break;
+    }
+    if (entry.d_tag == DT_DEBUG) {
+      debug = entry.d_un.d_ptr;
+      break;
+    }
+  }
+  struct r_debug r_debug;
+  if (!debug || !core_.CopyData(&r_debug, debug, sizeof(r_debug))) {
+    BPLOG(INFO) << "Core file has no r_debug";
+    return;
+  }
+
+  Addr address = reinterpret_cast<Addr>(r_debug.r_map);
+  for (size_t i = 0; address && i < kMaxLinkMapEntries; ++i) {
+    struct link_map entry;
+    if (!core_.CopyData(&entry, address, sizeof(entry)))
+      break;
+    string path;
+    Addr name = reinterpret_cast<Addr>(entry.l_name);
+    char c;
+    while (name && path.size() < kMaxPathLength &&
+           core_.CopyData(&c, name + path.size(), 1) && c) {
+      path += c;
+    }
+    if (!path.empty())
+      AddModule(entry.l_addr, 0, path);
+    address = reinterpret_cast<Addr>(entry.l_next);
+  }
+}
+
+bool ElfCore::AddModule(Addr start, Addr end, const string& path) {
+  Ehdr header;
+  if (!core_.CopyData(&header, start, sizeof(header)) ||
+      memcmp(header.e_ident, ELFMAG, SELFMAG) != 0 ||
+      header.e_ident[EI_CLASS] != ElfCoreDump::kClass) {
+    return false;
+  }
+
+  std::vector<Phdr> headers;
+  if (header.e_phentsize == sizeof(Phdr) &&
+      header.e_phnum <= kMaxProgramHeaders) {
+    headers.resize(header.e_phnum);
+  }
+  if (!headers.empty() &&
+      !core_.CopyData(&headers[0], start + header.e_phoff,
+                      headers.size() * sizeof(Phdr))) {
+    headers.clear();
+  }
+
+  // The module's first byte is loaded where its first segment starts.
+  Addr load_bias = start;
+  Addr loaded_end = 0;
+  bool found_load = false;
+  for (size_t i = 0; i < headers.size(); ++i) {
+    const Phdr& segment = headers[i];
+    if (segment.p_type != PT_LOAD)
+      continue;
+    if (!found_load) {
+      load_bias = start - (segment.p_vaddr - segment.p_offset);
+      found_load = true;
+    }
+    loaded_end = std::max<Addr>(loaded_end,
+                                load_bias + segment.p_vaddr + segment.p_memsz);
+  }
+  if (!end)
+    end = loaded_end;
+  if (end <= start) {
+    BPLOG(INFO) << "Could not find the extent of module " << path;
+    return false;
+  }
+
+  string debug_identifier = ReadDebugIdentifier(headers, load_bias);
+  string debug_file = PathnameStripper::File(path);
+  return modules_->Add(new BasicCodeModule(
+      start,                       // base_address
+      end - start,                 // size
+      path,                        // code_file
+      "",                          // code_identifier
+      debug_file,                  // debug_file
+      debug_identifier,            // debug_identifier
+      ""));                        // version
+}
+
+string ElfCore::ReadDebugIdentifier(const std::vector<Phdr>& headers,
+                                    Addr load_bias) {
+  for (size_t i = 0; i < headers.size(); ++i) {
+    const Phdr& segment = headers[i];
+    if (segment.p_type != PT_NOTE || segment.p_filesz == 0 ||
+        segment.p_filesz > kMaxNoteSegmentSize) {
+      continue;
+    }
+    std::vector<char> notes(segment.p_filesz);
+    if (!core_.CopyData(&notes[0], load_bias + segment.p_vaddr,
+                        notes.size())) {
+      continue;
+    }
+
+    const size_t alignment = segment.p_align == 8 ? 8 : 4;
+    size_t offset = 0;
+    while (notes.size() - offset >= sizeof(ElfW(Nhdr))) {
+      ElfW(Nhdr) note;
+      memcpy(&note, &notes[offset], sizeof(note));
+      size_t remaining = notes.size() - offset - sizeof(note);
+      size_t name_size = (note.n_namesz + alignment - 1) & ~(alignment - 1);
+      if (note.n_namesz > remaining || name_size > remaining ||
+          note.n_descsz > remaining - name_size) {
+        break;
+      }
+      const char* name = &notes[offset + sizeof(note)];
+      const char* description = name + name_size;
+      if (note.n_type == NT_GNU_BUILD_ID && note.n_namesz == 4 &&
+          memcmp(name, "GNU", 4) == 0 && note.n_descsz > 0) {
+        return ElfUnwindInfo::DebugIdentifierForBuildId(
+            description, note.n_descsz, IsBigEndian());
+      }
+      size_t description_size =
+          (note.n_descsz + alignment - 1) & ~(alignment - 1);
+      if (description_size > remaining - name_size)
+        break;
+      offset += sizeof(note) + name_size + description_size;
+    }
+  }
+  return "";
+}
+
+ElfCoreMemoryRegion* ElfCore::SegmentAt(uint64_t address) const {
+  const uint8_t* data = mapped_file_.content().data();
+  size_t size = mapped_file_.size();
+  for (unsigned i = 0; i < core_.GetProgramHeaderCount(); ++i) {
+    const Phdr* segment = core_.GetProgramHeader(i);
+    if (segment->p_type != PT_LOAD || address < segment->p_vaddr ||
+        address - segment->p_vaddr >= segment->p_filesz) {
+      continue;
+    }
+    if (segment->p_offset > size ||
+        segment->p_filesz > size - segment->p_offset) {
+      return NULL;
+    }
+    uint64_t length = std::min<uint64_t>(segment->p_filesz, 0xffffffff);
+    return new ElfCoreMemoryRegion(segment->p_vaddr,
+                                   data + segment->p_offset, length);
+  }
+  return NULL;
+}
+
+}  // namespace google_breakpad
@@ -0,0 +1,219 @@
+// Copyright (c) 2016 Google Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+// notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above
+// copyright notice, this list of conditions and the following disclaimer
+// in the documentation and/or other materials provided with the
+// distribution.
+//     * Neither the name of Google Inc. nor the names of its
+// contributors may be used to endorse or promote products derived from
+// this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+// elf_core.h: ElfCore, which reads the threads, modules and memory of a
+// Linux ELF core file in place, for ElfCoreProcessor.
+//
+// A core file holds everything a stack walk needs: an NT_PRSTATUS note
+// with the registers of each thread, the first of them the thread that
+// received the fatal signal, and a PT_LOAD segment for each mapping,
+// stacks included.  The modules come from the NT_FILE note, which lists
+// the file behind each mapping, or, for cores written by kernels older
+// than 3.7, from the dynamic linker's link_map list in the core's memory.
+// Each module's debug identifier is made from the build ID note in its
+// first page, which Linux dumps for every ELF mapping.
+//
+// The core is read with ElfCoreDump, so it must have been written by a
+// process of the same CPU as the processor's own, as with core2md.
+
+#ifndef PROCESSOR_ELF_CORE_H__
+#define PROCESSOR_ELF_CORE_H__
+
+#include <stddef.h>
+
+#include <string>
+#include <vector>
+
+#include "common/linux/elf_core_dump.h"
+#include "common/linux/memory_mapped_file.h"
+#include "common/scoped_ptr.h"
+#include "common/using_std_string.h"
+#include "google_breakpad/common/breakpad_types.h"
+#include "google_breakpad/processor/dump_context.h"
+#include "google_breakpad/processor/memory_region.h"
+#include "google_breakpad/processor/system_info.h"
+#include "processor/basic_code_modules.h"
+#include "processor/linked_ptr.h"
+
+namespace google_breakpad {
+
+// The modules of an ElfCore.
+class ElfCoreModules : public BasicCodeModules {
+ public:
+  ElfCoreModules() {}
+
+  // Takes over ownership of |module|.  Returns false if it overlaps a
+  // module already added.
+  bool Add(const CodeModule* module) { return StoreModule(module); }
+
+  // Makes the module at |base_address| the main module.
+  void set_main_address(uint64_t base_address) {
+    main_address_ = base_address;
+  }
+};
+
+// A PT_LOAD segment of an ElfCore, read in place from the mapped core.
+// See memory_region.h for documentation.
+class ElfCoreMemoryRegion : public MemoryRegion {
+ public:
+  ElfCoreMemoryRegion(uint64_t base_address, const uint8_t* data,
+                      uint32_t size)
+      : base_address_(base_address), data_(data), size_(size) {}
+  virtual ~ElfCoreMemoryRegion() {}
+
+  virtual uint64_t GetBase() const { return base_address_; }
+  virtual uint32_t GetSize() const { return size_; }
+
+  virtual bool GetMemoryAtAddress(uint64_t address, uint8_t* value) const;
+  virtual bool GetMemoryAtAddress(uint64_t address, uint16_t* value) const;
+  virtual bool GetMemoryAtAddress(uint64_t address, uint32_t* value) const;
+  virtual bool GetMemoryAtAddress(uint64_t address, uint64_t* value) const;
+
+  // Returns the mapped core directly: it is in the processor's own byte
+  // order.
+  virtual const uint8_t* GetContiguousMemory(uint64_t address,
+                                             uint32_t size) const;
+
+  virtual void Print() const;
+
+ private:
+  template<typename ValueType>
+  bool GetMemory(uint64_t address, ValueType* value) const;
+
+  uint64_t base_address_;
+  const uint8_t* data_;
+  uint32_t size_;
+};
+
+class ElfCore {
+ public:
+  // Maps the core file at |path| and reads its notes and modules.  Returns
+  // NULL if the file can't be mapped, isn't a core file of the processor's
+  // own CPU, or has no threads.
+  static ElfCore* Open(const string& path);
+
+  ~ElfCore();
+
+  // The threads, in the order of their NT_PRSTATUS notes.
+  unsigned int thread_count() const { return threads_.size(); }
+  uint32_t GetThreadId(unsigned int index) const;
+  DumpContext* GetThreadContext(unsigned int index) const;
+
+  // Returns the PT_LOAD segment holding the stack pointer of thread
+  // |index|, or NULL if the core doesn't hold it.
+  MemoryRegion* GetThreadMemory(unsigned int index) const;
+
+  const ElfCoreModules* GetModules() const { return modules_.get(); }
+  const SystemInfo* GetSystemInfo() const { return &system_info_; }
+
+  // The signal the first thread received, or 0 if it received none.
+  int crash_signal() const { return crash_signal_; }
+
+  // The faulting address of the signal, from the NT_SIGINFO note, or 0 if
+  // the core has none.
+  uint64_t crash_address() const { return crash_address_; }
+
+  uint32_t process_id() const { return process_id_; }
+
+ private:
+  typedef ElfCoreDump::Addr Addr;
+  typedef ElfCoreDump::Ehdr Ehdr;
+  typedef ElfCoreDump::Phdr Phdr;
+
+  struct Thread {
+    uint32_t id;
+    linked_ptr<DumpContext> context;
+    linked_ptr<ElfCoreMemoryRegion> memory;
+  };
+
+  // A mapping listed in the NT_FILE note.
+  struct FileMapping {
+    Addr start;
+    Addr end;
+    Addr offset;
+    string path;
+  };
+
+  ElfCore();
+
+  // Reads the notes.  Returns false if the core has no threads or a note
+  // is malformed.
+  bool ReadNotes();
+
+  // Reads the NT_FILE note in |description| into |file_mappings|.
+  bool ReadFileNote(const MemoryRange& description,
+                    std::vector<FileMapping>* file_mappings);
+
+  // Adds a module for each file in |file_mappings| that starts with an
+  // ELF header.
+  void AddFileModules(const std::vector<FileMapping>& file_mappings);
+
+  // Adds a module for each entry of the dynamic linker's link_map list.
+  void AddLinkMapModules();
+
+  // Adds the module whose ELF header is at |start| to modules_.  |end|
+  // is the end of the module, or 0 to take it from its program headers.
+  // Returns false if there is no ELF header at |start|.
+  bool AddModule(Addr start, Addr end, const string& path);
+
+  // Returns the debug identifier made from the build ID of the module
+  // whose program headers are |headers|, loaded with |load_bias|.
+  string ReadDebugIdentifier(const std::vector<Phdr>& headers,
+                             Addr load_bias);
+
+  // Finds the PT_LOAD segment holding |address| with its data in the core.
+  ElfCoreMemoryRegion* SegmentAt(uint64_t address) const;
+
+  MemoryMappedFile mapped_file_;
+  ElfCoreDump core_;
+
+  std::vector<Thread> threads_;
+  scoped_ptr<ElfCoreModules> modules_;
+  SystemInfo system_info_;
+  int crash_signal_;
+  uint64_t crash_address_;
+
+  // From the NT_PRPSINFO note.
+  uint32_t process_id_;
+  string executable_path_;
+
+  // From the NT_AUXV note.
+  Addr entry_address_;
+  Addr program_headers_address_;
+  Addr program_header_count_;
+  Addr vdso_address_;
+
+  // Disallow copy constructor and assignment operator.
+  ElfCore(const ElfCore&);
+  void operator=(const ElfCore&);
+};
+
+}  // namespace google_breakpad
+
+#endif  // PROCESSOR_ELF_CORE_H__
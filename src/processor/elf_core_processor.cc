@@ -0,0 +1,175 @@
+// Copyright (c) 2016 Google Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+// notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above
+// copyright notice, this list of conditions and the following disclaimer
+// in the documentation and/or other materials provided with the
+// distribution.
+//     * Neither the name of Google Inc. nor the names of its
+// contributors may be used to endorse or promote products derived from
+// this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+// elf_core_processor.cc: A processor for Linux ELF core files.
+//
+// See elf_core_processor.h for documentation.
+
+#include "google_breakpad/processor/elf_core_processor.h"
+
+#include <assert.h>
+#include <stdio.h>
+
+#include "common/scoped_ptr.h"
+#include "google_breakpad/common/minidump_exception_linux.h"
+#include "google_breakpad/processor/call_stack.h"
+#include "google_breakpad/processor/process_state.h"
+#include "google_breakpad/processor/stackwalker.h"
+#include "google_breakpad/processor/stack_frame_symbolizer.h"
+#include "processor/elf_core.h"
+#include "processor/logging.h"
+
+namespace google_breakpad {
+
+ElfCoreProcessor::ElfCoreProcessor(StackFrameSymbolizer* frame_symbolizer)
+    : frame_symbolizer_(frame_symbolizer) {
+  assert(frame_symbolizer);
+}
+
+ElfCoreProcessor::~ElfCoreProcessor() {}
+
+ProcessResult ElfCoreProcessor::Process(const string& core_path,
+                                        ProcessState* process_state) {
+  assert(process_state);
+  process_state->Clear();
+
+  scoped_ptr<ElfCore> core(ElfCore::Open(core_path));
+  if (!core.get())
+    return PROCESS_ERROR_MINIDUMP_NOT_FOUND;
+
+  ProcessResult result = Process(core.get(), process_state);
+  for (size_t i = 0; i < process_state->thread_memory_regions_.size(); ++i)
+    process_state->thread_memory_regions_[i] = NULL;
+  return result;
+}
+
+ProcessResult ElfCoreProcessor::Process(ElfCore* core,
+                                        ProcessState* process_state) {
+  assert(core);
+  assert(process_state);
+  process_state->Clear();
+
+  process_state->system_info_ = *core->GetSystemInfo();
+  process_state->modules_ = core->GetModules()->Copy();
+  if (core->crash_signal()) {
+    process_state->crashed_ = true;
+    process_state->crash_reason_ = GetCrashReason(core->crash_signal());
+    process_state->crash_address_ = core->crash_address();
+  }
+  // The kernel writes the thread that received the signal first.
+  process_state->requesting_thread_ = 0;
+
+  bool interrupted = false;
+  for (unsigned int i = 0; i < core->thread_count(); ++i) {
+    MemoryRegion* thread_memory = core->GetThreadMemory(i);
+    if (!thread_memory) {
+      BPLOG(ERROR) << "No memory region for thread " << i << " ("
+                   << core->GetThreadId(i) << ")";
+    }
+
+    scoped_ptr<Stackwalker> stackwalker(
+        Stackwalker::StackwalkerForCPU(&process_state->system_info_,
+                                       core->GetThreadContext(i),
+                                       thread_memory,
+                                       process_state->modules_,
+                                       frame_symbolizer_));
+    scoped_ptr<CallStack> stack(
+        process_state->NewCallStack(&process_state->frame_arena_));
+    if (stackwalker.get()) {
+      stackwalker->set_frame_arena(&process_state->frame_arena_);
+      if (!stackwalker->Walk(stack.get(),
+                             &process_state->modules_without_symbols_,
+                             &process_state->modules_with_corrupt_symbols_)) {
+        BPLOG(INFO) << "Stackwalker interrupt (missing symbols?) at thread "
+                    << i;
+        interrupted = true;
+      }
+    } else {
+      BPLOG(ERROR) << "No stackwalker for thread " << i;
+    }
+    process_state->threads_.push_back(stack.release());
+    process_state->thread_memory_regions_.push_back(thread_memory);
+  }
+
+  if (interrupted) {
+    BPLOG(INFO) << "Processing was interrupted.";
+    return PROCESS_SYMBOL_SUPPLIER_INTERRUPTED;
+  }
+  return PROCESS_OK;
+}
+
+// static
+string ElfCoreProcessor::GetCrashReason(int signal_number) {
+  static const struct {
+    int signal_number;
+    const char* name;
+  } kSignalNames[] = {
+    { MD_EXCEPTION_CODE_LIN_SIGHUP, "SIGHUP" },
+    { MD_EXCEPTION_CODE_LIN_SIGINT, "SIGINT" },
+    { MD_EXCEPTION_CODE_LIN_SIGQUIT, "SIGQUIT" },
+    { MD_EXCEPTION_CODE_LIN_SIGILL, "SIGILL" },
+    { MD_EXCEPTION_CODE_LIN_SIGTRAP, "SIGTRAP" },
+    { MD_EXCEPTION_CODE_LIN_SIGABRT, "SIGABRT" },
+    { MD_EXCEPTION_CODE_LIN_SIGBUS, "SIGBUS" },
+    { MD_EXCEPTION_CODE_LIN_SIGFPE, "SIGFPE" },
+    { MD_EXCEPTION_CODE_LIN_SIGKILL, "SIGKILL" },
+    { MD_EXCEPTION_CODE_LIN_SIGUSR1, "SIGUSR1" },
+    { MD_EXCEPTION_CODE_LIN_SIGSEGV, "SIGSEGV" },
+    { MD_EXCEPTION_CODE_LIN_SIGUSR2, "SIGUSR2" },
+    { MD_EXCEPTION_CODE_LIN_SIGPIPE, "SIGPIPE" },
+    { MD_EXCEPTION_CODE_LIN_SIGALRM, "SIGALRM" },
+    { MD_EXCEPTION_CODE_LIN_SIGTERM, "SIGTERM" },
+    { MD_EXCEPTION_CODE_LIN_SIGSTKFLT, "SIGSTKFLT" },
+    { MD_EXCEPTION_CODE_LIN_SIGCHLD, "SIGCHLD" },
+    { MD_EXCEPTION_CODE_LIN_SIGCONT, "SIGCONT" },
+    { MD_EXCEPTION_CODE_LIN_SIGSTOP, "SIGSTOP" },
+    { MD_EXCEPTION_CODE_LIN_SIGTSTP, "SIGTSTP" },
+    { MD_EXCEPTION_CODE_LIN_SIGTTIN, "SIGTTIN" },
+    { MD_EXCEPTION_CODE_LIN_SIGTTOU, "SIGTTOU" },
+    { MD_EXCEPTION_CODE_LIN_SIGURG, "SIGURG" },
+    { MD_EXCEPTION_CODE_LIN_SIGXCPU, "SIGXCPU" },
+    { MD_EXCEPTION_CODE_LIN_SIGXFSZ, "SIGXFSZ" },
+    { MD_EXCEPTION_CODE_LIN_SIGVTALRM, "SIGVTALRM" },
+    { MD_EXCEPTION_CODE_LIN_SIGPROF, "SIGPROF" },
+    { MD_EXCEPTION_CODE_LIN_SIGWINCH, "SIGWINCH" },
+    { MD_EXCEPTION_CODE_LIN_SIGIO, "SIGIO" },
+    { MD_EXCEPTION_CODE_LIN_SIGPWR, "SIGPWR" },
+    { MD_EXCEPTION_CODE_LIN_SIGSYS, "SIGSYS" },
+  };
+  for (size_t i = 0; i < sizeof(kSignalNames) / sizeof(kSignalNames[0]);
+       ++i) {
+    if (kSignalNames[i].signal_number == signal_number)
+      return kSignalNames[i].name;
+  }
+  char reason[11];
+  snprintf(reason, sizeof(reason), "0x%08x", signal_number);
+  return reason;
+}
+
+}  // namespace google_breakpad
@@ -0,0 +1,197 @@
+// Copyright (c) 2016 Google Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+// notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above
+// copyright notice, this list of conditions and the following disclaimer
+// in the documentation and/or other materials provided with the
+// distribution.
+//     * Neither the name of Google Inc. nor the names of its
+// contributors may be used to endorse or promote products derived from
+// this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+// elf_core_processor_unittest.cc: Unit tests for ElfCore and
+// ElfCoreProcessor, run against a core file from a real crash.
+
+#include <signal.h>
+#include <stdio.h>
+#include <unistd.h>
+
+#include <string>
+
+#include "breakpad_googletest_includes.h"
+#include "common/linux/tests/crash_generator.h"
+#include "common/scoped_ptr.h"
+#include "common/using_std_string.h"
+#include "google_breakpad/processor/basic_source_line_resolver.h"
+#include "google_breakpad/processor/call_stack.h"
+#include "google_breakpad/processor/code_module.h"
+#include "google_breakpad/processor/code_modules.h"
+#include "google_breakpad/processor/elf_core_processor.h"
+#include "google_breakpad/processor/process_state.h"
+#include "google_breakpad/processor/stack_frame_symbolizer.h"
+#include "processor/elf_core.h"
+#include "processor/elf_unwind_info.h"
+#include "processor/pathname_stripper.h"
+
+namespace {
+
+using google_breakpad::BasicSourceLineResolver;
+using google_breakpad::CodeModule;
+using google_breakpad::CrashGenerator;
+using google_breakpad::ElfCore;
+using google_breakpad::ElfCoreProcessor;
+using google_breakpad::ElfUnwindInfo;
+using google_breakpad::MemoryRegion;
+using google_breakpad::PathnameStripper;
+using google_breakpad::ProcessState;
+using google_breakpad::StackFrameSymbolizer;
+using google_breakpad::scoped_ptr;
+
+const unsigned kNumThreads = 3;
+const unsigned kCrashThread = 1;
+// Large enough to hold the stacks of all the threads.
+const rlim_t kCoreSizeLimit = 64 * 1024 * 1024;
+
+class ElfCoreProcessorTest : public ::testing::Test {
+ public:
+  // Crashes a child process, leaving its core file for the test to read.
+  // Returns false if the system doesn't write core files where
+  // CrashGenerator expects them.
+  bool CrashChild() {
+    if (!crash_generator_.HasDefaultCorePattern()) {
+      fprintf(stderr, "ElfCoreProcessorTest is skipped "
+              "due to non-default core pattern\n");
+      return false;
+    }
+    crash_generator_.set_core_size_limit(kCoreSizeLimit);
+    EXPECT_TRUE(crash_generator_.CreateChildCrash(kNumThreads, kCrashThread,
+                                                  SIGABRT, NULL));
+    return true;
+  }
+
+  CrashGenerator crash_generator_;
+};
+
+TEST_F(ElfCoreProcessorTest, ReadsThreadsAndModules) {
+  if (!CrashChild())
+    return;
+
+  scoped_ptr<ElfCore> core(ElfCore::Open(crash_generator_.GetCoreFilePath()));
+  ASSERT_TRUE(core.get());
+  ASSERT_EQ(kNumThreads, core->thread_count());
+  // The thread that received the signal comes first.
+  EXPECT_EQ(static_cast<uint32_t>(crash_generator_.GetThreadId(kCrashThread)),
+            core->GetThreadId(0));
+  EXPECT_EQ(SIGABRT, core->crash_signal());
+  for (unsigned int i = 0; i < core->thread_count(); ++i) {
+    ASSERT_TRUE(core->GetThreadContext(i));
+    uint64_t stack_pointer;
+    ASSERT_TRUE(core->GetThreadContext(i)->GetStackPointer(&stack_pointer));
+    MemoryRegion* memory = core->GetThreadMemory(i);
+    ASSERT_TRUE(memory);
+    uint64_t word;
+    EXPECT_TRUE(memory->GetMemoryAtAddress(stack_pointer, &word));
+  }
+
+  // The child is a fork of this test, so this test is its main module,
+  // and its identifier is made from the same build ID as the client's.
+  char path[4096];
+  ssize_t path_length = readlink("/proc/self/exe", path, sizeof(path) - 1);
+  ASSERT_GT(path_length, 0);
+  path[path_length] = '\0';
+  const CodeModule* main_module = core->GetModules()->GetMainModule();
+  ASSERT_TRUE(main_module);
+  EXPECT_EQ(string(path), main_module->code_file());
+  EXPECT_EQ(PathnameStripper::File(path), main_module->debug_file());
+  scoped_ptr<ElfUnwindInfo> binary(ElfUnwindInfo::Open(path));
+  if (binary.get() && !binary->debug_identifier().empty())
+    EXPECT_EQ(binary->debug_identifier(), main_module->debug_identifier());
+
+  // Every thread is stopped somewhere in the C library.
+  const CodeModule* libc = core->GetModules()->GetModuleForAddress(
+      reinterpret_cast<uintptr_t>(&getpid));
+  ASSERT_TRUE(libc);
+  EXPECT_FALSE(libc->debug_identifier().empty());
+}
+
+TEST_F(ElfCoreProcessorTest, WalksEveryThread) {
+  if (!CrashChild())
+    return;
+
+  BasicSourceLineResolver resolver;
+  StackFrameSymbolizer frame_symbolizer(NULL, &resolver);
+  ElfCoreProcessor processor(&frame_symbolizer);
+  scoped_ptr<ElfCore> core(ElfCore::Open(crash_generator_.GetCoreFilePath()));
+  ASSERT_TRUE(core.get());
+  ProcessState state;
+  ASSERT_EQ(google_breakpad::PROCESS_OK, processor.Process(core.get(), &state));
+
+  EXPECT_TRUE(state.crashed());
+  EXPECT_EQ("SIGABRT", state.crash_reason());
+  EXPECT_EQ(0, state.requesting_thread());
+  EXPECT_EQ("Linux", state.system_info()->os);
+  EXPECT_FALSE(state.system_info()->cpu.empty());
+  ASSERT_EQ(kNumThreads, state.threads()->size());
+  for (size_t i = 0; i < state.threads()->size(); ++i) {
+    EXPECT_FALSE(state.threads()->at(i)->frames()->empty());
+    EXPECT_TRUE(state.thread_memory_regions()->at(i));
+  }
+  ASSERT_TRUE(state.modules());
+  EXPECT_EQ(core->GetModules()->module_count(),
+            state.modules()->module_count());
+}
+
+TEST_F(ElfCoreProcessorTest, ProcessesCoreFilePath) {
+  if (!CrashChild())
+    return;
+
+  BasicSourceLineResolver resolver;
+  StackFrameSymbolizer frame_symbolizer(NULL, &resolver);
+  ElfCoreProcessor processor(&frame_symbolizer);
+  ProcessState state;
+  ASSERT_EQ(google_breakpad::PROCESS_OK,
+            processor.Process(crash_generator_.GetCoreFilePath(), &state));
+  ASSERT_EQ(kNumThreads, state.threads()->size());
+  // The core is gone, so its memory isn't handed out.
+  for (size_t i = 0; i < state.thread_memory_regions()->size(); ++i)
+    EXPECT_FALSE(state.thread_memory_regions()->at(i));
+}
+
+TEST(ElfCoreProcessorNoCrashTest, RejectsFilesThatArentCores) {
+  EXPECT_FALSE(ElfCore::Open("/nonexistent/core"));
+  // An executable is an ELF file, but not a core file.
+  EXPECT_FALSE(ElfCore::Open("/proc/self/exe"));
+
+  BasicSourceLineResolver resolver;
+  StackFrameSymbolizer frame_symbolizer(NULL, &resolver);
+  ElfCoreProcessor processor(&frame_symbolizer);
+  ProcessState state;
+  EXPECT_EQ(google_breakpad::PROCESS_ERROR_MINIDUMP_NOT_FOUND,
+            processor.Process("/nonexistent/core", &state));
+}
+
+TEST(ElfCoreProcessorNoCrashTest, NamesSignals) {
+  EXPECT_EQ("SIGSEGV", ElfCoreProcessor::GetCrashReason(SIGSEGV));
+  EXPECT_EQ("SIGABRT", ElfCoreProcessor::GetCrashReason(SIGABRT));
+  EXPECT_EQ("0x00000040", ElfCoreProcessor::GetCrashReason(64));
+}
+
+}  // namespace
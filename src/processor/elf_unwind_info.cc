@@ -0,0 +1,529 @@
+// Copyright (c) 2016 Google Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+// notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above
+// copyright notice, this list of conditions and the following disclaimer
+// in the documentation and/or other materials provided with the
+// distribution.
+//     * Neither the name of Google Inc. nor the names of its
+// contributors may be used to endorse or promote products derived from
+// this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+// elf_unwind_info.cc: Finds CFI rules in an ELF binary's .eh_frame.
+//
+// See elf_unwind_info.h for documentation.
+
+#include "processor/elf_unwind_info.h"
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#ifndef _WIN32
+#include <sys/mman.h>
+#include <unistd.h>
+#endif  // _WIN32
+
+#include <limits>
+
+#include "common/dwarf/bytereader-inl.h"
+#include "common/dwarf/bytereader.h"
+#include "common/dwarf/dwarf2reader.h"
+#include "common/dwarf_cfi_to_module.h"
+#include "common/module.h"
+#include "common/scoped_ptr.h"
+#include "processor/cfi_frame_info.h"
+#include "processor/logging.h"
+
+namespace google_breakpad {
+
+namespace {
+
+using dwarf2reader::ByteReader;
+using dwarf2reader::DwarfPointerEncoding;
+
+// The parts of the ELF format that are read, from the System V ABI.
+const char kElfMagic[4] = { 0x7f, 'E', 'L', 'F' };
+const int kElfClassOffset = 4;
+const int kElfDataOffset = 5;
+const uint8_t kElfClass32 = 1;
+const uint8_t kElfClass64 = 2;
+const uint8_t kElfDataLittleEndian = 1;
+const uint8_t kElfDataBigEndian = 2;
+
+const uint32_t kProgramHeaderLoad = 1;
+const uint32_t kProgramHeaderNote = 4;
+const uint32_t kProgramHeaderGnuEhFrame = 0x6474e550;
+
+const uint32_t kNoteGnuBuildId = 3;
+
+const uint16_t kMachine386 = 3;
+const uint16_t kMachineMips = 8;
+const uint16_t kMachineArm = 40;
+const uint16_t kMachineX86_64 = 62;
+const uint16_t kMachineAarch64 = 183;
+
+// Tells the processor's logs, rather than stderr, about the rules that
+// can't be expressed as Breakpad postfix expressions.  Those are common:
+// the PLT's rules are DWARF expressions, and the outermost frames mark
+// the return address undefined.
+class LoggingReporter : public DwarfCFIToModule::Reporter {
+ public:
+  explicit LoggingReporter(const string &file)
+      : DwarfCFIToModule::Reporter(file, ".eh_frame") {}
+
+  virtual void UnnamedRegister(size_t offset, int reg) {
+    BPLOG(INFO) << file_ << ": the FDE at offset " << offset
+                << " uses unnamed register " << reg;
+  }
+
+  virtual void UndefinedNotSupported(size_t offset, const string &reg) {
+    BPLOG(INFO) << file_ << ": the FDE at offset " << offset
+                << " makes " << reg << " undefined";
+  }
+
+  virtual void ExpressionsNotSupported(size_t offset, const string &reg) {
+    BPLOG(INFO) << file_ << ": the FDE at offset " << offset
+                << " recovers " << reg << " with a DWARF expression";
+  }
+};
+
+// Returns the size of a pointer with |encoding|, or 0 if it doesn't have
+// a fixed size, as the fields of the .eh_frame_hdr table must.
+size_t FixedEncodingSize(uint8_t encoding, uint8_t address_size) {
+  if (encoding & dwarf2reader::DW_EH_PE_indirect ||
+      encoding == dwarf2reader::DW_EH_PE_aligned) {
+    return 0;
+  }
+  switch (encoding & 0x0f) {
+    case dwarf2reader::DW_EH_PE_absptr:
+      return address_size;
+    case dwarf2reader::DW_EH_PE_udata2:
+    case dwarf2reader::DW_EH_PE_sdata2:
+      return 2;
+    case dwarf2reader::DW_EH_PE_udata4:
+    case dwarf2reader::DW_EH_PE_sdata4:
+      return 4;
+    case dwarf2reader::DW_EH_PE_udata8:
+    case dwarf2reader::DW_EH_PE_sdata8:
+      return 8;
+    default:
+      return 0;
+  }
+}
+
+// Reads a pointer with |encoding| at |*cursor|, which is before |end|,
+// into |*value|, and advances |*cursor| past it.
+bool ReadFixedPointer(const ByteReader &reader, uint8_t encoding,
+                      const char **cursor, const char *end,
+                      uint64_t *value) {
+  DwarfPointerEncoding pointer_encoding =
+      static_cast<DwarfPointerEncoding>(encoding);
+  size_t size = FixedEncodingSize(encoding, reader.AddressSize());
+  if (size == 0 || !reader.ValidEncoding(pointer_encoding) ||
+      !reader.UsableEncoding(pointer_encoding) ||
+      static_cast<size_t>(end - *cursor) < size) {
+    return false;
+  }
+  size_t length;
+  *value = reader.ReadEncodedPointer(*cursor, pointer_encoding, &length);
+  *cursor += length;
+  return true;
+}
+
+// Adds the rules in |rule_map| to |frame_info|.
+void AddRules(const Module::RuleMap &rule_map, CFIFrameInfo *frame_info) {
+  for (Module::RuleMap::const_iterator rule = rule_map.begin();
+       rule != rule_map.end(); ++rule) {
+    if (rule->first == ".cfa")
+      frame_info->SetCFARule(rule->second);
+    else if (rule->first == ".ra")
+      frame_info->SetRARule(rule->second);
+    else
+      frame_info->SetRegisterRule(rule->first, rule->second);
+  }
+}
+
+}  // namespace
+
+// static
+ElfUnwindInfo *ElfUnwindInfo::Open(const string &path) {
+#ifdef _WIN32
+  return NULL;
+#else  // _WIN32
+  int fd = open(path.c_str(), O_RDONLY);
+  if (fd == -1) {
+    string error_string;
+    int error_code = ErrnoString(&error_string);
+    BPLOG(ERROR) << "Could not open binary " << path <<
+        ", error " << error_code << ": " << error_string;
+    return NULL;
+  }
+
+  struct stat st;
+  if (fstat(fd, &st) == -1 || st.st_size == 0 ||
+      static_cast<uint64_t>(st.st_size) > std::numeric_limits<size_t>::max()) {
+    BPLOG(ERROR) << "Binary " << path << " has a bad size";
+    close(fd);
+    return NULL;
+  }
+
+  size_t size = static_cast<size_t>(st.st_size);
+  void *data = mmap(NULL, size, PROT_READ, MAP_SHARED, fd, 0);
+  if (data == MAP_FAILED) {
+    string error_string;
+    int error_code = ErrnoString(&error_string);
+    BPLOG(ERROR) << "Could not map binary " << path <<
+        ", error " << error_code << ": " << error_string;
+    close(fd);
+    return NULL;
+  }
+
+  scoped_ptr<ElfUnwindInfo> unwind_info(
+      new ElfUnwindInfo(path, fd, static_cast<const char*>(data), size));
+  if (!unwind_info->ReadHeaders()) {
+    BPLOG(ERROR) << path << " is not an ELF binary with usable unwind tables";
+    return NULL;
+  }
+  return unwind_info.release();
+#endif  // _WIN32
+}
+
+ElfUnwindInfo::ElfUnwindInfo(const string &path, int fd, const char *base,
+                             size_t size)
+    : path_(path),
+      fd_(fd),
+      base_(base),
+      size_(size),
+      big_endian_(false),
+      address_size_(0),
+      load_address_(0),
+      eh_frame_hdr_address_(0),
+      eh_frame_hdr_(NULL),
+      table_(NULL),
+      fde_count_(0),
+      table_encoding_(0),
+      table_field_size_(0),
+      eh_frame_address_(0),
+      eh_frame_(NULL),
+      eh_frame_size_(0) {
+}
+
+ElfUnwindInfo::~ElfUnwindInfo() {
+#ifndef _WIN32
+  munmap(const_cast<char*>(base_), size_);
+  close(fd_);
+#endif  // _WIN32
+}
+
+bool ElfUnwindInfo::ReadHeaders() {
+  if (size_ < 52 || memcmp(base_, kElfMagic, sizeof(kElfMagic)) != 0)
+    return false;
+  uint8_t elf_class = base_[kElfClassOffset];
+  uint8_t elf_data = base_[kElfDataOffset];
+  if ((elf_class != kElfClass32 && elf_class != kElfClass64) ||
+      (elf_data != kElfDataLittleEndian && elf_data != kElfDataBigEndian)) {
+    return false;
+  }
+  bool elf64 = elf_class == kElfClass64;
+  if (elf64 && size_ < 64)
+    return false;
+  big_endian_ = elf_data == kElfDataBigEndian;
+  address_size_ = elf64 ? 8 : 4;
+  ByteReader reader(big_endian_ ? dwarf2reader::ENDIANNESS_BIG :
+                                  dwarf2reader::ENDIANNESS_LITTLE);
+  reader.SetAddressSize(address_size_);
+
+  switch (reader.ReadTwoBytes(base_ + 18)) {
+    case kMachine386:
+      register_names_ = DwarfCFIToModule::RegisterNames::I386();
+      break;
+    case kMachineMips:
+      register_names_ = DwarfCFIToModule::RegisterNames::MIPS();
+      break;
+    case kMachineArm:
+      register_names_ = DwarfCFIToModule::RegisterNames::ARM();
+      break;
+    case kMachineX86_64:
+      register_names_ = DwarfCFIToModule::RegisterNames::X86_64();
+      break;
+    case kMachineAarch64:
+      register_names_ = DwarfCFIToModule::RegisterNames::ARM64();
+      break;
+    default:
+      return false;
+  }
+
+  uint64_t header_offset = elf64 ? reader.ReadEightBytes(base_ + 32) :
+                                   reader.ReadFourBytes(base_ + 28);
+  uint16_t header_size = reader.ReadTwoBytes(base_ + (elf64 ? 54 : 42));
+  uint16_t header_count = reader.ReadTwoBytes(base_ + (elf64 ? 56 : 44));
+  if (header_size < (elf64 ? 56 : 32) || header_offset > size_ ||
+      header_count > (size_ - header_offset) / header_size) {
+    return false;
+  }
+
+  uint64_t eh_frame_hdr_address = 0;
+  bool has_eh_frame_hdr = false;
+  for (uint16_t i = 0; i < header_count; ++i) {
+    const char *header = base_ + header_offset + i * header_size;
+    uint32_t type = reader.ReadFourBytes(header);
+    uint64_t offset, address, file_size, alignment;
+    if (elf64) {
+      offset = reader.ReadEightBytes(header + 8);
+      address = reader.ReadEightBytes(header + 16);
+      file_size = reader.ReadEightBytes(header + 32);
+      alignment = reader.ReadEightBytes(header + 48);
+    } else {
+      offset = reader.ReadFourBytes(header + 4);
+      address = reader.ReadFourBytes(header + 8);
+      file_size = reader.ReadFourBytes(header + 16);
+      alignment = reader.ReadFourBytes(header + 28);
+    }
+
+    if (type == kProgramHeaderLoad) {
+      if (segments_.empty())
+        load_address_ = address - offset;
+      Segment segment = { address, offset, file_size };
+      segments_.push_back(segment);
+    } else if (type == kProgramHeaderNote) {
+      ReadBuildId(offset, file_size, alignment);
+    } else if (type == kProgramHeaderGnuEhFrame) {
+      eh_frame_hdr_address = address;
+      has_eh_frame_hdr = true;
+    }
+  }
+
+  return has_eh_frame_hdr && ReadEhFrameHeader(eh_frame_hdr_address);
+}
+
+bool ElfUnwindInfo::ReadEhFrameHeader(uint64_t address) {
+  const char *header;
+  size_t available;
+  if (!DataAt(address, &header, &available) || available < 4)
+    return false;
+  // The version, then the encodings of the pointer to .eh_frame, the FDE
+  // count and the table's fields.
+  if (header[0] != 1)
+    return false;
+  uint8_t eh_frame_encoding = header[1];
+  uint8_t count_encoding = header[2];
+  uint8_t table_encoding = header[3];
+
+  ByteReader reader(big_endian_ ? dwarf2reader::ENDIANNESS_BIG :
+                                  dwarf2reader::ENDIANNESS_LITTLE);
+  reader.SetAddressSize(address_size_);
+  reader.SetCFIDataBase(address, header);
+  reader.SetDataBase(address);
+
+  const char *cursor = header + 4;
+  const char *end = header + available;
+  uint64_t eh_frame_address, count;
+  if (!ReadFixedPointer(reader, eh_frame_encoding, &cursor, end,
+                        &eh_frame_address) ||
+      !ReadFixedPointer(reader, count_encoding, &cursor, end, &count)) {
+    return false;
+  }
+  size_t field_size = FixedEncodingSize(table_encoding, address_size_);
+  if (field_size == 0 ||
+      !reader.UsableEncoding(
+          static_cast<DwarfPointerEncoding>(table_encoding)) ||
+      count > static_cast<size_t>(end - cursor) / (2 * field_size)) {
+    return false;
+  }
+
+  eh_frame_hdr_address_ = address;
+  eh_frame_hdr_ = header;
+  table_ = cursor;
+  fde_count_ = count;
+  table_encoding_ = table_encoding;
+  table_field_size_ = field_size;
+  eh_frame_address_ = eh_frame_address;
+  return DataAt(eh_frame_address, &eh_frame_, &eh_frame_size_);
+}
+
+void ElfUnwindInfo::ReadBuildId(uint64_t offset, uint64_t size,
+                                uint64_t alignment) {
+  if (offset > size_ || size > size_ - offset)
+    return;
+  ByteReader reader(big_endian_ ? dwarf2reader::ENDIANNESS_BIG :
+                                  dwarf2reader::ENDIANNESS_LITTLE);
+  // Each note is its name and description sizes, its type, then the name
+  // and description, both padded to the segment's alignment.
+  uint64_t padding = alignment == 8 ? 8 : 4;
+  const char *note = base_ + offset;
+  const char *end = note + size;
+  while (end - note >= 12) {
+    uint64_t name_size = reader.ReadFourBytes(note);
+    uint64_t description_size = reader.ReadFourBytes(note + 4);
+    uint32_t type = reader.ReadFourBytes(note + 8);
+    uint64_t padded_name_size = (name_size + padding - 1) & ~(padding - 1);
+    uint64_t padded_description_size =
+        (description_size + padding - 1) & ~(padding - 1);
+    const char *name = note + 12;
+    if (padded_name_size > static_cast<uint64_t>(end - name) ||
+        padded_description_size >
+            static_cast<uint64_t>(end - name) - padded_name_size) {
+      return;
+    }
+    const char *description = name + padded_name_size;
+    if (type == kNoteGnuBuildId && name_size == 4 &&
+        memcmp(name, "GNU", 4) == 0 && description_size > 0) {
+      debug_identifier_ = DebugIdentifierForBuildId(description,
+                                                    description_size,
+                                                    big_endian_);
+      return;
+    }
+    note = description + padded_description_size;
+  }
+}
+
+// static
+string ElfUnwindInfo::DebugIdentifierForBuildId(const char *build_id,
+                                                size_t size,
+                                                bool big_endian) {
+  ByteReader reader(big_endian ? dwarf2reader::ENDIANNESS_BIG :
+                                 dwarf2reader::ENDIANNESS_LITTLE);
+  // The client copies the first 16 bytes of the build ID, padded with
+  // zeros, into a GUID, and writes it out like a PDB's signature with an
+  // age of 0.
+  char guid[16] = { 0 };
+  memcpy(guid, build_id, size < sizeof(guid) ? size : sizeof(guid));
+  char identifier[34];
+  snprintf(identifier, sizeof(identifier),
+           "%08X%04X%04X%02X%02X%02X%02X%02X%02X%02X%02X0",
+           static_cast<unsigned int>(reader.ReadFourBytes(guid)),
+           reader.ReadTwoBytes(guid + 4),
+           reader.ReadTwoBytes(guid + 6),
+           static_cast<uint8_t>(guid[8]), static_cast<uint8_t>(guid[9]),
+           static_cast<uint8_t>(guid[10]), static_cast<uint8_t>(guid[11]),
+           static_cast<uint8_t>(guid[12]), static_cast<uint8_t>(guid[13]),
+           static_cast<uint8_t>(guid[14]), static_cast<uint8_t>(guid[15]));
+  return identifier;
+}
+
+bool ElfUnwindInfo::DataAt(uint64_t address, const char **data,
+                           size_t *available) const {
+  for (size_t i = 0; i < segments_.size(); ++i) {
+    const Segment &segment = segments_[i];
+    if (address < segment.address ||
+        address - segment.address >= segment.file_size) {
+      continue;
+    }
+    uint64_t offset = segment.offset + (address - segment.address);
+    if (offset >= size_)
+      return false;
+    uint64_t in_segment = segment.file_size - (address - segment.address);
+    uint64_t in_file = size_ - offset;
+    *data = base_ + offset;
+    *available = in_segment < in_file ? in_segment : in_file;
+    return true;
+  }
+  return false;
+}
+
+bool ElfUnwindInfo::FindFDE(uint64_t address, uint64_t *fde_address) const {
+  ByteReader reader(big_endian_ ? dwarf2reader::ENDIANNESS_BIG :
+                                  dwarf2reader::ENDIANNESS_LITTLE);
+  reader.SetAddressSize(address_size_);
+  reader.SetCFIDataBase(eh_frame_hdr_address_, eh_frame_hdr_);
+  reader.SetDataBase(eh_frame_hdr_address_);
+  DwarfPointerEncoding encoding =
+      static_cast<DwarfPointerEncoding>(table_encoding_);
+  size_t entry_size = 2 * table_field_size_;
+  size_t length;
+
+  // Find the last entry whose initial location is at or before |address|.
+  size_t low = 0, high = fde_count_;
+  while (low < high) {
+    size_t middle = low + (high - low) / 2;
+    uint64_t initial_location =
+        reader.ReadEncodedPointer(table_ + middle * entry_size, encoding,
+                                  &length);
+    if (initial_location <= address)
+      low = middle + 1;
+    else
+      high = middle;
+  }
+  if (low == 0)
+    return false;
+  *fde_address = reader.ReadEncodedPointer(
+      table_ + (low - 1) * entry_size + table_field_size_, encoding, &length);
+  return true;
+}
+
+CFIFrameInfo *ElfUnwindInfo::FindCFIFrameInfo(uint64_t module_address) const {
+  uint64_t address = load_address_ + module_address;
+  uint64_t fde_address;
+  if (!FindFDE(address, &fde_address) || fde_address < eh_frame_address_ ||
+      fde_address - eh_frame_address_ >= eh_frame_size_) {
+    return NULL;
+  }
+
+  // Find the end of the FDE from its length, so that only it is parsed.
+  ByteReader reader(big_endian_ ? dwarf2reader::ENDIANNESS_BIG :
+                                  dwarf2reader::ENDIANNESS_LITTLE);
+  reader.SetAddressSize(address_size_);
+  reader.SetCFIDataBase(eh_frame_address_, eh_frame_);
+  size_t fde_offset = fde_address - eh_frame_address_;
+  size_t available = eh_frame_size_ - fde_offset;
+  if (available < 4)
+    return NULL;
+  uint64_t length = reader.ReadFourBytes(eh_frame_ + fde_offset);
+  size_t length_size = 4;
+  if (length == 0xffffffff) {
+    if (available < 12)
+      return NULL;
+    length = reader.ReadEightBytes(eh_frame_ + fde_offset + 4);
+    length_size = 12;
+  }
+  if (length == 0 || length > available - length_size)
+    return NULL;
+
+  Module module(path_, "", "", "");
+  LoggingReporter module_reporter(path_);
+  DwarfCFIToModule handler(&module, register_names_, &module_reporter);
+  dwarf2reader::CallFrameInfo::Reporter dwarf_reporter(path_, ".eh_frame");
+  dwarf2reader::CallFrameInfo parser(eh_frame_, eh_frame_size_, &reader,
+                                     &handler, &dwarf_reporter, true);
+  parser.StartRange(fde_offset, fde_offset + length_size + length);
+
+  std::vector<Module::StackFrameEntry*> entries;
+  module.GetStackFrameEntries(&entries);
+  for (size_t i = 0; i < entries.size(); ++i) {
+    const Module::StackFrameEntry *entry = entries[i];
+    if (address < entry->address || address - entry->address >= entry->size)
+      continue;
+    scoped_ptr<CFIFrameInfo> rules(new CFIFrameInfo);
+    AddRules(entry->initial_rules, rules.get());
+    for (Module::RuleChangeMap::const_iterator change =
+             entry->rule_changes.begin();
+         change != entry->rule_changes.end() && change->first <= address;
+         ++change) {
+      AddRules(change->second, rules.get());
+    }
+    return rules.release();
+  }
+  return NULL;
+}
+
+}  // namespace google_breakpad
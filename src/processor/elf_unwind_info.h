@@ -0,0 +1,156 @@
+// Copyright (c) 2016 Google Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+// notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above
+// copyright notice, this list of conditions and the following disclaimer
+// in the documentation and/or other materials provided with the
+// distribution.
+//     * Neither the name of Google Inc. nor the names of its
+// contributors may be used to endorse or promote products derived from
+// this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+// elf_unwind_info.h: ElfUnwindInfo, which finds the CFI rules for an
+// address in the unwind tables of an ELF binary itself.
+//
+// dump_syms converts all of a module's CFI into its symbol file up front.
+// When a module has no symbol file but its binary is at hand, its CFI can
+// still be used: ELF binaries carry .eh_frame for C++ exception handling,
+// along with .eh_frame_hdr, which holds a table of its FDEs sorted by
+// address and is found through the PT_GNU_EH_FRAME program header.  An
+// ElfUnwindInfo maps the binary, finds the FDE covering an address in
+// that table, and parses just that FDE and its CIE, with the same
+// dwarf2reader::CallFrameInfo and DwarfCFIToModule that dump_syms uses.
+// Only program headers are read, so stripped binaries work too.
+//
+// Binaries are read by mapping them into memory, which isn't supported on
+// Windows.
+
+#ifndef PROCESSOR_ELF_UNWIND_INFO_H__
+#define PROCESSOR_ELF_UNWIND_INFO_H__
+
+#include <stddef.h>
+
+#include <string>
+#include <vector>
+
+#include "common/using_std_string.h"
+#include "google_breakpad/common/breakpad_types.h"
+
+namespace google_breakpad {
+
+class CFIFrameInfo;
+
+class ElfUnwindInfo {
+ public:
+  // Maps the ELF file at |path| and reads its program headers.  Returns
+  // NULL if the file can't be mapped, or isn't an ELF file for a CPU the
+  // stack walkers support, or has no usable .eh_frame_hdr.
+  static ElfUnwindInfo *Open(const string &path);
+
+  ~ElfUnwindInfo();
+
+  // Returns the CFI rules for the instruction at |module_address|, an
+  // offset from the address the binary's first byte is loaded at, as
+  // CodeModule::base_address gives it.  Returns NULL if no FDE covers the
+  // address.  The caller owns the result.
+  CFIFrameInfo *FindCFIFrameInfo(uint64_t module_address) const;
+
+  // The identifier that the Linux client records as the debug identifier
+  // of modules built from this binary, made from its build ID.  Empty if
+  // the binary has no build ID note.
+  const string &debug_identifier() const { return debug_identifier_; }
+
+  // Returns the debug identifier the Linux client records for a module
+  // with the |size|-byte GNU build ID at |build_id|, as stored in a file
+  // of the given byte order.
+  static string DebugIdentifierForBuildId(const char *build_id, size_t size,
+                                          bool big_endian);
+
+  // The number of FDEs in the .eh_frame_hdr table.
+  size_t fde_count() const { return fde_count_; }
+
+ private:
+  // A PT_LOAD segment.
+  struct Segment {
+    uint64_t address;
+    uint64_t offset;
+    uint64_t file_size;
+  };
+
+  ElfUnwindInfo(const string &path, int fd, const char *base, size_t size);
+
+  // Reads the ELF and program headers and finds the tables.  Returns false
+  // if they are malformed or missing.
+  bool ReadHeaders();
+
+  // Reads the .eh_frame_hdr at |address|.
+  bool ReadEhFrameHeader(uint64_t address);
+
+  // Sets debug_identifier_ from the build ID note in the PT_NOTE segment
+  // at |offset|, if it has one.
+  void ReadBuildId(uint64_t offset, uint64_t size, uint64_t alignment);
+
+  // Sets |*data| to the bytes at |address| as loaded, and |*available| to
+  // how many of them the file holds.  Returns false if no segment maps the
+  // address to the file.
+  bool DataAt(uint64_t address, const char **data, size_t *available) const;
+
+  // Returns the address of the FDE for the instruction at |address|, from
+  // the .eh_frame_hdr table.
+  bool FindFDE(uint64_t address, uint64_t *fde_address) const;
+
+  string path_;
+  int fd_;
+  const char *base_;
+  size_t size_;
+
+  bool big_endian_;
+  uint8_t address_size_;
+  std::vector<string> register_names_;
+  std::vector<Segment> segments_;
+
+  // The address that the first byte of the file is loaded at.
+  uint64_t load_address_;
+
+  // The .eh_frame_hdr table, which holds fde_count_ pairs of an initial
+  // location and an FDE address, each encoded with table_encoding_.
+  uint64_t eh_frame_hdr_address_;
+  const char *eh_frame_hdr_;
+  const char *table_;
+  size_t fde_count_;
+  uint8_t table_encoding_;
+  size_t table_field_size_;
+
+  // .eh_frame, which runs to the end of the data of its segment.
+  uint64_t eh_frame_address_;
+  const char *eh_frame_;
+  size_t eh_frame_size_;
+
+  string debug_identifier_;
+
+  // Disallow copy constructor and assignment operator.
+  ElfUnwindInfo(const ElfUnwindInfo&);
+  void operator=(const ElfUnwindInfo&);
+};
+
+}  // namespace google_breakpad
+
+#endif  // PROCESSOR_ELF_UNWIND_INFO_H__
@@ -0,0 +1,331 @@
+// Copyright (c) 2016 Google Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+// notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above
+// copyright notice, this list of conditions and the following disclaimer
+// in the documentation and/or other materials provided with the
+// distribution.
+//     * Neither the name of Google Inc. nor the names of its
+// contributors may be used to endorse or promote products derived from
+// this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+// elf_unwind_info_unittest.cc: Unit tests for ElfUnwindInfo, and for
+// StackFrameSymbolizer's use of it when a module has no symbols.
+
+#include <stdio.h>
+#include <sys/stat.h>
+
+#include <string>
+
+#include "breakpad_googletest_includes.h"
+#include "common/scoped_ptr.h"
+#include "common/test_assembler.h"
+#include "common/tests/auto_tempdir.h"
+#include "common/using_std_string.h"
+#include "google_breakpad/processor/basic_source_line_resolver.h"
+#include "google_breakpad/processor/stack_frame.h"
+#include "google_breakpad/processor/stack_frame_symbolizer.h"
+#include "processor/basic_code_module.h"
+#include "processor/cfi_frame_info.h"
+#include "processor/elf_unwind_info.h"
+#include "processor/simple_symbol_supplier.h"
+
+namespace {
+
+using google_breakpad::AutoTempDir;
+using google_breakpad::BasicCodeModule;
+using google_breakpad::BasicSourceLineResolver;
+using google_breakpad::CFIFrameInfo;
+using google_breakpad::ElfUnwindInfo;
+using google_breakpad::SimpleSymbolSupplier;
+using google_breakpad::StackFrame;
+using google_breakpad::StackFrameSymbolizer;
+using google_breakpad::scoped_ptr;
+using google_breakpad::test_assembler::Label;
+using google_breakpad::test_assembler::Section;
+using google_breakpad::test_assembler::kLittleEndian;
+
+// The test binary is loaded at kLoadAddress, and holds the headers, a
+// build ID note, .eh_frame_hdr and .eh_frame at these offsets.  The two
+// functions it describes are past the end of the file.
+const uint64_t kLoadAddress = 0x400000;
+const uint64_t kNoteOffset = 0x100;
+const uint64_t kEhFrameHdrOffset = 0x200;
+const uint64_t kEhFrameOffset = 0x300;
+const uint64_t kFunction1 = 0x401000;
+const uint64_t kFunction1Size = 0x20;
+const uint64_t kFunction2 = 0x401020;
+const uint64_t kFunction2Size = 0x40;
+
+const char kDebugIdentifier[] = "0403020106050807090A0B0C0D0E0F100";
+
+// Pads |section| with zeros up to |offset|.
+void PadTo(Section *section, uint64_t offset) {
+  ASSERT_LE(section->Size(), offset);
+  section->Append(offset - section->Size(), 0);
+}
+
+// Appends the 32-bit offset from the current position to |address|, for
+// DW_EH_PE_pcrel pointers.
+void PCRelative(Section *section, uint64_t address) {
+  section->D32(address - section->Here().Value());
+}
+
+// Appends an .eh_frame FDE for the function at |address|, with
+// |instructions|, using the CIE at |cie|.
+void AppendFDE(Section *section, const Label &cie, uint64_t address,
+               uint64_t size, const string &instructions) {
+  Label length, start;
+  section->D32(length).Mark(&start);
+  section->D32(section->Here().Value() - cie.Value());
+  PCRelative(section, address);
+  section->D32(size)
+      .ULEB128(0)  // augmentation data length
+      .Append(instructions);
+  // Entries are padded with DW_CFA_nop to the address size.
+  section->Append((8 - (section->Size() % 8)) % 8, 0);
+  length = section->Here() - start;
+}
+
+// Builds a little-endian x86-64 ELF binary with a build ID and unwind
+// tables for two functions.  If |with_eh_frame_hdr| is false, the
+// PT_GNU_EH_FRAME header is left out.
+string BuildBinary(bool with_eh_frame_hdr) {
+  Section elf(kLittleEndian);
+  elf.start() = kLoadAddress;
+  Label file_size;
+  int header_count = with_eh_frame_hdr ? 3 : 2;
+
+  // The ELF header.
+  elf.Append(string("\x7f" "ELF", 4))
+      .D8(2)   // ELFCLASS64
+      .D8(1)   // ELFDATA2LSB
+      .D8(1);  // EV_CURRENT
+  PadTo(&elf, 16);
+  elf.D16(3)   // ET_DYN
+      .D16(62)  // EM_X86_64
+      .D32(1)
+      .D64(0)   // e_entry
+      .D64(64)  // e_phoff
+      .D64(0)   // e_shoff
+      .D32(0)
+      .D16(64)  // e_ehsize
+      .D16(56)  // e_phentsize
+      .D16(header_count)
+      .D16(64)  // e_shentsize
+      .D16(0)
+      .D16(0);
+
+  // The program headers: type, flags, offset, address, physical address,
+  // file size, memory size and alignment.
+  elf.D32(1).D32(5).D64(0).D64(kLoadAddress).D64(kLoadAddress)
+      .D64(file_size).D64(0x2000).D64(0x1000);
+  elf.D32(4).D32(4).D64(kNoteOffset).D64(kLoadAddress + kNoteOffset)
+      .D64(0).D64(36).D64(36).D64(4);
+  if (with_eh_frame_hdr) {
+    elf.D32(0x6474e550).D32(4)
+        .D64(kEhFrameHdrOffset).D64(kLoadAddress + kEhFrameHdrOffset)
+        .D64(0).D64(0x28).D64(0x28).D64(4);
+  }
+
+  // A GNU build ID note.
+  PadTo(&elf, kNoteOffset);
+  elf.D32(4).D32(20).D32(3).Append(string("GNU", 4));
+  for (int i = 1; i <= 20; ++i)
+    elf.D8(i);
+
+  // .eh_frame_hdr, with a pc-relative pointer to .eh_frame, and a table
+  // of offsets from itself.
+  const uint64_t hdr = kLoadAddress + kEhFrameHdrOffset;
+  Label fde1, fde2;
+  PadTo(&elf, kEhFrameHdrOffset);
+  elf.D8(1)      // version
+      .D8(0x1b)  // DW_EH_PE_pcrel | DW_EH_PE_sdata4
+      .D8(0x03)  // DW_EH_PE_udata4
+      .D8(0x3b);  // DW_EH_PE_datarel | DW_EH_PE_sdata4
+  PCRelative(&elf, kLoadAddress + kEhFrameOffset);
+  elf.D32(2)
+      .D32(kFunction1 - hdr).D32(fde1 - hdr)
+      .D32(kFunction2 - hdr).D32(fde2 - hdr);
+
+  // .eh_frame: a CIE whose FDEs use pc-relative pointers, which starts
+  // with the CFA at $rsp + 8 and the return address just below it.
+  PadTo(&elf, kEhFrameOffset);
+  Label cie, cie_length, cie_start;
+  elf.Mark(&cie).D32(cie_length).Mark(&cie_start)
+      .D32(0)    // CIE id
+      .D8(1)     // version
+      .Append(string("zR", 3))
+      .ULEB128(1)      // code alignment factor
+      .LEB128(-8)      // data alignment factor
+      .D8(16)          // return address register: $rip
+      .ULEB128(1)      // augmentation data length
+      .D8(0x1b)        // FDE pointer encoding
+      .Append(string("\x0c\x07\x08"  // DW_CFA_def_cfa: $rsp + 8
+                     "\x90\x01", 5));  // DW_CFA_offset: $rip at cfa - 8
+  elf.Append((8 - (elf.Size() % 8)) % 8, 0);
+  cie_length = elf.Here() - cie_start;
+
+  // The first function pushes $rbp in its first byte, the second grows
+  // the stack by 24 bytes in its first two.
+  elf.Mark(&fde1);
+  AppendFDE(&elf, cie, kFunction1, kFunction1Size,
+            string("\x41"          // DW_CFA_advance_loc: 1
+                   "\x0e\x10"      // DW_CFA_def_cfa_offset: 16
+                   "\x86\x02", 5));  // DW_CFA_offset: $rbp at cfa - 16
+  elf.Mark(&fde2);
+  AppendFDE(&elf, cie, kFunction2, kFunction2Size,
+            string("\x42"        // DW_CFA_advance_loc: 2
+                   "\x0e\x20", 3));  // DW_CFA_def_cfa_offset: 32
+  elf.D32(0);  // terminator
+  file_size = elf.Size();
+
+  string contents;
+  EXPECT_TRUE(elf.GetContents(&contents));
+  return contents;
+}
+
+bool WriteFile(const string &path, const string &contents) {
+  FILE *file = fopen(path.c_str(), "wb");
+  if (!file)
+    return false;
+  bool written =
+      fwrite(contents.data(), 1, contents.size(), file) == contents.size();
+  return fclose(file) == 0 && written;
+}
+
+string Rules(ElfUnwindInfo *unwind_info, uint64_t address) {
+  scoped_ptr<CFIFrameInfo> rules(
+      unwind_info->FindCFIFrameInfo(address - kLoadAddress));
+  return rules.get() ? rules->Serialize() : "<none>";
+}
+
+class ElfUnwindInfoTest : public ::testing::Test {
+ public:
+  void SetUp() {
+    binary_path_ = temp_dir_.path() + "/libtest.so";
+    ASSERT_TRUE(WriteFile(binary_path_, BuildBinary(true)));
+  }
+
+  AutoTempDir temp_dir_;
+  string binary_path_;
+};
+
+TEST_F(ElfUnwindInfoTest, ReadsHeaders) {
+  scoped_ptr<ElfUnwindInfo> unwind_info(ElfUnwindInfo::Open(binary_path_));
+  ASSERT_TRUE(unwind_info.get());
+  EXPECT_EQ(2U, unwind_info->fde_count());
+  EXPECT_EQ(kDebugIdentifier, unwind_info->debug_identifier());
+}
+
+TEST_F(ElfUnwindInfoTest, FindsRulesForEachAddress) {
+  scoped_ptr<ElfUnwindInfo> unwind_info(ElfUnwindInfo::Open(binary_path_));
+  ASSERT_TRUE(unwind_info.get());
+
+  EXPECT_EQ(".cfa: $rsp 8 + .ra: .cfa -8 + ^",
+            Rules(unwind_info.get(), kFunction1));
+  EXPECT_EQ(".cfa: $rsp 16 + .ra: .cfa -8 + ^ $rbp: .cfa -16 + ^",
+            Rules(unwind_info.get(), kFunction1 + 1));
+  EXPECT_EQ(".cfa: $rsp 16 + .ra: .cfa -8 + ^ $rbp: .cfa -16 + ^",
+            Rules(unwind_info.get(), kFunction1 + kFunction1Size - 1));
+  EXPECT_EQ(".cfa: $rsp 8 + .ra: .cfa -8 + ^",
+            Rules(unwind_info.get(), kFunction2 + 1));
+  EXPECT_EQ(".cfa: $rsp 32 + .ra: .cfa -8 + ^",
+            Rules(unwind_info.get(), kFunction2 + 2));
+}
+
+TEST_F(ElfUnwindInfoTest, NoRulesOutsideFunctions) {
+  scoped_ptr<ElfUnwindInfo> unwind_info(ElfUnwindInfo::Open(binary_path_));
+  ASSERT_TRUE(unwind_info.get());
+
+  EXPECT_EQ("<none>", Rules(unwind_info.get(), kFunction1 - 1));
+  EXPECT_EQ("<none>",
+            Rules(unwind_info.get(), kFunction2 + kFunction2Size));
+  EXPECT_EQ("<none>", Rules(unwind_info.get(), kLoadAddress));
+}
+
+TEST_F(ElfUnwindInfoTest, RejectsBinariesWithoutTables) {
+  string path = temp_dir_.path() + "/libnohdr.so";
+  ASSERT_TRUE(WriteFile(path, BuildBinary(false)));
+  EXPECT_FALSE(ElfUnwindInfo::Open(path));
+
+  string not_elf = temp_dir_.path() + "/libtest.sym";
+  ASSERT_TRUE(WriteFile(not_elf, "MODULE Linux x86_64 0 libtest.so\n"));
+  EXPECT_FALSE(ElfUnwindInfo::Open(not_elf));
+
+  EXPECT_FALSE(ElfUnwindInfo::Open(temp_dir_.path() + "/missing.so"));
+}
+
+class SymbolizerFallbackTest : public ::testing::Test {
+ public:
+  void SetUp() {
+    // SimpleSymbolSupplier finds binaries where it would find their
+    // symbol files, without the .sym extension.
+    string directory = temp_dir_.path() + "/libtest.so";
+    ASSERT_EQ(0, mkdir(directory.c_str(), 0755));
+    directory += string("/") + kDebugIdentifier;
+    ASSERT_EQ(0, mkdir(directory.c_str(), 0755));
+    ASSERT_TRUE(WriteFile(directory + "/libtest.so", BuildBinary(true)));
+  }
+
+  AutoTempDir temp_dir_;
+};
+
+TEST_F(SymbolizerFallbackTest, UsesBinaryWithoutSymbols) {
+  SimpleSymbolSupplier supplier(temp_dir_.path());
+  BasicSourceLineResolver resolver;
+  StackFrameSymbolizer symbolizer(&supplier, &resolver);
+
+  const uint64_t base = 0x7f0000000000ULL;
+  BasicCodeModule module(base, 0x2000, "/lib/libtest.so", "",
+                         "libtest.so", kDebugIdentifier, "");
+  StackFrame frame;
+  frame.module = &module;
+  frame.instruction = base + (kFunction1 + 1 - kLoadAddress);
+  scoped_ptr<CFIFrameInfo> rules(symbolizer.FindCFIFrameInfo(&frame));
+  ASSERT_TRUE(rules.get());
+  EXPECT_EQ(".cfa: $rsp 16 + .ra: .cfa -8 + ^ $rbp: .cfa -16 + ^",
+            rules->Serialize());
+}
+
+TEST_F(SymbolizerFallbackTest, IgnoresMismatchedBinary) {
+  SimpleSymbolSupplier supplier(temp_dir_.path());
+  BasicSourceLineResolver resolver;
+  StackFrameSymbolizer symbolizer(&supplier, &resolver);
+
+  // The supplier is asked for the binary by identifier, so put the test
+  // binary under another one to make it mismatch.
+  string other = "00000000000000000000000000000000";
+  string directory = temp_dir_.path() + "/libtest.so/" + other;
+  ASSERT_EQ(0, rename((temp_dir_.path() + "/libtest.so/" +
+                       kDebugIdentifier).c_str(),
+                      directory.c_str()));
+
+  const uint64_t base = 0x7f0000000000ULL;
+  BasicCodeModule module(base, 0x2000, "/lib/libtest.so", "",
+                         "libtest.so", other, "");
+  StackFrame frame;
+  frame.module = &module;
+  frame.instruction = base + (kFunction1 + 1 - kLoadAddress);
+  EXPECT_FALSE(symbolizer.FindCFIFrameInfo(&frame));
+}
+
+}  // namespace
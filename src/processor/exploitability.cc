@@ -49,7 +49,9 @@ namespace google_breakpad {
 Exploitability::Exploitability(Minidump *dump,
                                ProcessState *process_state)
     : dump_(dump),
-      process_state_(process_state) {}
+      process_state_(process_state),
+      analyze_instructions_(true),
+      instruction_analysis_cache_(NULL) {}
 
 ExploitabilityRating Exploitability::CheckExploitability() {
   return CheckPlatformExploitability();
@@ -36,9 +36,18 @@
 
 #include "processor/exploitability_linux.h"
 
+#include <stdlib.h>
+#include <string.h>
+
+#include <vector>
+
+#include "google_breakpad/common/minidump_exception_linux.h"
 #include "google_breakpad/processor/process_state.h"
 #include "google_breakpad/processor/call_stack.h"
+#include "google_breakpad/processor/minidump.h"
 #include "google_breakpad/processor/stack_frame.h"
+#include "processor/range_map-inl.h"
+#include "processor/tokenize.h"
 
 namespace {
 
@@ -51,36 +60,216 @@ const char kStackCheckFailureFunction[] = "__stack_chk_fail";
 // can determine that the call would overflow the target buffer.
 const char kBoundsCheckFailureFunction[] = "__chk_fail";
 
+// The cutoff that we use to judge if an address is likely an offset from
+// NULL.
+const uint64_t kProbableNullOffset = 4096;
+
+// The largest Linux maps stream read.  Even processes with tens of
+// thousands of mappings stay well below this.
+const uint32_t kMaxLinuxMapsLength = 16 * 1024 * 1024;
+
 }  // namespace
 
 namespace google_breakpad {
 
+using std::vector;
+
+bool MemoryPermissionIndex::AddMapping(uint64_t base, uint64_t size,
+                                       int flags) {
+  if (!mappings_.StoreRange(base, size, flags))
+    return false;
+  ++mapping_count_;
+  return true;
+}
+
+int MemoryPermissionIndex::AddLinuxMaps(const char *maps, size_t length) {
+  int added = 0;
+  const char *end = maps + length;
+  const char *line = maps;
+  while (line < end) {
+    const char *line_end =
+        static_cast<const char*>(memchr(line, '\n', end - line));
+    if (!line_end)
+      line_end = end;
+
+    // Each line is "start-end perms offset dev inode [name]".
+    vector<char> buffer(line, line_end);
+    buffer.push_back('\0');
+    line = line_end + 1;
+    vector<char*> fields;
+    Tokenize(&buffer[0], " \t", 6, &fields);
+    if (fields.size() < 5 || strlen(fields[1]) < 3)
+      continue;
+
+    char *cursor;
+    uint64_t start = strtoull(fields[0], &cursor, 16);
+    if (*cursor != '-')
+      continue;
+    uint64_t stop = strtoull(cursor + 1, &cursor, 16);
+    if (*cursor != '\0' || stop <= start)
+      continue;
+
+    int flags = 0;
+    if (fields[1][0] == 'r')
+      flags |= kReadable;
+    if (fields[1][1] == 'w')
+      flags |= kWritable;
+    if (fields[1][2] == 'x')
+      flags |= kExecutable;
+
+    // Tokenize leaves the padding before the name in the last field.
+    const char *name = fields.size() == 6 ? fields[5] : "";
+    name += strspn(name, " \t");
+    if (*name == '\0')
+      flags |= kAnonymous;
+    else if (strncmp(name, "[stack", 6) == 0)
+      flags |= kStack;
+
+    if (AddMapping(start, stop - start, flags))
+      ++added;
+  }
+  mappings_.Freeze();
+  return added;
+}
+
+int MemoryPermissionIndex::AddMemoryInfo(
+    const MinidumpMemoryInfoList *memory_info_list) {
+  int added = 0;
+  for (unsigned int i = 0; i < memory_info_list->info_count(); ++i) {
+    const MinidumpMemoryInfo *memory_info =
+        memory_info_list->GetMemoryInfoAtIndex(i);
+    const MDRawMemoryInfo *raw_info = memory_info ? memory_info->info() : NULL;
+    if (!raw_info || raw_info->state != MD_MEMORY_STATE_COMMIT)
+      continue;
+
+    // Memory info doesn't name regions, so none can be told to be a stack.
+    int flags = kAnonymous;
+    uint32_t protection =
+        raw_info->protection & MD_MEMORY_PROTECTION_ACCESS_MASK;
+    if (protection != MD_MEMORY_PROTECT_NOACCESS &&
+        protection != MD_MEMORY_PROTECT_EXECUTE)
+      flags |= kReadable;
+    if (memory_info->IsWritable())
+      flags |= kWritable;
+    if (memory_info->IsExecutable())
+      flags |= kExecutable;
+
+    if (AddMapping(memory_info->GetBase(), memory_info->GetSize(), flags))
+      ++added;
+  }
+  mappings_.Freeze();
+  return added;
+}
+
+bool MemoryPermissionIndex::GetFlags(uint64_t address, int *flags) const {
+  return mappings_.RetrieveRange(address, flags, NULL, NULL);
+}
+
 ExploitabilityLinux::ExploitabilityLinux(Minidump *dump,
                                          ProcessState *process_state)
     : Exploitability(dump, process_state) { }
 
 ExploitabilityRating ExploitabilityLinux::CheckPlatformExploitability() {
+  if (CrashedInStackCheckFailure())
+    return EXPLOITABILITY_HIGH;
+
+  // The remaining checks need the exception and the process's mappings,
+  // and without them there is nothing more to say.
+  MinidumpException *exception = dump_->GetException();
+  const MDRawExceptionStream *raw_exception =
+      exception ? exception->exception() : NULL;
+  const MinidumpContext *context = exception ? exception->GetContext() : NULL;
+  uint64_t instruction_ptr;
+  uint64_t stack_ptr;
+  if (!raw_exception || !context ||
+      !context->GetInstructionPointer(&instruction_ptr) ||
+      !context->GetStackPointer(&stack_ptr) ||
+      !BuildMemoryIndex()) {
+    return EXPLOITABILITY_NONE;
+  }
+
+  // Running code that isn't in executable memory means that control flow
+  // was hijacked.
+  int flags;
+  if (!memory_index_.GetFlags(instruction_ptr, &flags) ||
+      !(flags & MemoryPermissionIndex::kExecutable)) {
+    return EXPLOITABILITY_HIGH;
+  }
+
+  // A stack pointer outside of any stack suggests that the stack was
+  // pivoted to attacker-controlled memory.  Threads other than the main
+  // thread run on anonymous mappings, so those are given the benefit of
+  // the doubt.
+  if (!memory_index_.GetFlags(stack_ptr, &flags) ||
+      !(flags & (MemoryPermissionIndex::kStack |
+                 MemoryPermissionIndex::kAnonymous))) {
+    return EXPLOITABILITY_HIGH;
+  }
+
+  uint32_t signal = raw_exception->exception_record.exception_code;
+  if (signal != MD_EXCEPTION_CODE_LIN_SIGSEGV &&
+      signal != MD_EXCEPTION_CODE_LIN_SIGBUS) {
+    return EXPLOITABILITY_NONE;
+  }
+
+  uint64_t address = process_state_->crash_address();
+  if (address <= kProbableNullOffset)
+    return EXPLOITABILITY_NONE;
+
+  // A fault nowhere near NULL, at an address that nothing is mapped at, is
+  // an access through a wild pointer.
+  if (!memory_index_.GetFlags(address, &flags))
+    return EXPLOITABILITY_INTERESTING;
+
+  // Executing the address was ruled out above, so the only access that
+  // can fault on readable memory that isn't writable is a write.
+  if ((flags & MemoryPermissionIndex::kReadable) &&
+      !(flags & MemoryPermissionIndex::kWritable)) {
+    return EXPLOITABLITY_MEDIUM;
+  }
+
+  // Inaccessible mappings are most often guard pages, which catch
+  // accesses that have run off the end of a buffer.
+  if (!(flags & MemoryPermissionIndex::kReadable))
+    return EXPLOITABILITY_INTERESTING;
+
+  return EXPLOITABILITY_NONE;
+}
+
+bool ExploitabilityLinux::BuildMemoryIndex() {
+  uint32_t length;
+  if (dump_->SeekToStreamType(MD_LINUX_MAPS, &length) &&
+      length > 0 && length <= kMaxLinuxMapsLength) {
+    vector<char> maps(length);
+    if (dump_->ReadBytes(&maps[0], length))
+      memory_index_.AddLinuxMaps(&maps[0], length);
+  }
+
+  MinidumpMemoryInfoList *memory_info_list = dump_->GetMemoryInfoList();
+  if (memory_info_list)
+    memory_index_.AddMemoryInfo(memory_info_list);
+
+  return memory_index_.mapping_count() > 0;
+}
+
+bool ExploitabilityLinux::CrashedInStackCheckFailure() const {
   // Check the crashing thread for functions suggesting a buffer overflow or
   // stack smash.
-  if (process_state_->requesting_thread() != -1) {
-    CallStack* crashing_thread =
-        process_state_->threads()->at(process_state_->requesting_thread());
-    const vector<StackFrame*>& crashing_thread_frames =
-        *crashing_thread->frames();
-    for (size_t i = 0; i < crashing_thread_frames.size(); ++i) {
-      if (crashing_thread_frames[i]->function_name ==
-          kStackCheckFailureFunction) {
-        return EXPLOITABILITY_HIGH;
-      }
-
-      if (crashing_thread_frames[i]->function_name ==
-          kBoundsCheckFailureFunction) {
-        return EXPLOITABILITY_HIGH;
-      }
+  if (process_state_->requesting_thread() == -1)
+    return false;
+
+  CallStack* crashing_thread =
+      process_state_->threads()->at(process_state_->requesting_thread());
+  const vector<StackFrame*>& crashing_thread_frames =
+      *crashing_thread->frames();
+  for (size_t i = 0; i < crashing_thread_frames.size(); ++i) {
+    const char* function_name = crashing_thread_frames[i]->FunctionName();
+    if (strcmp(function_name, kStackCheckFailureFunction) == 0 ||
+        strcmp(function_name, kBoundsCheckFailureFunction) == 0) {
+      return true;
     }
   }
-
-  return EXPLOITABILITY_NONE;
+  return false;
 }
 
 }  // namespace google_breakpad
@@ -37,17 +37,75 @@
 #ifndef GOOGLE_BREAKPAD_PROCESSOR_EXPLOITABILITY_LINUX_H_
 #define GOOGLE_BREAKPAD_PROCESSOR_EXPLOITABILITY_LINUX_H_
 
+#include <stddef.h>
+
 #include "google_breakpad/common/breakpad_types.h"
 #include "google_breakpad/processor/exploitability.h"
+#include "processor/range_map.h"
 
 namespace google_breakpad {
 
+class MinidumpMemoryInfoList;
+
+// A sorted index of the crashed process's memory mappings and what each
+// permits, built once per dump from its memory info list and its Linux
+// maps stream.  Each of ExploitabilityLinux's heuristics then costs one
+// binary search, rather than a scan of the mappings.
+class MemoryPermissionIndex {
+ public:
+  enum {
+    kReadable = 1 << 0,
+    kWritable = 1 << 1,
+    kExecutable = 1 << 2,
+    // The mapping is a thread's stack ("[stack]" or "[stack:<tid>]").
+    kStack = 1 << 3,
+    // The mapping has no name.  Stacks of threads other than the main
+    // thread are anonymous mappings.
+    kAnonymous = 1 << 4
+  };
+
+  MemoryPermissionIndex() : mapping_count_(0) {}
+
+  // Adds the mappings listed in |maps|, in the format of
+  // /proc/<pid>/maps.  Malformed lines, and mappings that overlap ones
+  // already added, are skipped.  Returns the number of mappings added.
+  int AddLinuxMaps(const char *maps, size_t length);
+
+  // Adds the committed regions of |memory_info_list|, skipping regions
+  // that overlap ones already added.  Returns the number of regions added.
+  int AddMemoryInfo(const MinidumpMemoryInfoList *memory_info_list);
+
+  // The number of mappings added.
+  int mapping_count() const { return mapping_count_; }
+
+  // Sets |flags| to the flags of the mapping containing |address| and
+  // returns true, or returns false if no mapping contains it.
+  bool GetFlags(uint64_t address, int *flags) const;
+
+ private:
+  bool AddMapping(uint64_t base, uint64_t size, int flags);
+
+  RangeMap<uint64_t, int> mappings_;
+  int mapping_count_;
+};
+
 class ExploitabilityLinux : public Exploitability {
  public:
   ExploitabilityLinux(Minidump *dump,
                       ProcessState *process_state);
 
   virtual ExploitabilityRating CheckPlatformExploitability();
+
+ private:
+  // Fills memory_index_ from the dump.  Returns false if the dump
+  // describes none of the process's mappings.
+  bool BuildMemoryIndex();
+
+  // Returns true if the crashing thread was running a function that libc
+  // calls on detecting a smashed stack or an overflowing buffer.
+  bool CrashedInStackCheckFailure() const;
+
+  MemoryPermissionIndex memory_index_;
 };
 
 }  // namespace google_breakpad
@@ -35,13 +35,17 @@
 #include "breakpad_googletest_includes.h"
 #include "common/using_std_string.h"
 #include "google_breakpad/processor/basic_source_line_resolver.h"
+#include "google_breakpad/processor/instruction_analysis_cache.h"
 #include "google_breakpad/processor/minidump_processor.h"
 #include "google_breakpad/processor/process_state.h"
+#include "processor/exploitability_linux.h"
 #include "processor/simple_symbol_supplier.h"
 
 namespace {
 
 using google_breakpad::BasicSourceLineResolver;
+using google_breakpad::InstructionAnalysisCache;
+using google_breakpad::MemoryPermissionIndex;
 using google_breakpad::MinidumpProcessor;
 using google_breakpad::ProcessState;
 using google_breakpad::SimpleSymbolSupplier;
@@ -55,10 +59,14 @@ string TestDataDir() {
 // and get the exploitability rating. Returns EXPLOITABILITY_ERR_PROCESSING
 // if the crash dump can't be processed.
 google_breakpad::ExploitabilityRating
-ExploitabilityFor(const string& filename) {
+ExploitabilityFor(const string& filename,
+                  InstructionAnalysisCache* cache = NULL,
+                  bool analyze_instructions = true) {
   SimpleSymbolSupplier supplier(TestDataDir() + "/symbols");
   BasicSourceLineResolver resolver;
   MinidumpProcessor processor(&supplier, &resolver, true);
+  processor.set_instruction_analysis_cache(cache);
+  processor.set_analyze_instructions(analyze_instructions);
   ProcessState state;
 
   string minidump_file = TestDataDir() + "/" + filename;
@@ -106,6 +114,45 @@ TEST(ExploitabilityTest, TestWindowsEngine) {
             ExploitabilityFor("read_av_conditional.dmp"));
 }
 
+TEST(ExploitabilityTest, TestWindowsEngineWithCache) {
+  const char* kDumps[] = {
+    "ascii_read_av_block_write.dmp",
+    "ascii_read_av_then_jmp.dmp",
+    "write_av_non_null.dmp",
+    "read_av_non_null.dmp",
+    "read_av_clobber_write.dmp",
+    "read_av_conditional.dmp"
+  };
+  const size_t kDumpCount = sizeof(kDumps) / sizeof(kDumps[0]);
+
+  // Rating each dump twice through one cache gives the uncached ratings
+  // both times, and answers the second round from the cache.
+  InstructionAnalysisCache cache(100);
+  for (int round = 0; round < 2; ++round) {
+    for (size_t i = 0; i < kDumpCount; ++i) {
+      EXPECT_EQ(ExploitabilityFor(kDumps[i]),
+                ExploitabilityFor(kDumps[i], &cache)) << kDumps[i];
+    }
+  }
+  EXPECT_LT(0U, cache.size());
+  EXPECT_EQ(cache.size(), cache.misses());
+  EXPECT_EQ(cache.misses(), cache.hits());
+}
+
+TEST(ExploitabilityTest, TestWindowsEngineWithoutAnalysis) {
+  // These ratings don't depend on the code at the crash address.
+  ASSERT_EQ(google_breakpad::EXPLOITABILITY_HIGH,
+            ExploitabilityFor("ascii_read_av.dmp", NULL, false));
+  ASSERT_EQ(google_breakpad::EXPLOITABILITY_NONE,
+            ExploitabilityFor("null_read_av.dmp", NULL, false));
+  ASSERT_EQ(google_breakpad::EXPLOITABILITY_HIGH,
+            ExploitabilityFor("exec_av_on_stack.dmp", NULL, false));
+  ASSERT_EQ(google_breakpad::EXPLOITABILITY_MEDIUM,
+            ExploitabilityFor("write_av_non_null.dmp", NULL, false));
+  ASSERT_EQ(google_breakpad::EXPLOITABILITY_LOW,
+            ExploitabilityFor("read_av_non_null.dmp", NULL, false));
+}
+
 TEST(ExploitabilityTest, TestLinuxEngine) {
   ASSERT_EQ(google_breakpad::EXPLOITABILITY_NONE,
             ExploitabilityFor("linux_null_read_av.dmp"));
@@ -114,4 +161,42 @@ TEST(ExploitabilityTest, TestLinuxEngine) {
   ASSERT_EQ(google_breakpad::EXPLOITABILITY_HIGH,
             ExploitabilityFor("linux_stacksmash.dmp"));
 }
+
+TEST(ExploitabilityTest, MemoryPermissionIndexLinuxMaps) {
+  const char kMaps[] =
+      "00400000-0040b000 r-xp 00000000 08:01 1234    /bin/cat\n"
+      "0060a000-0060b000 r--p 0000a000 08:01 1234    /bin/cat\n"
+      "01f3c000-01f5d000 rw-p 00000000 00:00 0       [heap]\n"
+      "7f0000000000-7f0000001000 ---p 00000000 00:00 0 \n"
+      "7f0000001000-7f0000801000 rw-p 00000000 00:00 0 \n"
+      "not a mapping\n"
+      "7ffd00000000-7ffd00021000 rw-p 00000000 00:00 0  [stack]";
+  MemoryPermissionIndex index;
+  ASSERT_EQ(6, index.AddLinuxMaps(kMaps, sizeof(kMaps) - 1));
+  ASSERT_EQ(6, index.mapping_count());
+
+  int flags;
+  ASSERT_TRUE(index.GetFlags(0x400123, &flags));
+  EXPECT_EQ(MemoryPermissionIndex::kReadable |
+            MemoryPermissionIndex::kExecutable, flags);
+  ASSERT_TRUE(index.GetFlags(0x60a000, &flags));
+  EXPECT_EQ(MemoryPermissionIndex::kReadable, flags);
+  ASSERT_TRUE(index.GetFlags(0x1f5cfff, &flags));
+  EXPECT_EQ(MemoryPermissionIndex::kReadable |
+            MemoryPermissionIndex::kWritable, flags);
+  ASSERT_TRUE(index.GetFlags(0x7f0000000800ULL, &flags));
+  EXPECT_EQ(MemoryPermissionIndex::kAnonymous, flags);
+  ASSERT_TRUE(index.GetFlags(0x7f0000001000ULL, &flags));
+  EXPECT_EQ(MemoryPermissionIndex::kReadable |
+            MemoryPermissionIndex::kWritable |
+            MemoryPermissionIndex::kAnonymous, flags);
+  ASSERT_TRUE(index.GetFlags(0x7ffd00020fffULL, &flags));
+  EXPECT_EQ(MemoryPermissionIndex::kReadable |
+            MemoryPermissionIndex::kWritable |
+            MemoryPermissionIndex::kStack, flags);
+
+  EXPECT_FALSE(index.GetFlags(0, &flags));
+  EXPECT_FALSE(index.GetFlags(0x40b000, &flags));
+  EXPECT_FALSE(index.GetFlags(0x7ffd00021000ULL, &flags));
+}
 }
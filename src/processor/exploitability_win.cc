@@ -40,6 +40,9 @@
 
 #include "common/scoped_ptr.h"
 #include "google_breakpad/common/minidump_exception_win32.h"
+#include "google_breakpad/processor/code_module.h"
+#include "google_breakpad/processor/code_modules.h"
+#include "google_breakpad/processor/instruction_analysis_cache.h"
 #include "google_breakpad/processor/minidump.h"
 #include "processor/disassembler_x86.h"
 #include "processor/logging.h"
@@ -69,6 +72,60 @@ static const size_t kHugeBump          = 90;
 // The maximum number of bytes to disassemble past the program counter.
 static const size_t kDisassembleBytesBeyondPC = 2048;
 
+// Disassembles the |length| bytes of code at |raw_memory|, which the
+// process had at |instruction_ptr| when it faulted reading (or, if
+// |bad_write| is true, writing) a bad address, and returns how much what
+// the instructions do with that address adds to the exploitability weight.
+static uint32_t AnalyzeInstructions(const uint8_t *raw_memory,
+                                    uint32_t length,
+                                    uint64_t instruction_ptr,
+                                    bool bad_write) {
+  uint32_t weight = 0;
+  DisassemblerX86 disassembler(raw_memory, length, instruction_ptr);
+  disassembler.NextInstruction();
+  if (bad_write)
+    disassembler.setBadWrite();
+  else
+    disassembler.setBadRead();
+  if (!disassembler.currentInstructionValid())
+    return 0;
+
+  // Check if the faulting instruction falls into one of several
+  // interesting groups.
+  switch (disassembler.currentInstructionGroup()) {
+    case libdis::insn_controlflow:
+      weight += kLargeBump;
+      break;
+    case libdis::insn_string:
+      weight += kHugeBump;
+      break;
+    default:
+      break;
+  }
+  // Loop the disassembler through the code and check if it IDed any
+  // interesting conditions in the near future.  Multiple flags may be set
+  // so treat each equally.
+  while (disassembler.NextInstruction() &&
+         disassembler.currentInstructionValid() &&
+         !disassembler.endOfBlock())
+    continue;
+  if (disassembler.flags() & DISX86_BAD_BRANCH_TARGET)
+    weight += kLargeBump;
+  if (disassembler.flags() & DISX86_BAD_ARGUMENT_PASSED)
+    weight += kTinyBump;
+  if (disassembler.flags() & DISX86_BAD_WRITE)
+    weight += kMediumBump;
+  if (disassembler.flags() & DISX86_BAD_BLOCK_WRITE)
+    weight += kMediumBump;
+  if (disassembler.flags() & DISX86_BAD_READ)
+    weight += kTinyBump;
+  if (disassembler.flags() & DISX86_BAD_BLOCK_READ)
+    weight += kTinyBump;
+  if (disassembler.flags() & DISX86_BAD_COMPARISON)
+    weight += kTinyBump;
+  return weight;
+}
+
 ExploitabilityWin::ExploitabilityWin(Minidump *dump,
                                      ProcessState *process_state)
     : Exploitability(dump, process_state) { }
@@ -199,8 +256,14 @@ ExploitabilityRating ExploitabilityWin::CheckPlatformExploitability() {
             return EXPLOITABILITY_ERR_PROCESSING;
             break;
         }
+        if (!near_null && AddressIsAscii(address))
+          exploitability_weight += kMediumBump;
+
+        // Analysis can only raise the weight, so skip it once the rating
+        // can go no higher.
         MinidumpMemoryRegion *instruction_region = 0;
-        if (memory_available) {
+        if (memory_available && analyze_instructions_ &&
+            exploitability_weight < kHighCutoff) {
           instruction_region =
               memory_list->GetMemoryRegionForAddress(instruction_ptr);
         }
@@ -215,55 +278,32 @@ ExploitabilityRating ExploitabilityWin::CheckPlatformExploitability() {
           available_memory = available_memory > kDisassembleBytesBeyondPC ?
               kDisassembleBytesBeyondPC : available_memory;
           if (available_memory) {
-            const uint8_t *raw_memory =
-                instruction_region->GetMemory() + memory_offset;
-            DisassemblerX86 disassembler(raw_memory,
-                                         available_memory,
-                                         instruction_ptr);
-            disassembler.NextInstruction();
-            if (bad_read)
-              disassembler.setBadRead();
-            else
-              disassembler.setBadWrite();
-            if (disassembler.currentInstructionValid()) {
-              // Check if the faulting instruction falls into one of
-              // several interesting groups.
-              switch (disassembler.currentInstructionGroup()) {
-                case libdis::insn_controlflow:
-                  exploitability_weight += kLargeBump;
-                  break;
-                case libdis::insn_string:
-                  exploitability_weight += kHugeBump;
-                  break;
-                default:
-                  break;
+            // The analysis reads the memory directly, and may not read it
+            // at all if its result is cached, so record what it depends on.
+            if (dump_->memory_read_log())
+              dump_->memory_read_log()->Add(instruction_ptr, available_memory);
+            const CodeModules *modules = process_state_->modules();
+            const CodeModule *module = instruction_analysis_cache_ && modules ?
+                modules->GetModuleForAddress(instruction_ptr) : NULL;
+            uint32_t analysis_weight;
+            if (!module ||
+                !instruction_analysis_cache_->Lookup(module, instruction_ptr,
+                                                     available_memory,
+                                                     bad_write,
+                                                     &analysis_weight)) {
+              analysis_weight = AnalyzeInstructions(
+                  instruction_region->GetMemory() + memory_offset,
+                  available_memory, instruction_ptr, bad_write);
+              if (module) {
+                instruction_analysis_cache_->Store(module, instruction_ptr,
+                                                   available_memory,
+                                                   bad_write,
+                                                   analysis_weight);
               }
-              // Loop the disassembler through the code and check if it
-              // IDed any interesting conditions in the near future.
-              // Multiple flags may be set so treat each equally.
-              while (disassembler.NextInstruction() &&
-                     disassembler.currentInstructionValid() &&
-                     !disassembler.endOfBlock())
-                continue;
-              if (disassembler.flags() & DISX86_BAD_BRANCH_TARGET)
-                exploitability_weight += kLargeBump;
-              if (disassembler.flags() & DISX86_BAD_ARGUMENT_PASSED)
-                exploitability_weight += kTinyBump;
-              if (disassembler.flags() & DISX86_BAD_WRITE)
-                exploitability_weight += kMediumBump;
-              if (disassembler.flags() & DISX86_BAD_BLOCK_WRITE)
-                exploitability_weight += kMediumBump;
-              if (disassembler.flags() & DISX86_BAD_READ)
-                exploitability_weight += kTinyBump;
-              if (disassembler.flags() & DISX86_BAD_BLOCK_READ)
-                exploitability_weight += kTinyBump;
-              if (disassembler.flags() & DISX86_BAD_COMPARISON)
-                exploitability_weight += kTinyBump;
             }
+            exploitability_weight += analysis_weight;
           }
         }
-        if (!near_null && AddressIsAscii(address))
-          exploitability_weight += kMediumBump;
       } else {
         BPLOG(INFO) << "Access violation type parameter missing.";
         return EXPLOITABILITY_ERR_PROCESSING;
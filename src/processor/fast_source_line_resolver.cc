@@ -40,12 +40,15 @@
 #include "google_breakpad/processor/fast_source_line_resolver.h"
 #include "processor/fast_source_line_resolver_types.h"
 
+#include <string.h>
+
 #include <map>
 #include <string>
 #include <utility>
 
 #include "common/scoped_ptr.h"
 #include "common/using_std_string.h"
+#include "processor/logging.h"
 #include "processor/module_factory.h"
 #include "processor/simple_serializer-inl.h"
 
@@ -54,6 +57,10 @@ using std::make_pair;
 
 namespace google_breakpad {
 
+// Zeros read as an empty map of any of the kinds a module holds.  Maps of a
+// compressed module point here until they are decompressed.
+static const char kEmptyMap[32] = { 0 };
+
 FastSourceLineResolver::FastSourceLineResolver()
   : SourceLineResolverBase(new FastModuleFactory) { }
 
@@ -61,8 +68,11 @@ bool FastSourceLineResolver::ShouldDeleteMemoryBufferAfterLoadModule() {
   return false;
 }
 
-void FastSourceLineResolver::Module::LookupAddress(StackFrame *frame) const {
+void FastSourceLineResolver::Module::LookupAddress(StackFrame *frame,
+                                                   bool share_names) const {
   MemAddr address = frame->instruction - frame->module->base_address();
+  const_cast<Module*>(this)->UseMaps(
+      1U << FILES_MAP | 1U << FUNCTIONS_MAP | 1U << PUBLIC_SYMBOLS_MAP);
 
   // First, look for a FUNC record that covers address. Use
   // RetrieveNearestRange instead of RetrieveRange so that, if there
@@ -70,9 +80,10 @@ void FastSourceLineResolver::Module::LookupAddress(StackFrame *frame) const {
   // extent of the PUBLIC symbol we find, below. This does mean we
   // need to check that address indeed falls within the function we
   // find; do the range comparison in an overflow-friendly way.
-  scoped_ptr<Function> func(new Function);
+  //
+  // The records are read in place, so with |share_names| nothing is
+  // allocated.
   const Function* func_ptr = 0;
-  scoped_ptr<PublicSymbol> public_symbol(new PublicSymbol);
   const PublicSymbol* public_symbol_ptr = 0;
   MemAddr function_base;
   MemAddr function_size;
@@ -81,28 +92,33 @@ void FastSourceLineResolver::Module::LookupAddress(StackFrame *frame) const {
   if (functions_.RetrieveNearestRange(address, func_ptr,
                                       &function_base, &function_size) &&
       address >= function_base && address - function_base < function_size) {
-    func.get()->CopyFrom(func_ptr);
-    frame->function_name = func->name;
+    if (share_names)
+      frame->shared_function_name = Function::Name(func_ptr);
+    else
+      frame->function_name = Function::Name(func_ptr);
     frame->function_base = frame->module->base_address() + function_base;
 
-    scoped_ptr<Line> line(new Line);
     const Line* line_ptr = 0;
     MemAddr line_base;
-    if (func->lines.RetrieveRange(address, line_ptr, &line_base, NULL)) {
-      line.get()->CopyFrom(line_ptr);
-      FileMap::iterator it = files_.find(line->source_file_id);
+    if (Function::Lines(func_ptr).RetrieveRange(address, line_ptr,
+                                                &line_base, NULL)) {
+      FileMap::iterator it = files_.find(Line::SourceFileId(line_ptr));
       if (it != files_.end()) {
-        frame->source_file_name =
-            files_.find(line->source_file_id).GetValuePtr();
+        if (share_names)
+          frame->shared_source_file_name = it.GetValuePtr();
+        else
+          frame->source_file_name = it.GetValuePtr();
       }
-      frame->source_line = line->line;
+      frame->source_line = Line::LineNumber(line_ptr);
       frame->source_line_base = frame->module->base_address() + line_base;
     }
   } else if (public_symbols_.Retrieve(address,
                                       public_symbol_ptr, &public_address) &&
              (!func_ptr || public_address > function_base)) {
-    public_symbol.get()->CopyFrom(public_symbol_ptr);
-    frame->function_name = public_symbol->name;
+    if (share_names)
+      frame->shared_function_name = PublicSymbol::Name(public_symbol_ptr);
+    else
+      frame->function_name = PublicSymbol::Name(public_symbol_ptr);
     frame->function_base = frame->module->base_address() + public_address;
   }
 }
@@ -128,7 +144,6 @@ WindowsFrameInfo FastSourceLineResolver::CopyWFI(const char *raw) {
   uint32_t max_stack_size = para_uint32[5];
   const char *boolean = reinterpret_cast<const char*>(para_uint32 + 6);
   bool allocates_base_pointer = (*boolean != 0);
-  string program_string = boolean + 1;
 
   return WindowsFrameInfo(type,
                           prolog_size,
@@ -138,17 +153,41 @@ WindowsFrameInfo FastSourceLineResolver::CopyWFI(const char *raw) {
                           local_size,
                           max_stack_size,
                           allocates_base_pointer,
-                          program_string);
+                          boolean + 1);
 }
 
 // Loads a map from the given buffer in char* type.
 // Does NOT take ownership of mem_buffer.
 // In addition, treat mem_buffer as const char*.
+void FastSourceLineResolver::Module::GetMemoryUsage(
+    ModuleMemoryUsage *usage) const {
+  size_t map_bytes[kNumberMaps_];
+  for (int map_id = 0; map_id < kNumberMaps_; ++map_id) {
+    map_bytes[map_id] = compressed_data_ && !map_data_[map_id].get() ?
+                        0 : map_sizes_[map_id];
+  }
+  usage->files = map_bytes[FILES_MAP];
+  usage->functions = map_bytes[FUNCTIONS_MAP];
+  usage->lines = 0;
+  usage->public_symbols = map_bytes[PUBLIC_SYMBOLS_MAP];
+  usage->frame_info = 0;
+  for (int map_id = WINDOWS_FRAME_INFO_MAPS; map_id < kNumberMaps_; ++map_id)
+    usage->frame_info += map_bytes[map_id];
+  usage->other = compressed_size_;
+}
+
 bool FastSourceLineResolver::Module::LoadMapFromMemory(
     char *memory_buffer,
     size_t memory_buffer_size) {
   if (!memory_buffer) return false;
 
+  uint32_t signature;
+  if (memory_buffer_size >= sizeof(signature)) {
+    memcpy(&signature, memory_buffer, sizeof(signature));
+    if (signature == kCompressedModuleSignature)
+      return LoadCompressedMap(memory_buffer, memory_buffer_size);
+  }
+
   // Read the "is_corrupt" flag.
   const char *mem_buffer = memory_buffer;
   mem_buffer = SimpleSerializer<bool>::Read(mem_buffer, &is_corrupt_);
@@ -168,27 +207,174 @@ bool FastSourceLineResolver::Module::LoadMapFromMemory(
   }
 
   // Use pointers to construct Static*Map data members in Module:
-  int map_id = 0;
-  files_ = StaticMap<int, char>(mem_buffer + offsets[map_id++]);
-  functions_ =
-      StaticRangeMap<MemAddr, Function>(mem_buffer + offsets[map_id++]);
-  public_symbols_ =
-      StaticAddressMap<MemAddr, PublicSymbol>(mem_buffer + offsets[map_id++]);
-  for (int i = 0; i < WindowsFrameInfo::STACK_INFO_LAST; ++i)
-    windows_frame_info_[i] =
-        StaticContainedRangeMap<MemAddr, char>(mem_buffer + offsets[map_id++]);
-
-  cfi_initial_rules_ =
-      StaticRangeMap<MemAddr, char>(mem_buffer + offsets[map_id++]);
-  cfi_delta_rules_ = StaticMap<MemAddr, char>(mem_buffer + offsets[map_id++]);
+  for (int map_id = 0; map_id < kNumberMaps_; ++map_id) {
+    map_sizes_[map_id] = map_sizes[map_id];
+    SetMap(map_id, mem_buffer + offsets[map_id]);
+  }
+
+  return true;
+}
+
+void FastSourceLineResolver::Module::SetMap(int map_id, const char *map_data) {
+  switch (map_id) {
+    case FILES_MAP:
+      files_ = StaticMap<int, char>(map_data);
+      break;
+    case FUNCTIONS_MAP:
+      functions_ = StaticRangeMap<MemAddr, Function>(map_data);
+      break;
+    case PUBLIC_SYMBOLS_MAP:
+      public_symbols_ = StaticAddressMap<MemAddr, PublicSymbol>(map_data);
+      break;
+    case CFI_RULES_MAP:
+      cfi_rules_ = StaticMap<int32_t, char>(map_data);
+      break;
+    case CFI_INITIAL_RULES_MAP:
+      cfi_initial_rules_ = StaticRangeMap<MemAddr, int32_t>(map_data);
+      break;
+    case CFI_DELTA_RULES_MAP:
+      cfi_delta_rules_ = StaticMap<MemAddr, int32_t>(map_data);
+      break;
+    default:
+      windows_frame_info_[map_id - WINDOWS_FRAME_INFO_MAPS] =
+          StaticContainedRangeMap<MemAddr, char>(map_data);
+      break;
+  }
+}
+
+bool FastSourceLineResolver::Module::LoadCompressedMap(
+    const char *memory_buffer, size_t memory_buffer_size) {
+  // Until the directory checks out, the module is corrupt and every map is
+  // empty.
+  is_corrupt_ = true;
+  for (int map_id = 0; map_id < kNumberMaps_; ++map_id) {
+    map_last_use_[map_id] = 0;
+    SetMap(map_id, kEmptyMap);
+  }
+
+  const CompressedModuleHeader *header =
+      reinterpret_cast<const CompressedModuleHeader*>(memory_buffer);
+  size_t directory_size = sizeof(*header) +
+                          kNumberMaps_ * sizeof(CompressedModuleMap);
+  if (memory_buffer_size < directory_size ||
+      header->version != kCompressedModuleVersion ||
+      header->map_count != static_cast<uint32_t>(kNumberMaps_)) {
+    BPLOG(ERROR) << "Unsupported compressed module " << name_;
+    return false;
+  }
+
+  const CompressedModuleMap *maps =
+      reinterpret_cast<const CompressedModuleMap*>(header + 1);
+  size_t block_count = 0;
+  for (int i = 0; i < kNumberMaps_; ++i) {
+    if (maps[i].first_block != block_count) {
+      BPLOG(ERROR) << "Corrupt compressed module directory in " << name_;
+      return false;
+    }
+    block_count += CompressedModuleBlockCount(maps[i].size);
+  }
 
+  const CompressedModuleBlock *blocks =
+      reinterpret_cast<const CompressedModuleBlock*>(maps + kNumberMaps_);
+  directory_size += block_count * sizeof(CompressedModuleBlock);
+  if (memory_buffer_size < directory_size) {
+    BPLOG(ERROR) << "Truncated compressed module directory in " << name_;
+    return false;
+  }
+  for (size_t i = 0; i < block_count; ++i) {
+    if (blocks[i].offset < directory_size ||
+        blocks[i].offset > memory_buffer_size ||
+        blocks[i].stored_size > memory_buffer_size - blocks[i].offset) {
+      BPLOG(ERROR) << "Compressed module block lies outside " << name_;
+      return false;
+    }
+  }
+
+  is_corrupt_ = header->is_corrupt != 0;
+  compressed_data_ = memory_buffer;
+  compressed_maps_ = maps;
+  compressed_blocks_ = blocks;
+  compressed_size_ = memory_buffer_size;
+  for (int map_id = 0; map_id < kNumberMaps_; ++map_id)
+    map_sizes_[map_id] = maps[map_id].size;
   return true;
 }
 
+void FastSourceLineResolver::Module::UseMaps(uint32_t map_mask) {
+  if (!compressed_data_)
+    return;
+
+  ++use_count_;
+  for (int map_id = 0; map_id < kNumberMaps_; ++map_id) {
+    const CompressedModuleMap &map = compressed_maps_[map_id];
+    if (!(map_mask & (1U << map_id)))
+      continue;
+    map_last_use_[map_id] = use_count_;
+    if (map_data_[map_id].get() || map.size == 0)
+      continue;
+
+    // One extra byte for a null terminator, as a serialized module has.
+    scoped_array<char> data(new char[map.size + 1]);
+    data[map.size] = '\0';
+    uint32_t block_count = CompressedModuleBlockCount(map.size);
+    bool decompressed = true;
+    for (uint32_t i = 0; decompressed && i < block_count; ++i) {
+      const CompressedModuleBlock &block =
+          compressed_blocks_[map.first_block + i];
+      size_t offset = i * kCompressedModuleBlockSize;
+      size_t block_size = map.size - offset;
+      if (block_size > kCompressedModuleBlockSize)
+        block_size = kCompressedModuleBlockSize;
+      const char *stored = compressed_data_ + block.offset;
+      if (block.stored_size == block_size) {
+        memcpy(data.get() + offset, stored, block_size);
+      } else {
+        decompressed = block.stored_size < block_size &&
+            DecompressBlock(reinterpret_cast<const uint8_t*>(stored),
+                            block.stored_size,
+                            reinterpret_cast<uint8_t*>(data.get() + offset),
+                            block_size);
+      }
+    }
+    if (!decompressed) {
+      BPLOG(ERROR) << "Could not decompress map " << map_id << " of "
+                   << name_;
+      // Leave the map empty, without trying again.
+      data.reset(new char[sizeof(kEmptyMap)]());
+    }
+    SetMap(map_id, data.get());
+    map_data_[map_id].swap(data);
+    if (map_id >= WINDOWS_FRAME_INFO_MAPS)
+      evictable_bytes_ += map.size;
+  }
+
+  // Drop the least recently used stack walking maps, but none this lookup
+  // is about to use.
+  while (evictable_bytes_ > kMaxEvictableMapBytes) {
+    int oldest = -1;
+    for (int map_id = WINDOWS_FRAME_INFO_MAPS; map_id < kNumberMaps_;
+         ++map_id) {
+      if (map_data_[map_id].get() && !(map_mask & (1U << map_id)) &&
+          (oldest < 0 || map_last_use_[map_id] < map_last_use_[oldest])) {
+        oldest = map_id;
+      }
+    }
+    if (oldest < 0)
+      break;
+    SetMap(oldest, kEmptyMap);
+    map_data_[oldest].reset();
+    evictable_bytes_ -= compressed_maps_[oldest].size;
+  }
+}
+
 WindowsFrameInfo *FastSourceLineResolver::Module::FindWindowsFrameInfo(
     const StackFrame *frame) const {
   MemAddr address = frame->instruction - frame->module->base_address();
-  scoped_ptr<WindowsFrameInfo> result(new WindowsFrameInfo());
+  const int kFrameDataMap =
+      WINDOWS_FRAME_INFO_MAPS + WindowsFrameInfo::STACK_INFO_FRAME_DATA;
+  const int kFPOMap = WINDOWS_FRAME_INFO_MAPS + WindowsFrameInfo::STACK_INFO_FPO;
+  const_cast<Module*>(this)->UseMaps(
+      1U << kFrameDataMap | 1U << kFPOMap | 1U << FUNCTIONS_MAP);
 
   // We only know about WindowsFrameInfo::STACK_INFO_FRAME_DATA and
   // WindowsFrameInfo::STACK_INFO_FPO. Prefer them in this order.
@@ -201,38 +387,23 @@ WindowsFrameInfo *FastSourceLineResolver::Module::FindWindowsFrameInfo(
        .RetrieveRange(address, frame_info_ptr))
       || (windows_frame_info_[WindowsFrameInfo::STACK_INFO_FPO]
           .RetrieveRange(address, frame_info_ptr))) {
-    result->CopyFrom(CopyWFI(frame_info_ptr));
-    return result.release();
+    return new WindowsFrameInfo(CopyWFI(frame_info_ptr));
   }
 
   // Even without a relevant STACK line, many functions contain
   // information about how much space their parameters consume on the
-  // stack. Use RetrieveNearestRange instead of RetrieveRange, so that
-  // we can use the function to bound the extent of the PUBLIC symbol,
-  // below. However, this does mean we need to check that ADDRESS
-  // falls within the retrieved function's range; do the range
-  // comparison in an overflow-friendly way.
-  scoped_ptr<Function> function(new Function);
+  // stack. Check that ADDRESS falls within the retrieved function's
+  // range in an overflow-friendly way.  (A PUBLIC symbol's parameter size
+  // alone isn't returned, so there is no need to look one up.)
   const Function* function_ptr = 0;
   MemAddr function_base, function_size;
   if (functions_.RetrieveNearestRange(address, function_ptr,
                                       &function_base, &function_size) &&
       address >= function_base && address - function_base < function_size) {
-    function.get()->CopyFrom(function_ptr);
-    result->parameter_size = function->parameter_size;
+    WindowsFrameInfo *result = new WindowsFrameInfo();
+    result->parameter_size = Function::ParameterSize(function_ptr);
     result->valid |= WindowsFrameInfo::VALID_PARAMETER_SIZE;
-    return result.release();
-  }
-
-  // PUBLIC symbols might have a parameter size. Use the function we
-  // found above to limit the range the public symbol covers.
-  scoped_ptr<PublicSymbol> public_symbol(new PublicSymbol);
-  const PublicSymbol* public_symbol_ptr = 0;
-  MemAddr public_address;
-  if (public_symbols_.Retrieve(address, public_symbol_ptr, &public_address) &&
-      (!function_ptr || public_address > function_base)) {
-    public_symbol.get()->CopyFrom(public_symbol_ptr);
-    result->parameter_size = public_symbol->parameter_size;
+    return result;
   }
 
   return NULL;
@@ -241,8 +412,11 @@ WindowsFrameInfo *FastSourceLineResolver::Module::FindWindowsFrameInfo(
 CFIFrameInfo *FastSourceLineResolver::Module::FindCFIFrameInfo(
     const StackFrame *frame) const {
   MemAddr address = frame->instruction - frame->module->base_address();
+  const_cast<Module*>(this)->UseMaps(
+      1U << CFI_RULES_MAP | 1U << CFI_INITIAL_RULES_MAP |
+      1U << CFI_DELTA_RULES_MAP);
   MemAddr initial_base, initial_size;
-  const char* initial_rules = NULL;
+  const int32_t* initial_rules = NULL;
 
   // Find the initial rule whose range covers this address. That
   // provides an initial set of register recovery rules. Then, walk
@@ -256,20 +430,30 @@ CFIFrameInfo *FastSourceLineResolver::Module::FindCFIFrameInfo(
   // Create a frame info structure, and populate it with the rules from
   // the STACK CFI INIT record.
   scoped_ptr<CFIFrameInfo> rules(new CFIFrameInfo());
-  if (!ParseCFIRuleSet(initial_rules, rules.get()))
+  const char *initial_rule_set = CFIRuleSet(*initial_rules);
+  if (!initial_rule_set || !ParseCFIRuleSet(initial_rule_set, rules.get()))
     return NULL;
 
   // Find the first delta rule that falls within the initial rule's range.
-  StaticMap<MemAddr, char>::iterator delta =
+  StaticMap<MemAddr, int32_t>::iterator delta =
     cfi_delta_rules_.lower_bound(initial_base);
 
   // Apply delta rules up to and including the frame's address.
   while (delta != cfi_delta_rules_.end() && delta.GetKey() <= address) {
-    ParseCFIRuleSet(delta.GetValuePtr(), rules.get());
+    const char *delta_rule_set = CFIRuleSet(*delta.GetValuePtr());
+    if (delta_rule_set)
+      ParseCFIRuleSet(delta_rule_set, rules.get());
     delta++;
   }
 
   return rules.release();
 }
 
+const char *FastSourceLineResolver::Module::CFIRuleSet(int32_t index) const {
+  // cfi_rules_ is keyed by index, so there's no need to search it.
+  if (index < 0 || static_cast<unsigned int>(index) >= cfi_rules_.size())
+    return NULL;
+  return cfi_rules_.IteratorAtIndex(index).GetValuePtr();
+}
+
 }  // namespace google_breakpad
@@ -40,11 +40,15 @@
 #include "google_breakpad/processor/fast_source_line_resolver.h"
 #include "processor/source_line_resolver_base_types.h"
 
+#include <string.h>
+
 #include <map>
 #include <string>
 
+#include "common/scoped_ptr.h"
 #include "google_breakpad/processor/stack_frame.h"
 #include "processor/cfi_frame_info.h"
+#include "processor/compressed_module_format.h"
 #include "processor/static_address_map-inl.h"
 #include "processor/static_contained_range_map-inl.h"
 #include "processor/static_map.h"
@@ -53,6 +57,11 @@
 
 namespace google_breakpad {
 
+// Lookups read the serialized records in place, through the pointers the
+// static maps return, rather than copying them: a lookup only needs a few
+// fields, and the names can be shared with the frames.  CopyFrom
+// de-serializes a whole record, for ModuleComparer.
+
 struct FastSourceLineResolver::Line : public SourceLineResolverBase::Line {
   void CopyFrom(const Line *line_ptr) {
     const char *raw = reinterpret_cast<const char*>(line_ptr);
@@ -68,6 +77,17 @@ struct FastSourceLineResolver::Line : public SourceLineResolverBase::Line {
     line = *(reinterpret_cast<const int32_t*>(
         raw + 2 * sizeof(address) + sizeof(source_file_id)));
   }
+
+  // Fields of the serialized Line at |line_ptr|.
+  static int32_t SourceFileId(const Line *line_ptr) {
+    const char *raw = reinterpret_cast<const char*>(line_ptr);
+    return *reinterpret_cast<const int32_t*>(raw + 2 * sizeof(MemAddr));
+  }
+  static int32_t LineNumber(const Line *line_ptr) {
+    const char *raw = reinterpret_cast<const char*>(line_ptr);
+    return *reinterpret_cast<const int32_t*>(
+        raw + 2 * sizeof(MemAddr) + sizeof(int32_t));
+  }
 };
 
 struct FastSourceLineResolver::Function :
@@ -91,6 +111,27 @@ public SourceLineResolverBase::Function {
   }
 
   StaticRangeMap<MemAddr, Line> lines;
+
+  // Fields of the serialized Function at |func_ptr|, which begins with
+  // its NUL-terminated name.
+  static const char *Name(const Function *func_ptr) {
+    return reinterpret_cast<const char*>(func_ptr);
+  }
+  static int32_t ParameterSize(const Function *func_ptr) {
+    return *reinterpret_cast<const int32_t*>(
+        Fields(func_ptr) + 2 * sizeof(MemAddr));
+  }
+  static StaticRangeMap<MemAddr, Line> Lines(const Function *func_ptr) {
+    return StaticRangeMap<MemAddr, Line>(
+        Fields(func_ptr) + 2 * sizeof(MemAddr) + sizeof(int32_t));
+  }
+
+ private:
+  // The fields after the name.
+  static const char *Fields(const Function *func_ptr) {
+    const char *raw = Name(func_ptr);
+    return raw + strlen(raw) + 1;
+  }
 };
 
 struct FastSourceLineResolver::PublicSymbol :
@@ -108,18 +149,39 @@ public SourceLineResolverBase::PublicSymbol {
     parameter_size = *(reinterpret_cast<const int32_t*>(
         raw + name_size + sizeof(MemAddr)));
   }
+
+  // Fields of the serialized PublicSymbol at |public_symbol_ptr|, which
+  // begins with its NUL-terminated name.
+  static const char *Name(const PublicSymbol *public_symbol_ptr) {
+    return reinterpret_cast<const char*>(public_symbol_ptr);
+  }
 };
 
 class FastSourceLineResolver::Module: public SourceLineResolverBase::Module {
  public:
-  explicit Module(const string &name) : name_(name), is_corrupt_(false) { }
+  explicit Module(const string &name)
+      : name_(name), is_corrupt_(false), compressed_data_(NULL),
+        compressed_maps_(NULL), compressed_blocks_(NULL), compressed_size_(0),
+        use_count_(0), evictable_bytes_(0) {
+    for (int map_id = 0; map_id < kNumberMaps_; ++map_id)
+      map_sizes_[map_id] = 0;
+  }
   virtual ~Module() { }
 
   // Looks up the given relative address, and fills the StackFrame struct
   // with the result.
-  virtual void LookupAddress(StackFrame *frame) const;
+  virtual void LookupAddress(StackFrame *frame, bool share_names) const;
 
-  // Loads a map from the given buffer in char* type.
+  // Counts each map the module refers to.  A function's lines are
+  // serialized with it, so they are counted in functions.  For a
+  // compressed module, only the maps decompressed at the moment are
+  // counted, and the compressed data is counted in other.
+  virtual void GetMemoryUsage(ModuleMemoryUsage *usage) const;
+
+  // Loads a map from the given buffer in char* type.  The buffer holds a
+  // serialized module, either as ModuleSerializer::Serialize writes it or
+  // in the compressed format of compressed_module_format.h.  The maps of a
+  // compressed module are decompressed as lookups need them.
   virtual bool LoadMapFromMemory(char *memory_buffer,
                                  size_t memory_buffer_size);
 
@@ -140,14 +202,54 @@ class FastSourceLineResolver::Module: public SourceLineResolverBase::Module {
   // returned CFIFrameInfo object.
   virtual CFIFrameInfo *FindCFIFrameInfo(const StackFrame *frame) const;
 
+  // Lookups only read the serialized maps, unless they are compressed and
+  // have to be decompressed first.
+  virtual bool CanLookUpConcurrently() const { return !compressed_data_; }
+
   // Number of serialized map components of Module.
-  static const int kNumberMaps_ = 5 + WindowsFrameInfo::STACK_INFO_LAST;
+  static const int kNumberMaps_ = 6 + WindowsFrameInfo::STACK_INFO_LAST;
+
+  // The decompressed maps of a compressed module that lookups only copy
+  // data out of, which are those for stack walking, are kept to about this
+  // many bytes.  The least recently used are dropped, to be decompressed
+  // again if they are needed.  Names that lookups share point into the
+  // other maps, which are kept once decompressed.
+  static const size_t kMaxEvictableMapBytes = 16 << 20;
 
  private:
   friend class FastSourceLineResolver;
   friend class ModuleComparer;
   typedef StaticMap<int, char> FileMap;
 
+  // The serialized maps, in the order they are stored.
+  enum MapId {
+    FILES_MAP,
+    FUNCTIONS_MAP,
+    PUBLIC_SYMBOLS_MAP,
+    WINDOWS_FRAME_INFO_MAPS,
+    CFI_RULES_MAP = WINDOWS_FRAME_INFO_MAPS + WindowsFrameInfo::STACK_INFO_LAST,
+    CFI_INITIAL_RULES_MAP,
+    CFI_DELTA_RULES_MAP
+  };
+
+  // Points the map |map_id| at its serialized data.
+  void SetMap(int map_id, const char *map_data);
+
+  // Validates the compressed module in |memory_buffer| and keeps its
+  // directory.  Its maps are left empty until UseMaps is called.
+  bool LoadCompressedMap(const char *memory_buffer, size_t memory_buffer_size);
+
+  // For a compressed module, decompresses each map whose bit is set in
+  // |map_mask| unless it already is, and then drops the least recently used
+  // evictable maps not in |map_mask| while they take more than
+  // kMaxEvictableMapBytes.  The lookups are const, but this only changes
+  // which maps are in memory, so they call it through const_cast.  Does
+  // nothing for an uncompressed module.
+  void UseMaps(uint32_t map_mask);
+
+  // Returns the rule set at INDEX in cfi_rules_, or NULL if there is none.
+  const char *CFIRuleSet(int32_t index) const;
+
   string name_;
   StaticMap<int, char> files_;
   StaticRangeMap<MemAddr, Function> functions_;
@@ -167,17 +269,41 @@ class FastSourceLineResolver::Module: public SourceLineResolverBase::Module {
   // records, walking a stack will only ever use a few of them, so it's
   // best to delay parsing a record until it's actually needed.
   //
+  // Each distinct rule set is stored once in cfi_rules_, keyed by its
+  // index, and the maps below hold those indices.
+  StaticMap<int32_t, char> cfi_rules_;
+
   // STACK CFI INIT records: for each range, an initial set of register
   // recovery rules. The RangeMap's itself gives the starting and ending
   // addresses.
-  StaticRangeMap<MemAddr, char> cfi_initial_rules_;
+  StaticRangeMap<MemAddr, int32_t> cfi_initial_rules_;
 
   // STACK CFI records: at a given address, the changes to the register
   // recovery rules that take effect at that address. The map key is the
   // starting address; the ending address is the key of the next entry in
   // this map, or the end of the range as given by the cfi_initial_rules_
   // entry (which FindCFIFrameInfo looks up first).
-  StaticMap<MemAddr, char> cfi_delta_rules_;
+  StaticMap<MemAddr, int32_t> cfi_delta_rules_;
+
+  // For a compressed module, the compressed data, which the module doesn't
+  // own, and its directory; otherwise NULL.
+  const char *compressed_data_;
+  const CompressedModuleMap *compressed_maps_;
+  const CompressedModuleBlock *compressed_blocks_;
+  size_t compressed_size_;
+
+  // The size of each serialized map, decompressed.
+  uint32_t map_sizes_[kNumberMaps_];
+
+  // For a compressed module, each map's decompressed data, NULL until it is
+  // needed or once it is dropped, and the value of use_count_ when a lookup
+  // last needed it.
+  scoped_array<char> map_data_[kNumberMaps_];
+  uint64_t map_last_use_[kNumberMaps_];
+  uint64_t use_count_;
+
+  // The size of the evictable maps decompressed.
+  size_t evictable_bytes_;
 };
 
 }  // namespace google_breakpad
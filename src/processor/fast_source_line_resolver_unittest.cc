@@ -38,12 +38,16 @@
 // Author: Siyang Xie (lambxsy@google.com)
 
 #include <assert.h>
+#include <pthread.h>
 #include <stdio.h>
 
 #include <sstream>
 #include <string>
+#include <vector>
 
 #include "breakpad_googletest_includes.h"
+#include "common/scoped_ptr.h"
+#include "common/tests/auto_tempdir.h"
 #include "common/using_std_string.h"
 #include "google_breakpad/processor/code_module.h"
 #include "google_breakpad/processor/stack_frame.h"
@@ -54,6 +58,7 @@
 
 namespace {
 
+using google_breakpad::AutoTempDir;
 using google_breakpad::SourceLineResolverBase;
 using google_breakpad::BasicSourceLineResolver;
 using google_breakpad::FastSourceLineResolver;
@@ -65,6 +70,7 @@ using google_breakpad::MemoryRegion;
 using google_breakpad::StackFrame;
 using google_breakpad::WindowsFrameInfo;
 using google_breakpad::linked_ptr;
+using google_breakpad::scoped_array;
 using google_breakpad::scoped_ptr;
 
 class TestCodeModule : public CodeModule {
@@ -165,8 +171,10 @@ static bool VerifyEmpty(const StackFrame &frame) {
 
 static void ClearSourceLineInfo(StackFrame *frame) {
   frame->function_name.clear();
+  frame->shared_function_name = NULL;
   frame->module = NULL;
   frame->source_file_name.clear();
+  frame->shared_source_file_name = NULL;
   frame->source_line = 0;
 }
 
@@ -463,6 +471,259 @@ TEST_F(TestFastSourceLineResolver, TestUnload) {
   ASSERT_TRUE(fast_resolver.HasModule(&module1));
 }
 
+TEST_F(TestFastSourceLineResolver, TestShareNames) {
+  TestCodeModule module1("module1");
+  ASSERT_TRUE(basic_resolver.LoadModule(&module1, symbol_file(1)));
+  ASSERT_TRUE(serializer.ConvertOneModule(module1.code_file(),
+                                          &basic_resolver,
+                                          &fast_resolver));
+  fast_resolver.set_share_names(true);
+
+  // Shared names point into the serialized module and read the same as
+  // the basic resolver's copies.
+  for (uint64_t address = 0x800; address < 0x3100; address += 0x18) {
+    StackFrame expected;
+    expected.instruction = address;
+    expected.module = &module1;
+    basic_resolver.FillSourceLineInfo(&expected);
+
+    StackFrame frame;
+    frame.instruction = address;
+    frame.module = &module1;
+    fast_resolver.FillSourceLineInfo(&frame);
+    EXPECT_TRUE(frame.function_name.empty());
+    EXPECT_TRUE(frame.source_file_name.empty());
+    EXPECT_EQ(expected.function_name, frame.FunctionName());
+    EXPECT_EQ(expected.function_base, frame.function_base);
+    EXPECT_EQ(expected.source_file_name, frame.SourceFileName());
+    EXPECT_EQ(expected.source_line, frame.source_line);
+    EXPECT_EQ(expected.source_line_base, frame.source_line_base);
+  }
+}
+
+TEST_F(TestFastSourceLineResolver, TestLoadMappedFile) {
+  char *symbol_data;
+  size_t symbol_data_size;
+  ASSERT_TRUE(SourceLineResolverBase::ReadSymbolFile(
+      symbol_file(1), &symbol_data, &symbol_data_size));
+  string symbol_data_string(symbol_data, symbol_data_size);
+  delete [] symbol_data;
+
+  unsigned int serialized_size;
+  scoped_array<char> serialized(serializer.SerializeSymbolFileData(
+      symbol_data_string, &serialized_size));
+  ASSERT_TRUE(serialized.get());
+
+  AutoTempDir temp_dir;
+  string map_file = temp_dir.path() + "/module1.sym.fast";
+  FILE *f = fopen(map_file.c_str(), "wb");
+  ASSERT_TRUE(f);
+  ASSERT_EQ(serialized_size,
+            fwrite(serialized.get(), 1, serialized_size, f));
+  fclose(f);
+
+  TestCodeModule module1("module1");
+  ASSERT_TRUE(fast_resolver.LoadModuleUsingMappedFile(&module1, map_file));
+  ASSERT_TRUE(fast_resolver.HasModule(&module1));
+  ASSERT_FALSE(fast_resolver.IsModuleCorrupt(&module1));
+  ASSERT_FALSE(fast_resolver.LoadModuleUsingMappedFile(&module1, map_file));
+
+  StackFrame frame;
+  frame.instruction = 0x1000;
+  frame.module = &module1;
+  fast_resolver.FillSourceLineInfo(&frame);
+  ASSERT_EQ("Function1_1", frame.function_name);
+  ASSERT_EQ("file1_1.cc", frame.source_file_name);
+  ASSERT_EQ(44, frame.source_line);
+  scoped_ptr<WindowsFrameInfo> windows_frame_info(
+      fast_resolver.FindWindowsFrameInfo(&frame));
+  ASSERT_TRUE(windows_frame_info.get());
+
+  // The mapping goes away with the module, and can be made again.
+  fast_resolver.UnloadModule(&module1);
+  ASSERT_FALSE(fast_resolver.HasModule(&module1));
+  ASSERT_TRUE(fast_resolver.LoadModuleUsingMappedFile(&module1, map_file));
+  frame.function_name.clear();
+  fast_resolver.FillSourceLineInfo(&frame);
+  ASSERT_EQ("Function1_1", frame.function_name);
+
+  TestCodeModule module2("module2");
+  ASSERT_FALSE(fast_resolver.LoadModuleUsingMappedFile(
+      &module2, temp_dir.path() + "/missing.sym.fast"));
+  ASSERT_FALSE(fast_resolver.HasModule(&module2));
+
+  // The basic resolver parses its symbol data, so it doesn't map files.
+  ASSERT_FALSE(basic_resolver.LoadModuleUsingMappedFile(&module1, map_file));
+  ASSERT_FALSE(basic_resolver.HasModule(&module1));
+}
+
+TEST_F(TestFastSourceLineResolver, TestLoadCompressed) {
+  FastSourceLineResolver compressed_resolver;
+  for (int module_index = 1; module_index <= 2; ++module_index) {
+    char *symbol_data;
+    size_t symbol_data_size;
+    ASSERT_TRUE(SourceLineResolverBase::ReadSymbolFile(
+        symbol_file(module_index), &symbol_data, &symbol_data_size));
+    string symbol_data_string(symbol_data, symbol_data_size);
+    delete [] symbol_data;
+
+    unsigned int serialized_size;
+    scoped_array<char> serialized(serializer.SerializeSymbolFileData(
+        symbol_data_string, &serialized_size));
+    ASSERT_TRUE(serialized.get());
+    unsigned int compressed_size;
+    scoped_array<char> compressed(ModuleSerializer::CompressSerializedData(
+        serialized.get(), serialized_size, &compressed_size));
+    ASSERT_TRUE(compressed.get());
+
+    std::stringstream name;
+    name << "module" << module_index;
+    TestCodeModule module(name.str());
+    ASSERT_TRUE(fast_resolver.LoadModuleUsingMapBuffer(
+        &module, string(serialized.get(), serialized_size)));
+    ASSERT_TRUE(compressed_resolver.LoadModuleUsingMapBuffer(
+        &module, string(compressed.get(), compressed_size)));
+    ASSERT_FALSE(compressed_resolver.IsModuleCorrupt(&module));
+
+    // Only the compressed data takes memory until a lookup needs a map.
+    SourceLineResolverBase::ModuleMemoryUsage expected_usage;
+    ASSERT_TRUE(fast_resolver.GetModuleMemoryUsage(&module, &expected_usage));
+    ASSERT_LT(0U, expected_usage.functions);
+    ASSERT_EQ(0U, expected_usage.other);
+    SourceLineResolverBase::ModuleMemoryUsage usage;
+    ASSERT_TRUE(compressed_resolver.GetModuleMemoryUsage(&module, &usage));
+    ASSERT_EQ(0U, usage.functions);
+    ASSERT_LE(compressed_size, usage.other);
+
+    // Every lookup finds what it does in the uncompressed module.
+    for (uint64_t address = 0x800; address < 0x3d00; address += 0x10) {
+      StackFrame expected;
+      expected.instruction = address;
+      expected.module = &module;
+      fast_resolver.FillSourceLineInfo(&expected);
+      StackFrame frame;
+      frame.instruction = address;
+      frame.module = &module;
+      compressed_resolver.FillSourceLineInfo(&frame);
+      EXPECT_EQ(expected.function_name, frame.function_name);
+      EXPECT_EQ(expected.function_base, frame.function_base);
+      EXPECT_EQ(expected.source_file_name, frame.source_file_name);
+      EXPECT_EQ(expected.source_line, frame.source_line);
+
+      scoped_ptr<WindowsFrameInfo> expected_wfi(
+          fast_resolver.FindWindowsFrameInfo(&frame));
+      scoped_ptr<WindowsFrameInfo> wfi(
+          compressed_resolver.FindWindowsFrameInfo(&frame));
+      ASSERT_EQ(expected_wfi.get() != NULL, wfi.get() != NULL);
+      if (wfi.get()) {
+        EXPECT_EQ(expected_wfi->program_string, wfi->program_string);
+        EXPECT_EQ(expected_wfi->parameter_size, wfi->parameter_size);
+      }
+
+      scoped_ptr<CFIFrameInfo> expected_cfi(
+          fast_resolver.FindCFIFrameInfo(&frame));
+      scoped_ptr<CFIFrameInfo> cfi(
+          compressed_resolver.FindCFIFrameInfo(&frame));
+      ASSERT_EQ(expected_cfi.get() != NULL, cfi.get() != NULL);
+      if (cfi.get())
+        EXPECT_EQ(expected_cfi->Serialize(), cfi->Serialize());
+    }
+    ASSERT_TRUE(compressed_resolver.GetModuleMemoryUsage(&module, &usage));
+    ASSERT_EQ(expected_usage.functions, usage.functions);
+
+    // Lookups decompress maps, so they can't run concurrently.
+    EXPECT_TRUE(fast_resolver.CanLookUpConcurrently(&module));
+    EXPECT_FALSE(compressed_resolver.CanLookUpConcurrently(&module));
+
+    // A truncated directory loads as a corrupt module without symbols.
+    TestCodeModule truncated(name.str() + "-truncated");
+    ASSERT_TRUE(compressed_resolver.LoadModuleUsingMapBuffer(
+        &truncated, string(compressed.get(), 24)));
+    ASSERT_TRUE(compressed_resolver.IsModuleCorrupt(&truncated));
+    StackFrame frame;
+    frame.instruction = 0x1000;
+    frame.module = &truncated;
+    compressed_resolver.FillSourceLineInfo(&frame);
+    ASSERT_TRUE(frame.function_name.empty());
+  }
+}
+
+// Looks up every address in [kLookupStart, kLookupEnd) that is a multiple
+// of kLookupStep in |module|, storing the function name and CFI rules
+// found for each in |results|.
+const uint64_t kLookupStart = 0x800;
+const uint64_t kLookupEnd = 0x3d00;
+const uint64_t kLookupStep = 0x10;
+
+struct LookupThread {
+  FastSourceLineResolver *resolver;
+  const CodeModule *module;
+  std::vector<string> results;
+};
+
+void LookUpAddresses(LookupThread *lookup) {
+  lookup->results.clear();
+  for (uint64_t address = kLookupStart; address < kLookupEnd;
+       address += kLookupStep) {
+    StackFrame frame;
+    frame.instruction = address;
+    frame.module = lookup->module;
+    lookup->resolver->FillSourceLineInfo(&frame);
+    scoped_ptr<CFIFrameInfo> cfi(lookup->resolver->FindCFIFrameInfo(&frame));
+    scoped_ptr<WindowsFrameInfo> wfi(
+        lookup->resolver->FindWindowsFrameInfo(&frame));
+    std::stringstream result;
+    result << frame.function_name << " " << frame.source_line << " "
+           << (cfi.get() ? cfi->Serialize() : "-") << " "
+           << (wfi.get() ? wfi->parameter_size : 0);
+    lookup->results.push_back(result.str());
+  }
+}
+
+void *LookUpAddressesThread(void *lookup) {
+  LookUpAddresses(static_cast<LookupThread*>(lookup));
+  return NULL;
+}
+
+TEST_F(TestFastSourceLineResolver, TestCanLookUpConcurrently) {
+  TestCodeModule module1("module1");
+  ASSERT_FALSE(fast_resolver.CanLookUpConcurrently(&module1));
+  ASSERT_TRUE(basic_resolver.LoadModule(&module1, symbol_file(1)));
+  ASSERT_TRUE(serializer.ConvertOneModule(module1.code_file(),
+                                          &basic_resolver,
+                                          &fast_resolver));
+
+  // The fast resolver's lookups only read the serialized module, but the
+  // basic resolver's copy the linked_ptr objects that hold its records.
+  EXPECT_TRUE(fast_resolver.CanLookUpConcurrently(&module1));
+  EXPECT_FALSE(basic_resolver.CanLookUpConcurrently(&module1));
+  TestCodeModule module2("module2");
+  EXPECT_FALSE(fast_resolver.CanLookUpConcurrently(&module2));
+
+  // Threads looking up at once find what a single thread does.
+  LookupThread expected = { &fast_resolver, &module1 };
+  LookUpAddresses(&expected);
+  const int kThreadCount = 4;
+  LookupThread lookups[kThreadCount];
+  pthread_t threads[kThreadCount];
+  for (int i = 0; i < kThreadCount; ++i) {
+    lookups[i].resolver = &fast_resolver;
+    lookups[i].module = &module1;
+    ASSERT_EQ(0, pthread_create(&threads[i], NULL, LookUpAddressesThread,
+                                &lookups[i]));
+  }
+  for (int i = 0; i < kThreadCount; ++i) {
+    ASSERT_EQ(0, pthread_join(threads[i], NULL));
+    EXPECT_TRUE(expected.results == lookups[i].results);
+  }
+
+  // The frame cache is filled by lookups.
+  fast_resolver.set_frame_cache_size(16);
+  EXPECT_FALSE(fast_resolver.CanLookUpConcurrently(&module1));
+  fast_resolver.set_frame_cache_size(0);
+  EXPECT_TRUE(fast_resolver.CanLookUpConcurrently(&module1));
+}
+
 TEST_F(TestFastSourceLineResolver, CompareModule) {
   char *symbol_data;
   size_t symbol_data_size;
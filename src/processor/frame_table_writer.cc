@@ -0,0 +1,618 @@
+// Copyright (c) 2016 Google Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+// notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above
+// copyright notice, this list of conditions and the following disclaimer
+// in the documentation and/or other materials provided with the
+// distribution.
+//     * Neither the name of Google Inc. nor the names of its
+// contributors may be used to endorse or promote products derived from
+// this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+// frame_table_writer.cc: Implementation of FrameTableWriter.
+//
+// See frame_table_writer.h for documentation.
+//
+// Arrow messages carry their metadata as flatbuffers, which are built
+// here by hand after Arrow's Schema.fbs and Message.fbs, without the
+// flatbuffers library.
+
+#include "processor/frame_table_writer.h"
+
+#include <assert.h>
+#include <string.h>
+
+#include <algorithm>
+#include <utility>
+
+#include "google_breakpad/processor/call_stack.h"
+#include "google_breakpad/processor/code_module.h"
+#include "google_breakpad/processor/process_state.h"
+#include "google_breakpad/processor/stack_frame.h"
+
+namespace google_breakpad {
+
+namespace {
+
+using std::vector;
+
+// The columns, in schema order.
+enum {
+  kRequestColumn,
+  kMinidumpColumn,
+  kThreadColumn,
+  kRequestingColumn,
+  kFrameColumn,
+  kModuleColumn,
+  kModuleOffsetColumn,
+  kFunctionColumn,
+  kFunctionOffsetColumn,
+  kSourceFileColumn,
+  kSourceLineColumn,
+  kInstructionColumn,
+  kTrustColumn
+};
+
+// Values from Arrow's Schema.fbs and Message.fbs.
+const int16_t kMetadataVersionV5 = 4;
+const uint8_t kTypeInt = 2;
+const uint8_t kTypeUtf8 = 5;
+const uint8_t kTypeBool = 6;
+const uint8_t kMessageHeaderSchema = 1;
+const uint8_t kMessageHeaderDictionaryBatch = 2;
+const uint8_t kMessageHeaderRecordBatch = 3;
+
+// Marks the start of an encapsulated message, and with a zero length
+// following it, the end of the stream.
+const uint32_t kContinuation = 0xffffffff;
+
+const char *TrustName(StackFrame::FrameTrust trust) {
+  switch (trust) {
+    case StackFrame::FRAME_TRUST_CONTEXT:
+      return "context";
+    case StackFrame::FRAME_TRUST_PREWALKED:
+      return "prewalked";
+    case StackFrame::FRAME_TRUST_CFI:
+      return "cfi";
+    case StackFrame::FRAME_TRUST_CFI_SCAN:
+      return "cfi_scan";
+    case StackFrame::FRAME_TRUST_FP:
+      return "frame_pointer";
+    case StackFrame::FRAME_TRUST_SCAN:
+      return "scan";
+    default:
+      return "none";
+  }
+}
+
+// Returns the position in |path| of its last component, as
+// PathnameStripper::File would return it.
+size_t FileNameStart(const string &path) {
+  string::size_type slash = path.find_last_of("/\\");
+  return slash == string::npos ? 0 : slash + 1;
+}
+
+void AppendLittleEndian(uint64_t value, size_t size, vector<uint8_t> *bytes) {
+  for (size_t i = 0; i < size; ++i)
+    bytes->push_back(static_cast<uint8_t>(value >> (8 * i)));
+}
+
+// Pads |bytes| with zeros to a multiple of eight bytes, the alignment
+// Arrow expects of buffers and messages.
+void PadToEight(vector<uint8_t> *bytes) {
+  while (bytes->size() % 8 != 0)
+    bytes->push_back(0);
+}
+
+// Builds a flatbuffer from back to front, as the flatbuffers library
+// does: children are added before the tables that refer to them, and an
+// object is referred to by its offset from the end of the buffer.
+// |reversed_| holds the buffer's bytes in reverse order.
+class FlatBufferBuilder {
+ public:
+  FlatBufferBuilder() : min_align_(1), table_start_(0) {}
+
+  uint32_t CreateString(const string &value) {
+    PreAlign(value.size() + 1, 4);
+    reversed_.push_back(0);
+    for (size_t i = value.size(); i > 0; --i)
+      reversed_.push_back(static_cast<uint8_t>(value[i - 1]));
+    PushScalar(value.size(), 4);
+    return Size();
+  }
+
+  // Creates a vector of structs made of two int64s, as Arrow's FieldNode
+  // and Buffer are.
+  uint32_t CreateInt64PairVector(const vector<int64_t> &pairs) {
+    PreAlign(pairs.size() * 8, 8);
+    for (size_t i = pairs.size(); i > 0; --i)
+      PushScalar(pairs[i - 1], 8);
+    PushScalar(pairs.size() / 2, 4);
+    return Size();
+  }
+
+  uint32_t CreateOffsetVector(const vector<uint32_t> &offsets) {
+    PreAlign(offsets.size() * 4, 4);
+    for (size_t i = offsets.size(); i > 0; --i)
+      PushOffset(offsets[i - 1]);
+    PushScalar(offsets.size(), 4);
+    return Size();
+  }
+
+  void StartTable() {
+    fields_.clear();
+    table_start_ = Size();
+  }
+
+  // Add field |id| of the table being built.
+  void AddScalar(int id, uint64_t value, size_t size) {
+    Align(size);
+    PushScalar(value, size);
+    fields_.push_back(std::make_pair(id, Size()));
+  }
+  void AddOffset(int id, uint32_t offset) {
+    PushOffset(offset);
+    fields_.push_back(std::make_pair(id, Size()));
+  }
+
+  // Finishes the table, writing its vtable in front of it, and returns
+  // its offset.
+  uint32_t EndTable() {
+    Align(4);
+    PushScalar(0, 4);
+    uint32_t table = Size();
+    int max_id = -1;
+    for (size_t i = 0; i < fields_.size(); ++i)
+      max_id = std::max(max_id, fields_[i].first);
+    vector<uint16_t> field_offsets(max_id + 1, 0);
+    for (size_t i = 0; i < fields_.size(); ++i)
+      field_offsets[fields_[i].first] = table - fields_[i].second;
+    for (size_t i = field_offsets.size(); i > 0; --i)
+      PushScalar(field_offsets[i - 1], 2);
+    PushScalar(table - table_start_, 2);
+    PushScalar(4 + 2 * field_offsets.size(), 2);
+
+    // The table starts with the offset back to its vtable.
+    uint32_t vtable_distance = Size() - table;
+    for (size_t i = 0; i < 4; ++i) {
+      reversed_[table - 1 - i] =
+          static_cast<uint8_t>(vtable_distance >> (8 * i));
+    }
+    return table;
+  }
+
+  // Returns the finished buffer, whose root is the table at |root|.
+  string Finish(uint32_t root) {
+    PreAlign(4, min_align_);
+    PushOffset(root);
+    return string(reversed_.rbegin(), reversed_.rend());
+  }
+
+ private:
+  uint32_t Size() const { return static_cast<uint32_t>(reversed_.size()); }
+
+  void PushScalar(uint64_t value, size_t size) {
+    for (size_t i = size; i > 0; --i)
+      reversed_.push_back(static_cast<uint8_t>(value >> (8 * (i - 1))));
+  }
+
+  // Pushes the offset from the pushed value to the object at |offset|.
+  void PushOffset(uint32_t offset) {
+    Align(4);
+    PushScalar(Size() + 4 - offset, 4);
+  }
+
+  // Pads so that |size| bytes pushed next end aligned to |alignment|.
+  void PreAlign(size_t size, size_t alignment) {
+    min_align_ = std::max(min_align_, alignment);
+    while ((reversed_.size() + size) % alignment != 0)
+      reversed_.push_back(0);
+  }
+  void Align(size_t alignment) { PreAlign(0, alignment); }
+
+  vector<uint8_t> reversed_;
+  size_t min_align_;
+
+  // The fields of the table being built, with the size of the buffer
+  // after each was pushed, and the size before the table's first field.
+  vector<std::pair<int, uint32_t> > fields_;
+  uint32_t table_start_;
+};
+
+// Creates an Int type table.
+uint32_t CreateIntType(FlatBufferBuilder *builder, int bit_width,
+                       bool is_signed) {
+  builder->StartTable();
+  builder->AddScalar(0, bit_width, 4);  // bitWidth
+  builder->AddScalar(1, is_signed, 1);  // is_signed
+  return builder->EndTable();
+}
+
+// Creates a Message table whose header is |header| of type
+// |header_type|.
+uint32_t CreateMessage(FlatBufferBuilder *builder, uint8_t header_type,
+                       uint32_t header, size_t body_length) {
+  builder->StartTable();
+  builder->AddScalar(3, body_length, 8);  // bodyLength
+  builder->AddOffset(2, header);  // header
+  builder->AddScalar(0, kMetadataVersionV5, 2);  // version
+  builder->AddScalar(1, header_type, 1);  // header_type
+  return builder->EndTable();
+}
+
+// Creates a RecordBatch table of |length| rows.  |nodes| and |buffers|
+// hold the int64 pairs of the FieldNode and Buffer structs.
+uint32_t CreateRecordBatch(FlatBufferBuilder *builder, size_t length,
+                           const vector<int64_t> &nodes,
+                           const vector<int64_t> &buffers) {
+  uint32_t node_vector = builder->CreateInt64PairVector(nodes);
+  uint32_t buffer_vector = builder->CreateInt64PairVector(buffers);
+  builder->StartTable();
+  builder->AddScalar(0, length, 8);  // length
+  builder->AddOffset(1, node_vector);  // nodes
+  builder->AddOffset(2, buffer_vector);  // buffers
+  return builder->EndTable();
+}
+
+// Appends |data| to |body| as a buffer, and its position to |buffers|.
+void AddBuffer(const vector<uint8_t> &data, vector<uint8_t> *body,
+               vector<int64_t> *buffers) {
+  buffers->push_back(body->size());
+  buffers->push_back(data.size());
+  body->insert(body->end(), data.begin(), data.end());
+  PadToEight(body);
+}
+
+}  // namespace
+
+FrameTableWriter::FrameTableWriter(FILE *file, size_t batch_rows)
+    : file_(file),
+      batch_rows_(batch_rows),
+      rows_(0),
+      row_count_(0),
+      schema_written_(false),
+      error_(false) {
+  assert(file_);
+  assert(batch_rows_ > 0);
+  AddColumn("request", COLUMN_UINT64, false);
+  AddColumn("minidump", COLUMN_STRING, true);
+  AddColumn("thread", COLUMN_INT32, false);
+  AddColumn("requesting", COLUMN_BOOL, false);
+  AddColumn("frame", COLUMN_INT32, false);
+  AddColumn("module", COLUMN_STRING, true);
+  AddColumn("module_offset", COLUMN_UINT64, true);
+  AddColumn("function", COLUMN_STRING, true);
+  AddColumn("function_offset", COLUMN_UINT64, true);
+  AddColumn("source_file", COLUMN_STRING, true);
+  AddColumn("source_line", COLUMN_INT32, true);
+  AddColumn("instruction", COLUMN_UINT64, false);
+  AddColumn("trust", COLUMN_STRING, false);
+}
+
+void FrameTableWriter::AddColumn(const char *name, ColumnType type,
+                                 bool nullable) {
+  Column column(name, type, nullable);
+  if (type == COLUMN_STRING) {
+    column.dictionary = dictionaries_.size();
+    dictionaries_.push_back(Dictionary());
+  }
+  columns_.push_back(column);
+}
+
+bool FrameTableWriter::Add(const ProcessState &process_state,
+                           uint64_t request,
+                           const string &minidump_path) {
+  string module_name;
+  const vector<CallStack*> *threads = process_state.threads();
+  for (size_t thread_index = 0; thread_index < threads->size();
+       ++thread_index) {
+    const vector<StackFrame*> *frames = threads->at(thread_index)->frames();
+    for (size_t frame_index = 0; frame_index < frames->size();
+         ++frame_index) {
+      const StackFrame *frame = frames->at(frame_index);
+      uint64_t instruction_address = frame->ReturnAddress();
+
+      AppendUInt64(kRequestColumn, request);
+      if (minidump_path.empty())
+        AppendNull(kMinidumpColumn);
+      else
+        AppendString(kMinidumpColumn, minidump_path.data(),
+                     minidump_path.size());
+      AppendInt32(kThreadColumn, thread_index);
+      AppendBool(kRequestingColumn,
+                 static_cast<int>(thread_index) ==
+                     process_state.requesting_thread());
+      AppendInt32(kFrameColumn, frame_index);
+
+      if (frame->module) {
+        const string &code_file = frame->module->code_file();
+        size_t start = FileNameStart(code_file);
+        AppendString(kModuleColumn, code_file.data() + start,
+                     code_file.size() - start);
+        AppendUInt64(kModuleOffsetColumn,
+                     instruction_address - frame->module->base_address());
+      } else {
+        AppendNull(kModuleColumn);
+        AppendNull(kModuleOffsetColumn);
+      }
+
+      const char *function_name = frame->FunctionName();
+      if (function_name[0] != '\0') {
+        AppendString(kFunctionColumn, function_name, strlen(function_name));
+        AppendUInt64(kFunctionOffsetColumn,
+                     instruction_address - frame->function_base);
+      } else {
+        AppendNull(kFunctionColumn);
+        AppendNull(kFunctionOffsetColumn);
+      }
+
+      const char *source_file_name = frame->SourceFileName();
+      if (source_file_name[0] != '\0') {
+        AppendString(kSourceFileColumn, source_file_name,
+                     strlen(source_file_name));
+        AppendInt32(kSourceLineColumn, frame->source_line);
+      } else {
+        AppendNull(kSourceFileColumn);
+        AppendNull(kSourceLineColumn);
+      }
+
+      AppendUInt64(kInstructionColumn, instruction_address);
+      const char *trust = TrustName(frame->trust);
+      AppendString(kTrustColumn, trust, strlen(trust));
+
+      ++rows_;
+      ++row_count_;
+      if (rows_ >= batch_rows_ && !WriteBatch())
+        return false;
+    }
+  }
+  return !error_;
+}
+
+bool FrameTableWriter::Finish() {
+  // A stream holds at least one record batch, so that the dictionaries
+  // are sent even if no rows were added.
+  if ((rows_ > 0 || !schema_written_) && !WriteBatch())
+    return false;
+  vector<uint8_t> end;
+  AppendLittleEndian(kContinuation, 4, &end);
+  AppendLittleEndian(0, 4, &end);
+  if (!error_ && fwrite(&end[0], 1, end.size(), file_) != end.size())
+    error_ = true;
+  if (!error_ && fflush(file_) != 0)
+    error_ = true;
+  return !error_;
+}
+
+void FrameTableWriter::AppendInt32(size_t column, int32_t value) {
+  Column *c = &columns_[column];
+  AppendLittleEndian(static_cast<uint32_t>(value), 4, &c->values);
+  SetValid(c, true);
+}
+
+void FrameTableWriter::AppendUInt64(size_t column, uint64_t value) {
+  Column *c = &columns_[column];
+  AppendLittleEndian(value, 8, &c->values);
+  SetValid(c, true);
+}
+
+void FrameTableWriter::AppendBool(size_t column, bool value) {
+  Column *c = &columns_[column];
+  if (rows_ % 8 == 0)
+    c->values.push_back(0);
+  if (value)
+    c->values.back() |= 1 << (rows_ % 8);
+  SetValid(c, true);
+}
+
+void FrameTableWriter::AppendString(size_t column, const char *value,
+                                    size_t length) {
+  Column *c = &columns_[column];
+  Dictionary *dictionary = &dictionaries_[c->dictionary];
+  std::pair<unordered_map<string, int32_t>::iterator, bool> inserted =
+      dictionary->indices.insert(
+          std::make_pair(string(value, length),
+                         static_cast<int32_t>(dictionary->values.size())));
+  if (inserted.second)
+    dictionary->values.push_back(inserted.first->first);
+  AppendLittleEndian(static_cast<uint32_t>(inserted.first->second), 4,
+                     &c->values);
+  SetValid(c, true);
+}
+
+void FrameTableWriter::AppendNull(size_t column) {
+  Column *c = &columns_[column];
+  assert(c->nullable);
+  switch (c->type) {
+    case COLUMN_UINT64:
+      c->values.insert(c->values.end(), 8, 0);
+      break;
+    case COLUMN_BOOL:
+      if (rows_ % 8 == 0)
+        c->values.push_back(0);
+      break;
+    default:
+      c->values.insert(c->values.end(), 4, 0);
+      break;
+  }
+  SetValid(c, false);
+  ++c->null_count;
+}
+
+void FrameTableWriter::SetValid(Column *column, bool valid) {
+  if (!column->nullable)
+    return;
+  if (rows_ % 8 == 0)
+    column->validity.push_back(0);
+  if (valid)
+    column->validity.back() |= 1 << (rows_ % 8);
+}
+
+bool FrameTableWriter::WriteBatch() {
+  if (error_)
+    return false;
+  if (!schema_written_)
+    WriteSchema();
+  for (size_t i = 0; i < dictionaries_.size(); ++i) {
+    if (!schema_written_ ||
+        dictionaries_[i].written < dictionaries_[i].values.size()) {
+      WriteDictionary(i, schema_written_);
+    }
+  }
+  schema_written_ = true;
+
+  vector<int64_t> nodes;
+  vector<int64_t> buffers;
+  vector<uint8_t> body;
+  vector<uint8_t> no_validity;
+  for (size_t i = 0; i < columns_.size(); ++i) {
+    Column *column = &columns_[i];
+    nodes.push_back(rows_);
+    nodes.push_back(column->null_count);
+    // A column without nulls needs no validity bitmap.
+    AddBuffer(column->null_count ? column->validity : no_validity, &body,
+              &buffers);
+    AddBuffer(column->values, &body, &buffers);
+    column->values.clear();
+    column->validity.clear();
+    column->null_count = 0;
+  }
+
+  FlatBufferBuilder builder;
+  uint32_t batch = CreateRecordBatch(&builder, rows_, nodes, buffers);
+  WriteMessage(builder.Finish(CreateMessage(&builder,
+                                            kMessageHeaderRecordBatch,
+                                            batch, body.size())),
+               body);
+  rows_ = 0;
+  return !error_;
+}
+
+void FrameTableWriter::WriteSchema() {
+  FlatBufferBuilder builder;
+  vector<uint32_t> fields;
+  for (size_t i = 0; i < columns_.size(); ++i) {
+    const Column &column = columns_[i];
+    uint32_t name = builder.CreateString(column.name);
+    uint32_t children = builder.CreateOffsetVector(vector<uint32_t>());
+    uint8_t type_type;
+    uint32_t type;
+    uint32_t dictionary = 0;
+    switch (column.type) {
+      case COLUMN_INT32:
+        type_type = kTypeInt;
+        type = CreateIntType(&builder, 32, true);
+        break;
+      case COLUMN_UINT64:
+        type_type = kTypeInt;
+        type = CreateIntType(&builder, 64, false);
+        break;
+      case COLUMN_BOOL:
+        type_type = kTypeBool;
+        builder.StartTable();
+        type = builder.EndTable();
+        break;
+      default: {
+        // The field's type is that of the dictionary's values.
+        type_type = kTypeUtf8;
+        builder.StartTable();
+        type = builder.EndTable();
+        uint32_t index_type = CreateIntType(&builder, 32, true);
+        builder.StartTable();
+        builder.AddScalar(0, column.dictionary, 8);  // id
+        builder.AddOffset(1, index_type);  // indexType
+        dictionary = builder.EndTable();
+        break;
+      }
+    }
+    builder.StartTable();
+    builder.AddOffset(0, name);  // name
+    builder.AddOffset(3, type);  // type
+    if (dictionary)
+      builder.AddOffset(4, dictionary);  // dictionary
+    builder.AddOffset(5, children);  // children
+    builder.AddScalar(1, column.nullable, 1);  // nullable
+    builder.AddScalar(2, type_type, 1);  // type_type
+    fields.push_back(builder.EndTable());
+  }
+  uint32_t field_vector = builder.CreateOffsetVector(fields);
+  builder.StartTable();
+  builder.AddOffset(1, field_vector);  // fields
+  uint32_t schema = builder.EndTable();
+  WriteMessage(builder.Finish(CreateMessage(&builder, kMessageHeaderSchema,
+                                            schema, 0)),
+               vector<uint8_t>());
+}
+
+void FrameTableWriter::WriteDictionary(int id, bool delta) {
+  Dictionary *dictionary = &dictionaries_[id];
+  size_t count = dictionary->values.size() - dictionary->written;
+  vector<uint8_t> offsets;
+  vector<uint8_t> data;
+  AppendLittleEndian(0, 4, &offsets);
+  for (size_t i = dictionary->written; i < dictionary->values.size(); ++i) {
+    const string &value = dictionary->values[i];
+    data.insert(data.end(), value.begin(), value.end());
+    AppendLittleEndian(data.size(), 4, &offsets);
+  }
+  dictionary->written = dictionary->values.size();
+
+  vector<int64_t> nodes;
+  nodes.push_back(count);
+  nodes.push_back(0);
+  vector<int64_t> buffers;
+  vector<uint8_t> body;
+  AddBuffer(vector<uint8_t>(), &body, &buffers);
+  AddBuffer(offsets, &body, &buffers);
+  AddBuffer(data, &body, &buffers);
+
+  FlatBufferBuilder builder;
+  uint32_t batch = CreateRecordBatch(&builder, count, nodes, buffers);
+  builder.StartTable();
+  builder.AddScalar(0, id, 8);  // id
+  builder.AddOffset(1, batch);  // data
+  builder.AddScalar(2, delta, 1);  // isDelta
+  uint32_t dictionary_batch = builder.EndTable();
+  WriteMessage(builder.Finish(CreateMessage(&builder,
+                                            kMessageHeaderDictionaryBatch,
+                                            dictionary_batch, body.size())),
+               body);
+}
+
+void FrameTableWriter::WriteMessage(const string &metadata,
+                                    const vector<uint8_t> &body) {
+  if (error_)
+    return;
+  vector<uint8_t> header;
+  AppendLittleEndian(kContinuation, 4, &header);
+  // The metadata is padded so that the body starts aligned.
+  size_t padded_size = (metadata.size() + 7) / 8 * 8;
+  AppendLittleEndian(padded_size, 4, &header);
+  header.insert(header.end(), metadata.begin(), metadata.end());
+  header.resize(8 + padded_size, 0);
+  if (fwrite(&header[0], 1, header.size(), file_) != header.size() ||
+      (!body.empty() &&
+       fwrite(&body[0], 1, body.size(), file_) != body.size())) {
+    error_ = true;
+  }
+}
+
+}  // namespace google_breakpad
@@ -0,0 +1,183 @@
+// Copyright (c) 2016 Google Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+// notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above
+// copyright notice, this list of conditions and the following disclaimer
+// in the documentation and/or other materials provided with the
+// distribution.
+//     * Neither the name of Google Inc. nor the names of its
+// contributors may be used to endorse or promote products derived from
+// this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+// frame_table_writer.h: FrameTableWriter, which writes the stack frames of
+// many process states as one table in the Apache Arrow IPC stream format.
+//
+// Analytics systems ingest columnar data far faster than they parse the
+// text or JSON output of minidump_stackwalk, and the names in stack
+// frames repeat heavily across minidumps of the same builds.  The writer
+// buffers one row per frame across process states, and writes a record
+// batch each time enough rows have collected.  Module, function, source
+// file and other string columns are dictionary encoded: each distinct
+// string is written once, in the first dictionary batch that needs it,
+// and later batches only send the strings that are new (delta
+// dictionaries).
+//
+// The table has these columns, matching the machine-readable output of
+// minidump_stackwalk.  Offsets are null when the frame has no module or
+// function, and the source line is null when it has no source file.
+//
+//   request          uint64     caller-assigned number of the minidump
+//   minidump         utf8 dict  path of the minidump, null if unknown
+//   thread           int32      index of the thread in the process state
+//   requesting       bool       whether the thread requested the dump
+//   frame            int32      index of the frame in its stack
+//   module           utf8 dict  file name of the frame's module
+//   module_offset    uint64
+//   function         utf8 dict
+//   function_offset  uint64
+//   source_file      utf8 dict
+//   source_line      int32
+//   instruction      uint64     the frame's return address
+//   trust            utf8 dict  how the frame was found, as in JSON output
+//
+// The stream needs no Arrow library to write; it can be read with any
+// Arrow implementation's stream reader, e.g. pyarrow.ipc.open_stream.
+
+#ifndef PROCESSOR_FRAME_TABLE_WRITER_H__
+#define PROCESSOR_FRAME_TABLE_WRITER_H__
+
+#include <stddef.h>
+#include <stdio.h>
+
+#include <string>
+#include <vector>
+
+#include "common/unordered.h"
+#include "common/using_std_string.h"
+#include "google_breakpad/common/breakpad_types.h"
+
+namespace google_breakpad {
+
+class ProcessState;
+
+class FrameTableWriter {
+ public:
+  // The number of rows buffered before a record batch is written.
+  static const size_t kDefaultBatchRows = 64 * 1024;
+
+  // Writes to |file|, which the writer does not take ownership of, in
+  // record batches of |batch_rows| rows.
+  FrameTableWriter(FILE *file, size_t batch_rows);
+
+  // Adds a row for every frame of every thread of |process_state|,
+  // processed from the minidump at |minidump_path|, which may be empty.
+  // Returns false if a record batch had to be written and writing
+  // failed; nothing more is written then.
+  bool Add(const ProcessState &process_state,
+           uint64_t request,
+           const string &minidump_path);
+
+  // Writes the rows still buffered and the end of the stream.  Returns
+  // false if writing failed.  The writer may not be used afterwards.
+  bool Finish();
+
+  // The number of rows added so far.
+  uint64_t row_count() const { return row_count_; }
+
+ private:
+  enum ColumnType {
+    COLUMN_INT32,
+    COLUMN_UINT64,
+    COLUMN_BOOL,
+    COLUMN_STRING  // Dictionary encoded, with int32 indices.
+  };
+
+  struct Dictionary {
+    Dictionary() : written(0) {}
+
+    unordered_map<string, int32_t> indices;
+    std::vector<string> values;
+
+    // The number of values already sent in dictionary batches.
+    size_t written;
+  };
+
+  struct Column {
+    Column(const char *name, ColumnType type, bool nullable)
+        : name(name), type(type), nullable(nullable), dictionary(-1),
+          null_count(0) {}
+
+    const char *name;
+    ColumnType type;
+    bool nullable;
+
+    // The index in dictionaries_ of a COLUMN_STRING's dictionary, which
+    // is also its dictionary id in the stream.
+    int dictionary;
+
+    // Little-endian values of the rows buffered, or a bitmap of them for
+    // COLUMN_BOOL, and a bitmap of the rows that are not null.
+    std::vector<uint8_t> values;
+    std::vector<uint8_t> validity;
+    size_t null_count;
+  };
+
+  void AddColumn(const char *name, ColumnType type, bool nullable);
+
+  // Append a value, or a null, to column |column| of the current row.
+  void AppendInt32(size_t column, int32_t value);
+  void AppendUInt64(size_t column, uint64_t value);
+  void AppendBool(size_t column, bool value);
+  void AppendString(size_t column, const char *value, size_t length);
+  void AppendNull(size_t column);
+  void SetValid(Column *column, bool valid);
+
+  // Writes the schema if it hasn't been, the dictionary values added
+  // since the last batch, and a record batch of the rows buffered.
+  bool WriteBatch();
+
+  void WriteSchema();
+  void WriteDictionary(int id, bool delta);
+
+  // Writes an encapsulated message with the flatbuffer |metadata| and
+  // |body|.
+  void WriteMessage(const string &metadata, const std::vector<uint8_t> &body);
+
+  FILE *file_;
+  size_t batch_rows_;
+  std::vector<Column> columns_;
+  std::vector<Dictionary> dictionaries_;
+
+  // The rows buffered, and added in total.
+  size_t rows_;
+  uint64_t row_count_;
+
+  bool schema_written_;
+  bool error_;
+
+  // Disallow copy constructor and assignment operator.
+  FrameTableWriter(const FrameTableWriter&);
+  void operator=(const FrameTableWriter&);
+};
+
+}  // namespace google_breakpad
+
+#endif  // PROCESSOR_FRAME_TABLE_WRITER_H__
@@ -0,0 +1,274 @@
+// Copyright (c) 2016 Google Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+// notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above
+// copyright notice, this list of conditions and the following disclaimer
+// in the documentation and/or other materials provided with the
+// distribution.
+//     * Neither the name of Google Inc. nor the names of its
+// contributors may be used to endorse or promote products derived from
+// this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+// frame_table_writer_unittest.cc: Unit tests for FrameTableWriter.
+//
+// The stream is read back with a minimal reader of the Arrow message
+// framing and the flatbuffer fields the tests look at.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <string>
+#include <vector>
+
+#include "breakpad_googletest_includes.h"
+#include "common/using_std_string.h"
+#include "google_breakpad/processor/basic_source_line_resolver.h"
+#include "google_breakpad/processor/call_stack.h"
+#include "google_breakpad/processor/minidump_processor.h"
+#include "google_breakpad/processor/process_state.h"
+#include "processor/frame_table_writer.h"
+#include "processor/simple_symbol_supplier.h"
+
+namespace {
+
+using google_breakpad::BasicSourceLineResolver;
+using google_breakpad::FrameTableWriter;
+using google_breakpad::MinidumpProcessor;
+using google_breakpad::ProcessState;
+using google_breakpad::SimpleSymbolSupplier;
+using std::vector;
+
+const int kMessageHeaderSchema = 1;
+const int kMessageHeaderDictionaryBatch = 2;
+const int kMessageHeaderRecordBatch = 3;
+
+// The number of dictionary encoded columns.
+const size_t kDictionaryCount = 5;
+
+string TestDataDir() {
+  return string(getenv("srcdir") ? getenv("srcdir") : ".") +
+      "/src/processor/testdata";
+}
+
+uint64_t ReadLittleEndian(const string &buffer, size_t position,
+                          size_t size) {
+  uint64_t value = 0;
+  for (size_t i = size; i > 0; --i)
+    value = (value << 8) | static_cast<uint8_t>(buffer[position + i - 1]);
+  return value;
+}
+
+// Returns the position of field |id| of the flatbuffer table at |table|,
+// or 0 if the field is absent.
+size_t FieldPosition(const string &buffer, size_t table, int id) {
+  size_t vtable = table - static_cast<int32_t>(
+      ReadLittleEndian(buffer, table, 4));
+  size_t vtable_size = ReadLittleEndian(buffer, vtable, 2);
+  if (4 + 2 * static_cast<size_t>(id) >= vtable_size)
+    return 0;
+  size_t offset = ReadLittleEndian(buffer, vtable + 4 + 2 * id, 2);
+  return offset ? table + offset : 0;
+}
+
+uint64_t ScalarField(const string &buffer, size_t table, int id,
+                     size_t size) {
+  size_t position = FieldPosition(buffer, table, id);
+  return position ? ReadLittleEndian(buffer, position, size) : 0;
+}
+
+// Returns the position of the table field |id| of |table| refers to.
+size_t TableField(const string &buffer, size_t table, int id) {
+  size_t position = FieldPosition(buffer, table, id);
+  EXPECT_NE(0U, position);
+  return position + ReadLittleEndian(buffer, position, 4);
+}
+
+// An encapsulated message read back from the stream.
+struct Message {
+  int header_type;
+  // The RecordBatch, or the DictionaryBatch's RecordBatch.
+  uint64_t length;
+  uint64_t dictionary_id;
+  bool delta;
+  string body;
+};
+
+// Reads the messages of |stream| into |messages|, checking their framing.
+bool ReadMessages(const string &stream, vector<Message> *messages) {
+  size_t position = 0;
+  for (;;) {
+    if (position + 8 > stream.size() ||
+        ReadLittleEndian(stream, position, 4) != 0xffffffff) {
+      return false;
+    }
+    size_t metadata_size = ReadLittleEndian(stream, position + 4, 4);
+    position += 8;
+    if (metadata_size == 0)
+      return position == stream.size();
+    if (metadata_size % 8 != 0 || position + metadata_size > stream.size())
+      return false;
+    string metadata = stream.substr(position, metadata_size);
+    position += metadata_size;
+
+    Message message;
+    size_t root = ReadLittleEndian(metadata, 0, 4);
+    EXPECT_EQ(4U, ScalarField(metadata, root, 0, 2));  // version
+    message.header_type = ScalarField(metadata, root, 1, 1);
+    size_t body_length = ScalarField(metadata, root, 3, 8);
+    if (body_length % 8 != 0 || position + body_length > stream.size())
+      return false;
+    message.body = stream.substr(position, body_length);
+    position += body_length;
+
+    message.length = 0;
+    message.dictionary_id = 0;
+    message.delta = false;
+    if (message.header_type != kMessageHeaderSchema) {
+      size_t header = TableField(metadata, root, 2);
+      size_t batch = header;
+      if (message.header_type == kMessageHeaderDictionaryBatch) {
+        message.dictionary_id = ScalarField(metadata, header, 0, 8);
+        message.delta = ScalarField(metadata, header, 2, 1);
+        batch = TableField(metadata, header, 1);
+      }
+      message.length = ScalarField(metadata, batch, 0, 8);
+    }
+    messages->push_back(message);
+  }
+}
+
+class FrameTableWriterTest : public ::testing::Test {
+ public:
+  void SetUp() {
+    file_ = NULL;
+    SimpleSymbolSupplier supplier(TestDataDir() + "/symbols");
+    BasicSourceLineResolver resolver;
+    MinidumpProcessor processor(&supplier, &resolver);
+    ASSERT_EQ(google_breakpad::PROCESS_OK,
+              processor.Process(TestDataDir() + "/minidump2.dmp", &state_));
+    frame_count_ = 0;
+    for (size_t i = 0; i < state_.threads()->size(); ++i)
+      frame_count_ += state_.threads()->at(i)->frames()->size();
+    file_ = tmpfile();
+    ASSERT_TRUE(file_);
+  }
+
+  void TearDown() {
+    if (file_)
+      fclose(file_);
+  }
+
+  string Contents() {
+    string contents;
+    rewind(file_);
+    char buffer[4096];
+    size_t read;
+    while ((read = fread(buffer, 1, sizeof(buffer), file_)) > 0)
+      contents.append(buffer, read);
+    return contents;
+  }
+
+  ProcessState state_;
+  size_t frame_count_;
+  FILE *file_;
+};
+
+TEST_F(FrameTableWriterTest, WritesBatchesAcrossProcessStates) {
+  FrameTableWriter writer(file_, frame_count_);
+  ASSERT_TRUE(writer.Add(state_, 1, "first.dmp"));
+  ASSERT_TRUE(writer.Add(state_, 2, "second.dmp"));
+  ASSERT_TRUE(writer.Finish());
+  EXPECT_EQ(2 * frame_count_, writer.row_count());
+
+  string stream = Contents();
+  vector<Message> messages;
+  ASSERT_TRUE(ReadMessages(stream, &messages));
+  ASSERT_GT(messages.size(), 1 + kDictionaryCount);
+  EXPECT_EQ(kMessageHeaderSchema, messages[0].header_type);
+
+  // Every dictionary is sent whole before the first record batch, and
+  // only the minidump path is new after that.
+  for (size_t i = 0; i < kDictionaryCount; ++i) {
+    EXPECT_EQ(kMessageHeaderDictionaryBatch, messages[1 + i].header_type);
+    EXPECT_EQ(i, messages[1 + i].dictionary_id);
+    EXPECT_FALSE(messages[1 + i].delta);
+  }
+  uint64_t rows = 0;
+  int deltas = 0;
+  for (size_t i = 1 + kDictionaryCount; i < messages.size(); ++i) {
+    if (messages[i].header_type == kMessageHeaderRecordBatch) {
+      EXPECT_EQ(frame_count_, messages[i].length);
+      rows += messages[i].length;
+    } else {
+      ASSERT_EQ(kMessageHeaderDictionaryBatch, messages[i].header_type);
+      EXPECT_TRUE(messages[i].delta);
+      EXPECT_EQ(0U, messages[i].dictionary_id);
+      EXPECT_EQ(1U, messages[i].length);
+      ++deltas;
+    }
+  }
+  EXPECT_EQ(writer.row_count(), rows);
+  EXPECT_EQ(1, deltas);
+
+  // Names are written once however many frames share them.
+  const string kModule = "kernel32.dll";
+  size_t found = stream.find(kModule);
+  EXPECT_NE(string::npos, found);
+  EXPECT_EQ(string::npos, stream.find(kModule, found + 1));
+}
+
+TEST_F(FrameTableWriterTest, WritesColumnBuffers) {
+  FrameTableWriter writer(file_, FrameTableWriter::kDefaultBatchRows);
+  ASSERT_TRUE(writer.Add(state_, 1, string()));
+  ASSERT_TRUE(writer.Finish());
+
+  vector<Message> messages;
+  ASSERT_TRUE(ReadMessages(Contents(), &messages));
+  ASSERT_EQ(2 + kDictionaryCount, messages.size());
+  const Message &batch = messages.back();
+  ASSERT_EQ(kMessageHeaderRecordBatch, batch.header_type);
+  EXPECT_EQ(frame_count_, batch.length);
+
+  // The minidump path is null in every row, and its dictionary empty.
+  EXPECT_EQ(0U, messages[1].length);
+
+  // The first column holds the request number, and has no validity
+  // bitmap, so its values start the body.
+  ASSERT_GE(batch.body.size(), 8 * frame_count_);
+  for (size_t i = 0; i < frame_count_; ++i)
+    EXPECT_EQ(1U, ReadLittleEndian(batch.body, 8 * i, 8));
+}
+
+TEST_F(FrameTableWriterTest, WritesEmptyStream) {
+  FrameTableWriter writer(file_, FrameTableWriter::kDefaultBatchRows);
+  ASSERT_TRUE(writer.Finish());
+  EXPECT_EQ(0U, writer.row_count());
+
+  vector<Message> messages;
+  ASSERT_TRUE(ReadMessages(Contents(), &messages));
+  ASSERT_EQ(2 + kDictionaryCount, messages.size());
+  EXPECT_EQ(kMessageHeaderRecordBatch, messages.back().header_type);
+  EXPECT_EQ(0U, messages.back().length);
+  EXPECT_TRUE(messages.back().body.empty());
+}
+
+}  // namespace
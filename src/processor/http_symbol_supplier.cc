@@ -0,0 +1,525 @@
+// Copyright (c) 2016 Google Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+// notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above
+// copyright notice, this list of conditions and the following disclaimer
+// in the documentation and/or other materials provided with the
+// distribution.
+//     * Neither the name of Google Inc. nor the names of its
+// contributors may be used to endorse or promote products derived from
+// this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+// http_symbol_supplier.cc: Implementation of HTTPSymbolSupplier.
+//
+// See http_symbol_supplier.h for documentation.
+
+#include "processor/http_symbol_supplier.h"
+
+#include <assert.h>
+#include <dirent.h>
+#include <dlfcn.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+#include <utime.h>
+
+#include <algorithm>
+#include <utility>
+
+#include "common/scoped_ptr.h"
+#include "processor/logging.h"
+#include "processor/mutex.h"
+#include "third_party/curl/curl.h"
+
+namespace google_breakpad {
+
+namespace {
+
+const char kSymbolExtension[] = ".sym";
+const char kMappableExtension[] = ".sym.fast";
+
+bool EndsWith(const string &s, const char *suffix) {
+  size_t suffix_length = strlen(suffix);
+  return s.size() > suffix_length &&
+         s.compare(s.size() - suffix_length, suffix_length, suffix) == 0;
+}
+
+// Returns true if |relative_path|, which comes from the debug file name
+// and identifier recorded in a minidump, names a file inside the cache:
+// exactly a directory for the debug file, one for the identifier and the
+// symbol file, none of them empty, "." or "..".
+bool IsSafeCachePath(const string &relative_path) {
+  const int kComponents = 3;
+  int components = 0;
+  size_t start = 0;
+  while (start <= relative_path.size()) {
+    size_t slash = relative_path.find('/', start);
+    if (slash == string::npos)
+      slash = relative_path.size();
+    string component = relative_path.substr(start, slash - start);
+    if (component.empty() || component == "." || component == ".." ||
+        ++components > kComponents) {
+      return false;
+    }
+    start = slash + 1;
+  }
+  return components == kComponents;
+}
+
+// Creates the directory that will hold |path|, and any missing parents.
+bool MakeParentDirectories(const string &path) {
+  size_t slash = path.find('/', 1);
+  while (slash != string::npos) {
+    string dir = path.substr(0, slash);
+    if (mkdir(dir.c_str(), 0777) != 0 && errno != EEXIST) {
+      BPLOG(ERROR) << "Could not create directory " << dir << ": "
+                   << strerror(errno);
+      return false;
+    }
+    slash = path.find('/', slash + 1);
+  }
+  return true;
+}
+
+size_t WriteToFile(char *data, size_t size, size_t count, void *file) {
+  return fwrite(data, 1, size * count, static_cast<FILE*>(file));
+}
+
+// A cached file found by ScanCache.
+struct ScannedFile {
+  time_t last_used;
+  string path;
+  uint64_t size;
+
+  bool operator<(const ScannedFile &that) const {
+    return last_used < that.last_used ||
+           (last_used == that.last_used && path < that.path);
+  }
+};
+
+void FindCachedFiles(const string &dir, vector<ScannedFile> *files) {
+  DIR *handle = opendir(dir.c_str());
+  if (!handle)
+    return;
+
+  vector<string> entries;
+  struct dirent *entry;
+  while ((entry = readdir(handle)) != NULL) {
+    if (strcmp(entry->d_name, ".") != 0 && strcmp(entry->d_name, "..") != 0)
+      entries.push_back(entry->d_name);
+  }
+  closedir(handle);
+
+  for (size_t i = 0; i < entries.size(); ++i) {
+    string path = dir + "/" + entries[i];
+    struct stat st;
+    if (stat(path.c_str(), &st) != 0)
+      continue;
+    if (S_ISDIR(st.st_mode)) {
+      FindCachedFiles(path, files);
+    } else if (S_ISREG(st.st_mode) && EndsWith(entries[i], kSymbolExtension)) {
+      ScannedFile file;
+      file.last_used = st.st_mtime;
+      file.path = path;
+      file.size = st.st_size;
+      files->push_back(file);
+    }
+  }
+}
+
+}  // namespace
+
+// The libcurl functions used, looked up at run time.
+struct HTTPSymbolSupplier::Curl {
+  void *library;
+  CURLcode (*global_init)(long);
+  CURL *(*easy_init)(void);
+  CURLcode (*easy_setopt)(CURL *, CURLoption, ...);
+  CURLcode (*easy_perform)(CURL *);
+  CURLcode (*easy_getinfo)(CURL *, CURLINFO, ...);
+  const char *(*easy_strerror)(CURLcode);
+  char *(*easy_escape)(CURL *, const char *, int);
+  void (*free_string)(void *);
+  void (*easy_cleanup)(CURL *);
+
+  // Returns NULL if libcurl or any of the functions can't be found.
+  static Curl *Load() {
+    const char *kLibraryNames[] = { "libcurl.so", "libcurl.so.4",
+                                    "libcurl.so.3", "libcurl.dylib" };
+    void *library = NULL;
+    for (size_t i = 0;
+         !library && i < sizeof(kLibraryNames) / sizeof(kLibraryNames[0]);
+         ++i) {
+      library = dlopen(kLibraryNames[i], RTLD_NOW);
+    }
+    if (!library) {
+      BPLOG(ERROR) << "Could not load libcurl; only cached symbols are "
+                      "available";
+      return NULL;
+    }
+
+    scoped_ptr<Curl> curl(new Curl());
+    curl->library = library;
+#define LOAD_CURL_FUNCTION(var, function_name, type) \
+    curl->var = reinterpret_cast<type>(dlsym(library, function_name)); \
+    if (!curl->var) { \
+      BPLOG(ERROR) << "Could not find libcurl function " << function_name; \
+      dlclose(library); \
+      return NULL; \
+    }
+
+    LOAD_CURL_FUNCTION(global_init, "curl_global_init",
+                       CURLcode (*)(long));
+    LOAD_CURL_FUNCTION(easy_init, "curl_easy_init", CURL *(*)(void));
+    LOAD_CURL_FUNCTION(easy_setopt, "curl_easy_setopt",
+                       CURLcode (*)(CURL *, CURLoption, ...));
+    LOAD_CURL_FUNCTION(easy_perform, "curl_easy_perform",
+                       CURLcode (*)(CURL *));
+    LOAD_CURL_FUNCTION(easy_getinfo, "curl_easy_getinfo",
+                       CURLcode (*)(CURL *, CURLINFO, ...));
+    LOAD_CURL_FUNCTION(easy_strerror, "curl_easy_strerror",
+                       const char *(*)(CURLcode));
+    LOAD_CURL_FUNCTION(easy_escape, "curl_easy_escape",
+                       char *(*)(CURL *, const char *, int));
+    LOAD_CURL_FUNCTION(free_string, "curl_free", void (*)(void *));
+    LOAD_CURL_FUNCTION(easy_cleanup, "curl_easy_cleanup",
+                       void (*)(CURL *));
+#undef LOAD_CURL_FUNCTION
+
+    if (curl->global_init(CURL_GLOBAL_ALL) != CURLE_OK) {
+      BPLOG(ERROR) << "Could not initialize libcurl";
+      dlclose(library);
+      return NULL;
+    }
+    return curl.release();
+  }
+};
+
+HTTPSymbolSupplier::HTTPSymbolSupplier(const vector<string> &server_urls,
+                                       const string &cache_path,
+                                       uint64_t cache_size_limit)
+    : SimpleSymbolSupplier(cache_path),
+      server_urls_(server_urls),
+      cache_path_(cache_path),
+      cache_size_limit_(cache_size_limit),
+      download_timeout_(300),
+      max_idle_connections_(4),
+      curl_(Curl::Load()),
+      cache_size_(0),
+      mutex_(new Mutex) {
+  // Leave off trailing slashes, which the paths and URLs built from these
+  // supply.
+  for (size_t i = 0; i < server_urls_.size(); ++i) {
+    while (EndsWith(server_urls_[i], "/"))
+      server_urls_[i].erase(server_urls_[i].size() - 1);
+  }
+
+  ScanCache(cache_path_);
+}
+
+HTTPSymbolSupplier::~HTTPSymbolSupplier() {
+  if (curl_) {
+    for (size_t i = 0; i < idle_handles_.size(); ++i)
+      curl_->easy_cleanup(static_cast<CURL*>(idle_handles_[i]));
+    // libcurl is left loaded and initialized; other users in the process
+    // may still depend on that.
+    delete curl_;
+  }
+  delete mutex_;
+}
+
+SymbolSupplier::SymbolResult HTTPSymbolSupplier::GetSymbolFile(
+    const CodeModule *module,
+    const SystemInfo *system_info,
+    string *symbol_file) {
+  BPLOG_IF(ERROR, !symbol_file) << "HTTPSymbolSupplier::GetSymbolFile "
+                                   "requires |symbol_file|";
+  assert(symbol_file);
+
+  // The cache must not be used to read, evict or write files outside it.
+  string relative_path;
+  if (!GetRelativeSymbolPath(module, kSymbolExtension, &relative_path))
+    return NOT_FOUND;
+  if (!IsSafeCachePath(relative_path)) {
+    BPLOG(ERROR) << "Refusing unsafe symbol cache path " << relative_path;
+    return NOT_FOUND;
+  }
+
+  if (SimpleSymbolSupplier::GetSymbolFile(module, system_info,
+                                          symbol_file) == FOUND) {
+    UseCachedFile(*symbol_file);
+    return FOUND;
+  }
+
+  if (!curl_ || server_urls_.empty())
+    return NOT_FOUND;
+
+  string cache_file = cache_path_ + "/" + relative_path;
+  if (!MakeParentDirectories(cache_file))
+    return NOT_FOUND;
+
+  SymbolResult result = Download(relative_path, cache_file);
+  if (result == FOUND)
+    *symbol_file = cache_file;
+  return result;
+}
+
+SymbolSupplier::SymbolResult HTTPSymbolSupplier::GetMappableSymbolFile(
+    const CodeModule *module,
+    const SystemInfo *system_info,
+    string *symbol_file) {
+  string relative_path;
+  if (!GetRelativeSymbolPath(module, kSymbolExtension, &relative_path) ||
+      !IsSafeCachePath(relative_path)) {
+    return NOT_FOUND;
+  }
+
+  SymbolResult result =
+      SimpleSymbolSupplier::GetMappableSymbolFile(module, system_info,
+                                                  symbol_file);
+  if (result == FOUND) {
+    // The text file it was converted from stands for it in the cache.
+    UseCachedFile(symbol_file->substr(0, symbol_file->size() -
+                                         strlen(kMappableExtension)) +
+                  kSymbolExtension);
+  }
+  return result;
+}
+
+uint64_t HTTPSymbolSupplier::cache_size() const {
+  AutoMutex lock(mutex_);
+  return cache_size_;
+}
+
+SymbolSupplier::SymbolResult HTTPSymbolSupplier::Download(
+    const string &relative_path,
+    const string &cache_file) {
+  bool interrupted = false;
+  for (size_t i = 0; i < server_urls_.size(); ++i) {
+    SymbolResult result = DownloadFrom(server_urls_[i], relative_path,
+                                       cache_file);
+    if (result == FOUND)
+      return FOUND;
+    if (result == INTERRUPT)
+      interrupted = true;
+  }
+  return interrupted ? INTERRUPT : NOT_FOUND;
+}
+
+SymbolSupplier::SymbolResult HTTPSymbolSupplier::DownloadFrom(
+    const string &server_url,
+    const string &relative_path,
+    const string &cache_file) {
+  CURL *handle = static_cast<CURL*>(AcquireHandle());
+  if (!handle)
+    return INTERRUPT;
+
+  // Download under a temporary name, so that neither a concurrent lookup
+  // nor a later run ever finds a partial file in the cache.
+  string temp_path_template = cache_file + ".XXXXXX";
+  scoped_array<char> temp_path(new char[temp_path_template.size() + 1]);
+  memcpy(temp_path.get(), temp_path_template.c_str(),
+         temp_path_template.size() + 1);
+  int fd = mkstemp(temp_path.get());
+  FILE *file = fd == -1 ? NULL : fdopen(fd, "wb");
+  if (!file) {
+    BPLOG(ERROR) << "Could not create " << temp_path.get() << ": "
+                 << strerror(errno);
+    if (fd != -1) {
+      close(fd);
+      unlink(temp_path.get());
+    }
+    ReleaseHandle(handle);
+    return INTERRUPT;
+  }
+
+  string url = server_url + "/" + EscapePath(handle, relative_path);
+  curl_->easy_setopt(handle, CURLOPT_URL, url.c_str());
+  curl_->easy_setopt(handle, CURLOPT_WRITEFUNCTION, WriteToFile);
+  curl_->easy_setopt(handle, CURLOPT_WRITEDATA, file);
+  // An empty string accepts every encoding libcurl supports, gzip included.
+  curl_->easy_setopt(handle, CURLOPT_ENCODING, "");
+  curl_->easy_setopt(handle, CURLOPT_FOLLOWLOCATION, 1L);
+  curl_->easy_setopt(handle, CURLOPT_NOSIGNAL, 1L);
+  curl_->easy_setopt(handle, CURLOPT_TIMEOUT, download_timeout_);
+  CURLcode code = curl_->easy_perform(handle);
+  long status = 0;
+  curl_->easy_getinfo(handle, CURLINFO_RESPONSE_CODE, &status);
+  curl_->easy_setopt(handle, CURLOPT_WRITEDATA, NULL);
+  ReleaseHandle(handle);
+
+  bool written = fclose(file) == 0;
+  SymbolResult result;
+  if (code == CURLE_OK && (status == 200 || status == 0)) {
+    // Other schemes, such as file:, have no status.
+    result = FOUND;
+  } else if ((code == CURLE_OK && (status == 404 || status == 410)) ||
+             code == CURLE_FILE_COULDNT_READ_FILE) {
+    BPLOG(INFO) << "No symbol file at " << url;
+    result = NOT_FOUND;
+  } else {
+    if (code != CURLE_OK) {
+      BPLOG(ERROR) << "Could not download " << url << ": "
+                   << curl_->easy_strerror(code);
+    } else {
+      BPLOG(ERROR) << "Could not download " << url << ": HTTP status "
+                   << status;
+    }
+    result = INTERRUPT;
+  }
+
+  if (result == FOUND) {
+    // mkstemp creates the file readable only by its owner, but the cache
+    // may be shared.
+    if (!written || chmod(temp_path.get(), 0644) != 0 ||
+        rename(temp_path.get(), cache_file.c_str()) != 0) {
+      BPLOG(ERROR) << "Could not write " << cache_file << ": "
+                   << strerror(errno);
+      result = INTERRUPT;
+    }
+  }
+  if (result != FOUND) {
+    unlink(temp_path.get());
+    return result;
+  }
+
+  BPLOG(INFO) << "Downloaded " << url;
+  UseCachedFile(cache_file);
+  return FOUND;
+}
+
+string HTTPSymbolSupplier::EscapePath(void *handle,
+                                      const string &relative_path) const {
+  string escaped;
+  size_t start = 0;
+  while (start <= relative_path.size()) {
+    size_t slash = relative_path.find('/', start);
+    if (slash == string::npos)
+      slash = relative_path.size();
+    string component = relative_path.substr(start, slash - start);
+    char *escaped_component = curl_->easy_escape(
+        static_cast<CURL*>(handle), component.c_str(), component.size());
+    if (start > 0)
+      escaped.append("/");
+    if (escaped_component) {
+      escaped.append(escaped_component);
+      curl_->free_string(escaped_component);
+    } else {
+      escaped.append(component);
+    }
+    start = slash + 1;
+  }
+  return escaped;
+}
+
+void *HTTPSymbolSupplier::AcquireHandle() {
+  {
+    AutoMutex lock(mutex_);
+    if (!idle_handles_.empty()) {
+      void *handle = idle_handles_.back();
+      idle_handles_.pop_back();
+      return handle;
+    }
+  }
+
+  CURL *handle = curl_->easy_init();
+  BPLOG_IF(ERROR, !handle) << "Could not create a libcurl handle";
+  return handle;
+}
+
+void HTTPSymbolSupplier::ReleaseHandle(void *handle) {
+  {
+    AutoMutex lock(mutex_);
+    if (idle_handles_.size() < max_idle_connections_) {
+      idle_handles_.push_back(handle);
+      return;
+    }
+  }
+  curl_->easy_cleanup(static_cast<CURL*>(handle));
+}
+
+void HTTPSymbolSupplier::ScanCache(const string &dir) {
+  vector<ScannedFile> files;
+  FindCachedFiles(dir, &files);
+  std::sort(files.begin(), files.end());
+
+  AutoMutex lock(mutex_);
+  for (size_t i = 0; i < files.size(); ++i) {
+    CachedFile cached;
+    cached.size = files[i].size;
+    cached.lru_position = lru_.insert(lru_.end(), files[i].path);
+    cached_files_.insert(std::make_pair(files[i].path, cached));
+    cache_size_ += cached.size;
+  }
+  EvictLocked(string());
+}
+
+void HTTPSymbolSupplier::UseCachedFile(const string &path) {
+  // Record the use in the file system too, for the next ScanCache.
+  utime(path.c_str(), NULL);
+
+  AutoMutex lock(mutex_);
+  CachedFileMap::iterator cached = cached_files_.find(path);
+  if (cached != cached_files_.end()) {
+    lru_.splice(lru_.end(), lru_, cached->second.lru_position);
+    return;
+  }
+
+  struct stat st;
+  if (stat(path.c_str(), &st) != 0)
+    return;
+  CachedFile new_file;
+  new_file.size = st.st_size;
+  new_file.lru_position = lru_.insert(lru_.end(), path);
+  cached_files_.insert(std::make_pair(path, new_file));
+  cache_size_ += new_file.size;
+  EvictLocked(path);
+}
+
+void HTTPSymbolSupplier::EvictLocked(const string &keep) {
+  if (cache_size_limit_ == 0)
+    return;
+
+  std::list<string>::iterator next = lru_.begin();
+  while (cache_size_ > cache_size_limit_ && next != lru_.end()) {
+    if (*next == keep) {
+      ++next;
+      continue;
+    }
+
+    string path = *next;
+    BPLOG(INFO) << "Evicting cached symbol file " << path;
+    unlink(path.c_str());
+    // Any serialized copy goes with it.
+    unlink((path.substr(0, path.size() - strlen(kSymbolExtension)) +
+            kMappableExtension).c_str());
+    CachedFileMap::iterator cached = cached_files_.find(path);
+    cache_size_ -= cached->second.size;
+    cached_files_.erase(cached);
+    next = lru_.erase(next);
+  }
+}
+
+}  // namespace google_breakpad
@@ -0,0 +1,180 @@
+// Copyright (c) 2016 Google Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+// notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above
+// copyright notice, this list of conditions and the following disclaimer
+// in the documentation and/or other materials provided with the
+// distribution.
+//     * Neither the name of Google Inc. nor the names of its
+// contributors may be used to endorse or promote products derived from
+// this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+// http_symbol_supplier.h: A SymbolSupplier that downloads symbol files from
+// HTTP symbol servers into a local disk cache.
+//
+// HTTPSymbolSupplier fetches the symbol file for a module from
+// <server>/<debug_file>/<debug_identifier>/<name>.sym, trying each of its
+// servers in turn, which is the layout described in
+// simple_symbol_supplier.h.  Downloaded files are kept in a cache directory
+// with the same layout, so the cache can be used, and kept, like any other
+// SimpleSymbolSupplier root; in particular serialize_symbol_store can
+// convert it in place, and the .sym.fast files it writes are used in
+// preference to the text files.
+//
+// The cache is bounded: once the text symbol files in it exceed the size
+// limit, the least recently used ones are deleted.  Use is tracked through
+// the files' modification times, so the order survives a restart.
+//
+// Downloads reuse a pool of libcurl handles, so connections to the servers
+// are kept alive between requests, and ask for compressed transfers.
+// GetSymbolFile may be called from several threads at once (for example by
+// StackFrameSymbolizer::PrefetchSymbols), each running its own download.
+// As with SimpleSymbolSupplier, GetCStringSymbolData and FreeSymbolData
+// may not.
+//
+// libcurl is loaded at run time.  If it can't be, only symbols that are
+// already in the cache are supplied.
+//
+// A server that doesn't have a module's symbols (HTTP 404 or 410) lets the
+// next server be tried, and NOT_FOUND is returned if none has them.  Any
+// other failure, such as an unreachable server, makes the lookup return
+// INTERRUPT, so that processing can be retried later rather than finish
+// without symbols that exist.
+
+#ifndef PROCESSOR_HTTP_SYMBOL_SUPPLIER_H__
+#define PROCESSOR_HTTP_SYMBOL_SUPPLIER_H__
+
+#include <list>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "common/using_std_string.h"
+#include "google_breakpad/common/breakpad_types.h"
+#include "processor/simple_symbol_supplier.h"
+
+namespace google_breakpad {
+
+class Mutex;
+
+class HTTPSymbolSupplier : public SimpleSymbolSupplier {
+ public:
+  // Creates a supplier that downloads symbols from |server_urls| (such as
+  // "http://symbols.example.com/breakpad") into |cache_path|, which is
+  // created if need be.  Once the cached symbol files exceed
+  // |cache_size_limit| bytes, the least recently used ones are deleted;
+  // 0 means no limit.  Construct the supplier before starting any threads
+  // that use libcurl, which it initializes.
+  HTTPSymbolSupplier(const vector<string> &server_urls,
+                     const string &cache_path,
+                     uint64_t cache_size_limit);
+  virtual ~HTTPSymbolSupplier();
+
+  // Returns the path to the cached symbol file for the given module,
+  // downloading it first if it isn't cached.
+  virtual SymbolResult GetSymbolFile(const CodeModule *module,
+                                     const SystemInfo *system_info,
+                                     string *symbol_file);
+  using SimpleSymbolSupplier::GetSymbolFile;
+
+  virtual SymbolResult GetMappableSymbolFile(const CodeModule *module,
+                                             const SystemInfo *system_info,
+                                             string *symbol_file);
+
+  // Whether libcurl was loaded, so that symbols can be downloaded.
+  bool CanDownload() const { return curl_ != NULL; }
+
+  // The time allowed for each download, in seconds.  The default is 300.
+  void set_download_timeout(long seconds) { download_timeout_ = seconds; }
+
+  // The number of idle libcurl handles, each holding its connections open,
+  // kept for reuse.  The default is 4; more concurrent downloads than that
+  // still work, but open new connections.
+  void set_max_idle_connections(unsigned int count) {
+    max_idle_connections_ = count;
+  }
+
+  // The total size of the text symbol files in the cache.
+  uint64_t cache_size() const;
+
+ private:
+  struct Curl;
+
+  struct CachedFile {
+    uint64_t size;
+    // This file's position in lru_.
+    std::list<string>::iterator lru_position;
+  };
+
+  typedef std::map<string, CachedFile> CachedFileMap;
+
+  // Downloads |relative_path| from each server in turn into |cache_file|.
+  SymbolResult Download(const string &relative_path,
+                        const string &cache_file);
+  SymbolResult DownloadFrom(const string &server_url,
+                            const string &relative_path,
+                            const string &cache_file);
+
+  // Returns |relative_path| with each of its components URL-escaped.
+  string EscapePath(void *handle, const string &relative_path) const;
+
+  // Takes a libcurl handle from the pool, or creates one, and returns one
+  // when done with it.
+  void *AcquireHandle();
+  void ReleaseHandle(void *handle);
+
+  // Adds the symbol files under |dir| to cached_files_ and lru_.
+  void ScanCache(const string &dir);
+
+  // Marks the cached |path| as just used, adding it to the cache's records
+  // if need be, and deletes the least recently used files if the cache is
+  // over its limit.
+  void UseCachedFile(const string &path);
+
+  // Deletes least recently used files, other than |keep|, until the cache
+  // fits its limit.  The caller must hold mutex_.
+  void EvictLocked(const string &keep);
+
+  vector<string> server_urls_;
+  string cache_path_;
+  uint64_t cache_size_limit_;
+  long download_timeout_;
+  unsigned int max_idle_connections_;
+
+  // NULL if libcurl could not be loaded.
+  Curl *curl_;
+  vector<void*> idle_handles_;
+
+  // Every text symbol file in the cache, least recently used first in lru_.
+  CachedFileMap cached_files_;
+  std::list<string> lru_;
+  uint64_t cache_size_;
+
+  Mutex *mutex_;
+
+  // Disallow copy constructor and assignment operator.
+  HTTPSymbolSupplier(const HTTPSymbolSupplier&);
+  void operator=(const HTTPSymbolSupplier&);
+};
+
+}  // namespace google_breakpad
+
+#endif  // PROCESSOR_HTTP_SYMBOL_SUPPLIER_H__
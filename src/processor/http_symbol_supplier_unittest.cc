@@ -0,0 +1,220 @@
+// Copyright (c) 2016 Google Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+// notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above
+// copyright notice, this list of conditions and the following disclaimer
+// in the documentation and/or other materials provided with the
+// distribution.
+//     * Neither the name of Google Inc. nor the names of its
+// contributors may be used to endorse or promote products derived from
+// this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+// http_symbol_supplier_unittest.cc: Unit tests for HTTPSymbolSupplier.
+// The "servers" are file: URLs into the test data, so no network access is
+// needed.
+
+#include <limits.h>
+#include <stdlib.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "breakpad_googletest_includes.h"
+#include "common/tests/auto_tempdir.h"
+#include "common/using_std_string.h"
+#include "google_breakpad/processor/system_info.h"
+#include "processor/basic_code_module.h"
+#include "processor/http_symbol_supplier.h"
+
+namespace {
+
+using google_breakpad::AutoTempDir;
+using google_breakpad::BasicCodeModule;
+using google_breakpad::HTTPSymbolSupplier;
+using google_breakpad::SymbolSupplier;
+using google_breakpad::SystemInfo;
+using std::vector;
+
+bool FileExists(const string &path) {
+  struct stat st;
+  return stat(path.c_str(), &st) == 0;
+}
+
+string ReadFile(const string &path) {
+  std::ifstream in(path.c_str());
+  string contents;
+  std::getline(in, contents, string::traits_type::to_char_type(
+                   string::traits_type::eof()));
+  return contents;
+}
+
+class HTTPSymbolSupplierTest : public ::testing::Test {
+ public:
+  HTTPSymbolSupplierTest()
+      : test_app_(0x400000, 0x10000, "c:\\test_app.exe", "",
+                  "c:\\test_app.pdb", "5A9832E5287241C1838ED98914E9B7FF1",
+                  ""),
+        kernel32_(0x7c800000, 0x10000, "C:\\WINDOWS\\system32\\kernel32.dll",
+                  "", "kernel32.pdb", "BCE8785C57B44245A669896B6A19B9542",
+                  ""),
+        missing_(0x10000000, 0x10000, "c:\\missing.dll", "", "missing.pdb",
+                 "0123456789ABCDEF0123456789ABCDEF0", "") {
+    char symbols_dir[PATH_MAX];
+    string relative_dir = string(getenv("srcdir") ? getenv("srcdir") : ".") +
+                          "/src/processor/testdata/symbols";
+    if (realpath(relative_dir.c_str(), symbols_dir))
+      symbols_dir_ = symbols_dir;
+    server_url_ = "file://" + symbols_dir_;
+    cache_dir_ = temp_dir_.path() + "/cache";
+  }
+
+  string TestAppSymbolFile(const string &root) const {
+    return root + "/test_app.pdb/5A9832E5287241C1838ED98914E9B7FF1/"
+                  "test_app.sym";
+  }
+
+  string Kernel32SymbolFile(const string &root) const {
+    return root + "/kernel32.pdb/BCE8785C57B44245A669896B6A19B9542/"
+                  "kernel32.sym";
+  }
+
+  AutoTempDir temp_dir_;
+  string symbols_dir_;
+  string server_url_;
+  string cache_dir_;
+  SystemInfo system_info_;
+  BasicCodeModule test_app_;
+  BasicCodeModule kernel32_;
+  BasicCodeModule missing_;
+};
+
+TEST_F(HTTPSymbolSupplierTest, DownloadsIntoCache) {
+  ASSERT_FALSE(symbols_dir_.empty());
+  HTTPSymbolSupplier supplier(vector<string>(1, server_url_ + "/"),
+                              cache_dir_, 0);
+  ASSERT_TRUE(supplier.CanDownload());
+
+  string symbol_file, symbol_data;
+  ASSERT_EQ(SymbolSupplier::FOUND,
+            supplier.GetSymbolFile(&test_app_, &system_info_, &symbol_file,
+                                   &symbol_data));
+  EXPECT_EQ(TestAppSymbolFile(cache_dir_), symbol_file);
+  EXPECT_EQ(ReadFile(TestAppSymbolFile(symbols_dir_)), symbol_data);
+  EXPECT_EQ(symbol_data.size(), supplier.cache_size());
+
+  EXPECT_EQ(SymbolSupplier::NOT_FOUND,
+            supplier.GetSymbolFile(&missing_, &system_info_, &symbol_file));
+  EXPECT_FALSE(FileExists(cache_dir_ + "/missing.pdb/"
+                          "0123456789ABCDEF0123456789ABCDEF0/missing.sym"));
+
+  // Another supplier finds the cached file, and its size, without a server.
+  HTTPSymbolSupplier cache_only(vector<string>(), cache_dir_, 0);
+  ASSERT_EQ(SymbolSupplier::FOUND,
+            cache_only.GetSymbolFile(&test_app_, &system_info_, &symbol_file));
+  EXPECT_EQ(TestAppSymbolFile(cache_dir_), symbol_file);
+  EXPECT_EQ(symbol_data.size(), cache_only.cache_size());
+}
+
+TEST_F(HTTPSymbolSupplierTest, TriesEachServer) {
+  ASSERT_FALSE(symbols_dir_.empty());
+  vector<string> servers;
+  servers.push_back("file://" + temp_dir_.path() + "/no_such_server");
+  servers.push_back(server_url_);
+  HTTPSymbolSupplier supplier(servers, cache_dir_, 0);
+
+  string symbol_file;
+  ASSERT_EQ(SymbolSupplier::FOUND,
+            supplier.GetSymbolFile(&kernel32_, &system_info_, &symbol_file));
+  EXPECT_EQ(Kernel32SymbolFile(cache_dir_), symbol_file);
+  EXPECT_EQ(SymbolSupplier::NOT_FOUND,
+            supplier.GetSymbolFile(&missing_, &system_info_, &symbol_file));
+}
+
+TEST_F(HTTPSymbolSupplierTest, EvictsLeastRecentlyUsed) {
+  ASSERT_FALSE(symbols_dir_.empty());
+  string test_app_data = ReadFile(TestAppSymbolFile(symbols_dir_));
+  string kernel32_data = ReadFile(Kernel32SymbolFile(symbols_dir_));
+
+  // Room for either file, but not both.
+  HTTPSymbolSupplier supplier(vector<string>(1, server_url_), cache_dir_,
+                              test_app_data.size() + 1);
+  string symbol_file;
+  ASSERT_EQ(SymbolSupplier::FOUND,
+            supplier.GetSymbolFile(&test_app_, &system_info_, &symbol_file));
+  ASSERT_EQ(SymbolSupplier::FOUND,
+            supplier.GetSymbolFile(&kernel32_, &system_info_, &symbol_file));
+  EXPECT_FALSE(FileExists(TestAppSymbolFile(cache_dir_)));
+  EXPECT_TRUE(FileExists(Kernel32SymbolFile(cache_dir_)));
+  EXPECT_EQ(kernel32_data.size(), supplier.cache_size());
+
+  // A fresh supplier with a smaller limit empties the cache on startup.
+  HTTPSymbolSupplier small_supplier(vector<string>(), cache_dir_, 1);
+  EXPECT_FALSE(FileExists(Kernel32SymbolFile(cache_dir_)));
+  EXPECT_EQ(0U, small_supplier.cache_size());
+}
+
+TEST_F(HTTPSymbolSupplierTest, RejectsPathsOutsideCache) {
+  ASSERT_FALSE(symbols_dir_.empty());
+  HTTPSymbolSupplier supplier(vector<string>(1, server_url_), cache_dir_, 0);
+
+  // The server has this file, but the identifier names more than one
+  // directory.
+  BasicCodeModule nested(0x400000, 0x10000, "c:\\test_app.exe", "",
+                         "c:\\test_app.pdb",
+                         "../test_app.pdb/5A9832E5287241C1838ED98914E9B7FF1",
+                         "");
+  BasicCodeModule dot_dot_file(0x400000, 0x10000, "c:\\test_app.exe", "",
+                               "..", "..", "");
+  BasicCodeModule dot_identifier(0x400000, 0x10000, "c:\\test_app.exe", "",
+                                 "c:\\test_app.pdb", ".", "");
+
+  string symbol_file;
+  EXPECT_EQ(SymbolSupplier::NOT_FOUND,
+            supplier.GetSymbolFile(&nested, &system_info_, &symbol_file));
+  EXPECT_EQ(SymbolSupplier::NOT_FOUND,
+            supplier.GetSymbolFile(&dot_dot_file, &system_info_,
+                                   &symbol_file));
+  EXPECT_EQ(SymbolSupplier::NOT_FOUND,
+            supplier.GetSymbolFile(&dot_identifier, &system_info_,
+                                   &symbol_file));
+  EXPECT_FALSE(FileExists(cache_dir_));
+  EXPECT_EQ(0U, supplier.cache_size());
+}
+
+TEST_F(HTTPSymbolSupplierTest, UnreachableServerInterrupts) {
+  HTTPSymbolSupplier supplier(vector<string>(1, "http://127.0.0.1:1"),
+                              cache_dir_, 0);
+  supplier.set_download_timeout(10);
+  string symbol_file;
+  EXPECT_EQ(SymbolSupplier::INTERRUPT,
+            supplier.GetSymbolFile(&test_app_, &system_info_, &symbol_file));
+  EXPECT_FALSE(FileExists(TestAppSymbolFile(cache_dir_)));
+}
+
+}  // namespace
+
+int main(int argc, char *argv[]) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,153 @@
+// Copyright (c) 2016 Google Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+// notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above
+// copyright notice, this list of conditions and the following disclaimer
+// in the documentation and/or other materials provided with the
+// distribution.
+//     * Neither the name of Google Inc. nor the names of its
+// contributors may be used to endorse or promote products derived from
+// this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+// instruction_analysis_cache.cc: Implementation of InstructionAnalysisCache.
+//
+// See instruction_analysis_cache.h for documentation.
+
+#include "google_breakpad/processor/instruction_analysis_cache.h"
+
+#include <utility>
+
+#include "google_breakpad/processor/code_module.h"
+#include "processor/mutex.h"
+
+namespace google_breakpad {
+
+struct InstructionAnalysisCache::Entry {
+  Entry(const Key& set_key, uint32_t set_weight)
+      : key(set_key), weight(set_weight) {}
+
+  Key key;
+  uint32_t weight;
+  // This entry's position in recent_.
+  EntryList::iterator position;
+};
+
+InstructionAnalysisCache::InstructionAnalysisCache(size_t max_entries)
+    : max_entries_(max_entries),
+      hits_(0),
+      misses_(0),
+      mutex_(new Mutex) {
+}
+
+InstructionAnalysisCache::~InstructionAnalysisCache() {
+  Clear();
+  delete mutex_;
+}
+
+// static
+bool InstructionAnalysisCache::MakeKey(const CodeModule* module,
+                                       uint64_t address, size_t length,
+                                       bool bad_write, Key* key) {
+  if (!module)
+    return false;
+  string debug_file = module->debug_file();
+  string debug_identifier = module->debug_identifier();
+  if (debug_file.empty() || debug_identifier.empty())
+    return false;
+  key->module = debug_file + "|" + debug_identifier;
+  key->offset = address - module->base_address();
+  key->length = length;
+  key->bad_write = bad_write;
+  return true;
+}
+
+bool InstructionAnalysisCache::Lookup(const CodeModule* module,
+                                      uint64_t address, size_t length,
+                                      bool bad_write, uint32_t* weight) {
+  Key key;
+  if (!MakeKey(module, address, length, bad_write, &key))
+    return false;
+
+  AutoMutex lock(mutex_);
+  EntryMap::iterator it = entries_.find(key);
+  if (it == entries_.end()) {
+    ++misses_;
+    return false;
+  }
+
+  ++hits_;
+  Entry* entry = it->second;
+  recent_.splice(recent_.begin(), recent_, entry->position);
+  *weight = entry->weight;
+  return true;
+}
+
+void InstructionAnalysisCache::Store(const CodeModule* module,
+                                     uint64_t address, size_t length,
+                                     bool bad_write, uint32_t weight) {
+  Key key;
+  if (max_entries_ == 0 ||
+      !MakeKey(module, address, length, bad_write, &key))
+    return;
+
+  AutoMutex lock(mutex_);
+  if (entries_.find(key) != entries_.end()) {
+    // Another thread got here first.
+    return;
+  }
+
+  while (entries_.size() >= max_entries_) {
+    Entry* oldest = recent_.back();
+    recent_.pop_back();
+    entries_.erase(oldest->key);
+    delete oldest;
+  }
+
+  Entry* entry = new Entry(key, weight);
+  entry->position = recent_.insert(recent_.begin(), entry);
+  entries_.insert(std::make_pair(key, entry));
+}
+
+void InstructionAnalysisCache::Clear() {
+  AutoMutex lock(mutex_);
+  for (EntryList::iterator it = recent_.begin(); it != recent_.end(); ++it)
+    delete *it;
+  recent_.clear();
+  entries_.clear();
+}
+
+size_t InstructionAnalysisCache::size() const {
+  AutoMutex lock(mutex_);
+  return entries_.size();
+}
+
+uint64_t InstructionAnalysisCache::hits() const {
+  AutoMutex lock(mutex_);
+  return hits_;
+}
+
+uint64_t InstructionAnalysisCache::misses() const {
+  AutoMutex lock(mutex_);
+  return misses_;
+}
+
+}  // namespace google_breakpad
@@ -35,6 +35,7 @@
 
 #include <assert.h>
 #include <errno.h>
+#include <pthread.h>
 #include <stdio.h>
 #include <string.h>
 #include <time.h>
@@ -51,9 +52,22 @@
 
 namespace google_breakpad {
 
+namespace {
+
+pthread_once_t capture_key_once = PTHREAD_ONCE_INIT;
+pthread_key_t capture_key;
+
+void CreateCaptureKey() {
+  pthread_key_create(&capture_key, NULL);
+}
+
+}  // namespace
+
+LogStream::Severity LogStream::minimum_severity_ = LogStream::SEVERITY_INFO;
+
 LogStream::LogStream(std::ostream &stream, Severity severity,
                      const char *file, int line)
-    : stream_(stream) {
+    : stream_(Destination(stream)) {
   time_t clock;
   time(&clock);
   struct tm tm_struct;
@@ -83,6 +97,26 @@ LogStream::~LogStream() {
   stream_ << std::endl;
 }
 
+// static
+std::ostream &LogStream::Destination(std::ostream &stream) {
+  LogCapture *capture = LogCapture::Current();
+  return capture ? capture->stream_ : stream;
+}
+
+LogCapture::LogCapture() : previous_(Current()) {
+  pthread_setspecific(capture_key, this);
+}
+
+LogCapture::~LogCapture() {
+  pthread_setspecific(capture_key, previous_);
+}
+
+// static
+LogCapture *LogCapture::Current() {
+  pthread_once(&capture_key_once, CreateCaptureKey);
+  return static_cast<LogCapture*>(pthread_getspecific(capture_key));
+}
+
 string HexString(uint32_t number) {
   char buffer[11];
   snprintf(buffer, sizeof(buffer), "0x%x", number);
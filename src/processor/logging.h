@@ -46,6 +46,15 @@
 // be specified by the BP_LOGGING_INCLUDE macro.  If defined, this header
 // will #include the header specified by that macro.
 //
+// Messages less severe than BPLOG_MINIMUM_SEVERITY, which defaults to
+// SEVERITY_INFO and may also be passed with -D, are compiled out.  Messages
+// less severe than the minimum set with LogStream::set_minimum_severity are
+// skipped at run time.  Either way, the arguments of a message that isn't
+// logged are not evaluated.
+//
+// A LogCapture collects the messages logged on its thread while it exists,
+// so that a program can decide afterwards whether to show them.
+//
 // If any initialization is needed before logging, it can be performed by
 // a function called through the BPLOG_INIT macro.  Each main function of
 // an executable program in the Breakpad processor library calls
@@ -58,6 +67,7 @@
 #define PROCESSOR_LOGGING_H__
 
 #include <iostream>
+#include <sstream>
 #include <string>
 
 #include "common/using_std_string.h"
@@ -106,18 +116,58 @@ class LogStream {
   // Finish logging by printing a newline and flushing the output stream.
   ~LogStream();
 
+  // Messages less severe than |severity| are skipped from now on, unless
+  // BPLOG and BPLOG_LOG_IS_ON have been redefined.  This is meant to be
+  // set before any thread starts logging.
+  static void set_minimum_severity(Severity severity) {
+    minimum_severity_ = severity;
+  }
+  static Severity minimum_severity() { return minimum_severity_; }
+
   template<typename T> std::ostream& operator<<(const T &t) {
     return stream_ << t;
   }
 
  private:
+  // Returns the stream of the calling thread's LogCapture if it has one,
+  // and otherwise |stream|.
+  static std::ostream &Destination(std::ostream &stream);
+
   std::ostream &stream_;
 
+  static Severity minimum_severity_;
+
   // Disallow copy constructor and assignment operator
   explicit LogStream(const LogStream &that);
   void operator=(const LogStream &that);
 };
 
+// While a LogCapture exists, messages that LogStream logs on the thread
+// that created it are appended to it instead of being written to their
+// streams.  Captures may be nested; the innermost one gets the messages.
+class LogCapture {
+ public:
+  LogCapture();
+  ~LogCapture();
+
+  // The messages captured so far, each ending in a newline.
+  string contents() const { return stream_.str(); }
+
+  // Returns the innermost capture of the calling thread, or NULL if there
+  // is none.
+  static LogCapture *Current();
+
+ private:
+  friend class LogStream;
+
+  std::ostringstream stream_;
+  LogCapture *previous_;
+
+  // Disallow copy constructor and assignment operator
+  explicit LogCapture(const LogCapture &that);
+  void operator=(const LogCapture &that);
+};
+
 // This class is used to explicitly ignore values in the conditional logging
 // macros.  This avoids compiler warnings like "value computed is not used"
 // and "statement has no effect".
@@ -154,9 +204,13 @@ int ErrnoString(string *error_string);
 #define BPLOG_MINIMUM_SEVERITY SEVERITY_INFO
 #endif
 
+// The compile-time test comes first, so that a message it rules out
+// compiles to nothing.
 #define BPLOG_LOG_IS_ON(severity) \
     ((google_breakpad::LogStream::SEVERITY_ ## severity) >= \
-     (google_breakpad::LogStream::BPLOG_MINIMUM_SEVERITY))
+     (google_breakpad::LogStream::BPLOG_MINIMUM_SEVERITY) && \
+     (google_breakpad::LogStream::SEVERITY_ ## severity) >= \
+     google_breakpad::LogStream::minimum_severity())
 
 #ifndef BPLOG
 #define BPLOG(severity) BPLOG_LAZY_STREAM(severity, BPLOG_LOG_IS_ON(severity))
@@ -39,6 +39,7 @@
 
 #include <map>
 #include <string>
+#include <vector>
 
 #include "processor/map_serializers.h"
 #include "processor/simple_serializer.h"
@@ -115,6 +116,67 @@ char *StdMapSerializer<Key, Value>::Serialize(
   return serialized_data;
 }
 
+template<typename Value>
+size_t StdVectorSerializer<Value>::SizeOf(const std::vector<Value> &v) const {
+  size_t size = 0;
+  size_t header_size = (1 + v.size()) * sizeof(uint32_t);
+  size += header_size;
+  size += v.size() * sizeof(int32_t);
+
+  typename std::vector<Value>::const_iterator iter;
+  for (iter = v.begin(); iter != v.end(); ++iter)
+    size += value_serializer_.SizeOf(*iter);
+  return size;
+}
+
+template<typename Value>
+char *StdVectorSerializer<Value>::Write(const std::vector<Value> &v,
+                                        char *dest) const {
+  if (!dest) {
+    BPLOG(ERROR) << "StdVectorSerializer failed: write to NULL address.";
+    return NULL;
+  }
+  char *start_address = dest;
+
+  // Write header:
+  // Number of nodes.
+  dest = SimpleSerializer<uint32_t>::Write(v.size(), dest);
+  // Nodes offsets.
+  uint32_t *offsets = reinterpret_cast<uint32_t*>(dest);
+  dest += sizeof(uint32_t) * v.size();
+
+  // The keys are the elements' indices.
+  char *key_address = dest;
+  dest += sizeof(int32_t) * v.size();
+
+  for (size_t index = 0; index < v.size(); ++index) {
+    offsets[index] = static_cast<uint32_t>(dest - start_address);
+    key_address = SimpleSerializer<int32_t>::Write(
+        static_cast<int32_t>(index), key_address);
+    dest = value_serializer_.Write(v[index], dest);
+  }
+  return dest;
+}
+
+template<typename Value>
+char *StdVectorSerializer<Value>::Serialize(const std::vector<Value> &v,
+                                            unsigned int *size) const {
+  // Compute size of memory to be allocated.
+  unsigned int size_to_alloc = SizeOf(v);
+  // Allocate memory.
+  char *serialized_data = new char[size_to_alloc];
+  if (!serialized_data) {
+    BPLOG(INFO) << "StdVectorSerializer memory allocation failed.";
+    if (size) *size = 0;
+    return NULL;
+  }
+  // Write serialized data into memory.
+  Write(v, serialized_data);
+
+  if (size) *size = size_to_alloc;
+  return serialized_data;
+}
+
 template<typename Address, typename Entry>
 size_t RangeMapSerializer<Address, Entry>::SizeOf(
     const RangeMap<Address, Entry> &m) const {
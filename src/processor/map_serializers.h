@@ -28,7 +28,7 @@
 // OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 //
 // map_serializers.h: defines templates for serializing std::map and its
-// wrappers: AddressMap, RangeMap, and ContainedRangeMap.
+// wrappers: AddressMap, RangeMap, and ContainedRangeMap, and std::vector.
 //
 // Author: Siyang Xie (lambxsy@google.com)
 
@@ -38,6 +38,7 @@
 
 #include <map>
 #include <string>
+#include <vector>
 
 #include "processor/simple_serializer.h"
 
@@ -73,6 +74,31 @@ class StdMapSerializer {
   SimpleSerializer<Value> value_serializer_;
 };
 
+// StdVectorSerializer serializes an std::vector instance in the same format
+// as StdMapSerializer serializes a std::map from each element's index to the
+// element, so that the result can be read with StaticMap<int32_t, Value>.
+template<typename Value>
+class StdVectorSerializer {
+ public:
+  // Calculate the memory size of serialized data.
+  size_t SizeOf(const std::vector<Value> &v) const;
+
+  // Writes the serialized data to memory with start address = dest,
+  // and returns the "end" of data, i.e., return the address follow the final
+  // byte of data.
+  // NOTE: caller has to allocate enough memory before invoke Write() method.
+  char* Write(const std::vector<Value> &v, char* dest) const;
+
+  // Serializes a std::vector object into a chunk of memory data.
+  // Returns a pointer to the serialized data.  If size != NULL, *size is set
+  // to the size of serialized data, i.e., SizeOf(v).
+  // Caller has the ownership of memory allocated as "new char[]".
+  char* Serialize(const std::vector<Value> &v, unsigned int *size) const;
+
+ private:
+  SimpleSerializer<Value> value_serializer_;
+};
+
 // AddressMapSerializer allocates memory and serializes an AddressMap into a
 // chunk of memory data.
 template<typename Addr, typename Entry>
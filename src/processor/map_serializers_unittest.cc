@@ -36,6 +36,7 @@
 #include <map>
 #include <string>
 #include <utility>
+#include <vector>
 #include <iostream>
 #include <sstream>
 
@@ -121,6 +122,57 @@ TEST_F(TestStdMapSerializer, MapWithFiveElementsTestCase) {
   EXPECT_EQ(memcmp(correct_data, serialized_data_, correct_size), 0);
 }
 
+class TestStdVectorSerializer : public ::testing::Test {
+ protected:
+  void SetUp() {
+    serialized_size_ = 0;
+    serialized_data_ = NULL;
+  }
+
+  void TearDown() {
+    delete [] serialized_data_;
+  }
+
+  std::vector<EntryType> std_vector_;
+  google_breakpad::StdVectorSerializer<EntryType> serializer_;
+  uint32_t serialized_size_;
+  char *serialized_data_;
+};
+
+TEST_F(TestStdVectorSerializer, EmptyVectorTestCase) {
+  const int32_t correct_data[] = { 0 };
+  uint32_t correct_size = sizeof(correct_data);
+
+  // std_vector_ is empty.
+  serialized_data_ = serializer_.Serialize(std_vector_, &serialized_size_);
+
+  EXPECT_EQ(correct_size, serialized_size_);
+  EXPECT_EQ(memcmp(correct_data, serialized_data_, correct_size), 0);
+}
+
+TEST_F(TestStdVectorSerializer, VectorWithThreeElementsTestCase) {
+  const int32_t correct_data[] = {
+      // # of nodes
+      3,
+      // Offsets
+      28, 32, 36,
+      // Keys
+      0, 1, 2,
+      // Values
+      7, 5, 7
+  };
+  uint32_t correct_size = sizeof(correct_data);
+
+  std_vector_.push_back(7);
+  std_vector_.push_back(5);
+  std_vector_.push_back(7);
+
+  serialized_data_ = serializer_.Serialize(std_vector_, &serialized_size_);
+
+  EXPECT_EQ(correct_size, serialized_size_);
+  EXPECT_EQ(memcmp(correct_data, serialized_data_, correct_size), 0);
+}
+
 class TestAddressMapSerializer : public ::testing::Test {
  protected:
   void SetUp() {
@@ -36,15 +36,15 @@
 #include <stdio.h>
 #include <string.h>
 
+#include <algorithm>
+#include <iostream>
 #include <memory>
-#include <sstream>
 #include <string>
 #include <vector>
 
 #include "google_breakpad/common/minidump_cpu_arm.h"
 #include "google_breakpad/processor/code_module.h"
 #include "processor/basic_code_module.h"
-#include "processor/linked_ptr.h"
 #include "processor/logging.h"
 #include "processor/range_map-inl.h"
 
@@ -52,28 +52,122 @@ namespace {
 static const char kGoogleBreakpadKey[] = "/google-breakpad(";
 static const char kMicrodumpBegin[] = "-----BEGIN BREAKPAD MICRODUMP-----";
 static const char kMicrodumpEnd[] = "-----END BREAKPAD MICRODUMP-----";
-static const char kOsKey[] = ": O ";
-static const char kCpuKey[] = ": C ";
-static const char kMmapKey[] = ": M ";
-static const char kStackKey[] = ": S ";
-static const char kStackFirstLineKey[] = ": S 0 ";
+static const char kRecordSeparator[] = ": ";
 static const char kArmArchitecture[] = "arm";
 static const char kArm64Architecture[] = "arm64";
 
-template<typename T>
-T HexStrToL(const string& str) {
-  uint64_t res = 0;
-  std::istringstream ss(str);
-  ss >> std::hex >> res;
-  return static_cast<T>(res);
+// The largest stack laid out for a compact microdump, so that a corrupt
+// address can't make it allocate without bound.
+static const uint64_t kMaxCompactStackLength = 64 * 1024 * 1024;
+
+// Return a pointer to the first occurrence of the |needle_length| bytes at
+// |needle| in [begin, end), or NULL if there is none.
+const char* FindBytes(const char* begin, const char* end,
+                      const char* needle, size_t needle_length) {
+  while (static_cast<size_t>(end - begin) >= needle_length) {
+    const char* candidate = static_cast<const char*>(
+        memchr(begin, needle[0], end - begin - needle_length + 1));
+    if (!candidate)
+      return NULL;
+    if (memcmp(candidate, needle, needle_length) == 0)
+      return candidate;
+    begin = candidate + 1;
+  }
+  return NULL;
+}
+
+// Return true if [begin, end) starts with the null-terminated |prefix|.
+bool StartsWith(const char* begin, const char* end, const char* prefix) {
+  size_t length = strlen(prefix);
+  return static_cast<size_t>(end - begin) >= length &&
+         memcmp(begin, prefix, length) == 0;
+}
+
+// Return the value of the hex digit |c|, or -1 if it isn't one.
+inline int HexDigitValue(char c) {
+  if (c >= '0' && c <= '9')
+    return c - '0';
+  if (c >= 'a' && c <= 'f')
+    return c - 'a' + 10;
+  if (c >= 'A' && c <= 'F')
+    return c - 'A' + 10;
+  return -1;
+}
+
+// Skip the spaces at *|cursor|, and return the token that follows them,
+// up to the next space or |end|. Advance *|cursor| past the token.
+string NextToken(const char** cursor, const char* end) {
+  while (*cursor < end && **cursor == ' ')
+    ++*cursor;
+  const char* token = *cursor;
+  while (*cursor < end && **cursor != ' ')
+    ++*cursor;
+  return string(token, *cursor - token);
+}
+
+// Like NextToken, but parse the token as a hex number, ignoring anything
+// from its first character that isn't a hex digit.
+uint64_t NextHexToken(const char** cursor, const char* end) {
+  while (*cursor < end && **cursor == ' ')
+    ++*cursor;
+  uint64_t value = 0;
+  int digit;
+  while (*cursor < end && (digit = HexDigitValue(**cursor)) >= 0) {
+    value = (value << 4) | digit;
+    ++*cursor;
+  }
+  while (*cursor < end && **cursor != ' ')
+    ++*cursor;
+  return value;
 }
 
-std::vector<uint8_t> ParseHexBuf(const string& str) {
-  std::vector<uint8_t> buf;
-  for (size_t i = 0; i < str.length(); i += 2) {
-    buf.push_back(HexStrToL<uint8_t>(str.substr(i, 2)));
+// Decode the pairs of hex digits at the start of [begin, end) and append
+// the bytes they represent to |buf|, stopping at the first character that
+// isn't a hex digit.
+void AppendHexBytes(const char* begin, const char* end,
+                    std::vector<uint8_t>* buf) {
+  buf->reserve(buf->size() + (end - begin) / 2);
+  for (; end - begin >= 2; begin += 2) {
+    int high = HexDigitValue(begin[0]);
+    int low = HexDigitValue(begin[1]);
+    if (high < 0 || low < 0)
+      break;
+    buf->push_back(static_cast<uint8_t>((high << 4) | low));
+  }
+}
+
+// Return the value of the base64 digit |c|, or -1 if it isn't one.
+inline int Base64DigitValue(char c) {
+  if (c >= 'A' && c <= 'Z')
+    return c - 'A';
+  if (c >= 'a' && c <= 'z')
+    return c - 'a' + 26;
+  if (c >= '0' && c <= '9')
+    return c - '0' + 52;
+  if (c == '+')
+    return 62;
+  if (c == '/')
+    return 63;
+  return -1;
+}
+
+// Decode the base64 digits at the start of [begin, end), as written in
+// compact microdumps, and append the bytes they represent to |buf|,
+// stopping at the padding or the first character that isn't a digit.
+void AppendBase64Bytes(const char* begin, const char* end,
+                       std::vector<uint8_t>* buf) {
+  buf->reserve(buf->size() + (end - begin) / 4 * 3);
+  uint32_t bits = 0;
+  int bit_count = 0;
+  int digit;
+  for (; begin < end && (digit = Base64DigitValue(*begin)) >= 0; ++begin) {
+    bits = (bits << 6) | digit;
+    bit_count += 6;
+    if (bit_count >= 8) {
+      bit_count -= 8;
+      buf->push_back(static_cast<uint8_t>(bits >> bit_count));
+    }
   }
-  return buf;
 }
 
 }  // namespace
@@ -85,11 +179,7 @@ namespace google_breakpad {
 //
 
 void MicrodumpModules::Add(const CodeModule* module) {
-  linked_ptr<const CodeModule> module_ptr(module);
-  if (!map_->StoreRange(module->base_address(), module->size(), module_ptr)) {
-    BPLOG(ERROR) << "Module " << module->code_file() <<
-                    " could not be stored";
-  }
+  StoreModule(module);
 }
 
 
@@ -146,6 +236,18 @@ bool MicrodumpMemoryRegion::GetMemoryAtAddress(uint64_t address,
   return GetMemoryLittleEndian(address, value);
 }
 
+const uint8_t* MicrodumpMemoryRegion::GetContiguousMemory(
+    uint64_t address, uint32_t size) const {
+  // The stack is stored little-endian, as Microdump decodes it.
+  const uint16_t kOne = 1;
+  if (*reinterpret_cast<const uint8_t*>(&kOne) != 1)
+    return NULL;
+  if (contents_.empty() || address < base_address_ ||
+      address - base_address_ + size > contents_.size())
+    return NULL;
+  return &contents_[address - base_address_];
+}
+
 template<typename ValueType>
 bool MicrodumpMemoryRegion::GetMemoryLittleEndian(uint64_t address,
                                                   ValueType* value) const {
@@ -175,131 +277,200 @@ Microdump::Microdump(const string& contents)
     modules_(new MicrodumpModules()),
     system_info_(new SystemInfo()) {
   assert(!contents.empty());
+  Parse(contents.data(), contents.size(), NULL);
+}
+
+Microdump::Microdump(const char* data, size_t size, size_t* end)
+  : context_(new MicrodumpContext()),
+    stack_region_(new MicrodumpMemoryRegion()),
+    modules_(new MicrodumpModules()),
+    system_info_(new SystemInfo()) {
+  Parse(data, size, end);
+}
 
+void Microdump::Parse(const char* data, size_t size, size_t* end) {
+  const char* data_end = data + size;
+  const char* cursor = data;
   bool in_microdump = false;
-  string line;
+  bool found_end = false;
   uint64_t stack_start = 0;
-  std::vector<uint8_t> stack_content;
+  uint64_t stack_header_start = 0;
+  uint64_t stack_header_length = 0;
+  std::vector<uint8_t>& stack_content = stack_region_->contents_;
   string arch;
 
-  std::istringstream stream(contents);
-  while (std::getline(stream, line)) {
-    if (line.find(kGoogleBreakpadKey) == string::npos) {
+  // Only lines logged by Breakpad matter, so rather than reading every
+  // line, search for the next Breakpad tag and read the rest of its line.
+  const size_t key_length = strlen(kGoogleBreakpadKey);
+  const char* key;
+  while ((key = FindBytes(cursor, data_end, kGoogleBreakpadKey, key_length))) {
+    const char* line_end = static_cast<const char*>(
+        memchr(key, '\n', data_end - key));
+    if (!line_end)
+      line_end = data_end;
+    cursor = line_end == data_end ? data_end : line_end + 1;
+    if (line_end > key && line_end[-1] == '\r')
+      --line_end;
+
+    // The record follows the tag's process id, as in
+    // "W/google-breakpad( 3745): S FFEA6000 00000000...".
+    const char* record = FindBytes(key + key_length, line_end,
+                                   kRecordSeparator,
+                                   strlen(kRecordSeparator));
+    if (!record)
       continue;
-    }
-    if (line.find(kMicrodumpBegin) != string::npos) {
+    record += strlen(kRecordSeparator);
+
+    if (StartsWith(record, line_end, kMicrodumpBegin)) {
       in_microdump = true;
       continue;
     }
-    if (line.find(kMicrodumpEnd) != string::npos) {
+    if (StartsWith(record, line_end, kMicrodumpEnd)) {
+      found_end = true;
       break;
     }
 
-    if (!in_microdump) {
+    if (!in_microdump || line_end - record < 2 || record[1] != ' ') {
       continue;
     }
 
-    size_t pos;
-    if ((pos = line.find(kOsKey)) != string::npos) {
-      string os_str(line, pos + strlen(kOsKey));
-      std::istringstream os_tokens(os_str);
-      string os_id;
-      string num_cpus;
-      string os_version;
-      // This reflect the actual HW arch and might not match the arch emulated
-      // for the execution (e.g., running a 32-bit binary on a 64-bit cpu).
-      string hw_arch;
-
-      os_tokens >> os_id;
-      os_tokens >> arch;
-      os_tokens >> num_cpus;
-      os_tokens >> hw_arch;
-      std::getline(os_tokens, os_version);
-      os_version.erase(0, 1);  // remove leading space.
-
-      system_info_->cpu = hw_arch;
-      system_info_->cpu_count = HexStrToL<uint8_t>(num_cpus);
-      system_info_->os_version = os_version;
-
-      if (os_id == "L") {
-        system_info_->os = "Linux";
-        system_info_->os_short = "linux";
-      } else if (os_id == "A") {
-        system_info_->os = "Android";
-        system_info_->os_short = "android";
-      }
+    const char* fields = record + 2;
+    switch (record[0]) {
+      case 'O': {
+        // This reflect the actual HW arch and might not match the arch
+        // emulated for the execution (e.g., running a 32-bit binary on a
+        // 64-bit cpu).
+        string os_id = NextToken(&fields, line_end);
+        arch = NextToken(&fields, line_end);
+        uint64_t num_cpus = NextHexToken(&fields, line_end);
+        string hw_arch = NextToken(&fields, line_end);
+        if (fields < line_end)
+          ++fields;  // Skip the space before the version.
+
+        system_info_->cpu = hw_arch;
+        system_info_->cpu_count = static_cast<uint8_t>(num_cpus);
+        system_info_->os_version = string(fields, line_end - fields);
+
+        if (os_id == "L") {
+          system_info_->os = "Linux";
+          system_info_->os_short = "linux";
+        } else if (os_id == "A") {
+          system_info_->os = "Android";
+          system_info_->os_short = "android";
+        }
 
-      // OS line also contains release and version for future use.
-    } else if ((pos = line.find(kStackKey)) != string::npos) {
-      if (line.find(kStackFirstLineKey) != string::npos) {
-        // The first line of the stack (S 0 stack header) provides the value of
-        // the stack pointer, the start address of the stack being dumped and
-        // the length of the stack. We could use it in future to double check
-        // that we received all the stack as expected.
-        continue;
+        // OS line also contains release and version for future use.
+        break;
       }
-      string stack_str(line, pos + strlen(kStackKey));
-      std::istringstream stack_tokens(stack_str);
-      string start_addr_str;
-      string raw_content;
-      stack_tokens >> start_addr_str;
-      stack_tokens >> raw_content;
-      uint64_t start_addr = HexStrToL<uint64_t>(start_addr_str);
-
-      if (stack_start != 0) {
-        // Verify that the stack chunks in the microdump are contiguous.
-        assert(start_addr == stack_start + stack_content.size());
-      } else {
-        stack_start = start_addr;
+
+      case 'S': {
+        if (StartsWith(fields, line_end, "0 ")) {
+          // The first line of the stack (S 0 stack header) provides the
+          // value of the stack pointer, the start address of the stack
+          // being dumped and the length of the stack. A compact microdump
+          // needs the last two to lay out its sparse stack.
+          NextToken(&fields, line_end);  // The "0".
+          NextHexToken(&fields, line_end);  // The stack pointer.
+          stack_header_start = NextHexToken(&fields, line_end);
+          stack_header_length = NextHexToken(&fields, line_end);
+          break;
+        }
+        uint64_t start_addr = NextHexToken(&fields, line_end);
+        while (fields < line_end && *fields == ' ')
+          ++fields;
+
+        if (stack_start != 0) {
+          // Verify that the stack chunks in the microdump are contiguous.
+          assert(start_addr == stack_start + stack_content.size());
+        } else {
+          stack_start = start_addr;
+        }
+        AppendHexBytes(fields, line_end, &stack_content);
+        break;
       }
-      std::vector<uint8_t> chunk = ParseHexBuf(raw_content);
-      stack_content.insert(stack_content.end(), chunk.begin(), chunk.end());
-
-    } else if ((pos = line.find(kCpuKey)) != string::npos) {
-      string cpu_state_str(line, pos + strlen(kCpuKey));
-      std::vector<uint8_t> cpu_state_raw = ParseHexBuf(cpu_state_str);
-      if (strcmp(arch.c_str(), kArmArchitecture) == 0) {
-        if (cpu_state_raw.size() != sizeof(MDRawContextARM)) {
-          std::cerr << "Malformed CPU context. Got " << cpu_state_raw.size() <<
-              " bytes instead of " << sizeof(MDRawContextARM) << std::endl;
-          continue;
+
+      case 's': {
+        // A run of the stack words kept in a compact microdump. The rest
+        // of the stack reads as zero.
+        uint64_t start_addr = NextHexToken(&fields, line_end);
+        while (fields < line_end && *fields == ' ')
+          ++fields;
+        if (stack_content.empty()) {
+          stack_start = stack_header_length != 0 ? stack_header_start
+                                                 : start_addr;
+          stack_content.resize(std::min(stack_header_length,
+                                        kMaxCompactStackLength));
         }
-        MDRawContextARM* arm = new MDRawContextARM();
-        memcpy(arm, &cpu_state_raw[0], cpu_state_raw.size());
-        context_->SetContextARM(arm);
-      } else if (strcmp(arch.c_str(), kArm64Architecture) == 0) {
-        if (cpu_state_raw.size() != sizeof(MDRawContextARM64)) {
-          std::cerr << "Malformed CPU context. Got " << cpu_state_raw.size() <<
-              " bytes instead of " << sizeof(MDRawContextARM64) << std::endl;
-          continue;
+        std::vector<uint8_t> words;
+        AppendBase64Bytes(fields, line_end, &words);
+        uint64_t offset = start_addr - stack_start;
+        if (start_addr < stack_start ||
+            offset + words.size() > kMaxCompactStackLength) {
+          std::cerr << "Stack words outside of the stack at 0x" << std::hex
+                    << start_addr << std::dec << std::endl;
+          break;
         }
-        MDRawContextARM64* arm = new MDRawContextARM64();
-        memcpy(arm, &cpu_state_raw[0], cpu_state_raw.size());
-        context_->SetContextARM64(arm);
-      } else {
-        std::cerr << "Unsupported architecture: " << arch << std::endl;
+        if (offset + words.size() > stack_content.size())
+          stack_content.resize(offset + words.size());
+        std::copy(words.begin(), words.end(), stack_content.begin() + offset);
+        break;
+      }
+
+      case 'C':
+      case 'c': {
+        std::vector<uint8_t> cpu_state_raw;
+        if (record[0] == 'C')
+          AppendHexBytes(fields, line_end, &cpu_state_raw);
+        else
+          AppendBase64Bytes(fields, line_end, &cpu_state_raw);
+        if (strcmp(arch.c_str(), kArmArchitecture) == 0) {
+          if (cpu_state_raw.size() != sizeof(MDRawContextARM)) {
+            std::cerr << "Malformed CPU context. Got " << cpu_state_raw.size()
+                      << " bytes instead of " << sizeof(MDRawContextARM)
+                      << std::endl;
+            break;
+          }
+          MDRawContextARM* arm = new MDRawContextARM();
+          memcpy(arm, &cpu_state_raw[0], cpu_state_raw.size());
+          context_->SetContextARM(arm);
+        } else if (strcmp(arch.c_str(), kArm64Architecture) == 0) {
+          if (cpu_state_raw.size() != sizeof(MDRawContextARM64)) {
+            std::cerr << "Malformed CPU context. Got " << cpu_state_raw.size()
+                      << " bytes instead of " << sizeof(MDRawContextARM64)
+                      << std::endl;
+            break;
+          }
+          MDRawContextARM64* arm = new MDRawContextARM64();
+          memcpy(arm, &cpu_state_raw[0], cpu_state_raw.size());
+          context_->SetContextARM64(arm);
+        } else {
+          std::cerr << "Unsupported architecture: " << arch << std::endl;
+        }
+        break;
+      }
+
+      case 'M': {
+        uint64_t addr = NextHexToken(&fields, line_end);
+        NextToken(&fields, line_end);  // The offset.
+        uint64_t size = NextHexToken(&fields, line_end);
+        string identifier = NextToken(&fields, line_end);
+        string filename = NextToken(&fields, line_end);
+
+        modules_->Add(new BasicCodeModule(
+            addr,                       // base_address
+            size,                       // size
+            filename,                   // code_file
+            identifier,                 // code_identifier
+            filename,                   // debug_file
+            identifier,                 // debug_identifier
+            ""));                       // version
+        break;
       }
-    } else if ((pos = line.find(kMmapKey)) != string::npos) {
-      string mmap_line(line, pos + strlen(kMmapKey));
-      std::istringstream mmap_tokens(mmap_line);
-      string addr, offset, size, identifier, filename;
-      mmap_tokens >> addr;
-      mmap_tokens >> offset;
-      mmap_tokens >> size;
-      mmap_tokens >> identifier;
-      mmap_tokens >> filename;
-
-      modules_->Add(new BasicCodeModule(
-          HexStrToL<uint64_t>(addr),  // base_address
-          HexStrToL<uint64_t>(size),  // size
-          filename,                   // code_file
-          identifier,                 // code_identifier
-          filename,                   // debug_file
-          identifier,                 // debug_identifier
-          ""));                       // version
     }
   }
-  stack_region_->Init(stack_start, stack_content);
+  stack_region_->base_address_ = stack_start;
+  if (end)
+    *end = found_end ? cursor - data : size;
 }
 
 }  // namespace google_breakpad
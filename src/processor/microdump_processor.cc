@@ -35,20 +35,120 @@
 
 #include <assert.h>
 
+#ifndef _WIN32
+#include <pthread.h>
+#endif  // _WIN32
+
+#include <map>
+#include <set>
 #include <string>
+#include <vector>
 
+#include "common/scoped_ptr.h"
 #include "common/using_std_string.h"
 #include "google_breakpad/processor/call_stack.h"
+#include "google_breakpad/processor/code_module.h"
 #include "google_breakpad/processor/microdump.h"
 #include "google_breakpad/processor/process_state.h"
+#include "google_breakpad/processor/source_line_resolver_interface.h"
 #include "google_breakpad/processor/stackwalker.h"
 #include "google_breakpad/processor/stack_frame_symbolizer.h"
+#include "processor/linked_ptr.h"
 #include "processor/logging.h"
+#include "processor/mutex.h"
+#include "processor/serialized_stack_frame_symbolizer.h"
 
 namespace google_breakpad {
 
+using std::vector;
+
+namespace {
+
+// Returns a string that identifies the symbols |modules| need: the debug
+// file and identifier of each module, in sorted order.  Microdumps whose
+// modules have the same key can be symbolized with the same symbol files,
+// wherever the modules were loaded.
+string ModuleSetKey(const CodeModules* modules) {
+  std::set<string> module_keys;
+  for (unsigned int i = 0; i < modules->module_count(); ++i) {
+    const CodeModule* module = modules->GetModuleAtIndex(i);
+    module_keys.insert(module->debug_file() + '\n' +
+                       module->debug_identifier() + '\n');
+  }
+
+  string key;
+  for (std::set<string>::const_iterator module_key = module_keys.begin();
+       module_key != module_keys.end();
+       ++module_key) {
+    key += *module_key;
+  }
+  return key;
+}
+
+}  // namespace
+
+// The microdumps of a ProcessBatch call, shared by the walker threads.
+// Each thread takes the next unprocessed microdump in |order| until none
+// remain.
+struct MicrodumpProcessor::MicrodumpBatch {
+  MicrodumpBatch() : frame_symbolizer(NULL), callback(NULL), next(0) {}
+
+  // Indexed like the batch.  NULL for an empty microdump, and reset once a
+  // microdump has been processed.
+  vector<linked_ptr<Microdump> > microdumps;
+  // The microdumps of the group being processed, in the order to process
+  // them.
+  vector<size_t> order;
+  StackFrameSymbolizer* frame_symbolizer;
+  MicrodumpProcessor::BatchCallback* callback;
+
+  // Guards |next|.
+  Mutex mutex;
+  size_t next;
+
+  // Held while |callback| runs.
+  Mutex callback_mutex;
+};
+
+// static
+void* MicrodumpProcessor::ProcessBatchThreadMain(void* arg) {
+  MicrodumpBatch* batch = static_cast<MicrodumpBatch*>(arg);
+  while (true) {
+    size_t position;
+    {
+      AutoMutex lock(&batch->mutex);
+      position = batch->next++;
+    }
+    if (position >= batch->order.size())
+      break;
+
+    size_t index = batch->order[position];
+    linked_ptr<Microdump>& microdump = batch->microdumps[index];
+    ProcessState process_state;
+    ProcessResult result;
+    if (microdump.get()) {
+      result = ProcessMicrodump(microdump.get(), batch->frame_symbolizer,
+                                &process_state);
+    } else {
+      BPLOG(ERROR) << "Microdump " << index << " is empty.";
+      result = PROCESS_ERROR_MINIDUMP_NOT_FOUND;
+    }
+
+    {
+      AutoMutex lock(&batch->callback_mutex);
+      batch->callback->Processed(index, result, &process_state);
+    }
+
+    // The state refers to the microdump's memory, so it goes first.
+    process_state.Clear();
+    microdump.reset();
+  }
+  return NULL;
+}
+
 MicrodumpProcessor::MicrodumpProcessor(StackFrameSymbolizer* frame_symbolizer)
-    : frame_symbolizer_(frame_symbolizer) {
+    : frame_symbolizer_(frame_symbolizer),
+      walker_thread_count_(1) {
   assert(frame_symbolizer);
 }
 
@@ -66,17 +166,27 @@ ProcessResult MicrodumpProcessor::Process(const string &microdump_contents,
   }
 
   Microdump microdump(microdump_contents);
-  process_state->modules_ = microdump.GetModules()->Copy();
+  return ProcessMicrodump(&microdump, frame_symbolizer_, process_state);
+}
+
+// static
+ProcessResult MicrodumpProcessor::ProcessMicrodump(
+    Microdump* microdump,
+    StackFrameSymbolizer* frame_symbolizer,
+    ProcessState* process_state) {
+  process_state->modules_ = microdump->GetModules()->Copy();
   scoped_ptr<Stackwalker> stackwalker(
       Stackwalker::StackwalkerForCPU(
                             &process_state->system_info_,
-                            microdump.GetContext(),
-                            microdump.GetMemory(),
+                            microdump->GetContext(),
+                            microdump->GetMemory(),
                             process_state->modules_,
-                            frame_symbolizer_));
+                            frame_symbolizer));
 
-  scoped_ptr<CallStack> stack(new CallStack());
+  scoped_ptr<CallStack> stack(
+      process_state->NewCallStack(&process_state->frame_arena_));
   if (stackwalker.get()) {
+    stackwalker->set_frame_arena(&process_state->frame_arena_);
     if (!stackwalker->Walk(stack.get(),
                            &process_state->modules_without_symbols_,
                            &process_state->modules_with_corrupt_symbols_)) {
@@ -89,12 +199,107 @@ ProcessResult MicrodumpProcessor::Process(const string &microdump_contents,
   }
 
   process_state->threads_.push_back(stack.release());
-  process_state->thread_memory_regions_.push_back(microdump.GetMemory());
+  process_state->thread_memory_regions_.push_back(microdump->GetMemory());
   process_state->crashed_ = true;
   process_state->requesting_thread_ = 0;
-  process_state->system_info_ = *microdump.GetSystemInfo();
+  process_state->system_info_ = *microdump->GetSystemInfo();
 
   return PROCESS_OK;
 }
 
+void MicrodumpProcessor::ProcessBatch(const vector<string>& microdumps,
+                                      BatchCallback* callback) {
+  assert(callback);
+
+  MicrodumpBatch batch;
+  batch.callback = callback;
+  batch.microdumps.resize(microdumps.size());
+
+  // Group the microdumps by the symbols they need, with the groups and the
+  // microdumps within each in batch order.  Empty microdumps form a group
+  // of their own.
+  std::map<string, size_t> group_indices;
+  vector<vector<size_t> > groups(1);
+  for (size_t i = 0; i < microdumps.size(); ++i) {
+    if (microdumps[i].empty()) {
+      groups[0].push_back(i);
+      continue;
+    }
+    batch.microdumps[i].reset(new Microdump(microdumps[i]));
+    string key = ModuleSetKey(batch.microdumps[i]->GetModules());
+    std::map<string, size_t>::iterator group =
+        group_indices.insert(std::make_pair(key, groups.size())).first;
+    if (group->second == groups.size())
+      groups.push_back(vector<size_t>());
+    groups[group->second].push_back(i);
+  }
+
+  batch.frame_symbolizer = frame_symbolizer_;
+#ifndef _WIN32
+  scoped_ptr<StackFrameSymbolizer> serialized_symbolizer;
+  if (walker_thread_count_ > 1) {
+    serialized_symbolizer.reset(
+        new SerializedStackFrameSymbolizer(frame_symbolizer_));
+    batch.frame_symbolizer = serialized_symbolizer.get();
+  }
+#endif  // _WIN32
+
+  // The resolver knows modules by their code file alone, so the symbols
+  // a group loaded for a code file are unloaded before a later group that
+  // needs a different build of it.  This maps each code file to the debug
+  // identifier its symbols were last loaded for.
+  std::map<string, string> loaded_identifiers;
+  SourceLineResolverInterface* resolver = frame_symbolizer_->resolver();
+
+  for (size_t group = 0; group < groups.size(); ++group) {
+    if (groups[group].empty())
+      continue;
+
+    Microdump* first = batch.microdumps[groups[group][0]].get();
+    if (first) {
+      const CodeModules* modules = first->GetModules();
+      for (unsigned int i = 0; i < modules->module_count(); ++i) {
+        const CodeModule* module = modules->GetModuleAtIndex(i);
+        std::map<string, string>::iterator loaded =
+            loaded_identifiers.insert(std::make_pair(
+                module->code_file(), module->debug_identifier())).first;
+        if (loaded->second != module->debug_identifier()) {
+          if (resolver && resolver->HasModule(module))
+            resolver->UnloadModule(module);
+          loaded->second = module->debug_identifier();
+        }
+      }
+      // Forget the modules found without symbols for the last group.
+      frame_symbolizer_->Reset();
+    }
+
+    batch.order.swap(groups[group]);
+    batch.next = 0;
+
+    unsigned int thread_count = walker_thread_count_;
+    if (thread_count > batch.order.size())
+      thread_count = batch.order.size();
+
+#ifndef _WIN32
+    // The calling thread walks too.
+    vector<pthread_t> threads;
+    for (unsigned int i = 1; i < thread_count; ++i) {
+      pthread_t thread;
+      if (pthread_create(&thread, NULL, ProcessBatchThreadMain, &batch) != 0) {
+        BPLOG(ERROR) << "Could not create microdump walker thread " << i;
+        break;
+      }
+      threads.push_back(thread);
+    }
+#endif  // _WIN32
+
+    ProcessBatchThreadMain(&batch);
+
+#ifndef _WIN32
+    for (size_t i = 0; i < threads.size(); ++i)
+      pthread_join(threads[i], NULL);
+#endif  // _WIN32
+  }
+}
+
 }  // namespace google_breakpad
@@ -37,6 +37,7 @@
 #include "breakpad_googletest_includes.h"
 #include "google_breakpad/processor/basic_source_line_resolver.h"
 #include "google_breakpad/processor/call_stack.h"
+#include "google_breakpad/processor/microdump.h"
 #include "google_breakpad/processor/microdump_processor.h"
 #include "google_breakpad/processor/process_state.h"
 #include "google_breakpad/processor/stack_frame.h"
@@ -47,6 +48,7 @@
 namespace {
 
 using google_breakpad::BasicSourceLineResolver;
+using google_breakpad::Microdump;
 using google_breakpad::MicrodumpProcessor;
 using google_breakpad::ProcessState;
 using google_breakpad::SimpleSymbolSupplier;
@@ -189,6 +191,137 @@ TEST_F(MicrodumpProcessorTest, TestProcessArm64) {
             state.threads()->at(0)->frames()->at(7)->module->code_file());
 }
 
+// A compact microdump keeps only the stack words the walker needs, so it
+// should give the same stack as the full microdump it was made from.
+TEST_F(MicrodumpProcessorTest, TestProcessCompact) {
+  // The full microdump, its compact form, and the number of modules the
+  // compact form keeps.
+  const struct {
+    const char* full;
+    const char* compact;
+    unsigned int module_count;
+  } kDumps[] = {
+    { "microdump-arm.dmp", "microdump-arm-compact.dmp", 2 },
+    { "microdump-arm64.dmp", "microdump-arm64-compact.dmp", 3 },
+  };
+  for (size_t i = 0; i < sizeof(kDumps) / sizeof(kDumps[0]); ++i) {
+    ProcessState full_state, compact_state;
+    AnalyzeDump(kDumps[i].full, &full_state, false /* omit_symbols */);
+    AnalyzeDump(kDumps[i].compact, &compact_state, false /* omit_symbols */);
+
+    ASSERT_EQ(full_state.system_info()->cpu,
+              compact_state.system_info()->cpu);
+    ASSERT_EQ(kDumps[i].module_count,
+              compact_state.modules()->module_count());
+    const std::vector<google_breakpad::StackFrame*>* full_frames =
+        full_state.threads()->at(0)->frames();
+    const std::vector<google_breakpad::StackFrame*>* compact_frames =
+        compact_state.threads()->at(0)->frames();
+    ASSERT_EQ(full_frames->size(), compact_frames->size());
+    for (size_t j = 0; j < full_frames->size(); ++j) {
+      EXPECT_EQ(full_frames->at(j)->instruction,
+                compact_frames->at(j)->instruction);
+      EXPECT_EQ(full_frames->at(j)->function_name,
+                compact_frames->at(j)->function_name);
+    }
+  }
+}
+
+TEST_F(MicrodumpProcessorTest, TestParseConsecutiveMicrodumps) {
+  string arm_contents, arm64_contents;
+  ReadFile(files_path_ + "microdump-arm.dmp", &arm_contents);
+  ReadFile(files_path_ + "microdump-arm64.dmp", &arm64_contents);
+  string log = "I/other( 1234): unrelated line\n" + arm_contents +
+               "I/other( 1234): another unrelated line\n" + arm64_contents;
+
+  size_t end = 0;
+  Microdump arm(log.data(), log.size(), &end);
+  ASSERT_LT(end, log.size());
+  ASSERT_EQ("armv7l", arm.GetSystemInfo()->cpu);
+  ASSERT_EQ(6U, arm.GetModules()->module_count());
+
+  size_t start = end;
+  Microdump arm64(log.data() + start, log.size() - start, &end);
+  ASSERT_EQ(log.size() - start, end);
+  ASSERT_EQ("aarch64", arm64.GetSystemInfo()->cpu);
+  ASSERT_EQ(8U, arm64.GetModules()->module_count());
+  ASSERT_EQ(arm64.GetMemory()->GetSize(),
+            Microdump(arm64_contents).GetMemory()->GetSize());
+}
+
+// Records what ProcessBatch reports for each microdump.
+class BatchRecorder : public MicrodumpProcessor::BatchCallback {
+ public:
+  explicit BatchRecorder(size_t batch_size)
+      : calls(batch_size, 0),
+        results(batch_size, google_breakpad::PROCESS_OK),
+        cpus(batch_size),
+        top_functions(batch_size),
+        frame_counts(batch_size, 0) {}
+
+  virtual void Processed(size_t index,
+                         google_breakpad::ProcessResult result,
+                         ProcessState* process_state) {
+    ++calls[index];
+    results[index] = result;
+    if (result != google_breakpad::PROCESS_OK)
+      return;
+    cpus[index] = process_state->system_info()->cpu;
+    const std::vector<google_breakpad::StackFrame*>* frames =
+        process_state->threads()->at(0)->frames();
+    top_functions[index] = frames->at(0)->function_name;
+    frame_counts[index] = frames->size();
+  }
+
+  std::vector<int> calls;
+  std::vector<google_breakpad::ProcessResult> results;
+  std::vector<string> cpus;
+  std::vector<string> top_functions;
+  std::vector<size_t> frame_counts;
+};
+
+TEST_F(MicrodumpProcessorTest, TestProcessBatch) {
+  string arm_contents, arm64_contents;
+  ReadFile(files_path_ + "microdump-arm.dmp", &arm_contents);
+  ReadFile(files_path_ + "microdump-arm64.dmp", &arm64_contents);
+  std::vector<string> microdumps;
+  microdumps.push_back(arm_contents);
+  microdumps.push_back(arm64_contents);
+  microdumps.push_back("");
+  microdumps.push_back(arm_contents);
+  microdumps.push_back(arm64_contents);
+
+  for (unsigned int thread_count = 1; thread_count <= 3; thread_count += 2) {
+    SimpleSymbolSupplier supplier(files_path_ + "symbols/microdump");
+    BasicSourceLineResolver resolver;
+    StackFrameSymbolizer frame_symbolizer(&supplier, &resolver);
+    MicrodumpProcessor processor(&frame_symbolizer);
+    processor.set_walker_thread_count(thread_count);
+
+    BatchRecorder recorder(microdumps.size());
+    processor.ProcessBatch(microdumps, &recorder);
+
+    for (size_t i = 0; i < microdumps.size(); ++i)
+      ASSERT_EQ(1, recorder.calls[i]);
+    ASSERT_EQ(google_breakpad::PROCESS_ERROR_MINIDUMP_NOT_FOUND,
+              recorder.results[2]);
+    for (size_t i = 0; i < microdumps.size(); i += 3) {
+      ASSERT_EQ(google_breakpad::PROCESS_OK, recorder.results[i]);
+      ASSERT_EQ("armv7l", recorder.cpus[i]);
+      ASSERT_EQ(8U, recorder.frame_counts[i]);
+      ASSERT_EQ("MicrodumpWriterTest_Setup_Test::TestBody",
+                recorder.top_functions[i]);
+    }
+    for (size_t i = 1; i < microdumps.size(); i += 3) {
+      ASSERT_EQ(google_breakpad::PROCESS_OK, recorder.results[i]);
+      ASSERT_EQ("aarch64", recorder.cpus[i]);
+      ASSERT_EQ(9U, recorder.frame_counts[i]);
+      ASSERT_EQ("MicrodumpWriterTest_Setup_Test::TestBody",
+                recorder.top_functions[i]);
+    }
+  }
+}
+
 }  // namespace
 
 int main(int argc, char* argv[]) {
@@ -48,10 +48,19 @@
 #define PRIx32 "lx"
 #define snprintf _snprintf
 #else  // _WIN32
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include <unistd.h>
 #define O_BINARY 0
 #endif  // _WIN32
 
+#if defined(__GNUC__) && !defined(__ANDROID__) && \
+    (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define MINIDUMP_SWAP_SSSE3 1
+#endif
+
+#include <algorithm>
 #include <fstream>
 #include <iostream>
 #include <limits>
@@ -60,11 +69,15 @@
 
 #include "processor/range_map-inl.h"
 
+#include "common/minidump_compression.h"
+#include "common/probes.h"
 #include "common/scoped_ptr.h"
 #include "google_breakpad/processor/dump_context.h"
+#include "google_breakpad/processor/minidump_reader.h"
 #include "processor/basic_code_module.h"
 #include "processor/basic_code_modules.h"
 #include "processor/logging.h"
+#include "processor/mutex.h"
 
 namespace google_breakpad {
 
@@ -74,6 +87,24 @@ using std::ifstream;
 using std::numeric_limits;
 using std::vector;
 
+// Writes |size| bytes at |data| to stdout as pairs of lowercase hex
+// digits, formatting them a buffer at a time rather than calling printf
+// for every byte: memory regions run to megabytes.
+static void PrintHexBytes(const uint8_t* data, size_t size) {
+  static const char kHexDigits[] = "0123456789abcdef";
+  char buffer[65536];
+  size_t used = 0;
+  for (size_t i = 0; i < size; ++i) {
+    buffer[used++] = kHexDigits[data[i] >> 4];
+    buffer[used++] = kHexDigits[data[i] & 0xf];
+    if (used == sizeof(buffer)) {
+      fwrite(buffer, 1, used, stdout);
+      used = 0;
+    }
+  }
+  fwrite(buffer, 1, used, stdout);
+}
+
 // Returns true iff |context_size| matches exactly one of the sizes of the
 // various MDRawContext* types.
 // TODO(blundell): This function can be removed once
@@ -323,6 +354,72 @@ static inline void Swap(MDTimeZoneInformation* time_zone) {
   Swap(&time_zone->daylight_bias);
 }
 
+
+// Bulk swapping of structures made of 32- and 64-bit fields that don't
+// straddle 16-byte boundaries.  Each 16-byte block of such a structure is
+// swapped with one byte shuffle: byte i of the swapped block is byte
+// shuffle[i] of the original.  With SSSE3, that is a single pshufb.
+
+static const uint8_t kSwap32x4[16] =
+    { 3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12 };
+static const uint8_t kSwap64x2[16] =
+    { 7, 6, 5, 4, 3, 2, 1, 0, 15, 14, 13, 12, 11, 10, 9, 8 };
+static const uint8_t kSwap64And32x2[16] =
+    { 7, 6, 5, 4, 3, 2, 1, 0, 11, 10, 9, 8, 15, 14, 13, 12 };
+
+// The shuffles for the blocks of an MDMemoryDescriptor and an MDRawThread.
+static const uint8_t* const kMemoryDescriptorShuffles[] = { kSwap64And32x2 };
+static const uint8_t* const kThreadShuffles[] =
+    { kSwap32x4, kSwap64x2, kSwap32x4 };
+static const size_t kMaxShuffleBlocks = 3;
+
+static void SwapBlocksPortable(uint8_t* data, size_t count,
+                               const uint8_t* const* shuffles,
+                               size_t block_count) {
+  for (size_t i = 0; i < count; ++i) {
+    for (size_t block = 0; block < block_count; ++block, data += 16) {
+      uint8_t original[16];
+      memcpy(original, data, sizeof(original));
+      for (int j = 0; j < 16; ++j)
+        data[j] = original[shuffles[block][j]];
+    }
+  }
+}
+
+#if defined(MINIDUMP_SWAP_SSSE3)
+__attribute__((target("ssse3")))
+static void SwapBlocksSSSE3(uint8_t* data, size_t count,
+                            const uint8_t* const* shuffles,
+                            size_t block_count) {
+  __m128i masks[kMaxShuffleBlocks];
+  for (size_t block = 0; block < block_count; ++block) {
+    masks[block] =
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(shuffles[block]));
+  }
+  for (size_t i = 0; i < count; ++i) {
+    for (size_t block = 0; block < block_count; ++block, data += 16) {
+      __m128i* p = reinterpret_cast<__m128i*>(data);
+      _mm_storeu_si128(p, _mm_shuffle_epi8(_mm_loadu_si128(p), masks[block]));
+    }
+  }
+}
+#endif  // MINIDUMP_SWAP_SSSE3
+
+// Swaps |count| consecutive structures at |data|, each made of
+// |block_count| 16-byte blocks to be swapped by |shuffles|.
+static void SwapBlocks(void* data, size_t count,
+                       const uint8_t* const* shuffles, size_t block_count) {
+  assert(block_count <= kMaxShuffleBlocks);
+  uint8_t* bytes = static_cast<uint8_t*>(data);
+#if defined(MINIDUMP_SWAP_SSSE3)
+  if (__builtin_cpu_supports("ssse3")) {
+    SwapBlocksSSSE3(bytes, count, shuffles, block_count);
+    return;
+  }
+#endif  // MINIDUMP_SWAP_SSSE3
+  SwapBlocksPortable(bytes, count, shuffles, block_count);
+}
+
 static void ConvertUTF16BufferToUTF8String(const uint16_t* utf16_data,
                                            size_t max_length_in_bytes,
                                            string* utf8_result,
@@ -1192,7 +1289,8 @@ uint32_t MinidumpMemoryRegion::max_bytes_ = 1024 * 1024;  // 1MB
 MinidumpMemoryRegion::MinidumpMemoryRegion(Minidump* minidump)
     : MinidumpObject(minidump),
       descriptor_(NULL),
-      memory_(NULL) {
+      memory_(NULL),
+      memory_data_(NULL) {
 }
 
 
@@ -1216,17 +1314,12 @@ const uint8_t* MinidumpMemoryRegion::GetMemory() const {
     return NULL;
   }
 
-  if (!memory_) {
+  if (!memory_data_) {
     if (descriptor_->memory.data_size == 0) {
       BPLOG(ERROR) << "MinidumpMemoryRegion is empty";
       return NULL;
     }
 
-    if (!minidump_->SeekSet(descriptor_->memory.rva)) {
-      BPLOG(ERROR) << "MinidumpMemoryRegion could not seek to memory region";
-      return NULL;
-    }
-
     if (descriptor_->memory.data_size > max_bytes_) {
       BPLOG(ERROR) << "MinidumpMemoryRegion size " <<
                       descriptor_->memory.data_size << " exceeds maximum " <<
@@ -1234,6 +1327,18 @@ const uint8_t* MinidumpMemoryRegion::GetMemory() const {
       return NULL;
     }
 
+    // Memory contents are never byte-swapped, so a memory-backed minidump
+    // can hand out its own copy of the region.
+    memory_data_ = minidump_->GetMappedBytes(descriptor_->memory.rva,
+                                             descriptor_->memory.data_size);
+    if (memory_data_)
+      return memory_data_;
+
+    if (!minidump_->SeekSet(descriptor_->memory.rva)) {
+      BPLOG(ERROR) << "MinidumpMemoryRegion could not seek to memory region";
+      return NULL;
+    }
+
     scoped_ptr< vector<uint8_t> > memory(
         new vector<uint8_t>(descriptor_->memory.data_size));
 
@@ -1243,9 +1348,10 @@ const uint8_t* MinidumpMemoryRegion::GetMemory() const {
     }
 
     memory_ = memory.release();
+    memory_data_ = &(*memory_)[0];
   }
 
-  return &(*memory_)[0];
+  return memory_data_;
 }
 
 
@@ -1272,6 +1378,7 @@ uint32_t MinidumpMemoryRegion::GetSize() const {
 void MinidumpMemoryRegion::FreeMemory() {
   delete memory_;
   memory_ = NULL;
+  memory_data_ = NULL;
 }
 
 
@@ -1315,6 +1422,9 @@ bool MinidumpMemoryRegion::GetMemoryAtAddressInternal(uint64_t address,
   if (minidump_->swap())
     Swap(value);
 
+  if (minidump_->memory_read_log())
+    minidump_->memory_read_log()->Add(address, sizeof(T));
+
   return true;
 }
 
@@ -1343,6 +1453,27 @@ bool MinidumpMemoryRegion::GetMemoryAtAddress(uint64_t  address,
 }
 
 
+const uint8_t* MinidumpMemoryRegion::GetContiguousMemory(uint64_t address,
+                                                         uint32_t size) const {
+  if (!valid_ || minidump_->swap())
+    return NULL;
+
+  if (address < descriptor_->start_of_memory_range ||
+      size > numeric_limits<uint64_t>::max() - address ||
+      address + size > descriptor_->start_of_memory_range +
+                       descriptor_->memory.data_size) {
+    return NULL;
+  }
+
+  const uint8_t* memory = GetMemory();
+  if (!memory)
+    return NULL;
+  if (minidump_->memory_read_log())
+    minidump_->memory_read_log()->Add(address, size);
+  return &memory[address - descriptor_->start_of_memory_range];
+}
+
+
 void MinidumpMemoryRegion::Print() const {
   if (!valid_) {
     BPLOG(ERROR) << "MinidumpMemoryRegion cannot print invalid data";
@@ -1352,11 +1483,7 @@ void MinidumpMemoryRegion::Print() const {
   const uint8_t* memory = GetMemory();
   if (memory) {
     printf("0x");
-    for (unsigned int byte_index = 0;
-         byte_index < descriptor_->memory.data_size;
-         byte_index++) {
-      printf("%02x", memory[byte_index]);
-    }
+    PrintHexBytes(memory, descriptor_->memory.data_size);
     printf("\n");
   } else {
     printf("No memory\n");
@@ -1398,13 +1525,10 @@ bool MinidumpThread::Read() {
   }
 
   if (minidump_->swap()) {
-    Swap(&thread_.thread_id);
-    Swap(&thread_.suspend_count);
-    Swap(&thread_.priority_class);
-    Swap(&thread_.priority);
-    Swap(&thread_.teb);
-    Swap(&thread_.stack);
-    Swap(&thread_.thread_context);
+    assert(sizeof(thread_) == sizeof(kThreadShuffles) /
+                              sizeof(kThreadShuffles[0]) * 16);
+    SwapBlocks(&thread_, 1, kThreadShuffles,
+               sizeof(kThreadShuffles) / sizeof(kThreadShuffles[0]));
   }
 
   // Check for base + size overflow or undersize.
@@ -1608,6 +1732,7 @@ bool MinidumpThreadList::Read(uint32_t expected_size) {
   if (thread_count != 0) {
     scoped_ptr<MinidumpThreads> threads(
         new MinidumpThreads(thread_count, MinidumpThread(minidump_)));
+    id_to_thread_map_.reserve(thread_count);
 
     for (unsigned int thread_index = 0;
          thread_index < thread_count;
@@ -1628,14 +1753,21 @@ bool MinidumpThreadList::Read(uint32_t expected_size) {
         return false;
       }
 
-      if (GetThreadByID(thread_id)) {
+      id_to_thread_map_.push_back(IDToThread(thread_id, thread));
+    }
+
+    std::sort(id_to_thread_map_.begin(), id_to_thread_map_.end());
+    for (unsigned int entry_index = 1;
+         entry_index < id_to_thread_map_.size();
+         ++entry_index) {
+      if (id_to_thread_map_[entry_index].first ==
+          id_to_thread_map_[entry_index - 1].first) {
         // Another thread with this ID is already in the list.  Data error.
         BPLOG(ERROR) << "MinidumpThreadList found multiple threads with ID " <<
-                        HexString(thread_id) << " at thread " <<
-                        thread_index << "/" << thread_count;
+                        HexString(id_to_thread_map_[entry_index].first);
+        id_to_thread_map_.clear();
         return false;
       }
-      id_to_thread_map_[thread_id] = thread;
     }
 
     threads_ = threads.release();
@@ -1668,7 +1800,12 @@ MinidumpThread* MinidumpThreadList::GetThreadAtIndex(unsigned int index)
 MinidumpThread* MinidumpThreadList::GetThreadByID(uint32_t thread_id) {
   // Don't check valid_.  Read calls this method before everything is
   // validated.  It is safe to not check valid_ here.
-  return id_to_thread_map_[thread_id];
+  IDToThreadMap::const_iterator iterator =
+      std::lower_bound(id_to_thread_map_.begin(), id_to_thread_map_.end(),
+                       thread_id, IDToThreadLess());
+  if (iterator == id_to_thread_map_.end() || iterator->first != thread_id)
+    return NULL;
+  return iterator->second;
 }
 
 
@@ -1701,13 +1838,17 @@ uint32_t MinidumpModule::max_cv_bytes_ = 32768;
 uint32_t MinidumpModule::max_misc_bytes_ = 32768;
 
 
-MinidumpModule::MinidumpModule(Minidump* minidump)
+MinidumpModule::MinidumpModule(Minidump* minidump,
+                               Mutex* auxiliary_data_mutex)
     : MinidumpObject(minidump),
-      module_valid_(false),
+      auxiliary_data_mutex_(auxiliary_data_mutex),
+      auxiliary_data_read_(false),
       has_debug_info_(false),
+      system_info_(NULL),
       module_(),
       name_(NULL),
       cv_record_(NULL),
+      cv_record_data_(NULL),
       cv_record_signature_(MD_CVINFOUNKNOWN_SIGNATURE),
       misc_record_(NULL) {
 }
@@ -1726,12 +1867,14 @@ bool MinidumpModule::Read() {
   name_ = NULL;
   delete cv_record_;
   cv_record_ = NULL;
+  cv_record_data_ = NULL;
   cv_record_signature_ = MD_CVINFOUNKNOWN_SIGNATURE;
   delete misc_record_;
   misc_record_ = NULL;
 
-  module_valid_ = false;
+  auxiliary_data_read_ = false;
   has_debug_info_ = false;
+  system_info_ = NULL;
   valid_ = false;
 
   if (!minidump_->ReadBytes(&module_, MD_MODULE_SIZE)) {
@@ -1774,48 +1917,58 @@ bool MinidumpModule::Read() {
     return false;
   }
 
-  module_valid_ = true;
+  valid_ = true;
   return true;
 }
 
 
-bool MinidumpModule::ReadAuxiliaryData() {
-  if (!module_valid_) {
-    BPLOG(ERROR) << "Invalid MinidumpModule for ReadAuxiliaryData";
-    return false;
-  }
+bool MinidumpModule::ReadAuxiliaryData() const {
+  // The data doesn't change once it has been read, so only the first read
+  // takes the lock.  The release store below publishes the data to threads
+  // that see the flag set here.
+  if (__atomic_load_n(&auxiliary_data_read_, __ATOMIC_ACQUIRE))
+    return name_ != NULL;
+
+  AutoMutex lock(auxiliary_data_mutex_);
+  if (auxiliary_data_read_)
+    return name_ != NULL;
 
   // Each module must have a name.
   name_ = minidump_->ReadString(module_.module_name_rva);
-  if (!name_) {
+  if (!name_)
     BPLOG(ERROR) << "MinidumpModule could not read name";
-    return false;
-  }
-
-  // At this point, we have enough info for the module to be valid.
-  valid_ = true;
 
   // CodeView and miscellaneous debug records are only required if the
-  // module indicates that they exist.
-  if (module_.cv_record.data_size && !GetCVRecord(NULL)) {
+  // module indicates that they exist.  They are read even without a name,
+  // for GetCVRecord and GetMiscRecord.
+  // See issue #222: if a debugging record is of a format that's too large
+  // to handle, the module is still usable without it.
+  bool has_debug_info = true;
+  if (module_.cv_record.data_size && !ReadCVRecord()) {
     BPLOG(ERROR) << "MinidumpModule has no CodeView record, "
                     "but one was expected";
-    return false;
+    has_debug_info = false;
   }
 
-  if (module_.misc_record.data_size && !GetMiscRecord(NULL)) {
+  if (module_.misc_record.data_size && !ReadMiscRecord()) {
     BPLOG(ERROR) << "MinidumpModule has no miscellaneous debug record, "
                     "but one was expected";
-    return false;
+    has_debug_info = false;
   }
 
-  has_debug_info_ = true;
-  return true;
+  has_debug_info_ = has_debug_info && name_ != NULL;
+
+  // code_identifier needs the system info stream.  Getting it here, under
+  // the lock, keeps several modules from reading it at once.
+  system_info_ = minidump_->GetSystemInfo();
+
+  __atomic_store_n(&auxiliary_data_read_, true, __ATOMIC_RELEASE);
+  return name_ != NULL;
 }
 
 
 string MinidumpModule::code_file() const {
-  if (!valid_) {
+  if (!valid_ || !ReadAuxiliaryData()) {
     BPLOG(ERROR) << "Invalid MinidumpModule for code_file";
     return "";
   }
@@ -1825,7 +1978,7 @@ string MinidumpModule::code_file() const {
 
 
 string MinidumpModule::code_identifier() const {
-  if (!valid_) {
+  if (!valid_ || !ReadAuxiliaryData()) {
     BPLOG(ERROR) << "Invalid MinidumpModule for code_identifier";
     return "";
   }
@@ -1833,7 +1986,7 @@ string MinidumpModule::code_identifier() const {
   if (!has_debug_info_)
     return "";
 
-  MinidumpSystemInfo *minidump_system_info = minidump_->GetSystemInfo();
+  MinidumpSystemInfo *minidump_system_info = system_info_;
   if (!minidump_system_info) {
     BPLOG(ERROR) << "MinidumpModule code_identifier requires "
                     "MinidumpSystemInfo";
@@ -1888,7 +2041,7 @@ string MinidumpModule::code_identifier() const {
 
 
 string MinidumpModule::debug_file() const {
-  if (!valid_) {
+  if (!valid_ || !ReadAuxiliaryData()) {
     BPLOG(ERROR) << "Invalid MinidumpModule for debug_file";
     return "";
   }
@@ -1898,11 +2051,11 @@ string MinidumpModule::debug_file() const {
 
   string file;
   // Prefer the CodeView record if present.
-  if (cv_record_) {
+  if (cv_record_data_) {
     if (cv_record_signature_ == MD_CVINFOPDB70_SIGNATURE) {
       // It's actually an MDCVInfoPDB70 structure.
       const MDCVInfoPDB70* cv_record_70 =
-          reinterpret_cast<const MDCVInfoPDB70*>(&(*cv_record_)[0]);
+          reinterpret_cast<const MDCVInfoPDB70*>(cv_record_data_);
       assert(cv_record_70->cv_signature == MD_CVINFOPDB70_SIGNATURE);
 
       // GetCVRecord guarantees pdb_file_name is null-terminated.
@@ -1910,7 +2063,7 @@ string MinidumpModule::debug_file() const {
     } else if (cv_record_signature_ == MD_CVINFOPDB20_SIGNATURE) {
       // It's actually an MDCVInfoPDB20 structure.
       const MDCVInfoPDB20* cv_record_20 =
-          reinterpret_cast<const MDCVInfoPDB20*>(&(*cv_record_)[0]);
+          reinterpret_cast<const MDCVInfoPDB20*>(cv_record_data_);
       assert(cv_record_20->cv_header.signature == MD_CVINFOPDB20_SIGNATURE);
 
       // GetCVRecord guarantees pdb_file_name is null-terminated.
@@ -1968,7 +2121,7 @@ string MinidumpModule::debug_file() const {
 
 
 string MinidumpModule::debug_identifier() const {
-  if (!valid_) {
+  if (!valid_ || !ReadAuxiliaryData()) {
     BPLOG(ERROR) << "Invalid MinidumpModule for debug_identifier";
     return "";
   }
@@ -1979,11 +2132,11 @@ string MinidumpModule::debug_identifier() const {
   string identifier;
 
   // Use the CodeView record if present.
-  if (cv_record_) {
+  if (cv_record_data_) {
     if (cv_record_signature_ == MD_CVINFOPDB70_SIGNATURE) {
       // It's actually an MDCVInfoPDB70 structure.
       const MDCVInfoPDB70* cv_record_70 =
-          reinterpret_cast<const MDCVInfoPDB70*>(&(*cv_record_)[0]);
+          reinterpret_cast<const MDCVInfoPDB70*>(cv_record_data_);
       assert(cv_record_70->cv_signature == MD_CVINFOPDB70_SIGNATURE);
 
       // Use the same format that the MS symbol server uses in filesystem
@@ -2007,7 +2160,7 @@ string MinidumpModule::debug_identifier() const {
     } else if (cv_record_signature_ == MD_CVINFOPDB20_SIGNATURE) {
       // It's actually an MDCVInfoPDB20 structure.
       const MDCVInfoPDB20* cv_record_20 =
-          reinterpret_cast<const MDCVInfoPDB20*>(&(*cv_record_)[0]);
+          reinterpret_cast<const MDCVInfoPDB20*>(cv_record_data_);
       assert(cv_record_20->cv_header.signature == MD_CVINFOPDB20_SIGNATURE);
 
       // Use the same format that the MS symbol server uses in filesystem
@@ -2062,7 +2215,7 @@ string MinidumpModule::version() const {
   // quad of 16-bit ints that Windows uses.
 
   BPLOG_IF(INFO, version.empty()) << "MinidumpModule could not determine "
-                                     "version for " << *name_;
+                                     "version for " << code_file();
 
   return version;
 }
@@ -2073,208 +2226,232 @@ const CodeModule* MinidumpModule::Copy() const {
 }
 
 
-const uint8_t* MinidumpModule::GetCVRecord(uint32_t* size) {
-  if (!module_valid_) {
+const uint8_t* MinidumpModule::GetCVRecord(uint32_t* size) const {
+  if (!valid_) {
     BPLOG(ERROR) << "Invalid MinidumpModule for GetCVRecord";
     return NULL;
   }
 
-  if (!cv_record_) {
-    // This just guards against 0-sized CodeView records; more specific checks
-    // are used when the signature is checked against various structure types.
-    if (module_.cv_record.data_size == 0) {
-      return NULL;
-    }
+  ReadAuxiliaryData();
+  if (!cv_record_data_)
+    return NULL;
+
+  if (size)
+    *size = module_.cv_record.data_size;
 
+  return cv_record_data_;
+}
+
+
+bool MinidumpModule::ReadCVRecord() const {
+  // This just guards against 0-sized CodeView records; more specific checks
+  // are used when the signature is checked against various structure types.
+  if (module_.cv_record.data_size == 0) {
+    return false;
+  }
+
+  if (module_.cv_record.data_size > max_cv_bytes_) {
+    BPLOG(ERROR) << "MinidumpModule CodeView record size " <<
+                    module_.cv_record.data_size << " exceeds maximum " <<
+                    max_cv_bytes_;
+    return false;
+  }
+
+  // A record that doesn't need to be byte-swapped can be used in place
+  // from a memory-backed minidump.
+  const uint8_t* cv_data = NULL;
+  if (!minidump_->swap()) {
+    cv_data = minidump_->GetMappedBytes(module_.cv_record.rva,
+                                        module_.cv_record.data_size);
+  }
+
+  // Allocating something that will be accessed as MDCVInfoPDB70 or
+  // MDCVInfoPDB20 but is allocated as uint8_t[] can cause alignment
+  // problems.  x86 and ppc are able to cope, though.  This allocation
+  // style is needed because the MDCVInfoPDB70 or MDCVInfoPDB20 are
+  // variable-sized due to their pdb_file_name fields; these structures
+  // are not MDCVInfoPDB70_minsize or MDCVInfoPDB20_minsize and treating
+  // them as such would result in incomplete structures or overruns.
+  scoped_ptr< vector<uint8_t> > cv_record;
+  if (!cv_data) {
     if (!minidump_->SeekSet(module_.cv_record.rva)) {
       BPLOG(ERROR) << "MinidumpModule could not seek to CodeView record";
-      return NULL;
+      return false;
     }
 
-    if (module_.cv_record.data_size > max_cv_bytes_) {
-      BPLOG(ERROR) << "MinidumpModule CodeView record size " <<
-                      module_.cv_record.data_size << " exceeds maximum " <<
-                      max_cv_bytes_;
-      return NULL;
+    cv_record.reset(new vector<uint8_t>(module_.cv_record.data_size));
+    if (!minidump_->ReadBytes(&(*cv_record)[0],
+                              module_.cv_record.data_size)) {
+      BPLOG(ERROR) << "MinidumpModule could not read CodeView record";
+      return false;
     }
+    cv_data = &(*cv_record)[0];
+  }
 
-    // Allocating something that will be accessed as MDCVInfoPDB70 or
-    // MDCVInfoPDB20 but is allocated as uint8_t[] can cause alignment
-    // problems.  x86 and ppc are able to cope, though.  This allocation
-    // style is needed because the MDCVInfoPDB70 or MDCVInfoPDB20 are
-    // variable-sized due to their pdb_file_name fields; these structures
-    // are not MDCVInfoPDB70_minsize or MDCVInfoPDB20_minsize and treating
-    // them as such would result in incomplete structures or overruns.
-    scoped_ptr< vector<uint8_t> > cv_record(
-        new vector<uint8_t>(module_.cv_record.data_size));
-
-    if (!minidump_->ReadBytes(&(*cv_record)[0], module_.cv_record.data_size)) {
-      BPLOG(ERROR) << "MinidumpModule could not read CodeView record";
-      return NULL;
+  uint32_t signature = MD_CVINFOUNKNOWN_SIGNATURE;
+  if (module_.cv_record.data_size > sizeof(signature)) {
+    const MDCVInfoPDB70* cv_record_signature =
+        reinterpret_cast<const MDCVInfoPDB70*>(cv_data);
+    signature = cv_record_signature->cv_signature;
+    if (minidump_->swap())
+      Swap(&signature);
+  }
+
+  if (signature == MD_CVINFOPDB70_SIGNATURE) {
+    // Now that the structure type is known, recheck the size.
+    if (MDCVInfoPDB70_minsize > module_.cv_record.data_size) {
+      BPLOG(ERROR) << "MinidumpModule CodeView7 record size mismatch, " <<
+                      MDCVInfoPDB70_minsize << " > " <<
+                      module_.cv_record.data_size;
+      return false;
     }
 
-    uint32_t signature = MD_CVINFOUNKNOWN_SIGNATURE;
-    if (module_.cv_record.data_size > sizeof(signature)) {
-      MDCVInfoPDB70* cv_record_signature =
+    if (minidump_->swap()) {
+      MDCVInfoPDB70* cv_record_70 =
           reinterpret_cast<MDCVInfoPDB70*>(&(*cv_record)[0]);
-      signature = cv_record_signature->cv_signature;
-      if (minidump_->swap())
-        Swap(&signature);
+      Swap(&cv_record_70->cv_signature);
+      Swap(&cv_record_70->signature);
+      Swap(&cv_record_70->age);
+      // Don't swap cv_record_70.pdb_file_name because it's an array of 8-bit
+      // quantities.  (It's a path, is it UTF-8?)
     }
 
-    if (signature == MD_CVINFOPDB70_SIGNATURE) {
-      // Now that the structure type is known, recheck the size.
-      if (MDCVInfoPDB70_minsize > module_.cv_record.data_size) {
-        BPLOG(ERROR) << "MinidumpModule CodeView7 record size mismatch, " <<
-                        MDCVInfoPDB70_minsize << " > " <<
-                        module_.cv_record.data_size;
-        return NULL;
-      }
-
-      if (minidump_->swap()) {
-        MDCVInfoPDB70* cv_record_70 =
-            reinterpret_cast<MDCVInfoPDB70*>(&(*cv_record)[0]);
-        Swap(&cv_record_70->cv_signature);
-        Swap(&cv_record_70->signature);
-        Swap(&cv_record_70->age);
-        // Don't swap cv_record_70.pdb_file_name because it's an array of 8-bit
-        // quantities.  (It's a path, is it UTF-8?)
-      }
-
-      // The last field of either structure is null-terminated 8-bit character
-      // data.  Ensure that it's null-terminated.
-      if ((*cv_record)[module_.cv_record.data_size - 1] != '\0') {
-        BPLOG(ERROR) << "MinidumpModule CodeView7 record string is not "
-                        "0-terminated";
-        return NULL;
-      }
-    } else if (signature == MD_CVINFOPDB20_SIGNATURE) {
-      // Now that the structure type is known, recheck the size.
-      if (MDCVInfoPDB20_minsize > module_.cv_record.data_size) {
-        BPLOG(ERROR) << "MinidumpModule CodeView2 record size mismatch, " <<
-                        MDCVInfoPDB20_minsize << " > " <<
-                        module_.cv_record.data_size;
-        return NULL;
-      }
-      if (minidump_->swap()) {
-        MDCVInfoPDB20* cv_record_20 =
-            reinterpret_cast<MDCVInfoPDB20*>(&(*cv_record)[0]);
-        Swap(&cv_record_20->cv_header.signature);
-        Swap(&cv_record_20->cv_header.offset);
-        Swap(&cv_record_20->signature);
-        Swap(&cv_record_20->age);
-        // Don't swap cv_record_20.pdb_file_name because it's an array of 8-bit
-        // quantities.  (It's a path, is it UTF-8?)
-      }
-
-      // The last field of either structure is null-terminated 8-bit character
-      // data.  Ensure that it's null-terminated.
-      if ((*cv_record)[module_.cv_record.data_size - 1] != '\0') {
-        BPLOG(ERROR) << "MindumpModule CodeView2 record string is not "
-                        "0-terminated";
-        return NULL;
-      }
+    // The last field of either structure is null-terminated 8-bit character
+    // data.  Ensure that it's null-terminated.
+    if (cv_data[module_.cv_record.data_size - 1] != '\0') {
+      BPLOG(ERROR) << "MinidumpModule CodeView7 record string is not "
+                      "0-terminated";
+      return false;
+    }
+  } else if (signature == MD_CVINFOPDB20_SIGNATURE) {
+    // Now that the structure type is known, recheck the size.
+    if (MDCVInfoPDB20_minsize > module_.cv_record.data_size) {
+      BPLOG(ERROR) << "MinidumpModule CodeView2 record size mismatch, " <<
+                      MDCVInfoPDB20_minsize << " > " <<
+                      module_.cv_record.data_size;
+      return false;
+    }
+    if (minidump_->swap()) {
+      MDCVInfoPDB20* cv_record_20 =
+          reinterpret_cast<MDCVInfoPDB20*>(&(*cv_record)[0]);
+      Swap(&cv_record_20->cv_header.signature);
+      Swap(&cv_record_20->cv_header.offset);
+      Swap(&cv_record_20->signature);
+      Swap(&cv_record_20->age);
+      // Don't swap cv_record_20.pdb_file_name because it's an array of 8-bit
+      // quantities.  (It's a path, is it UTF-8?)
     }
 
-    // If the signature doesn't match something above, it's not something
-    // that Breakpad can presently handle directly.  Because some modules in
-    // the wild contain such CodeView records as MD_CVINFOCV50_SIGNATURE,
-    // don't bail out here - allow the data to be returned to the user,
-    // although byte-swapping can't be done.
-
-    // Store the vector type because that's how storage was allocated, but
-    // return it casted to uint8_t*.
-    cv_record_ = cv_record.release();
-    cv_record_signature_ = signature;
+    // The last field of either structure is null-terminated 8-bit character
+    // data.  Ensure that it's null-terminated.
+    if (cv_data[module_.cv_record.data_size - 1] != '\0') {
+      BPLOG(ERROR) << "MindumpModule CodeView2 record string is not "
+                      "0-terminated";
+      return false;
+    }
   }
 
-  if (size)
-    *size = module_.cv_record.data_size;
+  // If the signature doesn't match something above, it's not something
+  // that Breakpad can presently handle directly.  Because some modules in
+  // the wild contain such CodeView records as MD_CVINFOCV50_SIGNATURE,
+  // don't bail out here - allow the data to be returned to the user,
+  // although byte-swapping can't be done.
 
-  return &(*cv_record_)[0];
+  // Store the vector type because that's how storage was allocated, but
+  // return it casted to uint8_t*.
+  cv_record_ = cv_record.release();
+  cv_record_data_ = cv_data;
+  cv_record_signature_ = signature;
+  return true;
 }
 
 
-const MDImageDebugMisc* MinidumpModule::GetMiscRecord(uint32_t* size) {
-  if (!module_valid_) {
+const MDImageDebugMisc* MinidumpModule::GetMiscRecord(uint32_t* size) const {
+  if (!valid_) {
     BPLOG(ERROR) << "Invalid MinidumpModule for GetMiscRecord";
     return NULL;
   }
 
-  if (!misc_record_) {
-    if (module_.misc_record.data_size == 0) {
-      return NULL;
-    }
+  ReadAuxiliaryData();
+  if (!misc_record_)
+    return NULL;
 
-    if (MDImageDebugMisc_minsize > module_.misc_record.data_size) {
-      BPLOG(ERROR) << "MinidumpModule miscellaneous debugging record "
-                      "size mismatch, " << MDImageDebugMisc_minsize << " > " <<
-                      module_.misc_record.data_size;
-      return NULL;
-    }
+  if (size)
+    *size = module_.misc_record.data_size;
 
-    if (!minidump_->SeekSet(module_.misc_record.rva)) {
-      BPLOG(ERROR) << "MinidumpModule could not seek to miscellaneous "
-                      "debugging record";
-      return NULL;
-    }
+  return reinterpret_cast<MDImageDebugMisc*>(&(*misc_record_)[0]);
+}
 
-    if (module_.misc_record.data_size > max_misc_bytes_) {
-      BPLOG(ERROR) << "MinidumpModule miscellaneous debugging record size " <<
-                      module_.misc_record.data_size << " exceeds maximum " <<
-                      max_misc_bytes_;
-      return NULL;
-    }
 
-    // Allocating something that will be accessed as MDImageDebugMisc but
-    // is allocated as uint8_t[] can cause alignment problems.  x86 and
-    // ppc are able to cope, though.  This allocation style is needed
-    // because the MDImageDebugMisc is variable-sized due to its data field;
-    // this structure is not MDImageDebugMisc_minsize and treating it as such
-    // would result in an incomplete structure or an overrun.
-    scoped_ptr< vector<uint8_t> > misc_record_mem(
-        new vector<uint8_t>(module_.misc_record.data_size));
-    MDImageDebugMisc* misc_record =
-        reinterpret_cast<MDImageDebugMisc*>(&(*misc_record_mem)[0]);
-
-    if (!minidump_->ReadBytes(misc_record, module_.misc_record.data_size)) {
-      BPLOG(ERROR) << "MinidumpModule could not read miscellaneous debugging "
-                      "record";
-      return NULL;
-    }
+bool MinidumpModule::ReadMiscRecord() const {
+  if (module_.misc_record.data_size == 0) {
+    return false;
+  }
 
-    if (minidump_->swap()) {
-      Swap(&misc_record->data_type);
-      Swap(&misc_record->length);
-      // Don't swap misc_record.unicode because it's an 8-bit quantity.
-      // Don't swap the reserved fields for the same reason, and because
-      // they don't contain any valid data.
-      if (misc_record->unicode) {
-        // There is a potential alignment problem, but shouldn't be a problem
-        // in practice due to the layout of MDImageDebugMisc.
-        uint16_t* data16 = reinterpret_cast<uint16_t*>(&(misc_record->data));
-        unsigned int dataBytes = module_.misc_record.data_size -
-                                 MDImageDebugMisc_minsize;
-        Swap(data16, dataBytes);
-      }
-    }
+  if (MDImageDebugMisc_minsize > module_.misc_record.data_size) {
+    BPLOG(ERROR) << "MinidumpModule miscellaneous debugging record "
+                    "size mismatch, " << MDImageDebugMisc_minsize << " > " <<
+                    module_.misc_record.data_size;
+    return false;
+  }
 
-    if (module_.misc_record.data_size != misc_record->length) {
-      BPLOG(ERROR) << "MinidumpModule miscellaneous debugging record data "
-                      "size mismatch, " << module_.misc_record.data_size <<
-                      " != " << misc_record->length;
-      return NULL;
-    }
+  if (!minidump_->SeekSet(module_.misc_record.rva)) {
+    BPLOG(ERROR) << "MinidumpModule could not seek to miscellaneous "
+                    "debugging record";
+    return false;
+  }
 
-    // Store the vector type because that's how storage was allocated, but
-    // return it casted to MDImageDebugMisc*.
-    misc_record_ = misc_record_mem.release();
+  if (module_.misc_record.data_size > max_misc_bytes_) {
+    BPLOG(ERROR) << "MinidumpModule miscellaneous debugging record size " <<
+                    module_.misc_record.data_size << " exceeds maximum " <<
+                    max_misc_bytes_;
+    return false;
   }
 
-  if (size)
-    *size = module_.misc_record.data_size;
+  // Allocating something that will be accessed as MDImageDebugMisc but
+  // is allocated as uint8_t[] can cause alignment problems.  x86 and
+  // ppc are able to cope, though.  This allocation style is needed
+  // because the MDImageDebugMisc is variable-sized due to its data field;
+  // this structure is not MDImageDebugMisc_minsize and treating it as such
+  // would result in an incomplete structure or an overrun.
+  scoped_ptr< vector<uint8_t> > misc_record_mem(
+      new vector<uint8_t>(module_.misc_record.data_size));
+  MDImageDebugMisc* misc_record =
+      reinterpret_cast<MDImageDebugMisc*>(&(*misc_record_mem)[0]);
+
+  if (!minidump_->ReadBytes(misc_record, module_.misc_record.data_size)) {
+    BPLOG(ERROR) << "MinidumpModule could not read miscellaneous debugging "
+                    "record";
+    return false;
+  }
 
-  return reinterpret_cast<MDImageDebugMisc*>(&(*misc_record_)[0]);
+  if (minidump_->swap()) {
+    Swap(&misc_record->data_type);
+    Swap(&misc_record->length);
+    // Don't swap misc_record.unicode because it's an 8-bit quantity.
+    // Don't swap the reserved fields for the same reason, and because
+    // they don't contain any valid data.
+    if (misc_record->unicode) {
+      // There is a potential alignment problem, but shouldn't be a problem
+      // in practice due to the layout of MDImageDebugMisc.
+      uint16_t* data16 = reinterpret_cast<uint16_t*>(&(misc_record->data));
+      unsigned int dataBytes = module_.misc_record.data_size -
+                               MDImageDebugMisc_minsize;
+      Swap(data16, dataBytes);
+    }
+  }
+
+  if (module_.misc_record.data_size != misc_record->length) {
+    BPLOG(ERROR) << "MinidumpModule miscellaneous debugging record data "
+                    "size mismatch, " << module_.misc_record.data_size <<
+                    " != " << misc_record->length;
+    return false;
+  }
+
+  // Store the vector type because that's how storage was allocated, but
+  // return it casted to MDImageDebugMisc*.
+  misc_record_ = misc_record_mem.release();
+  return true;
 }
 
 
@@ -2432,13 +2609,15 @@ MinidumpModuleList::MinidumpModuleList(Minidump* minidump)
     : MinidumpStream(minidump),
       range_map_(new RangeMap<uint64_t, unsigned int>()),
       modules_(NULL),
-      module_count_(0) {
+      module_count_(0),
+      auxiliary_data_mutex_(new Mutex) {
 }
 
 
 MinidumpModuleList::~MinidumpModuleList() {
   delete range_map_;
   delete modules_;
+  delete auxiliary_data_mutex_;
 }
 
 
@@ -2498,7 +2677,8 @@ bool MinidumpModuleList::Read(uint32_t expected_size) {
 
   if (module_count != 0) {
     scoped_ptr<MinidumpModules> modules(
-        new MinidumpModules(module_count, MinidumpModule(minidump_)));
+        new MinidumpModules(module_count,
+                            MinidumpModule(minidump_, auxiliary_data_mutex_)));
 
     for (unsigned int module_index = 0;
          module_index < module_count;
@@ -2513,31 +2693,15 @@ bool MinidumpModuleList::Read(uint32_t expected_size) {
       }
     }
 
-    // Loop through the module list once more to read additional data and
-    // build the range map.  This is done in a second pass because
-    // MinidumpModule::ReadAuxiliaryData seeks around, and if it were
-    // included in the loop above, additional seeks would be needed where
-    // none are now to read contiguous data.
+    // Loop through the module list once more to build the range map.  The
+    // modules' names and debugging records are not read here: they are
+    // scattered through the file, and most modules are never looked at.
+    // MinidumpModule reads them the first time they are asked for.
     for (unsigned int module_index = 0;
          module_index < module_count;
          ++module_index) {
       MinidumpModule* module = &(*modules)[module_index];
 
-      // ReadAuxiliaryData fails if any data that the module indicates should
-      // exist is missing, but we treat some such cases as valid anyway.  See
-      // issue #222: if a debugging record is of a format that's too large to
-      // handle, it shouldn't render the entire dump invalid.  Check module
-      // validity before giving up.
-      if (!module->ReadAuxiliaryData() && !module->valid()) {
-        BPLOG(ERROR) << "MinidumpModuleList could not read required module "
-                        "auxiliary data for module " <<
-                        module_index << "/" << module_count;
-        return false;
-      }
-
-      // It is safe to use module->code_file() after successfully calling
-      // module->ReadAuxiliaryData or noting that the module is valid.
-
       uint64_t base_address = module->base_address();
       uint64_t module_size = module->size();
       if (base_address == static_cast<uint64_t>(-1)) {
@@ -2560,6 +2724,10 @@ bool MinidumpModuleList::Read(uint32_t expected_size) {
     modules_ = modules.release();
   }
 
+  // The module list is not modified after this point, but is searched for
+  // every frame and scanned stack word.
+  range_map_->Freeze();
+
   module_count_ = module_count;
 
   valid_ = true;
@@ -2585,6 +2753,30 @@ const MinidumpModule* MinidumpModuleList::GetModuleForAddress(
 }
 
 
+void MinidumpModuleList::GetModulesForAddresses(
+    const uint64_t* addresses, size_t count,
+    const CodeModule** modules) const {
+  if (!valid_) {
+    BPLOG(ERROR) << "Invalid MinidumpModuleList for GetModulesForAddresses";
+    for (size_t i = 0; i < count; ++i)
+      modules[i] = NULL;
+    return;
+  }
+
+  if (count == 0)
+    return;
+
+  // module_count_ is bounded well below this by Read.
+  const unsigned int kNoModule = numeric_limits<unsigned int>::max();
+  vector<unsigned int> module_indices(count);
+  range_map_->RetrieveRanges(addresses, count, kNoModule, &module_indices[0]);
+  for (size_t i = 0; i < count; ++i) {
+    modules[i] = module_indices[i] == kNoModule ?
+                 NULL : GetModuleAtIndex(module_indices[i]);
+  }
+}
+
+
 const MinidumpModule* MinidumpModuleList::GetMainModule() const {
   if (!valid_) {
     BPLOG(ERROR) << "Invalid MinidumpModuleList for GetMainModule";
@@ -2667,14 +2859,15 @@ void MinidumpModuleList::Print() {
 //
 
 
-uint32_t MinidumpMemoryList::max_regions_ = 4096;
+uint32_t MinidumpMemoryList::max_regions_ =
+    numeric_limits<uint32_t>::max();
 
 
 MinidumpMemoryList::MinidumpMemoryList(Minidump* minidump)
     : MinidumpStream(minidump),
       range_map_(new RangeMap<uint64_t, unsigned int>()),
-      descriptors_(NULL),
-      regions_(NULL),
+      descriptors_(new MemoryDescriptors()),
+      regions_(new MemoryRegions()),
       region_count_(0) {
 }
 
@@ -2682,16 +2875,26 @@ MinidumpMemoryList::MinidumpMemoryList(Minidump* minidump)
 MinidumpMemoryList::~MinidumpMemoryList() {
   delete range_map_;
   delete descriptors_;
+  FreeRegions();
   delete regions_;
 }
 
 
+void MinidumpMemoryList::FreeRegions() {
+  for (MemoryRegions::iterator iterator = regions_->begin();
+       iterator != regions_->end();
+       ++iterator) {
+    delete *iterator;
+  }
+  regions_->clear();
+}
+
+
 bool MinidumpMemoryList::Read(uint32_t expected_size) {
-  // Invalidate cached data.
-  delete descriptors_;
-  descriptors_ = NULL;
-  delete regions_;
-  regions_ = NULL;
+  // Invalidate cached data.  The vectors keep their storage, so that a
+  // list that is read again for another minidump doesn't reallocate it.
+  descriptors_->clear();
+  FreeRegions();
   range_map_->Clear();
   region_count_ = 0;
 
@@ -2744,28 +2947,41 @@ bool MinidumpMemoryList::Read(uint32_t expected_size) {
   }
 
   if (region_count != 0) {
-    scoped_ptr<MemoryDescriptors> descriptors(
-        new MemoryDescriptors(region_count));
-
-    // Read the entire array in one fell swoop, instead of reading one entry
-    // at a time in the loop.
-    if (!minidump_->ReadBytes(&(*descriptors)[0],
-                              sizeof(MDMemoryDescriptor) * region_count)) {
-      BPLOG(ERROR) << "MinidumpMemoryList could not read memory region list";
-      return false;
+    MemoryDescriptors* descriptors = descriptors_;
+
+    // Read the array in large batches, instead of reading one entry at a time
+    // in the loop.  Reading it in batches, rather than all at once, means
+    // that a region_count that's larger than the minidump can't cause a
+    // correspondingly large allocation.
+    const uint32_t kDescriptorBatchSize = 4096;
+    while (descriptors->size() < region_count) {
+      size_t batch_start = descriptors->size();
+      size_t batch_size = region_count - batch_start;
+      if (batch_size > kDescriptorBatchSize)
+        batch_size = kDescriptorBatchSize;
+      descriptors->resize(batch_start + batch_size);
+      if (!minidump_->ReadBytes(&(*descriptors)[batch_start],
+                                sizeof(MDMemoryDescriptor) * batch_size)) {
+        BPLOG(ERROR) << "MinidumpMemoryList could not read memory region "
+                        "list";
+        return false;
+      }
+      if (minidump_->swap()) {
+        assert(sizeof(MDMemoryDescriptor) == 16);
+        SwapBlocks(&(*descriptors)[batch_start], batch_size,
+                   kMemoryDescriptorShuffles, 1);
+      }
     }
 
-    scoped_ptr<MemoryRegions> regions(
-        new MemoryRegions(region_count, MinidumpMemoryRegion(minidump_)));
+    // The MinidumpMemoryRegion objects are created by
+    // GetMemoryRegionAtIndex as they are needed.
+    regions_->assign(region_count, static_cast<MinidumpMemoryRegion*>(NULL));
 
     for (unsigned int region_index = 0;
          region_index < region_count;
          ++region_index) {
       MDMemoryDescriptor* descriptor = &(*descriptors)[region_index];
 
-      if (minidump_->swap())
-        Swap(descriptor);
-
       uint64_t base_address = descriptor->start_of_memory_range;
       uint32_t region_size = descriptor->memory.data_size;
 
@@ -2786,14 +3002,12 @@ bool MinidumpMemoryList::Read(uint32_t expected_size) {
                         HexString(region_size);
         return false;
       }
-
-      (*regions)[region_index].SetDescriptor(descriptor);
     }
 
-    descriptors_ = descriptors.release();
-    regions_ = regions.release();
   }
 
+  range_map_->Freeze();
+
   region_count_ = region_count;
 
   valid_ = true;
@@ -2814,7 +3028,13 @@ MinidumpMemoryRegion* MinidumpMemoryList::GetMemoryRegionAtIndex(
     return NULL;
   }
 
-  return &(*regions_)[index];
+  MinidumpMemoryRegion*& region = (*regions_)[index];
+  if (!region) {
+    region = new MinidumpMemoryRegion(minidump_);
+    region->SetDescriptor(&(*descriptors_)[index]);
+  }
+
+  return region;
 }
 
 
@@ -2836,6 +3056,43 @@ MinidumpMemoryRegion* MinidumpMemoryList::GetMemoryRegionForAddress(
 }
 
 
+size_t MinidumpMemoryList::GetMemorySpans(const SpanRequest* requests,
+                                          size_t count,
+                                          const uint8_t** spans) {
+  if (!valid_) {
+    BPLOG(ERROR) << "Invalid MinidumpMemoryList for GetMemorySpans";
+    for (size_t i = 0; i < count; ++i)
+      spans[i] = NULL;
+    return 0;
+  }
+  if (count == 0)
+    return 0;
+
+  vector<uint64_t> addresses(count);
+  for (size_t i = 0; i < count; ++i)
+    addresses[i] = requests[i].address;
+  vector<unsigned int> region_indices(count);
+  const unsigned int kNoRegion = numeric_limits<unsigned int>::max();
+  range_map_->RetrieveRanges(&addresses[0], count, kNoRegion,
+                             &region_indices[0]);
+
+  size_t found = 0;
+  for (size_t i = 0; i < count; ++i) {
+    spans[i] = NULL;
+    if (region_indices[i] == kNoRegion)
+      continue;
+    MinidumpMemoryRegion* region = GetMemoryRegionAtIndex(region_indices[i]);
+    if (region) {
+      spans[i] = region->GetContiguousMemory(requests[i].address,
+                                             requests[i].size);
+    }
+    if (spans[i])
+      ++found;
+  }
+  return found;
+}
+
+
 void MinidumpMemoryList::Print() {
   if (!valid_) {
     BPLOG(ERROR) << "MinidumpMemoryList cannot print invalid data";
@@ -3691,6 +3948,151 @@ void MinidumpBreakpadInfo::Print() {
 }
 
 
+//
+// MinidumpHandlerTiming
+//
+
+
+MinidumpHandlerTiming::MinidumpHandlerTiming(Minidump* minidump)
+    : MinidumpStream(minidump),
+      start_time_(0),
+      timings_() {
+}
+
+
+bool MinidumpHandlerTiming::Read(uint32_t expected_size) {
+  timings_.clear();
+  valid_ = false;
+
+  MDRawHandlerTimingList header;
+  if (expected_size < sizeof(header)) {
+    BPLOG(ERROR) << "MinidumpHandlerTiming header size mismatch, " <<
+                    expected_size << " < " << sizeof(header);
+    return false;
+  }
+  if (!minidump_->ReadBytes(&header, sizeof(header))) {
+    BPLOG(ERROR) << "MinidumpHandlerTiming could not read header";
+    return false;
+  }
+
+  if (minidump_->swap()) {
+    Swap(&header.size_of_header);
+    Swap(&header.size_of_entry);
+    Swap(&header.number_of_entries);
+    Swap(&header.start_time);
+  }
+
+  if (header.size_of_header != sizeof(MDRawHandlerTimingList) ||
+      header.size_of_entry != sizeof(MDRawHandlerTiming)) {
+    BPLOG(ERROR) << "MinidumpHandlerTiming header or entry size mismatch, " <<
+                    header.size_of_header << ", " << header.size_of_entry;
+    return false;
+  }
+
+  // The handler times at most a few phases, so the count can't overflow
+  // the stream size below unless the stream is corrupt.
+  if (header.number_of_entries >
+          (expected_size - sizeof(header)) / sizeof(MDRawHandlerTiming) ||
+      expected_size != sizeof(header) +
+                       header.number_of_entries * sizeof(MDRawHandlerTiming)) {
+    BPLOG(ERROR) << "MinidumpHandlerTiming size mismatch, " << expected_size <<
+                    " for " << header.number_of_entries << " entries";
+    return false;
+  }
+
+  if (header.number_of_entries != 0) {
+    timings_.resize(header.number_of_entries);
+    if (!minidump_->ReadBytes(&timings_[0],
+                              timings_.size() * sizeof(MDRawHandlerTiming))) {
+      BPLOG(ERROR) << "MinidumpHandlerTiming could not read timings";
+      timings_.clear();
+      return false;
+    }
+  }
+
+  if (minidump_->swap()) {
+    for (size_t i = 0; i < timings_.size(); ++i) {
+      Swap(&timings_[i].phase);
+      Swap(&timings_[i].count);
+      Swap(&timings_[i].start_time);
+      Swap(&timings_[i].duration);
+    }
+  }
+
+  start_time_ = header.start_time;
+  valid_ = true;
+  return true;
+}
+
+
+const MDRawHandlerTiming* MinidumpHandlerTiming::GetTimingAtIndex(
+    unsigned int index) const {
+  if (!valid_ || index >= timings_.size()) {
+    BPLOG(ERROR) << "MinidumpHandlerTiming has no timing at index " << index;
+    return NULL;
+  }
+  return &timings_[index];
+}
+
+
+const MDRawHandlerTiming* MinidumpHandlerTiming::GetTimingForPhase(
+    uint32_t phase) const {
+  if (!valid_)
+    return NULL;
+  for (size_t i = 0; i < timings_.size(); ++i) {
+    if (timings_[i].phase == phase)
+      return &timings_[i];
+  }
+  return NULL;
+}
+
+
+// static
+const char* MinidumpHandlerTiming::PhaseName(uint32_t phase) {
+  switch (phase) {
+    case MD_HANDLER_PHASE_HANDLER:
+      return "handler";
+    case MD_HANDLER_PHASE_ENUMERATE:
+      return "enumerate";
+    case MD_HANDLER_PHASE_SUSPEND:
+      return "suspend";
+    case MD_HANDLER_PHASE_IDENTIFIERS:
+      return "identifiers";
+    case MD_HANDLER_PHASE_MEMORY:
+      return "memory";
+    case MD_HANDLER_PHASE_WRITE:
+      return "write";
+  }
+  return "unknown";
+}
+
+
+void MinidumpHandlerTiming::Print() {
+  if (!valid_) {
+    BPLOG(ERROR) << "MinidumpHandlerTiming cannot print invalid data";
+    return;
+  }
+
+  printf("MDRawHandlerTimingList\n");
+  printf("  start_time   = %" PRIu64 " ns\n", start_time_);
+  printf("  timing_count = %d\n", timing_count());
+  printf("\n");
+
+  for (unsigned int timing_index = 0;
+       timing_index < timing_count();
+       ++timing_index) {
+    const MDRawHandlerTiming& timing = timings_[timing_index];
+    printf("timing[%d]\n", timing_index);
+    printf("MDRawHandlerTiming\n");
+    printf("  phase      = %d (%s)\n", timing.phase, PhaseName(timing.phase));
+    printf("  count      = %d\n", timing.count);
+    printf("  start_time = %" PRIu64 " ns\n", timing.start_time);
+    printf("  duration   = %" PRIu64 " ns\n", timing.duration);
+    printf("\n");
+  }
+}
+
+
 //
 // MinidumpMemoryInfo
 //
@@ -3897,6 +4299,8 @@ bool MinidumpMemoryInfoList::Read(uint32_t expected_size) {
     infos_ = infos.release();
   }
 
+  range_map_->Freeze();
+
   info_count_ = header_number_of_entries;
 
   valid_ = true;
@@ -3960,6 +4364,62 @@ void MinidumpMemoryInfoList::Print() {
 }
 
 
+//
+// MinidumpMemoryReadLog
+//
+
+
+MinidumpMemoryReadLog::MinidumpMemoryReadLog() : ranges_(), mutex_(new Mutex) {
+}
+
+
+MinidumpMemoryReadLog::~MinidumpMemoryReadLog() {
+  delete mutex_;
+}
+
+
+void MinidumpMemoryReadLog::Add(uint64_t address, uint64_t size) {
+  if (size == 0)
+    return;
+  uint64_t end = size > numeric_limits<uint64_t>::max() - address ?
+                 numeric_limits<uint64_t>::max() : address + size;
+
+  AutoMutex lock(mutex_);
+
+  // Absorb the range that starts before address, if it reaches it, and
+  // every range that starts within the new one.
+  RangeMap::iterator next = ranges_.upper_bound(address);
+  if (next != ranges_.begin()) {
+    RangeMap::iterator previous = next;
+    --previous;
+    if (previous->second >= address) {
+      if (previous->second >= end)
+        return;
+      address = previous->first;
+      next = previous;
+    }
+  }
+  while (next != ranges_.end() && next->first <= end) {
+    if (next->second > end)
+      end = next->second;
+    ranges_.erase(next++);
+  }
+  ranges_[address] = end;
+}
+
+
+MinidumpMemoryReadLog::RangeMap MinidumpMemoryReadLog::ranges() const {
+  AutoMutex lock(mutex_);
+  return ranges_;
+}
+
+
+void MinidumpMemoryReadLog::Clear() {
+  AutoMutex lock(mutex_);
+  ranges_.clear();
+}
+
+
 //
 // Minidump
 //
@@ -3975,6 +4435,30 @@ Minidump::Minidump(const string& path)
       stream_map_(new MinidumpStreamMap()),
       path_(path),
       stream_(NULL),
+      data_(NULL),
+      data_size_(0),
+      data_offset_(0),
+      reader_(NULL),
+      memory_read_log_(NULL),
+      map_file_(false),
+      mapped_(false),
+      swap_(false),
+      valid_(false) {
+}
+
+Minidump::Minidump(const string& path, bool map_file)
+    : header_(),
+      directory_(NULL),
+      stream_map_(new MinidumpStreamMap()),
+      path_(path),
+      stream_(NULL),
+      data_(NULL),
+      data_size_(0),
+      data_offset_(0),
+      reader_(NULL),
+      memory_read_log_(NULL),
+      map_file_(map_file),
+      mapped_(false),
       swap_(false),
       valid_(false) {
 }
@@ -3985,24 +4469,127 @@ Minidump::Minidump(istream& stream)
       stream_map_(new MinidumpStreamMap()),
       path_(),
       stream_(&stream),
+      data_(NULL),
+      data_size_(0),
+      data_offset_(0),
+      reader_(NULL),
+      memory_read_log_(NULL),
+      map_file_(false),
+      mapped_(false),
+      swap_(false),
+      valid_(false) {
+}
+
+Minidump::Minidump(const uint8_t* data, size_t size)
+    : header_(),
+      directory_(NULL),
+      stream_map_(new MinidumpStreamMap()),
+      path_(),
+      stream_(NULL),
+      data_(data),
+      data_size_(size),
+      data_offset_(0),
+      reader_(NULL),
+      memory_read_log_(NULL),
+      map_file_(false),
+      mapped_(false),
+      swap_(false),
+      valid_(false) {
+}
+
+Minidump::Minidump(MinidumpReader* reader)
+    : header_(),
+      directory_(NULL),
+      stream_map_(new MinidumpStreamMap()),
+      path_(),
+      stream_(NULL),
+      data_(NULL),
+      data_size_(0),
+      data_offset_(0),
+      reader_(reader),
+      memory_read_log_(NULL),
+      map_file_(false),
+      mapped_(false),
       swap_(false),
       valid_(false) {
 }
 
 Minidump::~Minidump() {
-  if (stream_) {
+  Close();
+  delete directory_;
+  ReleaseStreams();
+  delete stream_map_;
+  for (MinidumpStreamMap::iterator iterator = spare_streams_.begin();
+       iterator != spare_streams_.end();
+       ++iterator) {
+    delete iterator->stream;
+  }
+}
+
+
+void Minidump::Reset(const string& path) {
+  Close();
+  path_ = path;
+}
+
+
+void Minidump::Reset(const uint8_t* data, size_t size) {
+  Close();
+  path_.clear();
+  data_ = data;
+  data_size_ = size;
+}
+
+
+void Minidump::Reset(MinidumpReader* reader) {
+  Close();
+  path_.clear();
+  reader_ = reader;
+}
+
+
+void Minidump::Close() {
+  if (stream_ || data_ || reader_) {
     BPLOG(INFO) << "Minidump closing minidump";
   }
   if (!path_.empty()) {
     delete stream_;
   }
-  delete directory_;
-  delete stream_map_;
+  stream_ = NULL;
+  reader_ = NULL;
+  UnmapFile();
+  data_ = NULL;
+  data_size_ = 0;
+  data_offset_ = 0;
+  decompressed_.clear();
+  swap_ = false;
+  valid_ = false;
+}
+
+
+void Minidump::ReleaseStreams() {
+  for (MinidumpStreamMap::iterator iterator = stream_map_->begin();
+       iterator != stream_map_->end();
+       ++iterator) {
+    if (iterator->stream)
+      spare_streams_.push_back(*iterator);
+  }
+  stream_map_->clear();
+}
+
+
+Minidump::MinidumpStreamInfo* Minidump::FindStreamInfo(uint32_t stream_type) {
+  MinidumpStreamMap::iterator iterator =
+      std::lower_bound(stream_map_->begin(), stream_map_->end(),
+                       stream_type, MinidumpStreamInfoLess());
+  if (iterator == stream_map_->end() || iterator->stream_type != stream_type)
+    return NULL;
+  return &*iterator;
 }
 
 
 bool Minidump::Open() {
-  if (stream_ != NULL) {
+  if (stream_ != NULL || data_ != NULL || reader_ != NULL) {
     BPLOG(INFO) << "Minidump reopening minidump " << path_;
 
     // The file is already open.  Seek to the beginning, which is the position
@@ -4010,6 +4597,15 @@ bool Minidump::Open() {
     return SeekSet(0);
   }
 
+  if (map_file_) {
+    if (MapFile()) {
+      BPLOG(INFO) << "Minidump mapped minidump " << path_;
+      return true;
+    }
+    BPLOG(INFO) << "Minidump could not map minidump " << path_ <<
+                   ", reading it as a stream";
+  }
+
   stream_ = new ifstream(path_.c_str(), std::ios::in | std::ios::binary);
   if (!stream_ || !stream_->good()) {
     string error_string;
@@ -4023,6 +4619,176 @@ bool Minidump::Open() {
   return true;
 }
 
+bool Minidump::MapFile() {
+#ifdef _WIN32
+  return false;
+#else  // _WIN32
+  int fd = open(path_.c_str(), O_RDONLY | O_BINARY);
+  if (fd == -1) {
+    return false;
+  }
+
+  struct stat st;
+  if (fstat(fd, &st) == -1 || st.st_size <= 0 ||
+      static_cast<uint64_t>(st.st_size) > numeric_limits<size_t>::max()) {
+    close(fd);
+    return false;
+  }
+
+  size_t size = static_cast<size_t>(st.st_size);
+  void* data = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (data == MAP_FAILED) {
+    return false;
+  }
+
+  data_ = static_cast<const uint8_t*>(data);
+  data_size_ = size;
+  data_offset_ = 0;
+  mapped_ = true;
+  return true;
+#endif  // _WIN32
+}
+
+
+void Minidump::UnmapFile() {
+#ifndef _WIN32
+  if (mapped_) {
+    munmap(const_cast<uint8_t*>(data_), data_size_);
+  }
+#endif  // _WIN32
+  if (mapped_) {
+    data_ = NULL;
+    data_size_ = 0;
+    data_offset_ = 0;
+    mapped_ = false;
+  }
+}
+
+
+bool Minidump::DecompressIfCompressed() {
+  CompressedMinidumpHeader header;
+  if (!ReadBytes(&header, sizeof(header))) {
+    // Too short to be compressed; let the header check report it.
+    return SeekSet(0);
+  }
+
+  bool swap;
+  if (header.signature == kCompressedMinidumpSignature) {
+    swap = false;
+  } else {
+    Swap(&header.signature);
+    if (header.signature != kCompressedMinidumpSignature)
+      return SeekSet(0);
+    swap = true;
+    Swap(&header.version);
+  }
+
+  if (header.version != kCompressedMinidumpVersion) {
+    BPLOG(ERROR) << "Compressed minidump version mismatch: " <<
+                    header.version << " != " << kCompressedMinidumpVersion;
+    return false;
+  }
+
+  // Gather the frames, which come after the header.
+  const uint8_t* input;
+  size_t input_size;
+  string input_data;
+  if (data_) {
+    input = data_;
+    input_size = data_size_;
+  } else if (reader_) {
+    const uint64_t size = reader_->size();
+    if (size > numeric_limits<size_t>::max()) {
+      BPLOG(ERROR) << "Compressed minidump is too large: " << size;
+      return false;
+    }
+    input_data.resize(static_cast<size_t>(size));
+    if (size && !reader_->ReadAt(0, &input_data[0], input_data.size())) {
+      BPLOG(ERROR) << "Compressed minidump could not be read";
+      return false;
+    }
+    input = reinterpret_cast<const uint8_t*>(input_data.data());
+    input_size = input_data.size();
+  } else {
+    char buffer[64 * 1024];
+    if (!SeekSet(0))
+      return false;
+    while (stream_->read(buffer, sizeof(buffer)) || stream_->gcount() > 0)
+      input_data.append(buffer, static_cast<size_t>(stream_->gcount()));
+    stream_->clear();
+    input = reinterpret_cast<const uint8_t*>(input_data.data());
+    input_size = input_data.size();
+  }
+
+  // The first pass checks the frames and finds the size of the image, the
+  // second fills it in.
+  uint64_t image_size = 0;
+  for (int pass = 0; pass < 2; ++pass) {
+    size_t offset = sizeof(header);
+    while (offset < input_size) {
+      CompressedMinidumpFrame frame;
+      if (input_size - offset < sizeof(frame)) {
+        BPLOG(ERROR) << "Compressed minidump frame header truncated at " <<
+                        offset;
+        return false;
+      }
+      memcpy(&frame, input + offset, sizeof(frame));
+      offset += sizeof(frame);
+      if (swap) {
+        Swap(&frame.offset);
+        Swap(&frame.size);
+        Swap(&frame.stored_size);
+      }
+
+      if (frame.stored_size > frame.size ||
+          frame.stored_size > input_size - offset ||
+          frame.size > kCompressedMinidumpMaxFrameSize ||
+          frame.offset > numeric_limits<uint32_t>::max() - frame.size) {
+        BPLOG(ERROR) << "Compressed minidump frame at " <<
+                        offset - sizeof(frame) << " is invalid";
+        return false;
+      }
+
+      const uint64_t end = frame.offset + frame.size;
+      if (pass == 0) {
+        if (end > image_size)
+          image_size = end;
+      } else if (frame.size) {
+        uint8_t* destination = &decompressed_[frame.offset];
+        if (frame.stored_size == frame.size) {
+          memcpy(destination, input + offset, frame.size);
+        } else if (!DecompressBlock(input + offset, frame.stored_size,
+                                    destination, frame.size)) {
+          BPLOG(ERROR) << "Compressed minidump frame at " <<
+                          offset - sizeof(frame) << " is corrupt";
+          return false;
+        }
+      }
+      offset += frame.stored_size;
+    }
+
+    if (pass == 0) {
+      if (image_size == 0) {
+        BPLOG(ERROR) << "Compressed minidump is empty";
+        return false;
+      }
+      decompressed_.assign(static_cast<size_t>(image_size), 0);
+    }
+  }
+
+  BPLOG(INFO) << "Minidump decompressed " << input_size << " bytes to " <<
+                 image_size;
+
+  // From here on, read the image instead of the original input.
+  UnmapFile();
+  data_ = &decompressed_[0];
+  data_size_ = decompressed_.size();
+  data_offset_ = 0;
+  return true;
+}
+
+
 bool Minidump::GetContextCPUFlagsFromSystemInfo(uint32_t *context_cpu_flags) {
   // Initialize output parameters
   *context_cpu_flags = 0;
@@ -4097,10 +4863,18 @@ bool Minidump::GetContextCPUFlagsFromSystemInfo(uint32_t *context_cpu_flags) {
 
 
 bool Minidump::Read() {
+  BREAKPAD_PROBE1(minidump__read__start, path_.c_str());
+  bool read = ReadHeaderAndDirectory();
+  BREAKPAD_PROBE3(minidump__read__done, path_.c_str(), read,
+                  read ? header_.stream_count : 0);
+  return read;
+}
+
+bool Minidump::ReadHeaderAndDirectory() {
   // Invalidate cached data.
   delete directory_;
   directory_ = NULL;
-  stream_map_->clear();
+  ReleaseStreams();
 
   valid_ = false;
 
@@ -4109,6 +4883,11 @@ bool Minidump::Read() {
     return false;
   }
 
+  if (!DecompressIfCompressed()) {
+    BPLOG(ERROR) << "Minidump cannot decompress minidump";
+    return false;
+  }
+
   if (!ReadBytes(&header_, sizeof(MDRawHeader))) {
     BPLOG(ERROR) << "Minidump cannot read header";
     return false;
@@ -4191,9 +4970,10 @@ bool Minidump::Read() {
         Swap(&directory_entry->location);
       }
 
-      // Initialize the stream_map_ map, which speeds locating a stream by
+      // Initialize the stream_map_ index, which speeds locating a stream by
       // type.
       unsigned int stream_type = directory_entry->stream_type;
+      MinidumpStreamInfo* info = FindStreamInfo(stream_type);
       switch (stream_type) {
         case MD_THREAD_LIST_STREAM:
         case MD_MODULE_LIST_STREAM:
@@ -4202,7 +4982,7 @@ bool Minidump::Read() {
         case MD_SYSTEM_INFO_STREAM:
         case MD_MISC_INFO_STREAM:
         case MD_BREAKPAD_INFO_STREAM: {
-          if (stream_map_->find(stream_type) != stream_map_->end()) {
+          if (info) {
             // Another stream with this type was already found.  A minidump
             // file should contain at most one of each of these stream types.
             BPLOG(ERROR) << "Minidump found multiple streams of type " <<
@@ -4215,7 +4995,14 @@ bool Minidump::Read() {
         default: {
           // Overwrites for stream types other than those above, but it's
           // expected to be the user's burden in that case.
-          (*stream_map_)[stream_type].stream_index = stream_index;
+          if (info) {
+            info->stream_index = stream_index;
+          } else {
+            stream_map_->insert(
+                std::lower_bound(stream_map_->begin(), stream_map_->end(),
+                                 stream_type, MinidumpStreamInfoLess()),
+                MinidumpStreamInfo(stream_type, stream_index));
+          }
         }
       }
     }
@@ -4274,6 +5061,11 @@ MinidumpBreakpadInfo* Minidump::GetBreakpadInfo() {
   return GetStream(&breakpad_info);
 }
 
+MinidumpHandlerTiming* Minidump::GetHandlerTiming() {
+  MinidumpHandlerTiming* handler_timing;
+  return GetStream(&handler_timing);
+}
+
 MinidumpMemoryInfoList* Minidump::GetMemoryInfoList() {
   MinidumpMemoryInfoList* memory_info_list;
   return GetStream(&memory_info_list);
@@ -4341,6 +5133,10 @@ static const char* get_stream_name(uint32_t stream_type) {
     return "MD_LINUX_MAPS";
   case MD_LINUX_DSO_DEBUG:
     return "MD_LINUX_DSO_DEBUG";
+  case MD_LINUX_ANNOTATIONS:
+    return "MD_LINUX_ANNOTATIONS";
+  case MD_LINUX_HANDLER_TIMING:
+    return "MD_LINUX_HANDLER_TIMING";
   default:
     return "unknown";
   }
@@ -4383,8 +5179,8 @@ void Minidump::Print() {
   for (MinidumpStreamMap::const_iterator iterator = stream_map_->begin();
        iterator != stream_map_->end();
        ++iterator) {
-    uint32_t stream_type = iterator->first;
-    MinidumpStreamInfo info = iterator->second;
+    uint32_t stream_type = iterator->stream_type;
+    const MinidumpStreamInfo& info = *iterator;
     printf("  stream type 0x%x (%s) at index %d\n", stream_type,
            get_stream_name(stream_type),
            info.stream_index);
@@ -4413,6 +5209,26 @@ const MDRawDirectory* Minidump::GetDirectoryEntryAtIndex(unsigned int index)
 bool Minidump::ReadBytes(void* bytes, size_t count) {
   // Can't check valid_ because Read needs to call this method before
   // validity can be determined.
+  if (data_) {
+    const uint8_t* source = GetMappedBytes(data_offset_, count);
+    if (!source) {
+      BPLOG(ERROR) << "ReadBytes: read past end of minidump at offset " <<
+                      data_offset_ << "+" << count << "/" << data_size_;
+      return false;
+    }
+    memcpy(bytes, source, count);
+    data_offset_ += count;
+    return true;
+  }
+  if (reader_) {
+    if (!reader_->ReadAt(data_offset_, bytes, count)) {
+      BPLOG(ERROR) << "ReadBytes: could not read minidump at offset " <<
+                      data_offset_ << "+" << count << "/" << reader_->size();
+      return false;
+    }
+    data_offset_ += count;
+    return true;
+  }
   if (!stream_) {
     return false;
   }
@@ -4445,6 +5261,24 @@ bool Minidump::ReadBytes(void* bytes, size_t count) {
 bool Minidump::SeekSet(off_t offset) {
   // Can't check valid_ because Read needs to call this method before
   // validity can be determined.
+  if (data_) {
+    if (offset < 0 || static_cast<uint64_t>(offset) > data_size_) {
+      BPLOG(ERROR) << "SeekSet: offset " << offset << " out of range: " <<
+                      data_size_;
+      return false;
+    }
+    data_offset_ = offset;
+    return true;
+  }
+  if (reader_) {
+    if (offset < 0 || static_cast<uint64_t>(offset) > reader_->size()) {
+      BPLOG(ERROR) << "SeekSet: offset " << offset << " out of range: " <<
+                      reader_->size();
+      return false;
+    }
+    data_offset_ = offset;
+    return true;
+  }
   if (!stream_) {
     return false;
   }
@@ -4459,10 +5293,14 @@ bool Minidump::SeekSet(off_t offset) {
 }
 
 off_t Minidump::Tell() {
-  if (!valid_ || !stream_) {
+  if (!valid_ || (!stream_ && !data_ && !reader_)) {
     return (off_t)-1;
   }
 
+  if (data_ || reader_) {
+    return data_offset_;
+  }
+
   // Check for conversion data loss
   std::streamoff std_streamoff = stream_->tellg();
   off_t rv = static_cast<off_t>(std_streamoff);
@@ -4475,6 +5313,16 @@ off_t Minidump::Tell() {
 }
 
 
+const uint8_t* Minidump::GetMappedBytes(off_t offset, size_t count) const {
+  if (!data_ || offset < 0 ||
+      static_cast<uint64_t>(offset) > data_size_ ||
+      count > data_size_ - static_cast<size_t>(offset)) {
+    return NULL;
+  }
+  return data_ + offset;
+}
+
+
 string* Minidump::ReadString(off_t offset) {
   if (!valid_) {
     BPLOG(ERROR) << "Invalid Minidump for ReadString";
@@ -4534,22 +5382,21 @@ bool Minidump::SeekToStreamType(uint32_t  stream_type,
     return false;
   }
 
-  MinidumpStreamMap::const_iterator iterator = stream_map_->find(stream_type);
-  if (iterator == stream_map_->end()) {
+  const MinidumpStreamInfo* info = FindStreamInfo(stream_type);
+  if (!info) {
     // This stream type didn't exist in the directory.
     BPLOG(INFO) << "SeekToStreamType: type " << stream_type << " not present";
     return false;
   }
 
-  MinidumpStreamInfo info = iterator->second;
-  if (info.stream_index >= header_.stream_count) {
+  if (info->stream_index >= header_.stream_count) {
     BPLOG(ERROR) << "SeekToStreamType: type " << stream_type <<
                     " out of range: " <<
-                    info.stream_index << "/" << header_.stream_count;
+                    info->stream_index << "/" << header_.stream_count;
     return false;
   }
 
-  MDRawDirectory* directory_entry = &(*directory_)[info.stream_index];
+  MDRawDirectory* directory_entry = &(*directory_)[info->stream_index];
   if (!SeekSet(directory_entry->location.rva)) {
     BPLOG(ERROR) << "SeekToStreamType could not seek to stream type " <<
                     stream_type;
@@ -4579,16 +5426,14 @@ T* Minidump::GetStream(T** stream) {
     return NULL;
   }
 
-  MinidumpStreamMap::iterator iterator = stream_map_->find(stream_type);
-  if (iterator == stream_map_->end()) {
+  // Get a pointer so that the stored stream field can be altered.
+  MinidumpStreamInfo* info = FindStreamInfo(stream_type);
+  if (!info) {
     // This stream type didn't exist in the directory.
     BPLOG(INFO) << "GetStream: type " << stream_type << " not present";
     return NULL;
   }
 
-  // Get a pointer so that the stored stream field can be altered.
-  MinidumpStreamInfo* info = &iterator->second;
-
   if (info->stream) {
     // This cast is safe because info.stream is only populated by this
     // method, and there is a direct correlation between T and stream_type.
@@ -4602,14 +5447,31 @@ T* Minidump::GetStream(T** stream) {
     return NULL;
   }
 
-  scoped_ptr<T> new_stream(new T(this));
+  // Reuse a stream of this type left over from an earlier Read, if there
+  // is one.  Its Read invalidates the data it held before.
+  T* new_stream = NULL;
+  for (MinidumpStreamMap::iterator iterator = spare_streams_.begin();
+       iterator != spare_streams_.end();
+       ++iterator) {
+    if (iterator->stream_type == stream_type) {
+      // This cast is safe for the same reason as the one above.
+      new_stream = static_cast<T*>(iterator->stream);
+      spare_streams_.erase(iterator);
+      break;
+    }
+  }
+  if (!new_stream)
+    new_stream = new T(this);
 
   if (!new_stream->Read(stream_length)) {
     BPLOG(ERROR) << "GetStream could not read stream type " << stream_type;
+    MinidumpStreamInfo spare(stream_type, 0);
+    spare.stream = new_stream;
+    spare_streams_.push_back(spare);
     return NULL;
   }
 
-  *stream = new_stream.release();
+  *stream = new_stream;
   info->stream = *stream;
   return *stream;
 }
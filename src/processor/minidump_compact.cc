@@ -0,0 +1,575 @@
+// Copyright (c) 2016 Google Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+// notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above
+// copyright notice, this list of conditions and the following disclaimer
+// in the documentation and/or other materials provided with the
+// distribution.
+//     * Neither the name of Google Inc. nor the names of its
+// contributors may be used to endorse or promote products derived from
+// this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+// minidump_compact.cc: Rewrite a minidump keeping only the memory that
+// processing it reads.
+//
+// The minidump is processed with MinidumpProcessor, with exploitability
+// analysis enabled, while a MinidumpMemoryReadLog records the memory read
+// from it.  A new minidump is then written with MinidumpFileWriter.  Thread
+// stacks are kept whole, since the stackwalkers view each stack as a
+// whole.  Of the other regions in the memory list, only the ranges that
+// were read are kept, widened by a margin (-m, 256 bytes by default) and
+// clipped to their regions.  Most of a full-memory dump is never read, and
+// the compacted dump reprocesses to the same stacks.
+//
+// The thread, module, memory, exception and system info streams are
+// rewritten, and streams that refer to nothing outside themselves, such as
+// the misc info, breakpad info and Linux /proc streams, are copied as they
+// are.  Any other stream is left out, with a message, since the locations
+// it holds can't be carried over.  Minidumps in the other byte order are
+// not supported.  With -c, the new minidump is written in the compressed
+// format of common/minidump_compression.h.
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "client/minidump_file_writer-inl.h"
+#include "common/scoped_ptr.h"
+#include "common/using_std_string.h"
+#include "google_breakpad/processor/basic_source_line_resolver.h"
+#include "google_breakpad/processor/minidump.h"
+#include "google_breakpad/processor/minidump_processor.h"
+#include "google_breakpad/processor/process_state.h"
+#include "processor/logging.h"
+#include "processor/simple_symbol_supplier.h"
+
+namespace {
+
+using google_breakpad::BasicSourceLineResolver;
+using google_breakpad::Minidump;
+using google_breakpad::MinidumpFileWriter;
+using google_breakpad::MinidumpMemoryReadLog;
+using google_breakpad::MinidumpProcessor;
+using google_breakpad::ProcessState;
+using google_breakpad::SimpleSymbolSupplier;
+using google_breakpad::UntypedMDRVA;
+using google_breakpad::TypedMDRVA;
+using google_breakpad::scoped_ptr;
+using std::map;
+using std::pair;
+using std::vector;
+
+const uint64_t kDefaultMargin = 256;
+
+// The longest MDString copied, in bytes.
+const uint32_t kMaxStringBytes = 64 * 1024;
+
+// Returns true if a stream of |stream_type| holds no locations in the
+// minidump, so that it can be copied as it is.
+bool IsSelfContained(uint32_t stream_type) {
+  switch (stream_type) {
+    case MD_MISC_INFO_STREAM:
+    case MD_MEMORY_INFO_LIST_STREAM:
+    case MD_THREAD_INFO_LIST_STREAM:
+    case MD_BREAKPAD_INFO_STREAM:
+    case MD_ASSERTION_INFO_STREAM:
+    case MD_LINUX_CPU_INFO:
+    case MD_LINUX_PROC_STATUS:
+    case MD_LINUX_LSB_RELEASE:
+    case MD_LINUX_CMD_LINE:
+    case MD_LINUX_ENVIRON:
+    case MD_LINUX_AUXV:
+    case MD_LINUX_MAPS:
+    case MD_LINUX_ANNOTATIONS:
+      return true;
+    default:
+      return false;
+  }
+}
+
+// Writes the parts of a minidump that processing it needs to a new one.
+class Compactor {
+ public:
+  // |read| holds the memory ranges that processing |dump| read.
+  Compactor(Minidump* dump, const MinidumpMemoryReadLog::RangeMap& read,
+            uint64_t margin, MinidumpFileWriter* writer)
+      : dump_(dump), read_(read), margin_(margin), writer_(writer),
+        memory_bytes_(0), kept_memory_bytes_(0) {}
+
+  bool Write();
+
+  uint64_t memory_bytes() const { return memory_bytes_; }
+  uint64_t kept_memory_bytes() const { return kept_memory_bytes_; }
+
+ private:
+  // Reads the bytes at |location| into |bytes|.
+  bool Read(const MDLocationDescriptor& location, vector<uint8_t>* bytes);
+
+  // Writes |size| bytes from |data| to the new minidump, setting |*output|
+  // to where they were written.
+  bool WriteBytes(const void* data, size_t size,
+                  MDLocationDescriptor* output);
+
+  // Copies the bytes at |*location| to the new minidump, and points
+  // |*location| at the copy.
+  bool Copy(MDLocationDescriptor* location);
+
+  // Copies the MDString at |*rva| to the new minidump, and points |*rva|
+  // at the copy.
+  bool CopyString(MDRVA* rva);
+
+  // Reads the list stream at |location|, a 32-bit count followed by that
+  // many entries of |entry_size| bytes, into |bytes|, setting |*count| and
+  // |*first| to the count and the offset of the first entry.  Some writers
+  // pad the count to 8 bytes.
+  bool ReadList(const MDLocationDescriptor& location, size_t entry_size,
+                vector<uint8_t>* bytes, uint32_t* count, size_t* first);
+
+  // Each of these writes a new copy of the stream at |*location|, and
+  // points |*location| at it.
+  bool WriteThreadList(MDLocationDescriptor* location);
+  bool WriteModuleList(MDLocationDescriptor* location);
+  bool WriteMemoryList(MDLocationDescriptor* location);
+  bool WriteException(MDLocationDescriptor* location);
+  bool WriteSystemInfo(MDLocationDescriptor* location);
+
+  // Adds the parts of |descriptor|'s region that are kept to |output|.
+  bool WriteMemoryRegion(const MDMemoryDescriptor& descriptor,
+                         vector<MDMemoryDescriptor>* output);
+
+  Minidump* dump_;
+  const MinidumpMemoryReadLog::RangeMap read_;
+  uint64_t margin_;
+  MinidumpFileWriter* writer_;
+
+  // The thread stacks written, by address range, so that a region in the
+  // memory list that is a stack can share its copy.
+  typedef map<pair<uint64_t, uint64_t>, MDLocationDescriptor> StackMap;
+  StackMap stacks_;
+
+  uint64_t memory_bytes_;
+  uint64_t kept_memory_bytes_;
+};
+
+bool Compactor::Write() {
+  const MDRawHeader* raw_header = dump_->header();
+  TypedMDRVA<MDRawHeader> header(writer_);
+  if (!header.Allocate())
+    return false;
+
+  // The stacks are written first, so that the memory list finds them
+  // wherever it is in the directory.
+  vector<MDRawDirectory> streams;
+  int thread_list_index = -1;
+  for (unsigned int i = 0; i < dump_->GetDirectoryEntryCount(); ++i) {
+    const MDRawDirectory* entry = dump_->GetDirectoryEntryAtIndex(i);
+    switch (entry->stream_type) {
+      case MD_UNUSED_STREAM:
+        continue;
+      case MD_THREAD_LIST_STREAM:
+        thread_list_index = streams.size();
+        // Fall through.
+      case MD_MODULE_LIST_STREAM:
+      case MD_MEMORY_LIST_STREAM:
+      case MD_EXCEPTION_STREAM:
+      case MD_SYSTEM_INFO_STREAM:
+        break;
+      default:
+        if (!IsSelfContained(entry->stream_type)) {
+          fprintf(stderr, "Leaving out stream of type 0x%x\n",
+                  entry->stream_type);
+          continue;
+        }
+    }
+    streams.push_back(*entry);
+  }
+  if (thread_list_index >= 0 &&
+      !WriteThreadList(&streams[thread_list_index].location)) {
+    return false;
+  }
+
+  for (size_t i = 0; i < streams.size(); ++i) {
+    MDLocationDescriptor* location = &streams[i].location;
+    bool written;
+    switch (streams[i].stream_type) {
+      case MD_THREAD_LIST_STREAM:
+        written = true;
+        break;
+      case MD_MODULE_LIST_STREAM:
+        written = WriteModuleList(location);
+        break;
+      case MD_MEMORY_LIST_STREAM:
+        written = WriteMemoryList(location);
+        break;
+      case MD_EXCEPTION_STREAM:
+        written = WriteException(location);
+        break;
+      case MD_SYSTEM_INFO_STREAM:
+        written = WriteSystemInfo(location);
+        break;
+      default:
+        written = Copy(location);
+        break;
+    }
+    if (!written) {
+      fprintf(stderr, "Couldn't write stream of type 0x%x\n",
+              streams[i].stream_type);
+      return false;
+    }
+  }
+
+  TypedMDRVA<MDRawDirectory> directory(writer_);
+  if (!directory.AllocateArray(streams.size()))
+    return false;
+  for (size_t i = 0; i < streams.size(); ++i)
+    directory.CopyIndex(i, &streams[i]);
+
+  *header.get() = *raw_header;
+  header.get()->stream_count = streams.size();
+  header.get()->stream_directory_rva = directory.position();
+  header.get()->checksum = 0;
+  return header.Flush();
+}
+
+bool Compactor::Read(const MDLocationDescriptor& location,
+                     vector<uint8_t>* bytes) {
+  bytes->resize(location.data_size);
+  if (location.data_size == 0)
+    return true;
+  return dump_->SeekSet(location.rva) &&
+         dump_->ReadBytes(&(*bytes)[0], location.data_size);
+}
+
+bool Compactor::WriteBytes(const void* data, size_t size,
+                           MDLocationDescriptor* output) {
+  UntypedMDRVA copy(writer_);
+  if (!copy.Allocate(size) || !copy.Copy(data, size))
+    return false;
+  *output = copy.location();
+  return true;
+}
+
+bool Compactor::Copy(MDLocationDescriptor* location) {
+  if (location->data_size == 0) {
+    location->rva = 0;
+    return true;
+  }
+  vector<uint8_t> bytes;
+  return Read(*location, &bytes) &&
+         WriteBytes(&bytes[0], bytes.size(), location);
+}
+
+bool Compactor::CopyString(MDRVA* rva) {
+  if (*rva == 0)
+    return true;
+  uint32_t length;
+  if (!dump_->SeekSet(*rva) || !dump_->ReadBytes(&length, sizeof(length)) ||
+      length > kMaxStringBytes) {
+    return false;
+  }
+  // The string is written with the terminator that MDStrings carry, which
+  // isn't counted in its length.
+  vector<uint8_t> bytes(sizeof(length) + length + sizeof(uint16_t));
+  memcpy(&bytes[0], &length, sizeof(length));
+  if (length && !dump_->ReadBytes(&bytes[sizeof(length)], length))
+    return false;
+  MDLocationDescriptor copy;
+  if (!WriteBytes(&bytes[0], bytes.size(), &copy))
+    return false;
+  *rva = copy.rva;
+  return true;
+}
+
+bool Compactor::ReadList(const MDLocationDescriptor& location,
+                         size_t entry_size, vector<uint8_t>* bytes,
+                         uint32_t* count, size_t* first) {
+  if (location.data_size < sizeof(*count) || !Read(location, bytes))
+    return false;
+  memcpy(count, &(*bytes)[0], sizeof(*count));
+  if (*count > (location.data_size - sizeof(*count)) / entry_size)
+    return false;
+  uint64_t entries_size = static_cast<uint64_t>(*count) * entry_size;
+  if (location.data_size == sizeof(*count) + entries_size) {
+    *first = sizeof(*count);
+  } else if (location.data_size == 8 + entries_size) {
+    *first = 8;
+  } else {
+    return false;
+  }
+  return true;
+}
+
+bool Compactor::WriteThreadList(MDLocationDescriptor* location) {
+  vector<uint8_t> bytes;
+  uint32_t count;
+  size_t first;
+  if (!ReadList(*location, sizeof(MDRawThread), &bytes, &count, &first))
+    return false;
+  for (uint32_t i = 0; i < count; ++i) {
+    uint8_t* entry = &bytes[first + i * sizeof(MDRawThread)];
+    MDRawThread thread;
+    memcpy(&thread, entry, sizeof(thread));
+    if (!Copy(&thread.thread_context))
+      return false;
+
+    const pair<uint64_t, uint64_t> range(thread.stack.start_of_memory_range,
+                                         thread.stack.memory.data_size);
+    StackMap::const_iterator stack = stacks_.find(range);
+    if (stack != stacks_.end()) {
+      thread.stack.memory = stack->second;
+    } else {
+      if (!Copy(&thread.stack.memory))
+        return false;
+      stacks_[range] = thread.stack.memory;
+    }
+    memcpy(entry, &thread, sizeof(thread));
+  }
+  return WriteBytes(&bytes[0], bytes.size(), location);
+}
+
+bool Compactor::WriteModuleList(MDLocationDescriptor* location) {
+  vector<uint8_t> bytes;
+  uint32_t count;
+  size_t first;
+  if (!ReadList(*location, MD_MODULE_SIZE, &bytes, &count, &first))
+    return false;
+  for (uint32_t i = 0; i < count; ++i) {
+    uint8_t* entry = &bytes[first + i * MD_MODULE_SIZE];
+    // MDRawModule is larger than MD_MODULE_SIZE, because of its alignment.
+    MDRawModule module;
+    memcpy(&module, entry, MD_MODULE_SIZE);
+    if (!CopyString(&module.module_name_rva) ||
+        !Copy(&module.cv_record) ||
+        !Copy(&module.misc_record)) {
+      return false;
+    }
+    memcpy(entry, &module, MD_MODULE_SIZE);
+  }
+  return WriteBytes(&bytes[0], bytes.size(), location);
+}
+
+bool Compactor::WriteMemoryList(MDLocationDescriptor* location) {
+  vector<uint8_t> bytes;
+  uint32_t count;
+  size_t first;
+  if (!ReadList(*location, sizeof(MDMemoryDescriptor), &bytes, &count,
+                &first)) {
+    return false;
+  }
+  vector<MDMemoryDescriptor> descriptors;
+  for (uint32_t i = 0; i < count; ++i) {
+    MDMemoryDescriptor descriptor;
+    memcpy(&descriptor, &bytes[first + i * sizeof(descriptor)],
+           sizeof(descriptor));
+    if (!WriteMemoryRegion(descriptor, &descriptors))
+      return false;
+  }
+
+  uint32_t new_count = descriptors.size();
+  vector<uint8_t> list(sizeof(new_count) +
+                       new_count * sizeof(MDMemoryDescriptor));
+  memcpy(&list[0], &new_count, sizeof(new_count));
+  if (new_count) {
+    memcpy(&list[sizeof(new_count)], &descriptors[0],
+           new_count * sizeof(MDMemoryDescriptor));
+  }
+  return WriteBytes(&list[0], list.size(), location);
+}
+
+bool Compactor::WriteMemoryRegion(const MDMemoryDescriptor& descriptor,
+                                  vector<MDMemoryDescriptor>* output) {
+  const uint64_t start = descriptor.start_of_memory_range;
+  const uint64_t size = descriptor.memory.data_size;
+  if (size == 0 || size > UINT64_MAX - start)
+    return true;
+  const uint64_t end = start + size;
+  memory_bytes_ += size;
+
+  StackMap::const_iterator stack = stacks_.find(std::make_pair(start, size));
+  if (stack != stacks_.end()) {
+    MDMemoryDescriptor copy = descriptor;
+    copy.memory = stack->second;
+    output->push_back(copy);
+    kept_memory_bytes_ += size;
+    return true;
+  }
+
+  // Find the read ranges that come within the margin of the region, and
+  // keep them and their margins, merging any that meet.
+  const uint64_t search_start = start > margin_ ? start - margin_ : 0;
+  MinidumpMemoryReadLog::RangeMap::const_iterator range =
+      read_.upper_bound(search_start);
+  if (range != read_.begin())
+    --range;
+  vector<pair<uint64_t, uint64_t> > pieces;
+  for (; range != read_.end(); ++range) {
+    const uint64_t range_start =
+        range->first > margin_ ? range->first - margin_ : 0;
+    const uint64_t range_end = range->second > UINT64_MAX - margin_ ?
+                               UINT64_MAX : range->second + margin_;
+    if (range_start >= end)
+      break;
+    const uint64_t piece_start = std::max(start, range_start);
+    const uint64_t piece_end = std::min(end, range_end);
+    if (piece_start >= piece_end)
+      continue;
+    if (!pieces.empty() && pieces.back().second >= piece_start)
+      pieces.back().second = std::max(pieces.back().second, piece_end);
+    else
+      pieces.push_back(std::make_pair(piece_start, piece_end));
+  }
+
+  for (size_t i = 0; i < pieces.size(); ++i) {
+    MDMemoryDescriptor piece;
+    piece.start_of_memory_range = pieces[i].first;
+    piece.memory.data_size = pieces[i].second - pieces[i].first;
+    piece.memory.rva = descriptor.memory.rva + (pieces[i].first - start);
+    if (!Copy(&piece.memory))
+      return false;
+    output->push_back(piece);
+    kept_memory_bytes_ += piece.memory.data_size;
+  }
+  return true;
+}
+
+bool Compactor::WriteException(MDLocationDescriptor* location) {
+  vector<uint8_t> bytes;
+  if (location->data_size < sizeof(MDRawExceptionStream) ||
+      !Read(*location, &bytes)) {
+    return false;
+  }
+  MDRawExceptionStream exception;
+  memcpy(&exception, &bytes[0], sizeof(exception));
+  if (!Copy(&exception.thread_context))
+    return false;
+  memcpy(&bytes[0], &exception, sizeof(exception));
+  return WriteBytes(&bytes[0], bytes.size(), location);
+}
+
+bool Compactor::WriteSystemInfo(MDLocationDescriptor* location) {
+  vector<uint8_t> bytes;
+  if (location->data_size < sizeof(MDRawSystemInfo) ||
+      !Read(*location, &bytes)) {
+    return false;
+  }
+  MDRawSystemInfo system_info;
+  memcpy(&system_info, &bytes[0], sizeof(system_info));
+  if (!CopyString(&system_info.csd_version_rva))
+    return false;
+  memcpy(&bytes[0], &system_info, sizeof(system_info));
+  return WriteBytes(&bytes[0], bytes.size(), location);
+}
+
+void usage(const char* program_name) {
+  fprintf(stderr,
+          "usage: %s [-c] [-m <margin>] <minidump-file> <output-file> "
+          "[<symbol-path> ...]\n"
+          "    -c  Write the compacted minidump compressed\n"
+          "    -m  Bytes kept on either side of the memory read outside "
+          "thread stacks\n"
+          "        (default %" PRIu64 ")\n",
+          program_name, kDefaultMargin);
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  BPLOG_INIT(&argc, &argv);
+
+  bool compressed = false;
+  uint64_t margin = kDefaultMargin;
+  int ch;
+  while ((ch = getopt(argc, argv, "cm:h")) != -1) {
+    switch (ch) {
+      case 'c':
+        compressed = true;
+        break;
+      case 'm': {
+        char* end;
+        margin = strtoull(optarg, &end, 0);
+        if (*optarg == '\0' || *end != '\0') {
+          usage(argv[0]);
+          return 1;
+        }
+        break;
+      }
+      default:
+        usage(argv[0]);
+        return 1;
+    }
+  }
+  if (argc - optind < 2) {
+    usage(argv[0]);
+    return 1;
+  }
+  const string minidump_file = argv[optind];
+  const string output_file = argv[optind + 1];
+  vector<string> symbol_paths(argv + optind + 2, argv + argc);
+
+  Minidump dump(minidump_file);
+  if (!dump.Read()) {
+    fprintf(stderr, "Couldn't read minidump %s\n", minidump_file.c_str());
+    return 1;
+  }
+  if (dump.swap()) {
+    fprintf(stderr, "Minidumps in the other byte order are not supported\n");
+    return 1;
+  }
+
+  MinidumpMemoryReadLog read_log;
+  dump.set_memory_read_log(&read_log);
+  scoped_ptr<SimpleSymbolSupplier> supplier;
+  if (!symbol_paths.empty())
+    supplier.reset(new SimpleSymbolSupplier(symbol_paths));
+  BasicSourceLineResolver resolver;
+  MinidumpProcessor processor(supplier.get(), &resolver, true);
+  ProcessState process_state;
+  if (processor.Process(&dump, &process_state) !=
+      google_breakpad::PROCESS_OK) {
+    fprintf(stderr, "Couldn't process minidump %s\n", minidump_file.c_str());
+    return 1;
+  }
+  dump.set_memory_read_log(NULL);
+
+  MinidumpFileWriter writer;
+  writer.set_compressed(compressed);
+  if (!writer.Open(output_file.c_str())) {
+    fprintf(stderr, "Couldn't create %s\n", output_file.c_str());
+    return 1;
+  }
+  Compactor compactor(&dump, read_log.ranges(), margin, &writer);
+  if (!compactor.Write() || !writer.Close()) {
+    fprintf(stderr, "Couldn't write %s\n", output_file.c_str());
+    unlink(output_file.c_str());
+    return 1;
+  }
+  fprintf(stderr, "Kept %" PRIu64 " of %" PRIu64 " bytes of listed memory\n",
+          compactor.kept_memory_bytes(), compactor.memory_bytes());
+  return 0;
+}
@@ -34,8 +34,14 @@
 
 #include <stdio.h>
 #include <string.h>
+#include <unistd.h>
+
+#include <set>
+#include <string>
+#include <vector>
 
 #include "common/scoped_ptr.h"
+#include "common/using_std_string.h"
 #include "google_breakpad/processor/minidump.h"
 #include "processor/logging.h"
 
@@ -51,6 +57,58 @@ using google_breakpad::MinidumpAssertion;
 using google_breakpad::MinidumpSystemInfo;
 using google_breakpad::MinidumpMiscInfo;
 using google_breakpad::MinidumpBreakpadInfo;
+using google_breakpad::MinidumpHandlerTiming;
+
+// The names -s accepts, in the order the streams are printed. "header"
+// is the minidump header and stream directory.
+const char* const kStreamNames[] = {
+  "header", "threads", "modules", "memory", "exception", "assertion",
+  "system_info", "misc_info", "breakpad_info", "handler_timing",
+  "memory_info", "linux_cmd_line", "linux_environ", "linux_lsb_release",
+  "linux_proc_status", "linux_cpu_info", "linux_maps"
+};
+
+// The streams to print. Minidump reads each stream only when it is first
+// asked for, so streams that aren't selected are never read.
+class StreamSelection {
+ public:
+  StreamSelection() : all_(true) { }
+
+  // Add the comma-separated stream names in LIST to the selection.
+  // Return false if one of them isn't in kStreamNames.
+  bool Add(const char *list) {
+    all_ = false;
+    string names(list);
+    size_t start = 0;
+    while (start <= names.size()) {
+      size_t end = names.find(',', start);
+      if (end == string::npos)
+        end = names.size();
+      string name = names.substr(start, end - start);
+      bool known = false;
+      for (size_t i = 0; i < sizeof(kStreamNames) / sizeof(kStreamNames[0]);
+           ++i) {
+        if (name == kStreamNames[i])
+          known = true;
+      }
+      if (!known) {
+        fprintf(stderr, "Unknown stream: %s\n", name.c_str());
+        return false;
+      }
+      selected_.insert(name);
+      start = end + 1;
+    }
+    return true;
+  }
+
+  bool Wants(const char *name) const {
+    return all_ || selected_.count(name) != 0;
+  }
+
+ private:
+  bool all_;
+  std::set<string> selected_;
+};
 
 static void DumpRawStream(Minidump *minidump,
                           uint32_t stream_type,
@@ -91,123 +149,191 @@ static void DumpRawStream(Minidump *minidump,
   printf("\n\n");
 }
 
-static bool PrintMinidumpDump(const char *minidump_file) {
+static bool PrintMinidumpDump(const char *minidump_file,
+                              const StreamSelection &streams) {
   Minidump minidump(minidump_file);
   if (!minidump.Read()) {
     BPLOG(ERROR) << "minidump.Read() failed";
     return false;
   }
-  minidump.Print();
+  if (streams.Wants("header"))
+    minidump.Print();
 
   int errors = 0;
 
-  MinidumpThreadList *thread_list = minidump.GetThreadList();
-  if (!thread_list) {
-    ++errors;
-    BPLOG(ERROR) << "minidump.GetThreadList() failed";
-  } else {
-    thread_list->Print();
-  }
-
-  MinidumpModuleList *module_list = minidump.GetModuleList();
-  if (!module_list) {
-    ++errors;
-    BPLOG(ERROR) << "minidump.GetModuleList() failed";
-  } else {
-    module_list->Print();
-  }
-
-  MinidumpMemoryList *memory_list = minidump.GetMemoryList();
-  if (!memory_list) {
-    ++errors;
-    BPLOG(ERROR) << "minidump.GetMemoryList() failed";
-  } else {
-    memory_list->Print();
-  }
-
-  MinidumpException *exception = minidump.GetException();
-  if (!exception) {
-    BPLOG(INFO) << "minidump.GetException() failed";
-  } else {
-    exception->Print();
-  }
-
-  MinidumpAssertion *assertion = minidump.GetAssertion();
-  if (!assertion) {
-    BPLOG(INFO) << "minidump.GetAssertion() failed";
-  } else {
-    assertion->Print();
-  }
-
-  MinidumpSystemInfo *system_info = minidump.GetSystemInfo();
-  if (!system_info) {
-    ++errors;
-    BPLOG(ERROR) << "minidump.GetSystemInfo() failed";
-  } else {
-    system_info->Print();
-  }
-
-  MinidumpMiscInfo *misc_info = minidump.GetMiscInfo();
-  if (!misc_info) {
-    ++errors;
-    BPLOG(ERROR) << "minidump.GetMiscInfo() failed";
-  } else {
-    misc_info->Print();
-  }
-
-  MinidumpBreakpadInfo *breakpad_info = minidump.GetBreakpadInfo();
-  if (!breakpad_info) {
-    // Breakpad info is optional, so don't treat this as an error.
-    BPLOG(INFO) << "minidump.GetBreakpadInfo() failed";
-  } else {
-    breakpad_info->Print();
-  }
-
-  MinidumpMemoryInfoList *memory_info_list = minidump.GetMemoryInfoList();
-  if (!memory_info_list) {
-    ++errors;
-    BPLOG(ERROR) << "minidump.GetMemoryInfoList() failed";
-  } else {
-    memory_info_list->Print();
-  }
-
-  DumpRawStream(&minidump,
-                MD_LINUX_CMD_LINE,
-                "MD_LINUX_CMD_LINE",
-                &errors);
-  DumpRawStream(&minidump,
-                MD_LINUX_ENVIRON,
-                "MD_LINUX_ENVIRON",
-                &errors);
-  DumpRawStream(&minidump,
-                MD_LINUX_LSB_RELEASE,
-                "MD_LINUX_LSB_RELEASE",
-                &errors);
-  DumpRawStream(&minidump,
-                MD_LINUX_PROC_STATUS,
-                "MD_LINUX_PROC_STATUS",
-                &errors);
-  DumpRawStream(&minidump,
-                MD_LINUX_CPU_INFO,
-                "MD_LINUX_CPU_INFO",
-                &errors);
-  DumpRawStream(&minidump,
-                MD_LINUX_MAPS,
-                "MD_LINUX_MAPS",
-                &errors);
+  if (streams.Wants("threads")) {
+    MinidumpThreadList *thread_list = minidump.GetThreadList();
+    if (!thread_list) {
+      ++errors;
+      BPLOG(ERROR) << "minidump.GetThreadList() failed";
+    } else {
+      thread_list->Print();
+    }
+  }
+
+  if (streams.Wants("modules")) {
+    MinidumpModuleList *module_list = minidump.GetModuleList();
+    if (!module_list) {
+      ++errors;
+      BPLOG(ERROR) << "minidump.GetModuleList() failed";
+    } else {
+      module_list->Print();
+    }
+  }
+
+  if (streams.Wants("memory")) {
+    MinidumpMemoryList *memory_list = minidump.GetMemoryList();
+    if (!memory_list) {
+      ++errors;
+      BPLOG(ERROR) << "minidump.GetMemoryList() failed";
+    } else {
+      memory_list->Print();
+    }
+  }
+
+  if (streams.Wants("exception")) {
+    MinidumpException *exception = minidump.GetException();
+    if (!exception) {
+      BPLOG(INFO) << "minidump.GetException() failed";
+    } else {
+      exception->Print();
+    }
+  }
+
+  if (streams.Wants("assertion")) {
+    MinidumpAssertion *assertion = minidump.GetAssertion();
+    if (!assertion) {
+      BPLOG(INFO) << "minidump.GetAssertion() failed";
+    } else {
+      assertion->Print();
+    }
+  }
+
+  if (streams.Wants("system_info")) {
+    MinidumpSystemInfo *system_info = minidump.GetSystemInfo();
+    if (!system_info) {
+      ++errors;
+      BPLOG(ERROR) << "minidump.GetSystemInfo() failed";
+    } else {
+      system_info->Print();
+    }
+  }
+
+  if (streams.Wants("misc_info")) {
+    MinidumpMiscInfo *misc_info = minidump.GetMiscInfo();
+    if (!misc_info) {
+      ++errors;
+      BPLOG(ERROR) << "minidump.GetMiscInfo() failed";
+    } else {
+      misc_info->Print();
+    }
+  }
+
+  if (streams.Wants("breakpad_info")) {
+    MinidumpBreakpadInfo *breakpad_info = minidump.GetBreakpadInfo();
+    if (!breakpad_info) {
+      // Breakpad info is optional, so don't treat this as an error.
+      BPLOG(INFO) << "minidump.GetBreakpadInfo() failed";
+    } else {
+      breakpad_info->Print();
+    }
+  }
+
+  if (streams.Wants("handler_timing")) {
+    MinidumpHandlerTiming *handler_timing = minidump.GetHandlerTiming();
+    if (!handler_timing) {
+      // Only Linux dumps have handler timing, so don't treat this as an error.
+      BPLOG(INFO) << "minidump.GetHandlerTiming() failed";
+    } else {
+      handler_timing->Print();
+    }
+  }
+
+  if (streams.Wants("memory_info")) {
+    MinidumpMemoryInfoList *memory_info_list = minidump.GetMemoryInfoList();
+    if (!memory_info_list) {
+      ++errors;
+      BPLOG(ERROR) << "minidump.GetMemoryInfoList() failed";
+    } else {
+      memory_info_list->Print();
+    }
+  }
+
+  if (streams.Wants("linux_cmd_line")) {
+    DumpRawStream(&minidump,
+                  MD_LINUX_CMD_LINE,
+                  "MD_LINUX_CMD_LINE",
+                  &errors);
+  }
+  if (streams.Wants("linux_environ")) {
+    DumpRawStream(&minidump,
+                  MD_LINUX_ENVIRON,
+                  "MD_LINUX_ENVIRON",
+                  &errors);
+  }
+  if (streams.Wants("linux_lsb_release")) {
+    DumpRawStream(&minidump,
+                  MD_LINUX_LSB_RELEASE,
+                  "MD_LINUX_LSB_RELEASE",
+                  &errors);
+  }
+  if (streams.Wants("linux_proc_status")) {
+    DumpRawStream(&minidump,
+                  MD_LINUX_PROC_STATUS,
+                  "MD_LINUX_PROC_STATUS",
+                  &errors);
+  }
+  if (streams.Wants("linux_cpu_info")) {
+    DumpRawStream(&minidump,
+                  MD_LINUX_CPU_INFO,
+                  "MD_LINUX_CPU_INFO",
+                  &errors);
+  }
+  if (streams.Wants("linux_maps")) {
+    DumpRawStream(&minidump,
+                  MD_LINUX_MAPS,
+                  "MD_LINUX_MAPS",
+                  &errors);
+  }
 
   return errors == 0;
 }
 
+static void usage(const char *program_name) {
+  fprintf(stderr, "usage: %s [-s stream[,stream...]] <file>\n"
+          "    -s : Print only the named streams, which may be any of\n"
+          "        ", program_name);
+  for (size_t i = 0; i < sizeof(kStreamNames) / sizeof(kStreamNames[0]); ++i)
+    fprintf(stderr, "%s%s", i ? ", " : "", kStreamNames[i]);
+  fprintf(stderr, "\n");
+}
+
 }  // namespace
 
 int main(int argc, char **argv) {
   BPLOG_INIT(&argc, &argv);
 
-  if (argc != 2) {
-    fprintf(stderr, "usage: %s <file>\n", argv[0]);
+  StreamSelection streams;
+  int ch;
+  while ((ch = getopt(argc, argv, "hs:")) != -1) {
+    switch (ch) {
+      case 's':
+        if (!streams.Add(optarg))
+          return 1;
+        break;
+      default:
+        usage(argv[0]);
+        return 1;
+    }
+  }
+
+  if (optind != argc - 1) {
+    usage(argv[0]);
     return 1;
   }
 
-  return PrintMinidumpDump(argv[1]) ? 0 : 1;
+  // Memory regions and raw streams can produce a lot of output.
+  setvbuf(stdout, NULL, _IOFBF, 1 << 20);
+
+  return PrintMinidumpDump(argv[optind], streams) ? 0 : 1;
 }
@@ -32,25 +32,268 @@
 #include <assert.h>
 #include <stdio.h>
 
+#include <set>
 #include <string>
+#include <vector>
 
 #include "common/scoped_ptr.h"
 #include "common/using_std_string.h"
 #include "google_breakpad/processor/call_stack.h"
+#include "google_breakpad/processor/code_modules_cache.h"
+#include "google_breakpad/processor/crash_signature_cache.h"
 #include "google_breakpad/processor/minidump.h"
 #include "google_breakpad/processor/process_state.h"
 #include "google_breakpad/processor/exploitability.h"
+#include "google_breakpad/processor/process_statistics.h"
+#include "google_breakpad/processor/source_line_resolver_interface.h"
+#include "google_breakpad/processor/stack_frame.h"
 #include "google_breakpad/processor/stack_frame_symbolizer.h"
+#include "google_breakpad/processor/task_executor.h"
+#include "google_breakpad/processor/walk_budget.h"
+#include "processor/linked_ptr.h"
 #include "processor/logging.h"
+#include "processor/serialized_stack_frame_symbolizer.h"
 #include "processor/stackwalker_x86.h"
+#include "processor/stopwatch.h"
+#include "processor/symbolized_frame_memo.h"
 
 namespace google_breakpad {
 
+namespace {
+
+using std::vector;
+
+// A stack walk that Process has set up but deferred, so that it can be run
+// on a walker thread.  Everything that reads from the minidump is done
+// before the walk is deferred; the walk itself only reads the thread's
+// (already loaded) stack memory and the process' CodeModules.
+struct DeferredStackwalk {
+  DeferredStackwalk() : stack(NULL), thread_position(0), interrupted(false),
+                        seconds(0) {}
+
+  string thread_string;
+  linked_ptr<Stackwalker> stackwalker;
+  // Owned by the ProcessState.
+  CallStack* stack;
+  // The position of |stack| in the ProcessState's threads.
+  size_t thread_position;
+  // Filled by the walk, and merged into the ProcessState's lists once all
+  // walks are done.
+  vector<const CodeModule*> modules_without_symbols;
+  vector<const CodeModule*> modules_with_corrupt_symbols;
+  bool interrupted;
+  // How long the walk took.
+  double seconds;
+};
+
+// Appends the modules in |from| that aren't already in |to| to |to|,
+// preserving their order.
+void MergeModuleList(const vector<const CodeModule*>& from,
+                     vector<const CodeModule*>* to) {
+  for (vector<const CodeModule*>::const_iterator iterator = from.begin();
+       iterator != from.end();
+       ++iterator) {
+    bool found = false;
+    for (vector<const CodeModule*>::const_iterator existing = to->begin();
+         existing != to->end();
+         ++existing) {
+      if (*existing == *iterator) {
+        found = true;
+        break;
+      }
+    }
+    if (!found)
+      to->push_back(*iterator);
+  }
+}
+
+// Walks |walk|'s stack on the calling thread, timing it.
+void RunStackwalk(DeferredStackwalk* walk) {
+  Stopwatch walk_time;
+  if (!walk->stackwalker->Walk(walk->stack,
+                               &walk->modules_without_symbols,
+                               &walk->modules_with_corrupt_symbols)) {
+    walk->interrupted = true;
+  }
+  walk->seconds = walk_time.ElapsedSeconds();
+}
+
+// Runs a deferred walk as a task.
+class StackwalkTask : public Task {
+ public:
+  explicit StackwalkTask(DeferredStackwalk* walk) : walk_(walk) {}
+
+  virtual void Run() { RunStackwalk(walk_); }
+
+ private:
+  DeferredStackwalk* walk_;
+};
+
+// The number of stack words OrderModulesForPrefetch looks at.
+const unsigned int kPrefetchStackScanWords = 4096;
+
+void AddModuleForPrefetch(const CodeModule* module,
+                          std::set<const CodeModule*>* listed,
+                          vector<const CodeModule*>* ordered) {
+  if (module && listed->insert(module).second)
+    ordered->push_back(module);
+}
+
+// Lists |modules| in the order their symbols are likely to be needed to walk
+// the stack of the thread with |context| and |stack_memory|, either of which
+// may be NULL: the module containing the instruction pointer, then the
+// modules that words on the stack point into, nearest the top of the stack
+// first, then the rest in module list order.  Unless |limit| is 0, at most
+// |limit| modules are listed.
+void OrderModulesForPrefetch(const CodeModules* modules,
+                             DumpContext* context,
+                             MemoryRegion* stack_memory,
+                             unsigned int limit,
+                             vector<const CodeModule*>* ordered) {
+  ordered->clear();
+  if (!modules)
+    return;
+  size_t max_modules = limit ? limit : modules->module_count();
+  std::set<const CodeModule*> listed;
+
+  uint64_t instruction_pointer;
+  if (context && context->GetInstructionPointer(&instruction_pointer)) {
+    AddModuleForPrefetch(modules->GetModuleForAddress(instruction_pointer),
+                         &listed, ordered);
+  }
+
+  if (context && stack_memory) {
+    uint32_t cpu = context->GetContextCPU();
+    bool is_64_bit = cpu == MD_CONTEXT_AMD64 || cpu == MD_CONTEXT_ARM64 ||
+                     cpu == MD_CONTEXT_PPC64;
+    uint64_t word_size = is_64_bit ? 8 : 4;
+    uint64_t address = stack_memory->GetBase();
+    uint64_t end = address + stack_memory->GetSize();
+    for (unsigned int words = 0;
+         words < kPrefetchStackScanWords && address + word_size <= end &&
+             ordered->size() < max_modules;
+         ++words, address += word_size) {
+      uint64_t value;
+      if (is_64_bit) {
+        if (!stack_memory->GetMemoryAtAddress(address, &value))
+          break;
+      } else {
+        uint32_t value32;
+        if (!stack_memory->GetMemoryAtAddress(address, &value32))
+          break;
+        value = value32;
+      }
+      AddModuleForPrefetch(modules->GetModuleForAddress(value), &listed,
+                           ordered);
+    }
+  }
+
+  for (unsigned int i = 0; i < modules->module_count(); ++i)
+    AddModuleForPrefetch(modules->GetModuleAtIndex(i), &listed, ordered);
+
+  if (ordered->size() > max_modules)
+    ordered->resize(max_modules);
+}
+
+// Adds the frames of |stack| to the frame counts in |statistics|.
+void CountStackFrames(const CallStack& stack, ProcessStatistics* statistics) {
+  const vector<StackFrame*>* frames = stack.frames();
+  for (vector<StackFrame*>::const_iterator frame = frames->begin();
+       frame != frames->end();
+       ++frame) {
+    switch ((*frame)->trust) {
+      case StackFrame::FRAME_TRUST_CONTEXT:
+        ++statistics->context_frame_count;
+        break;
+      case StackFrame::FRAME_TRUST_CFI:
+        ++statistics->cfi_frame_count;
+        break;
+      case StackFrame::FRAME_TRUST_FP:
+        ++statistics->frame_pointer_frame_count;
+        break;
+      case StackFrame::FRAME_TRUST_SCAN:
+      case StackFrame::FRAME_TRUST_CFI_SCAN:
+        ++statistics->scanned_frame_count;
+        break;
+      default:
+        ++statistics->other_frame_count;
+        break;
+    }
+  }
+}
+
+// Adds the frames of |threads| to the frame counts in |statistics|.
+void CountFrames(const vector<CallStack*>& threads,
+                 ProcessStatistics* statistics) {
+  for (vector<CallStack*>::const_iterator thread = threads.begin();
+       thread != threads.end();
+       ++thread) {
+    CountStackFrames(**thread, statistics);
+  }
+}
+
+// Points the symbolizer at the ProcessStatistics being collected for the
+// minidump that Process is working on, until Process returns.
+class ScopedSymbolizerStatistics {
+ public:
+  ScopedSymbolizerStatistics(StackFrameSymbolizer* symbolizer,
+                             ProcessStatistics* statistics)
+      : symbolizer_(symbolizer) {
+    symbolizer_->set_statistics(statistics);
+  }
+  ~ScopedSymbolizerStatistics() { symbolizer_->set_statistics(NULL); }
+
+ private:
+  StackFrameSymbolizer* symbolizer_;
+};
+
+// Charges the symbol data the symbolizer reads to the budget of the
+// minidump that Process is working on, until Process returns.
+class ScopedSymbolizerWalkBudget {
+ public:
+  ScopedSymbolizerWalkBudget(StackFrameSymbolizer* symbolizer,
+                             WalkBudget* budget)
+      : symbolizer_(symbolizer) {
+    symbolizer_->set_walk_budget(budget);
+  }
+  ~ScopedSymbolizerWalkBudget() { symbolizer_->set_walk_budget(NULL); }
+
+ private:
+  StackFrameSymbolizer* symbolizer_;
+};
+
+// Stops the symbol prefetch that Process started when Process returns.
+class ScopedSymbolPrefetch {
+ public:
+  explicit ScopedSymbolPrefetch(StackFrameSymbolizer* symbolizer)
+      : symbolizer_(symbolizer) {}
+  ~ScopedSymbolPrefetch() { symbolizer_->StopPrefetch(); }
+
+ private:
+  StackFrameSymbolizer* symbolizer_;
+};
+
+}  // namespace
+
 MinidumpProcessor::MinidumpProcessor(SymbolSupplier *supplier,
                                      SourceLineResolverInterface *resolver)
     : frame_symbolizer_(new StackFrameSymbolizer(supplier, resolver)),
       own_frame_symbolizer_(true),
-      enable_exploitability_(false) {
+      enable_exploitability_(false),
+      walker_thread_count_(1),
+      task_executor_(NULL),
+      symbol_prefetch_thread_count_(0),
+      symbol_prefetch_module_limit_(0),
+      collect_statistics_(false),
+      memoize_frames_(false),
+      source_lines_for_requesting_thread_only_(false),
+      requesting_thread_callback_(NULL),
+      crash_signature_cache_(NULL),
+      thread_sink_(NULL),
+      unwind_policy_(NULL),
+      analyze_instructions_(true),
+      instruction_analysis_cache_(NULL),
+      code_modules_cache_(NULL) {
 }
 
 MinidumpProcessor::MinidumpProcessor(SymbolSupplier *supplier,
@@ -58,14 +301,42 @@ MinidumpProcessor::MinidumpProcessor(SymbolSupplier *supplier,
                                      bool enable_exploitability)
     : frame_symbolizer_(new StackFrameSymbolizer(supplier, resolver)),
       own_frame_symbolizer_(true),
-      enable_exploitability_(enable_exploitability) {
+      enable_exploitability_(enable_exploitability),
+      walker_thread_count_(1),
+      task_executor_(NULL),
+      symbol_prefetch_thread_count_(0),
+      symbol_prefetch_module_limit_(0),
+      collect_statistics_(false),
+      memoize_frames_(false),
+      source_lines_for_requesting_thread_only_(false),
+      requesting_thread_callback_(NULL),
+      crash_signature_cache_(NULL),
+      thread_sink_(NULL),
+      unwind_policy_(NULL),
+      analyze_instructions_(true),
+      instruction_analysis_cache_(NULL),
+      code_modules_cache_(NULL) {
 }
 
 MinidumpProcessor::MinidumpProcessor(StackFrameSymbolizer *frame_symbolizer,
                                      bool enable_exploitability)
     : frame_symbolizer_(frame_symbolizer),
       own_frame_symbolizer_(false),
-      enable_exploitability_(enable_exploitability) {
+      enable_exploitability_(enable_exploitability),
+      walker_thread_count_(1),
+      task_executor_(NULL),
+      symbol_prefetch_thread_count_(0),
+      symbol_prefetch_module_limit_(0),
+      collect_statistics_(false),
+      memoize_frames_(false),
+      source_lines_for_requesting_thread_only_(false),
+      requesting_thread_callback_(NULL),
+      crash_signature_cache_(NULL),
+      thread_sink_(NULL),
+      unwind_policy_(NULL),
+      analyze_instructions_(true),
+      instruction_analysis_cache_(NULL),
+      code_modules_cache_(NULL) {
   assert(frame_symbolizer_);
 }
 
@@ -80,6 +351,10 @@ ProcessResult MinidumpProcessor::Process(
 
   process_state->Clear();
 
+  ProcessStatistics* statistics =
+      collect_statistics_ ? &process_state->statistics_ : NULL;
+  Stopwatch phase_time;
+
   const MDRawHeader *header = dump->header();
   if (!header) {
     BPLOG(ERROR) << "Minidump " << dump->path() << " has no header";
@@ -117,13 +392,29 @@ ProcessResult MinidumpProcessor::Process(
   // This will just return an empty string if it doesn't exist.
   process_state->assertion_ = GetAssertion(dump);
 
+  MinidumpHandlerTiming *handler_timing = dump->GetHandlerTiming();
+  if (handler_timing) {
+    for (unsigned int i = 0; i < handler_timing->timing_count(); ++i) {
+      process_state->handler_timings_.push_back(
+          *handler_timing->GetTimingAtIndex(i));
+    }
+  }
+
   MinidumpModuleList *module_list = dump->GetModuleList();
 
   // Put a copy of the module list into ProcessState object.  This is not
   // necessarily a MinidumpModuleList, but it adheres to the CodeModules
-  // interface, which is all that ProcessState needs to expose.
-  if (module_list)
-    process_state->modules_ = module_list->Copy();
+  // interface, which is all that ProcessState needs to expose.  A copy from
+  // code_modules_cache_ may be shared with other ProcessStates.
+  //
+  // The copy outlives the dump and describes every module, so making it
+  // reads every module's name and debugging records.  MinidumpModule's
+  // lazy reads therefore save nothing here; they help callers that use a
+  // MinidumpModuleList directly and look at only a few of its modules.
+  if (module_list) {
+    process_state->modules_ = code_modules_cache_ ?
+        code_modules_cache_->Copy(module_list) : module_list->Copy();
+  }
 
   MinidumpMemoryList *memory_list = dump->GetMemoryList();
   if (memory_list) {
@@ -148,123 +439,382 @@ ProcessResult MinidumpProcessor::Process(
       (has_requesting_thread   ? "" : "no ") << "requesting thread, and " <<
       (has_process_create_time ? "" : "no ") << "process create time";
 
+  if (statistics)
+    statistics->module_setup_seconds = phase_time.ElapsedSeconds();
+  phase_time.Restart();
+
   bool interrupted = false;
   bool found_requesting_thread = false;
   unsigned int thread_count = threads->thread_count();
 
   // Reset frame_symbolizer_ at the beginning of stackwalk for each minidump.
   frame_symbolizer_->Reset();
-
-  for (unsigned int thread_index = 0;
-       thread_index < thread_count;
-       ++thread_index) {
-    char thread_string_buffer[64];
-    snprintf(thread_string_buffer, sizeof(thread_string_buffer), "%d/%d",
-             thread_index, thread_count);
-    string thread_string = dump->path() + ":" + thread_string_buffer;
-
-    MinidumpThread *thread = threads->GetThreadAtIndex(thread_index);
-    if (!thread) {
-      BPLOG(ERROR) << "Could not get thread for " << thread_string;
-      return PROCESS_ERROR_GETTING_THREAD;
+  if (frame_symbolizer_->resolver()) {
+    frame_symbolizer_->resolver()->DeferSourceLines(
+        source_lines_for_requesting_thread_only_);
+  }
+  ScopedSymbolizerStatistics scoped_statistics(frame_symbolizer_, statistics);
+
+  // Shared by the walks of all of this minidump's threads.
+  scoped_ptr<WalkBudget> walk_budget(
+      walk_budget_limits_.IsUnlimited() ?
+          NULL : new WalkBudget(walk_budget_limits_));
+  ScopedSymbolizerWalkBudget scoped_walk_budget(frame_symbolizer_,
+                                                walk_budget.get());
+
+  // With more than one walker thread, each walk is set up here but deferred
+  // until all threads have been looked at, and the walkers share
+  // frame_symbolizer_ through a lock.  A thread sink takes each stack as
+  // soon as it is walked, so walks are not deferred when there is one.
+  bool defer_walks = walker_thread_count_ > 1 && !thread_sink_;
+
+  // Deferred walks and symbol prefetches run on task_executor_, or without
+  // one, on threads started for this minidump; this thread is the last of
+  // the walker threads.
+  unsigned int own_thread_count =
+      symbol_prefetch_thread_count_ + (defer_walks ? walker_thread_count_ - 1
+                                                   : 0);
+  scoped_ptr<WorkStealingExecutor> own_executor(
+      !task_executor_ && own_thread_count > 0 ?
+          new WorkStealingExecutor(own_thread_count) : NULL);
+  TaskExecutor* executor =
+      task_executor_ ? task_executor_ : own_executor.get();
+
+  // Start fetching symbols for the walks below, most wanted first.
+  ScopedSymbolPrefetch scoped_prefetch(frame_symbolizer_);
+  if (symbol_prefetch_thread_count_ > 0 && process_state->modules_) {
+    DumpContext* crash_context = NULL;
+    MemoryRegion* crash_stack = NULL;
+    MinidumpThread* crash_thread = has_requesting_thread ?
+        threads->GetThreadByID(requesting_thread_id) : NULL;
+    if (crash_thread) {
+      if (exception)
+        crash_context = exception->GetContext();
+      if (!crash_context)
+        crash_context = crash_thread->GetContext();
+      crash_stack = crash_thread->GetMemory();
     }
+    vector<const CodeModule*> prefetch_modules;
+    OrderModulesForPrefetch(process_state->modules_, crash_context,
+                            crash_stack, symbol_prefetch_module_limit_,
+                            &prefetch_modules);
+    frame_symbolizer_->PrefetchSymbols(prefetch_modules,
+                                       &process_state->system_info_,
+                                       symbol_prefetch_thread_count_,
+                                       executor);
+  }
 
-    uint32_t thread_id;
-    if (!thread->GetThreadID(&thread_id)) {
-      BPLOG(ERROR) << "Could not get thread ID for " << thread_string;
-      return PROCESS_ERROR_GETTING_THREAD_ID;
-    }
+  StackFrameSymbolizer* walk_symbolizer = frame_symbolizer_;
+#ifndef _WIN32
+  scoped_ptr<StackFrameSymbolizer> serialized_symbolizer;
+  if (defer_walks) {
+    serialized_symbolizer.reset(
+        new SerializedStackFrameSymbolizer(frame_symbolizer_));
+    walk_symbolizer = serialized_symbolizer.get();
+  }
+#endif  // _WIN32
+  vector<DeferredStackwalk> deferred_walks;
+
+  // The requesting thread's index in deferred_walks, if its walk was
+  // deferred.  When exploitability is rated, the walk is reserved for the
+  // calling thread, which rates the crash as soon as the stack is walked
+  // while the walker threads walk the others.  Otherwise it goes ahead of
+  // the others.
+  size_t requesting_walk = static_cast<size_t>(-1);
+
+  // Shared by the walks of all of this minidump's threads.
+  scoped_ptr<SymbolizedFrameMemo> frame_memo(
+      memoize_frames_ ? new SymbolizedFrameMemo() : NULL);
+
+  // With a requesting thread callback or a crash signature cache, a first
+  // pass walks just the requesting thread, right away, to hand it to the
+  // callback or to look its signature up.  The
+  // second pass walks the rest, putting the requesting thread's stack back
+  // in its place.
+  int first_pass = (requesting_thread_callback_ || crash_signature_cache_) &&
+                   has_requesting_thread ? 0 : 1;
+  scoped_ptr<CallStack> requesting_stack;
+  MemoryRegion* requesting_thread_memory = NULL;
+  double requesting_walk_seconds = 0;
+  bool filled_source_lines = false;
+
+  // With a thread sink, the stacks of all threads but the requesting one
+  // are walked into this arena, which is reset as each is handed over.
+  FrameArena thread_arena;
+
+  for (int pass = first_pass; pass < 2; ++pass) {
+    for (unsigned int thread_index = 0;
+           thread_index < thread_count;
+           ++thread_index) {
+      char thread_string_buffer[64];
+      snprintf(thread_string_buffer, sizeof(thread_string_buffer), "%d/%d",
+               thread_index, thread_count);
+      string thread_string = dump->path() + ":" + thread_string_buffer;
+
+      MinidumpThread *thread = threads->GetThreadAtIndex(thread_index);
+      if (!thread) {
+        BPLOG(ERROR) << "Could not get thread for " << thread_string;
+        return PROCESS_ERROR_GETTING_THREAD;
+      }
 
-    thread_string += " id " + HexString(thread_id);
-    BPLOG(INFO) << "Looking at thread " << thread_string;
+      uint32_t thread_id;
+      if (!thread->GetThreadID(&thread_id)) {
+        BPLOG(ERROR) << "Could not get thread ID for " << thread_string;
+        return PROCESS_ERROR_GETTING_THREAD_ID;
+      }
 
-    // If this thread is the thread that produced the minidump, don't process
-    // it.  Because of the problems associated with a thread producing a
-    // dump of itself (when both its context and its stack are in flux),
-    // processing that stack wouldn't provide much useful data.
-    if (has_dump_thread && thread_id == dump_thread_id) {
-      continue;
-    }
+      thread_string += " id " + HexString(thread_id);
+      BPLOG(INFO) << "Looking at thread " << thread_string;
+
+      // If this thread is the thread that produced the minidump, don't process
+      // it.  Because of the problems associated with a thread producing a
+      // dump of itself (when both its context and its stack are in flux),
+      // processing that stack wouldn't provide much useful data.
+      if (has_dump_thread && thread_id == dump_thread_id) {
+        continue;
+      }
 
-    MinidumpContext *context = thread->GetContext();
+      bool is_requesting_thread =
+          has_requesting_thread && thread_id == requesting_thread_id;
+      if (pass == 0 && !is_requesting_thread)
+        continue;
+
+      MinidumpContext *context = thread->GetContext();
+
+      if (is_requesting_thread) {
+        if (found_requesting_thread) {
+          // There can't be more than one requesting thread.
+          BPLOG(ERROR) << "Duplicate requesting thread: " << thread_string;
+          return PROCESS_ERROR_DUPLICATE_REQUESTING_THREADS;
+        }
+
+        // Use processed_state->threads_.size() instead of thread_index.
+        // thread_index points to the thread index in the minidump, which
+        // might be greater than the thread index in the threads vector if
+        // any of the minidump's threads are skipped and not placed into the
+        // processed threads vector.  The thread vector's current size will
+        // be the index of the current thread when it's pushed into the
+        // vector.
+        process_state->requesting_thread_ = process_state->threads_.size();
+
+        found_requesting_thread = true;
+
+        if (process_state->crashed_) {
+          // Use the exception record's context for the crashed thread, instead
+          // of the thread's own context.  For the crashed thread, the thread's
+          // own context is the state inside the exception handler.  Using it
+          // would not result in the expected stack trace from the time of the
+          // crash. If the exception context is invalid, however, we fall back
+          // on the thread context.
+          MinidumpContext *ctx = exception->GetContext();
+          context = ctx ? ctx : thread->GetContext();
+        }
+
+        if (requesting_stack.get()) {
+          // Walked in the first pass.
+          process_state->threads_.push_back(requesting_stack.release());
+          process_state->thread_memory_regions_.push_back(
+              requesting_thread_memory);
+          if (statistics) {
+            statistics->thread_stackwalk_seconds.push_back(
+                requesting_walk_seconds);
+          }
+          if (thread_sink_)
+            SendToThreadSink(process_state, true, NULL, NULL);
+          continue;
+        }
+      }
 
-    if (has_requesting_thread && thread_id == requesting_thread_id) {
-      if (found_requesting_thread) {
-        // There can't be more than one requesting thread.
-        BPLOG(ERROR) << "Duplicate requesting thread: " << thread_string;
-        return PROCESS_ERROR_DUPLICATE_REQUESTING_THREADS;
+      // If the memory region for the stack cannot be read using the RVA stored
+      // in the memory descriptor inside MINIDUMP_THREAD, try to locate and use
+      // a memory region (containing the stack) from the minidump memory list.
+      MinidumpMemoryRegion *thread_memory = thread->GetMemory();
+      if (!thread_memory && memory_list) {
+        uint64_t start_stack_memory_range =
+            thread->GetStartOfStackMemoryRange();
+        if (start_stack_memory_range) {
+          thread_memory = memory_list->GetMemoryRegionForAddress(
+             start_stack_memory_range);
+        }
+      }
+      if (!thread_memory) {
+        BPLOG(ERROR) << "No memory region for " << thread_string;
       }
 
-      // Use processed_state->threads_.size() instead of thread_index.
-      // thread_index points to the thread index in the minidump, which
-      // might be greater than the thread index in the threads vector if
-      // any of the minidump's threads are skipped and not placed into the
-      // processed threads vector.  The thread vector's current size will
-      // be the index of the current thread when it's pushed into the
-      // vector.
-      process_state->requesting_thread_ = process_state->threads_.size();
-
-      found_requesting_thread = true;
-
-      if (process_state->crashed_) {
-        // Use the exception record's context for the crashed thread, instead
-        // of the thread's own context.  For the crashed thread, the thread's
-        // own context is the state inside the exception handler.  Using it
-        // would not result in the expected stack trace from the time of the
-        // crash. If the exception context is invalid, however, we fall back
-        // on the thread context.
-        MinidumpContext *ctx = exception->GetContext();
-        context = ctx ? ctx : thread->GetContext();
+      // Use process_state->modules_ instead of module_list, because the
+      // |modules| argument will be used to populate the |module| fields in
+      // the returned StackFrame objects, which will be placed into the
+      // returned ProcessState object.  module_list's lifetime is only as
+      // long as the Minidump object: it will be deleted when this function
+      // returns.  process_state->modules_ is owned by the ProcessState object
+      // (just like the StackFrame objects), and is much more suitable for this
+      // task.
+      FrameArena* stack_arena = thread_sink_ && !is_requesting_thread ?
+                                &thread_arena : &process_state->frame_arena_;
+      scoped_ptr<Stackwalker> stackwalker(
+          Stackwalker::StackwalkerForCPU(process_state->system_info(),
+                                         context,
+                                         thread_memory,
+                                         process_state->modules_,
+                                         walk_symbolizer));
+      if (stackwalker.get()) {
+        stackwalker->set_symbolized_frame_memo(frame_memo.get());
+        stackwalker->set_frame_arena(stack_arena);
+        stackwalker->set_walk_budget(walk_budget.get());
+        stackwalker->set_unwind_policy(unwind_policy_);
+      }
+
+      // Read the stack memory now, so that walker threads never need to read
+      // from the minidump.  A thread whose stack memory can't be read is
+      // walked right away instead, because each access would retry the read.
+      scoped_ptr<CallStack> stack(process_state->NewCallStack(stack_arena));
+      double walk_seconds = 0;
+      if (stackwalker.get() && defer_walks && pass == 1 &&
+          (!thread_memory || thread_memory->GetMemory())) {
+        DeferredStackwalk walk;
+        walk.thread_string = thread_string;
+        walk.stackwalker.reset(stackwalker.release());
+        walk.stack = stack.get();
+        walk.thread_position = process_state->threads_.size();
+        if (is_requesting_thread)
+          requesting_walk = deferred_walks.size();
+        deferred_walks.push_back(walk);
+      } else if (stackwalker.get()) {
+        Stopwatch walk_time;
+        if (!stackwalker->Walk(stack.get(),
+                               &process_state->modules_without_symbols_,
+                               &process_state->modules_with_corrupt_symbols_)) {
+          BPLOG(INFO) << "Stackwalker interrupt (missing symbols?) at "
+                      << thread_string;
+          interrupted = true;
+        }
+        walk_seconds = walk_time.ElapsedSeconds();
+      } else {
+        // Threads with missing CPU contexts will hit this, but
+        // don't abort processing the rest of the dump just for
+        // one bad thread.
+        BPLOG(ERROR) << "No stackwalker for " << thread_string;
+      }
+      process_state->threads_.push_back(stack.release());
+      process_state->thread_memory_regions_.push_back(thread_memory);
+      if (statistics)
+        statistics->thread_stackwalk_seconds.push_back(walk_seconds);
+      if (thread_sink_ && pass == 1) {
+        SendToThreadSink(process_state, is_requesting_thread, &thread_arena,
+                         statistics);
       }
     }
 
-    // If the memory region for the stack cannot be read using the RVA stored
-    // in the memory descriptor inside MINIDUMP_THREAD, try to locate and use
-    // a memory region (containing the stack) from the minidump memory list.
-    MinidumpMemoryRegion *thread_memory = thread->GetMemory();
-    if (!thread_memory && memory_list) {
-      uint64_t start_stack_memory_range = thread->GetStartOfStackMemoryRange();
-      if (start_stack_memory_range) {
-        thread_memory = memory_list->GetMemoryRegionForAddress(
-           start_stack_memory_range);
+    if (pass == 1 || !found_requesting_thread)
+      continue;
+
+    // Hand the requesting thread's stack over before going on.
+    if (interrupted) {
+      BPLOG(INFO) << "Processing interrupted for " << dump->path();
+      return PROCESS_SYMBOL_SUPPLIER_INTERRUPTED;
+    }
+    if (crash_signature_cache_ &&
+        crash_signature_cache_->Record(
+            CrashSignatureCache::Signature(*process_state))) {
+      BPLOG(INFO) << "Minidump " << dump->path() << " is a duplicate crash";
+      return PROCESS_DUPLICATE_CRASH;
+    }
+    if (source_lines_for_requesting_thread_only_) {
+      if (!FillRequestingThreadSourceLines(process_state)) {
+        BPLOG(INFO) << "Processing interrupted for " << dump->path();
+        return PROCESS_SYMBOL_SUPPLIER_INTERRUPTED;
       }
+      filled_source_lines = true;
+    }
+    if (requesting_thread_callback_ &&
+        !requesting_thread_callback_->RequestingThreadWalked(*process_state)) {
+      BPLOG(INFO) << "Processed the requesting thread of " << dump->path();
+      return PROCESS_OK;
+    }
+    requesting_stack.reset(process_state->threads_.back());
+    process_state->threads_.pop_back();
+    requesting_thread_memory = process_state->thread_memory_regions_.back();
+    process_state->thread_memory_regions_.pop_back();
+    if (statistics) {
+      requesting_walk_seconds = statistics->thread_stackwalk_seconds.back();
+      statistics->thread_stackwalk_seconds.pop_back();
+    }
+    process_state->requesting_thread_ = -1;
+    found_requesting_thread = false;
+  }
+
+  // Exploitability defaults to EXPLOITABILITY_NOT_ANALYZED
+  process_state->exploitability_ = EXPLOITABILITY_NOT_ANALYZED;
+
+  bool checked_exploitability = false;
+  if (!deferred_walks.empty()) {
+    bool reserve_requesting_walk =
+        enable_exploitability_ && requesting_walk < deferred_walks.size();
+    vector<StackwalkTask> walk_tasks;
+    walk_tasks.reserve(deferred_walks.size());
+    for (size_t i = 0; i < deferred_walks.size(); ++i)
+      walk_tasks.push_back(StackwalkTask(&deferred_walks[i]));
+    TaskGroup walk_group(executor);
+    for (size_t i = 0; i < walk_tasks.size(); ++i) {
+      if (i == requesting_walk && reserve_requesting_walk)
+        continue;
+      walk_group.Submit(&walk_tasks[i],
+                        i == requesting_walk ? TaskExecutor::PRIORITY_CRITICAL
+                                             : TaskExecutor::PRIORITY_NORMAL,
+                        TaskExecutor::STAGE_STACKWALK);
     }
-    if (!thread_memory) {
-      BPLOG(ERROR) << "No memory region for " << thread_string;
+
+    // Exploitability rating only looks at the requesting thread's stack,
+    // and is the only other reader of the minidump, so it runs on this
+    // thread alongside the walks of the others.
+    bool requesting_stack_walked =
+        !interrupted && process_state->requesting_thread_ != -1;
+    if (reserve_requesting_walk) {
+      DeferredStackwalk* walk = &deferred_walks[requesting_walk];
+      RunStackwalk(walk);
+      if (walk->interrupted)
+        requesting_stack_walked = false;
+    }
+    if (enable_exploitability_ && requesting_stack_walked) {
+      CheckExploitability(dump, process_state, statistics);
+      checked_exploitability = true;
     }
 
-    // Use process_state->modules_ instead of module_list, because the
-    // |modules| argument will be used to populate the |module| fields in
-    // the returned StackFrame objects, which will be placed into the
-    // returned ProcessState object.  module_list's lifetime is only as
-    // long as the Minidump object: it will be deleted when this function
-    // returns.  process_state->modules_ is owned by the ProcessState object
-    // (just like the StackFrame objects), and is much more suitable for this
-    // task.
-    scoped_ptr<Stackwalker> stackwalker(
-        Stackwalker::StackwalkerForCPU(process_state->system_info(),
-                                       context,
-                                       thread_memory,
-                                       process_state->modules_,
-                                       frame_symbolizer_));
-
-    scoped_ptr<CallStack> stack(new CallStack());
-    if (stackwalker.get()) {
-      if (!stackwalker->Walk(stack.get(),
-                             &process_state->modules_without_symbols_,
-                             &process_state->modules_with_corrupt_symbols_)) {
+    // Help with the walks no walker thread has started.
+    walk_group.Wait();
+
+    // Merge the results in thread order, which produces the same module
+    // lists as walking the threads one after another.
+    for (vector<DeferredStackwalk>::const_iterator walk =
+             deferred_walks.begin();
+         walk != deferred_walks.end();
+         ++walk) {
+      MergeModuleList(walk->modules_without_symbols,
+                      &process_state->modules_without_symbols_);
+      MergeModuleList(walk->modules_with_corrupt_symbols,
+                      &process_state->modules_with_corrupt_symbols_);
+      if (walk->interrupted) {
         BPLOG(INFO) << "Stackwalker interrupt (missing symbols?) at "
-                    << thread_string;
+                    << walk->thread_string;
         interrupted = true;
       }
-    } else {
-      // Threads with missing CPU contexts will hit this, but
-      // don't abort processing the rest of the dump just for
-      // one bad thread.
-      BPLOG(ERROR) << "No stackwalker for " << thread_string;
+      if (statistics)
+        statistics->thread_stackwalk_seconds[walk->thread_position] =
+            walk->seconds;
     }
-    process_state->threads_.push_back(stack.release());
-    process_state->thread_memory_regions_.push_back(thread_memory);
+  }
+
+  // Now that the stacks are walked, look up the requesting thread's source
+  // lines, which the resolver was told to leave out.
+  if (source_lines_for_requesting_thread_only_ && !interrupted &&
+      !filled_source_lines &&
+      !FillRequestingThreadSourceLines(process_state)) {
+    interrupted = true;
+  }
+
+  if (statistics) {
+    statistics->stackwalk_seconds = phase_time.ElapsedSeconds();
+    CountFrames(process_state->threads_, statistics);
   }
 
   if (interrupted) {
@@ -281,37 +831,88 @@ ProcessResult MinidumpProcessor::Process(
     process_state->requesting_thread_ = -1;
   }
 
-  // Exploitability defaults to EXPLOITABILITY_NOT_ANALYZED
-  process_state->exploitability_ = EXPLOITABILITY_NOT_ANALYZED;
+  // If an exploitability run was requested and didn't run alongside the
+  // walks, we perform the platform specific rating now.
+  if (enable_exploitability_ && !checked_exploitability)
+    CheckExploitability(dump, process_state, statistics);
 
-  // If an exploitability run was requested we perform the platform specific
-  // rating.
-  if (enable_exploitability_) {
-    scoped_ptr<Exploitability> exploitability(
-        Exploitability::ExploitabilityForPlatform(dump, process_state));
-    // The engine will be null if the platform is not supported
-    if (exploitability != NULL) {
-      process_state->exploitability_ = exploitability->CheckExploitability();
-    } else {
-      process_state->exploitability_ = EXPLOITABILITY_ERR_NOENGINE;
+  BPLOG(INFO) << "Processed " << dump->path();
+  return PROCESS_OK;
+}
+
+bool MinidumpProcessor::FillRequestingThreadSourceLines(
+    ProcessState* process_state) {
+  if (process_state->requesting_thread_ == -1)
+    return true;
+  const vector<StackFrame*>* frames =
+      process_state->threads_[process_state->requesting_thread_]->frames();
+  for (vector<StackFrame*>::const_iterator frame = frames->begin();
+       frame != frames->end();
+       ++frame) {
+    if (frame_symbolizer_->FillDeferredSourceLines(
+            &process_state->system_info_, *frame) ==
+        StackFrameSymbolizer::kInterrupt) {
+      return false;
     }
   }
+  return true;
+}
+
+void MinidumpProcessor::CheckExploitability(Minidump* dump,
+                                            ProcessState* process_state,
+                                            ProcessStatistics* statistics) {
+  Stopwatch exploitability_time;
+  scoped_ptr<Exploitability> exploitability(
+      Exploitability::ExploitabilityForPlatform(dump, process_state));
+  // The engine will be null if the platform is not supported
+  if (exploitability != NULL) {
+    exploitability->set_analyze_instructions(analyze_instructions_);
+    exploitability->set_instruction_analysis_cache(
+        instruction_analysis_cache_);
+    process_state->exploitability_ = exploitability->CheckExploitability();
+  } else {
+    process_state->exploitability_ = EXPLOITABILITY_ERR_NOENGINE;
+  }
+  if (statistics)
+    statistics->exploitability_seconds = exploitability_time.ElapsedSeconds();
+}
 
-  BPLOG(INFO) << "Processed " << dump->path();
-  return PROCESS_OK;
+void MinidumpProcessor::SendToThreadSink(ProcessState* process_state,
+                                         bool keep,
+                                         FrameArena* thread_arena,
+                                         ProcessStatistics* statistics) {
+  int thread_index = process_state->threads_.size() - 1;
+  CallStack* stack = process_state->threads_[thread_index];
+  thread_sink_->ThreadWalked(*process_state, thread_index, *stack);
+  if (keep)
+    return;
+
+  if (statistics)
+    CountStackFrames(*stack, statistics);
+  process_state->threads_[thread_index] =
+      process_state->NewCallStack(&process_state->frame_arena_);
+  process_state->DeleteCallStack(stack);
+  thread_arena->Rewind();
 }
 
 ProcessResult MinidumpProcessor::Process(
     const string &minidump_file, ProcessState *process_state) {
   BPLOG(INFO) << "Processing minidump in file " << minidump_file;
 
-  Minidump dump(minidump_file);
+  // Map the file so that memory regions and CodeView records don't have to
+  // be copied out of it.
+  Stopwatch read_time;
+  Minidump dump(minidump_file, true);
   if (!dump.Read()) {
      BPLOG(ERROR) << "Minidump " << dump.path() << " could not be read";
      return PROCESS_ERROR_MINIDUMP_NOT_FOUND;
   }
+  double read_seconds = read_time.ElapsedSeconds();
 
-  return Process(&dump, process_state);
+  ProcessResult result = Process(&dump, process_state);
+  if (collect_statistics_)
+    process_state->statistics_.read_seconds = read_seconds;
+  return result;
 }
 
 // Returns the MDRawSystemInfo from a minidump, or NULL if system info is
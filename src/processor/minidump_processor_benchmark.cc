@@ -0,0 +1,596 @@
+// Copyright (c) 2016 Google Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+// notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above
+// copyright notice, this list of conditions and the following disclaimer
+// in the documentation and/or other materials provided with the
+// distribution.
+//     * Neither the name of Google Inc. nor the names of its
+// contributors may be used to endorse or promote products derived from
+// this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+// minidump_processor_benchmark.cc: Measures the throughput of
+// MinidumpProcessor over synthetic minidumps.
+//
+// The minidump is built in memory with the SynthMinidump classes: a Windows
+// x86 process with a configurable number of threads and modules, each
+// thread's stack holding a chain of frames of the requested depth.  Every
+// module is given generated symbols with FUNC and line records for each of
+// its functions, and STACK CFI records for the requested percentage of
+// them; the remaining frames are walked by their frame pointers.
+//
+// The symbols are loaded into a BasicSourceLineResolver, or serialized and
+// loaded into a FastSourceLineResolver.  The stacks are walked on the
+// calling thread, or on several walker threads, whose symbol lookups are
+// serialized unless the resolver can make them concurrently; comparing
+// the two resolvers with several walker threads shows what that costs.
+//
+// The benchmark reports how long each module's symbols take to load, how
+// long the first minidump takes with no symbols loaded, the minidumps and
+// frames per second processed once they are, and the peak resident set
+// size of the process.  Logging goes to stderr, results to stdout.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include "common/benchmark_helpers.h"
+#include "common/scoped_ptr.h"
+#include "common/using_std_string.h"
+#include "google_breakpad/common/minidump_format.h"
+#include "google_breakpad/processor/basic_source_line_resolver.h"
+#include "google_breakpad/processor/call_stack.h"
+#include "google_breakpad/processor/code_module.h"
+#include "google_breakpad/processor/code_modules.h"
+#include "google_breakpad/processor/fast_source_line_resolver.h"
+#include "google_breakpad/processor/minidump.h"
+#include "google_breakpad/processor/minidump_processor.h"
+#include "google_breakpad/processor/process_state.h"
+#include "google_breakpad/processor/process_statistics.h"
+#include "google_breakpad/processor/symbol_supplier.h"
+#include "processor/logging.h"
+#include "processor/module_serializer.h"
+#include "processor/synth_minidump.h"
+
+namespace {
+
+using google_breakpad::BasicSourceLineResolver;
+using google_breakpad::CallStack;
+using google_breakpad::CodeModule;
+using google_breakpad::CodeModules;
+using google_breakpad::FastSourceLineResolver;
+using google_breakpad::Minidump;
+using google_breakpad::MinidumpProcessor;
+using google_breakpad::ModuleSerializer;
+using google_breakpad::PROCESS_OK;
+using google_breakpad::ParseCount;
+using google_breakpad::PeakResidentSetKilobytes;
+using google_breakpad::ProcessResult;
+using google_breakpad::ProcessState;
+using google_breakpad::ProcessStatistics;
+using google_breakpad::scoped_ptr;
+using google_breakpad::SourceLineResolverInterface;
+using google_breakpad::SymbolSupplier;
+using google_breakpad::SystemInfo;
+using google_breakpad::SynthMinidump::Context;
+using google_breakpad::SynthMinidump::Dump;
+using google_breakpad::SynthMinidump::Memory;
+using google_breakpad::SynthMinidump::Module;
+using google_breakpad::SynthMinidump::Section;
+using google_breakpad::SynthMinidump::String;
+using google_breakpad::SynthMinidump::Thread;
+using std::map;
+
+typedef google_breakpad::SynthMinidump::SystemInfo SynthSystemInfo;
+using std::vector;
+
+// Where the synthetic modules and stacks live in the process.
+const uint32_t kModuleBase = 0x10000000;
+const uint32_t kModuleSpacing = 0x01000000;
+const uint32_t kStackBase = 0x00100000;
+const uint32_t kStackSpacing = 0x00100000;
+
+// Every function is kFunctionSize bytes long, and calls the function in
+// the frame above it from kCallOffset bytes in.  Each stack frame is
+// kFrameSize bytes: locals, then the saved %ebp and the return address.
+const uint32_t kFunctionSize = 0x100;
+const uint32_t kCallOffset = 0x20;
+const uint32_t kFrameSize = 32;
+const uint32_t kFrameLocalsSize = kFrameSize - 8;
+
+struct BenchmarkOptions {
+  BenchmarkOptions()
+      : thread_count(8),
+        stack_depth(32),
+        module_count(16),
+        functions_per_module(256),
+        cfi_percent(50),
+        iterations(200),
+        walker_thread_count(1),
+        fast_resolver(false) {}
+
+  unsigned long thread_count;
+  unsigned long stack_depth;
+  unsigned long module_count;
+  unsigned long functions_per_module;
+  unsigned long cfi_percent;
+  unsigned long iterations;
+  unsigned long walker_thread_count;
+  bool fast_resolver;
+};
+
+// The address of function |function| of module |module|.
+uint32_t FunctionAddress(unsigned long module, unsigned long function) {
+  return kModuleBase + module * kModuleSpacing + function * kFunctionSize;
+}
+
+// Whether function |function| of every module has STACK CFI records.
+// Spreads the functions that do evenly through the module.
+bool FunctionHasCFI(const BenchmarkOptions &options, unsigned long function) {
+  return (function * 37) % 100 < options.cfi_percent;
+}
+
+string ModuleName(unsigned long module) {
+  char name[32];
+  snprintf(name, sizeof(name), "module%lu", module);
+  return name;
+}
+
+// Generates the symbol file for module |module|.
+string ModuleSymbols(const BenchmarkOptions &options, unsigned long module) {
+  string name = ModuleName(module);
+  string symbols = "MODULE windows x86 " + name + " " + name + ".pdb\n" +
+                   "FILE 1 " + name + ".cc\n";
+  char line[256];
+  for (unsigned long function = 0; function < options.functions_per_module;
+       ++function) {
+    uint32_t rva = function * kFunctionSize;
+    snprintf(line, sizeof(line),
+             "FUNC %x %x 0 %s_function%lu\n"
+             "%x %x %lu 1\n"
+             "%x %x %lu 1\n",
+             rva, kFunctionSize, name.c_str(), function,
+             rva, kCallOffset, function * 10 + 1,
+             rva + kCallOffset, kFunctionSize - kCallOffset,
+             function * 10 + 2);
+    symbols += line;
+  }
+  for (unsigned long function = 0; function < options.functions_per_module;
+       ++function) {
+    if (!FunctionHasCFI(options, function))
+      continue;
+    // The function pushes %ebp, sets it to %esp, and keeps it there.
+    uint32_t rva = function * kFunctionSize;
+    snprintf(line, sizeof(line),
+             "STACK CFI INIT %x %x .cfa: $esp 4 + .ra: .cfa 4 - ^\n"
+             "STACK CFI %x .cfa: $esp 8 + $ebp: .cfa 8 - ^\n"
+             "STACK CFI %x .cfa: $ebp 8 +\n",
+             rva, kFunctionSize, rva + 1, rva + 3);
+    symbols += line;
+  }
+  return symbols;
+}
+
+// Serves the generated symbols, serialized for FastSourceLineResolver if
+// |options| asks for it, keyed by debug file name.
+class SyntheticSymbolSupplier : public SymbolSupplier {
+ public:
+  explicit SyntheticSymbolSupplier(const BenchmarkOptions &options) {
+    ModuleSerializer serializer;
+    for (unsigned long module = 0; module < options.module_count; ++module) {
+      string symbols = ModuleSymbols(options, module);
+      string debug_file = ModuleName(module) + ".pdb";
+      if (!options.fast_resolver) {
+        symbols_[debug_file] = symbols;
+        continue;
+      }
+      unsigned int size;
+      char *serialized = serializer.SerializeSymbolFileData(symbols, &size);
+      if (serialized) {
+        symbols_[debug_file].assign(serialized, size);
+        delete [] serialized;
+      }
+    }
+  }
+
+  virtual ~SyntheticSymbolSupplier() {
+    for (BufferMap::iterator it = buffers_.begin(); it != buffers_.end();
+         ++it) {
+      delete [] it->second;
+    }
+  }
+
+  // The generated symbols for |module|, or NULL if there are none.
+  const string *SymbolsFor(const CodeModule *module) const {
+    SymbolMap::const_iterator it = symbols_.find(module->debug_file());
+    return it == symbols_.end() ? NULL : &it->second;
+  }
+
+  virtual SymbolResult GetSymbolFile(const CodeModule *module,
+                                     const SystemInfo *system_info,
+                                     string *symbol_file) {
+    if (!SymbolsFor(module))
+      return NOT_FOUND;
+    *symbol_file = module->debug_file();
+    return FOUND;
+  }
+
+  virtual SymbolResult GetSymbolFile(const CodeModule *module,
+                                     const SystemInfo *system_info,
+                                     string *symbol_file,
+                                     string *symbol_data) {
+    const string *symbols = SymbolsFor(module);
+    if (!symbols)
+      return NOT_FOUND;
+    *symbol_file = module->debug_file();
+    if (symbol_data)
+      *symbol_data = *symbols;
+    return FOUND;
+  }
+
+  virtual SymbolResult GetCStringSymbolData(const CodeModule *module,
+                                            const SystemInfo *system_info,
+                                            string *symbol_file,
+                                            char **symbol_data,
+                                            size_t *symbol_data_size) {
+    const string *symbols = SymbolsFor(module);
+    if (!symbols)
+      return NOT_FOUND;
+    *symbol_file = module->debug_file();
+    *symbol_data_size = symbols->size() + 1;
+    *symbol_data = new char[*symbol_data_size];
+    memcpy(*symbol_data, symbols->c_str(), *symbol_data_size);
+    FreeSymbolData(module);
+    buffers_[module->code_file()] = *symbol_data;
+    return FOUND;
+  }
+
+  virtual void FreeSymbolData(const CodeModule *module) {
+    BufferMap::iterator it = buffers_.find(module->code_file());
+    if (it != buffers_.end()) {
+      delete [] it->second;
+      buffers_.erase(it);
+    }
+  }
+
+ private:
+  typedef map<string, string> SymbolMap;
+  typedef map<string, char*> BufferMap;
+
+  SymbolMap symbols_;
+  BufferMap buffers_;
+};
+
+// Builds the synthetic minidump described by |options| into |contents|.
+bool BuildMinidump(const BenchmarkOptions &options, string *contents) {
+  static const MDVSFixedFileInfo kVersionInfo = {
+    MD_VSFIXEDFILEINFO_SIGNATURE,         // signature
+    MD_VSFIXEDFILEINFO_VERSION,           // struct_version
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0
+  };
+
+  Dump dump(0);
+  // The dump refers to its sections until it is complete, so they are
+  // kept here and freed at the end.
+  vector<Section*> sections;
+
+  String csd_version(dump, SynthSystemInfo::windows_x86_csd_version);
+  SynthSystemInfo system_info(dump, SynthSystemInfo::windows_x86,
+                              csd_version);
+  dump.Add(&system_info);
+  dump.Add(&csd_version);
+
+  for (unsigned long module = 0; module < options.module_count; ++module) {
+    string name = ModuleName(module);
+    String *code_file = new String(dump, "c:\\benchmark\\" + name + ".dll");
+    Section *cv_record = new Section(dump);
+    cv_record->D32(MD_CVINFOPDB70_SIGNATURE)
+              .D32(module + 1).D16(0).D16(0).Append(8, 0)  // signature
+              .D32(1)                                      // age
+              .AppendCString(name + ".pdb");
+    Module *minidump_module =
+        new Module(dump, FunctionAddress(module, 0), kModuleSpacing,
+                   *code_file, 1262805309, 0, kVersionInfo, cv_record);
+    dump.Add(minidump_module);
+    dump.Add(code_file);
+    dump.Add(cv_record);
+    sections.push_back(minidump_module);
+    sections.push_back(code_file);
+    sections.push_back(cv_record);
+  }
+
+  unsigned long function_count =
+      options.module_count * options.functions_per_module;
+  for (unsigned long thread = 0; thread < options.thread_count; ++thread) {
+    // Frame |depth| of the thread runs in the function chosen here, so
+    // that the threads between them touch most of the functions.
+    vector<uint32_t> functions;
+    for (unsigned long depth = 0; depth < options.stack_depth; ++depth) {
+      unsigned long index = (thread * 7919 + depth * 104729) % function_count;
+      functions.push_back(
+          FunctionAddress(index / options.functions_per_module,
+                          index % options.functions_per_module));
+    }
+
+    uint32_t stack_base = kStackBase + thread * kStackSpacing;
+    Memory *stack = new Memory(dump, stack_base);
+    for (unsigned long depth = 0; depth < options.stack_depth; ++depth) {
+      uint32_t frame = stack_base + depth * kFrameSize;
+      bool outermost = depth + 1 == options.stack_depth;
+      stack->Append(kFrameLocalsSize, 0)
+            .D32(outermost ? 0 : frame + kFrameSize + kFrameLocalsSize)
+            .D32(outermost ? 0 : functions[depth + 1] + kCallOffset);
+    }
+    stack->Append(kFrameSize, 0);
+
+    MDRawContextX86 raw_context;
+    memset(&raw_context, 0, sizeof(raw_context));
+    raw_context.context_flags = MD_CONTEXT_X86_INTEGER | MD_CONTEXT_X86_CONTROL;
+    raw_context.eip = functions[0] + kCallOffset / 2;
+    raw_context.esp = stack_base;
+    raw_context.ebp = stack_base + kFrameLocalsSize;
+    Context *context = new Context(dump, raw_context);
+
+    Thread *minidump_thread =
+        new Thread(dump, thread + 1, *stack, *context);
+    dump.Add(stack);
+    dump.Add(context);
+    dump.Add(minidump_thread);
+    sections.push_back(stack);
+    sections.push_back(context);
+    sections.push_back(minidump_thread);
+  }
+
+  dump.Finish();
+  bool result = dump.GetContents(contents);
+  for (vector<Section*>::iterator it = sections.begin(); it != sections.end();
+       ++it) {
+    delete *it;
+  }
+  return result;
+}
+
+double SecondsSince(const struct timeval &start) {
+  struct timeval now;
+  gettimeofday(&now, NULL);
+  return (now.tv_sec - start.tv_sec) + (now.tv_usec - start.tv_usec) / 1e6;
+}
+
+// Returns a new resolver of the kind |options| asks for, which the caller
+// owns.
+SourceLineResolverInterface *NewResolver(const BenchmarkOptions &options) {
+  if (options.fast_resolver)
+    return new FastSourceLineResolver;
+  return new BasicSourceLineResolver;
+}
+
+// Processes the minidump in |contents| with |processor|, adding the number
+// of frames walked to |frames|.  Copies the processor's statistics to
+// |statistics| if it is not NULL.
+bool ProcessMinidump(MinidumpProcessor *processor, const string &contents,
+                     size_t *frames, ProcessStatistics *statistics) {
+  Minidump dump(reinterpret_cast<const uint8_t*>(contents.data()),
+                contents.size());
+  if (!dump.Read()) {
+    BPLOG(ERROR) << "Couldn't read the synthetic minidump";
+    return false;
+  }
+  ProcessState state;
+  ProcessResult result = processor->Process(&dump, &state);
+  if (result != PROCESS_OK) {
+    BPLOG(ERROR) << "Processing the synthetic minidump failed: " << result;
+    return false;
+  }
+  for (vector<CallStack*>::const_iterator it = state.threads()->begin();
+       it != state.threads()->end(); ++it) {
+    *frames += (*it)->frames()->size();
+  }
+  if (statistics)
+    *statistics = *state.statistics();
+  return true;
+}
+
+// Measures how long the symbols of every module in the minidump in
+// |contents| take to load into a fresh resolver of the kind |options| asks
+// for, in seconds per module.
+bool MeasureSymbolLoad(const BenchmarkOptions &options,
+                       SyntheticSymbolSupplier *supplier,
+                       const string &contents, double *seconds,
+                       size_t *symbol_bytes) {
+  Minidump dump(reinterpret_cast<const uint8_t*>(contents.data()),
+                contents.size());
+  if (!dump.Read() || !dump.GetModuleList())
+    return false;
+  const CodeModules *modules = dump.GetModuleList();
+
+  scoped_ptr<SourceLineResolverInterface> resolver(NewResolver(options));
+  double total = 0;
+  *symbol_bytes = 0;
+  for (unsigned int i = 0; i < modules->module_count(); ++i) {
+    const CodeModule *module = modules->GetModuleAtIndex(i);
+    const string *symbols = supplier->SymbolsFor(module);
+    if (!symbols)
+      return false;
+    struct timeval start;
+    gettimeofday(&start, NULL);
+    bool loaded = resolver->LoadModuleUsingMapBuffer(module, *symbols);
+    total += SecondsSince(start);
+    if (!loaded)
+      return false;
+    *symbol_bytes += symbols->size();
+  }
+  *seconds = modules->module_count() ? total / modules->module_count() : 0;
+  return true;
+}
+
+bool RunBenchmark(const BenchmarkOptions &options) {
+  string contents;
+  if (!BuildMinidump(options, &contents)) {
+    BPLOG(ERROR) << "Couldn't build the synthetic minidump";
+    return false;
+  }
+  printf("minidump: %lu threads of %lu frames, %lu modules of %lu "
+         "functions, %lu%% with CFI, %lu bytes\n",
+         options.thread_count, options.stack_depth, options.module_count,
+         options.functions_per_module, options.cfi_percent,
+         static_cast<unsigned long>(contents.size()));
+  printf("processor: %s, %lu walker threads\n",
+         options.fast_resolver ? "FastSourceLineResolver" :
+                                 "BasicSourceLineResolver",
+         options.walker_thread_count);
+
+  SyntheticSymbolSupplier supplier(options);
+  double load_seconds;
+  size_t symbol_bytes;
+  if (!MeasureSymbolLoad(options, &supplier, contents, &load_seconds,
+                         &symbol_bytes)) {
+    BPLOG(ERROR) << "Couldn't load the synthetic symbols";
+    return false;
+  }
+  printf("symbol load: %.3f ms per module, %.1f MB of symbols in total\n",
+         load_seconds * 1e3, symbol_bytes / 1048576.0);
+
+  scoped_ptr<SourceLineResolverInterface> resolver(NewResolver(options));
+  MinidumpProcessor processor(&supplier, resolver.get());
+  processor.set_walker_thread_count(options.walker_thread_count);
+
+  // The first minidump loads every module's symbols.
+  processor.set_collect_statistics(true);
+  struct timeval start;
+  gettimeofday(&start, NULL);
+  size_t frames = 0;
+  ProcessStatistics statistics;
+  if (!ProcessMinidump(&processor, contents, &frames, &statistics))
+    return false;
+  printf("first minidump: %.3f ms, %lu frames (%lu by CFI, %lu by frame "
+         "pointer, %lu by scanning); %.3f ms fetching and %.3f ms parsing "
+         "symbols\n",
+         SecondsSince(start) * 1e3, static_cast<unsigned long>(frames),
+         static_cast<unsigned long>(statistics.cfi_frame_count),
+         static_cast<unsigned long>(statistics.frame_pointer_frame_count),
+         static_cast<unsigned long>(statistics.scanned_frame_count),
+         statistics.symbol_fetch_seconds * 1e3,
+         statistics.symbol_parse_seconds * 1e3);
+  processor.set_collect_statistics(false);
+  size_t expected_frames = options.thread_count * options.stack_depth;
+  if (frames != expected_frames) {
+    fprintf(stderr, "Walked %lu frames instead of the %lu in the minidump\n",
+            static_cast<unsigned long>(frames),
+            static_cast<unsigned long>(expected_frames));
+    return false;
+  }
+
+  frames = 0;
+  gettimeofday(&start, NULL);
+  for (unsigned long i = 0; i < options.iterations; ++i) {
+    if (!ProcessMinidump(&processor, contents, &frames, NULL))
+      return false;
+  }
+  double seconds = SecondsSince(start);
+  printf("processed %lu minidumps in %.3f s: %.1f minidumps/s, "
+         "%.0f frames/s\n",
+         options.iterations, seconds,
+         seconds > 0 ? options.iterations / seconds : 0,
+         seconds > 0 ? frames / seconds : 0);
+  printf("peak RSS: %ld kB\n", PeakResidentSetKilobytes());
+  return true;
+}
+
+void usage(const char *program_name) {
+  BenchmarkOptions defaults;
+  fprintf(stderr, "usage: %s [-t threads] [-d depth] [-m modules] "
+          "[-f functions]\n"
+          "          [-c cfi-percent] [-n iterations] [-w walkers] [-F]\n"
+          "    -t : Threads in the minidump (default %lu)\n"
+          "    -d : Frames on each thread's stack (default %lu)\n"
+          "    -m : Modules in the minidump (default %lu)\n"
+          "    -f : Functions in each module (default %lu)\n"
+          "    -c : Percentage of functions with STACK CFI records "
+          "(default %lu)\n"
+          "    -n : Number of times the minidump is processed (default %lu)\n"
+          "    -w : Threads that walk the stacks (default %lu)\n"
+          "    -F : Use FastSourceLineResolver rather than "
+          "BasicSourceLineResolver\n",
+          program_name, defaults.thread_count, defaults.stack_depth,
+          defaults.module_count, defaults.functions_per_module,
+          defaults.cfi_percent, defaults.iterations,
+          defaults.walker_thread_count);
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+  BPLOG_INIT(&argc, &argv);
+
+  BenchmarkOptions options;
+  int ch;
+  while ((ch = getopt(argc, argv, "ht:d:m:f:c:n:w:F")) != -1) {
+    bool valid;
+    switch (ch) {
+      case 't':
+        valid = ParseCount('t', optarg, 1,
+                           (kModuleBase - kStackBase) / kStackSpacing,
+                           &options.thread_count);
+        break;
+      case 'd':
+        valid = ParseCount('d', optarg, 1, kStackSpacing / kFrameSize - 1,
+                           &options.stack_depth);
+        break;
+      case 'm':
+        valid = ParseCount('m', optarg, 1, 128, &options.module_count);
+        break;
+      case 'f':
+        valid = ParseCount('f', optarg, 1, kModuleSpacing / kFunctionSize,
+                           &options.functions_per_module);
+        break;
+      case 'c':
+        valid = ParseCount('c', optarg, 0, 100, &options.cfi_percent);
+        break;
+      case 'n':
+        valid = ParseCount('n', optarg, 1, 1000000, &options.iterations);
+        break;
+      case 'w':
+        valid = ParseCount('w', optarg, 1, 256, &options.walker_thread_count);
+        break;
+      case 'F':
+        options.fast_resolver = true;
+        valid = true;
+        break;
+      default:
+        usage(argv[0]);
+        return 1;
+    }
+    if (!valid)
+      return 1;
+  }
+  if (optind != argc) {
+    usage(argv[0]);
+    return 1;
+  }
+
+  return RunBenchmark(options) ? 0 : 1;
+}
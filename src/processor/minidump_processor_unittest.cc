@@ -40,16 +40,23 @@
 
 #include "breakpad_googletest_includes.h"
 #include "common/scoped_ptr.h"
+#include "common/tests/auto_tempdir.h"
 #include "common/using_std_string.h"
 #include "google_breakpad/processor/basic_source_line_resolver.h"
 #include "google_breakpad/processor/call_stack.h"
 #include "google_breakpad/processor/code_module.h"
 #include "google_breakpad/processor/code_modules.h"
+#include "google_breakpad/processor/code_modules_cache.h"
+#include "google_breakpad/processor/crash_signature_cache.h"
 #include "google_breakpad/processor/minidump.h"
 #include "google_breakpad/processor/minidump_processor.h"
+#include "google_breakpad/processor/missing_symbol_cache.h"
 #include "google_breakpad/processor/process_state.h"
+#include "google_breakpad/processor/process_statistics.h"
 #include "google_breakpad/processor/stack_frame.h"
+#include "google_breakpad/processor/stack_frame_symbolizer.h"
 #include "google_breakpad/processor/symbol_supplier.h"
+#include "google_breakpad/processor/walk_budget.h"
 #include "processor/logging.h"
 #include "processor/stackwalker_unittest_utils.h"
 
@@ -142,9 +149,14 @@ class TestMinidumpMiscInfo : public MinidumpMiscInfo {
 
 namespace {
 
+using google_breakpad::AutoTempDir;
 using google_breakpad::BasicSourceLineResolver;
 using google_breakpad::CallStack;
 using google_breakpad::CodeModule;
+using google_breakpad::CodeModules;
+using google_breakpad::CodeModulesCache;
+using google_breakpad::CrashSignatureCache;
+using google_breakpad::Minidump;
 using google_breakpad::MinidumpContext;
 using google_breakpad::MinidumpMemoryRegion;
 using google_breakpad::MinidumpMiscInfo;
@@ -152,15 +164,20 @@ using google_breakpad::MinidumpProcessor;
 using google_breakpad::MinidumpSystemInfo;
 using google_breakpad::MinidumpThreadList;
 using google_breakpad::MinidumpThread;
+using google_breakpad::MissingSymbolCache;
 using google_breakpad::MockMinidump;
 using google_breakpad::MockMinidumpMemoryList;
 using google_breakpad::MockMinidumpMemoryRegion;
 using google_breakpad::MockMinidumpThread;
 using google_breakpad::MockMinidumpThreadList;
 using google_breakpad::ProcessState;
+using google_breakpad::ProcessStatistics;
 using google_breakpad::scoped_ptr;
+using google_breakpad::StackFrame;
+using google_breakpad::StackFrameSymbolizer;
 using google_breakpad::SymbolSupplier;
 using google_breakpad::SystemInfo;
+using google_breakpad::WalkBudget;
 using ::testing::_;
 using ::testing::AnyNumber;
 using ::testing::DoAll;
@@ -394,6 +411,76 @@ TEST_F(MinidumpProcessorTest, TestSymbolSupplierLookupCounts) {
             google_breakpad::PROCESS_OK);
 }
 
+// This test case verifies that a MissingSymbolCache keeps the symbol
+// supplier from being asked again about missing symbols across minidumps.
+TEST_F(MinidumpProcessorTest, TestMissingSymbolCache) {
+  MockSymbolSupplier supplier;
+  BasicSourceLineResolver resolver;
+  StackFrameSymbolizer symbolizer(&supplier, &resolver);
+  MissingSymbolCache cache(3600);
+  symbolizer.set_missing_symbol_cache(&cache);
+  MinidumpProcessor processor(&symbolizer, false);
+
+  string minidump_file = string(getenv("srcdir") ? getenv("srcdir") : ".") +
+                         "/src/processor/testdata/minidump2.dmp";
+  ProcessState state;
+  EXPECT_CALL(supplier, GetCStringSymbolData(
+      Property(&google_breakpad::CodeModule::code_file,
+               "c:\\test_app.exe"),
+      _, _, _, _)).WillOnce(Return(SymbolSupplier::NOT_FOUND));
+  EXPECT_CALL(supplier, GetCStringSymbolData(
+      Property(&google_breakpad::CodeModule::code_file,
+               Ne("c:\\test_app.exe")),
+      _, _, _, _)).WillRepeatedly(Return(SymbolSupplier::NOT_FOUND));
+  EXPECT_CALL(supplier, FreeSymbolData(_)).Times(AnyNumber());
+  ASSERT_EQ(google_breakpad::PROCESS_OK,
+            processor.Process(minidump_file, &state));
+  ASSERT_TRUE(Mock::VerifyAndClearExpectations(&supplier));
+
+  const CodeModule* main_module = state.modules()->GetMainModule();
+  ASSERT_TRUE(main_module);
+  EXPECT_TRUE(cache.IsMissing(main_module));
+  size_t missing_count = cache.size();
+  EXPECT_EQ(state.modules_without_symbols()->size(), missing_count);
+
+  // The next minidump doesn't need to ask about any of them.
+  EXPECT_CALL(supplier, GetCStringSymbolData(_, _, _, _, _)).Times(0);
+  ProcessState second_state;
+  ASSERT_EQ(google_breakpad::PROCESS_OK,
+            processor.Process(minidump_file, &second_state));
+  ASSERT_TRUE(Mock::VerifyAndClearExpectations(&supplier));
+  EXPECT_EQ(state.modules_without_symbols()->size(),
+            second_state.modules_without_symbols()->size());
+
+  // The cache survives a round trip through a file, unless it has expired.
+  AutoTempDir temp_dir;
+  string cache_file = temp_dir.path() + "/missing_symbols";
+  ASSERT_TRUE(cache.Save(cache_file));
+  MissingSymbolCache loaded_cache(3600);
+  ASSERT_TRUE(loaded_cache.Load(cache_file));
+  EXPECT_EQ(missing_count, loaded_cache.size());
+  EXPECT_TRUE(loaded_cache.IsMissing(main_module));
+  MissingSymbolCache expired_cache(0);
+  ASSERT_TRUE(expired_cache.Load(cache_file));
+  EXPECT_EQ(0U, expired_cache.size());
+  EXPECT_FALSE(expired_cache.IsMissing(main_module));
+
+  // A forgotten module is looked up again.
+  loaded_cache.Forget(main_module);
+  EXPECT_FALSE(loaded_cache.IsMissing(main_module));
+  EXPECT_EQ(missing_count - 1, loaded_cache.size());
+
+  // Malformed files are rejected without changing the cache.
+  string bad_file = temp_dir.path() + "/bad_missing_symbols";
+  FILE* file = fopen(bad_file.c_str(), "w");
+  ASSERT_TRUE(file);
+  fprintf(file, "BREAKPAD_MISSING_SYMBOLS 1\nnot-a-time id file\n");
+  fclose(file);
+  EXPECT_FALSE(loaded_cache.Load(bad_file));
+  EXPECT_EQ(missing_count - 1, loaded_cache.size());
+  EXPECT_FALSE(loaded_cache.Load(temp_dir.path() + "/no_such_file"));
+}
+
 TEST_F(MinidumpProcessorTest, TestBasicProcessing) {
   TestSymbolSupplier supplier;
   BasicSourceLineResolver resolver;
@@ -478,6 +565,675 @@ TEST_F(MinidumpProcessorTest, TestBasicProcessing) {
             google_breakpad::PROCESS_SYMBOL_SUPPLIER_INTERRUPTED);
 }
 
+TEST_F(MinidumpProcessorTest, TestWalkerThreads) {
+  const char* kMinidumps[] = {
+    "minidump2.dmp",
+    "ascii_read_av.dmp",
+    "stack_exhaustion.dmp",
+  };
+  string testdata_dir = string(getenv("srcdir") ? getenv("srcdir") : ".") +
+                        "/src/processor/testdata/";
+
+  for (size_t i = 0; i < sizeof(kMinidumps) / sizeof(kMinidumps[0]); ++i) {
+    string minidump_file = testdata_dir + kMinidumps[i];
+
+    // TestSymbolSupplier only knows about minidump2.dmp.
+    TestSymbolSupplier serial_supplier;
+    BasicSourceLineResolver serial_resolver;
+    MinidumpProcessor serial_processor(i == 0 ? &serial_supplier : NULL,
+                                       &serial_resolver);
+    ProcessState serial_state;
+    ASSERT_EQ(google_breakpad::PROCESS_OK,
+              serial_processor.Process(minidump_file, &serial_state));
+
+    TestSymbolSupplier supplier;
+    BasicSourceLineResolver resolver;
+    MinidumpProcessor processor(i == 0 ? &supplier : NULL, &resolver);
+    processor.set_walker_thread_count(4);
+    EXPECT_EQ(4U, processor.walker_thread_count());
+    ProcessState state;
+    ASSERT_EQ(google_breakpad::PROCESS_OK,
+              processor.Process(minidump_file, &state));
+
+    // Walking on several threads must produce exactly the same stacks, in
+    // the same order, as walking them one after another.
+    ASSERT_EQ(serial_state.threads()->size(), state.threads()->size());
+    EXPECT_EQ(serial_state.requesting_thread(), state.requesting_thread());
+    for (size_t thread = 0; thread < state.threads()->size(); ++thread) {
+      const CallStack* serial_stack = serial_state.threads()->at(thread);
+      const CallStack* stack = state.threads()->at(thread);
+      ASSERT_EQ(serial_stack->frames()->size(), stack->frames()->size());
+      for (size_t frame = 0; frame < stack->frames()->size(); ++frame) {
+        const StackFrame* serial_frame = serial_stack->frames()->at(frame);
+        const StackFrame* stack_frame = stack->frames()->at(frame);
+        EXPECT_EQ(serial_frame->instruction, stack_frame->instruction);
+        EXPECT_EQ(serial_frame->trust, stack_frame->trust);
+        EXPECT_EQ(serial_frame->function_name, stack_frame->function_name);
+        EXPECT_EQ(serial_frame->source_line, stack_frame->source_line);
+      }
+    }
+    EXPECT_EQ(serial_state.modules_without_symbols()->size(),
+              state.modules_without_symbols()->size());
+  }
+}
+
+TEST_F(MinidumpProcessorTest, TestReuseMinidumpAndProcessState) {
+  const char* kMinidumps[] = {
+    "minidump2.dmp",
+    "ascii_read_av.dmp",
+    "stack_exhaustion.dmp",
+    "minidump2.dmp",
+  };
+  string testdata_dir = string(getenv("srcdir") ? getenv("srcdir") : ".") +
+                        "/src/processor/testdata/";
+
+  // One Minidump and one ProcessState, reset for every file, must give the
+  // same results as fresh ones.
+  BasicSourceLineResolver reused_resolver;
+  MinidumpProcessor reused_processor(NULL, &reused_resolver);
+  Minidump dump("", true);
+  ProcessState reused_state;
+  for (size_t i = 0; i < sizeof(kMinidumps) / sizeof(kMinidumps[0]); ++i) {
+    string minidump_file = testdata_dir + kMinidumps[i];
+
+    BasicSourceLineResolver resolver;
+    MinidumpProcessor processor(NULL, &resolver);
+    ProcessState state;
+    ASSERT_EQ(google_breakpad::PROCESS_OK,
+              processor.Process(minidump_file, &state));
+
+    dump.Reset(minidump_file);
+    ASSERT_TRUE(dump.Read());
+    ASSERT_EQ(google_breakpad::PROCESS_OK,
+              reused_processor.Process(&dump, &reused_state));
+
+    EXPECT_EQ(state.crash_reason(), reused_state.crash_reason());
+    EXPECT_EQ(state.requesting_thread(), reused_state.requesting_thread());
+    ASSERT_EQ(state.threads()->size(), reused_state.threads()->size());
+    ASSERT_EQ(state.thread_memory_regions()->size(),
+              reused_state.thread_memory_regions()->size());
+    for (size_t thread = 0; thread < state.threads()->size(); ++thread) {
+      const CallStack* stack = state.threads()->at(thread);
+      const CallStack* reused_stack = reused_state.threads()->at(thread);
+      ASSERT_EQ(stack->frames()->size(), reused_stack->frames()->size());
+      for (size_t frame = 0; frame < stack->frames()->size(); ++frame) {
+        EXPECT_EQ(stack->frames()->at(frame)->instruction,
+                  reused_stack->frames()->at(frame)->instruction);
+        EXPECT_EQ(stack->frames()->at(frame)->trust,
+                  reused_stack->frames()->at(frame)->trust);
+      }
+    }
+    ASSERT_EQ(state.modules()->module_count(),
+              reused_state.modules()->module_count());
+  }
+}
+
+TEST_F(MinidumpProcessorTest, TestSymbolPrefetch) {
+  string minidump_file = string(getenv("srcdir") ? getenv("srcdir") : ".") +
+                         "/src/processor/testdata/minidump2.dmp";
+
+  TestSymbolSupplier serial_supplier;
+  BasicSourceLineResolver serial_resolver;
+  MinidumpProcessor serial_processor(&serial_supplier, &serial_resolver);
+  ProcessState serial_state;
+  ASSERT_EQ(google_breakpad::PROCESS_OK,
+            serial_processor.Process(minidump_file, &serial_state));
+
+  // Prefetching everything, only the module the crash is in, and on top of
+  // walker threads must all give the same stacks as not prefetching.
+  const unsigned int kModuleLimits[] = { 0, 1, 0 };
+  const unsigned int kWalkerThreads[] = { 1, 1, 4 };
+  for (size_t i = 0; i < sizeof(kModuleLimits) / sizeof(kModuleLimits[0]);
+       ++i) {
+    TestSymbolSupplier supplier;
+    BasicSourceLineResolver resolver;
+    MinidumpProcessor processor(&supplier, &resolver);
+    processor.set_symbol_prefetch_thread_count(4);
+    processor.set_symbol_prefetch_module_limit(kModuleLimits[i]);
+    processor.set_walker_thread_count(kWalkerThreads[i]);
+    EXPECT_EQ(4U, processor.symbol_prefetch_thread_count());
+    EXPECT_EQ(kModuleLimits[i], processor.symbol_prefetch_module_limit());
+
+    // Processing twice checks that the first prefetch was stopped cleanly.
+    for (int pass = 0; pass < 2; ++pass) {
+      ProcessState state;
+      ASSERT_EQ(google_breakpad::PROCESS_OK,
+                processor.Process(minidump_file, &state));
+      ASSERT_EQ(serial_state.threads()->size(), state.threads()->size());
+      const CallStack* serial_stack = serial_state.threads()->at(0);
+      const CallStack* stack = state.threads()->at(0);
+      ASSERT_EQ(serial_stack->frames()->size(), stack->frames()->size());
+      for (size_t frame = 0; frame < stack->frames()->size(); ++frame) {
+        const StackFrame* serial_frame = serial_stack->frames()->at(frame);
+        const StackFrame* stack_frame = stack->frames()->at(frame);
+        EXPECT_EQ(serial_frame->instruction, stack_frame->instruction);
+        EXPECT_EQ(serial_frame->function_name, stack_frame->function_name);
+        EXPECT_EQ(serial_frame->source_file_name,
+                  stack_frame->source_file_name);
+        EXPECT_EQ(serial_frame->source_line, stack_frame->source_line);
+      }
+      EXPECT_EQ(serial_state.modules_without_symbols()->size(),
+                state.modules_without_symbols()->size());
+    }
+  }
+
+  // An interrupt reported to a prefetch thread interrupts processing.
+  TestSymbolSupplier supplier;
+  supplier.set_interrupt(true);
+  BasicSourceLineResolver resolver;
+  MinidumpProcessor processor(&supplier, &resolver);
+  processor.set_symbol_prefetch_thread_count(4);
+  ProcessState state;
+  ASSERT_EQ(google_breakpad::PROCESS_SYMBOL_SUPPLIER_INTERRUPTED,
+            processor.Process(minidump_file, &state));
+}
+
+TEST_F(MinidumpProcessorTest, TestExploitabilityWithWalkerThreads) {
+  // Rating exploitability alongside the walks of the other threads must
+  // give the same rating and stacks as rating it after all walks.
+  const char* kMinidumps[] = {
+    "minidump2.dmp", "null_read_av.dmp", "linux_null_read_av.dmp"
+  };
+  for (size_t i = 0; i < sizeof(kMinidumps) / sizeof(kMinidumps[0]); ++i) {
+    string minidump_file =
+        string(getenv("srcdir") ? getenv("srcdir") : ".") +
+        "/src/processor/testdata/" + kMinidumps[i];
+
+    BasicSourceLineResolver serial_resolver;
+    MinidumpProcessor serial_processor(NULL, &serial_resolver, true);
+    ProcessState serial_state;
+    ASSERT_EQ(google_breakpad::PROCESS_OK,
+              serial_processor.Process(minidump_file, &serial_state));
+    EXPECT_NE(google_breakpad::EXPLOITABILITY_NOT_ANALYZED,
+              serial_state.exploitability());
+
+    BasicSourceLineResolver resolver;
+    MinidumpProcessor processor(NULL, &resolver, true);
+    processor.set_walker_thread_count(4);
+    ProcessState state;
+    ASSERT_EQ(google_breakpad::PROCESS_OK,
+              processor.Process(minidump_file, &state));
+    EXPECT_EQ(serial_state.exploitability(), state.exploitability());
+    EXPECT_EQ(serial_state.requesting_thread(), state.requesting_thread());
+    ASSERT_EQ(serial_state.threads()->size(), state.threads()->size());
+    for (size_t thread = 0; thread < state.threads()->size(); ++thread) {
+      EXPECT_EQ(serial_state.threads()->at(thread)->frames()->size(),
+                state.threads()->at(thread)->frames()->size());
+    }
+  }
+}
+
+TEST_F(MinidumpProcessorTest, TestMemoizeFrames) {
+  const char* kMinidumps[] = {
+    "minidump2.dmp",
+    "ascii_read_av.dmp",
+    "stack_exhaustion.dmp",
+  };
+  string testdata_dir = string(getenv("srcdir") ? getenv("srcdir") : ".") +
+                        "/src/processor/testdata/";
+
+  for (size_t i = 0; i < sizeof(kMinidumps) / sizeof(kMinidumps[0]); ++i) {
+    string minidump_file = testdata_dir + kMinidumps[i];
+
+    TestSymbolSupplier plain_supplier;
+    BasicSourceLineResolver plain_resolver;
+    MinidumpProcessor plain_processor(i == 0 ? &plain_supplier : NULL,
+                                      &plain_resolver);
+    ProcessState plain_state;
+    ASSERT_EQ(google_breakpad::PROCESS_OK,
+              plain_processor.Process(minidump_file, &plain_state));
+
+    // Memoizing, alone and with walker threads, must not change the stacks.
+    for (unsigned int walker_threads = 1; walker_threads <= 4;
+         walker_threads += 3) {
+      TestSymbolSupplier supplier;
+      BasicSourceLineResolver resolver;
+      MinidumpProcessor processor(i == 0 ? &supplier : NULL, &resolver);
+      processor.set_memoize_frames(true);
+      EXPECT_TRUE(processor.memoize_frames());
+      processor.set_walker_thread_count(walker_threads);
+      ProcessState state;
+      ASSERT_EQ(google_breakpad::PROCESS_OK,
+                processor.Process(minidump_file, &state));
+
+      ASSERT_EQ(plain_state.threads()->size(), state.threads()->size());
+      for (size_t thread = 0; thread < state.threads()->size(); ++thread) {
+        const CallStack* plain_stack = plain_state.threads()->at(thread);
+        const CallStack* stack = state.threads()->at(thread);
+        ASSERT_EQ(plain_stack->frames()->size(), stack->frames()->size());
+        for (size_t frame = 0; frame < stack->frames()->size(); ++frame) {
+          const StackFrame* plain_frame = plain_stack->frames()->at(frame);
+          const StackFrame* stack_frame = stack->frames()->at(frame);
+          EXPECT_EQ(plain_frame->instruction, stack_frame->instruction);
+          ASSERT_EQ(plain_frame->module == NULL, stack_frame->module == NULL);
+          if (stack_frame->module) {
+            EXPECT_EQ(plain_frame->module->code_file(),
+                      stack_frame->module->code_file());
+          }
+          EXPECT_EQ(plain_frame->trust, stack_frame->trust);
+          EXPECT_EQ(plain_frame->function_name, stack_frame->function_name);
+          EXPECT_EQ(plain_frame->function_base, stack_frame->function_base);
+          EXPECT_EQ(plain_frame->source_file_name,
+                    stack_frame->source_file_name);
+          EXPECT_EQ(plain_frame->source_line, stack_frame->source_line);
+        }
+      }
+      EXPECT_EQ(plain_state.modules_without_symbols()->size(),
+                state.modules_without_symbols()->size());
+    }
+  }
+}
+
+TEST_F(MinidumpProcessorTest, TestSourceLinesForRequestingThreadOnly) {
+  string minidump_file = string(getenv("srcdir") ? getenv("srcdir") : ".") +
+                         "/src/processor/testdata/minidump2.dmp";
+
+  TestSymbolSupplier plain_supplier;
+  BasicSourceLineResolver plain_resolver;
+  MinidumpProcessor plain_processor(&plain_supplier, &plain_resolver);
+  plain_processor.set_collect_statistics(true);
+  ProcessState plain_state;
+  ASSERT_EQ(google_breakpad::PROCESS_OK,
+            plain_processor.Process(minidump_file, &plain_state));
+
+  // minidump2.dmp's only thread is the crashed one, so it must come out
+  // the same, alone and with walker threads and memoization.
+  for (unsigned int walker_threads = 1; walker_threads <= 4;
+       walker_threads += 3) {
+    TestSymbolSupplier supplier;
+    BasicSourceLineResolver resolver;
+    MinidumpProcessor processor(&supplier, &resolver);
+    processor.set_source_lines_for_requesting_thread_only(true);
+    EXPECT_TRUE(processor.source_lines_for_requesting_thread_only());
+    processor.set_collect_statistics(true);
+    processor.set_memoize_frames(walker_threads > 1);
+    processor.set_walker_thread_count(walker_threads);
+    ProcessState state;
+    ASSERT_EQ(google_breakpad::PROCESS_OK,
+              processor.Process(minidump_file, &state));
+
+    ASSERT_EQ(plain_state.threads()->size(), state.threads()->size());
+    const CallStack* plain_stack = plain_state.threads()->at(0);
+    const CallStack* stack = state.threads()->at(0);
+    ASSERT_EQ(plain_stack->frames()->size(), stack->frames()->size());
+    for (size_t frame = 0; frame < stack->frames()->size(); ++frame) {
+      const StackFrame* plain_frame = plain_stack->frames()->at(frame);
+      const StackFrame* stack_frame = stack->frames()->at(frame);
+      EXPECT_EQ(plain_frame->instruction, stack_frame->instruction);
+      EXPECT_EQ(plain_frame->trust, stack_frame->trust);
+      EXPECT_EQ(plain_frame->function_name, stack_frame->function_name);
+      EXPECT_EQ(plain_frame->source_file_name, stack_frame->source_file_name);
+      EXPECT_EQ(plain_frame->source_line, stack_frame->source_line);
+    }
+
+    // test_app.exe's symbols were read once to walk the stack, and again
+    // for its source lines.
+    EXPECT_EQ(plain_state.statistics()->symbol_fetch_count + 1,
+              state.statistics()->symbol_fetch_count);
+    EXPECT_FALSE(resolver.HasDeferredSourceLines(
+        state.modules()->GetMainModule()));
+  }
+}
+
+// Records what a MinidumpProcessor hands it ahead of the rest of the
+// minidump.
+class TestRequestingThreadCallback
+    : public MinidumpProcessor::RequestingThreadCallback {
+ public:
+  explicit TestRequestingThreadCallback(bool go_on)
+      : go_on_(go_on), calls_(0), thread_count_(0), requesting_thread_(-1) {}
+
+  virtual bool RequestingThreadWalked(const ProcessState& process_state) {
+    ++calls_;
+    thread_count_ = process_state.threads()->size();
+    requesting_thread_ = process_state.requesting_thread();
+    function_names_.clear();
+    if (requesting_thread_ >= 0) {
+      const CallStack* stack =
+          process_state.threads()->at(requesting_thread_);
+      for (size_t i = 0; i < stack->frames()->size(); ++i)
+        function_names_.push_back(stack->frames()->at(i)->function_name);
+    }
+    return go_on_;
+  }
+
+  bool go_on_;
+  int calls_;
+  size_t thread_count_;
+  int requesting_thread_;
+  std::vector<string> function_names_;
+};
+
+TEST_F(MinidumpProcessorTest, TestRequestingThreadCallback) {
+  const char* kMinidumps[] = {
+    "minidump2.dmp",
+    "ascii_read_av.dmp",
+  };
+  string testdata_dir = string(getenv("srcdir") ? getenv("srcdir") : ".") +
+                        "/src/processor/testdata/";
+
+  for (size_t i = 0; i < sizeof(kMinidumps) / sizeof(kMinidumps[0]); ++i) {
+    string minidump_file = testdata_dir + kMinidumps[i];
+
+    // TestSymbolSupplier only knows about minidump2.dmp.
+    TestSymbolSupplier plain_supplier;
+    BasicSourceLineResolver plain_resolver;
+    MinidumpProcessor plain_processor(i == 0 ? &plain_supplier : NULL,
+                                      &plain_resolver);
+    ProcessState plain_state;
+    ASSERT_EQ(google_breakpad::PROCESS_OK,
+              plain_processor.Process(minidump_file, &plain_state));
+    ASSERT_GE(plain_state.requesting_thread(), 0);
+    const CallStack* plain_requesting_stack =
+        plain_state.threads()->at(plain_state.requesting_thread());
+
+    for (unsigned int walker_threads = 1; walker_threads <= 4;
+         walker_threads += 3) {
+      // Going on gives the same stacks as processing without a callback.
+      TestSymbolSupplier supplier;
+      BasicSourceLineResolver resolver;
+      MinidumpProcessor processor(i == 0 ? &supplier : NULL, &resolver);
+      processor.set_walker_thread_count(walker_threads);
+      TestRequestingThreadCallback go_on(true);
+      processor.set_requesting_thread_callback(&go_on);
+      ProcessState state;
+      ASSERT_EQ(google_breakpad::PROCESS_OK,
+                processor.Process(minidump_file, &state));
+
+      EXPECT_EQ(1, go_on.calls_);
+      EXPECT_EQ(1U, go_on.thread_count_);
+      EXPECT_EQ(0, go_on.requesting_thread_);
+      ASSERT_EQ(plain_requesting_stack->frames()->size(),
+                go_on.function_names_.size());
+      for (size_t frame = 0; frame < go_on.function_names_.size(); ++frame) {
+        EXPECT_EQ(plain_requesting_stack->frames()->at(frame)->function_name,
+                  go_on.function_names_[frame]);
+      }
+
+      EXPECT_EQ(plain_state.requesting_thread(), state.requesting_thread());
+      ASSERT_EQ(plain_state.threads()->size(), state.threads()->size());
+      for (size_t thread = 0; thread < state.threads()->size(); ++thread) {
+        const CallStack* plain_stack = plain_state.threads()->at(thread);
+        const CallStack* stack = state.threads()->at(thread);
+        ASSERT_EQ(plain_stack->frames()->size(), stack->frames()->size());
+        for (size_t frame = 0; frame < stack->frames()->size(); ++frame) {
+          const StackFrame* plain_frame = plain_stack->frames()->at(frame);
+          const StackFrame* stack_frame = stack->frames()->at(frame);
+          EXPECT_EQ(plain_frame->instruction, stack_frame->instruction);
+          EXPECT_EQ(plain_frame->trust, stack_frame->trust);
+          EXPECT_EQ(plain_frame->function_name, stack_frame->function_name);
+          EXPECT_EQ(plain_frame->source_line, stack_frame->source_line);
+        }
+      }
+      EXPECT_EQ(plain_state.thread_memory_regions()->size(),
+                state.thread_memory_regions()->size());
+    }
+
+    // Stopping leaves just the requesting thread.
+    TestSymbolSupplier supplier;
+    BasicSourceLineResolver resolver;
+    MinidumpProcessor processor(i == 0 ? &supplier : NULL, &resolver);
+    TestRequestingThreadCallback stop(false);
+    processor.set_requesting_thread_callback(&stop);
+    ProcessState state;
+    ASSERT_EQ(google_breakpad::PROCESS_OK,
+              processor.Process(minidump_file, &state));
+    EXPECT_EQ(1, stop.calls_);
+    ASSERT_EQ(1U, state.threads()->size());
+    EXPECT_EQ(0, state.requesting_thread());
+    EXPECT_EQ(plain_requesting_stack->frames()->size(),
+              state.threads()->at(0)->frames()->size());
+    EXPECT_EQ(plain_state.crash_reason(), state.crash_reason());
+  }
+}
+
+TEST_F(MinidumpProcessorTest, TestCodeModulesCache) {
+  string testdata_dir = string(getenv("srcdir") ? getenv("srcdir") : ".") +
+                        "/src/processor/testdata/";
+  string minidump_file = testdata_dir + "minidump2.dmp";
+  string other_minidump_file = testdata_dir + "ascii_read_av.dmp";
+
+  TestSymbolSupplier supplier;
+  BasicSourceLineResolver resolver;
+  MinidumpProcessor plain_processor(&supplier, &resolver);
+  ProcessState plain_state;
+  ASSERT_EQ(google_breakpad::PROCESS_OK,
+            plain_processor.Process(minidump_file, &plain_state));
+
+  CodeModulesCache cache(1);
+  MinidumpProcessor processor(&supplier, &resolver);
+  processor.set_code_modules_cache(&cache);
+  scoped_ptr<ProcessState> state(new ProcessState);
+  ASSERT_EQ(google_breakpad::PROCESS_OK,
+            processor.Process(minidump_file, state.get()));
+  EXPECT_EQ(0U, cache.hits());
+  EXPECT_EQ(1U, cache.misses());
+  EXPECT_EQ(1U, cache.size());
+
+  // The shared list reads the same as a copy of its own.
+  const CodeModules* modules = state->modules();
+  const CodeModules* plain_modules = plain_state.modules();
+  ASSERT_EQ(plain_modules->module_count(), modules->module_count());
+  EXPECT_EQ(plain_modules->GetMainModule()->code_file(),
+            modules->GetMainModule()->code_file());
+  for (unsigned int i = 0; i < modules->module_count(); ++i) {
+    const CodeModule* module = modules->GetModuleAtSequence(i);
+    EXPECT_EQ(plain_modules->GetModuleAtSequence(i)->debug_identifier(),
+              module->debug_identifier());
+    EXPECT_EQ(module, modules->GetModuleForAddress(module->base_address()));
+  }
+
+  // A second dump with the same modules shares the list.
+  ProcessState duplicate_state;
+  ASSERT_EQ(google_breakpad::PROCESS_OK,
+            processor.Process(minidump_file, &duplicate_state));
+  EXPECT_EQ(1U, cache.hits());
+  EXPECT_EQ(modules->GetMainModule(),
+            duplicate_state.modules()->GetMainModule());
+
+  // Copies share it too, and it outlives the states and the cache that
+  // held it.
+  scoped_ptr<const CodeModules> copy(modules->Copy());
+  state.reset();
+  cache.Clear();
+  EXPECT_EQ(0U, cache.size());
+  EXPECT_EQ(duplicate_state.modules()->GetMainModule(),
+            copy->GetMainModule());
+  duplicate_state.Clear();
+  EXPECT_EQ(plain_modules->module_count(), copy->module_count());
+
+  // A different module list is not shared.
+  ASSERT_EQ(google_breakpad::PROCESS_OK,
+            processor.Process(minidump_file, &duplicate_state));
+  MinidumpProcessor other_processor(NULL, &resolver);
+  other_processor.set_code_modules_cache(&cache);
+  ProcessState other_state;
+  ASSERT_EQ(google_breakpad::PROCESS_OK,
+            other_processor.Process(other_minidump_file, &other_state));
+  EXPECT_EQ(3U, cache.misses());
+  EXPECT_NE(duplicate_state.modules()->GetMainModule(),
+            other_state.modules()->GetMainModule());
+  EXPECT_EQ(1U, cache.size());
+}
+
+TEST_F(MinidumpProcessorTest, TestCrashSignatureCache) {
+  string testdata_dir = string(getenv("srcdir") ? getenv("srcdir") : ".") +
+                        "/src/processor/testdata/";
+  string minidump_file = testdata_dir + "minidump2.dmp";
+  string other_minidump_file = testdata_dir + "ascii_read_av.dmp";
+
+  CrashSignatureCache cache(1);
+
+  // The first copy of a crash is processed in full.
+  TestSymbolSupplier supplier;
+  BasicSourceLineResolver resolver;
+  MinidumpProcessor processor(&supplier, &resolver);
+  processor.set_crash_signature_cache(&cache);
+  ProcessState state;
+  ASSERT_EQ(google_breakpad::PROCESS_OK,
+            processor.Process(minidump_file, &state));
+  ASSERT_EQ(1U, state.threads()->size());
+  EXPECT_EQ(0U, cache.hits());
+  EXPECT_EQ(1U, cache.misses());
+  EXPECT_EQ(1U, cache.size());
+  uint64_t signature = CrashSignatureCache::Signature(state);
+  EXPECT_NE(0U, signature);
+
+  // Another processor sharing the cache recognizes the second copy.
+  TestSymbolSupplier duplicate_supplier;
+  BasicSourceLineResolver duplicate_resolver;
+  MinidumpProcessor duplicate_processor(&duplicate_supplier,
+                                        &duplicate_resolver);
+  duplicate_processor.set_crash_signature_cache(&cache);
+  TestRequestingThreadCallback callback(true);
+  duplicate_processor.set_requesting_thread_callback(&callback);
+  ProcessState duplicate_state;
+  ASSERT_EQ(google_breakpad::PROCESS_DUPLICATE_CRASH,
+            duplicate_processor.Process(minidump_file, &duplicate_state));
+  EXPECT_EQ(0, callback.calls_);
+  ASSERT_EQ(1U, duplicate_state.threads()->size());
+  EXPECT_EQ(0, duplicate_state.requesting_thread());
+  EXPECT_EQ(state.crash_reason(), duplicate_state.crash_reason());
+  EXPECT_EQ(signature, CrashSignatureCache::Signature(duplicate_state));
+  EXPECT_EQ(1U, cache.hits());
+  EXPECT_EQ(1U, cache.misses());
+
+  // A different crash pushes the first one out of the one-entry cache.
+  MinidumpProcessor other_processor(NULL, &resolver);
+  other_processor.set_crash_signature_cache(&cache);
+  ProcessState other_state;
+  ASSERT_EQ(google_breakpad::PROCESS_OK,
+            other_processor.Process(other_minidump_file, &other_state));
+  EXPECT_NE(signature, CrashSignatureCache::Signature(other_state));
+  EXPECT_EQ(1U, cache.size());
+  EXPECT_EQ(2U, cache.misses());
+
+  ASSERT_EQ(google_breakpad::PROCESS_OK,
+            processor.Process(minidump_file, &state));
+  EXPECT_EQ(3U, cache.misses());
+
+  cache.Clear();
+  EXPECT_EQ(0U, cache.size());
+  EXPECT_FALSE(cache.Record(0));
+  EXPECT_FALSE(cache.Record(0));
+  EXPECT_EQ(0U, cache.size());
+}
+
+TEST_F(MinidumpProcessorTest, TestWalkBudget) {
+  string testdata_dir = string(getenv("srcdir") ? getenv("srcdir") : ".") +
+                        "/src/processor/testdata/";
+  string minidump_file = testdata_dir + "minidump2.dmp";
+
+  TestSymbolSupplier plain_supplier;
+  BasicSourceLineResolver plain_resolver;
+  MinidumpProcessor plain_processor(&plain_supplier, &plain_resolver);
+  ProcessState plain_state;
+  ASSERT_EQ(google_breakpad::PROCESS_OK,
+            plain_processor.Process(minidump_file, &plain_state));
+  ASSERT_EQ(1U, plain_state.threads()->size());
+  const CallStack* plain_stack = plain_state.threads()->at(0);
+  ASSERT_GT(plain_stack->frames()->size(), 3U);
+  EXPECT_FALSE(plain_stack->truncated());
+
+  WalkBudget::Limits limits[4];
+  // Ample limits change nothing.
+  limits[0].seconds = 600;
+  limits[0].frames = 1000;
+  limits[0].scanned_words = 1000000;
+  limits[0].symbol_bytes = 1 << 30;
+  // Each of these runs out partway through the walk.
+  limits[1].frames = 3;
+  limits[2].symbol_bytes = 1;
+  limits[3].seconds = 1e-9;
+  const size_t kExpectedFrames[] = {
+    plain_stack->frames()->size(), 3, 1, 1
+  };
+
+  for (size_t i = 0; i < sizeof(limits) / sizeof(limits[0]); ++i) {
+    TestSymbolSupplier supplier;
+    BasicSourceLineResolver resolver;
+    MinidumpProcessor processor(&supplier, &resolver);
+    processor.set_walk_budget_limits(limits[i]);
+    ProcessState state;
+    ASSERT_EQ(google_breakpad::PROCESS_OK,
+              processor.Process(minidump_file, &state));
+    ASSERT_EQ(1U, state.threads()->size());
+    const CallStack* stack = state.threads()->at(0);
+    ASSERT_EQ(kExpectedFrames[i], stack->frames()->size());
+    EXPECT_EQ(i != 0, stack->truncated());
+    // The frames that were walked are as without a budget.
+    for (size_t frame = 0; frame < stack->frames()->size(); ++frame) {
+      EXPECT_EQ(plain_stack->frames()->at(frame)->instruction,
+                stack->frames()->at(frame)->instruction);
+      EXPECT_EQ(plain_stack->frames()->at(frame)->function_name,
+                stack->frames()->at(frame)->function_name);
+    }
+  }
+}
+
+TEST_F(MinidumpProcessorTest, TestStatistics) {
+  string minidump_file = string(getenv("srcdir") ? getenv("srcdir") : ".") +
+                         "/src/processor/testdata/minidump2.dmp";
+
+  // Nothing is collected unless asked for.
+  TestSymbolSupplier quiet_supplier;
+  BasicSourceLineResolver quiet_resolver;
+  MinidumpProcessor quiet_processor(&quiet_supplier, &quiet_resolver);
+  EXPECT_FALSE(quiet_processor.collect_statistics());
+  ProcessState quiet_state;
+  ASSERT_EQ(google_breakpad::PROCESS_OK,
+            quiet_processor.Process(minidump_file, &quiet_state));
+  const ProcessStatistics* quiet = quiet_state.statistics();
+  EXPECT_EQ(0, quiet->symbol_fetch_count);
+  EXPECT_EQ(0U, quiet->context_frame_count);
+  EXPECT_TRUE(quiet->thread_stackwalk_seconds.empty());
+
+  // The same numbers come out with and without walker threads, apart from
+  // the times.
+  const unsigned int kWalkerThreads[] = { 1, 4 };
+  for (size_t i = 0; i < sizeof(kWalkerThreads) / sizeof(kWalkerThreads[0]);
+       ++i) {
+    TestSymbolSupplier supplier;
+    BasicSourceLineResolver resolver;
+    MinidumpProcessor processor(&supplier, &resolver, true);
+    processor.set_collect_statistics(true);
+    processor.set_walker_thread_count(kWalkerThreads[i]);
+    EXPECT_TRUE(processor.collect_statistics());
+    ProcessState state;
+    ASSERT_EQ(google_breakpad::PROCESS_OK,
+              processor.Process(minidump_file, &state));
+
+    const ProcessStatistics* statistics = state.statistics();
+    EXPECT_GE(statistics->read_seconds, 0);
+    EXPECT_GE(statistics->module_setup_seconds, 0);
+    EXPECT_GE(statistics->exploitability_seconds, 0);
+    EXPECT_LE(statistics->symbol_fetch_seconds +
+                  statistics->symbol_parse_seconds,
+              statistics->stackwalk_seconds);
+    ASSERT_EQ(1U, statistics->thread_stackwalk_seconds.size());
+    EXPECT_LE(statistics->thread_stackwalk_seconds[0],
+              statistics->stackwalk_seconds);
+
+    // test_app.exe has symbols and kernel32.dll doesn't; each is asked for
+    // once.
+    EXPECT_EQ(2, statistics->symbol_fetch_count);
+    EXPECT_EQ(1, statistics->symbol_parse_count);
+
+    // All four frames are accounted for.
+    EXPECT_EQ(1U, statistics->context_frame_count);
+    EXPECT_EQ(4U, statistics->context_frame_count +
+                  statistics->cfi_frame_count +
+                  statistics->frame_pointer_frame_count +
+                  statistics->scanned_frame_count +
+                  statistics->other_frame_count);
+
+    // Clearing the state clears its statistics.
+    state.Clear();
+    EXPECT_EQ(0, state.statistics()->symbol_fetch_count);
+    EXPECT_TRUE(state.statistics()->thread_stackwalk_seconds.empty());
+  }
+}
+
 TEST_F(MinidumpProcessorTest, TestThreadMissingMemory) {
   MockMinidump dump;
   EXPECT_CALL(dump, path()).WillRepeatedly(Return("mock minidump"));
@@ -544,6 +1300,116 @@ TEST_F(MinidumpProcessorTest, TestThreadMissingMemory) {
   ASSERT_EQ(kExpectedEIP, state.threads()->at(0)->frames()->at(0)->instruction);
 }
 
+class TestThreadSink : public MinidumpProcessor::ThreadSink {
+ public:
+  virtual void ThreadWalked(const ProcessState& process_state,
+                            int thread_index,
+                            const CallStack& stack) {
+    thread_indexes_.push_back(thread_index);
+    thread_counts_.push_back(process_state.threads()->size());
+    instructions_.push_back(stack.frames()->empty() ?
+                            0 : stack.frames()->at(0)->instruction);
+  }
+
+  std::vector<int> thread_indexes_;
+  std::vector<size_t> thread_counts_;
+  std::vector<uint64_t> instructions_;
+};
+
+TEST_F(MinidumpProcessorTest, TestThreadSink) {
+  MockMinidump dump;
+  EXPECT_CALL(dump, path()).WillRepeatedly(Return("mock minidump"));
+  EXPECT_CALL(dump, Read()).WillRepeatedly(Return(true));
+
+  MDRawHeader fake_header;
+  fake_header.time_date_stamp = 0;
+  EXPECT_CALL(dump, header()).WillRepeatedly(Return(&fake_header));
+
+  MDRawSystemInfo raw_system_info;
+  memset(&raw_system_info, 0, sizeof(raw_system_info));
+  raw_system_info.processor_architecture = MD_CPU_ARCHITECTURE_X86;
+  raw_system_info.platform_id = MD_OS_WIN32_NT;
+  TestMinidumpSystemInfo dump_system_info(raw_system_info);
+  EXPECT_CALL(dump, GetSystemInfo()).
+      WillRepeatedly(Return(&dump_system_info));
+
+  MockMinidumpThreadList thread_list;
+  EXPECT_CALL(dump, GetThreadList()).
+      WillOnce(Return(&thread_list));
+  MockMinidumpMemoryList memory_list;
+  EXPECT_CALL(dump, GetMemoryList()).
+      WillOnce(Return(&memory_list));
+
+  // Three threads without stack memory, each with a single frame.
+  const int kThreadCount = 3;
+  const uint32_t kBaseEIP = 0xabcd1230;
+  MockMinidumpThread threads[kThreadCount];
+  MDRawContextX86 raw_contexts[kThreadCount];
+  scoped_ptr<TestMinidumpContext> contexts[kThreadCount];
+  for (int i = 0; i < kThreadCount; ++i) {
+    EXPECT_CALL(threads[i], GetThreadID(_)).
+      WillRepeatedly(DoAll(SetArgumentPointee<0>(i + 1),
+                           Return(true)));
+    EXPECT_CALL(threads[i], GetMemory()).
+      WillRepeatedly(Return(reinterpret_cast<MinidumpMemoryRegion*>(NULL)));
+    EXPECT_CALL(threads[i], GetStartOfStackMemoryRange()).
+      WillRepeatedly(Return(0));
+
+    memset(&raw_contexts[i], 0, sizeof(raw_contexts[i]));
+    raw_contexts[i].context_flags = MD_CONTEXT_X86_FULL;
+    raw_contexts[i].eip = kBaseEIP + i;
+    contexts[i].reset(new TestMinidumpContext(raw_contexts[i]));
+    EXPECT_CALL(threads[i], GetContext()).
+      WillRepeatedly(Return(contexts[i].get()));
+    EXPECT_CALL(thread_list, GetThreadAtIndex(i)).
+      WillRepeatedly(Return(&threads[i]));
+  }
+  EXPECT_CALL(thread_list, thread_count()).
+    WillRepeatedly(Return(kThreadCount));
+
+  MinidumpProcessor processor(reinterpret_cast<SymbolSupplier*>(NULL), NULL);
+  processor.set_collect_statistics(true);
+  processor.set_walker_thread_count(4);
+  TestThreadSink sink;
+  processor.set_thread_sink(&sink);
+  ProcessState state;
+  ASSERT_EQ(google_breakpad::PROCESS_OK, processor.Process(&dump, &state));
+
+  // Each thread went to the sink, in order, as soon as it was walked.
+  ASSERT_EQ(static_cast<size_t>(kThreadCount), sink.instructions_.size());
+  for (int i = 0; i < kThreadCount; ++i) {
+    EXPECT_EQ(i, sink.thread_indexes_[i]);
+    EXPECT_EQ(static_cast<size_t>(i + 1), sink.thread_counts_[i]);
+    EXPECT_EQ(kBaseEIP + i, sink.instructions_[i]);
+  }
+
+  // Their stacks were freed afterwards, but still counted.
+  ASSERT_EQ(static_cast<size_t>(kThreadCount), state.threads()->size());
+  for (int i = 0; i < kThreadCount; ++i)
+    EXPECT_TRUE(state.threads()->at(i)->frames()->empty());
+  EXPECT_EQ(static_cast<uint64_t>(kThreadCount),
+            state.statistics()->context_frame_count);
+}
+
+TEST_F(MinidumpProcessorTest, TestThreadSinkKeepsRequestingThread) {
+  TestSymbolSupplier supplier;
+  BasicSourceLineResolver resolver;
+  MinidumpProcessor processor(&supplier, &resolver);
+  TestThreadSink sink;
+  processor.set_thread_sink(&sink);
+
+  string minidump_file = string(getenv("srcdir") ? getenv("srcdir") : ".") +
+                         "/src/processor/testdata/minidump2.dmp";
+  ProcessState state;
+  ASSERT_EQ(google_breakpad::PROCESS_OK,
+            processor.Process(minidump_file, &state));
+
+  ASSERT_EQ(1U, sink.thread_indexes_.size());
+  ASSERT_EQ(0, state.requesting_thread());
+  EXPECT_EQ(0, sink.thread_indexes_[0]);
+  EXPECT_FALSE(state.threads()->at(0)->frames()->empty());
+}
+
 TEST_F(MinidumpProcessorTest, GetProcessCreateTime) {
   const uint32_t kProcessCreateTime = 2000;
   const uint32_t kTimeDateStamp = 5000;
@@ -0,0 +1,180 @@
+// Copyright (c) 2016 Google Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+// notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above
+// copyright notice, this list of conditions and the following disclaimer
+// in the documentation and/or other materials provided with the
+// distribution.
+//     * Neither the name of Google Inc. nor the names of its
+// contributors may be used to endorse or promote products derived from
+// this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+// minidump_router.cc: Route minidumps to the nodes of a processing
+// cluster by the modules they hold, with SymbolAffinityRouter.
+//
+// minidump_router reads requests from stdin, one per line.  A line
+// "+<node>" adds a node, and "-<node>" removes one; the number of known
+// modules that change owner is reported on stderr.  A line "!stats"
+// prints each node's statistics on stderr, as end of input does.  Any
+// other line is the path of a minidump: its module list is read, and the
+// line "<node> <path>" is written to stdout, or "- <path>" if there are
+// no nodes.  A minidump whose module list can't be read is routed by its
+// path.  Write the path of a minidump that starts with "+", "-" or "!" as
+// "./<path>".
+//
+// The nodes are typically "minidump_stackwalk -d" daemons, each reached
+// through a pipe or socket by whatever reads minidump_router's output.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <string>
+#include <vector>
+
+#include "common/using_std_string.h"
+#include "google_breakpad/processor/minidump.h"
+#include "google_breakpad/processor/symbol_affinity_router.h"
+#include "processor/logging.h"
+
+namespace {
+
+using google_breakpad::Minidump;
+using google_breakpad::MinidumpModuleList;
+using google_breakpad::SymbolAffinityRouter;
+using std::vector;
+
+void PrintStats(const SymbolAffinityRouter &router) {
+  vector<SymbolAffinityRouter::NodeStats> stats;
+  router.GetStats(&stats);
+  for (size_t i = 0; i < stats.size(); ++i) {
+    uint64_t lookups = stats[i].hits + stats[i].misses;
+    fprintf(stderr, "%s: %llu minidumps, %llu module hits, %llu misses "
+            "(%.1f%% hits), %lu modules\n",
+            stats[i].name.c_str(),
+            static_cast<unsigned long long>(stats[i].minidumps),
+            static_cast<unsigned long long>(stats[i].hits),
+            static_cast<unsigned long long>(stats[i].misses),
+            lookups ? 100.0 * stats[i].hits / lookups : 0.0,
+            static_cast<unsigned long>(stats[i].modules));
+  }
+}
+
+// Returns the node to send the minidump at |path| to.
+string RouteMinidump(const string &path, SymbolAffinityRouter *router) {
+  Minidump dump(path);
+  MinidumpModuleList *modules = NULL;
+  if (dump.Read())
+    modules = dump.GetModuleList();
+  BPLOG_IF(ERROR, !modules) << "Could not read the module list of " << path
+                            << ", routing it by its path";
+  return router->Route(modules, path);
+}
+
+bool ParseCount(char option, const char *value, unsigned long *count) {
+  char *end;
+  *count = strtoul(value, &end, 10);
+  if (end == value || *end != '\0' || *count == 0) {
+    fprintf(stderr, "Invalid value for -%c: %s\n", option, value);
+    return false;
+  }
+  return true;
+}
+
+void usage(const char *program_name) {
+  fprintf(stderr, "usage: %s [-r replicas] [-m modules] [node ...]\n"
+          "    Routes the minidumps named on stdin to the given nodes\n"
+          "    -r : Points on the hash ring per node (default %d)\n"
+          "    -m : Number of largest modules that route a minidump "
+          "(default %d)\n",
+          program_name, SymbolAffinityRouter::kDefaultReplicas,
+          static_cast<int>(SymbolAffinityRouter::kDefaultDominantModules));
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+  BPLOG_INIT(&argc, &argv);
+
+  unsigned long replicas = SymbolAffinityRouter::kDefaultReplicas;
+  unsigned long dominant_modules =
+      SymbolAffinityRouter::kDefaultDominantModules;
+  int ch;
+  while ((ch = getopt(argc, argv, "hr:m:")) != -1) {
+    switch (ch) {
+      case 'r':
+        if (!ParseCount('r', optarg, &replicas))
+          return 1;
+        break;
+      case 'm':
+        if (!ParseCount('m', optarg, &dominant_modules))
+          return 1;
+        break;
+      default:
+        usage(argv[0]);
+        return 1;
+    }
+  }
+
+  SymbolAffinityRouter router(static_cast<int>(replicas), dominant_modules);
+  for (int argi = optind; argi < argc; ++argi) {
+    if (!router.AddNode(argv[argi], NULL))
+      BPLOG(ERROR) << "Node " << argv[argi] << " is given twice";
+  }
+
+  char line[4096];
+  while (fgets(line, sizeof(line), stdin)) {
+    size_t length = strlen(line);
+    while (length > 0 && (line[length - 1] == '\n' ||
+                          line[length - 1] == '\r')) {
+      line[--length] = '\0';
+    }
+    if (length == 0)
+      continue;
+
+    size_t moved;
+    if (line[0] == '+') {
+      if (router.AddNode(line + 1, &moved)) {
+        fprintf(stderr, "%s joined, taking %lu modules\n", line + 1,
+                static_cast<unsigned long>(moved));
+      } else {
+        BPLOG(ERROR) << "Node " << line + 1 << " already joined";
+      }
+    } else if (line[0] == '-') {
+      if (router.RemoveNode(line + 1, &moved)) {
+        fprintf(stderr, "%s left, giving up %lu modules\n", line + 1,
+                static_cast<unsigned long>(moved));
+      } else {
+        BPLOG(ERROR) << "There is no node " << line + 1;
+      }
+    } else if (strcmp(line, "!stats") == 0) {
+      PrintStats(router);
+    } else {
+      string node = RouteMinidump(line, &router);
+      printf("%s %s\n", node.empty() ? "-" : node.c_str(), line);
+      fflush(stdout);
+    }
+  }
+
+  PrintStats(router);
+  return 0;
+}
@@ -0,0 +1,343 @@
+// Copyright (c) 2016 Google Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+// notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above
+// copyright notice, this list of conditions and the following disclaimer
+// in the documentation and/or other materials provided with the
+// distribution.
+//     * Neither the name of Google Inc. nor the names of its
+// contributors may be used to endorse or promote products derived from
+// this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+// minidump_snapshot.cc: Implementation of MinidumpSnapshot.
+//
+// See minidump_snapshot.h for documentation.
+
+#include "google_breakpad/processor/minidump_snapshot.h"
+
+#include <string.h>
+
+#include <algorithm>
+
+#include "google_breakpad/processor/minidump.h"
+#include "processor/logging.h"
+
+namespace google_breakpad {
+
+namespace {
+
+using std::vector;
+
+// A run of memory to be copied into the rebuilt minidump.
+struct MemoryPiece {
+  uint64_t start;
+  uint64_t size;
+  const uint8_t* bytes;
+};
+
+// A region of the rebuilt minidump's memory list, and where its bytes are
+// in the rebuilt image.
+struct Region {
+  uint64_t start;
+  uint64_t end;
+  uint64_t rva;
+
+  bool operator<(const Region& other) const { return start < other.start; }
+};
+
+// Adds the memory of |region|, which may be NULL, to |pieces|.
+void AddPiece(MinidumpMemoryRegion* region, vector<MemoryPiece>* pieces) {
+  if (!region || region->GetSize() == 0)
+    return;
+  const uint8_t* bytes = region->GetMemory();
+  if (!bytes)
+    return;
+  MemoryPiece piece;
+  piece.start = region->GetBase();
+  piece.size = region->GetSize();
+  piece.bytes = bytes;
+  if (piece.size > UINT64_MAX - piece.start)
+    return;
+  pieces->push_back(piece);
+}
+
+// Adds the thread stacks and the memory list of |dump| to |pieces|.
+void AddMemory(Minidump* dump, vector<MemoryPiece>* pieces) {
+  MinidumpThreadList* threads = dump->GetThreadList();
+  for (unsigned int i = 0; threads && i < threads->thread_count(); ++i) {
+    MinidumpThread* thread = threads->GetThreadAtIndex(i);
+    if (thread)
+      AddPiece(thread->GetMemory(), pieces);
+  }
+  MinidumpMemoryList* memory = dump->GetMemoryList();
+  for (unsigned int i = 0; memory && i < memory->region_count(); ++i)
+    AddPiece(memory->GetMemoryRegionAtIndex(i), pieces);
+}
+
+// Appends |size| bytes from |data| to |image|, aligned to 8 bytes, and
+// returns where they went.
+uint64_t Append(const void* data, size_t size, string* image) {
+  image->resize((image->size() + 7) & ~static_cast<size_t>(7));
+  const uint64_t rva = image->size();
+  image->append(static_cast<const char*>(data), size);
+  return rva;
+}
+
+// Returns the index in |dump|'s directory of the stream of |stream_type|,
+// or -1 if there is none.
+int FindStream(Minidump* dump, uint32_t stream_type) {
+  for (unsigned int i = 0; i < dump->GetDirectoryEntryCount(); ++i) {
+    if (dump->GetDirectoryEntryAtIndex(i)->stream_type == stream_type)
+      return i;
+  }
+  return -1;
+}
+
+// Returns the offset in the image of entry |index| of |dump|'s directory.
+size_t DirectoryEntryOffset(Minidump* dump, int index) {
+  return dump->header()->stream_directory_rva + index * sizeof(MDRawDirectory);
+}
+
+}  // namespace
+
+// static
+bool MinidumpSnapshot::ReadInfo(Minidump* dump, MDRawSnapshotInfo* info,
+                                vector<MDRawSnapshotStack>* stacks) {
+  stacks->clear();
+  const int index = FindStream(dump, MD_LINUX_SNAPSHOT);
+  if (index < 0)
+    return false;
+  const MDLocationDescriptor location =
+      dump->GetDirectoryEntryAtIndex(index)->location;
+  if (location.data_size < sizeof(*info) || !dump->SeekSet(location.rva) ||
+      !dump->ReadBytes(info, sizeof(*info))) {
+    BPLOG(ERROR) << "MinidumpSnapshot cannot read snapshot header";
+    return false;
+  }
+  if (info->size_of_header < sizeof(*info) ||
+      info->size_of_header > location.data_size ||
+      info->size_of_entry < sizeof(MDRawSnapshotStack) ||
+      info->number_of_entries >
+          (location.data_size - info->size_of_header) / info->size_of_entry) {
+    BPLOG(ERROR) << "MinidumpSnapshot snapshot stream is malformed";
+    return false;
+  }
+  for (uint32_t i = 0; i < info->number_of_entries; ++i) {
+    MDRawSnapshotStack stack;
+    if (!dump->SeekSet(location.rva + info->size_of_header +
+                       i * info->size_of_entry) ||
+        !dump->ReadBytes(&stack, sizeof(stack))) {
+      BPLOG(ERROR) << "MinidumpSnapshot cannot read snapshot stack " << i;
+      return false;
+    }
+    stacks->push_back(stack);
+  }
+  return true;
+}
+
+// static
+bool MinidumpSnapshot::Rebuild(const string& base, const string& delta,
+                               string* full) {
+  Minidump base_dump(reinterpret_cast<const uint8_t*>(base.data()),
+                     base.size());
+  Minidump delta_dump(reinterpret_cast<const uint8_t*>(delta.data()),
+                      delta.size());
+  if (!base_dump.Read() || !delta_dump.Read()) {
+    BPLOG(ERROR) << "MinidumpSnapshot cannot read minidumps";
+    return false;
+  }
+  if (base_dump.swap() || delta_dump.swap()) {
+    BPLOG(ERROR) << "MinidumpSnapshot doesn't support the other byte order";
+    return false;
+  }
+  // A compressed image decompresses to a different one, whose locations
+  // can't be patched in |delta|.
+  if (delta.size() < sizeof(MDRawHeader) ||
+      memcmp(delta.data(), delta_dump.header(), sizeof(MDRawHeader)) != 0) {
+    BPLOG(ERROR) << "MinidumpSnapshot doesn't support compressed minidumps";
+    return false;
+  }
+
+  MDRawSnapshotInfo base_info;
+  MDRawSnapshotInfo delta_info;
+  vector<MDRawSnapshotStack> base_stacks;
+  vector<MDRawSnapshotStack> stacks;
+  if (!ReadInfo(&base_dump, &base_info, &base_stacks) ||
+      !ReadInfo(&delta_dump, &delta_info, &stacks)) {
+    BPLOG(ERROR) << "MinidumpSnapshot needs two snapshots";
+    return false;
+  }
+  if (base_info.sequence != 0 || delta_info.sequence == 0 ||
+      memcmp(&base_info.series_id, &delta_info.series_id,
+             sizeof(MDGUID)) != 0) {
+    BPLOG(ERROR) << "MinidumpSnapshot needs a base and a delta of its series";
+    return false;
+  }
+
+  const int thread_list_index = FindStream(&delta_dump, MD_THREAD_LIST_STREAM);
+  const int memory_list_index = FindStream(&delta_dump, MD_MEMORY_LIST_STREAM);
+  const int snapshot_index = FindStream(&delta_dump, MD_LINUX_SNAPSHOT);
+  if (thread_list_index < 0 || memory_list_index < 0) {
+    BPLOG(ERROR) << "MinidumpSnapshot delta lacks a thread or memory list";
+    return false;
+  }
+
+  // The delta's memory is copied over the base's, so it comes last.
+  vector<MemoryPiece> pieces;
+  AddMemory(&base_dump, &pieces);
+  AddMemory(&delta_dump, &pieces);
+
+  // The regions cover every piece and every stack, merged where they
+  // overlap.
+  vector<Region> regions;
+  for (size_t i = 0; i < pieces.size(); ++i) {
+    Region region = { pieces[i].start, pieces[i].start + pieces[i].size, 0 };
+    regions.push_back(region);
+  }
+  for (size_t i = 0; i < stacks.size(); ++i) {
+    if (stacks[i].size == 0 ||
+        stacks[i].size > UINT64_MAX - stacks[i].start_of_memory_range) {
+      continue;
+    }
+    Region region = { stacks[i].start_of_memory_range,
+                      stacks[i].start_of_memory_range + stacks[i].size, 0 };
+    regions.push_back(region);
+  }
+  std::sort(regions.begin(), regions.end());
+  size_t merged = 0;
+  for (size_t i = 0; i < regions.size(); ++i) {
+    if (merged > 0 && regions[i].start < regions[merged - 1].end) {
+      regions[merged - 1].end =
+          std::max(regions[merged - 1].end, regions[i].end);
+    } else {
+      regions[merged++] = regions[i];
+    }
+  }
+  regions.resize(merged);
+
+  *full = delta;
+  vector<MDMemoryDescriptor> descriptors;
+  vector<uint8_t> bytes;
+  for (size_t i = 0; i < regions.size(); ++i) {
+    Region& region = regions[i];
+    const uint64_t size = region.end - region.start;
+    if (size > UINT32_MAX) {
+      BPLOG(ERROR) << "MinidumpSnapshot memory region is too large";
+      return false;
+    }
+    bytes.assign(size, 0);
+    for (size_t j = 0; j < pieces.size(); ++j) {
+      const MemoryPiece& piece = pieces[j];
+      if (piece.start < region.start ||
+          piece.start + piece.size > region.end) {
+        continue;
+      }
+      memcpy(&bytes[piece.start - region.start], piece.bytes, piece.size);
+    }
+    region.rva = Append(size ? &bytes[0] : NULL, size, full);
+
+    MDMemoryDescriptor descriptor;
+    descriptor.start_of_memory_range = region.start;
+    descriptor.memory.data_size = size;
+    descriptor.memory.rva = region.rva;
+    descriptors.push_back(descriptor);
+  }
+
+  uint32_t count = descriptors.size();
+  string list(reinterpret_cast<const char*>(&count), sizeof(count));
+  if (count) {
+    list.append(reinterpret_cast<const char*>(&descriptors[0]),
+                count * sizeof(MDMemoryDescriptor));
+  }
+  MDRawDirectory memory_list;
+  memory_list.stream_type = MD_MEMORY_LIST_STREAM;
+  memory_list.location.data_size = list.size();
+  memory_list.location.rva = Append(list.data(), list.size(), full);
+  if (full->size() > UINT32_MAX) {
+    BPLOG(ERROR) << "MinidumpSnapshot rebuilt minidump is too large";
+    return false;
+  }
+  full->replace(DirectoryEntryOffset(&delta_dump, memory_list_index),
+                sizeof(memory_list),
+                reinterpret_cast<const char*>(&memory_list),
+                sizeof(memory_list));
+
+  // The rebuilt minidump is complete, and no longer a delta.
+  if (snapshot_index >= 0) {
+    MDRawDirectory unused;
+    memset(&unused, 0, sizeof(unused));
+    unused.stream_type = MD_UNUSED_STREAM;
+    full->replace(DirectoryEntryOffset(&delta_dump, snapshot_index),
+                  sizeof(unused), reinterpret_cast<const char*>(&unused),
+                  sizeof(unused));
+  }
+
+  // Point the threads at their stacks, which are inside the regions.  Some
+  // writers pad the thread count to 8 bytes.
+  const MDLocationDescriptor threads =
+      delta_dump.GetDirectoryEntryAtIndex(thread_list_index)->location;
+  uint32_t thread_count;
+  if (threads.data_size < sizeof(thread_count) ||
+      threads.rva > delta.size() ||
+      threads.data_size > delta.size() - threads.rva) {
+    BPLOG(ERROR) << "MinidumpSnapshot cannot read the delta's threads";
+    return false;
+  }
+  memcpy(&thread_count, delta.data() + threads.rva, sizeof(thread_count));
+  const uint64_t entries_size =
+      static_cast<uint64_t>(thread_count) * sizeof(MDRawThread);
+  size_t first;
+  if (threads.data_size == sizeof(thread_count) + entries_size) {
+    first = sizeof(thread_count);
+  } else if (threads.data_size == 8 + entries_size) {
+    first = 8;
+  } else {
+    BPLOG(ERROR) << "MinidumpSnapshot cannot read the delta's threads";
+    return false;
+  }
+  for (uint32_t i = 0; i < thread_count; ++i) {
+    const size_t offset = threads.rva + first + i * sizeof(MDRawThread);
+    MDRawThread thread;
+    memcpy(&thread, full->data() + offset, sizeof(thread));
+    for (size_t j = 0; j < stacks.size(); ++j) {
+      if (stacks[j].thread_id != thread.thread_id || stacks[j].size == 0)
+        continue;
+      const uint64_t start = stacks[j].start_of_memory_range;
+      Region key = { start, 0, 0 };
+      vector<Region>::const_iterator region =
+          std::upper_bound(regions.begin(), regions.end(), key);
+      if (region == regions.begin())
+        break;
+      --region;
+      if (start >= region->end || stacks[j].size > region->end - start)
+        break;
+      thread.stack.start_of_memory_range = start;
+      thread.stack.memory.data_size = stacks[j].size;
+      thread.stack.memory.rva = region->rva + (start - region->start);
+      break;
+    }
+    full->replace(offset, sizeof(thread),
+                  reinterpret_cast<const char*>(&thread), sizeof(thread));
+  }
+  return true;
+}
+
+}  // namespace google_breakpad
@@ -0,0 +1,245 @@
+// Copyright (c) 2016 Google Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+// notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above
+// copyright notice, this list of conditions and the following disclaimer
+// in the documentation and/or other materials provided with the
+// distribution.
+//     * Neither the name of Google Inc. nor the names of its
+// contributors may be used to endorse or promote products derived from
+// this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+// Unit tests for MinidumpSnapshot, using synthesized minidumps.
+
+#include <string.h>
+
+#include <string>
+#include <vector>
+
+#include "breakpad_googletest_includes.h"
+#include "common/using_std_string.h"
+#include "google_breakpad/common/minidump_format.h"
+#include "google_breakpad/processor/minidump.h"
+#include "google_breakpad/processor/minidump_snapshot.h"
+#include "processor/synth_minidump.h"
+
+namespace {
+
+using google_breakpad::Minidump;
+using google_breakpad::MinidumpMemoryList;
+using google_breakpad::MinidumpMemoryRegion;
+using google_breakpad::MinidumpSnapshot;
+using google_breakpad::MinidumpThread;
+using google_breakpad::MinidumpThreadList;
+using google_breakpad::SynthMinidump::Context;
+using google_breakpad::SynthMinidump::Dump;
+using google_breakpad::SynthMinidump::Memory;
+using google_breakpad::SynthMinidump::Section;
+using google_breakpad::SynthMinidump::Stream;
+using google_breakpad::SynthMinidump::Thread;
+using google_breakpad::test_assembler::kLittleEndian;
+using std::vector;
+
+const uint32_t kThreadID = 0x3c1b;
+const uint32_t kProcessID = 0x3c00;
+const uint64_t kStackStart = 0x7ff00000;
+const uint64_t kHeapStart = 0x10000000;
+const uint64_t kNewStart = 0x20000000;
+
+// Builds the snapshots of a series: a base holding a thread's stack and a
+// heap region, and deltas holding the pages written since.
+class MinidumpSnapshotTest : public ::testing::Test {
+ public:
+  MinidumpSnapshotTest() {
+    memset(&raw_context_, 0, sizeof(raw_context_));
+    raw_context_.context_flags = MD_CONTEXT_X86_INTEGER |
+                                 MD_CONTEXT_X86_CONTROL;
+    raw_context_.esp = kStackStart + 0x80;
+  }
+
+  // Appends an MD_LINUX_SNAPSHOT stream's contents to |stream|.
+  void AppendSnapshot(Stream* stream, uint32_t sequence, uint8_t series,
+                      const vector<MDRawSnapshotStack>& stacks) {
+    stream->D32(sizeof(MDRawSnapshotInfo))
+           .D32(sizeof(MDRawSnapshotStack))
+           .D32(stacks.size())
+           .D32(sequence)
+           .D32(0x11223344).D16(0x5566).D16(0x7788)
+           .Append(8, series)
+           .D32(kProcessID)
+           .D32(0x1000);
+    for (size_t i = 0; i < stacks.size(); ++i) {
+      stream->D32(stacks[i].thread_id)
+             .D32(0)
+             .D64(stacks[i].start_of_memory_range)
+             .D64(stacks[i].size);
+    }
+  }
+
+  // Sets |contents| to a base with a 0x100-byte stack of 0x11s and 0x20
+  // bytes of heap of 0x22s.
+  void MakeBase(uint8_t series, string* contents) {
+    Dump dump(0, kLittleEndian);
+    Memory stack(dump, kStackStart);
+    stack.Append(0x100, 0x11);
+    Memory heap(dump, kHeapStart);
+    heap.Append(0x20, 0x22);
+    Context context(dump, raw_context_);
+    Thread thread(dump, kThreadID, stack, context);
+    Stream snapshot(dump, MD_LINUX_SNAPSHOT);
+    AppendSnapshot(&snapshot, 0, series, vector<MDRawSnapshotStack>());
+    dump.Add(&stack);
+    dump.Add(&heap);
+    dump.Add(&context);
+    dump.Add(&thread);
+    dump.Add(&snapshot);
+    dump.Finish();
+    ASSERT_TRUE(dump.GetContents(contents));
+  }
+
+  // Sets |contents| to a delta whose thread's stack is |stack_size| bytes,
+  // with 0x10 bytes of 0x33s written in the middle of it, and 8 bytes of
+  // 0x44s at kNewStart.
+  void MakeDelta(uint8_t series, uint64_t stack_size, string* contents) {
+    Dump dump(0, kLittleEndian);
+    Memory empty_stack(dump, kStackStart);
+    Memory written(dump, kStackStart + 0x80);
+    written.Append(0x10, 0x33);
+    Memory added(dump, kNewStart);
+    added.Append(8, 0x44);
+    Context context(dump, raw_context_);
+    Thread thread(dump, kThreadID, empty_stack, context);
+    MDRawSnapshotStack entry;
+    memset(&entry, 0, sizeof(entry));
+    entry.thread_id = kThreadID;
+    entry.start_of_memory_range = kStackStart;
+    entry.size = stack_size;
+    Stream snapshot(dump, MD_LINUX_SNAPSHOT);
+    AppendSnapshot(&snapshot, 1, series, vector<MDRawSnapshotStack>(1, entry));
+    dump.Add(static_cast<Section*>(&empty_stack));
+    dump.Add(&written);
+    dump.Add(&added);
+    dump.Add(&context);
+    dump.Add(&thread);
+    dump.Add(&snapshot);
+    dump.Finish();
+    ASSERT_TRUE(dump.GetContents(contents));
+  }
+
+  // Returns the bytes of |region|.
+  static string Bytes(MinidumpMemoryRegion* region) {
+    return string(reinterpret_cast<const char*>(region->GetMemory()),
+                  region->GetSize());
+  }
+
+  MDRawContextX86 raw_context_;
+};
+
+TEST_F(MinidumpSnapshotTest, ReadInfo) {
+  string delta;
+  MakeDelta(0x99, 0x100, &delta);
+  Minidump dump(reinterpret_cast<const uint8_t*>(delta.data()), delta.size());
+  ASSERT_TRUE(dump.Read());
+
+  MDRawSnapshotInfo info;
+  vector<MDRawSnapshotStack> stacks;
+  ASSERT_TRUE(MinidumpSnapshot::ReadInfo(&dump, &info, &stacks));
+  EXPECT_EQ(1U, info.sequence);
+  EXPECT_EQ(kProcessID, info.process_id);
+  EXPECT_EQ(0x1000U, info.page_size);
+  EXPECT_EQ(0x99, info.series_id.data4[0]);
+  ASSERT_EQ(1U, stacks.size());
+  EXPECT_EQ(kThreadID, stacks[0].thread_id);
+  EXPECT_EQ(kStackStart, stacks[0].start_of_memory_range);
+  EXPECT_EQ(0x100U, stacks[0].size);
+}
+
+TEST_F(MinidumpSnapshotTest, Rebuild) {
+  string base, delta, full;
+  MakeBase(0x99, &base);
+  MakeDelta(0x99, 0x100, &delta);
+  ASSERT_TRUE(MinidumpSnapshot::Rebuild(base, delta, &full));
+
+  Minidump dump(reinterpret_cast<const uint8_t*>(full.data()), full.size());
+  ASSERT_TRUE(dump.Read());
+  MDRawSnapshotInfo info;
+  vector<MDRawSnapshotStack> stacks;
+  EXPECT_FALSE(MinidumpSnapshot::ReadInfo(&dump, &info, &stacks));
+
+  // The stack is the base's, with the bytes written since overlaid.
+  MinidumpThreadList* threads = dump.GetThreadList();
+  ASSERT_TRUE(threads != NULL);
+  ASSERT_EQ(1U, threads->thread_count());
+  MinidumpThread* thread = threads->GetThreadAtIndex(0);
+  MinidumpMemoryRegion* stack = thread->GetMemory();
+  ASSERT_TRUE(stack != NULL);
+  EXPECT_EQ(kStackStart, stack->GetBase());
+  EXPECT_EQ(string(0x80, 0x11) + string(0x10, 0x33) + string(0x70, 0x11),
+            Bytes(stack));
+
+  // The memory list holds the base's heap, the new memory and the stack.
+  MinidumpMemoryList* memory = dump.GetMemoryList();
+  ASSERT_TRUE(memory != NULL);
+  ASSERT_EQ(3U, memory->region_count());
+  MinidumpMemoryRegion* heap = memory->GetMemoryRegionForAddress(kHeapStart);
+  ASSERT_TRUE(heap != NULL);
+  EXPECT_EQ(string(0x20, 0x22), Bytes(heap));
+  MinidumpMemoryRegion* added = memory->GetMemoryRegionForAddress(kNewStart);
+  ASSERT_TRUE(added != NULL);
+  EXPECT_EQ(string(8, 0x44), Bytes(added));
+  MinidumpMemoryRegion* listed_stack =
+      memory->GetMemoryRegionForAddress(kStackStart + 0x80);
+  ASSERT_TRUE(listed_stack != NULL);
+  EXPECT_EQ(Bytes(stack), Bytes(listed_stack));
+}
+
+TEST_F(MinidumpSnapshotTest, StackGrownSinceBase) {
+  string base, delta, full;
+  MakeBase(0x99, &base);
+  MakeDelta(0x99, 0x180, &delta);
+  ASSERT_TRUE(MinidumpSnapshot::Rebuild(base, delta, &full));
+
+  Minidump dump(reinterpret_cast<const uint8_t*>(full.data()), full.size());
+  ASSERT_TRUE(dump.Read());
+  MinidumpThreadList* threads = dump.GetThreadList();
+  ASSERT_TRUE(threads != NULL);
+  MinidumpMemoryRegion* stack = threads->GetThreadAtIndex(0)->GetMemory();
+  ASSERT_TRUE(stack != NULL);
+  // Stack memory in neither minidump is zero.
+  EXPECT_EQ(string(0x80, 0x11) + string(0x10, 0x33) + string(0x70, 0x11) +
+                string(0x80, 0),
+            Bytes(stack));
+}
+
+TEST_F(MinidumpSnapshotTest, RejectsOtherSeries) {
+  string base, delta, full;
+  MakeBase(0x99, &base);
+  MakeDelta(0x98, 0x100, &delta);
+  EXPECT_FALSE(MinidumpSnapshot::Rebuild(base, delta, &full));
+}
+
+TEST_F(MinidumpSnapshotTest, RejectsTwoBases) {
+  string base, full;
+  MakeBase(0x99, &base);
+  EXPECT_FALSE(MinidumpSnapshot::Rebuild(base, base, &full));
+}
+
+}  // namespace
@@ -30,36 +30,206 @@
 // minidump_stackwalk.cc: Process a minidump with MinidumpProcessor, printing
 // the results, including stack traces.
 //
+// With -d, minidump_stackwalk runs as a daemon that processes a stream of
+// minidumps read from stdin, keeping parsed symbols in memory between them.
+// Each request is a line holding the path of a minidump file, or a line
+// "@<size>" followed by <size> bytes of minidump data.  Requests are
+// processed concurrently and numbered from 1 in the order they are read.
+// The result of each is written to stdout as a line "BEGIN <number> ok" or
+// "BEGIN <number> error <ProcessResult>", followed by the minidump's path
+// if it has one, the usual output when processing succeeded, and a line
+// "END <number>".  Results may complete out of order.  A line
+// "!invalidate <debug_file> <debug_identifier>", or "!invalidate" alone,
+// drops the cached symbols for that module, or for all modules, so that
+// updated symbol files are picked up without restarting the daemon.
+//
+// With -b, minidump_stackwalk processes every file in a directory, or every
+// minidump named in a list file, the same way, printing machine-readable
+// results and throughput statistics.
+//
+// With -J, results are printed as JSON by ProcessStateJSONWriter instead.
+//
+// In -d and -b modes, -a also writes the stack frames of every minidump
+// processed to a file, as one Arrow table written by FrameTableWriter, for
+// analytics systems to ingest without parsing the printed results.
+//
+// In -b mode, -F aggregates the stacks of every minidump processed into
+// one profile by StackProfile, written to a file in the folded-stack
+// format that flame graph tools read, instead of printing each result.
+//
+// -u loads an UnwindPolicy that skips the methods of finding callers known
+// to be futile for some modules.  In -d and -b modes, -U writes the policy,
+// updated from how each method did on the minidumps processed, to a file
+// that can be given to -u on later runs.
+//
+// High-volume runs can keep logging out of the way: -q skips INFO messages
+// without formatting them, and in -d and -b modes -e holds each minidump's
+// messages back, printing them to stderr only if processing it fails.
+//
 // Author: Mark Mentovai
 
+#include <dirent.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+#ifndef _WIN32
+#include <pthread.h>
+#endif  // _WIN32
 
+#include <algorithm>
 #include <string>
 #include <vector>
 
 #include "common/scoped_ptr.h"
 #include "common/using_std_string.h"
 #include "google_breakpad/processor/basic_source_line_resolver.h"
+#include "google_breakpad/processor/code_module.h"
+#include "google_breakpad/processor/code_modules.h"
+#include "google_breakpad/processor/code_modules_cache.h"
+#include "google_breakpad/processor/minidump.h"
 #include "google_breakpad/processor/minidump_processor.h"
 #include "google_breakpad/processor/process_state.h"
+#include "google_breakpad/processor/symbol_module_cache.h"
+#include "google_breakpad/processor/task_executor.h"
+#include "google_breakpad/processor/unwind_policy.h"
+#include "processor/frame_table_writer.h"
 #include "processor/logging.h"
+#include "processor/mutex.h"
+#include "processor/pack_symbol_supplier.h"
+#include "processor/process_state_json_writer.h"
 #include "processor/simple_symbol_supplier.h"
+#include "processor/stack_profile.h"
 #include "processor/stackwalk_common.h"
 
 
 namespace {
 
+using google_breakpad::AutoMutex;
 using google_breakpad::BasicSourceLineResolver;
+using google_breakpad::CodeModules;
+using google_breakpad::CodeModulesCache;
+using google_breakpad::FrameTableWriter;
+using google_breakpad::LogCapture;
+using google_breakpad::LogStream;
+using google_breakpad::Minidump;
 using google_breakpad::MinidumpProcessor;
+using google_breakpad::Mutex;
+using google_breakpad::PackSymbolSupplier;
+using google_breakpad::ProcessResult;
 using google_breakpad::ProcessState;
+using google_breakpad::ProcessStateJSONWriter;
 using google_breakpad::SimpleSymbolSupplier;
+using google_breakpad::StackProfile;
+using google_breakpad::SymbolModuleCache;
+using google_breakpad::SymbolSupplier;
+using google_breakpad::Task;
+using google_breakpad::TaskExecutor;
+using google_breakpad::TaskGroup;
+using google_breakpad::UnwindPolicy;
+using google_breakpad::UnwindStatistics;
+using google_breakpad::WorkStealingExecutor;
 using google_breakpad::scoped_ptr;
 
-// Processes |minidump_file| using MinidumpProcessor.  |symbol_path|, if
-// non-empty, is the base directory of a symbol storage area, laid out in
-// the format required by SimpleSymbolSupplier.  If such a storage area
-// is specified, it is made available for use by the MinidumpProcessor.
+// The default memory budget of the daemon's symbol cache, in megabytes.
+const size_t kDefaultSymbolCacheMegabytes = 512;
+
+// The module lists the daemon keeps for dumps of the same builds to share.
+const size_t kModuleListCacheEntries = 64;
+
+enum OutputFormat {
+  OUTPUT_TEXT,
+  OUTPUT_MACHINE_READABLE,
+  OUTPUT_JSON
+};
+
+struct StackwalkOptions {
+  StackwalkOptions()
+      : output_format(OUTPUT_TEXT),
+        load_modules_lazily(false),
+        log_failures_only(false),
+        thread_count(1),
+        symbol_cache_size(kDefaultSymbolCacheMegabytes << 20),
+        unwind_policy(NULL) {}
+
+  OutputFormat output_format;
+  std::vector<string> symbol_paths;
+
+  // Single minidump mode only: load symbol files that have a .sym.idx
+  // index on demand.
+  bool load_modules_lazily;
+
+  // Daemon and batch modes only: print the messages logged while
+  // processing a minidump only if processing it fails.
+  bool log_failures_only;
+
+  // Daemon and batch modes only: the number of minidumps processed at
+  // once, and the number of bytes of parsed symbols kept once no minidump
+  // uses them.
+  unsigned int thread_count;
+  size_t symbol_cache_size;
+
+  // Daemon and batch modes only: the file the frame table is written to,
+  // if any.
+  string frame_table_path;
+
+  // Batch mode only: the file the stacks of every minidump are written to
+  // as one folded-stack profile, if any.  Results are not printed then.
+  string profile_path;
+
+  // The policy stack walkers follow, or NULL to try every method.
+  const UnwindPolicy *unwind_policy;
+
+  // Daemon and batch modes only: the file the policy, updated from the
+  // minidumps processed, is written to, if any.
+  string updated_policy_path;
+};
+
+// The symbol suppliers for a list of symbol paths.  Paths naming files are
+// symbol packs, read by a PackSymbolSupplier, and the others are symbol
+// store directories, read by a SimpleSymbolSupplier that the
+// PackSymbolSupplier falls back on for modules it has no symbols for.
+class StackwalkSymbolSupplier {
+ public:
+  explicit StackwalkSymbolSupplier(const std::vector<string> &symbol_paths) {
+    std::vector<string> pack_paths;
+    std::vector<string> directories;
+    for (size_t i = 0; i < symbol_paths.size(); ++i) {
+      struct stat st;
+      if (stat(symbol_paths[i].c_str(), &st) == 0 && S_ISREG(st.st_mode))
+        pack_paths.push_back(symbol_paths[i]);
+      else
+        directories.push_back(symbol_paths[i]);
+    }
+    if (!directories.empty())
+      simple_supplier_.reset(new SimpleSymbolSupplier(directories));
+    if (!pack_paths.empty()) {
+      pack_supplier_.reset(new PackSymbolSupplier(pack_paths,
+                                                  simple_supplier_.get()));
+    }
+  }
+
+  // Returns the supplier to use, or NULL if there are no symbol paths.
+  SymbolSupplier *get() {
+    if (pack_supplier_.get())
+      return pack_supplier_.get();
+    return simple_supplier_.get();
+  }
+
+ private:
+  scoped_ptr<SimpleSymbolSupplier> simple_supplier_;
+  scoped_ptr<PackSymbolSupplier> pack_supplier_;
+};
+
+// Processes |minidump_file| using MinidumpProcessor.  |symbol_paths| are
+// base directories of symbol storage areas, laid out in the format
+// required by SimpleSymbolSupplier, or symbol pack files.  Any that are
+// specified are made available for use by the MinidumpProcessor.  If
+// |load_modules_lazily| is true, symbol files with an index are parsed
+// only as far as the stack walk needs.
 //
 // Returns the value of MinidumpProcessor::Process.  If processing succeeds,
 // prints identifying OS and CPU information from the minidump, crash
@@ -68,15 +238,19 @@ using google_breakpad::scoped_ptr;
 // is printed to stdout.
 bool PrintMinidumpProcess(const string &minidump_file,
                           const std::vector<string> &symbol_paths,
-                          bool machine_readable) {
-  scoped_ptr<SimpleSymbolSupplier> symbol_supplier;
-  if (!symbol_paths.empty()) {
-    // TODO(mmentovai): check existence of symbol_path if specified?
-    symbol_supplier.reset(new SimpleSymbolSupplier(symbol_paths));
-  }
+                          OutputFormat output_format,
+                          bool load_modules_lazily,
+                          const UnwindPolicy *unwind_policy) {
+  // TODO(mmentovai): check existence of symbol_path if specified?
+  StackwalkSymbolSupplier symbol_supplier(symbol_paths);
 
+  // The process state is printed while |resolver| still holds the modules,
+  // so frames may share its names rather than copy them.
   BasicSourceLineResolver resolver;
+  resolver.set_share_names(true);
+  resolver.set_load_modules_lazily(load_modules_lazily);
   MinidumpProcessor minidump_processor(symbol_supplier.get(), &resolver);
+  minidump_processor.set_unwind_policy(unwind_policy);
 
   // Process the minidump.
   ProcessState process_state;
@@ -86,19 +260,700 @@ bool PrintMinidumpProcess(const string &minidump_file,
     return false;
   }
 
-  if (machine_readable) {
-    PrintProcessStateMachineReadable(process_state);
-  } else {
-    PrintProcessState(process_state);
+  switch (output_format) {
+    case OUTPUT_MACHINE_READABLE:
+      PrintProcessStateMachineReadable(process_state);
+      break;
+    case OUTPUT_JSON:
+      PrintProcessStateJSON(process_state);
+      break;
+    default:
+      PrintProcessState(process_state);
+      break;
+  }
+
+  return true;
+}
+
+// A daemon request.  |data| holds the minidump for requests that send it
+// inline, and is empty when the minidump is to be read from |path|.
+struct DumpRequest {
+  DumpRequest() : id(0) {}
+
+  unsigned long id;
+  string path;
+  string data;
+};
+
+enum ReadRequestResult {
+  READ_REQUEST_OK,
+  READ_REQUEST_END,
+  READ_REQUEST_MALFORMED
+};
+
+// Reads the next non-blank line from |input| into |line|, without its line
+// ending.  Returns false at the end of input.
+bool ReadLine(FILE *input, string *line) {
+  do {
+    line->clear();
+    int c;
+    while ((c = getc(input)) != EOF && c != '\n')
+      line->push_back(static_cast<char>(c));
+    if (c == EOF && line->empty())
+      return false;
+    if (!line->empty() && (*line)[line->size() - 1] == '\r')
+      line->erase(line->size() - 1);
+  } while (line->empty());
+  return true;
+}
+
+// Carries out the "!invalidate" command |line| on |module_cache|.
+// Returns false if |line| is malformed.
+bool InvalidateSymbols(const string &line, SymbolModuleCache *module_cache) {
+  static const char kCommand[] = "!invalidate";
+  static const size_t kCommandLength = sizeof(kCommand) - 1;
+  if (line.compare(0, kCommandLength, kCommand) != 0)
+    return false;
+  if (line.size() == kCommandLength) {
+    module_cache->InvalidateAll();
+    return true;
+  }
+  size_t space = line.find(' ', kCommandLength + 1);
+  if (line[kCommandLength] != ' ' || space == string::npos)
+    return false;
+  module_cache->Invalidate(
+      line.substr(kCommandLength + 1, space - kCommandLength - 1),
+      line.substr(space + 1));
+  return true;
+}
+
+// Reads the next request from |input| into |request|, carrying out any
+// commands for |module_cache| that come before it.
+ReadRequestResult ReadRequest(FILE *input, SymbolModuleCache *module_cache,
+                              DumpRequest *request) {
+  string line;
+  for (;;) {
+    if (!ReadLine(input, &line))
+      return READ_REQUEST_END;
+    if (line[0] != '!')
+      break;
+    if (!InvalidateSymbols(line, module_cache)) {
+      BPLOG(ERROR) << "Malformed request: " << line;
+      return READ_REQUEST_MALFORMED;
+    }
+  }
+
+  if (line[0] != '@') {
+    request->path = line;
+    return READ_REQUEST_OK;
+  }
+
+  const char *size_string = line.c_str() + 1;
+  char *size_end;
+  unsigned long long size = strtoull(size_string, &size_end, 10);
+  if (size_end == size_string || *size_end != '\0' || size == 0) {
+    BPLOG(ERROR) << "Malformed request: " << line;
+    return READ_REQUEST_MALFORMED;
+  }
+  request->data.resize(size);
+  if (fread(&request->data[0], 1, size, input) != size) {
+    BPLOG(ERROR) << "Inline minidump truncated after " << size << " bytes "
+                    "were requested";
+    return READ_REQUEST_MALFORMED;
+  }
+  return READ_REQUEST_OK;
+}
+
+// A source of requests for the daemon threads.
+class RequestReader {
+ public:
+  virtual ~RequestReader() {}
+
+  // Reads the next request into |request|.
+  virtual ReadRequestResult Read(DumpRequest *request) = 0;
+};
+
+// Reads requests in the daemon protocol from a stream.
+class StreamRequestReader : public RequestReader {
+ public:
+  StreamRequestReader(FILE *input, SymbolModuleCache *module_cache)
+      : input_(input), module_cache_(module_cache) {}
+
+  virtual ReadRequestResult Read(DumpRequest *request) {
+    return ReadRequest(input_, module_cache_, request);
+  }
+
+ private:
+  FILE *input_;
+  SymbolModuleCache *module_cache_;
+};
+
+// Requests each minidump in a list of paths in turn.
+class PathListRequestReader : public RequestReader {
+ public:
+  explicit PathListRequestReader(const std::vector<string> &paths)
+      : paths_(paths), next_(0) {}
+
+  virtual ReadRequestResult Read(DumpRequest *request) {
+    if (next_ == paths_.size())
+      return READ_REQUEST_END;
+    request->path = paths_[next_++];
+    return READ_REQUEST_OK;
+  }
+
+ private:
+  const std::vector<string> &paths_;
+  size_t next_;
+};
+
+// Counts of the requests processed, gathered from all daemon threads.
+struct ProcessingStats {
+  ProcessingStats() : processed(0), failed(0) {}
+
+  unsigned long processed;
+  unsigned long failed;
+
+  // How each method of finding callers did, gathered only when an updated
+  // unwind policy is written.
+  UnwindStatistics unwind;
+
+  // The tasks run on the shared executor, by stage.
+  TaskExecutor::StageMetrics stages[TaskExecutor::STAGE_COUNT];
+};
+
+// The processing state of one running request.  Parsed symbols are shared
+// between workers through |module_cache|, and module lists through
+// |modules_cache|, but each worker has its own symbol supplier and
+// resolver, neither of which may be used by several threads at once.  The
+// Minidump and ProcessState are reset and reused for each request, keeping
+// the storage they allocated for earlier ones.  The processor runs its
+// concurrent work on |executor|, which may be NULL.
+class DaemonWorker {
+ public:
+  DaemonWorker(const StackwalkOptions &options,
+               SymbolModuleCache *module_cache,
+               CodeModulesCache *modules_cache,
+               Mutex *output_mutex,
+               FrameTableWriter *frame_table,
+               StackProfile *profile,
+               ProcessingStats *stats,
+               TaskExecutor *executor)
+      : options_(options),
+        output_mutex_(output_mutex),
+        frame_table_(frame_table),
+        profile_(profile),
+        stats_(stats),
+        symbol_supplier_(options.symbol_paths),
+        dump_(string(), true) {
+    resolver_.set_module_cache(module_cache);
+    resolver_.set_freeze_modules(true);
+    processor_.reset(new MinidumpProcessor(symbol_supplier_.get(),
+                                           &resolver_));
+    processor_->set_code_modules_cache(modules_cache);
+    processor_->set_unwind_policy(options.unwind_policy);
+    processor_->set_task_executor(executor);
+  }
+
+  // Processes |request|, prints its result and counts it in |stats_|.
+  // The frames of a minidump processed successfully are added to
+  // |frame_table_|, if there is one, while holding the output lock.  If
+  // there is a |profile_|, its stacks are added to that instead of being
+  // printed.
+  void Process(const DumpRequest &request) {
+    scoped_ptr<LogCapture> log_capture;
+    if (options_.log_failures_only)
+      log_capture.reset(new LogCapture());
+
+    ProcessState &process_state = process_state_;
+    ProcessResult result;
+    if (request.data.empty())
+      dump_.Reset(request.path);
+    else
+      dump_.Reset(reinterpret_cast<const uint8_t*>(request.data.data()),
+                  request.data.size());
+    if (dump_.Read()) {
+      result = processor_->Process(&dump_, &process_state);
+    } else {
+      if (request.data.empty()) {
+        BPLOG(ERROR) << "Minidump " << request.path << " could not be read";
+      } else {
+        BPLOG(ERROR) << "Inline minidump " << request.id
+                     << " could not be read";
+      }
+      result = google_breakpad::PROCESS_ERROR_MINIDUMP_NOT_FOUND;
+    }
+
+    // JSON results are serialized before taking the output lock, into a
+    // buffer that is reused for every request.
+    if (result == google_breakpad::PROCESS_OK && !profile_ &&
+        options_.output_format == OUTPUT_JSON) {
+      json_writer_.Write(process_state);
+    }
+
+    {
+      AutoMutex lock(output_mutex_);
+      ++stats_->processed;
+      if (result != google_breakpad::PROCESS_OK) {
+        ++stats_->failed;
+        if (log_capture.get())
+          std::cerr << log_capture->contents() << std::flush;
+      }
+      if (profile_) {
+        if (result == google_breakpad::PROCESS_OK)
+          profile_->Add(process_state);
+      } else {
+        PrintResult(request, result, process_state);
+      }
+      if (frame_table_ && result == google_breakpad::PROCESS_OK &&
+          !frame_table_->Add(process_state, request.id, request.path)) {
+        BPLOG(ERROR) << "Could not write the frame table";
+      }
+      if (!options_.updated_policy_path.empty() &&
+          result == google_breakpad::PROCESS_OK) {
+        stats_->unwind.Add(process_state);
+      }
+    }
+
+    // Return this minidump's symbols to the cache, which keeps them for
+    // later requests for as long as its memory budget allows.
+    const CodeModules *modules = process_state.modules();
+    if (modules) {
+      for (unsigned int i = 0; i < modules->module_count(); ++i)
+        resolver_.UnloadModule(modules->GetModuleAtIndex(i));
+    }
+    process_state.Clear();
+  }
+
+ private:
+  // Prints the result of |request|, with |process_state| if processing
+  // succeeded.
+  void PrintResult(const DumpRequest &request, ProcessResult result,
+                   const ProcessState &process_state) {
+    if (result == google_breakpad::PROCESS_OK)
+      printf("BEGIN %lu ok", request.id);
+    else
+      printf("BEGIN %lu error %d", request.id, result);
+    if (!request.path.empty())
+      printf(" %s", request.path.c_str());
+    printf("\n");
+    if (result == google_breakpad::PROCESS_OK) {
+      switch (options_.output_format) {
+        case OUTPUT_MACHINE_READABLE:
+          PrintProcessStateMachineReadable(process_state);
+          break;
+        case OUTPUT_JSON:
+          fwrite(json_writer_.data(), 1, json_writer_.size(), stdout);
+          printf("\n");
+          break;
+        default:
+          PrintProcessState(process_state);
+          break;
+      }
+    }
+    printf("END %lu\n", request.id);
+    fflush(stdout);
+  }
+
+  const StackwalkOptions &options_;
+  Mutex *output_mutex_;
+  FrameTableWriter *frame_table_;
+  StackProfile *profile_;
+  ProcessingStats *stats_;
+  StackwalkSymbolSupplier symbol_supplier_;
+  BasicSourceLineResolver resolver_;
+  scoped_ptr<MinidumpProcessor> processor_;
+  ProcessStateJSONWriter json_writer_;
+  Minidump dump_;
+  ProcessState process_state_;
+};
+
+#ifndef _WIN32
+// Runs requests as tasks on the executor that their processors also run
+// stack walks and symbol loads on.  At most |max_requests| are submitted
+// and not yet finished, so that inline minidumps can't pile up in memory.
+// A running request borrows a DaemonWorker, and one is made whenever none
+// is free, so there are never more workers than requests run at once.
+class RequestRunner {
+ public:
+  RequestRunner(const StackwalkOptions &options,
+                SymbolModuleCache *module_cache,
+                CodeModulesCache *modules_cache,
+                Mutex *output_mutex,
+                FrameTableWriter *frame_table,
+                StackProfile *profile,
+                ProcessingStats *stats,
+                TaskExecutor *executor,
+                size_t max_requests)
+      : options_(options),
+        module_cache_(module_cache),
+        modules_cache_(modules_cache),
+        output_mutex_(output_mutex),
+        frame_table_(frame_table),
+        profile_(profile),
+        stats_(stats),
+        executor_(executor),
+        tasks_(max_requests, RequestTask(this)),
+        group_(executor) {
+    pthread_mutex_init(&mutex_, NULL);
+    pthread_cond_init(&changed_, NULL);
+    for (size_t i = 0; i < tasks_.size(); ++i)
+      free_tasks_.push_back(&tasks_[i]);
+  }
+
+  ~RequestRunner() {
+    group_.Wait();
+    for (size_t i = 0; i < workers_.size(); ++i)
+      delete workers_[i];
+    pthread_cond_destroy(&changed_);
+    pthread_mutex_destroy(&mutex_);
+  }
+
+  // Submits |request|, taking ownership of it, once fewer than
+  // |max_requests| are outstanding.
+  void Submit(DumpRequest *request) {
+    pthread_mutex_lock(&mutex_);
+    while (free_tasks_.empty())
+      pthread_cond_wait(&changed_, &mutex_);
+    RequestTask *task = free_tasks_.back();
+    free_tasks_.pop_back();
+    pthread_mutex_unlock(&mutex_);
+    task->request.reset(request);
+    group_.Submit(task, TaskExecutor::PRIORITY_NORMAL,
+                  TaskExecutor::STAGE_REQUEST);
+  }
+
+  // Returns once every request submitted has been processed.
+  void Wait() { group_.Wait(); }
+
+ private:
+  class RequestTask : public Task {
+   public:
+    explicit RequestTask(RequestRunner *runner) : runner_(runner) {}
+    RequestTask(const RequestTask &that) : Task(), runner_(that.runner_) {}
+
+    virtual void Run() { runner_->Run(this); }
+
+    scoped_ptr<DumpRequest> request;
+
+   private:
+    RequestRunner *runner_;
+  };
+
+  void Run(RequestTask *task) {
+    DaemonWorker *worker = NULL;
+    pthread_mutex_lock(&mutex_);
+    if (!free_workers_.empty()) {
+      worker = free_workers_.back();
+      free_workers_.pop_back();
+    }
+    pthread_mutex_unlock(&mutex_);
+    if (!worker) {
+      worker = new DaemonWorker(options_, module_cache_, modules_cache_,
+                                output_mutex_, frame_table_, profile_,
+                                stats_, executor_);
+      pthread_mutex_lock(&mutex_);
+      workers_.push_back(worker);
+      pthread_mutex_unlock(&mutex_);
+    }
+
+    worker->Process(*task->request);
+    task->request.reset();
+
+    pthread_mutex_lock(&mutex_);
+    free_workers_.push_back(worker);
+    free_tasks_.push_back(task);
+    pthread_cond_signal(&changed_);
+    pthread_mutex_unlock(&mutex_);
+  }
+
+  const StackwalkOptions &options_;
+  SymbolModuleCache *module_cache_;
+  CodeModulesCache *modules_cache_;
+  Mutex *output_mutex_;
+  FrameTableWriter *frame_table_;
+  StackProfile *profile_;
+  ProcessingStats *stats_;
+  TaskExecutor *executor_;
+
+  // Not resized once requests are submitted.
+  std::vector<RequestTask> tasks_;
+
+  // Guard the members below, and |changed_| is signalled when a request
+  // finishes.
+  pthread_mutex_t mutex_;
+  pthread_cond_t changed_;
+  std::vector<RequestTask*> free_tasks_;
+  std::vector<DaemonWorker*> workers_;
+  std::vector<DaemonWorker*> free_workers_;
+
+  TaskGroup group_;
+};
+#endif  // _WIN32
+
+// Serves requests from |reader| until it runs out, sharing parsed symbols
+// through |module_cache|.  Returns false if the input was malformed, no
+// worker could be started or the frame table, profile or updated unwind
+// policy could not be written.
+bool ServeRequests(const StackwalkOptions &options,
+                   RequestReader *reader,
+                   SymbolModuleCache *module_cache,
+                   ProcessingStats *stats) {
+  Mutex output_mutex;
+  CodeModulesCache modules_cache(kModuleListCacheEntries);
+  ReadRequestResult read_result;
+  unsigned long next_id = 1;
+
+  FILE *frame_table_file = NULL;
+  scoped_ptr<FrameTableWriter> frame_table;
+  if (!options.frame_table_path.empty()) {
+    frame_table_file = fopen(options.frame_table_path.c_str(), "wb");
+    if (!frame_table_file) {
+      fprintf(stderr, "Could not open %s\n", options.frame_table_path.c_str());
+      return false;
+    }
+    frame_table.reset(new FrameTableWriter(
+        frame_table_file, FrameTableWriter::kDefaultBatchRows));
+  }
+
+  scoped_ptr<StackProfile> profile;
+  if (!options.profile_path.empty())
+    profile.reset(new StackProfile);
+
+#ifndef _WIN32
+  // Requests, and the stack walks and symbol loads within them, share the
+  // executor's threads.
+  WorkStealingExecutor executor(options.thread_count);
+  if (executor.thread_count() == 0) {
+    if (frame_table_file)
+      fclose(frame_table_file);
+    return false;
+  }
+  BasicSourceLineResolver::set_load_executor(&executor);
+
+  {
+    RequestRunner runner(options, module_cache, &modules_cache,
+                         &output_mutex, frame_table.get(), profile.get(),
+                         stats, &executor, options.thread_count * 2);
+    for (;;) {
+      scoped_ptr<DumpRequest> request(new DumpRequest);
+      read_result = reader->Read(request.get());
+      if (read_result != READ_REQUEST_OK)
+        break;
+      request->id = next_id++;
+      runner.Submit(request.release());
+    }
+    runner.Wait();
+  }
+
+  BasicSourceLineResolver::set_load_executor(NULL);
+  for (int stage = 0; stage < TaskExecutor::STAGE_COUNT; ++stage) {
+    stats->stages[stage] = executor.GetStageMetrics(
+        static_cast<TaskExecutor::Stage>(stage));
+  }
+#else  // _WIN32
+  // Without threads, requests are processed one at a time as they are read.
+  DaemonWorker worker(options, module_cache, &modules_cache, &output_mutex,
+                      frame_table.get(), profile.get(), stats, NULL);
+  for (;;) {
+    DumpRequest request;
+    read_result = reader->Read(&request);
+    if (read_result != READ_REQUEST_OK)
+      break;
+    request.id = next_id++;
+    worker.Process(request);
+  }
+#endif  // _WIN32
+
+  bool frame_table_written = true;
+  if (frame_table.get()) {
+    frame_table_written = frame_table->Finish();
+    if (fclose(frame_table_file) != 0)
+      frame_table_written = false;
+    if (!frame_table_written) {
+      fprintf(stderr, "Could not write %s\n",
+              options.frame_table_path.c_str());
+    }
+  }
+
+  bool profile_written = true;
+  if (profile.get()) {
+    FILE *profile_file = fopen(options.profile_path.c_str(), "w");
+    profile_written = profile_file && profile->WriteFolded(profile_file);
+    if (profile_file && fclose(profile_file) != 0)
+      profile_written = false;
+    if (!profile_written)
+      fprintf(stderr, "Could not write %s\n", options.profile_path.c_str());
+  }
+
+  bool policy_written = true;
+  if (!options.updated_policy_path.empty()) {
+    UnwindPolicy policy;
+    if (options.unwind_policy)
+      policy = *options.unwind_policy;
+    policy.Update(stats->unwind, UnwindPolicy::UpdateOptions());
+    string text = policy.Serialize();
+    FILE *policy_file = fopen(options.updated_policy_path.c_str(), "w");
+    policy_written = policy_file &&
+        fwrite(text.data(), 1, text.size(), policy_file) == text.size();
+    if (policy_file && fclose(policy_file) != 0)
+      policy_written = false;
+    if (!policy_written) {
+      fprintf(stderr, "Could not write %s\n",
+              options.updated_policy_path.c_str());
+    }
+  }
+  return read_result == READ_REQUEST_END && frame_table_written &&
+      profile_written && policy_written;
+}
+
+// Serves requests read from stdin until the end of input.
+bool RunDaemon(const StackwalkOptions &options) {
+  SymbolModuleCache module_cache(options.symbol_cache_size);
+  StreamRequestReader reader(stdin, &module_cache);
+  ProcessingStats stats;
+  return ServeRequests(options, &reader, &module_cache, &stats);
+}
+
+// Fills |paths| with the minidumps named by |batch|: every regular file in
+// it if it is a directory, otherwise the lines of the file it names.
+bool ListBatchMinidumps(const string &batch, std::vector<string> *paths) {
+  struct stat batch_stat;
+  if (stat(batch.c_str(), &batch_stat) != 0) {
+    fprintf(stderr, "Could not find %s\n", batch.c_str());
+    return false;
+  }
+
+  if (S_ISDIR(batch_stat.st_mode)) {
+    DIR *dir = opendir(batch.c_str());
+    if (!dir) {
+      fprintf(stderr, "Could not read directory %s\n", batch.c_str());
+      return false;
+    }
+    struct dirent *entry;
+    while ((entry = readdir(dir)) != NULL) {
+      string path = batch + "/" + entry->d_name;
+      struct stat path_stat;
+      if (stat(path.c_str(), &path_stat) == 0 && S_ISREG(path_stat.st_mode))
+        paths->push_back(path);
+    }
+    closedir(dir);
+    std::sort(paths->begin(), paths->end());
+    return true;
+  }
+
+  FILE *list = fopen(batch.c_str(), "r");
+  if (!list) {
+    fprintf(stderr, "Could not open %s\n", batch.c_str());
+    return false;
+  }
+  string path;
+  while (ReadLine(list, &path))
+    paths->push_back(path);
+  fclose(list);
+  return true;
+}
+
+double SecondsSince(const struct timeval &start) {
+  struct timeval now;
+  gettimeofday(&now, NULL);
+  return (now.tv_sec - start.tv_sec) + (now.tv_usec - start.tv_usec) / 1e6;
+}
+
+// Processes every minidump named by |batch|, then reports throughput on
+// stderr.  Returns false if any minidump could not be processed.
+bool RunBatch(const StackwalkOptions &options, const string &batch) {
+  std::vector<string> paths;
+  if (!ListBatchMinidumps(batch, &paths))
+    return false;
+
+  struct timeval start;
+  gettimeofday(&start, NULL);
+
+  SymbolModuleCache module_cache(options.symbol_cache_size);
+  PathListRequestReader reader(paths);
+  ProcessingStats stats;
+  bool served = ServeRequests(options, &reader, &module_cache, &stats);
+
+  double seconds = SecondsSince(start);
+  fprintf(stderr,
+          "Processed %lu minidumps (%lu failed) in %.2f s, %.1f minidumps/s "
+          "on %u threads; %lu modules, %lu MB of symbols cached\n",
+          stats.processed, stats.failed, seconds,
+          seconds > 0 ? stats.processed / seconds : 0.0,
+          options.thread_count,
+          static_cast<unsigned long>(module_cache.module_count()),
+          static_cast<unsigned long>(module_cache.memory_used() >> 20));
+  for (int stage = 0; stage < TaskExecutor::STAGE_COUNT; ++stage) {
+    const TaskExecutor::StageMetrics &metrics = stats.stages[stage];
+    if (metrics.submitted == 0)
+      continue;
+    fprintf(stderr, "  %s tasks: %llu, %llu run while waiting, "
+            "at most %lu queued\n",
+            TaskExecutor::StageName(static_cast<TaskExecutor::Stage>(stage)),
+            static_cast<unsigned long long>(metrics.submitted),
+            static_cast<unsigned long long>(metrics.withdrawn),
+            static_cast<unsigned long>(metrics.max_queue_depth));
   }
+  return served && stats.failed == 0;
+}
 
+// Parses a positive decimal count given to option |option|.
+bool ParseCount(char option, const char *value, unsigned long *count) {
+  char *end;
+  *count = strtoul(value, &end, 10);
+  if (end == value || *end != '\0' || *count == 0) {
+    fprintf(stderr, "Invalid value for -%c: %s\n", option, value);
+    return false;
+  }
   return true;
 }
 
 void usage(const char *program_name) {
-  fprintf(stderr, "usage: %s [-m] <minidump-file> [symbol-path ...]\n"
-          "    -m : Output in machine-readable format\n",
-          program_name);
+  fprintf(stderr, "usage: %s [-m|-J] [-l] [-q] [-u policy] <minidump-file> "
+          "[symbol-path ...]\n"
+          "       %s -d [-m|-J] [-q] [-e] [-j threads] [-c megabytes] "
+          "[-a file]\n"
+          "          [-u policy] [-U file] [symbol-path ...]\n"
+          "       %s -b <directory|list-file> [-J] [-q] [-e] "
+          "[-j threads]\n"
+          "          [-c megabytes] [-a file] [-F file] [-u policy] "
+          "[-U file]\n"
+          "          [symbol-path ...]\n"
+          "    Each symbol-path is a symbol store directory or a symbol pack "
+          "file\n"
+          "    -m : Output in machine-readable format\n"
+          "    -J : Output in JSON format, one line per minidump\n"
+          "    -l : Parse only the needed parts of symbol files that have "
+          "a .sym.idx\n"
+          "         index\n"
+          "    -q : Log errors only\n"
+          "    -e : In -d and -b modes, print the messages logged for a "
+          "minidump only\n"
+          "         if processing it fails\n"
+          "    -d : Run as a daemon, processing minidumps named or sent on "
+          "stdin\n"
+          "    -b : Process every minidump in a directory or named in a "
+          "list file,\n"
+          "         in machine-readable format unless -J is given\n"
+          "    -j : Number of minidumps processed at once in -d and -b modes "
+          "(default 1)\n"
+          "    -c : Megabytes of parsed symbols kept between minidumps in -d "
+          "and -b\n"
+          "         modes (default %d)\n"
+          "    -a : In -d and -b modes, also write the stack frames of every "
+          "minidump\n"
+          "         to a file as an Arrow IPC stream, one row per frame\n"
+          "    -F : In -b mode, write the stacks of every minidump to a "
+          "file as one\n"
+          "         folded-stack profile instead of printing each result\n"
+          "    -u : Follow the unwind policy in a file, skipping the "
+          "methods of finding\n"
+          "         callers it lists as futile for a module\n"
+          "    -U : In -d and -b modes, write the unwind policy updated "
+          "from the\n"
+          "         minidumps processed to a file\n",
+          program_name, program_name, program_name,
+          static_cast<int>(kDefaultSymbolCacheMegabytes));
 }
 
 }  // namespace
@@ -106,38 +961,104 @@ void usage(const char *program_name) {
 int main(int argc, char **argv) {
   BPLOG_INIT(&argc, &argv);
 
-  if (argc < 2) {
+  StackwalkOptions options;
+  UnwindPolicy unwind_policy;
+  bool daemon = false;
+  const char *batch = NULL;
+  unsigned long count;
+  int ch;
+  while ((ch = getopt(argc, argv, "hmJlqedb:j:c:a:F:u:U:")) != -1) {
+    switch (ch) {
+      case 'm':
+        options.output_format = OUTPUT_MACHINE_READABLE;
+        break;
+      case 'J':
+        options.output_format = OUTPUT_JSON;
+        break;
+      case 'l':
+        options.load_modules_lazily = true;
+        break;
+      case 'q':
+        LogStream::set_minimum_severity(LogStream::SEVERITY_ERROR);
+        break;
+      case 'e':
+        options.log_failures_only = true;
+        break;
+      case 'd':
+        daemon = true;
+        break;
+      case 'b':
+        batch = optarg;
+        break;
+      case 'j':
+        if (!ParseCount('j', optarg, &count))
+          return 1;
+        options.thread_count = count;
+        break;
+      case 'c':
+        if (!ParseCount('c', optarg, &count))
+          return 1;
+        options.symbol_cache_size = static_cast<size_t>(count) << 20;
+        break;
+      case 'a':
+        options.frame_table_path = optarg;
+        break;
+      case 'F':
+        options.profile_path = optarg;
+        break;
+      case 'u':
+        if (!unwind_policy.LoadFromFile(optarg)) {
+          fprintf(stderr, "Could not load unwind policy %s\n", optarg);
+          return 1;
+        }
+        options.unwind_policy = &unwind_policy;
+        break;
+      case 'U':
+        options.updated_policy_path = optarg;
+        break;
+      default:
+        usage(argv[0]);
+        return 1;
+    }
+  }
+
+  int symbol_path_arg = optind;
+  const char *minidump_file = NULL;
+  if ((daemon && batch) ||
+      ((daemon || batch) && options.load_modules_lazily) ||
+      (!batch && !options.profile_path.empty()) ||
+      (!daemon && !batch &&
+       (options.log_failures_only || !options.frame_table_path.empty() ||
+        !options.updated_policy_path.empty()))) {
     usage(argv[0]);
     return 1;
   }
 
-  const char *minidump_file;
-  bool machine_readable;
-  int symbol_path_arg;
-
-  if (strcmp(argv[1], "-m") == 0) {
-    if (argc < 3) {
+  if (!daemon && !batch) {
+    if (optind >= argc) {
       usage(argv[0]);
       return 1;
     }
-
-    machine_readable = true;
-    minidump_file = argv[2];
-    symbol_path_arg = 3;
-  } else {
-    machine_readable = false;
-    minidump_file = argv[1];
-    symbol_path_arg = 2;
+    minidump_file = argv[optind];
+    symbol_path_arg = optind + 1;
   }
 
   // extra arguments are symbol paths
-  std::vector<string> symbol_paths;
-  if (argc > symbol_path_arg) {
-    for (int argi = symbol_path_arg; argi < argc; ++argi)
-      symbol_paths.push_back(argv[argi]);
+  for (int argi = symbol_path_arg; argi < argc; ++argi)
+    options.symbol_paths.push_back(argv[argi]);
+
+  if (daemon)
+    return RunDaemon(options) ? 0 : 1;
+
+  if (batch) {
+    if (options.output_format == OUTPUT_TEXT)
+      options.output_format = OUTPUT_MACHINE_READABLE;
+    return RunBatch(options, batch) ? 0 : 1;
   }
 
   return PrintMinidumpProcess(minidump_file,
-                              symbol_paths,
-                              machine_readable) ? 0 : 1;
+                              options.symbol_paths,
+                              options.output_format,
+                              options.load_modules_lazily,
+                              options.unwind_policy) ? 0 : 1;
 }
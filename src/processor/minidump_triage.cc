@@ -0,0 +1,210 @@
+// Copyright (c) 2016 Google Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+// notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above
+// copyright notice, this list of conditions and the following disclaimer
+// in the documentation and/or other materials provided with the
+// distribution.
+//     * Neither the name of Google Inc. nor the names of its
+// contributors may be used to endorse or promote products derived from
+// this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+// minidump_triage.cc: Check minidumps with MinidumpValidator before
+// processing them.
+//
+// minidump_triage checks each minidump named on the command line, or on
+// stdin, one per line, if there are none, and writes a line of JSON for
+// each to stdout:
+//
+// {"path", "verdict", "process_result",
+//  "problems": [{"code", "detail", "fatal"}, ...],
+//  "crash_reason", "crash_address", "requesting_thread",
+//  "instruction_pointer", "instruction_module", "instruction_offset",
+//  "modules": [{"debug_file", "debug_id"}, ...]}
+//
+// "verdict" is "valid", "degraded" or "invalid", and "process_result" is
+// the ProcessResult that MinidumpProcessor::Process would return if the
+// minidump is invalid, or 0.  Addresses and offsets are hexadecimal
+// strings, "instruction_module" is an index in "modules", and members
+// that are unknown are omitted.  The exit status is 0 unless a minidump
+// is invalid.
+//
+// Minidumps are mapped into memory, and only their header, directory
+// and the streams that processing depends on are read.
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <string>
+
+#include "common/using_std_string.h"
+#include "google_breakpad/processor/minidump.h"
+#include "google_breakpad/processor/minidump_validator.h"
+#include "processor/logging.h"
+
+namespace {
+
+using google_breakpad::Minidump;
+using google_breakpad::MinidumpValidator;
+
+// Appends |value| to |*out| as a JSON string.
+void AppendString(const string &value, string *out) {
+  static const char kHexDigits[] = "0123456789abcdef";
+  out->push_back('"');
+  for (size_t i = 0; i < value.size(); ++i) {
+    unsigned char c = value[i];
+    if (c == '"' || c == '\\') {
+      out->push_back('\\');
+      out->push_back(c);
+    } else if (c < 0x20) {
+      char escape[6] = { '\\', 'u', '0', '0',
+                         kHexDigits[c >> 4], kHexDigits[c & 0xf] };
+      out->append(escape, sizeof(escape));
+    } else {
+      out->push_back(c);
+    }
+  }
+  out->push_back('"');
+}
+
+void AppendKey(const char *name, string *out) {
+  if ((*out)[out->size() - 1] != '{')
+    out->push_back(',');
+  AppendString(name, out);
+  out->push_back(':');
+}
+
+void AppendAddress(const char *name, uint64_t value, string *out) {
+  char hex[24];
+  snprintf(hex, sizeof(hex), "0x%llx",
+           static_cast<unsigned long long>(value));
+  AppendKey(name, out);
+  AppendString(hex, out);
+}
+
+// Writes the JSON line for the minidump at |path|, reusing |dump| and
+// |result|.  Returns false if the minidump is invalid.
+bool Triage(const string &path, Minidump *dump,
+            MinidumpValidator::Result *result, string *line) {
+  dump->Reset(path);
+  MinidumpValidator::Validate(dump, result);
+
+  line->assign("{");
+  AppendKey("path", line);
+  AppendString(path, line);
+  AppendKey("verdict", line);
+  AppendString(MinidumpValidator::VerdictName(result->verdict), line);
+  char number[16];
+  snprintf(number, sizeof(number), "%d",
+           static_cast<int>(result->process_result));
+  AppendKey("process_result", line);
+  line->append(number);
+
+  AppendKey("problems", line);
+  line->push_back('[');
+  for (size_t i = 0; i < result->problems.size(); ++i) {
+    const MinidumpValidator::Problem &problem = result->problems[i];
+    line->append(i == 0 ? "{" : ",{");
+    AppendKey("code", line);
+    AppendString(problem.code, line);
+    if (!problem.detail.empty()) {
+      AppendKey("detail", line);
+      AppendString(problem.detail, line);
+    }
+    AppendKey("fatal", line);
+    line->append(problem.fatal ? "true" : "false");
+    line->push_back('}');
+  }
+  line->push_back(']');
+
+  if (result->crashed) {
+    AppendKey("crash_reason", line);
+    AppendString(result->crash_reason, line);
+    AppendAddress("crash_address", result->crash_address, line);
+  }
+  if (result->has_requesting_thread)
+    AppendAddress("requesting_thread", result->requesting_thread_id, line);
+  if (result->has_instruction_pointer)
+    AppendAddress("instruction_pointer", result->instruction_pointer, line);
+  if (result->instruction_module >= 0) {
+    snprintf(number, sizeof(number), "%d", result->instruction_module);
+    AppendKey("instruction_module", line);
+    line->append(number);
+    AppendAddress("instruction_offset", result->instruction_offset, line);
+  }
+
+  AppendKey("modules", line);
+  line->push_back('[');
+  for (size_t i = 0; i < result->modules.size(); ++i) {
+    line->append(i == 0 ? "{" : ",{");
+    AppendKey("debug_file", line);
+    AppendString(result->modules[i].debug_file, line);
+    AppendKey("debug_id", line);
+    AppendString(result->modules[i].debug_identifier, line);
+    line->push_back('}');
+  }
+  line->append("]}\n");
+
+  fwrite(line->data(), 1, line->size(), stdout);
+  fflush(stdout);
+  return result->verdict != MinidumpValidator::VERDICT_INVALID;
+}
+
+void usage(const char *program_name) {
+  fprintf(stderr, "usage: %s [minidump-file ...]\n"
+          "    Checks each minidump, or those named on stdin, without "
+          "processing it\n",
+          program_name);
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+  BPLOG_INIT(&argc, &argv);
+
+  if (getopt(argc, argv, "h") != -1) {
+    usage(argv[0]);
+    return 1;
+  }
+
+  Minidump dump("", true);
+  MinidumpValidator::Result result;
+  string line;
+  bool all_valid = true;
+  if (optind < argc) {
+    for (int argi = optind; argi < argc; ++argi)
+      all_valid &= Triage(argv[argi], &dump, &result, &line);
+    return all_valid ? 0 : 1;
+  }
+
+  char path[4096];
+  while (fgets(path, sizeof(path), stdin)) {
+    size_t length = strlen(path);
+    while (length > 0 && (path[length - 1] == '\n' ||
+                          path[length - 1] == '\r')) {
+      path[--length] = '\0';
+    }
+    if (length > 0)
+      all_valid &= Triage(path, &dump, &result, &line);
+  }
+  return all_valid ? 0 : 1;
+}
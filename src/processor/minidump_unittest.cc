@@ -30,31 +30,45 @@
 // Unit test for Minidump.  Uses a pre-generated minidump and
 // verifies that certain streams are correct.
 
+#include <algorithm>
 #include <iostream>
 #include <fstream>
 #include <sstream>
+#include <pthread.h>
 #include <stdlib.h>
 #include <string>
 #include <vector>
 
 #include "breakpad_googletest_includes.h"
+#include "common/minidump_compression.h"
 #include "common/using_std_string.h"
 #include "google_breakpad/common/minidump_format.h"
+#include "google_breakpad/processor/block_caching_minidump_reader.h"
 #include "google_breakpad/processor/minidump.h"
+#include "google_breakpad/processor/minidump_reader.h"
 #include "processor/logging.h"
 #include "processor/synth_minidump.h"
 
 namespace {
 
+using google_breakpad::BlockCachingMinidumpReader;
+using google_breakpad::CodeModule;
+using google_breakpad::CodeModules;
+using google_breakpad::CompressBlock;
+using google_breakpad::CompressedMinidumpFrame;
+using google_breakpad::CompressedMinidumpHeader;
 using google_breakpad::Minidump;
 using google_breakpad::MinidumpContext;
 using google_breakpad::MinidumpException;
+using google_breakpad::MinidumpHandlerTiming;
 using google_breakpad::MinidumpMemoryInfo;
 using google_breakpad::MinidumpMemoryInfoList;
 using google_breakpad::MinidumpMemoryList;
+using google_breakpad::MinidumpMemoryReadLog;
 using google_breakpad::MinidumpMemoryRegion;
 using google_breakpad::MinidumpModule;
 using google_breakpad::MinidumpModuleList;
+using google_breakpad::MinidumpReader;
 using google_breakpad::MinidumpSystemInfo;
 using google_breakpad::MinidumpThread;
 using google_breakpad::MinidumpThreadList;
@@ -119,6 +133,256 @@ TEST_F(MinidumpTest, TestMinidumpFromStream) {
   //TODO: add more checks here
 }
 
+// A MinidumpReader over a string, which counts the reads made of it.
+class StringMinidumpReader : public MinidumpReader {
+ public:
+  explicit StringMinidumpReader(const string& contents)
+      : contents_(contents), reads_(0), bytes_read_(0) {}
+
+  virtual uint64_t size() const { return contents_.size(); }
+  virtual bool ReadAt(uint64_t offset, void* buffer, size_t count) {
+    ++reads_;
+    bytes_read_ += count;
+    if (offset > contents_.size() || count > contents_.size() - offset)
+      return false;
+    memcpy(buffer, contents_.data() + offset, count);
+    return true;
+  }
+
+  int reads() const { return reads_; }
+  size_t bytes_read() const { return bytes_read_; }
+
+ private:
+  string contents_;
+  int reads_;
+  size_t bytes_read_;
+};
+
+TEST(BlockCachingMinidumpReaderTest, ReadsWholeBlocks) {
+  string contents;
+  for (int i = 0; i < 1000; ++i)
+    contents += static_cast<char>(i * 7);
+  StringMinidumpReader source(contents);
+  BlockCachingMinidumpReader reader(&source, 100, 3);
+  EXPECT_EQ(1000U, reader.size());
+
+  // A read is rounded out to the blocks it touches, fetched in one go.
+  char buffer[400];
+  ASSERT_TRUE(reader.ReadAt(150, buffer, 100));
+  EXPECT_EQ(0, memcmp(buffer, contents.data() + 150, 100));
+  EXPECT_EQ(1, source.reads());
+  EXPECT_EQ(200U, source.bytes_read());
+  EXPECT_EQ(2U, reader.cached_blocks());
+
+  // Reads within those blocks need nothing more.
+  ASSERT_TRUE(reader.ReadAt(100, buffer, 4));
+  ASSERT_TRUE(reader.ReadAt(296, buffer, 4));
+  EXPECT_EQ(0, memcmp(buffer, contents.data() + 296, 4));
+  EXPECT_EQ(1, source.reads());
+
+  // Only the missing block is fetched, and the least recently used one is
+  // then dropped.
+  ASSERT_TRUE(reader.ReadAt(250, buffer, 100));
+  EXPECT_EQ(0, memcmp(buffer, contents.data() + 250, 100));
+  ASSERT_TRUE(reader.ReadAt(950, buffer, 50));
+  EXPECT_EQ(0, memcmp(buffer, contents.data() + 950, 50));
+  EXPECT_EQ(3, source.reads());
+  EXPECT_EQ(400U, source.bytes_read());
+  EXPECT_EQ(3U, reader.cached_blocks());
+  ASSERT_TRUE(reader.ReadAt(150, buffer, 1));
+  EXPECT_EQ(4, source.reads());
+
+  // Reads larger than the cache go straight to the source.
+  ASSERT_TRUE(reader.ReadAt(0, buffer, 400));
+  EXPECT_EQ(0, memcmp(buffer, contents.data(), 400));
+  EXPECT_EQ(5, source.reads());
+
+  // Reads past the end fail without reaching the source.
+  EXPECT_FALSE(reader.ReadAt(990, buffer, 11));
+  EXPECT_FALSE(reader.ReadAt(1001, buffer, 0));
+  EXPECT_EQ(5, source.reads());
+}
+
+TEST_F(MinidumpTest, TestMinidumpFromReader) {
+  ifstream file_stream(minidump_file_.c_str(), std::ios::in);
+  ASSERT_TRUE(file_stream.good());
+  std::stringstream contents;
+  contents << file_stream.rdbuf();
+
+  StringMinidumpReader source(contents.str());
+  BlockCachingMinidumpReader reader(&source, 1024, 16);
+  Minidump reader_minidump(&reader);
+  ASSERT_EQ("", reader_minidump.path());
+  ASSERT_TRUE(reader_minidump.Read());
+  EXPECT_TRUE(reader_minidump.GetMappedBytes(0, 1) == NULL);
+
+  Minidump minidump(minidump_file_);
+  ASSERT_TRUE(minidump.Read());
+
+  MinidumpModuleList* reader_module_list = reader_minidump.GetModuleList();
+  MinidumpModuleList* module_list = minidump.GetModuleList();
+  ASSERT_TRUE(reader_module_list != NULL);
+  ASSERT_TRUE(module_list != NULL);
+  ASSERT_EQ(module_list->module_count(), reader_module_list->module_count());
+  const MinidumpModule* reader_module =
+      reader_module_list->GetModuleAtIndex(0);
+  EXPECT_EQ(module_list->GetModuleAtIndex(0)->debug_identifier(),
+            reader_module->debug_identifier());
+
+  MinidumpThreadList* reader_thread_list = reader_minidump.GetThreadList();
+  ASSERT_TRUE(reader_thread_list != NULL);
+  ASSERT_EQ(minidump.GetThreadList()->thread_count(),
+            reader_thread_list->thread_count());
+  MinidumpMemoryRegion* reader_stack =
+      reader_thread_list->GetThreadAtIndex(0)->GetMemory();
+  MinidumpMemoryRegion* stack =
+      minidump.GetThreadList()->GetThreadAtIndex(0)->GetMemory();
+  ASSERT_TRUE(reader_stack != NULL);
+  ASSERT_EQ(stack->GetSize(), reader_stack->GetSize());
+  EXPECT_EQ(0, memcmp(stack->GetMemory(), reader_stack->GetMemory(),
+                      stack->GetSize()));
+
+  // Only the parts of the dump that were used were fetched, a block at a
+  // time.
+  EXPECT_LT(reader.source_bytes(), reader.size());
+  EXPECT_LT(source.reads(), 16);
+}
+
+TEST_F(MinidumpTest, TestMinidumpMappedFile) {
+  Minidump mapped_minidump(minidump_file_, true);
+  ASSERT_EQ(mapped_minidump.path(), minidump_file_);
+  ASSERT_TRUE(mapped_minidump.Read());
+  const MDRawHeader* header = mapped_minidump.header();
+  ASSERT_NE(header, (MDRawHeader*)NULL);
+  ASSERT_EQ(header->signature, uint32_t(MD_HEADER_SIGNATURE));
+  const uint8_t* mapping = mapped_minidump.GetMappedBytes(0, 1);
+  ASSERT_TRUE(mapping != NULL);
+
+  // The mapped minidump must agree with the same minidump read as a stream.
+  Minidump minidump(minidump_file_);
+  ASSERT_TRUE(minidump.Read());
+  EXPECT_TRUE(minidump.GetMappedBytes(0, 1) == NULL);
+
+  MinidumpModuleList* mapped_module_list = mapped_minidump.GetModuleList();
+  MinidumpModuleList* module_list = minidump.GetModuleList();
+  ASSERT_TRUE(mapped_module_list != NULL);
+  ASSERT_TRUE(module_list != NULL);
+  ASSERT_EQ(module_list->module_count(), mapped_module_list->module_count());
+  for (unsigned int i = 0; i < module_list->module_count(); ++i) {
+    const MinidumpModule* mapped_module =
+        mapped_module_list->GetModuleAtIndex(i);
+    const MinidumpModule* module = module_list->GetModuleAtIndex(i);
+    EXPECT_EQ(module->code_file(), mapped_module->code_file());
+    EXPECT_EQ(module->debug_file(), mapped_module->debug_file());
+    EXPECT_EQ(module->debug_identifier(), mapped_module->debug_identifier());
+  }
+
+  MinidumpMemoryList* mapped_memory_list = mapped_minidump.GetMemoryList();
+  MinidumpMemoryList* memory_list = minidump.GetMemoryList();
+  ASSERT_TRUE(mapped_memory_list != NULL);
+  ASSERT_TRUE(memory_list != NULL);
+  ASSERT_EQ(memory_list->region_count(), mapped_memory_list->region_count());
+  for (unsigned int i = 0; i < memory_list->region_count(); ++i) {
+    MinidumpMemoryRegion* mapped_region =
+        mapped_memory_list->GetMemoryRegionAtIndex(i);
+    MinidumpMemoryRegion* region = memory_list->GetMemoryRegionAtIndex(i);
+    ASSERT_EQ(region->GetSize(), mapped_region->GetSize());
+    const uint8_t* mapped_bytes = mapped_region->GetMemory();
+    const uint8_t* bytes = region->GetMemory();
+    ASSERT_TRUE(mapped_bytes != NULL);
+    ASSERT_TRUE(bytes != NULL);
+    EXPECT_EQ(0, memcmp(bytes, mapped_bytes, region->GetSize()));
+    // The mapped region's contents are not copied.
+    EXPECT_TRUE(mapped_bytes > mapping);
+  }
+}
+
+// Appends a frame holding |size| bytes of |data| for |offset| to
+// |compressed|, compressing the bytes if that saves space.
+static void AppendFrame(string* compressed, uint64_t offset,
+                        const char* data, size_t size) {
+  vector<uint8_t> block(size + 1);
+  vector<uint16_t> hash_table(google_breakpad::kCompressBlockHashTableSize);
+  CompressedMinidumpFrame frame;
+  frame.offset = offset;
+  frame.size = size;
+  frame.stored_size = size ? CompressBlock(
+      reinterpret_cast<const uint8_t*>(data), size, &block[0], size - 1,
+      &hash_table[0]) : 0;
+  if (size && !frame.stored_size) {
+    memcpy(&block[0], data, size);
+    frame.stored_size = size;
+  }
+  compressed->append(reinterpret_cast<const char*>(&frame), sizeof(frame));
+  compressed->append(reinterpret_cast<const char*>(&block[0]),
+                     frame.stored_size);
+}
+
+TEST_F(MinidumpTest, TestCompressedMinidump) {
+  ifstream file_stream(minidump_file_.c_str(), std::ios::in);
+  ASSERT_TRUE(file_stream.good());
+  std::stringstream contents;
+  contents << file_stream.rdbuf();
+  const string plain = contents.str();
+
+  // Write the body in frames, the header last as a writer filling it in
+  // afterwards would, and finish with a frame recording the size.
+  string compressed;
+  CompressedMinidumpHeader header = {
+    google_breakpad::kCompressedMinidumpSignature,
+    google_breakpad::kCompressedMinidumpVersion
+  };
+  compressed.append(reinterpret_cast<const char*>(&header), sizeof(header));
+  const size_t kHeaderSize = sizeof(MDRawHeader);
+  const size_t kFrameSize = google_breakpad::kCompressedMinidumpMaxFrameSize;
+  for (size_t offset = kHeaderSize; offset < plain.size();
+       offset += kFrameSize) {
+    AppendFrame(&compressed, offset, plain.data() + offset,
+                std::min(kFrameSize, plain.size() - offset));
+  }
+  AppendFrame(&compressed, 0, plain.data(), kHeaderSize);
+  AppendFrame(&compressed, plain.size(), NULL, 0);
+  EXPECT_LT(compressed.size(), plain.size());
+
+  Minidump plain_minidump(minidump_file_);
+  ASSERT_TRUE(plain_minidump.Read());
+  istringstream stream(compressed);
+  Minidump stream_minidump(stream);
+  ASSERT_TRUE(stream_minidump.Read());
+  Minidump buffer_minidump(reinterpret_cast<const uint8_t*>(compressed.data()),
+                           compressed.size());
+  ASSERT_TRUE(buffer_minidump.Read());
+
+  Minidump* minidumps[] = { &stream_minidump, &buffer_minidump };
+  for (size_t i = 0; i < sizeof(minidumps) / sizeof(minidumps[0]); ++i) {
+    Minidump* minidump = minidumps[i];
+    EXPECT_EQ(0, memcmp(plain_minidump.header(), minidump->header(),
+                        sizeof(MDRawHeader)));
+    ASSERT_TRUE(minidump->GetModuleList());
+    EXPECT_EQ(plain_minidump.GetModuleList()->module_count(),
+              minidump->GetModuleList()->module_count());
+    MinidumpMemoryList* memory_list = minidump->GetMemoryList();
+    MinidumpMemoryList* plain_memory_list = plain_minidump.GetMemoryList();
+    ASSERT_TRUE(memory_list);
+    ASSERT_EQ(plain_memory_list->region_count(), memory_list->region_count());
+    for (unsigned int j = 0; j < memory_list->region_count(); ++j) {
+      MinidumpMemoryRegion* region = memory_list->GetMemoryRegionAtIndex(j);
+      MinidumpMemoryRegion* plain_region =
+          plain_memory_list->GetMemoryRegionAtIndex(j);
+      ASSERT_EQ(plain_region->GetSize(), region->GetSize());
+      EXPECT_EQ(0, memcmp(plain_region->GetMemory(), region->GetMemory(),
+                          region->GetSize()));
+    }
+  }
+
+  // A frame claiming more data than follows it is rejected.
+  string truncated = compressed.substr(0, sizeof(header) +
+                                       sizeof(CompressedMinidumpFrame) + 1);
+  istringstream truncated_stream(truncated);
+  Minidump truncated_minidump(truncated_stream);
+  EXPECT_FALSE(truncated_minidump.Read());
+}
+
 TEST(Dump, ReadBackEmpty) {
   Dump dump(0);
   dump.Finish();
@@ -206,7 +470,264 @@ TEST(Dump, OneMemory) {
   ASSERT_TRUE(memcmp("memory contents", region1_bytes, 15) == 0);
 }
 
+TEST(Dump, OneMemoryFromBuffer) {
+  Dump dump(0, kBigEndian);
+  Memory memory(dump, 0x309d68010bd21b2cULL);
+  memory.Append("memory contents");
+  dump.Add(&memory);
+  dump.Finish();
+
+  string contents;
+  ASSERT_TRUE(dump.GetContents(&contents));
+  const uint8_t* data = reinterpret_cast<const uint8_t*>(contents.data());
+  Minidump minidump(data, contents.size());
+  ASSERT_TRUE(minidump.Read());
+  ASSERT_EQ(1U, minidump.GetDirectoryEntryCount());
+  EXPECT_TRUE(minidump.GetMappedBytes(0, contents.size()) == data);
+  EXPECT_TRUE(minidump.GetMappedBytes(0, contents.size() + 1) == NULL);
+
+  MinidumpMemoryList *memory_list = minidump.GetMemoryList();
+  ASSERT_TRUE(memory_list != NULL);
+  ASSERT_EQ(1U, memory_list->region_count());
+
+  MinidumpMemoryRegion *region1 = memory_list->GetMemoryRegionAtIndex(0);
+  ASSERT_EQ(0x309d68010bd21b2cULL, region1->GetBase());
+  ASSERT_EQ(15U, region1->GetSize());
+  const uint8_t *region1_bytes = region1->GetMemory();
+  ASSERT_TRUE(memcmp("memory contents", region1_bytes, 15) == 0);
+  // The region is used in place.
+  EXPECT_TRUE(region1_bytes >= data &&
+              region1_bytes + 15 <= data + contents.size());
+}
+
+// More memory regions than the old fixed limit allowed, fetched lazily.
+TEST(Dump, ManyMemoryRegions) {
+  const unsigned int kRegionCount = 5000;
+  Dump dump(0, kLittleEndian);
+  vector<Memory*> memories;
+  for (unsigned int i = 0; i < kRegionCount; ++i) {
+    Memory* memory = new Memory(dump, 0x10000000ULL + i * 0x1000);
+    memory->D32(i);
+    dump.Add(memory);
+    memories.push_back(memory);
+  }
+  dump.Finish();
+
+  string contents;
+  ASSERT_TRUE(dump.GetContents(&contents));
+  for (unsigned int i = 0; i < memories.size(); ++i)
+    delete memories[i];
+
+  istringstream minidump_stream(contents);
+  Minidump minidump(minidump_stream);
+  ASSERT_TRUE(minidump.Read());
+
+  MinidumpMemoryList *memory_list = minidump.GetMemoryList();
+  ASSERT_TRUE(memory_list != NULL);
+  ASSERT_EQ(kRegionCount, memory_list->region_count());
+
+  MinidumpMemoryRegion *region =
+      memory_list->GetMemoryRegionForAddress(0x10000000ULL + 4567 * 0x1000 + 2);
+  ASSERT_TRUE(region != NULL);
+  EXPECT_EQ(0x10000000ULL + 4567 * 0x1000, region->GetBase());
+  uint32_t value;
+  ASSERT_TRUE(region->GetMemoryAtAddress(region->GetBase(), &value));
+  EXPECT_EQ(4567U, value);
+  // Asking again returns the same region.
+  EXPECT_EQ(region, memory_list->GetMemoryRegionAtIndex(4567));
+  EXPECT_TRUE(memory_list->GetMemoryRegionForAddress(0x0fff0000ULL) == NULL);
+}
+
+TEST(Dump, ContiguousMemory) {
+  const uint16_t kOne = 1;
+  const bool host_little_endian =
+      *reinterpret_cast<const uint8_t*>(&kOne) == 1;
+
+  for (int i = 0; i < 2; ++i) {
+    bool little_endian = i == 0;
+    Dump dump(0, little_endian ? kLittleEndian : kBigEndian);
+    Memory memory(dump, 0x1000);
+    memory.D32(0x01234567).D32(0x89abcdef);
+    dump.Add(&memory);
+    dump.Finish();
+
+    string contents;
+    ASSERT_TRUE(dump.GetContents(&contents));
+    istringstream minidump_stream(contents);
+    Minidump minidump(minidump_stream);
+    ASSERT_TRUE(minidump.Read());
+    MinidumpMemoryRegion *region =
+        minidump.GetMemoryList()->GetMemoryRegionAtIndex(0);
+    ASSERT_TRUE(region != NULL);
+
+    const uint8_t *view = region->GetContiguousMemory(0x1004, 4);
+    if (little_endian != host_little_endian) {
+      // The values would need swapping.
+      EXPECT_TRUE(view == NULL);
+      continue;
+    }
+    ASSERT_TRUE(view != NULL);
+    uint32_t value;
+    memcpy(&value, view, sizeof(value));
+    EXPECT_EQ(0x89abcdefU, value);
+    EXPECT_TRUE(region->GetContiguousMemory(0x1000, 8) == view - 4);
+    EXPECT_TRUE(region->GetContiguousMemory(0x1004, 5) == NULL);
+    EXPECT_TRUE(region->GetContiguousMemory(0x0fff, 4) == NULL);
+  }
+}
+
+TEST(Dump, MemorySpans) {
+  Dump dump(0, kLittleEndian);
+  Memory low(dump, 0x1000);
+  low.D32(0x01234567).D32(0x89abcdef);
+  Memory high(dump, 0x2000);
+  high.D32(0xfeedface);
+  dump.Add(&low);
+  dump.Add(&high);
+  dump.Finish();
+
+  string contents;
+  ASSERT_TRUE(dump.GetContents(&contents));
+  const uint8_t* data = reinterpret_cast<const uint8_t*>(contents.data());
+  Minidump minidump(data, contents.size());
+  ASSERT_TRUE(minidump.Read());
+  MinidumpMemoryList* memory_list = minidump.GetMemoryList();
+  ASSERT_TRUE(memory_list != NULL);
+
+  // Out of address order, with misses and a span crossing a region's end.
+  const MinidumpMemoryList::SpanRequest requests[] = {
+    { 0x2000, 4 },
+    { 0x1004, 4 },
+    { 0x1800, 4 },
+    { 0x1000, 8 },
+    { 0x1004, 5 },
+    { 0x2000, 4 },
+  };
+  const size_t kCount = sizeof(requests) / sizeof(requests[0]);
+  const uint8_t* spans[kCount];
+  EXPECT_EQ(4U, memory_list->GetMemorySpans(requests, kCount, spans));
+
+  const uint16_t kOne = 1;
+  if (*reinterpret_cast<const uint8_t*>(&kOne) != 1) {
+    // The values would need swapping, so the big-endian host finds none.
+    return;
+  }
+  uint32_t value;
+  ASSERT_TRUE(spans[0] != NULL);
+  memcpy(&value, spans[0], sizeof(value));
+  EXPECT_EQ(0xfeedfaceU, value);
+  ASSERT_TRUE(spans[1] != NULL);
+  memcpy(&value, spans[1], sizeof(value));
+  EXPECT_EQ(0x89abcdefU, value);
+  EXPECT_TRUE(spans[2] == NULL);
+  EXPECT_TRUE(spans[3] == spans[1] - 4);
+  EXPECT_TRUE(spans[4] == NULL);
+  EXPECT_TRUE(spans[5] == spans[0]);
+
+  // The spans point into the minidump's own bytes.
+  EXPECT_TRUE(spans[0] >= data && spans[0] < data + contents.size());
+  EXPECT_TRUE(spans[1] >= data && spans[1] < data + contents.size());
+}
+
+TEST(Dump, MemoryReadLog) {
+  MinidumpMemoryReadLog log;
+  log.Add(0x1010, 8);
+  log.Add(0x1000, 4);
+  log.Add(0x1004, 4);
+  log.Add(0x1008, 8);
+  log.Add(0x2000, 0);
+  log.Add(0x3000, 4);
+  log.Add(0x3001, 2);
+  MinidumpMemoryReadLog::RangeMap ranges = log.ranges();
+  ASSERT_EQ(2U, ranges.size());
+  EXPECT_EQ(0x1018U, ranges[0x1000]);
+  EXPECT_EQ(0x3004U, ranges[0x3000]);
+  log.Add(0x0ff0, 0x3000);
+  ranges = log.ranges();
+  ASSERT_EQ(1U, ranges.size());
+  EXPECT_EQ(0x3ff0U, ranges[0x0ff0]);
+
+  // Reads through a minidump's memory regions are recorded, and misses
+  // aren't.
+  Dump dump(0, kLittleEndian);
+  Memory memory(dump, 0x1000);
+  memory.D32(0x01234567).D32(0x89abcdef).D32(0xfeedface);
+  dump.Add(&memory);
+  dump.Finish();
+  string contents;
+  ASSERT_TRUE(dump.GetContents(&contents));
+  istringstream minidump_stream(contents);
+  Minidump minidump(minidump_stream);
+  ASSERT_TRUE(minidump.Read());
+  log.Clear();
+  minidump.set_memory_read_log(&log);
+  MinidumpMemoryRegion *region =
+      minidump.GetMemoryList()->GetMemoryRegionAtIndex(0);
+  ASSERT_TRUE(region != NULL);
+  uint32_t value;
+  EXPECT_TRUE(region->GetMemoryAtAddress(0x1008, &value));
+  EXPECT_FALSE(region->GetMemoryAtAddress(0x100a, &value));
+  ranges = log.ranges();
+  ASSERT_EQ(1U, ranges.size());
+  EXPECT_EQ(0x100cU, ranges[0x1008]);
+  if (region->GetContiguousMemory(0x1000, 4)) {
+    ranges = log.ranges();
+    ASSERT_EQ(2U, ranges.size());
+    EXPECT_EQ(0x1004U, ranges[0x1000]);
+  }
+}
+
 // One thread --- and its requisite entourage.
+TEST(Dump, OneThreadBigEndian) {
+  Dump dump(0, kBigEndian);
+  Memory stack(dump, 0x309d68010bd21b2cULL);
+  stack.Append("stack for thread");
+
+  MDRawContextMIPS raw_context;
+  memset(&raw_context, 0, sizeof(raw_context));
+  raw_context.context_flags = MD_CONTEXT_MIPS_INTEGER;
+  Context context(dump, raw_context);
+
+  Thread thread(dump, 0xa898f11b, stack, context,
+                0x9e39439f, 0x4abfc15f, 0xe499898a, 0x0d43e939dcfd0372ULL);
+
+  dump.Add(&stack);
+  dump.Add(&context);
+  dump.Add(&thread);
+  dump.Finish();
+
+  string contents;
+  ASSERT_TRUE(dump.GetContents(&contents));
+
+  istringstream minidump_stream(contents);
+  Minidump minidump(minidump_stream);
+  ASSERT_TRUE(minidump.Read());
+
+  // Every field of the thread and memory descriptors must be swapped.
+  MinidumpThreadList *thread_list = minidump.GetThreadList();
+  ASSERT_TRUE(thread_list != NULL);
+  ASSERT_EQ(1U, thread_list->thread_count());
+  const MDRawThread *raw_thread =
+      thread_list->GetThreadAtIndex(0)->thread();
+  ASSERT_TRUE(raw_thread != NULL);
+  EXPECT_EQ(0xa898f11bU, raw_thread->thread_id);
+  EXPECT_EQ(0x9e39439fU, raw_thread->suspend_count);
+  EXPECT_EQ(0x4abfc15fU, raw_thread->priority_class);
+  EXPECT_EQ(0xe499898aU, raw_thread->priority);
+  EXPECT_EQ(0x0d43e939dcfd0372ULL, raw_thread->teb);
+  EXPECT_EQ(0x309d68010bd21b2cULL, raw_thread->stack.start_of_memory_range);
+  EXPECT_EQ(16U, raw_thread->stack.memory.data_size);
+  EXPECT_EQ(sizeof(raw_context), raw_thread->thread_context.data_size);
+
+  MinidumpMemoryList *md_memory_list = minidump.GetMemoryList();
+  ASSERT_TRUE(md_memory_list != NULL);
+  ASSERT_EQ(1U, md_memory_list->region_count());
+  MinidumpMemoryRegion *md_region = md_memory_list->GetMemoryRegionAtIndex(0);
+  EXPECT_EQ(0x309d68010bd21b2cULL, md_region->GetBase());
+  EXPECT_EQ(16U, md_region->GetSize());
+  EXPECT_TRUE(memcmp("stack for thread", md_region->GetMemory(), 16) == 0);
+}
+
 TEST(Dump, OneThread) {
   Dump dump(0, kLittleEndian);
   Memory stack(dump, 0x2326a0fa);
@@ -298,6 +819,113 @@ TEST(Dump, OneThread) {
   EXPECT_EQ(0x2e951ef7U, raw_context.ss);
 }
 
+// Builds a little-endian minidump in contents with one thread for each
+// ID in thread_ids, all sharing a stack and a context.
+static void BuildThreadsDump(const vector<uint32_t>& thread_ids,
+                             string* contents) {
+  Dump dump(0, kLittleEndian);
+  Memory stack(dump, 0x2326a0fa);
+  stack.Append("stack for thread");
+  MDRawContextX86 raw_context = {};
+  raw_context.context_flags = MD_CONTEXT_X86_INTEGER | MD_CONTEXT_X86_CONTROL;
+  Context context(dump, raw_context);
+  dump.Add(&stack);
+  dump.Add(&context);
+  vector<Thread*> threads;
+  for (size_t i = 0; i < thread_ids.size(); ++i) {
+    threads.push_back(new Thread(dump, thread_ids[i], stack, context,
+                                 0, 0, 0, 0));
+    dump.Add(threads.back());
+  }
+  dump.Finish();
+  ASSERT_TRUE(dump.GetContents(contents));
+  for (size_t i = 0; i < threads.size(); ++i)
+    delete threads[i];
+}
+
+TEST(Dump, ThreadsByID) {
+  vector<uint32_t> thread_ids;
+  thread_ids.push_back(0xa898f11b);
+  thread_ids.push_back(0x0000002a);
+  thread_ids.push_back(0x7f3e2d1c);
+  string contents;
+  BuildThreadsDump(thread_ids, &contents);
+
+  istringstream minidump_stream(contents);
+  Minidump minidump(minidump_stream);
+  ASSERT_TRUE(minidump.Read());
+  MinidumpThreadList *thread_list = minidump.GetThreadList();
+  ASSERT_TRUE(thread_list != NULL);
+  ASSERT_EQ(3U, thread_list->thread_count());
+  for (unsigned int i = 0; i < thread_ids.size(); ++i) {
+    EXPECT_EQ(thread_list->GetThreadAtIndex(i),
+              thread_list->GetThreadByID(thread_ids[i]));
+  }
+  EXPECT_TRUE(thread_list->GetThreadByID(0) == NULL);
+  EXPECT_TRUE(thread_list->GetThreadByID(0x7f3e2d1d) == NULL);
+  EXPECT_TRUE(thread_list->GetThreadByID(0xffffffff) == NULL);
+}
+
+TEST(Dump, ThreadsDuplicateID) {
+  vector<uint32_t> thread_ids;
+  thread_ids.push_back(0x0000002a);
+  thread_ids.push_back(0xa898f11b);
+  thread_ids.push_back(0x0000002a);
+  string contents;
+  BuildThreadsDump(thread_ids, &contents);
+
+  istringstream minidump_stream(contents);
+  Minidump minidump(minidump_stream);
+  ASSERT_TRUE(minidump.Read());
+  EXPECT_TRUE(minidump.GetThreadList() == NULL);
+}
+
+TEST(Dump, ResetAndReuse) {
+  vector<uint32_t> first_ids;
+  first_ids.push_back(0xa898f11b);
+  first_ids.push_back(0x0000002a);
+  string first;
+  BuildThreadsDump(first_ids, &first);
+
+  vector<uint32_t> second_ids;
+  second_ids.push_back(0x7f3e2d1c);
+  string second;
+  BuildThreadsDump(second_ids, &second);
+
+  Minidump minidump(reinterpret_cast<const uint8_t*>(first.data()),
+                    first.size());
+  ASSERT_TRUE(minidump.Read());
+  MinidumpThreadList *first_list = minidump.GetThreadList();
+  ASSERT_TRUE(first_list != NULL);
+  ASSERT_EQ(2U, first_list->thread_count());
+  EXPECT_TRUE(first_list->GetThreadByID(0x0000002a) != NULL);
+
+  minidump.Reset(reinterpret_cast<const uint8_t*>(second.data()),
+                 second.size());
+  EXPECT_TRUE(minidump.header() == NULL);
+  ASSERT_TRUE(minidump.Read());
+  ASSERT_EQ(2U, minidump.GetDirectoryEntryCount());
+  MinidumpThreadList *second_list = minidump.GetThreadList();
+  ASSERT_TRUE(second_list != NULL);
+  // The thread list read from the first minidump is reused.
+  EXPECT_EQ(first_list, second_list);
+  ASSERT_EQ(1U, second_list->thread_count());
+  EXPECT_TRUE(second_list->GetThreadByID(0x0000002a) == NULL);
+  EXPECT_EQ(second_list->GetThreadAtIndex(0),
+            second_list->GetThreadByID(0x7f3e2d1c));
+  EXPECT_TRUE(minidump.GetMemoryList() != NULL);
+
+  // A dump with no thread list leaves the spare one unused.
+  Dump empty(0, kLittleEndian);
+  empty.Finish();
+  string third;
+  ASSERT_TRUE(empty.GetContents(&third));
+  minidump.Reset(reinterpret_cast<const uint8_t*>(third.data()),
+                 third.size());
+  ASSERT_TRUE(minidump.Read());
+  EXPECT_TRUE(minidump.GetThreadList() == NULL);
+}
+
 TEST(Dump, ThreadMissingMemory) {
   Dump dump(0, kLittleEndian);
   Memory stack(dump, 0x2326a0fa);
@@ -442,6 +1070,145 @@ TEST(Dump, OneModule) {
   ASSERT_EQ(0x34571371U, md_raw_module->checksum);
   ASSERT_TRUE(memcmp(&md_raw_module->version_info, &fixed_file_info,
                      sizeof(fixed_file_info)) == 0);
+
+  // Bulk lookups agree with single ones, in the caller's order.
+  const uint64_t addresses[] = {
+    0xa90206ca83eb2852ULL + 0xada542bc,  // last byte of the module
+    0xa90206ca83eb2851ULL,               // just below it
+    0xa90206ca83eb2852ULL,               // first byte
+    0xa90206ca83eb2852ULL + 0xada542bd   // just above it
+  };
+  const CodeModule* modules[4];
+  md_module_list->GetModulesForAddresses(addresses, 4, modules);
+  EXPECT_EQ(md_module, modules[0]);
+  EXPECT_TRUE(modules[1] == NULL);
+  EXPECT_EQ(md_module, modules[2]);
+  EXPECT_TRUE(modules[3] == NULL);
+  for (int i = 0; i < 4; ++i)
+    EXPECT_EQ(md_module_list->GetModuleForAddress(addresses[i]), modules[i]);
+}
+
+// Module names are read when first asked for, so a module whose name is
+// unreadable no longer makes MinidumpModuleList::Read fail: the list is
+// read, the module's getters return empty strings, and the other modules
+// can be used as before.
+TEST(Dump, ModuleWithUnreadableName) {
+  Dump dump(0, kLittleEndian);
+  String good_name(dump, "good");
+  String bad_name(dump, "bad");
+  Module good_module(dump, 0x1000, 0x1000, good_name);
+  Module bad_module(dump, 0x4000, 0x1000, bad_name);
+  dump.Add(&good_module);
+  dump.Add(&bad_module);
+  dump.Add(&good_name);
+  dump.Add(&bad_name);
+  dump.Finish();
+
+  string contents;
+  ASSERT_TRUE(dump.GetContents(&contents));
+  // Give the second name an odd length, which ReadString rejects.
+  const char kBadName[] = { 6, 0, 0, 0, 'b', 0, 'a', 0, 'd', 0 };
+  size_t bad_name_offset = contents.find(string(kBadName, sizeof(kBadName)));
+  ASSERT_NE(string::npos, bad_name_offset);
+  contents[bad_name_offset] = 5;
+
+  istringstream minidump_stream(contents);
+  Minidump minidump(minidump_stream);
+  ASSERT_TRUE(minidump.Read());
+  MinidumpModuleList *md_module_list = minidump.GetModuleList();
+  ASSERT_TRUE(md_module_list != NULL);
+  ASSERT_EQ(2U, md_module_list->module_count());
+
+  const MinidumpModule *md_module =
+      md_module_list->GetModuleForAddress(0x4800);
+  ASSERT_TRUE(md_module != NULL);
+  EXPECT_EQ(0x4000U, md_module->base_address());
+  EXPECT_EQ("", md_module->code_file());
+  EXPECT_EQ("", md_module->debug_file());
+  EXPECT_EQ("", md_module->debug_identifier());
+
+  md_module = md_module_list->GetModuleForAddress(0x1800);
+  ASSERT_TRUE(md_module != NULL);
+  EXPECT_EQ("good", md_module->code_file());
+
+  // A copy, such as MinidumpProcessor keeps, holds both modules too.
+  const CodeModules* copy = md_module_list->Copy();
+  EXPECT_EQ(2U, copy->module_count());
+  EXPECT_EQ("", copy->GetModuleForAddress(0x4800)->code_file());
+  EXPECT_EQ("good", copy->GetModuleForAddress(0x1800)->code_file());
+  delete copy;
+}
+
+// Reads the names and code identifiers of all the modules in a
+// MinidumpModuleList, for ModuleNamesFromSeveralThreads.
+void* ReadModuleNames(void* list) {
+  const MinidumpModuleList* md_module_list =
+      static_cast<const MinidumpModuleList*>(list);
+  vector<string>* names = new vector<string>;
+  for (unsigned int i = 0; i < md_module_list->module_count(); ++i) {
+    const MinidumpModule* md_module = md_module_list->GetModuleAtIndex(i);
+    names->push_back(md_module->code_file() + " " +
+                     md_module->code_identifier());
+  }
+  return names;
+}
+
+// The modules of a list read their names, and the system info that their
+// code identifiers need, through the minidump's shared file position, so
+// threads asking for them at once must take turns.
+TEST(Dump, ModuleNamesFromSeveralThreads) {
+  const int kModules = 32;
+  const int kThreads = 4;
+  Dump dump(0, kLittleEndian);
+  String csd_version(dump, "Service Pack 2");
+  SystemInfo system_info(dump, SystemInfo::windows_x86, csd_version);
+  dump.Add(&system_info);
+  dump.Add(&csd_version);
+  vector<string> expected_names;
+  vector<String*> names;
+  vector<Module*> modules;
+  for (int i = 0; i < kModules; ++i) {
+    std::ostringstream name;
+    name << "module" << i;
+    // The stock time stamp and the module size, as the symbol server
+    // formats them.
+    expected_names.push_back(name.str() + " 4B44E13D1000");
+    names.push_back(new String(dump, name.str()));
+    modules.push_back(new Module(dump, 0x10000 * (i + 1), 0x1000,
+                                 *names.back()));
+    dump.Add(modules.back());
+  }
+  for (int i = 0; i < kModules; ++i)
+    dump.Add(names[i]);
+  dump.Finish();
+
+  string contents;
+  ASSERT_TRUE(dump.GetContents(&contents));
+  istringstream minidump_stream(contents);
+  Minidump minidump(minidump_stream);
+  ASSERT_TRUE(minidump.Read());
+  MinidumpModuleList* md_module_list = minidump.GetModuleList();
+  ASSERT_TRUE(md_module_list != NULL);
+  ASSERT_EQ(static_cast<unsigned int>(kModules),
+            md_module_list->module_count());
+
+  pthread_t threads[kThreads];
+  for (int i = 0; i < kThreads; ++i) {
+    ASSERT_EQ(0, pthread_create(&threads[i], NULL, ReadModuleNames,
+                                md_module_list));
+  }
+  for (int i = 0; i < kThreads; ++i) {
+    void* result;
+    ASSERT_EQ(0, pthread_join(threads[i], &result));
+    vector<string>* thread_names = static_cast<vector<string>*>(result);
+    EXPECT_EQ(expected_names, *thread_names);
+    delete thread_names;
+  }
+
+  for (int i = 0; i < kModules; ++i) {
+    delete modules[i];
+    delete names[i];
+  }
 }
 
 TEST(Dump, OneSystemInfo) {
@@ -684,6 +1451,72 @@ TEST(Dump, OneMemoryInfo) {
   ASSERT_EQ(kRegionSize, info2->GetSize());
 }
 
+TEST(Dump, HandlerTiming) {
+  Dump dump(0, kBigEndian);
+  Stream stream(dump, MD_LINUX_HANDLER_TIMING);
+
+  const uint64_t kStartTime = 0x123456789aULL;
+  stream.D32(sizeof(MDRawHandlerTimingList))  // size_of_header
+        .D32(sizeof(MDRawHandlerTiming))      // size_of_entry
+        .D32(2)                               // number_of_entries
+        .D32(0)                               // reserved
+        .D64(kStartTime);                     // start_time
+  stream.D32(MD_HANDLER_PHASE_SUSPEND)        // phase
+        .D32(1)                               // count
+        .D64(1000)                            // start_time
+        .D64(250);                            // duration
+  stream.D32(MD_HANDLER_PHASE_IDENTIFIERS)
+        .D32(3)
+        .D64(2000)
+        .D64(900);
+
+  dump.Add(&stream);
+  dump.Finish();
+
+  string contents;
+  ASSERT_TRUE(dump.GetContents(&contents));
+  istringstream minidump_stream(contents);
+  Minidump minidump(minidump_stream);
+  ASSERT_TRUE(minidump.Read());
+
+  MinidumpHandlerTiming *handler_timing = minidump.GetHandlerTiming();
+  ASSERT_TRUE(handler_timing != NULL);
+  EXPECT_EQ(kStartTime, handler_timing->start_time());
+  ASSERT_EQ(2U, handler_timing->timing_count());
+  const MDRawHandlerTiming *timing = handler_timing->GetTimingAtIndex(1);
+  ASSERT_TRUE(timing != NULL);
+  EXPECT_EQ((uint32_t) MD_HANDLER_PHASE_IDENTIFIERS, timing->phase);
+  EXPECT_EQ(3U, timing->count);
+  EXPECT_EQ(2000U, timing->start_time);
+  EXPECT_EQ(900U, timing->duration);
+  EXPECT_EQ(handler_timing->GetTimingAtIndex(0),
+            handler_timing->GetTimingForPhase(MD_HANDLER_PHASE_SUSPEND));
+  EXPECT_TRUE(handler_timing->GetTimingForPhase(MD_HANDLER_PHASE_WRITE) ==
+              NULL);
+  EXPECT_TRUE(handler_timing->GetTimingAtIndex(2) == NULL);
+}
+
+TEST(Dump, HandlerTimingSizeMismatch) {
+  Dump dump(0, kLittleEndian);
+  Stream stream(dump, MD_LINUX_HANDLER_TIMING);
+  // The header claims more entries than the stream holds.
+  stream.D32(sizeof(MDRawHandlerTimingList))
+        .D32(sizeof(MDRawHandlerTiming))
+        .D32(0x10000000)
+        .D32(0)
+        .D64(0);
+  stream.D32(MD_HANDLER_PHASE_WRITE).D32(1).D64(0).D64(1);
+  dump.Add(&stream);
+  dump.Finish();
+
+  string contents;
+  ASSERT_TRUE(dump.GetContents(&contents));
+  istringstream minidump_stream(contents);
+  Minidump minidump(minidump_stream);
+  ASSERT_TRUE(minidump.Read());
+  EXPECT_TRUE(minidump.GetHandlerTiming() == NULL);
+}
+
 TEST(Dump, OneExceptionX86) {
   Dump dump(0, kLittleEndian);
 
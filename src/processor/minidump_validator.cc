@@ -0,0 +1,289 @@
+// Copyright (c) 2016 Google Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+// notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above
+// copyright notice, this list of conditions and the following disclaimer
+// in the documentation and/or other materials provided with the
+// distribution.
+//     * Neither the name of Google Inc. nor the names of its
+// contributors may be used to endorse or promote products derived from
+// this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+// minidump_validator.cc: Implementation of MinidumpValidator.
+//
+// See minidump_validator.h for documentation.
+
+#include "google_breakpad/processor/minidump_validator.h"
+
+#include <set>
+
+#include "google_breakpad/processor/minidump.h"
+#include "google_breakpad/processor/minidump_processor.h"
+#include "processor/logging.h"
+
+namespace google_breakpad {
+
+namespace {
+
+// Adds a problem to |result|.  The first fatal problem sets the result
+// that processing would return.
+void AddProblem(MinidumpValidator::Result* result, const char* code,
+                const string& detail, ProcessResult process_result) {
+  MinidumpValidator::Problem problem;
+  problem.code = code;
+  problem.detail = detail;
+  problem.fatal = process_result != PROCESS_OK;
+  result->problems.push_back(problem);
+  if (problem.fatal && result->process_result == PROCESS_OK)
+    result->process_result = process_result;
+}
+
+// Returns true if the |size| bytes at |offset| lie within |dump|.
+bool InDump(Minidump* dump, uint64_t offset, uint64_t size) {
+  if (offset + size < offset)
+    return false;
+  if (size == 0)
+    return true;
+  // A minidump in memory can be checked without reading it.
+  if (dump->GetMappedBytes(0, 1))
+    return dump->GetMappedBytes(offset, size) != NULL;
+  uint8_t last;
+  return dump->SeekSet(offset + size - 1) && dump->ReadBytes(&last, 1);
+}
+
+string StreamName(uint32_t stream_type) {
+  return "stream " + HexString(stream_type);
+}
+
+// Checks the requesting thread |thread|, with |exception| if the minidump
+// has one, and fills in the instruction pointer.
+void CheckRequestingThread(Minidump* dump, MinidumpThread* thread,
+                           MinidumpException* exception,
+                           MinidumpValidator::Result* result) {
+  const string thread_name = "thread " + HexString(
+      result->requesting_thread_id);
+  MinidumpContext* context = exception ? exception->GetContext() : NULL;
+  if (!context)
+    context = thread->GetContext();
+  if (!context) {
+    AddProblem(result, "requesting_thread_context_missing", thread_name,
+               PROCESS_OK);
+    return;
+  }
+  result->has_instruction_pointer =
+      context->GetInstructionPointer(&result->instruction_pointer);
+
+  const MDMemoryDescriptor& stack = thread->thread()->stack;
+  if (stack.memory.data_size == 0) {
+    AddProblem(result, "requesting_thread_stack_missing", thread_name,
+               PROCESS_OK);
+    return;
+  }
+  if (!InDump(dump, stack.memory.rva, stack.memory.data_size)) {
+    AddProblem(result, "requesting_thread_stack_out_of_bounds", thread_name,
+               PROCESS_OK);
+    return;
+  }
+  uint64_t stack_pointer;
+  if (context->GetStackPointer(&stack_pointer) &&
+      (stack_pointer < stack.start_of_memory_range ||
+       stack_pointer - stack.start_of_memory_range >=
+           stack.memory.data_size)) {
+    AddProblem(result, "stack_pointer_outside_stack",
+               thread_name + " sp " + HexString(stack_pointer),
+               PROCESS_OK);
+  }
+}
+
+}  // namespace
+
+void MinidumpValidator::Result::Clear() {
+  verdict = VERDICT_VALID;
+  process_result = PROCESS_OK;
+  problems.clear();
+  crashed = false;
+  crash_reason.clear();
+  crash_address = 0;
+  has_requesting_thread = false;
+  requesting_thread_id = 0;
+  has_instruction_pointer = false;
+  instruction_pointer = 0;
+  instruction_module = -1;
+  instruction_offset = 0;
+  modules.clear();
+}
+
+// static
+void MinidumpValidator::Validate(Minidump* dump, Result* result) {
+  result->Clear();
+  if (!dump->Read()) {
+    AddProblem(result, "header_unreadable", string(),
+               PROCESS_ERROR_NO_MINIDUMP_HEADER);
+    result->verdict = VERDICT_INVALID;
+    return;
+  }
+
+  std::set<uint32_t> stream_types;
+  for (unsigned int i = 0; i < dump->GetDirectoryEntryCount(); ++i) {
+    const MDRawDirectory* entry = dump->GetDirectoryEntryAtIndex(i);
+    stream_types.insert(entry->stream_type);
+    if (!InDump(dump, entry->location.rva, entry->location.data_size)) {
+      AddProblem(result, "stream_out_of_bounds",
+                 StreamName(entry->stream_type), PROCESS_OK);
+    }
+  }
+
+  // The thread checks that MinidumpProcessor::Process fails on, in the
+  // same order.
+  uint32_t dump_thread_id = 0;
+  bool has_dump_thread = false;
+  MinidumpBreakpadInfo* breakpad_info = NULL;
+  if (stream_types.count(MD_BREAKPAD_INFO_STREAM)) {
+    breakpad_info = dump->GetBreakpadInfo();
+    if (breakpad_info) {
+      has_dump_thread = breakpad_info->GetDumpThreadID(&dump_thread_id);
+      result->has_requesting_thread =
+          breakpad_info->GetRequestingThreadID(&result->requesting_thread_id);
+    } else {
+      AddProblem(result, "breakpad_info_unreadable", string(), PROCESS_OK);
+    }
+  }
+
+  MinidumpException* exception = NULL;
+  if (stream_types.count(MD_EXCEPTION_STREAM)) {
+    exception = dump->GetException();
+    if (exception) {
+      result->crashed = true;
+      result->has_requesting_thread =
+          exception->GetThreadID(&result->requesting_thread_id);
+      result->crash_reason =
+          MinidumpProcessor::GetCrashReason(dump, &result->crash_address);
+    } else {
+      AddProblem(result, "exception_unreadable", string(), PROCESS_OK);
+    }
+  }
+
+  if (!stream_types.count(MD_SYSTEM_INFO_STREAM)) {
+    // Without the CPU type, no stack can be walked.
+    AddProblem(result, "system_info_missing", string(), PROCESS_OK);
+  } else if (!dump->GetSystemInfo()) {
+    AddProblem(result, "system_info_unreadable", string(), PROCESS_OK);
+  }
+
+  MinidumpThreadList* threads = NULL;
+  if (!stream_types.count(MD_THREAD_LIST_STREAM)) {
+    AddProblem(result, "thread_list_missing", string(),
+               PROCESS_ERROR_NO_THREAD_LIST);
+  } else if (!(threads = dump->GetThreadList())) {
+    AddProblem(result, "thread_list_unreadable", string(),
+               PROCESS_ERROR_NO_THREAD_LIST);
+  }
+
+  MinidumpThread* requesting_thread = NULL;
+  if (threads) {
+    for (unsigned int i = 0; i < threads->thread_count(); ++i) {
+      MinidumpThread* thread = threads->GetThreadAtIndex(i);
+      if (!thread) {
+        AddProblem(result, "thread_unreadable", "index " + HexString(i),
+                   PROCESS_ERROR_GETTING_THREAD);
+        break;
+      }
+      uint32_t thread_id;
+      if (!thread->GetThreadID(&thread_id)) {
+        AddProblem(result, "thread_id_unreadable", "index " + HexString(i),
+                   PROCESS_ERROR_GETTING_THREAD_ID);
+        break;
+      }
+      if (has_dump_thread && thread_id == dump_thread_id)
+        continue;
+      if (result->has_requesting_thread &&
+          thread_id == result->requesting_thread_id) {
+        if (requesting_thread) {
+          AddProblem(result, "duplicate_requesting_thread",
+                     "thread " + HexString(thread_id),
+                     PROCESS_ERROR_DUPLICATE_REQUESTING_THREADS);
+          break;
+        }
+        requesting_thread = thread;
+      }
+    }
+    if (result->has_requesting_thread && !requesting_thread &&
+        result->process_result == PROCESS_OK) {
+      AddProblem(result, "requesting_thread_missing",
+                 "thread " + HexString(result->requesting_thread_id),
+                 PROCESS_OK);
+    }
+  }
+  if (requesting_thread && result->process_result == PROCESS_OK)
+    CheckRequestingThread(dump, requesting_thread, exception, result);
+
+  MinidumpModuleList* modules = NULL;
+  if (!stream_types.count(MD_MODULE_LIST_STREAM)) {
+    AddProblem(result, "module_list_missing", string(), PROCESS_OK);
+  } else if (!(modules = dump->GetModuleList())) {
+    AddProblem(result, "module_list_unreadable", string(), PROCESS_OK);
+  }
+  if (modules) {
+    result->modules.resize(modules->module_count());
+    for (unsigned int i = 0; i < modules->module_count(); ++i) {
+      const MinidumpModule* module = modules->GetModuleAtIndex(i);
+      result->modules[i].debug_file = module->debug_file();
+      result->modules[i].debug_identifier = module->debug_identifier();
+    }
+    const MinidumpModule* module = result->has_instruction_pointer ?
+        modules->GetModuleForAddress(result->instruction_pointer) : NULL;
+    for (unsigned int i = 0; module && i < modules->module_count(); ++i) {
+      if (modules->GetModuleAtIndex(i) != module)
+        continue;
+      result->instruction_module = i;
+      result->instruction_offset =
+          result->instruction_pointer - module->base_address();
+      if (result->modules[i].debug_identifier.empty()) {
+        // Its symbols can't be found, so its frames won't be symbolized.
+        AddProblem(result, "instruction_module_without_debug_identifier",
+                   module->code_file(), PROCESS_OK);
+      }
+    }
+  }
+
+  if (stream_types.count(MD_MEMORY_LIST_STREAM) && !dump->GetMemoryList())
+    AddProblem(result, "memory_list_unreadable", string(), PROCESS_OK);
+
+  if (result->process_result != PROCESS_OK)
+    result->verdict = VERDICT_INVALID;
+  else if (!result->problems.empty())
+    result->verdict = VERDICT_DEGRADED;
+}
+
+// static
+const char* MinidumpValidator::VerdictName(Verdict verdict) {
+  switch (verdict) {
+    case VERDICT_VALID:
+      return "valid";
+    case VERDICT_DEGRADED:
+      return "degraded";
+    case VERDICT_INVALID:
+      return "invalid";
+  }
+  return "unknown";
+}
+
+}  // namespace google_breakpad
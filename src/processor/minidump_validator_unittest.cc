@@ -0,0 +1,263 @@
+// Copyright (c) 2010, Google Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+// notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above
+// copyright notice, this list of conditions and the following disclaimer
+// in the documentation and/or other materials provided with the
+// distribution.
+//     * Neither the name of Google Inc. nor the names of its
+// contributors may be used to endorse or promote products derived from
+// this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+// Unit tests for MinidumpValidator, using synthesized minidumps.
+
+#include <string.h>
+
+#include <string>
+
+#include "breakpad_googletest_includes.h"
+#include "common/using_std_string.h"
+#include "google_breakpad/common/minidump_format.h"
+#include "google_breakpad/processor/minidump.h"
+#include "google_breakpad/processor/minidump_validator.h"
+#include "processor/synth_minidump.h"
+
+namespace {
+
+using google_breakpad::Minidump;
+using google_breakpad::MinidumpValidator;
+using google_breakpad::SynthMinidump::Context;
+using google_breakpad::SynthMinidump::Dump;
+using google_breakpad::SynthMinidump::Exception;
+using google_breakpad::SynthMinidump::Memory;
+using google_breakpad::SynthMinidump::Module;
+using google_breakpad::SynthMinidump::Section;
+using google_breakpad::SynthMinidump::String;
+using google_breakpad::SynthMinidump::SystemInfo;
+using google_breakpad::SynthMinidump::Thread;
+using google_breakpad::test_assembler::kLittleEndian;
+
+const uint32_t kThreadID = 0x3c1b;
+const uint64_t kStackStart = 0x7ff00000;
+const uint64_t kModuleBase = 0x40000000;
+const uint32_t kModuleSize = 0x10000;
+
+bool HasProblem(const MinidumpValidator::Result& result,
+                const string& code) {
+  for (size_t i = 0; i < result.problems.size(); ++i) {
+    if (result.problems[i].code == code)
+      return true;
+  }
+  return false;
+}
+
+class MinidumpValidatorTest : public ::testing::Test {
+ public:
+  MinidumpValidatorTest()
+      : dump(0, kLittleEndian),
+        csd_version(dump, "Service Pack 3"),
+        system_info(dump, SystemInfo::windows_x86, csd_version),
+        stack(dump, kStackStart),
+        module_name(dump, "app.exe"),
+        cv_record(dump),
+        context_(NULL),
+        thread_(NULL),
+        exception_(NULL),
+        module_(NULL) {
+    stack.Append(0x100, 0);
+    memset(&raw_context, 0, sizeof(raw_context));
+    raw_context.context_flags = MD_CONTEXT_X86_INTEGER |
+                                MD_CONTEXT_X86_CONTROL;
+    raw_context.eip = kModuleBase + 0x1234;
+    raw_context.esp = kStackStart + 0x80;
+
+    // An MDCVInfoPDB70 record.
+    cv_record.D32(MD_CVINFOPDB70_SIGNATURE)
+             .D32(0x11223344).D16(0x5566).D16(0x7788)
+             .Append(8, 0x99)
+             .D32(1)
+             .AppendCString("app.pdb");
+  }
+
+  // Adds a thread list holding the crashed thread, an exception stream
+  // for it and a module list holding the module its eip is in.
+  void AddCrash(const MDRawContextX86& context) {
+    context_ = new Context(dump, context);
+    thread_ = new Thread(dump, kThreadID, stack, *context_);
+    exception_ = new Exception(dump, *context_, kThreadID,
+                               MD_EXCEPTION_CODE_WIN_ACCESS_VIOLATION, 0,
+                               kModuleBase + 0x1234);
+    MDVSFixedFileInfo version_info;
+    memset(&version_info, 0, sizeof(version_info));
+    module_ = new Module(dump, kModuleBase, kModuleSize, module_name,
+                         0xb1054d2a, 0, version_info, &cv_record);
+    dump.Add(&stack);
+    dump.Add(context_);
+    dump.Add(thread_);
+    dump.Add(exception_);
+    dump.Add(&module_name);
+    dump.Add(&cv_record);
+    dump.Add(module_);
+  }
+
+  void TearDown() {
+    delete context_;
+    delete thread_;
+    delete exception_;
+    delete module_;
+  }
+
+  void Validate(const string& contents) {
+    Minidump minidump(reinterpret_cast<const uint8_t*>(contents.data()),
+                      contents.size());
+    MinidumpValidator::Validate(&minidump, &result);
+  }
+
+  void FinishAndValidate() {
+    dump.Finish();
+    string contents;
+    ASSERT_TRUE(dump.GetContents(&contents));
+    Validate(contents);
+  }
+
+  Dump dump;
+  String csd_version;
+  SystemInfo system_info;
+  Memory stack;
+  String module_name;
+  Section cv_record;
+  MDRawContextX86 raw_context;
+  Context* context_;
+  Thread* thread_;
+  Exception* exception_;
+  Module* module_;
+  MinidumpValidator::Result result;
+};
+
+TEST_F(MinidumpValidatorTest, Valid) {
+  dump.Add(&csd_version);
+  dump.Add(&system_info);
+  AddCrash(raw_context);
+  FinishAndValidate();
+
+  EXPECT_EQ(MinidumpValidator::VERDICT_VALID, result.verdict);
+  EXPECT_EQ(google_breakpad::PROCESS_OK, result.process_result);
+  EXPECT_TRUE(result.problems.empty());
+  EXPECT_TRUE(result.crashed);
+  EXPECT_EQ("EXCEPTION_ACCESS_VIOLATION", result.crash_reason);
+  ASSERT_TRUE(result.has_requesting_thread);
+  EXPECT_EQ(kThreadID, result.requesting_thread_id);
+  ASSERT_TRUE(result.has_instruction_pointer);
+  EXPECT_EQ(kModuleBase + 0x1234, result.instruction_pointer);
+  ASSERT_EQ(1U, result.modules.size());
+  EXPECT_EQ(0, result.instruction_module);
+  EXPECT_EQ(0x1234U, result.instruction_offset);
+  EXPECT_EQ("app.pdb", result.modules[0].debug_file);
+  EXPECT_EQ("112233445566778899999999999999991",
+            result.modules[0].debug_identifier);
+}
+
+TEST_F(MinidumpValidatorTest, StackPointerOutsideStack) {
+  raw_context.esp = kStackStart + 0x1000;
+  dump.Add(&csd_version);
+  dump.Add(&system_info);
+  AddCrash(raw_context);
+  FinishAndValidate();
+
+  EXPECT_EQ(MinidumpValidator::VERDICT_DEGRADED, result.verdict);
+  EXPECT_EQ(google_breakpad::PROCESS_OK, result.process_result);
+  EXPECT_TRUE(HasProblem(result, "stack_pointer_outside_stack"));
+}
+
+TEST_F(MinidumpValidatorTest, NoThreadList) {
+  dump.Add(&csd_version);
+  dump.Add(&system_info);
+  dump.Add(&stack);
+  FinishAndValidate();
+
+  EXPECT_EQ(MinidumpValidator::VERDICT_INVALID, result.verdict);
+  EXPECT_EQ(google_breakpad::PROCESS_ERROR_NO_THREAD_LIST,
+            result.process_result);
+  ASSERT_FALSE(result.problems.empty());
+  EXPECT_TRUE(HasProblem(result, "thread_list_missing"));
+}
+
+TEST_F(MinidumpValidatorTest, StreamOutOfBounds) {
+  dump.Add(&csd_version);
+  dump.Add(&system_info);
+  AddCrash(raw_context);
+  dump.Finish();
+  string contents;
+  ASSERT_TRUE(dump.GetContents(&contents));
+
+  // The stream directory comes last; stretch the system info stream's
+  // entry past the end of the minidump.
+  const size_t kEntrySize = sizeof(MDRawDirectory);
+  bool found = false;
+  for (size_t offset = contents.size() - kEntrySize;
+       offset >= sizeof(MDRawHeader) && !found; offset -= kEntrySize) {
+    MDRawDirectory entry;
+    memcpy(&entry, contents.data() + offset, kEntrySize);
+    if (entry.stream_type == MD_SYSTEM_INFO_STREAM) {
+      entry.location.data_size = contents.size();
+      contents.replace(offset, kEntrySize,
+                       reinterpret_cast<const char*>(&entry), kEntrySize);
+      found = true;
+    }
+  }
+  ASSERT_TRUE(found);
+  Validate(contents);
+
+  EXPECT_EQ(MinidumpValidator::VERDICT_DEGRADED, result.verdict);
+  EXPECT_TRUE(HasProblem(result, "stream_out_of_bounds"));
+}
+
+TEST_F(MinidumpValidatorTest, NotAMinidump) {
+  Validate("This is not a minidump, just some text.");
+
+  EXPECT_EQ(MinidumpValidator::VERDICT_INVALID, result.verdict);
+  EXPECT_EQ(google_breakpad::PROCESS_ERROR_NO_MINIDUMP_HEADER,
+            result.process_result);
+  EXPECT_TRUE(HasProblem(result, "header_unreadable"));
+}
+
+TEST_F(MinidumpValidatorTest, ResultIsReused) {
+  Validate("Not a minidump either.");
+  ASSERT_EQ(MinidumpValidator::VERDICT_INVALID, result.verdict);
+
+  dump.Add(&csd_version);
+  dump.Add(&system_info);
+  AddCrash(raw_context);
+  FinishAndValidate();
+  EXPECT_EQ(MinidumpValidator::VERDICT_VALID, result.verdict);
+  EXPECT_TRUE(result.problems.empty());
+}
+
+TEST(MinidumpValidator, VerdictName) {
+  EXPECT_STREQ("valid",
+               MinidumpValidator::VerdictName(MinidumpValidator::VERDICT_VALID));
+  EXPECT_STREQ("degraded", MinidumpValidator::VerdictName(
+      MinidumpValidator::VERDICT_DEGRADED));
+  EXPECT_STREQ("invalid", MinidumpValidator::VerdictName(
+      MinidumpValidator::VERDICT_INVALID));
+}
+
+}  // namespace
@@ -0,0 +1,239 @@
+// Copyright (c) 2016 Google Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+// notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above
+// copyright notice, this list of conditions and the following disclaimer
+// in the documentation and/or other materials provided with the
+// distribution.
+//     * Neither the name of Google Inc. nor the names of its
+// contributors may be used to endorse or promote products derived from
+// this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+// missing_symbol_cache.cc: Implementation of MissingSymbolCache.
+//
+// See missing_symbol_cache.h for documentation.
+
+#include "google_breakpad/processor/missing_symbol_cache.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifndef _WIN32
+#include <unistd.h>
+#endif  // _WIN32
+
+#include <fstream>
+
+#include "common/scoped_ptr.h"
+#include "google_breakpad/processor/code_module.h"
+#include "processor/logging.h"
+#include "processor/mutex.h"
+
+namespace google_breakpad {
+
+namespace {
+
+// The first line of a saved cache.  Each following line holds one entry:
+// the time it was recorded, in seconds since the epoch, the debug
+// identifier, and the debug file, which runs to the end of the line.
+const char kFileHeader[] = "BREAKPAD_MISSING_SYMBOLS 1";
+
+}  // namespace
+
+MissingSymbolCache::MissingSymbolCache(time_t time_to_live)
+    : time_to_live_(time_to_live),
+      mutex_(new Mutex) {
+}
+
+MissingSymbolCache::~MissingSymbolCache() {
+  delete mutex_;
+}
+
+// static
+bool MissingSymbolCache::KeyForModule(const CodeModule* module, Key* key) {
+  if (!module)
+    return false;
+  key->first = module->debug_file();
+  key->second = module->debug_identifier();
+  // Saved entries are one per line, with the identifier delimited by spaces.
+  return !key->first.empty() && !key->second.empty() &&
+         key->first.find('\n') == string::npos &&
+         key->second.find_first_of(" \n") == string::npos;
+}
+
+bool MissingSymbolCache::IsMissing(const CodeModule* module) {
+  Key key;
+  if (!KeyForModule(module, &key))
+    return false;
+
+  AutoMutex lock(mutex_);
+  EntryMap::iterator entry = entries_.find(key);
+  if (entry == entries_.end())
+    return false;
+  if (IsExpired(entry->second, time(NULL))) {
+    entries_.erase(entry);
+    return false;
+  }
+  return true;
+}
+
+void MissingSymbolCache::RecordMissing(const CodeModule* module) {
+  Key key;
+  if (!KeyForModule(module, &key))
+    return;
+
+  AutoMutex lock(mutex_);
+  entries_[key] = time(NULL);
+}
+
+void MissingSymbolCache::Forget(const CodeModule* module) {
+  Key key;
+  if (!KeyForModule(module, &key))
+    return;
+
+  AutoMutex lock(mutex_);
+  entries_.erase(key);
+}
+
+void MissingSymbolCache::Clear() {
+  AutoMutex lock(mutex_);
+  entries_.clear();
+}
+
+size_t MissingSymbolCache::size() const {
+  AutoMutex lock(mutex_);
+  return entries_.size();
+}
+
+bool MissingSymbolCache::Load(const string& path) {
+  std::ifstream file(path.c_str());
+  if (!file.is_open()) {
+    BPLOG(ERROR) << "Could not open missing symbol cache " << path;
+    return false;
+  }
+
+  string line;
+  if (!std::getline(file, line) || line != kFileHeader) {
+    BPLOG(ERROR) << "Missing symbol cache " << path << " has a bad header";
+    return false;
+  }
+
+  // Parse everything before touching the cache, so that a malformed file
+  // changes nothing.
+  time_t now = time(NULL);
+  EntryMap loaded;
+  int line_number = 1;
+  while (std::getline(file, line)) {
+    ++line_number;
+    size_t identifier_start = line.find(' ');
+    size_t file_start = identifier_start == string::npos ?
+        string::npos : line.find(' ', identifier_start + 1);
+    char* time_end = NULL;
+    errno = 0;
+    long long recorded = strtoll(line.c_str(), &time_end, 10);
+    if (file_start == string::npos || file_start == identifier_start + 1 ||
+        file_start + 1 == line.size() || errno != 0 ||
+        time_end != line.c_str() + identifier_start) {
+      BPLOG(ERROR) << "Malformed line " << line_number
+                   << " in missing symbol cache " << path;
+      return false;
+    }
+
+    if (IsExpired(static_cast<time_t>(recorded), now))
+      continue;
+    Key key(line.substr(file_start + 1),
+            line.substr(identifier_start + 1,
+                        file_start - identifier_start - 1));
+    time_t& entry = loaded[key];
+    if (entry < recorded)
+      entry = static_cast<time_t>(recorded);
+  }
+
+  AutoMutex lock(mutex_);
+  for (EntryMap::const_iterator entry = loaded.begin();
+       entry != loaded.end();
+       ++entry) {
+    std::pair<EntryMap::iterator, bool> inserted = entries_.insert(*entry);
+    if (!inserted.second && inserted.first->second < entry->second)
+      inserted.first->second = entry->second;
+  }
+  return true;
+}
+
+bool MissingSymbolCache::Save(const string& path) const {
+  FILE* file;
+#ifndef _WIN32
+  string temp_path_template = path + ".XXXXXX";
+  scoped_array<char> temp_path(new char[temp_path_template.size() + 1]);
+  memcpy(temp_path.get(), temp_path_template.c_str(),
+         temp_path_template.size() + 1);
+  int fd = mkstemp(temp_path.get());
+  file = fd == -1 ? NULL : fdopen(fd, "w");
+  if (!file && fd != -1) {
+    close(fd);
+    unlink(temp_path.get());
+  }
+#else  // _WIN32
+  string temp_path = path + ".tmp";
+  file = fopen(temp_path.c_str(), "w");
+#endif  // _WIN32
+  if (!file) {
+    BPLOG(ERROR) << "Could not create missing symbol cache " << path;
+    return false;
+  }
+
+  bool written = fprintf(file, "%s\n", kFileHeader) > 0;
+  {
+    AutoMutex lock(mutex_);
+    time_t now = time(NULL);
+    for (EntryMap::const_iterator entry = entries_.begin();
+         written && entry != entries_.end();
+         ++entry) {
+      if (IsExpired(entry->second, now))
+        continue;
+      written = fprintf(file, "%lld %s %s\n",
+                        static_cast<long long>(entry->second),
+                        entry->first.second.c_str(),
+                        entry->first.first.c_str()) > 0;
+    }
+  }
+
+  if (fclose(file) != 0)
+    written = false;
+#ifndef _WIN32
+  const char* temp_name = temp_path.get();
+#else  // _WIN32
+  // rename does not replace an existing file on Windows.
+  const char* temp_name = temp_path.c_str();
+  if (written)
+    remove(path.c_str());
+#endif  // _WIN32
+  if (!written || rename(temp_name, path.c_str()) != 0) {
+    BPLOG(ERROR) << "Could not write missing symbol cache " << path;
+    remove(temp_name);
+    return false;
+  }
+  return true;
+}
+
+}  // namespace google_breakpad
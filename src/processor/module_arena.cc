@@ -0,0 +1,151 @@
+// Copyright (c) 2016 Google Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+// notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above
+// copyright notice, this list of conditions and the following disclaimer
+// in the documentation and/or other materials provided with the
+// distribution.
+//     * Neither the name of Google Inc. nor the names of its
+// contributors may be used to endorse or promote products derived from
+// this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+// module_arena.cc: Implementation of ModuleArena.
+//
+// See module_arena.h for documentation.
+
+#include "processor/module_arena.h"
+
+#ifndef _WIN32
+#include <sys/mman.h>
+#include <unistd.h>
+#endif  // _WIN32
+
+#include <new>
+
+#include "processor/logging.h"
+
+namespace google_breakpad {
+
+// Allocations are rounded up to a multiple of this, which suits every
+// object the resolver stores.
+static const size_t kAlignment = 16;
+
+// The size of an arena's first block, unless it uses huge pages.
+static const size_t kFirstBlockSize = 64 * 1024;
+
+const size_t ModuleArena::kHugePageSize;
+
+static size_t RoundUp(size_t size, size_t alignment) {
+  return (size + alignment - 1) / alignment * alignment;
+}
+
+ModuleArena::ModuleArena(bool huge_pages)
+    : huge_pages_(huge_pages),
+      next_(NULL),
+      end_(NULL),
+      next_block_size_(huge_pages ? kHugePageSize : kFirstBlockSize),
+      allocated_bytes_(0),
+      reserved_bytes_(0) {
+}
+
+ModuleArena::~ModuleArena() {
+  for (size_t i = 0; i < blocks_.size(); ++i)
+    FreeBlock(blocks_[i]);
+}
+
+void *ModuleArena::Allocate(size_t size) {
+  size = RoundUp(size > 0 ? size : 1, kAlignment);
+  if (size > static_cast<size_t>(end_ - next_))
+    AddBlock(size);
+  void *result = next_;
+  next_ += size;
+  allocated_bytes_ += size;
+  return result;
+}
+
+void ModuleArena::Adopt(ModuleArena *other) {
+  if (other == this)
+    return;
+  // This arena goes on allocating from its own current block; what is
+  // left of |other|'s goes unused.
+  blocks_.insert(blocks_.end(), other->blocks_.begin(), other->blocks_.end());
+  allocated_bytes_ += other->allocated_bytes_;
+  reserved_bytes_ += other->reserved_bytes_;
+  other->blocks_.clear();
+  other->next_ = other->end_ = NULL;
+  other->allocated_bytes_ = other->reserved_bytes_ = 0;
+}
+
+void ModuleArena::AddBlock(size_t size) {
+  size_t block_size = next_block_size_;
+  if (block_size < size)
+    block_size = RoundUp(size, huge_pages_ ? kHugePageSize : kFirstBlockSize);
+  if (next_block_size_ < kHugePageSize)
+    next_block_size_ *= 2;
+
+  Block block = { NULL, block_size };
+#ifndef _WIN32
+  // Huge pages only back 2MB-aligned ranges, so a block that should use
+  // them is cut out of a larger mapping.
+  size_t map_size = huge_pages_ ? block_size + kHugePageSize : block_size;
+  void *mapping = mmap(NULL, map_size, PROT_READ | PROT_WRITE,
+                       MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (mapping == MAP_FAILED) {
+    BPLOG(ERROR) << "Could not map a " << block_size << "-byte arena block";
+    throw std::bad_alloc();
+  }
+  block.base = static_cast<char *>(mapping);
+  if (huge_pages_) {
+    char *aligned = reinterpret_cast<char *>(
+        RoundUp(reinterpret_cast<size_t>(block.base), kHugePageSize));
+    if (aligned > block.base)
+      munmap(block.base, aligned - block.base);
+    size_t tail = block.base + map_size - (aligned + block_size);
+    if (tail > 0)
+      munmap(aligned + block_size, tail);
+    block.base = aligned;
+#ifdef MADV_HUGEPAGE
+    // Only a hint: without transparent huge pages the block just uses
+    // normal pages.
+    madvise(block.base, block_size, MADV_HUGEPAGE);
+#endif  // MADV_HUGEPAGE
+  }
+#else  // _WIN32
+  block.base = new char[block_size];
+#endif  // _WIN32
+
+  blocks_.push_back(block);
+  reserved_bytes_ += block_size;
+  next_ = block.base;
+  end_ = block.base + block_size;
+}
+
+// static
+void ModuleArena::FreeBlock(const Block &block) {
+#ifndef _WIN32
+  munmap(block.base, block.size);
+#else  // _WIN32
+  delete [] block.base;
+#endif  // _WIN32
+}
+
+}  // namespace google_breakpad
@@ -0,0 +1,140 @@
+// Copyright (c) 2016 Google Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+// notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above
+// copyright notice, this list of conditions and the following disclaimer
+// in the documentation and/or other materials provided with the
+// distribution.
+//     * Neither the name of Google Inc. nor the names of its
+// contributors may be used to endorse or promote products derived from
+// this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+// module_arena.h: ModuleArena, which holds the parsed records of one
+// loaded module so that they are all freed at once when it is unloaded.
+//
+// A large symbol file turns into hundreds of thousands of small objects.
+// Allocated one at a time, they end up scattered across the heap, and
+// unloading the module frees them one at a time, leaving holes that a
+// long-running processor's heap fragments around.  A ModuleArena hands
+// out memory from a few large blocks that it maps itself, and unmaps
+// them all when it is destroyed, so a module's records sit together and
+// unloading it returns their memory to the system in a handful of calls.
+// With huge pages, the blocks are mapped 2MB-aligned and the kernel is
+// asked to back them with transparent huge pages, so that lookups in a
+// large module take fewer TLB misses.
+//
+// Objects of a class derived from ArenaObject can only be allocated in a
+// ModuleArena.  Deleting one runs its destructor but leaves its memory to
+// the arena, so it may be held by linked_ptr and other owners that delete
+// it, as long as the arena outlives them.
+//
+// A ModuleArena is not thread-safe.  Threads that parse records for a
+// module at once each allocate from an arena of their own, and the
+// module's arena adopts their blocks afterwards.
+
+#ifndef PROCESSOR_MODULE_ARENA_H__
+#define PROCESSOR_MODULE_ARENA_H__
+
+#include <stddef.h>
+
+#include <vector>
+
+namespace google_breakpad {
+
+class ModuleArena {
+ public:
+  // If |huge_pages| is true, blocks are backed by transparent huge pages
+  // where the system supports them.
+  explicit ModuleArena(bool huge_pages);
+
+  // Frees every block, and so every object allocated in the arena.  Their
+  // destructors must already have run.
+  ~ModuleArena();
+
+  // Returns |size| bytes, aligned for any object the resolver stores.
+  // Never returns NULL.
+  void *Allocate(size_t size);
+
+  // Takes over the blocks of |other|, which is left empty.  The objects
+  // allocated in it are then freed with this arena's.
+  void Adopt(ModuleArena *other);
+
+  // The bytes handed out by Allocate, and the bytes of the blocks they
+  // were handed out from.
+  size_t allocated_bytes() const { return allocated_bytes_; }
+  size_t reserved_bytes() const { return reserved_bytes_; }
+
+  bool huge_pages() const { return huge_pages_; }
+
+  // The size of a huge page, and of the blocks of an arena that uses them.
+  static const size_t kHugePageSize = 2 * 1024 * 1024;
+
+ private:
+  struct Block {
+    char *base;
+    size_t size;
+  };
+
+  // Maps a new block with room for at least |size| bytes, and makes it the
+  // block that Allocate hands out memory from.
+  void AddBlock(size_t size);
+
+  static void FreeBlock(const Block &block);
+
+  bool huge_pages_;
+  std::vector<Block> blocks_;
+
+  // The unused part of the current block.
+  char *next_;
+  char *end_;
+
+  // The size of the next block to map, unless an allocation needs more.
+  // Blocks start small, so that small modules don't hold on to much
+  // memory, and grow to kHugePageSize.
+  size_t next_block_size_;
+
+  size_t allocated_bytes_;
+  size_t reserved_bytes_;
+
+  // Disallow copy constructor and assignment operator.
+  ModuleArena(const ModuleArena&);
+  void operator=(const ModuleArena&);
+};
+
+// A base for classes whose objects live in a ModuleArena.  Allocate them
+// with new (arena) T(...).
+class ArenaObject {
+ public:
+  static void *operator new(size_t size, ModuleArena *arena) {
+    return arena->Allocate(size);
+  }
+
+  // Called only if a constructor throws; the arena keeps the memory.
+  static void operator delete(void *object, ModuleArena *arena) { }
+
+  // Deleting an object only destroys it; the arena frees its memory.
+  static void operator delete(void *object) { }
+};
+
+}  // namespace google_breakpad
+
+#endif  // PROCESSOR_MODULE_ARENA_H__
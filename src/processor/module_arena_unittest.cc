@@ -0,0 +1,131 @@
+// Copyright (c) 2016 Google Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+// notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above
+// copyright notice, this list of conditions and the following disclaimer
+// in the documentation and/or other materials provided with the
+// distribution.
+//     * Neither the name of Google Inc. nor the names of its
+// contributors may be used to endorse or promote products derived from
+// this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+// module_arena_unittest.cc: Unit tests for ModuleArena.
+
+#include <stdint.h>
+#include <string.h>
+
+#include <string>
+
+#include "breakpad_googletest_includes.h"
+#include "common/using_std_string.h"
+#include "processor/module_arena.h"
+
+namespace {
+
+using google_breakpad::ArenaObject;
+using google_breakpad::ModuleArena;
+
+// Counts the objects destroyed.
+struct Counted : public ArenaObject {
+  Counted(const string &set_name, int *set_destroyed)
+      : name(set_name), destroyed(set_destroyed) { }
+  ~Counted() { ++*destroyed; }
+
+  string name;
+  int *destroyed;
+};
+
+TEST(ModuleArenaTest, AllocationsAreAlignedAndDistinct) {
+  ModuleArena arena(false);
+  char *previous = NULL;
+  for (size_t size = 1; size < 200; ++size) {
+    char *allocation = static_cast<char *>(arena.Allocate(size));
+    ASSERT_TRUE(allocation);
+    EXPECT_EQ(0U, reinterpret_cast<uintptr_t>(allocation) % 16);
+    memset(allocation, 0xa5, size);
+    EXPECT_NE(previous, allocation);
+    previous = allocation;
+  }
+  EXPECT_LE(arena.allocated_bytes(), arena.reserved_bytes());
+}
+
+TEST(ModuleArenaTest, LargeAllocations) {
+  ModuleArena arena(false);
+  arena.Allocate(10);
+  const size_t kLarge = 3 * 1024 * 1024;
+  char *large = static_cast<char *>(arena.Allocate(kLarge));
+  memset(large, 0x5a, kLarge);
+  EXPECT_LE(kLarge, arena.reserved_bytes());
+  // Smaller allocations go on after the large one.
+  char *small = static_cast<char *>(arena.Allocate(10));
+  EXPECT_TRUE(small < large || small >= large + kLarge);
+}
+
+TEST(ModuleArenaTest, HugePages) {
+  ModuleArena arena(true);
+  char *allocation = static_cast<char *>(arena.Allocate(100));
+  // The block is aligned to a huge page, whether or not the system backs
+  // it with one.
+  EXPECT_EQ(0U, reinterpret_cast<uintptr_t>(allocation) %
+                ModuleArena::kHugePageSize);
+  EXPECT_EQ(ModuleArena::kHugePageSize, arena.reserved_bytes());
+  memset(allocation, 0, 100);
+}
+
+TEST(ModuleArenaTest, DeleteOnlyDestroys) {
+  int destroyed = 0;
+  ModuleArena arena(false);
+  Counted *first = new (&arena) Counted("a name too long to fit in place",
+                                        &destroyed);
+  Counted *second = new (&arena) Counted("b", &destroyed);
+  size_t allocated = arena.allocated_bytes();
+  delete first;
+  EXPECT_EQ(1, destroyed);
+  EXPECT_EQ(allocated, arena.allocated_bytes());
+  EXPECT_EQ("b", second->name);
+  delete second;
+  EXPECT_EQ(2, destroyed);
+}
+
+TEST(ModuleArenaTest, Adopt) {
+  ModuleArena arena(false);
+  arena.Allocate(100);
+  size_t reserved = arena.reserved_bytes();
+  size_t allocated = arena.allocated_bytes();
+  {
+    ModuleArena other(false);
+    char *allocation = static_cast<char *>(other.Allocate(1000));
+    arena.Adopt(&other);
+    EXPECT_EQ(0U, other.allocated_bytes());
+    EXPECT_EQ(0U, other.reserved_bytes());
+    // |other| no longer frees the memory it handed out.
+    memset(allocation, 0, 1000);
+  }
+  EXPECT_LT(reserved, arena.reserved_bytes());
+  EXPECT_LT(allocated, arena.allocated_bytes());
+  // The arena goes on allocating from its own block.
+  reserved = arena.reserved_bytes();
+  arena.Allocate(100);
+  EXPECT_EQ(reserved, arena.reserved_bytes());
+}
+
+}  // namespace
@@ -36,6 +36,7 @@
 
 #include <map>
 #include <string>
+#include <vector>
 
 #include "common/scoped_ptr.h"
 #include "processor/basic_code_module.h"
@@ -148,18 +149,37 @@ bool ModuleComparer::CompareModule(const BasicModule *basic_module,
                            &(fast_module->windows_frame_info_[i])));
   }
 
+  // Compare cfi_rules_:
+  {
+    std::vector<string>::const_iterator iter1 =
+        basic_module->cfi_rules_.begin();
+    StaticMap<int32_t, char>::iterator iter2 = fast_module->cfi_rules_.begin();
+    int32_t index = 0;
+    while (iter1 != basic_module->cfi_rules_.end()
+        && iter2 != fast_module->cfi_rules_.end()) {
+      ASSERT_TRUE(index == iter2.GetKey());
+      string tmp(iter2.GetValuePtr());
+      ASSERT_TRUE(*iter1 == tmp);
+      ++iter1;
+      ++iter2;
+      ++index;
+    }
+    ASSERT_TRUE(iter1 == basic_module->cfi_rules_.end());
+    ASSERT_TRUE(iter2 == fast_module->cfi_rules_.end());
+  }
+
   // Compare cfi_initial_rules_:
   {
-    RangeMap<MemAddr, string>::MapConstIterator iter1;
-    StaticRangeMap<MemAddr, char>::MapConstIterator iter2;
+    RangeMap<MemAddr, int>::MapConstIterator iter1;
+    StaticRangeMap<MemAddr, int32_t>::MapConstIterator iter2;
     iter1 = basic_module->cfi_initial_rules_.map_.begin();
     iter2 = fast_module->cfi_initial_rules_.map_.begin();
     while (iter1 != basic_module->cfi_initial_rules_.map_.end()
         && iter2 != fast_module->cfi_initial_rules_.map_.end()) {
       ASSERT_TRUE(iter1->first == iter2.GetKey());
       ASSERT_TRUE(iter1->second.base() == iter2.GetValuePtr()->base());
-      string tmp(iter2.GetValuePtr()->entryptr());
-      ASSERT_TRUE(iter1->second.entry() == tmp);
+      ASSERT_TRUE(iter1->second.entry() ==
+                  *iter2.GetValuePtr()->entryptr());
       ++iter1;
       ++iter2;
     }
@@ -169,15 +189,14 @@ bool ModuleComparer::CompareModule(const BasicModule *basic_module,
 
   // Compare cfi_delta_rules_:
   {
-    map<MemAddr, string>::const_iterator iter1;
-    StaticMap<MemAddr, char>::iterator iter2;
+    map<MemAddr, int>::const_iterator iter1;
+    StaticMap<MemAddr, int32_t>::iterator iter2;
     iter1 = basic_module->cfi_delta_rules_.begin();
     iter2 = fast_module->cfi_delta_rules_.begin();
     while (iter1 != basic_module->cfi_delta_rules_.end()
         && iter2 != fast_module->cfi_delta_rules_.end()) {
       ASSERT_TRUE(iter1->first == iter2.GetKey());
-      string tmp(iter2.GetValuePtr());
-      ASSERT_TRUE(iter1->second == tmp);
+      ASSERT_TRUE(iter1->second == *iter2.GetValuePtr());
       ++iter1;
       ++iter2;
     }
@@ -196,21 +215,21 @@ bool ModuleComparer::CompareFunction(const BasicFunc *basic_func,
   ASSERT_TRUE(basic_func->address == fast_func->address);
   ASSERT_TRUE(basic_func->size == fast_func->size);
 
-  // compare range map of lines:
-  RangeMap<MemAddr, linked_ptr<BasicLine> >::MapConstIterator iter1;
+  // compare lines with range map of lines:
   StaticRangeMap<MemAddr, FastLine>::MapConstIterator iter2;
-  iter1 = basic_func->lines.map_.begin();
   iter2 = fast_func->lines.map_.begin();
-  while (iter1 != basic_func->lines.map_.end()
+  size_t index1 = 0;
+  while (index1 < basic_func->line_count
       && iter2 != fast_func->lines.map_.end()) {
-    ASSERT_TRUE(iter1->first == iter2.GetKey());
-    ASSERT_TRUE(iter1->second.base() == iter2.GetValuePtr()->base());
-    ASSERT_TRUE(CompareLine(iter1->second.entry().get(),
-                            iter2.GetValuePtr()->entryptr()));
-    ++iter1;
+    const BasicLine &line =
+        (*basic_func->line_table)[basic_func->first_line + index1];
+    ASSERT_TRUE(line.address + line.size - 1 == iter2.GetKey());
+    ASSERT_TRUE(line.address == iter2.GetValuePtr()->base());
+    ASSERT_TRUE(CompareLine(&line, iter2.GetValuePtr()->entryptr()));
+    ++index1;
     ++iter2;
   }
-  ASSERT_TRUE(iter1 == basic_func->lines.map_.end());
+  ASSERT_TRUE(index1 == basic_func->line_count);
   ASSERT_TRUE(iter2 == fast_func->lines.map_.end());
 
   delete fast_func;
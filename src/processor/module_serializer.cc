@@ -35,19 +35,18 @@
 
 #include "processor/module_serializer.h"
 
+#include <string.h>
+
 #include <map>
 #include <string>
+#include <vector>
 
 #include "processor/basic_code_module.h"
+#include "processor/compressed_module_format.h"
 #include "processor/logging.h"
 
 namespace google_breakpad {
 
-// Definition of static member variable in SimplerSerializer<Funcion>, which
-// is declared in file "simple_serializer-inl.h"
-RangeMapSerializer< MemAddr, linked_ptr<BasicSourceLineResolver::Line> >
-SimpleSerializer<BasicSourceLineResolver::Function>::range_map_serializer_;
-
 size_t ModuleSerializer::SizeOf(const BasicSourceLineResolver::Module &module) {
   size_t total_size_alloc_ = 0;
 
@@ -62,6 +61,7 @@ size_t ModuleSerializer::SizeOf(const BasicSourceLineResolver::Module &module) {
   for (int i = 0; i < WindowsFrameInfo::STACK_INFO_LAST; ++i)
    map_sizes_[map_index++] =
        wfi_serializer_.SizeOf(&(module.windows_frame_info_[i]));
+  map_sizes_[map_index++] = cfi_rules_serializer_.SizeOf(module.cfi_rules_);
   map_sizes_[map_index++] = cfi_init_rules_serializer_.SizeOf(
      module.cfi_initial_rules_);
   map_sizes_[map_index++] = cfi_delta_rules_serializer_.SizeOf(
@@ -93,6 +93,7 @@ char *ModuleSerializer::Write(const BasicSourceLineResolver::Module &module,
   dest = pubsym_serializer_.Write(module.public_symbols_, dest);
   for (int i = 0; i < WindowsFrameInfo::STACK_INFO_LAST; ++i)
     dest = wfi_serializer_.Write(&(module.windows_frame_info_[i]), dest);
+  dest = cfi_rules_serializer_.Write(module.cfi_rules_, dest);
   dest = cfi_init_rules_serializer_.Write(module.cfi_initial_rules_, dest);
   dest = cfi_delta_rules_serializer_.Write(module.cfi_delta_rules_, dest);
   // Write a null terminator.
@@ -192,16 +193,103 @@ bool ModuleSerializer::ConvertOneModule(
 
 char* ModuleSerializer::SerializeSymbolFileData(
     const string &symbol_data, unsigned int *size) {
-  scoped_ptr<BasicSourceLineResolver::Module> module(
-      new BasicSourceLineResolver::Module("no name"));
   scoped_array<char> buffer(new char[symbol_data.size() + 1]);
   memcpy(buffer.get(), symbol_data.c_str(), symbol_data.size());
   buffer.get()[symbol_data.size()] = '\0';
-  if (!module->LoadMapFromMemory(buffer.get(), symbol_data.size() + 1)) {
+  return SerializeSymbolFileData(buffer.get(), symbol_data.size() + 1, size);
+}
+
+char* ModuleSerializer::SerializeSymbolFileData(
+    char *symbol_data, size_t symbol_data_size, unsigned int *size) {
+  scoped_ptr<BasicSourceLineResolver::Module> module(
+      new BasicSourceLineResolver::Module("no name"));
+  if (!module->LoadMapFromMemory(symbol_data, symbol_data_size)) {
     return NULL;
   }
-  buffer.reset(NULL);
   return Serialize(*(module.get()), size);
 }
 
+// static
+char* ModuleSerializer::CompressSerializedData(const char *serialized_data,
+                                               unsigned int size,
+                                               unsigned int *compressed_size) {
+  if (compressed_size) *compressed_size = 0;
+
+  // The is_corrupt flag, then the size of each map, then the maps.
+  size_t header_size = sizeof(bool) + kNumberMaps_ * sizeof(uint32_t);
+  if (!serialized_data || size < header_size) {
+    BPLOG(ERROR) << "CompressSerializedData: not a serialized module";
+    return NULL;
+  }
+  uint32_t map_sizes[kNumberMaps_];
+  memcpy(map_sizes, serialized_data + sizeof(bool), sizeof(map_sizes));
+  size_t maps_size = 0;
+  for (int i = 0; i < kNumberMaps_; ++i)
+    maps_size += map_sizes[i];
+  if (maps_size > size - header_size) {
+    BPLOG(ERROR) << "CompressSerializedData: serialized module is truncated";
+    return NULL;
+  }
+
+  CompressedModuleHeader header;
+  header.signature = kCompressedModuleSignature;
+  header.version = kCompressedModuleVersion;
+  header.map_count = kNumberMaps_;
+  header.is_corrupt = serialized_data[0] != 0;
+
+  CompressedModuleMap maps[kNumberMaps_];
+  uint32_t block_count = 0;
+  for (int i = 0; i < kNumberMaps_; ++i) {
+    maps[i].size = map_sizes[i];
+    maps[i].first_block = block_count;
+    block_count += CompressedModuleBlockCount(map_sizes[i]);
+  }
+
+  // The blocks' data follows the header and the directory.
+  std::vector<CompressedModuleBlock> blocks(block_count);
+  std::vector<uint8_t> data(sizeof(header) + sizeof(maps) +
+                            block_count * sizeof(CompressedModuleBlock));
+  scoped_array<uint8_t> compressed(new uint8_t[kCompressedModuleBlockSize]);
+  scoped_array<uint16_t> hash_table(
+      new uint16_t[kCompressBlockHashTableSize]);
+  const uint8_t *map_data =
+      reinterpret_cast<const uint8_t*>(serialized_data + header_size);
+  uint32_t block_index = 0;
+  for (int i = 0; i < kNumberMaps_; ++i) {
+    for (uint32_t offset = 0; offset < map_sizes[i];
+         offset += kCompressedModuleBlockSize, ++block_index) {
+      size_t block_size = map_sizes[i] - offset;
+      if (block_size > kCompressedModuleBlockSize)
+        block_size = kCompressedModuleBlockSize;
+      const uint8_t *block = map_data + offset;
+
+      // Blocks that don't get smaller are stored as they are.
+      size_t stored_size = CompressBlock(block, block_size, compressed.get(),
+                                         block_size - 1, hash_table.get());
+      if (stored_size == 0) {
+        stored_size = block_size;
+      } else {
+        block = compressed.get();
+      }
+      blocks[block_index].offset = static_cast<uint32_t>(data.size());
+      blocks[block_index].stored_size = static_cast<uint32_t>(stored_size);
+      data.insert(data.end(), block, block + stored_size);
+    }
+    map_data += map_sizes[i];
+  }
+
+  memcpy(&data[0], &header, sizeof(header));
+  memcpy(&data[sizeof(header)], maps, sizeof(maps));
+  if (block_count > 0) {
+    memcpy(&data[sizeof(header) + sizeof(maps)], &blocks[0],
+           block_count * sizeof(CompressedModuleBlock));
+  }
+
+  char *result = new char[data.size()];
+  memcpy(result, &data[0], data.size());
+  if (compressed_size)
+    *compressed_size = static_cast<unsigned int>(data.size());
+  return result;
+}
+
 }  // namespace google_breakpad
@@ -81,6 +81,21 @@ class ModuleSerializer {
   char* SerializeSymbolFileData(const string &symbol_data,
                                 unsigned int *size = NULL);
 
+  // Same as above, but parses the |symbol_data_size| bytes of symbol data in
+  // |symbol_data| in place, which modifies them, rather than parsing a copy.
+  char* SerializeSymbolFileData(char *symbol_data, size_t symbol_data_size,
+                                unsigned int *size = NULL);
+
+  // Converts the |size| bytes of serialized module data in |serialized_data|
+  // into the compressed format described in compressed_module_format.h,
+  // which FastSourceLineResolver also loads, decompressing each map the
+  // first time a lookup needs it.  Returns NULL if |serialized_data| isn't
+  // a serialized module.  Caller takes ownership of the compressed data (on
+  // heap), and owner should call delete [] to free the memory after use.
+  static char* CompressSerializedData(const char *serialized_data,
+                                      unsigned int size,
+                                      unsigned int *compressed_size = NULL);
+
   // Serializes one loaded module with given moduleid in the basic source line
   // resolver, and loads the serialized data into the fast source line resolver.
   // Return false if the basic source line doesn't have a module with the given
@@ -118,8 +133,9 @@ class ModuleSerializer {
   AddressMapSerializer<MemAddr, linked_ptr<PublicSymbol> > pubsym_serializer_;
   ContainedRangeMapSerializer<MemAddr,
                               linked_ptr<WindowsFrameInfo> > wfi_serializer_;
-  RangeMapSerializer<MemAddr, string> cfi_init_rules_serializer_;
-  StdMapSerializer<MemAddr, string> cfi_delta_rules_serializer_;
+  StdVectorSerializer<string> cfi_rules_serializer_;
+  RangeMapSerializer<MemAddr, int> cfi_init_rules_serializer_;
+  StdMapSerializer<MemAddr, int> cfi_delta_rules_serializer_;
 };
 
 }  // namespace google_breakpad
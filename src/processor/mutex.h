@@ -0,0 +1,151 @@
+// Copyright (c) 2016 Google Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+// notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above
+// copyright notice, this list of conditions and the following disclaimer
+// in the documentation and/or other materials provided with the
+// distribution.
+//     * Neither the name of Google Inc. nor the names of its
+// contributors may be used to endorse or promote products derived from
+// this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+// mutex.h: Mutex, a minimal mutual exclusion lock for processor data
+// structures that may be shared between threads, and AutoMutex, which holds
+// a Mutex for the duration of a scope.  ReaderWriterLock is a lock that
+// several readers may hold at once, held for a scope by AutoReaderLock or
+// AutoWriterLock.
+//
+// Both are built on pthreads, or on a critical section and a slim
+// reader/writer lock on Windows.
+
+#ifndef PROCESSOR_MUTEX_H__
+#define PROCESSOR_MUTEX_H__
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <pthread.h>
+#endif  // _WIN32
+
+namespace google_breakpad {
+
+class Mutex {
+ public:
+#ifdef _WIN32
+  Mutex() { InitializeCriticalSection(&section_); }
+  ~Mutex() { DeleteCriticalSection(&section_); }
+  void Lock() { EnterCriticalSection(&section_); }
+  void Unlock() { LeaveCriticalSection(&section_); }
+#else
+  Mutex() { pthread_mutex_init(&mutex_, NULL); }
+  ~Mutex() { pthread_mutex_destroy(&mutex_); }
+  void Lock() { pthread_mutex_lock(&mutex_); }
+  void Unlock() { pthread_mutex_unlock(&mutex_); }
+#endif  // _WIN32
+
+ private:
+#ifdef _WIN32
+  CRITICAL_SECTION section_;
+#else
+  pthread_mutex_t mutex_;
+#endif  // _WIN32
+
+  // Disallow copy constructor and assignment operator.
+  Mutex(const Mutex&);
+  void operator=(const Mutex&);
+};
+
+class AutoMutex {
+ public:
+  explicit AutoMutex(Mutex *mutex) : mutex_(mutex) { mutex_->Lock(); }
+  ~AutoMutex() { mutex_->Unlock(); }
+
+ private:
+  Mutex *mutex_;
+
+  // Disallow copy constructor and assignment operator.
+  AutoMutex(const AutoMutex&);
+  void operator=(const AutoMutex&);
+};
+
+class ReaderWriterLock {
+ public:
+#ifdef _WIN32
+  ReaderWriterLock() { InitializeSRWLock(&lock_); }
+  ~ReaderWriterLock() {}
+  void ReaderLock() { AcquireSRWLockShared(&lock_); }
+  void ReaderUnlock() { ReleaseSRWLockShared(&lock_); }
+  void WriterLock() { AcquireSRWLockExclusive(&lock_); }
+  void WriterUnlock() { ReleaseSRWLockExclusive(&lock_); }
+#else
+  ReaderWriterLock() { pthread_rwlock_init(&lock_, NULL); }
+  ~ReaderWriterLock() { pthread_rwlock_destroy(&lock_); }
+  void ReaderLock() { pthread_rwlock_rdlock(&lock_); }
+  void ReaderUnlock() { pthread_rwlock_unlock(&lock_); }
+  void WriterLock() { pthread_rwlock_wrlock(&lock_); }
+  void WriterUnlock() { pthread_rwlock_unlock(&lock_); }
+#endif  // _WIN32
+
+ private:
+#ifdef _WIN32
+  SRWLOCK lock_;
+#else
+  pthread_rwlock_t lock_;
+#endif  // _WIN32
+
+  // Disallow copy constructor and assignment operator.
+  ReaderWriterLock(const ReaderWriterLock&);
+  void operator=(const ReaderWriterLock&);
+};
+
+class AutoReaderLock {
+ public:
+  explicit AutoReaderLock(ReaderWriterLock *lock) : lock_(lock) {
+    lock_->ReaderLock();
+  }
+  ~AutoReaderLock() { lock_->ReaderUnlock(); }
+
+ private:
+  ReaderWriterLock *lock_;
+
+  // Disallow copy constructor and assignment operator.
+  AutoReaderLock(const AutoReaderLock&);
+  void operator=(const AutoReaderLock&);
+};
+
+class AutoWriterLock {
+ public:
+  explicit AutoWriterLock(ReaderWriterLock *lock) : lock_(lock) {
+    lock_->WriterLock();
+  }
+  ~AutoWriterLock() { lock_->WriterUnlock(); }
+
+ private:
+  ReaderWriterLock *lock_;
+
+  // Disallow copy constructor and assignment operator.
+  AutoWriterLock(const AutoWriterLock&);
+  void operator=(const AutoWriterLock&);
+};
+
+}  // namespace google_breakpad
+
+#endif  // PROCESSOR_MUTEX_H__
@@ -0,0 +1,211 @@
+// Copyright (c) 2016 Google Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+// notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above
+// copyright notice, this list of conditions and the following disclaimer
+// in the documentation and/or other materials provided with the
+// distribution.
+//     * Neither the name of Google Inc. nor the names of its
+// contributors may be used to endorse or promote products derived from
+// this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+// pack_symbol_store.cc: Pack a tree of symbol files into a symbol pack.
+//
+// The symbol store is laid out for SimpleSymbolSupplier, as
+// <debug_file>/<debug_identifier>/<name>.sym under its root.  Every such
+// text symbol file, or with -f every serialized .sym.fast file that
+// serialize_symbol_store wrote, is added to one symbol pack (see
+// symbol_pack.h), which PackSymbolSupplier reads.  The pack is written
+// under a temporary name and renamed into place, so it can replace a pack
+// that processors are using.
+
+#include <dirent.h>
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "common/using_std_string.h"
+#include "processor/logging.h"
+#include "processor/symbol_pack.h"
+
+namespace {
+
+using google_breakpad::SymbolPack;
+using google_breakpad::SymbolPackWriter;
+using std::vector;
+
+const char kSymbolExtension[] = ".sym";
+const char kSerializedExtension[] = ".sym.fast";
+
+// A symbol file to pack, and the module it holds the symbols for.
+struct PackJob {
+  string path;
+  string debug_file;
+  string debug_identifier;
+
+  bool operator<(const PackJob& other) const { return path < other.path; }
+};
+
+bool EndsWith(const string& s, const char* suffix) {
+  size_t suffix_length = strlen(suffix);
+  return s.size() > suffix_length &&
+         s.compare(s.size() - suffix_length, suffix_length, suffix) == 0;
+}
+
+// Returns the names of the entries of the directory |path|, other than "."
+// and "..".  Returns false if it can't be read.
+bool ReadDirectory(const string& path, vector<string>* entries) {
+  DIR* dir = opendir(path.c_str());
+  if (!dir) {
+    BPLOG(ERROR) << "Could not open directory " << path << ": "
+                 << strerror(errno);
+    return false;
+  }
+  struct dirent* entry;
+  while ((entry = readdir(dir)) != NULL) {
+    if (strcmp(entry->d_name, ".") != 0 && strcmp(entry->d_name, "..") != 0)
+      entries->push_back(entry->d_name);
+  }
+  closedir(dir);
+  return true;
+}
+
+bool IsDirectory(const string& path) {
+  struct stat st;
+  return stat(path.c_str(), &st) == 0 && S_ISDIR(st.st_mode);
+}
+
+// Adds a job for every file ending in |extension| two directories below
+// |root|, where SimpleSymbolSupplier would look for it.
+void FindSymbolFiles(const string& root, const char* extension,
+                     vector<PackJob>* jobs) {
+  vector<string> debug_files;
+  ReadDirectory(root, &debug_files);
+  for (size_t i = 0; i < debug_files.size(); ++i) {
+    string debug_file_dir = root + "/" + debug_files[i];
+    if (!IsDirectory(debug_file_dir))
+      continue;
+    vector<string> identifiers;
+    ReadDirectory(debug_file_dir, &identifiers);
+    for (size_t j = 0; j < identifiers.size(); ++j) {
+      string identifier_dir = debug_file_dir + "/" + identifiers[j];
+      if (!IsDirectory(identifier_dir))
+        continue;
+      vector<string> files;
+      ReadDirectory(identifier_dir, &files);
+      for (size_t k = 0; k < files.size(); ++k) {
+        if (!EndsWith(files[k], extension))
+          continue;
+        PackJob job;
+        job.path = identifier_dir + "/" + files[k];
+        job.debug_file = debug_files[i];
+        job.debug_identifier = identifiers[j];
+        jobs->push_back(job);
+      }
+    }
+  }
+}
+
+// Reads the whole of the file at |path| into |data|.
+bool ReadFile(const string& path, vector<char>* data) {
+  FILE* file = fopen(path.c_str(), "rb");
+  if (!file) {
+    BPLOG(ERROR) << "Could not open " << path << ": " << strerror(errno);
+    return false;
+  }
+  data->clear();
+  char buffer[1 << 16];
+  size_t bytes_read;
+  while ((bytes_read = fread(buffer, 1, sizeof(buffer), file)) > 0)
+    data->insert(data->end(), buffer, buffer + bytes_read);
+  bool read = !ferror(file);
+  fclose(file);
+  if (!read)
+    BPLOG(ERROR) << "Could not read " << path;
+  return read;
+}
+
+void usage(const char* program_name) {
+  fprintf(stderr, "usage: %s [-f] <symbol-path> <pack-file>\n"
+          "    -f : Pack serialized .sym.fast files instead of .sym files\n",
+          program_name);
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  BPLOG_INIT(&argc, &argv);
+
+  bool serialized = false;
+  int argi = 1;
+  for (; argi < argc && argv[argi][0] == '-'; ++argi) {
+    if (strcmp(argv[argi], "-f") == 0) {
+      serialized = true;
+    } else {
+      usage(argv[0]);
+      return 1;
+    }
+  }
+  if (argc - argi != 2) {
+    usage(argv[0]);
+    return 1;
+  }
+
+  vector<PackJob> jobs;
+  FindSymbolFiles(argv[argi],
+                  serialized ? kSerializedExtension : kSymbolExtension,
+                  &jobs);
+  // Pack modules in a stable order, so that packing the same store twice
+  // gives the same pack.
+  std::sort(jobs.begin(), jobs.end());
+
+  SymbolPackWriter writer(argv[argi + 1],
+                          serialized ? SymbolPack::FORMAT_SERIALIZED :
+                                       SymbolPack::FORMAT_TEXT);
+  if (!writer.Open())
+    return 1;
+
+  int packed = 0;
+  int failed = 0;
+  vector<char> data;
+  for (size_t i = 0; i < jobs.size(); ++i) {
+    const PackJob& job = jobs[i];
+    if (ReadFile(job.path, &data) &&
+        writer.AddModule(job.debug_file, job.debug_identifier,
+                         data.empty() ? "" : &data[0], data.size())) {
+      ++packed;
+    } else {
+      ++failed;
+    }
+  }
+
+  if (!writer.Finish())
+    return 1;
+
+  printf("%d packed, %d failed\n", packed, failed);
+  return failed == 0 ? 0 : 1;
+}
@@ -0,0 +1,241 @@
+// Copyright (c) 2016 Google Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+// notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above
+// copyright notice, this list of conditions and the following disclaimer
+// in the documentation and/or other materials provided with the
+// distribution.
+//     * Neither the name of Google Inc. nor the names of its
+// contributors may be used to endorse or promote products derived from
+// this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+// pack_symbol_supplier.cc: A SymbolSupplier that reads symbol packs.
+//
+// See pack_symbol_supplier.h for documentation.
+
+#include "processor/pack_symbol_supplier.h"
+
+#include <assert.h>
+#include <string.h>
+
+#include "google_breakpad/processor/code_module.h"
+#include "processor/logging.h"
+#include "processor/symbol_pack.h"
+
+namespace google_breakpad {
+
+PackSymbolSupplier::PackSymbolSupplier(const vector<string> &pack_paths,
+                                       SymbolSupplier *fallback)
+    : fallback_(fallback) {
+  for (size_t i = 0; i < pack_paths.size(); ++i) {
+    SymbolPack *pack = SymbolPack::Open(pack_paths[i]);
+    if (pack) {
+      BPLOG(INFO) << "Opened symbol pack " << pack_paths[i] << " with "
+                  << pack->module_count() << " modules";
+      packs_.push_back(pack);
+    }
+  }
+}
+
+PackSymbolSupplier::~PackSymbolSupplier() {
+  for (map<string, pair<void *, size_t> >::iterator mapped =
+           mapped_buffers_.begin();
+       mapped != mapped_buffers_.end(); ++mapped) {
+    SymbolPack::UnmapCopy(mapped->second.first, mapped->second.second);
+  }
+  for (map<string, char *>::iterator it = memory_buffers_.begin();
+       it != memory_buffers_.end(); ++it) {
+    delete [] it->second;
+  }
+  for (size_t i = 0; i < packs_.size(); ++i)
+    delete packs_[i];
+}
+
+const SymbolPack *PackSymbolSupplier::FindModule(const CodeModule *module,
+                                                 const char **data,
+                                                 size_t *size,
+                                                 string *symbol_file) const {
+  if (!module || module->debug_file().empty() ||
+      module->debug_identifier().empty()) {
+    return NULL;
+  }
+
+  string key = SymbolPack::MakeKey(module->debug_file(),
+                                   module->debug_identifier());
+  for (size_t i = 0; i < packs_.size(); ++i) {
+    if (packs_[i]->Find(key, data, size)) {
+      *symbol_file = packs_[i]->path() + "#" + key;
+      return packs_[i];
+    }
+  }
+  return NULL;
+}
+
+SymbolSupplier::SymbolResult PackSymbolSupplier::GetSymbolFile(
+    const CodeModule *module, const SystemInfo *system_info,
+    string *symbol_file) {
+  BPLOG_IF(ERROR, !symbol_file) << "PackSymbolSupplier::GetSymbolFile "
+                                   "requires |symbol_file|";
+  assert(symbol_file);
+  symbol_file->clear();
+
+  const char *data;
+  size_t size;
+  if (FindModule(module, &data, &size, symbol_file))
+    return FOUND;
+  if (fallback_)
+    return fallback_->GetSymbolFile(module, system_info, symbol_file);
+  return NOT_FOUND;
+}
+
+SymbolSupplier::SymbolResult PackSymbolSupplier::GetSymbolFile(
+    const CodeModule *module, const SystemInfo *system_info,
+    string *symbol_file, string *symbol_data) {
+  assert(symbol_file);
+  symbol_file->clear();
+
+  const char *data;
+  size_t size;
+  if (FindModule(module, &data, &size, symbol_file)) {
+    if (symbol_data)
+      symbol_data->assign(data, size);
+    return FOUND;
+  }
+  if (fallback_) {
+    return fallback_->GetSymbolFile(module, system_info, symbol_file,
+                                    symbol_data);
+  }
+  return NOT_FOUND;
+}
+
+SymbolSupplier::SymbolResult PackSymbolSupplier::GetCStringSymbolData(
+    const CodeModule *module,
+    const SystemInfo *system_info,
+    string *symbol_file,
+    char **symbol_data,
+    size_t *symbol_data_size) {
+  assert(symbol_file);
+  assert(symbol_data);
+  assert(symbol_data_size);
+  symbol_file->clear();
+
+  const char *data;
+  size_t size;
+  const SymbolPack *pack = FindModule(module, &data, &size, symbol_file);
+  if (!pack) {
+    if (fallback_) {
+      return fallback_->GetCStringSymbolData(module, system_info, symbol_file,
+                                             symbol_data, symbol_data_size);
+    }
+    return NOT_FOUND;
+  }
+
+  // The size handed out includes the '\0' after the data.
+  *symbol_data_size = size + 1;
+
+  void *mapping;
+  size_t mapping_size;
+  if (pack->MapPrivateCopy(data, size, symbol_data, &mapping,
+                           &mapping_size)) {
+    mapped_buffers_.insert(
+        std::make_pair(module->code_file(),
+                       std::make_pair(mapping, mapping_size)));
+    return FOUND;
+  }
+
+  *symbol_data = new char[*symbol_data_size];
+  memcpy(*symbol_data, data, *symbol_data_size);
+  memory_buffers_.insert(std::make_pair(module->code_file(), *symbol_data));
+  return FOUND;
+}
+
+void PackSymbolSupplier::FreeSymbolData(const CodeModule *module) {
+  if (!module) {
+    BPLOG(INFO) << "Cannot free symbol data buffer for NULL module";
+    return;
+  }
+
+  map<string, pair<void *, size_t> >::iterator mapped =
+      mapped_buffers_.find(module->code_file());
+  if (mapped != mapped_buffers_.end()) {
+    SymbolPack::UnmapCopy(mapped->second.first, mapped->second.second);
+    mapped_buffers_.erase(mapped);
+    return;
+  }
+
+  map<string, char *>::iterator it = memory_buffers_.find(module->code_file());
+  if (it != memory_buffers_.end()) {
+    delete [] it->second;
+    memory_buffers_.erase(it);
+    return;
+  }
+
+  if (fallback_)
+    fallback_->FreeSymbolData(module);
+}
+
+SymbolSupplier::SymbolResult PackSymbolSupplier::GetMappableSymbolFile(
+    const CodeModule *module, const SystemInfo *system_info,
+    string *symbol_file) {
+  assert(symbol_file);
+  symbol_file->clear();
+
+  // Symbols in a pack take precedence over the fallback's.
+  const char *data;
+  size_t size;
+  string pack_symbol_file;
+  if (!fallback_ || FindModule(module, &data, &size, &pack_symbol_file))
+    return NOT_FOUND;
+  return fallback_->GetMappableSymbolFile(module, system_info, symbol_file);
+}
+
+SymbolSupplier::SymbolResult PackSymbolSupplier::GetCompressedSymbolFile(
+    const CodeModule *module, const SystemInfo *system_info,
+    string *symbol_file) {
+  assert(symbol_file);
+  symbol_file->clear();
+
+  const char *data;
+  size_t size;
+  string pack_symbol_file;
+  if (!fallback_ || FindModule(module, &data, &size, &pack_symbol_file))
+    return NOT_FOUND;
+  return fallback_->GetCompressedSymbolFile(module, system_info, symbol_file);
+}
+
+SymbolSupplier::SymbolResult PackSymbolSupplier::GetIndexedSymbolFile(
+    const CodeModule *module, const SystemInfo *system_info,
+    string *symbol_file, string *index_file) {
+  assert(symbol_file);
+  assert(index_file);
+  symbol_file->clear();
+  index_file->clear();
+
+  const char *data;
+  size_t size;
+  string pack_symbol_file;
+  if (!fallback_ || FindModule(module, &data, &size, &pack_symbol_file))
+    return NOT_FOUND;
+  return fallback_->GetIndexedSymbolFile(module, system_info, symbol_file,
+                                         index_file);
+}
+
+}  // namespace google_breakpad
@@ -0,0 +1,143 @@
+// Copyright (c) 2016 Google Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+// notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above
+// copyright notice, this list of conditions and the following disclaimer
+// in the documentation and/or other materials provided with the
+// distribution.
+//     * Neither the name of Google Inc. nor the names of its
+// contributors may be used to endorse or promote products derived from
+// this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+// pack_symbol_supplier.h: A SymbolSupplier that reads symbol packs.
+//
+// PackSymbolSupplier finds symbols in one or more symbol packs (see
+// symbol_pack.h), which are opened and mapped into memory once, when the
+// supplier is created.  Finding a module's symbols takes a hash table probe
+// in each pack instead of a search of a directory tree.  The packs are
+// searched in the order given, and a module found in none of them may be
+// looked for with another SymbolSupplier, such as a SimpleSymbolSupplier
+// for symbols that have not been packed yet.
+//
+// Text symbols are handed to the resolver in a private mapping of the pack,
+// so that they are read in as they are parsed rather than copied.  A pack
+// of serialized symbols is only of use with a FastSourceLineResolver, and a
+// pack of text symbols with a BasicSourceLineResolver.
+
+#ifndef PROCESSOR_PACK_SYMBOL_SUPPLIER_H__
+#define PROCESSOR_PACK_SYMBOL_SUPPLIER_H__
+
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "common/using_std_string.h"
+#include "google_breakpad/processor/symbol_supplier.h"
+
+namespace google_breakpad {
+
+using std::map;
+using std::pair;
+using std::vector;
+
+class CodeModule;
+class SymbolPack;
+
+class PackSymbolSupplier : public SymbolSupplier {
+ public:
+  // Opens the packs at |pack_paths|.  Packs that can't be opened are
+  // logged and left out.  |fallback|, if not NULL, is asked for the
+  // symbols of modules that none of the packs hold; it is not owned, and
+  // must outlive the PackSymbolSupplier.
+  PackSymbolSupplier(const vector<string> &pack_paths,
+                     SymbolSupplier *fallback);
+  virtual ~PackSymbolSupplier();
+
+  // The number of packs that could be opened.
+  size_t pack_count() const { return packs_.size(); }
+
+  // Sets |symbol_file| to a name for the module's symbols in a pack, the
+  // pack's path and the module's key separated by '#'.  That isn't the
+  // name of a file that can be opened, so only the GetSymbolFile that also
+  // returns the symbol data, and GetCStringSymbolData, are of use to a
+  // resolver.
+  virtual SymbolResult GetSymbolFile(const CodeModule *module,
+                                     const SystemInfo *system_info,
+                                     string *symbol_file);
+
+  virtual SymbolResult GetSymbolFile(const CodeModule *module,
+                                     const SystemInfo *system_info,
+                                     string *symbol_file,
+                                     string *symbol_data);
+
+  virtual SymbolResult GetCStringSymbolData(const CodeModule *module,
+                                            const SystemInfo *system_info,
+                                            string *symbol_file,
+                                            char **symbol_data,
+                                            size_t *symbol_data_size);
+
+  virtual void FreeSymbolData(const CodeModule *module);
+
+  // Packs hold no files to map, decompress or load through an index, so
+  // these only find the fallback's, for modules that aren't in a pack.
+  virtual SymbolResult GetMappableSymbolFile(const CodeModule *module,
+                                             const SystemInfo *system_info,
+                                             string *symbol_file);
+
+  virtual SymbolResult GetCompressedSymbolFile(const CodeModule *module,
+                                               const SystemInfo *system_info,
+                                               string *symbol_file);
+
+  virtual SymbolResult GetIndexedSymbolFile(const CodeModule *module,
+                                            const SystemInfo *system_info,
+                                            string *symbol_file,
+                                            string *index_file);
+
+ private:
+  // Looks for the symbols for |module| in the packs.  On success, sets
+  // |*data| and |*size| as SymbolPack::Find does, and |symbol_file| as
+  // GetSymbolFile does, and returns the pack that holds them.  Returns
+  // NULL if no pack holds them.
+  const SymbolPack *FindModule(const CodeModule *module,
+                               const char **data,
+                               size_t *size,
+                               string *symbol_file) const;
+
+  vector<SymbolPack*> packs_;
+  SymbolSupplier *fallback_;
+
+  // Buffers handed out by GetCStringSymbolData that are private mappings
+  // of a pack, with the mappings that hold them and their sizes.
+  map<string, pair<void *, size_t> > mapped_buffers_;
+
+  // Buffers handed out by GetCStringSymbolData that are copies on the heap,
+  // for when a pack can't be mapped privately.
+  map<string, char *> memory_buffers_;
+
+  // Disallow copy constructor and assignment operator.
+  PackSymbolSupplier(const PackSymbolSupplier&);
+  void operator=(const PackSymbolSupplier&);
+};
+
+}  // namespace google_breakpad
+
+#endif  // PROCESSOR_PACK_SYMBOL_SUPPLIER_H__
@@ -0,0 +1,288 @@
+// Copyright (c) 2016 Google Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+// notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above
+// copyright notice, this list of conditions and the following disclaimer
+// in the documentation and/or other materials provided with the
+// distribution.
+//     * Neither the name of Google Inc. nor the names of its
+// contributors may be used to endorse or promote products derived from
+// this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+// pack_symbol_supplier_unittest.cc: Unit tests for SymbolPack,
+// SymbolPackWriter and PackSymbolSupplier.
+
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "breakpad_googletest_includes.h"
+#include "common/scoped_ptr.h"
+#include "common/tests/auto_tempdir.h"
+#include "common/using_std_string.h"
+#include "google_breakpad/processor/basic_source_line_resolver.h"
+#include "google_breakpad/processor/stack_frame.h"
+#include "google_breakpad/processor/system_info.h"
+#include "processor/basic_code_module.h"
+#include "processor/pack_symbol_supplier.h"
+#include "processor/simple_symbol_supplier.h"
+#include "processor/symbol_pack.h"
+
+namespace {
+
+using google_breakpad::AutoTempDir;
+using google_breakpad::BasicCodeModule;
+using google_breakpad::BasicSourceLineResolver;
+using google_breakpad::PackSymbolSupplier;
+using google_breakpad::SimpleSymbolSupplier;
+using google_breakpad::scoped_ptr;
+using google_breakpad::StackFrame;
+using google_breakpad::SymbolPack;
+using google_breakpad::SymbolPackWriter;
+using google_breakpad::SymbolSupplier;
+using google_breakpad::SystemInfo;
+using std::vector;
+
+const char kTestAppSymbols[] =
+    "MODULE windows x86 5A9832E5287241C1838ED98914E9B7FF1 test_app.pdb\n"
+    "FILE 1 c:\\test_app.cc\n"
+    "FUNC 1000 10 0 main\n"
+    "1000 10 7 1\n";
+
+string ReadFile(const string &path) {
+  std::ifstream in(path.c_str());
+  string contents;
+  std::getline(in, contents, string::traits_type::to_char_type(
+                   string::traits_type::eof()));
+  return contents;
+}
+
+class PackSymbolSupplierTest : public ::testing::Test {
+ public:
+  PackSymbolSupplierTest()
+      : test_app_(0x400000, 0x10000, "c:\\test_app.exe", "",
+                  "c:\\test_app.pdb", "5A9832E5287241C1838ED98914E9B7FF1",
+                  ""),
+        kernel32_(0x7c800000, 0x10000, "C:\\WINDOWS\\system32\\kernel32.dll",
+                  "", "kernel32.pdb", "BCE8785C57B44245A669896B6A19B9542",
+                  ""),
+        missing_(0x10000000, 0x10000, "c:\\missing.dll", "", "missing.pdb",
+                 "0123456789ABCDEF0123456789ABCDEF0", "") {
+    char symbols_dir[PATH_MAX];
+    string relative_dir = string(getenv("srcdir") ? getenv("srcdir") : ".") +
+                          "/src/processor/testdata/symbols";
+    if (realpath(relative_dir.c_str(), symbols_dir))
+      symbols_dir_ = symbols_dir;
+    pack_path_ = temp_dir_.path() + "/symbols.pack";
+  }
+
+  // Writes a text pack holding the test_app symbols above.
+  bool WriteTestAppPack() {
+    SymbolPackWriter writer(pack_path_, SymbolPack::FORMAT_TEXT);
+    return writer.Open() &&
+           writer.AddModule("test_app.pdb",
+                            "5A9832E5287241C1838ED98914E9B7FF1",
+                            kTestAppSymbols, strlen(kTestAppSymbols)) &&
+           writer.Finish();
+  }
+
+  AutoTempDir temp_dir_;
+  string symbols_dir_;
+  string pack_path_;
+  SystemInfo system_info_;
+  BasicCodeModule test_app_;
+  BasicCodeModule kernel32_;
+  BasicCodeModule missing_;
+};
+
+TEST_F(PackSymbolSupplierTest, FindsManyModules) {
+  const int kModuleCount = 1000;
+  SymbolPackWriter writer(pack_path_, SymbolPack::FORMAT_SERIALIZED);
+  ASSERT_TRUE(writer.Open());
+  for (int i = 0; i < kModuleCount; ++i) {
+    char identifier[40], data[32];
+    snprintf(identifier, sizeof(identifier), "%033X", i);
+    snprintf(data, sizeof(data), "symbols %d", i);
+    ASSERT_TRUE(writer.AddModule("module.pdb", identifier, data,
+                                 strlen(data)));
+  }
+  // A module can only be added once.
+  EXPECT_FALSE(writer.AddModule("c:\\module.pdb",
+                                "000000000000000000000000000000000",
+                                "again", 5));
+  ASSERT_TRUE(writer.Finish());
+
+  scoped_ptr<SymbolPack> pack(SymbolPack::Open(pack_path_));
+  ASSERT_TRUE(pack.get());
+  EXPECT_EQ(SymbolPack::FORMAT_SERIALIZED, pack->format());
+  EXPECT_EQ(static_cast<uint64_t>(kModuleCount), pack->module_count());
+  for (int i = 0; i < kModuleCount; ++i) {
+    char identifier[40], data[32];
+    snprintf(identifier, sizeof(identifier), "%033X", i);
+    snprintf(data, sizeof(data), "symbols %d", i);
+    const char *found;
+    size_t size;
+    ASSERT_TRUE(pack->Find(SymbolPack::MakeKey("module.pdb", identifier),
+                           &found, &size));
+    EXPECT_EQ(string(data), string(found, size));
+    EXPECT_EQ('\0', found[size]);
+  }
+
+  const char *found;
+  size_t size;
+  EXPECT_FALSE(pack->Find(SymbolPack::MakeKey("module.pdb", "F"), &found,
+                          &size));
+  string other_key = SymbolPack::MakeKey("other.pdb",
+                                         "000000000000000000000000000000000");
+  EXPECT_FALSE(pack->Find(other_key, &found, &size));
+}
+
+TEST_F(PackSymbolSupplierTest, RejectsBadPacks) {
+  EXPECT_FALSE(SymbolPack::Open(temp_dir_.path() + "/nonexistent"));
+
+  string bad_path = temp_dir_.path() + "/bad.pack";
+  std::ofstream bad(bad_path.c_str());
+  bad << kTestAppSymbols;
+  bad.close();
+  EXPECT_FALSE(SymbolPack::Open(bad_path));
+
+  // A pack with no modules is valid, and finds nothing.
+  SymbolPackWriter writer(pack_path_, SymbolPack::FORMAT_TEXT);
+  ASSERT_TRUE(writer.Open());
+  ASSERT_TRUE(writer.Finish());
+  scoped_ptr<SymbolPack> pack(SymbolPack::Open(pack_path_));
+  ASSERT_TRUE(pack.get());
+  const char *found;
+  size_t size;
+  EXPECT_FALSE(pack->Find(SymbolPack::MakeKey(test_app_.debug_file(),
+                                              test_app_.debug_identifier()),
+                          &found, &size));
+}
+
+TEST_F(PackSymbolSupplierTest, SuppliesSymbolData) {
+  ASSERT_TRUE(WriteTestAppPack());
+  PackSymbolSupplier supplier(vector<string>(1, pack_path_), NULL);
+  ASSERT_EQ(1U, supplier.pack_count());
+
+  string symbol_file, symbol_data;
+  ASSERT_EQ(SymbolSupplier::FOUND,
+            supplier.GetSymbolFile(&test_app_, &system_info_, &symbol_file,
+                                   &symbol_data));
+  EXPECT_EQ(pack_path_ + "#test_app.pdb/5A9832E5287241C1838ED98914E9B7FF1",
+            symbol_file);
+  EXPECT_EQ(kTestAppSymbols, symbol_data);
+  EXPECT_EQ(SymbolSupplier::NOT_FOUND,
+            supplier.GetSymbolFile(&kernel32_, &system_info_, &symbol_file));
+
+  // The buffer is the resolver's to modify, without changing the pack.
+  char *buffer;
+  size_t buffer_size;
+  ASSERT_EQ(SymbolSupplier::FOUND,
+            supplier.GetCStringSymbolData(&test_app_, &system_info_,
+                                          &symbol_file, &buffer,
+                                          &buffer_size));
+  ASSERT_EQ(strlen(kTestAppSymbols) + 1, buffer_size);
+  EXPECT_STREQ(kTestAppSymbols, buffer);
+  memset(buffer, 'x', buffer_size - 1);
+  supplier.FreeSymbolData(&test_app_);
+
+  ASSERT_EQ(SymbolSupplier::FOUND,
+            supplier.GetCStringSymbolData(&test_app_, &system_info_,
+                                          &symbol_file, &buffer,
+                                          &buffer_size));
+  EXPECT_STREQ(kTestAppSymbols, buffer);
+  supplier.FreeSymbolData(&test_app_);
+}
+
+TEST_F(PackSymbolSupplierTest, FallsBack) {
+  ASSERT_FALSE(symbols_dir_.empty());
+  ASSERT_TRUE(WriteTestAppPack());
+  SimpleSymbolSupplier fallback(symbols_dir_);
+  vector<string> pack_paths;
+  pack_paths.push_back(temp_dir_.path() + "/nonexistent");
+  pack_paths.push_back(pack_path_);
+  PackSymbolSupplier supplier(pack_paths, &fallback);
+  EXPECT_EQ(1U, supplier.pack_count());
+
+  // test_app is in the pack as well as the symbol store, and the pack's
+  // symbols are preferred.
+  string symbol_file, symbol_data;
+  ASSERT_EQ(SymbolSupplier::FOUND,
+            supplier.GetSymbolFile(&test_app_, &system_info_, &symbol_file,
+                                   &symbol_data));
+  EXPECT_EQ(kTestAppSymbols, symbol_data);
+
+  ASSERT_EQ(SymbolSupplier::FOUND,
+            supplier.GetSymbolFile(&kernel32_, &system_info_, &symbol_file,
+                                   &symbol_data));
+  EXPECT_EQ(symbols_dir_ + "/kernel32.pdb/BCE8785C57B44245A669896B6A19B9542/"
+                           "kernel32.sym",
+            symbol_file);
+  EXPECT_EQ(ReadFile(symbol_file), symbol_data);
+
+  char *buffer;
+  size_t buffer_size;
+  ASSERT_EQ(SymbolSupplier::FOUND,
+            supplier.GetCStringSymbolData(&kernel32_, &system_info_,
+                                          &symbol_file, &buffer,
+                                          &buffer_size));
+  EXPECT_EQ(symbol_data, string(buffer, buffer_size - 1));
+  supplier.FreeSymbolData(&kernel32_);
+
+  EXPECT_EQ(SymbolSupplier::NOT_FOUND,
+            supplier.GetSymbolFile(&missing_, &system_info_, &symbol_file));
+}
+
+TEST_F(PackSymbolSupplierTest, ResolvesFromPack) {
+  ASSERT_TRUE(WriteTestAppPack());
+  PackSymbolSupplier supplier(vector<string>(1, pack_path_), NULL);
+
+  string symbol_file;
+  char *buffer;
+  size_t buffer_size;
+  ASSERT_EQ(SymbolSupplier::FOUND,
+            supplier.GetCStringSymbolData(&test_app_, &system_info_,
+                                          &symbol_file, &buffer,
+                                          &buffer_size));
+  BasicSourceLineResolver resolver;
+  ASSERT_TRUE(resolver.LoadModuleUsingMemoryBuffer(&test_app_, buffer,
+                                                   buffer_size));
+  supplier.FreeSymbolData(&test_app_);
+
+  StackFrame frame;
+  frame.instruction = 0x401004;
+  frame.module = &test_app_;
+  resolver.FillSourceLineInfo(&frame);
+  EXPECT_EQ("main", frame.function_name);
+  EXPECT_EQ("c:\\test_app.cc", frame.source_file_name);
+  EXPECT_EQ(7, frame.source_line);
+}
+
+}  // namespace
+
+int main(int argc, char *argv[]) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
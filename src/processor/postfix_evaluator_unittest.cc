@@ -43,6 +43,7 @@
 #include "google_breakpad/common/breakpad_types.h"
 #include "google_breakpad/processor/memory_region.h"
 #include "processor/logging.h"
+#include "processor/windows_frame_program.h"
 
 
 namespace {
@@ -51,6 +52,7 @@ namespace {
 using std::map;
 using google_breakpad::MemoryRegion;
 using google_breakpad::PostfixEvaluator;
+using google_breakpad::WindowsFrameProgram;
 
 
 // FakeMemoryRegion is used to test PostfixEvaluator's dereference (^)
@@ -393,11 +395,101 @@ static bool RunTests() {
 }
 
 
+// Checks that WindowsFrameProgram evaluates program strings as
+// PostfixEvaluator<uint32_t> does: the same result, and the same values
+// and assignments afterwards.
+static bool RunWindowsFrameProgramTests() {
+  const char* const kExpressions[] = {
+    "$rAdd 2 2 + =",
+    "$rAdd2\t2\n2 + =",
+    " $rAdd2  2 2 +   = ",
+    "$T0 2 = +",
+    "2 + =",
+    "^",
+    "=",
+    "2 2 =",
+    "k 2 =",
+    ".cbParams 2 =",
+    "2 2 +",
+    "$ebp",
+    "0 $T1 0 0 + =",
+    "$T2 $T2 2 + =",
+    "$eip 0x10 =",
+    "$eip 4294967296 =",
+    "$eip -4 =",
+    "$rMul 9 6 * = $rSub 9 6 - = $rDivQ 9 6 / = $rDivM 9 6 % =",
+    "$rDeref 9 ^ = $rAlign 36 8 @ =",
+    "$rAdd3 2 2 + =$rMul2 9 6 * =",
+    "$T0 $ebp = $eip $T0 4 + ^ = $ebp $T0 ^ = $esp $T0 8 + = "
+    "$L $T0 .cbSavedRegs - = $P $T0 8 + .cbParams + =",
+    "$T0 $ebp = $T2 $esp = $T1 .raSearchStart = $eip $T1 ^ = $ebp $T0 = "
+    "$esp $T1 4 + = $L $T0 .cbSavedRegs - = $P $T1 4 + .cbParams + = "
+    "$ebx $T0 28 - ^ =",
+    "$T0 .raSearch = $eip $T0 ^ = $esp $T0 4 + = $T3 $T0 16 @ = "
+    "$esi $T3 ^ = $ebp $T4 =",
+    "$T0 $ebp = $eip $T0 4 + ^ = $ebp 1 2 3 4 5 6 7 8 9 10 11 12 13 14 15 "
+    "16 17 + + + + + + + + + + + + + + + + ="
+  };
+
+  FakeMemoryRegion fake_memory;
+  for (size_t i = 0; i < sizeof(kExpressions) / sizeof(kExpressions[0]);
+       ++i) {
+    const string expression = kExpressions[i];
+
+    PostfixEvaluator<uint32_t>::DictionaryType dictionary;
+    dictionary["$ebp"] = 0xbfff0010;
+    dictionary["$esp"] = 0xbfff0000;
+    dictionary[".cbSavedRegs"] = 4;
+    dictionary[".cbParams"] = 4;
+    dictionary[".raSearchStart"] = 0xbfff0020;
+    dictionary[".raSearch"] = 0xbfff0020;
+    PostfixEvaluator<uint32_t> evaluator(&dictionary, &fake_memory);
+    PostfixEvaluator<uint32_t>::DictionaryValidityType assigned;
+    bool expected_result = evaluator.Evaluate(expression, &assigned);
+
+    WindowsFrameProgram program(expression);
+    WindowsFrameProgram::Environment environment(program);
+    environment.Set(WindowsFrameProgram::kEBP, 0xbfff0010);
+    environment.Set(WindowsFrameProgram::kESP, 0xbfff0000);
+    environment.Set(WindowsFrameProgram::kSavedRegs, 4);
+    environment.Set(WindowsFrameProgram::kParams, 4);
+    environment.Set(WindowsFrameProgram::kRASearchStart, 0xbfff0020);
+    environment.Set(WindowsFrameProgram::kRASearch, 0xbfff0020);
+    bool result = program.Evaluate(&fake_memory, &environment);
+
+    if (result != expected_result) {
+      fprintf(stderr, "FAIL: program \"%s\", expected %s, observed %s\n",
+              expression.c_str(),
+              expected_result ? "evaluable" : "not evaluable",
+              result ? "evaluated" : "not evaluated");
+      return false;
+    }
+
+    for (PostfixEvaluator<uint32_t>::DictionaryType::const_iterator
+             entry = dictionary.begin();
+         entry != dictionary.end();
+         ++entry) {
+      int variable = program.FindVariable(entry->first);
+      if (variable < 0 || !environment.Defined(variable) ||
+          environment.Get(variable) != entry->second ||
+          environment.Assigned(variable) !=
+              (assigned.find(entry->first) != assigned.end())) {
+        fprintf(stderr, "FAIL: program \"%s\", \"%s\" differs\n",
+                expression.c_str(), entry->first.c_str());
+        return false;
+      }
+    }
+  }
+
+  return true;
+}
+
+
 }  // namespace
 
 
 int main(int argc, char **argv) {
   BPLOG_INIT(&argc, &argv);
 
-  return RunTests() ? 0 : 1;
+  return RunTests() && RunWindowsFrameProgramTests() ? 0 : 1;
 }
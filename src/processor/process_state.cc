@@ -54,16 +54,39 @@ void ProcessState::Clear() {
   for (vector<CallStack *>::const_iterator iterator = threads_.begin();
        iterator != threads_.end();
        ++iterator) {
-    delete *iterator;
+    DeleteCallStack(*iterator);
   }
   threads_.clear();
+  // thread_memory_regions_ DOES NOT own the MemoryRegion pointers.
+  thread_memory_regions_.clear();
+  frame_arena_.Rewind();
   system_info_.Clear();
   // modules_without_symbols_ and modules_with_corrupt_symbols_ DO NOT own
   // the underlying CodeModule pointers.  Just clear the vectors.
   modules_without_symbols_.clear();
   modules_with_corrupt_symbols_.clear();
+  handler_timings_.clear();
   delete modules_;
   modules_ = NULL;
+  statistics_.Clear();
+}
+
+CallStack* ProcessState::NewCallStack(FrameArena* arena) {
+  CallStack* stack = new (arena) CallStack();
+  if (!spare_frames_.empty()) {
+    stack->frames_.swap(spare_frames_.back());
+    spare_frames_.pop_back();
+  }
+  return stack;
+}
+
+void ProcessState::DeleteCallStack(CallStack* stack) {
+  stack->Clear();
+  if (stack->frames_.capacity()) {
+    spare_frames_.push_back(vector<StackFrame*>());
+    spare_frames_.back().swap(stack->frames_);
+  }
+  delete stack;
 }
 
 }  // namespace google_breakpad
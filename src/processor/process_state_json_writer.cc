@@ -0,0 +1,392 @@
+// Copyright (c) 2016 Google Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+// notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above
+// copyright notice, this list of conditions and the following disclaimer
+// in the documentation and/or other materials provided with the
+// distribution.
+//     * Neither the name of Google Inc. nor the names of its
+// contributors may be used to endorse or promote products derived from
+// this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+// process_state_json_writer.cc: Implementation of ProcessStateJSONWriter.
+//
+// See process_state_json_writer.h for documentation.
+
+#include "processor/process_state_json_writer.h"
+
+#include <assert.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <algorithm>
+
+#include "google_breakpad/processor/call_stack.h"
+#include "google_breakpad/processor/code_module.h"
+#include "google_breakpad/processor/code_modules.h"
+#include "google_breakpad/processor/process_state.h"
+#include "google_breakpad/processor/stack_frame.h"
+#include "google_breakpad/processor/system_info.h"
+
+namespace google_breakpad {
+
+namespace {
+
+using std::vector;
+
+// Returns the position in |path| of its last component, as
+// PathnameStripper::File would return it.
+size_t FileNameStart(const string &path) {
+  string::size_type slash = path.find_last_of("/\\");
+  return slash == string::npos ? 0 : slash + 1;
+}
+
+const char *TrustName(StackFrame::FrameTrust trust) {
+  switch (trust) {
+    case StackFrame::FRAME_TRUST_CONTEXT:
+      return "context";
+    case StackFrame::FRAME_TRUST_PREWALKED:
+      return "prewalked";
+    case StackFrame::FRAME_TRUST_CFI:
+      return "cfi";
+    case StackFrame::FRAME_TRUST_CFI_SCAN:
+      return "cfi_scan";
+    case StackFrame::FRAME_TRUST_FP:
+      return "frame_pointer";
+    case StackFrame::FRAME_TRUST_SCAN:
+      return "scan";
+    default:
+      return "none";
+  }
+}
+
+bool ContainsModule(const vector<const CodeModule*> *modules,
+                    const CodeModule *module) {
+  for (vector<const CodeModule*>::const_iterator iter = modules->begin();
+       iter != modules->end(); ++iter) {
+    if (*iter == module ||
+        (module->debug_file() == (*iter)->debug_file() &&
+         module->debug_identifier() == (*iter)->debug_identifier())) {
+      return true;
+    }
+  }
+  return false;
+}
+
+}  // namespace
+
+ProcessStateJSONWriter::ProcessStateJSONWriter()
+    : depth_(0),
+      after_key_(false) {
+}
+
+void ProcessStateJSONWriter::Write(const ProcessState &process_state) {
+  buffer_.clear();
+  depth_ = 0;
+  after_key_ = false;
+
+  BeginObject();
+
+  const SystemInfo *system_info = process_state.system_info();
+  Key("system_info");
+  BeginObject();
+  StringMember("os", system_info->os);
+  StringMember("os_version", system_info->os_version);
+  StringMember("cpu", system_info->cpu);
+  StringMember("cpu_info", system_info->cpu_info);
+  Key("cpu_count");
+  Integer(system_info->cpu_count);
+  EndObject();
+
+  Key("crash_info");
+  BeginObject();
+  Key("crashed");
+  Boolean(process_state.crashed());
+  if (process_state.crashed()) {
+    StringMember("reason", process_state.crash_reason());
+    Key("address");
+    Address(process_state.crash_address());
+  }
+  StringMember("assertion", process_state.assertion());
+  EndObject();
+
+  if (process_state.requesting_thread() != -1) {
+    Key("requesting_thread");
+    Integer(process_state.requesting_thread());
+  }
+  if (process_state.time_date_stamp() != 0) {
+    Key("time_date_stamp");
+    Integer(process_state.time_date_stamp());
+  }
+  if (process_state.process_create_time() != 0) {
+    Key("process_create_time");
+    Integer(process_state.process_create_time());
+  }
+
+  WriteModules(process_state);
+
+  Key("threads");
+  BeginArray();
+  const vector<CallStack*> *threads = process_state.threads();
+  for (size_t i = 0; i < threads->size(); ++i)
+    WriteStack(threads->at(i));
+  EndArray();
+
+  EndObject();
+  assert(depth_ == 0);
+}
+
+void ProcessStateJSONWriter::WriteModules(const ProcessState &process_state) {
+  const CodeModules *modules = process_state.modules();
+  IndexModules(modules);
+
+  Key("modules");
+  BeginArray();
+  if (modules) {
+    const CodeModule *main_module = modules->GetMainModule();
+    unsigned int module_count = modules->module_count();
+    for (unsigned int sequence = 0; sequence < module_count; ++sequence) {
+      const CodeModule *module = modules->GetModuleAtSequence(sequence);
+      BeginObject();
+      string code_file = module->code_file();
+      Key("filename");
+      size_t start = FileNameStart(code_file);
+      String(code_file.data() + start, code_file.size() - start);
+      StringMember("version", module->version());
+      string debug_file = module->debug_file();
+      start = FileNameStart(debug_file);
+      if (start < debug_file.size()) {
+        Key("debug_file");
+        String(debug_file.data() + start, debug_file.size() - start);
+      }
+      StringMember("debug_id", module->debug_identifier());
+      Key("base_address");
+      Address(module->base_address());
+      Key("end_address");
+      Address(module->base_address() + module->size() - 1);
+      if (main_module &&
+          module->base_address() == main_module->base_address()) {
+        Key("main");
+        Boolean(true);
+      }
+      if (ContainsModule(process_state.modules_without_symbols(), module)) {
+        Key("missing_symbols");
+        Boolean(true);
+      }
+      if (ContainsModule(process_state.modules_with_corrupt_symbols(),
+                         module)) {
+        Key("corrupt_symbols");
+        Boolean(true);
+      }
+      EndObject();
+    }
+  }
+  EndArray();
+}
+
+void ProcessStateJSONWriter::WriteStack(const CallStack *stack) {
+  BeginObject();
+  Key("frames");
+  BeginArray();
+  const vector<StackFrame*> *frames = stack->frames();
+  for (size_t i = 0; i < frames->size(); ++i) {
+    const StackFrame *frame = frames->at(i);
+    uint64_t instruction_address = frame->ReturnAddress();
+    BeginObject();
+    if (frame->module) {
+      std::vector<std::pair<const CodeModule*, size_t> >::const_iterator it =
+          std::lower_bound(module_index_.begin(), module_index_.end(),
+                           std::make_pair(frame->module, size_t(0)));
+      const string *name;
+      if (it != module_index_.end() && it->first == frame->module) {
+        name = &module_names_[it->second];
+      } else {
+        // The frame refers to a module from outside the process state.
+        scratch_name_ = frame->module->code_file();
+        scratch_name_.erase(0, FileNameStart(scratch_name_));
+        name = &scratch_name_;
+      }
+      Key("module");
+      String(*name);
+      Key("module_offset");
+      Address(instruction_address - frame->module->base_address());
+    }
+    const char *function_name = frame->FunctionName();
+    if (function_name[0] != '\0') {
+      Key("function");
+      String(function_name, strlen(function_name));
+      Key("function_offset");
+      Address(instruction_address - frame->function_base);
+    }
+    const char *source_file_name = frame->SourceFileName();
+    if (source_file_name[0] != '\0') {
+      Key("file");
+      String(source_file_name, strlen(source_file_name));
+      Key("line");
+      Integer(frame->source_line);
+      Key("line_offset");
+      Address(instruction_address - frame->source_line_base);
+    }
+    Key("offset");
+    Address(instruction_address);
+    Key("trust");
+    const char *trust = TrustName(frame->trust);
+    String(trust, strlen(trust));
+    EndObject();
+  }
+  EndArray();
+  if (stack->truncated()) {
+    Key("truncated");
+    Boolean(true);
+  }
+  EndObject();
+}
+
+void ProcessStateJSONWriter::IndexModules(const CodeModules *modules) {
+  module_index_.clear();
+  unsigned int module_count = modules ? modules->module_count() : 0;
+  if (module_names_.size() < module_count)
+    module_names_.resize(module_count);
+  for (unsigned int i = 0; i < module_count; ++i) {
+    const CodeModule *module = modules->GetModuleAtSequence(i);
+    string code_file = module->code_file();
+    module_names_[i].assign(code_file, FileNameStart(code_file),
+                            string::npos);
+    module_index_.push_back(std::make_pair(module, size_t(i)));
+  }
+  std::sort(module_index_.begin(), module_index_.end());
+}
+
+void ProcessStateJSONWriter::BeginObject() {
+  Separate();
+  assert(depth_ < kMaxDepth);
+  buffer_.push_back('{');
+  empty_[depth_++] = true;
+}
+
+void ProcessStateJSONWriter::EndObject() {
+  assert(depth_ > 0);
+  --depth_;
+  buffer_.push_back('}');
+}
+
+void ProcessStateJSONWriter::BeginArray() {
+  Separate();
+  assert(depth_ < kMaxDepth);
+  buffer_.push_back('[');
+  empty_[depth_++] = true;
+}
+
+void ProcessStateJSONWriter::EndArray() {
+  assert(depth_ > 0);
+  --depth_;
+  buffer_.push_back(']');
+}
+
+void ProcessStateJSONWriter::Key(const char *name) {
+  String(name, strlen(name));
+  buffer_.push_back(':');
+  after_key_ = true;
+}
+
+void ProcessStateJSONWriter::Separate() {
+  if (after_key_) {
+    after_key_ = false;
+    return;
+  }
+  if (depth_ > 0) {
+    if (!empty_[depth_ - 1])
+      buffer_.push_back(',');
+    empty_[depth_ - 1] = false;
+  }
+}
+
+void ProcessStateJSONWriter::String(const char *value, size_t length) {
+  static const char kHexDigits[] = "0123456789abcdef";
+  Separate();
+  buffer_.push_back('"');
+  const char *run = value;
+  for (const char *c = value; c != value + length; ++c) {
+    unsigned char u = static_cast<unsigned char>(*c);
+    if (u >= 0x20 && u != '"' && u != '\\')
+      continue;
+    buffer_.append(run, c - run);
+    run = c + 1;
+    switch (u) {
+      case '"':
+        buffer_.append("\\\"", 2);
+        break;
+      case '\\':
+        buffer_.append("\\\\", 2);
+        break;
+      case '\n':
+        buffer_.append("\\n", 2);
+        break;
+      case '\r':
+        buffer_.append("\\r", 2);
+        break;
+      case '\t':
+        buffer_.append("\\t", 2);
+        break;
+      default: {
+        char escape[6] = { '\\', 'u', '0', '0',
+                           kHexDigits[u >> 4], kHexDigits[u & 0xf] };
+        buffer_.append(escape, sizeof(escape));
+        break;
+      }
+    }
+  }
+  buffer_.append(run, value + length - run);
+  buffer_.push_back('"');
+}
+
+void ProcessStateJSONWriter::StringMember(const char *name,
+                                          const string &value) {
+  if (value.empty())
+    return;
+  Key(name);
+  String(value);
+}
+
+void ProcessStateJSONWriter::Integer(int64_t value) {
+  Separate();
+  char number[24];
+  int length = snprintf(number, sizeof(number), "%" PRId64, value);
+  buffer_.append(number, length);
+}
+
+void ProcessStateJSONWriter::Boolean(bool value) {
+  Separate();
+  if (value)
+    buffer_.append("true", 4);
+  else
+    buffer_.append("false", 5);
+}
+
+void ProcessStateJSONWriter::Address(uint64_t value) {
+  Separate();
+  char number[24];
+  int length = snprintf(number, sizeof(number), "\"0x%" PRIx64 "\"", value);
+  buffer_.append(number, length);
+}
+
+}  // namespace google_breakpad
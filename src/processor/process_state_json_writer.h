@@ -0,0 +1,138 @@
+// Copyright (c) 2016 Google Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+// notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above
+// copyright notice, this list of conditions and the following disclaimer
+// in the documentation and/or other materials provided with the
+// distribution.
+//     * Neither the name of Google Inc. nor the names of its
+// contributors may be used to endorse or promote products derived from
+// this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+// process_state_json_writer.h: ProcessStateJSONWriter, which serializes a
+// ProcessState as a single line of JSON.
+//
+// The writer produces the same information as the machine-readable output
+// of minidump_stackwalk, in a form that needs no format-specific parser.
+// It writes into a buffer that is kept between calls, so a writer that is
+// reused for many process states stops allocating memory once its buffer
+// and module tables have grown to fit the largest of them.
+//
+// The object written has this layout.  Addresses and offsets are strings
+// holding hexadecimal numbers, because JSON numbers can't represent every
+// 64-bit value exactly.  Members with empty or unknown values are omitted.
+//
+// {"system_info": {"os", "os_version", "cpu", "cpu_info", "cpu_count"},
+//  "crash_info": {"crashed", "reason", "address", "assertion"},
+//  "requesting_thread", "time_date_stamp", "process_create_time",
+//  "modules": [{"filename", "version", "debug_file", "debug_id",
+//               "base_address", "end_address", "main",
+//               "missing_symbols", "corrupt_symbols"}, ...],
+//  "threads": [{"frames": [{"module", "module_offset", "function",
+//                           "function_offset", "file", "line",
+//                           "line_offset", "offset", "trust"}, ...]}, ...]}
+
+#ifndef PROCESSOR_PROCESS_STATE_JSON_WRITER_H__
+#define PROCESSOR_PROCESS_STATE_JSON_WRITER_H__
+
+#include <stddef.h>
+
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "common/using_std_string.h"
+#include "google_breakpad/common/breakpad_types.h"
+
+namespace google_breakpad {
+
+class CallStack;
+class CodeModule;
+class CodeModules;
+class ProcessState;
+
+class ProcessStateJSONWriter {
+ public:
+  ProcessStateJSONWriter();
+
+  // Serializes |process_state|, replacing the previous contents of the
+  // buffer.  The JSON is not followed by a newline.
+  void Write(const ProcessState &process_state);
+
+  // The serialized JSON, valid until the next call to Write.
+  const char *data() const { return buffer_.data(); }
+  size_t size() const { return buffer_.size(); }
+
+ private:
+  // The deepest nesting of objects and arrays that Write produces.
+  static const int kMaxDepth = 8;
+
+  void BeginObject();
+  void EndObject();
+  void BeginArray();
+  void EndArray();
+
+  // Starts a member of the current object named |name|.  The next value
+  // written is the member's value.
+  void Key(const char *name);
+
+  void String(const char *value, size_t length);
+  void String(const string &value) { String(value.data(), value.size()); }
+  void Integer(int64_t value);
+  void Boolean(bool value);
+  void Address(uint64_t value);
+
+  // Members holding strings, omitted when |value| is empty.
+  void StringMember(const char *name, const string &value);
+
+  // Writes the separator that precedes a value, if any.
+  void Separate();
+
+  void WriteModules(const ProcessState &process_state);
+  void WriteStack(const CallStack *stack);
+
+  // Fills module_index_ and module_names_ for |modules|, so that frames
+  // can be attributed to their modules without building new strings.
+  void IndexModules(const CodeModules *modules);
+
+  string buffer_;
+
+  // Whether the object or array open at each depth has no members yet.
+  bool empty_[kMaxDepth];
+  int depth_;
+
+  // Whether a member name has just been written.
+  bool after_key_;
+
+  // Modules sorted by pointer, each with the index of its file name in
+  // module_names_.
+  std::vector<std::pair<const CodeModule*, size_t> > module_index_;
+  std::vector<string> module_names_;
+  string scratch_name_;
+
+  // Disallow copy constructor and assignment operator.
+  ProcessStateJSONWriter(const ProcessStateJSONWriter&);
+  void operator=(const ProcessStateJSONWriter&);
+};
+
+}  // namespace google_breakpad
+
+#endif  // PROCESSOR_PROCESS_STATE_JSON_WRITER_H__
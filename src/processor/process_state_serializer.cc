@@ -0,0 +1,771 @@
+// Copyright (c) 2016 Google Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+// notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above
+// copyright notice, this list of conditions and the following disclaimer
+// in the documentation and/or other materials provided with the
+// distribution.
+//     * Neither the name of Google Inc. nor the names of its
+// contributors may be used to endorse or promote products derived from
+// this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+// process_state_serializer.cc: Implementation of ProcessStateSerializer.
+//
+// See process_state_serializer.h for documentation.
+
+#include "processor/process_state_serializer.h"
+
+#include <assert.h>
+
+#include <vector>
+
+#include "common/scoped_ptr.h"
+#include "google_breakpad/common/breakpad_types.h"
+#include "google_breakpad/processor/call_stack.h"
+#include "google_breakpad/processor/code_module.h"
+#include "google_breakpad/processor/code_modules.h"
+#include "google_breakpad/processor/process_state.h"
+#include "google_breakpad/processor/stack_frame.h"
+#include "google_breakpad/processor/stack_frame_cpu.h"
+#include "google_breakpad/processor/system_info.h"
+#include "processor/basic_code_module.h"
+#include "processor/basic_code_modules.h"
+#include "processor/logging.h"
+#include "processor/range_map-inl.h"
+
+namespace google_breakpad {
+
+namespace {
+
+using std::vector;
+
+enum WireType {
+  WIRETYPE_VARINT = 0,
+  WIRETYPE_FIXED64 = 1,
+  WIRETYPE_LENGTH_DELIMITED = 2,
+  WIRETYPE_FIXED32 = 5
+};
+
+// Field numbers from process_state.proto.
+enum ProcessStateField {
+  PROCESS_STATE_TIME_DATE_STAMP = 1,
+  PROCESS_STATE_CRASH = 2,
+  PROCESS_STATE_ASSERTION = 3,
+  PROCESS_STATE_REQUESTING_THREAD = 4,
+  PROCESS_STATE_THREADS = 5,
+  PROCESS_STATE_MODULES = 6,
+  PROCESS_STATE_OS = 7,
+  PROCESS_STATE_OS_SHORT = 8,
+  PROCESS_STATE_OS_VERSION = 9,
+  PROCESS_STATE_CPU = 10,
+  PROCESS_STATE_CPU_INFO = 11,
+  PROCESS_STATE_CPU_COUNT = 12,
+  PROCESS_STATE_PROCESS_CREATE_TIME = 13,
+  PROCESS_STATE_MODULES_WITHOUT_SYMBOLS = 14,
+  PROCESS_STATE_MODULES_WITH_CORRUPT_SYMBOLS = 15
+};
+
+enum CrashField {
+  CRASH_REASON = 1,
+  CRASH_ADDRESS = 2
+};
+
+enum ThreadField {
+  THREAD_FRAMES = 1,
+  THREAD_TRUNCATED = 2,
+  THREAD_SCANNED_MODULES = 3
+};
+
+enum StackFrameField {
+  FRAME_INSTRUCTION = 1,
+  FRAME_MODULE = 2,
+  FRAME_FUNCTION_NAME = 3,
+  FRAME_FUNCTION_BASE = 4,
+  FRAME_SOURCE_FILE_NAME = 5,
+  FRAME_SOURCE_LINE = 6,
+  FRAME_SOURCE_LINE_BASE = 7,
+  FRAME_TRUST = 8,
+  FRAME_RETURN_ADDRESS = 9
+};
+
+enum CodeModuleField {
+  MODULE_BASE_ADDRESS = 1,
+  MODULE_SIZE = 2,
+  MODULE_CODE_FILE = 3,
+  MODULE_CODE_IDENTIFIER = 4,
+  MODULE_DEBUG_FILE = 5,
+  MODULE_DEBUG_IDENTIFIER = 6,
+  MODULE_VERSION = 7
+};
+
+void AppendVarint(uint64_t value, string *output) {
+  while (value >= 0x80) {
+    output->push_back(static_cast<char>((value & 0x7f) | 0x80));
+    value >>= 7;
+  }
+  output->push_back(static_cast<char>(value));
+}
+
+void AppendTag(int field, WireType wire_type, string *output) {
+  AppendVarint((static_cast<uint64_t>(field) << 3) | wire_type, output);
+}
+
+// int32 and int64 fields are both encoded as the varint of the value's
+// 64-bit two's complement representation.
+void AppendIntegerField(int field, int64_t value, string *output) {
+  AppendTag(field, WIRETYPE_VARINT, output);
+  AppendVarint(static_cast<uint64_t>(value), output);
+}
+
+void AppendBytesField(int field, const char *data, size_t size,
+                      string *output) {
+  AppendTag(field, WIRETYPE_LENGTH_DELIMITED, output);
+  AppendVarint(size, output);
+  output->append(data, size);
+}
+
+void AppendStringField(int field, const string &value, string *output) {
+  AppendBytesField(field, value.data(), value.size(), output);
+}
+
+// Appends |value| unless it is empty, as optional string fields are.
+void AppendOptionalStringField(int field, const string &value,
+                               string *output) {
+  if (!value.empty())
+    AppendStringField(field, value, output);
+}
+
+// Reads protocol buffer wire format data.
+class WireReader {
+ public:
+  WireReader(const char *data, size_t size)
+      : position_(reinterpret_cast<const uint8_t*>(data)),
+        end_(reinterpret_cast<const uint8_t*>(data) + size) {}
+
+  bool AtEnd() const { return position_ == end_; }
+
+  bool ReadVarint(uint64_t *value) {
+    *value = 0;
+    for (int shift = 0; shift < 64; shift += 7) {
+      if (position_ == end_)
+        return false;
+      uint8_t byte = *position_++;
+      *value |= static_cast<uint64_t>(byte & 0x7f) << shift;
+      if (!(byte & 0x80))
+        return true;
+    }
+    return false;
+  }
+
+  bool ReadTag(int *field, int *wire_type) {
+    uint64_t tag;
+    if (!ReadVarint(&tag) || (tag >> 3) == 0 || (tag >> 3) > 0x1fffffff)
+      return false;
+    *field = static_cast<int>(tag >> 3);
+    *wire_type = static_cast<int>(tag & 7);
+    return true;
+  }
+
+  bool ReadLengthDelimited(const char **data, size_t *size) {
+    uint64_t length;
+    if (!ReadVarint(&length) ||
+        length > static_cast<uint64_t>(end_ - position_)) {
+      return false;
+    }
+    *data = reinterpret_cast<const char*>(position_);
+    *size = static_cast<size_t>(length);
+    position_ += length;
+    return true;
+  }
+
+  // Skips the value of a field with |wire_type| that the reader doesn't
+  // know about.
+  bool SkipValue(int wire_type) {
+    uint64_t varint;
+    const char *data;
+    size_t size;
+    switch (wire_type) {
+      case WIRETYPE_VARINT:
+        return ReadVarint(&varint);
+      case WIRETYPE_FIXED64:
+        return Skip(8);
+      case WIRETYPE_LENGTH_DELIMITED:
+        return ReadLengthDelimited(&data, &size);
+      case WIRETYPE_FIXED32:
+        return Skip(4);
+      default:
+        return false;
+    }
+  }
+
+ private:
+  bool Skip(size_t size) {
+    if (size > static_cast<size_t>(end_ - position_))
+      return false;
+    position_ += size;
+    return true;
+  }
+
+  const uint8_t *position_;
+  const uint8_t *end_;
+};
+
+// The value of one field, as read by ReadField.
+struct FieldValue {
+  int field;
+  int wire_type;
+  uint64_t varint;
+  const char *data;
+  size_t size;
+
+  string AsString() const { return string(data, size); }
+};
+
+// Reads the next field from |reader|.  Values of unknown wire types are
+// rejected, as they can't be skipped.
+bool ReadField(WireReader *reader, FieldValue *value) {
+  if (!reader->ReadTag(&value->field, &value->wire_type))
+    return false;
+  switch (value->wire_type) {
+    case WIRETYPE_VARINT:
+      return reader->ReadVarint(&value->varint);
+    case WIRETYPE_LENGTH_DELIMITED:
+      return reader->ReadLengthDelimited(&value->data, &value->size);
+    default:
+      return reader->SkipValue(value->wire_type);
+  }
+}
+
+// Returns a new BasicCodeModule read from a CodeModule message, or NULL.
+BasicCodeModule *DeserializeModule(const char *data, size_t size) {
+  uint64_t base_address = 0;
+  uint64_t module_size = 0;
+  string code_file, code_identifier, debug_file, debug_identifier, version;
+
+  WireReader reader(data, size);
+  while (!reader.AtEnd()) {
+    FieldValue value;
+    if (!ReadField(&reader, &value))
+      return NULL;
+    bool is_string = value.wire_type == WIRETYPE_LENGTH_DELIMITED;
+    bool is_varint = value.wire_type == WIRETYPE_VARINT;
+    switch (value.field) {
+      case MODULE_BASE_ADDRESS:
+        if (is_varint) base_address = value.varint;
+        break;
+      case MODULE_SIZE:
+        if (is_varint) module_size = value.varint;
+        break;
+      case MODULE_CODE_FILE:
+        if (is_string) code_file = value.AsString();
+        break;
+      case MODULE_CODE_IDENTIFIER:
+        if (is_string) code_identifier = value.AsString();
+        break;
+      case MODULE_DEBUG_FILE:
+        if (is_string) debug_file = value.AsString();
+        break;
+      case MODULE_DEBUG_IDENTIFIER:
+        if (is_string) debug_identifier = value.AsString();
+        break;
+      case MODULE_VERSION:
+        if (is_string) version = value.AsString();
+        break;
+    }
+  }
+
+  return new BasicCodeModule(base_address, module_size, code_file,
+                             code_identifier, debug_file, debug_identifier,
+                             version);
+}
+
+// Returns a new frame of the type the stackwalker for |cpu| produces, so
+// that code which casts frames according to the CPU finds the type it
+// expects.  Serialized frames carry no register context, so the context
+// is left invalid, except that x86 and amd64 frames, whose ReturnAddress
+// comes from the instruction pointer, get one holding |return_address|.
+StackFrame *NewFrameForCPU(const string &cpu, uint64_t return_address) {
+  if (cpu == "x86") {
+    StackFrameX86 *frame = new StackFrameX86();
+    frame->context.eip = static_cast<uint32_t>(return_address);
+    frame->context_validity = StackFrameX86::CONTEXT_VALID_EIP;
+    return frame;
+  }
+  if (cpu == "amd64") {
+    StackFrameAMD64 *frame = new StackFrameAMD64();
+    frame->context.rip = return_address;
+    frame->context_validity = StackFrameAMD64::CONTEXT_VALID_RIP;
+    return frame;
+  }
+  if (cpu == "ppc")
+    return new StackFramePPC();
+  if (cpu == "ppc64")
+    return new StackFramePPC64();
+  if (cpu == "sparc")
+    return new StackFrameSPARC();
+  if (cpu == "arm")
+    return new StackFrameARM();
+  if (cpu == "arm64")
+    return new StackFrameARM64();
+  if (cpu == "mips")
+    return new StackFrameMIPS();
+  return new StackFrame();
+}
+
+// A module as it was serialized, to be matched with one of the process's
+// modules once they have all been read, and then given to |frame| or, if
+// that is NULL, appended to |list|.  Owns |module| until it is matched.
+struct PendingModule {
+  StackFrame *frame;
+  vector<const CodeModule*> *list;
+  BasicCodeModule *module;
+};
+
+// Adds |module| to |pending_modules| for |frame| or |list|.
+void AddPendingModule(StackFrame *frame, vector<const CodeModule*> *list,
+                      BasicCodeModule *module,
+                      vector<PendingModule> *pending_modules) {
+  PendingModule pending = { frame, list, module };
+  pending_modules->push_back(pending);
+}
+
+// Reads a StackFrame message into a new frame for |cpu|, which is stored
+// in |frame_result| even on failure.  If the frame has a module, it is added to
+// |pending_modules|, which takes ownership of it.
+bool DeserializeFrame(const char *data, size_t size, const string &cpu,
+                      StackFrame **frame_result,
+                      vector<PendingModule> *pending_modules) {
+  // The frame can only be created once its return address is known.
+  uint64_t return_address = 0;
+  bool has_return_address = false;
+  WireReader address_reader(data, size);
+  while (!address_reader.AtEnd()) {
+    FieldValue value;
+    if (!ReadField(&address_reader, &value))
+      break;
+    if (value.wire_type != WIRETYPE_VARINT)
+      continue;
+    if (value.field == FRAME_RETURN_ADDRESS) {
+      return_address = value.varint;
+      has_return_address = true;
+    } else if (value.field == FRAME_INSTRUCTION && !has_return_address) {
+      return_address = value.varint;
+    }
+  }
+  StackFrame *frame = NewFrameForCPU(cpu, return_address);
+  *frame_result = frame;
+
+  bool has_instruction = false;
+  WireReader reader(data, size);
+  while (!reader.AtEnd()) {
+    FieldValue value;
+    if (!ReadField(&reader, &value))
+      return false;
+    bool is_string = value.wire_type == WIRETYPE_LENGTH_DELIMITED;
+    bool is_varint = value.wire_type == WIRETYPE_VARINT;
+    switch (value.field) {
+      case FRAME_INSTRUCTION:
+        if (is_varint) {
+          frame->instruction = value.varint;
+          has_instruction = true;
+        }
+        break;
+      case FRAME_MODULE:
+        if (is_string) {
+          BasicCodeModule *module = DeserializeModule(value.data, value.size);
+          if (!module)
+            return false;
+          AddPendingModule(frame, NULL, module, pending_modules);
+        }
+        break;
+      case FRAME_FUNCTION_NAME:
+        if (is_string) frame->function_name = value.AsString();
+        break;
+      case FRAME_FUNCTION_BASE:
+        if (is_varint) frame->function_base = value.varint;
+        break;
+      case FRAME_SOURCE_FILE_NAME:
+        if (is_string) frame->source_file_name = value.AsString();
+        break;
+      case FRAME_SOURCE_LINE:
+        if (is_varint) frame->source_line = static_cast<int>(value.varint);
+        break;
+      case FRAME_SOURCE_LINE_BASE:
+        if (is_varint) frame->source_line_base = value.varint;
+        break;
+      case FRAME_TRUST:
+        if (is_varint && value.varint <= StackFrame::FRAME_TRUST_CONTEXT) {
+          frame->trust = static_cast<StackFrame::FrameTrust>(value.varint);
+        }
+        break;
+    }
+  }
+  return has_instruction;
+}
+
+// Reads a Thread message's frames into |frames|, which takes ownership of
+// them even on failure.  Its scanned modules are added to
+// |pending_modules| for |scanned_modules|.
+bool DeserializeThread(const char *data, size_t size, const string &cpu,
+                       vector<StackFrame*> *frames, bool *truncated,
+                       vector<const CodeModule*> *scanned_modules,
+                       vector<PendingModule> *pending_modules) {
+  WireReader reader(data, size);
+  while (!reader.AtEnd()) {
+    FieldValue value;
+    if (!ReadField(&reader, &value))
+      return false;
+    if (value.field == THREAD_TRUNCATED &&
+        value.wire_type == WIRETYPE_VARINT) {
+      *truncated = value.varint != 0;
+      continue;
+    }
+    if (value.field == THREAD_SCANNED_MODULES &&
+        value.wire_type == WIRETYPE_LENGTH_DELIMITED) {
+      BasicCodeModule *module = DeserializeModule(value.data, value.size);
+      if (!module)
+        return false;
+      AddPendingModule(NULL, scanned_modules, module, pending_modules);
+      continue;
+    }
+    if (value.field != THREAD_FRAMES ||
+        value.wire_type != WIRETYPE_LENGTH_DELIMITED) {
+      continue;
+    }
+    StackFrame *frame = NULL;
+    bool frame_ok = DeserializeFrame(value.data, value.size, cpu, &frame,
+                                     pending_modules);
+    frames->push_back(frame);
+    if (!frame_ok)
+      return false;
+  }
+  return true;
+}
+
+// A CodeModules collection built from serialized modules.
+class SerializedCodeModules : public BasicCodeModules {
+ public:
+  // Takes ownership of |module|.  The first module added is the main one.
+  // Returns false, deleting |module|, if it overlaps a module already
+  // added.
+  bool Add(const CodeModule *module) {
+    if (!StoreModule(module))
+      return false;
+    if (map_->GetCount() == 1)
+      main_address_ = module->base_address();
+    return true;
+  }
+};
+
+}  // namespace
+
+void ProcessStateSerializer::Serialize(const ProcessState &process_state,
+                                       string *output) {
+  output->clear();
+
+  if (process_state.time_date_stamp() != 0) {
+    AppendIntegerField(PROCESS_STATE_TIME_DATE_STAMP,
+                       process_state.time_date_stamp(), output);
+  }
+
+  if (process_state.crashed()) {
+    string crash;
+    AppendStringField(CRASH_REASON, process_state.crash_reason(), &crash);
+    AppendIntegerField(CRASH_ADDRESS, process_state.crash_address(), &crash);
+    AppendStringField(PROCESS_STATE_CRASH, crash, output);
+  }
+
+  AppendOptionalStringField(PROCESS_STATE_ASSERTION, process_state.assertion(),
+                            output);
+
+  if (process_state.requesting_thread() != -1) {
+    AppendIntegerField(PROCESS_STATE_REQUESTING_THREAD,
+                       process_state.requesting_thread(), output);
+  }
+
+  const vector<CallStack*> *threads = process_state.threads();
+  for (size_t i = 0; i < threads->size(); ++i) {
+    SerializeThread(threads->at(i));
+    AppendStringField(PROCESS_STATE_THREADS, thread_buffer_, output);
+  }
+
+  const CodeModules *modules = process_state.modules();
+  if (modules) {
+    const CodeModule *main_module = modules->GetMainModule();
+    if (main_module) {
+      SerializeModule(main_module, &module_buffer_);
+      AppendStringField(PROCESS_STATE_MODULES, module_buffer_, output);
+    }
+    for (unsigned int i = 0; i < modules->module_count(); ++i) {
+      const CodeModule *module = modules->GetModuleAtIndex(i);
+      if (module == main_module)
+        continue;
+      SerializeModule(module, &module_buffer_);
+      AppendStringField(PROCESS_STATE_MODULES, module_buffer_, output);
+    }
+  }
+
+  const SystemInfo *system_info = process_state.system_info();
+  AppendOptionalStringField(PROCESS_STATE_OS, system_info->os, output);
+  AppendOptionalStringField(PROCESS_STATE_OS_SHORT, system_info->os_short,
+                            output);
+  AppendOptionalStringField(PROCESS_STATE_OS_VERSION, system_info->os_version,
+                            output);
+  AppendOptionalStringField(PROCESS_STATE_CPU, system_info->cpu, output);
+  AppendOptionalStringField(PROCESS_STATE_CPU_INFO, system_info->cpu_info,
+                            output);
+  if (system_info->cpu_count != 0) {
+    AppendIntegerField(PROCESS_STATE_CPU_COUNT, system_info->cpu_count,
+                       output);
+  }
+
+  if (process_state.process_create_time() != 0) {
+    AppendIntegerField(PROCESS_STATE_PROCESS_CREATE_TIME,
+                       process_state.process_create_time(), output);
+  }
+
+  SerializeModuleList(PROCESS_STATE_MODULES_WITHOUT_SYMBOLS,
+                      *process_state.modules_without_symbols(), output);
+  SerializeModuleList(PROCESS_STATE_MODULES_WITH_CORRUPT_SYMBOLS,
+                      *process_state.modules_with_corrupt_symbols(), output);
+}
+
+// static
+void ProcessStateSerializer::SerializeModule(const CodeModule *module,
+                                             string *output) {
+  output->clear();
+  AppendIntegerField(MODULE_BASE_ADDRESS, module->base_address(), output);
+  AppendIntegerField(MODULE_SIZE, module->size(), output);
+  AppendOptionalStringField(MODULE_CODE_FILE, module->code_file(), output);
+  AppendOptionalStringField(MODULE_CODE_IDENTIFIER, module->code_identifier(),
+                            output);
+  AppendOptionalStringField(MODULE_DEBUG_FILE, module->debug_file(), output);
+  AppendOptionalStringField(MODULE_DEBUG_IDENTIFIER,
+                            module->debug_identifier(), output);
+  AppendOptionalStringField(MODULE_VERSION, module->version(), output);
+}
+
+void ProcessStateSerializer::SerializeModuleList(
+    int field, const vector<const CodeModule*> &modules, string *output) {
+  for (size_t i = 0; i < modules.size(); ++i) {
+    SerializeModule(modules[i], &module_buffer_);
+    AppendStringField(field, module_buffer_, output);
+  }
+}
+
+void ProcessStateSerializer::SerializeThread(const CallStack *stack) {
+  thread_buffer_.clear();
+  const vector<StackFrame*> *frames = stack->frames();
+  for (size_t i = 0; i < frames->size(); ++i) {
+    const StackFrame *frame = frames->at(i);
+    frame_buffer_.clear();
+    AppendIntegerField(FRAME_INSTRUCTION, frame->instruction, &frame_buffer_);
+    if (frame->module) {
+      SerializeModule(frame->module, &module_buffer_);
+      AppendStringField(FRAME_MODULE, module_buffer_, &frame_buffer_);
+    }
+    if (frame->FunctionName()[0] != '\0') {
+      AppendStringField(FRAME_FUNCTION_NAME, frame->FunctionName(),
+                        &frame_buffer_);
+      AppendIntegerField(FRAME_FUNCTION_BASE, frame->function_base,
+                         &frame_buffer_);
+    }
+    if (frame->SourceFileName()[0] != '\0') {
+      AppendStringField(FRAME_SOURCE_FILE_NAME, frame->SourceFileName(),
+                        &frame_buffer_);
+      AppendIntegerField(FRAME_SOURCE_LINE, frame->source_line,
+                         &frame_buffer_);
+      AppendIntegerField(FRAME_SOURCE_LINE_BASE, frame->source_line_base,
+                         &frame_buffer_);
+    }
+    if (frame->trust != StackFrame::FRAME_TRUST_NONE)
+      AppendIntegerField(FRAME_TRUST, frame->trust, &frame_buffer_);
+    uint64_t return_address = frame->ReturnAddress();
+    if (return_address != frame->instruction) {
+      AppendIntegerField(FRAME_RETURN_ADDRESS, return_address,
+                         &frame_buffer_);
+    }
+    AppendStringField(THREAD_FRAMES, frame_buffer_, &thread_buffer_);
+  }
+  if (stack->truncated())
+    AppendIntegerField(THREAD_TRUNCATED, 1, &thread_buffer_);
+  SerializeModuleList(THREAD_SCANNED_MODULES, *stack->scanned_modules(),
+                      &thread_buffer_);
+}
+
+bool ProcessStateSerializer::Deserialize(const char *data, size_t size,
+                                         ProcessState *process_state) {
+  assert(process_state);
+  process_state->Clear();
+
+  // Frames are created according to the CPU, which may be serialized
+  // after the threads, so find it first.
+  string cpu;
+  WireReader cpu_reader(data, size);
+  while (!cpu_reader.AtEnd()) {
+    FieldValue value;
+    if (!ReadField(&cpu_reader, &value)) {
+      BPLOG(ERROR) << "Malformed serialized process state";
+      return false;
+    }
+    if (value.field == PROCESS_STATE_CPU &&
+        value.wire_type == WIRETYPE_LENGTH_DELIMITED) {
+      cpu = value.AsString();
+    }
+  }
+
+  scoped_ptr<SerializedCodeModules> modules(new SerializedCodeModules);
+  vector<PendingModule> pending_modules;
+  bool ok = true;
+  WireReader reader(data, size);
+  while (ok && !reader.AtEnd()) {
+    FieldValue value;
+    if (!ReadField(&reader, &value)) {
+      ok = false;
+      break;
+    }
+    bool is_string = value.wire_type == WIRETYPE_LENGTH_DELIMITED;
+    bool is_varint = value.wire_type == WIRETYPE_VARINT;
+    SystemInfo *system_info = &process_state->system_info_;
+    switch (value.field) {
+      case PROCESS_STATE_TIME_DATE_STAMP:
+        if (is_varint)
+          process_state->time_date_stamp_ = static_cast<uint32_t>(value.varint);
+        break;
+      case PROCESS_STATE_PROCESS_CREATE_TIME:
+        if (is_varint) {
+          process_state->process_create_time_ =
+              static_cast<uint32_t>(value.varint);
+        }
+        break;
+      case PROCESS_STATE_CRASH:
+        if (is_string) {
+          process_state->crashed_ = true;
+          WireReader crash_reader(value.data, value.size);
+          while (ok && !crash_reader.AtEnd()) {
+            FieldValue crash_value;
+            if (!ReadField(&crash_reader, &crash_value)) {
+              ok = false;
+            } else if (crash_value.field == CRASH_REASON &&
+                       crash_value.wire_type == WIRETYPE_LENGTH_DELIMITED) {
+              process_state->crash_reason_ = crash_value.AsString();
+            } else if (crash_value.field == CRASH_ADDRESS &&
+                       crash_value.wire_type == WIRETYPE_VARINT) {
+              process_state->crash_address_ = crash_value.varint;
+            }
+          }
+        }
+        break;
+      case PROCESS_STATE_ASSERTION:
+        if (is_string) process_state->assertion_ = value.AsString();
+        break;
+      case PROCESS_STATE_REQUESTING_THREAD:
+        if (is_varint)
+          process_state->requesting_thread_ = static_cast<int>(value.varint);
+        break;
+      case PROCESS_STATE_THREADS:
+        if (is_string) {
+          CallStack *stack = process_state->NewCallStack(NULL);
+          process_state->threads_.push_back(stack);
+          ok = DeserializeThread(value.data, value.size, cpu, &stack->frames_,
+                                 &stack->truncated_, &stack->scanned_modules_,
+                                 &pending_modules);
+        }
+        break;
+      case PROCESS_STATE_MODULES:
+        if (is_string) {
+          BasicCodeModule *module = DeserializeModule(value.data, value.size);
+          ok = module && modules->Add(module);
+        }
+        break;
+      case PROCESS_STATE_MODULES_WITHOUT_SYMBOLS:
+      case PROCESS_STATE_MODULES_WITH_CORRUPT_SYMBOLS:
+        if (is_string) {
+          BasicCodeModule *module = DeserializeModule(value.data, value.size);
+          ok = module != NULL;
+          if (module) {
+            AddPendingModule(
+                NULL,
+                value.field == PROCESS_STATE_MODULES_WITHOUT_SYMBOLS ?
+                    &process_state->modules_without_symbols_ :
+                    &process_state->modules_with_corrupt_symbols_,
+                module, &pending_modules);
+          }
+        }
+        break;
+      case PROCESS_STATE_OS:
+        if (is_string) system_info->os = value.AsString();
+        break;
+      case PROCESS_STATE_OS_SHORT:
+        if (is_string) system_info->os_short = value.AsString();
+        break;
+      case PROCESS_STATE_OS_VERSION:
+        if (is_string) system_info->os_version = value.AsString();
+        break;
+      case PROCESS_STATE_CPU:
+        if (is_string) system_info->cpu = value.AsString();
+        break;
+      case PROCESS_STATE_CPU_INFO:
+        if (is_string) system_info->cpu_info = value.AsString();
+        break;
+      case PROCESS_STATE_CPU_COUNT:
+        if (is_varint)
+          system_info->cpu_count = static_cast<int>(value.varint);
+        break;
+    }
+  }
+
+  // Point each frame and module list at the process's copy of the module,
+  // adding modules that only they mention.
+  for (size_t i = 0; i < pending_modules.size(); ++i) {
+    const PendingModule &pending = pending_modules[i];
+    const CodeModule *module =
+        modules->GetModuleForAddress(pending.module->base_address());
+    if (module && module->base_address() == pending.module->base_address() &&
+        module->size() == pending.module->size()) {
+      delete pending.module;
+    } else if (modules->Add(pending.module)) {
+      module = pending.module;
+    } else {
+      continue;
+    }
+    if (pending.frame)
+      pending.frame->module = module;
+    else
+      pending.list->push_back(module);
+  }
+
+  int thread_count = static_cast<int>(process_state->threads_.size());
+  if (process_state->requesting_thread_ < -1 ||
+      process_state->requesting_thread_ >= thread_count) {
+    ok = false;
+  }
+
+  process_state->modules_ = modules.release();
+  if (!ok) {
+    BPLOG(ERROR) << "Malformed serialized process state";
+    process_state->Clear();
+    return false;
+  }
+  return true;
+}
+
+}  // namespace google_breakpad
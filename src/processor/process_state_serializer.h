@@ -0,0 +1,104 @@
+// Copyright (c) 2016 Google Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+// notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above
+// copyright notice, this list of conditions and the following disclaimer
+// in the documentation and/or other materials provided with the
+// distribution.
+//     * Neither the name of Google Inc. nor the names of its
+// contributors may be used to endorse or promote products derived from
+// this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+// process_state_serializer.h: ProcessStateSerializer, which converts a
+// ProcessState to and from the ProcessStateProto wire format described in
+// src/processor/proto/process_state.proto.
+//
+// Serialized process states carry everything needed to print or analyze a
+// processed minidump again without the minidump itself, and are far more
+// compact than the text formats.  The encoding follows the protocol buffer
+// wire format, so any protobuf implementation can read or write it, but
+// ProcessStateSerializer does not depend on one.
+//
+// Information that the schema does not describe is not preserved: register
+// contexts other than the instruction pointer, thread memory, and the
+// exploitability rating.  The main module is
+// written first, and the first module read is taken to be the main module.
+// The modules without symbols or with corrupt symbols and the modules each
+// stack walk scanned are kept, so that ProcessStateUpdater can tell what
+// a change of symbols makes out of date.
+
+#ifndef PROCESSOR_PROCESS_STATE_SERIALIZER_H__
+#define PROCESSOR_PROCESS_STATE_SERIALIZER_H__
+
+#include <stddef.h>
+
+#include <string>
+#include <vector>
+
+#include "common/using_std_string.h"
+
+namespace google_breakpad {
+
+class CallStack;
+class CodeModule;
+class ProcessState;
+
+class ProcessStateSerializer {
+ public:
+  ProcessStateSerializer() {}
+
+  // Replaces the contents of |output| with the ProcessStateProto encoding
+  // of |process_state|.
+  void Serialize(const ProcessState &process_state, string *output);
+
+  // Rebuilds |process_state| from the |size| bytes of ProcessStateProto
+  // data at |data|.  Fields unknown to this version of the schema are
+  // skipped.  Returns false, leaving |process_state| cleared, if the data
+  // is malformed.
+  bool Deserialize(const char *data, size_t size, ProcessState *process_state);
+
+ private:
+  // Encodes |module| as a CodeModule message into |output|.
+  static void SerializeModule(const CodeModule *module, string *output);
+
+  // Appends each of |modules| to |output| as a CodeModule message in
+  // |field|.
+  void SerializeModuleList(int field,
+                           const std::vector<const CodeModule*> &modules,
+                           string *output);
+
+  // Encodes |stack| as a Thread message into thread_buffer_.
+  void SerializeThread(const CallStack *stack);
+
+  // Buffers for the embedded messages, which are kept between calls so
+  // that serializing doesn't allocate memory for every frame.
+  string thread_buffer_;
+  string frame_buffer_;
+  string module_buffer_;
+
+  // Disallow copy constructor and assignment operator.
+  ProcessStateSerializer(const ProcessStateSerializer&);
+  void operator=(const ProcessStateSerializer&);
+};
+
+}  // namespace google_breakpad
+
+#endif  // PROCESSOR_PROCESS_STATE_SERIALIZER_H__
@@ -0,0 +1,229 @@
+// Copyright (c) 2016 Google Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+// notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above
+// copyright notice, this list of conditions and the following disclaimer
+// in the documentation and/or other materials provided with the
+// distribution.
+//     * Neither the name of Google Inc. nor the names of its
+// contributors may be used to endorse or promote products derived from
+// this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+// process_state_serializer_unittest.cc: Unit tests for
+// ProcessStateSerializer.
+
+#include <stdlib.h>
+
+#include <string>
+#include <vector>
+
+#include "breakpad_googletest_includes.h"
+#include "common/using_std_string.h"
+#include "google_breakpad/processor/basic_source_line_resolver.h"
+#include "google_breakpad/processor/call_stack.h"
+#include "google_breakpad/processor/code_module.h"
+#include "google_breakpad/processor/code_modules.h"
+#include "google_breakpad/processor/minidump_processor.h"
+#include "google_breakpad/processor/process_state.h"
+#include "google_breakpad/processor/stack_frame_cpu.h"
+#include "google_breakpad/processor/walk_budget.h"
+#include "processor/process_state_json_writer.h"
+#include "processor/process_state_serializer.h"
+#include "processor/simple_symbol_supplier.h"
+
+namespace {
+
+using google_breakpad::BasicSourceLineResolver;
+using google_breakpad::CodeModule;
+using google_breakpad::MinidumpProcessor;
+using google_breakpad::ProcessState;
+using google_breakpad::ProcessStateJSONWriter;
+using google_breakpad::ProcessStateSerializer;
+using google_breakpad::SimpleSymbolSupplier;
+using google_breakpad::StackFrame;
+using google_breakpad::StackFrameX86;
+using google_breakpad::WalkBudget;
+using std::vector;
+
+string TestDataDir() {
+  return string(getenv("srcdir") ? getenv("srcdir") : ".") +
+      "/src/processor/testdata";
+}
+
+string ToJSON(const ProcessState &state) {
+  ProcessStateJSONWriter writer;
+  writer.Write(state);
+  return string(writer.data(), writer.size());
+}
+
+class ProcessStateSerializerTest : public ::testing::Test {
+ public:
+  void SetUp() {
+    SimpleSymbolSupplier supplier(TestDataDir() + "/symbols");
+    BasicSourceLineResolver resolver;
+    MinidumpProcessor processor(&supplier, &resolver);
+    ASSERT_EQ(google_breakpad::PROCESS_OK,
+              processor.Process(TestDataDir() + "/minidump2.dmp", &state_));
+    serializer_.Serialize(state_, &serialized_);
+    ASSERT_FALSE(serialized_.empty());
+  }
+
+  ProcessState state_;
+  ProcessStateSerializer serializer_;
+  string serialized_;
+};
+
+TEST_F(ProcessStateSerializerTest, RoundTrip) {
+  ProcessState copy;
+  ASSERT_TRUE(serializer_.Deserialize(serialized_.data(), serialized_.size(),
+                                      &copy));
+  EXPECT_EQ(ToJSON(state_), ToJSON(copy));
+  EXPECT_EQ(state_.system_info()->os_short, copy.system_info()->os_short);
+
+  // Frames refer to the process's own modules, and have the frame type of
+  // the process's CPU with only the instruction pointer set.
+  ASSERT_EQ(state_.threads()->size(), copy.threads()->size());
+  const StackFrame *frame = copy.threads()->at(0)->frames()->at(0);
+  ASSERT_TRUE(frame->module);
+  EXPECT_EQ(copy.modules()->GetModuleForAddress(frame->instruction),
+            frame->module);
+  EXPECT_EQ(copy.modules()->GetMainModule(), frame->module);
+  EXPECT_EQ(StackFrame::FRAME_TRUST_CONTEXT, frame->trust);
+  EXPECT_EQ(StackFrameX86::CONTEXT_VALID_EIP,
+            static_cast<const StackFrameX86*>(frame)->context_validity);
+  const StackFrame *caller = copy.threads()->at(0)->frames()->at(1);
+  EXPECT_EQ(state_.threads()->at(0)->frames()->at(1)->ReturnAddress(),
+            caller->ReturnAddress());
+  EXPECT_NE(caller->instruction, caller->ReturnAddress());
+
+  // Reserializing yields the same bytes.
+  string reserialized;
+  serializer_.Serialize(copy, &reserialized);
+  EXPECT_EQ(serialized_, reserialized);
+}
+
+TEST_F(ProcessStateSerializerTest, RoundTripsTruncatedStacks) {
+  EXPECT_FALSE(state_.threads()->at(0)->truncated());
+  EXPECT_EQ(string::npos, ToJSON(state_).find("\"truncated\""));
+
+  SimpleSymbolSupplier supplier(TestDataDir() + "/symbols");
+  BasicSourceLineResolver resolver;
+  MinidumpProcessor processor(&supplier, &resolver);
+  WalkBudget::Limits limits;
+  limits.frames = 2;
+  processor.set_walk_budget_limits(limits);
+  ProcessState truncated_state;
+  ASSERT_EQ(google_breakpad::PROCESS_OK,
+            processor.Process(TestDataDir() + "/minidump2.dmp",
+                              &truncated_state));
+  ASSERT_TRUE(truncated_state.threads()->at(0)->truncated());
+  EXPECT_NE(string::npos, ToJSON(truncated_state).find("\"truncated\""));
+
+  string serialized;
+  serializer_.Serialize(truncated_state, &serialized);
+  ProcessState copy;
+  ASSERT_TRUE(serializer_.Deserialize(serialized.data(), serialized.size(),
+                                      &copy));
+  ASSERT_EQ(1U, copy.threads()->size());
+  EXPECT_TRUE(copy.threads()->at(0)->truncated());
+  EXPECT_EQ(2U, copy.threads()->at(0)->frames()->size());
+  EXPECT_EQ(ToJSON(truncated_state), ToJSON(copy));
+}
+
+TEST_F(ProcessStateSerializerTest, RoundTripsSymbolNotes) {
+  // The walk scanned the stack through the code of both modules.
+  const vector<const CodeModule*> *scanned =
+      state_.threads()->at(0)->scanned_modules();
+  ASSERT_EQ(2U, scanned->size());
+  ProcessState copy;
+  ASSERT_TRUE(serializer_.Deserialize(serialized_.data(), serialized_.size(),
+                                      &copy));
+  const vector<const CodeModule*> *copy_scanned =
+      copy.threads()->at(0)->scanned_modules();
+  ASSERT_EQ(2U, copy_scanned->size());
+  for (size_t i = 0; i < scanned->size(); ++i) {
+    EXPECT_EQ(scanned->at(i)->code_file(), copy_scanned->at(i)->code_file());
+    EXPECT_EQ(copy.modules()->GetModuleForAddress(
+                  copy_scanned->at(i)->base_address()),
+              copy_scanned->at(i));
+  }
+
+  SimpleSymbolSupplier supplier(TestDataDir() + "/no-such-symbols");
+  BasicSourceLineResolver resolver;
+  MinidumpProcessor processor(&supplier, &resolver);
+  ProcessState unsymbolized;
+  ASSERT_EQ(google_breakpad::PROCESS_OK,
+            processor.Process(TestDataDir() + "/minidump2.dmp",
+                              &unsymbolized));
+  ASSERT_EQ(2U, unsymbolized.modules_without_symbols()->size());
+  string serialized;
+  serializer_.Serialize(unsymbolized, &serialized);
+  ASSERT_TRUE(serializer_.Deserialize(serialized.data(), serialized.size(),
+                                      &copy));
+  ASSERT_EQ(2U, copy.modules_without_symbols()->size());
+  EXPECT_EQ(copy.modules()->GetMainModule(),
+            copy.modules_without_symbols()->at(0));
+  EXPECT_TRUE(copy.modules_with_corrupt_symbols()->empty());
+  EXPECT_EQ(ToJSON(unsymbolized), ToJSON(copy));
+}
+
+TEST_F(ProcessStateSerializerTest, SkipsUnknownFields) {
+  // Field 100 as a varint, field 101 as a string, field 102 as fixed32.
+  string extended = serialized_;
+  extended.append("\xa0\x06\x2a", 3);
+  extended.append("\xaa\x06\x03" "abc", 6);
+  extended.append("\xb5\x06" "abcd", 6);
+
+  ProcessState copy;
+  ASSERT_TRUE(serializer_.Deserialize(extended.data(), extended.size(),
+                                      &copy));
+  EXPECT_EQ(ToJSON(state_), ToJSON(copy));
+}
+
+TEST_F(ProcessStateSerializerTest, RejectsMalformedData) {
+  ProcessState copy;
+  EXPECT_FALSE(serializer_.Deserialize(serialized_.data(),
+                                       serialized_.size() - 1, &copy));
+  EXPECT_TRUE(copy.threads()->empty());
+  EXPECT_FALSE(copy.modules());
+
+  // A length running past the end of the data.
+  string overlong("\x2a\x7f", 2);
+  EXPECT_FALSE(serializer_.Deserialize(overlong.data(), overlong.size(),
+                                       &copy));
+
+  // A requesting thread that doesn't exist.
+  string bad_thread("\x20\x05", 2);
+  EXPECT_FALSE(serializer_.Deserialize(bad_thread.data(), bad_thread.size(),
+                                       &copy));
+}
+
+TEST_F(ProcessStateSerializerTest, EmptyData) {
+  ProcessState copy;
+  ASSERT_TRUE(serializer_.Deserialize(NULL, 0, &copy));
+  EXPECT_FALSE(copy.crashed());
+  EXPECT_EQ(-1, copy.requesting_thread());
+  EXPECT_TRUE(copy.threads()->empty());
+  ASSERT_TRUE(copy.modules());
+  EXPECT_EQ(0U, copy.modules()->module_count());
+}
+
+}  // namespace
@@ -0,0 +1,304 @@
+// Copyright (c) 2016 Google Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+// notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above
+// copyright notice, this list of conditions and the following disclaimer
+// in the documentation and/or other materials provided with the
+// distribution.
+//     * Neither the name of Google Inc. nor the names of its
+// contributors may be used to endorse or promote products derived from
+// this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+// process_state_updater.cc: Implementation of ProcessStateUpdater.
+//
+// See process_state_updater.h for documentation.
+
+#include "processor/process_state_updater.h"
+
+#include <assert.h>
+
+#include "common/scoped_ptr.h"
+#include "google_breakpad/processor/call_stack.h"
+#include "google_breakpad/processor/code_module.h"
+#include "google_breakpad/processor/minidump.h"
+#include "google_breakpad/processor/process_state.h"
+#include "google_breakpad/processor/stack_frame.h"
+#include "google_breakpad/processor/stack_frame_symbolizer.h"
+#include "google_breakpad/processor/stackwalker.h"
+#include "processor/cfi_frame_info.h"
+#include "processor/logging.h"
+#include "processor/windows_frame_info.h"
+
+namespace google_breakpad {
+
+namespace {
+
+using std::vector;
+
+// Returns true if |module| is one of |changed_modules|.
+bool IsChanged(const vector<const CodeModule*>& changed_modules,
+               const CodeModule* module) {
+  for (size_t i = 0; i < changed_modules.size(); ++i) {
+    if (changed_modules[i]->debug_file() == module->debug_file() &&
+        changed_modules[i]->debug_identifier() == module->debug_identifier()) {
+      return true;
+    }
+  }
+  return false;
+}
+
+// Removes the modules in |changed_modules| from |modules|.
+void RemoveChanged(const vector<const CodeModule*>& changed_modules,
+                   vector<const CodeModule*>* modules) {
+  vector<const CodeModule*> kept;
+  for (size_t i = 0; i < modules->size(); ++i) {
+    if (!IsChanged(changed_modules, modules->at(i)))
+      kept.push_back(modules->at(i));
+  }
+  modules->swap(kept);
+}
+
+// Adds |module| to |modules| unless it is already there.
+void AddModule(const CodeModule* module, vector<const CodeModule*>* modules) {
+  for (size_t i = 0; i < modules->size(); ++i) {
+    if (modules->at(i) == module)
+      return;
+  }
+  modules->push_back(module);
+}
+
+// Forgets what |frame|'s symbols said about it.
+void ClearSymbols(StackFrame* frame) {
+  frame->function_name.clear();
+  frame->function_base = 0;
+  frame->source_file_name.clear();
+  frame->source_line = 0;
+  frame->source_line_base = 0;
+  frame->shared_function_name = NULL;
+  frame->shared_source_file_name = NULL;
+}
+
+}  // namespace
+
+ProcessStateUpdater::ProcessStateUpdater(
+    StackFrameSymbolizer* frame_symbolizer)
+    : frame_symbolizer_(frame_symbolizer),
+      walked_stack_count_(0),
+      symbolized_frame_count_(0) {
+  assert(frame_symbolizer_);
+}
+
+ProcessResult ProcessStateUpdater::Update(
+    Minidump* dump,
+    const vector<const CodeModule*>& changed_modules,
+    ProcessState* process_state) {
+  assert(process_state);
+  walked_stack_count_ = 0;
+  symbolized_frame_count_ = 0;
+
+  // Whether the changed modules have symbols is found out anew.
+  RemoveChanged(changed_modules, &process_state->modules_without_symbols_);
+  RemoveChanged(changed_modules,
+                &process_state->modules_with_corrupt_symbols_);
+
+  vector<size_t> walk_again;
+  for (size_t i = 0; i < process_state->threads_.size(); ++i) {
+    bool stack_walk_again = false;
+    if (!SymbolizeChangedFrames(changed_modules, process_state->threads_[i],
+                                process_state, &stack_walk_again)) {
+      BPLOG(INFO) << "Update interrupted by the symbol supplier";
+      return PROCESS_SYMBOL_SUPPLIER_INTERRUPTED;
+    }
+    if (stack_walk_again)
+      walk_again.push_back(i);
+  }
+
+  if (walk_again.empty())
+    return PROCESS_OK;
+  if (!dump) {
+    BPLOG(ERROR) << "Updating " << walk_again.size()
+                 << " stacks needs their minidump";
+    return PROCESS_ERROR_MINIDUMP_NOT_FOUND;
+  }
+  return WalkAgain(dump, walk_again, process_state);
+}
+
+bool ProcessStateUpdater::SymbolizeChangedFrames(
+    const vector<const CodeModule*>& changed_modules,
+    CallStack* stack,
+    ProcessState* process_state,
+    bool* walk_again) {
+  *walk_again = false;
+  const vector<const CodeModule*>* scanned_modules = stack->scanned_modules();
+  for (size_t i = 0; i < scanned_modules->size(); ++i) {
+    if (IsChanged(changed_modules, scanned_modules->at(i))) {
+      *walk_again = true;
+      return true;
+    }
+  }
+
+  const vector<StackFrame*>& frames = *stack->frames();
+  int symbolized_frames = 0;
+  for (size_t i = 0; i < frames.size(); ++i) {
+    StackFrame* frame = frames[i];
+    if (!frame->module || !IsChanged(changed_modules, frame->module))
+      continue;
+
+    // The caller was found with the old symbols' stack walking information.
+    if (i + 1 < frames.size() &&
+        (frames[i + 1]->trust == StackFrame::FRAME_TRUST_CFI ||
+         frames[i + 1]->trust == StackFrame::FRAME_TRUST_CFI_SCAN)) {
+      *walk_again = true;
+      return true;
+    }
+
+    ClearSymbols(frame);
+    StackFrameSymbolizer::SymbolizerResult result =
+        frame_symbolizer_->FillSourceLineInfo(process_state->modules_,
+                                              &process_state->system_info_,
+                                              frame);
+    switch (result) {
+      case StackFrameSymbolizer::kInterrupt:
+        return false;
+      case StackFrameSymbolizer::kError:
+        AddModule(frame->module, &process_state->modules_without_symbols_);
+        break;
+      case StackFrameSymbolizer::kWarningCorruptSymbols:
+        AddModule(frame->module,
+                  &process_state->modules_with_corrupt_symbols_);
+        break;
+      default:
+        break;
+    }
+    ++symbolized_frames;
+
+    // The new symbols would find the caller differently.
+    scoped_ptr<WindowsFrameInfo> windows_frame_info(
+        frame_symbolizer_->FindWindowsFrameInfo(frame));
+    scoped_ptr<CFIFrameInfo> cfi_frame_info(
+        windows_frame_info.get() ?
+            NULL : frame_symbolizer_->FindCFIFrameInfo(frame));
+    if (windows_frame_info.get() || cfi_frame_info.get()) {
+      *walk_again = true;
+      return true;
+    }
+  }
+  symbolized_frame_count_ += symbolized_frames;
+  return true;
+}
+
+ProcessResult ProcessStateUpdater::WalkAgain(
+    Minidump* dump,
+    const vector<size_t>& thread_indexes,
+    ProcessState* process_state) {
+  MinidumpThreadList* threads = dump->GetThreadList();
+  if (!threads) {
+    BPLOG(ERROR) << "Minidump " << dump->path() << " has no thread list";
+    return PROCESS_ERROR_NO_THREAD_LIST;
+  }
+
+  // Match the stored stacks with the minidump's threads, leaving out the
+  // thread that produced the minidump as MinidumpProcessor does.
+  uint32_t dump_thread_id = 0;
+  bool has_dump_thread = false;
+  MinidumpBreakpadInfo* breakpad_info = dump->GetBreakpadInfo();
+  if (breakpad_info)
+    has_dump_thread = breakpad_info->GetDumpThreadID(&dump_thread_id);
+  vector<MinidumpThread*> walked_threads;
+  for (unsigned int i = 0; i < threads->thread_count(); ++i) {
+    MinidumpThread* thread = threads->GetThreadAtIndex(i);
+    if (!thread) {
+      BPLOG(ERROR) << "Could not get thread " << i << " of " << dump->path();
+      return PROCESS_ERROR_GETTING_THREAD;
+    }
+    uint32_t thread_id;
+    if (!thread->GetThreadID(&thread_id)) {
+      BPLOG(ERROR) << "Could not get thread ID of thread " << i << " of "
+                   << dump->path();
+      return PROCESS_ERROR_GETTING_THREAD_ID;
+    }
+    if (!has_dump_thread || thread_id != dump_thread_id)
+      walked_threads.push_back(thread);
+  }
+  if (walked_threads.size() != process_state->threads_.size()) {
+    BPLOG(ERROR) << "Minidump " << dump->path() << " has "
+                 << walked_threads.size() << " threads to walk, but the "
+                 << "process state has " << process_state->threads_.size();
+    return PROCESS_ERROR_GETTING_THREAD;
+  }
+
+  MinidumpMemoryList* memory_list = dump->GetMemoryList();
+  for (size_t i = 0; i < thread_indexes.size(); ++i) {
+    size_t thread_index = thread_indexes[i];
+    MinidumpThread* thread = walked_threads[thread_index];
+
+    // The crashed thread is walked from the exception's context, as
+    // MinidumpProcessor::Process does.
+    MinidumpContext* context = thread->GetContext();
+    if (process_state->crashed_ &&
+        static_cast<int>(thread_index) == process_state->requesting_thread_) {
+      MinidumpException* exception = dump->GetException();
+      MinidumpContext* exception_context =
+          exception ? exception->GetContext() : NULL;
+      if (exception_context)
+        context = exception_context;
+    }
+
+    MinidumpMemoryRegion* thread_memory = thread->GetMemory();
+    if (!thread_memory && memory_list) {
+      uint64_t start_stack_memory_range = thread->GetStartOfStackMemoryRange();
+      if (start_stack_memory_range) {
+        thread_memory = memory_list->GetMemoryRegionForAddress(
+            start_stack_memory_range);
+      }
+    }
+
+    scoped_ptr<Stackwalker> stackwalker(
+        Stackwalker::StackwalkerForCPU(process_state->system_info(),
+                                       context,
+                                       thread_memory,
+                                       process_state->modules_,
+                                       frame_symbolizer_));
+    CallStack* stack = process_state->NewCallStack(NULL);
+    if (stackwalker.get() &&
+        !stackwalker->Walk(stack,
+                           &process_state->modules_without_symbols_,
+                           &process_state->modules_with_corrupt_symbols_)) {
+      BPLOG(INFO) << "Update interrupted by the symbol supplier";
+      process_state->DeleteCallStack(stack);
+      return PROCESS_SYMBOL_SUPPLIER_INTERRUPTED;
+    }
+    BPLOG_IF(ERROR, !stackwalker.get()) << "No stackwalker for thread "
+                                        << thread_index << " of "
+                                        << dump->path();
+
+    process_state->DeleteCallStack(process_state->threads_[thread_index]);
+    process_state->threads_[thread_index] = stack;
+    if (process_state->thread_memory_regions_.size() ==
+        process_state->threads_.size()) {
+      process_state->thread_memory_regions_[thread_index] = thread_memory;
+    }
+    ++walked_stack_count_;
+  }
+  return PROCESS_OK;
+}
+
+}  // namespace google_breakpad
@@ -0,0 +1,126 @@
+// Copyright (c) 2016 Google Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+// notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above
+// copyright notice, this list of conditions and the following disclaimer
+// in the documentation and/or other materials provided with the
+// distribution.
+//     * Neither the name of Google Inc. nor the names of its
+// contributors may be used to endorse or promote products derived from
+// this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+// process_state_updater.h: ProcessStateUpdater, which brings a processed
+// minidump up to date when the symbols of some of its modules change.
+//
+// When a module's symbols turn up after its crashes were processed,
+// processing those minidumps again from scratch walks and symbolizes
+// every thread anew, although most of that work gives the same answer as
+// before.  ProcessStateUpdater redoes only the parts of a stored
+// ProcessState that depend on the changed symbols.
+//
+// A stack is walked again from the minidump if
+//  - stack scanning consulted the symbols of a changed module while
+//    walking it (see CallStack::scanned_modules), or
+//  - one of its frames lies in a changed module, and either the frame's
+//    caller was found with stack walking information from the module's
+//    old symbols (FRAME_TRUST_CFI), or its new symbols have some for the
+//    frame.
+// In the other stacks, the frames in changed modules are only symbolized
+// again, which needs no minidump.
+//
+// The ProcessState may have been read back with ProcessStateSerializer,
+// which keeps the scanned modules and the lists of modules without
+// symbols or with corrupt symbols that the updater relies on.
+
+#ifndef PROCESSOR_PROCESS_STATE_UPDATER_H__
+#define PROCESSOR_PROCESS_STATE_UPDATER_H__
+
+#include <stddef.h>
+
+#include <vector>
+
+#include "google_breakpad/processor/process_result.h"
+
+namespace google_breakpad {
+
+class CallStack;
+class CodeModule;
+class Minidump;
+class ProcessState;
+class StackFrameSymbolizer;
+
+class ProcessStateUpdater {
+ public:
+  // Symbolizes and walks with |frame_symbolizer|, whose resolver must not
+  // have the old symbols of the changed modules loaded, and which must not
+  // use a CFIFrameInfoCache or MissingSymbolCache that remembers them.
+  // Walking a stack again symbolizes all of its frames, so the symbolizer
+  // should find the current symbols of every module, as the processor
+  // would.  The updater does not take ownership of |frame_symbolizer|.
+  explicit ProcessStateUpdater(StackFrameSymbolizer* frame_symbolizer);
+
+  // Brings |process_state|, which was processed from |dump|, up to date
+  // after the symbols of |changed_modules| changed.  Modules are matched
+  // with the process's own by debug file and debug identifier.  |dump| is
+  // only read if a stack has to be walked again, and may be NULL if the
+  // caller knows none will be, in which case
+  // PROCESS_ERROR_MINIDUMP_NOT_FOUND is returned if one is.  Returns
+  // PROCESS_SYMBOL_SUPPLIER_INTERRUPTED if the symbol supplier
+  // interrupted, or the error MinidumpProcessor::Process would return if
+  // the minidump's threads can't be read; |process_state| is then partly
+  // updated, and should be updated again from its stored form.
+  ProcessResult Update(Minidump* dump,
+                       const std::vector<const CodeModule*>& changed_modules,
+                       ProcessState* process_state);
+
+  // The number of stacks walked again, and of frames symbolized again in
+  // the stacks that were not, by the last call to Update.
+  int walked_stack_count() const { return walked_stack_count_; }
+  int symbolized_frame_count() const { return symbolized_frame_count_; }
+
+ private:
+  // Symbolizes the frames of |stack| in |changed_modules| again, and sets
+  // |*walk_again| if the stack has to be walked again.  Returns false if
+  // the symbol supplier interrupted.
+  bool SymbolizeChangedFrames(
+      const std::vector<const CodeModule*>& changed_modules,
+      CallStack* stack,
+      ProcessState* process_state,
+      bool* walk_again);
+
+  // Walks the stacks of |process_state|'s threads |thread_indexes| again
+  // from |dump|, replacing the stored ones.
+  ProcessResult WalkAgain(Minidump* dump,
+                          const std::vector<size_t>& thread_indexes,
+                          ProcessState* process_state);
+
+  StackFrameSymbolizer* frame_symbolizer_;
+  int walked_stack_count_;
+  int symbolized_frame_count_;
+
+  // Disallow copy constructor and assignment operator.
+  ProcessStateUpdater(const ProcessStateUpdater&);
+  void operator=(const ProcessStateUpdater&);
+};
+
+}  // namespace google_breakpad
+
+#endif  // PROCESSOR_PROCESS_STATE_UPDATER_H__
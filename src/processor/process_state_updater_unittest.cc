@@ -0,0 +1,263 @@
+// Copyright (c) 2016 Google Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+// notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above
+// copyright notice, this list of conditions and the following disclaimer
+// in the documentation and/or other materials provided with the
+// distribution.
+//     * Neither the name of Google Inc. nor the names of its
+// contributors may be used to endorse or promote products derived from
+// this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+// process_state_updater_unittest.cc: Unit tests for ProcessStateUpdater.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+
+#include <string>
+#include <vector>
+
+#include "breakpad_googletest_includes.h"
+#include "common/tests/auto_tempdir.h"
+#include "common/using_std_string.h"
+#include "google_breakpad/processor/basic_source_line_resolver.h"
+#include "google_breakpad/processor/call_stack.h"
+#include "google_breakpad/processor/code_module.h"
+#include "google_breakpad/processor/code_modules.h"
+#include "google_breakpad/processor/minidump.h"
+#include "google_breakpad/processor/minidump_processor.h"
+#include "google_breakpad/processor/process_state.h"
+#include "google_breakpad/processor/stack_frame.h"
+#include "google_breakpad/processor/stack_frame_symbolizer.h"
+#include "processor/process_state_json_writer.h"
+#include "processor/process_state_serializer.h"
+#include "processor/process_state_updater.h"
+#include "processor/simple_symbol_supplier.h"
+
+namespace {
+
+using google_breakpad::AutoTempDir;
+using google_breakpad::BasicSourceLineResolver;
+using google_breakpad::CodeModule;
+using google_breakpad::Minidump;
+using google_breakpad::MinidumpProcessor;
+using google_breakpad::ProcessState;
+using google_breakpad::ProcessStateJSONWriter;
+using google_breakpad::ProcessStateSerializer;
+using google_breakpad::ProcessStateUpdater;
+using google_breakpad::SimpleSymbolSupplier;
+using google_breakpad::StackFrameSymbolizer;
+using std::vector;
+
+string TestDataDir() {
+  return string(getenv("srcdir") ? getenv("srcdir") : ".") +
+      "/src/processor/testdata";
+}
+
+string ToJSON(const ProcessState &state) {
+  ProcessStateJSONWriter writer;
+  writer.Write(state);
+  return string(writer.data(), writer.size());
+}
+
+class ProcessStateUpdaterTest : public ::testing::Test {
+ public:
+  void SetUp() {
+    dump_path_ = TestDataDir() + "/minidump2.dmp";
+    full_symbols_ = TestDataDir() + "/symbols";
+    no_symbols_ = TestDataDir() + "/no-such-symbols";
+  }
+
+  // Processes the minidump with the symbols under |symbol_path|, and
+  // leaves the result in |state| as it would be read back from storage.
+  void ProcessAndStore(const string &symbol_path, ProcessState *state) {
+    SimpleSymbolSupplier supplier(symbol_path);
+    BasicSourceLineResolver resolver;
+    MinidumpProcessor processor(&supplier, &resolver);
+    ProcessState processed;
+    ASSERT_EQ(google_breakpad::PROCESS_OK,
+              processor.Process(dump_path_, &processed));
+    string serialized;
+    serializer_.Serialize(processed, &serialized);
+    ASSERT_TRUE(serializer_.Deserialize(serialized.data(), serialized.size(),
+                                        state));
+  }
+
+  // Updates |state| with the symbols under |symbol_path| for the modules
+  // with the debug files |changed|, reading the minidump if |read_dump|.
+  google_breakpad::ProcessResult Update(const string &symbol_path,
+                                        const vector<string> &changed,
+                                        bool read_dump,
+                                        ProcessState *state) {
+    vector<const CodeModule*> changed_modules;
+    for (size_t i = 0; i < changed.size(); ++i) {
+      for (unsigned int j = 0; j < state->modules()->module_count(); ++j) {
+        const CodeModule *module = state->modules()->GetModuleAtIndex(j);
+        if (module->debug_file() == changed[i])
+          changed_modules.push_back(module);
+      }
+    }
+    EXPECT_EQ(changed.size(), changed_modules.size());
+
+    SimpleSymbolSupplier supplier(symbol_path);
+    BasicSourceLineResolver resolver;
+    StackFrameSymbolizer symbolizer(&supplier, &resolver);
+    ProcessStateUpdater updater(&symbolizer);
+    Minidump dump(dump_path_);
+    EXPECT_TRUE(dump.Read());
+    google_breakpad::ProcessResult result =
+        updater.Update(read_dump ? &dump : NULL, changed_modules, state);
+    walked_stack_count_ = updater.walked_stack_count();
+    symbolized_frame_count_ = updater.symbolized_frame_count();
+    return result;
+  }
+
+  // Copies the symbols of |module| with |identifier| under |directory|,
+  // leaving out their stack walking information unless
+  // |with_stack_info|.
+  void CopySymbols(const string &module, const string &identifier,
+                   bool with_stack_info, const string &directory) {
+    const string path = "/" + module + "/" + identifier;
+    const string file = "/" + module + ".sym";
+    FILE *input = fopen((full_symbols_ + path + file).c_str(), "r");
+    ASSERT_TRUE(input);
+    ASSERT_EQ(0, mkdir((directory + "/" + module).c_str(), 0755));
+    ASSERT_EQ(0, mkdir((directory + path).c_str(), 0755));
+    FILE *output = fopen((directory + path + file).c_str(), "w");
+    ASSERT_TRUE(output);
+    char line[4096];
+    while (fgets(line, sizeof(line), input)) {
+      if (with_stack_info || strncmp(line, "STACK ", 6) != 0)
+        fputs(line, output);
+    }
+    fclose(input);
+    fclose(output);
+  }
+
+  string dump_path_;
+  string full_symbols_;
+  string no_symbols_;
+  ProcessStateSerializer serializer_;
+  int walked_stack_count_;
+  int symbolized_frame_count_;
+};
+
+TEST_F(ProcessStateUpdaterTest, WalksAgainWithNewStackInfo) {
+  ProcessState expected;
+  ProcessAndStore(full_symbols_, &expected);
+
+  // Without symbols, the stack is walked with frame pointers, and the
+  // new symbols have stack walking information for it.
+  ProcessState state;
+  ProcessAndStore(no_symbols_, &state);
+  EXPECT_EQ(2U, state.modules_without_symbols()->size());
+  vector<string> changed;
+  changed.push_back("c:\\test_app.pdb");
+  changed.push_back("kernel32.pdb");
+  ASSERT_EQ(google_breakpad::PROCESS_OK,
+            Update(full_symbols_, changed, true, &state));
+  EXPECT_EQ(1, walked_stack_count_);
+  EXPECT_EQ(0, symbolized_frame_count_);
+  EXPECT_TRUE(state.modules_without_symbols()->empty());
+  EXPECT_EQ(ToJSON(expected), ToJSON(state));
+}
+
+TEST_F(ProcessStateUpdaterTest, SymbolizesWithoutStackInfo) {
+  const char kApp[] = "null_read_av";
+  const char kAppIdentifier[] = "7B7D1968FF0D47AE4366E9C3A7E1B6750";
+  const char kLibc[] = "libc-2.13.so";
+  const char kLibcIdentifier[] = "F4F8DFCD5A5FB5A7CE64717E9E6AE3890";
+  dump_path_ = TestDataDir() + "/linux_null_read_av.dmp";
+  AutoTempDir app_symbols;
+  CopySymbols(kApp, kAppIdentifier, true, app_symbols.path());
+  AutoTempDir named_symbols;
+  CopySymbols(kApp, kAppIdentifier, true, named_symbols.path());
+  CopySymbols(kLibc, kLibcIdentifier, false, named_symbols.path());
+
+  // libc's frame is the last one with a module, and its caller was found
+  // by scanning the stack, which didn't look at libc.  Symbols that only
+  // name its functions leave the stack as it was.
+  ProcessState state;
+  ProcessAndStore(app_symbols.path(), &state);
+  ASSERT_EQ(1U, state.modules_without_symbols()->size());
+  ProcessState expected;
+  ProcessAndStore(named_symbols.path(), &expected);
+  vector<string> changed(1, kLibc);
+  ASSERT_EQ(google_breakpad::PROCESS_OK,
+            Update(named_symbols.path(), changed, false, &state));
+  EXPECT_EQ(0, walked_stack_count_);
+  EXPECT_EQ(1, symbolized_frame_count_);
+  EXPECT_EQ("__libc_start_main",
+            string(state.threads()->at(0)->frames()->at(2)->FunctionName()));
+  EXPECT_TRUE(state.modules_without_symbols()->empty());
+  EXPECT_EQ(ToJSON(expected), ToJSON(state));
+
+  // Symbols with call frame info for the frame change how its caller is
+  // found.
+  ProcessAndStore(full_symbols_, &expected);
+  ASSERT_EQ(google_breakpad::PROCESS_OK,
+            Update(full_symbols_, changed, true, &state));
+  EXPECT_EQ(1, walked_stack_count_);
+  EXPECT_EQ(ToJSON(expected), ToJSON(state));
+}
+
+TEST_F(ProcessStateUpdaterTest, WalksAgainWhenScannedOrUnwound) {
+  ProcessState state;
+  ProcessAndStore(full_symbols_, &state);
+  string original = ToJSON(state);
+
+  // The stack was walked with kernel32's stack walking information, and
+  // scanned through its code.
+  vector<string> changed(1, "kernel32.pdb");
+  EXPECT_EQ(google_breakpad::PROCESS_ERROR_MINIDUMP_NOT_FOUND,
+            Update(full_symbols_, changed, false, &state));
+  ASSERT_EQ(google_breakpad::PROCESS_OK,
+            Update(full_symbols_, changed, true, &state));
+  EXPECT_EQ(1, walked_stack_count_);
+  EXPECT_EQ(original, ToJSON(state));
+
+  // Walking it again symbolizes all of its frames, with whatever symbols
+  // are found for them then.
+  ASSERT_EQ(google_breakpad::PROCESS_OK,
+            Update(no_symbols_, changed, true, &state));
+  EXPECT_EQ(1, walked_stack_count_);
+  EXPECT_EQ(2U, state.modules_without_symbols()->size());
+  EXPECT_NE(original, ToJSON(state));
+}
+
+TEST_F(ProcessStateUpdaterTest, LeavesUnaffectedStacksAlone) {
+  ProcessState state;
+  ProcessAndStore(full_symbols_, &state);
+  string original = ToJSON(state);
+
+  // No frame lies in ntdll, and no walk looked at it.
+  vector<string> changed(1, "ntdll.pdb");
+  ASSERT_EQ(google_breakpad::PROCESS_OK,
+            Update(no_symbols_, changed, false, &state));
+  EXPECT_EQ(0, walked_stack_count_);
+  EXPECT_EQ(0, symbolized_frame_count_);
+  EXPECT_EQ(original, ToJSON(state));
+}
+
+}  // namespace
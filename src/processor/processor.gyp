@@ -44,16 +44,25 @@
         'basic_source_line_resolver_types.h',
         'binarystream.cc',
         'binarystream.h',
+        'block_caching_minidump_reader.cc',
         'call_stack.cc',
         'cfi_frame_info-inl.h',
         'cfi_frame_info.cc',
         'cfi_frame_info.h',
+        'cfi_frame_info_cache.cc',
+        'code_modules_cache.cc',
+        'crash_signature_analyzer.cc',
+        'crash_signature_analyzer.h',
+        'crash_signature_cache.cc',
         'contained_range_map-inl.h',
+        'compressed_module_format.h',
         'contained_range_map.h',
         'disassembler_x86.cc',
         'disassembler_x86.h',
         'dump_context.cc',
         'dump_object.cc',
+        'elf_unwind_info.cc',
+        'elf_unwind_info.h',
         'exploitability.cc',
         'exploitability_linux.cc',
         'exploitability_linux.h',
@@ -61,6 +70,8 @@
         'exploitability_win.h',
         'fast_source_line_resolver.cc',
         'fast_source_line_resolver_types.h',
+        'frame_table_writer.cc',
+        'frame_table_writer.h',
         'linked_ptr.h',
         'logging.cc',
         'logging.h',
@@ -69,16 +80,30 @@
         'microdump_processor.cc',
         'minidump.cc',
         'minidump_processor.cc',
+        'minidump_snapshot.cc',
+        'minidump_validator.cc',
+        'missing_symbol_cache.cc',
+        'module_arena.cc',
+        'module_arena.h',
         'module_comparer.cc',
         'module_comparer.h',
         'module_factory.h',
+        'mutex.h',
         'module_serializer.cc',
         'module_serializer.h',
+        'pack_symbol_supplier.cc',
+        'pack_symbol_supplier.h',
         'pathname_stripper.cc',
         'pathname_stripper.h',
         'postfix_evaluator-inl.h',
         'postfix_evaluator.h',
         'process_state.cc',
+        'process_state_json_writer.cc',
+        'process_state_json_writer.h',
+        'process_state_serializer.cc',
+        'process_state_serializer.h',
+        'process_state_updater.cc',
+        'process_state_updater.h',
         'range_map-inl.h',
         'range_map.h',
         'simple_serializer-inl.h',
@@ -87,8 +112,18 @@
         'simple_symbol_supplier.h',
         'source_line_resolver_base.cc',
         'source_line_resolver_base_types.h',
+        'symbol_affinity_router.cc',
+        'symbol_file_decompressor.cc',
+        'symbol_file_decompressor.h',
+        'symbol_file_index.cc',
+        'symbol_file_index.h',
+        'symbol_module_cache.cc',
+        'symbol_pack.cc',
+        'symbol_pack.h',
         'stack_frame_cpu.cc',
         'stack_frame_symbolizer.cc',
+        'stack_profile.cc',
+        'stack_profile.h',
         'stackwalker.cc',
         'stackwalker_address_list.cc',
         'stackwalker_address_list.h',
@@ -119,11 +154,16 @@
         'static_map_iterator.h',
         'static_range_map-inl.h',
         'static_range_map.h',
+        'stopwatch.h',
         'synth_minidump.cc',
         'synth_minidump.h',
+        'task_executor.cc',
         'tokenize.cc',
         'tokenize.h',
+        'unwind_policy.cc',
+        'walk_budget.cc',
         'windows_frame_info.h',
+        'windows_frame_program.h',
       ],
       'include_dirs': [
         '..',
@@ -142,16 +182,25 @@
         'binarystream_unittest.cc',
         'cfi_frame_info_unittest.cc',
         'contained_range_map_unittest.cc',
+        'crash_signature_analyzer_unittest.cc',
         'disassembler_x86_unittest.cc',
+        'elf_unwind_info_unittest.cc',
         'exploitability_unittest.cc',
         'fast_source_line_resolver_unittest.cc',
+        'frame_table_writer_unittest.cc',
         'map_serializers_unittest.cc',
         'microdump_processor_unittest.cc',
         'minidump_processor_unittest.cc',
         'minidump_unittest.cc',
+        'minidump_snapshot_unittest.cc',
+        'minidump_validator_unittest.cc',
+        'module_arena_unittest.cc',
         'pathname_stripper_unittest.cc',
         'postfix_evaluator_unittest.cc',
+        'process_state_serializer_unittest.cc',
+        'process_state_updater_unittest.cc',
         'range_map_unittest.cc',
+        'stack_profile_unittest.cc',
         'stackwalker_address_list_unittest.cc',
         'stackwalker_amd64_unittest.cc',
         'stackwalker_arm64_unittest.cc',
@@ -163,7 +212,10 @@
         'static_contained_range_map_unittest.cc',
         'static_map_unittest.cc',
         'static_range_map_unittest.cc',
+        'symbol_affinity_router_unittest.cc',
         'synth_minidump_unittest.cc',
+        'task_executor_unittest.cc',
+        'unwind_policy_unittest.cc',
         'synth_minidump_unittest_data.h',
       ],
       'include_dirs': [
@@ -175,5 +227,35 @@
         '../build/testing.gypi:gtest',
       ],
     },
+    {
+      'target_name': 'minidump_processor_benchmark',
+      'type': 'executable',
+      'sources': [
+        '../common/benchmark_helpers.cc',
+        '../common/benchmark_helpers.h',
+        'minidump_processor_benchmark.cc',
+      ],
+      'include_dirs': [
+        '..',
+      ],
+      'dependencies': [
+        'processor',
+      ],
+    },
+    {
+      'target_name': 'processor_microbenchmark',
+      'type': 'executable',
+      'sources': [
+        '../common/benchmark_helpers.cc',
+        '../common/benchmark_helpers.h',
+        'processor_microbenchmark.cc',
+      ],
+      'include_dirs': [
+        '..',
+      ],
+      'dependencies': [
+        'processor',
+      ],
+    },
   ],
 }
@@ -0,0 +1,836 @@
+// Copyright (c) 2016 Google Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+// notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above
+// copyright notice, this list of conditions and the following disclaimer
+// in the documentation and/or other materials provided with the
+// distribution.
+//     * Neither the name of Google Inc. nor the names of its
+// contributors may be used to endorse or promote products derived from
+// this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+// processor_microbenchmark.cc: Measures the processor's lookup structures,
+// expression evaluators and parsers one at a time.
+//
+// Where minidump_processor_benchmark measures the processor as a whole,
+// each benchmark here times a single hot path, so that a change to it can
+// be measured alone.  The inputs resemble what the processor sees: the
+// range maps hold the functions of a module, with sizes spread over a few
+// orders of magnitude and lookups concentrated on a minority of them; the
+// evaluators run the rules that compilers emit for common prologues; and
+// the memory lookups read a thread's stack.
+//
+// Every benchmark reports the mean time per operation.  The inputs are
+// generated from a fixed seed, so runs are comparable.  Logging goes to
+// stderr, results to stdout.
+
+#include <ctype.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include "common/benchmark_helpers.h"
+#include "common/scoped_ptr.h"
+#include "common/using_std_string.h"
+#include "google_breakpad/common/minidump_format.h"
+#include "google_breakpad/processor/basic_source_line_resolver.h"
+#include "google_breakpad/processor/minidump.h"
+#include "processor/address_map-inl.h"
+#include "processor/basic_code_module.h"
+#include "processor/cfi_frame_info.h"
+#include "processor/contained_range_map-inl.h"
+#include "processor/logging.h"
+#include "processor/map_serializers-inl.h"
+#include "processor/postfix_evaluator-inl.h"
+#include "processor/range_map-inl.h"
+#include "processor/static_map-inl.h"
+#include "processor/static_range_map-inl.h"
+#include "processor/stopwatch.h"
+#include "processor/synth_minidump.h"
+#include "processor/tokenize.h"
+
+namespace {
+
+using google_breakpad::AddressMap;
+using google_breakpad::BasicCodeModule;
+using google_breakpad::BasicSourceLineResolver;
+using google_breakpad::CFIFrameInfo;
+using google_breakpad::CFIFrameInfoParseHandler;
+using google_breakpad::CFIRuleParser;
+using google_breakpad::ContainedRangeMap;
+using google_breakpad::Minidump;
+using google_breakpad::MinidumpMemoryList;
+using google_breakpad::MinidumpMemoryRegion;
+using google_breakpad::ParseCount;
+using google_breakpad::PostfixEvaluator;
+using google_breakpad::RangeMap;
+using google_breakpad::RangeMapSerializer;
+using google_breakpad::StaticMap;
+using google_breakpad::StaticRangeMap;
+using google_breakpad::StdMapSerializer;
+using google_breakpad::Stopwatch;
+using google_breakpad::scoped_array;
+using google_breakpad::scoped_ptr;
+using google_breakpad::SynthMinidump::Dump;
+using google_breakpad::SynthMinidump::Memory;
+using std::map;
+using std::vector;
+
+// Where the module and the stack live in the benchmarked process.
+const uint64_t kModuleBase = 0x7fff50000000ULL;
+const uint64_t kStackBase = 0x7fffe0000000ULL;
+const uint64_t kStackSize = 1024 * 1024;
+
+// The number of functions in the module, about as many as a large shared
+// library has.
+const int kFunctionCount = 20000;
+
+// The number of distinct lookup addresses cycled through.
+const size_t kLookupCount = 4096;
+
+struct BenchmarkOptions {
+  BenchmarkOptions() : operations(1000000), seed(1) {}
+
+  unsigned long operations;
+  unsigned long seed;
+};
+
+// A small, fast pseudo-random number generator (xorshift64*), so that the
+// inputs are the same on every platform.
+class Random {
+ public:
+  explicit Random(uint64_t seed) : state_(seed ? seed : 1) {}
+
+  uint64_t Next() {
+    state_ ^= state_ >> 12;
+    state_ ^= state_ << 25;
+    state_ ^= state_ >> 27;
+    return state_ * 2685821657736338717ULL;
+  }
+
+  // A number in [0, limit).
+  uint64_t Below(uint64_t limit) { return Next() % limit; }
+
+  // A number in [0, 1).
+  double Fraction() { return (Next() >> 11) / 9007199254740992.0; }
+
+ private:
+  uint64_t state_;
+};
+
+// A function of the module: [base, base + size).
+struct Function {
+  uint64_t base;
+  uint64_t size;
+};
+
+// Generates the functions of the module.  Sizes are log-uniform between 16
+// bytes and 8 kilobytes, and functions are separated by up to 32 bytes of
+// alignment padding.
+vector<Function> ModuleFunctions(Random *random) {
+  vector<Function> functions;
+  uint64_t address = kModuleBase;
+  for (int i = 0; i < kFunctionCount; ++i) {
+    Function function;
+    function.base = address;
+    function.size =
+        static_cast<uint64_t>(16 * pow(2.0, 9 * random->Fraction()));
+    functions.push_back(function);
+    address += function.size + random->Below(33);
+  }
+  return functions;
+}
+
+// Generates addresses to look up in the module: nine in ten fall in a
+// function, chosen so that a tenth of the functions get most of the
+// lookups, and the rest fall anywhere in the module, gaps included.
+vector<uint64_t> LookupAddresses(Random *random,
+                                 const vector<Function> &functions) {
+  const Function &last = functions.back();
+  uint64_t module_size = last.base + last.size - kModuleBase;
+  vector<uint64_t> addresses;
+  for (size_t i = 0; i < kLookupCount; ++i) {
+    if (random->Below(10) == 0) {
+      addresses.push_back(kModuleBase + random->Below(module_size));
+    } else {
+      double skew = random->Fraction();
+      size_t index =
+          static_cast<size_t>(functions.size() * skew * skew * skew);
+      // Spread the hot functions through the module.
+      index = (index * 7919) % functions.size();
+      const Function &function = functions[index];
+      addresses.push_back(function.base + random->Below(function.size));
+    }
+  }
+  return addresses;
+}
+
+// What a benchmark measured.
+struct BenchmarkResult {
+  BenchmarkResult() : operations(0), hits(0), seconds(0) {}
+
+  unsigned long operations;
+  // How many operations succeeded, which also keeps the compiler from
+  // dropping their results.
+  unsigned long hits;
+  double seconds;
+};
+
+// The module's functions and lookups, shared by the range map benchmarks.
+struct ModuleData {
+  explicit ModuleData(const BenchmarkOptions &options) : random(options.seed) {
+    functions = ModuleFunctions(&random);
+    lookups = LookupAddresses(&random, functions);
+  }
+
+  Random random;
+  vector<Function> functions;
+  vector<uint64_t> lookups;
+};
+
+void BenchmarkRangeMap(const BenchmarkOptions &options, bool freeze,
+                       BenchmarkResult *result) {
+  ModuleData data(options);
+  RangeMap<uint64_t, int> range_map;
+  for (size_t i = 0; i < data.functions.size(); ++i)
+    range_map.StoreRange(data.functions[i].base, data.functions[i].size, i);
+  if (freeze)
+    range_map.Freeze();
+
+  Stopwatch stopwatch;
+  for (unsigned long i = 0; i < options.operations; ++i) {
+    int entry;
+    if (range_map.RetrieveRange(data.lookups[i % kLookupCount], &entry,
+                                NULL, NULL)) {
+      ++result->hits;
+    }
+  }
+  result->seconds = stopwatch.ElapsedSeconds();
+  result->operations = options.operations;
+}
+
+void BenchmarkRangeMapTree(const BenchmarkOptions &options,
+                           BenchmarkResult *result) {
+  BenchmarkRangeMap(options, false, result);
+}
+
+void BenchmarkRangeMapFrozen(const BenchmarkOptions &options,
+                             BenchmarkResult *result) {
+  BenchmarkRangeMap(options, true, result);
+}
+
+// Looks up the words of a stack in batches, as stack scanning does: most
+// words are small integers or stack addresses that fall in no function,
+// and the rest are return addresses.
+void BenchmarkRangeMapBatch(const BenchmarkOptions &options,
+                            BenchmarkResult *result) {
+  ModuleData data(options);
+  RangeMap<uint64_t, int> range_map;
+  for (size_t i = 0; i < data.functions.size(); ++i)
+    range_map.StoreRange(data.functions[i].base, data.functions[i].size, i);
+  range_map.Freeze();
+
+  const size_t kBatchSize = 256;
+  vector<uint64_t> words(kLookupCount);
+  for (size_t i = 0; i < words.size(); ++i) {
+    switch (data.random.Below(4)) {
+      case 0:
+        words[i] = data.lookups[i];
+        break;
+      case 1:
+        words[i] = kStackBase + data.random.Below(kStackSize);
+        break;
+      default:
+        words[i] = data.random.Below(4096);
+        break;
+    }
+  }
+
+  vector<int> entries(kBatchSize);
+  Stopwatch stopwatch;
+  unsigned long operations = 0;
+  for (size_t batch = 0; operations < options.operations; ++batch) {
+    size_t offset = (batch * kBatchSize) % kLookupCount;
+    range_map.RetrieveRanges(&words[offset], kBatchSize, -1, &entries[0]);
+    for (size_t i = 0; i < kBatchSize; ++i) {
+      if (entries[i] != -1)
+        ++result->hits;
+    }
+    operations += kBatchSize;
+  }
+  result->seconds = stopwatch.ElapsedSeconds();
+  result->operations = operations;
+}
+
+// The functions stored with STACK WIN records nest: a function's record
+// covers all of it, and further records cover its prologue and, for some,
+// a block inside the prologue.
+void BenchmarkContainedRangeMap(const BenchmarkOptions &options, bool freeze,
+                                BenchmarkResult *result) {
+  ModuleData data(options);
+  ContainedRangeMap<uint64_t, int> contained_map;
+  for (size_t i = 0; i < data.functions.size(); ++i) {
+    const Function &function = data.functions[i];
+    contained_map.StoreRange(function.base, function.size, i);
+    uint64_t nested = function.size / 4;
+    for (int depth = 0; depth < 2 && nested >= 4; ++depth) {
+      contained_map.StoreRange(function.base, nested, i);
+      nested /= 4;
+    }
+  }
+  if (freeze)
+    contained_map.Freeze();
+
+  Stopwatch stopwatch;
+  for (unsigned long i = 0; i < options.operations; ++i) {
+    int entry;
+    if (contained_map.RetrieveRange(data.lookups[i % kLookupCount], &entry))
+      ++result->hits;
+  }
+  result->seconds = stopwatch.ElapsedSeconds();
+  result->operations = options.operations;
+}
+
+void BenchmarkContainedRangeMapTree(const BenchmarkOptions &options,
+                                    BenchmarkResult *result) {
+  BenchmarkContainedRangeMap(options, false, result);
+}
+
+void BenchmarkContainedRangeMapFrozen(const BenchmarkOptions &options,
+                                      BenchmarkResult *result) {
+  BenchmarkContainedRangeMap(options, true, result);
+}
+
+void BenchmarkStaticRangeMap(const BenchmarkOptions &options,
+                             BenchmarkResult *result) {
+  ModuleData data(options);
+  RangeMap<uint64_t, int> range_map;
+  for (size_t i = 0; i < data.functions.size(); ++i)
+    range_map.StoreRange(data.functions[i].base, data.functions[i].size, i);
+  RangeMapSerializer<uint64_t, int> serializer;
+  unsigned int size;
+  scoped_array<char> serialized(serializer.Serialize(range_map, &size));
+  StaticRangeMap<uint64_t, int> static_map(serialized.get());
+
+  Stopwatch stopwatch;
+  for (unsigned long i = 0; i < options.operations; ++i) {
+    const int *entry;
+    uint64_t base, range_size;
+    if (static_map.RetrieveRange(data.lookups[i % kLookupCount], entry,
+                                 &base, &range_size)) {
+      ++result->hits;
+    }
+  }
+  result->seconds = stopwatch.ElapsedSeconds();
+  result->operations = options.operations;
+}
+
+// Looks up the starts of functions, as the fast resolver does with the
+// addresses of PUBLIC records.
+void BenchmarkStaticMap(const BenchmarkOptions &options,
+                        BenchmarkResult *result) {
+  ModuleData data(options);
+  map<uint64_t, int> std_map;
+  for (size_t i = 0; i < data.functions.size(); ++i)
+    std_map[data.functions[i].base] = i;
+  StdMapSerializer<uint64_t, int> serializer;
+  unsigned int size;
+  scoped_array<char> serialized(serializer.Serialize(std_map, &size));
+  StaticMap<uint64_t, int> static_map(serialized.get());
+
+  Stopwatch stopwatch;
+  for (unsigned long i = 0; i < options.operations; ++i) {
+    StaticMap<uint64_t, int>::iterator it =
+        static_map.upper_bound(data.lookups[i % kLookupCount]);
+    if (it != static_map.begin())
+      ++result->hits;
+  }
+  result->seconds = stopwatch.ElapsedSeconds();
+  result->operations = options.operations;
+}
+
+// Looks up PUBLIC symbols, which the resolvers keep in an AddressMap.
+void BenchmarkAddressMap(const BenchmarkOptions &options,
+                         BenchmarkResult *result) {
+  ModuleData data(options);
+  AddressMap<uint64_t, int> address_map;
+  for (size_t i = 0; i < data.functions.size(); ++i)
+    address_map.Store(data.functions[i].base, i);
+
+  Stopwatch stopwatch;
+  for (unsigned long i = 0; i < options.operations; ++i) {
+    int entry;
+    if (address_map.Retrieve(data.lookups[i % kLookupCount], &entry, NULL))
+      ++result->hits;
+  }
+  result->seconds = stopwatch.ElapsedSeconds();
+  result->operations = options.operations;
+}
+
+// A minidump holding a thread's stack, filled with a mix of return
+// addresses, stack addresses and small integers.
+class StackDump {
+ public:
+  explicit StackDump(const BenchmarkOptions &options) : region_(NULL) {
+    Random random(options.seed);
+    Dump dump(0);
+    Memory stack(dump, kStackBase);
+    for (uint64_t offset = 0; offset < kStackSize; offset += 8) {
+      switch (random.Below(4)) {
+        case 0:
+          stack.D64(kModuleBase + random.Below(0x1000000));
+          break;
+        case 1:
+          stack.D64(kStackBase + random.Below(kStackSize));
+          break;
+        default:
+          stack.D64(random.Below(4096));
+          break;
+      }
+    }
+    dump.Add(&stack);
+    dump.Finish();
+    if (!dump.GetContents(&contents_))
+      return;
+    minidump_.reset(new Minidump(
+        reinterpret_cast<const uint8_t*>(contents_.data()), contents_.size()));
+    if (!minidump_->Read())
+      return;
+    MinidumpMemoryList *memory_list = minidump_->GetMemoryList();
+    if (memory_list)
+      region_ = memory_list->GetMemoryRegionForAddress(kStackBase);
+  }
+
+  // The stack's memory region, or NULL if the minidump could not be read.
+  MinidumpMemoryRegion *region() const { return region_; }
+
+ private:
+  string contents_;
+  scoped_ptr<Minidump> minidump_;
+  MinidumpMemoryRegion *region_;
+};
+
+// Random aligned addresses in the stack, the lookups frame walking and
+// stack scanning make.
+vector<uint64_t> StackAddresses(const BenchmarkOptions &options) {
+  Random random(options.seed + 1);
+  vector<uint64_t> addresses;
+  for (size_t i = 0; i < kLookupCount; ++i)
+    addresses.push_back(kStackBase + random.Below(kStackSize / 8) * 8);
+  return addresses;
+}
+
+void BenchmarkMemoryRegion(const BenchmarkOptions &options,
+                           BenchmarkResult *result) {
+  StackDump stack_dump(options);
+  MinidumpMemoryRegion *region = stack_dump.region();
+  if (!region) {
+    BPLOG(ERROR) << "Couldn't read the synthetic stack";
+    return;
+  }
+  vector<uint64_t> addresses = StackAddresses(options);
+
+  Stopwatch stopwatch;
+  for (unsigned long i = 0; i < options.operations; ++i) {
+    uint64_t value;
+    if (region->GetMemoryAtAddress(addresses[i % kLookupCount], &value))
+      result->hits += value & 1;
+  }
+  result->seconds = stopwatch.ElapsedSeconds();
+  result->operations = options.operations;
+}
+
+// Runs the program of a STACK WIN record for a function with a standard
+// %ebp frame that saves two registers, as the x86 stack walker does.
+void BenchmarkPostfixEvaluator(const BenchmarkOptions &options,
+                               BenchmarkResult *result) {
+  StackDump stack_dump(options);
+  MinidumpMemoryRegion *region = stack_dump.region();
+  if (!region) {
+    BPLOG(ERROR) << "Couldn't read the synthetic stack";
+    return;
+  }
+  vector<uint64_t> addresses = StackAddresses(options);
+
+  const string kProgram =
+      "$T0 $ebp = $eip $T0 4 + ^ = $ebp $T0 ^ = $esp $T0 8 + = "
+      "$ebx $T0 28 - ^ = $esi $T0 24 - ^ =";
+  typedef PostfixEvaluator<uint64_t> Evaluator;
+  Evaluator::DictionaryType dictionary;
+  Evaluator evaluator(&dictionary, region);
+
+  Stopwatch stopwatch;
+  for (unsigned long i = 0; i < options.operations; ++i) {
+    dictionary.clear();
+    uint64_t frame = addresses[i % kLookupCount];
+    if (frame < kStackBase + 32)
+      frame += 32;
+    if (frame + 16 > kStackBase + kStackSize)
+      frame -= 16;
+    dictionary["$ebp"] = frame;
+    dictionary["$esp"] = frame - 64;
+    dictionary["$eip"] = kModuleBase;
+    if (evaluator.Evaluate(kProgram, NULL))
+      ++result->hits;
+  }
+  result->seconds = stopwatch.ElapsedSeconds();
+  result->operations = options.operations;
+}
+
+// The STACK CFI rule sets GCC and Clang emit for x86-64 functions: at
+// entry, after pushing %rbp, with %rbp as the frame pointer, and after
+// saving %rbx and %r12 as well.
+const char *const kAMD64RuleSets[] = {
+  ".cfa: $rsp 8 + .ra: .cfa -8 + ^",
+  ".cfa: $rsp 16 + .ra: .cfa -8 + ^ $rbp: .cfa -16 + ^",
+  ".cfa: $rbp 16 + .ra: .cfa -8 + ^ $rbp: .cfa -16 + ^",
+  ".cfa: $rbp 16 + .ra: .cfa -8 + ^ $rbp: .cfa -16 + ^ "
+      "$rbx: .cfa -24 + ^ $r12: .cfa -32 + ^",
+};
+const size_t kAMD64RuleSetCount =
+    sizeof(kAMD64RuleSets) / sizeof(kAMD64RuleSets[0]);
+
+// The callee frame's registers for the CFI benchmarks.
+const char *const kAMD64RegisterNames[] = {
+  "$rax", "$rdx", "$rcx", "$rbx", "$rsi", "$rdi", "$rbp", "$rsp",
+  "$r8",  "$r9",  "$r10", "$r11", "$r12", "$r13", "$r14", "$r15",
+  "$rip",
+};
+const int kAMD64RegisterCount =
+    sizeof(kAMD64RegisterNames) / sizeof(kAMD64RegisterNames[0]);
+const int kAMD64RBP = 6;
+const int kAMD64RSP = 7;
+
+// Parses kAMD64RuleSets into |frame_infos|.
+bool ParseAMD64RuleSets(vector<CFIFrameInfo> *frame_infos) {
+  frame_infos->resize(kAMD64RuleSetCount);
+  for (size_t i = 0; i < kAMD64RuleSetCount; ++i) {
+    CFIFrameInfoParseHandler handler(&(*frame_infos)[i]);
+    CFIRuleParser parser(&handler);
+    if (!parser.Parse(kAMD64RuleSets[i])) {
+      BPLOG(ERROR) << "Couldn't parse CFI rules: " << kAMD64RuleSets[i];
+      return false;
+    }
+  }
+  return true;
+}
+
+// Recovers the caller's registers with the name-keyed interface.
+void BenchmarkCFIRegisterMap(const BenchmarkOptions &options,
+                             BenchmarkResult *result) {
+  StackDump stack_dump(options);
+  MinidumpMemoryRegion *region = stack_dump.region();
+  vector<CFIFrameInfo> frame_infos;
+  if (!region || !ParseAMD64RuleSets(&frame_infos))
+    return;
+  vector<uint64_t> addresses = StackAddresses(options);
+
+  CFIFrameInfo::RegisterValueMap<uint64_t> registers;
+  for (int i = 0; i < kAMD64RegisterCount; ++i)
+    registers[kAMD64RegisterNames[i]] = i;
+  CFIFrameInfo::RegisterValueMap<uint64_t> caller_registers;
+
+  Stopwatch stopwatch;
+  for (unsigned long i = 0; i < options.operations; ++i) {
+    uint64_t frame = addresses[i % kLookupCount];
+    if (frame + 64 > kStackBase + kStackSize)
+      frame -= 64;
+    registers["$rsp"] = frame;
+    registers["$rbp"] = frame + 32;
+    caller_registers.clear();
+    if (frame_infos[i % kAMD64RuleSetCount].FindCallerRegs(
+            registers, *region, &caller_registers)) {
+      ++result->hits;
+    }
+  }
+  result->seconds = stopwatch.ElapsedSeconds();
+  result->operations = options.operations;
+}
+
+// Recovers the caller's registers with the numbered interface that the
+// stack walkers use.
+void BenchmarkCFIRegisterFile(const BenchmarkOptions &options,
+                              BenchmarkResult *result) {
+  StackDump stack_dump(options);
+  MinidumpMemoryRegion *region = stack_dump.region();
+  vector<CFIFrameInfo> frame_infos;
+  if (!region || !ParseAMD64RuleSets(&frame_infos))
+    return;
+  vector<uint64_t> addresses = StackAddresses(options);
+
+  CFIFrameInfo::RegisterFile<uint64_t> registers;
+  for (int i = 0; i < kAMD64RegisterCount; ++i)
+    registers.Set(i, i);
+  CFIFrameInfo::RegisterFile<uint64_t> caller_registers;
+
+  Stopwatch stopwatch;
+  for (unsigned long i = 0; i < options.operations; ++i) {
+    uint64_t frame = addresses[i % kLookupCount];
+    if (frame + 64 > kStackBase + kStackSize)
+      frame -= 64;
+    registers.Set(kAMD64RSP, frame);
+    registers.Set(kAMD64RBP, frame + 32);
+    caller_registers.Clear();
+    uint64_t caller_cfa, caller_ra;
+    if (frame_infos[i % kAMD64RuleSetCount].FindCallerRegs(
+            kAMD64RegisterNames, kAMD64RegisterCount, registers, *region,
+            &caller_registers, &caller_cfa, &caller_ra)) {
+      ++result->hits;
+    }
+  }
+  result->seconds = stopwatch.ElapsedSeconds();
+  result->operations = options.operations;
+}
+
+// Generates a symbol file for the module, with the records dump_syms
+// writes for a typical C++ library: source files, functions with a line
+// record for every few bytes, PUBLIC records and STACK CFI records.
+string ModuleSymbols(Random *random, const vector<Function> &functions,
+                     unsigned long *record_count) {
+  const int kFileCount = 500;
+  string symbols = "MODULE Linux x86_64 0123456789ABCDEF0123456789ABCDEF0 "
+                   "libbenchmark.so\n";
+  char line[256];
+  for (int i = 0; i < kFileCount; ++i) {
+    snprintf(line, sizeof(line),
+             "FILE %d /build/src/benchmark/component%d/source_file%d.cc\n",
+             i, i % 37, i);
+    symbols += line;
+  }
+  *record_count = kFileCount + 1;
+  for (size_t i = 0; i < functions.size(); ++i) {
+    uint64_t rva = functions[i].base - kModuleBase;
+    uint64_t size = functions[i].size;
+    snprintf(line, sizeof(line),
+             "FUNC %llx %llx 0 benchmark::component%lu::Class%lu::"
+             "Method%lu(int, char const*, std::string const&)\n",
+             static_cast<unsigned long long>(rva),
+             static_cast<unsigned long long>(size),
+             static_cast<unsigned long>(i % 37),
+             static_cast<unsigned long>(i % 1009),
+             static_cast<unsigned long>(i));
+    symbols += line;
+    ++*record_count;
+    int file = random->Below(kFileCount);
+    unsigned long source_line = 1 + random->Below(2000);
+    for (uint64_t offset = 0; offset < size;) {
+      uint64_t length = 4 + random->Below(32);
+      if (offset + length > size)
+        length = size - offset;
+      snprintf(line, sizeof(line), "%llx %llx %lu %d\n",
+               static_cast<unsigned long long>(rva + offset),
+               static_cast<unsigned long long>(length), source_line, file);
+      symbols += line;
+      ++*record_count;
+      offset += length;
+      source_line += random->Below(3);
+    }
+  }
+  for (size_t i = 0; i < functions.size(); i += 10) {
+    snprintf(line, sizeof(line), "PUBLIC %llx 0 benchmark_export_%lu\n",
+             static_cast<unsigned long long>(functions[i].base - kModuleBase),
+             static_cast<unsigned long>(i));
+    symbols += line;
+    ++*record_count;
+  }
+  for (size_t i = 0; i < functions.size(); ++i) {
+    uint64_t rva = functions[i].base - kModuleBase;
+    snprintf(line, sizeof(line),
+             "STACK CFI INIT %llx %llx .cfa: $rsp 8 + .ra: .cfa -8 + ^\n",
+             static_cast<unsigned long long>(rva),
+             static_cast<unsigned long long>(functions[i].size));
+    symbols += line;
+    ++*record_count;
+    if (functions[i].size < 8)
+      continue;
+    snprintf(line, sizeof(line),
+             "STACK CFI %llx .cfa: $rsp 16 + $rbp: .cfa -16 + ^\n"
+             "STACK CFI %llx .cfa: $rbp 16 +\n",
+             static_cast<unsigned long long>(rva + 1),
+             static_cast<unsigned long long>(rva + 4));
+    symbols += line;
+    *record_count += 2;
+  }
+  return symbols;
+}
+
+// Splits symbol file records into fields, as the symbol parsers do.
+void BenchmarkTokenize(const BenchmarkOptions &options,
+                       BenchmarkResult *result) {
+  ModuleData data(options);
+  unsigned long record_count;
+  string symbols = ModuleSymbols(&data.random, data.functions, &record_count);
+
+  // Tokenize modifies the line, so each one is copied into a buffer first,
+  // as a parser reading the symbol file would.
+  vector<string> lines;
+  for (size_t start = 0; start < symbols.size() && lines.size() < kLookupCount;
+       ) {
+    size_t end = symbols.find('\n', start);
+    if (end == string::npos)
+      break;
+    string line = symbols.substr(start, end - start);
+    if (line.compare(0, 5, "FUNC ") == 0)
+      lines.push_back(line.substr(5));
+    else if (isxdigit(line[0]) && line.compare(0, 5, "FILE ") != 0)
+      lines.push_back(line);
+    start = end + 1;
+  }
+  if (lines.empty())
+    return;
+
+  char buffer[512];
+  vector<char*> tokens;
+  Stopwatch stopwatch;
+  for (unsigned long i = 0; i < options.operations; ++i) {
+    const string &line = lines[i % lines.size()];
+    memcpy(buffer, line.c_str(), line.size() + 1);
+    // FUNC records have four fields after the keyword, as line records do.
+    if (google_breakpad::Tokenize(buffer, " \r\n", 4, &tokens))
+      ++result->hits;
+  }
+  result->seconds = stopwatch.ElapsedSeconds();
+  result->operations = options.operations;
+}
+
+// Parses and stores a whole symbol file; one operation is one record.
+void BenchmarkSymbolParse(const BenchmarkOptions &options,
+                          BenchmarkResult *result) {
+  ModuleData data(options);
+  unsigned long record_count;
+  string symbols = ModuleSymbols(&data.random, data.functions, &record_count);
+  BasicCodeModule module(kModuleBase, 0x10000000, "libbenchmark.so", "",
+                         "libbenchmark.so",
+                         "0123456789ABCDEF0123456789ABCDEF0", "");
+
+  unsigned long loads = options.operations / record_count;
+  if (loads == 0)
+    loads = 1;
+  Stopwatch stopwatch;
+  for (unsigned long i = 0; i < loads; ++i) {
+    BasicSourceLineResolver resolver;
+    if (resolver.LoadModuleUsingMapBuffer(&module, symbols))
+      ++result->hits;
+  }
+  result->seconds = stopwatch.ElapsedSeconds();
+  result->operations = loads * record_count;
+}
+
+struct Benchmark {
+  const char *name;
+  void (*run)(const BenchmarkOptions &options, BenchmarkResult *result);
+};
+
+const Benchmark kBenchmarks[] = {
+  { "range_map/retrieve", BenchmarkRangeMapTree },
+  { "range_map/retrieve_frozen", BenchmarkRangeMapFrozen },
+  { "range_map/retrieve_ranges", BenchmarkRangeMapBatch },
+  { "contained_range_map/retrieve", BenchmarkContainedRangeMapTree },
+  { "contained_range_map/retrieve_frozen", BenchmarkContainedRangeMapFrozen },
+  { "static_range_map/retrieve", BenchmarkStaticRangeMap },
+  { "static_map/upper_bound", BenchmarkStaticMap },
+  { "address_map/retrieve", BenchmarkAddressMap },
+  { "postfix_evaluator/stack_win_program", BenchmarkPostfixEvaluator },
+  { "cfi_frame_info/find_caller_regs_map", BenchmarkCFIRegisterMap },
+  { "cfi_frame_info/find_caller_regs_file", BenchmarkCFIRegisterFile },
+  { "tokenize/symbol_records", BenchmarkTokenize },
+  { "basic_source_line_resolver/parse_record", BenchmarkSymbolParse },
+  { "minidump_memory_region/get_memory_at_address", BenchmarkMemoryRegion },
+};
+const size_t kBenchmarkCount = sizeof(kBenchmarks) / sizeof(kBenchmarks[0]);
+
+// Whether the benchmark |name| was asked for by the |count| prefixes in
+// |prefixes|; all are when there are none.
+bool Selected(const char *name, char **prefixes, int count) {
+  if (count == 0)
+    return true;
+  for (int i = 0; i < count; ++i) {
+    if (strncmp(name, prefixes[i], strlen(prefixes[i])) == 0)
+      return true;
+  }
+  return false;
+}
+
+void usage(const char *program_name) {
+  BenchmarkOptions defaults;
+  fprintf(stderr, "usage: %s [-n operations] [-s seed] [benchmark ...]\n"
+          "    -n : Operations timed in each benchmark (default %lu)\n"
+          "    -s : Seed for the generated inputs (default %lu)\n"
+          "Runs the benchmarks whose names start with one of the given "
+          "prefixes, or all\nof them:\n",
+          program_name, defaults.operations, defaults.seed);
+  for (size_t i = 0; i < kBenchmarkCount; ++i)
+    fprintf(stderr, "    %s\n", kBenchmarks[i].name);
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+  BPLOG_INIT(&argc, &argv);
+
+  BenchmarkOptions options;
+  int ch;
+  while ((ch = getopt(argc, argv, "hn:s:")) != -1) {
+    bool valid;
+    switch (ch) {
+      case 'n':
+        valid = ParseCount('n', optarg, 1, 1000000000, &options.operations);
+        break;
+      case 's':
+        valid = ParseCount('s', optarg, 0, 0xffffffffUL, &options.seed);
+        break;
+      default:
+        usage(argv[0]);
+        return 1;
+    }
+    if (!valid)
+      return 1;
+  }
+
+  bool ran = false;
+  for (size_t i = 0; i < kBenchmarkCount; ++i) {
+    const Benchmark &benchmark = kBenchmarks[i];
+    if (!Selected(benchmark.name, argv + optind, argc - optind))
+      continue;
+    ran = true;
+    BenchmarkResult result;
+    benchmark.run(options, &result);
+    if (result.operations == 0) {
+      fprintf(stderr, "%s failed\n", benchmark.name);
+      return 1;
+    }
+    printf("%-44s %10.1f ns/op  %lu ops, %lu hits\n", benchmark.name,
+           result.seconds * 1e9 / result.operations, result.operations,
+           result.hits);
+    fflush(stdout);
+  }
+  if (!ran) {
+    usage(argv[0]);
+    return 1;
+  }
+  return 0;
+}
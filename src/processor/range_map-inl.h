@@ -39,6 +39,8 @@
 
 #include <assert.h>
 
+#include <algorithm>
+
 #include "processor/range_map.h"
 #include "processor/logging.h"
 
@@ -63,6 +65,16 @@ bool RangeMap<AddressType, EntryType>::StoreRange(const AddressType &base,
     return false;
   }
 
+  // Symbol files list their ranges in address order, so a new range usually
+  // lies above every range already stored.  That takes a single comparison
+  // to check, and the range can then be appended at the end of the map
+  // without searching it, so that loading sorted ranges is linear overall.
+  if (map_.empty() || base > map_.rbegin()->first) {
+    Thaw();
+    map_.insert(map_.end(), MapValue(high, Range(base, entry)));
+    return true;
+  }
+
   // Ensure that this range does not overlap with another one already in the
   // map.
   MapConstIterator iterator_base = map_.lower_bound(base);
@@ -107,6 +119,8 @@ bool RangeMap<AddressType, EntryType>::StoreRange(const AddressType &base,
     }
   }
 
+  Thaw();
+
   // Store the range in the map by its high address, so that lower_bound can
   // be used to quickly locate a range by address.
   map_.insert(MapValue(high, Range(base, entry)));
@@ -121,6 +135,19 @@ bool RangeMap<AddressType, EntryType>::RetrieveRange(
   BPLOG_IF(ERROR, !entry) << "RangeMap::RetrieveRange requires |entry|";
   assert(entry);
 
+  if (frozen_) {
+    size_t index = LoadLastHit();
+    if (index >= frozen_highs_.size() ||
+        address < frozen_bases_[index] || address > frozen_highs_[index]) {
+      index = FrozenLowerBound(address);
+      if (index == frozen_highs_.size() || address < frozen_bases_[index])
+        return false;
+      StoreLastHit(index);
+    }
+    GetFrozenRange(index, entry, entry_base, entry_size);
+    return true;
+  }
+
   MapConstIterator iterator = map_.lower_bound(address);
   if (iterator == map_.end())
     return false;
@@ -143,6 +170,53 @@ bool RangeMap<AddressType, EntryType>::RetrieveRange(
 }
 
 
+template<typename AddressType, typename EntryType>
+class RangeMap<AddressType, EntryType>::AddressIndexLess {
+ public:
+  explicit AddressIndexLess(const AddressType *addresses)
+      : addresses_(addresses) {}
+
+  bool operator()(size_t a, size_t b) const {
+    return addresses_[a] < addresses_[b];
+  }
+
+ private:
+  const AddressType *addresses_;
+};
+
+
+template<typename AddressType, typename EntryType>
+void RangeMap<AddressType, EntryType>::RetrieveRanges(
+    const AddressType *addresses, size_t count,
+    const EntryType &not_found, EntryType *entries) const {
+  std::vector<size_t> order(count);
+  for (size_t i = 0; i < count; ++i)
+    order[i] = i;
+  std::sort(order.begin(), order.end(), AddressIndexLess(addresses));
+
+  // The range that answered the previous address.  Starting it out empty
+  // (base above high) forces a lookup for the first address.
+  AddressType base = 1;
+  AddressType high = 0;
+  EntryType entry = not_found;
+  for (size_t i = 0; i < count; ++i) {
+    const AddressType &address = addresses[order[i]];
+    if (address < base || address > high) {
+      AddressType size;
+      if (RetrieveRange(address, &entry, &base, &size)) {
+        high = base + (size - 1);
+      } else {
+        // Remember the miss only for this address, so that duplicates of
+        // it are answered without another search.
+        entry = not_found;
+        base = high = address;
+      }
+    }
+    entries[order[i]] = entry;
+  }
+}
+
+
 template<typename AddressType, typename EntryType>
 bool RangeMap<AddressType, EntryType>::RetrieveNearestRange(
     const AddressType &address, EntryType *entry,
@@ -154,6 +228,17 @@ bool RangeMap<AddressType, EntryType>::RetrieveNearestRange(
   if (RetrieveRange(address, entry, entry_base, entry_size))
     return true;
 
+  if (frozen_) {
+    // RetrieveRange failed, so the range at FrozenLowerBound, if any, lies
+    // entirely above address, and the one before it is the nearest lower
+    // range.
+    size_t index = FrozenLowerBound(address);
+    if (index == 0)
+      return false;
+    GetFrozenRange(index - 1, entry, entry_base, entry_size);
+    return true;
+  }
+
   // upper_bound gives the first element whose key is greater than address,
   // but we want the first element whose key is less than or equal to address.
   // Decrement the iterator to get there, but not if the upper_bound already
@@ -186,6 +271,12 @@ bool RangeMap<AddressType, EntryType>::RetrieveRangeAtIndex(
     return false;
   }
 
+  if (frozen_) {
+    // Match the tree walk below, which treats a negative index as 0.
+    GetFrozenRange(index < 0 ? 0 : index, entry, entry_base, entry_size);
+    return true;
+  }
+
   // Walk through the map.  Although it's ordered, it's not a vector, so it
   // can't be addressed directly by index.
   MapConstIterator iterator = map_.begin();
@@ -211,6 +302,94 @@ int RangeMap<AddressType, EntryType>::GetCount() const {
 template<typename AddressType, typename EntryType>
 void RangeMap<AddressType, EntryType>::Clear() {
   map_.clear();
+  frozen_highs_.clear();
+  frozen_bases_.clear();
+  frozen_entries_.clear();
+  frozen_ = false;
+  last_hit_ = 0;
+}
+
+
+template<typename AddressType, typename EntryType>
+void RangeMap<AddressType, EntryType>::Thaw() {
+  if (frozen_) {
+    frozen_highs_.clear();
+    frozen_bases_.clear();
+    frozen_entries_.clear();
+    frozen_ = false;
+  }
+}
+
+
+template<typename AddressType, typename EntryType>
+void RangeMap<AddressType, EntryType>::Freeze() {
+  frozen_highs_.clear();
+  frozen_bases_.clear();
+  frozen_entries_.clear();
+  frozen_highs_.reserve(map_.size());
+  frozen_bases_.reserve(map_.size());
+  frozen_entries_.reserve(map_.size());
+  for (MapConstIterator iterator = map_.begin(); iterator != map_.end();
+       ++iterator) {
+    frozen_highs_.push_back(iterator->first);
+    frozen_bases_.push_back(iterator->second.base());
+    frozen_entries_.push_back(iterator->second.entry());
+  }
+  frozen_ = true;
+  last_hit_ = 0;
+}
+
+
+template<typename AddressType, typename EntryType>
+size_t RangeMap<AddressType, EntryType>::LoadLastHit() const {
+#if defined(__GNUC__)
+  return __atomic_load_n(&last_hit_, __ATOMIC_RELAXED);
+#else
+  return last_hit_;
+#endif
+}
+
+
+template<typename AddressType, typename EntryType>
+void RangeMap<AddressType, EntryType>::StoreLastHit(size_t index) const {
+#if defined(__GNUC__)
+  __atomic_store_n(&last_hit_, index, __ATOMIC_RELAXED);
+#else
+  last_hit_ = index;
+#endif
+}
+
+
+template<typename AddressType, typename EntryType>
+size_t RangeMap<AddressType, EntryType>::FrozenLowerBound(
+    const AddressType &address) const {
+  size_t count = frozen_highs_.size();
+  if (count == 0)
+    return 0;
+
+  // Halve the candidate window on every step without branching on the
+  // comparison, so the loop runs a fixed log2(count) times and the compiler
+  // can use a conditional move instead of a mispredicted jump.
+  const AddressType *first = &frozen_highs_[0];
+  const AddressType *base = first;
+  while (count > 1) {
+    size_t half = count / 2;
+    base = (base[half] < address) ? base + half : base;
+    count -= half;
+  }
+  return (base - first) + (*base < address);
+}
+
+
+template<typename AddressType, typename EntryType>
+void RangeMap<AddressType, EntryType>::GetFrozenRange(
+    size_t index, EntryType *entry,
+    AddressType *entry_base, AddressType *entry_size) const {
+  *entry = frozen_entries_[index];
+  if (entry_base)
+    *entry_base = frozen_bases_[index];
+  if (entry_size)
+    *entry_size = frozen_highs_[index] - frozen_bases_[index] + 1;
 }
 
 
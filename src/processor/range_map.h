@@ -42,6 +42,7 @@
 
 
 #include <map>
+#include <vector>
 
 
 namespace google_breakpad {
@@ -52,7 +53,7 @@ template<class, class> class RangeMapSerializer;
 template<typename AddressType, typename EntryType>
 class RangeMap {
  public:
-  RangeMap() : map_() {}
+  RangeMap() : map_(), frozen_(false), last_hit_(0) {}
 
   // Inserts a range into the map.  Returns false for a parameter error,
   // or if the location of the range would conflict with a range already
@@ -67,6 +68,15 @@ class RangeMap {
   bool RetrieveRange(const AddressType &address, EntryType *entry,
                      AddressType *entry_base, AddressType *entry_size) const;
 
+  // Locates the ranges encompassing each of |count| addresses at once,
+  // storing the entry for addresses[i] in entries[i], or |not_found| if no
+  // range encompasses that address.  The addresses are visited in ascending
+  // order, so a run of them that falls in one range costs a single search.
+  // This is cheaper than calling RetrieveRange in a loop when the addresses
+  // cluster, as the words examined by a stack scan do.
+  void RetrieveRanges(const AddressType *addresses, size_t count,
+                      const EntryType &not_found, EntryType *entries) const;
+
   // Locates the range encompassing the supplied address, if one exists.
   // If no range encompasses the supplied address, locates the nearest range
   // to the supplied address that is lower than the address.  Returns false
@@ -94,6 +104,19 @@ class RangeMap {
   // initially created.
   void Clear();
 
+  // Copies the stored ranges into sorted arrays, which the Retrieve*
+  // methods then search instead of the tree.  The arrays are contiguous
+  // and searched without data-dependent branches, which is considerably
+  // faster for maps that are filled once and then queried heavily, such
+  // as a dump's module and memory lists.  RetrieveRangeAtIndex becomes a
+  // constant-time operation.  Storing a range or clearing the map discards
+  // the arrays, and lookups go back to the tree until Freeze is called
+  // again.  While frozen, RetrieveRange first checks the range that
+  // satisfied the previous lookup, since consecutive lookups tend to land
+  // in the same range.
+  void Freeze();
+  bool frozen() const { return frozen_; }
+
  private:
   // Friend declarations.
   friend class ModuleComparer;
@@ -121,8 +144,38 @@ class RangeMap {
   typedef typename AddressToRangeMap::const_iterator MapConstIterator;
   typedef typename AddressToRangeMap::value_type MapValue;
 
+  // Discards the frozen copy, which storing a range makes out of date.
+  void Thaw();
+
+  // Returns the index of the first frozen range whose high address is not
+  // below |address|, or the number of frozen ranges if there is none.
+  size_t FrozenLowerBound(const AddressType &address) const;
+
+  // Orders indices into an address array by the addresses they refer to.
+  class AddressIndexLess;
+
+  // Read and update last_hit_.  Threads sharing a map may race to update
+  // it, so these use relaxed atomic accesses where the compiler offers them.
+  size_t LoadLastHit() const;
+  void StoreLastHit(size_t index) const;
+
+  // Fills in the Retrieve* out-parameters from frozen range |index|.
+  void GetFrozenRange(size_t index, EntryType *entry,
+                      AddressType *entry_base, AddressType *entry_size) const;
+
   // Maps the high address of each range to a EntryType.
   AddressToRangeMap map_;
+
+  // The contents of map_ in address order, kept as parallel arrays so that
+  // the search only touches frozen_highs_.  Valid when frozen_ is true.
+  std::vector<AddressType> frozen_highs_;
+  std::vector<AddressType> frozen_bases_;
+  std::vector<EntryType> frozen_entries_;
+  bool frozen_;
+
+  // The index of the frozen range that most recently satisfied
+  // RetrieveRange.  It is only a hint, and is validated before use.
+  mutable size_t last_hit_;
 };
 
 
@@ -363,6 +363,87 @@ static bool RetriveAtIndexTest2() {
 
 
 // RunTests runs a series of test sets.
+// Checks that RetrieveRanges agrees with RetrieveRange for unsorted
+// addresses, including repeats and addresses that fall between ranges,
+// whether or not the map is frozen.
+static bool RetrieveRangesTest() {
+  scoped_ptr<TestMap> range_map(new TestMap());
+
+  // Store ranges [10 * object_id, 10 * object_id + 3]:
+  for (int object_id = 0; object_id < 10; ++object_id) {
+    linked_ptr<CountedObject> object(new CountedObject(object_id));
+    range_map->StoreRange(10 * object_id, 4, object);
+  }
+
+  const AddressType addresses[] = {
+    93, 0, 3, 4, 55, 52, 52, 9, 100, 21, -1, 53, 4, 90
+  };
+  const size_t address_count = sizeof(addresses) / sizeof(addresses[0]);
+
+  for (int pass = 0; pass < 2; ++pass) {
+    if (pass == 1)
+      range_map->Freeze();
+
+    linked_ptr<CountedObject> entries[address_count];
+    range_map->RetrieveRanges(addresses, address_count,
+                              linked_ptr<CountedObject>(), entries);
+    for (size_t i = 0; i < address_count; ++i) {
+      linked_ptr<CountedObject> expected;
+      range_map->RetrieveRange(addresses[i], &expected, NULL, NULL);
+      if (entries[i].get() != expected.get()) {
+        fprintf(stderr, "FAILED: RetrieveRangesTest pass %d address %d, "
+                "expected %d, observed %d\n",
+                pass, addresses[i],
+                expected.get() ? expected->id() : -1,
+                entries[i].get() ? entries[i]->id() : -1);
+        return false;
+      }
+    }
+  }
+
+  return true;
+}
+
+
+// Checks that ranges stored in address order, which StoreRange appends
+// without searching the map, are still checked against the last range, and
+// that they discard a frozen copy.
+static bool SortedStoreTest() {
+  TestMap range_map;
+  for (int object_id = 0; object_id < 10; ++object_id) {
+    linked_ptr<CountedObject> object(new CountedObject(object_id));
+    if (!range_map.StoreRange(10 * object_id, 5, object)) {
+      fprintf(stderr, "FAILED: SortedStoreTest could not store %d\n",
+              object_id);
+      return false;
+    }
+  }
+  range_map.Freeze();
+
+  linked_ptr<CountedObject> object(new CountedObject(10));
+  if (range_map.StoreRange(94, 10, object) ||    // overlaps the last range
+      range_map.StoreRange(90, 5, object) ||     // equals the last range
+      !range_map.StoreRange(95, 5, object) ||    // adjacent to it
+      !range_map.StoreRange(45, 5, object) ||    // in an earlier gap
+      range_map.frozen() ||
+      range_map.GetCount() != 12) {
+    fprintf(stderr, "FAILED: SortedStoreTest\n");
+    return false;
+  }
+
+  linked_ptr<CountedObject> found;
+  if (!range_map.RetrieveRange(99, &found, NULL, NULL) ||
+      found->id() != 10 ||
+      !range_map.RetrieveRange(94, &found, NULL, NULL) ||
+      found->id() != 9) {
+    fprintf(stderr, "FAILED: SortedStoreTest retrieve\n");
+    return false;
+  }
+
+  return true;
+}
+
+
 static bool RunTests() {
   // These tests will be run sequentially.  The first set of tests exercises
   // most functions of RangeTest, and verifies all of the bounds-checking.
@@ -510,6 +591,19 @@ static bool RunTests() {
         return false;
     }
 
+    if (!RetrieveIndexTest(range_map.get(), range_test_set_index))
+      return false;
+
+    // Repeat the retrieval tests against the frozen form of the map.
+    range_map->Freeze();
+    for (unsigned int range_test_index = 0;
+         range_test_index < range_test_count;
+         ++range_test_index) {
+      const RangeTest *range_test = &range_tests[range_test_index];
+      if (!RetrieveTest(range_map.get(), range_test))
+        return false;
+    }
+
     if (!RetrieveIndexTest(range_map.get(), range_test_set_index))
       return false;
 
@@ -538,6 +632,16 @@ static bool RunTests() {
     return false;
   }
 
+  if (!RetrieveRangesTest()) {
+    fprintf(stderr, "FAILED: did not pass RetrieveRangesTest()\n");
+    return false;
+  }
+
+  if (!SortedStoreTest()) {
+    fprintf(stderr, "FAILED: did not pass SortedStoreTest()\n");
+    return false;
+  }
+
   return true;
 }
 
@@ -0,0 +1,364 @@
+// Copyright (c) 2016 Google Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+// notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above
+// copyright notice, this list of conditions and the following disclaimer
+// in the documentation and/or other materials provided with the
+// distribution.
+//     * Neither the name of Google Inc. nor the names of its
+// contributors may be used to endorse or promote products derived from
+// this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+// serialize_symbol_store.cc: Convert a tree of text symbol files into the
+// serialized form that FastSourceLineResolver loads in place.
+//
+// Every file ending in .sym under the symbol store is parsed and written
+// back out by ModuleSerializer under the same relative path with .fast
+// appended, so that a store laid out for SimpleSymbolSupplier gains the
+// .sym.fast files that SimpleSymbolSupplier::GetMappableSymbolFile looks
+// for.  Files are converted in parallel, and each output file is written
+// under a temporary name and renamed into place, so a processor never maps
+// a partially written file.
+//
+// With -x, a SymbolFileIndex is written for each symbol file instead, with
+// .idx appended, so that resolvers can load the symbol file on demand.
+// Indexes are only used next to their symbol files.
+//
+// With -z, serialized files are written compressed in independently
+// decompressible blocks, which FastSourceLineResolver expands one map at a
+// time as lookups need them.
+
+#include <errno.h>
+#include <dirent.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+#include <string>
+#include <vector>
+
+#include "common/scoped_ptr.h"
+#include "common/using_std_string.h"
+#include "google_breakpad/processor/source_line_resolver_base.h"
+#include "processor/logging.h"
+#include "processor/module_serializer.h"
+#include "processor/symbol_file_index.h"
+
+namespace {
+
+using google_breakpad::ModuleSerializer;
+using google_breakpad::scoped_array;
+using google_breakpad::SourceLineResolverBase;
+using google_breakpad::SymbolFileIndex;
+using std::vector;
+
+const char kSymbolExtension[] = ".sym";
+const char kSerializedExtension[] = ".fast";
+const char kIndexExtension[] = ".idx";
+
+// A symbol file to convert, relative to the input and output roots.
+struct ConversionJob {
+  string input_path;
+  string output_path;
+};
+
+// State shared by the converter threads.  Each thread takes the next
+// unclaimed job until none remain.
+struct ConversionQueue {
+  const vector<ConversionJob>* jobs;
+  bool incremental;
+  bool build_indexes;
+  bool compress;
+  size_t next_job;
+  int converted;
+  int up_to_date;
+  int failed;
+  pthread_mutex_t mutex;
+};
+
+bool EndsWith(const string& s, const char* suffix) {
+  size_t suffix_length = strlen(suffix);
+  return s.size() > suffix_length &&
+         s.compare(s.size() - suffix_length, suffix_length, suffix) == 0;
+}
+
+// Adds a job for every symbol file under |input_dir|, to be written under
+// |output_dir| with |output_extension| appended.
+void FindSymbolFiles(const string& input_dir, const string& output_dir,
+                     const char* output_extension,
+                     vector<ConversionJob>* jobs) {
+  DIR* dir = opendir(input_dir.c_str());
+  if (!dir) {
+    BPLOG(ERROR) << "Could not open directory " << input_dir << ": "
+                 << strerror(errno);
+    return;
+  }
+
+  vector<string> entries;
+  struct dirent* entry;
+  while ((entry = readdir(dir)) != NULL) {
+    if (strcmp(entry->d_name, ".") != 0 && strcmp(entry->d_name, "..") != 0)
+      entries.push_back(entry->d_name);
+  }
+  closedir(dir);
+
+  for (size_t i = 0; i < entries.size(); ++i) {
+    string input_path = input_dir + "/" + entries[i];
+    string output_path = output_dir + "/" + entries[i];
+    struct stat st;
+    if (stat(input_path.c_str(), &st) != 0)
+      continue;
+    if (S_ISDIR(st.st_mode)) {
+      FindSymbolFiles(input_path, output_path, output_extension, jobs);
+    } else if (S_ISREG(st.st_mode) && EndsWith(entries[i], kSymbolExtension)) {
+      ConversionJob job;
+      job.input_path = input_path;
+      job.output_path = output_path + output_extension;
+      jobs->push_back(job);
+    }
+  }
+}
+
+// Creates the directory that will hold |path|, and any missing parents.
+bool MakeParentDirectories(const string& path) {
+  size_t slash = path.find('/', 1);
+  while (slash != string::npos) {
+    string dir = path.substr(0, slash);
+    if (mkdir(dir.c_str(), 0777) != 0 && errno != EEXIST) {
+      BPLOG(ERROR) << "Could not create directory " << dir << ": "
+                   << strerror(errno);
+      return false;
+    }
+    slash = path.find('/', slash + 1);
+  }
+  return true;
+}
+
+// Returns true if the output file for |job| is at least as new as the
+// symbol file it came from.
+bool IsUpToDate(const ConversionJob& job) {
+  struct stat input_stat, output_stat;
+  if (stat(job.input_path.c_str(), &input_stat) != 0 ||
+      stat(job.output_path.c_str(), &output_stat) != 0) {
+    return false;
+  }
+  return output_stat.st_mtime >= input_stat.st_mtime;
+}
+
+// Writes the |size| bytes at |data| to |path|, by way of a temporary file.
+bool WriteOutputFile(const string& path, const char* data, size_t size) {
+  if (!MakeParentDirectories(path))
+    return false;
+
+  string temp_path = path + ".XXXXXX";
+  scoped_array<char> temp_name(new char[temp_path.size() + 1]);
+  memcpy(temp_name.get(), temp_path.c_str(), temp_path.size() + 1);
+  int fd = mkstemp(temp_name.get());
+  if (fd == -1) {
+    BPLOG(ERROR) << "Could not create " << temp_path << ": "
+                 << strerror(errno);
+    return false;
+  }
+
+  bool written = true;
+  size_t remaining = size;
+  while (remaining > 0) {
+    ssize_t result = write(fd, data, remaining);
+    if (result < 0) {
+      if (errno == EINTR)
+        continue;
+      written = false;
+      break;
+    }
+    data += result;
+    remaining -= result;
+  }
+  if (close(fd) != 0)
+    written = false;
+  // mkstemp creates the file readable only by its owner, but the symbol
+  // store is usually shared.
+  chmod(temp_name.get(), 0644);
+
+  if (!written || rename(temp_name.get(), path.c_str()) != 0) {
+    BPLOG(ERROR) << "Could not write " << path << ": " << strerror(errno);
+    unlink(temp_name.get());
+    return false;
+  }
+  return true;
+}
+
+bool Convert(const ConversionJob& job, bool build_index, bool compress,
+             ModuleSerializer* serializer) {
+  char* symbol_data;
+  size_t symbol_data_size;
+  if (!SourceLineResolverBase::ReadSymbolFile(job.input_path, &symbol_data,
+                                              &symbol_data_size)) {
+    return false;
+  }
+  scoped_array<char> symbol_data_holder(symbol_data);
+
+  // ReadSymbolFile adds a null terminator, which isn't in the file.
+  if (build_index) {
+    string index;
+    SymbolFileIndex::Build(symbol_data, symbol_data_size - 1, &index);
+    symbol_data_holder.reset();
+    return WriteOutputFile(job.output_path, index.data(), index.size());
+  }
+
+  unsigned int serialized_size;
+  scoped_array<char> serialized(serializer->SerializeSymbolFileData(
+      symbol_data, symbol_data_size, &serialized_size));
+  symbol_data_holder.reset();
+  if (!serialized.get()) {
+    BPLOG(ERROR) << "Could not serialize " << job.input_path;
+    return false;
+  }
+  if (compress) {
+    serialized.reset(ModuleSerializer::CompressSerializedData(
+        serialized.get(), serialized_size, &serialized_size));
+    if (!serialized.get()) {
+      BPLOG(ERROR) << "Could not compress " << job.input_path;
+      return false;
+    }
+  }
+  return WriteOutputFile(job.output_path, serialized.get(), serialized_size);
+}
+
+void* ConversionThreadMain(void* arg) {
+  ConversionQueue* queue = static_cast<ConversionQueue*>(arg);
+  ModuleSerializer serializer;
+  while (true) {
+    pthread_mutex_lock(&queue->mutex);
+    size_t index = queue->next_job++;
+    pthread_mutex_unlock(&queue->mutex);
+    if (index >= queue->jobs->size())
+      break;
+
+    const ConversionJob& job = (*queue->jobs)[index];
+    int* counter;
+    if (queue->incremental && IsUpToDate(job)) {
+      counter = &queue->up_to_date;
+    } else if (Convert(job, queue->build_indexes, queue->compress,
+                       &serializer)) {
+      BPLOG(INFO) << "Wrote " << job.output_path;
+      counter = &queue->converted;
+    } else {
+      counter = &queue->failed;
+    }
+
+    pthread_mutex_lock(&queue->mutex);
+    ++*counter;
+    pthread_mutex_unlock(&queue->mutex);
+  }
+  return NULL;
+}
+
+void usage(const char* program_name) {
+  fprintf(stderr, "usage: %s [-i] [-x] [-z] [-j <threads>] <symbol-path> "
+          "[output-path]\n"
+          "    -i : Skip symbol files whose output is up to date\n"
+          "    -x : Write .sym.idx indexes instead of serialized files\n"
+          "    -z : Compress serialized files\n"
+          "    -j : Number of files to convert at once (default 1)\n"
+          "Output files are written alongside the symbol files, or in\n"
+          "the same layout under output-path.\n",
+          program_name);
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  BPLOG_INIT(&argc, &argv);
+
+  bool incremental = false;
+  bool build_indexes = false;
+  bool compress = false;
+  int thread_count = 1;
+  int argi = 1;
+  for (; argi < argc && argv[argi][0] == '-'; ++argi) {
+    if (strcmp(argv[argi], "-i") == 0) {
+      incremental = true;
+    } else if (strcmp(argv[argi], "-x") == 0) {
+      build_indexes = true;
+    } else if (strcmp(argv[argi], "-z") == 0) {
+      compress = true;
+    } else if (strcmp(argv[argi], "-j") == 0 && argi + 1 < argc) {
+      thread_count = atoi(argv[++argi]);
+      if (thread_count < 1) {
+        usage(argv[0]);
+        return 1;
+      }
+    } else {
+      usage(argv[0]);
+      return 1;
+    }
+  }
+  if (argc - argi < 1 || argc - argi > 2) {
+    usage(argv[0]);
+    return 1;
+  }
+
+  string input_root = argv[argi];
+  string output_root = argc - argi == 2 ? argv[argi + 1] : input_root;
+
+  vector<ConversionJob> jobs;
+  FindSymbolFiles(input_root, output_root,
+                  build_indexes ? kIndexExtension : kSerializedExtension,
+                  &jobs);
+
+  ConversionQueue queue;
+  queue.jobs = &jobs;
+  queue.incremental = incremental;
+  queue.build_indexes = build_indexes;
+  queue.compress = compress;
+  queue.next_job = 0;
+  queue.converted = 0;
+  queue.up_to_date = 0;
+  queue.failed = 0;
+  pthread_mutex_init(&queue.mutex, NULL);
+
+  if (static_cast<size_t>(thread_count) > jobs.size())
+    thread_count = jobs.size();
+  vector<pthread_t> threads;
+  for (int i = 1; i < thread_count; ++i) {
+    pthread_t thread;
+    if (pthread_create(&thread, NULL, ConversionThreadMain, &queue) != 0) {
+      BPLOG(ERROR) << "Could not create converter thread " << i;
+      break;
+    }
+    threads.push_back(thread);
+  }
+
+  // Help out, which also guarantees progress if no thread could be created.
+  ConversionThreadMain(&queue);
+
+  for (size_t i = 0; i < threads.size(); ++i)
+    pthread_join(threads[i], NULL);
+  pthread_mutex_destroy(&queue.mutex);
+
+  printf("%d converted, %d up to date, %d failed\n",
+         queue.converted, queue.up_to_date, queue.failed);
+  return queue.failed == 0 ? 0 : 1;
+}
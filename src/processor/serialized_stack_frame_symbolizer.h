@@ -0,0 +1,123 @@
+// Copyright (c) 2016 Google Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+// notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above
+// copyright notice, this list of conditions and the following disclaimer
+// in the documentation and/or other materials provided with the
+// distribution.
+//     * Neither the name of Google Inc. nor the names of its
+// contributors may be used to endorse or promote products derived from
+// this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+// serialized_stack_frame_symbolizer.h: SerializedStackFrameSymbolizer, which
+// lets several threads share a StackFrameSymbolizer that isn't thread-safe.
+//
+// Lookups in symbols that are already loaded, into a resolver that can look
+// them up concurrently (see SourceLineResolverInterface::
+// CanLookUpConcurrently), run at once under a shared lock.  Every other call,
+// including those that load symbols, holds the lock exclusively.  This keeps
+// any resolver and supplier, including user subclasses, safe without making
+// them thread-aware.  With a resolver that can't look up concurrently, such
+// as BasicSourceLineResolver, whose lookups copy linked_ptr objects, every
+// call runs on its own.
+
+#ifndef PROCESSOR_SERIALIZED_STACK_FRAME_SYMBOLIZER_H__
+#define PROCESSOR_SERIALIZED_STACK_FRAME_SYMBOLIZER_H__
+
+#include "google_breakpad/processor/stack_frame_symbolizer.h"
+#include "processor/mutex.h"
+
+namespace google_breakpad {
+
+class SerializedStackFrameSymbolizer : public StackFrameSymbolizer {
+ public:
+  // Does not take ownership of |symbolizer|, which must outlive this
+  // object.
+  explicit SerializedStackFrameSymbolizer(StackFrameSymbolizer* symbolizer)
+      : StackFrameSymbolizer(symbolizer->supplier(), symbolizer->resolver()),
+        symbolizer_(symbolizer) {
+  }
+
+  virtual SymbolizerResult FillSourceLineInfo(const CodeModules* modules,
+                                              const SystemInfo* system_info,
+                                              StackFrame* stack_frame) {
+    {
+      AutoReaderLock lock(&lock_);
+      SymbolizerResult result;
+      if (symbolizer_->FillLoadedSourceLineInfo(modules, stack_frame,
+                                                &result)) {
+        return result;
+      }
+    }
+    AutoWriterLock lock(&lock_);
+    return symbolizer_->FillSourceLineInfo(modules, system_info, stack_frame);
+  }
+
+  virtual bool IsInFunctionWithoutLoading(const CodeModule* module,
+                                          const SystemInfo* system_info,
+                                          uint64_t address,
+                                          bool* in_function) {
+    AutoWriterLock lock(&lock_);
+    return symbolizer_->IsInFunctionWithoutLoading(module, system_info,
+                                                   address, in_function);
+  }
+
+  virtual WindowsFrameInfo* FindWindowsFrameInfo(const StackFrame* frame) {
+    {
+      AutoReaderLock lock(&lock_);
+      WindowsFrameInfo* frame_info;
+      if (symbolizer_->FindLoadedWindowsFrameInfo(frame, &frame_info))
+        return frame_info;
+    }
+    AutoWriterLock lock(&lock_);
+    return symbolizer_->FindWindowsFrameInfo(frame);
+  }
+
+  virtual CFIFrameInfo* FindCFIFrameInfo(const StackFrame* frame) {
+    {
+      AutoReaderLock lock(&lock_);
+      CFIFrameInfo* cfi_frame_info;
+      if (symbolizer_->FindLoadedCFIFrameInfo(frame, &cfi_frame_info))
+        return cfi_frame_info;
+    }
+    AutoWriterLock lock(&lock_);
+    return symbolizer_->FindCFIFrameInfo(frame);
+  }
+
+  virtual void Reset() {
+    AutoWriterLock lock(&lock_);
+    symbolizer_->Reset();
+  }
+
+  virtual bool HasImplementation() {
+    AutoWriterLock lock(&lock_);
+    return symbolizer_->HasImplementation();
+  }
+
+ private:
+  StackFrameSymbolizer* symbolizer_;
+  ReaderWriterLock lock_;
+};
+
+}  // namespace google_breakpad
+
+#endif  // PROCESSOR_SERIALIZED_STACK_FRAME_SYMBOLIZER_H__
@@ -164,23 +164,8 @@ class SimpleSerializer<WindowsFrameInfo> {
   }
 };
 
-// Specializations of SimpleSerializer: Linked_ptr version of
-// Line, Function, PublicSymbol, WindowsFrameInfo.
-template<>
-class SimpleSerializer< linked_ptr<BasicSourceLineResolver::Line> > {
-  typedef BasicSourceLineResolver::Line Line;
- public:
-  static size_t SizeOf(const linked_ptr<Line> &lineptr) {
-    if (lineptr.get() == NULL) return 0;
-    return SimpleSerializer<Line>::SizeOf(*(lineptr.get()));
-  }
-  static char *Write(const linked_ptr<Line> &lineptr, char *dest) {
-    if (lineptr.get())
-      dest = SimpleSerializer<Line>::Write(*(lineptr.get()), dest);
-    return dest;
-  }
-};
-
+// Specializations of SimpleSerializer: Function, and linked_ptr versions of
+// Function, PublicSymbol, WindowsFrameInfo.
 template<>
 class SimpleSerializer<BasicSourceLineResolver::Function> {
   // Convenient type names.
@@ -193,7 +178,7 @@ class SimpleSerializer<BasicSourceLineResolver::Function> {
     size += SimpleSerializer<MemAddr>::SizeOf(func.address);
     size += SimpleSerializer<MemAddr>::SizeOf(func.size);
     size += SimpleSerializer<int32_t>::SizeOf(func.parameter_size);
-    size += range_map_serializer_.SizeOf(func.lines);
+    size += LinesSizeOf(func);
     return size;
   }
 
@@ -202,12 +187,43 @@ class SimpleSerializer<BasicSourceLineResolver::Function> {
     dest = SimpleSerializer<MemAddr>::Write(func.address, dest);
     dest = SimpleSerializer<MemAddr>::Write(func.size, dest);
     dest = SimpleSerializer<int32_t>::Write(func.parameter_size, dest);
-    dest = range_map_serializer_.Write(func.lines, dest);
+    dest = WriteLines(func, dest);
     return dest;
   }
+
  private:
-  // This static member is defined in module_serializer.cc.
-  static RangeMapSerializer< MemAddr, linked_ptr<Line> > range_map_serializer_;
+  // The function's lines are written the way RangeMapSerializer writes a
+  // RangeMap of them, which is what FastSourceLineResolver reads: a count,
+  // each node's offset, each line's high address, and then each line's
+  // base address and contents.
+  static size_t LinesSizeOf(const Function &func) {
+    size_t size = (1 + func.line_count) * sizeof(uint32_t);
+    for (size_t i = 0; i < func.line_count; ++i) {
+      const Line &line = (*func.line_table)[func.first_line + i];
+      size += 2 * SimpleSerializer<MemAddr>::SizeOf(line.address);
+      size += SimpleSerializer<Line>::SizeOf(line);
+    }
+    return size;
+  }
+
+  static char *WriteLines(const Function &func, char *dest) {
+    char *start_address = dest;
+    dest = SimpleSerializer<uint32_t>::Write(func.line_count, dest);
+    uint32_t *offsets = reinterpret_cast<uint32_t*>(dest);
+    dest += sizeof(uint32_t) * func.line_count;
+    char *key_address = dest;
+    dest += sizeof(MemAddr) * func.line_count;
+
+    for (size_t i = 0; i < func.line_count; ++i) {
+      const Line &line = (*func.line_table)[func.first_line + i];
+      offsets[i] = static_cast<uint32_t>(dest - start_address);
+      key_address = SimpleSerializer<MemAddr>::Write(
+          line.address + line.size - 1, key_address);
+      dest = SimpleSerializer<MemAddr>::Write(line.address, dest);
+      dest = SimpleSerializer<Line>::Write(line, dest);
+    }
+    return dest;
+  }
 };
 
 template<>
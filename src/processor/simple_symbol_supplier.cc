@@ -40,9 +40,16 @@
 #include <sys/types.h>
 #include <sys/stat.h>
 
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif  // _WIN32
+
 #include <algorithm>
 #include <iostream>
 #include <fstream>
+#include <limits>
 
 #include "common/using_std_string.h"
 #include "google_breakpad/processor/code_module.h"
@@ -104,23 +111,35 @@ SymbolSupplier::SymbolResult SimpleSymbolSupplier::GetCStringSymbolData(
   assert(symbol_data);
   assert(symbol_data_size);
 
+  SymbolSupplier::SymbolResult s = GetSymbolFile(module, system_info,
+                                                 symbol_file);
+  if (s != FOUND)
+    return s;
+
+  if (MapSymbolFile(*symbol_file, symbol_data, symbol_data_size)) {
+    mapped_buffers_.insert(
+        std::make_pair(module->code_file(),
+                       std::make_pair(*symbol_data, *symbol_data_size)));
+    return FOUND;
+  }
+
   string symbol_data_string;
-  SymbolSupplier::SymbolResult s =
-      GetSymbolFile(module, system_info, symbol_file, &symbol_data_string);
+  std::ifstream in(symbol_file->c_str());
+  std::getline(in, symbol_data_string, string::traits_type::to_char_type(
+                   string::traits_type::eof()));
+  in.close();
 
-  if (s == FOUND) {
-    *symbol_data_size = symbol_data_string.size() + 1;
-    *symbol_data = new char[*symbol_data_size];
-    if (*symbol_data == NULL) {
-      BPLOG(ERROR) << "Memory allocation for size " << *symbol_data_size
-                   << " failed";
-      return INTERRUPT;
-    }
-    memcpy(*symbol_data, symbol_data_string.c_str(), symbol_data_string.size());
-    (*symbol_data)[symbol_data_string.size()] = '\0';
-    memory_buffers_.insert(make_pair(module->code_file(), *symbol_data));
+  *symbol_data_size = symbol_data_string.size() + 1;
+  *symbol_data = new char[*symbol_data_size];
+  if (*symbol_data == NULL) {
+    BPLOG(ERROR) << "Memory allocation for size " << *symbol_data_size
+                 << " failed";
+    return INTERRUPT;
   }
-  return s;
+  memcpy(*symbol_data, symbol_data_string.c_str(), symbol_data_string.size());
+  (*symbol_data)[symbol_data_string.size()] = '\0';
+  memory_buffers_.insert(make_pair(module->code_file(), *symbol_data));
+  return FOUND;
 }
 
 void SimpleSymbolSupplier::FreeSymbolData(const CodeModule *module) {
@@ -129,6 +148,16 @@ void SimpleSymbolSupplier::FreeSymbolData(const CodeModule *module) {
     return;
   }
 
+  map<string, pair<char *, size_t> >::iterator mapped =
+      mapped_buffers_.find(module->code_file());
+  if (mapped != mapped_buffers_.end()) {
+#ifndef _WIN32
+    munmap(mapped->second.first, mapped->second.second);
+#endif  // _WIN32
+    mapped_buffers_.erase(mapped);
+    return;
+  }
+
   map<string, char *>::iterator it = memory_buffers_.find(module->code_file());
   if (it == memory_buffers_.end()) {
     BPLOG(INFO) << "Cannot find symbol data buffer for module "
@@ -139,30 +168,237 @@ void SimpleSymbolSupplier::FreeSymbolData(const CodeModule *module) {
   memory_buffers_.erase(it);
 }
 
+// static
+bool SimpleSymbolSupplier::MapSymbolFile(const string &symbol_file,
+                                         char **symbol_data,
+                                         size_t *symbol_data_size) {
+#ifdef _WIN32
+  return false;
+#else  // _WIN32
+  int fd = open(symbol_file.c_str(), O_RDONLY);
+  if (fd == -1)
+    return false;
+
+  struct stat st;
+  if (fstat(fd, &st) == -1 || st.st_size <= 0 ||
+      static_cast<uint64_t>(st.st_size) >=
+          std::numeric_limits<size_t>::max()) {
+    close(fd);
+    return false;
+  }
+  size_t file_size = static_cast<size_t>(st.st_size);
+
+  // The resolver expects the data to end in a '\0'.  Reserve room for the
+  // file and one more byte with an anonymous mapping, which reads as zeros,
+  // and map the file over the start of it.  Mapping the file alone would
+  // usually do, as the rest of its last page reads as zeros too, but not
+  // when the file ends on a page boundary.
+  size_t size = file_size + 1;
+  void *data = mmap(NULL, size, PROT_READ | PROT_WRITE,
+                    MAP_PRIVATE | MAP_ANON, -1, 0);
+  if (data == MAP_FAILED) {
+    close(fd);
+    return false;
+  }
+
+  // The mapping is private, so the resolver can tokenize the data in place.
+  // Pages that it only reads are shared with the page cache, rather than
+  // copied, as they were when the file was read into a string and then
+  // into a buffer.
+  if (mmap(data, file_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_FIXED,
+           fd, 0) == MAP_FAILED) {
+    string error_string;
+    int error_code = ErrnoString(&error_string);
+    BPLOG(ERROR) << "Could not map " << symbol_file <<
+        ", error " << error_code << ": " << error_string;
+    munmap(data, size);
+    close(fd);
+    return false;
+  }
+  close(fd);
+
+  // Symbol files are parsed from start to end, once.
+  madvise(data, file_size, MADV_SEQUENTIAL);
+
+  *symbol_data = static_cast<char*>(data);
+  *symbol_data_size = size;
+  return true;
+#endif  // _WIN32
+}
+
+SymbolSupplier::SymbolResult SimpleSymbolSupplier::GetMappableSymbolFile(
+    const CodeModule *module, const SystemInfo *system_info,
+    string *symbol_file) {
+  BPLOG_IF(ERROR, !symbol_file) << "SimpleSymbolSupplier::"
+                                   "GetMappableSymbolFile requires "
+                                   "|symbol_file|";
+  assert(symbol_file);
+  symbol_file->clear();
+
+  for (unsigned int path_index = 0; path_index < paths_.size(); ++path_index) {
+    SymbolResult result;
+    if ((result = GetFileAtPathFromRoot(module, system_info,
+                                        paths_[path_index], ".sym.fast",
+                                        symbol_file)) != NOT_FOUND) {
+      return result;
+    }
+  }
+  return NOT_FOUND;
+}
+
+SymbolSupplier::SymbolResult SimpleSymbolSupplier::GetCompressedSymbolFile(
+    const CodeModule *module, const SystemInfo *system_info,
+    string *symbol_file) {
+  BPLOG_IF(ERROR, !symbol_file) << "SimpleSymbolSupplier::"
+                                   "GetCompressedSymbolFile requires "
+                                   "|symbol_file|";
+  assert(symbol_file);
+  symbol_file->clear();
+
+  static const char *kCompressedExtensions[] = { ".sym.gz", ".sym.zst" };
+  for (unsigned int path_index = 0; path_index < paths_.size(); ++path_index) {
+    for (size_t i = 0;
+         i < sizeof(kCompressedExtensions) / sizeof(kCompressedExtensions[0]);
+         ++i) {
+      SymbolResult result;
+      if ((result = GetFileAtPathFromRoot(module, system_info,
+                                          paths_[path_index],
+                                          kCompressedExtensions[i],
+                                          symbol_file)) != NOT_FOUND) {
+        return result;
+      }
+    }
+  }
+  return NOT_FOUND;
+}
+
+SymbolSupplier::SymbolResult SimpleSymbolSupplier::GetIndexedSymbolFile(
+    const CodeModule *module, const SystemInfo *system_info,
+    string *symbol_file, string *index_file) {
+  BPLOG_IF(ERROR, !symbol_file || !index_file) << "SimpleSymbolSupplier::"
+                                                  "GetIndexedSymbolFile "
+                                                  "requires |symbol_file| "
+                                                  "and |index_file|";
+  assert(symbol_file);
+  assert(index_file);
+  symbol_file->clear();
+  index_file->clear();
+
+  for (unsigned int path_index = 0; path_index < paths_.size(); ++path_index) {
+    SymbolResult result;
+    if ((result = GetFileAtPathFromRoot(module, system_info,
+                                        paths_[path_index], ".sym.idx",
+                                        index_file)) == FOUND) {
+      // The index is only any use next to its symbol file.
+      *symbol_file = index_file->substr(0, index_file->size() - 4);
+      if (file_exists(*symbol_file))
+        return FOUND;
+      symbol_file->clear();
+      index_file->clear();
+    } else if (result != NOT_FOUND) {
+      return result;
+    }
+  }
+  return NOT_FOUND;
+}
+
+SymbolSupplier::SymbolResult SimpleSymbolSupplier::GetSymbolFileDigest(
+    const CodeModule *module, const SystemInfo *system_info,
+    string *digest) {
+  BPLOG_IF(ERROR, !digest) << "SimpleSymbolSupplier::GetSymbolFileDigest "
+                              "requires |digest|";
+  assert(digest);
+  digest->clear();
+
+  for (unsigned int path_index = 0; path_index < paths_.size(); ++path_index) {
+    string digest_file;
+    SymbolResult result;
+    if ((result = GetFileAtPathFromRoot(module, system_info,
+                                        paths_[path_index], ".sym.digest",
+                                        &digest_file)) == FOUND) {
+      std::ifstream in(digest_file.c_str());
+      if (std::getline(in, *digest) && !digest->empty())
+        return FOUND;
+      BPLOG(ERROR) << "Can't read symbol file digest " << digest_file;
+      digest->clear();
+    } else if (result != NOT_FOUND) {
+      return result;
+    }
+  }
+  return NOT_FOUND;
+}
+
+SymbolSupplier::SymbolResult SimpleSymbolSupplier::GetBinaryFile(
+    const CodeModule *module, const SystemInfo *system_info,
+    string *binary_file) {
+  BPLOG_IF(ERROR, !binary_file) << "SimpleSymbolSupplier::GetBinaryFile "
+                                   "requires |binary_file|";
+  assert(binary_file);
+  binary_file->clear();
+
+  for (unsigned int path_index = 0; path_index < paths_.size(); ++path_index) {
+    SymbolResult result;
+    if ((result = GetFileAtPathFromRoot(module, system_info,
+                                        paths_[path_index], "",
+                                        binary_file)) != NOT_FOUND) {
+      return result;
+    }
+  }
+  return NOT_FOUND;
+}
+
 SymbolSupplier::SymbolResult SimpleSymbolSupplier::GetSymbolFileAtPathFromRoot(
     const CodeModule *module, const SystemInfo *system_info,
     const string &root_path, string *symbol_file) {
+  return GetFileAtPathFromRoot(module, system_info, root_path, ".sym",
+                               symbol_file);
+}
+
+SymbolSupplier::SymbolResult SimpleSymbolSupplier::GetFileAtPathFromRoot(
+    const CodeModule *module, const SystemInfo *system_info,
+    const string &root_path, const char *extension, string *symbol_file) {
   BPLOG_IF(ERROR, !symbol_file) << "SimpleSymbolSupplier::GetSymbolFileAtPath "
                                    "requires |symbol_file|";
   assert(symbol_file);
   symbol_file->clear();
 
-  if (!module)
+  string relative_path;
+  if (!GetRelativeSymbolPath(module, extension, &relative_path))
     return NOT_FOUND;
 
   // Start with the base path.
   string path = root_path;
-
-  // Append the debug (pdb) file name as a directory name.
   path.append("/");
+  path.append(relative_path);
+
+  if (!file_exists(path)) {
+    BPLOG(INFO) << "No symbol file at " << path;
+    return NOT_FOUND;
+  }
+
+  *symbol_file = path;
+  return FOUND;
+}
+
+// static
+bool SimpleSymbolSupplier::GetRelativeSymbolPath(const CodeModule *module,
+                                                 const char *extension,
+                                                 string *relative_path) {
+  assert(relative_path);
+  relative_path->clear();
+
+  if (!module)
+    return false;
+
+  // Start with the debug (pdb) file name as a directory name.
   string debug_file_name = PathnameStripper::File(module->debug_file());
   if (debug_file_name.empty()) {
     BPLOG(ERROR) << "Can't construct symbol file path without debug_file "
                     "(code_file = " <<
                     PathnameStripper::File(module->code_file()) << ")";
-    return NOT_FOUND;
+    return false;
   }
-  path.append(debug_file_name);
+  string path = debug_file_name;
 
   // Append the identifier as a directory name.
   path.append("/");
@@ -172,13 +408,13 @@ SymbolSupplier::SymbolResult SimpleSymbolSupplier::GetSymbolFileAtPathFromRoot(
                     "(code_file = " <<
                     PathnameStripper::File(module->code_file()) <<
                     ", debug_file = " << debug_file_name << ")";
-    return NOT_FOUND;
+    return false;
   }
   path.append(identifier);
 
-  // Transform the debug file name into one ending in .sym.  If the existing
-  // name ends in .pdb, strip the .pdb.  Otherwise, add .sym to the non-.pdb
-  // name.
+  // Transform the debug file name into one ending in the extension, usually
+  // .sym.  If the existing name ends in .pdb, strip the .pdb.  Otherwise, add
+  // the extension to the non-.pdb name.
   path.append("/");
   string debug_file_extension;
   if (debug_file_name.size() > 4)
@@ -190,15 +426,10 @@ SymbolSupplier::SymbolResult SimpleSymbolSupplier::GetSymbolFileAtPathFromRoot(
   } else {
     path.append(debug_file_name);
   }
-  path.append(".sym");
+  path.append(extension);
 
-  if (!file_exists(path)) {
-    BPLOG(INFO) << "No symbol file at " << path;
-    return NOT_FOUND;
-  }
-
-  *symbol_file = path;
-  return FOUND;
+  *relative_path = path;
+  return true;
 }
 
 }  // namespace google_breakpad
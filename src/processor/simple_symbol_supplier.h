@@ -78,6 +78,7 @@
 
 #include <map>
 #include <string>
+#include <utility>
 #include <vector>
 
 #include "common/using_std_string.h"
@@ -86,6 +87,7 @@
 namespace google_breakpad {
 
 using std::map;
+using std::pair;
 using std::vector;
 
 class CodeModule;
@@ -113,7 +115,10 @@ class SimpleSymbolSupplier : public SymbolSupplier {
                                      string *symbol_file,
                                      string *symbol_data);
 
-  // Allocates data buffer on heap and writes symbol data into buffer.
+  // Places the symbol data in a buffer that the resolver may modify.
+  // Where possible, the symbol file is mapped privately, so that its pages
+  // are read in as they are parsed and only the ones the resolver writes to
+  // are copied; otherwise the data is read into a buffer on the heap.
   // Symbol supplier ALWAYS takes ownership of the data buffer.
   virtual SymbolResult GetCStringSymbolData(const CodeModule *module,
                                             const SystemInfo *system_info,
@@ -124,14 +129,76 @@ class SimpleSymbolSupplier : public SymbolSupplier {
   // Free the data buffer allocated in the above GetCStringSymbolData();
   virtual void FreeSymbolData(const CodeModule *module);
 
+  // Returns the path to a serialized symbol file for the given module.
+  // These are looked for alongside the text symbol files, with the
+  // extension .sym.fast in place of .sym.
+  virtual SymbolResult GetMappableSymbolFile(const CodeModule *module,
+                                             const SystemInfo *system_info,
+                                             string *symbol_file);
+
+  // Returns the path to a compressed text symbol file for the given
+  // module.  These are looked for alongside the text symbol files, with
+  // the extension .sym.gz or .sym.zst in place of .sym.
+  virtual SymbolResult GetCompressedSymbolFile(const CodeModule *module,
+                                               const SystemInfo *system_info,
+                                               string *symbol_file);
+
+  // Returns the paths to a text symbol file for the given module and its
+  // sidecar index, which is looked for alongside it with the extension
+  // .sym.idx in place of .sym.
+  virtual SymbolResult GetIndexedSymbolFile(const CodeModule *module,
+                                            const SystemInfo *system_info,
+                                            string *symbol_file,
+                                            string *index_file);
+
+  // Returns the digest of the symbol records for the given module, read
+  // from the first line of a file looked for alongside the text symbol
+  // file, with the extension .sym.digest in place of .sym.  Whatever
+  // publishes the symbol files writes these.
+  virtual SymbolResult GetSymbolFileDigest(const CodeModule *module,
+                                           const SystemInfo *system_info,
+                                           string *digest);
+
+  // Returns the path to the binary for the given module, which is looked
+  // for alongside the text symbol file, named like the debug file.
+  virtual SymbolResult GetBinaryFile(const CodeModule *module,
+                                     const SystemInfo *system_info,
+                                     string *binary_file);
+
  protected:
   SymbolResult GetSymbolFileAtPathFromRoot(const CodeModule *module,
                                            const SystemInfo *system_info,
                                            const string &root_path,
                                            string *symbol_file);
 
+  // Sets |relative_path| to the path, relative to a symbol root, at which
+  // the file ending in |extension| (".sym", for example) for |module| is
+  // stored.  Returns false if |module| lacks the information to name it.
+  static bool GetRelativeSymbolPath(const CodeModule *module,
+                                    const char *extension,
+                                    string *relative_path);
+
  private:
+  // Looks for a file for |module| under |root_path|, named like the text
+  // symbol file but ending in |extension| instead of .sym.
+  SymbolResult GetFileAtPathFromRoot(const CodeModule *module,
+                                     const SystemInfo *system_info,
+                                     const string &root_path,
+                                     const char *extension,
+                                     string *symbol_file);
+
+  // Maps |symbol_file| into memory for GetCStringSymbolData, followed by
+  // a '\0'.  |symbol_data_size| is also the size of the mapping.  Returns
+  // false if the file can't be mapped.
+  static bool MapSymbolFile(const string &symbol_file,
+                            char **symbol_data,
+                            size_t *symbol_data_size);
+
   map<string, char *> memory_buffers_;
+
+  // Buffers handed out by GetCStringSymbolData that are mappings rather
+  // than heap allocations, with the sizes of the mappings.
+  map<string, pair<char *, size_t> > mapped_buffers_;
   vector<string> paths_;
 };
 
@@ -34,28 +34,76 @@
 //
 // Author: Siyang Xie (lambxsy@google.com)
 
+#include <fcntl.h>
 #include <stdio.h>
 #include <string.h>
 #include <sys/stat.h>
 
+#ifndef _WIN32
+#include <sys/mman.h>
+#include <unistd.h>
+#endif  // _WIN32
+
+#include <algorithm>
+#include <functional>
+#include <limits>
 #include <map>
 #include <utility>
+#include <vector>
 
+#include "common/probes.h"
+#include "common/scoped_ptr.h"
 #include "google_breakpad/processor/source_line_resolver_base.h"
+#include "google_breakpad/processor/symbol_module_cache.h"
+#include "processor/basic_code_module.h"
 #include "processor/source_line_resolver_base_types.h"
 #include "processor/module_factory.h"
+#include "processor/symbol_file_decompressor.h"
 
 using std::map;
 using std::make_pair;
+using std::numeric_limits;
+using std::vector;
 
 namespace google_breakpad {
 
+// What Module::LookupAddress found at one address.  The addresses are
+// kept relative to the module's base address.
+struct SourceLineResolverBase::FrameCacheEntry {
+  FrameCacheEntry() : module(NULL), address(0), shared_function_name(NULL),
+                      function_base(0), shared_source_file_name(NULL),
+                      source_line(0), source_line_base(0) {}
+
+  // NULL if the entry is unused.
+  const Module *module;
+  uint64_t address;
+
+  // With share_names_, the shared_ names are used instead of the strings.
+  string function_name;
+  const char *shared_function_name;
+  uint64_t function_base;
+  string source_file_name;
+  const char *shared_source_file_name;
+  int source_line;
+  uint64_t source_line_base;
+};
+
 SourceLineResolverBase::SourceLineResolverBase(
     ModuleFactory *module_factory)
   : modules_(new ModuleMap),
     corrupt_modules_(new ModuleSet),
     memory_buffers_(new MemoryMap),
-    module_factory_(module_factory) {
+    mapped_files_(new MappedFileMap),
+    module_factory_(module_factory),
+    module_cache_(NULL),
+    cached_modules_(new ModuleSet),
+    cache_generation_(0),
+    frame_cache_(NULL),
+    frame_cache_size_(0),
+    share_names_(false),
+    freeze_modules_(false),
+    load_modules_lazily_(false),
+    defer_source_lines_(false) {
 }
 
 SourceLineResolverBase::~SourceLineResolverBase() {
@@ -63,7 +111,7 @@ SourceLineResolverBase::~SourceLineResolverBase() {
   // Iterate through ModuleMap and delete all loaded modules.
   for (it = modules_->begin(); it != modules_->end(); ++it) {
     // Delete individual module.
-    delete it->second;
+    ReleaseModule(it->first, it->second);
   }
   // Delete the map of modules.
   delete modules_;
@@ -73,6 +121,9 @@ SourceLineResolverBase::~SourceLineResolverBase() {
   delete corrupt_modules_;
   corrupt_modules_ = NULL;
 
+  delete cached_modules_;
+  cached_modules_ = NULL;
+
   MemoryMap::iterator iter = memory_buffers_->begin();
   for (; iter != memory_buffers_->end(); ++iter) {
     delete [] iter->second;
@@ -81,8 +132,18 @@ SourceLineResolverBase::~SourceLineResolverBase() {
   delete memory_buffers_;
   memory_buffers_ = NULL;
 
+  MappedFileMap::iterator mapped = mapped_files_->begin();
+  for (; mapped != mapped_files_->end(); ++mapped) {
+    UnmapSymbolFile(mapped->second.first, mapped->second.second);
+  }
+  delete mapped_files_;
+  mapped_files_ = NULL;
+
   delete module_factory_;
   module_factory_ = NULL;
+
+  delete [] frame_cache_;
+  frame_cache_ = NULL;
 }
 
 bool SourceLineResolverBase::ReadSymbolFile(const string &map_file,
@@ -160,6 +221,9 @@ bool SourceLineResolverBase::LoadModule(const CodeModule *module,
     return false;
   }
 
+  if (LoadModuleFromCache(module))
+    return true;
+
   BPLOG(INFO) << "Loading symbols for module " << module->code_file()
               << " from " << map_file;
 
@@ -173,7 +237,8 @@ bool SourceLineResolverBase::LoadModule(const CodeModule *module,
   bool load_result = LoadModuleUsingMemoryBuffer(module, memory_buffer,
                                                  memory_buffer_size);
 
-  if (load_result && !ShouldDeleteMemoryBufferAfterLoadModule()) {
+  if (load_result && !ShouldDeleteMemoryBufferAfterLoadModule() &&
+      cached_modules_->find(module->code_file()) == cached_modules_->end()) {
     // memory_buffer has to stay alive as long as the module.
     memory_buffers_->insert(make_pair(module->code_file(), memory_buffer));
   } else {
@@ -195,6 +260,9 @@ bool SourceLineResolverBase::LoadModuleUsingMapBuffer(
     return false;
   }
 
+  if (LoadModuleFromCache(module))
+    return true;
+
   size_t memory_buffer_size = map_buffer.size() + 1;
   char *memory_buffer = new char[memory_buffer_size];
   if (memory_buffer == NULL) {
@@ -209,7 +277,8 @@ bool SourceLineResolverBase::LoadModuleUsingMapBuffer(
   bool load_result = LoadModuleUsingMemoryBuffer(module, memory_buffer,
                                                  memory_buffer_size);
 
-  if (load_result && !ShouldDeleteMemoryBufferAfterLoadModule()) {
+  if (load_result && !ShouldDeleteMemoryBufferAfterLoadModule() &&
+      cached_modules_->find(module->code_file()) == cached_modules_->end()) {
     // memory_buffer has to stay alive as long as the module.
     memory_buffers_->insert(make_pair(module->code_file(), memory_buffer));
   } else {
@@ -233,13 +302,37 @@ bool SourceLineResolverBase::LoadModuleUsingMemoryBuffer(
     return false;
   }
 
+  BREAKPAD_PROBE2(resolver__load__start, module->code_file().c_str(),
+                  memory_buffer_size);
+  if (LoadModuleFromCache(module)) {
+    BREAKPAD_PROBE3(resolver__load__done, module->code_file().c_str(), true,
+                    IsModuleCorrupt(module));
+    return true;
+  }
+
   BPLOG(INFO) << "Loading symbols for module " << module->code_file()
              << " from memory buffer";
 
+  // A module still missing its source lines can't be shared.
+  bool use_cache = module_cache_ && !defer_source_lines_ &&
+                   !SymbolModuleCache::KeyForModule(module).empty();
+  char *cache_buffer = NULL;
+  if (use_cache && !ShouldDeleteMemoryBufferAfterLoadModule()) {
+    // The module will refer to the buffer it is loaded from, so a cached
+    // module needs a copy that the cache can own.
+    cache_buffer = new char[memory_buffer_size];
+    memcpy(cache_buffer, memory_buffer, memory_buffer_size);
+    memory_buffer = cache_buffer;
+  }
+
   Module *basic_module = module_factory_->CreateModule(module->code_file());
 
   // Ownership of memory is NOT transfered to Module::LoadMapFromMemory().
-  if (!basic_module->LoadMapFromMemory(memory_buffer, memory_buffer_size)) {
+  bool load_result = defer_source_lines_ ?
+      basic_module->LoadMapWithoutSourceLinesFromMemory(memory_buffer,
+                                                        memory_buffer_size) :
+      basic_module->LoadMapFromMemory(memory_buffer, memory_buffer_size);
+  if (!load_result) {
     BPLOG(ERROR) << "Too many error while parsing symbol data for module "
                  << module->code_file();
     // Returning false from here would be an indication that the symbols for
@@ -247,26 +340,277 @@ bool SourceLineResolverBase::LoadModuleUsingMemoryBuffer(
     // and add the module to both the modules_ and the corrupt_modules_ lists.
     assert(basic_module->IsCorrupt());
   }
+  if (freeze_modules_)
+    basic_module->Freeze();
+
+  AddLoadedModule(module, basic_module, use_cache, cache_buffer,
+                  memory_buffer_size);
+  BREAKPAD_PROBE3(resolver__load__done, module->code_file().c_str(), false,
+                  !load_result);
+  return true;
+}
+
+void SourceLineResolverBase::AddLoadedModule(const CodeModule *module,
+                                             Module *symbol_module,
+                                             bool use_cache,
+                                             char *cache_buffer,
+                                             size_t size) {
+  string digest;
+  std::map<string, string>::iterator pending =
+      pending_digests_.find(module->code_file());
+  if (pending != pending_digests_.end()) {
+    digest = pending->second;
+    pending_digests_.erase(pending);
+  }
 
-  modules_->insert(make_pair(module->code_file(), basic_module));
-  if (basic_module->IsCorrupt()) {
+  if (use_cache) {
+    bool corrupt;
+    symbol_module = module_cache_->Insert(module, symbol_module, cache_buffer,
+                                          size, digest, &corrupt);
+    cached_modules_->insert(module->code_file());
+  }
+
+  modules_->insert(make_pair(module->code_file(), symbol_module));
+  if (symbol_module->IsCorrupt()) {
     corrupt_modules_->insert(module->code_file());
   }
-  return true;
 }
 
 bool SourceLineResolverBase::ShouldDeleteMemoryBufferAfterLoadModule() {
   return true;
 }
 
+bool SourceLineResolverBase::LoadModuleUsingMappedFile(
+    const CodeModule *module, const string &map_file) {
+  if (module == NULL)
+    return false;
+
+  // Resolvers that parse the symbol data modify it and then let it go, so
+  // they gain nothing from a mapping, and can't use a read-only one.
+  if (ShouldDeleteMemoryBufferAfterLoadModule())
+    return false;
+
+  // Make sure we don't already have a module with the given name.
+  if (modules_->find(module->code_file()) != modules_->end()) {
+    BPLOG(INFO) << "Symbols for module " << module->code_file()
+                << " already loaded";
+    return false;
+  }
+
+  if (LoadModuleFromCache(module))
+    return true;
+
+#ifdef _WIN32
+  return false;
+#else  // _WIN32
+  int fd = open(map_file.c_str(), O_RDONLY);
+  if (fd == -1) {
+    string error_string;
+    int error_code = ErrnoString(&error_string);
+    BPLOG(ERROR) << "Could not open " << map_file <<
+        ", error " << error_code << ": " << error_string;
+    return false;
+  }
+
+  struct stat st;
+  if (fstat(fd, &st) == -1 || st.st_size <= 0 ||
+      static_cast<uint64_t>(st.st_size) > numeric_limits<size_t>::max()) {
+    BPLOG(ERROR) << "Could not map " << map_file << ": bad file size";
+    close(fd);
+    return false;
+  }
+
+  size_t size = static_cast<size_t>(st.st_size);
+  void *data = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (data == MAP_FAILED) {
+    string error_string;
+    int error_code = ErrnoString(&error_string);
+    BPLOG(ERROR) << "Could not map " << map_file <<
+        ", error " << error_code << ": " << error_string;
+    return false;
+  }
+
+  BPLOG(INFO) << "Mapped symbol file " << map_file << " for module "
+              << module->code_file();
+
+  char *memory_buffer = static_cast<char*>(data);
+  bool load_result = LoadModuleUsingMemoryBuffer(module, memory_buffer, size);
+
+  if (load_result &&
+      cached_modules_->find(module->code_file()) == cached_modules_->end()) {
+    // The mapping has to stay alive as long as the module.  (A cached module
+    // has its own copy of the data.)
+    mapped_files_->insert(make_pair(module->code_file(),
+                                    make_pair(memory_buffer, size)));
+  } else {
+    UnmapSymbolFile(memory_buffer, size);
+  }
+
+  return load_result;
+#endif  // _WIN32
+}
+
+bool SourceLineResolverBase::LoadModuleUsingCompressedFile(
+    const CodeModule *module, const string &compressed_file) {
+  if (module == NULL)
+    return false;
+
+  // Resolvers that keep their symbol data need all of it in memory anyway.
+  if (!ShouldDeleteMemoryBufferAfterLoadModule())
+    return false;
+
+  // Make sure we don't already have a module with the given name.
+  if (modules_->find(module->code_file()) != modules_->end()) {
+    BPLOG(INFO) << "Symbols for module " << module->code_file()
+                << " already loaded";
+    return false;
+  }
+
+  if (LoadModuleFromCache(module))
+    return true;
+
+  scoped_ptr<SymbolFileDecompressor> decompressor(
+      SymbolFileDecompressor::Open(compressed_file));
+  if (!decompressor.get())
+    return false;
+
+  BPLOG(INFO) << "Loading symbols for module " << module->code_file()
+              << " from compressed file " << compressed_file;
+
+  scoped_ptr<Module> basic_module(
+      module_factory_->CreateModule(module->code_file()));
+  size_t data_size = 0;
+  if (!basic_module->LoadMapFromDecompressor(decompressor.get(),
+                                             &data_size)) {
+    BPLOG(ERROR) << "Could not load symbols for module "
+                 << module->code_file() << " from " << compressed_file;
+    return false;
+  }
+  if (freeze_modules_)
+    basic_module->Freeze();
+
+  bool use_cache = module_cache_ &&
+                   !SymbolModuleCache::KeyForModule(module).empty();
+  AddLoadedModule(module, basic_module.release(), use_cache, NULL,
+                  data_size);
+  return true;
+}
+
+bool SourceLineResolverBase::LoadModuleUsingIndexedFile(
+    const CodeModule *module, const string &map_file,
+    const string &index_file) {
+  if (module == NULL || !CanLoadModulesUsingIndexedFiles())
+    return false;
+
+  // Make sure we don't already have a module with the given name.
+  if (modules_->find(module->code_file()) != modules_->end()) {
+    BPLOG(INFO) << "Symbols for module " << module->code_file()
+                << " already loaded";
+    return false;
+  }
+
+  // A fully loaded module in the cache is as good.
+  if (LoadModuleFromCache(module))
+    return true;
+
+  scoped_ptr<Module> basic_module(
+      module_factory_->CreateModule(module->code_file()));
+  if (!basic_module->LoadMapFromIndexedFile(map_file, index_file))
+    return false;
+
+  BPLOG(INFO) << "Loading symbols for module " << module->code_file()
+              << " on demand from " << map_file;
+  if (freeze_modules_)
+    basic_module->Freeze();
+
+  // The module is still parsing as it is used, so it can't be shared.
+  AddLoadedModule(module, basic_module.release(), false, NULL, 0);
+  return true;
+}
+
+bool SourceLineResolverBase::CanLoadModulesUsingIndexedFiles() {
+  // Resolvers that keep their symbol data refer to all of it anyway.
+  return load_modules_lazily_ && ShouldDeleteMemoryBufferAfterLoadModule();
+}
+
+bool SourceLineResolverBase::LoadModuleUsingDigest(const CodeModule *module,
+                                                   const string &digest) {
+  if (module == NULL || digest.empty() || !CanShareModulesByDigest())
+    return false;
+
+  // Make sure we don't already have a module with the given name.
+  if (modules_->find(module->code_file()) != modules_->end()) {
+    BPLOG(INFO) << "Symbols for module " << module->code_file()
+                << " already loaded";
+    return false;
+  }
+
+  if (LoadModuleFromCache(module))
+    return true;
+
+  bool corrupt = false;
+  Module *cached_module = module_cache_->AcquireByDigest(digest, &corrupt);
+  if (!cached_module) {
+    pending_digests_[module->code_file()] = digest;
+    return false;
+  }
+
+  BPLOG(INFO) << "Sharing symbols with digest " << digest << " for module "
+              << module->code_file();
+  AddCachedModule(module, cached_module, corrupt);
+  return true;
+}
+
+bool SourceLineResolverBase::CanShareModulesByDigest() {
+  // Modules loaded without their source lines aren't cached.
+  return module_cache_ && !defer_source_lines_;
+}
+
+bool SourceLineResolverBase::DeferSourceLines(bool defer) {
+  // Resolvers that keep their symbol data refer to all of it anyway.
+  if (defer && !ShouldDeleteMemoryBufferAfterLoadModule())
+    return false;
+  defer_source_lines_ = defer;
+  return true;
+}
+
+bool SourceLineResolverBase::HasDeferredSourceLines(const CodeModule *module) {
+  if (!module)
+    return false;
+  ModuleMap::const_iterator it = modules_->find(module->code_file());
+  return it != modules_->end() && it->second->HasDeferredSourceLines();
+}
+
+bool SourceLineResolverBase::LoadSourceLinesUsingMemoryBuffer(
+    const CodeModule *module, char *memory_buffer, size_t memory_buffer_size) {
+  if (!module)
+    return false;
+  ModuleMap::const_iterator it = modules_->find(module->code_file());
+  if (it == modules_->end() || !it->second->HasDeferredSourceLines())
+    return false;
+
+  BPLOG(INFO) << "Loading source lines for module " << module->code_file();
+  it->second->LoadSourceLinesFromMemory(memory_buffer, memory_buffer_size);
+  if (it->second->IsCorrupt())
+    corrupt_modules_->insert(module->code_file());
+
+  // The frame cache holds the module's frames as they were found without
+  // source lines.
+  for (size_t i = 0; i < frame_cache_size_; ++i) {
+    if (frame_cache_[i].module == it->second)
+      frame_cache_[i] = FrameCacheEntry();
+  }
+  return true;
+}
+
 void SourceLineResolverBase::UnloadModule(const CodeModule *code_module) {
   if (!code_module)
     return;
 
   ModuleMap::iterator mod_iter = modules_->find(code_module->code_file());
   if (mod_iter != modules_->end()) {
-    Module *symbol_module = mod_iter->second;
-    delete symbol_module;
+    ReleaseModule(mod_iter->first, mod_iter->second);
     corrupt_modules_->erase(mod_iter->first);
     modules_->erase(mod_iter);
   }
@@ -280,13 +624,26 @@ void SourceLineResolverBase::UnloadModule(const CodeModule *code_module) {
       delete [] iter->second;
       memory_buffers_->erase(iter);
     }
+
+    MappedFileMap::iterator mapped =
+        mapped_files_->find(code_module->code_file());
+    if (mapped != mapped_files_->end()) {
+      UnmapSymbolFile(mapped->second.first, mapped->second.second);
+      mapped_files_->erase(mapped);
+    }
   }
 }
 
 bool SourceLineResolverBase::HasModule(const CodeModule *module) {
   if (!module)
     return false;
-  return modules_->find(module->code_file()) != modules_->end();
+  if (module_cache_)
+    DropStaleModules();
+  if (modules_->find(module->code_file()) != modules_->end())
+    return true;
+  // A module loaded through the cache by another resolver saves this one
+  // from fetching and parsing the symbols again.
+  return LoadModuleFromCache(module);
 }
 
 bool SourceLineResolverBase::IsModuleCorrupt(const CodeModule *module) {
@@ -295,12 +652,170 @@ bool SourceLineResolverBase::IsModuleCorrupt(const CodeModule *module) {
   return corrupt_modules_->find(module->code_file()) != corrupt_modules_->end();
 }
 
+bool SourceLineResolverBase::GetModuleMemoryUsage(const CodeModule *module,
+                                                  ModuleMemoryUsage *usage) {
+  if (!module || !usage)
+    return false;
+  ModuleMap::const_iterator it = modules_->find(module->code_file());
+  if (it == modules_->end())
+    return false;
+  *usage = ModuleMemoryUsage();
+  it->second->GetMemoryUsage(usage);
+  return true;
+}
+
+size_t SourceLineResolverBase::memory_used() {
+  size_t memory_used = 0;
+  for (ModuleMap::const_iterator it = modules_->begin();
+       it != modules_->end(); ++it) {
+    ModuleMemoryUsage usage;
+    it->second->GetMemoryUsage(&usage);
+    memory_used += usage.total();
+  }
+  return memory_used;
+}
+
+void SourceLineResolverBase::set_frame_cache_size(size_t entries) {
+  size_t size = 0;
+  if (entries > 0) {
+    size = 1;
+    while (size < entries)
+      size <<= 1;
+  }
+  delete [] frame_cache_;
+  frame_cache_ = size ? new FrameCacheEntry[size] : NULL;
+  frame_cache_size_ = size;
+}
+
+void SourceLineResolverBase::set_share_names(bool share_names) {
+  share_names_ = share_names;
+  // The frame cache holds names the way they were last looked up.
+  for (size_t i = 0; i < frame_cache_size_; ++i)
+    frame_cache_[i] = FrameCacheEntry();
+}
+
+SourceLineResolverBase::FrameCacheEntry *SourceLineResolverBase::FrameCacheSlot(
+    const Module *module, uint64_t address) {
+  uint64_t hash = address ^ (reinterpret_cast<uintptr_t>(module) >> 4);
+  hash *= 0x9E3779B97F4A7C15ULL;
+  return &frame_cache_[(hash >> 32) & (frame_cache_size_ - 1)];
+}
+
 void SourceLineResolverBase::FillSourceLineInfo(StackFrame *frame) {
-  if (frame->module) {
-    ModuleMap::const_iterator it = modules_->find(frame->module->code_file());
-    if (it != modules_->end()) {
-      it->second->LookupAddress(frame);
+  if (!frame->module)
+    return;
+  ModuleMap::const_iterator it = modules_->find(frame->module->code_file());
+  if (it == modules_->end())
+    return;
+  if (!frame_cache_) {
+    it->second->LookupAddress(frame, share_names_);
+    return;
+  }
+
+  uint64_t base = frame->module->base_address();
+  uint64_t address = frame->instruction - base;
+  FrameCacheEntry *entry = FrameCacheSlot(it->second, address);
+  if (entry->module != it->second || entry->address != address) {
+    // Look the address up in a frame of its own, so that what was found can
+    // be told apart from what |frame| already held.
+    StackFrame lookup;
+    lookup.instruction = frame->instruction;
+    lookup.module = frame->module;
+    it->second->LookupAddress(&lookup, share_names_);
+
+    entry->module = it->second;
+    entry->address = address;
+    entry->function_name.swap(lookup.function_name);
+    entry->shared_function_name = lookup.shared_function_name;
+    entry->function_base = lookup.function_base ?
+        lookup.function_base - base : 0;
+    entry->source_file_name.swap(lookup.source_file_name);
+    entry->shared_source_file_name = lookup.shared_source_file_name;
+    entry->source_line = lookup.source_line;
+    entry->source_line_base = lookup.source_line_base ?
+        lookup.source_line_base - base : 0;
+  }
+
+  // LookupAddress only sets the fields it finds something for; so does
+  // the cache.
+  if (entry->shared_function_name) {
+    frame->shared_function_name = entry->shared_function_name;
+    frame->function_base = base + entry->function_base;
+  } else if (!entry->function_name.empty() || entry->function_base) {
+    frame->function_name = entry->function_name;
+    frame->function_base = base + entry->function_base;
+  }
+  if (entry->shared_source_file_name)
+    frame->shared_source_file_name = entry->shared_source_file_name;
+  else if (!entry->source_file_name.empty())
+    frame->source_file_name = entry->source_file_name;
+  if (entry->source_line || entry->source_line_base) {
+    frame->source_line = entry->source_line;
+    frame->source_line_base = base + entry->source_line_base;
+  }
+}
+
+namespace {
+
+// A lookup for SymbolizeAddresses, ordered by module and then by address.
+struct SortedLookup {
+  const void *module;
+  uint64_t address;
+  size_t index;
+
+  bool operator<(const SortedLookup &other) const {
+    if (module != other.module)
+      return std::less<const void*>()(module, other.module);
+    return address < other.address;
+  }
+};
+
+}  // namespace
+
+void SourceLineResolverBase::SymbolizeAddresses(const AddressLookup *lookups,
+                                                size_t count,
+                                                SymbolizedAddress *results) {
+  static const SymbolizedAddress kNotFound = { NULL, NULL, 0, 0 };
+  vector<SortedLookup> sorted;
+  sorted.reserve(count);
+  // Lookups usually come in runs for one module.
+  const CodeModule *last_code_module = NULL;
+  const Module *last_module = NULL;
+  for (size_t i = 0; i < count; ++i) {
+    results[i] = kNotFound;
+    const CodeModule *code_module = lookups[i].module;
+    if (!code_module)
+      continue;
+    if (code_module != last_code_module) {
+      ModuleMap::const_iterator it = modules_->find(code_module->code_file());
+      last_module = it == modules_->end() ? NULL : it->second;
+      last_code_module = code_module;
     }
+    if (!last_module)
+      continue;
+    SortedLookup lookup = {
+      last_module, lookups[i].address - code_module->base_address(), i
+    };
+    sorted.push_back(lookup);
+  }
+  std::sort(sorted.begin(), sorted.end());
+
+  vector<MemAddr> addresses;
+  vector<SymbolizedAddress> found;
+  size_t begin = 0;
+  while (begin < sorted.size()) {
+    size_t end = begin + 1;
+    while (end < sorted.size() && sorted[end].module == sorted[begin].module)
+      ++end;
+    addresses.clear();
+    for (size_t i = begin; i < end; ++i)
+      addresses.push_back(sorted[i].address);
+    found.resize(addresses.size());
+    static_cast<const Module*>(sorted[begin].module)->LookupAddresses(
+        &addresses[0], addresses.size(), &found[0]);
+    for (size_t i = begin; i < end; ++i)
+      results[sorted[i].index] = found[i - begin];
+    begin = end;
   }
 }
 
@@ -326,13 +841,149 @@ CFIFrameInfo *SourceLineResolverBase::FindCFIFrameInfo(
   return NULL;
 }
 
+bool SourceLineResolverBase::CanLookUpConcurrently(const CodeModule *module) {
+  // Lookups fill the frame cache, and with a module cache HasModule drops
+  // stale modules and adopts cached ones.
+  if (!module || frame_cache_ || module_cache_)
+    return false;
+  ModuleMap::const_iterator it = modules_->find(module->code_file());
+  return it != modules_->end() && it->second->CanLookUpConcurrently();
+}
+
+void SourceLineResolverBase::set_module_cache(
+    SymbolModuleCache *module_cache) {
+  BPLOG_IF(ERROR, !modules_->empty()) << "set_module_cache called after "
+                                         "modules were loaded";
+  module_cache_ = module_cache;
+  if (module_cache_)
+    cache_generation_ = module_cache_->generation();
+}
+
+bool SourceLineResolverBase::ReloadModule(const CodeModule *module,
+                                          const string &map_file) {
+  if (!module_cache_ || SymbolModuleCache::KeyForModule(module).empty())
+    return false;
+
+  char *memory_buffer;
+  size_t memory_buffer_size;
+  if (!ReadSymbolFile(map_file, &memory_buffer, &memory_buffer_size))
+    return false;
+
+  BPLOG(INFO) << "Reloading symbols for module " << module->code_file()
+              << " from " << map_file;
+
+  Module *basic_module = module_factory_->CreateModule(module->code_file());
+  if (!basic_module->LoadMapFromMemory(memory_buffer, memory_buffer_size)) {
+    BPLOG(ERROR) << "Too many error while parsing symbol data for module "
+                 << module->code_file();
+    assert(basic_module->IsCorrupt());
+  }
+  if (freeze_modules_)
+    basic_module->Freeze();
+
+  char *cache_buffer = memory_buffer;
+  if (ShouldDeleteMemoryBufferAfterLoadModule()) {
+    delete [] memory_buffer;
+    cache_buffer = NULL;
+  }
+  module_cache_->Publish(module, basic_module, cache_buffer,
+                         memory_buffer_size);
+  return true;
+}
+
+void SourceLineResolverBase::DropStaleModules() {
+  // Read the generation first, so that changes made during the sweep are
+  // caught by the next one.
+  uint32_t generation = module_cache_->generation();
+  if (generation == cache_generation_)
+    return;
+  cache_generation_ = generation;
+
+  ModuleMap::iterator it = modules_->begin();
+  while (it != modules_->end()) {
+    if (cached_modules_->find(it->first) == cached_modules_->end() ||
+        !module_cache_->IsStale(it->second)) {
+      ++it;
+      continue;
+    }
+    BPLOG(INFO) << "Dropping outdated symbols for module " << it->first;
+    ReleaseModule(it->first, it->second);
+    corrupt_modules_->erase(it->first);
+    modules_->erase(it++);
+  }
+}
+
+bool SourceLineResolverBase::LoadModuleFromCache(const CodeModule *module) {
+  if (!module_cache_)
+    return false;
+
+  bool corrupt = false;
+  Module *cached_module = module_cache_->Acquire(module, &corrupt);
+  if (!cached_module)
+    return false;
+
+  BPLOG(INFO) << "Using cached symbols for module " << module->code_file();
+  AddCachedModule(module, cached_module, corrupt);
+  return true;
+}
+
+void SourceLineResolverBase::AddCachedModule(const CodeModule *module,
+                                             Module *cached_module,
+                                             bool corrupt) {
+  modules_->insert(make_pair(module->code_file(), cached_module));
+  cached_modules_->insert(module->code_file());
+  if (corrupt)
+    corrupt_modules_->insert(module->code_file());
+}
+
+void SourceLineResolverBase::ReleaseModule(const string &code_file,
+                                           Module *symbol_module) {
+  // Another module may later be allocated where this one was.
+  for (size_t i = 0; i < frame_cache_size_; ++i) {
+    if (frame_cache_[i].module == symbol_module)
+      frame_cache_[i] = FrameCacheEntry();
+  }
+
+  ModuleSet::iterator it = cached_modules_->find(code_file);
+  if (it != cached_modules_->end()) {
+    cached_modules_->erase(it);
+    module_cache_->Release(symbol_module);
+  } else {
+    delete symbol_module;
+  }
+}
+
+// static
+void SourceLineResolverBase::UnmapSymbolFile(char *data, size_t size) {
+#ifndef _WIN32
+  munmap(data, size);
+#endif  // _WIN32
+}
+
 bool SourceLineResolverBase::CompareString::operator()(
     const string &s1, const string &s2) const {
   return strcmp(s1.c_str(), s2.c_str()) < 0;
 }
 
+void SourceLineResolverBase::Module::LookupAddresses(
+    const MemAddr *addresses, size_t count, SymbolizedAddress *results) const {
+  // The addresses are relative, so look them up in a module based at 0.
+  BasicCodeModule module(0, 0, "", "", "", "", "");
+  for (size_t i = 0; i < count; ++i) {
+    StackFrame frame;
+    frame.instruction = addresses[i];
+    frame.module = &module;
+    LookupAddress(&frame, true);
+    results[i].function_name = frame.shared_function_name;
+    results[i].source_file_name = frame.shared_source_file_name;
+    results[i].source_line = frame.source_line;
+    results[i].function_offset =
+        frame.shared_function_name ? addresses[i] - frame.function_base : 0;
+  }
+}
+
 bool SourceLineResolverBase::Module::ParseCFIRuleSet(
-    const string &rule_set, CFIFrameInfo *frame_info) const {
+    const char *rule_set, CFIFrameInfo *frame_info) const {
   CFIFrameInfoParseHandler handler(frame_info);
   CFIRuleParser parser(&handler);
   return parser.Parse(rule_set);
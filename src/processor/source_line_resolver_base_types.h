@@ -54,6 +54,8 @@
 
 namespace google_breakpad {
 
+class SymbolFileDecompressor;
+
 class SourceLineResolverBase::AutoFileCloser {
  public:
   explicit AutoFileCloser(FILE *file) : file_(file) {}
@@ -127,13 +129,61 @@ class SourceLineResolverBase::Module {
   virtual bool LoadMapFromMemory(char *memory_buffer,
                                  size_t memory_buffer_size) = 0;
 
+  // Loads a map from text symbol data read from |decompressor|, a block at
+  // a time, setting |*data_size| to the size of the decompressed data.
+  // Returns false if the data couldn't all be read, or if this kind of
+  // module can't be loaded that way (the default), for example because it
+  // keeps referring to its symbol data once loaded.
+  virtual bool LoadMapFromDecompressor(SymbolFileDecompressor *decompressor,
+                                       size_t *data_size) {
+    return false;
+  }
+
+  // Loads a map from the text symbol file |map_file| on demand, parsing
+  // records as lookups need them, with the help of |index_file|, its
+  // SymbolFileIndex.  Returns false if either file can't be used, or if
+  // this kind of module can't be loaded that way (the default).
+  virtual bool LoadMapFromIndexedFile(const string &map_file,
+                                      const string &index_file) {
+    return false;
+  }
+
+  // Loads a map from |memory_buffer| like LoadMapFromMemory, but without
+  // source file and line data, which LoadSourceLinesFromMemory adds later
+  // from the same symbol data.  Functions and public symbols are loaded, as
+  // stack walking consults them.  Returns false if this kind of module
+  // can't be loaded that way (the default).
+  virtual bool LoadMapWithoutSourceLinesFromMemory(char *memory_buffer,
+                                                   size_t memory_buffer_size) {
+    return false;
+  }
+  virtual bool LoadSourceLinesFromMemory(char *memory_buffer,
+                                         size_t memory_buffer_size) {
+    return false;
+  }
+
+  // Returns true if the module was loaded by
+  // LoadMapWithoutSourceLinesFromMemory and LoadSourceLinesFromMemory
+  // hasn't been called since.
+  virtual bool HasDeferredSourceLines() const { return false; }
+
   // Tells whether the loaded symbol data is corrupt.  Return value is
   // undefined, if the symbol data hasn't been loaded yet.
   virtual bool IsCorrupt() const = 0;
 
   // Looks up the given relative address, and fills the StackFrame struct
-  // with the result.
-  virtual void LookupAddress(StackFrame *frame) const = 0;
+  // with the result.  If |share_names| is true, the frame's
+  // shared_function_name and shared_source_file_name are pointed at this
+  // module's names instead of copying them into function_name and
+  // source_file_name.
+  virtual void LookupAddress(StackFrame *frame, bool share_names) const = 0;
+
+  // Looks up the |count| relative addresses in |addresses|, which are in
+  // ascending order, storing what LookupAddress would find for addresses[i]
+  // in results[i], with the names shared.  The default looks each address
+  // up with LookupAddress.
+  virtual void LookupAddresses(const MemAddr *addresses, size_t count,
+                               SymbolizedAddress *results) const;
 
   // If Windows stack walking information is available covering ADDRESS,
   // return a WindowsFrameInfo structure describing it. If the information
@@ -148,8 +198,24 @@ class SourceLineResolverBase::Module {
   // is not available, return NULL. The caller takes ownership of any
   // returned CFIFrameInfo object.
   virtual CFIFrameInfo *FindCFIFrameInfo(const StackFrame *frame) const = 0;
+
+  // Returns true if LookupAddress, FindWindowsFrameInfo and
+  // FindCFIFrameInfo change nothing, so that they may run on several
+  // threads at once.  The default is false.
+  virtual bool CanLookUpConcurrently() const { return false; }
+
+  // Prepares the loaded symbol data for lookups only, trading a little
+  // work up front for faster lookups.  Nothing may be added to the module
+  // afterwards.
+  virtual void Freeze() { }
+
+  // Fills |usage| with the memory that the loaded symbol data takes,
+  // including any data the module refers to in the buffer it was loaded
+  // from.
+  virtual void GetMemoryUsage(ModuleMemoryUsage *usage) const = 0;
  protected:
-  virtual bool ParseCFIRuleSet(const string &rule_set,
+  // Parses the NUL-terminated |rule_set| into |frame_info| in place.
+  virtual bool ParseCFIRuleSet(const char *rule_set,
                                CFIFrameInfo *frame_info) const;
 };
 
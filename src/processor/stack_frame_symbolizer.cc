@@ -36,22 +36,406 @@
 
 #include <assert.h>
 
+#ifndef _WIN32
+#include <pthread.h>
+#endif  // _WIN32
+
+#include <map>
+#include <utility>
+#include <vector>
+
+#include "common/probes.h"
 #include "common/scoped_ptr.h"
+#include "google_breakpad/processor/cfi_frame_info_cache.h"
 #include "google_breakpad/processor/code_module.h"
 #include "google_breakpad/processor/code_modules.h"
+#include "google_breakpad/processor/missing_symbol_cache.h"
+#include "google_breakpad/processor/process_statistics.h"
 #include "google_breakpad/processor/source_line_resolver_interface.h"
 #include "google_breakpad/processor/stack_frame.h"
 #include "google_breakpad/processor/symbol_supplier.h"
 #include "google_breakpad/processor/system_info.h"
+#include "google_breakpad/processor/task_executor.h"
+#include "google_breakpad/processor/walk_budget.h"
+#include "processor/elf_unwind_info.h"
 #include "processor/linked_ptr.h"
 #include "processor/logging.h"
+#include "processor/stopwatch.h"
+#include "processor/symbol_file_index.h"
 
 namespace google_breakpad {
 
+#ifndef _WIN32
+
+// The symbols being fetched by PrefetchSymbols, one entry per module.  Each
+// entry is claimed, under |mutex|, by whichever thread fetches it: the next
+// fetch task to run, or the thread calling FillSourceLineInfo if it needs
+// the module before any fetch task has started on it.  The entry then
+// belongs to that thread until it is marked FETCHED.
+struct StackFrameSymbolizer::SymbolPrefetch {
+  enum State {
+    PENDING,
+    FETCHING,
+    FETCHED,
+    // Handed to FillSourceLineInfo, which loads the symbols into the
+    // resolver.
+    TAKEN
+  };
+
+  struct Entry {
+    Entry() : module(NULL),
+              state(PENDING),
+              result(SymbolSupplier::NOT_FOUND),
+              mappable(false) {}
+
+    const CodeModule* module;
+    State state;
+    SymbolSupplier::SymbolResult result;
+    // Whether symbol_file is a serialized symbol file to map, rather than
+    // the file that symbol_data was read from.
+    bool mappable;
+    string symbol_file;
+    string symbol_data;
+  };
+
+  // Fetches one pending entry, then submits itself again if it found one,
+  // so that no more fetches run at once than there are FetchTasks, and
+  // none holds an executor thread for longer than one fetch.
+  class FetchTask : public Task {
+   public:
+    FetchTask() : prefetch_(NULL) {}
+    explicit FetchTask(SymbolPrefetch* prefetch) : prefetch_(prefetch) {}
+
+    virtual void Run() {
+      if (prefetch_->FetchNext()) {
+        prefetch_->group.Submit(this, TaskExecutor::PRIORITY_SPECULATIVE,
+                                TaskExecutor::STAGE_SYMBOL_FETCH);
+      }
+    }
+
+   private:
+    SymbolPrefetch* prefetch_;
+  };
+
+  // Fetches on |executor|, or on |thread_count| threads of its own if
+  // |executor| is NULL.
+  SymbolPrefetch(TaskExecutor* executor, unsigned int thread_count)
+      : supplier(NULL),
+        system_info(NULL),
+        try_mappable(false),
+        next_entry(0),
+        stopping(false),
+        own_executor(executor ? NULL : new WorkStealingExecutor(thread_count)),
+        group(executor ? executor : own_executor.get()) {
+    pthread_mutex_init(&mutex, NULL);
+    pthread_cond_init(&fetched, NULL);
+  }
+
+  ~SymbolPrefetch() {
+    Stop();
+    pthread_cond_destroy(&fetched);
+    pthread_mutex_destroy(&mutex);
+  }
+
+  // Starts up to |task_count| fetch tasks.
+  void Start(unsigned int task_count) {
+    if (task_count > entries.size())
+      task_count = entries.size();
+    tasks.resize(task_count, FetchTask(this));
+    for (unsigned int i = 0; i < task_count; ++i) {
+      group.Submit(&tasks[i], TaskExecutor::PRIORITY_SPECULATIVE,
+                   TaskExecutor::STAGE_SYMBOL_FETCH);
+    }
+  }
+
+  // Skips the entries not yet started, and waits for the fetches in
+  // progress.
+  void Stop() {
+    pthread_mutex_lock(&mutex);
+    stopping = true;
+    pthread_mutex_unlock(&mutex);
+    group.Wait();
+  }
+
+  // Fetches the symbols for |entry|, the same way FillSourceLineInfo would.
+  // Called without |mutex| held.
+  void Fetch(Entry* entry) {
+    if (try_mappable) {
+      entry->result = supplier->GetMappableSymbolFile(entry->module,
+                                                      system_info,
+                                                      &entry->symbol_file);
+      if (entry->result == SymbolSupplier::FOUND) {
+        entry->mappable = true;
+        return;
+      }
+      if (entry->result == SymbolSupplier::INTERRUPT)
+        return;
+      entry->symbol_file.clear();
+    }
+    entry->result = supplier->GetSymbolFile(entry->module, system_info,
+                                            &entry->symbol_file,
+                                            &entry->symbol_data);
+  }
+
+  // Hands the fetched symbols for |module| over to |taken|, first fetching
+  // them or waiting for their fetch to finish if need be.  Returns false if
+  // |module| isn't part of this prefetch or was already taken.
+  bool Take(const CodeModule* module, Entry* taken) {
+    pthread_mutex_lock(&mutex);
+    std::map<string, size_t>::iterator index =
+        entry_index.find(module->code_file());
+    if (index == entry_index.end() ||
+        entries[index->second].state == TAKEN) {
+      pthread_mutex_unlock(&mutex);
+      return false;
+    }
+
+    Entry* entry = &entries[index->second];
+    if (entry->state == PENDING) {
+      // No prefetch thread has got to this module yet.  Fetching it here
+      // is never slower than waiting for one to.
+      entry->state = FETCHING;
+      pthread_mutex_unlock(&mutex);
+      Fetch(entry);
+      pthread_mutex_lock(&mutex);
+    } else {
+      while (entry->state == FETCHING)
+        pthread_cond_wait(&fetched, &mutex);
+    }
+
+    entry->state = TAKEN;
+    taken->module = entry->module;
+    taken->result = entry->result;
+    taken->mappable = entry->mappable;
+    taken->symbol_file.swap(entry->symbol_file);
+    taken->symbol_data.swap(entry->symbol_data);
+    pthread_mutex_unlock(&mutex);
+    return true;
+  }
+
+  // Fetches the next pending entry.  Returns false if there was none, or
+  // the prefetch is stopping.
+  bool FetchNext() {
+    pthread_mutex_lock(&mutex);
+    while (next_entry < entries.size() &&
+           entries[next_entry].state != PENDING) {
+      ++next_entry;
+    }
+    if (stopping || next_entry == entries.size()) {
+      pthread_mutex_unlock(&mutex);
+      return false;
+    }
+
+    Entry* entry = &entries[next_entry++];
+    entry->state = FETCHING;
+    pthread_mutex_unlock(&mutex);
+    Fetch(entry);
+    pthread_mutex_lock(&mutex);
+    entry->state = FETCHED;
+    pthread_cond_broadcast(&fetched);
+    pthread_mutex_unlock(&mutex);
+    return true;
+  }
+
+  SymbolSupplier* supplier;
+  const SystemInfo* system_info;
+  bool try_mappable;
+
+  // Not resized once the fetch tasks are started, so that an entry can be
+  // used without holding |mutex| by the thread fetching it.
+  std::vector<Entry> entries;
+
+  // Maps each module's code file to its position in |entries|.
+  std::map<string, size_t> entry_index;
+
+  // The first entry that may still be PENDING.
+  size_t next_entry;
+  bool stopping;
+
+  pthread_mutex_t mutex;
+  // Signalled whenever an entry becomes FETCHED.
+  pthread_cond_t fetched;
+
+  scoped_ptr<WorkStealingExecutor> own_executor;
+  TaskGroup group;
+  std::vector<FetchTask> tasks;
+};
+
+#endif  // _WIN32
+
 StackFrameSymbolizer::StackFrameSymbolizer(
     SymbolSupplier* supplier,
     SourceLineResolverInterface* resolver) : supplier_(supplier),
-                                             resolver_(resolver) { }
+                                             resolver_(resolver),
+                                             cfi_frame_info_cache_(NULL),
+                                             missing_symbol_cache_(NULL),
+                                             statistics_(NULL),
+                                             walk_budget_(NULL),
+                                             prefetch_(NULL) { }
+
+StackFrameSymbolizer::~StackFrameSymbolizer() {
+  StopPrefetch();
+  ClearScanIndexes();
+  ClearBinaryUnwindInfos();
+}
+
+void StackFrameSymbolizer::Reset() {
+  StopPrefetch();
+  no_symbol_modules_.clear();
+  ClearScanIndexes();
+  ClearBinaryUnwindInfos();
+}
+
+void StackFrameSymbolizer::ClearScanIndexes() {
+  for (std::map<string, SymbolFileIndex*>::iterator it =
+           scan_indexes_.begin();
+       it != scan_indexes_.end();
+       ++it) {
+    delete it->second;
+  }
+  scan_indexes_.clear();
+}
+
+void StackFrameSymbolizer::ClearBinaryUnwindInfos() {
+  for (std::map<string, ElfUnwindInfo*>::iterator it =
+           binary_unwind_infos_.begin();
+       it != binary_unwind_infos_.end();
+       ++it) {
+    delete it->second;
+  }
+  binary_unwind_infos_.clear();
+}
+
+void StackFrameSymbolizer::RecordSymbolFetch(double seconds) {
+  if (statistics_) {
+    statistics_->symbol_fetch_seconds += seconds;
+    ++statistics_->symbol_fetch_count;
+  }
+}
+
+void StackFrameSymbolizer::RecordSymbolParse(double seconds) {
+  if (statistics_) {
+    statistics_->symbol_parse_seconds += seconds;
+    ++statistics_->symbol_parse_count;
+  }
+}
+
+void StackFrameSymbolizer::PrefetchSymbols(
+    const std::vector<const CodeModule*>& modules,
+    const SystemInfo* system_info,
+    unsigned int thread_count,
+    TaskExecutor* executor) {
+  StopPrefetch();
+#ifndef _WIN32
+  if (thread_count == 0 || !supplier_ || !resolver_)
+    return;
+
+  scoped_ptr<SymbolPrefetch> prefetch(new SymbolPrefetch(executor,
+                                                         thread_count));
+  prefetch->supplier = supplier_;
+  prefetch->system_info = system_info;
+  prefetch->try_mappable =
+      !resolver_->ShouldDeleteMemoryBufferAfterLoadModule();
+  for (std::vector<const CodeModule*>::const_iterator module = modules.begin();
+       module != modules.end();
+       ++module) {
+    if (!*module || resolver_->HasModule(*module) ||
+        no_symbol_modules_.find((*module)->code_file()) !=
+            no_symbol_modules_.end() ||
+        (missing_symbol_cache_ && missing_symbol_cache_->IsMissing(*module))) {
+      continue;
+    }
+    if (prefetch->entry_index.insert(
+            std::make_pair((*module)->code_file(),
+                           prefetch->entries.size())).second) {
+      prefetch->entries.push_back(SymbolPrefetch::Entry());
+      prefetch->entries.back().module = *module;
+    }
+  }
+
+  // If the executor has no threads, the tasks never run before the
+  // prefetch is stopped, and FillSourceLineInfo fetches every module
+  // itself, as it would have without a prefetch.
+  prefetch->Start(thread_count);
+  prefetch_ = prefetch.release();
+#endif  // _WIN32
+}
+
+void StackFrameSymbolizer::StopPrefetch() {
+#ifndef _WIN32
+  if (!prefetch_)
+    return;
+
+  delete prefetch_;
+  prefetch_ = NULL;
+#endif  // _WIN32
+}
+
+bool StackFrameSymbolizer::FillSourceLineInfoFromPrefetch(
+    const CodeModule* module,
+    StackFrame* frame,
+    SymbolizerResult* result) {
+#ifndef _WIN32
+  SymbolPrefetch::Entry entry;
+  Stopwatch fetch_time;
+  if (!prefetch_ || !prefetch_->Take(module, &entry))
+    return false;
+  RecordSymbolFetch(fetch_time.ElapsedSeconds());
+
+  switch (entry.result) {
+    case SymbolSupplier::FOUND:
+      break;
+
+    case SymbolSupplier::NOT_FOUND:
+      no_symbol_modules_.insert(module->code_file());
+      if (missing_symbol_cache_)
+        missing_symbol_cache_->RecordMissing(module);
+      *result = kError;
+      return true;
+
+    case SymbolSupplier::INTERRUPT:
+      *result = kInterrupt;
+      return true;
+
+    default:
+      BPLOG(ERROR) << "Unknown SymbolResult enum: " << entry.result;
+      *result = kError;
+      return true;
+  }
+
+  Stopwatch parse_time;
+  if (entry.mappable) {
+    bool mapped = resolver_->LoadModuleUsingMappedFile(module,
+                                                       entry.symbol_file);
+    RecordSymbolParse(parse_time.ElapsedSeconds());
+    if (!mapped) {
+      // The ordinary path will read the symbols instead.
+      BPLOG(INFO) << "Could not map prefetched symbol file "
+                  << entry.symbol_file;
+      return false;
+    }
+  } else {
+    if (walk_budget_)
+      walk_budget_->ChargeSymbolBytes(entry.symbol_data.size());
+    bool loaded = resolver_->LoadModuleUsingMapBuffer(module,
+                                                      entry.symbol_data);
+    RecordSymbolParse(parse_time.ElapsedSeconds());
+    if (!loaded) {
+      BPLOG(ERROR) << "Failed to load symbol file in resolver.";
+      no_symbol_modules_.insert(module->code_file());
+      *result = kError;
+      return true;
+    }
+  }
+
+  resolver_->FillSourceLineInfo(frame);
+  *result = resolver_->IsModuleCorrupt(module) ?
+      kWarningCorruptSymbols : kNoError;
+  return true;
+#else  // _WIN32
+  return false;
+#endif  // _WIN32
+}
 
 StackFrameSymbolizer::SymbolizerResult StackFrameSymbolizer::FillSourceLineInfo(
     const CodeModules* modules,
@@ -83,19 +467,141 @@ StackFrameSymbolizer::SymbolizerResult StackFrameSymbolizer::FillSourceLineInfo(
     return kError;
   }
 
+  // Skip modules whose symbols were found to be missing recently, perhaps
+  // while processing another minidump.
+  if (missing_symbol_cache_ && missing_symbol_cache_->IsMissing(module)) {
+    no_symbol_modules_.insert(module->code_file());
+    return kError;
+  }
+
+  // A resolver sharing a cache may already hold the same symbols under
+  // another debug file or identifier, if the supplier knows their digest.
+  // Nothing is parsed then, so this comes first.
+  if (resolver_->CanShareModulesByDigest()) {
+    string digest;
+    SymbolSupplier::SymbolResult digest_result =
+        supplier_->GetSymbolFileDigest(module, system_info, &digest);
+    if (digest_result == SymbolSupplier::INTERRUPT)
+      return kInterrupt;
+    if (digest_result == SymbolSupplier::FOUND &&
+        resolver_->LoadModuleUsingDigest(frame->module, digest)) {
+      resolver_->FillSourceLineInfo(frame);
+      return resolver_->IsModuleCorrupt(frame->module) ?
+          kWarningCorruptSymbols : kNoError;
+    }
+  }
+
+  // Resolvers that have been asked to may parse just the records they need
+  // from an indexed symbol file, if the supplier has one.  This is
+  // cheapest of the rest, so it comes next.
+  if (resolver_->CanLoadModulesUsingIndexedFiles()) {
+    string indexed_file;
+    string index_file;
+    Stopwatch fetch_time;
+    SymbolSupplier::SymbolResult indexed_result =
+        supplier_->GetIndexedSymbolFile(module, system_info, &indexed_file,
+                                        &index_file);
+    if (indexed_result == SymbolSupplier::INTERRUPT)
+      return kInterrupt;
+    if (indexed_result == SymbolSupplier::FOUND) {
+      RecordSymbolFetch(fetch_time.ElapsedSeconds());
+      Stopwatch parse_time;
+      bool loaded = resolver_->LoadModuleUsingIndexedFile(frame->module,
+                                                          indexed_file,
+                                                          index_file);
+      RecordSymbolParse(parse_time.ElapsedSeconds());
+      if (loaded) {
+        resolver_->FillSourceLineInfo(frame);
+        return resolver_->IsModuleCorrupt(frame->module) ?
+            kWarningCorruptSymbols : kNoError;
+      }
+    }
+  }
+
+  // Resolvers that let go of their symbol data once it is loaded can parse
+  // a compressed symbol file as it is decompressed, if the supplier has
+  // one.  PrefetchSymbols only fetches uncompressed symbols, so this comes
+  // first.
+  if (resolver_->ShouldDeleteMemoryBufferAfterLoadModule()) {
+    string compressed_file;
+    Stopwatch fetch_time;
+    SymbolSupplier::SymbolResult compressed_result =
+        supplier_->GetCompressedSymbolFile(module, system_info,
+                                           &compressed_file);
+    if (compressed_result == SymbolSupplier::INTERRUPT)
+      return kInterrupt;
+    if (compressed_result == SymbolSupplier::FOUND) {
+      // Only count the lookup as a fetch if it found something, as most
+      // symbol stores have no compressed files.
+      RecordSymbolFetch(fetch_time.ElapsedSeconds());
+      Stopwatch parse_time;
+      bool loaded = resolver_->LoadModuleUsingCompressedFile(frame->module,
+                                                             compressed_file);
+      RecordSymbolParse(parse_time.ElapsedSeconds());
+      if (loaded) {
+        resolver_->FillSourceLineInfo(frame);
+        return resolver_->IsModuleCorrupt(frame->module) ?
+            kWarningCorruptSymbols : kNoError;
+      }
+      BPLOG(INFO) << "Could not load compressed symbol file "
+                  << compressed_file << ", reading symbols instead";
+    }
+  }
+
+  // Use the symbols fetched by PrefetchSymbols, if there are any.
+  SymbolizerResult prefetch_result;
+  if (FillSourceLineInfoFromPrefetch(module, frame, &prefetch_result))
+    return prefetch_result;
+
+  // Resolvers that use their symbol data in place can map a serialized
+  // symbol file, if the supplier has one, rather than read the symbols.
+  if (!resolver_->ShouldDeleteMemoryBufferAfterLoadModule()) {
+    string mappable_file;
+    Stopwatch fetch_time;
+    SymbolSupplier::SymbolResult mappable_result =
+        supplier_->GetMappableSymbolFile(module, system_info, &mappable_file);
+    RecordSymbolFetch(fetch_time.ElapsedSeconds());
+    if (mappable_result == SymbolSupplier::INTERRUPT)
+      return kInterrupt;
+    if (mappable_result == SymbolSupplier::FOUND) {
+      Stopwatch parse_time;
+      bool mapped = resolver_->LoadModuleUsingMappedFile(frame->module,
+                                                         mappable_file);
+      RecordSymbolParse(parse_time.ElapsedSeconds());
+      if (mapped) {
+        resolver_->FillSourceLineInfo(frame);
+        return resolver_->IsModuleCorrupt(frame->module) ?
+            kWarningCorruptSymbols : kNoError;
+      }
+      BPLOG(INFO) << "Could not map symbol file " << mappable_file
+                  << ", reading symbols instead";
+    }
+  }
+
   // Start fetching symbol from supplier.
   string symbol_file;
   char* symbol_data = NULL;
   size_t symbol_data_size;
+  Stopwatch fetch_time;
+  BREAKPAD_PROBE1(symbols__fetch__start, module->code_file().c_str());
   SymbolSupplier::SymbolResult symbol_result = supplier_->GetCStringSymbolData(
       module, system_info, &symbol_file, &symbol_data, &symbol_data_size);
+  BREAKPAD_PROBE3(symbols__fetch__done, module->code_file().c_str(),
+                  static_cast<int>(symbol_result),
+                  symbol_result == SymbolSupplier::FOUND ?
+                      symbol_data_size : 0);
+  RecordSymbolFetch(fetch_time.ElapsedSeconds());
 
   switch (symbol_result) {
     case SymbolSupplier::FOUND: {
+      if (walk_budget_)
+        walk_budget_->ChargeSymbolBytes(symbol_data_size);
+      Stopwatch parse_time;
       bool load_success = resolver_->LoadModuleUsingMemoryBuffer(
           frame->module,
           symbol_data,
           symbol_data_size);
+      RecordSymbolParse(parse_time.ElapsedSeconds());
       if (resolver_->ShouldDeleteMemoryBufferAfterLoadModule()) {
         supplier_->FreeSymbolData(module);
       }
@@ -113,6 +619,8 @@ StackFrameSymbolizer::SymbolizerResult StackFrameSymbolizer::FillSourceLineInfo(
 
     case SymbolSupplier::NOT_FOUND:
       no_symbol_modules_.insert(module->code_file());
+      if (missing_symbol_cache_)
+        missing_symbol_cache_->RecordMissing(module);
       return kError;
 
     case SymbolSupplier::INTERRUPT:
@@ -125,6 +633,105 @@ StackFrameSymbolizer::SymbolizerResult StackFrameSymbolizer::FillSourceLineInfo(
   return kError;
 }
 
+StackFrameSymbolizer::SymbolizerResult
+StackFrameSymbolizer::FillDeferredSourceLines(const SystemInfo* system_info,
+                                              StackFrame* frame) {
+  assert(frame);
+  if (!frame->module || !resolver_ || !resolver_->HasModule(frame->module))
+    return kError;
+  if (!resolver_->HasDeferredSourceLines(frame->module)) {
+    resolver_->FillSourceLineInfo(frame);
+    return resolver_->IsModuleCorrupt(frame->module) ?
+        kWarningCorruptSymbols : kNoError;
+  }
+  if (!supplier_)
+    return kError;
+
+  string symbol_file;
+  char* symbol_data = NULL;
+  size_t symbol_data_size;
+  Stopwatch fetch_time;
+  BREAKPAD_PROBE1(symbols__fetch__start, frame->module->code_file().c_str());
+  SymbolSupplier::SymbolResult symbol_result = supplier_->GetCStringSymbolData(
+      frame->module, system_info, &symbol_file, &symbol_data,
+      &symbol_data_size);
+  BREAKPAD_PROBE3(symbols__fetch__done, frame->module->code_file().c_str(),
+                  static_cast<int>(symbol_result),
+                  symbol_result == SymbolSupplier::FOUND ?
+                      symbol_data_size : 0);
+  RecordSymbolFetch(fetch_time.ElapsedSeconds());
+  if (symbol_result == SymbolSupplier::INTERRUPT)
+    return kInterrupt;
+  if (symbol_result != SymbolSupplier::FOUND)
+    return kError;
+
+  if (walk_budget_)
+    walk_budget_->ChargeSymbolBytes(symbol_data_size);
+  Stopwatch parse_time;
+  bool load_success = resolver_->LoadSourceLinesUsingMemoryBuffer(
+      frame->module, symbol_data, symbol_data_size);
+  RecordSymbolParse(parse_time.ElapsedSeconds());
+  supplier_->FreeSymbolData(frame->module);
+  if (!load_success)
+    return kError;
+
+  resolver_->FillSourceLineInfo(frame);
+  return resolver_->IsModuleCorrupt(frame->module) ?
+      kWarningCorruptSymbols : kNoError;
+}
+
+bool StackFrameSymbolizer::IsInFunctionWithoutLoading(
+    const CodeModule* module,
+    const SystemInfo* system_info,
+    uint64_t address,
+    bool* in_function) {
+  assert(in_function);
+  if (!module || !resolver_ || !supplier_ || resolver_->HasModule(module) ||
+      no_symbol_modules_.find(module->code_file()) !=
+          no_symbol_modules_.end()) {
+    return false;
+  }
+
+  std::map<string, SymbolFileIndex*>::iterator it =
+      scan_indexes_.find(module->code_file());
+  if (it == scan_indexes_.end()) {
+    SymbolFileIndex* index = NULL;
+    string symbol_file;
+    string index_file;
+    Stopwatch fetch_time;
+    SymbolSupplier::SymbolResult result =
+        supplier_->GetIndexedSymbolFile(module, system_info, &symbol_file,
+                                        &index_file);
+    if (result == SymbolSupplier::INTERRUPT)
+      return false;
+    if (result == SymbolSupplier::FOUND) {
+      RecordSymbolFetch(fetch_time.ElapsedSeconds());
+      index = SymbolFileIndex::Open(symbol_file, index_file);
+    }
+    it = scan_indexes_.insert(std::make_pair(module->code_file(),
+                                             index)).first;
+  }
+  const SymbolFileIndex* index = it->second;
+  if (!index)
+    return false;
+
+  // This follows how the resolvers name a frame: the function covering the
+  // address if there is one, or else the nearest public symbol below it.
+  uint64_t module_address = address - module->base_address();
+  size_t i;
+  if (index->FindNearest(SymbolFileIndex::FUNCTIONS, module_address, &i)) {
+    const SymbolFileIndexEntry& function =
+        index->entry(SymbolFileIndex::FUNCTIONS, i);
+    if (module_address - function.address < function.size) {
+      *in_function = true;
+      return true;
+    }
+  }
+  *in_function = index->FindNearest(SymbolFileIndex::PUBLICS, module_address,
+                                    &i);
+  return true;
+}
+
 WindowsFrameInfo* StackFrameSymbolizer::FindWindowsFrameInfo(
     const StackFrame* frame) {
   return resolver_ ? resolver_->FindWindowsFrameInfo(frame) : NULL;
@@ -132,7 +739,120 @@ WindowsFrameInfo* StackFrameSymbolizer::FindWindowsFrameInfo(
 
 CFIFrameInfo* StackFrameSymbolizer::FindCFIFrameInfo(
     const StackFrame* frame) {
-  return resolver_ ? resolver_->FindCFIFrameInfo(frame) : NULL;
+  if (!resolver_)
+    return NULL;
+  if (!cfi_frame_info_cache_ || !frame->module)
+    return FindUncachedCFIFrameInfo(frame);
+
+  CFIFrameInfo* cfi_frame_info;
+  if (cfi_frame_info_cache_->Lookup(frame->module, frame->instruction,
+                                    &cfi_frame_info)) {
+    return cfi_frame_info;
+  }
+
+  cfi_frame_info = FindUncachedCFIFrameInfo(frame);
+  // Having no rules only means something once the module's symbols are
+  // loaded; they may merely be unavailable for now.
+  if (cfi_frame_info || resolver_->HasModule(frame->module)) {
+    cfi_frame_info_cache_->Store(frame->module, frame->instruction,
+                                 cfi_frame_info);
+  }
+  return cfi_frame_info;
+}
+
+bool StackFrameSymbolizer::FillLoadedSourceLineInfo(
+    const CodeModules* modules,
+    StackFrame* frame,
+    SymbolizerResult* result) {
+  assert(frame);
+  assert(result);
+  if (!modules || !resolver_)
+    return false;
+  const CodeModule* module = modules->GetModuleForAddress(frame->instruction);
+  if (!module || !resolver_->CanLookUpConcurrently(module) ||
+      no_symbol_modules_.find(module->code_file()) !=
+          no_symbol_modules_.end()) {
+    return false;
+  }
+  frame->module = module;
+  resolver_->FillSourceLineInfo(frame);
+  *result = resolver_->IsModuleCorrupt(module) ?
+      kWarningCorruptSymbols : kNoError;
+  return true;
+}
+
+bool StackFrameSymbolizer::FindLoadedWindowsFrameInfo(
+    const StackFrame* frame,
+    WindowsFrameInfo** frame_info) {
+  assert(frame_info);
+  if (!resolver_ || !frame->module ||
+      !resolver_->CanLookUpConcurrently(frame->module)) {
+    return false;
+  }
+  *frame_info = resolver_->FindWindowsFrameInfo(frame);
+  return true;
+}
+
+bool StackFrameSymbolizer::FindLoadedCFIFrameInfo(
+    const StackFrame* frame,
+    CFIFrameInfo** cfi_frame_info) {
+  assert(cfi_frame_info);
+  if (!resolver_ || !frame->module ||
+      !resolver_->CanLookUpConcurrently(frame->module)) {
+    return false;
+  }
+  // The cache is thread-safe.  With the module loaded, the rules come from
+  // its symbols and are cached even if there are none.
+  if (cfi_frame_info_cache_ &&
+      cfi_frame_info_cache_->Lookup(frame->module, frame->instruction,
+                                    cfi_frame_info)) {
+    return true;
+  }
+  *cfi_frame_info = resolver_->FindCFIFrameInfo(frame);
+  if (cfi_frame_info_cache_) {
+    cfi_frame_info_cache_->Store(frame->module, frame->instruction,
+                                 *cfi_frame_info);
+  }
+  return true;
+}
+
+CFIFrameInfo* StackFrameSymbolizer::FindUncachedCFIFrameInfo(
+    const StackFrame* frame) {
+  CFIFrameInfo* cfi_frame_info = resolver_->FindCFIFrameInfo(frame);
+  if (cfi_frame_info || !frame->module || !supplier_ ||
+      resolver_->HasModule(frame->module)) {
+    return cfi_frame_info;
+  }
+
+  // Without symbols for the module, the rules may still be in its binary.
+  const CodeModule* module = frame->module;
+  std::map<string, ElfUnwindInfo*>::iterator it =
+      binary_unwind_infos_.find(module->code_file());
+  if (it == binary_unwind_infos_.end()) {
+    ElfUnwindInfo* unwind_info = NULL;
+    string binary_file;
+    SymbolSupplier::SymbolResult result =
+        supplier_->GetBinaryFile(module, NULL, &binary_file);
+    if (result == SymbolSupplier::INTERRUPT)
+      return NULL;
+    if (result == SymbolSupplier::FOUND) {
+      unwind_info = ElfUnwindInfo::Open(binary_file);
+      if (unwind_info &&
+          unwind_info->debug_identifier() != module->debug_identifier()) {
+        BPLOG(ERROR) << "Binary " << binary_file << " has identifier "
+                     << unwind_info->debug_identifier() << ", not "
+                     << module->debug_identifier();
+        delete unwind_info;
+        unwind_info = NULL;
+      }
+    }
+    it = binary_unwind_infos_.insert(std::make_pair(module->code_file(),
+                                                    unwind_info)).first;
+  }
+  if (!it->second)
+    return NULL;
+  return it->second->FindCFIFrameInfo(frame->instruction -
+                                      module->base_address());
 }
 
 }  // namespace google_breakpad
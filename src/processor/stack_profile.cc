@@ -0,0 +1,161 @@
+// Copyright (c) 2016 Google Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+// notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above
+// copyright notice, this list of conditions and the following disclaimer
+// in the documentation and/or other materials provided with the
+// distribution.
+//     * Neither the name of Google Inc. nor the names of its
+// contributors may be used to endorse or promote products derived from
+// this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+// stack_profile.cc: Implementation of StackProfile.
+//
+// See stack_profile.h for documentation.
+
+#include "processor/stack_profile.h"
+
+#include <stdio.h>
+
+#include <algorithm>
+
+#include "google_breakpad/processor/call_stack.h"
+#include "google_breakpad/processor/code_module.h"
+#include "google_breakpad/processor/process_state.h"
+#include "google_breakpad/processor/stack_frame.h"
+
+namespace google_breakpad {
+
+namespace {
+
+using std::vector;
+
+// Appends |value| to |out| in hexadecimal, with a 0x prefix.
+void AppendHex(uint64_t value, string *out) {
+  char buffer[19];
+  snprintf(buffer, sizeof(buffer), "0x%llx",
+           static_cast<unsigned long long>(value));
+  out->append(buffer);
+}
+
+}  // namespace
+
+StackProfile::StackProfile()
+    : sample_count_(0),
+      stack_count_(0) {
+  nodes_.push_back(Node(0, 0));
+}
+
+void StackProfile::Add(const ProcessState &process_state) {
+  const vector<CallStack*> *threads = process_state.threads();
+  for (size_t thread_index = 0; thread_index < threads->size();
+       ++thread_index) {
+    const vector<StackFrame*> *frames = threads->at(thread_index)->frames();
+    if (frames->empty())
+      continue;
+    // Frames are ordered innermost first; the trie, outermost first.
+    uint32_t node = 0;
+    for (size_t frame_index = frames->size(); frame_index > 0;
+         --frame_index) {
+      node = Child(node, InternFrameName(frames->at(frame_index - 1)));
+    }
+    if (nodes_[node].samples++ == 0)
+      ++stack_count_;
+    ++sample_count_;
+  }
+}
+
+bool StackProfile::WriteFolded(FILE *file) const {
+  vector<string> lines;
+  lines.reserve(stack_count_);
+  vector<uint32_t> path;
+  for (size_t node = 1; node < nodes_.size(); ++node) {
+    if (nodes_[node].samples == 0)
+      continue;
+    path.clear();
+    for (uint32_t ancestor = node; ancestor != 0;
+         ancestor = nodes_[ancestor].parent) {
+      path.push_back(nodes_[ancestor].name);
+    }
+    string line;
+    for (size_t i = path.size(); i > 0; --i) {
+      line.append(names_[path[i - 1]]);
+      line.push_back(i > 1 ? ';' : ' ');
+    }
+    char count[24];
+    snprintf(count, sizeof(count), "%llu\n",
+             static_cast<unsigned long long>(nodes_[node].samples));
+    line.append(count);
+    lines.push_back(line);
+  }
+
+  std::sort(lines.begin(), lines.end());
+  for (size_t i = 0; i < lines.size(); ++i) {
+    if (fwrite(lines[i].data(), 1, lines[i].size(), file) != lines[i].size())
+      return false;
+  }
+  return fflush(file) == 0;
+}
+
+uint32_t StackProfile::InternFrameName(const StackFrame *frame) {
+  uint64_t instruction = frame->ReturnAddress();
+  name_.clear();
+  if (frame->module) {
+    const string &code_file = frame->module->code_file();
+    string::size_type slash = code_file.find_last_of("/\\");
+    name_.append(code_file, slash == string::npos ? 0 : slash + 1,
+                 string::npos);
+    const char *function_name = frame->FunctionName();
+    if (function_name[0] != '\0') {
+      name_.push_back('!');
+      name_.append(function_name);
+    } else {
+      name_.push_back('+');
+      AppendHex(instruction - frame->module->base_address(), &name_);
+    }
+  } else {
+    AppendHex(instruction, &name_);
+  }
+  // Semicolons separate frames, and a line ends the stack.
+  for (size_t i = 0; i < name_.size(); ++i) {
+    if (name_[i] == ';' || name_[i] == '\n')
+      name_[i] = '_';
+  }
+
+  uint32_t index = static_cast<uint32_t>(names_.size());
+  std::pair<unordered_map<string, uint32_t>::iterator, bool> inserted =
+      name_indices_.insert(std::make_pair(name_, index));
+  if (inserted.second)
+    names_.push_back(name_);
+  return inserted.first->second;
+}
+
+uint32_t StackProfile::Child(uint32_t parent, uint32_t name) {
+  uint64_t key = static_cast<uint64_t>(parent) << 32 | name;
+  uint32_t index = static_cast<uint32_t>(nodes_.size());
+  std::pair<unordered_map<uint64_t, uint32_t>::iterator, bool> inserted =
+      children_.insert(std::make_pair(key, index));
+  if (inserted.second)
+    nodes_.push_back(Node(parent, name));
+  return inserted.first->second;
+}
+
+}  // namespace google_breakpad
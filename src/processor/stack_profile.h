@@ -0,0 +1,123 @@
+// Copyright (c) 2016 Google Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+// notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above
+// copyright notice, this list of conditions and the following disclaimer
+// in the documentation and/or other materials provided with the
+// distribution.
+//     * Neither the name of Google Inc. nor the names of its
+// contributors may be used to endorse or promote products derived from
+// this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+// stack_profile.h: StackProfile, which aggregates the stacks of many
+// process states into one profile in the folded-stack format read by
+// flame graph tools.
+//
+// Each thread of each process state added counts as one sample of its
+// stack.  Stacks are merged into a trie, from the outermost frame in,
+// whose nodes refer to frame names interned once each, so that the
+// profile of thousands of minidumps of the same builds takes little more
+// memory than their distinct stacks.
+//
+// A frame is named "module!function" if its function is known,
+// "module+0xoffset" if only its module is, and "0xaddress" otherwise,
+// where module is the file name of the module's code file.  The folded
+// output has one line per distinct stack: its frame names, outermost
+// first and separated by semicolons, a space and the number of samples.
+
+#ifndef PROCESSOR_STACK_PROFILE_H__
+#define PROCESSOR_STACK_PROFILE_H__
+
+#include <stdio.h>
+
+#include <string>
+#include <vector>
+
+#include "common/unordered.h"
+#include "common/using_std_string.h"
+#include "google_breakpad/common/breakpad_types.h"
+
+namespace google_breakpad {
+
+class ProcessState;
+class StackFrame;
+
+class StackProfile {
+ public:
+  StackProfile();
+
+  // Adds a sample for the stack of every thread of |process_state|.
+  void Add(const ProcessState &process_state);
+
+  // Writes the profile to |file| in the folded-stack format, one line per
+  // distinct stack, sorted.  Returns false if writing failed.
+  bool WriteFolded(FILE *file) const;
+
+  // The number of samples added, of distinct stacks among them, and of
+  // distinct frame names.
+  uint64_t sample_count() const { return sample_count_; }
+  size_t stack_count() const { return stack_count_; }
+  size_t name_count() const { return names_.size(); }
+
+ private:
+  struct Node {
+    Node(uint32_t parent, uint32_t name)
+        : parent(parent), name(name), samples(0) {}
+
+    // The caller's node, and the index of the frame's name in names_.
+    uint32_t parent;
+    uint32_t name;
+
+    // The samples whose stack ends at this frame.
+    uint64_t samples;
+  };
+
+  // Returns the index in names_ of the name of |frame|, adding it if it
+  // is new.
+  uint32_t InternFrameName(const StackFrame *frame);
+
+  // Returns the node for the frame named |name| called from |parent|,
+  // adding it if it is new.
+  uint32_t Child(uint32_t parent, uint32_t name);
+
+  // The distinct frame names, and the index of each.
+  std::vector<string> names_;
+  unordered_map<string, uint32_t> name_indices_;
+
+  // The trie, whose root, node 0, stands for no frame, and the index of
+  // each node by its parent and name, as parent << 32 | name.
+  std::vector<Node> nodes_;
+  unordered_map<uint64_t, uint32_t> children_;
+
+  uint64_t sample_count_;
+  size_t stack_count_;
+
+  // Reused to build each frame name.
+  string name_;
+
+  // Disallow copy constructor and assignment operator.
+  StackProfile(const StackProfile&);
+  void operator=(const StackProfile&);
+};
+
+}  // namespace google_breakpad
+
+#endif  // PROCESSOR_STACK_PROFILE_H__
@@ -0,0 +1,134 @@
+// Copyright (c) 2016 Google Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+// notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above
+// copyright notice, this list of conditions and the following disclaimer
+// in the documentation and/or other materials provided with the
+// distribution.
+//     * Neither the name of Google Inc. nor the names of its
+// contributors may be used to endorse or promote products derived from
+// this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+// stack_profile_unittest.cc: Unit tests for StackProfile.
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <algorithm>
+#include <string>
+
+#include "breakpad_googletest_includes.h"
+#include "common/using_std_string.h"
+#include "google_breakpad/processor/basic_source_line_resolver.h"
+#include "google_breakpad/processor/minidump_processor.h"
+#include "google_breakpad/processor/process_state.h"
+#include "processor/simple_symbol_supplier.h"
+#include "processor/stack_profile.h"
+
+namespace {
+
+using google_breakpad::BasicSourceLineResolver;
+using google_breakpad::MinidumpProcessor;
+using google_breakpad::ProcessState;
+using google_breakpad::SimpleSymbolSupplier;
+using google_breakpad::StackProfile;
+
+string TestDataDir() {
+  return string(getenv("srcdir") ? getenv("srcdir") : ".") +
+      "/src/processor/testdata";
+}
+
+// The crashed thread of minidump2.dmp, the only one it has.
+const char kSymbolizedStack[] =
+    "kernel32.dll!BaseProcessStart;"
+    "test_app.exe!__tmainCRTStartup;"
+    "test_app.exe!main;"
+    "test_app.exe!`anonymous namespace'::CrashFunction";
+
+class StackProfileTest : public ::testing::Test {
+ public:
+  // Processes minidump2.dmp into |state|, with symbols if |symbolize|.
+  void Process(bool symbolize, ProcessState *state) {
+    SimpleSymbolSupplier supplier(TestDataDir() + "/symbols");
+    BasicSourceLineResolver resolver;
+    MinidumpProcessor processor(symbolize ? &supplier : NULL, &resolver);
+    ASSERT_EQ(google_breakpad::PROCESS_OK,
+              processor.Process(TestDataDir() + "/minidump2.dmp", state));
+  }
+
+  string Folded() {
+    FILE *file = tmpfile();
+    EXPECT_TRUE(file != NULL);
+    if (!file)
+      return string();
+    EXPECT_TRUE(profile_.WriteFolded(file));
+    string contents;
+    rewind(file);
+    char buffer[4096];
+    size_t read;
+    while ((read = fread(buffer, 1, sizeof(buffer), file)) > 0)
+      contents.append(buffer, read);
+    fclose(file);
+    return contents;
+  }
+
+  StackProfile profile_;
+};
+
+TEST_F(StackProfileTest, Empty) {
+  EXPECT_EQ(0U, profile_.sample_count());
+  EXPECT_EQ(0U, profile_.stack_count());
+  EXPECT_EQ("", Folded());
+}
+
+TEST_F(StackProfileTest, MergesIdenticalStacks) {
+  ProcessState state;
+  Process(true, &state);
+  for (int i = 0; i < 3; ++i)
+    profile_.Add(state);
+
+  EXPECT_EQ(3U, profile_.sample_count());
+  EXPECT_EQ(1U, profile_.stack_count());
+  EXPECT_EQ(4U, profile_.name_count());
+  EXPECT_EQ(string(kSymbolizedStack) + " 3\n", Folded());
+}
+
+TEST_F(StackProfileTest, SeparatesDistinctStacks) {
+  ProcessState symbolized;
+  Process(true, &symbolized);
+  ProcessState unsymbolized;
+  Process(false, &unsymbolized);
+  profile_.Add(symbolized);
+  profile_.Add(unsymbolized);
+  profile_.Add(symbolized);
+
+  EXPECT_EQ(3U, profile_.sample_count());
+  EXPECT_EQ(2U, profile_.stack_count());
+
+  // Without symbols, the innermost frame is named by its module offset.
+  string folded = Folded();
+  EXPECT_NE(string::npos,
+            folded.find(string(kSymbolizedStack) + " 2\n"));
+  EXPECT_NE(string::npos, folded.find("test_app.exe+0x429e 1\n"));
+  EXPECT_EQ(2, std::count(folded.begin(), folded.end(), '\n'));
+}
+
+}  // namespace
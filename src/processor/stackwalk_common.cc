@@ -50,6 +50,7 @@
 #include "google_breakpad/processor/stack_frame_cpu.h"
 #include "processor/logging.h"
 #include "processor/pathname_stripper.h"
+#include "processor/process_state_json_writer.h"
 
 namespace google_breakpad {
 
@@ -132,10 +133,10 @@ static void PrintStack(const CallStack *stack, const string &cpu) {
 
     if (frame->module) {
       printf("%s", PathnameStripper::File(frame->module->code_file()).c_str());
-      if (!frame->function_name.empty()) {
-        printf("!%s", frame->function_name.c_str());
-        if (!frame->source_file_name.empty()) {
-          string source_file = PathnameStripper::File(frame->source_file_name);
+      if (frame->FunctionName()[0] != '\0') {
+        printf("!%s", frame->FunctionName());
+        if (frame->SourceFileName()[0] != '\0') {
+          string source_file = PathnameStripper::File(frame->SourceFileName());
           printf(" [%s : %d + 0x%" PRIx64 "]",
                  source_file.c_str(),
                  frame->source_line,
@@ -470,6 +471,8 @@ static void PrintStack(const CallStack *stack, const string &cpu) {
     }
     printf("\n    Found by: %s\n", frame->trust_description().c_str());
   }
+  if (stack->truncated())
+    printf(" <stack walk stopped by its budget>\n");
 }
 
 // PrintStackMachineReadable prints the call stack in |stack| to stdout,
@@ -492,13 +495,13 @@ static void PrintStackMachineReadable(int thread_num, const CallStack *stack) {
       assert(!frame->module->code_file().empty());
       printf("%s", StripSeparator(PathnameStripper::File(
                      frame->module->code_file())).c_str());
-      if (!frame->function_name.empty()) {
+      if (frame->FunctionName()[0] != '\0') {
         printf("%c%s", kOutputSeparator,
-               StripSeparator(frame->function_name).c_str());
-        if (!frame->source_file_name.empty()) {
+               StripSeparator(frame->FunctionName()).c_str());
+        if (frame->SourceFileName()[0] != '\0') {
           printf("%c%s%c%d%c0x%" PRIx64,
                  kOutputSeparator,
-                 StripSeparator(frame->source_file_name).c_str(),
+                 StripSeparator(frame->SourceFileName()).c_str(),
                  kOutputSeparator,
                  frame->source_line,
                  kOutputSeparator,
@@ -776,4 +779,11 @@ void PrintProcessStateMachineReadable(const ProcessState& process_state) {
   }
 }
 
+void PrintProcessStateJSON(const ProcessState& process_state) {
+  ProcessStateJSONWriter writer;
+  writer.Write(process_state);
+  fwrite(writer.data(), 1, writer.size(), stdout);
+  printf("\n");
+}
+
 }  // namespace google_breakpad
@@ -41,6 +41,10 @@ class ProcessState;
 void PrintProcessStateMachineReadable(const ProcessState& process_state);
 void PrintProcessState(const ProcessState& process_state);
 
+// Prints |process_state| to stdout as one line of JSON, in the format
+// written by ProcessStateJSONWriter.
+void PrintProcessStateJSON(const ProcessState& process_state);
+
 }  // namespace google_breakpad
 
 #endif  // PROCESSOR_STACKWALK_COMMON_H__
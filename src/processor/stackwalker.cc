@@ -37,6 +37,9 @@
 
 #include <assert.h>
 
+#include <algorithm>
+
+#include "common/probes.h"
 #include "common/scoped_ptr.h"
 #include "google_breakpad/processor/call_stack.h"
 #include "google_breakpad/processor/code_module.h"
@@ -45,6 +48,7 @@
 #include "google_breakpad/processor/stack_frame.h"
 #include "google_breakpad/processor/stack_frame_symbolizer.h"
 #include "google_breakpad/processor/system_info.h"
+#include "google_breakpad/processor/unwind_policy.h"
 #include "processor/linked_ptr.h"
 #include "processor/logging.h"
 #include "processor/stackwalker_ppc.h"
@@ -55,6 +59,7 @@
 #include "processor/stackwalker_arm.h"
 #include "processor/stackwalker_arm64.h"
 #include "processor/stackwalker_mips.h"
+#include "processor/symbolized_frame_memo.h"
 
 namespace google_breakpad {
 
@@ -72,7 +77,21 @@ Stackwalker::Stackwalker(const SystemInfo* system_info,
     : system_info_(system_info),
       memory_(memory),
       modules_(modules),
-      frame_symbolizer_(frame_symbolizer) {
+      frame_symbolizer_(frame_symbolizer),
+      frame_arena_(NULL),
+      walk_budget_(NULL),
+      walk_budget_ran_out_(false),
+      frame_memo_(NULL),
+      unwind_policy_(NULL),
+      policy_module_(NULL),
+      policy_methods_(0),
+      stack_view_(NULL),
+      stack_view_base_(0),
+      stack_view_size_(0),
+      module_bounds_computed_(false),
+      modules_lowest_(0),
+      modules_highest_(0),
+      scanned_modules_(NULL) {
   assert(frame_symbolizer_);
 }
 
@@ -124,6 +143,19 @@ bool Stackwalker::Walk(
   // so far, as the caller may have set a limit.
   uint32_t scanned_frames = 0;
 
+  walk_budget_ran_out_ = false;
+  scanned_modules_ = &stack->scanned_modules_;
+
+  stack_view_ = NULL;
+  if (memory_ && memory_->GetSize() > 0) {
+    stack_view_base_ = memory_->GetBase();
+    stack_view_size_ = memory_->GetSize();
+    stack_view_ = memory_->GetContiguousMemory(stack_view_base_,
+                                               stack_view_size_);
+  }
+
+  BREAKPAD_PROBE(stackwalk__start);
+
   // Take ownership of the pointer returned by GetContextFrame.
   scoped_ptr<StackFrame> frame(GetContextFrame());
 
@@ -134,11 +166,11 @@ bool Stackwalker::Walk(
 
     // Resolve the module information, if a module map was provided.
     StackFrameSymbolizer::SymbolizerResult symbolizer_result =
-        frame_symbolizer_->FillSourceLineInfo(modules_, system_info_,
-                                             frame.get());
+        SymbolizeFrame(frame.get());
     switch (symbolizer_result) {
       case StackFrameSymbolizer::kInterrupt:
         BPLOG(INFO) << "Stack walk is interrupted.";
+        scanned_modules_ = NULL;
         return false;
         break;
       case StackFrameSymbolizer::kError:
@@ -167,6 +199,9 @@ bool Stackwalker::Walk(
         break;
     }
 
+    BREAKPAD_PROBE3(stackwalk__frame, stack->frames_.size(),
+                    frame->instruction, static_cast<int>(frame->trust));
+
     // Add the frame to the call stack.  Relinquish the ownership claim
     // over the frame, because the stack now owns it.
     stack->frames_.push_back(frame.release());
@@ -178,11 +213,27 @@ bool Stackwalker::Walk(
       break;
     }
 
+    // Keep the frames walked so far once the budget runs out.
+    if (walk_budget_ && !walk_budget_->ChargeFrame()) {
+      BPLOG(INFO) << "Stack walk stopped by its budget after "
+                  << stack->frames_.size() << " frames.";
+      stack->truncated_ = true;
+      break;
+    }
+
     // Get the next frame and take ownership.
-    bool stack_scan_allowed = scanned_frames < max_frames_scanned_;
+    bool stack_scan_allowed =
+        scanned_frames < max_frames_scanned_ &&
+        (AllowedUnwindMethods(stack->frames_.back()) &
+         UnwindPolicy::METHOD_SCAN) != 0;
     frame.reset(GetCallerFrame(stack, stack_scan_allowed));
   }
 
+  if (walk_budget_ran_out_)
+    stack->truncated_ = true;
+
+  BREAKPAD_PROBE2(stackwalk__done, stack->frames_.size(), scanned_frames);
+  scanned_modules_ = NULL;
   return true;
 }
 
@@ -266,10 +317,30 @@ Stackwalker* Stackwalker::StackwalkerForCPU(
 }
 
 bool Stackwalker::InstructionAddressSeemsValid(uint64_t address) {
+  // Scanning looks at many addresses in modules that end up on no stack,
+  // so judge the address from the module's symbol file index if there is
+  // one, rather than load all of the module's symbols for it.
+  const CodeModule* module =
+      modules_ ? modules_->GetModuleForAddress(address) : NULL;
+  if (!module) {
+    // not inside any loaded module
+    return false;
+  }
+  if (scanned_modules_ &&
+      std::find(scanned_modules_->begin(), scanned_modules_->end(),
+                module) == scanned_modules_->end()) {
+    scanned_modules_->push_back(module);
+  }
+  bool in_function;
+  if (frame_symbolizer_->IsInFunctionWithoutLoading(module, system_info_,
+                                                    address, &in_function)) {
+    return in_function;
+  }
+
   StackFrame frame;
   frame.instruction = address;
   StackFrameSymbolizer::SymbolizerResult symbolizer_result =
-      frame_symbolizer_->FillSourceLineInfo(modules_, system_info_, &frame);
+      SymbolizeFrame(&frame);
 
   if (!frame.module) {
     // not inside any loaded module
@@ -289,7 +360,65 @@ bool Stackwalker::InstructionAddressSeemsValid(uint64_t address) {
     return true;
   }
 
-  return !frame.function_name.empty();
+  return frame.FunctionName()[0] != '\0';
+}
+
+StackFrameSymbolizer::SymbolizerResult Stackwalker::SymbolizeFrame(
+    StackFrame* frame) {
+  StackFrameSymbolizer::SymbolizerResult result;
+  if (frame_memo_ && frame_memo_->Lookup(frame, &result))
+    return result;
+  result = frame_symbolizer_->FillSourceLineInfo(modules_, system_info_,
+                                                 frame);
+  if (frame_memo_)
+    frame_memo_->Store(*frame, result);
+  return result;
+}
+
+int Stackwalker::AllowedUnwindMethods(const StackFrame* frame) {
+  if (!unwind_policy_ || !frame->module)
+    return UnwindPolicy::ALL_METHODS;
+  if (frame->module != policy_module_) {
+    policy_module_ = frame->module;
+    policy_methods_ = unwind_policy_->AllowedMethods(frame->module);
+  }
+  return policy_methods_;
+}
+
+bool Stackwalker::GetModuleAddressBounds(uint64_t* lowest,
+                                         uint64_t* highest) {
+  if (!module_bounds_computed_) {
+    module_bounds_computed_ = true;
+    // An empty span, so that no address passes the check if there are no
+    // usable modules.
+    modules_lowest_ = 1;
+    modules_highest_ = 0;
+    unsigned int count = modules_ ? modules_->module_count() : 0;
+    for (unsigned int i = 0; i < count; ++i) {
+      const CodeModule* module = modules_->GetModuleAtIndex(i);
+      if (!module || module->size() == 0)
+        continue;
+      uint64_t module_lowest = module->base_address();
+      uint64_t module_highest = module_lowest + module->size() - 1;
+      if (module_highest < module_lowest)
+        module_highest = ~static_cast<uint64_t>(0);
+      if (modules_lowest_ > modules_highest_) {
+        modules_lowest_ = module_lowest;
+        modules_highest_ = module_highest;
+      } else {
+        if (module_lowest < modules_lowest_)
+          modules_lowest_ = module_lowest;
+        if (module_highest > modules_highest_)
+          modules_highest_ = module_highest;
+      }
+    }
+  }
+
+  if (modules_lowest_ > modules_highest_)
+    return false;
+  *lowest = modules_lowest_;
+  *highest = modules_highest_;
+  return true;
 }
 
 }  // namespace google_breakpad
@@ -41,6 +41,7 @@
 #include "google_breakpad/processor/source_line_resolver_interface.h"
 #include "google_breakpad/processor/stack_frame_cpu.h"
 #include "google_breakpad/processor/system_info.h"
+#include "google_breakpad/processor/unwind_policy.h"
 #include "processor/cfi_frame_info.h"
 #include "processor/logging.h"
 #include "processor/stackwalker_amd64.h"
@@ -56,39 +57,39 @@ StackwalkerAMD64::cfi_register_map_[] = {
   // unchanged if the CFI doesn't mention them --- clearly wrong for $rip
   // and $rsp.
   { "$rax", NULL, false,
-    StackFrameAMD64::CONTEXT_VALID_RAX, &MDRawContextAMD64::rax },
+    StackFrameAMD64::CONTEXT_VALID_RAX, &StackFrameAMD64Registers::rax },
   { "$rdx", NULL, false,
-    StackFrameAMD64::CONTEXT_VALID_RDX, &MDRawContextAMD64::rdx },
+    StackFrameAMD64::CONTEXT_VALID_RDX, &StackFrameAMD64Registers::rdx },
   { "$rcx", NULL, false,
-    StackFrameAMD64::CONTEXT_VALID_RCX, &MDRawContextAMD64::rcx },
+    StackFrameAMD64::CONTEXT_VALID_RCX, &StackFrameAMD64Registers::rcx },
   { "$rbx", NULL, true,
-    StackFrameAMD64::CONTEXT_VALID_RBX, &MDRawContextAMD64::rbx },
+    StackFrameAMD64::CONTEXT_VALID_RBX, &StackFrameAMD64Registers::rbx },
   { "$rsi", NULL, false,
-    StackFrameAMD64::CONTEXT_VALID_RSI, &MDRawContextAMD64::rsi },
+    StackFrameAMD64::CONTEXT_VALID_RSI, &StackFrameAMD64Registers::rsi },
   { "$rdi", NULL, false,
-    StackFrameAMD64::CONTEXT_VALID_RDI, &MDRawContextAMD64::rdi },
+    StackFrameAMD64::CONTEXT_VALID_RDI, &StackFrameAMD64Registers::rdi },
   { "$rbp", NULL, true,
-    StackFrameAMD64::CONTEXT_VALID_RBP, &MDRawContextAMD64::rbp },
+    StackFrameAMD64::CONTEXT_VALID_RBP, &StackFrameAMD64Registers::rbp },
   { "$rsp", ".cfa", false,
-    StackFrameAMD64::CONTEXT_VALID_RSP, &MDRawContextAMD64::rsp },
+    StackFrameAMD64::CONTEXT_VALID_RSP, &StackFrameAMD64Registers::rsp },
   { "$r8", NULL, false,
-    StackFrameAMD64::CONTEXT_VALID_R8,  &MDRawContextAMD64::r8 },
+    StackFrameAMD64::CONTEXT_VALID_R8,  &StackFrameAMD64Registers::r8 },
   { "$r9", NULL, false,
-    StackFrameAMD64::CONTEXT_VALID_R9,  &MDRawContextAMD64::r9 },
+    StackFrameAMD64::CONTEXT_VALID_R9,  &StackFrameAMD64Registers::r9 },
   { "$r10", NULL, false,
-    StackFrameAMD64::CONTEXT_VALID_R10, &MDRawContextAMD64::r10 },
+    StackFrameAMD64::CONTEXT_VALID_R10, &StackFrameAMD64Registers::r10 },
   { "$r11", NULL, false,
-    StackFrameAMD64::CONTEXT_VALID_R11, &MDRawContextAMD64::r11 },
+    StackFrameAMD64::CONTEXT_VALID_R11, &StackFrameAMD64Registers::r11 },
   { "$r12", NULL, true,
-    StackFrameAMD64::CONTEXT_VALID_R12, &MDRawContextAMD64::r12 },
+    StackFrameAMD64::CONTEXT_VALID_R12, &StackFrameAMD64Registers::r12 },
   { "$r13", NULL, true,
-    StackFrameAMD64::CONTEXT_VALID_R13, &MDRawContextAMD64::r13 },
+    StackFrameAMD64::CONTEXT_VALID_R13, &StackFrameAMD64Registers::r13 },
   { "$r14", NULL, true,
-    StackFrameAMD64::CONTEXT_VALID_R14, &MDRawContextAMD64::r14 },
+    StackFrameAMD64::CONTEXT_VALID_R14, &StackFrameAMD64Registers::r14 },
   { "$r15", NULL, true,
-    StackFrameAMD64::CONTEXT_VALID_R15, &MDRawContextAMD64::r15 },
+    StackFrameAMD64::CONTEXT_VALID_R15, &StackFrameAMD64Registers::r15 },
   { "$rip", ".ra", false,
-    StackFrameAMD64::CONTEXT_VALID_RIP, &MDRawContextAMD64::rip },
+    StackFrameAMD64::CONTEXT_VALID_RIP, &StackFrameAMD64Registers::rip },
 };
 
 StackwalkerAMD64::StackwalkerAMD64(const SystemInfo* system_info,
@@ -102,6 +103,10 @@ StackwalkerAMD64::StackwalkerAMD64(const SystemInfo* system_info,
                   (sizeof(cfi_register_map_) / sizeof(cfi_register_map_[0]))) {
 }
 
+StackFrameAMD64::~StackFrameAMD64() {
+  delete full_context;
+}
+
 uint64_t StackFrameAMD64::ReturnAddress() const {
   assert(context_validity & StackFrameAMD64::CONTEXT_VALID_RIP);
   return context.rip;
@@ -113,11 +118,28 @@ StackFrame* StackwalkerAMD64::GetContextFrame() {
     return NULL;
   }
 
-  StackFrameAMD64* frame = new StackFrameAMD64();
+  StackFrameAMD64* frame = new (frame_arena_) StackFrameAMD64();
 
   // The instruction pointer is stored directly in a register, so pull it
   // straight out of the CPU context structure.
-  frame->context = *context_;
+  frame->full_context = new MDRawContextAMD64(*context_);
+  frame->context.rax = context_->rax;
+  frame->context.rcx = context_->rcx;
+  frame->context.rdx = context_->rdx;
+  frame->context.rbx = context_->rbx;
+  frame->context.rsp = context_->rsp;
+  frame->context.rbp = context_->rbp;
+  frame->context.rsi = context_->rsi;
+  frame->context.rdi = context_->rdi;
+  frame->context.r8 = context_->r8;
+  frame->context.r9 = context_->r9;
+  frame->context.r10 = context_->r10;
+  frame->context.r11 = context_->r11;
+  frame->context.r12 = context_->r12;
+  frame->context.r13 = context_->r13;
+  frame->context.r14 = context_->r14;
+  frame->context.r15 = context_->r15;
+  frame->context.rip = context_->rip;
   frame->context_validity = StackFrameAMD64::CONTEXT_VALID_ALL;
   frame->trust = StackFrame::FRAME_TRUST_CONTEXT;
   frame->instruction = frame->context.rip;
@@ -130,7 +152,7 @@ StackFrameAMD64* StackwalkerAMD64::GetCallerByCFIFrameInfo(
     CFIFrameInfo* cfi_frame_info) {
   StackFrameAMD64* last_frame = static_cast<StackFrameAMD64*>(frames.back());
 
-  scoped_ptr<StackFrameAMD64> frame(new StackFrameAMD64());
+  scoped_ptr<StackFrameAMD64> frame(new (frame_arena_) StackFrameAMD64());
   if (!cfi_walker_
       .FindCallerRegisters(*memory_, *cfi_frame_info,
                            last_frame->context, last_frame->context_validity,
@@ -170,15 +192,15 @@ StackFrameAMD64* StackwalkerAMD64::GetCallerByFramePointerRecovery(
   // %caller_rbp = *(%callee_rbp)
 
   uint64_t caller_rip, caller_rbp;
-  if (memory_->GetMemoryAtAddress(last_rbp + 8, &caller_rip) &&
-      memory_->GetMemoryAtAddress(last_rbp, &caller_rbp)) {
+  if (ReadStackMemory(last_rbp + 8, &caller_rip) &&
+      ReadStackMemory(last_rbp, &caller_rbp)) {
     uint64_t caller_rsp = last_rbp + 16;
 
     // Simple sanity check that the stack is growing downwards as expected.
     if (caller_rbp < last_rbp || caller_rsp < last_rsp)
       return NULL;
 
-    StackFrameAMD64* frame = new StackFrameAMD64();
+    StackFrameAMD64* frame = new (frame_arena_) StackFrameAMD64();
     frame->trust = StackFrame::FRAME_TRUST_FP;
     frame->context = last_frame->context;
     frame->context.rip = caller_rip;
@@ -207,7 +229,7 @@ StackFrameAMD64* StackwalkerAMD64::GetCallerByStackScan(
 
   // Create a new stack frame (ownership will be transferred to the caller)
   // and fill it in.
-  StackFrameAMD64* frame = new StackFrameAMD64();
+  StackFrameAMD64* frame = new (frame_arena_) StackFrameAMD64();
 
   frame->trust = StackFrame::FRAME_TRUST_SCAN;
   frame->context = last_frame->context;
@@ -227,7 +249,7 @@ StackFrameAMD64* StackwalkerAMD64::GetCallerByStackScan(
     // that the caller's %rbp is saved there.
     if (caller_rip_address - 8 == last_frame->context.rbp) {
       uint64_t caller_rbp = 0;
-      if (memory_->GetMemoryAtAddress(last_frame->context.rbp, &caller_rbp) &&
+      if (ReadStackMemory(last_frame->context.rbp, &caller_rbp) &&
           caller_rbp > caller_rip_address) {
         frame->context.rbp = caller_rbp;
         frame->context_validity |= StackFrameAMD64::CONTEXT_VALID_RBP;
@@ -253,15 +275,18 @@ StackFrame* StackwalkerAMD64::GetCallerFrame(const CallStack* stack,
   const vector<StackFrame*> &frames = *stack->frames();
   StackFrameAMD64* last_frame = static_cast<StackFrameAMD64*>(frames.back());
   scoped_ptr<StackFrameAMD64> new_frame;
+  int methods = AllowedUnwindMethods(last_frame);
 
   // If we have DWARF CFI information, use it.
-  scoped_ptr<CFIFrameInfo> cfi_frame_info(
-      frame_symbolizer_->FindCFIFrameInfo(last_frame));
-  if (cfi_frame_info.get())
-    new_frame.reset(GetCallerByCFIFrameInfo(frames, cfi_frame_info.get()));
+  if (methods & UnwindPolicy::METHOD_CFI) {
+    scoped_ptr<CFIFrameInfo> cfi_frame_info(
+        frame_symbolizer_->FindCFIFrameInfo(last_frame));
+    if (cfi_frame_info.get())
+      new_frame.reset(GetCallerByCFIFrameInfo(frames, cfi_frame_info.get()));
+  }
 
   // If CFI was not available or failed, try using frame pointer recovery.
-  if (!new_frame.get()) {
+  if ((methods & UnwindPolicy::METHOD_FRAME_POINTER) && !new_frame.get()) {
     new_frame.reset(GetCallerByFramePointerRecovery(frames));
   }
 
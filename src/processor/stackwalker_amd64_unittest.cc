@@ -31,12 +31,14 @@
 
 // stackwalker_amd64_unittest.cc: Unit tests for StackwalkerAMD64 class.
 
+#include <stdio.h>
 #include <string.h>
 #include <string>
 #include <vector>
 
 #include "breakpad_googletest_includes.h"
 #include "common/test_assembler.h"
+#include "common/tests/auto_tempdir.h"
 #include "common/using_std_string.h"
 #include "google_breakpad/common/minidump_format.h"
 #include "google_breakpad/processor/basic_source_line_resolver.h"
@@ -46,15 +48,19 @@
 #include "google_breakpad/processor/stack_frame_cpu.h"
 #include "processor/stackwalker_unittest_utils.h"
 #include "processor/stackwalker_amd64.h"
+#include "processor/symbol_file_index.h"
 
+using google_breakpad::AutoTempDir;
 using google_breakpad::BasicSourceLineResolver;
 using google_breakpad::CallStack;
 using google_breakpad::CodeModule;
+using google_breakpad::FrameArena;
 using google_breakpad::StackFrameSymbolizer;
 using google_breakpad::StackFrame;
 using google_breakpad::StackFrameAMD64;
 using google_breakpad::Stackwalker;
 using google_breakpad::StackwalkerAMD64;
+using google_breakpad::SymbolFileIndex;
 using google_breakpad::SystemInfo;
 using google_breakpad::test_assembler::kLittleEndian;
 using google_breakpad::test_assembler::Label;
@@ -168,7 +174,14 @@ TEST_F(SanityCheck, NoResolver) {
   StackFrameAMD64 *frame = static_cast<StackFrameAMD64 *>(frames->at(0));
   // Check that the values from the original raw context made it
   // through to the context in the stack frame.
-  EXPECT_EQ(0, memcmp(&raw_context, &frame->context, sizeof(raw_context)));
+  ASSERT_TRUE(frame->full_context);
+  EXPECT_EQ(0, memcmp(&raw_context, frame->full_context, sizeof(raw_context)));
+  EXPECT_EQ(raw_context.rax, frame->context.rax);
+  EXPECT_EQ(raw_context.rbx, frame->context.rbx);
+  EXPECT_EQ(raw_context.rsp, frame->context.rsp);
+  EXPECT_EQ(raw_context.rbp, frame->context.rbp);
+  EXPECT_EQ(raw_context.r15, frame->context.r15);
+  EXPECT_EQ(raw_context.rip, frame->context.rip);
 }
 
 TEST_F(GetContextFrame, Simple) {
@@ -194,7 +207,7 @@ TEST_F(GetContextFrame, Simple) {
   StackFrameAMD64 *frame = static_cast<StackFrameAMD64 *>(frames->at(0));
   // Check that the values from the original raw context made it
   // through to the context in the stack frame.
-  EXPECT_EQ(0, memcmp(&raw_context, &frame->context, sizeof(raw_context)));
+  EXPECT_EQ(0, memcmp(&raw_context, frame->full_context, sizeof(raw_context)));
 }
 
 // The stackwalker should be able to produce the context frame even
@@ -218,7 +231,7 @@ TEST_F(GetContextFrame, NoStackMemory) {
   StackFrameAMD64 *frame = static_cast<StackFrameAMD64 *>(frames->at(0));
   // Check that the values from the original raw context made it
   // through to the context in the stack frame.
-  EXPECT_EQ(0, memcmp(&raw_context, &frame->context, sizeof(raw_context)));
+  EXPECT_EQ(0, memcmp(&raw_context, frame->full_context, sizeof(raw_context)));
 }
 
 class GetCallerFrame: public StackwalkerAMD64Fixture, public Test { };
@@ -281,7 +294,7 @@ TEST_F(GetCallerFrame, ScanWithoutSymbols) {
   StackFrameAMD64 *frame0 = static_cast<StackFrameAMD64 *>(frames->at(0));
   EXPECT_EQ(StackFrame::FRAME_TRUST_CONTEXT, frame0->trust);
   ASSERT_EQ(StackFrameAMD64::CONTEXT_VALID_ALL, frame0->context_validity);
-  EXPECT_EQ(0, memcmp(&raw_context, &frame0->context, sizeof(raw_context)));
+  EXPECT_EQ(0, memcmp(&raw_context, frame0->full_context, sizeof(raw_context)));
 
   StackFrameAMD64 *frame1 = static_cast<StackFrameAMD64 *>(frames->at(1));
   EXPECT_EQ(StackFrame::FRAME_TRUST_SCAN, frame1->trust);
@@ -302,6 +315,46 @@ TEST_F(GetCallerFrame, ScanWithoutSymbols) {
   EXPECT_EQ(frame2_sp.Value(), frame2->context.rsp);
 }
 
+TEST_F(GetCallerFrame, FramesInArena) {
+  // A walker given a FrameArena allocates its frames there, and they can
+  // still be deleted with the call stack before the arena goes away.
+  stack_section.start() = 0x8000000080000000ULL;
+  uint64_t return_address = 0x50000000b0000100ULL;
+  Label frame1_sp;
+  stack_section
+    // frame 0
+    .Append(16, 0)                      // space
+    .D64(return_address)                // actual return address
+    // frame 1
+    .Mark(&frame1_sp)
+    .Append(32, 0);                     // end of stack
+
+  RegionFromSection();
+
+  raw_context.rip = 0x40000000c0000200ULL;
+  raw_context.rbp = 0;
+  raw_context.rsp = stack_section.start().Value();
+
+  FrameArena arena;
+  CallStack arena_call_stack;
+  StackFrameSymbolizer frame_symbolizer(&supplier, &resolver);
+  StackwalkerAMD64 walker(&system_info, &raw_context, &stack_region, &modules,
+                          &frame_symbolizer);
+  walker.set_frame_arena(&arena);
+  vector<const CodeModule*> modules_without_symbols;
+  vector<const CodeModule*> modules_with_corrupt_symbols;
+  ASSERT_TRUE(walker.Walk(&arena_call_stack, &modules_without_symbols,
+                          &modules_with_corrupt_symbols));
+  EXPECT_EQ(1U, arena.block_count());
+  frames = arena_call_stack.frames();
+  ASSERT_EQ(2U, frames->size());
+
+  StackFrameAMD64 *frame1 = static_cast<StackFrameAMD64 *>(frames->at(1));
+  EXPECT_EQ(StackFrame::FRAME_TRUST_SCAN, frame1->trust);
+  EXPECT_EQ(return_address, frame1->context.rip);
+  EXPECT_EQ(frame1_sp.Value(), frame1->context.rsp);
+}
+
 TEST_F(GetCallerFrame, ScanWithFunctionSymbols) {
   // During stack scanning, if a potential return address
   // is located within a loaded module that has symbols,
@@ -370,6 +423,170 @@ TEST_F(GetCallerFrame, ScanWithFunctionSymbols) {
   EXPECT_EQ(0x50000000b0000100ULL, frame1->function_base);
 }
 
+// A supplier that also has an indexed symbol file for one module.
+class IndexedSymbolSupplier : public MockSymbolSupplier {
+ public:
+  IndexedSymbolSupplier() : indexed_module_(NULL), indexed_requests_(0) {}
+
+  // Writes |info| and its index to |directory| and serves them for
+  // |module|.
+  bool SetIndexedSymbols(const CodeModule *module, const string &directory,
+                         const string &info) {
+    indexed_module_ = module;
+    symbol_file_ = directory + "/indexed.sym";
+    index_file_ = symbol_file_ + ".idx";
+    string index;
+    SymbolFileIndex::Build(info.data(), info.size(), &index);
+    return WriteFile(symbol_file_, info) && WriteFile(index_file_, index);
+  }
+
+  virtual SymbolResult GetIndexedSymbolFile(const CodeModule *module,
+                                            const SystemInfo *system_info,
+                                            string *symbol_file,
+                                            string *index_file) {
+    if (module != indexed_module_)
+      return NOT_FOUND;
+    ++indexed_requests_;
+    *symbol_file = symbol_file_;
+    *index_file = index_file_;
+    return FOUND;
+  }
+
+  int indexed_requests() const { return indexed_requests_; }
+
+ private:
+  static bool WriteFile(const string &path, const string &data) {
+    FILE *file = fopen(path.c_str(), "wb");
+    if (!file)
+      return false;
+    bool written = fwrite(data.data(), 1, data.size(), file) == data.size();
+    return fclose(file) == 0 && written;
+  }
+
+  const CodeModule *indexed_module_;
+  string symbol_file_;
+  string index_file_;
+  int indexed_requests_;
+};
+
+class ScanWithIndexedSymbols: public StackwalkerAMD64Fixture, public Test {
+ public:
+  void SetUp() {
+    // The fixture's supplier is not used.
+    EXPECT_CALL(indexed_supplier, GetCStringSymbolData(_, _, _, _, _))
+      .WillRepeatedly(Return(MockSymbolSupplier::NOT_FOUND));
+    EXPECT_CALL(indexed_supplier, FreeSymbolData(_)).Times(AnyNumber());
+  }
+
+  // Serve |info| for |module| from memory, as SetModuleSymbols does.
+  void SetIndexedModuleSymbols(MockCodeModule *module, const string &info) {
+    size_t buffer_size;
+    char *buffer =
+        indexed_supplier.CopySymbolDataAndOwnTheCopy(info, &buffer_size);
+    EXPECT_CALL(indexed_supplier,
+                GetCStringSymbolData(module, &system_info, _, _, _))
+      .WillRepeatedly(DoAll(SetArgumentPointee<3>(buffer),
+                            SetArgumentPointee<4>(buffer_size),
+                            Return(MockSymbolSupplier::FOUND)));
+  }
+
+  AutoTempDir temp_dir;
+  IndexedSymbolSupplier indexed_supplier;
+};
+
+TEST_F(ScanWithIndexedSymbols, RejectsWithoutLoading) {
+  // A scan that passes over an address in module2, which isn't within
+  // any of its functions, rejects it from module2's index without loading
+  // module2's symbols.
+  stack_section.start() = 0x8000000080000000ULL;
+  uint64_t return_address = 0x40000000c0000110ULL;
+  Label frame1_sp, frame1_rbp;
+
+  stack_section
+    // frame 0
+    .Append(16, 0)                      // space
+    .D64(0x50000000b000aaaaULL)         // in module2, but in no function
+    .D64(return_address)                // actual return address
+    // frame 1
+    .Mark(&frame1_sp)
+    .Append(32, 0)                      // end of stack
+    .Mark(&frame1_rbp);
+  RegionFromSection();
+
+  raw_context.rip = 0x40000000c0000200ULL;
+  raw_context.rbp = frame1_rbp.Value();
+  raw_context.rsp = stack_section.start().Value();
+
+  const string module2_symbols = "FUNC 100 400 10 echidna\n";
+  ASSERT_TRUE(indexed_supplier.SetIndexedSymbols(&module2, temp_dir.path(),
+                                                 module2_symbols));
+  SetIndexedModuleSymbols(&module1, "FUNC 100 400 10 platypus\n");
+  SetIndexedModuleSymbols(&module2, module2_symbols);
+
+  StackFrameSymbolizer frame_symbolizer(&indexed_supplier, &resolver);
+  StackwalkerAMD64 walker(&system_info, &raw_context, &stack_region, &modules,
+                          &frame_symbolizer);
+  vector<const CodeModule*> modules_without_symbols;
+  vector<const CodeModule*> modules_with_corrupt_symbols;
+  ASSERT_TRUE(walker.Walk(&call_stack, &modules_without_symbols,
+                          &modules_with_corrupt_symbols));
+  frames = call_stack.frames();
+  ASSERT_EQ(2U, frames->size());
+  EXPECT_EQ("platypus", frames->at(0)->function_name);
+  EXPECT_EQ(StackFrame::FRAME_TRUST_SCAN, frames->at(1)->trust);
+  EXPECT_EQ(return_address, frames->at(1)->instruction + 1);
+  EXPECT_EQ("platypus", frames->at(1)->function_name);
+
+  EXPECT_EQ(1, indexed_supplier.indexed_requests());
+  EXPECT_FALSE(resolver.HasModule(&module2));
+}
+
+TEST_F(ScanWithIndexedSymbols, LoadsAcceptedFrames) {
+  // An address that module2's index places within a function is accepted,
+  // and only then are module2's symbols loaded, to name the frame.
+  stack_section.start() = 0x8000000080000000ULL;
+  uint64_t return_address = 0x50000000b0000110ULL;
+  Label frame1_sp, frame1_rbp;
+
+  stack_section
+    // frame 0
+    .Append(16, 0)                      // space
+    .D64(0x50000000b000aaaaULL)         // in module2, but in no function
+    .D64(return_address)                // actual return address
+    // frame 1
+    .Mark(&frame1_sp)
+    .Append(32, 0)                      // end of stack
+    .Mark(&frame1_rbp);
+  RegionFromSection();
+
+  raw_context.rip = 0x40000000c0000200ULL;
+  raw_context.rbp = frame1_rbp.Value();
+  raw_context.rsp = stack_section.start().Value();
+
+  const string module2_symbols = "FUNC 100 400 10 echidna\n";
+  ASSERT_TRUE(indexed_supplier.SetIndexedSymbols(&module2, temp_dir.path(),
+                                                 module2_symbols));
+  SetIndexedModuleSymbols(&module1, "FUNC 100 400 10 platypus\n");
+  SetIndexedModuleSymbols(&module2, module2_symbols);
+
+  StackFrameSymbolizer frame_symbolizer(&indexed_supplier, &resolver);
+  StackwalkerAMD64 walker(&system_info, &raw_context, &stack_region, &modules,
+                          &frame_symbolizer);
+  vector<const CodeModule*> modules_without_symbols;
+  vector<const CodeModule*> modules_with_corrupt_symbols;
+  ASSERT_TRUE(walker.Walk(&call_stack, &modules_without_symbols,
+                          &modules_with_corrupt_symbols));
+  frames = call_stack.frames();
+  ASSERT_EQ(2U, frames->size());
+  StackFrameAMD64 *frame1 = static_cast<StackFrameAMD64 *>(frames->at(1));
+  EXPECT_EQ(StackFrame::FRAME_TRUST_SCAN, frame1->trust);
+  EXPECT_EQ(return_address, frame1->context.rip);
+  EXPECT_EQ(frame1_sp.Value(), frame1->context.rsp);
+  EXPECT_EQ("echidna", frame1->function_name);
+  EXPECT_EQ(0x50000000b0000100ULL, frame1->function_base);
+  EXPECT_TRUE(resolver.HasModule(&module2));
+}
+
 // Test that set_max_frames_scanned prevents using stack scanning
 // to find caller frames.
 TEST_F(GetCallerFrame, ScanningNotAllowed) {
@@ -429,7 +646,7 @@ TEST_F(GetCallerFrame, ScanningNotAllowed) {
   StackFrameAMD64 *frame0 = static_cast<StackFrameAMD64 *>(frames->at(0));
   EXPECT_EQ(StackFrame::FRAME_TRUST_CONTEXT, frame0->trust);
   ASSERT_EQ(StackFrameAMD64::CONTEXT_VALID_ALL, frame0->context_validity);
-  EXPECT_EQ(0, memcmp(&raw_context, &frame0->context, sizeof(raw_context)));
+  EXPECT_EQ(0, memcmp(&raw_context, frame0->full_context, sizeof(raw_context)));
 }
 
 TEST_F(GetCallerFrame, CallerPushedRBP) {
@@ -40,6 +40,7 @@
 #include "google_breakpad/processor/memory_region.h"
 #include "google_breakpad/processor/source_line_resolver_interface.h"
 #include "google_breakpad/processor/stack_frame_cpu.h"
+#include "google_breakpad/processor/unwind_policy.h"
 #include "processor/cfi_frame_info.h"
 #include "processor/logging.h"
 #include "processor/stackwalker_arm.h"
@@ -64,7 +65,7 @@ StackFrame* StackwalkerARM::GetContextFrame() {
     return NULL;
   }
 
-  StackFrameARM* frame = new StackFrameARM();
+  StackFrameARM* frame = new (frame_arena_) StackFrameARM();
 
   // The instruction pointer is stored directly in a register (r15), so pull it
   // straight out of the CPU context structure.
@@ -89,28 +90,33 @@ StackFrameARM* StackwalkerARM::GetCallerByCFIFrameInfo(
     NULL
   };
 
-  // Populate a dictionary with the valid register values in last_frame.
-  CFIFrameInfo::RegisterValueMap<uint32_t> callee_registers;
-  for (int i = 0; register_names[i]; i++)
+  static const int register_count =
+      sizeof(register_names) / sizeof(register_names[0]) - 1;
+
+  // Populate a register file with the valid register values in last_frame.
+  CFIFrameInfo::RegisterFile<uint32_t> callee_registers;
+  for (int i = 0; i < register_count; i++) {
     if (last_frame->context_validity & StackFrameARM::RegisterValidFlag(i))
-      callee_registers[register_names[i]] = last_frame->context.iregs[i];
+      callee_registers.Set(i, last_frame->context.iregs[i]);
+  }
 
   // Use the STACK CFI data to recover the caller's register values.
-  CFIFrameInfo::RegisterValueMap<uint32_t> caller_registers;
-  if (!cfi_frame_info->FindCallerRegs(callee_registers, *memory_,
-                                      &caller_registers))
+  CFIFrameInfo::RegisterFile<uint32_t> caller_registers;
+  uint32_t caller_cfa, caller_ra;
+  if (!cfi_frame_info->FindCallerRegs(register_names, register_count,
+                                      callee_registers, *memory_,
+                                      &caller_registers,
+                                      &caller_cfa, &caller_ra))
     return NULL;
 
   // Construct a new stack frame given the values the CFI recovered.
-  scoped_ptr<StackFrameARM> frame(new StackFrameARM());
-  for (int i = 0; register_names[i]; i++) {
-    CFIFrameInfo::RegisterValueMap<uint32_t>::iterator entry =
-      caller_registers.find(register_names[i]);
-    if (entry != caller_registers.end()) {
+  scoped_ptr<StackFrameARM> frame(new (frame_arena_) StackFrameARM());
+  for (int i = 0; i < register_count; i++) {
+    if (caller_registers.Has(i)) {
       // We recovered the value of this register; fill the context with the
       // value from caller_registers.
       frame->context_validity |= StackFrameARM::RegisterValidFlag(i);
-      frame->context.iregs[i] = entry->second;
+      frame->context.iregs[i] = caller_registers.Get(i);
     } else if (4 <= i && i <= 11 && (last_frame->context_validity &
                                      StackFrameARM::RegisterValidFlag(i))) {
       // If the STACK CFI data doesn't mention some callee-saves register, and
@@ -123,31 +129,23 @@ StackFrameARM* StackwalkerARM::GetCallerByCFIFrameInfo(
   }
   // If the CFI doesn't recover the PC explicitly, then use .ra.
   if (!(frame->context_validity & StackFrameARM::CONTEXT_VALID_PC)) {
-    CFIFrameInfo::RegisterValueMap<uint32_t>::iterator entry =
-      caller_registers.find(".ra");
-    if (entry != caller_registers.end()) {
-      if (fp_register_ == -1) {
-        frame->context_validity |= StackFrameARM::CONTEXT_VALID_PC;
-        frame->context.iregs[MD_CONTEXT_ARM_REG_PC] = entry->second;
-      } else {
-        // The CFI updated the link register and not the program counter.
-        // Handle getting the program counter from the link register.
-        frame->context_validity |= StackFrameARM::CONTEXT_VALID_PC;
-        frame->context_validity |= StackFrameARM::CONTEXT_VALID_LR;
-        frame->context.iregs[MD_CONTEXT_ARM_REG_LR] = entry->second;
-        frame->context.iregs[MD_CONTEXT_ARM_REG_PC] =
-            last_frame->context.iregs[MD_CONTEXT_ARM_REG_LR];
-      }
+    if (fp_register_ == -1) {
+      frame->context_validity |= StackFrameARM::CONTEXT_VALID_PC;
+      frame->context.iregs[MD_CONTEXT_ARM_REG_PC] = caller_ra;
+    } else {
+      // The CFI updated the link register and not the program counter.
+      // Handle getting the program counter from the link register.
+      frame->context_validity |= StackFrameARM::CONTEXT_VALID_PC;
+      frame->context_validity |= StackFrameARM::CONTEXT_VALID_LR;
+      frame->context.iregs[MD_CONTEXT_ARM_REG_LR] = caller_ra;
+      frame->context.iregs[MD_CONTEXT_ARM_REG_PC] =
+          last_frame->context.iregs[MD_CONTEXT_ARM_REG_LR];
     }
   }
   // If the CFI doesn't recover the SP explicitly, then use .cfa.
   if (!(frame->context_validity & StackFrameARM::CONTEXT_VALID_SP)) {
-    CFIFrameInfo::RegisterValueMap<uint32_t>::iterator entry =
-      caller_registers.find(".cfa");
-    if (entry != caller_registers.end()) {
-      frame->context_validity |= StackFrameARM::CONTEXT_VALID_SP;
-      frame->context.iregs[MD_CONTEXT_ARM_REG_SP] = entry->second;
-    }
+    frame->context_validity |= StackFrameARM::CONTEXT_VALID_SP;
+    frame->context.iregs[MD_CONTEXT_ARM_REG_SP] = caller_cfa;
   }
 
   // If we didn't recover the PC and the SP, then the frame isn't very useful.
@@ -179,7 +177,7 @@ StackFrameARM* StackwalkerARM::GetCallerByStackScan(
 
   // Create a new stack frame (ownership will be transferred to the caller)
   // and fill it in.
-  StackFrameARM* frame = new StackFrameARM();
+  StackFrameARM* frame = new (frame_arena_) StackFrameARM();
 
   frame->trust = StackFrame::FRAME_TRUST_SCAN;
   frame->context = last_frame->context;
@@ -203,14 +201,14 @@ StackFrameARM* StackwalkerARM::GetCallerByFramePointer(
   uint32_t last_fp = last_frame->context.iregs[fp_register_];
 
   uint32_t caller_fp = 0;
-  if (last_fp && !memory_->GetMemoryAtAddress(last_fp, &caller_fp)) {
+  if (last_fp && !ReadStackMemory(last_fp, &caller_fp)) {
     BPLOG(ERROR) << "Unable to read caller_fp from last_fp: 0x"
                  << std::hex << last_fp;
     return NULL;
   }
 
   uint32_t caller_lr = 0;
-  if (last_fp && !memory_->GetMemoryAtAddress(last_fp + 4, &caller_lr)) {
+  if (last_fp && !ReadStackMemory(last_fp + 4, &caller_lr)) {
     BPLOG(ERROR) << "Unable to read caller_lr from last_fp + 4: 0x"
                  << std::hex << (last_fp + 4);
     return NULL;
@@ -221,7 +219,7 @@ StackFrameARM* StackwalkerARM::GetCallerByFramePointer(
 
   // Create a new stack frame (ownership will be transferred to the caller)
   // and fill it in.
-  StackFrameARM* frame = new StackFrameARM();
+  StackFrameARM* frame = new (frame_arena_) StackFrameARM();
 
   frame->trust = StackFrame::FRAME_TRUST_FP;
   frame->context = last_frame->context;
@@ -247,16 +245,20 @@ StackFrame* StackwalkerARM::GetCallerFrame(const CallStack* stack,
   const vector<StackFrame*> &frames = *stack->frames();
   StackFrameARM* last_frame = static_cast<StackFrameARM*>(frames.back());
   scoped_ptr<StackFrameARM> frame;
+  int methods = AllowedUnwindMethods(last_frame);
 
   // See if there is DWARF call frame information covering this address.
-  scoped_ptr<CFIFrameInfo> cfi_frame_info(
-      frame_symbolizer_->FindCFIFrameInfo(last_frame));
-  if (cfi_frame_info.get())
-    frame.reset(GetCallerByCFIFrameInfo(frames, cfi_frame_info.get()));
+  if (methods & UnwindPolicy::METHOD_CFI) {
+    scoped_ptr<CFIFrameInfo> cfi_frame_info(
+        frame_symbolizer_->FindCFIFrameInfo(last_frame));
+    if (cfi_frame_info.get())
+      frame.reset(GetCallerByCFIFrameInfo(frames, cfi_frame_info.get()));
+  }
 
   // If CFI failed, or there wasn't CFI available, fall back
   // to frame pointer, if this is configured.
-  if (fp_register_ >= 0 && !frame.get())
+  if (fp_register_ >= 0 && (methods & UnwindPolicy::METHOD_FRAME_POINTER) &&
+      !frame.get())
     frame.reset(GetCallerByFramePointer(frames));
 
   // If everuthing failed, fall back to stack scanning.
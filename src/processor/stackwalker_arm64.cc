@@ -33,6 +33,8 @@
 //
 // Author: Mark Mentovai, Ted Mielczarek, Jim Blandy, Colin Blundell
 
+#include <string.h>
+
 #include <vector>
 
 #include "common/scoped_ptr.h"
@@ -40,6 +42,7 @@
 #include "google_breakpad/processor/memory_region.h"
 #include "google_breakpad/processor/source_line_resolver_interface.h"
 #include "google_breakpad/processor/stack_frame_cpu.h"
+#include "google_breakpad/processor/unwind_policy.h"
 #include "processor/cfi_frame_info.h"
 #include "processor/logging.h"
 #include "processor/stackwalker_arm64.h"
@@ -47,6 +50,10 @@
 namespace google_breakpad {
 
 
+StackFrameARM64::~StackFrameARM64() {
+  delete full_context;
+}
+
 StackwalkerARM64::StackwalkerARM64(const SystemInfo* system_info,
                                    const MDRawContextARM64* context,
                                    MemoryRegion* memory,
@@ -63,11 +70,12 @@ StackFrame* StackwalkerARM64::GetContextFrame() {
     return NULL;
   }
 
-  StackFrameARM64* frame = new StackFrameARM64();
+  StackFrameARM64* frame = new (frame_arena_) StackFrameARM64();
 
   // The instruction pointer is stored directly in a register (x32), so pull it
   // straight out of the CPU context structure.
-  frame->context = *context_;
+  frame->full_context = new MDRawContextARM64(*context_);
+  memcpy(frame->context.iregs, context_->iregs, sizeof(frame->context.iregs));
   frame->context_validity = context_frame_validity_;
   frame->trust = StackFrame::FRAME_TRUST_CONTEXT;
   frame->instruction = frame->context.iregs[MD_CONTEXT_ARM64_REG_PC];
@@ -88,29 +96,32 @@ StackFrameARM64* StackwalkerARM64::GetCallerByCFIFrameInfo(
     "pc",  NULL
   };
 
-  // Populate a dictionary with the valid register values in last_frame.
-  CFIFrameInfo::RegisterValueMap<uint64_t> callee_registers;
-  for (int i = 0; register_names[i]; i++) {
+  static const int register_count =
+      sizeof(register_names) / sizeof(register_names[0]) - 1;
+
+  // Populate a register file with the valid register values in last_frame.
+  CFIFrameInfo::RegisterFile<uint64_t> callee_registers;
+  for (int i = 0; i < register_count; i++) {
     if (last_frame->context_validity & StackFrameARM64::RegisterValidFlag(i))
-      callee_registers[register_names[i]] = last_frame->context.iregs[i];
+      callee_registers.Set(i, last_frame->context.iregs[i]);
   }
 
   // Use the STACK CFI data to recover the caller's register values.
-  CFIFrameInfo::RegisterValueMap<uint64_t> caller_registers;
-  if (!cfi_frame_info->FindCallerRegs(callee_registers, *memory_,
-                                      &caller_registers)) {
+  CFIFrameInfo::RegisterFile<uint64_t> caller_registers;
+  uint64_t caller_cfa, caller_ra;
+  if (!cfi_frame_info->FindCallerRegs(register_names, register_count,
+                                      callee_registers, *memory_,
+                                      &caller_registers,
+                                      &caller_cfa, &caller_ra))
     return NULL;
-  }
   // Construct a new stack frame given the values the CFI recovered.
-  scoped_ptr<StackFrameARM64> frame(new StackFrameARM64());
-  for (int i = 0; register_names[i]; i++) {
-    CFIFrameInfo::RegisterValueMap<uint64_t>::iterator entry =
-      caller_registers.find(register_names[i]);
-    if (entry != caller_registers.end()) {
+  scoped_ptr<StackFrameARM64> frame(new (frame_arena_) StackFrameARM64());
+  for (int i = 0; i < register_count; i++) {
+    if (caller_registers.Has(i)) {
       // We recovered the value of this register; fill the context with the
       // value from caller_registers.
       frame->context_validity |= StackFrameARM64::RegisterValidFlag(i);
-      frame->context.iregs[i] = entry->second;
+      frame->context.iregs[i] = caller_registers.Get(i);
     } else if (19 <= i && i <= 29 && (last_frame->context_validity &
                                       StackFrameARM64::RegisterValidFlag(i))) {
       // If the STACK CFI data doesn't mention some callee-saves register, and
@@ -124,21 +135,13 @@ StackFrameARM64* StackwalkerARM64::GetCallerByCFIFrameInfo(
   }
   // If the CFI doesn't recover the PC explicitly, then use .ra.
   if (!(frame->context_validity & StackFrameARM64::CONTEXT_VALID_PC)) {
-    CFIFrameInfo::RegisterValueMap<uint64_t>::iterator entry =
-      caller_registers.find(".ra");
-    if (entry != caller_registers.end()) {
-      frame->context_validity |= StackFrameARM64::CONTEXT_VALID_PC;
-      frame->context.iregs[MD_CONTEXT_ARM64_REG_PC] = entry->second;
-    }
+    frame->context_validity |= StackFrameARM64::CONTEXT_VALID_PC;
+    frame->context.iregs[MD_CONTEXT_ARM64_REG_PC] = caller_ra;
   }
   // If the CFI doesn't recover the SP explicitly, then use .cfa.
   if (!(frame->context_validity & StackFrameARM64::CONTEXT_VALID_SP)) {
-    CFIFrameInfo::RegisterValueMap<uint64_t>::iterator entry =
-      caller_registers.find(".cfa");
-    if (entry != caller_registers.end()) {
-      frame->context_validity |= StackFrameARM64::CONTEXT_VALID_SP;
-      frame->context.iregs[MD_CONTEXT_ARM64_REG_SP] = entry->second;
-    }
+    frame->context_validity |= StackFrameARM64::CONTEXT_VALID_SP;
+    frame->context.iregs[MD_CONTEXT_ARM64_REG_SP] = caller_cfa;
   }
 
   // If we didn't recover the PC and the SP, then the frame isn't very useful.
@@ -170,7 +173,7 @@ StackFrameARM64* StackwalkerARM64::GetCallerByStackScan(
 
   // Create a new stack frame (ownership will be transferred to the caller)
   // and fill it in.
-  StackFrameARM64* frame = new StackFrameARM64();
+  StackFrameARM64* frame = new (frame_arena_) StackFrameARM64();
 
   frame->trust = StackFrame::FRAME_TRUST_SCAN;
   frame->context = last_frame->context;
@@ -189,14 +192,14 @@ StackFrameARM64* StackwalkerARM64::GetCallerByFramePointer(
   uint64_t last_fp = last_frame->context.iregs[MD_CONTEXT_ARM64_REG_FP];
 
   uint64_t caller_fp = 0;
-  if (last_fp && !memory_->GetMemoryAtAddress(last_fp, &caller_fp)) {
+  if (last_fp && !ReadStackMemory(last_fp, &caller_fp)) {
     BPLOG(ERROR) << "Unable to read caller_fp from last_fp: 0x"
                  << std::hex << last_fp;
     return NULL;
   }
 
   uint64_t caller_lr = 0;
-  if (last_fp && !memory_->GetMemoryAtAddress(last_fp + 8, &caller_lr)) {
+  if (last_fp && !ReadStackMemory(last_fp + 8, &caller_lr)) {
     BPLOG(ERROR) << "Unable to read caller_lr from last_fp + 8: 0x"
                  << std::hex << (last_fp + 8);
     return NULL;
@@ -207,7 +210,7 @@ StackFrameARM64* StackwalkerARM64::GetCallerByFramePointer(
 
   // Create a new stack frame (ownership will be transferred to the caller)
   // and fill it in.
-  StackFrameARM64* frame = new StackFrameARM64();
+  StackFrameARM64* frame = new (frame_arena_) StackFrameARM64();
 
   frame->trust = StackFrame::FRAME_TRUST_FP;
   frame->context = last_frame->context;
@@ -233,15 +236,18 @@ StackFrame* StackwalkerARM64::GetCallerFrame(const CallStack* stack,
   const vector<StackFrame*> &frames = *stack->frames();
   StackFrameARM64* last_frame = static_cast<StackFrameARM64*>(frames.back());
   scoped_ptr<StackFrameARM64> frame;
+  int methods = AllowedUnwindMethods(last_frame);
 
   // See if there is DWARF call frame information covering this address.
-  scoped_ptr<CFIFrameInfo> cfi_frame_info(
-      frame_symbolizer_->FindCFIFrameInfo(last_frame));
-  if (cfi_frame_info.get())
-    frame.reset(GetCallerByCFIFrameInfo(frames, cfi_frame_info.get()));
+  if (methods & UnwindPolicy::METHOD_CFI) {
+    scoped_ptr<CFIFrameInfo> cfi_frame_info(
+        frame_symbolizer_->FindCFIFrameInfo(last_frame));
+    if (cfi_frame_info.get())
+      frame.reset(GetCallerByCFIFrameInfo(frames, cfi_frame_info.get()));
+  }
 
   // If CFI failed, or there wasn't CFI available, fall back to frame pointer.
-  if (!frame.get())
+  if ((methods & UnwindPolicy::METHOD_FRAME_POINTER) && !frame.get())
     frame.reset(GetCallerByFramePointer(frames));
 
   // If everything failed, fall back to stack scanning.
@@ -161,7 +161,10 @@ TEST_F(SanityCheck, NoResolver) {
   StackFrameARM64 *frame = static_cast<StackFrameARM64 *>(frames->at(0));
   // Check that the values from the original raw context made it
   // through to the context in the stack frame.
-  EXPECT_EQ(0, memcmp(&raw_context, &frame->context, sizeof(raw_context)));
+  ASSERT_TRUE(frame->full_context);
+  EXPECT_EQ(0, memcmp(&raw_context, frame->full_context, sizeof(raw_context)));
+  EXPECT_EQ(0, memcmp(raw_context.iregs, frame->context.iregs,
+                      sizeof(raw_context.iregs)));
 }
 
 class GetContextFrame: public StackwalkerARM64Fixture, public Test { };
@@ -183,7 +186,7 @@ TEST_F(GetContextFrame, NoStackMemory) {
   StackFrameARM64 *frame = static_cast<StackFrameARM64 *>(frames->at(0));
   // Check that the values from the original raw context made it
   // through to the context in the stack frame.
-  EXPECT_EQ(0, memcmp(&raw_context, &frame->context, sizeof(raw_context)));
+  EXPECT_EQ(0, memcmp(&raw_context, frame->full_context, sizeof(raw_context)));
 }
 
 class GetCallerFrame: public StackwalkerARM64Fixture, public Test { };
@@ -240,7 +243,7 @@ TEST_F(GetCallerFrame, ScanWithoutSymbols) {
   EXPECT_EQ(StackFrame::FRAME_TRUST_CONTEXT, frame0->trust);
   ASSERT_EQ(StackFrameARM64::CONTEXT_VALID_ALL,
             frame0->context_validity);
-  EXPECT_EQ(0, memcmp(&raw_context, &frame0->context, sizeof(raw_context)));
+  EXPECT_EQ(0, memcmp(&raw_context, frame0->full_context, sizeof(raw_context)));
 
   StackFrameARM64 *frame1 = static_cast<StackFrameARM64 *>(frames->at(1));
   EXPECT_EQ(StackFrame::FRAME_TRUST_SCAN, frame1->trust);
@@ -310,7 +313,7 @@ TEST_F(GetCallerFrame, ScanWithFunctionSymbols) {
   EXPECT_EQ(StackFrame::FRAME_TRUST_CONTEXT, frame0->trust);
   ASSERT_EQ(StackFrameARM64::CONTEXT_VALID_ALL,
             frame0->context_validity);
-  EXPECT_EQ(0, memcmp(&raw_context, &frame0->context, sizeof(raw_context)));
+  EXPECT_EQ(0, memcmp(&raw_context, frame0->full_context, sizeof(raw_context)));
   EXPECT_EQ("monotreme", frame0->function_name);
   EXPECT_EQ(0x40000100ULL, frame0->function_base);
 
@@ -379,7 +382,7 @@ TEST_F(GetCallerFrame, ScanFirstFrame) {
   EXPECT_EQ(StackFrame::FRAME_TRUST_CONTEXT, frame0->trust);
   ASSERT_EQ(StackFrameARM64::CONTEXT_VALID_ALL,
             frame0->context_validity);
-  EXPECT_EQ(0, memcmp(&raw_context, &frame0->context, sizeof(raw_context)));
+  EXPECT_EQ(0, memcmp(&raw_context, frame0->full_context, sizeof(raw_context)));
 
   StackFrameARM64 *frame1 = static_cast<StackFrameARM64 *>(frames->at(1));
   EXPECT_EQ(StackFrame::FRAME_TRUST_SCAN, frame1->trust);
@@ -443,7 +446,7 @@ TEST_F(GetCallerFrame, ScanningNotAllowed) {
   EXPECT_EQ(StackFrame::FRAME_TRUST_CONTEXT, frame0->trust);
   ASSERT_EQ(StackFrameARM64::CONTEXT_VALID_ALL,
             frame0->context_validity);
-  EXPECT_EQ(0, memcmp(&raw_context, &frame0->context, sizeof(raw_context)));
+  EXPECT_EQ(0, memcmp(&raw_context, frame0->full_context, sizeof(raw_context)));
 }
 
 class GetFramesByFramePointer: public StackwalkerARM64Fixture, public Test { };
@@ -506,7 +509,7 @@ TEST_F(GetFramesByFramePointer, OnlyFramePointer) {
   EXPECT_EQ(StackFrame::FRAME_TRUST_CONTEXT, frame0->trust);
   ASSERT_EQ(StackFrameARM64::CONTEXT_VALID_ALL,
             frame0->context_validity);
-  EXPECT_EQ(0, memcmp(&raw_context, &frame0->context, sizeof(raw_context)));
+  EXPECT_EQ(0, memcmp(&raw_context, frame0->full_context, sizeof(raw_context)));
 
   StackFrameARM64 *frame1 = static_cast<StackFrameARM64 *>(frames->at(1));
   EXPECT_EQ(StackFrame::FRAME_TRUST_FP, frame1->trust);
@@ -39,6 +39,7 @@
 #include "google_breakpad/processor/memory_region.h"
 #include "google_breakpad/processor/source_line_resolver_interface.h"
 #include "google_breakpad/processor/stack_frame_cpu.h"
+#include "google_breakpad/processor/unwind_policy.h"
 #include "processor/cfi_frame_info.h"
 #include "processor/logging.h"
 #include "processor/postfix_evaluator-inl.h"
@@ -70,7 +71,7 @@ StackFrame* StackwalkerMIPS::GetContextFrame() {
     return NULL;
   }
 
-  StackFrameMIPS* frame = new StackFrameMIPS();
+  StackFrameMIPS* frame = new (frame_arena_) StackFrameMIPS();
 
   // The instruction pointer is stored directly in a register, so pull it
   // straight out of the CPU context structure.
@@ -96,48 +97,36 @@ StackFrameMIPS* StackwalkerMIPS::GetCallerByCFIFrameInfo(
     CFIFrameInfo* cfi_frame_info) {
   StackFrameMIPS* last_frame = static_cast<StackFrameMIPS*>(frames.back());
 
-  uint32_t sp = 0, pc = 0;
+  static const int kRegisterCount =
+      sizeof(kRegisterNames) / sizeof(kRegisterNames[0]) - 1;
 
-  // Populate a dictionary with the valid register values in last_frame.
-  CFIFrameInfo::RegisterValueMap<uint32_t> callee_registers;
-  // Use the STACK CFI data to recover the caller's register values.
-  CFIFrameInfo::RegisterValueMap<uint32_t> caller_registers;
-
-  for (int i = 0; kRegisterNames[i]; ++i) {
-    caller_registers[kRegisterNames[i]] = last_frame->context.iregs[i];
-    callee_registers[kRegisterNames[i]] = last_frame->context.iregs[i];
-  }
+  // Populate a register file with the register values in last_frame.
+  CFIFrameInfo::RegisterFile<uint32_t> callee_registers;
+  for (int i = 0; i < kRegisterCount; ++i)
+    callee_registers.Set(i, last_frame->context.iregs[i]);
 
-  if (!cfi_frame_info->FindCallerRegs(callee_registers, *memory_,
-                                      &caller_registers))  {
+  // Use the STACK CFI data to recover the caller's register values.
+  CFIFrameInfo::RegisterFile<uint32_t> caller_registers;
+  uint32_t cfa, ra;
+  if (!cfi_frame_info->FindCallerRegs(kRegisterNames, kRegisterCount,
+                                      callee_registers, *memory_,
+                                      &caller_registers, &cfa, &ra)) {
     return NULL;
   }
 
-  CFIFrameInfo::RegisterValueMap<uint32_t>::const_iterator entry =
-      caller_registers.find(".cfa");
+  // The CFA is the caller's $sp, and the return address is its $ra.
+  caller_registers.Set(MD_CONTEXT_MIPS_REG_SP, cfa);
+  caller_registers.Set(MD_CONTEXT_MIPS_REG_RA, ra);
+  uint32_t pc = ra - 2 * sizeof(pc);
 
-  if (entry != caller_registers.end()) {
-    sp = entry->second;
-    caller_registers["$sp"] = entry->second;
-  }
-
-  entry = caller_registers.find(".ra");
-  if (entry != caller_registers.end()) {
-    caller_registers["$ra"] = entry->second;
-    pc = entry->second - 2 * sizeof(pc);
-  }
-  caller_registers["$pc"] = pc;
   // Construct a new stack frame given the values the CFI recovered.
-  scoped_ptr<StackFrameMIPS> frame(new StackFrameMIPS());
+  scoped_ptr<StackFrameMIPS> frame(new (frame_arena_) StackFrameMIPS());
 
-  for (int i = 0; kRegisterNames[i]; ++i) {
-    CFIFrameInfo::RegisterValueMap<uint32_t>::const_iterator caller_entry =
-        caller_registers.find(kRegisterNames[i]);
-
-    if (caller_entry != caller_registers.end()) {
+  for (int i = 0; i < kRegisterCount; ++i) {
+    if (caller_registers.Has(i)) {
       // The value of this register is recovered; fill the context with the
       // value from caller_registers.
-      frame->context.iregs[i] = caller_entry->second;
+      frame->context.iregs[i] = caller_registers.Get(i);
       frame->context_validity |= StackFrameMIPS::RegisterValidFlag(i);
     } else if (((i >= INDEX_MIPS_REG_S0 && i <= INDEX_MIPS_REG_S7) ||
                 (i > INDEX_MIPS_REG_GP && i < INDEX_MIPS_REG_RA)) &&
@@ -153,11 +142,11 @@ StackFrameMIPS* StackwalkerMIPS::GetCallerByCFIFrameInfo(
     }
   }
 
-  frame->context.epc = caller_registers["$pc"];
-  frame->instruction = caller_registers["$pc"];
+  frame->context.epc = pc;
+  frame->instruction = pc;
   frame->context_validity |= StackFrameMIPS::CONTEXT_VALID_PC;
   
-  frame->context.iregs[MD_CONTEXT_MIPS_REG_RA] = caller_registers["$ra"];
+  frame->context.iregs[MD_CONTEXT_MIPS_REG_RA] = ra;
   frame->context_validity |= StackFrameMIPS::CONTEXT_VALID_RA;
 
   frame->trust = StackFrame::FRAME_TRUST_CFI;
@@ -177,10 +166,12 @@ StackFrame* StackwalkerMIPS::GetCallerFrame(const CallStack* stack,
   scoped_ptr<StackFrameMIPS> new_frame;
 
   // See if there is DWARF call frame information covering this address.
-  scoped_ptr<CFIFrameInfo> cfi_frame_info(
-    frame_symbolizer_->FindCFIFrameInfo(last_frame));
-  if (cfi_frame_info.get())
-    new_frame.reset(GetCallerByCFIFrameInfo(frames, cfi_frame_info.get()));
+  if (AllowedUnwindMethods(last_frame) & UnwindPolicy::METHOD_CFI) {
+    scoped_ptr<CFIFrameInfo> cfi_frame_info(
+      frame_symbolizer_->FindCFIFrameInfo(last_frame));
+    if (cfi_frame_info.get())
+      new_frame.reset(GetCallerByCFIFrameInfo(frames, cfi_frame_info.get()));
+  }
 
   // If caller frame is not found in CFI try analyzing the stack.
   if (stack_scan_allowed && !new_frame.get()) {
@@ -249,8 +240,7 @@ StackFrameMIPS* StackwalkerMIPS::GetCallerByStackScan(
       return NULL;
     }
     // Get $fp stored in the stack frame.
-    if (!memory_->GetMemoryAtAddress(caller_sp - sizeof(caller_pc),
-                                     &caller_fp)) {
+    if (!ReadStackMemory(caller_sp - sizeof(caller_pc), &caller_fp)) {
       BPLOG(INFO) << " GetMemoryAtAddress for fp failed " ;
       return NULL;
     }
@@ -277,7 +267,7 @@ StackFrameMIPS* StackwalkerMIPS::GetCallerByStackScan(
 
   // Create a new stack frame (ownership will be transferred to the caller)
   // and fill it in.
-  StackFrameMIPS* frame = new StackFrameMIPS();
+  StackFrameMIPS* frame = new (frame_arena_) StackFrameMIPS();
   frame->trust = StackFrame::FRAME_TRUST_SCAN;
   frame->context = last_frame->context;
   frame->context.epc = caller_pc;
@@ -68,7 +68,7 @@ StackFrame* StackwalkerPPC::GetContextFrame() {
     return NULL;
   }
 
-  StackFramePPC* frame = new StackFramePPC();
+  StackFramePPC* frame = new (frame_arena_) StackFramePPC();
 
   // The instruction pointer is stored directly in a register, so pull it
   // straight out of the CPU context structure.
@@ -104,8 +104,7 @@ StackFrame* StackwalkerPPC::GetCallerFrame(const CallStack* stack,
   // Anything else is an error, or an indication that we've reached the
   // end of the stack.
   uint32_t stack_pointer;
-  if (!memory_->GetMemoryAtAddress(last_frame->context.gpr[1],
-                                   &stack_pointer) ||
+  if (!ReadStackMemory(last_frame->context.gpr[1], &stack_pointer) ||
       stack_pointer <= last_frame->context.gpr[1]) {
     return NULL;
   }
@@ -116,12 +115,12 @@ StackFrame* StackwalkerPPC::GetCallerFrame(const CallStack* stack,
   // so check for them here and return false (end of stack) when they're
   // hit to avoid having a phantom frame.
   uint32_t instruction;
-  if (!memory_->GetMemoryAtAddress(stack_pointer + 8, &instruction) ||
+  if (!ReadStackMemory(stack_pointer + 8, &instruction) ||
       instruction <= 1) {
     return NULL;
   }
 
-  StackFramePPC* frame = new StackFramePPC();
+  StackFramePPC* frame = new (frame_arena_) StackFramePPC();
 
   frame->context = last_frame->context;
   frame->context.srr0 = instruction;
@@ -59,7 +59,7 @@ StackFrame* StackwalkerPPC64::GetContextFrame() {
     return NULL;
   }
 
-  StackFramePPC64* frame = new StackFramePPC64();
+  StackFramePPC64* frame = new (frame_arena_) StackFramePPC64();
 
   // The instruction pointer is stored directly in a register, so pull it
   // straight out of the CPU context structure.
@@ -95,8 +95,7 @@ StackFrame* StackwalkerPPC64::GetCallerFrame(const CallStack* stack,
   // Anything else is an error, or an indication that we've reached the
   // end of the stack.
   uint64_t stack_pointer;
-  if (!memory_->GetMemoryAtAddress(last_frame->context.gpr[1],
-                                   &stack_pointer) ||
+  if (!ReadStackMemory(last_frame->context.gpr[1], &stack_pointer) ||
       stack_pointer <= last_frame->context.gpr[1]) {
     return NULL;
   }
@@ -107,12 +106,12 @@ StackFrame* StackwalkerPPC64::GetCallerFrame(const CallStack* stack,
   // so check for them here and return false (end of stack) when they're
   // hit to avoid having a phantom frame.
   uint64_t instruction;
-  if (!memory_->GetMemoryAtAddress(stack_pointer + 16, &instruction) ||
+  if (!ReadStackMemory(stack_pointer + 16, &instruction) ||
       instruction <= 1) {
     return NULL;
   }
 
-  StackFramePPC64* frame = new StackFramePPC64();
+  StackFramePPC64* frame = new (frame_arena_) StackFramePPC64();
 
   frame->context = last_frame->context;
   frame->context.srr0 = instruction;
@@ -59,7 +59,7 @@ StackFrame* StackwalkerSPARC::GetContextFrame() {
     return NULL;
   }
 
-  StackFrameSPARC* frame = new StackFrameSPARC();
+  StackFrameSPARC* frame = new (frame_arena_) StackFrameSPARC();
 
   // The instruction pointer is stored directly in a register, so pull it
   // straight out of the CPU context structure.
@@ -100,18 +100,18 @@ StackFrame* StackwalkerSPARC::GetCallerFrame(const CallStack* stack,
   }
 
   uint32_t instruction;
-  if (!memory_->GetMemoryAtAddress(stack_pointer + 60,
-                     &instruction) || instruction <= 1) {
+  if (!ReadStackMemory(stack_pointer + 60, &instruction) ||
+      instruction <= 1) {
     return NULL;
   }
 
   uint32_t stack_base;
-  if (!memory_->GetMemoryAtAddress(stack_pointer + 56,
-                     &stack_base) || stack_base <= 1) {
+  if (!ReadStackMemory(stack_pointer + 56, &stack_base) ||
+      stack_base <= 1) {
     return NULL;
   }
 
-  StackFrameSPARC* frame = new StackFrameSPARC();
+  StackFrameSPARC* frame = new (frame_arena_) StackFrameSPARC();
 
   frame->context = last_frame->context;
   frame->context.g_r[14] = stack_pointer;
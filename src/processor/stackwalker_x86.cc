@@ -42,8 +42,8 @@
 #include "google_breakpad/processor/memory_region.h"
 #include "google_breakpad/processor/source_line_resolver_interface.h"
 #include "google_breakpad/processor/stack_frame_cpu.h"
+#include "google_breakpad/processor/unwind_policy.h"
 #include "processor/logging.h"
-#include "processor/postfix_evaluator-inl.h"
 #include "processor/stackwalker_x86.h"
 #include "processor/windows_frame_info.h"
 #include "processor/cfi_frame_info.h"
@@ -57,6 +57,16 @@ namespace google_breakpad {
 // smaller than 128 KB.
 static const uint32_t kMaxReasonableGapBetweenFrames = 128 * 1024;
 
+// The programs for frames without a program string of their own.  See
+// GetCallerByWindowsFrameInfo.
+static const char kBasePointerProgram[] =
+    "$eip .raSearchStart ^ = "
+    "$ebp $esp .cbCalleeParams + .cbSavedRegs + 8 - ^ = "
+    "$esp .raSearchStart 4 + =";
+static const char kNoBasePointerProgram[] =
+    "$eip .raSearchStart ^ = "
+    "$esp .raSearchStart 4 + =";
+
 const StackwalkerX86::CFIWalker::RegisterSet
 StackwalkerX86::cfi_register_map_[] = {
   // It may seem like $eip and $esp are callee-saves, because (with Unix or
@@ -92,7 +102,9 @@ StackwalkerX86::StackwalkerX86(const SystemInfo* system_info,
     : Stackwalker(system_info, memory, modules, resolver_helper),
       context_(context),
       cfi_walker_(cfi_register_map_,
-                  (sizeof(cfi_register_map_) / sizeof(cfi_register_map_[0]))) {
+                  (sizeof(cfi_register_map_) / sizeof(cfi_register_map_[0]))),
+      base_pointer_program_(kBasePointerProgram),
+      no_base_pointer_program_(kNoBasePointerProgram) {
   if (memory_ && memory_->GetBase() + memory_->GetSize() - 1 > 0xffffffff) {
     // The x86 is a 32-bit CPU, the limits of the supplied stack are invalid.
     // Mark memory_ = NULL, which will cause stackwalking to fail.
@@ -123,7 +135,7 @@ StackFrame* StackwalkerX86::GetContextFrame() {
     return NULL;
   }
 
-  StackFrameX86* frame = new StackFrameX86();
+  StackFrameX86* frame = new (frame_arena_) StackFrameX86();
 
   // The instruction pointer is stored directly in a register, so pull it
   // straight out of the CPU context structure.
@@ -200,80 +212,23 @@ StackFrameX86* StackwalkerX86::GetCallerByWindowsFrameInfo(
     }
   }
 
-  // Set up the dictionary for the PostfixEvaluator.  %ebp and %esp are used
-  // in each program string, and their previous values are known, so set them
-  // here.
-  PostfixEvaluator<uint32_t>::DictionaryType dictionary;
-  // Provide the current register values.
-  dictionary["$ebp"] = last_frame->context.ebp;
-  dictionary["$esp"] = last_frame->context.esp;
-  // Provide constants from the debug info for last_frame and its callee.
-  // .cbCalleeParams is a Breakpad extension that allows us to use the
-  // PostfixEvaluator engine when certain types of debugging information
-  // are present without having to write the constants into the program
-  // string as literals.
-  dictionary[".cbCalleeParams"] = last_frame_callee_parameter_size;
-  dictionary[".cbSavedRegs"] = last_frame_info->saved_register_size;
-  dictionary[".cbLocals"] = last_frame_info->local_size;
-
-  uint32_t raSearchStart = last_frame->context.esp +
-                           last_frame_callee_parameter_size +
-                           last_frame_info->local_size +
-                           last_frame_info->saved_register_size;
-
-  uint32_t raSearchStartOld = raSearchStart;
-  uint32_t found = 0;  // dummy value
-  // Scan up to three words above the calculated search value, in case
-  // the stack was aligned to a quadword boundary.
-  //
-  // TODO(ivan.penkov): Consider cleaning up the scan for return address that
-  // follows.  The purpose of this scan is to adjust the .raSearchStart
-  // calculation (which is based on register %esp) in the cases where register
-  // %esp may have been aligned (up to a quadword).  There are two problems
-  // with this approach:
-  //  1) In practice, 64 byte boundary alignment is seen which clearly can not
-  //     be handled by a three word scan.
-  //  2) A search for a return address is "guesswork" by definition because
-  //     the results will be different depending on what is left on the stack
-  //     from previous executions.
-  // So, basically, the results from this scan should be ignored if other means
-  // for calculation of the value of .raSearchStart are available.
-  if (ScanForReturnAddress(raSearchStart, &raSearchStart, &found, 3) &&
-      last_frame->trust == StackFrame::FRAME_TRUST_CONTEXT &&
-      last_frame->windows_frame_info != NULL &&
-      last_frame_info->type_ == WindowsFrameInfo::STACK_INFO_FPO &&
-      raSearchStartOld == raSearchStart &&
-      found == last_frame->context.eip) {
-    // The context frame represents an FPO-optimized Windows system call.
-    // On the top of the stack we have a pointer to the current instruction.
-    // This means that the callee has returned but the return address is still
-    // on the top of the stack which is very atypical situaltion.
-    // Skip one slot from the stack and do another scan in order to get the
-    // actual return address.
-    raSearchStart += 4;
-    ScanForReturnAddress(raSearchStart, &raSearchStart, &found, 3);
-  }
-
-  dictionary[".cbParams"] = last_frame_info->parameter_size;
-
   // Decide what type of program string to use. The program string is in
-  // postfix notation and will be passed to PostfixEvaluator::Evaluate.
-  // Given the dictionary and the program string, it is possible to compute
-  // the return address and the values of other registers in the calling
-  // function. Because of bugs described below, the stack may need to be
-  // scanned for these values. The results of program string evaluation
-  // will be used to determine whether to scan for better values.
-  string program_string;
+  // postfix notation, and is evaluated as compiled by WindowsFrameProgram.
+  // Given the values set up below and the program string, it is possible
+  // to compute the return address and the values of other registers in the
+  // calling function. Because of bugs described below, the stack may need
+  // to be scanned for these values. The results of program string
+  // evaluation will be used to determine whether to scan for better values.
+  const WindowsFrameProgram* program;
   bool recover_ebp = true;
 
-  trust = StackFrame::FRAME_TRUST_CFI;
   if (!last_frame_info->program_string.empty()) {
     // The FPO data has its own program string, which will tell us how to
     // get to the caller frame, and may even fill in the values of
     // nonvolatile registers and provide pointers to local variables and
     // parameters.  In some cases, particularly with program strings that use
     // .raSearchStart, the stack may need to be scanned afterward.
-    program_string = last_frame_info->program_string;
+    program = &last_frame_info->program;
   } else if (last_frame_info->allocates_base_pointer) {
     // The function corresponding to the last frame doesn't use the frame
     // pointer for conventional purposes, but it does allocate a new
@@ -310,9 +265,7 @@ StackFrameX86* StackwalkerX86::GetCallerByWindowsFrameInfo(
     // %eip_new = *(%esp_old + callee_params + saved_regs + locals)
     // %ebp_new = *(%esp_old + callee_params + saved_regs - 8)
     // %esp_new = %esp_old + callee_params + saved_regs + locals + 4
-    program_string = "$eip .raSearchStart ^ = "
-        "$ebp $esp .cbCalleeParams + .cbSavedRegs + 8 - ^ = "
-        "$esp .raSearchStart 4 + =";
+    program = &base_pointer_program_;
   } else {
     // The function corresponding to the last frame doesn't use %ebp at
     // all.  The callee frame is located relative to %esp.
@@ -333,11 +286,69 @@ StackFrameX86* StackwalkerX86::GetCallerByWindowsFrameInfo(
     // %eip_new = *(%esp_old + callee_params + saved_regs + locals)
     // %esp_new = %esp_old + callee_params + saved_regs + locals + 4
     // %ebp_new = %ebp_old
-    program_string = "$eip .raSearchStart ^ = "
-        "$esp .raSearchStart 4 + =";
+    program = &no_base_pointer_program_;
     recover_ebp = false;
   }
 
+  // Set up the variables for the program.  %ebp and %esp are used in each
+  // program string, and their previous values are known, so set them here.
+  WindowsFrameProgram::Environment environment(*program);
+  // Provide the current register values.
+  environment.Set(WindowsFrameProgram::kEBP, last_frame->context.ebp);
+  environment.Set(WindowsFrameProgram::kESP, last_frame->context.esp);
+  // Provide constants from the debug info for last_frame and its callee.
+  // .cbCalleeParams is a Breakpad extension that allows us to use the
+  // program string engine when certain types of debugging information
+  // are present without having to write the constants into the program
+  // string as literals.
+  environment.Set(WindowsFrameProgram::kCalleeParams,
+                  last_frame_callee_parameter_size);
+  environment.Set(WindowsFrameProgram::kSavedRegs,
+                  last_frame_info->saved_register_size);
+  environment.Set(WindowsFrameProgram::kLocals, last_frame_info->local_size);
+
+  uint32_t raSearchStart = last_frame->context.esp +
+                           last_frame_callee_parameter_size +
+                           last_frame_info->local_size +
+                           last_frame_info->saved_register_size;
+
+  uint32_t raSearchStartOld = raSearchStart;
+  uint32_t found = 0;  // dummy value
+  // Scan up to three words above the calculated search value, in case
+  // the stack was aligned to a quadword boundary.
+  //
+  // TODO(ivan.penkov): Consider cleaning up the scan for return address that
+  // follows.  The purpose of this scan is to adjust the .raSearchStart
+  // calculation (which is based on register %esp) in the cases where register
+  // %esp may have been aligned (up to a quadword).  There are two problems
+  // with this approach:
+  //  1) In practice, 64 byte boundary alignment is seen which clearly can not
+  //     be handled by a three word scan.
+  //  2) A search for a return address is "guesswork" by definition because
+  //     the results will be different depending on what is left on the stack
+  //     from previous executions.
+  // So, basically, the results from this scan should be ignored if other means
+  // for calculation of the value of .raSearchStart are available.
+  if (ScanForReturnAddress(raSearchStart, &raSearchStart, &found, 3) &&
+      last_frame->trust == StackFrame::FRAME_TRUST_CONTEXT &&
+      last_frame->windows_frame_info != NULL &&
+      last_frame_info->type_ == WindowsFrameInfo::STACK_INFO_FPO &&
+      raSearchStartOld == raSearchStart &&
+      found == last_frame->context.eip) {
+    // The context frame represents an FPO-optimized Windows system call.
+    // On the top of the stack we have a pointer to the current instruction.
+    // This means that the callee has returned but the return address is still
+    // on the top of the stack which is very atypical situaltion.
+    // Skip one slot from the stack and do another scan in order to get the
+    // actual return address.
+    raSearchStart += 4;
+    ScanForReturnAddress(raSearchStart, &raSearchStart, &found, 3);
+  }
+
+  environment.Set(WindowsFrameProgram::kParams,
+                  last_frame_info->parameter_size);
+  trust = StackFrame::FRAME_TRUST_CFI;
+
   // Check for alignment operators in the program string.  If alignment
   // operators are found, then current %ebp must be valid and it is the only
   // reliable data point that can be used for getting to the previous frame.
@@ -350,23 +361,20 @@ StackFrameX86* StackwalkerX86::GetCallerByWindowsFrameInfo(
   // For some more details on this topic, take a look at the following thread:
   // https://groups.google.com/forum/#!topic/google-breakpad-dev/ZP1FA9B1JjM
   if ((StackFrameX86::CONTEXT_VALID_EBP & last_frame->context_validity) != 0 &&
-      program_string.find('@') != string::npos) {
+      program->uses_align()) {
     raSearchStart = last_frame->context.ebp + 4;
   }
 
   // The difference between raSearch and raSearchStart is unknown,
   // but making them the same seems to work well in practice.
-  dictionary[".raSearchStart"] = raSearchStart;
-  dictionary[".raSearch"] = raSearchStart;
+  environment.Set(WindowsFrameProgram::kRASearchStart, raSearchStart);
+  environment.Set(WindowsFrameProgram::kRASearch, raSearchStart);
 
   // Now crank it out, making sure that the program string set at least the
   // two required variables.
-  PostfixEvaluator<uint32_t> evaluator =
-      PostfixEvaluator<uint32_t>(&dictionary, memory_);
-  PostfixEvaluator<uint32_t>::DictionaryValidityType dictionary_validity;
-  if (!evaluator.Evaluate(program_string, &dictionary_validity) ||
-      dictionary_validity.find("$eip") == dictionary_validity.end() ||
-      dictionary_validity.find("$esp") == dictionary_validity.end()) {
+  if (!program->Evaluate(memory_, &environment) ||
+      !environment.Assigned(WindowsFrameProgram::kEIP) ||
+      !environment.Assigned(WindowsFrameProgram::kESP)) {
     // Program string evaluation failed. It may be that %eip is not somewhere
     // with stack frame info, and %ebp is pointing to non-stack memory, so
     // our evaluation couldn't succeed. We'll scan the stack for a return
@@ -386,8 +394,8 @@ StackFrameX86* StackwalkerX86::GetCallerByWindowsFrameInfo(
     // This seems like a reasonable return address. Since program string
     // evaluation failed, use it and set %esp to the location above the
     // one where the return address was found.
-    dictionary["$eip"] = eip;
-    dictionary["$esp"] = location + 4;
+    environment.Set(WindowsFrameProgram::kEIP, eip);
+    environment.Set(WindowsFrameProgram::kESP, location + 4);
     trust = StackFrame::FRAME_TRUST_SCAN;
   }
 
@@ -398,7 +406,8 @@ StackFrameX86* StackwalkerX86::GetCallerByWindowsFrameInfo(
   // However, if program string evaluation resulted in both %eip and
   // %ebp values of 0, trust that the end of the stack has been
   // reached and don't scan for anything else.
-  if (dictionary["$eip"] != 0 || dictionary["$ebp"] != 0) {
+  if (environment.Get(WindowsFrameProgram::kEIP) != 0 ||
+      environment.Get(WindowsFrameProgram::kEBP) != 0) {
     int offset = 0;
 
     // This scan can only be done if a CodeModules object is available, to
@@ -413,11 +422,12 @@ StackFrameX86* StackwalkerX86::GetCallerByWindowsFrameInfo(
     // ability, older OSes (pre-XP SP2) and CPUs (pre-P4) don't enforce
     // an independent execute privilege on memory pages.
 
-    uint32_t eip = dictionary["$eip"];
+    uint32_t eip = environment.Get(WindowsFrameProgram::kEIP);
     if (modules_ && !modules_->GetModuleForAddress(eip)) {
       // The instruction pointer at .raSearchStart was invalid, so start
       // looking one 32-bit word above that location.
-      uint32_t location_start = dictionary[".raSearchStart"] + 4;
+      uint32_t location_start =
+          environment.Get(WindowsFrameProgram::kRASearchStart) + 4;
       uint32_t location;
       if (stack_scan_allowed
           && ScanForReturnAddress(location_start, &location, &eip,
@@ -425,8 +435,8 @@ StackFrameX86* StackwalkerX86::GetCallerByWindowsFrameInfo(
         // This is a better return address that what program string
         // evaluation found.  Use it, and set %esp to the location above the
         // one where the return address was found.
-        dictionary["$eip"] = eip;
-        dictionary["$esp"] = location + 4;
+        environment.Set(WindowsFrameProgram::kEIP, eip);
+        environment.Set(WindowsFrameProgram::kESP, location + 4);
         offset = location - location_start;
         trust = StackFrame::FRAME_TRUST_CFI_SCAN;
       }
@@ -440,7 +450,7 @@ StackFrameX86* StackwalkerX86::GetCallerByWindowsFrameInfo(
       // stack.  The scan is performed from the highest possible address to
       // the lowest, because the expectation is that the function's prolog
       // would have saved %ebp early.
-      uint32_t ebp = dictionary["$ebp"];
+      uint32_t ebp = environment.Get(WindowsFrameProgram::kEBP);
 
       // When a scan for return address is used, it is possible to skip one or
       // more frames (when return address is not in a known module).  One
@@ -450,7 +460,7 @@ StackFrameX86* StackwalkerX86::GetCallerByWindowsFrameInfo(
         (trust != StackFrame::FRAME_TRUST_CFI && ebp <= raSearchStart + offset);
 
       uint32_t value;  // throwaway variable to check pointer validity
-      if (has_skipped_frames || !memory_->GetMemoryAtAddress(ebp, &value)) {
+      if (has_skipped_frames || !ReadStackMemory(ebp, &value)) {
         int fp_search_bytes = last_frame_info->saved_register_size + offset;
         uint32_t location_end = last_frame->context.esp +
                                  last_frame_callee_parameter_size;
@@ -458,13 +468,13 @@ StackFrameX86* StackwalkerX86::GetCallerByWindowsFrameInfo(
         for (uint32_t location = location_end + fp_search_bytes;
              location >= location_end;
              location -= 4) {
-          if (!memory_->GetMemoryAtAddress(location, &ebp))
+          if (!ReadStackMemory(location, &ebp))
             break;
 
-          if (memory_->GetMemoryAtAddress(ebp, &value)) {
+          if (ReadStackMemory(ebp, &value)) {
             // The candidate value is a pointer to the same memory region
             // (the stack).  Prefer it as a recovered %ebp result.
-            dictionary["$ebp"] = ebp;
+            environment.Set(WindowsFrameProgram::kEBP, ebp);
             break;
           }
         }
@@ -474,29 +484,29 @@ StackFrameX86* StackwalkerX86::GetCallerByWindowsFrameInfo(
 
   // Create a new stack frame (ownership will be transferred to the caller)
   // and fill it in.
-  StackFrameX86* frame = new StackFrameX86();
+  StackFrameX86* frame = new (frame_arena_) StackFrameX86();
 
   frame->trust = trust;
   frame->context = last_frame->context;
-  frame->context.eip = dictionary["$eip"];
-  frame->context.esp = dictionary["$esp"];
-  frame->context.ebp = dictionary["$ebp"];
+  frame->context.eip = environment.Get(WindowsFrameProgram::kEIP);
+  frame->context.esp = environment.Get(WindowsFrameProgram::kESP);
+  frame->context.ebp = environment.Get(WindowsFrameProgram::kEBP);
   frame->context_validity = StackFrameX86::CONTEXT_VALID_EIP |
                                 StackFrameX86::CONTEXT_VALID_ESP |
                                 StackFrameX86::CONTEXT_VALID_EBP;
 
   // These are nonvolatile (callee-save) registers, and the program string
   // may have filled them in.
-  if (dictionary_validity.find("$ebx") != dictionary_validity.end()) {
-    frame->context.ebx = dictionary["$ebx"];
+  if (environment.Assigned(WindowsFrameProgram::kEBX)) {
+    frame->context.ebx = environment.Get(WindowsFrameProgram::kEBX);
     frame->context_validity |= StackFrameX86::CONTEXT_VALID_EBX;
   }
-  if (dictionary_validity.find("$esi") != dictionary_validity.end()) {
-    frame->context.esi = dictionary["$esi"];
+  if (environment.Assigned(WindowsFrameProgram::kESI)) {
+    frame->context.esi = environment.Get(WindowsFrameProgram::kESI);
     frame->context_validity |= StackFrameX86::CONTEXT_VALID_ESI;
   }
-  if (dictionary_validity.find("$edi") != dictionary_validity.end()) {
-    frame->context.edi = dictionary["$edi"];
+  if (environment.Assigned(WindowsFrameProgram::kEDI)) {
+    frame->context.edi = environment.Get(WindowsFrameProgram::kEDI);
     frame->context_validity |= StackFrameX86::CONTEXT_VALID_EDI;
   }
 
@@ -509,7 +519,7 @@ StackFrameX86* StackwalkerX86::GetCallerByCFIFrameInfo(
   StackFrameX86* last_frame = static_cast<StackFrameX86*>(frames.back());
   last_frame->cfi_frame_info = cfi_frame_info;
 
-  scoped_ptr<StackFrameX86> frame(new StackFrameX86());
+  scoped_ptr<StackFrameX86> frame(new (frame_arena_) StackFrameX86());
   if (!cfi_walker_
       .FindCallerRegisters(*memory_, *cfi_frame_info,
                            last_frame->context, last_frame->context_validity,
@@ -530,6 +540,7 @@ StackFrameX86* StackwalkerX86::GetCallerByCFIFrameInfo(
 
 StackFrameX86* StackwalkerX86::GetCallerByEBPAtBase(
     const vector<StackFrame*> &frames,
+    bool frame_pointer_allowed,
     bool stack_scan_allowed) {
   StackFrame::FrameTrust trust;
   StackFrameX86* last_frame = static_cast<StackFrameX86*>(frames.back());
@@ -561,8 +572,9 @@ StackFrameX86* StackwalkerX86::GetCallerByEBPAtBase(
 
   uint32_t caller_eip, caller_esp, caller_ebp;
 
-  if (memory_->GetMemoryAtAddress(last_ebp + 4, &caller_eip) &&
-      memory_->GetMemoryAtAddress(last_ebp, &caller_ebp)) {
+  if (frame_pointer_allowed &&
+      ReadStackMemory(last_ebp + 4, &caller_eip) &&
+      ReadStackMemory(last_ebp, &caller_ebp)) {
     caller_esp = last_ebp + 8;
     trust = StackFrame::FRAME_TRUST_FP;
   } else {
@@ -570,7 +582,8 @@ StackFrameX86* StackwalkerX86::GetCallerByEBPAtBase(
     // is pointing to non-stack memory. We'll scan the stack for a
     // return address. This can happen if last_frame is executing code
     // for a module for which we don't have symbols, and that module
-    // is compiled without a frame pointer.
+    // is compiled without a frame pointer.  The unwind policy may also
+    // skip frame pointers for the module.
     if (!stack_scan_allowed
         || !ScanForReturnAddress(last_esp, &caller_esp, &caller_eip,
                                  frames.size() == 1 /* is_context_frame */)) {
@@ -588,7 +601,7 @@ StackFrameX86* StackwalkerX86::GetCallerByEBPAtBase(
     // A valid caller %ebp must be greater than the address where it is stored
     // and the gap between the two adjacent frames should be reasonable.
     uint32_t restored_ebp_chain = caller_esp - 8;
-    if (!memory_->GetMemoryAtAddress(restored_ebp_chain, &caller_ebp) ||
+    if (!ReadStackMemory(restored_ebp_chain, &caller_ebp) ||
         caller_ebp <= restored_ebp_chain ||
         caller_ebp - restored_ebp_chain > kMaxReasonableGapBetweenFrames) {
       // The restored %ebp chain doesn't appear to be valid.
@@ -601,7 +614,7 @@ StackFrameX86* StackwalkerX86::GetCallerByEBPAtBase(
 
   // Create a new stack frame (ownership will be transferred to the caller)
   // and fill it in.
-  StackFrameX86* frame = new StackFrameX86();
+  StackFrameX86* frame = new (frame_arena_) StackFrameX86();
 
   frame->trust = trust;
   frame->context = last_frame->context;
@@ -625,16 +638,19 @@ StackFrame* StackwalkerX86::GetCallerFrame(const CallStack* stack,
   const vector<StackFrame*> &frames = *stack->frames();
   StackFrameX86* last_frame = static_cast<StackFrameX86*>(frames.back());
   scoped_ptr<StackFrameX86> new_frame;
+  int methods = AllowedUnwindMethods(last_frame);
 
   // If the resolver has Windows stack walking information, use that.
-  WindowsFrameInfo* windows_frame_info
-      = frame_symbolizer_->FindWindowsFrameInfo(last_frame);
-  if (windows_frame_info)
-    new_frame.reset(GetCallerByWindowsFrameInfo(frames, windows_frame_info,
-                                                stack_scan_allowed));
+  if (methods & UnwindPolicy::METHOD_CFI) {
+    WindowsFrameInfo* windows_frame_info
+        = frame_symbolizer_->FindWindowsFrameInfo(last_frame);
+    if (windows_frame_info)
+      new_frame.reset(GetCallerByWindowsFrameInfo(frames, windows_frame_info,
+                                                  stack_scan_allowed));
+  }
 
   // If the resolver has DWARF CFI information, use that.
-  if (!new_frame.get()) {
+  if ((methods & UnwindPolicy::METHOD_CFI) && !new_frame.get()) {
     CFIFrameInfo* cfi_frame_info =
         frame_symbolizer_->FindCFIFrameInfo(last_frame);
     if (cfi_frame_info)
@@ -642,8 +658,11 @@ StackFrame* StackwalkerX86::GetCallerFrame(const CallStack* stack,
   }
 
   // Otherwise, hope that the program was using a traditional frame structure.
-  if (!new_frame.get())
-    new_frame.reset(GetCallerByEBPAtBase(frames, stack_scan_allowed));
+  if (!new_frame.get()) {
+    new_frame.reset(GetCallerByEBPAtBase(
+        frames, (methods & UnwindPolicy::METHOD_FRAME_POINTER) != 0,
+        stack_scan_allowed));
+  }
 
   // If nothing worked, tell the caller.
   if (!new_frame.get())
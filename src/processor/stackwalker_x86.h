@@ -47,6 +47,7 @@
 #include "google_breakpad/processor/stackwalker.h"
 #include "google_breakpad/processor/stack_frame_cpu.h"
 #include "processor/cfi_frame_info.h"
+#include "processor/windows_frame_program.h"
 
 namespace google_breakpad {
 
@@ -94,9 +95,12 @@ class StackwalkerX86 : public Stackwalker {
   // Assuming a traditional frame layout --- where the caller's %ebp
   // has been pushed just after the return address and the callee's
   // %ebp points to the saved %ebp --- construct the frame that called
-  // frames.back(). The caller takes ownership of the returned frame.
+  // frames.back(), falling back to scanning the stack if that fails.
+  // |frame_pointer_allowed| and |stack_scan_allowed| say which of the
+  // two may be used.  The caller takes ownership of the returned frame.
   // Return NULL on failure.
   StackFrameX86* GetCallerByEBPAtBase(const vector<StackFrame*> &frames,
+                                      bool frame_pointer_allowed,
                                       bool stack_scan_allowed);
 
   // Stores the CPU context corresponding to the innermost stack frame to
@@ -108,6 +112,12 @@ class StackwalkerX86 : public Stackwalker {
 
   // Our CFI frame walker.
   const CFIWalker cfi_walker_;
+
+  // The programs GetCallerByWindowsFrameInfo uses for frames whose
+  // WindowsFrameInfo has no program string of its own, for functions that
+  // allocate a base pointer and for those that don't.
+  const WindowsFrameProgram base_pointer_program_;
+  const WindowsFrameProgram no_base_pointer_program_;
 };
 
 
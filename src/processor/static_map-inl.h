@@ -56,68 +56,52 @@ StaticMap<Key, Value, Compare>::StaticMap(const char* raw_data)
       raw_data_ + (1 + num_nodes_) * sizeof(uint32_t));
 }
 
-// find(), lower_bound() and upper_bound() implement binary search algorithm.
+// find(), lower_bound() and upper_bound() share one binary search.  It
+// narrows the range without branching on the comparison, so that the
+// compiler can use a conditional move rather than mispredicting half of
+// the probes, and it prefetches the keys either outcome probes next.  The
+// maps are read-only, so the keys can be read straight from keys_, without
+// GetKeyAtIndex's range check.
+template<typename Key, typename Value, typename Compare>
+int StaticMap<Key, Value, Compare>::LowerBoundIndex(const Key &key) const {
+  if (num_nodes_ <= 0)
+    return 0;
+  const Key *base = keys_;
+  int count = num_nodes_;
+  while (count > 1) {
+    int half = count / 2;
+#if defined(__GNUC__)
+    __builtin_prefetch(base + half / 2);
+    __builtin_prefetch(base + half + half / 2);
+#endif
+    base = compare_(base[half], key) < 0 ? base + half : base;
+    count -= half;
+  }
+  return static_cast<int>(base - keys_) + (compare_(*base, key) < 0);
+}
+
 template<typename Key, typename Value, typename Compare>
 StaticMapIterator<Key, Value, Compare>
 StaticMap<Key, Value, Compare>::find(const Key &key) const {
-  int begin = 0;
-  int end = num_nodes_;
-  int middle;
-  int compare_result;
-  while (begin < end) {
-    middle = begin + (end - begin) / 2;
-    compare_result = compare_(key, GetKeyAtIndex(middle));
-    if (compare_result == 0)
-      return IteratorAtIndex(middle);
-    if (compare_result < 0) {
-      end = middle;
-    } else {
-      begin = middle + 1;
-    }
-  }
+  int index = LowerBoundIndex(key);
+  if (index < num_nodes_ && compare_(key, keys_[index]) == 0)
+    return IteratorAtIndex(index);
   return this->end();
 }
 
 template<typename Key, typename Value, typename Compare>
 StaticMapIterator<Key, Value, Compare>
 StaticMap<Key, Value, Compare>::lower_bound(const Key &key) const {
-  int begin = 0;
-  int end = num_nodes_;
-  int middle;
-  int comp_result;
-  while (begin < end) {
-    middle = begin + (end - begin) / 2;
-    comp_result = compare_(key, GetKeyAtIndex(middle));
-    if (comp_result == 0)
-      return IteratorAtIndex(middle);
-    if (comp_result < 0) {
-      end = middle;
-    } else {
-      begin = middle + 1;
-    }
-  }
-  return IteratorAtIndex(begin);
+  return IteratorAtIndex(LowerBoundIndex(key));
 }
 
 template<typename Key, typename Value, typename Compare>
 StaticMapIterator<Key, Value, Compare>
 StaticMap<Key, Value, Compare>::upper_bound(const Key &key) const {
-  int begin = 0;
-  int end = num_nodes_;
-  int middle;
-  int compare_result;
-  while (begin < end) {
-    middle = begin + (end - begin) / 2;
-    compare_result = compare_(key, GetKeyAtIndex(middle));
-    if (compare_result == 0)
-      return IteratorAtIndex(middle + 1);
-    if (compare_result < 0) {
-      end = middle;
-    } else {
-      begin = middle + 1;
-    }
-  }
-  return IteratorAtIndex(begin);
+  int index = LowerBoundIndex(key);
+  if (index < num_nodes_ && compare_(key, keys_[index]) == 0)
+    ++index;
+  return IteratorAtIndex(index);
 }
 
 template<typename Key, typename Value, typename Compare>
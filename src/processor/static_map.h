@@ -122,6 +122,9 @@ class StaticMap {
  private:
   const Key GetKeyAtIndex(int i) const;
 
+  // Returns the index of the first key not less than |key|, or num_nodes_.
+  int LowerBoundIndex(const Key &key) const;
+
   // Start address of a raw memory chunk with serialized data.
   const char* raw_data_;
 
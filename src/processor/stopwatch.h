@@ -0,0 +1,87 @@
+// Copyright (c) 2016 Google Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+// notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above
+// copyright notice, this list of conditions and the following disclaimer
+// in the documentation and/or other materials provided with the
+// distribution.
+//     * Neither the name of Google Inc. nor the names of its
+// contributors may be used to endorse or promote products derived from
+// this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+// stopwatch.h: Stopwatch, which measures elapsed wall-clock time for the
+// processor's statistics.
+//
+// Stopwatch is built on gettimeofday, or on the performance counter on
+// Windows.
+
+#ifndef PROCESSOR_STOPWATCH_H__
+#define PROCESSOR_STOPWATCH_H__
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/time.h>
+#endif  // _WIN32
+
+namespace google_breakpad {
+
+class Stopwatch {
+ public:
+  // Creates a stopwatch that starts running at once.
+  Stopwatch() { Restart(); }
+
+  // Starts measuring again from now.
+  void Restart() {
+#ifdef _WIN32
+    QueryPerformanceCounter(&start_);
+#else
+    gettimeofday(&start_, NULL);
+#endif  // _WIN32
+  }
+
+  // Returns the number of seconds since the stopwatch was created or last
+  // restarted.
+  double ElapsedSeconds() const {
+#ifdef _WIN32
+    LARGE_INTEGER now, frequency;
+    QueryPerformanceCounter(&now);
+    QueryPerformanceFrequency(&frequency);
+    return static_cast<double>(now.QuadPart - start_.QuadPart) /
+           frequency.QuadPart;
+#else
+    struct timeval now;
+    gettimeofday(&now, NULL);
+    return (now.tv_sec - start_.tv_sec) + (now.tv_usec - start_.tv_usec) / 1e6;
+#endif  // _WIN32
+  }
+
+ private:
+#ifdef _WIN32
+  LARGE_INTEGER start_;
+#else
+  struct timeval start_;
+#endif  // _WIN32
+};
+
+}  // namespace google_breakpad
+
+#endif  // PROCESSOR_STOPWATCH_H__
@@ -0,0 +1,227 @@
+// Copyright (c) 2016 Google Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+// notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above
+// copyright notice, this list of conditions and the following disclaimer
+// in the documentation and/or other materials provided with the
+// distribution.
+//     * Neither the name of Google Inc. nor the names of its
+// contributors may be used to endorse or promote products derived from
+// this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+// symbol_affinity_router.cc: Implementation of SymbolAffinityRouter.
+//
+// See symbol_affinity_router.h for documentation.
+
+#include "google_breakpad/processor/symbol_affinity_router.h"
+
+#include <assert.h>
+#include <stdio.h>
+
+#include <algorithm>
+#include <utility>
+
+#include "google_breakpad/processor/code_module.h"
+#include "google_breakpad/processor/code_modules.h"
+
+namespace google_breakpad {
+
+namespace {
+
+using std::map;
+using std::set;
+using std::vector;
+
+// Orders modules largest first, then by key, so that the dominant modules
+// don't depend on the order of the module list.
+struct LargerModule {
+  bool operator()(const CodeModule* a, const CodeModule* b) const {
+    if (a->size() != b->size())
+      return a->size() > b->size();
+    return SymbolAffinityRouter::KeyForModule(a) <
+        SymbolAffinityRouter::KeyForModule(b);
+  }
+};
+
+}  // namespace
+
+const int SymbolAffinityRouter::kDefaultReplicas;
+const size_t SymbolAffinityRouter::kDefaultDominantModules;
+
+SymbolAffinityRouter::SymbolAffinityRouter(int replicas,
+                                           size_t dominant_module_count)
+    : replicas_(replicas),
+      dominant_module_count_(dominant_module_count),
+      nodes_(),
+      ring_() {
+  assert(replicas_ > 0);
+}
+
+bool SymbolAffinityRouter::AddNode(const string& name,
+                                   size_t* moved_modules) {
+  if (nodes_.find(name) != nodes_.end())
+    return false;
+  nodes_[name].stats.name = name;
+  for (int i = 0; i < replicas_; ++i)
+    ring_.insert(std::make_pair(ReplicaHash(name, i), name));
+
+  if (moved_modules) {
+    set<string> moved;
+    for (NodeMap::const_iterator node = nodes_.begin(); node != nodes_.end();
+         ++node) {
+      for (set<string>::const_iterator key = node->second.modules.begin();
+           key != node->second.modules.end(); ++key) {
+        if (NodeForKey(*key) == name)
+          moved.insert(*key);
+      }
+    }
+    *moved_modules = moved.size();
+  }
+  return true;
+}
+
+bool SymbolAffinityRouter::RemoveNode(const string& name,
+                                      size_t* moved_modules) {
+  NodeMap::iterator node = nodes_.find(name);
+  if (node == nodes_.end())
+    return false;
+  if (moved_modules)
+    *moved_modules = node->second.modules.size();
+  nodes_.erase(node);
+
+  for (Ring::iterator point = ring_.begin(); point != ring_.end(); ) {
+    if (point->second == name)
+      ring_.erase(point++);
+    else
+      ++point;
+  }
+  return true;
+}
+
+void SymbolAffinityRouter::DominantModules(
+    const CodeModules* modules,
+    vector<const CodeModule*>* dominant) const {
+  dominant->clear();
+  if (!modules)
+    return;
+  for (unsigned int i = 0; i < modules->module_count(); ++i) {
+    const CodeModule* module = modules->GetModuleAtIndex(i);
+    if (!SymbolAffinityRouter::KeyForModule(module).empty())
+      dominant->push_back(module);
+  }
+  std::sort(dominant->begin(), dominant->end(), LargerModule());
+  if (dominant->size() > dominant_module_count_)
+    dominant->resize(dominant_module_count_);
+}
+
+string SymbolAffinityRouter::NodeForKey(const string& key) const {
+  if (ring_.empty())
+    return string();
+  Ring::const_iterator point = ring_.lower_bound(Hash(key));
+  if (point == ring_.end())
+    point = ring_.begin();
+  return point->second;
+}
+
+string SymbolAffinityRouter::Route(const CodeModules* modules,
+                                   const string& fallback_key) {
+  if (nodes_.empty())
+    return string();
+
+  vector<const CodeModule*> dominant;
+  DominantModules(modules, &dominant);
+  vector<string> keys;
+  map<string, uint64_t> votes;
+  for (size_t i = 0; i < dominant.size(); ++i) {
+    keys.push_back(SymbolAffinityRouter::KeyForModule(dominant[i]));
+    // A module's vote is its size, but even an empty module counts.
+    votes[NodeForKey(keys.back())] += dominant[i]->size() + 1;
+  }
+
+  string chosen;
+  if (votes.empty()) {
+    chosen = NodeForKey(fallback_key);
+  } else {
+    // Ties go to the node first by name.
+    uint64_t most_votes = 0;
+    for (map<string, uint64_t>::const_iterator vote = votes.begin();
+         vote != votes.end(); ++vote) {
+      if (vote->second > most_votes) {
+        most_votes = vote->second;
+        chosen = vote->first;
+      }
+    }
+  }
+
+  Node& node = nodes_[chosen];
+  ++node.stats.minidumps;
+  for (size_t i = 0; i < keys.size(); ++i) {
+    if (node.modules.insert(keys[i]).second)
+      ++node.stats.misses;
+    else
+      ++node.stats.hits;
+  }
+  return chosen;
+}
+
+void SymbolAffinityRouter::GetStats(vector<NodeStats>* stats) const {
+  stats->clear();
+  for (NodeMap::const_iterator node = nodes_.begin(); node != nodes_.end();
+       ++node) {
+    stats->push_back(node->second.stats);
+    stats->back().modules = node->second.modules.size();
+  }
+}
+
+// static
+string SymbolAffinityRouter::KeyForModule(const CodeModule* module) {
+  string debug_file = module->debug_file();
+  string debug_identifier = module->debug_identifier();
+  if (debug_file.empty() || debug_identifier.empty())
+    return string();
+  return debug_file + "|" + debug_identifier;
+}
+
+// static
+uint64_t SymbolAffinityRouter::Hash(const string& key) {
+  // 64-bit FNV-1a, followed by a finalizer so that similar keys, like the
+  // names of a node's replicas, land far apart on the ring.
+  uint64_t hash = 14695981039346656037ULL;
+  for (size_t i = 0; i < key.size(); ++i) {
+    hash ^= static_cast<unsigned char>(key[i]);
+    hash *= 1099511628211ULL;
+  }
+  hash ^= hash >> 33;
+  hash *= 0xff51afd7ed558ccdULL;
+  hash ^= hash >> 33;
+  hash *= 0xc4ceb9fe1a85ec53ULL;
+  hash ^= hash >> 33;
+  return hash;
+}
+
+// static
+uint64_t SymbolAffinityRouter::ReplicaHash(const string& name, int replica) {
+  char suffix[16];
+  snprintf(suffix, sizeof(suffix), "#%d", replica);
+  return Hash(name + suffix);
+}
+
+}  // namespace google_breakpad
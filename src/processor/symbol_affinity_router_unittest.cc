@@ -0,0 +1,215 @@
+// Copyright (c) 2016 Google Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+// notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above
+// copyright notice, this list of conditions and the following disclaimer
+// in the documentation and/or other materials provided with the
+// distribution.
+//     * Neither the name of Google Inc. nor the names of its
+// contributors may be used to endorse or promote products derived from
+// this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+// symbol_affinity_router_unittest.cc: Unit tests for SymbolAffinityRouter.
+
+#include <stdio.h>
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include "breakpad_googletest_includes.h"
+#include "common/using_std_string.h"
+#include "google_breakpad/processor/symbol_affinity_router.h"
+#include "processor/stackwalker_unittest_utils.h"
+
+namespace {
+
+using google_breakpad::SymbolAffinityRouter;
+using std::map;
+using std::vector;
+
+// MockCodeModule uses its code file as every name, so a module's key is
+// "<name>|<name>".
+string Key(const string& name) {
+  return name + "|" + name;
+}
+
+string Name(const char* prefix, int i) {
+  char name[32];
+  snprintf(name, sizeof(name), "%s%d", prefix, i);
+  return name;
+}
+
+class SymbolAffinityRouterTest : public ::testing::Test {
+ public:
+  SymbolAffinityRouterTest()
+      : router_(SymbolAffinityRouter::kDefaultReplicas, 2) { }
+
+  ~SymbolAffinityRouterTest() {
+    for (size_t i = 0; i < modules_.size(); ++i)
+      delete modules_[i];
+  }
+
+  // Adds a module |name| of |size| bytes to |modules|.
+  void AddModule(const string& name, uint64_t size,
+                 MockCodeModules* modules) {
+    uint64_t base = 0x10000000 * (modules->module_count() + 1);
+    modules_.push_back(new MockCodeModule(base, size, name, "1"));
+    modules->Add(modules_.back());
+  }
+
+  void AddNodes(int count) {
+    for (int i = 0; i < count; ++i)
+      ASSERT_TRUE(router_.AddNode(Name("node", i), NULL));
+  }
+
+  SymbolAffinityRouter router_;
+  vector<const MockCodeModule*> modules_;
+};
+
+TEST_F(SymbolAffinityRouterTest, NoNodes) {
+  MockCodeModules modules;
+  AddModule("libc.so", 0x1000, &modules);
+  EXPECT_EQ("", router_.NodeForKey(Key("libc.so")));
+  EXPECT_EQ("", router_.Route(&modules, "dump"));
+}
+
+TEST_F(SymbolAffinityRouterTest, DominantModules) {
+  MockCodeModules modules;
+  AddModule("small", 0x100, &modules);
+  AddModule("largest", 0x3000, &modules);
+  AddModule("large", 0x2000, &modules);
+  vector<const google_breakpad::CodeModule*> dominant;
+  router_.DominantModules(&modules, &dominant);
+  ASSERT_EQ(2U, dominant.size());
+  EXPECT_EQ("largest", dominant[0]->code_file());
+  EXPECT_EQ("large", dominant[1]->code_file());
+
+  router_.DominantModules(NULL, &dominant);
+  EXPECT_TRUE(dominant.empty());
+}
+
+TEST_F(SymbolAffinityRouterTest, RoutesByTheLargestModules) {
+  AddNodes(4);
+
+  // Whatever owns a much larger module wins the vote, and the small
+  // module, which isn't dominant, has no say.
+  MockCodeModules modules;
+  AddModule("app", 0x100000, &modules);
+  AddModule("libc.so", 0x1000, &modules);
+  AddModule("tiny.so", 0x10, &modules);
+  string node = router_.Route(&modules, "dump");
+  EXPECT_EQ(router_.NodeForKey(Key("app")), node);
+
+  // The same modules in another order go to the same node, where they
+  // are hits.
+  MockCodeModules reordered;
+  AddModule("tiny.so", 0x10, &reordered);
+  AddModule("libc.so", 0x1000, &reordered);
+  AddModule("app", 0x100000, &reordered);
+  EXPECT_EQ(node, router_.Route(&reordered, "another dump"));
+
+  vector<SymbolAffinityRouter::NodeStats> stats;
+  router_.GetStats(&stats);
+  ASSERT_EQ(4U, stats.size());
+  for (size_t i = 0; i < stats.size(); ++i) {
+    if (stats[i].name == node) {
+      EXPECT_EQ(2U, stats[i].minidumps);
+      EXPECT_EQ(2U, stats[i].hits);
+      EXPECT_EQ(2U, stats[i].misses);
+      EXPECT_EQ(2U, stats[i].modules);
+    } else {
+      EXPECT_EQ(0U, stats[i].minidumps);
+    }
+  }
+}
+
+TEST_F(SymbolAffinityRouterTest, FallsBackToTheKey) {
+  AddNodes(4);
+  EXPECT_EQ(router_.NodeForKey("dump"), router_.Route(NULL, "dump"));
+  MockCodeModules empty;
+  EXPECT_EQ(router_.NodeForKey("dump"), router_.Route(&empty, "dump"));
+}
+
+TEST_F(SymbolAffinityRouterTest, SpreadsModules) {
+  AddNodes(4);
+  map<string, int> owned;
+  for (int i = 0; i < 4000; ++i)
+    ++owned[router_.NodeForKey(Key(Name("module", i)))];
+  ASSERT_EQ(4U, owned.size());
+  for (map<string, int>::const_iterator node = owned.begin();
+       node != owned.end(); ++node) {
+    EXPECT_LT(500, node->second) << node->first;
+    EXPECT_GT(1500, node->second) << node->first;
+  }
+}
+
+TEST_F(SymbolAffinityRouterTest, Rebalances) {
+  AddNodes(4);
+  EXPECT_FALSE(router_.AddNode("node0", NULL));
+  EXPECT_FALSE(router_.RemoveNode("node4", NULL));
+
+  const int kModules = 400;
+  vector<string> owners;
+  for (int i = 0; i < kModules; ++i) {
+    MockCodeModules modules;
+    AddModule(Name("module", i), 0x1000, &modules);
+    owners.push_back(router_.Route(&modules, "dump"));
+    EXPECT_EQ(router_.NodeForKey(Key(Name("module", i))), owners.back());
+  }
+
+  // A new node takes modules only from the others.
+  size_t moved = 0;
+  ASSERT_TRUE(router_.AddNode("node4", &moved));
+  size_t taken = 0;
+  for (int i = 0; i < kModules; ++i) {
+    string owner = router_.NodeForKey(Key(Name("module", i)));
+    if (owner != owners[i]) {
+      EXPECT_EQ("node4", owner);
+      ++taken;
+    }
+  }
+  EXPECT_EQ(taken, moved);
+  EXPECT_LT(0U, moved);
+
+  // When it leaves, its modules go back where they were.
+  ASSERT_TRUE(router_.RemoveNode("node4", &moved));
+  EXPECT_EQ(0U, moved);
+  for (int i = 0; i < kModules; ++i)
+    EXPECT_EQ(owners[i], router_.NodeForKey(Key(Name("module", i))));
+
+  // When an old node leaves, only its own modules move, and the router
+  // forgets what it was sent.
+  vector<SymbolAffinityRouter::NodeStats> stats;
+  router_.GetStats(&stats);
+  ASSERT_TRUE(router_.RemoveNode("node1", &moved));
+  EXPECT_EQ(stats[1].modules, moved);
+  for (int i = 0; i < kModules; ++i) {
+    string owner = router_.NodeForKey(Key(Name("module", i)));
+    EXPECT_NE("node1", owner);
+    if (owners[i] != "node1")
+      EXPECT_EQ(owners[i], owner);
+  }
+  router_.GetStats(&stats);
+  EXPECT_EQ(3U, stats.size());
+}
+
+}  // namespace
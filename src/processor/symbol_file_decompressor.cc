@@ -0,0 +1,333 @@
+// Copyright (c) 2016 Google Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+// notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above
+// copyright notice, this list of conditions and the following disclaimer
+// in the documentation and/or other materials provided with the
+// distribution.
+//     * Neither the name of Google Inc. nor the names of its
+// contributors may be used to endorse or promote products derived from
+// this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+// symbol_file_decompressor.cc: Reads compressed symbol files.
+//
+// See symbol_file_decompressor.h for documentation.
+
+#include "processor/symbol_file_decompressor.h"
+
+#ifndef _WIN32
+#include <dlfcn.h>
+#include <pthread.h>
+#endif  // _WIN32
+#include <stdio.h>
+#include <string.h>
+
+#include "common/scoped_ptr.h"
+#include "processor/logging.h"
+
+namespace google_breakpad {
+
+#ifndef _WIN32
+
+namespace {
+
+// How much of the compressed file is read at a time.
+const size_t kInputBufferSize = 128 * 1024;
+
+void *OpenLibrary(const char *const *library_names, size_t count) {
+  void *library = NULL;
+  for (size_t i = 0; !library && i < count; ++i) {
+    library = dlopen(library_names[i], RTLD_NOW);
+  }
+  return library;
+}
+
+// The zlib functions used, looked up at run time.
+struct Zlib {
+  void *(*gzopen)(const char *, const char *);
+  int (*gzbuffer)(void *, unsigned);
+  int (*gzread)(void *, void *, unsigned);
+  const char *(*gzerror)(void *, int *);
+  int (*gzclose)(void *);
+
+  // Returns NULL if zlib or any of the functions can't be found.
+  static Zlib *Load() {
+    const char *kLibraryNames[] = { "libz.so.1", "libz.so", "libz.dylib",
+                                    "libz.1.dylib" };
+    void *library = OpenLibrary(
+        kLibraryNames, sizeof(kLibraryNames) / sizeof(kLibraryNames[0]));
+    if (!library) {
+      BPLOG(ERROR) << "Could not load zlib; gzip-compressed symbol files "
+                      "can't be read";
+      return NULL;
+    }
+
+    scoped_ptr<Zlib> zlib(new Zlib());
+#define LOAD_ZLIB_FUNCTION(var, type) \
+    zlib->var = reinterpret_cast<type>(dlsym(library, #var)); \
+    if (!zlib->var) { \
+      BPLOG(ERROR) << "Could not find zlib function " #var; \
+      dlclose(library); \
+      return NULL; \
+    }
+
+    LOAD_ZLIB_FUNCTION(gzopen, void *(*)(const char *, const char *));
+    LOAD_ZLIB_FUNCTION(gzbuffer, int (*)(void *, unsigned));
+    LOAD_ZLIB_FUNCTION(gzread, int (*)(void *, void *, unsigned));
+    LOAD_ZLIB_FUNCTION(gzerror, const char *(*)(void *, int *));
+    LOAD_ZLIB_FUNCTION(gzclose, int (*)(void *));
+#undef LOAD_ZLIB_FUNCTION
+    return zlib.release();
+  }
+};
+
+// ZSTD_inBuffer and ZSTD_outBuffer, from zstd.h.
+struct ZstdInBuffer {
+  const void *src;
+  size_t size;
+  size_t pos;
+};
+
+struct ZstdOutBuffer {
+  void *dst;
+  size_t size;
+  size_t pos;
+};
+
+// The libzstd functions used, looked up at run time.
+struct Zstd {
+  void *(*ZSTD_createDStream)(void);
+  size_t (*ZSTD_initDStream)(void *);
+  size_t (*ZSTD_decompressStream)(void *, ZstdOutBuffer *, ZstdInBuffer *);
+  unsigned (*ZSTD_isError)(size_t);
+  const char *(*ZSTD_getErrorName)(size_t);
+  size_t (*ZSTD_freeDStream)(void *);
+
+  // Returns NULL if libzstd or any of the functions can't be found.
+  static Zstd *Load() {
+    const char *kLibraryNames[] = { "libzstd.so.1", "libzstd.so",
+                                    "libzstd.dylib", "libzstd.1.dylib" };
+    void *library = OpenLibrary(
+        kLibraryNames, sizeof(kLibraryNames) / sizeof(kLibraryNames[0]));
+    if (!library) {
+      BPLOG(ERROR) << "Could not load libzstd; zstd-compressed symbol files "
+                      "can't be read";
+      return NULL;
+    }
+
+    scoped_ptr<Zstd> zstd(new Zstd());
+#define LOAD_ZSTD_FUNCTION(var, type) \
+    zstd->var = reinterpret_cast<type>(dlsym(library, #var)); \
+    if (!zstd->var) { \
+      BPLOG(ERROR) << "Could not find libzstd function " #var; \
+      dlclose(library); \
+      return NULL; \
+    }
+
+    LOAD_ZSTD_FUNCTION(ZSTD_createDStream, void *(*)(void));
+    LOAD_ZSTD_FUNCTION(ZSTD_initDStream, size_t (*)(void *));
+    LOAD_ZSTD_FUNCTION(ZSTD_decompressStream,
+                       size_t (*)(void *, ZstdOutBuffer *, ZstdInBuffer *));
+    LOAD_ZSTD_FUNCTION(ZSTD_isError, unsigned (*)(size_t));
+    LOAD_ZSTD_FUNCTION(ZSTD_getErrorName, const char *(*)(size_t));
+    LOAD_ZSTD_FUNCTION(ZSTD_freeDStream, size_t (*)(void *));
+#undef LOAD_ZSTD_FUNCTION
+    return zstd.release();
+  }
+};
+
+// The libraries are loaded once, and kept for the life of the process.
+pthread_once_t zlib_once = PTHREAD_ONCE_INIT;
+Zlib *zlib = NULL;
+pthread_once_t zstd_once = PTHREAD_ONCE_INIT;
+Zstd *zstd = NULL;
+
+void LoadZlib() { zlib = Zlib::Load(); }
+void LoadZstd() { zstd = Zstd::Load(); }
+
+class GzipDecompressor : public SymbolFileDecompressor {
+ public:
+  GzipDecompressor(const string &path, void *file)
+      : SymbolFileDecompressor(path), file_(file) {
+    // A larger buffer than zlib's default means fewer, larger reads.
+    zlib->gzbuffer(file_, kInputBufferSize);
+  }
+
+  virtual ~GzipDecompressor() {
+    zlib->gzclose(file_);
+  }
+
+  virtual bool Read(char *buffer, size_t size, size_t *bytes_read) {
+    *bytes_read = 0;
+    // gzread takes an unsigned size and returns an int.
+    if (size > 1 << 30)
+      size = 1 << 30;
+    int result = zlib->gzread(file_, buffer, static_cast<unsigned>(size));
+    int error = 0;
+    const char *message = NULL;
+    if (result <= 0)
+      message = zlib->gzerror(file_, &error);
+    if (result < 0 || error != 0) {
+      BPLOG(ERROR) << "Could not decompress " << path() << ": "
+                   << (message ? message : "read failed");
+      return false;
+    }
+    *bytes_read = static_cast<size_t>(result);
+    return true;
+  }
+
+ private:
+  void *file_;
+};
+
+class ZstdDecompressor : public SymbolFileDecompressor {
+ public:
+  ZstdDecompressor(const string &path, FILE *file, void *stream)
+      : SymbolFileDecompressor(path),
+        file_(file),
+        stream_(stream),
+        input_buffer_(new char[kInputBufferSize]),
+        at_eof_(false),
+        frame_remaining_(0) {
+    input_.src = input_buffer_.get();
+    input_.size = 0;
+    input_.pos = 0;
+  }
+
+  virtual ~ZstdDecompressor() {
+    zstd->ZSTD_freeDStream(stream_);
+    fclose(file_);
+  }
+
+  virtual bool Read(char *buffer, size_t size, size_t *bytes_read) {
+    *bytes_read = 0;
+    ZstdOutBuffer output = { buffer, size, 0 };
+    while (output.pos == 0) {
+      if (input_.pos == input_.size && !at_eof_) {
+        input_.size = fread(input_buffer_.get(), 1, kInputBufferSize, file_);
+        input_.pos = 0;
+        if (input_.size == 0) {
+          if (ferror(file_)) {
+            BPLOG(ERROR) << "Could not read " << path();
+            return false;
+          }
+          at_eof_ = true;
+        }
+      }
+
+      // Stop once the input is used up and the last frame was decoded and
+      // flushed.  Otherwise, with no input left, this still flushes any
+      // output the stream holds.
+      if (input_.pos == input_.size && at_eof_ && frame_remaining_ == 0)
+        break;
+      size_t result = zstd->ZSTD_decompressStream(stream_, &output, &input_);
+      if (zstd->ZSTD_isError(result)) {
+        BPLOG(ERROR) << "Could not decompress " << path() << ": "
+                     << zstd->ZSTD_getErrorName(result);
+        return false;
+      }
+      frame_remaining_ = result;
+
+      if (output.pos == 0 && at_eof_ && input_.pos == input_.size) {
+        // A nonzero result means the last frame isn't complete.
+        if (frame_remaining_ != 0) {
+          BPLOG(ERROR) << "Could not decompress " << path()
+                       << ": data is truncated";
+          return false;
+        }
+        break;
+      }
+    }
+    *bytes_read = output.pos;
+    return true;
+  }
+
+ private:
+  FILE *file_;
+  void *stream_;
+  scoped_array<char> input_buffer_;
+  ZstdInBuffer input_;
+  bool at_eof_;
+
+  // The last ZSTD_decompressStream result: 0 when a frame has just been
+  // completely decoded and flushed, or before any data has been read.
+  size_t frame_remaining_;
+};
+
+}  // namespace
+
+#endif  // _WIN32
+
+// static
+SymbolFileDecompressor *SymbolFileDecompressor::Open(const string &path) {
+#ifdef _WIN32
+  return NULL;
+#else  // _WIN32
+  FILE *file = fopen(path.c_str(), "rb");
+  if (!file) {
+    BPLOG(ERROR) << "Could not open " << path;
+    return NULL;
+  }
+
+  unsigned char magic[4];
+  size_t magic_size = fread(magic, 1, sizeof(magic), file);
+
+  static const unsigned char kGzipMagic[] = { 0x1f, 0x8b };
+  static const unsigned char kZstdMagic[] = { 0x28, 0xb5, 0x2f, 0xfd };
+  if (magic_size >= sizeof(kGzipMagic) &&
+      memcmp(magic, kGzipMagic, sizeof(kGzipMagic)) == 0) {
+    fclose(file);
+    pthread_once(&zlib_once, LoadZlib);
+    if (!zlib)
+      return NULL;
+    void *gz_file = zlib->gzopen(path.c_str(), "rb");
+    if (!gz_file) {
+      BPLOG(ERROR) << "Could not open " << path;
+      return NULL;
+    }
+    return new GzipDecompressor(path, gz_file);
+  }
+
+  if (magic_size >= sizeof(kZstdMagic) &&
+      memcmp(magic, kZstdMagic, sizeof(kZstdMagic)) == 0) {
+    pthread_once(&zstd_once, LoadZstd);
+    void *stream = zstd ? zstd->ZSTD_createDStream() : NULL;
+    if (!stream) {
+      fclose(file);
+      return NULL;
+    }
+    if (zstd->ZSTD_isError(zstd->ZSTD_initDStream(stream)) ||
+        fseek(file, 0, SEEK_SET) != 0) {
+      BPLOG(ERROR) << "Could not start decompressing " << path;
+      zstd->ZSTD_freeDStream(stream);
+      fclose(file);
+      return NULL;
+    }
+    return new ZstdDecompressor(path, file, stream);
+  }
+
+  BPLOG(ERROR) << path << " is not gzip- or zstd-compressed";
+  fclose(file);
+  return NULL;
+#endif  // _WIN32
+}
+
+}  // namespace google_breakpad
@@ -0,0 +1,84 @@
+// Copyright (c) 2016 Google Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+// notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above
+// copyright notice, this list of conditions and the following disclaimer
+// in the documentation and/or other materials provided with the
+// distribution.
+//     * Neither the name of Google Inc. nor the names of its
+// contributors may be used to endorse or promote products derived from
+// this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+// symbol_file_decompressor.h: Reads compressed symbol files.
+//
+// A symbol store may keep its text symbol files compressed, with gzip
+// (.sym.gz) or zstd (.sym.zst).  SymbolFileDecompressor reads such a file a
+// piece at a time, so that the symbols can be parsed as they are
+// decompressed rather than after the whole text has been inflated into
+// memory.
+//
+// zlib and libzstd are loaded at run time, the first time a file needs
+// them.  A file compressed in a format whose library can't be loaded can't
+// be opened.  Compressed symbol files aren't supported on Windows.
+
+#ifndef PROCESSOR_SYMBOL_FILE_DECOMPRESSOR_H__
+#define PROCESSOR_SYMBOL_FILE_DECOMPRESSOR_H__
+
+#include <stddef.h>
+
+#include <string>
+
+#include "common/using_std_string.h"
+
+namespace google_breakpad {
+
+class SymbolFileDecompressor {
+ public:
+  // Opens the compressed file at |path|, telling its format from its first
+  // bytes.  Returns NULL if the file can't be opened, isn't compressed in a
+  // supported format, or the library for its format can't be loaded.  The
+  // caller takes ownership of the returned object.
+  static SymbolFileDecompressor *Open(const string &path);
+
+  virtual ~SymbolFileDecompressor() {}
+
+  // Decompresses up to |size| bytes into |buffer|, setting |*bytes_read|
+  // to the number stored, which is 0 only at the end of the data.  Returns
+  // false if the file can't be read or its data is corrupt or truncated.
+  virtual bool Read(char *buffer, size_t size, size_t *bytes_read) = 0;
+
+  // The path the decompressor was opened with.
+  const string &path() const { return path_; }
+
+ protected:
+  explicit SymbolFileDecompressor(const string &path) : path_(path) {}
+
+ private:
+  string path_;
+
+  // Disallow copy constructor and assignment operator.
+  SymbolFileDecompressor(const SymbolFileDecompressor&);
+  void operator=(const SymbolFileDecompressor&);
+};
+
+}  // namespace google_breakpad
+
+#endif  // PROCESSOR_SYMBOL_FILE_DECOMPRESSOR_H__
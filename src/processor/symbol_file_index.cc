@@ -0,0 +1,343 @@
+// Copyright (c) 2016 Google Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+// notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above
+// copyright notice, this list of conditions and the following disclaimer
+// in the documentation and/or other materials provided with the
+// distribution.
+//     * Neither the name of Google Inc. nor the names of its
+// contributors may be used to endorse or promote products derived from
+// this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+// symbol_file_index.cc: Builds and reads symbol file indexes.
+//
+// See symbol_file_index.h for documentation.
+
+#include "processor/symbol_file_index.h"
+
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#ifndef _WIN32
+#include <sys/mman.h>
+#include <unistd.h>
+#endif  // _WIN32
+
+#include <algorithm>
+#include <limits>
+#include <vector>
+
+#include "google_breakpad/processor/basic_source_line_resolver.h"
+#include "processor/logging.h"
+
+namespace google_breakpad {
+
+using std::vector;
+
+namespace {
+
+const char kSymbolFileIndexMagic[8] = { 'B', 'P', 'S', 'Y', 'M', 'I', 'X',
+                                        '1' };
+const uint32_t kSymbolFileIndexVersion = 1;
+
+bool StartsWith(const char *line, size_t length, const char *prefix) {
+  size_t prefix_length = strlen(prefix);
+  return length >= prefix_length && memcmp(line, prefix, prefix_length) == 0;
+}
+
+bool CompareAddresses(const SymbolFileIndexEntry &entry1,
+                      const SymbolFileIndexEntry &entry2) {
+  return entry1.address < entry2.address;
+}
+
+#ifndef _WIN32
+// Maps the file at |path| read-only.  Returns false if it is empty or
+// can't be mapped.
+bool MapFile(const string &path, const char **data, size_t *size) {
+  int fd = open(path.c_str(), O_RDONLY);
+  if (fd == -1) {
+    string error_string;
+    int error_code = ErrnoString(&error_string);
+    BPLOG(ERROR) << "Could not open " << path <<
+        ", error " << error_code << ": " << error_string;
+    return false;
+  }
+
+  struct stat st;
+  if (fstat(fd, &st) == -1 || st.st_size <= 0 ||
+      static_cast<uint64_t>(st.st_size) > std::numeric_limits<size_t>::max()) {
+    BPLOG(ERROR) << path << " has a bad size";
+    close(fd);
+    return false;
+  }
+
+  void *mapping = mmap(NULL, static_cast<size_t>(st.st_size), PROT_READ,
+                       MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (mapping == MAP_FAILED) {
+    string error_string;
+    int error_code = ErrnoString(&error_string);
+    BPLOG(ERROR) << "Could not map " << path <<
+        ", error " << error_code << ": " << error_string;
+    return false;
+  }
+  *data = static_cast<const char*>(mapping);
+  *size = static_cast<size_t>(st.st_size);
+  return true;
+}
+#endif  // _WIN32
+
+}  // namespace
+
+// static
+void SymbolFileIndex::Build(const char *data, size_t size, string *index) {
+  vector<SymbolFileIndexEntry> entries[KIND_COUNT];
+
+  // The kind of the block that the next line may extend, or KIND_COUNT if
+  // it can't extend one.
+  Kind open_kind = KIND_COUNT;
+
+  // SymbolParseHelper modifies the lines it parses, so they are copied
+  // here first.
+  vector<char> line_copy;
+
+  size_t line_offset = 0;
+  while (line_offset < size) {
+    const char *line = data + line_offset;
+    const char *newline = static_cast<const char*>(
+        memchr(line, '\n', size - line_offset));
+    size_t length = newline ? newline - line : size - line_offset;
+    size_t next_line_offset = line_offset + length + 1;
+
+    SymbolFileIndexEntry entry;
+    entry.address = 0;
+    entry.size = 0;
+    entry.offset = line_offset;
+    entry.length = length;
+    Kind kind = KIND_COUNT;
+    line_copy.assign(line, line + length);
+    line_copy.push_back('\0');
+    char *text = &line_copy[0];
+
+    if (length == 0 || (length == 1 && line[0] == '\r')) {
+      // Blank lines are skipped by the parser, and don't end a block.
+      if (open_kind != KIND_COUNT) {
+        SymbolFileIndexEntry &open_entry = entries[open_kind].back();
+        open_entry.length = line_offset + length - open_entry.offset;
+      }
+      line_offset = next_line_offset;
+      continue;
+    } else if (StartsWith(line, length, "FILE ")) {
+      long id;
+      char *filename;
+      if (SymbolParseHelper::ParseFile(text, &id, &filename)) {
+        entry.address = id;
+        kind = FILES;
+      }
+      open_kind = KIND_COUNT;
+    } else if (StartsWith(line, length, "FUNC ")) {
+      long stack_param_size;
+      char *name;
+      open_kind = KIND_COUNT;
+      if (SymbolParseHelper::ParseFunction(text, &entry.address, &entry.size,
+                                           &stack_param_size, &name)) {
+        kind = FUNCTIONS;
+        open_kind = FUNCTIONS;
+      }
+    } else if (StartsWith(line, length, "PUBLIC ")) {
+      long stack_param_size;
+      char *name;
+      // Public symbols at address 0 are never stored, so aren't indexed.
+      if (SymbolParseHelper::ParsePublicSymbol(text, &entry.address,
+                                               &stack_param_size, &name) &&
+          entry.address != 0) {
+        kind = PUBLICS;
+      }
+      open_kind = KIND_COUNT;
+    } else if (StartsWith(line, length, "STACK CFI INIT ")) {
+      char *cursor = text + strlen("STACK CFI INIT ");
+      char *end;
+      entry.address = strtoull(cursor, &end, 16);
+      if (end != cursor) {
+        cursor = end;
+        entry.size = strtoull(cursor, &end, 16);
+      }
+      open_kind = KIND_COUNT;
+      if (end != cursor) {
+        kind = CFI;
+        open_kind = CFI;
+      }
+    } else if (StartsWith(line, length, "STACK CFI ")) {
+      // A delta record belongs to the STACK CFI INIT record before it.
+      if (open_kind != CFI)
+        open_kind = KIND_COUNT;
+    } else if (StartsWith(line, length, "STACK WIN ")) {
+      if (open_kind != WINDOWS) {
+        kind = WINDOWS;
+        open_kind = WINDOWS;
+      }
+    } else if (StartsWith(line, length, "STACK ") ||
+               StartsWith(line, length, "MODULE ") ||
+               StartsWith(line, length, "INFO ")) {
+      open_kind = KIND_COUNT;
+    } else if (open_kind != FUNCTIONS) {
+      // A line record without a function to belong to.
+      open_kind = KIND_COUNT;
+    }
+
+    if (kind != KIND_COUNT) {
+      entries[kind].push_back(entry);
+    } else if (open_kind != KIND_COUNT) {
+      SymbolFileIndexEntry &open_entry = entries[open_kind].back();
+      open_entry.length = line_offset + length - open_entry.offset;
+    }
+    line_offset = next_line_offset;
+  }
+
+  SymbolFileIndexHeader header;
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, kSymbolFileIndexMagic, sizeof(header.magic));
+  header.version = kSymbolFileIndexVersion;
+  header.symbol_file_size = size;
+  for (int kind = 0; kind < KIND_COUNT; ++kind) {
+    if (kind != WINDOWS) {
+      std::stable_sort(entries[kind].begin(), entries[kind].end(),
+                       CompareAddresses);
+    }
+    header.entry_counts[kind] = entries[kind].size();
+  }
+
+  index->assign(reinterpret_cast<const char*>(&header), sizeof(header));
+  for (int kind = 0; kind < KIND_COUNT; ++kind) {
+    if (!entries[kind].empty()) {
+      index->append(reinterpret_cast<const char*>(&entries[kind][0]),
+                    entries[kind].size() * sizeof(SymbolFileIndexEntry));
+    }
+  }
+}
+
+// static
+SymbolFileIndex *SymbolFileIndex::Open(const string &symbol_file,
+                                       const string &index_file) {
+#ifdef _WIN32
+  return NULL;
+#else  // _WIN32
+  const char *symbol_data;
+  size_t symbol_data_size;
+  if (!MapFile(symbol_file, &symbol_data, &symbol_data_size))
+    return NULL;
+  const char *index_data;
+  size_t index_data_size;
+  if (!MapFile(index_file, &index_data, &index_data_size)) {
+    munmap(const_cast<char*>(symbol_data), symbol_data_size);
+    return NULL;
+  }
+
+  const SymbolFileIndexHeader *header =
+      reinterpret_cast<const SymbolFileIndexHeader*>(index_data);
+  bool valid = index_data_size >= sizeof(*header) &&
+               memcmp(header->magic, kSymbolFileIndexMagic,
+                      sizeof(header->magic)) == 0 &&
+               header->version == kSymbolFileIndexVersion;
+  if (valid) {
+    uint64_t remaining = (index_data_size - sizeof(*header)) /
+                         sizeof(SymbolFileIndexEntry);
+    for (int kind = 0; valid && kind < KIND_COUNT; ++kind) {
+      valid = header->entry_counts[kind] <= remaining;
+      remaining -= header->entry_counts[kind];
+    }
+    valid = valid && remaining == 0;
+  }
+  if (!valid) {
+    BPLOG(ERROR) << index_file << " is not a valid symbol file index";
+  } else if (header->symbol_file_size != symbol_data_size) {
+    BPLOG(ERROR) << index_file << " was not built from " << symbol_file <<
+        " as it is now";
+    valid = false;
+  }
+  if (!valid) {
+    munmap(const_cast<char*>(index_data), index_data_size);
+    munmap(const_cast<char*>(symbol_data), symbol_data_size);
+    return NULL;
+  }
+
+  return new SymbolFileIndex(symbol_data, symbol_data_size,
+                             index_data, index_data_size);
+#endif  // _WIN32
+}
+
+SymbolFileIndex::SymbolFileIndex(const char *symbol_data,
+                                 size_t symbol_data_size,
+                                 const char *index_data,
+                                 size_t index_data_size)
+    : symbol_data_(symbol_data),
+      symbol_data_size_(symbol_data_size),
+      index_data_(index_data),
+      index_data_size_(index_data_size) {
+  const SymbolFileIndexHeader *header =
+      reinterpret_cast<const SymbolFileIndexHeader*>(index_data);
+  const SymbolFileIndexEntry *entries =
+      reinterpret_cast<const SymbolFileIndexEntry*>(header + 1);
+  for (int kind = 0; kind < KIND_COUNT; ++kind) {
+    entry_counts_[kind] = static_cast<size_t>(header->entry_counts[kind]);
+    entries_[kind] = entries;
+    entries += entry_counts_[kind];
+  }
+}
+
+SymbolFileIndex::~SymbolFileIndex() {
+#ifndef _WIN32
+  munmap(const_cast<char*>(index_data_), index_data_size_);
+  munmap(const_cast<char*>(symbol_data_), symbol_data_size_);
+#endif  // _WIN32
+}
+
+bool SymbolFileIndex::FindNearest(Kind kind, uint64_t address,
+                                  size_t *i) const {
+  SymbolFileIndexEntry key;
+  key.address = address;
+  const SymbolFileIndexEntry *begin = entries_[kind];
+  const SymbolFileIndexEntry *end = begin + entry_counts_[kind];
+  const SymbolFileIndexEntry *nearest =
+      std::upper_bound(begin, end, key, CompareAddresses);
+  if (nearest == begin)
+    return false;
+  --nearest;
+  // Of several entries at one address, the resolver keeps the first.
+  while (nearest != begin && (nearest - 1)->address == nearest->address)
+    --nearest;
+  *i = nearest - begin;
+  return true;
+}
+
+const char *SymbolFileIndex::BlockText(
+    const SymbolFileIndexEntry &entry) const {
+  if (entry.offset > symbol_data_size_ ||
+      entry.length > symbol_data_size_ - entry.offset) {
+    return NULL;
+  }
+  return symbol_data_ + entry.offset;
+}
+
+}  // namespace google_breakpad
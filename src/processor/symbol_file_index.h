@@ -0,0 +1,150 @@
+// Copyright (c) 2016 Google Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+// notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above
+// copyright notice, this list of conditions and the following disclaimer
+// in the documentation and/or other materials provided with the
+// distribution.
+//     * Neither the name of Google Inc. nor the names of its
+// contributors may be used to endorse or promote products derived from
+// this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+// symbol_file_index.h: A sidecar index of the records in a text symbol file.
+//
+// Resolving a handful of frames in a very large module doesn't need most
+// of its symbol file, but BasicSourceLineResolver normally parses all of
+// it.  A symbol file index, stored next to the symbol file with .idx
+// appended to its name, records where each block of records the resolver
+// looks up by address begins and ends, so that a module can be loaded by
+// parsing only the blocks covering the addresses it is asked about.
+//
+// The index holds one SymbolFileIndexEntry per block, grouped by kind:
+//
+//   FILES      a FILE record; |address| is the file's id
+//   FUNCTIONS  a FUNC record and the line records that follow it
+//   PUBLICS    a PUBLIC record
+//   CFI        a STACK CFI INIT record and the STACK CFI records that
+//              follow it
+//   WINDOWS    a run of consecutive STACK WIN records, which are looked up
+//              in a way that doesn't suit partial loading, and so are
+//              loaded all at once; |address| and |size| are 0
+//
+// Each group but WINDOWS is sorted by address, keeping symbol file order
+// among entries with the same address.  The file is laid out as:
+//
+//   SymbolFileIndexHeader
+//   the entries of each kind, in the order above
+//
+// Numbers are stored in the byte order of the machine that wrote the
+// index, as they are in serialized symbol files.  The index records the
+// size of the symbol file it was built from, and isn't used with a symbol
+// file of any other size.  Indexes are read by mapping them, and their
+// symbol files, into memory, which isn't supported on Windows.
+
+#ifndef PROCESSOR_SYMBOL_FILE_INDEX_H__
+#define PROCESSOR_SYMBOL_FILE_INDEX_H__
+
+#include <stddef.h>
+
+#include <string>
+
+#include "common/using_std_string.h"
+#include "google_breakpad/common/breakpad_types.h"
+
+namespace google_breakpad {
+
+struct SymbolFileIndexHeader {
+  char magic[8];                // kSymbolFileIndexMagic
+  uint32_t version;             // kSymbolFileIndexVersion
+  uint32_t reserved;
+  uint64_t symbol_file_size;
+  uint64_t entry_counts[5];     // indexed by SymbolFileIndex::Kind
+};
+
+struct SymbolFileIndexEntry {
+  uint64_t address;
+  uint64_t size;
+  uint64_t offset;              // of the block within the symbol file
+  uint64_t length;              // of the block, without its last line break
+};
+
+class SymbolFileIndex {
+ public:
+  enum Kind {
+    FILES,
+    FUNCTIONS,
+    PUBLICS,
+    CFI,
+    WINDOWS,
+    KIND_COUNT
+  };
+
+  // Builds the index of the |size| bytes of text symbol data at |data|,
+  // storing it in |*index|.
+  static void Build(const char *data, size_t size, string *index);
+
+  // Maps |symbol_file| and |index_file|, its index, into memory.  Returns
+  // NULL if either can't be mapped, or if the index isn't valid or wasn't
+  // built from a symbol file of the same size.  The caller takes ownership
+  // of the returned object.
+  static SymbolFileIndex *Open(const string &symbol_file,
+                               const string &index_file);
+
+  ~SymbolFileIndex();
+
+  size_t entry_count(Kind kind) const { return entry_counts_[kind]; }
+  const SymbolFileIndexEntry &entry(Kind kind, size_t i) const {
+    return entries_[kind][i];
+  }
+
+  // Finds the entry of |kind| with the highest address at or below
+  // |address|, the first in symbol file order if several share it, and
+  // sets |*i| to its position.  Returns false if there is none.  Not for
+  // use with WINDOWS.
+  bool FindNearest(Kind kind, uint64_t address, size_t *i) const;
+
+  // Returns the text of the block that |entry| describes, which is
+  // entry.length bytes long and not null-terminated, or NULL if the entry
+  // lies outside the symbol file.
+  const char *BlockText(const SymbolFileIndexEntry &entry) const;
+
+  size_t symbol_data_size() const { return symbol_data_size_; }
+
+ private:
+  SymbolFileIndex(const char *symbol_data, size_t symbol_data_size,
+                  const char *index_data, size_t index_data_size);
+
+  const char *symbol_data_;
+  size_t symbol_data_size_;
+  const char *index_data_;
+  size_t index_data_size_;
+  size_t entry_counts_[KIND_COUNT];
+  const SymbolFileIndexEntry *entries_[KIND_COUNT];
+
+  // Disallow copy constructor and assignment operator.
+  SymbolFileIndex(const SymbolFileIndex&);
+  void operator=(const SymbolFileIndex&);
+};
+
+}  // namespace google_breakpad
+
+#endif  // PROCESSOR_SYMBOL_FILE_INDEX_H__
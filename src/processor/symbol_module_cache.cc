@@ -0,0 +1,415 @@
+// Copyright (c) 2016 Google Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+// notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above
+// copyright notice, this list of conditions and the following disclaimer
+// in the documentation and/or other materials provided with the
+// distribution.
+//     * Neither the name of Google Inc. nor the names of its
+// contributors may be used to endorse or promote products derived from
+// this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+// symbol_module_cache.cc: Implementation of SymbolModuleCache.
+//
+// See symbol_module_cache.h for documentation.
+
+#include "google_breakpad/processor/symbol_module_cache.h"
+
+#include <assert.h>
+
+#include <utility>
+
+#include "google_breakpad/processor/code_module.h"
+#include "processor/logging.h"
+#include "processor/mutex.h"
+#include "processor/source_line_resolver_base_types.h"
+
+namespace google_breakpad {
+
+// The Module handed out to resolvers.  Lookups in the concrete modules are
+// const but are not safe to run concurrently (BasicSourceLineResolver's
+// copy linked_ptr objects, for example), so each shared module serializes
+// the lookups made through it.
+class SymbolModuleCache::SharedModule : public SymbolModuleCache::Module {
+ public:
+  SharedModule(Entry* entry, Module* symbols)
+      : entry_(entry), symbols_(symbols) {}
+  virtual ~SharedModule() { delete symbols_; }
+
+  Entry* entry() const { return entry_; }
+
+  virtual bool LoadMapFromMemory(char* memory_buffer,
+                                 size_t memory_buffer_size) {
+    // Cached modules are loaded before they are shared.
+    assert(false);
+    return false;
+  }
+
+  virtual bool IsCorrupt() const {
+    return symbols_->IsCorrupt();
+  }
+
+  virtual void LookupAddress(StackFrame* frame, bool share_names) const {
+    AutoMutex lock(&mutex_);
+    symbols_->LookupAddress(frame, share_names);
+  }
+
+  virtual void LookupAddresses(
+      const SourceLineResolverBase::MemAddr* addresses, size_t count,
+      SourceLineResolverBase::SymbolizedAddress* results) const {
+    AutoMutex lock(&mutex_);
+    symbols_->LookupAddresses(addresses, count, results);
+  }
+
+  virtual WindowsFrameInfo*
+  FindWindowsFrameInfo(const StackFrame* frame) const {
+    AutoMutex lock(&mutex_);
+    return symbols_->FindWindowsFrameInfo(frame);
+  }
+
+  virtual CFIFrameInfo* FindCFIFrameInfo(const StackFrame* frame) const {
+    AutoMutex lock(&mutex_);
+    return symbols_->FindCFIFrameInfo(frame);
+  }
+
+  virtual void GetMemoryUsage(
+      SourceLineResolverBase::ModuleMemoryUsage* usage) const {
+    AutoMutex lock(&mutex_);
+    symbols_->GetMemoryUsage(usage);
+  }
+
+ private:
+  Entry* entry_;
+  Module* symbols_;
+  mutable Mutex mutex_;
+};
+
+struct SymbolModuleCache::Entry {
+  Entry() : module(NULL), buffer(NULL), size(0), corrupt(false),
+            stale(false), references(0), last_use(0) {}
+  ~Entry() {
+    delete module;
+    delete [] buffer;
+  }
+
+  string key;
+  SharedModule* module;
+
+  // The digest under which the entry is in digests_, if any.
+  string digest;
+
+  // The symbol data, when the module refers to it after loading.
+  char* buffer;
+  size_t size;
+  bool corrupt;
+
+  // Set once the entry has been replaced or invalidated and removed from
+  // entries_.  It lives on only until its last reference is released.
+  bool stale;
+  int references;
+
+  // use_count_ when the entry was last acquired or released.
+  uint64_t last_use;
+
+  // This entry's position in unused_, valid when references is zero.
+  EntryList::iterator unused_position;
+};
+
+SymbolModuleCache::SymbolModuleCache(size_t memory_budget)
+    : memory_budget_(memory_budget),
+      memory_used_(0),
+      digest_share_count_(0),
+      generation_(0),
+      use_count_(0),
+      eviction_policy_(NULL),
+      mutex_(new Mutex) {
+}
+
+SymbolModuleCache::~SymbolModuleCache() {
+  for (EntryMap::iterator it = entries_.begin(); it != entries_.end(); ++it) {
+    BPLOG_IF(ERROR, it->second->references != 0)
+        << "SymbolModuleCache destroyed while " << it->first << " is in use";
+    delete it->second;
+  }
+  delete mutex_;
+}
+
+void SymbolModuleCache::set_memory_budget(size_t memory_budget) {
+  AutoMutex lock(mutex_);
+  memory_budget_ = memory_budget;
+  EvictLocked();
+}
+
+size_t SymbolModuleCache::module_count() const {
+  AutoMutex lock(mutex_);
+  return entries_.size();
+}
+
+size_t SymbolModuleCache::memory_used() const {
+  AutoMutex lock(mutex_);
+  return memory_used_;
+}
+
+uint64_t SymbolModuleCache::digest_share_count() const {
+  AutoMutex lock(mutex_);
+  return digest_share_count_;
+}
+
+void SymbolModuleCache::Invalidate(const string &debug_file,
+                                   const string &debug_identifier) {
+  AutoMutex lock(mutex_);
+  EntryMap::iterator it = entries_.find(debug_file + "|" + debug_identifier);
+  if (it != entries_.end())
+    DetachLocked(it->second);
+}
+
+void SymbolModuleCache::InvalidateAll() {
+  AutoMutex lock(mutex_);
+  while (!entries_.empty())
+    DetachLocked(entries_.begin()->second);
+}
+
+uint32_t SymbolModuleCache::generation() const {
+  return __atomic_load_n(&generation_, __ATOMIC_ACQUIRE);
+}
+
+void SymbolModuleCache::set_eviction_policy(EvictionPolicy *eviction_policy) {
+  AutoMutex lock(mutex_);
+  eviction_policy_ = eviction_policy;
+  EvictLocked();
+}
+
+// static
+string SymbolModuleCache::KeyForModule(const CodeModule* module) {
+  if (!module)
+    return string();
+  string debug_file = module->debug_file();
+  string debug_identifier = module->debug_identifier();
+  if (debug_file.empty() || debug_identifier.empty())
+    return string();
+  return debug_file + "|" + debug_identifier;
+}
+
+SymbolModuleCache::Module* SymbolModuleCache::Acquire(
+    const CodeModule* module, bool* corrupt) {
+  string key = KeyForModule(module);
+  if (key.empty())
+    return NULL;
+
+  AutoMutex lock(mutex_);
+  EntryMap::iterator it = entries_.find(key);
+  if (it == entries_.end())
+    return NULL;
+
+  Entry* entry = it->second;
+  if (entry->references++ == 0)
+    unused_.erase(entry->unused_position);
+  entry->last_use = ++use_count_;
+  *corrupt = entry->corrupt;
+  return entry->module;
+}
+
+SymbolModuleCache::Module* SymbolModuleCache::AcquireByDigest(
+    const string& digest, bool* corrupt) {
+  if (digest.empty())
+    return NULL;
+
+  AutoMutex lock(mutex_);
+  EntryMap::iterator it = digests_.find(digest);
+  if (it == digests_.end())
+    return NULL;
+
+  Entry* entry = it->second;
+  if (entry->references++ == 0)
+    unused_.erase(entry->unused_position);
+  entry->last_use = ++use_count_;
+  ++digest_share_count_;
+  *corrupt = entry->corrupt;
+  return entry->module;
+}
+
+SymbolModuleCache::Module* SymbolModuleCache::Insert(
+    const CodeModule* module, Module* symbols, char* buffer, size_t size,
+    const string& digest, bool* corrupt) {
+  string key = KeyForModule(module);
+  if (key.empty())
+    return NULL;
+
+  AutoMutex lock(mutex_);
+  EntryMap::iterator it = entries_.find(key);
+  if (it != entries_.end()) {
+    // Lost a race with another resolver loading the same symbols.
+    delete symbols;
+    delete [] buffer;
+    Entry* entry = it->second;
+    if (entry->references++ == 0)
+      unused_.erase(entry->unused_position);
+    entry->last_use = ++use_count_;
+    AddDigestLocked(entry, digest);
+    *corrupt = entry->corrupt;
+    return entry->module;
+  }
+
+  Entry* entry = new Entry;
+  entry->key = key;
+  entry->module = new SharedModule(entry, symbols);
+  entry->buffer = buffer;
+  entry->size = size;
+  entry->corrupt = symbols->IsCorrupt();
+  entry->references = 1;
+  entry->last_use = ++use_count_;
+  entries_.insert(std::make_pair(key, entry));
+  AddDigestLocked(entry, digest);
+  memory_used_ += size;
+
+  // The new module is referenced, but it may push older ones out.
+  EvictLocked();
+
+  *corrupt = entry->corrupt;
+  return entry->module;
+}
+
+bool SymbolModuleCache::Publish(const CodeModule* module, Module* symbols,
+                                char* buffer, size_t size) {
+  string key = KeyForModule(module);
+  if (key.empty())
+    return false;
+
+  AutoMutex lock(mutex_);
+  EntryMap::iterator it = entries_.find(key);
+  if (it != entries_.end())
+    DetachLocked(it->second);
+
+  Entry* entry = new Entry;
+  entry->key = key;
+  entry->module = new SharedModule(entry, symbols);
+  entry->buffer = buffer;
+  entry->size = size;
+  entry->corrupt = symbols->IsCorrupt();
+  entry->last_use = ++use_count_;
+  entries_.insert(std::make_pair(key, entry));
+  entry->unused_position = unused_.insert(unused_.end(), entry);
+  memory_used_ += size;
+  BPLOG(INFO) << "Published new symbols for " << key;
+
+  // Until a resolver picks it up, the new version is as evictable as any
+  // other unreferenced module.
+  EvictLocked();
+  return true;
+}
+
+void SymbolModuleCache::Release(Module* module) {
+  if (!module)
+    return;
+
+  AutoMutex lock(mutex_);
+  Entry* entry = static_cast<SharedModule*>(module)->entry();
+  assert(entry->references > 0);
+  entry->last_use = ++use_count_;
+  if (--entry->references == 0) {
+    if (entry->stale) {
+      DeleteLocked(entry);
+      return;
+    }
+    entry->unused_position = unused_.insert(unused_.end(), entry);
+    EvictLocked();
+  }
+}
+
+bool SymbolModuleCache::IsStale(Module* module) const {
+  AutoMutex lock(mutex_);
+  return static_cast<SharedModule*>(module)->entry()->stale;
+}
+
+void SymbolModuleCache::DetachLocked(Entry* entry) {
+  BPLOG(INFO) << "Invalidating cached symbols for " << entry->key;
+  UnindexLocked(entry);
+  entry->stale = true;
+  __atomic_store_n(&generation_, generation_ + 1, __ATOMIC_RELEASE);
+  if (entry->references == 0) {
+    unused_.erase(entry->unused_position);
+    DeleteLocked(entry);
+  }
+}
+
+void SymbolModuleCache::AddDigestLocked(Entry* entry, const string& digest) {
+  if (digest.empty() || !entry->digest.empty())
+    return;
+  if (digests_.insert(std::make_pair(digest, entry)).second)
+    entry->digest = digest;
+}
+
+void SymbolModuleCache::UnindexLocked(Entry* entry) {
+  entries_.erase(entry->key);
+  if (!entry->digest.empty())
+    digests_.erase(entry->digest);
+}
+
+void SymbolModuleCache::DeleteLocked(Entry* entry) {
+  memory_used_ -= entry->size;
+  delete entry;
+}
+
+void SymbolModuleCache::EvictLocked() {
+  while (memory_used_ > memory_budget_ && !unused_.empty()) {
+    EntryList::iterator victim = unused_.begin();
+    if (eviction_policy_) {
+      std::vector<EvictionPolicy::Candidate> candidates(unused_.size());
+      std::vector<EntryList::iterator> positions;
+      positions.reserve(unused_.size());
+      for (EntryList::iterator it = unused_.begin(); it != unused_.end();
+           ++it) {
+        EvictionPolicy::Candidate& candidate = candidates[positions.size()];
+        candidate.key = (*it)->key;
+        candidate.size = (*it)->size;
+        (*it)->module->GetMemoryUsage(&candidate.memory_usage);
+        candidate.last_use = (*it)->last_use;
+        positions.push_back(it);
+      }
+      size_t index = eviction_policy_->ChooseVictim(candidates, use_count_);
+      if (index < positions.size())
+        victim = positions[index];
+    }
+
+    Entry* entry = *victim;
+    unused_.erase(victim);
+    BPLOG(INFO) << "Evicting cached symbols for " << entry->key;
+    UnindexLocked(entry);
+    DeleteLocked(entry);
+  }
+}
+
+size_t SizeWeightedEvictionPolicy::ChooseVictim(
+    const std::vector<Candidate> &candidates, uint64_t use_count) {
+  size_t victim = 0;
+  double victim_weight = -1;
+  for (size_t i = 0; i < candidates.size(); ++i) {
+    double weight = static_cast<double>(candidates[i].memory_usage.total()) *
+                    (use_count - candidates[i].last_use + 1);
+    if (weight > victim_weight) {
+      victim = i;
+      victim_weight = weight;
+    }
+  }
+  return victim;
+}
+
+}  // namespace google_breakpad
@@ -0,0 +1,382 @@
+// Copyright (c) 2016 Google Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+// notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above
+// copyright notice, this list of conditions and the following disclaimer
+// in the documentation and/or other materials provided with the
+// distribution.
+//     * Neither the name of Google Inc. nor the names of its
+// contributors may be used to endorse or promote products derived from
+// this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+// symbol_pack.cc: Reads and writes symbol packs.
+//
+// See symbol_pack.h for documentation.
+
+#include "processor/symbol_pack.h"
+
+#include <assert.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#ifndef _WIN32
+#include <sys/mman.h>
+#include <unistd.h>
+#endif  // _WIN32
+
+#include <limits>
+
+#include "processor/logging.h"
+#include "processor/pathname_stripper.h"
+
+namespace google_breakpad {
+
+namespace {
+
+const char kSymbolPackMagic[8] = { 'B', 'P', 'S', 'Y', 'M', 'P', 'K', '1' };
+const uint32_t kSymbolPackVersion = 1;
+
+// The index has a power of two buckets, at least twice as many as there
+// are modules so that probe sequences stay short, and at least this many.
+const uint64_t kMinimumBucketCount = 16;
+
+uint64_t AlignUp(uint64_t offset) {
+  return (offset + 7) & ~static_cast<uint64_t>(7);
+}
+
+}  // namespace
+
+// static
+SymbolPack *SymbolPack::Open(const string &path) {
+#ifdef _WIN32
+  return NULL;
+#else  // _WIN32
+  int fd = open(path.c_str(), O_RDONLY);
+  if (fd == -1) {
+    string error_string;
+    int error_code = ErrnoString(&error_string);
+    BPLOG(ERROR) << "Could not open symbol pack " << path <<
+        ", error " << error_code << ": " << error_string;
+    return NULL;
+  }
+
+  struct stat st;
+  if (fstat(fd, &st) == -1 ||
+      static_cast<uint64_t>(st.st_size) < sizeof(SymbolPackHeader) ||
+      static_cast<uint64_t>(st.st_size) > std::numeric_limits<size_t>::max()) {
+    BPLOG(ERROR) << "Symbol pack " << path << " has a bad size";
+    close(fd);
+    return NULL;
+  }
+
+  size_t size = static_cast<size_t>(st.st_size);
+  void *data = mmap(NULL, size, PROT_READ, MAP_SHARED, fd, 0);
+  if (data == MAP_FAILED) {
+    string error_string;
+    int error_code = ErrnoString(&error_string);
+    BPLOG(ERROR) << "Could not map symbol pack " << path <<
+        ", error " << error_code << ": " << error_string;
+    close(fd);
+    return NULL;
+  }
+
+  const char *base = static_cast<const char*>(data);
+  const SymbolPackHeader *header =
+      reinterpret_cast<const SymbolPackHeader*>(base);
+  uint64_t bucket_count = header->bucket_count;
+  if (memcmp(header->magic, kSymbolPackMagic, sizeof(header->magic)) != 0 ||
+      header->version != kSymbolPackVersion ||
+      (header->format != FORMAT_TEXT && header->format != FORMAT_SERIALIZED) ||
+      bucket_count == 0 || (bucket_count & (bucket_count - 1)) != 0 ||
+      header->index_offset % 8 != 0 ||
+      header->index_offset > size ||
+      bucket_count > (size - header->index_offset) / sizeof(SymbolPackEntry)) {
+    BPLOG(ERROR) << path << " is not a valid symbol pack";
+    munmap(data, size);
+    close(fd);
+    return NULL;
+  }
+
+  return new SymbolPack(path, fd, base, size);
+#endif  // _WIN32
+}
+
+SymbolPack::SymbolPack(const string &path, int fd, const char *base,
+                       size_t size)
+    : path_(path),
+      fd_(fd),
+      base_(base),
+      size_(size) {
+  const SymbolPackHeader *header =
+      reinterpret_cast<const SymbolPackHeader*>(base_);
+  format_ = static_cast<Format>(header->format);
+  module_count_ = header->module_count;
+  bucket_count_ = header->bucket_count;
+  index_ = reinterpret_cast<const SymbolPackEntry*>(base_ +
+                                                    header->index_offset);
+}
+
+SymbolPack::~SymbolPack() {
+#ifndef _WIN32
+  munmap(const_cast<char*>(base_), size_);
+  close(fd_);
+#endif  // _WIN32
+}
+
+// static
+string SymbolPack::MakeKey(const string &debug_file,
+                           const string &debug_identifier) {
+  return PathnameStripper::File(debug_file) + "/" + debug_identifier;
+}
+
+// static
+uint64_t SymbolPack::HashKey(const string &key) {
+  uint64_t hash = 14695981039346656037ULL;
+  for (size_t i = 0; i < key.size(); ++i) {
+    hash ^= static_cast<unsigned char>(key[i]);
+    hash *= 1099511628211ULL;
+  }
+  return hash;
+}
+
+bool SymbolPack::Find(const string &key, const char **data,
+                      size_t *size) const {
+  assert(data);
+  assert(size);
+  uint64_t hash = HashKey(key);
+  uint64_t index_offset = reinterpret_cast<const char*>(index_) - base_;
+  uint64_t mask = bucket_count_ - 1;
+  for (uint64_t probe = 0; probe < bucket_count_; ++probe) {
+    const SymbolPackEntry &entry = index_[(hash + probe) & mask];
+    if (entry.key_size == 0)
+      return false;
+    if (entry.hash != hash || entry.key_size != key.size())
+      continue;
+    // Entries are checked as they are used, rather than all when the pack
+    // is opened, which would read in the whole index.
+    if (entry.key_size > index_offset ||
+        entry.key_offset > index_offset - entry.key_size ||
+        entry.data_offset > index_offset ||
+        entry.data_size >= index_offset - entry.data_offset) {
+      BPLOG(ERROR) << "Symbol pack " << path_ << " has a bad entry for "
+                   << key;
+      return false;
+    }
+    if (memcmp(base_ + entry.key_offset, key.data(), key.size()) != 0)
+      continue;
+    *data = base_ + entry.data_offset;
+    *size = static_cast<size_t>(entry.data_size);
+    return true;
+  }
+  return false;
+}
+
+bool SymbolPack::MapPrivateCopy(const char *data, size_t size, char **copy,
+                                void **mapping, size_t *mapping_size) const {
+#ifdef _WIN32
+  return false;
+#else  // _WIN32
+  assert(data >= base_ && data + size < base_ + size_);
+  size_t page_size = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+  size_t offset = data - base_;
+  size_t page_offset = offset - offset % page_size;
+  size_t length = offset - page_offset + size + 1;
+  void *result = mmap(NULL, length, PROT_READ | PROT_WRITE, MAP_PRIVATE,
+                      fd_, page_offset);
+  if (result == MAP_FAILED) {
+    string error_string;
+    int error_code = ErrnoString(&error_string);
+    BPLOG(ERROR) << "Could not map symbols from " << path_ <<
+        ", error " << error_code << ": " << error_string;
+    return false;
+  }
+
+  // Symbol data is parsed from start to end, once.
+  madvise(result, length, MADV_SEQUENTIAL);
+
+  *copy = static_cast<char*>(result) + (offset - page_offset);
+  *mapping = result;
+  *mapping_size = length;
+  return true;
+#endif  // _WIN32
+}
+
+// static
+void SymbolPack::UnmapCopy(void *mapping, size_t mapping_size) {
+#ifndef _WIN32
+  munmap(mapping, mapping_size);
+#endif  // _WIN32
+}
+
+SymbolPackWriter::SymbolPackWriter(const string &path,
+                                   SymbolPack::Format format)
+    : path_(path),
+      format_(format),
+      file_(NULL),
+      offset_(0),
+      write_failed_(false) {
+}
+
+SymbolPackWriter::~SymbolPackWriter() {
+  if (file_) {
+    fclose(file_);
+    remove(temp_path_.c_str());
+  }
+}
+
+bool SymbolPackWriter::Open() {
+#ifdef _WIN32
+  return false;
+#else  // _WIN32
+  assert(!file_);
+  string temp_template = path_ + ".XXXXXX";
+  vector<char> temp_name(temp_template.begin(), temp_template.end());
+  temp_name.push_back('\0');
+  int fd = mkstemp(&temp_name[0]);
+  if (fd == -1) {
+    string error_string;
+    int error_code = ErrnoString(&error_string);
+    BPLOG(ERROR) << "Could not create " << temp_template <<
+        ", error " << error_code << ": " << error_string;
+    return false;
+  }
+  temp_path_ = &temp_name[0];
+  // mkstemp creates the file readable only by its owner, but the symbol
+  // store is usually shared.
+  fchmod(fd, 0644);
+
+  file_ = fdopen(fd, "wb");
+  if (!file_) {
+    close(fd);
+    remove(temp_path_.c_str());
+    return false;
+  }
+
+  // The header is written again with the real counts by Finish.
+  SymbolPackHeader header;
+  memset(&header, 0, sizeof(header));
+  return Write(&header, sizeof(header));
+#endif  // _WIN32
+}
+
+bool SymbolPackWriter::AddModule(const string &debug_file,
+                                 const string &debug_identifier,
+                                 const char *data, size_t size) {
+  assert(file_);
+  string key = SymbolPack::MakeKey(debug_file, debug_identifier);
+  if (!keys_.insert(key).second) {
+    BPLOG(ERROR) << "Symbol pack " << path_ << " already holds " << key;
+    return false;
+  }
+
+  PendingEntry entry;
+  entry.hash = SymbolPack::HashKey(key);
+  entry.key_offset = offset_;
+  entry.key_size = static_cast<uint32_t>(key.size());
+  if (!Write(key.data(), key.size()) || !Align())
+    return false;
+  entry.data_offset = offset_;
+  entry.data_size = size;
+  if (!Write(data, size) || !Write("", 1) || !Align())
+    return false;
+  entries_.push_back(entry);
+  return true;
+}
+
+bool SymbolPackWriter::Finish() {
+  assert(file_);
+  if (write_failed_) {
+    fclose(file_);
+    file_ = NULL;
+    remove(temp_path_.c_str());
+    return false;
+  }
+
+  uint64_t bucket_count = kMinimumBucketCount;
+  while (bucket_count < entries_.size() * 2)
+    bucket_count *= 2;
+
+  vector<SymbolPackEntry> index(bucket_count);
+  memset(&index[0], 0, bucket_count * sizeof(SymbolPackEntry));
+  uint64_t mask = bucket_count - 1;
+  for (size_t i = 0; i < entries_.size(); ++i) {
+    const PendingEntry &pending = entries_[i];
+    // AddModule rejected duplicate keys, so the first empty bucket will do.
+    uint64_t bucket = pending.hash & mask;
+    while (index[bucket].key_size != 0)
+      bucket = (bucket + 1) & mask;
+    SymbolPackEntry &entry = index[bucket];
+    entry.hash = pending.hash;
+    entry.key_offset = pending.key_offset;
+    entry.key_size = pending.key_size;
+    entry.data_offset = pending.data_offset;
+    entry.data_size = pending.data_size;
+  }
+
+  SymbolPackHeader header;
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, kSymbolPackMagic, sizeof(header.magic));
+  header.version = kSymbolPackVersion;
+  header.format = format_;
+  header.module_count = entries_.size();
+  header.bucket_count = bucket_count;
+  header.index_offset = offset_;
+
+  bool written = Write(&index[0], bucket_count * sizeof(SymbolPackEntry)) &&
+                 fseek(file_, 0, SEEK_SET) == 0 &&
+                 fwrite(&header, sizeof(header), 1, file_) == 1;
+  if (fclose(file_) != 0)
+    written = false;
+  file_ = NULL;
+
+  if (!written || rename(temp_path_.c_str(), path_.c_str()) != 0) {
+    string error_string;
+    int error_code = ErrnoString(&error_string);
+    BPLOG(ERROR) << "Could not write symbol pack " << path_ <<
+        ", error " << error_code << ": " << error_string;
+    remove(temp_path_.c_str());
+    return false;
+  }
+  return true;
+}
+
+bool SymbolPackWriter::Write(const void *data, size_t size) {
+  if (write_failed_)
+    return false;
+  if (size > 0 && fwrite(data, size, 1, file_) != 1) {
+    write_failed_ = true;
+    string error_string;
+    int error_code = ErrnoString(&error_string);
+    BPLOG(ERROR) << "Could not write " << temp_path_ <<
+        ", error " << error_code << ": " << error_string;
+    return false;
+  }
+  offset_ += size;
+  return true;
+}
+
+bool SymbolPackWriter::Align() {
+  static const char kPadding[8] = { 0 };
+  return Write(kPadding, AlignUp(offset_) - offset_);
+}
+
+}  // namespace google_breakpad
@@ -0,0 +1,209 @@
+// Copyright (c) 2016 Google Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+// notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above
+// copyright notice, this list of conditions and the following disclaimer
+// in the documentation and/or other materials provided with the
+// distribution.
+//     * Neither the name of Google Inc. nor the names of its
+// contributors may be used to endorse or promote products derived from
+// this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+// symbol_pack.h: A container file holding the symbols of many modules.
+//
+// A symbol store with one file per module costs several directory lookups
+// per module for each search path, which adds up when the store holds
+// millions of files.  A symbol pack holds the symbol data of many modules
+// in one file, with a hash table index keyed on the module's debug file
+// and debug identifier, so a module is found with one probe of a mapped
+// file.
+//
+// A pack holds either text symbol files or serialized ones (see
+// ModuleSerializer), as recorded in its header.  It is laid out as:
+//
+//   SymbolPackHeader
+//   for each module:
+//     its key, the debug file's base name, '/', and the debug identifier
+//     padding to an 8-byte boundary
+//     its symbol data, followed by a '\0'
+//     padding to an 8-byte boundary
+//   the index: bucket_count SymbolPackEntry structures, a hash table with
+//     linear probing in which empty buckets have a key_size of 0
+//
+// Numbers are stored in the byte order of the machine that wrote the pack,
+// as they are in serialized symbol files.  Packs are read by mapping them
+// into memory, which isn't supported on Windows.
+
+#ifndef PROCESSOR_SYMBOL_PACK_H__
+#define PROCESSOR_SYMBOL_PACK_H__
+
+#include <stddef.h>
+#include <stdio.h>
+
+#include <set>
+#include <string>
+#include <vector>
+
+#include "common/using_std_string.h"
+#include "google_breakpad/common/breakpad_types.h"
+
+namespace google_breakpad {
+
+using std::set;
+using std::vector;
+
+struct SymbolPackHeader {
+  char magic[8];            // kSymbolPackMagic
+  uint32_t version;         // kSymbolPackVersion
+  uint32_t format;          // a SymbolPack::Format
+  uint64_t module_count;
+  uint64_t bucket_count;    // a power of two
+  uint64_t index_offset;    // the offset of the first SymbolPackEntry
+};
+
+struct SymbolPackEntry {
+  uint64_t hash;            // SymbolPack::HashKey of the key
+  uint64_t key_offset;
+  uint64_t data_offset;
+  uint64_t data_size;       // not counting the '\0' after the data
+  uint32_t key_size;        // 0 for an empty bucket
+  uint32_t reserved;
+};
+
+class SymbolPack {
+ public:
+  enum Format {
+    FORMAT_TEXT = 1,        // text symbol files
+    FORMAT_SERIALIZED = 2   // serialized symbol files
+  };
+
+  // Maps the pack at |path| into memory.  Returns NULL if it can't be
+  // mapped or isn't a valid pack.  The caller takes ownership of the
+  // returned object.
+  static SymbolPack *Open(const string &path);
+
+  ~SymbolPack();
+
+  // Returns the key under which the symbols for the module with
+  // |debug_file| and |debug_identifier| are stored.  Only the base name of
+  // |debug_file| is used.
+  static string MakeKey(const string &debug_file,
+                        const string &debug_identifier);
+
+  // Returns the hash of |key| used to index the pack: 64-bit FNV-1a.
+  static uint64_t HashKey(const string &key);
+
+  // Looks up the symbols stored under |key|.  On success, sets |*data| to
+  // point at them within the pack's read-only mapping, where they are
+  // followed by a '\0', and |*size| to their size without the '\0'.
+  bool Find(const string &key, const char **data, size_t *size) const;
+
+  // Maps a private, writable copy of the |size| bytes at |data|, which
+  // Find returned, and the '\0' after them.  The pages are shared with the
+  // pack until they are written to.  Sets |*copy| to the copy, and
+  // |*mapping| and |*mapping_size| to the mapping that holds it, for
+  // UnmapCopy.  Returns false if the copy can't be mapped.
+  bool MapPrivateCopy(const char *data, size_t size, char **copy,
+                      void **mapping, size_t *mapping_size) const;
+
+  // Unmaps a copy made by MapPrivateCopy.
+  static void UnmapCopy(void *mapping, size_t mapping_size);
+
+  const string &path() const { return path_; }
+  Format format() const { return format_; }
+  uint64_t module_count() const { return module_count_; }
+
+ private:
+  SymbolPack(const string &path, int fd, const char *base, size_t size);
+
+  string path_;
+  int fd_;
+  const char *base_;
+  size_t size_;
+  Format format_;
+  uint64_t module_count_;
+  uint64_t bucket_count_;
+  const SymbolPackEntry *index_;
+
+  // Disallow copy constructor and assignment operator.
+  SymbolPack(const SymbolPack&);
+  void operator=(const SymbolPack&);
+};
+
+// Writes a symbol pack.  The symbol data is written out as modules are
+// added, and the index, which is kept in memory, once they all have been.
+// The pack is written under a temporary name and renamed into place by
+// Finish, so readers never see a partially written pack.
+class SymbolPackWriter {
+ public:
+  SymbolPackWriter(const string &path, SymbolPack::Format format);
+
+  // Removes the temporary file if Finish wasn't called or failed.
+  ~SymbolPackWriter();
+
+  // Creates the temporary file.  Returns false on failure.
+  bool Open();
+
+  // Adds the |size| bytes of symbol data at |data| for the module with
+  // |debug_file| and |debug_identifier|.  Returns false if the pack
+  // already holds symbols for that module or they can't be written.
+  bool AddModule(const string &debug_file, const string &debug_identifier,
+                 const char *data, size_t size);
+
+  // Writes the index and renames the pack into place.  Returns false on
+  // failure, including when any earlier write failed.
+  bool Finish();
+
+ private:
+  // A module added to the pack, for the index.
+  struct PendingEntry {
+    uint64_t hash;
+    uint64_t key_offset;
+    uint64_t data_offset;
+    uint64_t data_size;
+    uint32_t key_size;
+  };
+
+  // Writes |size| bytes to the temporary file, advancing offset_.  A
+  // failed write leaves the file in an unknown state, so it sets
+  // write_failed_, and Finish fails.
+  bool Write(const void *data, size_t size);
+
+  // Pads the temporary file with zeros up to an 8-byte boundary.
+  bool Align();
+
+  string path_;
+  string temp_path_;
+  SymbolPack::Format format_;
+  FILE *file_;
+  uint64_t offset_;
+  bool write_failed_;
+  vector<PendingEntry> entries_;
+  set<string> keys_;
+
+  // Disallow copy constructor and assignment operator.
+  SymbolPackWriter(const SymbolPackWriter&);
+  void operator=(const SymbolPackWriter&);
+};
+
+}  // namespace google_breakpad
+
+#endif  // PROCESSOR_SYMBOL_PACK_H__
@@ -0,0 +1,206 @@
+// Copyright (c) 2016 Google Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+// notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above
+// copyright notice, this list of conditions and the following disclaimer
+// in the documentation and/or other materials provided with the
+// distribution.
+//     * Neither the name of Google Inc. nor the names of its
+// contributors may be used to endorse or promote products derived from
+// this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+// symbolize_addresses.cc: Symbolize many module addresses at once.
+//
+// Reads lines of the form
+//   <debug_file> <debug_identifier> <address>
+// from standard input, where the address is a hexadecimal offset into the
+// module, and prints a line for each with the function, offset, source
+// file and line found there, in the order read.  Symbol files are found
+// under the symbol paths as SimpleSymbolSupplier lays them out, and each
+// is loaded once.  Input is symbolized in large batches with
+// SourceLineResolverBase::SymbolizeAddresses, which is much quicker than
+// looking the addresses up one at a time.
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include "common/using_std_string.h"
+#include "google_breakpad/processor/basic_source_line_resolver.h"
+#include "processor/basic_code_module.h"
+#include "processor/logging.h"
+#include "processor/simple_symbol_supplier.h"
+
+namespace {
+
+using google_breakpad::BasicCodeModule;
+using google_breakpad::BasicSourceLineResolver;
+using google_breakpad::CodeModule;
+using google_breakpad::SimpleSymbolSupplier;
+using google_breakpad::SourceLineResolverBase;
+using google_breakpad::SymbolSupplier;
+using std::map;
+using std::vector;
+
+// Lines read before they are symbolized together.
+const size_t kBatchSize = 1 << 16;
+
+// The modules named in the input, keyed by debug file and identifier.
+// Their code files are the same key, which the resolver tells them apart
+// by.  A module is NULL if its symbols couldn't be loaded.
+class ModuleTable {
+ public:
+  ModuleTable(SimpleSymbolSupplier* supplier,
+              BasicSourceLineResolver* resolver)
+      : supplier_(supplier), resolver_(resolver) {}
+  ~ModuleTable() {
+    for (ModuleMap::iterator it = modules_.begin(); it != modules_.end();
+         ++it) {
+      delete it->second;
+    }
+  }
+
+  // Returns the module for |debug_file| and |debug_identifier|, loading its
+  // symbols the first time it is asked for, or NULL if there are none.
+  const CodeModule* Get(const string& debug_file,
+                        const string& debug_identifier) {
+    string key = debug_file + "/" + debug_identifier;
+    ModuleMap::iterator it = modules_.find(key);
+    if (it != modules_.end())
+      return it->second;
+
+    BasicCodeModule* module =
+        new BasicCodeModule(0, UINT64_MAX, key, "", debug_file,
+                            debug_identifier, "");
+    string symbol_file;
+    if (supplier_->GetSymbolFile(module, NULL, &symbol_file) !=
+            SymbolSupplier::FOUND ||
+        !resolver_->LoadModule(module, symbol_file)) {
+      fprintf(stderr, "No symbols for %s %s\n", debug_file.c_str(),
+              debug_identifier.c_str());
+      delete module;
+      module = NULL;
+    }
+    modules_[key] = module;
+    return module;
+  }
+
+ private:
+  typedef map<string, BasicCodeModule*> ModuleMap;
+
+  SimpleSymbolSupplier* supplier_;
+  BasicSourceLineResolver* resolver_;
+  ModuleMap modules_;
+};
+
+// Parses an input line into |debug_file|, |debug_identifier| and
+// |address|.  Returns false if it is malformed.
+bool ParseLine(char* line, string* debug_file, string* debug_identifier,
+               uint64_t* address) {
+  const char* kSeparators = " \t\r\n";
+  char* saveptr;
+  char* file = strtok_r(line, kSeparators, &saveptr);
+  char* identifier = file ? strtok_r(NULL, kSeparators, &saveptr) : NULL;
+  char* offset = identifier ? strtok_r(NULL, kSeparators, &saveptr) : NULL;
+  if (!offset || strtok_r(NULL, kSeparators, &saveptr))
+    return false;
+  char* end;
+  *address = strtoull(offset, &end, 16);
+  if (*end != '\0')
+    return false;
+  *debug_file = file;
+  *debug_identifier = identifier;
+  return true;
+}
+
+// Symbolizes |lookups| and prints a line for each.
+void SymbolizeBatch(
+    BasicSourceLineResolver* resolver,
+    const vector<SourceLineResolverBase::AddressLookup>& lookups) {
+  if (lookups.empty())
+    return;
+  vector<SourceLineResolverBase::SymbolizedAddress> results(lookups.size());
+  resolver->SymbolizeAddresses(&lookups[0], lookups.size(), &results[0]);
+  for (size_t i = 0; i < lookups.size(); ++i) {
+    const SourceLineResolverBase::SymbolizedAddress& result = results[i];
+    if (!result.function_name) {
+      printf("0x%" PRIx64 "\n", lookups[i].address);
+      continue;
+    }
+    printf("%s + 0x%" PRIx64, result.function_name, result.function_offset);
+    if (result.source_file_name)
+      printf(" [%s : %d]", result.source_file_name, result.source_line);
+    printf("\n");
+  }
+}
+
+void usage(const char* program_name) {
+  fprintf(stderr, "usage: %s <symbol-path> [<symbol-path> ...]\n"
+          "    Reads \"<debug_file> <debug_identifier> <address>\" lines "
+          "from standard input\n",
+          program_name);
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  BPLOG_INIT(&argc, &argv);
+
+  if (argc < 2) {
+    usage(argv[0]);
+    return 1;
+  }
+
+  SimpleSymbolSupplier supplier(vector<string>(argv + 1, argv + argc));
+  BasicSourceLineResolver resolver;
+  ModuleTable modules(&supplier, &resolver);
+
+  vector<SourceLineResolverBase::AddressLookup> lookups;
+  lookups.reserve(kBatchSize);
+  int malformed = 0;
+  char line[1024];
+  string debug_file;
+  string debug_identifier;
+  while (fgets(line, sizeof(line), stdin)) {
+    SourceLineResolverBase::AddressLookup lookup = { NULL, 0 };
+    if (ParseLine(line, &debug_file, &debug_identifier, &lookup.address)) {
+      lookup.module = modules.Get(debug_file, debug_identifier);
+    } else {
+      // Still printed, so that output lines match input lines.
+      ++malformed;
+    }
+    lookups.push_back(lookup);
+    if (lookups.size() == kBatchSize) {
+      SymbolizeBatch(&resolver, lookups);
+      lookups.clear();
+    }
+  }
+  SymbolizeBatch(&resolver, lookups);
+
+  if (malformed)
+    fprintf(stderr, "%d malformed lines\n", malformed);
+  return malformed == 0 ? 0 : 1;
+}
@@ -0,0 +1,134 @@
+// Copyright (c) 2016 Google Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+// notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above
+// copyright notice, this list of conditions and the following disclaimer
+// in the documentation and/or other materials provided with the
+// distribution.
+//     * Neither the name of Google Inc. nor the names of its
+// contributors may be used to endorse or promote products derived from
+// this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+// symbolized_frame_memo.h: SymbolizedFrameMemo, which remembers how the
+// frames of one dump were symbolized, so that walks of the dump's other
+// threads can reuse the results.
+//
+// Most threads of a large process are idle workers whose stacks share the
+// same frames from the thread entry point down to the wait they are blocked
+// in.  Within one dump, an instruction address always belongs to the same
+// module and symbolizes the same way, so the memo is keyed by the address
+// alone.  A memo must not outlive the CodeModules of its dump, and must not
+// be shared between dumps.  It is safe to use from several walker threads.
+
+#ifndef PROCESSOR_SYMBOLIZED_FRAME_MEMO_H__
+#define PROCESSOR_SYMBOLIZED_FRAME_MEMO_H__
+
+#include <map>
+#include <string>
+
+#include "common/using_std_string.h"
+#include "google_breakpad/common/breakpad_types.h"
+#include "google_breakpad/processor/stack_frame.h"
+#include "google_breakpad/processor/stack_frame_symbolizer.h"
+#include "processor/mutex.h"
+
+namespace google_breakpad {
+
+class SymbolizedFrameMemo {
+ public:
+  SymbolizedFrameMemo() : hits_(0) {}
+
+  // If the instruction at |frame|'s address has been symbolized, fills in
+  // |frame|'s module and source line information as it was then, sets
+  // |result| to what the symbolizer returned, and returns true.
+  bool Lookup(StackFrame* frame,
+              StackFrameSymbolizer::SymbolizerResult* result) {
+    AutoMutex lock(&mutex_);
+    EntryMap::const_iterator it = entries_.find(frame->instruction);
+    if (it == entries_.end())
+      return false;
+    const Entry& entry = it->second;
+    frame->module = entry.module;
+    frame->function_name = entry.function_name;
+    frame->shared_function_name = entry.shared_function_name;
+    frame->function_base = entry.function_base;
+    frame->source_file_name = entry.source_file_name;
+    frame->shared_source_file_name = entry.shared_source_file_name;
+    frame->source_line = entry.source_line;
+    frame->source_line_base = entry.source_line_base;
+    *result = entry.result;
+    ++hits_;
+    return true;
+  }
+
+  // Remembers how |frame| was symbolized, with |result|.  Interrupted
+  // symbolization isn't remembered, since it may succeed when retried.
+  void Store(const StackFrame& frame,
+             StackFrameSymbolizer::SymbolizerResult result) {
+    if (result == StackFrameSymbolizer::kInterrupt)
+      return;
+    Entry entry;
+    entry.result = result;
+    entry.module = frame.module;
+    entry.function_name = frame.function_name;
+    entry.shared_function_name = frame.shared_function_name;
+    entry.function_base = frame.function_base;
+    entry.source_file_name = frame.source_file_name;
+    entry.shared_source_file_name = frame.shared_source_file_name;
+    entry.source_line = frame.source_line;
+    entry.source_line_base = frame.source_line_base;
+    AutoMutex lock(&mutex_);
+    entries_.insert(std::make_pair(frame.instruction, entry));
+  }
+
+  // The number of frames symbolized from the memo.
+  uint64_t hits() const {
+    AutoMutex lock(&mutex_);
+    return hits_;
+  }
+
+ private:
+  struct Entry {
+    StackFrameSymbolizer::SymbolizerResult result;
+    const CodeModule* module;
+    string function_name;
+    const char* shared_function_name;
+    uint64_t function_base;
+    string source_file_name;
+    const char* shared_source_file_name;
+    int source_line;
+    uint64_t source_line_base;
+  };
+  typedef std::map<uint64_t, Entry> EntryMap;
+
+  EntryMap entries_;
+  uint64_t hits_;
+  mutable Mutex mutex_;
+
+  // Disallow copy constructor and assignment operator.
+  SymbolizedFrameMemo(const SymbolizedFrameMemo&);
+  void operator=(const SymbolizedFrameMemo&);
+};
+
+}  // namespace google_breakpad
+
+#endif  // PROCESSOR_SYMBOLIZED_FRAME_MEMO_H__
@@ -41,8 +41,16 @@ Section::Section(const Dump &dump)
   : test_assembler::Section(dump.endianness()) { }
 
 void Section::CiteLocationIn(test_assembler::Section *section) const {
-  if (this)
-    (*section).D32(size_).D32(file_offset_);
+  (*section).D32(size_).D32(file_offset_);
+}
+
+// Append an MDLocationDescriptor referring to CITED to SECTION, or one
+// with a zero length and MDRVA if CITED is NULL.  (Compilers may assume
+// that 'this' is never NULL, so CiteLocationIn can't check for it.)
+static void CiteOptionalLocationIn(const Section *cited,
+                                   test_assembler::Section *section) {
+  if (cited)
+    cited->CiteLocationIn(section);
   else
     (*section).D32(0).D32(0);
 }
@@ -272,8 +280,8 @@ Module::Module(const Dump &dump,
   D32(version_info.file_subtype);
   D32(version_info.file_date_hi);
   D32(version_info.file_date_lo);
-  cv_record->CiteLocationIn(this);
-  misc_record->CiteLocationIn(this);
+  CiteOptionalLocationIn(cv_record, this);
+  CiteOptionalLocationIn(misc_record, this);
   D64(0).D64(0);
 }
 
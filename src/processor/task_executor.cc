@@ -0,0 +1,398 @@
+// Copyright (c) 2016 Google Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+// notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above
+// copyright notice, this list of conditions and the following disclaimer
+// in the documentation and/or other materials provided with the
+// distribution.
+//     * Neither the name of Google Inc. nor the names of its
+// contributors may be used to endorse or promote products derived from
+// this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+// task_executor.cc: Implementation of TaskExecutor, TaskGroup and
+// WorkStealingExecutor.
+//
+// See task_executor.h for documentation.
+
+#include "google_breakpad/processor/task_executor.h"
+
+#ifndef _WIN32
+#include <pthread.h>
+#endif  // _WIN32
+
+#include <deque>
+#include <vector>
+
+#include "processor/logging.h"
+
+namespace google_breakpad {
+
+// static
+const char* TaskExecutor::StageName(Stage stage) {
+  switch (stage) {
+    case STAGE_STACKWALK:
+      return "stackwalk";
+    case STAGE_SYMBOL_FETCH:
+      return "symbol_fetch";
+    case STAGE_SYMBOL_PARSE:
+      return "symbol_parse";
+    case STAGE_REQUEST:
+      return "request";
+    default:
+      return "unknown";
+  }
+}
+
+// static
+void TaskExecutor::RunTask(Task* task) {
+  // The group may be waiting for nothing but this task, and destroy it
+  // as soon as it is told, so it is fetched first.
+  TaskGroup* group = task->group_;
+  task->Run();
+  if (group)
+    group->Finished();
+}
+
+struct TaskGroup::Sync {
+#ifndef _WIN32
+  Sync() {
+    pthread_mutex_init(&mutex, NULL);
+    pthread_cond_init(&changed, NULL);
+  }
+  ~Sync() {
+    pthread_cond_destroy(&changed);
+    pthread_mutex_destroy(&mutex);
+  }
+
+  void Lock() { pthread_mutex_lock(&mutex); }
+  void Unlock() { pthread_mutex_unlock(&mutex); }
+
+  pthread_mutex_t mutex;
+  // Signalled when a task is submitted or finishes.
+  pthread_cond_t changed;
+#else  // _WIN32
+  void Lock() {}
+  void Unlock() {}
+#endif  // _WIN32
+};
+
+TaskGroup::TaskGroup(TaskExecutor* executor)
+    : executor_(executor),
+      outstanding_(0),
+      sync_(new Sync) {
+}
+
+TaskGroup::~TaskGroup() {
+  Wait();
+  delete sync_;
+}
+
+void TaskGroup::Submit(Task* task, TaskExecutor::Priority priority,
+                       TaskExecutor::Stage stage) {
+  if (!executor_) {
+    task->group_ = NULL;
+    task->Run();
+    return;
+  }
+
+  // The task is submitted under the lock so that a waiting thread can't
+  // miss it: it is either queued by the time the thread looks, or the
+  // thread is woken once it is.
+  sync_->Lock();
+  task->group_ = this;
+  ++outstanding_;
+  executor_->Submit(task, priority, stage);
+#ifndef _WIN32
+  pthread_cond_broadcast(&sync_->changed);
+#endif  // _WIN32
+  sync_->Unlock();
+}
+
+void TaskGroup::Wait() {
+  if (!executor_)
+    return;
+  sync_->Lock();
+  while (outstanding_ > 0) {
+    sync_->Unlock();
+    Task* task = executor_->Withdraw(this);
+    if (task)
+      task->Run();
+    sync_->Lock();
+    if (task) {
+      --outstanding_;
+      continue;
+    }
+    if (outstanding_ == 0)
+      break;
+#ifndef _WIN32
+    // Whatever is left is running on executor threads, which may yet
+    // submit more.
+    pthread_cond_wait(&sync_->changed, &sync_->mutex);
+#else  // _WIN32
+    // Without threads, every task not yet run was still queued.
+    BPLOG(ERROR) << "TaskGroup has " << outstanding_
+                 << " tasks that can't be found";
+    break;
+#endif  // _WIN32
+  }
+  sync_->Unlock();
+}
+
+void TaskGroup::Finished() {
+  sync_->Lock();
+  --outstanding_;
+#ifndef _WIN32
+  pthread_cond_broadcast(&sync_->changed);
+#endif  // _WIN32
+  sync_->Unlock();
+}
+
+struct WorkStealingExecutor::State {
+  struct Entry {
+    Task* task;
+    Stage stage;
+  };
+  typedef std::deque<Entry> Queue;
+
+  // What a thread needs to find its own queues.
+  struct Worker {
+    State* state;
+    size_t index;
+  };
+
+  explicit State(size_t queue_owners)
+      : owner_count(queue_owners),
+        queues(queue_owners * PRIORITY_COUNT),
+        next_owner(0),
+        stopping(false) {
+#ifndef _WIN32
+    pthread_mutex_init(&mutex, NULL);
+    pthread_cond_init(&changed, NULL);
+    pthread_key_create(&worker_key, NULL);
+#endif  // _WIN32
+  }
+
+  ~State() {
+#ifndef _WIN32
+    pthread_key_delete(worker_key);
+    pthread_cond_destroy(&changed);
+    pthread_mutex_destroy(&mutex);
+#endif  // _WIN32
+  }
+
+  void Lock() {
+#ifndef _WIN32
+    pthread_mutex_lock(&mutex);
+#endif  // _WIN32
+  }
+
+  void Unlock() {
+#ifndef _WIN32
+    pthread_mutex_unlock(&mutex);
+#endif  // _WIN32
+  }
+
+  Queue* QueueFor(size_t owner, int priority) {
+    return &queues[owner * PRIORITY_COUNT + priority];
+  }
+
+  // Takes the most urgent task for the thread owning queues |owner| into
+  // |entry|, as described in task_executor.h.  Called with the lock held.
+  bool Take(size_t owner, Entry* entry) {
+    for (int priority = 0; priority < PRIORITY_COUNT; ++priority) {
+      Queue* own = QueueFor(owner, priority);
+      if (!own->empty()) {
+        *entry = own->back();
+        own->pop_back();
+        return true;
+      }
+      for (size_t i = 1; i < owner_count; ++i) {
+        Queue* other = QueueFor((owner + i) % owner_count, priority);
+        if (!other->empty()) {
+          *entry = other->front();
+          other->pop_front();
+          return true;
+        }
+      }
+    }
+    return false;
+  }
+
+#ifndef _WIN32
+  static void* ThreadMain(void* arg) {
+    Worker* worker = static_cast<Worker*>(arg);
+    State* state = worker->state;
+    pthread_setspecific(state->worker_key, worker);
+    state->Lock();
+    while (true) {
+      Entry entry;
+      if (state->Take(worker->index, &entry)) {
+        --state->metrics[entry.stage].queue_depth;
+        state->Unlock();
+        RunTask(entry.task);
+        state->Lock();
+        ++state->metrics[entry.stage].completed;
+        continue;
+      }
+      if (state->stopping)
+        break;
+      pthread_cond_wait(&state->changed, &state->mutex);
+    }
+    state->Unlock();
+    return NULL;
+  }
+#endif  // _WIN32
+
+  // The number of threads with queues, at least 1 so that an executor
+  // without threads can still hold tasks.
+  size_t owner_count;
+  std::vector<Queue> queues;
+
+  // The owner of the queues that the next task submitted from outside the
+  // executor's threads goes on.
+  size_t next_owner;
+
+  bool stopping;
+  StageMetrics metrics[STAGE_COUNT];
+
+  // Not resized once the threads are started.
+  std::vector<Worker> workers;
+
+#ifndef _WIN32
+  // Guards everything above, and is signalled when a task is queued or
+  // the executor is stopping.
+  pthread_mutex_t mutex;
+  pthread_cond_t changed;
+
+  // Holds each executor thread's Worker.
+  pthread_key_t worker_key;
+
+  std::vector<pthread_t> threads;
+#endif  // _WIN32
+};
+
+WorkStealingExecutor::WorkStealingExecutor(unsigned int thread_count)
+    : state_(NULL) {
+#ifdef _WIN32
+  thread_count = 0;
+#endif  // _WIN32
+  state_ = new State(thread_count > 0 ? thread_count : 1);
+#ifndef _WIN32
+  state_->workers.resize(thread_count);
+  for (unsigned int i = 0; i < thread_count; ++i) {
+    state_->workers[i].state = state_;
+    state_->workers[i].index = i;
+    pthread_t thread;
+    if (pthread_create(&thread, NULL, State::ThreadMain,
+                       &state_->workers[i]) != 0) {
+      BPLOG(ERROR) << "Could not create executor thread " << i;
+      break;
+    }
+    state_->threads.push_back(thread);
+  }
+#endif  // _WIN32
+}
+
+WorkStealingExecutor::~WorkStealingExecutor() {
+#ifndef _WIN32
+  state_->Lock();
+  state_->stopping = true;
+  pthread_cond_broadcast(&state_->changed);
+  state_->Unlock();
+  for (size_t i = 0; i < state_->threads.size(); ++i)
+    pthread_join(state_->threads[i], NULL);
+#endif  // _WIN32
+  delete state_;
+}
+
+void WorkStealingExecutor::Submit(Task* task, Priority priority,
+                                  Stage stage) {
+  State::Entry entry = { task, stage };
+  state_->Lock();
+  size_t owner;
+#ifndef _WIN32
+  State::Worker* worker =
+      static_cast<State::Worker*>(pthread_getspecific(state_->worker_key));
+  if (worker && worker->state == state_) {
+    owner = worker->index;
+  } else
+#endif  // _WIN32
+  {
+    // Tasks from outside are spread over the threads that started.
+    size_t started = state_->owner_count;
+#ifndef _WIN32
+    if (!state_->threads.empty())
+      started = state_->threads.size();
+#endif  // _WIN32
+    owner = state_->next_owner++ % started;
+  }
+  state_->QueueFor(owner, priority)->push_back(entry);
+  StageMetrics* metrics = &state_->metrics[stage];
+  ++metrics->submitted;
+  if (++metrics->queue_depth > metrics->max_queue_depth)
+    metrics->max_queue_depth = metrics->queue_depth;
+#ifndef _WIN32
+  pthread_cond_signal(&state_->changed);
+#endif  // _WIN32
+  state_->Unlock();
+}
+
+Task* WorkStealingExecutor::Withdraw(const TaskGroup* group) {
+  state_->Lock();
+  for (int priority = 0; priority < PRIORITY_COUNT; ++priority) {
+    for (size_t owner = 0; owner < state_->owner_count; ++owner) {
+      State::Queue* queue = state_->QueueFor(owner, priority);
+      for (State::Queue::iterator entry = queue->begin();
+           entry != queue->end();
+           ++entry) {
+        if (GroupOf(entry->task) != group)
+          continue;
+        Task* task = entry->task;
+        StageMetrics* metrics = &state_->metrics[entry->stage];
+        --metrics->queue_depth;
+        ++metrics->withdrawn;
+        queue->erase(entry);
+        state_->Unlock();
+        return task;
+      }
+    }
+  }
+  state_->Unlock();
+  return NULL;
+}
+
+TaskExecutor::StageMetrics WorkStealingExecutor::GetStageMetrics(
+    Stage stage) const {
+  state_->Lock();
+  StageMetrics metrics = state_->metrics[stage];
+  state_->Unlock();
+  return metrics;
+}
+
+unsigned int WorkStealingExecutor::thread_count() const {
+#ifndef _WIN32
+  return state_->threads.size();
+#else  // _WIN32
+  return 0;
+#endif  // _WIN32
+}
+
+}  // namespace google_breakpad
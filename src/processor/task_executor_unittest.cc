@@ -0,0 +1,327 @@
+// Copyright (c) 2016 Google Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+// notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above
+// copyright notice, this list of conditions and the following disclaimer
+// in the documentation and/or other materials provided with the
+// distribution.
+//     * Neither the name of Google Inc. nor the names of its
+// contributors may be used to endorse or promote products derived from
+// this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+// task_executor_unittest.cc: Unit tests for TaskGroup and
+// WorkStealingExecutor.
+
+#include <pthread.h>
+
+#include <vector>
+
+#include "breakpad_googletest_includes.h"
+#include "google_breakpad/processor/task_executor.h"
+#include "processor/mutex.h"
+
+namespace {
+
+using google_breakpad::AutoMutex;
+using google_breakpad::Mutex;
+using google_breakpad::Task;
+using google_breakpad::TaskExecutor;
+using google_breakpad::TaskGroup;
+using google_breakpad::WorkStealingExecutor;
+using std::vector;
+
+// Records the order tasks ran in.
+class Recorder {
+ public:
+  void Record(int id) {
+    AutoMutex lock(&mutex_);
+    order_.push_back(id);
+  }
+
+  vector<int> order() {
+    AutoMutex lock(&mutex_);
+    return order_;
+  }
+
+ private:
+  Mutex mutex_;
+  vector<int> order_;
+};
+
+class RecordingTask : public Task {
+ public:
+  RecordingTask() : recorder_(NULL), id_(0), thread_() {}
+  RecordingTask(Recorder* recorder, int id)
+      : recorder_(recorder), id_(id), thread_() {}
+
+  virtual void Run() {
+    thread_ = pthread_self();
+    recorder_->Record(id_);
+  }
+
+  pthread_t thread() const { return thread_; }
+
+ private:
+  Recorder* recorder_;
+  int id_;
+  pthread_t thread_;
+};
+
+// Holds up an executor thread until Release is called.
+class BlockingTask : public Task {
+ public:
+  BlockingTask() : started_(false), released_(false) {
+    pthread_mutex_init(&mutex_, NULL);
+    pthread_cond_init(&changed_, NULL);
+  }
+  ~BlockingTask() {
+    pthread_cond_destroy(&changed_);
+    pthread_mutex_destroy(&mutex_);
+  }
+
+  virtual void Run() {
+    pthread_mutex_lock(&mutex_);
+    started_ = true;
+    pthread_cond_broadcast(&changed_);
+    while (!released_)
+      pthread_cond_wait(&changed_, &mutex_);
+    pthread_mutex_unlock(&mutex_);
+  }
+
+  void WaitUntilStarted() {
+    pthread_mutex_lock(&mutex_);
+    while (!started_)
+      pthread_cond_wait(&changed_, &mutex_);
+    pthread_mutex_unlock(&mutex_);
+  }
+
+  void Release() {
+    pthread_mutex_lock(&mutex_);
+    released_ = true;
+    pthread_cond_broadcast(&changed_);
+    pthread_mutex_unlock(&mutex_);
+  }
+
+ private:
+  bool started_;
+  bool released_;
+  pthread_mutex_t mutex_;
+  pthread_cond_t changed_;
+};
+
+// Submits |count| tasks to a group of its own and waits for them.
+class SpawningTask : public Task {
+ public:
+  SpawningTask(TaskExecutor* executor, Recorder* recorder, int count)
+      : executor_(executor), children_(count) {
+    for (int i = 0; i < count; ++i)
+      children_[i] = RecordingTask(recorder, i);
+  }
+
+  virtual void Run() {
+    TaskGroup group(executor_);
+    for (size_t i = 0; i < children_.size(); ++i) {
+      group.Submit(&children_[i], TaskExecutor::PRIORITY_NORMAL,
+                   TaskExecutor::STAGE_SYMBOL_PARSE);
+    }
+    group.Wait();
+  }
+
+ private:
+  TaskExecutor* executor_;
+  vector<RecordingTask> children_;
+};
+
+// Submits itself again until it has run |runs| times.
+class ResubmittingTask : public Task {
+ public:
+  ResubmittingTask(TaskGroup* group, int runs) : group_(group), runs_(runs) {}
+
+  virtual void Run() {
+    if (--runs_ > 0) {
+      group_->Submit(this, TaskExecutor::PRIORITY_SPECULATIVE,
+                     TaskExecutor::STAGE_SYMBOL_FETCH);
+    }
+  }
+
+  int runs() const { return runs_; }
+
+ private:
+  TaskGroup* group_;
+  int runs_;
+};
+
+TEST(TaskExecutorTest, RunsEveryTask) {
+  WorkStealingExecutor executor(4);
+  EXPECT_EQ(4U, executor.thread_count());
+  Recorder recorder;
+  vector<RecordingTask> tasks;
+  for (int i = 0; i < 100; ++i)
+    tasks.push_back(RecordingTask(&recorder, i));
+
+  TaskGroup group(&executor);
+  for (size_t i = 0; i < tasks.size(); ++i) {
+    group.Submit(&tasks[i], TaskExecutor::PRIORITY_NORMAL,
+                 TaskExecutor::STAGE_STACKWALK);
+  }
+  group.Wait();
+
+  vector<int> order = recorder.order();
+  ASSERT_EQ(tasks.size(), order.size());
+  vector<bool> seen(tasks.size());
+  for (size_t i = 0; i < order.size(); ++i)
+    seen[order[i]] = true;
+  for (size_t i = 0; i < seen.size(); ++i)
+    EXPECT_TRUE(seen[i]) << "task " << i;
+
+  TaskExecutor::StageMetrics metrics =
+      executor.GetStageMetrics(TaskExecutor::STAGE_STACKWALK);
+  EXPECT_EQ(100U, metrics.submitted);
+  EXPECT_EQ(100U, metrics.completed + metrics.withdrawn);
+  EXPECT_EQ(0U, metrics.queue_depth);
+  EXPECT_GE(metrics.max_queue_depth, 1U);
+  EXPECT_EQ(0U, executor.GetStageMetrics(
+      TaskExecutor::STAGE_SYMBOL_FETCH).submitted);
+}
+
+TEST(TaskExecutorTest, WaitingThreadRunsTasksWithoutExecutorThreads) {
+  WorkStealingExecutor executor(0);
+  EXPECT_EQ(0U, executor.thread_count());
+  Recorder recorder;
+  RecordingTask first(&recorder, 1);
+  RecordingTask second(&recorder, 2);
+
+  TaskGroup group(&executor);
+  group.Submit(&first, TaskExecutor::PRIORITY_NORMAL,
+               TaskExecutor::STAGE_REQUEST);
+  group.Submit(&second, TaskExecutor::PRIORITY_CRITICAL,
+               TaskExecutor::STAGE_REQUEST);
+  EXPECT_TRUE(recorder.order().empty());
+  group.Wait();
+
+  // Withdrawn tasks run most urgent first.
+  vector<int> order = recorder.order();
+  ASSERT_EQ(2U, order.size());
+  EXPECT_EQ(2, order[0]);
+  EXPECT_EQ(1, order[1]);
+  EXPECT_TRUE(pthread_equal(pthread_self(), first.thread()));
+  EXPECT_TRUE(pthread_equal(pthread_self(), second.thread()));
+
+  TaskExecutor::StageMetrics metrics =
+      executor.GetStageMetrics(TaskExecutor::STAGE_REQUEST);
+  EXPECT_EQ(2U, metrics.submitted);
+  EXPECT_EQ(2U, metrics.withdrawn);
+  EXPECT_EQ(0U, metrics.completed);
+  EXPECT_EQ(2U, metrics.max_queue_depth);
+}
+
+TEST(TaskExecutorTest, NullExecutorRunsTasksOnSubmit) {
+  Recorder recorder;
+  RecordingTask task(&recorder, 7);
+  TaskGroup group(NULL);
+  group.Submit(&task, TaskExecutor::PRIORITY_NORMAL,
+               TaskExecutor::STAGE_STACKWALK);
+  ASSERT_EQ(1U, recorder.order().size());
+  group.Wait();
+}
+
+TEST(TaskExecutorTest, StartsUrgentTasksFirst) {
+  WorkStealingExecutor executor(1);
+  BlockingTask blocker;
+  TaskGroup blocker_group(&executor);
+  blocker_group.Submit(&blocker, TaskExecutor::PRIORITY_NORMAL,
+                       TaskExecutor::STAGE_REQUEST);
+  blocker.WaitUntilStarted();
+
+  Recorder recorder;
+  RecordingTask speculative(&recorder, TaskExecutor::PRIORITY_SPECULATIVE);
+  RecordingTask normal(&recorder, TaskExecutor::PRIORITY_NORMAL);
+  RecordingTask critical(&recorder, TaskExecutor::PRIORITY_CRITICAL);
+  // The tasks are left to the executor thread, rather than waited for, so
+  // that it is the thread that picks the order.
+  {
+    TaskGroup group(&executor);
+    group.Submit(&speculative, TaskExecutor::PRIORITY_SPECULATIVE,
+                 TaskExecutor::STAGE_SYMBOL_FETCH);
+    group.Submit(&normal, TaskExecutor::PRIORITY_NORMAL,
+                 TaskExecutor::STAGE_STACKWALK);
+    group.Submit(&critical, TaskExecutor::PRIORITY_CRITICAL,
+                 TaskExecutor::STAGE_SYMBOL_PARSE);
+    EXPECT_EQ(1U, executor.GetStageMetrics(
+        TaskExecutor::STAGE_SYMBOL_FETCH).queue_depth);
+    blocker.Release();
+    blocker_group.Wait();
+    while (recorder.order().size() < 3) {
+      // The executor thread runs the three tasks on its own.
+    }
+  }
+
+  vector<int> order = recorder.order();
+  ASSERT_EQ(3U, order.size());
+  EXPECT_EQ(TaskExecutor::PRIORITY_CRITICAL, order[0]);
+  EXPECT_EQ(TaskExecutor::PRIORITY_NORMAL, order[1]);
+  EXPECT_EQ(TaskExecutor::PRIORITY_SPECULATIVE, order[2]);
+}
+
+TEST(TaskExecutorTest, TasksCanWaitForTasks) {
+  // Each spawning task occupies an executor thread while it waits, so the
+  // children only run because their waiting parents take them back.
+  WorkStealingExecutor executor(2);
+  Recorder recorder;
+  vector<SpawningTask*> parents;
+  TaskGroup group(&executor);
+  for (int i = 0; i < 4; ++i) {
+    parents.push_back(new SpawningTask(&executor, &recorder, 10));
+    group.Submit(parents.back(), TaskExecutor::PRIORITY_NORMAL,
+                 TaskExecutor::STAGE_REQUEST);
+  }
+  group.Wait();
+  EXPECT_EQ(40U, recorder.order().size());
+  for (size_t i = 0; i < parents.size(); ++i)
+    delete parents[i];
+}
+
+TEST(TaskExecutorTest, WaitCoversTasksSubmittedWhileWaiting) {
+  for (unsigned int threads = 0; threads < 3; ++threads) {
+    WorkStealingExecutor executor(threads);
+    TaskGroup group(&executor);
+    ResubmittingTask task(&group, 5);
+    group.Submit(&task, TaskExecutor::PRIORITY_SPECULATIVE,
+                 TaskExecutor::STAGE_SYMBOL_FETCH);
+    group.Wait();
+    EXPECT_EQ(0, task.runs()) << threads << " threads";
+    EXPECT_EQ(5U, executor.GetStageMetrics(
+        TaskExecutor::STAGE_SYMBOL_FETCH).submitted);
+  }
+}
+
+TEST(TaskExecutorTest, StageNames) {
+  EXPECT_STREQ("stackwalk",
+               TaskExecutor::StageName(TaskExecutor::STAGE_STACKWALK));
+  EXPECT_STREQ("symbol_fetch",
+               TaskExecutor::StageName(TaskExecutor::STAGE_SYMBOL_FETCH));
+  EXPECT_STREQ("symbol_parse",
+               TaskExecutor::StageName(TaskExecutor::STAGE_SYMBOL_PARSE));
+  EXPECT_STREQ("request",
+               TaskExecutor::StageName(TaskExecutor::STAGE_REQUEST));
+}
+
+}  // namespace
@@ -0,0 +1,266 @@
+// Copyright (c) 2016 Google Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+// notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above
+// copyright notice, this list of conditions and the following disclaimer
+// in the documentation and/or other materials provided with the
+// distribution.
+//     * Neither the name of Google Inc. nor the names of its
+// contributors may be used to endorse or promote products derived from
+// this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+// unwind_policy.cc: Implementation of UnwindPolicy and UnwindStatistics.
+//
+// See unwind_policy.h for documentation.
+
+#include "google_breakpad/processor/unwind_policy.h"
+
+#include <stdio.h>
+
+#include <vector>
+
+#include "google_breakpad/processor/call_stack.h"
+#include "google_breakpad/processor/code_module.h"
+#include "google_breakpad/processor/process_state.h"
+#include "google_breakpad/processor/stack_frame.h"
+#include "processor/logging.h"
+#include "processor/pathname_stripper.h"
+
+namespace google_breakpad {
+
+namespace {
+
+using std::vector;
+
+const char kWhitespace[] = " \t";
+
+const struct {
+  UnwindPolicy::Method method;
+  const char* name;
+} kMethodNames[] = {
+  { UnwindPolicy::METHOD_CFI, "cfi" },
+  { UnwindPolicy::METHOD_FRAME_POINTER, "fp" },
+  { UnwindPolicy::METHOD_SCAN, "scan" },
+};
+
+// Returns the counts in |counts| for the method that found frames with
+// |trust|, or NULL if they weren't found by one of the policy's methods.
+UnwindStatistics::MethodCounts* CountsForTrust(
+    StackFrame::FrameTrust trust,
+    UnwindStatistics::ModuleCounts* counts) {
+  switch (trust) {
+    case StackFrame::FRAME_TRUST_CFI:
+      return &counts->cfi;
+    case StackFrame::FRAME_TRUST_FP:
+      return &counts->frame_pointer;
+    case StackFrame::FRAME_TRUST_SCAN:
+    case StackFrame::FRAME_TRUST_CFI_SCAN:
+      return &counts->scan;
+    default:
+      return NULL;
+  }
+}
+
+bool IsConfirming(StackFrame::FrameTrust trust) {
+  return trust == StackFrame::FRAME_TRUST_CFI ||
+         trust == StackFrame::FRAME_TRUST_FP;
+}
+
+// Parses a comma-separated list of method names into |methods|.
+bool ParseMethods(const string& list, int* methods) {
+  *methods = 0;
+  if (list == "none")
+    return true;
+  string::size_type start = 0;
+  for (;;) {
+    string::size_type end = list.find(',', start);
+    string name = list.substr(start, end == string::npos ?
+                                     string::npos : end - start);
+    bool found = false;
+    for (size_t i = 0; i < sizeof(kMethodNames) / sizeof(kMethodNames[0]);
+         ++i) {
+      if (name == kMethodNames[i].name) {
+        *methods |= kMethodNames[i].method;
+        found = true;
+      }
+    }
+    if (!found)
+      return false;
+    if (end == string::npos)
+      return true;
+    start = end + 1;
+  }
+}
+
+// Returns true if fewer than |fraction| of the frames in |counts| were
+// confirmed, given at least |min_frames| frames.
+bool IsFutile(const UnwindStatistics::MethodCounts& counts,
+              uint64_t min_frames, double fraction) {
+  return counts.frames >= min_frames && counts.frames > 0 &&
+         counts.confirmed < fraction * counts.frames;
+}
+
+}  // namespace
+
+void UnwindStatistics::Add(const ProcessState& process_state) {
+  const vector<CallStack*>* threads = process_state.threads();
+  for (size_t i = 0; i < threads->size(); ++i) {
+    const vector<StackFrame*>* frames = threads->at(i)->frames();
+    for (size_t j = 0; j + 2 < frames->size(); ++j) {
+      const StackFrame* callee = frames->at(j);
+      if (!callee->module)
+        continue;
+      ModuleCounts* module_counts =
+          &modules_[PathnameStripper::File(callee->module->debug_file())];
+      MethodCounts* counts =
+          CountsForTrust(frames->at(j + 1)->trust, module_counts);
+      if (!counts)
+        continue;
+      ++counts->frames;
+      if (IsConfirming(frames->at(j + 2)->trust))
+        ++counts->confirmed;
+    }
+  }
+}
+
+bool UnwindPolicy::Parse(const string& text) {
+  modules_.clear();
+  string::size_type line_start = 0;
+  int line_number = 0;
+  while (line_start < text.size()) {
+    string::size_type line_end = text.find('\n', line_start);
+    if (line_end == string::npos)
+      line_end = text.size();
+    string line = text.substr(line_start, line_end - line_start);
+    line_start = line_end + 1;
+    ++line_number;
+
+    if (!line.empty() && line[line.size() - 1] == '\r')
+      line.erase(line.size() - 1);
+    string::size_type first = line.find_first_not_of(kWhitespace);
+    if (first == string::npos || line[first] == '#')
+      continue;
+    string::size_type last = line.find_last_not_of(kWhitespace);
+    line = line.substr(first, last - first + 1);
+
+    // The module name may contain spaces; the methods are the last word.
+    string::size_type split = line.find_last_of(kWhitespace);
+    int methods;
+    if (split == string::npos ||
+        !ParseMethods(line.substr(split + 1), &methods)) {
+      BPLOG(ERROR) << "Malformed unwind policy line " << line_number << ": "
+                   << line;
+      modules_.clear();
+      return false;
+    }
+    string::size_type module_end = line.find_last_not_of(kWhitespace, split);
+    modules_[line.substr(0, module_end + 1)] = methods;
+  }
+  return true;
+}
+
+bool UnwindPolicy::LoadFromFile(const string& path) {
+  FILE* file = fopen(path.c_str(), "r");
+  if (!file) {
+    BPLOG(ERROR) << "Could not open unwind policy " << path;
+    modules_.clear();
+    return false;
+  }
+  string text;
+  char buffer[4096];
+  size_t read;
+  while ((read = fread(buffer, 1, sizeof(buffer), file)) > 0)
+    text.append(buffer, read);
+  bool failed = ferror(file);
+  fclose(file);
+  if (failed) {
+    BPLOG(ERROR) << "Could not read unwind policy " << path;
+    modules_.clear();
+    return false;
+  }
+  return Parse(text);
+}
+
+string UnwindPolicy::Serialize() const {
+  string text;
+  for (std::map<string, int>::const_iterator it = modules_.begin();
+       it != modules_.end(); ++it) {
+    text += it->first;
+    text += ' ';
+    string methods;
+    for (size_t i = 0; i < sizeof(kMethodNames) / sizeof(kMethodNames[0]);
+         ++i) {
+      if (it->second & kMethodNames[i].method) {
+        if (!methods.empty())
+          methods += ',';
+        methods += kMethodNames[i].name;
+      }
+    }
+    text += methods.empty() ? "none" : methods;
+    text += '\n';
+  }
+  return text;
+}
+
+void UnwindPolicy::SetModuleMethods(const string& module, int methods) {
+  modules_[module] = methods & ALL_METHODS;
+}
+
+int UnwindPolicy::AllowedMethods(const CodeModule* module) const {
+  if (!module || modules_.empty())
+    return ALL_METHODS;
+  std::map<string, int>::const_iterator it =
+      modules_.find(PathnameStripper::File(module->debug_file()));
+  return it == modules_.end() ? ALL_METHODS : it->second;
+}
+
+void UnwindPolicy::Update(const UnwindStatistics& statistics,
+                          const UpdateOptions& options) {
+  const std::map<string, UnwindStatistics::ModuleCounts>& modules =
+      statistics.modules();
+  for (std::map<string, UnwindStatistics::ModuleCounts>::const_iterator it =
+           modules.begin();
+       it != modules.end(); ++it) {
+    const UnwindStatistics::ModuleCounts& counts = it->second;
+    std::map<string, int>::const_iterator current = modules_.find(it->first);
+    int methods = current == modules_.end() ? ALL_METHODS : current->second;
+    int updated = methods;
+    if (IsFutile(counts.frame_pointer, options.min_frames,
+                 options.min_confirmed_fraction)) {
+      updated &= ~METHOD_FRAME_POINTER;
+    }
+    if (IsFutile(counts.scan, options.min_frames,
+                 options.min_confirmed_fraction)) {
+      updated &= ~METHOD_SCAN;
+    }
+    if (counts.cfi.frames == 0 &&
+        counts.frame_pointer.frames >= options.min_frames &&
+        counts.frame_pointer.frames > 0 &&
+        counts.frame_pointer.confirmed >=
+            options.reliable_fraction * counts.frame_pointer.frames) {
+      updated &= ~METHOD_CFI;
+    }
+    if (updated != methods)
+      modules_[it->first] = updated;
+  }
+}
+
+}  // namespace google_breakpad
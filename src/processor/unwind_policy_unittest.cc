@@ -0,0 +1,189 @@
+// Copyright (c) 2016 Google Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+// notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above
+// copyright notice, this list of conditions and the following disclaimer
+// in the documentation and/or other materials provided with the
+// distribution.
+//     * Neither the name of Google Inc. nor the names of its
+// contributors may be used to endorse or promote products derived from
+// this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+// unwind_policy_unittest.cc: Unit tests for UnwindPolicy and
+// UnwindStatistics.
+
+#include <stdlib.h>
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include "breakpad_googletest_includes.h"
+#include "common/using_std_string.h"
+#include "google_breakpad/processor/basic_source_line_resolver.h"
+#include "google_breakpad/processor/call_stack.h"
+#include "google_breakpad/processor/minidump_processor.h"
+#include "google_breakpad/processor/process_state.h"
+#include "google_breakpad/processor/stack_frame.h"
+#include "google_breakpad/processor/unwind_policy.h"
+#include "processor/simple_symbol_supplier.h"
+#include "processor/stackwalker_unittest_utils.h"
+
+namespace {
+
+using google_breakpad::BasicSourceLineResolver;
+using google_breakpad::MinidumpProcessor;
+using google_breakpad::ProcessState;
+using google_breakpad::SimpleSymbolSupplier;
+using google_breakpad::StackFrame;
+using google_breakpad::UnwindPolicy;
+using google_breakpad::UnwindStatistics;
+
+// The debug file of the module of the first three frames of the crashing
+// thread in minidump2.dmp.
+const char kTestApp[] = "test_app.pdb";
+
+string TestDataDir() {
+  return string(getenv("srcdir") ? getenv("srcdir") : ".") +
+      "/src/processor/testdata";
+}
+
+// Processes minidump2.dmp into |state|, with symbols if |symbolize|,
+// following |policy| if it isn't NULL.
+void ProcessTestDump(bool symbolize, const UnwindPolicy *policy,
+                     ProcessState *state) {
+  SimpleSymbolSupplier supplier(TestDataDir() + "/symbols");
+  BasicSourceLineResolver resolver;
+  MinidumpProcessor processor(symbolize ? &supplier : NULL, &resolver);
+  processor.set_unwind_policy(policy);
+  ASSERT_EQ(google_breakpad::PROCESS_OK,
+            processor.Process(TestDataDir() + "/minidump2.dmp", state));
+}
+
+TEST(UnwindPolicyTest, ParsesAndSerializes) {
+  UnwindPolicy policy;
+  ASSERT_TRUE(policy.Parse("# A comment\n"
+                           "\n"
+                           "libc.so cfi,fp\r\n"
+                           "  My Module.pdb\tscan  \n"
+                           "kernel32.pdb none"));
+  EXPECT_EQ(3U, policy.module_count());
+  EXPECT_EQ("My Module.pdb scan\n"
+            "kernel32.pdb none\n"
+            "libc.so cfi,fp\n",
+            policy.Serialize());
+
+  UnwindPolicy reparsed;
+  ASSERT_TRUE(reparsed.Parse(policy.Serialize()));
+  EXPECT_EQ(policy.Serialize(), reparsed.Serialize());
+}
+
+TEST(UnwindPolicyTest, RejectsMalformedLines) {
+  UnwindPolicy policy;
+  EXPECT_FALSE(policy.Parse("libc.so cfi\nlibm.so\n"));
+  EXPECT_EQ(0U, policy.module_count());
+  EXPECT_FALSE(policy.Parse("libc.so cfi,stack\n"));
+  EXPECT_FALSE(policy.Parse("libc.so cfi,\n"));
+  EXPECT_FALSE(policy.LoadFromFile(TestDataDir() + "/no-such-policy"));
+}
+
+TEST(UnwindPolicyTest, AllowedMethods) {
+  UnwindPolicy policy;
+  MockCodeModule module(0x1000, 0x1000, "/lib/libc.so", "1");
+  MockCodeModule other(0x2000, 0x1000, "/lib/libm.so", "1");
+  EXPECT_EQ(UnwindPolicy::ALL_METHODS, policy.AllowedMethods(&module));
+
+  policy.SetModuleMethods("libc.so", UnwindPolicy::METHOD_CFI);
+  EXPECT_EQ(UnwindPolicy::METHOD_CFI, policy.AllowedMethods(&module));
+  EXPECT_EQ(UnwindPolicy::ALL_METHODS, policy.AllowedMethods(&other));
+  EXPECT_EQ(UnwindPolicy::ALL_METHODS, policy.AllowedMethods(NULL));
+
+  policy.SetModuleMethods("libc.so", 0);
+  EXPECT_EQ(0, policy.AllowedMethods(&module));
+}
+
+TEST(UnwindPolicyTest, CountsMethodsByModule) {
+  ProcessState state;
+  ProcessTestDump(true, NULL, &state);
+  UnwindStatistics statistics;
+  statistics.Add(state);
+  statistics.Add(state);
+
+  // Two callers of test_app.exe frames were found with stack walking
+  // information, and both led on to more of it.  The last caller found,
+  // in kernel32.dll, is not counted.
+  const std::map<string, UnwindStatistics::ModuleCounts> &modules =
+      statistics.modules();
+  ASSERT_EQ(1U, modules.size());
+  ASSERT_EQ(kTestApp, modules.begin()->first);
+  const UnwindStatistics::ModuleCounts &counts = modules.begin()->second;
+  EXPECT_EQ(4U, counts.cfi.frames);
+  EXPECT_EQ(4U, counts.cfi.confirmed);
+  EXPECT_EQ(0U, counts.frame_pointer.frames);
+  EXPECT_EQ(0U, counts.scan.frames);
+}
+
+TEST(UnwindPolicyTest, UpdateSkipsUnneededStackWalkingInformation) {
+  // Without symbols, every caller is found with the frame pointer.
+  ProcessState state;
+  ProcessTestDump(false, NULL, &state);
+  UnwindStatistics statistics;
+  statistics.Add(state);
+
+  UnwindPolicy::UpdateOptions options;
+  UnwindPolicy policy;
+  policy.Update(statistics, options);
+  EXPECT_EQ(0U, policy.module_count());
+
+  options.min_frames = 2;
+  policy.Update(statistics, options);
+  EXPECT_EQ(string(kTestApp) + " fp,scan\n", policy.Serialize());
+
+  // Methods the policy already skips stay skipped.
+  policy.SetModuleMethods(kTestApp, UnwindPolicy::METHOD_FRAME_POINTER);
+  policy.Update(statistics, options);
+  EXPECT_EQ(string(kTestApp) + " fp\n", policy.Serialize());
+}
+
+TEST(UnwindPolicyTest, StackwalkerFollowsPolicy) {
+  ProcessState state;
+  ProcessTestDump(true, NULL, &state);
+  ASSERT_EQ(4U, state.threads()->at(0)->frames()->size());
+
+  // With only the frame pointer, the walk still reaches kernel32.dll.
+  UnwindPolicy policy;
+  policy.SetModuleMethods(kTestApp, UnwindPolicy::METHOD_FRAME_POINTER);
+  ProcessState fp_state;
+  ProcessTestDump(true, &policy, &fp_state);
+  const std::vector<StackFrame*> *frames =
+      fp_state.threads()->at(0)->frames();
+  ASSERT_EQ(4U, frames->size());
+  for (size_t i = 1; i < frames->size(); ++i)
+    EXPECT_EQ(StackFrame::FRAME_TRUST_FP, frames->at(i)->trust);
+
+  // With no methods, the walk stops at the first frame.
+  policy.SetModuleMethods(kTestApp, 0);
+  ProcessState stopped_state;
+  ProcessTestDump(true, &policy, &stopped_state);
+  EXPECT_EQ(1U, stopped_state.threads()->at(0)->frames()->size());
+}
+
+}  // namespace
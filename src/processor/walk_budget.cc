@@ -0,0 +1,106 @@
+// Copyright (c) 2016 Google Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+// notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above
+// copyright notice, this list of conditions and the following disclaimer
+// in the documentation and/or other materials provided with the
+// distribution.
+//     * Neither the name of Google Inc. nor the names of its
+// contributors may be used to endorse or promote products derived from
+// this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+// walk_budget.cc: Implementation of WalkBudget.
+//
+// See walk_budget.h for documentation.
+
+#include "google_breakpad/processor/walk_budget.h"
+
+#include "processor/mutex.h"
+#include "processor/stopwatch.h"
+
+namespace google_breakpad {
+
+WalkBudget::WalkBudget(const Limits& limits)
+    : limits_(limits),
+      stopwatch_(new Stopwatch),
+      frames_(0),
+      scanned_words_(0),
+      symbol_bytes_(0),
+      exhausted_(false),
+      mutex_(new Mutex) {
+}
+
+WalkBudget::~WalkBudget() {
+  delete mutex_;
+  delete stopwatch_;
+}
+
+bool WalkBudget::CheckExhaustedLocked() {
+  if (!exhausted_ &&
+      ((limits_.frames && frames_ >= limits_.frames) ||
+       (limits_.scanned_words && scanned_words_ >= limits_.scanned_words) ||
+       (limits_.symbol_bytes && symbol_bytes_ >= limits_.symbol_bytes) ||
+       (limits_.seconds > 0 &&
+        stopwatch_->ElapsedSeconds() >= limits_.seconds))) {
+    exhausted_ = true;
+  }
+  return exhausted_;
+}
+
+bool WalkBudget::ChargeFrame() {
+  AutoMutex lock(mutex_);
+  ++frames_;
+  return !CheckExhaustedLocked();
+}
+
+bool WalkBudget::ChargeScannedWords(uint64_t words) {
+  AutoMutex lock(mutex_);
+  scanned_words_ += words;
+  return !CheckExhaustedLocked();
+}
+
+void WalkBudget::ChargeSymbolBytes(uint64_t bytes) {
+  AutoMutex lock(mutex_);
+  symbol_bytes_ += bytes;
+  CheckExhaustedLocked();
+}
+
+bool WalkBudget::exhausted() const {
+  AutoMutex lock(mutex_);
+  return exhausted_;
+}
+
+uint64_t WalkBudget::frames() const {
+  AutoMutex lock(mutex_);
+  return frames_;
+}
+
+uint64_t WalkBudget::scanned_words() const {
+  AutoMutex lock(mutex_);
+  return scanned_words_;
+}
+
+uint64_t WalkBudget::symbol_bytes() const {
+  AutoMutex lock(mutex_);
+  return symbol_bytes_;
+}
+
+}  // namespace google_breakpad
@@ -48,6 +48,7 @@
 #include "google_breakpad/common/breakpad_types.h"
 #include "processor/logging.h"
 #include "processor/tokenize.h"
+#include "processor/windows_frame_program.h"
 
 namespace google_breakpad {
 
@@ -106,7 +107,8 @@ struct WindowsFrameInfo {
         local_size(set_local_size),
         max_stack_size(set_max_stack_size),
         allocates_base_pointer(set_allocates_base_pointer),
-        program_string(set_program_string) {}
+        program_string(set_program_string),
+        program(set_program_string) {}
 
   // Parse a textual serialization of a WindowsFrameInfo object from
   // a string. Returns NULL if parsing fails, or a new object
@@ -171,6 +173,7 @@ struct WindowsFrameInfo {
     max_stack_size = that.max_stack_size;
     allocates_base_pointer = that.allocates_base_pointer;
     program_string = that.program_string;
+    program = that.program;
   }
 
   // Clears the WindowsFrameInfo object so that users will see it as though
@@ -179,6 +182,7 @@ struct WindowsFrameInfo {
     type_ = STACK_INFO_UNKNOWN;
     valid = VALID_NONE;
     program_string.erase();
+    program = WindowsFrameProgram();
   }
 
   StackInfoTypes type_;
@@ -201,6 +205,10 @@ struct WindowsFrameInfo {
   // If program_string is empty, use allocates_base_pointer.
   bool allocates_base_pointer;
   string program_string;
+
+  // program_string, compiled when the WindowsFrameInfo is created, so
+  // that the stack walker doesn't parse it for every frame it applies to.
+  WindowsFrameProgram program;
 };
 
 }  // namespace google_breakpad
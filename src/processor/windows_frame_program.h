@@ -0,0 +1,464 @@
+// Copyright (c) 2016 Google Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+// notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above
+// copyright notice, this list of conditions and the following disclaimer
+// in the documentation and/or other materials provided with the
+// distribution.
+//     * Neither the name of Google Inc. nor the names of its
+// contributors may be used to endorse or promote products derived from
+// this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+// windows_frame_program.h: WindowsFrameProgram, the program string of a
+// STACK WIN record compiled for repeated evaluation.
+//
+// PostfixEvaluator tokenizes a program string, and keeps every value on
+// its stack and in its dictionary as a string, each time it evaluates it.
+// WindowsFrameProgram tokenizes the string once, turning literals into
+// numbers and the registers and constants that program strings use into
+// fixed slots, and evaluates the result on a stack of integers.  It
+// follows PostfixEvaluator<uint32_t>'s rules: identifiers are looked up
+// when they are popped, only identifiers beginning with '$' may be
+// assigned to, an assignment may be smashed up against the following
+// token ("=$eip"), assignments made before a failure are kept, and
+// anything left on the stack at the end is a failure.  Unlike
+// PostfixEvaluator, it fails on division by zero instead of crashing.
+
+#ifndef PROCESSOR_WINDOWS_FRAME_PROGRAM_H__
+#define PROCESSOR_WINDOWS_FRAME_PROGRAM_H__
+
+#include <stdio.h>
+
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "common/using_std_string.h"
+#include "google_breakpad/common/breakpad_types.h"
+#include "google_breakpad/processor/memory_region.h"
+#include "processor/logging.h"
+
+namespace google_breakpad {
+
+class WindowsFrameProgram {
+ public:
+  // The registers and constants that program strings use, which have
+  // slots of their own.  Any other identifier gets a slot numbered from
+  // kFixedVariableCount up, in the order it first appears.
+  enum Variable {
+    kEIP = 0,        // $eip
+    kESP,            // $esp
+    kEBP,            // $ebp
+    kEBX,            // $ebx
+    kESI,            // $esi
+    kEDI,            // $edi
+    kT0,             // $T0
+    kT1,             // $T1
+    kT2,             // $T2
+    kL,              // $L
+    kP,              // $P
+    kRASearch,       // .raSearch
+    kRASearchStart,  // .raSearchStart
+    kParams,         // .cbParams
+    kCalleeParams,   // .cbCalleeParams
+    kSavedRegs,      // .cbSavedRegs
+    kLocals,         // .cbLocals
+    kFixedVariableCount
+  };
+
+  // The variables of one evaluation of a program, the counterpart of
+  // PostfixEvaluator's dictionary and its set of assigned identifiers.
+  class Environment {
+   public:
+    explicit Environment(const WindowsFrameProgram& program)
+        : extra_(program.extra_names_.size()) {}
+
+    // Gives |variable| the value |value|.
+    void Set(int variable, uint32_t value) {
+      Slot* slot = GetSlot(variable);
+      slot->value = value;
+      slot->defined = true;
+    }
+
+    // Returns the value of |variable|, or 0 if it has none.
+    uint32_t Get(int variable) const { return GetSlot(variable)->value; }
+
+    // Returns true if |variable| has a value.
+    bool Defined(int variable) const { return GetSlot(variable)->defined; }
+
+    // Returns true if evaluating the program assigned to |variable|.
+    bool Assigned(int variable) const { return GetSlot(variable)->assigned; }
+
+   private:
+    friend class WindowsFrameProgram;
+
+    struct Slot {
+      Slot() : value(0), defined(false), assigned(false) {}
+      uint32_t value;
+      bool defined;
+      bool assigned;
+    };
+
+    Slot* GetSlot(int variable) {
+      return variable < kFixedVariableCount ?
+             &fixed_[variable] : &extra_[variable - kFixedVariableCount];
+    }
+    const Slot* GetSlot(int variable) const {
+      return variable < kFixedVariableCount ?
+             &fixed_[variable] : &extra_[variable - kFixedVariableCount];
+    }
+
+    Slot fixed_[kFixedVariableCount];
+    std::vector<Slot> extra_;
+  };
+
+  WindowsFrameProgram() : uses_align_(false), max_depth_(0) {}
+
+  explicit WindowsFrameProgram(const string& program_string)
+      : uses_align_(false), max_depth_(0) {
+    Compile(program_string);
+  }
+
+  // Replaces the program with the compiled form of |program_string|.
+  // Compiling never fails: a program that can't be evaluated fails when
+  // it is evaluated, at the same point PostfixEvaluator would.
+  void Compile(const string& program_string) {
+    operations_.clear();
+    extra_names_.clear();
+    uses_align_ = false;
+    max_depth_ = 0;
+
+    std::istringstream stream(program_string);
+    string token;
+    while (stream >> token) {
+      if (token.size() > 1 && token[0] == '=') {
+        CompileToken("=");
+        CompileToken(token.substr(1));
+      } else {
+        CompileToken(token);
+      }
+    }
+    ComputeMaxDepth();
+  }
+
+  // Returns the variable named |name|: its fixed slot, or the slot the
+  // program gave it.  Returns -1 if it has neither.
+  int FindVariable(const string& name) const {
+    for (int i = 0; i < kFixedVariableCount; ++i) {
+      if (name == FixedVariableName(i))
+        return i;
+    }
+    for (size_t i = 0; i < extra_names_.size(); ++i) {
+      if (name == extra_names_[i])
+        return kFixedVariableCount + i;
+    }
+    return -1;
+  }
+
+  // Returns true if the program has no operations.
+  bool empty() const { return operations_.empty(); }
+
+  // Returns true if the program uses the alignment operator (@).
+  bool uses_align() const { return uses_align_; }
+
+  // Evaluates the program with the variables in |environment|, reading
+  // dereferenced (^) addresses from |memory|, which may be NULL if the
+  // program doesn't dereference anything.  Returns true if the program
+  // ran to completion and left nothing on the stack.
+  bool Evaluate(const MemoryRegion* memory, Environment* environment) const {
+    const size_t kSmallStackSize = 16;
+    Entry small_stack[kSmallStackSize];
+    std::vector<Entry> large_stack;
+    Entry* stack = small_stack;
+    if (max_depth_ > kSmallStackSize) {
+      large_stack.resize(max_depth_);
+      stack = &large_stack[0];
+    }
+    size_t depth = 0;
+
+    for (size_t i = 0; i < operations_.size(); ++i) {
+      const Operation& operation = operations_[i];
+      switch (operation.code) {
+        case PUSH_LITERAL:
+          stack[depth].value = operation.operand;
+          stack[depth].variable = -1;
+          ++depth;
+          break;
+
+        case PUSH_VARIABLE:
+          stack[depth].variable = operation.operand;
+          ++depth;
+          break;
+
+        case DEREFERENCE: {
+          if (!memory) {
+            BPLOG(ERROR) << "Attempt to dereference without memory";
+            return false;
+          }
+          uint32_t address;
+          if (!PopValue(stack, &depth, *environment, &address))
+            return false;
+          uint32_t value;
+          if (!memory->GetMemoryAtAddress(address, &value)) {
+            BPLOG(ERROR) << "Could not dereference memory at address " <<
+                            HexString(address);
+            return false;
+          }
+          stack[depth].value = value;
+          stack[depth].variable = -1;
+          ++depth;
+          break;
+        }
+
+        case ASSIGN: {
+          uint32_t value;
+          if (!PopValue(stack, &depth, *environment, &value))
+            return false;
+          if (depth == 0)
+            return false;
+          --depth;
+          int variable = stack[depth].variable;
+          if (variable < 0 || !IsAssignable(variable)) {
+            BPLOG(ERROR) << "Can't assign " << HexString(value);
+            return false;
+          }
+          Environment::Slot* slot = environment->GetSlot(variable);
+          slot->value = value;
+          slot->defined = true;
+          slot->assigned = true;
+          break;
+        }
+
+        default: {
+          // A binary operation.  The right operand is on top.
+          uint32_t operand1, operand2;
+          if (!PopValue(stack, &depth, *environment, &operand2) ||
+              !PopValue(stack, &depth, *environment, &operand1)) {
+            return false;
+          }
+          uint32_t result;
+          switch (operation.code) {
+            case ADD:
+              result = operand1 + operand2;
+              break;
+            case SUBTRACT:
+              result = operand1 - operand2;
+              break;
+            case MULTIPLY:
+              result = operand1 * operand2;
+              break;
+            case DIVIDE_QUOTIENT:
+            case DIVIDE_MODULUS:
+              if (operand2 == 0) {
+                BPLOG(ERROR) << "Division by zero";
+                return false;
+              }
+              result = operation.code == DIVIDE_QUOTIENT ?
+                       operand1 / operand2 : operand1 % operand2;
+              break;
+            default:  // ALIGN
+              result = operand1 & (static_cast<uint32_t>(-1) ^ (operand2 - 1));
+              break;
+          }
+          stack[depth].value = result;
+          stack[depth].variable = -1;
+          ++depth;
+          break;
+        }
+      }
+    }
+
+    if (depth != 0) {
+      BPLOG(ERROR) << "Incomplete execution";
+      return false;
+    }
+    return true;
+  }
+
+ private:
+  enum OperationCode {
+    PUSH_LITERAL,
+    PUSH_VARIABLE,
+    ADD,
+    SUBTRACT,
+    MULTIPLY,
+    DIVIDE_QUOTIENT,
+    DIVIDE_MODULUS,
+    ALIGN,
+    DEREFERENCE,
+    ASSIGN
+  };
+
+  struct Operation {
+    OperationCode code;
+    // The literal's value, or the variable's slot.
+    uint32_t operand;
+  };
+
+  // An entry on the evaluation stack: a value, or, until it is popped, the
+  // identifier that names one.
+  struct Entry {
+    uint32_t value;
+    int variable;  // -1 for a value
+  };
+
+  void CompileToken(const string& token) {
+    Operation operation;
+    operation.operand = 0;
+    if (token == "+") {
+      operation.code = ADD;
+    } else if (token == "-") {
+      operation.code = SUBTRACT;
+    } else if (token == "*") {
+      operation.code = MULTIPLY;
+    } else if (token == "/") {
+      operation.code = DIVIDE_QUOTIENT;
+    } else if (token == "%") {
+      operation.code = DIVIDE_MODULUS;
+    } else if (token == "@") {
+      operation.code = ALIGN;
+      uses_align_ = true;
+    } else if (token == "^") {
+      operation.code = DEREFERENCE;
+    } else if (token == "=") {
+      operation.code = ASSIGN;
+    } else if (ParseLiteral(token, &operation.operand)) {
+      operation.code = PUSH_LITERAL;
+    } else {
+      operation.code = PUSH_VARIABLE;
+      operation.operand = VariableForName(token);
+    }
+    operations_.push_back(operation);
+  }
+
+  // Parses |token| as PostfixEvaluator<uint32_t> parses literals: an
+  // optional '-' followed by something that reads entirely as a uint32_t.
+  static bool ParseLiteral(const string& token, uint32_t* value) {
+    std::istringstream token_stream(token);
+    bool negative = token_stream.peek() == '-';
+    if (negative)
+      token_stream.get();
+    uint32_t literal = 0;
+    if (!(token_stream >> literal) || token_stream.peek() != EOF)
+      return false;
+    *value = negative ? 0 - literal : literal;
+    return true;
+  }
+
+  static const char* FixedVariableName(int variable) {
+    static const char* const kFixedNames[kFixedVariableCount] = {
+      "$eip", "$esp", "$ebp", "$ebx", "$esi", "$edi",
+      "$T0", "$T1", "$T2", "$L", "$P",
+      ".raSearch", ".raSearchStart", ".cbParams", ".cbCalleeParams",
+      ".cbSavedRegs", ".cbLocals"
+    };
+    return kFixedNames[variable];
+  }
+
+  int VariableForName(const string& name) {
+    int variable = FindVariable(name);
+    if (variable >= 0)
+      return variable;
+    extra_names_.push_back(name);
+    return kFixedVariableCount + extra_names_.size() - 1;
+  }
+
+  // Only variables, whose names begin with '$', may be assigned to.
+  bool IsAssignable(int variable) const {
+    if (variable < kFixedVariableCount)
+      return variable < kRASearch;
+    return extra_names_[variable - kFixedVariableCount][0] == '$';
+  }
+
+  // Sets max_depth_ to the deepest the stack gets before evaluation either
+  // finishes or runs out of operands.
+  void ComputeMaxDepth() {
+    size_t depth = 0;
+    for (size_t i = 0; i < operations_.size(); ++i) {
+      switch (operations_[i].code) {
+        case PUSH_LITERAL:
+        case PUSH_VARIABLE:
+          ++depth;
+          break;
+        case DEREFERENCE:
+          if (depth < 1)
+            return;
+          break;
+        case ASSIGN:
+          if (depth < 2)
+            return;
+          depth -= 2;
+          break;
+        default:
+          if (depth < 2)
+            return;
+          --depth;
+          break;
+      }
+      if (depth > max_depth_)
+        max_depth_ = depth;
+    }
+  }
+
+  // Pops the top entry of |stack|, looking it up in |environment| if it
+  // is an identifier, and stores its value in |value|.  Returns false if
+  // the stack is empty or the identifier has no value.
+  bool PopValue(Entry* stack, size_t* depth, const Environment& environment,
+                uint32_t* value) const {
+    if (*depth == 0) {
+      BPLOG(ERROR) << "Stack underflow";
+      return false;
+    }
+    --*depth;
+    const Entry& entry = stack[*depth];
+    if (entry.variable < 0) {
+      *value = entry.value;
+      return true;
+    }
+    if (!environment.Defined(entry.variable)) {
+      BPLOG(INFO) << "Identifier " << VariableName(entry.variable) <<
+                     " not in dictionary";
+      return false;
+    }
+    *value = environment.Get(entry.variable);
+    return true;
+  }
+
+  string VariableName(int variable) const {
+    return variable < kFixedVariableCount ?
+           FixedVariableName(variable) :
+           extra_names_[variable - kFixedVariableCount];
+  }
+
+  std::vector<Operation> operations_;
+
+  // The names of the variables beyond the fixed ones.
+  std::vector<string> extra_names_;
+
+  bool uses_align_;
+
+  // The most entries the stack holds during evaluation.
+  size_t max_depth_;
+};
+
+}  // namespace google_breakpad
+
+#endif  // PROCESSOR_WINDOWS_FRAME_PROGRAM_H__
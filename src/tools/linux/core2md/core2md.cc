@@ -28,18 +28,34 @@
 // OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 // core2md.cc: A utility to convert an ELF core file to a minidump file.
+//
+// With "-" as the core file, the core is read from stdin in one pass and
+// only the parts of it that the minidump needs are kept in memory, so that
+// core2md can be used as a core_pattern pipe handler without the core ever
+// being written to disk. See common/linux/elf_core_stream_reader.h.
 
 #include <stdio.h>
+#include <string.h>
+#include <unistd.h>
 
 #include "client/linux/minidump_writer/minidump_writer.h"
 #include "client/linux/minidump_writer/linux_core_dumper.h"
+#include "common/linux/elf_core_stream_reader.h"
 
 using google_breakpad::AppMemoryList;
+using google_breakpad::ElfCoreStreamReader;
 using google_breakpad::MappingList;
 using google_breakpad::LinuxCoreDumper;
 
 static int ShowUsage(const char* argv0) {
   fprintf(stderr, "Usage: %s <core file> <procfs dir> <output>\n", argv0);
+  fprintf(stderr, "\n"
+          "If <core file> is -, the core is read from stdin, e.g. with\n"
+          "  echo '|%s - /proc/%%P /var/crash/%%P.dmp' > "
+          "/proc/sys/kernel/core_pattern\n"
+          "/proc/sys/kernel/core_pipe_limit must be non-zero for /proc/%%P "
+          "to\n"
+          "outlive the read of the core.\n", argv0);
   return 1;
 }
 
@@ -53,6 +69,22 @@ bool WriteMinidumpFromCore(const char* filename,
                                         &dumper);
 }
 
+bool WriteMinidumpFromCoreStream(const char* filename,
+                                 int core_fd,
+                                 const char* procfs_override) {
+  ElfCoreStreamReader reader;
+  if (!reader.Read(core_fd)) {
+    fprintf(stderr, "Unable to read core dump from stream.\n");
+    return false;
+  }
+
+  MappingList mappings;
+  AppMemoryList memory_list;
+  LinuxCoreDumper dumper(0, reader.content(), procfs_override);
+  return google_breakpad::WriteMinidump(filename, mappings, memory_list,
+                                        &dumper);
+}
+
 int main(int argc, char *argv[]) {
   if (argc != 4) {
     return ShowUsage(argv[0]);
@@ -61,9 +93,10 @@ int main(int argc, char *argv[]) {
   const char* core_file = argv[1];
   const char* procfs_dir = argv[2];
   const char* minidump_file = argv[3];
-  if (!WriteMinidumpFromCore(minidump_file,
-                             core_file,
-                             procfs_dir)) {
+  bool success = strcmp(core_file, "-") == 0 ?
+      WriteMinidumpFromCoreStream(minidump_file, STDIN_FILENO, procfs_dir) :
+      WriteMinidumpFromCore(minidump_file, core_file, procfs_dir);
+  if (!success) {
     fprintf(stderr, "Unable to generate minidump.\n");
     return 1;
   }
@@ -27,32 +27,273 @@
 // (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
 // OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
+#include <dirent.h>
+#include <elf.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
 #include <cstring>
+#include <fstream>
 #include <iostream>
 #include <string>
 #include <vector>
 
+#include "common/dwarf_cu_cache.h"
 #include "common/linux/dump_symbols.h"
+#include "common/linux/eintr_wrapper.h"
+#include "common/module.h"
+#include "common/scoped_ptr.h"
 
+using google_breakpad::DebugDirectoryCache;
+using google_breakpad::DumpOptions;
+using google_breakpad::DwarfCUCache;
+using google_breakpad::Module;
+using google_breakpad::ReadModuleIdentifier;
+using google_breakpad::ReadSymbolData;
 using google_breakpad::WriteSymbolFile;
+using google_breakpad::scoped_ptr;
 
 int usage(const char* self) {
   fprintf(stderr, "Usage: %s [OPTION] <binary-with-debugging-info> "
-          "[directories-for-debug-file]\n\n", self);
+          "[directories-for-debug-file]\n", self);
+  fprintf(stderr, "       %s [OPTION] -s <symbol-store> "
+          "<binary-or-directory>...\n\n", self);
   fprintf(stderr, "Options:\n");
   fprintf(stderr, "  -c    Do not generate CFI section\n");
   fprintf(stderr, "  -r    Do not handle inter-compilation unit references\n");
+  fprintf(stderr, "  -j <threads>\n"
+                  "        Read DWARF compilation units and call frame\n"
+                  "        information on this many threads\n");
+  fprintf(stderr, "  -m <megabytes>\n"
+                  "        Hold about this much function, line and call\n"
+                  "        frame data in memory, writing the rest to\n"
+                  "        temporary files in $TMPDIR or /tmp\n");
+  fprintf(stderr, "  -u <directory>\n"
+                  "        Keep the functions read from each DWARF\n"
+                  "        compilation unit in this directory, and take\n"
+                  "        those of units unchanged since an earlier dump\n"
+                  "        from it rather than reading them again\n");
+  fprintf(stderr, "  -s <symbol-store>\n"
+                  "        Write the symbols for each binary, and for each ELF\n"
+                  "        file found under each directory, to\n"
+                  "        <symbol-store>/<name>/<id>/<name>.sym, skipping\n"
+                  "        binaries whose symbols are already there\n");
+  fprintf(stderr, "  -d <directory>\n"
+                  "        With -s, search this directory for debug files;\n"
+                  "        may be repeated\n");
+  fprintf(stderr, "  -w <workers>\n"
+                  "        With -s, dump this many binaries at once\n");
   return 1;
 }
 
+namespace {
+
+// Return true if PATH names a regular file beginning with the ELF magic
+// number.
+bool IsElfFile(const string& path) {
+  int fd = open(path.c_str(), O_RDONLY);
+  if (fd < 0)
+    return false;
+  char magic[SELFMAG];
+  ssize_t bytes_read = HANDLE_EINTR(read(fd, magic, SELFMAG));
+  close(fd);
+  return bytes_read == SELFMAG && memcmp(magic, ELFMAG, SELFMAG) == 0;
+}
+
+// Append PATH to BINARIES if it is a file, or every ELF file beneath it if
+// it is a directory. Symbolic links within directories are not followed,
+// so that no binary is dumped twice.
+void FindBinaries(const string& path, bool top_level,
+                  std::vector<string>* binaries) {
+  struct stat st;
+  if ((top_level ? stat(path.c_str(), &st) : lstat(path.c_str(), &st)) != 0) {
+    if (top_level)
+      fprintf(stderr, "%s: %s\n", path.c_str(), strerror(errno));
+    return;
+  }
+  if (S_ISREG(st.st_mode)) {
+    if (top_level || IsElfFile(path))
+      binaries->push_back(path);
+    return;
+  }
+  if (!S_ISDIR(st.st_mode))
+    return;
+
+  DIR* dir = opendir(path.c_str());
+  if (!dir) {
+    fprintf(stderr, "%s: %s\n", path.c_str(), strerror(errno));
+    return;
+  }
+  std::vector<string> entries;
+  struct dirent* entry;
+  while ((entry = readdir(dir)) != NULL) {
+    if (strcmp(entry->d_name, ".") != 0 && strcmp(entry->d_name, "..") != 0)
+      entries.push_back(path + "/" + entry->d_name);
+  }
+  closedir(dir);
+  for (size_t i = 0; i < entries.size(); ++i)
+    FindBinaries(entries[i], false, binaries);
+}
+
+// Create the directory PATH and any missing parents. Return false on
+// failure.
+bool MakeDirectories(const string& path) {
+  size_t slash = 0;
+  while ((slash = path.find('/', slash + 1)) != string::npos) {
+    string parent = path.substr(0, slash);
+    if (mkdir(parent.c_str(), 0777) != 0 && errno != EEXIST)
+      return false;
+  }
+  return mkdir(path.c_str(), 0777) == 0 || errno == EEXIST;
+}
+
+// The state shared by the threads of a batch dump.
+struct BatchDump {
+  const std::vector<string>* binaries;
+  const std::vector<string>* debug_dirs;
+  const DumpOptions* options;
+  string store;
+
+  // Protects the members below it.
+  pthread_mutex_t mutex;
+
+  // The index in binaries of the next binary to dump.
+  size_t next;
+
+  // The number of binaries we failed to dump.
+  int failures;
+};
+
+// Dump the symbols for BINARY into the store. Return false on failure.
+bool DumpToStore(BatchDump* batch, const string& binary, int worker) {
+  string name, id;
+  if (!ReadModuleIdentifier(binary, &name, &id))
+    return false;
+
+  string directory = batch->store + "/" + name + "/" + id;
+  string sym_file = directory + "/" + name + ".sym";
+  struct stat st;
+  if (stat(sym_file.c_str(), &st) == 0) {
+    fprintf(stderr, "%s: symbols already in %s\n",
+            binary.c_str(), sym_file.c_str());
+    return true;
+  }
+
+  Module* module;
+  if (!ReadSymbolData(binary, *batch->debug_dirs, *batch->options, &module))
+    return false;
+  scoped_ptr<Module> module_owner(module);
+
+  if (!MakeDirectories(directory)) {
+    fprintf(stderr, "Failed to create %s: %s\n",
+            directory.c_str(), strerror(errno));
+    return false;
+  }
+
+  // Write to a temporary file and rename it into place, so that a
+  // partially written file is never taken for a finished one.
+  char suffix[32];
+  snprintf(suffix, sizeof(suffix), ".tmp.%d.%d",
+           static_cast<int>(getpid()), worker);
+  string temp_file = sym_file + suffix;
+  bool written;
+  {
+    std::ofstream stream(temp_file.c_str());
+    written = stream && module->Write(stream, batch->options->symbol_data);
+  }
+  if (!written || rename(temp_file.c_str(), sym_file.c_str()) != 0) {
+    fprintf(stderr, "Failed to write %s\n", sym_file.c_str());
+    unlink(temp_file.c_str());
+    return false;
+  }
+  printf("%s\n", sym_file.c_str());
+  return true;
+}
+
+struct BatchWorker {
+  BatchDump* batch;
+  int index;
+};
+
+// A thread's main loop: claim binaries until there are none left.
+void* RunBatchWorker(void* arg) {
+  BatchWorker* worker = static_cast<BatchWorker*>(arg);
+  BatchDump* batch = worker->batch;
+  while (true) {
+    pthread_mutex_lock(&batch->mutex);
+    size_t index = batch->next++;
+    pthread_mutex_unlock(&batch->mutex);
+    if (index >= batch->binaries->size())
+      break;
+
+    const string& binary = (*batch->binaries)[index];
+    if (!DumpToStore(batch, binary, worker->index)) {
+      fprintf(stderr, "Failed to write symbol file for %s.\n",
+              binary.c_str());
+      pthread_mutex_lock(&batch->mutex);
+      ++batch->failures;
+      pthread_mutex_unlock(&batch->mutex);
+    }
+  }
+  return NULL;
+}
+
+// Dump every binary in BINARIES into STORE using NUM_WORKERS threads.
+// Return the number of binaries that couldn't be dumped.
+int DumpBatch(const std::vector<string>& binaries,
+              const std::vector<string>& debug_dirs,
+              const DumpOptions& options,
+              const string& store,
+              int num_workers) {
+  BatchDump batch;
+  batch.binaries = &binaries;
+  batch.debug_dirs = &debug_dirs;
+  batch.options = &options;
+  batch.store = store;
+  pthread_mutex_init(&batch.mutex, NULL);
+  batch.next = 0;
+  batch.failures = 0;
+
+  std::vector<BatchWorker> workers(num_workers);
+  std::vector<pthread_t> threads;
+  for (int i = 0; i < num_workers; ++i) {
+    workers[i].batch = &batch;
+    workers[i].index = i;
+  }
+  // The first worker runs on this thread.
+  for (int i = 1; i < num_workers; ++i) {
+    pthread_t thread;
+    if (pthread_create(&thread, NULL, RunBatchWorker, &workers[i]) != 0)
+      break;
+    threads.push_back(thread);
+  }
+  RunBatchWorker(&workers[0]);
+  for (size_t i = 0; i < threads.size(); ++i)
+    pthread_join(threads[i], NULL);
+
+  pthread_mutex_destroy(&batch.mutex);
+  return batch.failures;
+}
+
+}  // namespace
+
 int main(int argc, char **argv) {
   if (argc < 2)
     return usage(argv[0]);
 
   bool cfi = true;
   bool handle_inter_cu_refs = true;
+  int num_threads = 1;
+  int num_workers = 1;
+  size_t memory_budget = 0;
+  string cu_cache_directory;
+  string store;
+  std::vector<string> debug_dirs;
   int arg_index = 1;
   while (arg_index < argc && strlen(argv[arg_index]) > 0 &&
          argv[arg_index][0] == '-') {
@@ -60,6 +301,37 @@ int main(int argc, char **argv) {
       cfi = false;
     } else if (strcmp("-r", argv[arg_index]) == 0) {
       handle_inter_cu_refs = false;
+    } else if (strcmp("-j", argv[arg_index]) == 0) {
+      if (arg_index + 1 >= argc)
+        return usage(argv[0]);
+      num_threads = atoi(argv[++arg_index]);
+      if (num_threads < 1)
+        return usage(argv[0]);
+    } else if (strcmp("-m", argv[arg_index]) == 0) {
+      if (arg_index + 1 >= argc)
+        return usage(argv[0]);
+      int megabytes = atoi(argv[++arg_index]);
+      if (megabytes < 1)
+        return usage(argv[0]);
+      memory_budget = static_cast<size_t>(megabytes) * 1024 * 1024;
+    } else if (strcmp("-u", argv[arg_index]) == 0) {
+      if (arg_index + 1 >= argc)
+        return usage(argv[0]);
+      cu_cache_directory = argv[++arg_index];
+    } else if (strcmp("-s", argv[arg_index]) == 0) {
+      if (arg_index + 1 >= argc)
+        return usage(argv[0]);
+      store = argv[++arg_index];
+    } else if (strcmp("-d", argv[arg_index]) == 0) {
+      if (arg_index + 1 >= argc)
+        return usage(argv[0]);
+      debug_dirs.push_back(argv[++arg_index]);
+    } else if (strcmp("-w", argv[arg_index]) == 0) {
+      if (arg_index + 1 >= argc)
+        return usage(argv[0]);
+      num_workers = atoi(argv[++arg_index]);
+      if (num_workers < 1)
+        return usage(argv[0]);
     } else {
       return usage(argv[0]);
     }
@@ -68,8 +340,43 @@ int main(int argc, char **argv) {
   if (arg_index == argc)
     return usage(argv[0]);
 
+  SymbolData symbol_data = cfi ? ALL_SYMBOL_DATA : NO_CFI;
+  DumpOptions options(symbol_data, handle_inter_cu_refs);
+  options.num_threads = num_threads;
+  options.memory_budget = memory_budget;
+  const char* temp_directory = getenv("TMPDIR");
+  if (temp_directory && temp_directory[0] != '\0')
+    options.temp_directory = temp_directory;
+  scoped_ptr<DwarfCUCache> dwarf_cu_cache;
+  if (!cu_cache_directory.empty()) {
+    if (!MakeDirectories(cu_cache_directory)) {
+      fprintf(stderr, "Failed to create %s: %s\n",
+              cu_cache_directory.c_str(), strerror(errno));
+      return 1;
+    }
+    dwarf_cu_cache.reset(new DwarfCUCache(cu_cache_directory));
+    options.dwarf_cu_cache = dwarf_cu_cache.get();
+  }
+
+  if (!store.empty()) {
+    std::vector<string> binaries;
+    for (; arg_index < argc; ++arg_index)
+      FindBinaries(argv[arg_index], true, &binaries);
+    DebugDirectoryCache debug_directory_cache;
+    options.debug_directory_cache = &debug_directory_cache;
+    int failures = DumpBatch(binaries, debug_dirs, options, store,
+                             num_workers);
+    if (failures) {
+      fprintf(stderr, "Failed to write %d of %d symbol files.\n",
+              failures, static_cast<int>(binaries.size()));
+      return 1;
+    }
+    return 0;
+  }
+  if (!debug_dirs.empty() || num_workers != 1)
+    return usage(argv[0]);
+
   const char* binary;
-  std::vector<string> debug_dirs;
   binary = argv[arg_index];
   for (int debug_dir_index = arg_index + 1;
        debug_dir_index < argc;
@@ -77,8 +384,6 @@ int main(int argc, char **argv) {
     debug_dirs.push_back(argv[debug_dir_index]);
   }
 
-  SymbolData symbol_data = cfi ? ALL_SYMBOL_DATA : NO_CFI;
-  google_breakpad::DumpOptions options(symbol_data, handle_inter_cu_refs);
   if (!WriteSymbolFile(binary, debug_dirs, options, std::cout)) {
     fprintf(stderr, "Failed to write symbol file.\n");
     return 1;
@@ -0,0 +1,453 @@
+// Copyright (c) 2016 Google Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+// notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above
+// copyright notice, this list of conditions and the following disclaimer
+// in the documentation and/or other materials provided with the
+// distribution.
+//     * Neither the name of Google Inc. nor the names of its
+// contributors may be used to endorse or promote products derived from
+// this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+// dump_syms_benchmark.cc: Measures how long dump_syms takes to read the
+// debugging information in ELF files and write their symbol files.
+//
+// The corpora are:
+//  - "synthetic": an x86-64 ELF file with DWARF built in memory with the
+//    synth_elf and test_assembler classes.  It has a configurable number
+//    of compilation units, each with a number of functions covered by a
+//    line program of the requested length, and .debug_frame CFI for every
+//    function.
+//  - "synthetic-debuglink": a stripped file whose .gnu_debuglink section
+//    names the synthetic file, for timing the search of the debug
+//    directory and the check of the debug file's CRC.
+//  - Any files named on the command line, searched for in the debug
+//    directories given with -d when they have been stripped.
+//
+// Each corpus is dumped with WriteSymbolFile the requested number of
+// times, to an in-memory stream.  The results are written to stdout as
+// tab-separated lines of corpus, metric, median, minimum and maximum, so
+// that they can be compared across versions; times are in milliseconds.
+// The phases are those of DumpStatistics.  The last line gives the peak
+// resident set size of the whole run; benchmark one corpus per run to
+// attribute it.  dump_syms' own messages go to stderr.
+
+#include <assert.h>
+#include <elf.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "common/benchmark_helpers.h"
+#include "common/dwarf/cfi_assembler.h"
+#include "common/dwarf/dwarf2enums.h"
+#include "common/dwarf/dwarf2reader_test_common.h"
+#include "common/linux/crc32.h"
+#include "common/linux/dump_symbols.h"
+#include "common/linux/synth_elf.h"
+#include "common/test_assembler.h"
+#include "common/using_std_string.h"
+
+namespace {
+
+using google_breakpad::CFISection;
+using google_breakpad::DumpOptions;
+using google_breakpad::DumpStatistics;
+using google_breakpad::Milliseconds;
+using google_breakpad::MonotonicNanoseconds;
+using google_breakpad::ParseCount;
+using google_breakpad::PeakResidentSetKilobytes;
+using google_breakpad::Samples;
+using google_breakpad::synth_elf::ELF;
+using google_breakpad::test_assembler::kLittleEndian;
+using google_breakpad::test_assembler::Label;
+using google_breakpad::test_assembler::Section;
+using std::vector;
+
+// Where the synthetic functions live. Each line of a function covers
+// kLineSize bytes of code.
+const uint64_t kTextAddress = 0x400000;
+const uint64_t kLineSize = 4;
+
+struct BenchmarkOptions {
+  BenchmarkOptions()
+      : compilation_units(64),
+        functions_per_unit(64),
+        lines_per_function(16),
+        iterations(10),
+        threads(1),
+        synthetic(true) {}
+
+  unsigned long compilation_units;
+  unsigned long functions_per_unit;
+  unsigned long lines_per_function;
+  unsigned long iterations;
+  unsigned long threads;
+  bool synthetic;
+  vector<string> debug_dirs;
+};
+
+// The address of function |function| of compilation unit |unit|.
+uint64_t FunctionAddress(const BenchmarkOptions &options, unsigned long unit,
+                         unsigned long function) {
+  return kTextAddress +
+      (unit * options.functions_per_unit + function) *
+      options.lines_per_function * kLineSize;
+}
+
+// Appends to |debug_line| the line program for compilation unit |unit|:
+// one row per line, each line of each function one line further down the
+// unit's source file.
+void AppendLineProgram(const BenchmarkOptions &options, unsigned long unit,
+                       Section *debug_line) {
+  Section program(kLittleEndian);
+  program.start() = 0;
+  Label unit_length, header_length, after_length, header_start, header_end,
+      end;
+
+  program.D32(unit_length).Mark(&after_length)
+      .D16(2)                   // version
+      .D32(header_length).Mark(&header_start)
+      .D8(1)                    // minimum_instruction_length
+      .D8(1)                    // default_is_stmt
+      .D8(static_cast<uint8_t>(-5))  // line_base
+      .D8(14)                   // line_range
+      .D8(13);                  // opcode_base
+  const uint8_t kStandardOpcodeLengths[] = {0, 1, 1, 1, 1, 0, 0, 0, 1, 0,
+                                            0, 1};
+  program.Append(kStandardOpcodeLengths, sizeof(kStandardOpcodeLengths));
+  char file_name[32];
+  snprintf(file_name, sizeof(file_name), "unit%lu.cc", unit);
+  program.D8(0)                 // no include_directories
+      .AppendCString(file_name).ULEB128(0).ULEB128(0).ULEB128(0)
+      .D8(0)                    // end of file_names
+      .Mark(&header_end);
+  header_length = header_end - header_start;
+
+  program.D8(0).ULEB128(9).D8(dwarf2reader::DW_LNE_set_address)
+      .D64(FunctionAddress(options, unit, 0));
+  const unsigned long rows =
+      options.functions_per_unit * options.lines_per_function;
+  for (unsigned long row = 0; row < rows; ++row) {
+    program.D8(dwarf2reader::DW_LNS_copy)
+        .D8(dwarf2reader::DW_LNS_advance_pc).ULEB128(kLineSize)
+        .D8(dwarf2reader::DW_LNS_advance_line).LEB128(1);
+  }
+  program.D8(0).ULEB128(1).D8(dwarf2reader::DW_LNE_end_sequence)
+      .Mark(&end);
+  unit_length = end - after_length;
+
+  string contents;
+  program.GetContents(&contents);
+  debug_line->Append(contents);
+}
+
+// Appends to |debug_info| compilation unit |unit|, whose line program is
+// at |stmt_list| in .debug_line.
+void AppendCompilationUnit(const BenchmarkOptions &options,
+                           unsigned long unit, uint64_t stmt_list,
+                           Section *debug_info) {
+  TestCompilationUnit info;
+  info.set_endianness(kLittleEndian);
+  info.set_format_size(4);
+  info.Header(2, Label(0), 8);
+
+  char name[64];
+  snprintf(name, sizeof(name), "unit%lu.cc", unit);
+  info.ULEB128(1).AppendCString(name).AppendCString("/src").D32(stmt_list);
+  for (unsigned long function = 0; function < options.functions_per_unit;
+       ++function) {
+    snprintf(name, sizeof(name), "function_%lu_%lu", unit, function);
+    const uint64_t address = FunctionAddress(options, unit, function);
+    info.ULEB128(2).AppendCString(name)
+        .D64(address)
+        .D64(address + options.lines_per_function * kLineSize);
+  }
+  info.D8(0);                   // end of the unit's children
+  info.Finish();
+
+  string contents;
+  info.GetContents(&contents);
+  debug_info->Append(contents);
+}
+
+// Appends to |debug_frame| an x86-64 prologue's worth of CFI for every
+// synthetic function.
+void AppendCFI(const BenchmarkOptions &options, CFISection *debug_frame) {
+  Label cie;
+  debug_frame->Mark(&cie)
+      .CIEHeader(1, -8, 16)
+      .D8(dwarf2reader::DW_CFA_def_cfa).ULEB128(7).ULEB128(8)
+      .D8(dwarf2reader::DW_CFA_offset | 16).ULEB128(1)
+      .FinishEntry();
+  for (unsigned long unit = 0; unit < options.compilation_units; ++unit) {
+    for (unsigned long function = 0; function < options.functions_per_unit;
+         ++function) {
+      debug_frame->FDEHeader(cie, FunctionAddress(options, unit, function),
+                             options.lines_per_function * kLineSize)
+          .D8(dwarf2reader::DW_CFA_advance_loc | 1)
+          .D8(dwarf2reader::DW_CFA_def_cfa_offset).ULEB128(16)
+          .D8(dwarf2reader::DW_CFA_offset | 6).ULEB128(2)
+          .D8(dwarf2reader::DW_CFA_advance_loc | 3)
+          .D8(dwarf2reader::DW_CFA_def_cfa_register).ULEB128(6)
+          .FinishEntry();
+    }
+  }
+}
+
+// Adds the first page of a .text section to |elf|, enough for
+// dump_syms to compute an identifier from.
+void AddText(ELF *elf) {
+  Section text(kLittleEndian);
+  text.Append(4096, 0x90);
+  elf->AddSection(".text", text, SHT_PROGBITS, SHF_ALLOC | SHF_EXECINSTR,
+                  kTextAddress);
+}
+
+// Sets |contents| to the synthetic ELF file with DWARF.
+bool BuildSyntheticFile(const BenchmarkOptions &options, string *contents) {
+  TestAbbrevTable abbrevs;
+  abbrevs.Abbrev(1, dwarf2reader::DW_TAG_compile_unit,
+                 dwarf2reader::DW_children_yes)
+      .Attribute(dwarf2reader::DW_AT_name, dwarf2reader::DW_FORM_string)
+      .Attribute(dwarf2reader::DW_AT_comp_dir, dwarf2reader::DW_FORM_string)
+      .Attribute(dwarf2reader::DW_AT_stmt_list, dwarf2reader::DW_FORM_data4)
+      .EndAbbrev()
+      .Abbrev(2, dwarf2reader::DW_TAG_subprogram,
+              dwarf2reader::DW_children_no)
+      .Attribute(dwarf2reader::DW_AT_name, dwarf2reader::DW_FORM_string)
+      .Attribute(dwarf2reader::DW_AT_low_pc, dwarf2reader::DW_FORM_addr)
+      .Attribute(dwarf2reader::DW_AT_high_pc, dwarf2reader::DW_FORM_addr)
+      .EndAbbrev()
+      .EndTable();
+
+  Section debug_info(kLittleEndian);
+  Section debug_line(kLittleEndian);
+  for (unsigned long unit = 0; unit < options.compilation_units; ++unit) {
+    AppendCompilationUnit(options, unit, debug_line.Size(), &debug_info);
+    AppendLineProgram(options, unit, &debug_line);
+  }
+  CFISection debug_frame(kLittleEndian, 8);
+  AppendCFI(options, &debug_frame);
+
+  ELF elf(EM_X86_64, ELFCLASS64, kLittleEndian);
+  AddText(&elf);
+  elf.AddSection(".debug_abbrev", abbrevs, SHT_PROGBITS);
+  elf.AddSection(".debug_info", debug_info, SHT_PROGBITS);
+  elf.AddSection(".debug_line", debug_line, SHT_PROGBITS);
+  elf.AddSection(".debug_frame", debug_frame, SHT_PROGBITS);
+  elf.Finish();
+  return elf.GetContents(contents);
+}
+
+// Sets |contents| to a stripped ELF file whose .gnu_debuglink section
+// names |debug_file|, whose contents are |debug_contents|.
+bool BuildDebugLinkFile(const string &debug_file,
+                        const string &debug_contents, string *contents) {
+  Section debuglink(kLittleEndian);
+  debuglink.AppendCString(debug_file).Align(4)
+      .D32(google_breakpad::ComputeCrc32(debug_contents));
+
+  ELF elf(EM_X86_64, ELFCLASS64, kLittleEndian);
+  AddText(&elf);
+  elf.AddSection(".gnu_debuglink", debuglink, SHT_PROGBITS);
+  elf.Finish();
+  return elf.GetContents(contents);
+}
+
+bool WriteWholeFile(const string &path, const string &contents) {
+  std::ofstream file(path.c_str(), std::ios::out | std::ios::binary);
+  file.write(contents.data(), contents.size());
+  file.close();
+  if (!file) {
+    fprintf(stderr, "Couldn't write %s\n", path.c_str());
+    return false;
+  }
+  return true;
+}
+
+void PrintMetric(const string &corpus, const char *metric,
+                 Samples *samples) {
+  printf("%s\t%s\t%.3f\t%.3f\t%.3f\n", corpus.c_str(), metric,
+         samples->Median(), samples->Min(), samples->Max());
+}
+
+// Dumps |path| |options.iterations| times and prints the results under
+// the name |corpus|.  Returns false if dump_syms fails.
+bool BenchmarkCorpus(const BenchmarkOptions &options, const string &corpus,
+                     const string &path,
+                     const vector<string> &debug_dirs) {
+  Samples total, load, identifier, debuglink, inflate, debug_info, lines,
+      cfi, symbol_table, write, units, size;
+  for (unsigned long i = 0; i < options.iterations; ++i) {
+    DumpStatistics statistics;
+    DumpOptions dump_options(ALL_SYMBOL_DATA, true);
+    dump_options.num_threads = options.threads;
+    dump_options.statistics = &statistics;
+    std::ostringstream symbols;
+
+    const uint64_t start = MonotonicNanoseconds();
+    if (!google_breakpad::WriteSymbolFile(path, debug_dirs, dump_options,
+                                          symbols)) {
+      fprintf(stderr, "Failed to dump %s\n", path.c_str());
+      return false;
+    }
+    total.Add(Milliseconds(MonotonicNanoseconds() - start));
+    load.Add(Milliseconds(statistics.load_ns));
+    identifier.Add(Milliseconds(statistics.identifier_ns));
+    debuglink.Add(Milliseconds(statistics.debuglink_ns));
+    inflate.Add(Milliseconds(statistics.inflate_ns));
+    debug_info.Add(Milliseconds(statistics.debug_info_ns));
+    lines.Add(Milliseconds(statistics.lines_ns));
+    cfi.Add(Milliseconds(statistics.cfi_ns));
+    symbol_table.Add(Milliseconds(statistics.symbol_table_ns));
+    write.Add(Milliseconds(statistics.write_ns));
+    units.Add(statistics.compilation_units);
+    size.Add(symbols.str().size());
+  }
+
+  PrintMetric(corpus, "total_ms", &total);
+  PrintMetric(corpus, "load_ms", &load);
+  PrintMetric(corpus, "identifier_ms", &identifier);
+  PrintMetric(corpus, "debuglink_ms", &debuglink);
+  PrintMetric(corpus, "inflate_ms", &inflate);
+  PrintMetric(corpus, "debug_info_ms", &debug_info);
+  PrintMetric(corpus, "lines_ms", &lines);
+  PrintMetric(corpus, "cfi_ms", &cfi);
+  PrintMetric(corpus, "symbol_table_ms", &symbol_table);
+  PrintMetric(corpus, "write_ms", &write);
+  PrintMetric(corpus, "compilation_units", &units);
+  PrintMetric(corpus, "symbol_file_bytes", &size);
+  return true;
+}
+
+// Builds the synthetic corpora in a temporary directory and benchmarks
+// them.
+bool BenchmarkSynthetic(const BenchmarkOptions &options) {
+  string debug_contents, stripped_contents;
+  if (!BuildSyntheticFile(options, &debug_contents) ||
+      !BuildDebugLinkFile("synthetic.debug", debug_contents,
+                          &stripped_contents)) {
+    fprintf(stderr, "Couldn't build the synthetic ELF files\n");
+    return false;
+  }
+
+  char directory[] = "/tmp/dump_syms_benchmark.XXXXXX";
+  if (!mkdtemp(directory)) {
+    perror("mkdtemp");
+    return false;
+  }
+  const string debug_path = string(directory) + "/synthetic.debug";
+  const string stripped_path = string(directory) + "/synthetic";
+  vector<string> debug_dirs(1, directory);
+  const bool succeeded =
+      WriteWholeFile(debug_path, debug_contents) &&
+      WriteWholeFile(stripped_path, stripped_contents) &&
+      BenchmarkCorpus(options, "synthetic", debug_path, vector<string>()) &&
+      BenchmarkCorpus(options, "synthetic-debuglink", stripped_path,
+                      debug_dirs);
+  unlink(debug_path.c_str());
+  unlink(stripped_path.c_str());
+  rmdir(directory);
+  return succeeded;
+}
+
+void usage(const char *program_name) {
+  BenchmarkOptions defaults;
+  fprintf(stderr, "usage: %s [-u units] [-f functions] [-l lines] "
+          "[-n iterations]\n"
+          "          [-j threads] [-d debug-dir]... [-S] [binary]...\n"
+          "    -u : Compilation units in the synthetic file (default %lu)\n"
+          "    -f : Functions in each unit (default %lu)\n"
+          "    -l : Lines in each function (default %lu)\n"
+          "    -n : Number of times each corpus is dumped (default %lu)\n"
+          "    -j : Threads dump_syms reads DWARF and CFI with "
+          "(default %lu)\n"
+          "    -d : Debug directory for the binaries named\n"
+          "    -S : Skip the synthetic corpora\n",
+          program_name, defaults.compilation_units,
+          defaults.functions_per_unit, defaults.lines_per_function,
+          defaults.iterations, defaults.threads);
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+  BenchmarkOptions options;
+  int ch;
+  while ((ch = getopt(argc, argv, "hu:f:l:n:j:d:S")) != -1) {
+    bool valid = true;
+    switch (ch) {
+      case 'u':
+        valid = ParseCount('u', optarg, 1, 1000000,
+                           &options.compilation_units);
+        break;
+      case 'f':
+        valid = ParseCount('f', optarg, 1, 1000000,
+                           &options.functions_per_unit);
+        break;
+      case 'l':
+        valid = ParseCount('l', optarg, 1, 1000000,
+                           &options.lines_per_function);
+        break;
+      case 'n':
+        valid = ParseCount('n', optarg, 1, 1000000, &options.iterations);
+        break;
+      case 'j':
+        valid = ParseCount('j', optarg, 1, 1024, &options.threads);
+        break;
+      case 'd':
+        options.debug_dirs.push_back(optarg);
+        break;
+      case 'S':
+        options.synthetic = false;
+        break;
+      default:
+        valid = false;
+        break;
+    }
+    if (!valid) {
+      usage(argv[0]);
+      return 1;
+    }
+  }
+  if (!options.synthetic && optind == argc) {
+    usage(argv[0]);
+    return 1;
+  }
+
+  printf("# corpus\tmetric\tmedian\tmin\tmax\n");
+  if (options.synthetic && !BenchmarkSynthetic(options))
+    return 1;
+  for (int i = optind; i < argc; ++i) {
+    if (!BenchmarkCorpus(options, argv[i], argv[i], options.debug_dirs))
+      return 1;
+  }
+  const double peak = PeakResidentSetKilobytes();
+  printf("all\tpeak_rss_kb\t%.0f\t%.0f\t%.0f\n", peak, peak, peak);
+  return 0;
+}
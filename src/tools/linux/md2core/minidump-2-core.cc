@@ -36,10 +36,12 @@
 #include <elf.h>
 #include <errno.h>
 #include <inttypes.h>
+#include <limits.h>
 #include <link.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/uio.h>
 #include <sys/user.h>
 #include <unistd.h>
 
@@ -49,7 +51,6 @@
 
 #include "common/linux/memory_mapped_file.h"
 #include "common/minidump_type_helper.h"
-#include "common/scoped_ptr.h"
 #include "google_breakpad/common/minidump_format.h"
 #include "third_party/lss/linux_syscall_support.h"
 #include "tools/linux/md2core/minidump_memory_range.h"
@@ -124,6 +125,33 @@ writea(int fd, const void* idata, size_t length) {
   return true;
 }
 
+// Write all of the given buffers, handling short writes and EINTR. The
+// entries of |iov| are updated as data is written. Return true iff successful.
+static bool
+writeva(int fd, struct iovec* iov, size_t count) {
+  while (count) {
+    ssize_t r;
+    do {
+      r = writev(fd, iov, count < IOV_MAX ? count : IOV_MAX);
+    } while (r == -1 && errno == EINTR);
+
+    if (r < 1)
+      return false;
+    size_t done = r;
+    while (count && done >= iov->iov_len) {
+      done -= iov->iov_len;
+      ++iov;
+      --count;
+    }
+    if (done) {
+      iov->iov_base = (uint8_t*)iov->iov_base + done;
+      iov->iov_len -= done;
+    }
+  }
+
+  return true;
+}
+
 /* Dynamically determines the byte sex of the system. Returns non-zero
  * for big-endian machines.
  */
@@ -197,13 +225,26 @@ struct CrashedProcess {
       : permissions(0xFFFFFFFF),
         start_address(0),
         end_address(0),
-        offset(0) {
+        offset(0),
+        data(NULL),
+        data_offset(0),
+        data_length(0) {
+    }
+
+    // Size of the mapping's contents in the core file: |data_offset| zero
+    // bytes, then the |data_length| bytes at |data|, then zeros up to the
+    // next page boundary.
+    size_t file_size() const {
+      return (data_offset + data_length + 4095) & ~4095;
     }
 
     uint32_t permissions;
     uint64_t start_address, end_address, offset;
     std::string filename;
-    std::string data;
+    // Points into the memory mapped dump or into a buffer owned by
+    // CrashedProcess, so that memory contents are never copied.
+    const uint8_t* data;
+    size_t data_offset, data_length;
   };
   std::map<uint64_t, Mapping> mappings;
 
@@ -233,6 +274,7 @@ struct CrashedProcess {
   std::map<uintptr_t, std::string> signatures;
 
   std::string dynamic_data;
+  std::string link_map_data;
   MDRawDebug debug;
   std::vector<MDRawLinkMap> link_map;
 };
@@ -853,8 +895,8 @@ ParseModuleStream(CrashedProcess* crashinfo, const MinidumpMemoryRange& range,
 }
 
 static void
-AddDataToMapping(CrashedProcess* crashinfo, const std::string& data,
-                 uintptr_t addr) {
+AddDataToMapping(CrashedProcess* crashinfo, const uint8_t* data,
+                 size_t length, uintptr_t addr) {
   for (std::map<uint64_t, CrashedProcess::Mapping>::iterator
          iter = crashinfo->mappings.begin();
        iter != crashinfo->mappings.end();
@@ -884,8 +926,9 @@ AddDataToMapping(CrashedProcess* crashinfo, const std::string& data,
       // file. But it is OK if the mapping itself extends past the end of
       // the data.
       mapping.start_address = addr & ~4095;
-      mapping.data.assign(addr & 4095, 0).append(data);
-      mapping.data.append(-mapping.data.size() & 4095, 0);
+      mapping.data = data;
+      mapping.data_offset = addr & 4095;
+      mapping.data_length = length;
       crashinfo->mappings[mapping.start_address] = mapping;
       return;
     }
@@ -895,9 +938,10 @@ AddDataToMapping(CrashedProcess* crashinfo, const std::string& data,
   mapping.permissions = PF_R | PF_W;
   mapping.start_address = addr & ~4095;
   mapping.end_address =
-    (addr + data.size() + 4095) & ~4095;
-  mapping.data.assign(addr & 4095, 0).append(data);
-  mapping.data.append(-mapping.data.size() & 4095, 0);
+    (addr + length + 4095) & ~4095;
+  mapping.data = data;
+  mapping.data_offset = addr & 4095;
+  mapping.data_length = length;
   crashinfo->mappings[mapping.start_address] = mapping;
 }
 
@@ -908,8 +952,7 @@ AugmentMappings(CrashedProcess* crashinfo,
   // Then adjust the mapping to include the stack dump.
   for (unsigned i = 0; i < crashinfo->threads.size(); ++i) {
     const CrashedProcess::Thread& thread = crashinfo->threads[i];
-    AddDataToMapping(crashinfo,
-                     std::string((char *)thread.stack, thread.stack_length),
+    AddDataToMapping(crashinfo, thread.stack, thread.stack_length,
                      thread.stack_addr);
   }
 
@@ -917,7 +960,7 @@ AugmentMappings(CrashedProcess* crashinfo,
   // the beginning of the address space, as this area should always be
   // available.
   static const uintptr_t start_addr = 4096;
-  std::string data;
+  std::string& data = crashinfo->link_map_data;
   struct r_debug debug = { 0 };
   debug.r_version = crashinfo->debug.version;
   debug.r_brk = (ElfW(Addr))crashinfo->debug.brk;
@@ -958,7 +1001,8 @@ AugmentMappings(CrashedProcess* crashinfo,
     data.append(filename);
     data.append(8 - (filename.size() & 7), 0);
   }
-  AddDataToMapping(crashinfo, data, start_addr);
+  AddDataToMapping(crashinfo, (const uint8_t*)data.data(), data.size(),
+                   start_addr);
 
   // Map the page containing the _DYNAMIC array
   if (!crashinfo->dynamic_data.empty()) {
@@ -984,7 +1028,9 @@ AugmentMappings(CrashedProcess* crashinfo,
         goto no_dt_debug;
       }
     }
-    AddDataToMapping(crashinfo, crashinfo->dynamic_data,
+    AddDataToMapping(crashinfo,
+                     (const uint8_t*)crashinfo->dynamic_data.data(),
+                     crashinfo->dynamic_data.size(),
                      (uintptr_t)crashinfo->debug.dynamic);
   }
 }
@@ -1168,10 +1214,10 @@ main(int argc, char** argv) {
     }
     phdr.p_vaddr = mapping.start_address;
     phdr.p_memsz = mapping.end_address - mapping.start_address;
-    if (mapping.data.size()) {
+    if (mapping.file_size()) {
       offset += filesz;
-      filesz = mapping.data.size();
-      phdr.p_filesz = mapping.data.size();
+      filesz = mapping.file_size();
+      phdr.p_filesz = filesz;
       phdr.p_offset = offset;
     } else {
       phdr.p_filesz = 0;
@@ -1212,22 +1258,38 @@ main(int argc, char** argv) {
       WriteThread(crashinfo.threads[i], 0);
   }
 
+  // The layout of the memory segments is already fixed by the program
+  // headers, so gather the padding and the memory contents straight from the
+  // mapped dump and hand them to the kernel in as few writes as possible.
+  // Every run of padding is shorter than a page.
+  static const uint8_t zeros[4096] = { 0 };
+  std::vector<struct iovec> iov;
+  iov.reserve(1 + 3 * crashinfo.mappings.size());
   if (note_align) {
-    google_breakpad::scoped_array<char> scratch(new char[note_align]);
-    memset(scratch.get(), 0, note_align);
-    if (!writea(1, scratch.get(), note_align))
-      return 1;
+    struct iovec pad = { (void*)zeros, note_align };
+    iov.push_back(pad);
   }
-
   for (std::map<uint64_t, CrashedProcess::Mapping>::const_iterator iter =
          crashinfo.mappings.begin();
        iter != crashinfo.mappings.end(); ++iter) {
     const CrashedProcess::Mapping& mapping = iter->second;
-    if (mapping.data.size()) {
-      if (!writea(1, mapping.data.c_str(), mapping.data.size()))
-        return 1;
+    if (mapping.data_offset) {
+      struct iovec lead = { (void*)zeros, mapping.data_offset };
+      iov.push_back(lead);
+    }
+    if (mapping.data_length) {
+      struct iovec contents = { (void*)mapping.data, mapping.data_length };
+      iov.push_back(contents);
+    }
+    size_t trail = mapping.file_size() - mapping.data_offset -
+                   mapping.data_length;
+    if (trail) {
+      struct iovec pad = { (void*)zeros, trail };
+      iov.push_back(pad);
     }
   }
+  if (!iov.empty() && !writeva(1, &iov[0], iov.size()))
+    return 1;
 
   return 0;
 }
@@ -0,0 +1,152 @@
+// Copyright (c) 2016 Google Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+// notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above
+// copyright notice, this list of conditions and the following disclaimer
+// in the documentation and/or other materials provided with the
+// distribution.
+//     * Neither the name of Google Inc. nor the names of its
+// contributors may be used to endorse or promote products derived from
+// this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+// minidump_spooler.cc: Upload the minidumps left in a spool directory to
+// a HTTP server, as they appear.  Each upload is sent as a
+// multipart/form-data POST request with the following parameters:
+//  prod: the product name
+//  ver: the product version
+//  upload_file_minidump: the minidump
+// Duplicate crashes are dropped, and uploads are batched and rate limited;
+// see common/linux/crash_report_spooler.h.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <string>
+
+#include "common/linux/crash_report_spooler.h"
+#include "common/using_std_string.h"
+
+using google_breakpad::CrashReportSpooler;
+
+//=============================================================================
+static void
+Usage(int argc, const char *argv[]) {
+  fprintf(stderr, "Upload the minidumps in a spool directory.\n");
+  fprintf(stderr, "Usage: %s [options...] -p <product> -v <version> "
+          "<spool-directory> <upload-URL>\n", argv[0]);
+  fprintf(stderr, "Options:\n");
+  fprintf(stderr, "<spool-directory> is where *.dmp files are left\n");
+  fprintf(stderr, "<upload-URL> is the destination for the uploads\n");
+
+  fprintf(stderr, "-p:\t <product> Product name\n");
+  fprintf(stderr, "-v:\t <version> Product version\n");
+  fprintf(stderr, "-x:\t <host[:port]> Use HTTP proxy on given port\n");
+  fprintf(stderr, "-u:\t <user[:password]> Set proxy user and password\n");
+  fprintf(stderr, "-b:\t <count> Dumps per batch (default 4)\n");
+  fprintf(stderr, "-i:\t <seconds> Time between batches (default 10)\n");
+  fprintf(stderr, "-d:\t <seconds> Drop repeats of a crash uploaded within "
+          "this time (default 3600)\n");
+  fprintf(stderr, "-z:\t Compress uploads with gzip\n");
+  fprintf(stderr, "-1:\t Upload one batch and exit\n");
+  fprintf(stderr, "-h:\t Usage\n");
+  fprintf(stderr, "-?:\t Usage\n");
+}
+
+//=============================================================================
+int main(int argc, const char *argv[]) {
+  CrashReportSpooler::Options options;
+  bool once = false;
+  extern int optind;
+  int ch;
+
+  while ((ch = getopt(argc, (char * const *)argv, "b:d:i:p:u:v:x:z1h?")) !=
+         -1) {
+    switch (ch) {
+      case 'b':
+        options.max_batch = atoi(optarg);
+        break;
+      case 'd':
+        options.dedupe_seconds = atoi(optarg);
+        break;
+      case 'i':
+        options.batch_interval_seconds = atoi(optarg);
+        break;
+      case 'p':
+        options.parameters["prod"] = optarg;
+        break;
+      case 'u':
+        options.proxy_user_pwd = optarg;
+        break;
+      case 'v':
+        options.parameters["ver"] = optarg;
+        break;
+      case 'x':
+        options.proxy = optarg;
+        break;
+      case 'z':
+        options.compress = true;
+        break;
+      case '1':
+        once = true;
+        break;
+
+      default:
+        Usage(argc, argv);
+        return 1;
+    }
+  }
+
+  if ((argc - optind) != 2) {
+    fprintf(stderr, "%s: Missing spool directory and/or upload-URL\n",
+            argv[0]);
+    Usage(argc, argv);
+    return 1;
+  }
+  options.spool_directory = argv[optind];
+  options.url = argv[optind + 1];
+
+  CrashReportSpooler spooler(options);
+  string error;
+  if (!spooler.Init(&error)) {
+    fprintf(stderr, "Failed to load libcurl: %s\n", error.c_str());
+    return 1;
+  }
+
+  while (true) {
+    int uploaded = spooler.uploaded();
+    int failures = spooler.failures();
+    int wait = spooler.RunOnce(time(NULL));
+    if (spooler.uploaded() != uploaded || spooler.failures() != failures) {
+      printf("Uploaded %d, dropped %d duplicates, %d rejected, "
+             "%d failed attempts\n",
+             spooler.uploaded(), spooler.duplicates(), spooler.rejected(),
+             spooler.failures());
+      fflush(stdout);
+    }
+    if (once)
+      break;
+    sleep(wait);
+  }
+  return spooler.failures() ? 1 : 0;
+}
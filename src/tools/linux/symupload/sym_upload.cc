@@ -27,8 +27,8 @@
 // (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
 // OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
-// symupload.cc: Upload a symbol file to a HTTP server.  The upload is sent as
-// a multipart/form-data POST request with the following parameters:
+// symupload.cc: Upload symbol files to a HTTP server.  Each upload is sent
+// as a multipart/form-data POST request with the following parameters:
 //  code_file: the basename of the module, e.g. "app"
 //  debug_file: the basename of the debugging file, e.g. "app"
 //  debug_identifier: the debug file's identifier, usually consisting of
@@ -38,6 +38,12 @@
 //  os: the operating system that the module was built for
 //  cpu: the CPU that the module was built for
 //  symbol_file: the contents of the breakpad-format symbol file
+//
+// Several symbol files can be given at once.  They are sent concurrently
+// over reused connections, and each (debug_file, debug_identifier) is sent
+// only once.  With -c, a HEAD request for each symbol file's path in a
+// symbol store (<debug_file>/<debug_identifier>/<debug_file>.sym) is made
+// first, and files the server already has are not uploaded.
 
 #include <assert.h>
 #include <stdio.h>
@@ -46,20 +52,24 @@
 
 #include <functional>
 #include <iostream>
+#include <set>
 #include <string>
 #include <vector>
 
 #include "common/linux/http_upload.h"
 #include "common/using_std_string.h"
 
-using google_breakpad::HTTPUpload;
+using google_breakpad::HTTPUploadSession;
 
 typedef struct {
-  string symbolsPath;
+  std::vector<string> symbolsPaths;
   string uploadURLStr;
+  string checkURLStr;
   string proxy;
   string proxy_user_pwd;
   string version;
+  int max_concurrent;
+  bool compress;
   bool success;
 } Options;
 
@@ -116,70 +126,170 @@ static string CompactIdentifier(const string &uuid) {
   return result;
 }
 
+//=============================================================================
+// Returns the URL of a symbol file under |base_url| in the layout that
+// SimpleSymbolSupplier reads: <debug_file>/<debug_identifier>/<name>.sym,
+// where <name> is debug_file without a trailing ".pdb".
+static string SymbolStoreURL(const string &base_url,
+                             const string &debug_file,
+                             const string &debug_identifier) {
+  string url = base_url;
+  if (url.empty() || url[url.size() - 1] != '/')
+    url += '/';
+  string name = debug_file;
+  if (name.size() > 4 && name.compare(name.size() - 4, 4, ".pdb") == 0)
+    name.resize(name.size() - 4);
+  return url + debug_file + "/" + debug_identifier + "/" + name + ".sym";
+}
+
+//=============================================================================
+// Prints the outcome of uploading a symbol file.  |prefix| is put before
+// each message when several files are being uploaded.
+static void ReportUpload(const string &prefix,
+                         const HTTPUploadSession::Request &request) {
+  const char *p = prefix.c_str();
+  if (!request.success) {
+    printf("%sFailed to send symbol file: %s\n", p,
+           request.error_description.c_str());
+    printf("%sResponse code: %ld\n", p, request.response_code);
+    printf("%sResponse:\n", p);
+    printf("%s\n", request.response_body.c_str());
+  } else if (request.response_code == 0) {
+    printf("%sFailed to send symbol file: No response code\n", p);
+  } else if (request.response_code != 200) {
+    printf("%sFailed to send symbol file: Response code %ld\n", p,
+           request.response_code);
+    printf("%sResponse:\n", p);
+    printf("%s\n", request.response_body.c_str());
+  } else {
+    printf("%sSuccessfully sent the symbol file.\n", p);
+  }
+}
+
 //=============================================================================
 static void Start(Options *options) {
-  std::map<string, string> parameters;
-  options->success = false;
-  std::vector<string> module_parts;
-  if (!ModuleDataForSymbolFile(options->symbolsPath, &module_parts)) {
-    fprintf(stderr, "Failed to parse symbol file!\n");
-    return;
+  options->success = true;
+  bool several = options->symbolsPaths.size() > 1;
+
+  // Read the module line of every symbol file, keeping the first file
+  // for each (debug_file, debug_identifier).
+  std::vector<HTTPUploadSession::Request> uploads;
+  std::vector<string> debug_files, debug_identifiers;
+  std::set<string> seen;
+  int failed = 0;
+  for (size_t i = 0; i < options->symbolsPaths.size(); ++i) {
+    const string &path = options->symbolsPaths[i];
+    std::vector<string> module_parts;
+    if (!ModuleDataForSymbolFile(path, &module_parts)) {
+      if (several)
+        fprintf(stderr, "%s: Failed to parse symbol file!\n", path.c_str());
+      else
+        fprintf(stderr, "Failed to parse symbol file!\n");
+      options->success = false;
+      ++failed;
+      continue;
+    }
+
+    string compacted_id = CompactIdentifier(module_parts[3]);
+    if (!seen.insert(module_parts[4] + "/" + compacted_id).second)
+      continue;
+
+    HTTPUploadSession::Request request;
+    request.url = options->uploadURLStr;
+    request.upload_file = path;
+    request.file_part_name = "symbol_file";
+
+    // Add parameters
+    if (!options->version.empty())
+      request.parameters["version"] = options->version;
+
+    // MODULE <os> <cpu> <uuid> <module-name>
+    // 0      1    2     3      4
+    request.parameters["os"] = module_parts[1];
+    request.parameters["cpu"] = module_parts[2];
+    request.parameters["debug_file"] = module_parts[4];
+    request.parameters["code_file"] = module_parts[4];
+    request.parameters["debug_identifier"] = compacted_id;
+    uploads.push_back(request);
+    debug_files.push_back(module_parts[4]);
+    debug_identifiers.push_back(compacted_id);
   }
+  if (uploads.empty())
+    return;
 
-  string compacted_id = CompactIdentifier(module_parts[3]);
-
-  // Add parameters
-  if (!options->version.empty())
-    parameters["version"] = options->version;
-
-  // MODULE <os> <cpu> <uuid> <module-name>
-  // 0      1    2     3      4
-  parameters["os"] = module_parts[1];
-  parameters["cpu"] = module_parts[2];
-  parameters["debug_file"] = module_parts[4];
-  parameters["code_file"] = module_parts[4];
-  parameters["debug_identifier"] = compacted_id;
-  string response, error;
-  long response_code;
-  bool success = HTTPUpload::SendRequest(options->uploadURLStr,
-                                         parameters,
-                                         options->symbolsPath,
-                                         "symbol_file",
-                                         options->proxy,
-                                         options->proxy_user_pwd,
-                                         "",
-                                         &response,
-                                         &response_code,
-                                         &error);
-
-  if (!success) {
+  HTTPUploadSession session;
+  string error;
+  if (!session.Init(&error)) {
     printf("Failed to send symbol file: %s\n", error.c_str());
-    printf("Response code: %ld\n", response_code);
-    printf("Response:\n");
-    printf("%s\n", response.c_str());
-  } else if (response_code == 0) {
-    printf("Failed to send symbol file: No response code\n");
-  } else if (response_code != 200) {
-    printf("Failed to send symbol file: Response code %ld\n", response_code);
-    printf("Response:\n");
-    printf("%s\n", response.c_str());
-  } else {
-    printf("Successfully sent the symbol file.\n");
+    options->success = false;
+    return;
+  }
+  session.set_proxy(options->proxy, options->proxy_user_pwd);
+  session.set_compress(options->compress);
+
+  // Drop the files that the server already has.  If a check fails, the
+  // file is uploaded anyway.
+  int present = 0;
+  if (!options->checkURLStr.empty()) {
+    std::vector<HTTPUploadSession::Request> checks(uploads.size());
+    for (size_t i = 0; i < checks.size(); ++i) {
+      checks[i].url = SymbolStoreURL(options->checkURLStr, debug_files[i],
+                                     debug_identifiers[i]);
+      checks[i].head_only = true;
+    }
+    session.SendRequests(&checks, options->max_concurrent);
+
+    std::vector<HTTPUploadSession::Request> missing;
+    for (size_t i = 0; i < checks.size(); ++i) {
+      if (checks[i].success && checks[i].response_code == 200) {
+        if (several) {
+          printf("%s: Already present on the server.\n",
+                 uploads[i].upload_file.c_str());
+        } else {
+          printf("The symbol file is already present on the server.\n");
+        }
+        ++present;
+      } else {
+        missing.push_back(uploads[i]);
+      }
+    }
+    uploads.swap(missing);
+  }
+
+  if (!session.SendRequests(&uploads, options->max_concurrent))
+    options->success = false;
+
+  int sent = 0;
+  for (size_t i = 0; i < uploads.size(); ++i) {
+    ReportUpload(several ? uploads[i].upload_file + ": " : "", uploads[i]);
+    if (uploads[i].success && uploads[i].response_code == 200)
+      ++sent;
+    else
+      ++failed;
+  }
+  if (several) {
+    printf("Sent %d symbol files, %d already present, %d failed.\n",
+           sent, present, failed);
   }
-  options->success = success;
 }
 
 //=============================================================================
 static void
 Usage(int argc, const char *argv[]) {
   fprintf(stderr, "Submit symbol information.\n");
-  fprintf(stderr, "Usage: %s [options...] <symbols> <upload-URL>\n", argv[0]);
+  fprintf(stderr, "Usage: %s [options...] <symbols>... <upload-URL>\n",
+          argv[0]);
   fprintf(stderr, "Options:\n");
   fprintf(stderr, "<symbols> should be created by using the dump_syms tool.\n");
   fprintf(stderr, "<upload-URL> is the destination for the upload\n");
   fprintf(stderr, "-v:\t Version information (e.g., 1.2.3.4)\n");
   fprintf(stderr, "-x:\t <host[:port]> Use HTTP proxy on given port\n");
   fprintf(stderr, "-u:\t <user[:password]> Set proxy user and password\n");
+  fprintf(stderr, "-c:\t <URL> Skip symbol files present under this symbol "
+                  "store URL\n");
+  fprintf(stderr, "-j:\t <count> Send up to this many requests at once "
+                  "(default 8)\n");
+  fprintf(stderr, "-z:\t Compress the uploads with gzip\n");
   fprintf(stderr, "-h:\t Usage\n");
   fprintf(stderr, "-?:\t Usage\n");
 }
@@ -190,8 +300,16 @@ SetupOptions(int argc, const char *argv[], Options *options) {
   extern int optind;
   int ch;
 
-  while ((ch = getopt(argc, (char * const *)argv, "u:v:x:h?")) != -1) {
+  options->max_concurrent = 8;
+  options->compress = false;
+  while ((ch = getopt(argc, (char * const *)argv, "c:j:u:v:x:zh?")) != -1) {
     switch (ch) {
+      case 'c':
+        options->checkURLStr = optarg;
+        break;
+      case 'j':
+        options->max_concurrent = atoi(optarg);
+        break;
       case 'u':
         options->proxy_user_pwd = optarg;
         break;
@@ -201,6 +319,9 @@ SetupOptions(int argc, const char *argv[], Options *options) {
       case 'x':
         options->proxy = optarg;
         break;
+      case 'z':
+        options->compress = true;
+        break;
 
       default:
         fprintf(stderr, "Invalid option '%c'\n", ch);
@@ -210,14 +331,14 @@ SetupOptions(int argc, const char *argv[], Options *options) {
     }
   }
 
-  if ((argc - optind) != 2) {
+  if ((argc - optind) < 2) {
     fprintf(stderr, "%s: Missing symbols file and/or upload-URL\n", argv[0]);
     Usage(argc, argv);
     exit(1);
   }
 
-  options->symbolsPath = argv[optind];
-  options->uploadURLStr = argv[optind + 1];
+  options->symbolsPaths.assign(argv + optind, argv + argc - 1);
+  options->uploadURLStr = argv[argc - 1];
 }
 
 //=============================================================================
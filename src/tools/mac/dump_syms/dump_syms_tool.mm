@@ -35,7 +35,9 @@
 #include <mach-o/arch.h>
 #include <unistd.h>
 
+#include <fstream>
 #include <iostream>
+#include <string>
 #include <vector>
 
 #include "common/mac/dump_syms.h"
@@ -46,14 +48,17 @@
 using google_breakpad::DumpSymbols;
 using google_breakpad::Module;
 using google_breakpad::scoped_ptr;
+using std::string;
 using std::vector;
 
 struct Options {
   Options()
-      : srcPath(), dsymPath(), arch(), cfi(true), handle_inter_cu_refs(true) {}
+      : srcPath(), dsymPath(), arch(), outputPrefix(), cfi(true),
+        handle_inter_cu_refs(true) {}
   NSString *srcPath;
   NSString *dsymPath;
   const NXArchInfo *arch;
+  const char *outputPrefix;
   bool cfi;
   bool handle_inter_cu_refs;
 };
@@ -102,6 +107,82 @@ static void CopyCFIDataBetweenModules(Module* to_module,
   }
 }
 
+// Return true if |a| and |b| were read from the same debug code file.
+static bool ModulesMatch(const Module* a, const Module* b) {
+  return a->name() == b->name() && a->os() == b->os() &&
+      a->architecture() == b->architecture() &&
+      a->identifier() == b->identifier();
+}
+
+// Dump every architecture in the file |dump_symbols| has read, writing each
+// to <options.outputPrefix>_<architecture>.sym. The architectures are read
+// concurrently, from one mapping of the file. If |split_module| is true,
+// the file is a dSYM, and CFI data is added from options.srcPath as Start
+// does for a single architecture.
+static bool WriteAllArchitectures(const Options &options,
+                                  bool split_module,
+                                  DumpSymbols *dump_symbols,
+                                  SymbolData symbol_data) {
+  // Name the output files before reading another file replaces the
+  // architecture list.
+  size_t available_size;
+  const struct fat_arch *available =
+      dump_symbols->AvailableArchitectures(&available_size);
+  vector<string> paths;
+  for (size_t i = 0; i < available_size; i++) {
+    const NXArchInfo *arch_info =
+        google_breakpad::BreakpadGetArchInfoFromCpuType(
+            available[i].cputype, available[i].cpusubtype);
+    paths.push_back(arch_info ? string(options.outputPrefix) + "_" +
+                                arch_info->name + ".sym"
+                              : string());
+  }
+
+  vector<Module*> modules;
+  bool result = dump_symbols->ReadAllSymbolData(&modules);
+
+  vector<Module*> cfi_modules;
+  if (split_module) {
+    if (!dump_symbols->Read(options.srcPath) ||
+        !dump_symbols->ReadAllSymbolData(&cfi_modules))
+      result = false;
+  }
+
+  for (size_t i = 0; i < modules.size(); i++) {
+    scoped_ptr<Module> module(modules[i]);
+    if (!module.get())
+      continue;
+
+    if (split_module) {
+      const Module* cfi_module = NULL;
+      for (size_t j = 0; j < cfi_modules.size() && !cfi_module; j++) {
+        if (cfi_modules[j] && ModulesMatch(cfi_modules[j], module.get()))
+          cfi_module = cfi_modules[j];
+      }
+      if (!cfi_module) {
+        fprintf(stderr, "%s: no matching architecture '%s' in %s\n",
+                [options.dsymPath fileSystemRepresentation],
+                module->architecture().c_str(),
+                [options.srcPath fileSystemRepresentation]);
+        result = false;
+        continue;
+      }
+      CopyCFIDataBetweenModules(module.get(), cfi_module);
+    }
+
+    std::ofstream stream(paths[i].c_str());
+    if (!stream || !module->Write(stream, symbol_data)) {
+      fprintf(stderr, "Unable to write symbol file %s\n", paths[i].c_str());
+      result = false;
+    }
+  }
+
+  for (size_t i = 0; i < cfi_modules.size(); i++)
+    delete cfi_modules[i];
+
+  return result;
+}
+
 static bool Start(const Options &options) {
   SymbolData symbol_data = options.cfi ? ALL_SYMBOL_DATA : NO_CFI;
   DumpSymbols dump_symbols(symbol_data, options.handle_inter_cu_refs);
@@ -120,6 +201,11 @@ static bool Start(const Options &options) {
   if (!dump_symbols.Read(primary_file))
     return false;
 
+  if (options.outputPrefix) {
+    return WriteAllArchitectures(options, split_module, &dump_symbols,
+                                 symbol_data);
+  }
+
   if (options.arch) {
     if (!dump_symbols.SetArchitecture(options.arch->cputype,
                                       options.arch->cpusubtype)) {
@@ -165,10 +251,7 @@ static bool Start(const Options &options) {
     scoped_ptr<Module> scoped_cfi_module(cfi_module);
 
     // Ensure that the modules are for the same debug code file.
-    if (cfi_module->name() != module->name() ||
-        cfi_module->os() != module->os() ||
-        cfi_module->architecture() != module->architecture() ||
-        cfi_module->identifier() != module->identifier()) {
+    if (!ModulesMatch(cfi_module, module)) {
       fprintf(stderr, "Cannot generate a symbol file from split sources that do"
                       " not match.\n");
       return false;
@@ -183,10 +266,12 @@ static bool Start(const Options &options) {
 //=============================================================================
 static void Usage(int argc, const char *argv[]) {
   fprintf(stderr, "Output a Breakpad symbol file from a Mach-o file.\n");
-  fprintf(stderr, "Usage: %s [-a ARCHITECTURE] [-c] [-g dSYM path] "
-                  "<Mach-o file>\n", argv[0]);
+  fprintf(stderr, "Usage: %s [-a ARCHITECTURE | -o PREFIX] [-c] "
+                  "[-g dSYM path] <Mach-o file>\n", argv[0]);
   fprintf(stderr, "\t-a: Architecture type [default: native, or whatever is\n");
   fprintf(stderr, "\t    in the file, if it contains only one architecture]\n");
+  fprintf(stderr, "\t-o: Dump every architecture in the file at once, to\n");
+  fprintf(stderr, "\t    PREFIX_<architecture>.sym, instead of to stdout\n");
   fprintf(stderr, "\t-g: Debug symbol file (dSYM) to dump in addition to the "
                   "Mach-o file\n");
   fprintf(stderr, "\t-c: Do not generate CFI section\n");
@@ -200,7 +285,7 @@ static void SetupOptions(int argc, const char *argv[], Options *options) {
   extern int optind;
   signed char ch;
 
-  while ((ch = getopt(argc, (char * const *)argv, "a:g:chr?")) != -1) {
+  while ((ch = getopt(argc, (char * const *)argv, "a:g:o:chr?")) != -1) {
     switch (ch) {
       case 'a': {
         const NXArchInfo *arch_info =
@@ -217,6 +302,9 @@ static void SetupOptions(int argc, const char *argv[], Options *options) {
         options->dsymPath = [[NSFileManager defaultManager]
             stringWithFileSystemRepresentation:optarg length:strlen(optarg)];
         break;
+      case 'o':
+        options->outputPrefix = optarg;
+        break;
       case 'c':
         options->cfi = false;
         break;
@@ -231,6 +319,12 @@ static void SetupOptions(int argc, const char *argv[], Options *options) {
     }
   }
 
+  if (options->arch && options->outputPrefix) {
+    fprintf(stderr, "%s: -a and -o cannot be used together\n", argv[0]);
+    Usage(argc, argv);
+    exit(1);
+  }
+
   if ((argc - optind) != 1) {
     fprintf(stderr, "Must specify Mach-o file\n");
     Usage(argc, argv);
@@ -218,8 +218,9 @@ type DumpQueue struct {
 }
 
 type dumpRequest struct {
-	path string
-	arch string
+	path  string
+	archs []string
+	all   bool
 }
 
 // StartDumpQueue creates a new worker pool to find all the Mach-O libraries in
@@ -239,11 +240,13 @@ func StartDumpQueue(root, dumpPath string, uq *UploadQueue) *DumpQueue {
 }
 
 // DumpSymbols enqueues the filepath to have its symbols dumped in the specified
-// architecture.
-func (dq *DumpQueue) DumpSymbols(filepath string, arch string) {
+// architectures. If archs lists every architecture in the file, they are all
+// dumped by a single run of dump_syms.
+func (dq *DumpQueue) DumpSymbols(filepath string, archs []string, allArchs bool) {
 	dq.queue <- dumpRequest{
-		path: filepath,
-		arch: arch,
+		path:  filepath,
+		archs: archs,
+		all:   allArchs,
 	}
 }
 
@@ -263,26 +266,50 @@ func (dq *DumpQueue) worker() {
 
 	for req := range dq.queue {
 		filebase := path.Join(dq.dumpPath, strings.Replace(req.path, "/", "_", -1))
-		symfile := fmt.Sprintf("%s_%s.sym", filebase, req.arch)
-		f, err := os.Create(symfile)
-		if err != nil {
-			log.Fatal("Error creating symbol file:", err)
-		}
 
-		cmd := exec.Command(dumpSyms, "-a", req.arch, req.path)
-		cmd.Stdout = f
-		err = cmd.Run()
-		f.Close()
+		if req.all && len(req.archs) > 1 {
+			// dump_syms reads all the architectures at once and writes
+			// filebase_<arch>.sym for each one it could read.
+			cmd := exec.Command(dumpSyms, "-o", filebase, req.path)
+			if output, err := cmd.CombinedOutput(); err != nil {
+				log.Printf("Error running dump_syms(-o, %s): %v: %s\n", req.path, err, output)
+			}
+			for _, arch := range req.archs {
+				symfile := fmt.Sprintf("%s_%s.sym", filebase, arch)
+				if _, err := os.Stat(symfile); err == nil && dq.uq != nil {
+					dq.uq.Upload(symfile)
+				}
+			}
+			continue
+		}
 
-		if err != nil {
-			os.Remove(symfile)
-			log.Printf("Error running dump_syms(%s, %s): %v\n", req.arch, req.path, err)
-		} else if dq.uq != nil {
-			dq.uq.Upload(symfile)
+		for _, arch := range req.archs {
+			dq.dumpArch(dumpSyms, filebase, req.path, arch)
 		}
 	}
 }
 
+// dumpArch runs dump_syms for a single architecture of filepath.
+func (dq *DumpQueue) dumpArch(dumpSyms, filebase, filepath, arch string) {
+	symfile := fmt.Sprintf("%s_%s.sym", filebase, arch)
+	f, err := os.Create(symfile)
+	if err != nil {
+		log.Fatal("Error creating symbol file:", err)
+	}
+
+	cmd := exec.Command(dumpSyms, "-a", arch, filepath)
+	cmd.Stdout = f
+	err = cmd.Run()
+	f.Close()
+
+	if err != nil {
+		os.Remove(symfile)
+		log.Printf("Error running dump_syms(%s, %s): %v\n", arch, filepath, err)
+	} else if dq.uq != nil {
+		dq.uq.Upload(symfile)
+	}
+}
+
 // uploadFromDirectory handles the upload-only case and merely uploads all files in
 // a directory.
 func uploadFromDirectory(directory string, uq *UploadQueue) {
@@ -384,10 +411,14 @@ func (fq *findQueue) worker() {
 		fatFile, err := macho.NewFatFile(f)
 		if err == nil {
 			// The file is fat, so dump its architectures.
+			var archs []string
 			for _, fatArch := range fatFile.Arches {
-				fq.dumpMachOFile(fp, fatArch.File)
+				if arch := dumpableArch(fatArch.File); arch != "" {
+					archs = append(archs, arch)
+				}
 			}
 			fatFile.Close()
+			fq.dumpArchs(fp, archs, len(archs) == len(fatFile.Arches))
 		} else if err == macho.ErrNotFat {
 			// The file isn't fat but may still be MachO.
 			thinFile, err := macho.NewFile(f)
@@ -395,7 +426,9 @@ func (fq *findQueue) worker() {
 				log.Printf("%s: %v", fp, err)
 				continue
 			}
-			fq.dumpMachOFile(fp, thinFile)
+			if arch := dumpableArch(thinFile); arch != "" {
+				fq.dumpArchs(fp, []string{arch}, true)
+			}
 			thinFile.Close()
 		} else {
 			f.Close()
@@ -403,18 +436,31 @@ func (fq *findQueue) worker() {
 	}
 }
 
-func (fq *findQueue) dumpMachOFile(fp string, image *macho.File) {
+// dumpableArch returns the architecture name of image if its symbols should
+// be dumped, or "" if not.
+func dumpableArch(image *macho.File) string {
 	if image.Type != MachODylib && image.Type != MachOBundle {
-		return
+		return ""
 	}
 
-	arch := getArchStringFromHeader(image.FileHeader)
-	if arch == "" {
-		// Don't know about this architecture type.
+	// This is "" if the architecture type is unknown.
+	return getArchStringFromHeader(image.FileHeader)
+}
+
+// dumpArchs enqueues the dumpable architectures archs of fp, or just
+// -arch if that was specified. allArchs is true if archs lists every
+// architecture in the file.
+func (fq *findQueue) dumpArchs(fp string, archs []string, allArchs bool) {
+	if *dumpArchitecture != "" {
+		for _, arch := range archs {
+			if arch == *dumpArchitecture {
+				fq.dq.DumpSymbols(fp, []string{arch}, false)
+			}
+		}
 		return
 	}
 
-	if (*dumpArchitecture != "" && *dumpArchitecture == arch) || *dumpArchitecture == "" {
-		fq.dq.DumpSymbols(fp, arch)
+	if len(archs) > 0 {
+		fq.dq.DumpSymbols(fp, archs, allArchs)
 	}
 }
@@ -0,0 +1,288 @@
+// Copyright (c) 2016, Google Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+// notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above
+// copyright notice, this list of conditions and the following disclaimer
+// in the documentation and/or other materials provided with the
+// distribution.
+//     * Neither the name of Google Inc. nor the names of its
+// contributors may be used to endorse or promote products derived from
+// this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+// ms_symbol_server_batch_converter.cc: Convert many symbol files from
+// Microsoft symbol servers with a pool of MSSymbolServerConverter workers.
+//
+// See ms_symbol_server_batch_converter.h for documentation.
+
+#include "tools/windows/converter/ms_symbol_server_batch_converter.h"
+
+#include <objbase.h>
+
+#include <cassert>
+#include <cstdio>
+
+namespace google_breakpad {
+
+MSSymbolServerBatchConverter::MSSymbolServerBatchConverter(
+    const string &local_cache,
+    const vector<string> &symbol_servers,
+    int thread_count)
+    : local_cache_(local_cache),
+      symbol_servers_(symbol_servers),
+      thread_count_(thread_count),
+      missing_(),
+      missing_list_file_(),
+      batch_(NULL),
+      results_(NULL),
+      keep_symbol_file_(false),
+      keep_pe_file_(false),
+      next_index_(0) {
+  if (thread_count_ <= 0) {
+    SYSTEM_INFO system_info;
+    GetSystemInfo(&system_info);
+    thread_count_ = system_info.dwNumberOfProcessors;
+  }
+
+  InitializeCriticalSection(&symsrv_lock_);
+  InitializeCriticalSection(&missing_lock_);
+}
+
+MSSymbolServerBatchConverter::~MSSymbolServerBatchConverter() {
+  DeleteCriticalSection(&missing_lock_);
+  DeleteCriticalSection(&symsrv_lock_);
+}
+
+bool MSSymbolServerBatchConverter::LoadMissingList(
+    const string &missing_list_file) {
+  EnterCriticalSection(&missing_lock_);
+  missing_list_file_ = missing_list_file;
+
+  FILE *file = NULL;
+#if _MSC_VER >= 1400  // MSVC 2005/8
+  if (fopen_s(&file, missing_list_file.c_str(), "r") != 0)
+    file = NULL;
+#else  // _MSC_VER >= 1400
+  file = fopen(missing_list_file.c_str(), "r");
+#endif  // _MSC_VER >= 1400
+  if (!file) {
+    LeaveCriticalSection(&missing_lock_);
+    // A list that was never written is empty.
+    return GetFileAttributesA(missing_list_file.c_str()) ==
+           INVALID_FILE_ATTRIBUTES;
+  }
+
+  char line[MAX_PATH * 2];
+  while (fgets(line, sizeof(line), file)) {
+    string key(line);
+    while (!key.empty() &&
+           (key[key.length() - 1] == '\n' || key[key.length() - 1] == '\r')) {
+      key.erase(key.length() - 1);
+    }
+    if (!key.empty())
+      missing_.insert(key);
+  }
+  fclose(file);
+
+  LeaveCriticalSection(&missing_lock_);
+  return true;
+}
+
+size_t MSSymbolServerBatchConverter::Convert(
+    const vector<MissingSymbolInfo> &missing,
+    bool keep_symbol_file,
+    bool keep_pe_file,
+    vector<Result> *results) {
+  assert(results);
+  results->clear();
+  results->resize(missing.size());
+  for (size_t i = 0; i < results->size(); ++i) {
+    (*results)[i].result = MSSymbolServerConverter::LOCATE_FAILURE;
+  }
+
+  batch_ = &missing;
+  results_ = results;
+  keep_symbol_file_ = keep_symbol_file;
+  keep_pe_file_ = keep_pe_file;
+  next_index_ = 0;
+
+  size_t thread_count = thread_count_;
+  if (thread_count > missing.size())
+    thread_count = missing.size();
+
+  vector<HANDLE> threads;
+  for (size_t i = 0; i < thread_count; ++i) {
+    HANDLE thread = CreateThread(NULL, 0, WorkerThread, this, 0, NULL);
+    if (thread) {
+      threads.push_back(thread);
+    } else {
+      fprintf(stderr, "MSSymbolServerBatchConverter: CreateThread: "
+              "error %d\n", GetLastError());
+    }
+  }
+
+  if (threads.empty()) {
+    // Work through the whole batch on this thread instead.
+    WorkerThread(this);
+  }
+
+  for (size_t i = 0; i < threads.size(); ++i) {
+    WaitForSingleObject(threads[i], INFINITE);
+    CloseHandle(threads[i]);
+  }
+
+  batch_ = NULL;
+  results_ = NULL;
+
+  size_t converted = 0;
+  for (size_t i = 0; i < results->size(); ++i) {
+    if ((*results)[i].result == MSSymbolServerConverter::LOCATE_SUCCESS)
+      ++converted;
+  }
+  return converted;
+}
+
+// static
+DWORD WINAPI MSSymbolServerBatchConverter::WorkerThread(void *context) {
+  MSSymbolServerBatchConverter *self =
+      reinterpret_cast<MSSymbolServerBatchConverter *>(context);
+
+  // PDBSourceLineWriter uses DIA, which needs COM on this thread.
+  HRESULT com_result = CoInitialize(NULL);
+
+  MSSymbolServerConverter converter(self->local_cache_,
+                                    self->symbol_servers_);
+  converter.set_symsrv_lock(&self->symsrv_lock_);
+
+  while (true) {
+    // InterlockedIncrement returns the incremented value.
+    size_t index = InterlockedIncrement(&self->next_index_) - 1;
+    if (index >= self->batch_->size())
+      break;
+    self->ConvertOne(&converter, index);
+  }
+
+  if (SUCCEEDED(com_result))
+    CoUninitialize();
+  return 0;
+}
+
+void MSSymbolServerBatchConverter::ConvertOne(
+    MSSymbolServerConverter *converter, size_t index) {
+  const MissingSymbolInfo &missing = (*batch_)[index];
+  Result &result = (*results_)[index];
+
+  string cached_symbol_file = CachedSymbolFile(missing);
+  if (!cached_symbol_file.empty() &&
+      GetFileAttributesA(cached_symbol_file.c_str()) !=
+          INVALID_FILE_ATTRIBUTES) {
+    result.result = MSSymbolServerConverter::LOCATE_SUCCESS;
+    result.converted_symbol_file = cached_symbol_file;
+    return;
+  }
+
+  if (IsKnownMissing(missing)) {
+    result.result = MSSymbolServerConverter::LOCATE_NOT_FOUND;
+    return;
+  }
+
+  result.result = converter->LocateAndConvertSymbolFile(
+      missing, keep_symbol_file_, keep_pe_file_,
+      &result.converted_symbol_file, NULL, NULL);
+
+  if (result.result == MSSymbolServerConverter::LOCATE_NOT_FOUND)
+    AddKnownMissing(missing);
+}
+
+string MSSymbolServerBatchConverter::CachedSymbolFile(
+    const MissingSymbolInfo &missing) const {
+  const string &debug_file = missing.debug_file;
+  if (debug_file.length() < 4 ||
+      _stricmp(debug_file.c_str() + debug_file.length() - 4, ".pdb") != 0) {
+    return string();
+  }
+
+  GUIDOrSignatureIdentifier identifier;
+  if (!identifier.InitializeFromString(missing.debug_identifier))
+    return string();
+
+  // SymSrv stores files as <cache>\<file>\<index>\<file>, where the index
+  // is the uppercase guid or signature followed by the age in lowercase.
+  char index[64];
+  if (identifier.type() == GUIDOrSignatureIdentifier::TYPE_GUID) {
+    GUID guid = identifier.guid();
+    _snprintf_s(index, sizeof(index), _TRUNCATE,
+                "%08X%04X%04X%02X%02X%02X%02X%02X%02X%02X%02X%x",
+                guid.Data1, guid.Data2, guid.Data3,
+                guid.Data4[0], guid.Data4[1], guid.Data4[2], guid.Data4[3],
+                guid.Data4[4], guid.Data4[5], guid.Data4[6], guid.Data4[7],
+                identifier.age());
+  } else {
+    _snprintf_s(index, sizeof(index), _TRUNCATE, "%08X%x",
+                identifier.signature(), identifier.age());
+  }
+
+  // LocateAndConvertSymbolFile stores the converted file next to the pdb,
+  // with .sym in place of .pdb.
+  return local_cache_ + "\\" + debug_file + "\\" + index + "\\" +
+         debug_file.substr(0, debug_file.length() - 4) + ".sym";
+}
+
+// static
+string MSSymbolServerBatchConverter::MissingKey(
+    const MissingSymbolInfo &missing) {
+  return missing.debug_file + " " + missing.debug_identifier;
+}
+
+bool MSSymbolServerBatchConverter::IsKnownMissing(
+    const MissingSymbolInfo &missing) {
+  EnterCriticalSection(&missing_lock_);
+  bool known_missing = missing_.find(MissingKey(missing)) != missing_.end();
+  LeaveCriticalSection(&missing_lock_);
+  return known_missing;
+}
+
+void MSSymbolServerBatchConverter::AddKnownMissing(
+    const MissingSymbolInfo &missing) {
+  string key = MissingKey(missing);
+
+  EnterCriticalSection(&missing_lock_);
+  if (missing_.insert(key).second && !missing_list_file_.empty()) {
+    // Append right away, so that an interrupted batch keeps what it
+    // learned.
+    FILE *file = NULL;
+#if _MSC_VER >= 1400  // MSVC 2005/8
+    if (fopen_s(&file, missing_list_file_.c_str(), "a") != 0)
+      file = NULL;
+#else  // _MSC_VER >= 1400
+    file = fopen(missing_list_file_.c_str(), "a");
+#endif  // _MSC_VER >= 1400
+    if (file) {
+      fprintf(file, "%s\n", key.c_str());
+      fclose(file);
+    } else {
+      fprintf(stderr, "MSSymbolServerBatchConverter: could not append to "
+              "%s\n", missing_list_file_.c_str());
+    }
+  }
+  LeaveCriticalSection(&missing_lock_);
+}
+
+}  // namespace google_breakpad
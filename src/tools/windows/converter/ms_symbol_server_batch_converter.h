@@ -0,0 +1,144 @@
+// Copyright (c) 2016, Google Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+// notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above
+// copyright notice, this list of conditions and the following disclaimer
+// in the documentation and/or other materials provided with the
+// distribution.
+//     * Neither the name of Google Inc. nor the names of its
+// contributors may be used to endorse or promote products derived from
+// this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+// ms_symbol_server_batch_converter.h: Convert many symbol files from
+// Microsoft symbol servers with a pool of MSSymbolServerConverter workers.
+//
+// Each worker takes the next module from a shared queue, locates its pdb and
+// PE files and converts them with its own PDBSourceLineWriter.  DbgHelp is
+// single-threaded, so the workers take turns in SymFindFileInPath, but a
+// worker's conversion overlaps with the other workers' downloads.
+//
+// Two things keep repeated runs over the same module list cheap:
+//  - A module whose converted .sym file is already in the local cache is
+//    reported as converted without contacting the symbol servers.
+//  - Modules that a symbol server authoritatively reported as missing are
+//    recorded in a "known missing" file, one "<debug_file> <debug_identifier>"
+//    line each, and are not requested again.  Transient failures are not
+//    recorded.
+
+#ifndef TOOLS_WINDOWS_MS_SYMBOL_SERVER_BATCH_CONVERTER_H_
+#define TOOLS_WINDOWS_MS_SYMBOL_SERVER_BATCH_CONVERTER_H_
+
+#include <windows.h>
+
+#include <set>
+#include <string>
+#include <vector>
+
+#include "tools/windows/converter/ms_symbol_server_converter.h"
+
+namespace google_breakpad {
+
+using std::set;
+using std::string;
+using std::vector;
+
+class MSSymbolServerBatchConverter {
+ public:
+  // The outcome of converting one module.
+  struct Result {
+    MSSymbolServerConverter::LocateResult result;
+
+    // The converted symbol file, when result is LOCATE_SUCCESS.
+    string converted_symbol_file;
+  };
+
+  // local_cache and symbol_servers are passed to each worker's
+  // MSSymbolServerConverter.  thread_count is the number of workers; 0
+  // means one per processor.
+  MSSymbolServerBatchConverter(const string &local_cache,
+                               const vector<string> &symbol_servers,
+                               int thread_count);
+  ~MSSymbolServerBatchConverter();
+
+  // Reads the known-missing list from missing_list_file and appends newly
+  // missing modules to it during Convert.  A file that does not exist yet
+  // is treated as empty.  Returns false if the file exists but cannot be
+  // read.
+  bool LoadMissingList(const string &missing_list_file);
+
+  // Locates and converts each module in |missing|, as
+  // MSSymbolServerConverter::LocateAndConvertSymbolFile does, and stores
+  // one Result per module in |results|, in the same order.  Returns the
+  // number of modules that were converted or found already converted.
+  size_t Convert(const vector<MissingSymbolInfo> &missing,
+                 bool keep_symbol_file,
+                 bool keep_pe_file,
+                 vector<Result> *results);
+
+ private:
+  // Runs one worker until the queue is empty.
+  static DWORD WINAPI WorkerThread(void *context);
+
+  // Handles the module at |index| of the current batch.
+  void ConvertOne(MSSymbolServerConverter *converter, size_t index);
+
+  // Returns the path that the converted symbol file for |missing| has in
+  // the local cache.  Returns an empty string if the debug file is not a
+  // pdb.
+  string CachedSymbolFile(const MissingSymbolInfo &missing) const;
+
+  // Returns the key used for |missing| in missing_.
+  static string MissingKey(const MissingSymbolInfo &missing);
+
+  // Returns true if |missing| is on the known-missing list.
+  bool IsKnownMissing(const MissingSymbolInfo &missing);
+
+  // Adds |missing| to the known-missing list and its file.
+  void AddKnownMissing(const MissingSymbolInfo &missing);
+
+  string local_cache_;
+  vector<string> symbol_servers_;
+  int thread_count_;
+
+  // Serializes DbgHelp use between the workers' converters.
+  CRITICAL_SECTION symsrv_lock_;
+
+  // Guards missing_ and the known-missing file.
+  CRITICAL_SECTION missing_lock_;
+  set<string> missing_;
+  string missing_list_file_;
+
+  // The batch that Convert is working on, and the index of the next
+  // module to hand out, advanced with InterlockedIncrement.
+  const vector<MissingSymbolInfo> *batch_;
+  vector<Result> *results_;
+  bool keep_symbol_file_;
+  bool keep_pe_file_;
+  volatile LONG next_index_;
+
+  // Disallow copy ctor and operator=
+  MSSymbolServerBatchConverter(const MSSymbolServerBatchConverter&);
+  void operator=(const MSSymbolServerBatchConverter&);
+};
+
+}  // namespace google_breakpad
+
+#endif  // TOOLS_WINDOWS_MS_SYMBOL_SERVER_BATCH_CONVERTER_H_
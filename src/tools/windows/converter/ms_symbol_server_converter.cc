@@ -103,6 +103,7 @@ bool GUIDOrSignatureIdentifier::InitializeFromString(
 MSSymbolServerConverter::MSSymbolServerConverter(
     const string &local_cache, const vector<string> &symbol_servers)
     : symbol_path_(),
+      symsrv_lock_(NULL),
       fail_dns_(false),
       fail_timeout_(false),
       fail_not_found_(false) {
@@ -180,6 +181,24 @@ class AutoSymSrv {
   bool initialized_;
 };
 
+// A stack-based class that holds a critical section, if there is one, for
+// as long as it is in scope.
+class AutoSymSrvLock {
+ public:
+  explicit AutoSymSrvLock(CRITICAL_SECTION *lock) : lock_(lock) {
+    if (lock_)
+      EnterCriticalSection(lock_);
+  }
+
+  ~AutoSymSrvLock() {
+    if (lock_)
+      LeaveCriticalSection(lock_);
+  }
+
+ private:
+  CRITICAL_SECTION *lock_;
+};
+
 // A stack-based class that "owns" a pathname and deletes it when destroyed,
 // unless told not to by having its Release() method called.  Early deletions
 // are supported by calling Delete().
@@ -232,6 +251,9 @@ MSSymbolServerConverter::LocateFile(const string &debug_or_code_file,
     return LOCATE_FAILURE;
   }
 
+  // Declared before symsrv so that SymCleanup runs with the lock held.
+  AutoSymSrvLock symsrv_lock(symsrv_lock_);
+
   HANDLE process = GetCurrentProcess();  // CloseHandle is not needed.
   AutoSymSrv symsrv;
   if (!symsrv.Initialize(process,
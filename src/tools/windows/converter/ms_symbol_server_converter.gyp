@@ -36,7 +36,10 @@
       'type': 'static_library',
       'msvs_guid': '1463C4CD-23FC-4DE9-BFDE-283338200157',
       'sources': [
+        'ms_symbol_server_batch_converter.cc',
+        'ms_symbol_server_batch_converter.h',
         'ms_symbol_server_converter.cc',
+        'ms_symbol_server_converter.h',
       ],
       'dependencies': [
         '../../../common/windows/common_windows.gyp:common_windows_lib',
@@ -144,6 +144,14 @@ class MSSymbolServerConverter {
   MSSymbolServerConverter(const string &local_cache,
                           const vector<string> &symbol_servers);
 
+  // DbgHelp functions are single-threaded.  When several converters run on
+  // different threads, they must share a lock, which LocateFile holds from
+  // SymInitialize to SymCleanup.  The lock is not owned by the converter.
+  // By default there is no lock.
+  void set_symsrv_lock(CRITICAL_SECTION *symsrv_lock) {
+    symsrv_lock_ = symsrv_lock;
+  }
+
   // Locates the PE file (DLL or EXE) specified by the identifying information
   // in |missing|, by checking the symbol stores identified when the object
   // was created.  When returning LOCATE_SUCCESS, pe_file is set to
@@ -206,6 +214,9 @@ class MSSymbolServerConverter {
   // constructor.
   string symbol_path_;
 
+  // Serializes DbgHelp use between converters, if set.  Not owned.
+  CRITICAL_SECTION *symsrv_lock_;
+
   // SymCallback will set at least one of these failure variables if
   // SymFindFileInPath fails for an expected reason.
   bool fail_dns_;        // DNS failures (fail_not_found_ will also be set).
@@ -31,6 +31,7 @@
 // a text-based format that we can use from the minidump processor.
 
 #include <stdio.h>
+#include <stdlib.h>
 
 #include <string>
 
@@ -40,13 +41,24 @@ using std::wstring;
 using google_breakpad::PDBSourceLineWriter;
 
 int wmain(int argc, wchar_t **argv) {
-  if (argc < 2) {
-    fprintf(stderr, "Usage: %ws <file.[pdb|exe|dll]>\n", argv[0]);
+  // -j <threads> lets the writer print functions on several threads; 0
+  // means one per processor.
+  int thread_count = 1;
+  int arg_index = 1;
+  if (argc > 2 && wcscmp(argv[1], L"-j") == 0) {
+    thread_count = _wtoi(argv[2]);
+    arg_index = 3;
+  }
+
+  if (argc <= arg_index) {
+    fprintf(stderr, "Usage: %ws [-j <threads>] <file.[pdb|exe|dll]>\n",
+            argv[0]);
     return 1;
   }
 
   PDBSourceLineWriter writer;
-  if (!writer.Open(wstring(argv[1]), PDBSourceLineWriter::ANY_FILE)) {
+  writer.set_thread_count(thread_count);
+  if (!writer.Open(wstring(argv[arg_index]), PDBSourceLineWriter::ANY_FILE)) {
     fprintf(stderr, "Open failed\n");
     return 1;
   }
@@ -199,6 +199,27 @@ TEST_F(DumpSymsRegressionTest, EnsureDumpedSymbolsMatch) {
   }
 }
 
+TEST_F(DumpSymsRegressionTest, EnsureParallelDumpedSymbolsMatch) {
+  for (size_t i = 0; i < sizeof(kRootNames) / sizeof(kRootNames[0]); ++i) {
+    const wchar_t* root_name = kRootNames[i];
+    std::wstring root_path = testdata_dir + L"\\" + root_name;
+
+    std::wstring sym_path = root_path + L".sym";
+    std::string expected_symbols;
+    ASSERT_NO_FATAL_FAILURE(GetFileContents(sym_path, &expected_symbols));
+
+    // The output has to be the same when functions are printed by several
+    // threads.
+    std::wstring pdb_path = root_path + L".pdb";
+    std::wstring command_line = L"\"" + dump_syms_exe + L"\" -j 4 \"" +
+        pdb_path + L"\"";
+    std::string symbols;
+    ASSERT_NO_FATAL_FAILURE(RunCommand(command_line, &symbols));
+
+    EXPECT_EQ(expected_symbols, symbols);
+  }
+}
+
 }  // namespace dump_syms
 }  // namespace windows
 }  // namespace tools
\ No newline at end of file